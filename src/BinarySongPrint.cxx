@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BinarySongPrint.hxx"
+#include "song/LightSong.hxx"
+#include "song/DetachedSong.hxx"
+#include "client/Response.hxx"
+#include "tag/Names.hxx"
+#include "tag/Tag.hxx"
+#include "fs/Traits.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "time/ChronoUtil.hxx"
+#include "util/PackedBigEndian.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/UriUtil.hxx"
+
+#include <string>
+
+static constexpr BinarySongKey
+TagKey(TagType type) noexcept
+{
+	return BinarySongKey(uint8_t(BinarySongKey::TAG_BASE) + uint8_t(type));
+}
+
+static_assert(uint8_t(BinarySongKey::TAG_BASE) + TAG_NUM_OF_ITEM_TYPES <= 0x100,
+	      "Too many tag types for the binary song encoding");
+
+inline void
+BinarySongWriter::AddRecord(BinarySongKey key, std::string_view value) noexcept
+{
+	const PackedBE32 length(value.size());
+
+	buffer.push_back(char(key));
+	buffer.append(ToStringView(ReferenceAsBytes(length)));
+	buffer.append(value);
+}
+
+inline void
+BinarySongWriter::AddRecord(BinarySongKey key, uint8_t value) noexcept
+{
+	AddRecord(key, ToStringView(ReferenceAsBytes(value)));
+}
+
+inline void
+BinarySongWriter::AddRecord(BinarySongKey key, uint32_t value) noexcept
+{
+	const PackedBE32 be(value);
+	AddRecord(key, ToStringView(ReferenceAsBytes(be)));
+}
+
+inline void
+BinarySongWriter::AddTime(BinarySongKey key,
+			  std::chrono::system_clock::time_point t) noexcept
+{
+	if (IsNegative(t))
+		return;
+
+	const PackedBE64 be(std::chrono::system_clock::to_time_t(t));
+	AddRecord(key, ToStringView(ReferenceAsBytes(be)));
+}
+
+inline void
+BinarySongWriter::AddUri(const char *uri, bool base) noexcept
+{
+	if (base) {
+		AddRecord(BinarySongKey::URI, PathTraitsUTF8::GetBase(uri));
+		return;
+	}
+
+	const auto allocated = uri_remove_auth(uri);
+	AddRecord(BinarySongKey::URI,
+		  allocated.empty() ? std::string_view{uri} : allocated);
+}
+
+inline void
+BinarySongWriter::AddRange(unsigned start_ms, unsigned end_ms) noexcept
+{
+	if (start_ms == 0 && end_ms == 0)
+		return;
+
+	const PackedBE32 range[] = {start_ms, end_ms};
+	AddRecord(BinarySongKey::RANGE,
+		  ToStringView(std::as_bytes(std::span{range})));
+}
+
+inline void
+BinarySongWriter::AddTagItem(TagType type, std::string_view value) noexcept
+{
+	const auto key = TagKey(type);
+
+	if (r.AnnounceBinaryTag(type)) {
+		std::string announce;
+		announce.push_back(char(key));
+		announce.append(tag_item_names[type]);
+		AddRecord(BinarySongKey::TAG_NAME, announce);
+	}
+
+	AddRecord(key, value);
+}
+
+inline void
+BinarySongWriter::AddTag(const Tag &tag) noexcept
+{
+	const auto tag_mask = r.GetTagMask();
+	for (const auto &i : tag)
+		if (tag_mask.Test(i.type))
+			AddTagItem(i.type, i.value);
+}
+
+void
+BinarySongWriter::AddSong(const LightSong &song, bool base) noexcept
+{
+	if (!base && song.directory != nullptr)
+		AddRecord(BinarySongKey::URI,
+			  std::string{song.directory} + '/' + song.uri);
+	else
+		AddUri(song.uri, base);
+
+	AddRange(song.start_time.ToMS(), song.end_time.ToMS());
+	AddTime(BinarySongKey::LAST_MODIFIED, song.mtime);
+	AddTime(BinarySongKey::ADDED, song.added);
+
+	if (song.audio_format.IsDefined())
+		AddRecord(BinarySongKey::FORMAT,
+			  ToString(song.audio_format).c_str());
+
+	AddTag(song.tag);
+
+	if (const auto duration = song.GetDuration(); !duration.IsNegative())
+		AddRecord(BinarySongKey::DURATION, uint32_t(duration.ToMS()));
+}
+
+void
+BinarySongWriter::AddSong(const DetachedSong &song, bool base) noexcept
+{
+	AddUri(song.GetURI(), base);
+
+	AddRange(song.GetStartTime().ToMS(), song.GetEndTime().ToMS());
+	AddTime(BinarySongKey::LAST_MODIFIED, song.GetLastModified());
+	AddTime(BinarySongKey::ADDED, song.GetAdded());
+
+	if (const auto &f = song.GetAudioFormat(); f.IsDefined())
+		AddRecord(BinarySongKey::FORMAT, ToString(f).c_str());
+
+	AddTag(song.GetTag());
+
+	if (const auto duration = song.GetDuration(); !duration.IsNegative())
+		AddRecord(BinarySongKey::DURATION, uint32_t(duration.ToMS()));
+}
+
+void
+BinarySongWriter::AddQueuePosition(unsigned position, unsigned id,
+				   uint8_t priority) noexcept
+{
+	AddRecord(BinarySongKey::POS, uint32_t(position));
+	AddRecord(BinarySongKey::ID, uint32_t(id));
+
+	if (priority != 0)
+		AddRecord(BinarySongKey::PRIO, priority);
+}
+
+void
+BinarySongWriter::Commit() noexcept
+{
+	r.Fmt(FMT_STRING("binary: {}\n"), buffer.size());
+	r.Write(buffer.data(), buffer.size());
+	r.Write("\n");
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_BINARY_SONG_PRINT_HXX
+#define MPD_BINARY_SONG_PRINT_HXX
+
+#include "tag/Type.hxx"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+struct LightSong;
+struct Tag;
+class DetachedSong;
+class Response;
+
+/**
+ * The keys of the records in the binary song encoding (protocol
+ * feature "binary_songs").  Keys 0x80 and above are tag types
+ * (#TagType plus 0x80) whose names are announced with
+ * #TAG_NAME records.
+ */
+enum class BinarySongKey : uint8_t {
+	/**
+	 * A string; the URI.
+	 */
+	URI = 0x01,
+
+	/**
+	 * Two 32 bit integers: start and end time in milliseconds
+	 * (end time 0 means "until the end").
+	 */
+	RANGE = 0x02,
+
+	/**
+	 * A signed 64 bit integer: seconds since the epoch.
+	 */
+	LAST_MODIFIED = 0x03,
+	ADDED = 0x04,
+
+	/**
+	 * A string in the same format as the "Format" line.
+	 */
+	FORMAT = 0x05,
+
+	/**
+	 * A 32 bit integer: the duration in milliseconds.
+	 */
+	DURATION = 0x06,
+
+	/**
+	 * 32 bit integers (queue position and song id) and an 8 bit
+	 * integer (priority, only if non-zero).
+	 */
+	POS = 0x07,
+	ID = 0x08,
+	PRIO = 0x09,
+
+	/**
+	 * Announces the name of a tag key: one byte (the tag key)
+	 * followed by the name.  Each tag key is announced only once
+	 * per response, before its first use.
+	 */
+	TAG_NAME = 0x7f,
+
+	TAG_BASE = 0x80,
+};
+
+/**
+ * Generates the binary encoding of a song: a "binary" chunk
+ * containing a sequence of records, each consisting of a one-byte
+ * #BinarySongKey, a 32 bit big-endian length and the value.  All
+ * integers are big-endian.  This avoids formatting (and parsing)
+ * each attribute as a text line.
+ */
+class BinarySongWriter {
+	Response &r;
+
+	fmt::memory_buffer buffer;
+
+public:
+	explicit BinarySongWriter(Response &_r) noexcept
+		:r(_r) {}
+
+	BinarySongWriter(const BinarySongWriter &) = delete;
+	BinarySongWriter &operator=(const BinarySongWriter &) = delete;
+
+	void AddSong(const LightSong &song, bool base) noexcept;
+	void AddSong(const DetachedSong &song, bool base) noexcept;
+
+	void AddQueuePosition(unsigned position, unsigned id,
+			      uint8_t priority) noexcept;
+
+	/**
+	 * Send the chunk to the client.
+	 */
+	void Commit() noexcept;
+
+private:
+	void AddRecord(BinarySongKey key, std::string_view value) noexcept;
+	void AddRecord(BinarySongKey key, uint8_t value) noexcept;
+	void AddRecord(BinarySongKey key, uint32_t value) noexcept;
+	void AddTime(BinarySongKey key,
+		     std::chrono::system_clock::time_point t) noexcept;
+
+	void AddUri(const char *uri, bool base) noexcept;
+	void AddRange(unsigned start_ms, unsigned end_ms) noexcept;
+	void AddTag(const Tag &tag) noexcept;
+	void AddTagItem(TagType type, std::string_view value) noexcept;
+};
+
+#endif
@@ -7,7 +7,8 @@
 #include "Partition.hxx"
 
 /**
- * Begin a "bulk edit" and commit it automatically.
+ * Begin a "bulk edit" and commit it automatically.  Bulk edits may
+ * be nested.
  */
 class ScopeBulkEdit {
 	Partition &partition;
@@ -23,6 +24,10 @@ public:
 
 	ScopeBulkEdit(const ScopeBulkEdit &) = delete;
 	ScopeBulkEdit &operator=(const ScopeBulkEdit &) = delete;
+
+	Partition &GetPartition() const noexcept {
+		return partition;
+	}
 };
 
 #endif
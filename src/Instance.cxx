@@ -6,9 +6,16 @@
 #include "Partition.hxx"
 #include "protocol/IdleFlags.hxx"
 #include "StateFile.hxx"
+#include "OutputStatsFile.hxx"
+#include "metrics/Server.hxx"
+#include "command/Trace.hxx"
 #include "Stats.hxx"
 #include "client/List.hxx"
+#include "thread/WorkerPool.hxx"
 #include "input/cache/Manager.hxx"
+#include "PictureCache.hxx"
+#include "tag/MixRampInfo.hxx"
+#include "Log.hxx"
 
 #ifdef ENABLE_CURL
 #include "RemoteTagCache.hxx"
@@ -20,10 +27,14 @@
 #include "db/Interface.hxx"
 #include "db/update/Service.hxx"
 #include "storage/StorageInterface.hxx"
+#include "storage/ListingCache.hxx"
 
 #ifdef ENABLE_INOTIFY
 #include "db/update/InotifyUpdate.hxx"
 #endif
+#ifdef ENABLE_FANOTIFY
+#include "db/update/FanotifyUpdate.hxx"
+#endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 #include "neighbor/Glue.hxx"
@@ -34,10 +45,13 @@
 #include "sticker/SongSticker.hxx"
 #include "sticker/TagSticker.hxx"
 #include "sticker/CleanupService.hxx"
+#include "analysis/Service.hxx"
 #endif
 
 #endif
 
+#include <vector>
+
 Instance::Instance() = default;
 
 Instance::~Instance() noexcept
@@ -47,6 +61,12 @@ Instance::~Instance() noexcept
 		sticker_cleanup.reset();
 #endif
 
+	/* stop background commands which may be accessing the
+	   database or the storage from another thread */
+	if (client_list)
+		for (auto &client : *client_list)
+			client.CancelBackgroundCommand();
+
 #ifdef ENABLE_DATABASE
 	delete update;
 
@@ -69,16 +89,34 @@ Instance::OnStateModified() noexcept
 Partition *
 Instance::FindPartition(const char *name) noexcept
 {
-	for (auto &partition : partitions)
-		if (partition.name == name)
-			return &partition;
+	const auto i = partitions_by_name.find(name);
+	return i != partitions_by_name.end()
+		? i->second
+		: nullptr;
+}
 
-	return nullptr;
+Partition &
+Instance::AddPartition(const char *name, const PartitionConfig &config)
+{
+	assert(FindPartition(name) == nullptr);
+
+	auto &partition = partitions.emplace_back(*this, name, config);
+
+	try {
+		partitions_by_name.emplace(partition.name, &partition);
+	} catch (...) {
+		partitions.pop_back();
+		throw;
+	}
+
+	return partition;
 }
 
 void
 Instance::DeletePartition(Partition &partition) noexcept
 {
+	partitions_by_name.erase(partition.name);
+
 	// TODO: use boost::intrusive::list to avoid this loop
 	for (auto i = partitions.begin();; ++i) {
 		assert(i != partitions.end());
@@ -127,6 +165,13 @@ Instance::OnDatabaseModified() noexcept
 
 	stats_invalidate();
 
+	/* picture files may have been added or removed */
+	if (picture_cache)
+		picture_cache->Flush();
+
+	if (storage_listing_cache)
+		storage_listing_cache->Flush();
+
 	for (auto &partition : partitions)
 		partition.DatabaseModified(*database);
 
@@ -183,11 +228,31 @@ Instance::LookupRemoteTag(const char *uri) noexcept
 
 	if (!remote_tag_cache)
 		remote_tag_cache = std::make_unique<RemoteTagCache>(event_loop,
-								    *this);
+								    *this,
+								    RemoteTagCacheConfig{});
 
 	remote_tag_cache->Lookup(uri);
 }
 
+void
+Instance::LookupRemoteTags(std::span<const std::string> uris) noexcept
+{
+	std::vector<std::string> remote;
+	for (const auto &uri : uris)
+		if (uri_has_scheme(uri))
+			remote.push_back(uri);
+
+	if (remote.empty())
+		return;
+
+	if (!remote_tag_cache)
+		remote_tag_cache = std::make_unique<RemoteTagCache>(event_loop,
+								    *this,
+								    RemoteTagCacheConfig{});
+
+	remote_tag_cache->Lookup(remote);
+}
+
 void
 Instance::OnRemoteTag(const char *uri, const Tag &tag) noexcept
 {
@@ -214,6 +279,14 @@ Instance::FlushCaches() noexcept
 {
 	if (input_cache)
 		input_cache->Flush();
+
+	if (picture_cache)
+		picture_cache->Flush();
+
+#ifdef ENABLE_DATABASE
+	if (storage_listing_cache)
+		storage_listing_cache->Flush();
+#endif
 }
 
 void
@@ -232,6 +305,41 @@ Instance::OnPlaylistDeleted(const char *name) const noexcept
 #endif
 }
 
+MixRampInfo
+Instance::LoadStoredMixRamp(const char *uri) noexcept
+{
+	MixRampInfo info;
+
+#ifdef ENABLE_SQLITE
+	if (!HasStickerDatabase())
+		return info;
+
+	const std::scoped_lock lock{player_sticker_mutex};
+
+	try {
+		if (!player_sticker_database)
+			player_sticker_database = std::make_unique<StickerDatabase>(sticker_database->Reopen());
+
+		if (auto s = player_sticker_database->LoadValue("song", uri,
+								"mixramp_start");
+		    !s.empty())
+			info.SetStart(std::move(s));
+
+		if (auto s = player_sticker_database->LoadValue("song", uri,
+								"mixramp_end");
+		    !s.empty())
+			info.SetEnd(std::move(s));
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load MixRamp stickers");
+	}
+#else
+	(void)uri;
+#endif
+
+	return info;
+}
+
 #ifdef ENABLE_SQLITE
 
 void
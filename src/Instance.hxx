@@ -8,6 +8,7 @@
 #include "event/Loop.hxx"
 #include "event/Thread.hxx"
 #include "event/MaskMonitor.hxx"
+#include "thread/Mutex.hxx"
 
 #ifdef ENABLE_SYSTEMD_DAEMON
 #include "lib/systemd/Watchdog.hxx"
@@ -27,23 +28,40 @@ class NeighborGlue;
 #include "db/Ptr.hxx"
 
 class Storage;
+class StorageListingCache;
 class UpdateService;
 #ifdef ENABLE_INOTIFY
 class InotifyUpdate;
 #endif
+#ifdef ENABLE_FANOTIFY
+class FanotifyUpdate;
+#endif
 #endif
 
+#include <atomic>
 #include <memory>
 #include <list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 class ClientList;
+class WorkerPool;
 struct Partition;
+struct PartitionConfig;
 class AudioOutputControl;
 class StateFile;
+class OutputStatsFile;
+class MetricsServer;
+class CommandTracer;
 class RemoteTagCache;
 class StickerDatabase;
 class StickerCleanupService;
+class AnalysisService;
+class MixRampInfo;
 class InputCacheManager;
+class PictureCache;
 
 /**
  * A utility class which, when used as the first base class, ensures
@@ -90,12 +108,24 @@ struct Instance final
 
 	std::unique_ptr<InputCacheManager> input_cache;
 
+	/**
+	 * Cache for "albumart" and "readpicture"; nullptr if
+	 * disabled.
+	 */
+	std::unique_ptr<PictureCache> picture_cache;
+
 	/**
 	 * Monitor for global idle events to be broadcasted to all
 	 * partitions.
 	 */
 	MaskMonitor idle_monitor{event_loop, BIND_THIS_METHOD(OnIdle)};
 
+	/**
+	 * The number of players which are currently running out of
+	 * decoded data (see PlayerListener::OnPlayerStarving()).
+	 */
+	std::atomic_uint n_starving_players{0};
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	std::unique_ptr<NeighborGlue> neighbors;
 #endif
@@ -109,29 +139,95 @@ struct Instance final
 	 */
 	Storage *storage = nullptr;
 
+	/**
+	 * Caches the directory listings of remote storages for
+	 * "listfiles"; nullptr if "storage_cache_ttl" is zero.
+	 */
+	std::unique_ptr<StorageListingCache> storage_listing_cache;
+
 	UpdateService *update = nullptr;
 
 #ifdef ENABLE_INOTIFY
 	std::unique_ptr<InotifyUpdate> inotify_update;
 #endif
+
+#ifdef ENABLE_FANOTIFY
+	std::unique_ptr<FanotifyUpdate> fanotify_update;
+#endif
 #endif
 
 #ifdef ENABLE_CURL
 	std::unique_ptr<RemoteTagCache> remote_tag_cache;
 #endif
 
+	/**
+	 * Executes read-only client commands (see
+	 * #WorkerBackgroundCommand).  This is nullptr if the setting
+	 * "command_threads" is zero.  It is declared before
+	 * #client_list so that it is destroyed after all clients.
+	 */
+	std::unique_ptr<WorkerPool> command_pool;
+
+	/**
+	 * Executes long-running commands (see
+	 * #ThreadBackgroundCommand).  Unlike #command_pool, this
+	 * always exists.
+	 */
+	std::unique_ptr<WorkerPool> background_pool;
+
 	std::unique_ptr<ClientList> client_list;
 
+	/**
+	 * Records the execution time of client commands; nullptr if
+	 * neither "slow_command_threshold" nor "command_trace_size" is
+	 * configured.
+	 */
+	std::unique_ptr<CommandTracer> command_tracer;
+
+	/**
+	 * Use AddPartition() and DeletePartition() to modify this
+	 * list, or else #partitions_by_name will be out of sync.
+	 */
 	std::list<Partition> partitions;
 
+	/**
+	 * Maps #Partition::name to elements of #partitions for
+	 * FindPartition().
+	 */
+	std::unordered_map<std::string_view, Partition *> partitions_by_name;
+
 	std::unique_ptr<StateFile> state_file;
 
+	std::unique_ptr<OutputStatsFile> output_stats_file;
+
+	/**
+	 * The Prometheus exporter; nullptr if "metrics_port" is not
+	 * configured.
+	 */
+	std::unique_ptr<MetricsServer> metrics_server;
+
 #ifdef ENABLE_SQLITE
 	std::unique_ptr<StickerDatabase> sticker_database;
 
 	std::unique_ptr<StickerCleanupService> sticker_cleanup;
 
 	bool need_sticker_cleanup = false;
+
+	/**
+	 * Analyzes songs in the background (see "analyze").  This is
+	 * nullptr if there is no sticker database, no storage, or if
+	 * "analysis_threads" is zero.
+	 */
+	std::unique_ptr<AnalysisService> analysis;
+
+	/**
+	 * A separate connection to the sticker database for
+	 * LoadStoredMixRamp(), which is called by the player threads.
+	 * It is opened on demand and protected by
+	 * #player_sticker_mutex.
+	 */
+	std::unique_ptr<StickerDatabase> player_sticker_database;
+	Mutex player_sticker_mutex;
 #endif
 
 	Instance();
@@ -168,6 +264,14 @@ struct Instance final
 	[[gnu::pure]]
 	Partition *FindPartition(const char *name) noexcept;
 
+	/**
+	 * Create a new #Partition and append it to #partitions.  The
+	 * caller is responsible for checking whether the name is
+	 * already in use.
+	 */
+	Partition &AddPartition(const char *name,
+				const PartitionConfig &config);
+
 	void DeletePartition(Partition &partition) noexcept;
 
 	void BeginShutdownPartitions() noexcept;
@@ -210,14 +314,34 @@ struct Instance final
 	void StartStickerCleanup();
 #endif
 
+	/**
+	 * Look up the MixRamp values stored for the given song by
+	 * the analysis service.  This method is thread-safe.
+	 *
+	 * @return the stored values (empty if there are none or if
+	 * there is no sticker database)
+	 */
+	MixRampInfo LoadStoredMixRamp(const char *uri) noexcept;
+
 	void BeginShutdownUpdate() noexcept;
 
 #ifdef ENABLE_CURL
 	void LookupRemoteTag(const char *uri) noexcept;
+
+	/**
+	 * Look up the tags of many songs at once (see
+	 * RemoteTagCache::Lookup()).  URIs without a scheme are
+	 * ignored.
+	 */
+	void LookupRemoteTags(std::span<const std::string> uris) noexcept;
 #else
 	void LookupRemoteTag(const char *) noexcept {
 		/* no-op */
 	}
+
+	void LookupRemoteTags(std::span<const std::string>) noexcept {
+		/* no-op */
+	}
 #endif
 
 	void FlushCaches() noexcept;
@@ -229,6 +353,10 @@ private:
 	/* virtual methods from class DatabaseListener */
 	void OnDatabaseModified() noexcept override;
 	void OnDatabaseSongRemoved(const char *uri) noexcept override;
+
+	bool IsPlaybackStarving() const noexcept override {
+		return n_starving_players.load(std::memory_order_relaxed) > 0;
+	}
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
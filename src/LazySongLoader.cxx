@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "LazySongLoader.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "SongLoader.hxx"
+#include "playlist/PlaylistSong.hxx"
+
+LazySongLoader::LazySongLoader(Partition &_partition) noexcept
+	:partition(_partition),
+	 idle_event(partition.instance.event_loop, BIND_THIS_METHOD(OnIdle))
+{
+}
+
+void
+LazySongLoader::Add(std::vector<unsigned> &&ids) noexcept
+{
+	for (const unsigned id : ids)
+		if (pending.insert(id).second)
+			queue.push_back(id);
+
+	if (!queue.empty())
+		idle_event.Schedule();
+}
+
+bool
+LazySongLoader::LoadNow(unsigned id, DetachedSong &song) noexcept
+{
+	if (pending.erase(id) == 0)
+		return false;
+
+	const Database *db = partition.instance.GetDatabase();
+	if (db == nullptr)
+		return false;
+
+	const SongLoader loader(db, partition.instance.storage);
+	return playlist_check_load_song(song, loader);
+}
+
+void
+LazySongLoader::OnIdle() noexcept
+{
+	const Database *db = partition.instance.GetDatabase();
+	if (db == nullptr) {
+		/* the database is gone; leave the songs as they are */
+		queue.clear();
+		pending.clear();
+		return;
+	}
+
+	std::vector<unsigned> batch;
+	batch.reserve(BATCH_SIZE);
+
+	while (batch.size() < BATCH_SIZE && !queue.empty()) {
+		const unsigned id = queue.front();
+		queue.pop_front();
+
+		if (pending.erase(id) > 0)
+			batch.push_back(id);
+	}
+
+	const SongLoader loader(db, partition.instance.storage);
+	partition.playlist.LoadLazySongs(partition.pc, loader, batch);
+
+	if (!queue.empty())
+		idle_event.Schedule();
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_LAZY_SONG_LOADER_HXX
+#define MPD_LAZY_SONG_LOADER_HXX
+
+#include "event/IdleEvent.hxx"
+
+#include <cstddef>
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+struct Partition;
+class DetachedSong;
+
+/**
+ * Loads the metadata of queue songs which were added without it (see
+ * playlist_load_into_queue()) from the database.  This happens in
+ * small batches whenever the #EventLoop is idle, so loading a huge
+ * playlist does not block the main thread; clients see the songs
+ * filling in through #IDLE_PLAYLIST.
+ */
+class LazySongLoader final {
+	/**
+	 * The maximum number of songs loaded in one #IdleEvent
+	 * callback.
+	 */
+	static constexpr std::size_t BATCH_SIZE = 256;
+
+	Partition &partition;
+
+	IdleEvent idle_event;
+
+	/**
+	 * The ids of the songs waiting to be loaded, in the order
+	 * they were added.
+	 */
+	std::deque<unsigned> queue;
+
+	/**
+	 * The same ids as #queue, for quick lookups.  Ids which were
+	 * loaded on demand by LoadNow() are removed from here, but not
+	 * from #queue.
+	 */
+	std::unordered_set<unsigned> pending;
+
+public:
+	explicit LazySongLoader(Partition &_partition) noexcept;
+
+	LazySongLoader(const LazySongLoader &) = delete;
+	LazySongLoader &operator=(const LazySongLoader &) = delete;
+
+	void Add(std::vector<unsigned> &&ids) noexcept;
+
+	/**
+	 * Load the given song right now (if it is still pending)
+	 * because it is about to be passed to the player.
+	 *
+	 * @return true if the song was modified
+	 */
+	bool LoadNow(unsigned id, DetachedSong &song) noexcept;
+
+private:
+	/* callback for #idle_event */
+	void OnIdle() noexcept;
+};
+
+#endif
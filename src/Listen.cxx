@@ -108,6 +108,8 @@ listen_global_init(const ConfigData &config, ClientListener &listener)
 		return;
 #endif
 
+	listener.AddThreads(config.GetUnsigned(ConfigOption::LISTEN_THREADS, 0));
+
 	for (const auto &param : config.GetParamList(ConfigOption::BIND_TO_ADDRESS)) {
 		try {
 			ServerSocketAddGeneric(listener, param.value.c_str(),
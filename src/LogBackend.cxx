@@ -9,6 +9,19 @@
 #include "Version.h"
 #include "config.h"
 
+#ifndef ANDROID
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/RingBuffer.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#endif
+
 #include <cassert>
 
 #include <stdio.h>
@@ -74,11 +87,10 @@ EnableLogTimestamp() noexcept
 }
 
 static const char *
-log_date() noexcept
+log_date(time_t t) noexcept
 {
 	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
 	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
 	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
 	return buf;
 }
@@ -145,10 +157,10 @@ LogFinishSysLog() noexcept
 #endif
 
 static void
-FileLog(const Domain &domain, std::string_view message) noexcept
+FileLog(const Domain &domain, std::string_view message, time_t t) noexcept
 {
 	fmt::print(stderr, "{}{}: {}\n",
-		   enable_timestamp ? log_date() : "",
+		   enable_timestamp ? log_date(t) : "",
 		   domain.GetName(),
 		   StripRight(message));
 
@@ -159,6 +171,262 @@ FileLog(const Domain &domain, std::string_view message) noexcept
 #endif
 }
 
+static void
+LogOutput(LogLevel level, const Domain &domain, std::string_view msg,
+	  time_t t) noexcept
+{
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		SysLog(domain, level, msg);
+		return;
+	}
+#else
+	(void)level;
+#endif
+
+	FileLog(domain, msg, t);
+}
+
+/**
+ * Writes log messages in a separate thread, so threads which log
+ * (e.g. the output thread in verbose mode) never block on file or
+ * syslog I/O.  Messages are copied into a ring buffer; if it is
+ * full, they are dropped.
+ */
+class LogThread {
+	struct RecordHeader {
+		const Domain *domain;
+		time_t time;
+		uint32_t length;
+		LogLevel level;
+	};
+
+	static constexpr std::size_t BUFFER_SIZE = 256 * 1024;
+
+	/**
+	 * Longer messages are truncated.
+	 */
+	static constexpr std::size_t MAX_MESSAGE = 4096;
+
+	/**
+	 * The maximum number of messages per domain and second;
+	 * excess messages are suppressed.
+	 */
+	static constexpr unsigned RATE_LIMIT = 200;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	/**
+	 * Serializes the producers, because #buffer supports only
+	 * one of them.  It is held only while copying a message,
+	 * never during I/O.  The consumer needs it only to wait for
+	 * #cond.
+	 */
+	Mutex mutex;
+	Cond cond;
+
+	RingBuffer<std::byte> buffer;
+
+	/**
+	 * The number of messages dropped because #buffer was full.
+	 * Protected by #mutex.
+	 */
+	std::size_t n_dropped = 0;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	bool running = false, quit = false;
+
+	struct DomainRate {
+		time_t second = 0;
+		unsigned count = 0, suppressed = 0;
+	};
+
+	/**
+	 * Only used by the log thread.
+	 */
+	std::unordered_map<const Domain *, DomainRate> rates;
+
+public:
+	void Start() {
+		buffer = RingBuffer<std::byte>{BUFFER_SIZE};
+		thread.Start();
+
+		const std::scoped_lock lock{mutex};
+		running = true;
+	}
+
+	/**
+	 * Stop the thread after all pending messages have been
+	 * written.
+	 */
+	void Stop() noexcept {
+		{
+			const std::scoped_lock lock{mutex};
+			if (!running)
+				return;
+
+			running = false;
+			quit = true;
+			cond.notify_one();
+		}
+
+		thread.Join();
+	}
+
+	/**
+	 * @return false if the thread is not running; the caller
+	 * shall write the message synchronously
+	 */
+	bool Push(LogLevel level, const Domain &domain,
+		  std::string_view msg) noexcept;
+
+private:
+	void Run() noexcept;
+
+	/**
+	 * Write all pending messages.
+	 */
+	void Drain() noexcept;
+
+	static void ReportSuppressed(const Domain &domain,
+				     const DomainRate &rate) noexcept;
+
+	bool IsRateLimited(const RecordHeader &header) noexcept;
+};
+
+bool
+LogThread::Push(LogLevel level, const Domain &domain,
+		std::string_view msg) noexcept
+{
+	msg = StripRight(msg);
+	if (msg.size() > MAX_MESSAGE)
+		msg = msg.substr(0, MAX_MESSAGE);
+
+	/* assemble the record first, so the consumer never sees a
+	   partial one */
+	const RecordHeader header{
+		&domain,
+		enable_timestamp ? time(nullptr) : time_t{},
+		uint32_t(msg.size()),
+		level,
+	};
+
+	std::byte record[sizeof(header) + MAX_MESSAGE];
+	std::copy_n((const std::byte *)&header, sizeof(header), record);
+	std::copy_n((const std::byte *)msg.data(), msg.size(),
+		    record + sizeof(header));
+	const std::span<const std::byte> src{record, sizeof(header) + msg.size()};
+
+	const std::scoped_lock lock{mutex};
+	if (!running)
+		return false;
+
+	if (buffer.WriteAvailable() < src.size())
+		++n_dropped;
+	else {
+		buffer.WriteFrom(src);
+		cond.notify_one();
+	}
+
+	return true;
+}
+
+void
+LogThread::ReportSuppressed(const Domain &domain, const DomainRate &rate) noexcept
+{
+	if (rate.suppressed > 0)
+		LogOutput(LogLevel::WARNING, domain,
+			  fmt::format("{} messages suppressed",
+				      rate.suppressed),
+			  time(nullptr));
+}
+
+inline bool
+LogThread::IsRateLimited(const RecordHeader &header) noexcept
+{
+	const time_t now = time(nullptr);
+
+	auto &rate = rates[header.domain];
+	if (rate.second != now) {
+		ReportSuppressed(*header.domain, rate);
+		rate = {now, 0, 0};
+	}
+
+	if (++rate.count <= RATE_LIMIT)
+		return false;
+
+	++rate.suppressed;
+	return true;
+}
+
+inline void
+LogThread::Drain() noexcept
+{
+	while (buffer.ReadAvailable() > 0) {
+		RecordHeader header;
+		buffer.ReadTo(std::as_writable_bytes(std::span{&header, 1}));
+
+		char message[MAX_MESSAGE];
+		buffer.ReadTo(std::as_writable_bytes(std::span{message, header.length}));
+
+		if (!IsRateLimited(header))
+			LogOutput(header.level, *header.domain,
+				  {message, header.length}, header.time);
+	}
+}
+
+void
+LogThread::Run() noexcept
+{
+	SetThreadName("log");
+
+	static constexpr Domain log_domain("log");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		if (buffer.ReadAvailable() == 0) {
+			if (quit)
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		const std::size_t dropped = std::exchange(n_dropped, 0);
+
+		lock.unlock();
+
+		if (dropped > 0)
+			LogOutput(LogLevel::WARNING, log_domain,
+				  fmt::format("{} messages dropped", dropped),
+				  time(nullptr));
+
+		Drain();
+
+		lock.lock();
+	}
+
+	for (const auto &[domain, rate] : rates)
+		ReportSuppressed(*domain, rate);
+}
+
+static LogThread log_thread;
+
+void
+StartLogThread()
+{
+	log_thread.Start();
+}
+
+void
+StopLogThread() noexcept
+{
+	log_thread.Stop();
+}
+
 #endif /* !ANDROID */
 
 void
@@ -181,13 +449,7 @@ Log(LogLevel level, const Domain &domain, std::string_view msg) noexcept
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
-		return;
-	}
-#endif
-
-	FileLog(domain, msg);
+	if (!log_thread.Push(level, domain, msg))
+		LogOutput(level, domain, msg, time(nullptr));
 #endif /* !ANDROID */
 }
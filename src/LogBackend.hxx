@@ -18,4 +18,20 @@ LogInitSysLog() noexcept;
 void
 LogFinishSysLog() noexcept;
 
+/**
+ * Start a thread which writes log messages asynchronously.  Until
+ * then (and after StopLogThread()), messages are written by the
+ * calling thread.
+ *
+ * Throws on error.
+ */
+void
+StartLogThread();
+
+/**
+ * Write all pending log messages and stop the log thread.
+ */
+void
+StopLogThread() noexcept;
+
 #endif /* LOG_H */
@@ -8,20 +8,27 @@
 #include "PlaylistFile.hxx"
 #include "MusicChunk.hxx"
 #include "StateFile.hxx"
+#include "OutputStatsFile.hxx"
+#include "metrics/Server.hxx"
+#include "command/Trace.hxx"
+#include "config/Net.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
 #include "client/Config.hxx"
 #include "client/List.hxx"
+#include "client/Listener.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/Config.hxx"
 #include "protocol/IdleFlags.hxx"
 #include "Log.hxx"
 #include "LogInit.hxx"
+#include "LogBackend.hxx"
 #include "input/Init.hxx"
 #include "input/cache/Config.hxx"
 #include "input/cache/Manager.hxx"
+#include "PictureCache.hxx"
 #include "event/Loop.hxx"
 #include "event/Call.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -31,7 +38,11 @@
 #include "decoder/DecoderList.hxx"
 #include "pcm/Convert.hxx"
 #include "unix/SignalHandlers.hxx"
+#include "thread/Name.hxx"
 #include "thread/Slack.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Util.hxx"
+#include "thread/WorkerPool.hxx"
 #include "net/Init.hxx"
 #include "lib/icu/Init.hxx"
 #include "config/Check.hxx"
@@ -43,7 +54,10 @@
 #include "config/Domain.hxx"
 #include "config/Parser.hxx"
 #include "config/PartitionConfig.hxx"
+#include "config/ThreadConfig.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/StringAPI.hxx"
 
 #ifdef ENABLE_DAEMON
 #include "unix/Daemon.hxx"
@@ -51,22 +65,36 @@
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
+#include "db/Interface.hxx"
 #include "db/Configured.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "storage/Configured.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "storage/ListingCache.hxx"
 #ifdef ENABLE_INOTIFY
 #include "db/update/InotifyUpdate.hxx"
 #endif
+#ifdef ENABLE_FANOTIFY
+#include "db/update/FanotifyUpdate.hxx"
+#endif
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 #include "neighbor/Glue.hxx"
 #endif
 
+#ifdef ENABLE_CURL
+#include "RemoteTagCache.hxx"
+#endif
+
 #ifdef ENABLE_SQLITE
 #include "sticker/Database.hxx"
+#include "sticker/Cache.hxx"
+#include "analysis/Service.hxx"
+#include "util/SplitString.hxx"
+
+#include <set>
 #endif
 
 #ifdef ENABLE_ARCHIVE
@@ -93,11 +121,16 @@
 #endif
 
 #include <climits>
+#include <optional>
 
 #ifndef ANDROID
 #include <clocale>
 #endif
 
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
 #ifdef ANDROID
 Context *context;
 LogListener *logListener;
@@ -163,18 +196,19 @@ InitStorage(Instance &instance, EventLoop &event_loop,
 }
 
 /**
- * Returns the database.  If this function returns false, this has not
- * succeeded, and the caller should create the database after the
- * process has been daemonized.
+ * Create the configured database (and the storage it needs), but do
+ * not open it yet; see #DatabaseOpenThread.
+ *
+ * @return the database or nullptr if no database shall be used
  */
-static bool
-glue_db_init_and_load(Instance &instance, const ConfigData &config)
+static DatabasePtr
+glue_db_init(Instance &instance, const ConfigData &config)
 {
 	auto db = CreateConfiguredDatabase(config, instance.event_loop,
 					   instance.io_thread.GetEventLoop(),
 					   instance);
 	if (!db)
-		return true;
+		return nullptr;
 
 	if (db->GetPlugin().RequireStorage()) {
 		InitStorage(instance, instance.io_thread.GetEventLoop(),
@@ -184,7 +218,7 @@ glue_db_init_and_load(Instance &instance, const ConfigData &config)
 			LogNotice(config_domain,
 				  "Found database setting without "
 				  "music_directory - disabling database");
-			return true;
+			return nullptr;
 		}
 	} else {
 		if (IsStorageConfigured(config))
@@ -193,12 +227,88 @@ glue_db_init_and_load(Instance &instance, const ConfigData &config)
 				  "because the database does not need it");
 	}
 
-	try {
-		db->Open();
-	} catch (...) {
-		std::throw_with_nested(std::runtime_error("Failed to open database plugin"));
+	return db;
+}
+
+/**
+ * Opens the database in a separate thread, so loading a large
+ * database file does not delay the initialization of the plugins,
+ * the outputs and everything else which does not need the database.
+ */
+class DatabaseOpenThread {
+	Database &db;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	std::exception_ptr error;
+
+public:
+	explicit DatabaseOpenThread(Database &_db)
+		:db(_db)
+	{
+		thread.Start();
 	}
 
+	~DatabaseOpenThread() noexcept {
+		if (thread.IsDefined()) {
+			/* initialization has failed; clean up */
+			thread.Join();
+			if (!error)
+				db.Close();
+		}
+	}
+
+	DatabaseOpenThread(const DatabaseOpenThread &) = delete;
+	DatabaseOpenThread &operator=(const DatabaseOpenThread &) = delete;
+
+	/**
+	 * Wait until the database has been opened.
+	 *
+	 * Throws on error.
+	 */
+	void Wait() {
+		thread.Join();
+
+		if (error) {
+			try {
+				std::rethrow_exception(error);
+			} catch (...) {
+				std::throw_with_nested(std::runtime_error("Failed to open database plugin"));
+			}
+		}
+	}
+
+private:
+	void Run() noexcept {
+		SetThreadName("db_open");
+
+#ifndef _WIN32
+		/* all signals shall be handled by the main thread's
+		   SignalMonitor, which is set up while this thread
+		   is running */
+		sigset_t mask;
+		sigfillset(&mask);
+		pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+#endif
+
+		try {
+			db.Open();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+};
+
+/**
+ * Install the opened database in the #Instance.
+ *
+ * @return false if the database file does not exist yet and the
+ * caller should create it
+ */
+static bool
+glue_db_load(Instance &instance, const ConfigData &config,
+	     DatabasePtr &&db)
+{
 	instance.database = std::move(db);
 
 	auto *sdb = dynamic_cast<SimpleDatabase *>(instance.database.get());
@@ -214,13 +324,6 @@ glue_db_init_and_load(Instance &instance, const ConfigData &config)
 	return sdb->FileExists();
 }
 
-static bool
-InitDatabaseAndStorage(Instance &instance, const ConfigData &config)
-{
-	const bool create_db = !glue_db_init_and_load(instance, config);
-	return create_db;
-}
-
 #endif
 
 #ifdef ENABLE_SQLITE
@@ -235,7 +338,19 @@ LoadStickerDatabase(const ConfigData &config)
 	if (sticker_file.IsNull())
 		return nullptr;
 
-	return std::make_unique<StickerDatabase>(std::move(sticker_file));
+	auto db = std::make_unique<StickerDatabase>(std::move(sticker_file));
+
+	if (const char *s = config.GetString(ConfigOption::STICKER_CACHE)) {
+		std::set<std::string, std::less<>> names;
+		for (const auto name : SplitString(s, ','))
+			if (!name.empty())
+				names.emplace(name);
+
+		if (!names.empty())
+			db->EnableCache(std::make_shared<StickerCache>(std::move(names)));
+	}
+
+	return db;
 }
 
 #endif
@@ -253,6 +368,41 @@ glue_state_file_init(Instance &instance, const ConfigData &raw_config)
 	instance.state_file->Read();
 }
 
+static void
+glue_output_stats_file_init(Instance &instance, const ConfigData &raw_config)
+{
+	auto path = raw_config.GetPath(ConfigOption::OUTPUT_STATS_FILE);
+	if (path.IsNull())
+		return;
+
+	const auto interval =
+		raw_config.GetDuration(ConfigOption::OUTPUT_STATS_INTERVAL,
+				       std::chrono::seconds{1},
+				       std::chrono::seconds{10});
+
+	instance.output_stats_file =
+		std::make_unique<OutputStatsFile>(instance.event_loop,
+						  std::move(path), interval,
+						  instance.partitions);
+	instance.output_stats_file->Start();
+}
+
+static void
+glue_metrics_init(Instance &instance, const ConfigData &raw_config)
+{
+	const unsigned port =
+		raw_config.GetUnsigned(ConfigOption::METRICS_PORT, 0);
+	if (port == 0)
+		return;
+
+	instance.metrics_server =
+		std::make_unique<MetricsServer>(instance.event_loop, instance);
+	ServerSocketAddGeneric(*instance.metrics_server,
+			       raw_config.GetString(ConfigOption::METRICS_BIND_TO_ADDRESS),
+			       port);
+	instance.metrics_server->Open();
+}
+
 /**
  * Initialize the decoder and player core, including the music pipe.
  */
@@ -261,10 +411,7 @@ initialize_decoder_and_player(Instance &instance,
 			      const ConfigData &config,
 			      const PartitionConfig &partition_config)
 {
-	instance.partitions.emplace_back(instance,
-					 "default",
-					 partition_config);
-	auto &partition = instance.partitions.back();
+	auto &partition = instance.AddPartition("default", partition_config);
 
 	partition.replay_gain_mode = config.With(ConfigOption::REPLAYGAIN, [](const char *s){
 		return s != nullptr
@@ -280,6 +427,9 @@ Instance::BeginShutdownUpdate() noexcept
 #ifdef ENABLE_INOTIFY
 	inotify_update.reset();
 #endif
+#ifdef ENABLE_FANOTIFY
+	fanotify_update.reset();
+#endif
 
 	if (update != nullptr)
 		update->CancelAllAsync();
@@ -326,6 +476,14 @@ MainConfigured(const CommandLineOptions &options,
 
 	log_init(raw_config, options.verbose, options.log_stderr);
 
+	thread_config_global_init(raw_config);
+
+	/* all threads inherit the CPU affinity of the main thread,
+	   including those created by libraries */
+	if (const auto &s = GetThreadScheduling("default");
+	    !s.cpu_affinity.empty())
+		SetThreadAffinity(s.cpu_affinity);
+
 	Instance instance;
 	global_instance = &instance;
 
@@ -343,16 +501,59 @@ MainConfigured(const CommandLineOptions &options,
 		raw_config.GetPositive(ConfigOption::MAX_CONN, 100);
 	instance.client_list = std::make_unique<ClientList>(max_clients);
 
+	const std::chrono::steady_clock::duration slow_command_threshold =
+		std::chrono::milliseconds{raw_config.GetUnsigned(ConfigOption::SLOW_COMMAND_THRESHOLD, 0)};
+	const unsigned command_trace_size =
+		raw_config.GetUnsigned(ConfigOption::COMMAND_TRACE_SIZE, 0);
+	if (slow_command_threshold > std::chrono::steady_clock::duration::zero() ||
+	    command_trace_size > 0)
+		instance.command_tracer =
+			std::make_unique<CommandTracer>(slow_command_threshold,
+							command_trace_size);
+
 	const auto *input_cache_config = raw_config.GetBlock(ConfigBlockOption::INPUT_CACHE);
 	if (input_cache_config != nullptr) {
 		const InputCacheConfig c(*input_cache_config);
 		instance.input_cache = std::make_unique<InputCacheManager>(c);
 	}
 
+#ifdef ENABLE_CURL
+	/* without this block, the cache is created on demand by
+	   Instance::LookupRemoteTag() */
+	const auto *remote_tag_cache_config =
+		raw_config.GetBlock(ConfigBlockOption::REMOTE_TAG_CACHE);
+	if (remote_tag_cache_config != nullptr) {
+		const RemoteTagCacheConfig c(*remote_tag_cache_config);
+		instance.remote_tag_cache =
+			std::make_unique<RemoteTagCache>(instance.event_loop,
+							 instance, c);
+	}
+#endif
+
+	const std::size_t picture_cache_size =
+		raw_config.With(ConfigOption::PICTURE_CACHE_SIZE, [](const char *s){
+			return s != nullptr
+				? ParseSize(s)
+				: PictureCache::DEFAULT_SIZE;
+		});
+	if (picture_cache_size > 0)
+		instance.picture_cache = std::make_unique<PictureCache>(picture_cache_size);
+
+#ifdef ENABLE_DATABASE
+	const auto storage_cache_ttl =
+		raw_config.GetDuration(ConfigOption::STORAGE_CACHE_TTL,
+				       std::chrono::seconds{0},
+				       StorageListingCache::DEFAULT_TTL);
+	if (storage_cache_ttl > std::chrono::steady_clock::duration::zero())
+		instance.storage_listing_cache =
+			std::make_unique<StorageListingCache>(storage_cache_ttl);
+#endif
+
 	initialize_decoder_and_player(instance,
 				      raw_config, partition_config);
 
 	listen_global_init(raw_config, *instance.partitions.front().listener);
+	glue_metrics_init(instance, raw_config);
 
 #ifdef ENABLE_DAEMON
 	daemonize_set_user();
@@ -371,14 +572,18 @@ MainConfigured(const CommandLineOptions &options,
 	const ScopeArchivePluginsInit archive_plugins_init{raw_config};
 #endif
 
+#ifdef ENABLE_DATABASE
+	/* load the database while the plugins are being initialized */
+	DatabasePtr db = glue_db_init(instance, raw_config);
+	std::optional<DatabaseOpenThread> db_open_thread;
+	if (db)
+		db_open_thread.emplace(*db);
+#endif
+
 	pcm_convert_global_init(raw_config);
 
 	const ScopeDecoderPluginsInit decoder_plugins_init(raw_config);
 
-#ifdef ENABLE_DATABASE
-	const bool create_db = InitDatabaseAndStorage(instance, raw_config);
-#endif
-
 #ifdef ENABLE_SQLITE
 	instance.sticker_database = LoadStickerDatabase(raw_config);
 #endif
@@ -398,8 +603,10 @@ MainConfigured(const CommandLineOptions &options,
 		if (name == nullptr)
 			throw std::runtime_error("Missing 'name'");
 
-		instance.partitions.emplace_back(instance, name,
-						 partition_config);
+		if (instance.FindPartition(name) != nullptr)
+			throw FmtRuntimeError("Duplicate partition {:?}", name);
+
+		instance.AddPartition(name, partition_config);
 	});
 
 	client_manager_init(raw_config);
@@ -419,11 +626,64 @@ MainConfigured(const CommandLineOptions &options,
 		instance,
 		options.daemon,
 	};
+
+	/* started after the signal handlers, so the log thread
+	   inherits the signal mask */
+	StartLogThread();
+	AtScopeExit() { StopLogThread(); };
 #endif
 
+	instance.io_thread.SetScheduling(GetThreadScheduling("io"));
 	instance.io_thread.Start();
+	instance.rtio_thread.SetScheduling(GetThreadScheduling("rtio"));
 	instance.rtio_thread.Start();
 
+	instance.partitions.front().listener->StartThreads();
+
+	if (client_command_threads > 0) {
+		auto pool = std::make_unique<WorkerPool>("command");
+		pool->SetScheduling(GetThreadScheduling("command"));
+		pool->Start(client_command_threads);
+		instance.command_pool = std::move(pool);
+	}
+
+	{
+		auto pool = std::make_unique<WorkerPool>("background");
+		pool->SetScheduling(GetThreadScheduling("background"));
+		pool->Start(client_background_threads);
+		instance.background_pool = std::move(pool);
+	}
+
+#ifdef ENABLE_DATABASE
+	bool create_db = false;
+	if (db_open_thread) {
+		db_open_thread->Wait();
+		db_open_thread.reset();
+		create_db = !glue_db_load(instance, raw_config, std::move(db));
+	}
+#endif
+
+#ifdef ENABLE_SQLITE
+	if (instance.sticker_database != nullptr &&
+	    instance.storage != nullptr) {
+		const unsigned analysis_threads =
+			raw_config.GetUnsigned(ConfigOption::ANALYSIS_THREADS, 1);
+		if (analysis_threads > 0)
+			instance.analysis =
+				std::make_unique<AnalysisService>(instance,
+								  *instance.sticker_database,
+								  *instance.storage,
+								  analysis_threads,
+								  raw_config.GetUnsigned(ConfigOption::ANALYSIS_DECODE_THREADS, 0));
+	}
+
+	AtScopeExit(&instance) {
+		/* stop decoding before the decoder and input plugins
+		   are deinitialized */
+		instance.analysis.reset();
+	};
+#endif
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance.neighbors != nullptr)
 		instance.neighbors->Open();
@@ -465,12 +725,43 @@ MainConfigured(const CommandLineOptions &options,
 #endif
 
 	glue_state_file_init(instance, raw_config);
+	glue_output_stats_file_init(instance, raw_config);
 
 #ifdef ENABLE_DATABASE
 	if (raw_config.GetBool(ConfigOption::AUTO_UPDATE, false)) {
 #ifdef ENABLE_INOTIFY
+		const char *method =
+			raw_config.GetString(ConfigOption::AUTO_UPDATE_METHOD,
+					     "inotify");
+
+		if (StringIsEqual(method, "fanotify")) {
+#ifdef ENABLE_FANOTIFY
+			if (instance.storage != nullptr &&
+			    instance.update != nullptr) {
+				try {
+					instance.fanotify_update =
+						mpd_fanotify_init(instance.event_loop,
+								  *instance.storage,
+								  *instance.update);
+				} catch (...) {
+					LogError(std::current_exception(),
+						 "fanotify failed, falling back to inotify");
+				}
+			}
+#else
+			LogWarning(config_domain,
+				   "fanotify: not available, falling back to inotify");
+#endif
+		} else if (!StringIsEqual(method, "inotify"))
+			throw FmtRuntimeError("Unsupported auto_update_method: {:?}",
+					      method);
+
 		if (instance.storage != nullptr &&
-		    instance.update != nullptr) {
+		    instance.update != nullptr
+#ifdef ENABLE_FANOTIFY
+		    && instance.fanotify_update == nullptr
+#endif
+		    ) {
 			try {
 				instance.inotify_update =
 					mpd_inotify_init(instance.event_loop,
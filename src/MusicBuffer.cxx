@@ -3,19 +3,87 @@
 
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "util/Domain.hxx"
+#include "util/HugeAllocator.hxx"
+#include "Log.hxx"
 
 #include <cassert>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks)
+static constexpr Domain music_buffer_domain("music_buffer");
+
+static std::span<std::byte>
+AllocateMusicBuffer(std::size_t size, bool huge_pages,
+		    MusicBufferStats &stats)
+{
+	if (huge_pages) {
+		try {
+			auto allocation = HugeAllocateHugeTlb(size);
+			stats.huge_pages = true;
+			return allocation;
+		} catch (const std::bad_alloc &) {
+			LogWarning(music_buffer_domain,
+				   "Failed to allocate huge pages for the audio buffer");
+		}
+	}
+
+	return HugeAllocate(size);
+}
+
+MusicBuffer::MusicBuffer(unsigned num_chunks,
+			 const MusicBufferOptions &options)
+	:buffer(AllocateMusicBuffer(decltype(buffer)::GetAllocationSize(num_chunks),
+				    options.huge_pages, stats))
 {
 	buffer.SetName("MusicBuffer");
+
+	/* the capacity may be larger than requested, because huge
+	   page allocations are rounded up */
+	stats.chunks = limit = stats.limit = buffer.GetCapacity();
+	stats.size = decltype(buffer)::GetAllocationSize(stats.chunks);
+
+	/* bind first, because locking populates the pages */
+	if (options.numa_node >= 0) {
+		if (buffer.BindNumaNode(options.numa_node))
+			stats.numa_node = options.numa_node;
+		else
+			FmtWarning(music_buffer_domain,
+				   "Failed to bind the audio buffer to NUMA node {}",
+				   options.numa_node);
+	}
+
+	if (options.lock) {
+		if (buffer.Lock())
+			stats.locked = true;
+		else
+			LogWarning(music_buffer_domain,
+				   "Failed to lock the audio buffer into RAM (RLIMIT_MEMLOCK too low?)");
+	}
+}
+
+void
+MusicBuffer::SetLimit(unsigned _limit) noexcept
+{
+	assert(_limit > 0);
+	assert(_limit <= GetSize());
+
+	const std::scoped_lock protect{mutex};
+
+	if (_limit > limit)
+		++stats.grown;
+	else if (_limit < limit)
+		++stats.shrunk;
+
+	limit = stats.limit = _limit;
+	stats.adaptive = true;
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
 	const std::scoped_lock protect{mutex};
+	if (buffer.GetAllocatedCount() >= limit)
+		return {nullptr, MusicChunkDeleter(*this)};
+
 	return {buffer.Allocate(), MusicChunkDeleter(*this)};
 }
 
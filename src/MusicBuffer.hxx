@@ -4,6 +4,7 @@
 #ifndef MPD_MUSIC_BUFFER_HXX
 #define MPD_MUSIC_BUFFER_HXX
 
+#include "MusicBufferOptions.hxx"
 #include "MusicChunk.hxx"
 #include "MusicChunkPtr.hxx"
 #include "util/SliceBuffer.hxx"
@@ -16,8 +17,18 @@ class MusicBuffer {
 	/** a mutex which protects #buffer */
 	mutable Mutex mutex;
 
+	/* this is declared before #buffer because it gets modified
+	   while #buffer is being initialized */
+	MusicBufferStats stats;
+
 	SliceBuffer<MusicChunk> buffer;
 
+	/**
+	 * The number of chunks which may be allocated; see
+	 * SetLimit().  Protected by #mutex.
+	 */
+	unsigned limit;
+
 public:
 	/**
 	 * Creates a new #MusicBuffer object.
@@ -25,7 +36,13 @@ public:
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
 	 */
-	explicit MusicBuffer(unsigned num_chunks);
+	explicit MusicBuffer(unsigned num_chunks,
+			     const MusicBufferOptions &options={});
+
+	MusicBufferStats GetStats() const noexcept {
+		const std::scoped_lock protect{mutex};
+		return stats;
+	}
 
 #ifndef NDEBUG
 	/**
@@ -40,7 +57,15 @@ public:
 
 	bool IsFull() const noexcept {
 		const std::scoped_lock protect{mutex};
-		return buffer.IsFull();
+		return buffer.IsFull() || buffer.GetAllocatedCount() >= limit;
+	}
+
+	/**
+	 * Returns the number of chunks currently in use.
+	 */
+	unsigned GetAllocatedCount() const noexcept {
+		const std::scoped_lock protect{mutex};
+		return buffer.GetAllocatedCount();
 	}
 
 	/**
@@ -53,6 +78,25 @@ public:
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the number of chunks which may be allocated (see
+	 * SetLimit()).
+	 */
+	unsigned GetLimit() const noexcept {
+		const std::scoped_lock protect{mutex};
+		return limit;
+	}
+
+	/**
+	 * Change the number of chunks which may be allocated, for
+	 * an adaptive buffer.  If more chunks are currently in use,
+	 * Allocate() fails until enough have been returned.
+	 *
+	 * @param _limit the new limit; must not be larger than
+	 * GetSize()
+	 */
+	void SetLimit(unsigned _limit) noexcept;
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * How the memory of a #MusicBuffer shall be allocated.
+ */
+struct MusicBufferOptions {
+	/**
+	 * Use explicit huge pages (hugetlbfs)?  Falls back to normal
+	 * pages if none are available.
+	 */
+	bool huge_pages = false;
+
+	/**
+	 * Lock the buffer into RAM with mlock()?
+	 */
+	bool lock = false;
+
+	/**
+	 * Bind the buffer to this NUMA node; -1 means no binding.
+	 */
+	int numa_node = -1;
+};
+
+/**
+ * Information about the allocation of a #MusicBuffer, for the
+ * "stats" command.
+ */
+struct MusicBufferStats {
+	std::size_t size = 0;
+
+	unsigned chunks = 0;
+
+	/**
+	 * The number of chunks which may be used; this is less than
+	 * #chunks if the buffer is adaptive ("audio_buffer_min_size")
+	 * and has not grown to its maximum size.
+	 */
+	unsigned limit = 0;
+
+	/**
+	 * How often has the adaptive buffer grown/shrunk?
+	 */
+	unsigned grown = 0, shrunk = 0;
+
+	/**
+	 * Has MusicBuffer::SetLimit() ever been called?
+	 */
+	bool adaptive = false;
+
+	bool huge_pages = false, locked = false;
+
+	/**
+	 * The NUMA node the buffer is bound to; -1 means no binding.
+	 */
+	int numa_node = -1;
+};
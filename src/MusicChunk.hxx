@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "config.h"
 #include "MusicChunkPtr.hxx"
 #include "Chrono.hxx"
 #include "tag/ReplayGainInfo.hxx"
@@ -12,12 +13,20 @@
 #endif
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <span>
 
-static constexpr size_t CHUNK_SIZE = 4096;
+/**
+ * The size of a #MusicChunk (including its #MusicChunkInfo header)
+ * in bytes.  This can be changed with the Meson option "chunk_size";
+ * at very high sample rates, larger chunks reduce the per-chunk
+ * overhead in #MusicPipe and the audio outputs.
+ */
+static constexpr size_t CHUNK_SIZE = MUSIC_CHUNK_SIZE;
 
 struct AudioFormat;
 struct Tag;
@@ -30,6 +39,14 @@ struct MusicChunkInfo {
 	/** the next chunk in a linked list */
 	MusicChunkPtr next;
 
+	/**
+	 * A copy of #next.get() which is published by
+	 * MusicPipe::Push() with "release" ordering.  Unlike #next,
+	 * it may be read by consumers without holding the
+	 * #MusicPipe's mutex; see GetNext().
+	 */
+	std::atomic<const MusicChunk *> next_published{nullptr};
+
 	/**
 	 * An optional chunk which should be mixed into this chunk.
 	 * This is used for cross-fading.
@@ -49,7 +66,7 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -57,6 +74,12 @@ struct MusicChunkInfo {
 	/** the time stamp within the song */
 	SignedSongTime time;
 
+	/**
+	 * When did the decoder begin to fill this chunk?  This is
+	 * used to measure the end-to-end latency.
+	 */
+	std::chrono::steady_clock::time_point submit_time{};
+
 	/**
 	 * Replay gain information associated with this chunk.
 	 * Only valid if the serial is not 0.
@@ -70,6 +93,13 @@ struct MusicChunkInfo {
 	 */
 	unsigned replay_gain_serial;
 
+	/**
+	 * A number which identifies this chunk in the output
+	 * #MusicPipe.  It is assigned by MusicPipe::Push() and
+	 * increases monotonically across all pipes.
+	 */
+	uint_least64_t serial = 0;
+
 #ifndef NDEBUG
 	AudioFormat audio_format;
 #endif
@@ -84,6 +114,16 @@ struct MusicChunkInfo {
 		return length == 0 && tag == nullptr;
 	}
 
+	/**
+	 * Returns the next chunk in the #MusicPipe (or nullptr if
+	 * this is the tail).  This may be called from any thread
+	 * without locking.
+	 */
+	[[gnu::pure]]
+	const MusicChunk *GetNext() const noexcept {
+		return next_published.load(std::memory_order_acquire);
+	}
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the
@@ -4,16 +4,20 @@
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
 
+#include <atomic>
 #include <cassert>
 
+/**
+ * The source for MusicChunk::serial.
+ */
+static std::atomic_uint_least64_t next_chunk_serial{1};
+
 #ifndef NDEBUG
 
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 {
-	const std::scoped_lock protect{mutex};
-
-	for (const MusicChunk *i = head.get(); i != nullptr; i = i->next.get())
+	for (const MusicChunk *i = Peek(); i != nullptr; i = i->GetNext())
 		if (i == chunk)
 			return true;
 
@@ -32,20 +36,21 @@ MusicPipe::Shift() noexcept
 		assert(!chunk->IsEmpty());
 
 		head = std::move(chunk->next);
-		--size;
+		head_published.store(head.get(), std::memory_order_release);
+		const unsigned old_size = size.fetch_sub(1, std::memory_order_release);
 
 		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+			assert(old_size == 1);
+			assert(tail == chunk.get());
 
-			tail_r = &head;
+			tail = nullptr;
 		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+			assert(old_size > 1);
+			assert(tail != chunk.get());
 		}
 
 #ifndef NDEBUG
-		if (size == 0)
+		if (old_size == 1)
 			audio_format.Clear();
 #endif
 	}
@@ -67,7 +72,7 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 
 	const std::scoped_lock protect{mutex};
 
-	assert(size > 0 || !audio_format.IsDefined());
+	assert(GetSize() > 0 || !audio_format.IsDefined());
 	assert(!audio_format.IsDefined() ||
 	       chunk->CheckFormat(audio_format));
 
@@ -77,8 +82,22 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 #endif
 
 	chunk->next.reset();
-	*tail_r = std::move(chunk);
-	tail_r = &(*tail_r)->next;
+	chunk->next_published.store(nullptr, std::memory_order_relaxed);
+	chunk->serial = next_chunk_serial.fetch_add(1, std::memory_order_relaxed);
+
+	MusicChunk *const new_tail = chunk.get();
+
+	/* link the chunk first, and then publish it with "release"
+	   ordering, so lock-free readers see its contents */
+	if (tail == nullptr) {
+		head = std::move(chunk);
+		head_published.store(new_tail, std::memory_order_release);
+	} else {
+		tail->next = std::move(chunk);
+		tail->next_published.store(new_tail, std::memory_order_release);
+	}
+
+	tail = new_tail;
 
-	++size;
+	size.fetch_add(1, std::memory_order_release);
 }
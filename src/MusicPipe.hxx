@@ -7,6 +7,8 @@
 #include "MusicChunkPtr.hxx"
 #include "thread/Mutex.hxx"
 
+#include <atomic>
+
 #ifndef NDEBUG
 #include "pcm/AudioFormat.hxx"
 #endif
@@ -14,19 +16,30 @@
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * Readers (Peek(), GetSize(), MusicChunk::GetNext()) do not lock;
+ * they only see chunks which have been published with "release"
+ * ordering by Push().  Only Push() and Shift(), which modify the
+ * owning #MusicChunkPtr links, are serialized with a mutex.
  */
 class MusicPipe {
 	/** the first chunk */
 	MusicChunkPtr head;
 
-	/** a pointer to the tail of the chunk */
-	MusicChunkPtr *tail_r = &head;
+	/** the last chunk; nullptr if the pipe is empty */
+	MusicChunk *tail = nullptr;
+
+	/**
+	 * A copy of #head.get() which may be read without holding
+	 * the mutex.
+	 */
+	std::atomic<const MusicChunk *> head_published{nullptr};
 
 	/** the current number of chunks */
-	unsigned size = 0;
+	std::atomic_uint size{0};
 
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	/** a mutex which protects #head and #tail */
+	Mutex mutex;
 
 #ifndef NDEBUG
 	AudioFormat audio_format = AudioFormat::Undefined();
@@ -61,8 +74,7 @@ public:
 	 */
 	[[gnu::pure]]
 	const MusicChunk *Peek() const noexcept {
-		const std::scoped_lock protect{mutex};
-		return head.get();
+		return head_published.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -85,8 +97,7 @@ public:
 	 */
 	[[gnu::pure]]
 	unsigned GetSize() const noexcept {
-		const std::scoped_lock protect{mutex};
-		return size;
+		return size.load(std::memory_order_acquire);
 	}
 
 	[[gnu::pure]]
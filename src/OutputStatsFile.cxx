@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "OutputStatsFile.hxx"
+#include "metrics/Prometheus.hxx"
+#include "io/FileOutputStream.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "Log.hxx"
+
+OutputStatsFile::OutputStatsFile(EventLoop &loop, AllocatedPath &&_path,
+				 Event::Duration _interval,
+				 const std::list<Partition> &_partitions) noexcept
+	:path(std::move(_path)), interval(_interval),
+	 timer_event(loop, BIND_THIS_METHOD(OnTimeout)),
+	 partitions(_partitions)
+{
+}
+
+inline void
+OutputStatsFile::Write(BufferedOutputStream &os)
+{
+	WriteOutputMetrics(os, partitions);
+}
+
+void
+OutputStatsFile::Write() noexcept
+try {
+	FileOutputStream fos(path);
+	BufferedOutputStream bos(fos);
+	Write(bos);
+	bos.Flush();
+	fos.Commit();
+} catch (...) {
+	LogError(std::current_exception());
+}
+
+void
+OutputStatsFile::OnTimeout() noexcept
+{
+	Write();
+	timer_event.Schedule(interval);
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_OUTPUT_STATS_FILE_HXX
+#define MPD_OUTPUT_STATS_FILE_HXX
+
+#include "fs/AllocatedPath.hxx"
+#include "event/FarTimerEvent.hxx"
+
+#include <list>
+
+struct Partition;
+class BufferedOutputStream;
+
+/**
+ * Periodically writes the #AudioOutputStats of all outputs to a file
+ * in the Prometheus text exposition format, e.g. for the
+ * "textfile" collector of the Prometheus node exporter.
+ */
+class OutputStatsFile final {
+	const AllocatedPath path;
+
+	const Event::Duration interval;
+
+	FarTimerEvent timer_event;
+
+	const std::list<Partition> &partitions;
+
+public:
+	OutputStatsFile(EventLoop &loop, AllocatedPath &&_path,
+			Event::Duration _interval,
+			const std::list<Partition> &_partitions) noexcept;
+
+	void Start() noexcept {
+		timer_event.Schedule(interval);
+	}
+
+	void Write() noexcept;
+
+private:
+	void Write(BufferedOutputStream &os);
+
+	/* callback for #timer_event */
+	void OnTimeout() noexcept;
+};
+
+#endif
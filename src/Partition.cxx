@@ -8,12 +8,16 @@
 #include "config/PartitionConfig.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "song/DetachedSong.hxx"
+#include "tag/MixRampInfo.hxx"
 #include "protocol/IdleFlags.hxx"
 #include "client/Listener.hxx"
 #include "client/Client.hxx"
 #include "input/cache/Manager.hxx"
+#include "LazySongLoader.hxx"
 #include "util/Domain.hxx"
 
+#include <algorithm> // for std::min()
+
 static constexpr Domain cache_domain("cache");
 
 Partition::Partition(Instance &_instance,
@@ -24,7 +28,10 @@ Partition::Partition(Instance &_instance,
 	 config(_config),
 	 listener(new ClientListener(instance.event_loop, *this)),
 	 idle_monitor(instance.event_loop, BIND_THIS_METHOD(OnIdleMonitor)),
+	 idle_coalesce_timer(instance.event_loop,
+			     BIND_THIS_METHOD(OnIdleCoalesceTimer)),
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
+	 park_timer(instance.event_loop, BIND_THIS_METHOD(OnParkTimer)),
 	 playlist(config.queue.max_length, *this),
 	 outputs(pc, *this),
 	 pc(*this, outputs,
@@ -39,6 +46,7 @@ Partition::~Partition() noexcept = default;
 void
 Partition::BeginShutdown() noexcept
 {
+	park_timer.Cancel();
 	pc.Kill();
 	listener.reset();
 }
@@ -46,13 +54,9 @@ Partition::BeginShutdown() noexcept
 static void
 PrefetchSong(InputCacheManager &cache, const char *uri) noexcept
 {
-	if (cache.Contains(uri))
-		return;
-
-	FmtDebug(cache_domain, "Prefetch {:?}", uri);
-
 	try {
-		cache.Prefetch(uri);
+		if (cache.Prefetch(uri))
+			FmtDebug(cache_domain, "Prefetch {:?}", uri);
 	} catch (...) {
 		FmtError(cache_domain,
 			 "Prefetch {:?} failed: {}",
@@ -74,11 +78,46 @@ Partition::PrefetchQueue() noexcept
 
 	auto &cache = *instance.input_cache;
 
+	const auto &queue = playlist.queue;
+	const auto max_duration = cache.GetPrefetchDuration();
+	std::chrono::steady_clock::duration duration{};
+
+	cache.BeginPrefetch();
+
 	int next = playlist.GetNextPosition();
-	if (next >= 0)
-		PrefetchSong(cache, playlist.queue.Get(next));
+	for (unsigned i = 0; next >= 0;) {
+		const auto &song = queue.Get(next);
+
+		/* each prefetch runs in its own thread, so all
+		   upcoming songs are loaded in parallel */
+		PrefetchSong(cache, song);
+
+		if (++i >= cache.GetPrefetchCount())
+			break;
+
+		if (max_duration > max_duration.zero()) {
+			/* songs with unknown duration do not
+			   count */
+			if (const auto d = song.GetDuration(); !d.IsNegative())
+				duration += std::chrono::milliseconds(d.ToMS());
+
+			if (duration >= max_duration)
+				break;
+		}
+
+		const unsigned order = queue.PositionToOrder(next);
+		const int next_order = queue.GetNextOrder(order);
+		if (next_order < 0 || unsigned(next_order) == order ||
+		    next_order == playlist.current)
+			/* end of queue, or we would wrap around to
+			   the songs we already have */
+			break;
+
+		next = queue.OrderToPosition(next_order);
+	}
 
-	// TODO: prefetch more songs
+	/* cancel prefetches which are not in the window anymore */
+	cache.EndPrefetch();
 }
 
 void
@@ -116,6 +155,18 @@ Partition::DatabaseModified(const Database &db) noexcept
 	EmitIdle(IDLE_DATABASE);
 }
 
+void
+Partition::LoadLazySongs(std::vector<unsigned> &&ids) noexcept
+{
+	if (ids.empty())
+		return;
+
+	if (!lazy_song_loader)
+		lazy_song_loader = std::make_unique<LazySongLoader>(*this);
+
+	lazy_song_loader->Add(std::move(ids));
+}
+
 #endif
 
 void
@@ -152,6 +203,9 @@ void
 Partition::OnQueueModified() noexcept
 {
 	EmitIdle(IDLE_PLAYLIST);
+
+	/* the upcoming songs may have changed */
+	PrefetchQueue();
 }
 
 void
@@ -166,6 +220,25 @@ Partition::OnQueueSongStarted() noexcept
 	EmitIdle(IDLE_PLAYER);
 }
 
+bool
+Partition::OnQueueSongNeeded([[maybe_unused]] unsigned id,
+			     [[maybe_unused]] DetachedSong &song) noexcept
+{
+#ifdef ENABLE_DATABASE
+	return lazy_song_loader && lazy_song_loader->LoadNow(id, song);
+#else
+	return false;
+#endif
+}
+
+void
+Partition::OnQueueLazySongs([[maybe_unused]] std::vector<unsigned> &&ids) noexcept
+{
+#ifdef ENABLE_DATABASE
+	LoadLazySongs(std::move(ids));
+#endif
+}
+
 void
 Partition::OnPlayerError() noexcept
 {
@@ -206,6 +279,21 @@ Partition::OnBorderPause() noexcept
 	EmitGlobalEvent(BORDER_PAUSE);
 }
 
+void
+Partition::OnPlayerStarving(bool starving) noexcept
+{
+	if (starving)
+		++instance.n_starving_players;
+	else
+		--instance.n_starving_players;
+}
+
+MixRampInfo
+Partition::LoadStoredMixRamp(const char *uri) noexcept
+{
+	return instance.LoadStoredMixRamp(uri);
+}
+
 void
 Partition::OnMixerVolumeChanged(Mixer &, int) noexcept
 {
@@ -223,7 +311,7 @@ Partition::OnMixerChanged() noexcept
 }
 
 void
-Partition::OnIdleMonitor(unsigned mask) noexcept
+Partition::BroadcastIdle(unsigned mask) noexcept
 {
 	/* send "idle" notifications to all subscribed
 	   clients */
@@ -234,6 +322,90 @@ Partition::OnIdleMonitor(unsigned mask) noexcept
 		instance.OnStateModified();
 }
 
+void
+Partition::OnIdleMonitor(unsigned mask) noexcept
+{
+	if (mask & IDLE_PLAYER)
+		SchedulePark();
+
+	const auto now = instance.event_loop.SteadyNow();
+
+	unsigned immediate = 0;
+	for (unsigned i = 0; i < IDLE_NUM_FLAGS; ++i) {
+		const unsigned flag = 1U << i;
+		if ((mask & flag) == 0)
+			continue;
+
+		const auto interval = config.idle.coalesce[i];
+		if (interval.count() == 0) {
+			immediate |= flag;
+		} else if (now < idle_deadlines[i]) {
+			/* this flag was sent recently; hold it back
+			   until the interval has elapsed */
+			idle_deferred |= flag;
+		} else {
+			immediate |= flag;
+			idle_deadlines[i] = now + interval;
+		}
+	}
+
+	if (immediate != 0)
+		BroadcastIdle(immediate);
+
+	if (idle_deferred != 0 && !idle_coalesce_timer.IsPending()) {
+		Event::TimePoint earliest = Event::TimePoint::max();
+		for (unsigned i = 0; i < IDLE_NUM_FLAGS; ++i)
+			if (idle_deferred & (1U << i))
+				earliest = std::min(earliest, idle_deadlines[i]);
+
+		idle_coalesce_timer.Schedule(earliest - now);
+	}
+}
+
+void
+Partition::SchedulePark() noexcept
+{
+	if (!playlist.playing && pc.IsThreadRunning())
+		park_timer.Schedule(PARK_DELAY);
+	else
+		park_timer.Cancel();
+}
+
+void
+Partition::OnParkTimer() noexcept
+{
+	if (!playlist.playing)
+		pc.LockPark();
+}
+
+void
+Partition::OnIdleCoalesceTimer() noexcept
+{
+	const auto now = instance.event_loop.SteadyNow();
+
+	unsigned ready = 0;
+	Event::TimePoint earliest = Event::TimePoint::max();
+	for (unsigned i = 0; i < IDLE_NUM_FLAGS; ++i) {
+		const unsigned flag = 1U << i;
+		if ((idle_deferred & flag) == 0)
+			continue;
+
+		if (now >= idle_deadlines[i]) {
+			ready |= flag;
+			idle_deadlines[i] = now + config.idle.coalesce[i];
+		} else
+			earliest = std::min(earliest, idle_deadlines[i]);
+	}
+
+	idle_deferred &= ~ready;
+
+	if (ready != 0)
+		BroadcastIdle(ready);
+
+	if (idle_deferred != 0)
+		idle_coalesce_timer.Schedule(earliest - now);
+}
+
 void
 Partition::OnGlobalEvent(unsigned mask) noexcept
 {
@@ -5,6 +5,8 @@
 #define MPD_PARTITION_HXX
 
 #include "event/MaskMonitor.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/FineTimerEvent.hxx"
 #include "queue/Playlist.hxx"
 #include "queue/Listener.hxx"
 #include "output/MultipleOutputs.hxx"
@@ -12,16 +14,20 @@
 #include "mixer/Memento.hxx"
 #include "player/Control.hxx"
 #include "player/Listener.hxx"
+#include "protocol/IdleFlags.hxx"
 #include "protocol/RangeArg.hxx"
 #include "util/IntrusiveList.hxx"
+#include "StatusCache.hxx"
 #include "ReplayGainMode.hxx"
 #include "SingleMode.hxx"
 #include "ConsumeMode.hxx"
 #include "Chrono.hxx"
 #include "config.h"
 
+#include <array>
 #include <string>
 #include <memory>
+#include <vector>
 
 struct PartitionConfig;
 struct Instance;
@@ -29,6 +35,7 @@ struct RangeArg;
 class MultipleOutputs;
 class SongLoader;
 class ClientListener;
+class LazySongLoader;
 class Client;
 struct ClientPerPartitionListHook;
 
@@ -41,6 +48,12 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	static constexpr unsigned SYNC_WITH_PLAYER = 0x2;
 	static constexpr unsigned BORDER_PAUSE = 0x4;
 
+	/**
+	 * After the player has been stopped for this duration, its
+	 * thread is terminated; see PlayerControl::LockPark().
+	 */
+	static constexpr Event::Duration PARK_DELAY = std::chrono::minutes{1};
+
 	Instance &instance;
 
 	const std::string name;
@@ -56,8 +69,31 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 */
 	MaskMonitor idle_monitor;
 
+	/**
+	 * Delivers idle flags which were held back because of the
+	 * "idle_coalesce" setting.
+	 */
+	FineTimerEvent idle_coalesce_timer;
+
+	/**
+	 * Idle flags which are waiting for #idle_coalesce_timer.
+	 */
+	unsigned idle_deferred = 0;
+
+	/**
+	 * For each idle flag with a coalescing interval: until when
+	 * further events of this flag will be held back.
+	 */
+	std::array<Event::TimePoint, IDLE_NUM_FLAGS> idle_deadlines{};
+
 	MaskMonitor global_events;
 
+	/**
+	 * Parks the player thread after playback has been stopped
+	 * for #PARK_DELAY.
+	 */
+	CoarseTimerEvent park_timer;
+
 	struct playlist playlist;
 
 	MultipleOutputs outputs;
@@ -68,6 +104,19 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
+	/**
+	 * Formatted "status" and "currentsong" responses.
+	 */
+	StatusCache status_cache;
+
+#ifdef ENABLE_DATABASE
+	/**
+	 * Loads metadata of songs which were added to the queue
+	 * without it.  Created on demand by LoadLazySongs().
+	 */
+	std::unique_ptr<LazySongLoader> lazy_song_loader;
+#endif
+
 	Partition(Instance &_instance,
 		  const char *_name,
 		  const PartitionConfig &_config) noexcept;
@@ -86,6 +135,9 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 * This method can be called from any thread.
 	 */
 	void EmitIdle(unsigned mask) noexcept {
+		if (mask & StatusCache::IDLE_MASK)
+			status_cache.Invalidate();
+
 		idle_monitor.OrMask(mask);
 	}
 
@@ -230,6 +282,13 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 * all subsystems.
 	 */
 	void DatabaseModified(const Database &db) noexcept;
+
+	/**
+	 * Load the metadata of the given queue songs (which were
+	 * added by playlist_load_into_queue() in lazy mode) in the
+	 * background.
+	 */
+	void LoadLazySongs(std::vector<unsigned> &&ids) noexcept;
 #endif
 
 	/**
@@ -260,6 +319,9 @@ private:
 	void OnQueueModified() noexcept override;
 	void OnQueueOptionsChanged() noexcept override;
 	void OnQueueSongStarted() noexcept override;
+	bool OnQueueSongNeeded(unsigned id,
+			       DetachedSong &song) noexcept override;
+	void OnQueueLazySongs(std::vector<unsigned> &&ids) noexcept override;
 
 	/* virtual methods from class PlayerListener */
 	void OnPlayerError() noexcept override;
@@ -268,16 +330,35 @@ private:
 	void OnPlayerTagModified() noexcept override;
 	void OnBorderPause() noexcept override;
 	void OnPlayerOptionsChanged() noexcept override;
+	void OnPlayerStarving(bool starving) noexcept override;
+	MixRampInfo LoadStoredMixRamp(const char *uri) noexcept override;
 
 	/* virtual methods from class MixerListener */
 	void OnMixerVolumeChanged(Mixer &mixer, int volume) noexcept override;
 	void OnMixerChanged() noexcept override;
 
+	/**
+	 * Send idle flags to all clients of this partition.
+	 */
+	void BroadcastIdle(unsigned mask) noexcept;
+
 	/* callback for #idle_monitor */
 	void OnIdleMonitor(unsigned mask) noexcept;
 
+	/* callback for #idle_coalesce_timer */
+	void OnIdleCoalesceTimer() noexcept;
+
 	/* callback for #global_events */
 	void OnGlobalEvent(unsigned mask) noexcept;
+
+	/**
+	 * Schedule #park_timer if the player thread is running but
+	 * not playing.
+	 */
+	void SchedulePark() noexcept;
+
+	/* callback for #park_timer */
+	void OnParkTimer() noexcept;
 };
 
 #endif
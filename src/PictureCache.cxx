@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PictureCache.hxx"
+
+#include <cassert>
+
+PictureCache::~PictureCache() noexcept
+{
+	Flush();
+}
+
+void
+PictureCache::Remove(Item &item) noexcept
+{
+	size -= item.GetSize();
+	lru.erase(lru.iterator_to(item));
+
+	/* this frees the item */
+	map.erase(map.find(item.key));
+}
+
+CachedPicturePtr
+PictureCache::Get(std::string_view key,
+		  std::chrono::system_clock::time_point mtime) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	auto i = map.find(key);
+	if (i == map.end())
+		return nullptr;
+
+	auto &item = *i->second;
+	if (mtime != std::chrono::system_clock::time_point::min()
+	    ? item.mtime != mtime
+	    : std::chrono::steady_clock::now() >= item.expires) {
+		/* stale */
+		Remove(item);
+		return nullptr;
+	}
+
+	/* mark as "most recently used" */
+	lru.erase(lru.iterator_to(item));
+	lru.push_back(item);
+
+	return item.picture;
+}
+
+void
+PictureCache::Put(std::string_view key,
+		  std::chrono::system_clock::time_point mtime,
+		  CachedPicturePtr picture) noexcept
+{
+	assert(picture);
+
+	auto item = std::make_unique<Item>(key, std::move(picture), mtime,
+					   std::chrono::steady_clock::now() + TTL);
+	const std::size_t item_size = item->GetSize();
+	if (item_size > max_size)
+		return;
+
+	const std::scoped_lock lock{mutex};
+
+	if (auto i = map.find(key); i != map.end())
+		Remove(*i->second);
+
+	while (size + item_size > max_size && !lru.empty())
+		Remove(lru.front());
+
+	size += item_size;
+	lru.push_back(*item);
+
+	const std::string_view item_key = item->key;
+	map.emplace(item_key, std::move(item));
+}
+
+void
+PictureCache::Flush() noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	lru.clear();
+	map.clear();
+	size = 0;
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PICTURE_CACHE_HXX
+#define MPD_PICTURE_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * A picture extracted by "albumart" or "readpicture".
+ */
+struct CachedPicture {
+	/**
+	 * The MIME type; empty if unknown.
+	 */
+	std::string mime_type;
+
+	AllocatedArray<std::byte> data;
+
+	/**
+	 * False if there is no picture (a negative cache entry).
+	 */
+	bool exists;
+};
+
+using CachedPicturePtr = std::shared_ptr<const CachedPicture>;
+
+/**
+ * An in-memory LRU cache for the pictures served by "albumart" and
+ * "readpicture".  Clients fetch pictures in chunks (one command per
+ * chunk), and a cover grid asks for hundreds of them, so without a
+ * cache each chunk would open the storage file (maybe on a network
+ * share) or scan the song's tags again.
+ *
+ * Entries are keyed by an arbitrary string (URI) and the
+ * modification time of the source, if known.  Entries without a
+ * known modification time expire after a while.
+ *
+ * This class is thread-safe, because these commands run in worker
+ * threads.
+ */
+class PictureCache {
+	struct Item : IntrusiveListHook<> {
+		const std::string key;
+
+		const CachedPicturePtr picture;
+
+		/**
+		 * The modification time of the source file;
+		 * time_point::min() if unknown.
+		 */
+		const std::chrono::system_clock::time_point mtime;
+
+		const std::chrono::steady_clock::time_point expires;
+
+		Item(std::string_view _key, CachedPicturePtr &&_picture,
+		     std::chrono::system_clock::time_point _mtime,
+		     std::chrono::steady_clock::time_point _expires) noexcept
+			:key(_key), picture(std::move(_picture)),
+			 mtime(_mtime), expires(_expires) {}
+
+		std::size_t GetSize() const noexcept {
+			return key.size() + picture->mime_type.size() +
+				picture->data.size() + sizeof(*this);
+		}
+	};
+
+	/**
+	 * How long are entries without a modification time valid?
+	 */
+	static constexpr std::chrono::steady_clock::duration TTL =
+		std::chrono::minutes{5};
+
+	const std::size_t max_size;
+
+	mutable Mutex mutex;
+
+	std::map<std::string_view, std::unique_ptr<Item>, std::less<>> map;
+
+	/**
+	 * All items, the least recently used first.
+	 */
+	IntrusiveList<Item> lru;
+
+	std::size_t size = 0;
+
+public:
+	static constexpr std::size_t DEFAULT_SIZE = 16 * 1024 * 1024;
+
+	explicit PictureCache(std::size_t _max_size) noexcept
+		:max_size(_max_size) {}
+
+	~PictureCache() noexcept;
+
+	PictureCache(const PictureCache &) = delete;
+	PictureCache &operator=(const PictureCache &) = delete;
+
+	/**
+	 * Pictures larger than this are not cached.
+	 */
+	std::size_t GetMaxPictureSize() const noexcept {
+		return max_size / 8;
+	}
+
+	/**
+	 * Returns the total size of all cached pictures (for
+	 * statistics).
+	 */
+	std::size_t GetSize() const noexcept {
+		const std::scoped_lock lock{mutex};
+		return size;
+	}
+
+	/**
+	 * Look up a picture.
+	 *
+	 * @param mtime the current modification time of the source;
+	 * time_point::min() if unknown
+	 * @return the picture or nullptr if it is not in the cache
+	 */
+	CachedPicturePtr Get(std::string_view key,
+			     std::chrono::system_clock::time_point mtime) noexcept;
+
+	/**
+	 * Add a picture to the cache, replacing an existing entry.
+	 */
+	void Put(std::string_view key,
+		 std::chrono::system_clock::time_point mtime,
+		 CachedPicturePtr picture) noexcept;
+
+	/**
+	 * Remove all entries, e.g. after the music directory was
+	 * modified.
+	 */
+	void Flush() noexcept;
+
+private:
+	void Remove(Item &item) noexcept;
+};
+
+#endif
@@ -12,6 +12,7 @@
 #include "Mapper.hxx"
 #include "protocol/RangeArg.hxx"
 #include "io/FileLineReader.hxx"
+#include "io/FileReader.hxx"
 #include "io/FileOutputStream.hxx"
 #include "io/BufferedOutputStream.hxx"
 #include "config/Data.hxx"
@@ -28,11 +29,18 @@
 #include "util/StringCompare.hxx"
 #include "util/UriExtract.hxx"
 
+#include <algorithm> // for std::find_if()
 #include <cassert>
 #include <cstring>
+#include <list>
 
 static const char PLAYLIST_COMMENT = '#';
 
+/**
+ * The maximum number of parsed playlists in #playlist_cache.
+ */
+static constexpr std::size_t PLAYLIST_CACHE_SIZE = 4;
+
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
@@ -236,26 +244,131 @@ try {
 	throw;
 }
 
-static PlaylistFileContents
-MaybeLoadPlaylistFile(Path path_fs, PlaylistFileEditor::LoadMode load_mode)
-try {
-	if (load_mode == PlaylistFileEditor::LoadMode::NO)
-		return {};
+static std::optional<PlaylistFileVersion>
+GetPlaylistFileVersion(Path path_fs) noexcept
+{
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi) || !fi.IsRegular())
+		return std::nullopt;
+
+	return PlaylistFileVersion{
+		fi.GetModificationTime(),
+		fi.GetSize(),
+#ifndef _WIN32
+		fi.GetDevice(),
+		fi.GetInode(),
+#endif
+	};
+}
 
-	return LoadPlaylistFile(path_fs);
-} catch (const PlaylistError &error) {
-	if (error.GetCode() == PlaylistResult::NO_SUCH_LIST &&
-	    load_mode == PlaylistFileEditor::LoadMode::TRY)
-		return {};
+struct CachedPlaylistFile {
+	AllocatedPath path;
+	PlaylistFileVersion version;
+	PlaylistFileContents contents;
+};
+
+/**
+ * Recently edited playlists, the most recently used one first.  Each
+ * entry is owned by at most one #PlaylistFileEditor at a time: the
+ * editor takes it out of the list and puts it back when it is
+ * destroyed.
+ */
+static std::list<CachedPlaylistFile> playlist_cache;
+
+static auto
+FindCachedPlaylistFile(const AllocatedPath &path_fs) noexcept
+{
+	return std::find_if(playlist_cache.begin(), playlist_cache.end(),
+			    [&path_fs](const auto &i){
+				    return i.path == path_fs;
+			    });
+}
 
-	throw;
- }
+/**
+ * Remove the given playlist from the cache and return its contents if
+ * they are still up to date.
+ */
+static std::optional<PlaylistFileContents>
+TakeCachedPlaylistFile(const AllocatedPath &path_fs,
+		       const PlaylistFileVersion &version) noexcept
+{
+	const auto i = FindCachedPlaylistFile(path_fs);
+	if (i == playlist_cache.end())
+		return std::nullopt;
+
+	std::optional<PlaylistFileContents> result;
+	if (i->version == version)
+		result.emplace(std::move(i->contents));
+
+	playlist_cache.erase(i);
+	return result;
+}
+
+static void
+InvalidateCachedPlaylistFile(const AllocatedPath &path_fs) noexcept
+{
+	if (const auto i = FindCachedPlaylistFile(path_fs);
+	    i != playlist_cache.end())
+		playlist_cache.erase(i);
+}
+
+static void
+PutCachedPlaylistFile(const AllocatedPath &path_fs,
+		      const PlaylistFileVersion &version,
+		      PlaylistFileContents &&contents) noexcept
+try {
+	InvalidateCachedPlaylistFile(path_fs);
+
+	playlist_cache.push_front({
+		path_fs,
+		version,
+		std::move(contents),
+	});
+
+	if (playlist_cache.size() > PLAYLIST_CACHE_SIZE)
+		playlist_cache.pop_back();
+} catch (...) {
+	/* out of memory - never mind, this is just a cache */
+}
 
 PlaylistFileEditor::PlaylistFileEditor(const char *name_utf8,
 				       LoadMode load_mode)
-	:path(spl_map_to_fs(name_utf8)),
-	 contents(MaybeLoadPlaylistFile(path, load_mode))
+	:path(spl_map_to_fs(name_utf8))
 {
+	if (load_mode != LoadMode::NO)
+		Load(load_mode);
+}
+
+PlaylistFileEditor::~PlaylistFileEditor() noexcept
+{
+	if (version && !dirty)
+		PutCachedPlaylistFile(path, *version, std::move(contents));
+}
+
+inline void
+PlaylistFileEditor::Load(LoadMode load_mode)
+{
+	assert(load_mode != LoadMode::NO);
+	assert(contents.empty());
+	assert(!version);
+
+	/* obtain the version before loading; if the file gets
+	   modified meanwhile, the version will not match next time
+	   and the file will be loaded again */
+	version = GetPlaylistFileVersion(path);
+	if (!version) {
+		if (load_mode == LoadMode::TRY)
+			return;
+
+		throw PlaylistError::NoSuchList();
+	}
+
+	if (auto cached = TakeCachedPlaylistFile(path, *version))
+		contents = std::move(*cached);
+	else
+		contents = LoadPlaylistFile(path);
+
+	loaded_size = contents.size();
 }
 
 void
@@ -268,6 +381,10 @@ PlaylistFileEditor::Insert(std::size_t i, const char *uri)
 		throw PlaylistError(PlaylistResult::TOO_LARGE,
 				    "Stored playlist is too large");
 
+	if (i < size())
+		rewrite = true;
+
+	dirty = true;
 	contents.emplace(std::next(contents.begin(), i), uri);
 }
 
@@ -314,6 +431,8 @@ PlaylistFileEditor::MoveIndex(RangeArg src, unsigned dest)
 	if (src.end > contents.size() || dest > contents.size() - src.Count())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
+	rewrite = dirty = true;
+
 	auto tmp = CutRange(contents, src);
 	InsertRange(contents, std::next(contents.begin(), dest), std::move(tmp));
 }
@@ -324,6 +443,7 @@ PlaylistFileEditor::RemoveIndex(unsigned i)
 	if (i >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
+	rewrite = dirty = true;
 	contents.erase(std::next(contents.begin(), i));
 }
 
@@ -333,14 +453,65 @@ PlaylistFileEditor::RemoveRange(RangeArg range)
 	if (!range.CheckClip(size()))
 		throw PlaylistError::BadRange();
 
+	rewrite = dirty = true;
 	contents.erase(std::next(contents.begin(), range.start),
 		       std::next(contents.begin(), range.end));
 }
 
+/**
+ * Does the given (non-empty) file end with a newline character?
+ */
+static bool
+EndsWithNewline(Path path_fs, uint_least64_t size)
+{
+	assert(size > 0);
+
+	FileReader reader{path_fs};
+	reader.Seek(size - 1);
+
+	std::byte last;
+	return reader.Read({&last, 1}) == 1 && last == std::byte{'\n'};
+}
+
+inline bool
+PlaylistFileEditor::SaveAppend()
+{
+	assert(version);
+	assert(!rewrite);
+	assert(loaded_size <= contents.size());
+
+	/* the file must still be the one we loaded */
+	if (GetPlaylistFileVersion(path) != version)
+		return false;
+
+	FileOutputStream fos(path, FileOutputStream::Mode::APPEND_EXISTING);
+	BufferedOutputStream bos(fos);
+
+	if (version->size > 0 && !EndsWithNewline(path, version->size))
+		bos.Write('\n');
+
+	for (std::size_t i = loaded_size; i < contents.size(); ++i)
+		playlist_print_uri(bos, contents[i].c_str());
+
+	bos.Flush();
+	fos.Commit();
+	return true;
+}
+
 void
 PlaylistFileEditor::Save()
 {
-	SavePlaylistFile(path, contents);
+	/* if saving fails, the contents must not be returned to the
+	   cache */
+	dirty = true;
+
+	if (rewrite || !version || !SaveAppend())
+		SavePlaylistFile(path, contents);
+
+	version = GetPlaylistFileVersion(path);
+	loaded_size = contents.size();
+	rewrite = dirty = false;
+
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -369,6 +540,8 @@ spl_delete(const char *name_utf8)
 	const auto path_fs = spl_map_to_fs(name_utf8);
 	assert(!path_fs.IsNull());
 
+	InvalidateCachedPlaylistFile(path_fs);
+
 	try {
 		RemoveFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -444,5 +617,6 @@ spl_rename(const char *utf8from, const char *utf8to)
 	const auto to_path_fs = spl_map_to_fs(utf8to);
 	assert(!to_path_fs.IsNull());
 
+	InvalidateCachedPlaylistFile(from_path_fs);
 	spl_rename_internal(from_path_fs, to_path_fs);
 }
@@ -6,9 +6,16 @@
 
 #include "fs/AllocatedPath.hxx"
 
+#include <chrono>
+#include <cstdint>
+#include <optional>
 #include <vector>
 #include <string>
 
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
 struct ConfigData;
 struct RangeArg;
 class DetachedSong;
@@ -19,11 +26,67 @@ typedef std::vector<std::string> PlaylistFileContents;
 
 extern bool playlist_saveAbsolutePaths;
 
+/**
+ * Identifies one version of a playlist file.  This is used to decide
+ * whether cached #PlaylistFileContents are still up to date.
+ */
+struct PlaylistFileVersion {
+	std::chrono::system_clock::time_point mtime;
+	uint_least64_t size;
+
+#ifndef _WIN32
+	/**
+	 * The modification time has only a resolution of one
+	 * second, but FileOutputStream replaces the file on each
+	 * rewrite, therefore the inode number detects modifications
+	 * within the same second.
+	 */
+	dev_t device;
+	ino_t inode;
+#endif
+
+	bool operator==(const PlaylistFileVersion &) const noexcept = default;
+};
+
+/**
+ * Loads a stored playlist, edits it in memory and writes it back.
+ *
+ * Parsed playlists are kept in a small LRU cache (main thread only),
+ * therefore a series of edits on the same playlist doesn't need to
+ * load and parse the file each time.  If only songs were appended,
+ * Save() appends them to the file instead of rewriting it.
+ */
 class PlaylistFileEditor {
 	const AllocatedPath path;
 
 	PlaylistFileContents contents;
 
+	/**
+	 * The version of the file which #contents were loaded from
+	 * or saved to; std::nullopt if the file did not exist or was
+	 * not loaded.
+	 */
+	std::optional<PlaylistFileVersion> version;
+
+	/**
+	 * The number of items which were loaded from the file.  If
+	 * #rewrite is false, only items after this position have been
+	 * added.
+	 */
+	std::size_t loaded_size = 0;
+
+	/**
+	 * Was the playlist modified other than by appending items?
+	 * Then Save() must rewrite the whole file.
+	 */
+	bool rewrite = false;
+
+	/**
+	 * Have #contents been modified since they were loaded or
+	 * saved?  Then they must not be returned to the cache.
+	 */
+	bool dirty = false;
+
 public:
 	enum class LoadMode {
 		NO,
@@ -36,6 +99,14 @@ public:
 	 */
 	explicit PlaylistFileEditor(const char *name_utf8, LoadMode load_mode);
 
+	/**
+	 * Returns the (unmodified or saved) contents to the cache.
+	 */
+	~PlaylistFileEditor() noexcept;
+
+	PlaylistFileEditor(const PlaylistFileEditor &) = delete;
+	PlaylistFileEditor &operator=(const PlaylistFileEditor &) = delete;
+
 	auto size() const noexcept {
 		return contents.size();
 	}
@@ -50,7 +121,15 @@ public:
 	void Save();
 
 private:
-	void Load();
+	void Load(LoadMode load_mode);
+
+	/**
+	 * Append the items after #loaded_size to the file.
+	 *
+	 * @return false if the file has been modified by somebody
+	 * else and needs to be rewritten
+	 */
+	bool SaveAppend();
 };
 
 /**
@@ -20,7 +20,8 @@ playlist_print_uris(Response &r, const playlist &playlist)
 }
 
 void
-playlist_print_info(Response &r, const playlist &playlist, RangeArg range)
+playlist_print_info(Response &r, const playlist &playlist, RangeArg range,
+		    WorkerPool *pool)
 {
 	const Queue &queue = playlist.queue;
 
@@ -30,7 +31,7 @@ playlist_print_info(Response &r, const playlist &playlist, RangeArg range)
 	if (range.IsEmpty())
 		return;
 
-	queue_print_info(r, queue, range.start, range.end);
+	queue_print_info(r, queue, range.start, range.end, pool);
 }
 
 void
@@ -90,3 +91,10 @@ playlist_print_changes_position(Response &r,
 	queue_print_changes_position(r, playlist.queue, version,
 				     range.start, range.end);
 }
+
+bool
+playlist_print_edits(Response &r, const playlist &playlist,
+		     uint32_t version)
+{
+	return queue_print_edits(r, playlist.queue, version);
+}
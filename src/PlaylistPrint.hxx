@@ -10,6 +10,7 @@ struct playlist;
 struct RangeArg;
 struct QueueSelection;
 class Response;
+class WorkerPool;
 
 /**
  * Sends the whole playlist to the client, song URIs only.
@@ -24,9 +25,13 @@ playlist_print_uris(Response &r, const playlist &playlist);
  * This function however fails when the start offset is invalid.
  *
  * Throws #PlaylistError if the range is invalid.
+ *
+ * @param pool an optional #WorkerPool for formatting large ranges
+ * in parallel (see queue_print_info())
  */
 void
-playlist_print_info(Response &r, const playlist &playlist, RangeArg range);
+playlist_print_info(Response &r, const playlist &playlist, RangeArg range,
+		    WorkerPool *pool=nullptr);
 
 /**
  * Sends the song with the specified id to the client.
@@ -68,4 +73,15 @@ playlist_print_changes_position(Response &r,
 				uint32_t version,
 				RangeArg range);
 
+/**
+ * Print the structural modifications since the specified playlist
+ * version.
+ *
+ * @return false if that version is too old (the client needs to
+ * reload the whole playlist)
+ */
+bool
+playlist_print_edits(Response &r, const playlist &playlist,
+		     uint32_t version);
+
 #endif
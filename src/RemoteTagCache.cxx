@@ -3,75 +3,277 @@
 
 #include "RemoteTagCache.hxx"
 #include "RemoteTagCacheHandler.hxx"
+#include "TagSave.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 #include "input/ScanTags.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FileLineReader.hxx"
+#include "io/FileOutputStream.hxx"
+#include "fs/FileSystem.hxx"
+#include "tag/Builder.hxx"
+#include "tag/ParseName.hxx"
+#include "util/CNumberParser.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/Domain.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringStrip.hxx"
 #include "Log.hxx"
 
+#include <cassert>
+#include <cstring>
+
+#include <stdlib.h>
+
+#define ITEM_BEGIN "remote_tag: "
+#define ITEM_EXPIRES "expires"
+#define ITEM_END "remote_tag_end"
+
 static constexpr Domain remote_tag_cache_domain("remote_tag_cache");
 
 RemoteTagCache::RemoteTagCache(EventLoop &event_loop,
-			       RemoteTagCacheHandler &_handler) noexcept
-	:handler(_handler),
+			       RemoteTagCacheHandler &_handler,
+			       const RemoteTagCacheConfig &_config) noexcept
+	:handler(_handler), config(_config),
 	 defer_invoke_handler(event_loop, BIND_THIS_METHOD(InvokeHandlers))
 {
+	if (!config.path.IsNull()) {
+		try {
+			Load();
+		} catch (...) {
+			FmtError(remote_tag_cache_domain,
+				 "Failed to load {:?}: {}",
+				 config.path, std::current_exception());
+		}
+	}
 }
 
 RemoteTagCache::~RemoteTagCache() noexcept
 {
+	if (!config.path.IsNull()) {
+		try {
+			Save();
+		} catch (...) {
+			FmtError(remote_tag_cache_domain,
+				 "Failed to save {:?}: {}",
+				 config.path, std::current_exception());
+		}
+	}
+
 	map.clear_and_dispose(DeleteDisposer());
 }
 
+inline void
+RemoteTagCache::Load(LineReader &file)
+{
+	const auto now = std::chrono::system_clock::now();
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		const char *uri_p = StringAfterPrefix(line, ITEM_BEGIN);
+		if (uri_p == nullptr)
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+
+		std::string uri{uri_p};
+		TagBuilder tag;
+		auto expires = std::chrono::system_clock::time_point::min();
+
+		while ((line = file.ReadLine()) != nullptr &&
+		       !StringIsEqual(line, ITEM_END)) {
+			char *colon = std::strchr(line, ':');
+			if (colon == nullptr || colon == line)
+				throw FmtRuntimeError("Malformed line: {:?}",
+						      line);
+
+			*colon++ = 0;
+			const char *value = StripLeft(colon);
+
+			TagType type;
+			if ((type = tag_name_parse(line)) != TAG_NUM_OF_ITEM_TYPES)
+				tag.AddItemUnchecked(type, value);
+			else if (StringIsEqual(line, "Time"))
+				tag.SetDuration(SignedSongTime::FromS(ParseDouble(value)));
+			else if (StringIsEqual(line, ITEM_EXPIRES))
+				expires = std::chrono::system_clock::from_time_t(strtoll(value, nullptr, 10));
+			else
+				throw FmtRuntimeError("Unknown line: {:?}",
+						      line);
+		}
+
+		if (expires <= now)
+			/* expired while MPD was not running */
+			continue;
+
+		auto [hint, inserted] = map.insert_check(uri);
+		if (!inserted)
+			continue;
+
+		auto *item = new Item(*this, std::move(uri));
+		item->tag = tag.Commit();
+		item->expires = expires;
+		item->state = Item::State::IDLE;
+		map.insert_commit(hint, *item);
+		idle_list.push_back(*item);
+	}
+}
+
+void
+RemoteTagCache::Load()
+{
+	if (!FileExists(config.path))
+		return;
+
+	FileLineReader file{config.path};
+
+	const std::scoped_lock lock{mutex};
+	Load(file);
+}
+
+inline void
+RemoteTagCache::Save(BufferedOutputStream &os) const noexcept
+{
+	/* oldest first, so the eviction order is restored by
+	   Load() */
+	for (const auto &item : idle_list) {
+		if (!item.tag.IsDefined())
+			/* failed or boring; try again after the
+			   restart */
+			continue;
+
+		os.Fmt(FMT_STRING(ITEM_BEGIN "{}\n"), item.uri);
+		os.Fmt(FMT_STRING(ITEM_EXPIRES ": {}\n"),
+		       std::chrono::system_clock::to_time_t(item.expires));
+		tag_save(os, item.tag);
+		os.Write(ITEM_END "\n");
+	}
+}
+
+void
+RemoteTagCache::Save()
+{
+	FileOutputStream fos(config.path);
+	BufferedOutputStream bos(fos);
+
+	{
+		const std::scoped_lock lock{mutex};
+		Save(bos);
+	}
+
+	bos.Flush();
+	fos.Commit();
+}
+
 void
 RemoteTagCache::Lookup(const std::string &uri) noexcept
 {
 	std::unique_lock lock{mutex};
+	Enqueue(uri);
+	StartPending(lock);
+}
+
+void
+RemoteTagCache::Lookup(std::span<const std::string> uris) noexcept
+{
+	std::unique_lock lock{mutex};
+
+	for (const auto &uri : uris)
+		Enqueue(uri);
 
+	StartPending(lock);
+}
+
+void
+RemoteTagCache::Enqueue(const std::string &uri) noexcept
+{
 	auto [tag, value] = map.insert_check(uri);
 	if (value) {
 		auto item = new Item(*this, uri);
 		map.insert_commit(tag, *item);
-		waiting_list.push_back(*item);
-		lock.unlock();
+		item->state = Item::State::PENDING;
+		pending_list.push_back(*item);
+		return;
+	}
 
-		try {
-			item->scanner = InputScanTags(uri.c_str(), *item);
-			if (!item->scanner) {
-				/* unsupported */
-				lock.lock();
-				ItemResolved(*item);
-				return;
-			}
-
-			item->scanner->Start();
-		} catch (...) {
-			FmtError(remote_tag_cache_domain,
-				 "Failed to scan tags of {:?}: {}",
-				 uri, std::current_exception());
+	switch (tag->state) {
+	case Item::State::PENDING:
+	case Item::State::WAITING:
+		/* already scanning this one - no-op */
+		break;
 
-			item->scanner.reset();
+	case Item::State::INVOKE:
+		/* the handler is about to be invoked anyway */
+		break;
 
-			lock.lock();
-			ItemResolved(*item);
-			return;
+	case Item::State::IDLE:
+		idle_list.erase(idle_list.iterator_to(*tag));
+
+		if (tag->expires <= std::chrono::system_clock::now()) {
+			/* expired: scan again */
+			tag->state = Item::State::PENDING;
+			pending_list.push_back(*tag);
+		} else {
+			/* already finished: re-invoke the handler */
+			tag->state = Item::State::INVOKE;
+			invoke_list.push_back(*tag);
+			ScheduleInvokeHandlers();
 		}
-	} else if (tag->scanner) {
-		/* already scanning this one - no-op */
-	} else {
-		/* already finished: re-invoke the handler */
 
-		idle_list.erase(waiting_list.iterator_to(*tag));
-		invoke_list.push_back(*tag);
+		break;
+	}
+}
+
+bool
+RemoteTagCache::StartScanner(Item &item) noexcept
+{
+	try {
+		item.scanner = InputScanTags(item.uri.c_str(), item);
+		if (!item.scanner)
+			/* unsupported */
+			return false;
+
+		item.scanner->Start();
+		return true;
+	} catch (...) {
+		FmtError(remote_tag_cache_domain,
+			 "Failed to scan tags of {:?}: {}",
+			 item.uri, std::current_exception());
+
+		item.scanner.reset();
+		return false;
+	}
+}
+
+void
+RemoteTagCache::StartPending(std::unique_lock<Mutex> &lock) noexcept
+{
+	while (n_waiting < config.max_lookups && !pending_list.empty()) {
+		auto &item = pending_list.pop_front();
+		item.state = Item::State::WAITING;
+		waiting_list.push_back(item);
+		++n_waiting;
+
+		lock.unlock();
+		const bool started = StartScanner(item);
+		lock.lock();
 
-		ScheduleInvokeHandlers();
+		if (!started)
+			ItemResolved(item);
 	}
 }
 
 void
 RemoteTagCache::ItemResolved(Item &item) noexcept
 {
+	assert(item.state == Item::State::WAITING);
+	assert(n_waiting > 0);
+
 	waiting_list.erase(waiting_list.iterator_to(item));
+	--n_waiting;
+
+	item.expires = std::chrono::system_clock::now() + config.ttl;
+	item.state = Item::State::INVOKE;
 	invoke_list.push_back(item);
 
 	ScheduleInvokeHandlers();
@@ -80,16 +282,20 @@ RemoteTagCache::ItemResolved(Item &item) noexcept
 void
 RemoteTagCache::InvokeHandlers() noexcept
 {
-	const std::scoped_lock lock{mutex};
+	std::unique_lock lock{mutex};
 
 	while (!invoke_list.empty()) {
 		auto &item = invoke_list.pop_front();
+		item.state = Item::State::IDLE;
 		idle_list.push_back(item);
 
 		const ScopeUnlock unlock(mutex);
 		handler.OnRemoteTag(item.uri.c_str(), item.tag);
 	}
 
+	/* some scanners have finished: start the next ones */
+	StartPending(lock);
+
 	/* evict items if there are too many */
 	while (map.size() > MAX_SIZE && !idle_list.empty()) {
 		auto *item = &idle_list.pop_front();
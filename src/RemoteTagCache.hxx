@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "RemoteTagCacheConfig.hxx"
 #include "input/RemoteTagScanner.hxx"
 #include "tag/Tag.hxx"
 #include "event/InjectEvent.hxx"
@@ -11,21 +12,33 @@
 #include "util/IntrusiveHashSet.hxx"
 
 #include <array>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <utility>
 
 class RemoteTagCacheHandler;
+class BufferedOutputStream;
+class LineReader;
 
 /**
  * A cache for tags received via #RemoteTagScanner.
+ *
+ * At most RemoteTagCacheConfig::max_lookups scanners run at a time;
+ * more lookups are queued.  If a path is configured, the cache is
+ * saved on shutdown and loaded again on startup.
  */
 class RemoteTagCache final {
 	static constexpr size_t MAX_SIZE = 4096;
 
 	RemoteTagCacheHandler &handler;
 
+	const RemoteTagCacheConfig config;
+
 	InjectEvent defer_invoke_handler;
 
 	Mutex mutex;
@@ -43,6 +56,22 @@ class RemoteTagCache final {
 
 		Tag tag;
 
+		/**
+		 * When shall this item be looked up again?  Only
+		 * valid in #State::IDLE and #State::INVOKE.
+		 */
+		std::chrono::system_clock::time_point expires;
+
+		/**
+		 * Which list is this item in?
+		 */
+		enum class State : uint_least8_t {
+			PENDING,
+			WAITING,
+			INVOKE,
+			IDLE,
+		} state;
+
 		template<typename U>
 		Item(RemoteTagCache &_parent, U &&_uri) noexcept
 			:parent(_parent), uri(std::forward<U>(_uri)) {}
@@ -69,6 +98,12 @@ class RemoteTagCache final {
 	 */
 	ItemList idle_list;
 
+	/**
+	 * These items are waiting for a free #RemoteTagScanner slot
+	 * (see RemoteTagCacheConfig::max_lookups).
+	 */
+	ItemList pending_list;
+
 	/**
 	 * A #RemoteTagScanner instances is currently busy on fetching
 	 * information, and we're waiting for our #RemoteTagHandler
@@ -83,6 +118,11 @@ class RemoteTagCache final {
 	 */
 	ItemList invoke_list;
 
+	/**
+	 * The number of items in #waiting_list.
+	 */
+	unsigned n_waiting = 0;
+
 	IntrusiveHashSet<
 		Item, 127,
 		IntrusiveHashSetOperators<Item, Item::GetUri,
@@ -92,13 +132,52 @@ class RemoteTagCache final {
 		IntrusiveHashSetOptions{.constant_time_size = true}> map;
 
 public:
+	/**
+	 * Loads the cache file (if one is configured); errors are
+	 * logged.
+	 */
 	RemoteTagCache(EventLoop &event_loop,
-		       RemoteTagCacheHandler &_handler) noexcept;
+		       RemoteTagCacheHandler &_handler,
+		       const RemoteTagCacheConfig &_config) noexcept;
+
+	/**
+	 * Saves the cache file (if one is configured); errors are
+	 * logged.
+	 */
 	~RemoteTagCache() noexcept;
 
 	void Lookup(const std::string &uri) noexcept;
 
+	/**
+	 * Look up many URIs at once, e.g. after adding a playlist to
+	 * the queue.  They are scanned in parallel, up to
+	 * RemoteTagCacheConfig::max_lookups at a time.
+	 */
+	void Lookup(std::span<const std::string> uris) noexcept;
+
+	/**
+	 * Returns the number of cached (or pending) URIs (for
+	 * statistics).
+	 */
+	std::size_t GetSize() noexcept {
+		const std::scoped_lock lock{mutex};
+		return map.size();
+	}
+
 private:
+	/**
+	 * Add the URI to the #pending_list unless it is already
+	 * known and has not expired.  Caller must lock the mutex.
+	 */
+	void Enqueue(const std::string &uri) noexcept;
+
+	/**
+	 * Start scanners for pending items until
+	 * RemoteTagCacheConfig::max_lookups is reached.  The mutex
+	 * is unlocked while starting each scanner.
+	 */
+	void StartPending(std::unique_lock<Mutex> &lock) noexcept;
+
 	void InvokeHandlers() noexcept;
 
 	void ScheduleInvokeHandlers() noexcept {
@@ -106,4 +185,15 @@ private:
 	}
 
 	void ItemResolved(Item &item) noexcept;
+
+	void Load();
+	void Load(LineReader &file);
+
+	/**
+	 * @return false if no scanner was started (the item needs
+	 * to be passed to ItemResolved())
+	 */
+	static bool StartScanner(Item &item) noexcept;
+	void Save();
+	void Save(BufferedOutputStream &os) const noexcept;
 };
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "RemoteTagCacheConfig.hxx"
+#include "config/Block.hxx"
+
+RemoteTagCacheConfig::RemoteTagCacheConfig(const ConfigBlock &block)
+	:path(block.GetPath("path"))
+{
+	using std::chrono::duration_cast;
+
+	ttl = duration_cast<std::chrono::system_clock::duration>(
+		block.GetDuration("ttl", std::chrono::seconds(1),
+				  duration_cast<std::chrono::steady_clock::duration>(ttl)));
+
+	max_lookups = block.GetPositiveValue("max_lookups", max_lookups);
+}
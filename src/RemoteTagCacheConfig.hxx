@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_REMOTE_TAG_CACHE_CONFIG_HXX
+#define MPD_REMOTE_TAG_CACHE_CONFIG_HXX
+
+#include "fs/AllocatedPath.hxx"
+
+#include <chrono>
+
+struct ConfigBlock;
+
+struct RemoteTagCacheConfig {
+	/**
+	 * The file where the cache is saved on shutdown and loaded
+	 * from on startup; nullptr if the cache is not persistent.
+	 */
+	AllocatedPath path = nullptr;
+
+	/**
+	 * How long shall a cached tag be used before it is looked up
+	 * again?
+	 */
+	std::chrono::system_clock::duration ttl = std::chrono::hours(24 * 7);
+
+	/**
+	 * The maximum number of concurrent #RemoteTagScanner
+	 * lookups.  More lookups are queued.
+	 */
+	unsigned max_lookups = 8;
+
+	RemoteTagCacheConfig() noexcept = default;
+
+	explicit RemoteTagCacheConfig(const ConfigBlock &block);
+};
+
+#endif
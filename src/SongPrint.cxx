@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "SongPrint.hxx"
+#include "BinarySongPrint.hxx"
 #include "song/LightSong.hxx"
 #include "song/DetachedSong.hxx"
 #include "TimePrint.hxx"
@@ -70,6 +71,13 @@ PrintRange(Response &r, SongTime start_time, SongTime end_time) noexcept
 void
 song_print_info(Response &r, const LightSong &song, bool base) noexcept
 {
+	if (r.WantBinarySongs()) {
+		BinarySongWriter w(r);
+		w.AddSong(song, base);
+		w.Commit();
+		return;
+	}
+
 	song_print_uri(r, song, base);
 
 	PrintRange(r, song.start_time, song.end_time);
@@ -96,6 +104,13 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 void
 song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
 {
+	if (r.WantBinarySongs()) {
+		BinarySongWriter w(r);
+		w.AddSong(song, base);
+		w.Commit();
+		return;
+	}
+
 	song_print_uri(r, song, base);
 
 	PrintRange(r, song.GetStartTime(), song.GetEndTime());
@@ -12,9 +12,11 @@
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "SongLoader.hxx"
+#include "config/PartitionConfig.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <chrono>
 #include <exception>
 
 static constexpr Domain state_file_domain("state_file");
@@ -23,7 +25,11 @@ StateFile::StateFile(StateFileConfig &&_config,
 		     Partition &_partition, EventLoop &_loop)
 	:config(std::move(_config)), path_utf8(config.path.ToUTF8()),
 	 timer_event(_loop, BIND_THIS_METHOD(OnTimeout)),
-	 partition(_partition)
+	 partition(_partition),
+	 /* seed the generation with the wall clock, so it never
+	    repeats the generation of a previous MPD run */
+	 queue_generation(std::chrono::duration_cast<std::chrono::seconds>(
+				  std::chrono::system_clock::now().time_since_epoch()).count())
 {
 }
 
@@ -62,7 +68,11 @@ StateFile::Write(BufferedOutputStream &os)
 	storage_state_save(os, partition.instance);
 #endif
 
-	playlist_state_save(os, partition.playlist, partition.pc);
+	if (config.queue_path.IsNull())
+		playlist_state_save(os, partition.playlist, partition.pc);
+	else
+		playlist_state_save(os, partition.playlist, partition.pc,
+				    queue_generation);
 }
 
 inline void
@@ -73,12 +83,48 @@ StateFile::Write(OutputStream &os)
 	bos.Flush();
 }
 
+inline void
+StateFile::WriteQueue()
+{
+	const auto &queue = partition.playlist.queue;
+	if (queue.version == prev_queue_version)
+		return;
+
+	FmtDebug(state_file_domain, "Saving queue file {}",
+		 config.queue_path.ToUTF8());
+
+	const unsigned generation = queue_generation + 1;
+
+	FileOutputStream fos(config.queue_path);
+	BufferedOutputStream bos(fos);
+	playlist_state_save_queue(bos, partition.playlist, generation);
+	bos.Flush();
+	fos.Commit();
+
+	/* the state file refers to the new queue file only after it
+	   has been committed */
+	queue_generation = generation;
+	prev_queue_version = queue.version;
+}
+
 void
 StateFile::Write()
 {
 	FmtDebug(state_file_domain,
 		 "Saving state file {}", path_utf8);
 
+	/* the queue file is written first; if MPD gets killed
+	   before the state file is committed, the old state file
+	   refers to the old generation, and the mismatch is
+	   detected while loading */
+	if (!config.queue_path.IsNull()) {
+		try {
+			WriteQueue();
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+
 	try {
 		FileOutputStream fos(config.path);
 		Write(fos);
@@ -102,8 +148,15 @@ try {
 #ifdef ENABLE_DATABASE
 	const SongLoader song_loader(partition.instance.GetDatabase(),
 				     partition.instance.storage);
+
+	/* with "lazy_playlist_load", database songs are restored
+	   without their metadata, which is then loaded in the
+	   background */
+	const bool lazy_load = partition.config.queue.lazy_load &&
+		partition.instance.GetDatabase() != nullptr;
 #else
 	const SongLoader song_loader(nullptr, nullptr);
+	constexpr bool lazy_load = false;
 #endif
 
 	const char *line;
@@ -112,7 +165,8 @@ try {
 			audio_output_state_read(line, partition.outputs) ||
 			playlist_state_restore(config, line, file, song_loader,
 					       partition.playlist,
-					       partition.pc);
+					       partition.pc,
+					       lazy_load);
 #ifdef ENABLE_DATABASE
 		success = success || storage_state_restore(line, file, partition.instance);
 #endif
@@ -10,6 +10,8 @@
 
 #include <string>
 
+#include <stdint.h>
+
 struct Partition;
 class OutputStream;
 class BufferedOutputStream;
@@ -34,6 +36,19 @@ class StateFile final {
 	unsigned prev_storage_version = 0;
 #endif
 
+	/**
+	 * The queue version which was last written to
+	 * StateFileConfig::queue_path.  Zero means the queue file
+	 * has not been written yet.
+	 */
+	uint32_t prev_queue_version = 0;
+
+	/**
+	 * The generation number of the queue file, which links the
+	 * state file with the queue file it was written with.
+	 */
+	unsigned queue_generation;
+
 public:
 	StateFile(StateFileConfig &&_config,
 		  Partition &partition, EventLoop &loop);
@@ -50,6 +65,12 @@ private:
 	void Write(OutputStream &os);
 	void Write(BufferedOutputStream &os);
 
+	/**
+	 * Write the queue file if the queue was modified since the
+	 * last call.
+	 */
+	void WriteQueue();
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
@@ -10,6 +10,7 @@
 
 StateFileConfig::StateFileConfig(const ConfigData &config)
 	:path(config.GetPath(ConfigOption::STATE_FILE)),
+	 queue_path(config.GetPath(ConfigOption::STATE_FILE_QUEUE)),
 	 interval(config.GetDuration(ConfigOption::STATE_FILE_INTERVAL,
 				     std::chrono::seconds{1},
 				     DEFAULT_INTERVAL)),
@@ -14,6 +14,12 @@ struct StateFileConfig {
 
 	AllocatedPath path;
 
+	/**
+	 * If set, then the queue is saved in this separate file,
+	 * which is only rewritten when the queue gets modified.
+	 */
+	AllocatedPath queue_path;
+
 	Event::Duration interval;
 
 	bool restore_paused;
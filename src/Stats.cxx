@@ -10,6 +10,27 @@
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "db/DatabaseLock.hxx"
+#include "input/cache/Manager.hxx"
+#include "client/Client.hxx"
+#include "client/List.hxx"
+#include "tag/Pool.hxx"
+#include "PictureCache.hxx"
+#include "util/HugeAllocator.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/NodePool.hxx"
+#endif
+
+#ifdef ENABLE_CURL
+#include "RemoteTagCache.hxx"
+#endif
+
+#ifdef ENABLE_SQLITE
+#include "analysis/Service.hxx"
+#endif
+#include "thread/Mutex.hxx"
 #include "Log.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/Math.hxx"
@@ -41,12 +62,29 @@ enum class StatsValidity : uint8_t {
 
 static StatsValidity stats_validity = StatsValidity::INVALID;
 
+/**
+ * Protects #stats and #stats_validity, because stats_prepare() may
+ * be called by a #WorkerBackgroundCommand.
+ */
+static Mutex stats_mutex;
+
 void
 stats_invalidate()
 {
+	const std::scoped_lock lock{stats_mutex};
 	stats_validity = StatsValidity::INVALID;
 }
 
+bool
+stats_needs_update() noexcept
+{
+	const std::scoped_lock lock{stats_mutex};
+	return stats_validity == StatsValidity::INVALID;
+}
+
+/**
+ * Caller must lock #stats_mutex.
+ */
 static bool
 stats_update(const Database &db)
 {
@@ -74,22 +112,36 @@ stats_update(const Database &db)
 	}
 }
 
+void
+stats_prepare(const Database &db) noexcept
+{
+	const std::scoped_lock lock{stats_mutex};
+	stats_update(db);
+}
+
 static void
 db_stats_print(Response &r, const Database &db)
 {
-	if (!stats_update(db))
-		return;
+	DatabaseStats s;
+
+	{
+		const std::scoped_lock lock{stats_mutex};
+		if (!stats_update(db))
+			return;
+
+		s = stats;
+	}
 
 	unsigned total_duration_s =
-		std::chrono::duration_cast<std::chrono::seconds>(stats.total_duration).count();
+		std::chrono::duration_cast<std::chrono::seconds>(s.total_duration).count();
 
 	r.Fmt(FMT_STRING("artists: {}\n"
 			 "albums: {}\n"
 			 "songs: {}\n"
 			 "db_playtime: {}\n"),
-	      stats.artist_count,
-	      stats.album_count,
-	      stats.song_count,
+	      s.artist_count,
+	      s.album_count,
+	      s.song_count,
 	      total_duration_s);
 
 	const auto update_stamp = db.GetUpdateStamp();
@@ -98,6 +150,29 @@ db_stats_print(Response &r, const Database &db)
 		      std::chrono::system_clock::to_time_t(update_stamp));
 }
 
+static constexpr auto
+ToMS(std::chrono::steady_clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+static void
+db_lock_stats_print(Response &r)
+{
+	const auto s = GetDatabaseLockStats();
+
+	r.Fmt(FMT_STRING("db_lock_exclusive: {}\n"
+			 "db_lock_exclusive_ms: {}\n"
+			 "db_lock_exclusive_max_ms: {}\n"
+			 "db_lock_shared: {}\n"
+			 "db_lock_shared_ms: {}\n"),
+	      s.exclusive_count,
+	      ToMS(s.exclusive_duration),
+	      ToMS(s.exclusive_max_duration),
+	      s.shared_count,
+	      ToMS(s.shared_duration));
+}
+
 #endif
 
 void
@@ -114,9 +189,117 @@ stats_print(Response &r, const Partition &partition)
 	      std::chrono::duration_cast<std::chrono::seconds>(uptime).count(),
 	      lround(partition.pc.GetTotalPlayTime().count()));
 
+	if (const auto b = partition.pc.LockGetBufferStats(); b.chunks > 0) {
+		r.Fmt(FMT_STRING("audio_buffer_size: {}\n"
+				 "audio_buffer_chunks: {}\n"
+				 "audio_buffer_huge_pages: {}\n"
+				 "audio_buffer_locked: {}\n"),
+		      b.size, b.chunks,
+		      unsigned(b.huge_pages), unsigned(b.locked));
+
+		if (b.numa_node >= 0)
+			r.Fmt(FMT_STRING("audio_buffer_numa_node: {}\n"),
+			      b.numa_node);
+
+		if (b.adaptive)
+			r.Fmt(FMT_STRING("audio_buffer_limit: {}\n"
+					 "audio_buffer_grown: {}\n"
+					 "audio_buffer_shrunk: {}\n"),
+			      b.limit, b.grown, b.shrunk);
+	}
+
+	if (const auto *cache = partition.instance.input_cache.get()) {
+		const auto c = cache->GetStats();
+		r.Fmt(FMT_STRING("input_cache_size: {}\n"
+				 "input_cache_max_size: {}\n"
+				 "input_cache_items: {}\n"
+				 "input_cache_hits: {}\n"
+				 "input_cache_misses: {}\n"
+				 "input_cache_evictions: {}\n"),
+		      c.size, c.max_size, c.n_items,
+		      c.hits, c.misses, c.evictions);
+
+		if (c.disk_size > 0 || c.disk_hits > 0)
+			r.Fmt(FMT_STRING("input_cache_disk_size: {}\n"
+					 "input_cache_disk_hits: {}\n"),
+			      c.disk_size, c.disk_hits);
+	}
+
+#ifdef ENABLE_SQLITE
+	if (auto *analysis = partition.instance.analysis.get()) {
+		const auto a = analysis->GetStats();
+		r.Fmt(FMT_STRING("analysis_queued: {}\n"
+				 "analysis_running: {}\n"
+				 "analysis_done: {}\n"
+				 "analysis_failed: {}\n"),
+		      a.queued, a.running, a.done, a.failed);
+	}
+#endif
+
 #ifdef ENABLE_DATABASE
 	const Database *db = partition.instance.GetDatabase();
-	if (db != nullptr)
+	if (db != nullptr) {
 		db_stats_print(r, *db);
+		db_lock_stats_print(r);
+	}
 #endif
 }
+
+void
+memstats_print(Response &r, Instance &instance)
+{
+	r.Fmt(FMT_STRING("huge_allocated_size: {}\n"),
+	      huge_allocated_size.load(std::memory_order_relaxed));
+
+	std::size_t audio_buffer_size = 0, queue_songs = 0;
+	for (const auto &partition : instance.partitions) {
+		audio_buffer_size += partition.pc.LockGetBufferStats().size;
+		queue_songs += partition.playlist.queue.GetLength();
+	}
+
+	r.Fmt(FMT_STRING("audio_buffer_size: {}\n"
+			 "queue_songs: {}\n"),
+	      audio_buffer_size, queue_songs);
+
+	if (const auto *cache = instance.input_cache.get())
+		r.Fmt(FMT_STRING("input_cache_size: {}\n"),
+		      cache->GetStats().size);
+
+	if (const auto *cache = instance.picture_cache.get())
+		r.Fmt(FMT_STRING("picture_cache_size: {}\n"),
+		      cache->GetSize());
+
+	const auto tag_pool = tag_pool_get_stats();
+	r.Fmt(FMT_STRING("tag_pool_items: {}\n"
+			 "tag_pool_size: {}\n"),
+	      tag_pool.n_items, tag_pool.size);
+
+#ifdef ENABLE_DATABASE
+	const auto songs = Song::GetPoolStats();
+	const auto directories = Directory::GetPoolStats();
+	r.Fmt(FMT_STRING("db_songs: {}\n"
+			 "db_songs_size: {}\n"
+			 "db_directories: {}\n"
+			 "db_directories_size: {}\n"),
+	      songs.n_allocated, songs.size,
+	      directories.n_allocated, directories.size);
+#endif
+
+#ifdef ENABLE_CURL
+	if (auto *cache = instance.remote_tag_cache.get())
+		r.Fmt(FMT_STRING("remote_tag_cache_items: {}\n"),
+		      cache->GetSize());
+#endif
+
+	if (instance.client_list) {
+		std::size_t n_clients = 0, output_size = 0;
+		for (const auto &client : *instance.client_list) {
+			++n_clients;
+			output_size += client.GetOutputAllocatedSize();
+		}
+
+		r.Fmt(FMT_STRING("clients: {}\n"
+				 "client_output_size: {}\n"),
+		      n_clients, output_size);
+	}
+}
@@ -5,12 +5,36 @@
 #define MPD_STATS_HXX
 
 class Response;
+struct Instance;
 struct Partition;
+class Database;
 
 void
 stats_invalidate();
 
+/**
+ * Do the cached database statistics need to be updated?  If yes,
+ * stats_print() may take a while on large databases.
+ */
+[[gnu::pure]]
+bool
+stats_needs_update() noexcept;
+
+/**
+ * Update the cached database statistics.  This may be called from
+ * any thread.
+ */
+void
+stats_prepare(const Database &db) noexcept;
+
 void
 stats_print(Response &r, const Partition &partition);
 
+/**
+ * Print the memory usage of the various subsystems (the "memstats"
+ * command).
+ */
+void
+memstats_print(Response &r, Instance &instance);
+
 #endif
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_STATUS_CACHE_HXX
+#define MPD_STATUS_CACHE_HXX
+
+#include "player/Control.hxx"
+#include "protocol/IdleFlags.hxx"
+#include "tag/Mask.hxx"
+#include "event/Chrono.hxx"
+
+#include <atomic>
+#include <string>
+
+/**
+ * Caches the formatted responses of the "status" and "currentsong"
+ * commands of one #Partition, so clients which poll them frequently
+ * do not cause repeated #PlayerControl lock acquisitions and fmt
+ * formatting.
+ *
+ * Every idle event which may affect these responses calls
+ * Invalidate(); this may happen in any thread.  All other methods
+ * and the entries may only be accessed in the main thread.
+ */
+class StatusCache {
+	/**
+	 * Incremented by Invalidate().  Cached entries remember the
+	 * generation they were built from.
+	 */
+	std::atomic_uint generation{1};
+
+public:
+	/**
+	 * The idle flags which invalidate the cache.
+	 */
+	static constexpr unsigned IDLE_MASK =
+		IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OPTIONS|
+		IDLE_OUTPUT|IDLE_UPDATE;
+
+	/**
+	 * How long may a cached "status" response be used?  This
+	 * matches the hardware volume throttling of #MixerMemento,
+	 * because a hardware volume change does not always emit
+	 * #IDLE_MIXER.
+	 */
+	static constexpr Event::Duration MAX_AGE = std::chrono::seconds{1};
+
+	struct Status {
+		/**
+		 * The generation this entry was built from; 0 means
+		 * the entry is empty.
+		 */
+		unsigned generation = 0;
+
+		Event::TimePoint expires;
+
+		/**
+		 * The player status at the time this entry was
+		 * built.  While the player is not playing, its time
+		 * fields are still valid.
+		 */
+		PlayerStatus player_status;
+
+		/**
+		 * Everything before the player time lines.
+		 */
+		std::string head;
+
+		/**
+		 * Everything after the "updating_db" line.
+		 */
+		std::string tail;
+	} status;
+
+	struct CurrentSong {
+		unsigned generation = 0;
+
+		/**
+		 * The client tag mask this response was formatted
+		 * with.
+		 */
+		TagMask tag_mask = TagMask::None();
+
+		std::string text;
+	} current_song;
+
+	/**
+	 * Discard all cached responses.  This method is thread-safe.
+	 */
+	void Invalidate() noexcept {
+		generation.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the current generation.  Call this before reading
+	 * the state to be cached, so an Invalidate() call which
+	 * happens meanwhile is not lost.
+	 */
+	unsigned GetGeneration() const noexcept {
+		return generation.load(std::memory_order_relaxed);
+	}
+
+	[[gnu::pure]]
+	bool IsValid(const Status &s, Event::TimePoint now) const noexcept {
+		return s.generation == GetGeneration() && now < s.expires;
+	}
+
+	[[gnu::pure]]
+	bool IsValid(const CurrentSong &s, TagMask tag_mask) const noexcept {
+		return s.generation == GetGeneration() &&
+			!(s.tag_mask ^ tag_mask).TestAny();
+	}
+};
+
+#endif
@@ -0,0 +1,689 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include "TagFast.hxx"
+#include "decoder/Features.h"
+#include "tag/Handler.hxx"
+#include "tag/Id3MusicBrainz.hxx"
+#include "tag/Names.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Table.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/CheckAudioFormat.hxx"
+#include "input/InputStream.hxx"
+#include "Chrono.hxx"
+
+#ifdef ENABLE_FLAC
+#include "lib/xiph/FlacAudioFormat.hxx"
+#include "lib/xiph/ScanVorbisComment.hxx"
+#endif
+
+#include <fmt/format.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * Metadata blocks (or MP4 tag items) larger than this are not
+ * loaded; files containing them are left to the decoder plugins.
+ */
+static constexpr std::size_t MAX_METADATA_SIZE = 256 * 1024;
+
+/**
+ * Collects the metadata until it is known to be complete; only then
+ * it is passed to the #TagHandler.
+ */
+struct FastScanResult {
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	SongTime duration = SongTime::zero();
+
+	/**
+	 * Raw Vorbis comments ("NAME=value").
+	 */
+	std::vector<std::string> comments;
+
+	std::vector<std::pair<TagType, std::string>> tags;
+
+	std::vector<std::pair<std::string, std::string>> pairs;
+
+	bool IsComplete() const noexcept {
+		return audio_format.IsDefined() && duration.IsPositive();
+	}
+
+	void Submit(TagHandler &handler) const noexcept {
+		handler.OnDuration(duration);
+		handler.OnAudioFormat(audio_format);
+
+#ifdef ENABLE_FLAC
+		for (const auto &i : comments)
+			ScanVorbisComment(i, handler);
+#endif
+
+		for (const auto &[type, value] : tags)
+			handler.OnTag(type, value);
+
+		if (handler.WantPair())
+			for (const auto &[name, value] : pairs)
+				handler.OnPair(name, value);
+	}
+};
+
+static constexpr uint16_t
+ReadBE16(const uint8_t *p) noexcept
+{
+	return (p[0] << 8) | p[1];
+}
+
+static constexpr uint32_t
+ReadBE32(const uint8_t *p) noexcept
+{
+	return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static constexpr uint64_t
+ReadBE64(const uint8_t *p) noexcept
+{
+	return (uint64_t(ReadBE32(p)) << 32) | ReadBE32(p + 4);
+}
+
+static void
+ReadFull(InputStream &is, std::unique_lock<Mutex> &lock,
+	 std::span<uint8_t> dest)
+{
+	is.ReadFull(lock, std::as_writable_bytes(dest));
+}
+
+/**
+ * Load a block of the given size into a new buffer.
+ *
+ * @return nullptr if the block is too large
+ */
+static std::unique_ptr<uint8_t[]>
+LoadBlock(InputStream &is, std::unique_lock<Mutex> &lock, std::size_t size)
+{
+	if (size > MAX_METADATA_SIZE)
+		return nullptr;
+
+	auto buffer = std::make_unique<uint8_t[]>(size);
+	ReadFull(is, lock, {buffer.get(), size});
+	return buffer;
+}
+
+#ifdef ENABLE_FLAC
+
+static bool
+ShiftLE32(std::span<const uint8_t> &src, uint32_t &value) noexcept
+{
+	if (src.size() < 4)
+		return false;
+
+	value = src[0] | (src[1] << 8) | (src[2] << 16) |
+		(uint32_t(src[3]) << 24);
+	src = src.subspan(4);
+	return true;
+}
+
+static bool
+ParseVorbisCommentBlock(std::span<const uint8_t> src,
+			std::vector<std::string> &comments)
+{
+	uint32_t vendor_length, n;
+	if (!ShiftLE32(src, vendor_length) || vendor_length > src.size())
+		return false;
+
+	src = src.subspan(vendor_length);
+
+	if (!ShiftLE32(src, n))
+		return false;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		uint32_t length;
+		if (!ShiftLE32(src, length) || length > src.size())
+			return false;
+
+		comments.emplace_back((const char *)src.data(), length);
+		src = src.subspan(length);
+	}
+
+	return true;
+}
+
+static void
+ParseFlacStreamInfo(const uint8_t *p, FastScanResult &result)
+{
+	const unsigned sample_rate = (p[10] << 12) | (p[11] << 4) |
+		(p[12] >> 4);
+	const unsigned channels = ((p[12] >> 1) & 0x7) + 1;
+	const unsigned bits_per_sample = (((p[12] & 0x1) << 4) |
+					  (p[13] >> 4)) + 1;
+	const uint64_t total_samples = (uint64_t(p[13] & 0xf) << 32) |
+		ReadBE32(p + 14);
+
+	result.audio_format = CheckAudioFormat(sample_rate,
+					       FlacSampleFormat(bits_per_sample),
+					       channels);
+
+	if (total_samples > 0)
+		result.duration = SongTime::FromScale<uint64_t>(total_samples,
+								sample_rate);
+}
+
+/**
+ * Parse the FLAC metadata blocks following the "fLaC" signature.
+ * Only STREAMINFO and VORBIS_COMMENT are loaded, all other blocks
+ * (SEEKTABLE, PICTURE, PADDING, ...) are skipped.
+ */
+static bool
+ScanFlac(InputStream &is, std::unique_lock<Mutex> &lock,
+	 FastScanResult &result)
+{
+	while (true) {
+		std::array<uint8_t, 4> header;
+		ReadFull(is, lock, header);
+
+		const bool last = (header[0] & 0x80) != 0;
+		const unsigned type = header[0] & 0x7f;
+		const std::size_t size = (header[1] << 16) | (header[2] << 8) |
+			header[3];
+
+		switch (type) {
+		case 0: /* STREAMINFO */
+			if (size != 34)
+				return false;
+
+			{
+				std::array<uint8_t, 34> stream_info;
+				ReadFull(is, lock, stream_info);
+				ParseFlacStreamInfo(stream_info.data(), result);
+			}
+
+			break;
+
+		case 4: /* VORBIS_COMMENT */
+			if (const auto block = LoadBlock(is, lock, size);
+			    block == nullptr ||
+			    !ParseVorbisCommentBlock({block.get(), size},
+						     result.comments))
+				return false;
+
+			break;
+
+		case 127: /* invalid */
+			return false;
+
+		default:
+			is.Skip(lock, size);
+			break;
+		}
+
+		if (last)
+			return true;
+	}
+}
+
+#endif
+
+/**
+ * MP4 atoms which are mapped to MPD tags.
+ */
+static constexpr struct tag_table mp4_tags[] = {
+	{ "\251nam", TAG_TITLE },
+	{ "\251ART", TAG_ARTIST },
+	{ "aART", TAG_ALBUM_ARTIST },
+	{ "\251alb", TAG_ALBUM },
+	{ "\251day", TAG_DATE },
+	{ "\251gen", TAG_GENRE },
+	{ "\251wrt", TAG_COMPOSER },
+	{ "\251cmt", TAG_COMMENT },
+	{ "\251grp", TAG_GROUPING },
+	{ "\251wrk", TAG_WORK },
+	{ "\251mvn", TAG_MOVEMENT },
+	{ "sonm", TAG_TITLE_SORT },
+	{ "soar", TAG_ARTIST_SORT },
+	{ "soaa", TAG_ALBUM_ARTIST_SORT },
+	{ "soal", TAG_ALBUM_SORT },
+	{ "soco", TAG_COMPOSERSORT },
+
+	/* sentinel */
+	{ nullptr, TAG_NUM_OF_ITEM_TYPES }
+};
+
+struct Mp4Box {
+	char type[4];
+
+	/**
+	 * The stream offset where this box ends.
+	 */
+	offset_type end;
+
+	bool Is(const char *_type) const noexcept {
+		return memcmp(type, _type, sizeof(type)) == 0;
+	}
+};
+
+/**
+ * Read the next box header if there is one before #end.
+ */
+static bool
+ReadMp4Box(InputStream &is, std::unique_lock<Mutex> &lock,
+	   offset_type end, Mp4Box &box)
+{
+	const offset_type offset = is.GetOffset();
+	if (offset + 8 > end)
+		return false;
+
+	std::array<uint8_t, 8> header;
+	ReadFull(is, lock, header);
+	memcpy(box.type, header.data() + 4, sizeof(box.type));
+
+	uint64_t size = ReadBE32(header.data());
+	unsigned header_size = 8;
+	if (size == 1) {
+		/* 64 bit "largesize" */
+		ReadFull(is, lock, header);
+		size = ReadBE64(header.data());
+		header_size = 16;
+	} else if (size == 0)
+		/* extends to the end of the enclosing box */
+		size = end - offset;
+
+	if (size < header_size || size > end - offset)
+		return false;
+
+	box.end = offset + size;
+	return true;
+}
+
+/**
+ * Skip boxes until one with the given type is found.
+ */
+static bool
+FindMp4Box(InputStream &is, std::unique_lock<Mutex> &lock,
+	   offset_type end, const char *type, Mp4Box &box)
+{
+	while (ReadMp4Box(is, lock, end, box)) {
+		if (box.Is(type))
+			return true;
+
+		is.Seek(lock, box.end);
+	}
+
+	return false;
+}
+
+/**
+ * Parse the duration from a "mvhd" or "mdhd" box.
+ */
+static SongTime
+ReadMp4Duration(InputStream &is, std::unique_lock<Mutex> &lock,
+		offset_type end)
+{
+	const offset_type available = end - is.GetOffset();
+	if (available < 20)
+		return SongTime::zero();
+
+	std::array<uint8_t, 32> buffer;
+	ReadFull(is, lock, std::span{buffer}.first(4));
+
+	uint32_t timescale;
+	uint64_t duration;
+	if (buffer[0] == 1) {
+		/* version 1: 64 bit times */
+		if (available < 32)
+			return SongTime::zero();
+
+		ReadFull(is, lock, std::span{buffer}.subspan(4, 28));
+		timescale = ReadBE32(&buffer[20]);
+		duration = ReadBE64(&buffer[24]);
+		if (duration == UINT64_MAX)
+			return SongTime::zero();
+	} else {
+		ReadFull(is, lock, std::span{buffer}.subspan(4, 16));
+		timescale = ReadBE32(&buffer[12]);
+		duration = ReadBE32(&buffer[16]);
+		if (duration == UINT32_MAX)
+			return SongTime::zero();
+	}
+
+	if (timescale == 0)
+		return SongTime::zero();
+
+	return SongTime::FromScale<uint64_t>(duration, timescale);
+}
+
+/**
+ * Parse the first entry of a "stsd" box.  Only codecs whose decoded
+ * sample format is known from the header are supported.
+ */
+static AudioFormat
+ReadMp4SampleDescription(InputStream &is, std::unique_lock<Mutex> &lock,
+			 offset_type end)
+{
+	std::array<uint8_t, 44> buffer;
+	if (end - is.GetOffset() < buffer.size())
+		return AudioFormat::Undefined();
+
+	ReadFull(is, lock, buffer);
+
+	/* skip the version/flags and the entry count */
+	const uint8_t *entry = buffer.data() + 8;
+	const unsigned channels = ReadBE16(entry + 24);
+	const unsigned sample_size = ReadBE16(entry + 26);
+	/* 16.16 fixed point */
+	const unsigned sample_rate = ReadBE32(entry + 32) >> 16;
+
+	SampleFormat format;
+	if (memcmp(entry + 4, "mp4a", 4) == 0)
+		/* AAC is always decoded to floating point */
+		format = SampleFormat::FLOAT;
+	else if (memcmp(entry + 4, "alac", 4) == 0)
+		format = sample_size == 16
+			? SampleFormat::S16
+			: SampleFormat::S32;
+	else
+		return AudioFormat::Undefined();
+
+	return CheckAudioFormat(sample_rate, format, channels);
+}
+
+/**
+ * Parse a "mdia" box; only sound tracks are accepted.
+ */
+static bool
+ScanMp4Media(InputStream &is, std::unique_lock<Mutex> &lock,
+	     offset_type end, FastScanResult &result)
+{
+	bool sound = false;
+	SongTime duration = SongTime::zero();
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	Mp4Box box;
+	while (ReadMp4Box(is, lock, end, box)) {
+		if (box.Is("hdlr")) {
+			std::array<uint8_t, 12> hdlr;
+			if (box.end - is.GetOffset() < hdlr.size())
+				return false;
+
+			ReadFull(is, lock, hdlr);
+			sound = memcmp(hdlr.data() + 8, "soun", 4) == 0;
+			if (!sound)
+				return false;
+		} else if (box.Is("mdhd")) {
+			duration = ReadMp4Duration(is, lock, box.end);
+		} else if (box.Is("minf")) {
+			Mp4Box stbl, stsd;
+			if (FindMp4Box(is, lock, box.end, "stbl", stbl) &&
+			    FindMp4Box(is, lock, stbl.end, "stsd", stsd))
+				audio_format = ReadMp4SampleDescription(is, lock,
+									stsd.end);
+		}
+
+		is.Seek(lock, box.end);
+	}
+
+	if (!sound || !audio_format.IsDefined())
+		return false;
+
+	result.audio_format = audio_format;
+	result.duration = duration;
+	return true;
+}
+
+static void
+ParseMp4Number(std::span<const uint8_t> value, TagType type,
+	       FastScanResult &result)
+{
+	if (value.size() < 6)
+		return;
+
+	const unsigned number = ReadBE16(value.data() + 2);
+	const unsigned total = ReadBE16(value.data() + 4);
+	if (number == 0)
+		return;
+
+	result.tags.emplace_back(type, total > 0
+				 ? fmt::format("{}/{}", number, total)
+				 : fmt::format("{}", number));
+}
+
+/**
+ * Split the next box from an in-memory buffer.
+ */
+static bool
+ShiftMp4Box(std::span<const uint8_t> &src, std::string_view &type,
+	    std::span<const uint8_t> &payload) noexcept
+{
+	if (src.size() < 8)
+		return false;
+
+	const std::size_t size = ReadBE32(src.data());
+	if (size < 8 || size > src.size())
+		return false;
+
+	type = {(const char *)src.data() + 4, 4};
+	payload = src.subspan(8, size - 8);
+	src = src.subspan(size);
+	return true;
+}
+
+/**
+ * Parse one item of the "ilst" box, i.e. a list of "data" boxes (and
+ * "mean"/"name" for free-form items).
+ */
+static void
+ParseMp4TagItem(std::string_view atom, std::span<const uint8_t> src,
+		FastScanResult &result)
+{
+	TagType type = tag_table_lookup(mp4_tags, atom);
+	const bool is_number = atom == "trkn" || atom == "disk";
+	std::string_view name{};
+
+	std::string_view child_type;
+	std::span<const uint8_t> payload;
+	while (ShiftMp4Box(src, child_type, payload)) {
+		if (payload.size() < 4)
+			continue;
+
+		if (child_type == "name") {
+			name = {(const char *)payload.data() + 4,
+				payload.size() - 4};
+			type = tag_table_lookup(musicbrainz_txxx_tags, name);
+			if (type == TAG_NUM_OF_ITEM_TYPES)
+				type = tag_name_parse_i(name);
+			continue;
+		}
+
+		if (child_type != "data" || payload.size() < 8)
+			continue;
+
+		/* skip the type indicator and the locale */
+		const auto value = payload.subspan(8);
+
+		if (is_number) {
+			ParseMp4Number(value,
+				       atom == "trkn" ? TAG_TRACK : TAG_DISC,
+				       result);
+			continue;
+		}
+
+		if ((ReadBE32(payload.data()) & 0xffffff) != 1)
+			/* not UTF-8 */
+			continue;
+
+		const std::string_view s{(const char *)value.data(),
+					 value.size()};
+
+		if (type != TAG_NUM_OF_ITEM_TYPES)
+			result.tags.emplace_back(type, s);
+
+		if (!name.empty())
+			result.pairs.emplace_back(name, s);
+		else if (type != TAG_NUM_OF_ITEM_TYPES)
+			result.pairs.emplace_back(tag_item_names[type], s);
+	}
+}
+
+static void
+ScanMp4TagList(InputStream &is, std::unique_lock<Mutex> &lock,
+	       offset_type end, FastScanResult &result)
+{
+	Mp4Box box;
+	while (ReadMp4Box(is, lock, end, box)) {
+		const std::size_t size = box.end - is.GetOffset();
+
+		/* skip large items such as cover art ("covr") */
+		if (!box.Is("covr")) {
+			if (const auto item = LoadBlock(is, lock, size))
+				ParseMp4TagItem({box.type, sizeof(box.type)},
+						{item.get(), size}, result);
+		}
+
+		is.Seek(lock, box.end);
+	}
+}
+
+/**
+ * Parse a "meta" box and its "ilst" child.
+ */
+static void
+ScanMp4Meta(InputStream &is, std::unique_lock<Mutex> &lock,
+	    offset_type end, FastScanResult &result)
+{
+	const offset_type start = is.GetOffset();
+	if (end - start < 8)
+		return;
+
+	/* in ISO files, "meta" is a full box with 4 bytes of
+	   version/flags; QuickTime files omit those */
+	std::array<uint8_t, 8> peek;
+	ReadFull(is, lock, peek);
+	is.Seek(lock, memcmp(peek.data() + 4, "hdlr", 4) == 0
+		? start : start + 4);
+
+	Mp4Box ilst;
+	if (FindMp4Box(is, lock, end, "ilst", ilst))
+		ScanMp4TagList(is, lock, ilst.end, result);
+}
+
+static bool
+ScanMp4Movie(InputStream &is, std::unique_lock<Mutex> &lock,
+	     offset_type end, FastScanResult &result)
+{
+	SongTime movie_duration = SongTime::zero();
+	bool have_track = false;
+
+	Mp4Box box;
+	while (ReadMp4Box(is, lock, end, box)) {
+		if (box.Is("mvhd")) {
+			movie_duration = ReadMp4Duration(is, lock, box.end);
+		} else if (box.Is("trak")) {
+			Mp4Box mdia;
+			if (!have_track &&
+			    FindMp4Box(is, lock, box.end, "mdia", mdia))
+				have_track = ScanMp4Media(is, lock, mdia.end,
+							  result);
+		} else if (box.Is("udta")) {
+			Mp4Box meta;
+			if (FindMp4Box(is, lock, box.end, "meta", meta))
+				ScanMp4Meta(is, lock, meta.end, result);
+		} else if (box.Is("meta")) {
+			ScanMp4Meta(is, lock, box.end, result);
+		}
+
+		is.Seek(lock, box.end);
+	}
+
+	if (!result.duration.IsPositive())
+		result.duration = movie_duration;
+
+	return have_track;
+}
+
+/**
+ * Skip all top-level boxes until "moov" is found; with a seekable
+ * stream, this costs only one small read per box, even if "mdat"
+ * comes first.
+ */
+static bool
+ScanMp4(InputStream &is, std::unique_lock<Mutex> &lock,
+	FastScanResult &result)
+{
+	Mp4Box box;
+	if (FindMp4Box(is, lock, is.GetSize(), "moov", box))
+		return ScanMp4Movie(is, lock, box.end, result);
+
+	return false;
+}
+
+static bool
+ScanFastTags(InputStream &is, std::unique_lock<Mutex> &lock,
+	     FastScanResult &result)
+{
+	std::array<uint8_t, 10> header;
+	ReadFull(is, lock, header);
+
+	if (memcmp(header.data() + 4, "ftyp", 4) == 0) {
+		is.Seek(lock, 0);
+		return ScanMp4(is, lock, result);
+	}
+
+#ifdef ENABLE_FLAC
+	if (memcmp(header.data(), "ID3", 3) == 0) {
+		/* skip the ID3v2 tag some encoders prepend to FLAC
+		   files; its size is a 28 bit "syncsafe" integer */
+		offset_type size = 10 + ((header[6] & 0x7f) << 21) +
+			((header[7] & 0x7f) << 14) +
+			((header[8] & 0x7f) << 7) +
+			(header[9] & 0x7f);
+		if (header[5] & 0x10)
+			/* footer present */
+			size += 10;
+
+		is.Seek(lock, size);
+		ReadFull(is, lock, std::span{header}.first(4));
+	} else
+		is.Seek(lock, 4);
+
+	if (memcmp(header.data(), "fLaC", 4) == 0)
+		return ScanFlac(is, lock, result);
+#endif
+
+	return false;
+}
+
+bool
+ScanFastTags(InputStream &is, TagHandler &handler) noexcept
+{
+	if (handler.WantPicture())
+		/* pictures are only available from the decoder
+		   plugins */
+		return false;
+
+	FastScanResult result;
+
+	try {
+		std::unique_lock lock{is.mutex};
+
+		if (!is.IsSeekable() || !is.KnownSize())
+			return false;
+
+		if (!ScanFastTags(is, lock, result) || !result.IsComplete())
+			return false;
+	} catch (...) {
+		/* let the decoder plugin deal with (and report)
+		   malformed files */
+		return false;
+	}
+
+	result.Submit(handler);
+	return true;
+}
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_TAG_FAST_HXX
+#define MPD_TAG_FAST_HXX
+
+class InputStream;
+class TagHandler;
+
+/**
+ * Scan the metadata of a song by parsing only the container headers
+ * (FLAC metadata blocks, MP4 "moov" box), using a few small reads of
+ * exactly the needed size and seeking over everything else.  This is
+ * much cheaper than letting a decoder plugin probe the file, which
+ * matters for database updates on network file systems.
+ *
+ * Nothing is passed to the #TagHandler unless both the audio format
+ * and the duration were found; if this function returns false, the
+ * caller should fall back to the decoder plugins.
+ *
+ * Errors are not reported; the decoder plugins will report them
+ * during the fallback.
+ *
+ * @param is a ready #InputStream positioned at the beginning
+ * @return true if the metadata was scanned completely
+ */
+bool
+ScanFastTags(InputStream &is, TagHandler &handler) noexcept;
+
+#endif
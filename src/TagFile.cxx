@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "TagFile.hxx"
+#include "TagFast.hxx"
 #include "tag/Generic.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
@@ -22,6 +23,15 @@ class TagFileScan {
 	Mutex mutex;
 	InputStreamPtr is;
 
+	[[gnu::pure]]
+	bool IsSupported() const noexcept {
+		for (const auto &plugin : GetEnabledDecoderPlugins())
+			if (plugin.SupportsSuffix(suffix))
+				return true;
+
+		return false;
+	}
+
 public:
 	TagFileScan(Path _path_fs, const char *_suffix,
 		    TagHandler &_handler) noexcept
@@ -48,6 +58,18 @@ public:
 		return plugin.ScanStream(*is, handler);
 	}
 
+	/**
+	 * Try ScanFastTags() if at least one enabled decoder plugin
+	 * supports the suffix.
+	 */
+	bool ScanFast() {
+		if (!IsSupported())
+			return false;
+
+		is = OpenLocalInputStream(path_fs, mutex);
+		return ScanFastTags(*is, handler);
+	}
+
 	bool Scan(const DecoderPlugin &plugin) {
 		return plugin.SupportsSuffix(suffix) &&
 			(ScanFile(plugin) || ScanStream(plugin));
@@ -68,6 +90,9 @@ ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler)
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
 	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler);
+	if (tfs.ScanFast())
+		return true;
+
 	for (const auto &plugin : GetEnabledDecoderPlugins()) {
 		if (tfs.Scan(plugin))
 			return true;
@@ -42,6 +42,9 @@ void
 tag_print_values(Response &r, const Tag &tag) noexcept
 {
 	const auto tag_mask = r.GetTagMask();
+	if (!(tag.types & tag_mask).TestAny())
+		return;
+
 	for (const auto &i : tag)
 		if (tag_mask.Test(i.type))
 			tag_print(r, i.type, i.value);
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "TagStream.hxx"
+#include "TagFast.hxx"
 #include "tag/Generic.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
@@ -41,10 +42,27 @@ tag_stream_scan(InputStream &is, TagHandler &handler)
 	if (full_mime != nullptr)
 		mime_base = GetMimeTypeBase(full_mime);
 
+	bool fast_tried = false;
+
 	for (const auto &plugin : GetEnabledDecoderPlugins()) {
 		if (!CheckDecoderPlugin(plugin, suffix, mime_base))
 			continue;
 
+		if (!fast_tried) {
+			/* before invoking the first matching plugin,
+			   try to get away with parsing just the
+			   container headers */
+			fast_tried = true;
+
+			try {
+				is.LockRewind();
+			} catch (...) {
+			}
+
+			if (ScanFastTags(is, handler))
+				return true;
+		}
+
 		try {
 			is.LockRewind();
 		} catch (...) {
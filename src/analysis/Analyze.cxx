@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include "Analyze.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/Command.hxx"
+#include "decoder/DecoderAPI.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/Convert.hxx"
+#include "pcm/MixRampAnalyzer.hxx"
+#include "pcm/MixRampGlue.hxx"
+#include "pcm/ReplayGainAnalyzer.hxx"
+#include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
+#include "util/MimeType.hxx"
+#include "util/SpanCast.hxx"
+#include "util/UriExtract.hxx"
+
+#include "decoder/Features.h"
+
+#ifdef ENABLE_FLAC
+#include "decoder/plugins/FlacDecoderPlugin.h"
+#include "decoder/plugins/FlacParallel.hxx"
+#endif
+
+#ifdef ENABLE_CHROMAPRINT
+#include "lib/chromaprint/Context.hxx"
+#endif
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * A #DecoderClient which converts the decoded PCM data to the format
+ * expected by #ReplayGainAnalyzer (and to 16 bit for Chromaprint)
+ * and feeds it into all analyzers.
+ */
+class AnalysisDecoderClient final : public DecoderClient {
+	const std::atomic_bool &cancel;
+
+	Mutex &mutex;
+
+	/**
+	 * Converts to 44.1 kHz / stereo / float32.
+	 */
+	std::unique_ptr<PcmConvert> convert;
+
+	WindowReplayGainAnalyzer replay_gain;
+	MixRampAnalyzer mixramp;
+
+#ifdef ENABLE_CHROMAPRINT
+	std::unique_ptr<PcmConvert> chromaprint_convert;
+	Chromaprint::Context chromaprint;
+
+	/**
+	 * Only the first two minutes are fingerprinted (like
+	 * "getfingerprint" does).
+	 */
+	uint64_t chromaprint_remaining;
+#endif
+
+	/**
+	 * An error which occurred in a noexcept method; it will be
+	 * rethrown by Finish().
+	 */
+	std::exception_ptr error;
+
+	bool ready = false;
+
+public:
+	AnalysisDecoderClient(const std::atomic_bool &_cancel,
+			      Mutex &_mutex) noexcept
+		:cancel(_cancel), mutex(_mutex) {}
+
+	bool IsReady() const noexcept {
+		return ready;
+	}
+
+	AnalysisResult Finish();
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) noexcept override;
+
+	DecoderCommand GetCommand() noexcept override {
+		return !error && !cancel.load(std::memory_order_relaxed)
+			? DecoderCommand::NONE
+			: DecoderCommand::STOP;
+	}
+
+	void CommandFinished() noexcept override {}
+
+	SongTime GetSeekTime() noexcept override {
+		return SongTime::zero();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return 0;
+	}
+
+	void SeekError() noexcept override {}
+
+	InputStreamPtr OpenUri(const char *uri) override {
+		if (cancel)
+			throw StopDecoder();
+
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is,
+		    std::span<std::byte> dest) noexcept override;
+
+	void SubmitTimestamp(FloatDuration) noexcept override {}
+	DecoderCommand SubmitAudio(InputStream *is,
+				   std::span<const std::byte> audio,
+				   uint16_t kbit_rate) noexcept override;
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) noexcept override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *) noexcept override {}
+	void SubmitMixRamp(MixRampInfo &&) noexcept override {}
+
+private:
+	void Feed(std::span<const std::byte> src);
+};
+
+void
+AnalysisDecoderClient::Ready(AudioFormat audio_format, bool,
+			     SignedSongTime) noexcept
+try {
+	const AudioFormat analyzer_format{
+		ReplayGainAnalyzer::SAMPLE_RATE,
+		SampleFormat::FLOAT,
+		ReplayGainAnalyzer::CHANNELS,
+	};
+
+	if (audio_format != analyzer_format)
+		convert = std::make_unique<PcmConvert>(audio_format,
+						       analyzer_format);
+
+#ifdef ENABLE_CHROMAPRINT
+	chromaprint_remaining = audio_format.TimeToSize(std::chrono::minutes(2));
+
+	AudioFormat chromaprint_format = audio_format;
+	chromaprint_format.format = SampleFormat::S16;
+	if (audio_format.format != SampleFormat::S16)
+		chromaprint_convert = std::make_unique<PcmConvert>(audio_format,
+								   chromaprint_format);
+
+	chromaprint.Start(chromaprint_format.sample_rate,
+			  chromaprint_format.channels);
+#endif
+
+	ready = true;
+} catch (...) {
+	error = std::current_exception();
+}
+
+inline void
+AnalysisDecoderClient::Feed(std::span<const std::byte> src)
+{
+	const auto frames =
+		FromBytesStrict<const ReplayGainAnalyzer::Frame>(src);
+	replay_gain.Process(frames);
+	mixramp.Process(frames);
+}
+
+DecoderCommand
+AnalysisDecoderClient::SubmitAudio(InputStream *,
+				   std::span<const std::byte> audio,
+				   uint16_t) noexcept
+try {
+	assert(ready);
+
+#ifdef ENABLE_CHROMAPRINT
+	if (chromaprint_remaining > 0) {
+		auto c = audio;
+		if (c.size() > chromaprint_remaining)
+			c = c.first(chromaprint_remaining);
+		chromaprint_remaining -= c.size();
+
+		if (chromaprint_convert)
+			c = chromaprint_convert->Convert(c);
+
+		chromaprint.Feed(FromBytesStrict<const int16_t>(c));
+	}
+#endif
+
+	Feed(convert ? convert->Convert(audio) : audio);
+
+	return GetCommand();
+} catch (...) {
+	error = std::current_exception();
+	return DecoderCommand::STOP;
+}
+
+size_t
+AnalysisDecoderClient::Read(InputStream &is,
+			    std::span<std::byte> dest) noexcept
+{
+	if (cancel)
+		return 0;
+
+	try {
+		return is.LockRead(dest);
+	} catch (...) {
+		error = std::current_exception();
+		return 0;
+	}
+}
+
+AnalysisResult
+AnalysisDecoderClient::Finish()
+{
+	if (cancel)
+		throw StopDecoder();
+
+	if (error)
+		std::rethrow_exception(error);
+
+	assert(ready);
+
+	if (convert) {
+		while (true) {
+			const auto flushed = convert->Flush();
+			if (flushed.empty())
+				break;
+
+			Feed(flushed);
+		}
+	}
+
+	replay_gain.Flush();
+
+	AnalysisResult result;
+	result.track_gain = replay_gain.GetGain();
+	result.track_peak = replay_gain.GetPeak();
+	result.mixramp_start = MixRampToString(mixramp,
+					       MixRampDirection::START);
+	result.mixramp_end = MixRampToString(mixramp,
+					     MixRampDirection::END);
+
+#ifdef ENABLE_CHROMAPRINT
+	if (chromaprint_convert) {
+		auto flushed = chromaprint_convert->Flush();
+		chromaprint.Feed(FromBytesStrict<const int16_t>(flushed));
+	}
+
+	chromaprint.Finish();
+	result.chromaprint = chromaprint.GetFingerprint();
+#endif
+
+	return result;
+}
+
+[[gnu::pure]]
+static bool
+CheckPluginMime(const DecoderPlugin &plugin, const InputStream &is) noexcept
+{
+	const char *mime_type = is.GetMimeType();
+	return mime_type != nullptr &&
+		plugin.SupportsMimeType(GetMimeTypeBase(mime_type));
+}
+
+static AnalysisResult
+AnalyzeFile(Path path, std::string_view suffix,
+	    const std::atomic_bool &cancel,
+	    [[maybe_unused]] WorkerPool *decode_pool,
+	    [[maybe_unused]] unsigned decode_threads)
+{
+	Mutex mutex;
+	auto is = OpenLocalInputStream(path, mutex);
+
+	for (const auto &plugin : GetEnabledDecoderPlugins()) {
+		if (!plugin.SupportsSuffix(suffix))
+			continue;
+
+		auto client = std::make_unique<AnalysisDecoderClient>(cancel,
+								      mutex);
+
+#ifdef ENABLE_FLAC
+		if (&plugin == &flac_decoder_plugin && decode_pool != nullptr &&
+		    FlacParallelDecode(*client, path, *decode_pool,
+				       decode_threads + 1))
+			return client->Finish();
+#endif
+
+		if (plugin.file_decode != nullptr) {
+			plugin.FileDecode(*client, path);
+		} else if (plugin.stream_decode != nullptr) {
+			/* rewind the stream, so each plugin gets a
+			   fresh start */
+			try {
+				is->LockRewind();
+			} catch (...) {
+			}
+
+			plugin.StreamDecode(*client, *is);
+		} else
+			continue;
+
+		if (client->IsReady() || cancel)
+			return client->Finish();
+	}
+
+	throw std::runtime_error("No decoder plugin");
+}
+
+static AnalysisResult
+AnalyzeStream(const char *uri, std::string_view suffix,
+	      const std::atomic_bool &cancel)
+{
+	Mutex mutex;
+	auto is = InputStream::OpenReady(uri, mutex);
+
+	for (const auto &plugin : GetEnabledDecoderPlugins()) {
+		if (plugin.stream_decode == nullptr ||
+		    !(CheckPluginMime(plugin, *is) ||
+		      (!suffix.empty() && plugin.SupportsSuffix(suffix))))
+			continue;
+
+		try {
+			is->LockRewind();
+		} catch (...) {
+		}
+
+		auto client = std::make_unique<AnalysisDecoderClient>(cancel,
+								      mutex);
+		plugin.StreamDecode(*client, *is);
+
+		if (client->IsReady() || cancel)
+			return client->Finish();
+	}
+
+	throw std::runtime_error("No decoder plugin");
+}
+
+} // anonymous namespace
+
+AnalysisResult
+AnalyzeSong(const char *uri, Path path, const std::atomic_bool &cancel,
+	    WorkerPool *decode_pool, unsigned decode_threads)
+{
+	const auto suffix = uri_get_suffix(uri);
+
+	return !path.IsNull()
+		? AnalyzeFile(path, suffix, cancel, decode_pool, decode_threads)
+		: AnalyzeStream(uri, suffix, cancel);
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ANALYSIS_ANALYZE_HXX
+#define MPD_ANALYSIS_ANALYZE_HXX
+
+#include <atomic>
+#include <string>
+
+class Path;
+class WorkerPool;
+
+/**
+ * The values calculated by AnalyzeSong().
+ */
+struct AnalysisResult {
+	float track_gain, track_peak;
+
+	/**
+	 * The MixRamp values in the format of the "mixramp_start" and
+	 * "mixramp_end" tags.
+	 */
+	std::string mixramp_start, mixramp_end;
+
+	/**
+	 * The Chromaprint fingerprint; empty if MPD was built
+	 * without libchromaprint.
+	 */
+	std::string chromaprint;
+};
+
+/**
+ * Decode a whole song and calculate its ReplayGain and MixRamp
+ * values and its fingerprint.  This blocks for a long time; it is
+ * meant to be called in a low-priority worker thread.
+ *
+ * Throws on error.
+ *
+ * @param uri the song URI (used to choose the decoder plugin, and to
+ * open the song if #path is nulled)
+ * @param path the local file path or nulled if the song is not a
+ * local file
+ * @param cancel if this flag becomes true, decoding is aborted and
+ * StopDecoder is thrown
+ * @param decode_pool if not nullptr, then local FLAC files are
+ * decoded by this #WorkerPool in parallel (see FlacParallelDecode())
+ * @param decode_threads the number of threads of #decode_pool
+ */
+AnalysisResult
+AnalyzeSong(const char *uri, Path path, const std::atomic_bool &cancel,
+	    WorkerPool *decode_pool=nullptr, unsigned decode_threads=0);
+
+#endif
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Service.hxx"
+#include "Analyze.hxx"
+#include "Instance.hxx"
+#include "protocol/IdleFlags.hxx"
+#include "decoder/DecoderAPI.hxx"
+#include "storage/StorageInterface.hxx"
+#include "config/ThreadConfig.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
+
+#include <cassert>
+
+static constexpr Domain analysis_domain("analysis");
+
+/**
+ * The sticker which marks a song as analyzed.
+ */
+static constexpr const char *ANALYZED_STICKER = "replaygain_track_gain";
+
+AnalysisService::AnalysisService(Instance &_instance,
+				 StickerDatabase &_sticker_db,
+				 const Storage &_storage, unsigned n_threads,
+				 unsigned _decode_threads)
+	:instance(_instance), storage(_storage),
+	 sticker_db(_sticker_db.Reopen()),
+	 decode_threads(_decode_threads)
+{
+	assert(n_threads > 0);
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		workers.emplace_front(*this);
+
+	pool.SetScheduling(GetThreadScheduling("analysis"));
+	pool.Start(n_threads);
+
+	if (decode_threads > 0) {
+		decode_pool.SetScheduling(GetThreadScheduling("analysis"));
+		decode_pool.Start(decode_threads);
+	}
+}
+
+AnalysisService::~AnalysisService() noexcept
+{
+	cancel = true;
+	pool.Stop();
+	decode_pool.Stop();
+}
+
+void
+AnalysisService::Enqueue(std::deque<std::string> &&uris) noexcept
+{
+	if (uris.empty())
+		return;
+
+	{
+		const std::scoped_lock lock{mutex};
+
+		for (auto &uri : uris)
+			queue.emplace_back(std::move(uri));
+
+		for (auto &worker : workers) {
+			if (!worker.busy) {
+				worker.busy = true;
+				pool.Push(worker);
+			}
+		}
+	}
+
+	instance.EmitIdle(IDLE_ANALYSIS);
+}
+
+AnalysisService::Stats
+AnalysisService::GetStats() noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return {queue.size(), n_running, n_done, n_failed};
+}
+
+inline void
+AnalysisService::AnalyzeOne(const std::string &uri)
+{
+	{
+		const std::scoped_lock lock{mutex};
+		if (!sticker_db.LoadValue("song", uri.c_str(),
+					  ANALYZED_STICKER).empty())
+			/* already analyzed */
+			return;
+	}
+
+	const auto path = storage.MapFS(uri);
+	const std::string real_uri = path.IsNull()
+		? storage.MapUTF8(uri)
+		: uri;
+
+	const auto result = AnalyzeSong(real_uri.c_str(), path, cancel,
+					decode_pool.IsStarted()
+					? &decode_pool : nullptr,
+					decode_threads);
+
+	const auto gain = fmt::format("{:.2f} dB", result.track_gain);
+	const auto peak = fmt::format("{:.6f}", result.track_peak);
+
+	const std::scoped_lock lock{mutex};
+	sticker_db.StoreValue("song", uri.c_str(), "replaygain_track_peak",
+			      peak.c_str());
+
+	if (!result.mixramp_start.empty())
+		sticker_db.StoreValue("song", uri.c_str(), "mixramp_start",
+				      result.mixramp_start.c_str());
+
+	if (!result.mixramp_end.empty())
+		sticker_db.StoreValue("song", uri.c_str(), "mixramp_end",
+				      result.mixramp_end.c_str());
+
+	if (!result.chromaprint.empty())
+		sticker_db.StoreValue("song", uri.c_str(), "chromaprint",
+				      result.chromaprint.c_str());
+
+	/* this one is stored last, because it marks the song as
+	   complete */
+	sticker_db.StoreValue("song", uri.c_str(), ANALYZED_STICKER,
+			      gain.c_str());
+}
+
+void
+AnalysisService::RunWorker(Worker &worker) noexcept
+{
+	std::unique_lock lock{mutex};
+
+	while (!cancel && !queue.empty()) {
+		const std::string uri = std::move(queue.front());
+		queue.pop_front();
+		++n_running;
+
+		lock.unlock();
+
+		bool success = false;
+		try {
+			AnalyzeOne(uri);
+			success = true;
+		} catch (StopDecoder) {
+		} catch (...) {
+			FmtError(analysis_domain, "Failed to analyze {:?}: {}",
+				 uri, std::current_exception());
+		}
+
+		lock.lock();
+
+		--n_running;
+		if (success)
+			++n_done;
+		else if (!cancel)
+			++n_failed;
+
+		instance.EmitIdle(IDLE_ANALYSIS);
+	}
+
+	worker.busy = false;
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ANALYSIS_SERVICE_HXX
+#define MPD_ANALYSIS_SERVICE_HXX
+
+#include "sticker/Database.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/WorkerPool.hxx"
+
+#include <atomic>
+#include <deque>
+#include <forward_list>
+#include <string>
+
+struct Instance;
+class Storage;
+
+/**
+ * Decodes songs in low-priority worker threads and stores their
+ * ReplayGain, MixRamp and fingerprint values as song stickers (see
+ * AnalyzeSong()).  This way, these values can be calculated for the
+ * whole library in advance, instead of on the fly while the player
+ * needs the CPU.
+ *
+ * Progress is reported with #IDLE_ANALYSIS.
+ */
+class AnalysisService {
+	/**
+	 * One of these is submitted to the #WorkerPool per thread;
+	 * it analyzes songs from the queue until it is empty.
+	 */
+	class Worker final : public WorkerJob {
+		AnalysisService &service;
+
+	public:
+		/**
+		 * Has this job been submitted to the #WorkerPool and
+		 * not yet finished?  Protected by
+		 * AnalysisService::mutex.
+		 */
+		bool busy = false;
+
+		explicit Worker(AnalysisService &_service) noexcept
+			:service(_service) {}
+
+		/* virtual methods from WorkerJob */
+		void Run() noexcept override {
+			service.RunWorker(*this);
+		}
+	};
+
+	Instance &instance;
+
+	const Storage &storage;
+
+	/**
+	 * Protects #queue, #workers, the counters and #sticker_db.
+	 */
+	Mutex mutex;
+
+	/**
+	 * A separate connection for storing the results.
+	 */
+	StickerDatabase sticker_db;
+
+	/**
+	 * URIs of songs waiting to be analyzed.
+	 */
+	std::deque<std::string> queue;
+
+	WorkerPool pool{"analysis", true};
+
+	/**
+	 * Decodes segments of FLAC files in parallel for the
+	 * #workers; not started if "analysis_decode_threads" is 0.
+	 */
+	WorkerPool decode_pool{"analysis_decode", true};
+
+	const unsigned decode_threads;
+
+	std::forward_list<Worker> workers;
+
+	std::atomic_bool cancel{false};
+
+	unsigned n_running = 0, n_done = 0, n_failed = 0;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	AnalysisService(Instance &_instance, StickerDatabase &_sticker_db,
+			const Storage &_storage, unsigned n_threads,
+			unsigned _decode_threads);
+
+	~AnalysisService() noexcept;
+
+	AnalysisService(const AnalysisService &) = delete;
+	AnalysisService &operator=(const AnalysisService &) = delete;
+
+	/**
+	 * Append songs to the queue.  Songs which have already been
+	 * analyzed (i.e. which have a "replaygain_track_gain"
+	 * sticker) are skipped by the worker threads.
+	 */
+	void Enqueue(std::deque<std::string> &&uris) noexcept;
+
+	struct Stats {
+		std::size_t queued;
+		unsigned running, done, failed;
+	};
+
+	Stats GetStats() noexcept;
+
+private:
+	void RunWorker(Worker &worker) noexcept;
+
+	void AnalyzeOne(const std::string &uri);
+};
+
+#endif
@@ -13,13 +13,17 @@
 #include "fs/Path.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "thread/Mutex.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UTF8.hxx"
 
 #include <cdio/iso9660.h>
 
 #include <array>
+#include <cstdint>
+#include <map>
 #include <span>
+#include <string>
 #include <utility>
 
 #include <stdlib.h>
@@ -28,6 +32,25 @@
 struct Iso9660 {
 	iso9660_t *const iso;
 
+	/**
+	 * Serializes all accesses to #iso, because the image may be
+	 * shared by streams in different threads.
+	 */
+	mutable Mutex mutex;
+
+	struct IndexEntry {
+		lsn_t lsn;
+		uint_least64_t size;
+	};
+
+	/**
+	 * The location of each file (path without leading slash),
+	 * collected while visiting the directory tree, so
+	 * OpenStream() doesn't need to walk the directories again.
+	 * Protected by #mutex.
+	 */
+	std::map<std::string, IndexEntry, std::less<>> index;
+
 	explicit Iso9660(Path path)
 		:iso(iso9660_open(path.c_str())) {
 		if (iso == nullptr)
@@ -43,6 +66,7 @@ struct Iso9660 {
 	Iso9660 &operator=(const Iso9660 &) = delete;
 
 	long SeekRead(void *ptr, lsn_t start, long int i_size) const {
+		const std::scoped_lock lock{mutex};
 		return iso9660_iso_seek_read(iso, ptr, start, i_size);
 	}
 };
@@ -72,7 +96,11 @@ inline void
 Iso9660ArchiveFile::Visit(char *path, size_t length, size_t capacity,
 			  ArchiveVisitor &visitor)
 {
-	auto *entlist = iso9660_ifs_readdir(iso->iso, path);
+	auto *entlist = [this, path]{
+		const std::scoped_lock lock{iso->mutex};
+		return iso9660_ifs_readdir(iso->iso, path);
+	}();
+
 	if (!entlist) {
 		return;
 	}
@@ -104,6 +132,12 @@ Iso9660ArchiveFile::Visit(char *path, size_t length, size_t capacity,
 			memcpy(path + new_length, "/", 2);
 			Visit(path, new_length + 1, capacity, visitor);
 		} else {
+			{
+				const std::scoped_lock lock{iso->mutex};
+				iso->index.insert_or_assign(path + 1,
+							    Iso9660::IndexEntry{statbuf->lsn, statbuf->size});
+			}
+
 			//remove leading /
 			visitor.VisitArchiveEntry(path + 1);
 		}
@@ -221,14 +255,30 @@ InputStreamPtr
 Iso9660ArchiveFile::OpenStream(const char *pathname,
 			       Mutex &mutex)
 {
-	auto statbuf = iso9660_ifs_stat_translate(iso->iso, pathname);
-	if (statbuf == nullptr)
-		throw FmtRuntimeError("not found in the ISO file: {:?}",
-				      pathname);
-
-	const lsn_t lsn = statbuf->lsn;
-	const offset_type size = statbuf->size;
-	free(statbuf);
+	lsn_t lsn;
+	offset_type size;
+
+	{
+		const std::scoped_lock lock{iso->mutex};
+
+		if (auto i = iso->index.find(pathname);
+		    i != iso->index.end()) {
+			lsn = i->second.lsn;
+			size = i->second.size;
+		} else {
+			auto statbuf = iso9660_ifs_stat_translate(iso->iso, pathname);
+			if (statbuf == nullptr)
+				throw FmtRuntimeError("not found in the ISO file: {:?}",
+						      pathname);
+
+			lsn = statbuf->lsn;
+			size = statbuf->size;
+			free(statbuf);
+
+			iso->index.try_emplace(pathname,
+					       Iso9660::IndexEntry{lsn, size});
+		}
+	}
 
 	return std::make_unique<Iso9660InputStream>(iso, pathname, mutex,
 						    lsn, size);
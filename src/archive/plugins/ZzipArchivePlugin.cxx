@@ -15,6 +15,7 @@
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
 #include "lib/fmt/SystemError.hxx"
+#include "thread/Mutex.hxx"
 #include "util/UTF8.hxx"
 
 #include <zzip/zzip.h>
@@ -24,6 +25,14 @@
 struct ZzipDir {
 	ZZIP_DIR *const dir;
 
+	/**
+	 * zziplib reads all files of an archive through one file
+	 * descriptor owned by the #ZZIP_DIR; this mutex serializes
+	 * all accesses, because the archive may be shared by streams
+	 * in different threads.
+	 */
+	Mutex mutex;
+
 	explicit ZzipDir(Path path)
 		:dir(zzip_dir_open(NarrowPath(path), nullptr)) {
 		if (dir == nullptr)
@@ -64,13 +73,19 @@ zzip_archive_open(Path pathname)
 inline void
 ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
 {
+	std::unique_lock lock{dir->mutex};
+
 	zzip_rewinddir(dir->dir);
 
 	ZZIP_DIRENT dirent;
-	while (zzip_dir_read(dir->dir, &dirent))
+	while (zzip_dir_read(dir->dir, &dirent)) {
 		//add only files
-		if (dirent.st_size > 0 && ValidateUTF8(dirent.d_name))
+		if (dirent.st_size > 0 && ValidateUTF8(dirent.d_name)) {
+			/* the visitor may open streams */
+			const ScopeUnlock unlock(dir->mutex);
 			visitor.VisitArchiveEntry(dirent.d_name);
+		}
+	}
 }
 
 /* single archive handling */
@@ -84,20 +99,18 @@ public:
 	template<typename D>
 	ZzipInputStream(D &&_dir, const char *_uri,
 			Mutex &_mutex,
-			ZZIP_FILE *_file)
+			ZZIP_FILE *_file, offset_type _size)
 		:InputStream(_uri, _mutex),
 		 dir(std::forward<D>(_dir)), file(_file) {
 		//we are seekable (but its not recommendent to do so)
 		seekable = true;
-
-		ZZIP_STAT z_stat;
-		zzip_file_stat(file, &z_stat);
-		size = z_stat.st_size;
+		size = _size;
 
 		SetReady();
 	}
 
 	~ZzipInputStream() noexcept override {
+		const std::scoped_lock lock{dir->mutex};
 		zzip_file_close(file);
 	}
 
@@ -115,6 +128,8 @@ InputStreamPtr
 ZzipArchiveFile::OpenStream(const char *pathname,
 			    Mutex &mutex)
 {
+	const std::scoped_lock lock{dir->mutex};
+
 	ZZIP_FILE *_file = zzip_file_open(dir->dir, pathname, 0);
 	if (_file == nullptr) {
 		const auto error = (zzip_error_t)zzip_error(dir->dir);
@@ -130,15 +145,19 @@ ZzipArchiveFile::OpenStream(const char *pathname,
 		}
 	}
 
+	ZZIP_STAT z_stat;
+	zzip_file_stat(_file, &z_stat);
+
 	return std::make_unique<ZzipInputStream>(dir, pathname,
 						 mutex,
-						 _file);
+						 _file, z_stat.st_size);
 }
 
 size_t
 ZzipInputStream::Read(std::unique_lock<Mutex> &, std::span<std::byte> dest)
 {
 	const ScopeUnlock unlock(mutex);
+	const std::scoped_lock lock{dir->mutex};
 
 	zzip_ssize_t nbytes = zzip_file_read(file, dest.data(), dest.size());
 	if (nbytes < 0)
@@ -162,6 +181,7 @@ void
 ZzipInputStream::Seek(std::unique_lock<Mutex> &, offset_type new_offset)
 {
 	const ScopeUnlock unlock(mutex);
+	const std::scoped_lock lock{dir->mutex};
 
 	zzip_off_t ofs = zzip_seek(file, new_offset, SEEK_SET);
 	if (ofs < 0)
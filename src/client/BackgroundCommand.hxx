@@ -26,6 +26,13 @@ public:
 	 * #Client's #EventLoop thread.
 	 */
 	virtual void Cancel() noexcept = 0;
+
+	/**
+	 * The client's output buffer has become empty.  Commands
+	 * which generate their response incrementally (see
+	 * #StreamBackgroundCommand) use this to submit more data.
+	 */
+	virtual void OnOutputDrained() noexcept {}
 };
 
 #endif
@@ -2,13 +2,23 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
-#include "Config.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "BackgroundCommand.hxx"
+#ifdef ENABLE_ZLIB
+#include "Compressor.hxx"
+#endif
+#ifndef _WIN32
+#include "OutputSpill.hxx"
+#endif
 #include "protocol/IdleFlags.hxx"
 #include "config.h"
 
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#endif
+
 Client::~Client() noexcept
 {
 	if (FullyBufferedSocket::IsDefined())
@@ -43,7 +53,16 @@ Client::OnBackgroundCommandFinished() noexcept
 	   InputResult::PAUSE meanwhile */
 	ResumeInput();
 
-	timeout_event.Schedule(client_timeout);
+	RefreshTimeout();
+}
+
+void
+Client::CancelBackgroundCommand() noexcept
+{
+	if (background_command) {
+		background_command->Cancel();
+		background_command.reset();
+	}
 }
 
 void
@@ -85,6 +104,31 @@ Client::GetPlayerControl() const noexcept
 	return partition->pc;
 }
 
+WorkerPool *
+Client::GetCommandPool() const noexcept
+{
+	if (IsInCommandList())
+		/* a command list cannot be continued after a
+		   #BackgroundCommand */
+		return nullptr;
+
+#ifdef ENABLE_DATABASE
+	if (const auto *db = GetDatabase();
+	    db != nullptr && !db->GetPlugin().IsThreadSafe())
+		return nullptr;
+#endif
+
+	return partition->instance.command_pool.get();
+}
+
+WorkerPool &
+Client::GetBackgroundPool() const noexcept
+{
+	assert(partition->instance.background_pool);
+
+	return *partition->instance.background_pool;
+}
+
 #ifdef ENABLE_DATABASE
 
 const Database *
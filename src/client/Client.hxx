@@ -13,9 +13,10 @@
 #include "event/FullyBufferedSocket.hxx"
 #include "event/CoarseTimerEvent.hxx"
 #include "util/IntrusiveList.hxx"
+#include "config.h"
 
 #include <cstddef>
-#include <list>
+#include <deque>
 #include <memory>
 #include <set>
 #include <string>
@@ -31,6 +32,9 @@ struct playlist;
 class Database;
 class Storage;
 class BackgroundCommand;
+class WorkerPool;
+class ClientCompressor;
+class ClientOutputSpill;
 
 class Client final
 	: public IClient, FullyBufferedSocket
@@ -42,6 +46,14 @@ class Client final
 
 	CoarseTimerEvent timeout_event;
 
+	/**
+	 * The time of the most recent command.  Activity only
+	 * updates this time stamp instead of rescheduling
+	 * #timeout_event; OnTimeout() checks it and reschedules if
+	 * the client has been active meanwhile.
+	 */
+	Event::TimePoint last_activity;
+
 	Partition *partition;
 
 	unsigned permission;
@@ -63,6 +75,9 @@ class Client final
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/** is this client currently executing a command list? */
+	bool in_command_list = false;
+
 public:
 	// TODO: make this attribute "private"
 	/**
@@ -76,6 +91,13 @@ public:
 	 */
 	size_t binary_limit = 8192;
 
+	/**
+	 * The upper bound for #binary_limit.  Chunks which do not fit
+	 * into the output buffer are streamed from a separate thread
+	 * (except within a command list).
+	 */
+	static constexpr size_t MAX_BINARY_LIMIT = 64 * 1024 * 1024;
+
 	/**
 	 * This caches the last "albumart" InputStream instance, to
 	 * avoid repeating the search for each chunk requested by this
@@ -100,9 +122,11 @@ private:
 	static constexpr size_t MAX_MESSAGES = 64;
 
 	/**
-	 * A list of messages this client has received.
+	 * A list of messages this client has received.  The
+	 * #ClientMessage objects are shared with the other
+	 * subscribers.
 	 */
-	std::list<ClientMessage> messages;
+	std::deque<ClientMessagePtr> messages;
 
 	/**
 	 * The command currently running in background.  If this is
@@ -117,6 +141,25 @@ private:
 	 */
 	ProtocolFeature protocol_feature = ProtocolFeature::None();
 
+#ifdef ENABLE_ZLIB
+	/**
+	 * Compresses all output while the protocol feature
+	 * #PF_COMPRESSION is enabled.  It is created and destroyed
+	 * by UpdateCompression().
+	 */
+	std::unique_ptr<ClientCompressor> compressor;
+#endif
+
+#ifndef _WIN32
+	/**
+	 * Receives output which does not fit into the output buffer
+	 * if #client_output_spill_directory is configured.  It is
+	 * created on demand and is moved back to the output buffer
+	 * piece by piece as the socket drains.
+	 */
+	std::unique_ptr<ClientOutputSpill> output_spill;
+#endif
+
 public:
 	Client(EventLoop &loop, Partition &partition,
 	       UniqueSocketDescriptor fd, int uid,
@@ -127,6 +170,14 @@ public:
 
 	using FullyBufferedSocket::GetEventLoop;
 	using FullyBufferedSocket::GetOutputMaxSize;
+	using FullyBufferedSocket::GetOutputAllocatedSize;
+
+	/**
+	 * Has all output been sent to the socket (including data in
+	 * the spill file)?
+	 */
+	[[gnu::pure]]
+	bool IsOutputEmpty() const noexcept;
 
 	[[gnu::pure]]
 	bool IsExpired() const noexcept {
@@ -149,6 +200,15 @@ public:
 		return Write("OK\n");
 	}
 
+	/**
+	 * Is the current command part of a command list?  A command
+	 * list cannot be continued after a #BackgroundCommand, so
+	 * command handlers must not install one in this case.
+	 */
+	bool IsInCommandList() const noexcept {
+		return in_command_list;
+	}
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -185,7 +245,11 @@ public:
 	}
 
 	void AllProtocolFeatures() noexcept {
-		protocol_feature.SetAll();
+		/* these change the transport or the response format,
+		   which is only allowed if the client asks for it
+		   explicitly */
+		protocol_feature.Set(~(ProtocolFeature(PF_COMPRESSION) |
+				       ProtocolFeature(PF_BINARY_SONGS)));
 	}
 
 	void ClearProtocolFeatures() noexcept {
@@ -216,6 +280,11 @@ public:
 	 */
 	void OnBackgroundCommandFinished() noexcept;
 
+	/**
+	 * Cancel the #BackgroundCommand (if any).
+	 */
+	void CancelBackgroundCommand() noexcept;
+
 	enum class SubscribeResult {
 		/** success */
 		OK,
@@ -242,16 +311,20 @@ public:
 	SubscribeResult Subscribe(const char *channel) noexcept;
 	bool Unsubscribe(const char *channel) noexcept;
 	void UnsubscribeAll() noexcept;
-	bool PushMessage(const ClientMessage &msg) noexcept;
+	bool PushMessage(const ClientMessagePtr &msg) noexcept;
 
 	template<typename F>
 	void ConsumeMessages(F &&f) {
 		while (!messages.empty()) {
-			f(messages.front());
+			f(*messages.front());
 			messages.pop_front();
 		}
 	}
 
+	unsigned GetNumber() const noexcept {
+		return num;
+	}
+
 	Partition &GetPartition() const noexcept {
 		return *partition;
 	}
@@ -267,6 +340,23 @@ public:
 	[[gnu::pure]]
 	PlayerControl &GetPlayerControl() const noexcept;
 
+	/**
+	 * Returns the #WorkerPool which shall execute a
+	 * #WorkerBackgroundCommand for this client, or nullptr if
+	 * the command must be executed synchronously (e.g. because
+	 * it is part of a command list, or because the #Database is
+	 * not thread-safe).
+	 */
+	[[gnu::pure]]
+	WorkerPool *GetCommandPool() const noexcept;
+
+	/**
+	 * Returns the #WorkerPool which executes
+	 * #ThreadBackgroundCommand instances.
+	 */
+	[[gnu::pure]]
+	WorkerPool &GetBackgroundPool() const noexcept;
+
 	/**
 	 * Wrapper for Instance::GetDatabaseOrThrow().
 	 */
@@ -282,15 +372,59 @@ public:
 
 private:
 	CommandResult ProcessCommandList(bool list_ok,
-					 std::list<std::string> &&list) noexcept;
+					 CommandList &list) noexcept;
 
 	CommandResult ProcessLine(char *line) noexcept;
 
+	/**
+	 * Write to the socket, bypassing the #ClientCompressor.
+	 */
+	bool WriteUncompressed(std::span<const std::byte> src) noexcept {
+		return !IsExpired() && WriteOutput(src);
+	}
+
+	/**
+	 * Append data to the output buffer, or to the spill file if
+	 * it does not fit.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool WriteOutput(std::span<const std::byte> src) noexcept;
+
+#ifndef _WIN32
+	bool SpillOutput(std::span<const std::byte> src) noexcept;
+
+	/**
+	 * Move data from the spill file to the (empty) output
+	 * buffer.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool RefillOutput() noexcept;
+#endif
+
+	/**
+	 * Start or stop compressing the output after the protocol
+	 * feature #PF_COMPRESSION has been toggled.  This is called
+	 * after the response to a command (list) has been written,
+	 * so the change takes effect with the next response.
+	 */
+	void UpdateCompression() noexcept;
+
 	/* virtual methods from class BufferedSocket */
 	InputResult OnSocketInput(std::span<std::byte> src) noexcept override;
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketDrained() noexcept override;
+
+	/**
+	 * Note client activity, and arm the timeout if it is not
+	 * already pending.
+	 */
+	void RefreshTimeout() noexcept;
+
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
 };
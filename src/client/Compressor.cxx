@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Compressor.hxx"
+
+#include <stdexcept>
+
+ClientCompressor::ClientCompressor(EventLoop &loop, WriteFunction _write_raw)
+	:write_raw(_write_raw),
+	 flush_event(loop, BIND_THIS_METHOD(OnFlush)),
+	 gzip(*this)
+{
+}
+
+bool
+ClientCompressor::Compress(std::span<const std::byte> src) noexcept
+{
+	if (src.empty())
+		return true;
+
+	try {
+		gzip.Write(src);
+	} catch (...) {
+		/* the socket has been closed (or zlib has failed,
+		   which is just as fatal for this connection) */
+		return false;
+	}
+
+	flush_event.Schedule();
+	return true;
+}
+
+bool
+ClientCompressor::Finish() noexcept
+{
+	flush_event.Cancel();
+
+	try {
+		gzip.Finish();
+		return true;
+	} catch (...) {
+		return false;
+	}
+}
+
+void
+ClientCompressor::OnFlush() noexcept
+{
+	try {
+		gzip.SyncFlush();
+	} catch (...) {
+		/* the socket has been closed; nothing left to do */
+	}
+}
+
+void
+ClientCompressor::Write(std::span<const std::byte> src)
+{
+	if (!write_raw(src))
+		throw std::runtime_error("Connection closed");
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_CLIENT_COMPRESSOR_HXX
+#define MPD_CLIENT_COMPRESSOR_HXX
+
+#include "event/IdleEvent.hxx"
+#include "io/OutputStream.hxx"
+#include "lib/zlib/GzipOutputStream.hxx"
+#include "util/BindMethod.hxx"
+
+#include <span>
+
+/**
+ * Compresses the output of a client connection (protocol feature
+ * "compression").  Compressed data is flushed as soon as the
+ * #EventLoop becomes idle, i.e. after each command (list) or
+ * asynchronous response, to keep latency low.
+ */
+class ClientCompressor final : OutputStream {
+	using WriteFunction =
+		BoundMethod<bool(std::span<const std::byte> src) noexcept>;
+
+	/**
+	 * Writes compressed data to the socket; returns false if the
+	 * socket has been closed.
+	 */
+	const WriteFunction write_raw;
+
+	IdleEvent flush_event;
+
+	GzipOutputStream gzip;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	ClientCompressor(EventLoop &loop, WriteFunction _write_raw);
+
+	/**
+	 * Compress the given data.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool Compress(std::span<const std::byte> src) noexcept;
+
+	/**
+	 * Terminate the compressed stream and write all pending data.
+	 * After that, this object may be destructed, and subsequent
+	 * data is sent uncompressed.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool Finish() noexcept;
+
+private:
+	void OnFlush() noexcept;
+
+	/* virtual methods from class OutputStream */
+	void Write(std::span<const std::byte> src) override;
+};
+
+#endif
@@ -3,14 +3,26 @@
 
 #include "Config.hxx"
 #include "config/Data.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 
 #define CLIENT_TIMEOUT_DEFAULT			(60)
 #define CLIENT_MAX_COMMAND_LIST_DEFAULT		(2048*1024)
 #define CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT	(8192*1024)
+#define CLIENT_MAX_OUTPUT_SPILL_SIZE_DEFAULT	(1024*1024*1024)
+#define CLIENT_COMMAND_THREADS_DEFAULT		(2)
+#define CLIENT_COMMAND_THREADS_MAX		(64)
+#define CLIENT_BACKGROUND_THREADS_DEFAULT	(2)
+#define CLIENT_BACKGROUND_THREADS_MAX		(64)
 
 Event::Duration client_timeout;
 size_t client_max_command_list_size;
 size_t client_max_output_buffer_size;
+AllocatedPath client_output_spill_directory = nullptr;
+uint_least64_t client_max_output_spill_size;
+size_t client_output_memory_limit;
+unsigned client_command_threads;
+unsigned client_background_threads;
 
 void
 client_manager_init(const ConfigData &config)
@@ -28,4 +40,32 @@ client_manager_init(const ConfigData &config)
 		config.GetPositive(ConfigOption::MAX_OUTPUT_BUFFER_SIZE,
 				   CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT / 1024)
 		* 1024;
+
+#ifndef _WIN32
+	client_output_spill_directory =
+		config.GetPath(ConfigOption::OUTPUT_SPILL_DIRECTORY);
+#endif
+
+	client_max_output_spill_size =
+		uint_least64_t(config.GetPositive(ConfigOption::MAX_OUTPUT_SPILL_SIZE,
+						  CLIENT_MAX_OUTPUT_SPILL_SIZE_DEFAULT / 1024))
+		* 1024;
+
+	client_output_memory_limit =
+		size_t(config.GetUnsigned(ConfigOption::OUTPUT_MEMORY_LIMIT, 0))
+		* 1024;
+
+	client_command_threads =
+		config.GetUnsigned(ConfigOption::COMMAND_THREADS,
+				   CLIENT_COMMAND_THREADS_DEFAULT);
+	if (client_command_threads > CLIENT_COMMAND_THREADS_MAX)
+		throw FmtRuntimeError("command_threads is too large (maximum {})",
+				      CLIENT_COMMAND_THREADS_MAX);
+
+	client_background_threads =
+		config.GetPositive(ConfigOption::BACKGROUND_THREADS,
+				   CLIENT_BACKGROUND_THREADS_DEFAULT);
+	if (client_background_threads > CLIENT_BACKGROUND_THREADS_MAX)
+		throw FmtRuntimeError("background_threads is too large (maximum {})",
+				      CLIENT_BACKGROUND_THREADS_MAX);
 }
@@ -6,12 +6,48 @@
 
 #include "event/Chrono.hxx"
 
+#include <cstdint>
+
 struct ConfigData;
+class AllocatedPath;
 
 extern Event::Duration client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * If set, then output which does not fit into a client's output
+ * buffer is written to an unlinked temporary file in this directory
+ * (see #ClientOutputSpill) instead of disconnecting the client.
+ */
+extern AllocatedPath client_output_spill_directory;
+
+/**
+ * The maximum size of one client's spill file.
+ */
+extern uint_least64_t client_max_output_spill_size;
+
+/**
+ * If the peak output buffers of all clients together exceed this
+ * size (0 = unlimited), then excess output is spilled even before a
+ * client's output buffer is full.  Only used if
+ * #client_output_spill_directory is set.
+ */
+extern size_t client_output_memory_limit;
+
+/**
+ * The number of threads which execute read-only commands (see
+ * #WorkerBackgroundCommand); 0 means they are executed in the main
+ * thread.
+ */
+extern unsigned client_command_threads;
+
+/**
+ * The number of threads which execute long-running commands such as
+ * "getfingerprint" (see #ThreadBackgroundCommand).
+ */
+extern unsigned client_background_threads;
+
 void
 client_manager_init(const ConfigData &config);
 
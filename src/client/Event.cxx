@@ -2,10 +2,15 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
+#include "BackgroundCommand.hxx"
 #include "Domain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "Log.hxx"
 
+#ifndef _WIN32
+#include "OutputSpill.hxx"
+#endif
+
 void
 Client::OnSocketError(std::exception_ptr ep) noexcept
 {
@@ -19,3 +24,19 @@ Client::OnSocketClosed() noexcept
 {
 	SetExpired();
 }
+
+void
+Client::OnSocketDrained() noexcept
+{
+#ifndef _WIN32
+	if (output_spill != nullptr && !output_spill->empty()) {
+		/* the background command will be notified when the
+		   spill file has been sent as well */
+		RefillOutput();
+		return;
+	}
+#endif
+
+	if (background_command)
+		background_command->OnOutputDrained();
+}
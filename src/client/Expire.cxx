@@ -4,7 +4,9 @@
 #include "Client.hxx"
 #include "BackgroundCommand.hxx"
 #include "Domain.hxx"
+#include "Config.hxx"
 #include "Log.hxx"
+#include "event/Loop.hxx"
 
 void
 Client::SetExpired() noexcept
@@ -21,6 +23,15 @@ Client::SetExpired() noexcept
 	timeout_event.Schedule(Event::Duration::zero());
 }
 
+void
+Client::RefreshTimeout() noexcept
+{
+	last_activity = GetEventLoop().SteadyNow();
+
+	if (!timeout_event.IsPending())
+		timeout_event.Schedule(client_timeout);
+}
+
 void
 Client::OnTimeout() noexcept
 {
@@ -28,6 +39,15 @@ Client::OnTimeout() noexcept
 		assert(!idle_waiting);
 		assert(!background_command);
 
+		const auto now = GetEventLoop().SteadyNow();
+		if (const auto due = last_activity + client_timeout;
+		    due > now) {
+			/* there was activity since the timer was
+			   scheduled */
+			timeout_event.Schedule(due - now);
+			return;
+		}
+
 		FmtDebug(client_domain, "[{}] timeout", num);
 	}
 
@@ -2,24 +2,48 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
-#include "Config.hxx"
 #include "Response.hxx"
 #include "protocol/IdleFlags.hxx"
 
-#include <fmt/format.h>
-
 #include <cassert>
+#include <string>
+#include <string_view>
 
-static void
-WriteIdleResponse(Response &r, unsigned flags) noexcept
+/**
+ * Format the "idle" response for the given flags.  The result is
+ * cached, because a broadcast usually sends the same response to
+ * many clients in a row.  This is only called in the main thread.
+ */
+static std::string_view
+GetIdleResponse(unsigned flags) noexcept
 {
-	const char *const*idle_names = idle_get_names();
-	for (unsigned i = 0; idle_names[i]; ++i) {
-		if (flags & (1 << i))
-			r.Fmt(FMT_STRING("changed: {}\n"), idle_names[i]);
+	static unsigned cached_flags = 0;
+	static std::string cached_response;
+
+	if (flags != cached_flags || cached_response.empty()) {
+		cached_response.clear();
+
+		const char *const*idle_names = idle_get_names();
+		for (unsigned i = 0; idle_names[i]; ++i) {
+			if (flags & (1 << i)) {
+				cached_response += "changed: ";
+				cached_response += idle_names[i];
+				cached_response += '\n';
+			}
+		}
+
+		cached_response += "OK\n";
+		cached_flags = flags;
 	}
 
-	r.Write("OK\n");
+	return cached_response;
+}
+
+static void
+WriteIdleResponse(Response &r, unsigned flags) noexcept
+{
+	const auto response = GetIdleResponse(flags);
+	r.Write(response.data(), response.size());
 }
 
 void
@@ -36,7 +60,7 @@ Client::IdleNotify() noexcept
 	Response r(*this, 0);
 	WriteIdleResponse(r, flags);
 
-	timeout_event.Schedule(client_timeout);
+	RefreshTimeout();
 }
 
 void
@@ -4,10 +4,13 @@
 #include "Listener.hxx"
 #include "Client.hxx"
 #include "Permission.hxx"
-#include "net/UniqueSocketDescriptor.hxx"
+#include "config/ThreadConfig.hxx"
 #include "net/SocketAddress.hxx"
 #include "config.h"
 
+#include <cassert>
+#include <stdexcept>
+
 static unsigned
 GetPermissions(SocketAddress address, int uid) noexcept
 {
@@ -27,12 +30,81 @@ GetPermissions(SocketAddress address, int uid) noexcept
 	return getDefaultPermissions();
 }
 
+ClientListener::~ClientListener() noexcept
+{
+	/* stop the threads before their listener sockets are
+	   closed; they cannot be closed from another thread while
+	   the EventLoop is running */
+	for (auto &thread : threads)
+		thread.Stop();
+
+	Close();
+}
+
+void
+ClientListener::AddThreads(unsigned n)
+{
+	assert(IsEmpty());
+
+#ifdef __linux__
+	if (n > 64)
+		throw std::runtime_error("Too many listener threads");
+
+	for (unsigned i = 0; i < n; ++i) {
+		auto &thread = threads.emplace_back();
+		thread.SetScheduling(GetThreadScheduling("io"));
+		AddReusePortLoop(thread.GetEventLoop());
+	}
+#else
+	if (n > 0)
+		throw std::runtime_error("Listener threads are only available on Linux");
+#endif
+}
+
+void
+ClientListener::StartThreads()
+{
+	for (auto &thread : threads)
+		thread.Start();
+}
+
+inline void
+ClientListener::OnInject() noexcept
+{
+	decltype(accepted) connections;
+
+	{
+		const std::scoped_lock protect{mutex};
+		connections.swap(accepted);
+	}
+
+	for (auto &i : connections)
+		client_new(GetEventLoop(), partition,
+			   std::move(i.fd), i.address, i.uid,
+			   i.permissions);
+}
+
 void
 ClientListener::OnAccept(UniqueSocketDescriptor fd,
 			 SocketAddress address, int uid) noexcept
 {
+	const unsigned permissions = GetPermissions(address, uid);
+
+	if (GetEventLoop().IsInside()) {
+		client_new(GetEventLoop(), partition,
+			   std::move(fd), address, uid, permissions);
+		return;
+	}
 
-	client_new(GetEventLoop(), partition,
-		   std::move(fd), address, uid,
-		   GetPermissions(address, uid));
+	/* accepted by one of the #threads: the #Client must be
+	   created in the main thread; all connections accepted
+	   until it wakes up are passed in one batch */
+	const std::scoped_lock protect{mutex};
+	accepted.push_back({
+		std::move(fd),
+		AllocatedSocketAddress{address},
+		uid,
+		permissions,
+	});
+	inject.Schedule();
 }
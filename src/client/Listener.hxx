@@ -5,17 +5,74 @@
 #define MPD_CLIENT_LISTENER_HXX
 
 #include "event/ServerSocket.hxx"
+#include "event/InjectEvent.hxx"
+#include "event/Thread.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "thread/Mutex.hxx"
+
+#include <list>
+#include <vector>
 
 struct Partition;
 
 class ClientListener final : public ServerSocket {
 	Partition &partition;
 
+	/**
+	 * Threads which accept connections on additional
+	 * SO_REUSEPORT listeners (setting "listen_threads").  The
+	 * #Client objects are still created in the main thread.
+	 */
+	std::list<EventThread> threads;
+
+	struct Accepted {
+		UniqueSocketDescriptor fd;
+		AllocatedSocketAddress address;
+		int uid;
+		unsigned permissions;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Connections accepted by the #threads which have not yet
+	 * been passed to client_new().  Protected by #mutex.
+	 */
+	std::vector<Accepted> accepted;
+
+	/**
+	 * Wakes up the main thread to create #Client objects for all
+	 * #accepted connections at once.
+	 */
+	InjectEvent inject;
+
 public:
 	ClientListener(EventLoop &_loop, Partition &_partition) noexcept
-		:ServerSocket(_loop), partition(_partition) {}
+		:ServerSocket(_loop), partition(_partition),
+		 inject(_loop, BIND_THIS_METHOD(OnInject)) {}
+
+	~ClientListener() noexcept;
+
+	/**
+	 * Create threads which accept connections on TCP listeners
+	 * besides the main thread (Linux only).  Must be called
+	 * before adding any address.
+	 *
+	 * Throws on error.
+	 */
+	void AddThreads(unsigned n);
+
+	/**
+	 * Start the threads created by AddThreads().  This is
+	 * separate from Open() because it must be called after
+	 * daemonizing.
+	 */
+	void StartThreads();
 
 private:
+	void OnInject() noexcept;
+
 	void OnAccept(UniqueSocketDescriptor fd,
 		      SocketAddress address, int uid) noexcept override;
 };
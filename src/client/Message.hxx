@@ -4,6 +4,7 @@
 #ifndef MPD_CLIENT_MESSAGE_HXX
 #define MPD_CLIENT_MESSAGE_HXX
 
+#include <memory>
 #include <string>
 
 #ifdef _WIN32
@@ -13,7 +14,8 @@
 #endif
 
 /**
- * A client-to-client message.
+ * A client-to-client message.  One instance is shared by all
+ * subscribers of the channel; see #ClientMessagePtr.
  */
 class ClientMessage {
 	std::string channel, message;
@@ -33,6 +35,8 @@ public:
 	}
 };
 
+using ClientMessagePtr = std::shared_ptr<const ClientMessage>;
+
 [[gnu::pure]]
 bool
 client_message_valid_channel_name(const char *name) noexcept;
@@ -6,6 +6,12 @@
 #include "Domain.hxx"
 #include "List.hxx"
 #include "BackgroundCommand.hxx"
+#ifdef ENABLE_ZLIB
+#include "Compressor.hxx"
+#endif
+#ifndef _WIN32
+#include "OutputSpill.hxx"
+#endif
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "lib/fmt/SocketAddressFormatter.hxx"
@@ -34,7 +40,7 @@ Client::Client(EventLoop &_loop, Partition &_partition,
 	 num(_num),
 	 last_album_art(_loop)
 {
-	timeout_event.Schedule(client_timeout);
+	RefreshTimeout();
 }
 
 void
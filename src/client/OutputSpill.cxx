@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "OutputSpill.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/SystemError.hxx"
+
+#include <cassert>
+#include <cerrno>
+#include <string>
+
+#include <fcntl.h>
+#include <stdlib.h> // for mkstemp()
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(O_TMPFILE)
+/* supported since Linux 3.11 */
+#define __O_TMPFILE 020000000
+#define O_TMPFILE (__O_TMPFILE | O_DIRECTORY)
+#endif
+
+static UniqueFileDescriptor
+OpenSpillFile(Path directory)
+{
+	UniqueFileDescriptor fd;
+
+#ifdef O_TMPFILE
+	/* try Linux's O_TMPFILE first; the file never gets a name */
+	if (fd.Open(directory.c_str(), O_TMPFILE|O_RDWR, 0600))
+		return fd;
+#endif
+
+	/* fall back to a named file which is unlinked right away */
+	auto path = directory / Path::FromFS("mpd-spill-XXXXXX");
+	std::string s = path.c_str();
+	int result = mkstemp(s.data());
+	if (result < 0)
+		throw FmtErrno("Failed to create temporary file in {:?}",
+			       directory);
+
+	fd = UniqueFileDescriptor{result};
+	unlink(s.c_str());
+	fd.EnableCloseOnExec();
+	return fd;
+}
+
+ClientOutputSpill::ClientOutputSpill(Path directory)
+	:fd(OpenSpillFile(directory))
+{
+}
+
+void
+ClientOutputSpill::Append(std::span<const std::byte> src)
+{
+	while (!src.empty()) {
+		const auto nbytes = fd.WriteAt(tail, src);
+		if (nbytes <= 0)
+			throw MakeErrno("Failed to write to spill file");
+
+		tail += nbytes;
+		src = src.subspan(nbytes);
+	}
+}
+
+std::size_t
+ClientOutputSpill::Read(std::span<std::byte> dest) const
+{
+	if (dest.size() > GetSize())
+		dest = dest.first(GetSize());
+
+	const auto nbytes = fd.ReadAt(head, dest);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to read from spill file");
+
+	return nbytes;
+}
+
+void
+ClientOutputSpill::Consume(std::size_t n) noexcept
+{
+	assert(n <= GetSize());
+
+	head += n;
+
+	if (empty()) {
+		/* start over at the beginning of the file and give
+		   the disk space back (errors are not fatal) */
+		head = tail = 0;
+		[[maybe_unused]] const int result = ftruncate(fd.Get(), 0);
+	}
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_CLIENT_OUTPUT_SPILL_HXX
+#define MPD_CLIENT_OUTPUT_SPILL_HXX
+
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+class Path;
+
+/**
+ * An unlinked temporary file which receives the output of a client
+ * that does not fit into its (memory) output buffer.  This allows
+ * large responses to slow clients without keeping them in memory.
+ */
+class ClientOutputSpill {
+	UniqueFileDescriptor fd;
+
+	/**
+	 * The file offset of the first byte which has not yet been
+	 * moved to the output buffer.
+	 */
+	uint_least64_t head = 0;
+
+	/**
+	 * The end of the data in the file.
+	 */
+	uint_least64_t tail = 0;
+
+public:
+	/**
+	 * Create the temporary file.
+	 *
+	 * Throws on error.
+	 *
+	 * @param directory the directory where the file is created
+	 */
+	explicit ClientOutputSpill(Path directory);
+
+	bool empty() const noexcept {
+		return head == tail;
+	}
+
+	uint_least64_t GetSize() const noexcept {
+		return tail - head;
+	}
+
+	/**
+	 * Append data to the end of the file.
+	 *
+	 * Throws on error.
+	 */
+	void Append(std::span<const std::byte> src);
+
+	/**
+	 * Read data from the beginning of the file, without removing
+	 * it; call Consume() after it has been moved to the output
+	 * buffer.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the number of bytes read
+	 */
+	std::size_t Read(std::span<std::byte> dest) const;
+
+	/**
+	 * Remove data from the beginning of the file.  Once the file
+	 * is empty, it is truncated to give the disk space back.
+	 */
+	void Consume(std::size_t n) noexcept;
+};
+
+#endif
@@ -5,9 +5,13 @@
 #include "Config.hxx"
 #include "Domain.hxx"
 #include "command/AllCommands.hxx"
+#include "BulkEdit.hxx"
 #include "Log.hxx"
 #include "util/StringAPI.hxx"
 #include "util/CharUtil.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <optional>
 
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
@@ -15,15 +19,31 @@
 
 inline CommandResult
 Client::ProcessCommandList(bool list_ok,
-			   std::list<std::string> &&list) noexcept
+			   CommandList &list) noexcept
 {
-	unsigned n = 0;
+	in_command_list = true;
+	AtScopeExit(this) { in_command_list = false; };
+
+	/* the whole list is one bulk edit: the queue version is
+	   incremented and the "playlist" idle event is emitted only
+	   once, no matter how many commands modify the queue */
+	std::optional<ScopeBulkEdit> bulk_edit;
+	bulk_edit.emplace(GetPartition());
+
+	for (unsigned n = 0; n < list.size(); ++n) {
+		if (&bulk_edit->GetPartition() != &GetPartition()) {
+			/* the "partition" command has switched to
+			   another partition; commit now, because the
+			   old one may be deleted by the next
+			   command */
+			bulk_edit.reset();
+			bulk_edit.emplace(GetPartition());
+		}
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+		char *cmd = list[n];
 
 		FmtDebug(client_domain, "process command {:?}", cmd);
-		auto ret = command_process(*this, n++, cmd);
+		auto ret = command_process(*this, n, cmd);
 		FmtDebug(client_domain, "command returned {}", unsigned(ret));
 		if (IsExpired())
 			return CommandResult::CLOSE;
@@ -84,8 +104,8 @@ Client::ProcessLine(char *line) noexcept
 			auto list = cmd_list.Commit();
 			cmd_list.Reset();
 
-			auto ret = ProcessCommandList(ok_mode,
-						      std::move(list));
+			auto ret = ProcessCommandList(ok_mode, list);
+			cmd_list.Recycle(std::move(list));
 			FmtDebug(client_domain,
 				 "[{}] process command "
 				 "list returned {}", id, unsigned(ret));
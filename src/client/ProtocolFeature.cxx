@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "ProtocolFeature.hxx"
 #include "Client.hxx"
 #include "Response.hxx"
@@ -18,6 +19,8 @@ struct feature_type_table {
 
 static constexpr struct feature_type_table protocol_feature_names_init[] = {
 	{"hide_playlists_in_root", PF_HIDE_PLAYLISTS_IN_ROOT},
+	{"compression", PF_COMPRESSION},
+	{"binary_songs", PF_BINARY_SONGS},
 };
 
 /**
@@ -56,8 +59,14 @@ protocol_features_print(Client &client, Response &r) noexcept
 void
 protocol_features_print_all(Response &r) noexcept
 {
-	for (unsigned i = 0; i < PF_NUM_OF_ITEM_TYPES; i++)
+	for (unsigned i = 0; i < PF_NUM_OF_ITEM_TYPES; i++) {
+#ifndef ENABLE_ZLIB
+		if (i == PF_COMPRESSION)
+			continue;
+#endif
+
 		r.Fmt(FMT_STRING("feature: {}\n"), protocol_feature_names[i]);
+	}
 }
 
 ProtocolFeatureType
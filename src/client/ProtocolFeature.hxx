@@ -14,6 +14,8 @@ class Response;
  */
 enum ProtocolFeatureType : uint8_t {
 	PF_HIDE_PLAYLISTS_IN_ROOT,
+	PF_COMPRESSION,
+	PF_BINARY_SONGS,
 
 	PF_NUM_OF_ITEM_TYPES
 };
@@ -2,7 +2,6 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
-#include "Config.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "util/StringStrip.hxx"
@@ -16,47 +15,64 @@ Client::OnSocketInput(std::span<std::byte> src) noexcept
 		return InputResult::PAUSE;
 
 	char *p = (char *)src.data();
+	char *const input_end = p + src.size();
 	char *newline = (char *)std::memchr(p, '\n', src.size());
 	if (newline == nullptr)
 		return InputResult::MORE;
 
-	timeout_event.Schedule(client_timeout);
+	RefreshTimeout();
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+	/* execute all complete lines which are already in the input
+	   buffer back to back; the responses are collected in the
+	   output buffer, which gets flushed only once by
+	   FullyBufferedSocket's IdleEvent */
 
-	/* skip whitespace at the end of the line */
-	char *end = StripRight(p, newline);
+	do {
+		BufferedSocket::ConsumeInput(newline + 1 - p);
 
-	/* terminate the string at the end of the line */
-	*end = 0;
+		/* skip whitespace at the end of the line */
+		char *end = StripRight(p, newline);
 
-	CommandResult result = ProcessLine(p);
-	switch (result) {
-	case CommandResult::OK:
-	case CommandResult::IDLE:
-	case CommandResult::BACKGROUND:
-	case CommandResult::ERROR:
-		break;
+		/* terminate the string at the end of the line */
+		*end = 0;
 
-	case CommandResult::KILL:
-		partition->instance.Break();
-		Close();
-		return InputResult::CLOSED;
+		CommandResult result = ProcessLine(p);
+		switch (result) {
+		case CommandResult::OK:
+		case CommandResult::IDLE:
+		case CommandResult::BACKGROUND:
+		case CommandResult::ERROR:
+			break;
 
-	case CommandResult::FINISH:
-		if (Flush())
+		case CommandResult::KILL:
+			partition->instance.Break();
 			Close();
-		return InputResult::CLOSED;
+			return InputResult::CLOSED;
 
-	case CommandResult::CLOSE:
-		Close();
-		return InputResult::CLOSED;
-	}
+		case CommandResult::FINISH:
+			if (Flush())
+				Close();
+			return InputResult::CLOSED;
 
-	if (IsExpired()) {
-		Close();
-		return InputResult::CLOSED;
-	}
+		case CommandResult::CLOSE:
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		if (IsExpired()) {
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		UpdateCompression();
+
+		if (background_command)
+			/* wait for OnBackgroundCommandFinished() */
+			return InputResult::PAUSE;
+
+		p = newline + 1;
+		newline = (char *)std::memchr(p, '\n', input_end - p);
+	} while (newline != nullptr);
 
 	return InputResult::AGAIN;
 }
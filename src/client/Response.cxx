@@ -6,22 +6,43 @@
 
 #include <fmt/format.h>
 
+#include <cstring>
+#include <stdexcept>
+
 TagMask
 Response::GetTagMask() const noexcept
 {
 	return GetClient().tag_mask;
 }
 
+bool
+Response::WantBinarySongs() const noexcept
+{
+	return GetClient().GetProtocolFeatures().Test(PF_BINARY_SONGS);
+}
+
+void
+Response::CheckCancel() const
+{
+	if (sink != nullptr && sink->IsCancelled())
+		throw std::runtime_error("Cancelled");
+}
+
 bool
 Response::Write(const void *data, size_t length) noexcept
 {
+	bytes_written += length;
+
+	if (sink != nullptr)
+		return sink->Write({(const std::byte *)data, length});
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data) noexcept
 {
-	return client.Write(data);
+	return Write(data, std::strlen(data));
 }
 
 bool
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "protocol/Ack.hxx"
+#include "tag/Mask.hxx"
 
 #include <fmt/core.h>
 
@@ -11,11 +12,33 @@
 #include <span>
 
 class Client;
-class TagMask;
+
+/**
+ * An alternative destination for a #Response instead of the
+ * #Client's output buffer.  This is used to generate a response in
+ * another thread (see #StreamBackgroundCommand).
+ */
+class ResponseSink {
+public:
+	/**
+	 * @return false if the data was discarded because the
+	 * response has been cancelled
+	 */
+	virtual bool Write(std::span<const std::byte> src) noexcept = 0;
+
+	[[gnu::pure]]
+	virtual bool IsCancelled() const noexcept = 0;
+};
 
 class Response {
 	Client &client;
 
+	/**
+	 * If not nullptr, then all output goes here instead of the
+	 * #Client.
+	 */
+	ResponseSink *const sink = nullptr;
+
 	/**
 	 * This command's index in the command list.  Used to generate
 	 * error messages.
@@ -27,10 +50,34 @@ class Response {
 	 */
 	const char *command = "";
 
+	/**
+	 * The tag types whose names have already been sent in this
+	 * response (protocol feature "binary_songs").
+	 */
+	TagMask binary_tag_names = TagMask::None();
+
+	/**
+	 * The number of bytes written so far (for command tracing).
+	 */
+	std::size_t bytes_written = 0;
+
 public:
 	Response(Client &_client, unsigned _list_index) noexcept
 		:client(_client), list_index(_list_index) {}
 
+	Response(Client &_client, unsigned _list_index,
+		 ResponseSink &_sink) noexcept
+		:client(_client), sink(&_sink), list_index(_list_index) {}
+
+	/**
+	 * Construct a response which shares the settings of the given
+	 * one, but writes to a different #ResponseSink.  This is used
+	 * to generate parts of a response in other threads.
+	 */
+	Response(const Response &parent, ResponseSink &_sink) noexcept
+		:client(parent.client), sink(&_sink),
+		 list_index(parent.list_index), command(parent.command) {}
+
 	Response(const Response &) = delete;
 	Response &operator=(const Response &) = delete;
 
@@ -51,10 +98,43 @@ public:
 	[[gnu::pure]]
 	TagMask GetTagMask() const noexcept;
 
+	std::size_t GetBytesWritten() const noexcept {
+		return bytes_written;
+	}
+
 	void SetCommand(const char *_command) noexcept {
 		command = _command;
 	}
 
+	/**
+	 * Shall songs be sent in the binary encoding (protocol
+	 * feature "binary_songs", see BinarySongPrint.hxx)?
+	 */
+	[[gnu::pure]]
+	bool WantBinarySongs() const noexcept;
+
+	/**
+	 * Remember that the name of the specified tag type is being
+	 * sent in this response (for the binary song encoding).
+	 *
+	 * @return true if the name has not been sent before
+	 */
+	bool AnnounceBinaryTag(TagType type) noexcept {
+		if (binary_tag_names.Test(type))
+			return false;
+
+		binary_tag_names.Set(type);
+		return true;
+	}
+
+	/**
+	 * Throws if this response has been cancelled (because the
+	 * client has disconnected) while being generated by a
+	 * #ResponseSink.  Long-running generators such as database
+	 * visitors should call this periodically.
+	 */
+	void CheckCancel() const;
+
 	bool Write(const void *data, size_t length) noexcept;
 	bool Write(const char *data) noexcept;
 
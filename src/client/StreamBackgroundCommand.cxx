@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "StreamBackgroundCommand.hxx"
+#include "Client.hxx"
+#include "command/CommandError.hxx"
+#include "util/SpanCast.hxx"
+
+StreamBackgroundCommand::StreamBackgroundCommand(Client &_client) noexcept
+	:thread(BIND_THIS_METHOD(_Run)),
+	 inject_event(_client.GetEventLoop(), BIND_THIS_METHOD(OnInject)),
+	 client(_client)
+{
+}
+
+void
+StreamBackgroundCommand::_Run() noexcept
+{
+	assert(!error);
+
+	try {
+		Response response(client, 0, *this);
+		Generate(response);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	{
+		const std::scoped_lock lock{mutex};
+		finished = true;
+	}
+
+	inject_event.Schedule();
+}
+
+bool
+StreamBackgroundCommand::Write(std::span<const std::byte> src) noexcept
+{
+	std::unique_lock lock{mutex};
+	cond.wait(lock, [this]{
+		return cancelled || buffer.size() < BUFFER_SIZE;
+	});
+
+	if (cancelled)
+		return false;
+
+	const bool was_empty = buffer.empty();
+	buffer.append(ToStringView(src));
+	lock.unlock();
+
+	if (was_empty)
+		inject_event.Schedule();
+
+	return true;
+}
+
+bool
+StreamBackgroundCommand::IsCancelled() const noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return cancelled;
+}
+
+void
+StreamBackgroundCommand::OnInject() noexcept
+{
+	Transfer();
+}
+
+void
+StreamBackgroundCommand::OnOutputDrained() noexcept
+{
+	Transfer();
+}
+
+inline void
+StreamBackgroundCommand::Transfer() noexcept
+{
+	if (!client.IsOutputEmpty())
+		/* wait for OnOutputDrained() */
+		return;
+
+	bool _finished;
+
+	{
+		const std::scoped_lock lock{mutex};
+		transfer.clear();
+		transfer.swap(buffer);
+		_finished = finished;
+	}
+
+	/* wake up the thread if it is waiting for buffer space */
+	cond.notify_one();
+
+	if (!transfer.empty() && !client.Write(transfer))
+		/* the client is gone, and this object has probably
+		   been deleted already */
+		return;
+
+	if (_finished)
+		Finish();
+}
+
+inline void
+StreamBackgroundCommand::Finish() noexcept
+{
+	/* free the Thread */
+	thread.Join();
+
+	Response response(client, 0);
+
+	if (error)
+		PrintError(response, error);
+	else
+		client.WriteOK();
+
+	/* delete this object */
+	client.OnBackgroundCommandFinished();
+}
+
+void
+StreamBackgroundCommand::Cancel() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		cancelled = true;
+	}
+
+	cond.notify_one();
+	thread.Join();
+
+	/* cancel the InjectEvent, just in case the Thread has
+	   meanwhile finished execution */
+	inject_event.Cancel();
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_STREAM_BACKGROUND_COMMAND_HXX
+#define MPD_STREAM_BACKGROUND_COMMAND_HXX
+
+#include "BackgroundCommand.hxx"
+#include "Response.hxx"
+#include "event/InjectEvent.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <exception>
+#include <string>
+
+class Client;
+
+/**
+ * A #BackgroundCommand which generates a (possibly huge) response in
+ * a new thread and streams it to the client through a bounded
+ * buffer.  When the buffer is full, the thread blocks until the
+ * client has received the data, i.e. generation pauses and resumes
+ * with socket writability.  This avoids holding the whole response
+ * in the client's output buffer.
+ */
+class StreamBackgroundCommand : public BackgroundCommand, ResponseSink {
+	/**
+	 * Generate() blocks as soon as the buffer has reached this
+	 * size.
+	 */
+	static constexpr std::size_t BUFFER_SIZE = 64 * 1024;
+
+	Thread thread;
+	InjectEvent inject_event;
+	Client &client;
+
+	/**
+	 * Protects #buffer, #finished and #cancelled.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * Signalled when space in #buffer becomes available or when
+	 * #cancelled is set.
+	 */
+	Cond cond;
+
+	/**
+	 * Data generated by the thread which has not yet been
+	 * submitted to the client.
+	 */
+	std::string buffer;
+
+	/**
+	 * Used by the #EventLoop thread to move data out of #buffer.
+	 * It is a member to be able to reuse its allocation.
+	 */
+	std::string transfer;
+
+	/**
+	 * The error thrown by Generate().
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Has Generate() returned?
+	 */
+	bool finished = false;
+
+	/**
+	 * Has Cancel() been called?
+	 */
+	bool cancelled = false;
+
+public:
+	explicit StreamBackgroundCommand(Client &_client) noexcept;
+
+	void Start() {
+		thread.Start();
+	}
+
+	/* virtual methods from class BackgroundCommand */
+	void Cancel() noexcept final;
+	void OnOutputDrained() noexcept final;
+
+private:
+	void _Run() noexcept;
+	void OnInject() noexcept;
+
+	/**
+	 * Move data from #buffer to the client, but only if the
+	 * client's output buffer is empty; and finish the command
+	 * after the thread has finished.
+	 */
+	void Transfer() noexcept;
+
+	void Finish() noexcept;
+
+	/* virtual methods from class ResponseSink */
+	bool Write(std::span<const std::byte> src) noexcept override;
+	bool IsCancelled() const noexcept override;
+
+protected:
+	/**
+	 * Generate the response.  This runs in a separate thread.
+	 * The #Response must not be used to send errors; throw an
+	 * exception instead.  Implementations should call
+	 * Response::CheckCancel() periodically.
+	 */
+	virtual void Generate(Response &response) = 0;
+};
+
+#endif
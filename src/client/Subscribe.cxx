@@ -56,10 +56,10 @@ Client::UnsubscribeAll() noexcept
 }
 
 bool
-Client::PushMessage(const ClientMessage &msg) noexcept
+Client::PushMessage(const ClientMessagePtr &msg) noexcept
 {
 	if (messages.size() >= MAX_MESSAGES ||
-	    !IsSubscribed(msg.GetChannel()))
+	    !IsSubscribed(msg->GetChannel()))
 		return false;
 
 	if (messages.empty())
@@ -6,32 +6,46 @@
 #include "Response.hxx"
 #include "command/CommandError.hxx"
 
-ThreadBackgroundCommand::ThreadBackgroundCommand(Client &_client) noexcept
-	:thread(BIND_THIS_METHOD(_Run)),
+ThreadBackgroundCommand::ThreadBackgroundCommand(Client &_client,
+						 WorkerPriority _priority) noexcept
+	:pool(_client.GetBackgroundPool()),
 	 defer_finish(_client.GetEventLoop(), BIND_THIS_METHOD(DeferredFinish)),
-	 client(_client)
+	 client(_client), priority(_priority)
 {
 }
 
 void
-ThreadBackgroundCommand::_Run() noexcept
+ThreadBackgroundCommand::Run() noexcept
 {
 	assert(!error);
 
 	try {
-		Run();
+		RunThread();
 	} catch (...) {
 		error = std::current_exception();
 	}
 
 	defer_finish.Schedule();
+
+	/* notify Cancel() while holding the lock, because this
+	   object may be deleted as soon as the lock is released */
+	const std::scoped_lock lock{finish_mutex};
+	finished = true;
+	finish_cond.notify_one();
+}
+
+inline void
+ThreadBackgroundCommand::WaitFinished() noexcept
+{
+	std::unique_lock lock{finish_mutex};
+	finish_cond.wait(lock, [this]{ return finished; });
 }
 
 void
 ThreadBackgroundCommand::DeferredFinish() noexcept
 {
-	/* free the Thread */
-	thread.Join();
+	/* the worker thread may not have released the lock yet */
+	WaitFinished();
 
 	/* send the response */
 	Response response(client, 0);
@@ -50,10 +64,13 @@ ThreadBackgroundCommand::DeferredFinish() noexcept
 void
 ThreadBackgroundCommand::Cancel() noexcept
 {
-	CancelThread();
-	thread.Join();
+	if (!pool.Cancel(*this)) {
+		/* already running: wait for it to finish */
+		CancelThread();
+		WaitFinished();
+	}
 
-	/* cancel the InjectEvent, just in case the Thread has
+	/* cancel the InjectEvent, just in case the worker has
 	   meanwhile finished execution */
 	defer_finish.Cancel();
 }
@@ -6,7 +6,9 @@
 
 #include "BackgroundCommand.hxx"
 #include "event/InjectEvent.hxx"
-#include "thread/Thread.hxx"
+#include "thread/WorkerPool.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 
 #include <exception>
 
@@ -14,46 +16,68 @@ class Client;
 class Response;
 
 /**
- * A #BackgroundCommand which defers execution into a new thread.
+ * A #BackgroundCommand which defers execution into a thread of the
+ * shared background #WorkerPool (see Client::GetBackgroundPool()).
  */
-class ThreadBackgroundCommand : public BackgroundCommand {
-	Thread thread;
+class ThreadBackgroundCommand : public BackgroundCommand, WorkerJob {
+	WorkerPool &pool;
 	InjectEvent defer_finish;
 	Client &client;
 
+	const WorkerPriority priority;
+
+	/**
+	 * Protects #finished.
+	 */
+	Mutex finish_mutex;
+
+	/**
+	 * Signalled when #finished is set.
+	 */
+	Cond finish_cond;
+
 	/**
 	 * The error thrown by Run().
 	 */
 	std::exception_ptr error;
 
+	/**
+	 * Has Run() returned?
+	 */
+	bool finished = false;
+
 public:
-	explicit ThreadBackgroundCommand(Client &_client) noexcept;
+	explicit ThreadBackgroundCommand(Client &_client,
+					 WorkerPriority _priority=WorkerPriority::NORMAL) noexcept;
 
 	auto &GetEventLoop() const noexcept {
 		return defer_finish.GetEventLoop();
 	}
 
-	void Start() {
-		thread.Start();
+	void Start() noexcept {
+		pool.Push(*this, priority);
 	}
 
 	void Cancel() noexcept final;
 
 private:
-	void _Run() noexcept;
+	void WaitFinished() noexcept;
 	void DeferredFinish() noexcept;
 
+	/* virtual methods from class WorkerJob */
+	void Run() noexcept final;
+
 protected:
 	/**
 	 * If this method throws, the exception will be converted to a
 	 * MPD response, and SendResponse() will not be called.
 	 */
-	virtual void Run() = 0;
+	virtual void RunThread() = 0;
 
 	/**
-	 * Send the response after Run() has finished.  Note that you
-	 * must not send errors here; if an error occurs, Run() should
-	 * throw an exception instead.
+	 * Send the response after RunThread() has finished.  Note
+	 * that you must not send errors here; if an error occurs,
+	 * RunThread() should throw an exception instead.
 	 */
 	virtual void SendResponse(Response &response) noexcept = 0;
 
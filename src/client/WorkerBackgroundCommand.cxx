@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "WorkerBackgroundCommand.hxx"
+#include "Client.hxx"
+#include "Domain.hxx"
+#include "command/CommandError.hxx"
+#include "util/SpanCast.hxx"
+#include "Log.hxx"
+
+WorkerBackgroundCommand::WorkerBackgroundCommand(Client &_client,
+						 WorkerPool &_pool,
+						 const char *_command) noexcept
+	:pool(_pool),
+	 defer_finish(_client.GetEventLoop(), BIND_THIS_METHOD(DeferredFinish)),
+	 client(_client), command(_command)
+{
+}
+
+void
+WorkerBackgroundCommand::Run() noexcept
+{
+	assert(!error);
+
+	try {
+		Response response(client, 0, *this);
+		response.SetCommand(command);
+		success = Generate(response);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	defer_finish.Schedule();
+
+	/* notify Cancel() while holding the lock, because this
+	   object may be deleted as soon as the lock is released */
+	const std::scoped_lock lock{mutex};
+	finished = true;
+	cond.notify_one();
+}
+
+bool
+WorkerBackgroundCommand::Write(std::span<const std::byte> src) noexcept
+{
+	if (overflow || cancelled)
+		return false;
+
+	if (buffer.size() + src.size() > client.GetOutputMaxSize()) {
+		/* same as FullyBufferedSocket::Write() would do if
+		   this command were executed synchronously */
+		overflow = true;
+		return false;
+	}
+
+	buffer.append(ToStringView(src));
+	return true;
+}
+
+bool
+WorkerBackgroundCommand::IsCancelled() const noexcept
+{
+	return cancelled;
+}
+
+inline void
+WorkerBackgroundCommand::WaitFinished() noexcept
+{
+	std::unique_lock lock{mutex};
+	cond.wait(lock, [this]{ return finished; });
+}
+
+void
+WorkerBackgroundCommand::DeferredFinish() noexcept
+{
+	/* the worker thread may not have released the lock yet */
+	WaitFinished();
+
+	if (overflow) {
+		LogWarning(client_domain, "Output buffer is full");
+		client.SetExpired();
+
+		/* delete this object */
+		client.OnBackgroundCommandFinished();
+		return;
+	}
+
+	/* send the response */
+	Response response(client, 0);
+	response.SetCommand(command);
+
+	if (!buffer.empty())
+		client.Write(buffer);
+
+	if (error) {
+		PrintError(response, error);
+	} else if (success) {
+		SendResponse(response);
+		client.WriteOK();
+	}
+
+	/* delete this object */
+	client.OnBackgroundCommandFinished();
+}
+
+void
+WorkerBackgroundCommand::Cancel() noexcept
+{
+	if (!pool.Cancel(*this)) {
+		/* already running: wait for it to finish */
+		cancelled = true;
+		WaitFinished();
+	}
+
+	/* cancel the InjectEvent, just in case the worker has
+	   meanwhile finished execution */
+	defer_finish.Cancel();
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_WORKER_BACKGROUND_COMMAND_HXX
+#define MPD_WORKER_BACKGROUND_COMMAND_HXX
+
+#include "BackgroundCommand.hxx"
+#include "Response.hxx"
+#include "event/InjectEvent.hxx"
+#include "thread/WorkerPool.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <atomic>
+#include <exception>
+#include <string>
+
+class Client;
+
+/**
+ * A #BackgroundCommand which is executed by a shared #WorkerPool
+ * instead of a new thread.  This is meant for read-only commands
+ * which may block for a while (e.g. on a database query or on file
+ * I/O) and which shall not stall the #EventLoop for all other
+ * clients.
+ *
+ * The response generated by the worker thread is collected in a
+ * buffer and submitted to the client from inside the client's
+ * #EventLoop thread.
+ */
+class WorkerBackgroundCommand
+	: public BackgroundCommand, WorkerJob, ResponseSink {
+
+	WorkerPool &pool;
+	InjectEvent defer_finish;
+	Client &client;
+
+	/**
+	 * The command name for error messages.
+	 */
+	const char *const command;
+
+	/**
+	 * Protects #finished.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled when #finished is set.
+	 */
+	Cond cond;
+
+	/**
+	 * The response generated by Generate().
+	 */
+	std::string buffer;
+
+	/**
+	 * The error thrown by Generate().
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Has Generate() returned?
+	 */
+	bool finished = false;
+
+	/**
+	 * The return value of Generate().
+	 */
+	bool success = false;
+
+	/**
+	 * Has the response exceeded the client's output buffer
+	 * limit?
+	 */
+	bool overflow = false;
+
+	/**
+	 * Has Cancel() been called?  This is polled by the worker
+	 * thread through Response::CheckCancel().
+	 */
+	std::atomic_bool cancelled{false};
+
+public:
+	/**
+	 * @param _command the command name (for error messages); the
+	 * string must remain valid for the lifetime of this object
+	 */
+	WorkerBackgroundCommand(Client &_client, WorkerPool &_pool,
+				const char *_command) noexcept;
+
+	void Start() noexcept {
+		pool.Push(*this);
+	}
+
+	/* virtual methods from class BackgroundCommand */
+	void Cancel() noexcept final;
+
+private:
+	void WaitFinished() noexcept;
+	void DeferredFinish() noexcept;
+
+	/* virtual methods from class WorkerJob */
+	void Run() noexcept final;
+
+	/* virtual methods from class ResponseSink */
+	bool Write(std::span<const std::byte> src) noexcept override;
+	bool IsCancelled() const noexcept override;
+
+protected:
+	/**
+	 * Generate the response.  This runs in a worker thread and
+	 * must not modify shared state (partitions, the queue, ...).
+	 *
+	 * If this method throws, the exception will be converted to
+	 * a MPD response, and SendResponse() will not be called.
+	 *
+	 * @return true on success, false if an error response has
+	 * been written
+	 */
+	virtual bool Generate(Response &response) = 0;
+
+	/**
+	 * Append more data to the response from inside the
+	 * #EventLoop thread after Generate() has returned true.
+	 */
+	virtual void SendResponse([[maybe_unused]] Response &response) noexcept {}
+};
+
+#endif
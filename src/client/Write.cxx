@@ -2,6 +2,24 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
+#include "Config.hxx"
+#include "Domain.hxx"
+#include "Log.hxx"
+
+#ifndef _WIN32
+#include "OutputSpill.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/PeakBuffer.hxx"
+#endif
+
+#ifdef ENABLE_ZLIB
+#include "Compressor.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#endif
+
+#include <array>
+#include <cassert>
+#include <stdexcept>
 
 #include <string.h>
 
@@ -9,5 +27,152 @@ bool
 Client::Write(const void *data, size_t length) noexcept
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+#ifdef ENABLE_ZLIB
+	if (compressor) {
+		if (!compressor->Compress({(const std::byte *)data, length})) {
+			SetExpired();
+			return false;
+		}
+
+		return true;
+	}
+#endif
+
+	return WriteOutput({(const std::byte *)data, length});
+}
+
+#ifndef _WIN32
+
+/**
+ * Do the peak output buffers of all clients together exceed the
+ * configured limit?
+ */
+[[gnu::pure]]
+static bool
+IsOutputMemoryExhausted() noexcept
+{
+	return client_output_memory_limit > 0 &&
+		PeakBuffer::GetTotalPeakSize() >= client_output_memory_limit;
+}
+
+#endif
+
+bool
+Client::WriteOutput(std::span<const std::byte> src) noexcept
+{
+#ifndef _WIN32
+	if (!client_output_spill_directory.IsNull()) {
+		/* once data has been spilled, everything else goes
+		   to the spill file as well to preserve the order */
+		if ((output_spill == nullptr || output_spill->empty()) &&
+		    /* an empty output buffer may always be filled,
+		       or there would be nothing to wait for */
+		    (FullyBufferedSocket::IsOutputEmpty() ||
+		     !IsOutputMemoryExhausted()) &&
+		    FullyBufferedSocket::TryWrite(src))
+			return true;
+
+		return SpillOutput(src);
+	}
+#endif
+
+	return FullyBufferedSocket::Write(src.data(), src.size());
+}
+
+#ifndef _WIN32
+
+bool
+Client::SpillOutput(std::span<const std::byte> src) noexcept
+try {
+	if (output_spill == nullptr)
+		output_spill = std::make_unique<ClientOutputSpill>(client_output_spill_directory);
+
+	if (output_spill->GetSize() + src.size() > client_max_output_spill_size)
+		throw std::runtime_error("Output spill file is full");
+
+	output_spill->Append(src);
+
+	if (FullyBufferedSocket::IsOutputEmpty())
+		/* OnSocketDrained() will not be called, so start
+		   moving data back right now */
+		return RefillOutput();
+
+	return true;
+} catch (...) {
+	OnSocketError(std::current_exception());
+	return false;
+}
+
+bool
+Client::RefillOutput() noexcept
+try {
+	assert(output_spill != nullptr);
+
+	/* move only a limited amount per call, so slow clients
+	   don't grow their peak buffers */
+	static constexpr std::size_t MAX_REFILL = 64 * 1024;
+
+	std::array<std::byte, 16384> buffer;
+
+	for (std::size_t total = 0;
+	     total < MAX_REFILL && !output_spill->empty();) {
+		const std::size_t nbytes = output_spill->Read(buffer);
+		if (nbytes == 0)
+			throw std::runtime_error("Spill file is truncated");
+
+		if (!FullyBufferedSocket::TryWrite(std::span{buffer}.first(nbytes)))
+			break;
+
+		output_spill->Consume(nbytes);
+		total += nbytes;
+	}
+
+	return true;
+} catch (...) {
+	OnSocketError(std::current_exception());
+	return false;
+}
+
+#endif
+
+bool
+Client::IsOutputEmpty() const noexcept
+{
+#ifndef _WIN32
+	if (output_spill != nullptr && !output_spill->empty())
+		return false;
+#endif
+
+	return FullyBufferedSocket::IsOutputEmpty();
+}
+
+void
+Client::UpdateCompression() noexcept
+{
+#ifdef ENABLE_ZLIB
+	const bool enabled = protocol_feature.Test(PF_COMPRESSION);
+	if (enabled == (compressor != nullptr))
+		return;
+
+	if (enabled) {
+		try {
+			compressor = std::make_unique<ClientCompressor>(GetEventLoop(),
+									BIND_THIS_METHOD(WriteUncompressed));
+		} catch (...) {
+			FmtError(client_domain,
+				 "[{}] failed to enable compression: {}",
+				 num, std::current_exception());
+			protocol_feature.Unset(PF_COMPRESSION);
+		}
+	} else {
+		const bool success = compressor->Finish();
+		compressor.reset();
+
+		if (!success)
+			SetExpired();
+	}
+#endif
 }
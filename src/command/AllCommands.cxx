@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "AllCommands.hxx"
+#include "Trace.hxx"
 #include "CommandError.hxx"
 #include "Request.hxx"
 #include "QueueCommands.hxx"
@@ -25,18 +26,30 @@
 #include "Instance.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/WorkerBackgroundCommand.hxx"
+#include "metrics/Histogram.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/StaticVector.hxx"
 #include "util/StringAPI.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/djb_hash.hxx"
 
 #ifdef ENABLE_SQLITE
 #include "StickerCommands.hxx"
+#include "AnalysisCommands.hxx"
 #endif
 
 #include <fmt/format.h>
 
+#include <array>
+#include <bit>
 #include <cassert>
+#include <chrono>
 #include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include <string.h>
 
@@ -55,6 +68,14 @@ struct command {
 	int min;
 	int max;
 	CommandResult (*handler)(Client &client, Request request, Response &response);
+
+	/**
+	 * May this command be executed by a
+	 * #WorkerBackgroundCommand?  This requires that the handler
+	 * only reads from the database, the storage or files, but
+	 * does not access any partition or queue.
+	 */
+	bool worker = false;
 };
 
 /* don't be fooled, this is the command handler for "commands" command */
@@ -73,7 +94,10 @@ static constexpr struct command commands[] = {
 	{ "add", PERMISSION_ADD, 1, 2, handle_add },
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
-	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
+	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art, true },
+#ifdef ENABLE_SQLITE
+	{ "analyze", PERMISSION_ADMIN, 0, 1, handle_analyze },
+#endif
 	{ "binarylimit", PERMISSION_NONE, 1, 1, handle_binary_limit },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_PLAYER, 0, 0, handle_clear },
@@ -81,14 +105,16 @@ static constexpr struct command commands[] = {
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+	{ "commandtraces", PERMISSION_ADMIN, 0, 0, handle_commandtraces },
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_PLAYER, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
-	{ "count", PERMISSION_READ, 1, -1, handle_count },
+	{ "count", PERMISSION_READ, 1, -1, handle_count, true },
 #endif
 	{ "crossfade", PERMISSION_PLAYER, 1, 1, handle_crossfade },
 	{ "currentsong", PERMISSION_READ, 0, 0, handle_currentsong },
 	{ "decoders", PERMISSION_READ, 0, 0, handle_decoders },
+	{ "decoderstats", PERMISSION_READ, 0, 0, handle_decoderstats },
 	{ "delete", PERMISSION_PLAYER, 1, 1, handle_delete },
 	{ "deleteid", PERMISSION_PLAYER, 1, 1, handle_deleteid },
 	{ "delpartition", PERMISSION_ADMIN, 1, 1, handle_delpartition },
@@ -105,11 +131,11 @@ static constexpr struct command commands[] = {
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
 #ifdef ENABLE_DATABASE
-	{ "list", PERMISSION_READ, 1, -1, handle_list },
+	{ "list", PERMISSION_READ, 1, -1, handle_list, true },
 	{ "listall", PERMISSION_READ, 0, 1, handle_listall },
 	{ "listallinfo", PERMISSION_READ, 0, 1, handle_listallinfo },
 #endif
-	{ "listfiles", PERMISSION_READ, 0, 1, handle_listfiles },
+	{ "listfiles", PERMISSION_READ, 0, 1, handle_listfiles, true },
 #ifdef ENABLE_DATABASE
 	{ "listmounts", PERMISSION_READ, 0, 0, handle_listmounts },
 #endif
@@ -121,7 +147,8 @@ static constexpr struct command commands[] = {
 	{ "listplaylistinfo", PERMISSION_READ, 1, 2, handle_listplaylistinfo },
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 3, handle_load },
-	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo, true },
+	{ "memstats", PERMISSION_READ, 0, 0, handle_memstats },
 	{ "mixrampdb", PERMISSION_PLAYER, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_PLAYER, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -135,6 +162,7 @@ static constexpr struct command commands[] = {
 	{ "notcommands", PERMISSION_NONE, 0, 0, handle_not_commands },
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
 	{ "outputset", PERMISSION_ADMIN, 3, 3, handle_outputset },
+	{ "outputstats", PERMISSION_READ, 0, 0, handle_outputstats },
 	{ "partition", PERMISSION_READ, 1, 1, handle_partition },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_PLAYER, 0, 1, handle_pause },
@@ -152,6 +180,7 @@ static constexpr struct command commands[] = {
 	{ "playlistmove", PERMISSION_CONTROL, 3, 3, handle_playlistmove },
 	{ "playlistsearch", PERMISSION_READ, 1, -1, handle_playlistsearch },
 	{ "plchanges", PERMISSION_READ, 1, 2, handle_plchanges },
+	{ "plchangesdiff", PERMISSION_READ, 1, 1, handle_plchangesdiff },
 	{ "plchangesposid", PERMISSION_READ, 1, 2, handle_plchangesposid },
 	{ "previous", PERMISSION_PLAYER, 0, 0, handle_previous },
 	{ "prio", PERMISSION_PLAYER, 2, -1, handle_prio },
@@ -161,7 +190,7 @@ static constexpr struct command commands[] = {
 	{ "rangeid", PERMISSION_ADD, 2, 2, handle_rangeid },
 	{ "readcomments", PERMISSION_READ, 1, 1, handle_read_comments },
 	{ "readmessages", PERMISSION_READ, 0, 0, handle_read_messages },
-	{ "readpicture", PERMISSION_READ, 2, 2, handle_read_picture },
+	{ "readpicture", PERMISSION_READ, 2, 2, handle_read_picture, true },
 	{ "rename", PERMISSION_CONTROL, 2, 2, handle_rename },
 	{ "repeat", PERMISSION_PLAYER, 1, 1, handle_repeat },
 	{ "replay_gain_mode", PERMISSION_PLAYER, 1, 1,
@@ -175,7 +204,7 @@ static constexpr struct command commands[] = {
 	{ "search", PERMISSION_READ, 1, -1, handle_search },
 	{ "searchadd", PERMISSION_ADD, 1, -1, handle_searchadd },
 	{ "searchaddpl", PERMISSION_CONTROL, 2, -1, handle_searchaddpl },
-	{ "searchcount", PERMISSION_READ, 1, -1, handle_searchcount },
+	{ "searchcount", PERMISSION_READ, 1, -1, handle_searchcount, true },
 #endif
 	{ "searchplaylist", PERMISSION_READ, 2, 4, handle_searchplaylist },
 	{ "seek", PERMISSION_PLAYER, 2, 2, handle_seek },
@@ -204,12 +233,58 @@ static constexpr struct command commands[] = {
 #endif
 	{ "unsubscribe", PERMISSION_READ, 1, 1, handle_unsubscribe },
 	{ "update", PERMISSION_CONTROL, 0, 1, handle_update },
+	{ "updatefiles", PERMISSION_CONTROL, 1, -1, handle_updatefiles },
 	{ "urlhandlers", PERMISSION_READ, 0, 0, handle_urlhandlers },
 	{ "volume", PERMISSION_PLAYER, 1, 1, handle_volume },
 };
 
 static constexpr unsigned num_commands = std::size(commands);
 
+/**
+ * The size of #command_hash_table; a power of two with plenty of
+ * room, so most lookups find the command in the first slot.
+ */
+static constexpr std::size_t command_hash_size =
+	std::bit_ceil(std::size_t{num_commands} * 4);
+
+static constexpr uint_least8_t NO_COMMAND = 0xff;
+static_assert(num_commands < NO_COMMAND);
+
+[[gnu::pure]]
+static constexpr std::size_t
+command_hash(const char *name) noexcept
+{
+	return djb_hash_string(name) & (command_hash_size - 1);
+}
+
+/**
+ * An open-addressing hash table (with linear probing) of indexes
+ * into #commands, built at compile time.  It replaces the binary
+ * search over the whole table with usually just one string
+ * comparison.
+ */
+static constexpr auto command_hash_table = []{
+	std::array<uint_least8_t, command_hash_size> table{};
+	table.fill(NO_COMMAND);
+
+	for (unsigned i = 0; i < num_commands; ++i) {
+		std::size_t slot = command_hash(commands[i].cmd);
+		while (table[slot] != NO_COMMAND)
+			slot = (slot + 1) & (command_hash_size - 1);
+
+		table[slot] = i;
+	}
+
+	return table;
+}();
+
+/**
+ * The execution time of each command (same index as #commands).
+ * For commands running in the background, this only covers the
+ * time until the background command was started.
+ */
+static LatencyHistogram command_latency[num_commands];
+
 [[gnu::pure]]
 static bool
 command_available([[maybe_unused]] const Partition &partition,
@@ -219,6 +294,9 @@ command_available([[maybe_unused]] const Partition &partition,
 	if (StringIsEqual(cmd->cmd, "sticker") ||
 	    StringIsEqual(cmd->cmd, "stickernames"))
 		return partition.instance.HasStickerDatabase();
+
+	if (StringIsEqual(cmd->cmd, "analyze"))
+		return partition.instance.analysis != nullptr;
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -287,6 +365,21 @@ handle_not_commands(Client &client, [[maybe_unused]] Request request, Response &
 	return PrintUnavailableCommands(r, client.GetPermission());
 }
 
+[[gnu::pure]]
+static const struct command *
+command_lookup(const char *name) noexcept
+{
+	for (std::size_t slot = command_hash(name);;
+	     slot = (slot + 1) & (command_hash_size - 1)) {
+		const unsigned i = command_hash_table[slot];
+		if (i == NO_COMMAND)
+			return nullptr;
+
+		if (StringIsEqual(name, commands[i].cmd))
+			return &commands[i];
+	}
+}
+
 void
 command_init() noexcept
 {
@@ -294,29 +387,11 @@ command_init() noexcept
 	/* ensure that the command list is sorted */
 	for (unsigned i = 0; i < num_commands - 1; ++i)
 		assert(strcmp(commands[i].cmd, commands[i + 1].cmd) < 0);
-#endif
-}
-
-[[gnu::pure]]
-static const struct command *
-command_lookup(const char *name) noexcept
-{
-	unsigned a = 0, b = num_commands, i;
-
-	/* binary search */
-	do {
-		i = (a + b) / 2;
 
-		const auto cmp = strcmp(name, commands[i].cmd);
-		if (cmp == 0)
-			return &commands[i];
-		else if (cmp < 0)
-			b = i;
-		else if (cmp > 0)
-			a = i + 1;
-	} while (a < b);
-
-	return nullptr;
+	/* ensure that the hash table finds all commands */
+	for (unsigned i = 0; i < num_commands; ++i)
+		assert(command_lookup(commands[i].cmd) == &commands[i]);
+#endif
 }
 
 static bool
@@ -374,6 +449,91 @@ command_checked_lookup(Response &r, unsigned permission,
 	return cmd;
 }
 
+/**
+ * Executes a command handler (with #command::worker set) in a
+ * #WorkerPool thread.
+ */
+class WorkerCommand final : public WorkerBackgroundCommand {
+	Client &client;
+
+	const struct command &cmd;
+
+	/**
+	 * Copies of the arguments, because the originals point into
+	 * the client's input buffer.
+	 */
+	const std::vector<std::string> args;
+
+	std::vector<const char *> argv;
+
+public:
+	WorkerCommand(Client &_client, WorkerPool &_pool,
+		      const struct command &_cmd, Request _args) noexcept
+		:WorkerBackgroundCommand(_client, _pool, _cmd.cmd),
+		 client(_client), cmd(_cmd),
+		 args(_args.begin(), _args.end())
+	{
+		argv.reserve(args.size());
+		for (const auto &i : args)
+			argv.push_back(i.c_str());
+	}
+
+protected:
+	bool Generate(Response &r) override {
+		const auto result = cmd.handler(client, Request{argv}, r);
+		assert(result == CommandResult::OK ||
+		       result == CommandResult::ERROR);
+		return result == CommandResult::OK;
+	}
+};
+
+static CommandResult
+command_invoke(Client &client, const struct command &cmd,
+	       Request args, Response &r)
+{
+	if (cmd.worker) {
+		if (auto *pool = client.GetCommandPool()) {
+			auto bc = std::make_unique<WorkerCommand>(client, *pool,
+								  cmd, args);
+			bc->Start();
+			client.SetBackgroundCommand(std::move(bc));
+			return CommandResult::BACKGROUND;
+		}
+	}
+
+	return cmd.handler(client, args, r);
+}
+
+/**
+ * Format a command line for #CommandTrace.
+ */
+static std::string
+FormatCommandLine(const char *name, Request args)
+{
+	/* truncate long command lines */
+	static constexpr std::size_t MAX_LENGTH = 256;
+
+	std::string result{name};
+
+	if (StringIsEqual(name, "password"))
+		/* don't reveal the password */
+		return result;
+
+	for (const char *i : args) {
+		if (result.size() >= MAX_LENGTH)
+			break;
+
+		result += " \"";
+		result += i;
+		result += '"';
+	}
+
+	if (result.size() > MAX_LENGTH)
+		result.resize(MAX_LENGTH);
+
+	return result;
+}
+
 CommandResult
 command_process(Client &client, unsigned num, char *line) noexcept
 {
@@ -429,9 +589,27 @@ command_process(Client &client, unsigned num, char *line) noexcept
 		if (cmd == nullptr)
 			return CommandResult::ERROR;
 
-		return cmd->handler(client, args, r);
+		std::optional<CommandTraceScope> trace;
+		if (auto *tracer = client.GetInstance().command_tracer.get())
+			trace.emplace(*tracer, client, r,
+				      FormatCommandLine(cmd_name, args));
+
+		const auto start = std::chrono::steady_clock::now();
+		AtScopeExit(cmd, start) {
+			command_latency[cmd - commands].Add(std::chrono::steady_clock::now() - start);
+		};
+
+		return command_invoke(client, *cmd, args, r);
 	} catch (...) {
 		PrintError(r, std::current_exception());
 		return CommandResult::ERROR;
 	}
 }
+
+void
+command_visit_latency(std::function<void(const char *name,
+					 const LatencyHistogram &latency)> f)
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		f(commands[i].cmd, command_latency[i]);
+}
@@ -6,7 +6,10 @@
 
 #include "CommandResult.hxx"
 
+#include <functional>
+
 class Client;
+class LatencyHistogram;
 
 void
 command_init() noexcept;
@@ -14,4 +17,12 @@ command_init() noexcept;
 CommandResult
 command_process(Client &client, unsigned num, char *line) noexcept;
 
+/**
+ * Invoke the given function for each command with its latency
+ * histogram (for the metrics exporter).
+ */
+void
+command_visit_latency(std::function<void(const char *name,
+					 const LatencyHistogram &latency)> f);
+
 #endif
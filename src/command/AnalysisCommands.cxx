@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "AnalysisCommands.hxx"
+#include "Request.hxx"
+#include "analysis/Service.hxx"
+#include "db/Interface.hxx"
+#include "db/Selection.hxx"
+#include "song/LightSong.hxx"
+#include "client/Client.hxx"
+#include "client/Response.hxx"
+#include "Instance.hxx"
+
+#include <fmt/format.h>
+
+CommandResult
+handle_analyze(Client &client, Request args, Response &r)
+{
+	auto &instance = client.GetInstance();
+	if (!instance.analysis) {
+		r.Error(ACK_ERROR_UNKNOWN, "analysis is disabled");
+		return CommandResult::ERROR;
+	}
+
+	const Database &db = client.GetDatabaseOrThrow();
+
+	const DatabaseSelection selection(args.GetOptional(0, ""), true);
+
+	std::deque<std::string> uris;
+	db.Visit(selection, [&uris](const LightSong &song){
+		uris.emplace_back(song.GetURI());
+	});
+
+	r.Fmt(FMT_STRING("queued: {}\n"), uris.size());
+
+	instance.analysis->Enqueue(std::move(uris));
+	return CommandResult::OK;
+}
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ANALYSIS_COMMANDS_HXX
+#define MPD_ANALYSIS_COMMANDS_HXX
+
+#include "CommandResult.hxx"
+
+class Client;
+class Request;
+class Response;
+
+CommandResult
+handle_analyze(Client &client, Request request, Response &response);
+
+#endif
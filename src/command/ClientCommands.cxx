@@ -11,6 +11,8 @@
 #include "tag/Type.hxx"
 #include "util/StringAPI.hxx"
 
+#include <algorithm> // for std::max()
+
 CommandResult
 handle_close([[maybe_unused]] Client &client, [[maybe_unused]] Request args,
 	     [[maybe_unused]] Response &r)
@@ -29,7 +31,8 @@ CommandResult
 handle_binary_limit(Client &client, Request args,
 		    [[maybe_unused]] Response &r)
 {
-	size_t value = args.ParseUnsigned(0, client.GetOutputMaxSize() - 4096);
+	size_t value = args.ParseUnsigned(0, std::max(client.GetOutputMaxSize() - 4096,
+						     Client::MAX_BINARY_LIMIT));
 	if (value < 64) {
 		r.Error(ACK_ERROR_ARG, "Value too small");
 		return CommandResult::ERROR;
@@ -162,7 +165,14 @@ handle_protocol(Client &client, Request request, Response &r)
 		client.ClearProtocolFeatures();
 		return CommandResult::OK;
 	} else if (StringIsEqual(cmd, "enable")) {
-		client.SetProtocolFeatures(ParseProtocolFeature(request), true);
+		const auto features = ParseProtocolFeature(request);
+#ifndef ENABLE_ZLIB
+		if (features.Test(PF_COMPRESSION)) {
+			r.Error(ACK_ERROR_ARG, "Compression is not available");
+			return CommandResult::ERROR;
+		}
+#endif
+		client.SetProtocolFeatures(features, true);
 		return CommandResult::OK;
 	} else if (StringIsEqual(cmd, "disable")) {
 		client.SetProtocolFeatures(ParseProtocolFeature(request), false);
@@ -17,10 +17,10 @@ bool
 CommandListBuilder::Add(const char *cmd)
 {
 	size_t len = strlen(cmd) + 1;
-	size += len;
-	if (size > client_max_command_list_size)
+	if (list.buffer.size() + len > client_max_command_list_size)
 		return false;
 
-	list.emplace_back(cmd);
+	list.offsets.push_back(list.buffer.size());
+	list.buffer.append(cmd, len);
 	return true;
 }
@@ -5,8 +5,49 @@
 #define MPD_COMMAND_LIST_BUILDER_HXX
 
 #include <cassert>
-#include <list>
+#include <cstddef>
 #include <string>
+#include <vector>
+
+/**
+ * A command list which was received completely.  All command lines
+ * are stored in one contiguous buffer (each one null-terminated)
+ * instead of one heap allocation per command; the buffers are
+ * recycled by #CommandListBuilder for the next command list, so a
+ * client which sends command lists over and over does not cause any
+ * further heap allocations.
+ */
+class CommandList {
+	friend class CommandListBuilder;
+
+	std::string buffer;
+
+	/**
+	 * The start offset of each command within #buffer.
+	 */
+	std::vector<std::size_t> offsets;
+
+public:
+	std::size_t size() const noexcept {
+		return offsets.size();
+	}
+
+	/**
+	 * Returns a writable pointer to the given command line (for
+	 * the in-place #Tokenizer).
+	 */
+	char *operator[](std::size_t i) noexcept {
+		assert(i < offsets.size());
+
+		return buffer.data() + offsets[i];
+	}
+
+private:
+	void clear() noexcept {
+		buffer.clear();
+		offsets.clear();
+	}
+};
 
 class CommandListBuilder {
 	/**
@@ -32,12 +73,9 @@ class CommandListBuilder {
 	/**
 	 * for when in list mode
 	 */
-	std::list<std::string> list;
+	CommandList list;
 
-	/**
-	 * Memory consumed by the list.
-	 */
-	size_t size;
+	static constexpr std::size_t MAX_RECYCLE_SIZE = 64 * 1024;
 
 public:
 	/**
@@ -65,11 +103,10 @@ public:
 	 * Begin building a command list.
 	 */
 	void Begin(bool ok) {
-		assert(list.empty());
+		assert(list.size() == 0);
 		assert(mode == Mode::DISABLED);
 
 		mode = (Mode)ok;
-		size = 0;
 	}
 
 	/**
@@ -80,11 +117,28 @@ public:
 	/**
 	 * Finishes the list and returns it.
 	 */
-	std::list<std::string> Commit() {
+	CommandList Commit() {
 		assert(IsActive());
 
 		return std::move(list);
 	}
+
+	/**
+	 * Give a #CommandList returned by Commit() back after it has
+	 * been executed, so its buffers can be reused by the next
+	 * command list.
+	 */
+	void Recycle(CommandList &&old) noexcept {
+		assert(!IsActive());
+
+		/* don't keep huge buffers around after an unusually
+		   large command list */
+		if (old.buffer.capacity() > MAX_RECYCLE_SIZE)
+			return;
+
+		old.clear();
+		list = std::move(old);
+	}
 };
 
 #endif
@@ -1,24 +1,37 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "DatabaseCommands.hxx"
 #include "PositionArg.hxx"
 #include "Request.hxx"
 #include "Partition.hxx"
+#include "BulkEdit.hxx"
 #include "db/DatabaseQueue.hxx"
 #include "db/DatabasePlaylist.hxx"
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
 #include "protocol/RangeArg.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/StreamBackgroundCommand.hxx"
 #include "tag/Names.hxx"
 #include "tag/ParseName.hxx"
 #include "util/Exception.hxx"
 #include "util/StringAPI.hxx"
 #include "util/ASCII.hxx"
 #include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+
+#ifdef ENABLE_SQLITE
+#include "Instance.hxx"
+#include "sticker/Cache.hxx"
+#include "sticker/Database.hxx"
+#include "sticker/Print.hxx"
+#endif
 
 #include <fmt/format.h>
 
@@ -27,6 +40,77 @@
 
 #include <limits.h> // for UINT_MAX
 
+/**
+ * Prints a #DatabaseSelection in a separate thread, streaming the
+ * response to the client.
+ */
+class DatabasePrintCommand final : public StreamBackgroundCommand {
+	const Database &db;
+
+	/**
+	 * The buffer for DatabaseSelection::filter.
+	 */
+	const std::unique_ptr<SongFilter> filter;
+
+	DatabaseSelection selection;
+
+	const SongAnnotation annotate;
+
+	const bool full, base;
+
+public:
+	DatabasePrintCommand(Client &_client, const Database &_db,
+			     const DatabaseSelection &_selection,
+			     std::unique_ptr<SongFilter> &&_filter,
+			     SongAnnotation &&_annotate,
+			     bool _full, bool _base) noexcept
+		:StreamBackgroundCommand(_client), db(_db),
+		 filter(std::move(_filter)),
+		 selection(_selection),
+		 annotate(std::move(_annotate)),
+		 full(_full), base(_base)
+	{
+		assert(selection.filter == filter.get());
+	}
+
+protected:
+	void Generate(Response &r) override {
+		db_selection_print(r, db, selection, full, base, annotate);
+	}
+};
+
+/**
+ * Print a recursive #DatabaseSelection.  The response may be huge,
+ * therefore it is generated in a #DatabasePrintCommand if possible;
+ * this is not possible within a command list, and only if the
+ * #Database is thread-safe.
+ *
+ * @param filter the object pointed to by DatabaseSelection::filter
+ * (may be nullptr)
+ */
+static CommandResult
+PrintRecursiveSelection(Client &client, Response &r,
+			const DatabaseSelection &selection,
+			std::unique_ptr<SongFilter> &&filter,
+			bool full, SongAnnotation &&annotate={})
+{
+	const Database &db = client.GetDatabaseOrThrow();
+
+	if (client.IsInCommandList() || !db.GetPlugin().IsThreadSafe()) {
+		db_selection_print(r, db, selection, full, false, annotate);
+		return CommandResult::OK;
+	}
+
+	auto cmd = std::make_unique<DatabasePrintCommand>(client, db,
+							  selection,
+							  std::move(filter),
+							  std::move(annotate),
+							  full, false);
+	cmd->Start();
+	client.SetBackgroundCommand(std::move(cmd));
+	return CommandResult::BACKGROUND;
+}
+
 CommandResult
 handle_listfiles_db(Client &client, Response &r, const char *uri)
 {
@@ -136,15 +220,62 @@ ParseDatabaseSelection(Request args, bool fold_case, SongFilter &filter)
 	return selection;
 }
 
+#ifdef ENABLE_SQLITE
+
+/**
+ * Parse the optional trailing "sticker NAME" argument of "find" and
+ * "search": print the value of this sticker with each song.  The
+ * values are taken from the #StickerCache, which saves one "sticker
+ * get" round trip per song and can be accessed from the worker
+ * thread.
+ */
+static SongAnnotation
+ParseStickerAnnotation(Client &client, Request &args)
+{
+	if (args.size() < 2 || !StringIsEqual(args[args.size() - 2], "sticker"))
+		return {};
+
+	const char *name = args.back();
+
+	const auto &instance = client.GetInstance();
+	if (!instance.HasStickerDatabase())
+		throw ProtocolError(ACK_ERROR_UNKNOWN,
+				    "sticker database is disabled");
+
+	auto cache = instance.sticker_database->GetCache();
+	if (!cache || !cache->IsCached(name))
+		throw ProtocolError(ACK_ERROR_ARG,
+				    fmt::format("sticker {:?} is not cached",
+						name));
+
+	args.pop_back();
+	args.pop_back();
+
+	return [cache=std::move(cache), name=std::string{name}]
+		(Response &r, const LightSong &song){
+		const auto value = cache->Get("song", song.GetURI(), name);
+		if (!value.empty())
+			sticker_print_value(r, name.c_str(), value.c_str());
+	};
+}
+
+#endif
+
 static CommandResult
 handle_match(Client &client, Request args, Response &r, bool fold_case)
 {
-	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, filter);
-
-	db_selection_print(r, client.GetPartition(),
-			   selection, true, false);
-	return CommandResult::OK;
+#ifdef ENABLE_SQLITE
+	auto annotate = ParseStickerAnnotation(client, args);
+#else
+	SongAnnotation annotate;
+#endif
+
+	auto filter = std::make_unique<SongFilter>();
+	const auto selection = ParseDatabaseSelection(args, fold_case, *filter);
+
+	return PrintRecursiveSelection(client, r, selection,
+				       std::move(filter), true,
+				       std::move(annotate));
 }
 
 CommandResult
@@ -170,6 +301,9 @@ handle_match_add(Client &client, Request args, bool fold_case)
 	SongFilter filter;
 	const auto selection = ParseDatabaseSelection(args, fold_case, filter);
 
+	/* emit only one "playlist" idle event for all new songs */
+	const ScopeBulkEdit bulk_edit(partition);
+
 	AddFromDatabase(partition, selection);
 
 	if (position < queue_length) {
@@ -273,10 +407,9 @@ handle_listall(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   false, false);
-	return CommandResult::OK;
+	return PrintRecursiveSelection(client, r,
+				       DatabaseSelection(uri, true),
+				       nullptr, false);
 }
 
 static CommandResult
@@ -383,8 +516,7 @@ handle_listallinfo(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   true, false);
-	return CommandResult::OK;
+	return PrintRecursiveSelection(client, r,
+				       DatabaseSelection(uri, true),
+				       nullptr, true);
 }
@@ -7,6 +7,7 @@
 #include "protocol/Ack.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/StreamBackgroundCommand.hxx"
 #include "util/CharUtil.hxx"
 #include "util/OffsetPointer.hxx"
 #include "util/ScopeExit.hxx"
@@ -25,6 +26,8 @@
 #include "input/Error.hxx"
 #include "LocateUri.hxx"
 #include "TimePrint.hxx"
+#include "Instance.hxx"
+#include "PictureCache.hxx"
 #include "thread/Mutex.hxx"
 #include "Log.hxx"
 
@@ -33,6 +36,9 @@
 #include <algorithm>
 #include <cassert>
 #include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
 
 [[gnu::pure]]
 static bool
@@ -156,6 +162,199 @@ find_stream_art(std::string_view directory, Mutex &mutex)
 	return nullptr;
 }
 
+[[gnu::pure]]
+static PictureCache *
+GetPictureCache(const Client &client) noexcept
+{
+	return client.GetInstance().picture_cache.get();
+}
+
+/**
+ * Binary chunks larger than this are sent by a #BinaryStreamCommand
+ * instead of being copied into the output buffer at once.
+ */
+static constexpr std::size_t STREAM_BINARY_THRESHOLD = 256 * 1024;
+
+/**
+ * Sends a large binary chunk from a separate thread, streaming it to
+ * the client through a bounded buffer.  This neither needs an output
+ * buffer as large as the chunk nor blocks the #EventLoop, so other
+ * clients are served meanwhile.
+ */
+class BinaryStreamCommand final : public StreamBackgroundCommand {
+	/**
+	 * The response lines preceding the "binary" line.
+	 */
+	const std::string header;
+
+	/**
+	 * The source: either an in-memory copy or an #InputStream.
+	 */
+	const CachedPicturePtr picture;
+	const InputStreamPtr is;
+
+	const offset_type offset;
+	const std::size_t size;
+
+	static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+public:
+	BinaryStreamCommand(Client &_client, std::string &&_header,
+			    CachedPicturePtr &&_picture,
+			    std::size_t _offset, std::size_t _size) noexcept
+		:StreamBackgroundCommand(_client), header(std::move(_header)),
+		 picture(std::move(_picture)),
+		 offset(_offset), size(_size) {}
+
+	BinaryStreamCommand(Client &_client, std::string &&_header,
+			    InputStreamPtr &&_is,
+			    offset_type _offset, std::size_t _size) noexcept
+		:StreamBackgroundCommand(_client), header(std::move(_header)),
+		 is(std::move(_is)),
+		 offset(_offset), size(_size) {}
+
+protected:
+	void Generate(Response &r) override {
+		r.Write(header.data(), header.size());
+		r.Fmt(FMT_STRING("binary: {}\n"), size);
+
+		if (picture)
+			WriteMemory(r);
+		else
+			WriteStream(r);
+
+		r.Write("\n");
+	}
+
+private:
+	void WriteMemory(Response &r) const {
+		const auto data = std::span<const std::byte>{picture->data}.subspan(offset, size);
+		for (std::size_t position = 0; position < size;
+		     position += CHUNK_SIZE) {
+			r.CheckCancel();
+
+			const auto chunk = data.subspan(position,
+							std::min(CHUNK_SIZE,
+								 size - position));
+			r.Write(chunk.data(), chunk.size());
+		}
+	}
+
+	void WriteStream(Response &r) const {
+		auto chunk = std::make_unique_for_overwrite<std::byte[]>(CHUNK_SIZE);
+
+		std::unique_lock lock{is->mutex};
+		is->Seek(lock, offset);
+
+		for (std::size_t position = 0; position < size;) {
+			r.CheckCancel();
+
+			const std::size_t nbytes =
+				is->Read(lock, {chunk.get(),
+						std::min(CHUNK_SIZE,
+							 size - position)});
+			if (nbytes == 0)
+				/* the file has been truncated meanwhile;
+				   the client will see a short chunk
+				   followed by an error */
+				throw std::runtime_error("Unexpected end of file");
+
+			const ScopeUnlock unlock{is->mutex};
+			r.Write(chunk.get(), nbytes);
+			position += nbytes;
+		}
+	}
+};
+
+/**
+ * Determine the size of the next binary chunk, which is limited by
+ * #binary_limit and, within a command list (where streaming is not
+ * possible), by the output buffer size.
+ */
+[[gnu::pure]]
+static std::size_t
+GetBinaryChunkSize(const Client &client, std::size_t available) noexcept
+{
+	std::size_t limit = client.binary_limit;
+	if (client.IsInCommandList())
+		limit = std::min(limit, client.GetOutputMaxSize() - 4096);
+
+	return std::min(available, limit);
+}
+
+/**
+ * Shall this binary chunk be sent by a #BinaryStreamCommand?
+ */
+[[gnu::pure]]
+static bool
+ShouldStreamBinary(const Client &client, std::size_t size) noexcept
+{
+	return !client.IsInCommandList() &&
+		size > std::min(STREAM_BINARY_THRESHOLD,
+				client.GetOutputMaxSize() - 4096);
+}
+
+static CommandResult
+StartBinaryStream(Client &client, std::unique_ptr<BinaryStreamCommand> cmd)
+{
+	cmd->Start();
+	client.SetBackgroundCommand(std::move(cmd));
+	return CommandResult::BACKGROUND;
+}
+
+static CommandResult
+send_art_chunk(Response &r, CachedPicturePtr picture, size_t offset)
+{
+	std::span<const std::byte> data = picture->data;
+	if (offset > data.size()) {
+		r.Error(ACK_ERROR_ARG, "Offset too large");
+		return CommandResult::ERROR;
+	}
+
+	// TODO: eliminate this const_cast
+	auto &client = const_cast<Client &>(r.GetClient());
+
+	const std::size_t size =
+		GetBinaryChunkSize(client, data.size() - offset);
+	if (ShouldStreamBinary(client, size))
+		return StartBinaryStream(client,
+					 std::make_unique<BinaryStreamCommand>(client,
+									       fmt::format("size: {}\n", data.size()),
+									       std::move(picture),
+									       offset, size));
+
+	r.Fmt(FMT_STRING("size: {}\n"), data.size());
+	r.WriteBinary(data.subspan(offset, size));
+	return CommandResult::OK;
+}
+
+/**
+ * Read the whole (small) art file into a #CachedPicture.
+ */
+static CachedPicturePtr
+load_stream_art(InputStream &is, std::size_t size)
+{
+	auto picture = std::make_shared<CachedPicture>();
+	picture->data = AllocatedArray<std::byte>{size};
+	picture->exists = true;
+
+	std::unique_lock lock{is.mutex};
+	is.Seek(lock, 0);
+
+	std::size_t position = 0;
+	while (position < size) {
+		std::size_t nbytes =
+			is.Read(lock, std::span{picture->data.data() + position,
+						size - position});
+		if (nbytes == 0)
+			throw std::runtime_error("Unexpected end of file");
+
+		position += nbytes;
+	}
+
+	return picture;
+}
+
 static CommandResult
 read_stream_art(Response &r, const std::string_view art_directory,
 		size_t offset)
@@ -163,6 +362,27 @@ read_stream_art(Response &r, const std::string_view art_directory,
 	// TODO: eliminate this const_cast
 	auto &client = const_cast<Client &>(r.GetClient());
 
+	/* art files are not tracked by the database; therefore
+	   their cache entries expire after a while */
+	static constexpr auto unknown_mtime =
+		std::chrono::system_clock::time_point::min();
+
+	auto *const cache = GetPictureCache(client);
+	std::string cache_key;
+	if (cache != nullptr) {
+		cache_key = "albumart:";
+		cache_key.append(art_directory);
+
+		if (const auto picture = cache->Get(cache_key, unknown_mtime)) {
+			if (!picture->exists) {
+				r.Error(ACK_ERROR_NO_EXIST, "No file exists");
+				return CommandResult::ERROR;
+			}
+
+			return send_art_chunk(r, std::move(picture), offset);
+		}
+	}
+
 	/* to avoid repeating the search for each chunk request by the
 	   same client, use the #LastInputStream class to cache the
 	   #InputStream instance */
@@ -172,6 +392,12 @@ read_stream_art(Response &r, const std::string_view art_directory,
 	});
 
 	if (is == nullptr) {
+		if (cache != nullptr) {
+			auto none = std::make_shared<CachedPicture>();
+			none->exists = false;
+			cache->Put(cache_key, unknown_mtime, std::move(none));
+		}
+
 		r.Error(ACK_ERROR_NO_EXIST, "No file exists");
 		return CommandResult::ERROR;
 	}
@@ -182,14 +408,32 @@ read_stream_art(Response &r, const std::string_view art_directory,
 
 	const offset_type art_file_size = is->GetSize();
 
+	if (cache != nullptr && art_file_size <= cache->GetMaxPictureSize()) {
+		/* load the whole file once; the following chunks
+		   will be served from the cache */
+		auto picture = load_stream_art(*is, art_file_size);
+		cache->Put(cache_key, unknown_mtime, picture);
+		return send_art_chunk(r, std::move(picture), offset);
+	}
+
 	if (offset > art_file_size) {
 		r.Error(ACK_ERROR_ARG, "Offset too large");
 		return CommandResult::ERROR;
 	}
 
 	std::size_t buffer_size =
-		std::min<offset_type>(art_file_size - offset,
-				      r.GetClient().binary_limit);
+		GetBinaryChunkSize(client,
+				   std::min<offset_type>(art_file_size - offset,
+							 Client::MAX_BINARY_LIMIT));
+
+	if (ShouldStreamBinary(client, buffer_size))
+		/* the stream is used by another thread now; the next
+		   request will have to open it again */
+		return StartBinaryStream(client,
+					 std::make_unique<BinaryStreamCommand>(client,
+									       fmt::format("size: {}\n", art_file_size),
+									       client.last_album_art.Steal(),
+									       offset, buffer_size));
 
 	auto buffer = std::make_unique<std::byte[]>(buffer_size);
 
@@ -303,6 +547,18 @@ class PrintPictureHandler final : public NullTagHandler {
 
 	const size_t offset;
 
+	/**
+	 * If set, then the next OnPicture() call passes the data of
+	 * this object, which can be streamed without copying it.
+	 */
+	CachedPicturePtr source;
+
+	/**
+	 * The command which will stream the picture (if it is too
+	 * large to be written to the output buffer at once).
+	 */
+	std::unique_ptr<BinaryStreamCommand> stream;
+
 	bool found = false;
 
 	bool bad_offset = false;
@@ -317,6 +573,29 @@ public:
 			throw ProtocolError(ACK_ERROR_ARG, "Bad file offset");
 	}
 
+	void OnCachedPicture(CachedPicturePtr picture) noexcept {
+		source = std::move(picture);
+		OnPicture(source->mime_type.empty()
+			  ? nullptr
+			  : source->mime_type.c_str(),
+			  source->data);
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	CommandResult Commit() {
+		RethrowError();
+
+		if (stream) {
+			// TODO: eliminate this const_cast
+			auto &client = const_cast<Client &>(response.GetClient());
+			return StartBinaryStream(client, std::move(stream));
+		}
+
+		return CommandResult::OK;
+	}
+
 	void OnPicture(const char *mime_type,
 		       std::span<const std::byte> buffer) noexcept override {
 		if (found)
@@ -330,21 +609,121 @@ public:
 			return;
 		}
 
+		auto &client = const_cast<Client &>(response.GetClient());
+		const std::size_t size =
+			GetBinaryChunkSize(client, buffer.size() - offset);
+
+		if (ShouldStreamBinary(client, size)) {
+			std::string header = fmt::format("size: {}\n",
+							 buffer.size());
+			if (mime_type != nullptr)
+				header += fmt::format("type: {}\n", mime_type);
+
+			CachedPicturePtr picture = std::move(source);
+			std::size_t picture_offset = offset;
+			if (!picture) {
+				/* the buffer is only valid during this
+				   call, so copy the chunk */
+				auto copy = std::make_shared<CachedPicture>();
+				copy->data = AllocatedArray<std::byte>{buffer.subspan(offset, size)};
+				copy->exists = true;
+				picture = std::move(copy);
+				picture_offset = 0;
+			}
+
+			stream = std::make_unique<BinaryStreamCommand>(client,
+								      std::move(header),
+								      std::move(picture),
+								      picture_offset, size);
+			return;
+		}
+
 		response.Fmt(FMT_STRING("size: {}\n"), buffer.size());
 
 		if (mime_type != nullptr)
 			response.Fmt(FMT_STRING("type: {}\n"), mime_type);
 
-		buffer = buffer.subspan(offset);
+		response.WriteBinary(buffer.subspan(offset, size));
+	}
+};
+
+/**
+ * Copies the first picture into a #CachedPicture.
+ */
+class CapturePictureHandler final : public NullTagHandler {
+	const std::size_t max_size;
+
+	std::shared_ptr<CachedPicture> picture;
+
+	bool too_large = false;
+
+public:
+	explicit CapturePictureHandler(std::size_t _max_size) noexcept
+		:NullTagHandler(WANT_PICTURE), max_size(_max_size) {}
+
+	/**
+	 * @return the picture (with CachedPicture::exists=false if
+	 * there is none) or nullptr if it is too large to be cached
+	 */
+	CachedPicturePtr Commit() noexcept {
+		if (too_large)
+			return nullptr;
+
+		if (!picture) {
+			picture = std::make_shared<CachedPicture>();
+			picture->exists = false;
+		}
 
-		const std::size_t binary_limit = response.GetClient().binary_limit;
-		if (buffer.size() > binary_limit)
-			buffer = buffer.first(binary_limit);
+		return std::move(picture);
+	}
+
+	void OnPicture(const char *mime_type,
+		       std::span<const std::byte> buffer) noexcept override {
+		if (picture || too_large)
+			/* only use the first picture */
+			return;
+
+		if (buffer.size() > max_size) {
+			too_large = true;
+			return;
+		}
 
-		response.WriteBinary(buffer);
+		picture = std::make_shared<CachedPicture>();
+		if (mime_type != nullptr)
+			picture->mime_type = mime_type;
+		picture->data = AllocatedArray<std::byte>{buffer};
+		picture->exists = true;
 	}
 };
 
+#ifdef ENABLE_DATABASE
+
+/**
+ * Determine the modification time of the given song from the
+ * database.  Returns time_point::min() if it is not a database song.
+ */
+[[gnu::pure]]
+static std::chrono::system_clock::time_point
+GetSongModificationTime(Client &client, const char *uri) noexcept
+try {
+	const auto *db = client.GetDatabase();
+	if (db == nullptr || uri_has_scheme(uri) ||
+	    PathTraitsUTF8::IsAbsolute(uri))
+		return std::chrono::system_clock::time_point::min();
+
+	const auto *song = db->GetSong(uri);
+	if (song == nullptr)
+		return std::chrono::system_clock::time_point::min();
+
+	AtScopeExit(db, song) { db->ReturnSong(song); };
+	return song->mtime;
+} catch (...) {
+	/* ignore all exceptions from Database::GetSong() */
+	return std::chrono::system_clock::time_point::min();
+}
+
+#endif
+
 CommandResult
 handle_read_picture(Client &client, Request args, Response &r)
 {
@@ -354,7 +733,39 @@ handle_read_picture(Client &client, Request args, Response &r)
 	const size_t offset = args.ParseUnsigned(1);
 
 	PrintPictureHandler handler(r, offset);
-	TagScanAny(client, uri, handler);
-	handler.RethrowError();
-	return CommandResult::OK;
+
+	auto *const cache = GetPictureCache(client);
+	if (cache == nullptr) {
+		TagScanAny(client, uri, handler);
+		return handler.Commit();
+	}
+
+	std::string cache_key = "readpicture:";
+	cache_key.append(uri);
+
+#ifdef ENABLE_DATABASE
+	const auto mtime = GetSongModificationTime(client, uri);
+#else
+	const auto mtime = std::chrono::system_clock::time_point::min();
+#endif
+
+	auto picture = cache->Get(cache_key, mtime);
+	if (!picture) {
+		CapturePictureHandler capture(cache->GetMaxPictureSize());
+		TagScanAny(client, uri, capture);
+
+		picture = capture.Commit();
+		if (!picture) {
+			/* too large for the cache */
+			TagScanAny(client, uri, handler);
+			return handler.Commit();
+		}
+
+		cache->Put(cache_key, mtime, picture);
+	}
+
+	if (picture->exists)
+		handler.OnCachedPicture(std::move(picture));
+
+	return handler.Commit();
 }
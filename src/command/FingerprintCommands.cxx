@@ -37,13 +37,13 @@ class GetChromaprintCommand final
 public:
 	GetChromaprintCommand(Client &_client, std::string &&_uri,
 			      AllocatedPath &&_path)  noexcept
-		:ThreadBackgroundCommand(_client),
+		:ThreadBackgroundCommand(_client, WorkerPriority::LOW),
 		 uri(std::move(_uri)), path(std::move(_path))
 	{
 	}
 
 protected:
-	void Run() override;
+	void RunThread() override;
 
 	void SendResponse(Response &r) noexcept override {
 		r.Fmt(FMT_STRING("chromaprint: {}\n"),
@@ -241,7 +241,7 @@ GetChromaprintCommand::DecodeFile()
 }
 
 void
-GetChromaprintCommand::Run()
+GetChromaprintCommand::RunThread()
 try {
 	if (!path.IsNull())
 		DecodeFile();
@@ -11,6 +11,7 @@
 #include <fmt/format.h>
 
 #include <cassert>
+#include <memory>
 #include <set>
 #include <string>
 
@@ -103,7 +104,10 @@ handle_send_message(Client &client, Request args, Response &r)
 	}
 
 	bool sent = false;
-	const ClientMessage msg(channel_name, message_text);
+
+	/* one copy is shared by all subscribers */
+	const auto msg = std::make_shared<const ClientMessage>(channel_name,
+							       message_text);
 
 	for (auto &c : client.GetPartition().clients)
 		if (c.PushMessage(msg))
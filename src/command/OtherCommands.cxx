@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "OtherCommands.hxx"
+#include "Trace.hxx"
 #include "Request.hxx"
 #include "FileCommands.hxx"
 #include "StorageCommands.hxx"
@@ -26,6 +27,7 @@
 #include "db/PlaylistVector.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/WorkerBackgroundCommand.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "protocol/IdleFlags.hxx"
@@ -41,6 +43,7 @@
 #include <fmt/format.h>
 
 #include <cassert>
+#include <memory>
 
 static void
 print_spl_list(Response &r, const PlaylistVector &list)
@@ -105,7 +108,7 @@ handle_listfiles(Client &client, Request args, Response &r)
 		if (client.GetInstance().storage != nullptr)
 			/* if we have a storage instance, obtain a list of
 			   files from it */
-			return handle_listfiles_storage(r,
+			return handle_listfiles_storage(client, r,
 							*client.GetInstance().storage,
 							uri);
 
@@ -301,6 +304,36 @@ handle_rescan(Client &client, Request args, Response &r)
 	return handle_update(client, args, r, true);
 }
 
+CommandResult
+handle_updatefiles(Client &client, Request args, Response &r)
+{
+#ifdef ENABLE_DATABASE
+	for (const char *uri : args) {
+		if (*uri == 0 || !uri_safe_local(uri)) {
+			r.Error(ACK_ERROR_ARG, "Malformed path");
+			return CommandResult::ERROR;
+		}
+	}
+
+	if (auto *update = client.GetInstance().update) {
+		unsigned id = update->EnqueueUris(args);
+		r.Fmt(FMT_STRING("updating_db: {}\n"), id);
+		return CommandResult::OK;
+	}
+
+	if (client.GetInstance().GetDatabase() != nullptr) {
+		r.Error(ACK_ERROR_NO_EXIST, "Not implemented");
+		return CommandResult::ERROR;
+	}
+#else
+	(void)client;
+	(void)args;
+#endif
+
+	r.Error(ACK_ERROR_NO_EXIST, "No database");
+	return CommandResult::ERROR;
+}
+
 CommandResult
 handle_getvol(Client &client, Request, Response &r)
 {
@@ -353,13 +386,63 @@ handle_volume(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+#ifdef ENABLE_DATABASE
+
+/**
+ * Updates the database statistics in a #WorkerPool thread (this can
+ * take a while on large databases), and then prints all statistics
+ * in the #EventLoop thread.
+ */
+class StatsCommand final : public WorkerBackgroundCommand {
+	Client &client;
+	const Database &db;
+
+public:
+	StatsCommand(Client &_client, WorkerPool &_pool,
+		     const Database &_db) noexcept
+		:WorkerBackgroundCommand(_client, _pool, "stats"),
+		 client(_client), db(_db) {}
+
+protected:
+	bool Generate(Response &) override {
+		stats_prepare(db);
+		return true;
+	}
+
+	void SendResponse(Response &r) noexcept override {
+		stats_print(r, client.GetPartition());
+	}
+};
+
+#endif
+
 CommandResult
 handle_stats(Client &client, [[maybe_unused]] Request args, Response &r)
 {
+#ifdef ENABLE_DATABASE
+	if (const auto *db = client.GetDatabase();
+	    db != nullptr && stats_needs_update()) {
+		if (auto *pool = client.GetCommandPool()) {
+			auto bc = std::make_unique<StatsCommand>(client, *pool,
+								 *db);
+			bc->Start();
+			client.SetBackgroundCommand(std::move(bc));
+			return CommandResult::BACKGROUND;
+		}
+	}
+#endif
+
 	stats_print(r, client.GetPartition());
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_memstats(Client &client, [[maybe_unused]] Request args, Response &r)
+{
+	memstats_print(r, client.GetInstance());
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, [[maybe_unused]] Request args, Response &r)
 {
@@ -386,6 +469,36 @@ handle_config(Client &client, [[maybe_unused]] Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_commandtraces(Client &client, [[maybe_unused]] Request args,
+		     Response &r)
+{
+	const auto *tracer = client.GetInstance().command_tracer.get();
+	if (tracer == nullptr) {
+		r.Error(ACK_ERROR_NO_EXIST, "Command tracing is disabled");
+		return CommandResult::ERROR;
+	}
+
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	for (const auto &i : tracer->GetTraces()) {
+		r.Fmt(FMT_STRING("command: {}\n"
+				 "client: {}\n"),
+		      i.command, i.client);
+		time_print(r, "Time", i.time);
+		r.Fmt(FMT_STRING("wall_ms: {:.3f}\n"
+				 "cpu_ms: {:.3f}\n"
+				 "lock_wait_ms: {:.3f}\n"
+				 "bytes: {}\n"),
+		      Milliseconds{i.wall}.count(),
+		      Milliseconds{i.cpu}.count(),
+		      Milliseconds{i.lock_wait}.count(),
+		      i.bytes);
+	}
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_idle(Client &client, Request args, Response &r)
 {
@@ -31,6 +31,9 @@ handle_update(Client &client, Request request, Response &response);
 CommandResult
 handle_rescan(Client &client, Request request, Response &response);
 
+CommandResult
+handle_updatefiles(Client &client, Request request, Response &response);
+
 CommandResult
 handle_getvol(Client &client, Request request, Response &response);
 
@@ -43,9 +46,15 @@ handle_volume(Client &client, Request request, Response &response);
 CommandResult
 handle_stats(Client &client, Request request, Response &response);
 
+CommandResult
+handle_memstats(Client &client, Request request, Response &response);
+
 CommandResult
 handle_config(Client &client, Request request, Response &response);
 
+CommandResult
+handle_commandtraces(Client &client, Request request, Response &response);
+
 CommandResult
 handle_idle(Client &client, Request request, Response &response);
 
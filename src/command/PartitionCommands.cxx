@@ -79,9 +79,8 @@ handle_newpartition(Client &client, Request request, Response &response)
 		return CommandResult::ERROR;
 	}
 
-	instance.partitions.emplace_back(instance, name,
-					 client.GetPartition().config);
-	auto &partition = instance.partitions.back();
+	auto &partition = instance.AddPartition(name,
+						client.GetPartition().config);
 	partition.UpdateEffectiveReplayGainMode();
 
 	instance.EmitIdle(IDLE_PARTITION);
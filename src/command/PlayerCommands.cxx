@@ -13,6 +13,7 @@
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "protocol/IdleFlags.hxx"
+#include "decoder/Stats.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "util/StringBuffer.hxx"
 #include "util/ScopeExit.hxx"
@@ -25,6 +26,8 @@
 
 #include <fmt/format.h>
 
+#include <string>
+
 #define COMMAND_STATUS_STATE            "state"
 #define COMMAND_STATUS_REPEAT           "repeat"
 #define COMMAND_STATUS_SINGLE           "single"
@@ -71,10 +74,59 @@ handle_stop(Client &client, [[maybe_unused]] Request args, [[maybe_unused]] Resp
 	return CommandResult::OK;
 }
 
+/**
+ * A #ResponseSink which collects the response in a string, to be
+ * stored in the #StatusCache.
+ */
+class StringResponseSink final : public ResponseSink {
+	std::string &buffer;
+
+public:
+	explicit StringResponseSink(std::string &_buffer) noexcept
+		:buffer(_buffer) {}
+
+	/* virtual methods from class ResponseSink */
+	bool Write(std::span<const std::byte> src) noexcept override {
+		buffer.append((const char *)src.data(), src.size());
+		return true;
+	}
+
+	bool IsCancelled() const noexcept override {
+		return false;
+	}
+};
+
+static void
+WriteString(Response &r, const std::string &s) noexcept
+{
+	r.Write(s.data(), s.size());
+}
+
 CommandResult
 handle_currentsong(Client &client, [[maybe_unused]] Request args, Response &r)
 {
-	playlist_print_current(r, client.GetPlaylist());
+	if (r.WantBinarySongs()) {
+		/* the binary encoding has per-response state; don't
+		   cache it */
+		playlist_print_current(r, client.GetPlaylist());
+		return CommandResult::OK;
+	}
+
+	auto &cache = client.GetPartition().status_cache;
+	auto &e = cache.current_song;
+	const TagMask tag_mask = r.GetTagMask();
+
+	if (!cache.IsValid(e, tag_mask)) {
+		e.generation = cache.GetGeneration();
+		e.tag_mask = tag_mask;
+		e.text.clear();
+
+		StringResponseSink sink{e.text};
+		Response cr{client, 0, sink};
+		playlist_print_current(cr, client.GetPlaylist());
+	}
+
+	WriteString(r, e.text);
 	return CommandResult::OK;
 }
 
@@ -92,17 +144,13 @@ handle_pause(Client &client, Request args, [[maybe_unused]] Response &r)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
+static void
+PrintStatusHead(Response &r, Partition &partition,
+		const PlayerStatus &player_status)
 {
-	auto &partition = client.GetPartition();
 	auto &pc = partition.pc;
 
 	const char *state = nullptr;
-	int song;
-
-	const auto player_status = pc.LockGetStatus();
-
 	switch (player_status.state) {
 	case PlayerState::STOP:
 		state = "stop";
@@ -150,43 +198,44 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 		r.Fmt(FMT_STRING(COMMAND_STATUS_MIXRAMPDELAY ": {}\n"),
 		      pc.GetMixRampDelay().count());
 
-	song = playlist.GetCurrentPosition();
+	const int song = playlist.GetCurrentPosition();
 	if (song >= 0) {
 		r.Fmt(FMT_STRING(COMMAND_STATUS_SONG ": {}\n"
 				 COMMAND_STATUS_SONGID ": {}\n"),
 		      song, playlist.PositionToId(song));
 	}
+}
 
-	if (player_status.state != PlayerState::STOP) {
-		r.Fmt(FMT_STRING(COMMAND_STATUS_TIME ": {}:{}\n"
-				 "elapsed: {:1.3f}\n"
-				 COMMAND_STATUS_BITRATE ": {}\n"),
-		      player_status.elapsed_time.RoundS(),
-		      player_status.total_time.IsNegative()
-		      ? 0U
-		      : unsigned(player_status.total_time.RoundS()),
-		      player_status.elapsed_time.ToDoubleS(),
-		      player_status.bit_rate);
-
-		if (!player_status.total_time.IsNegative())
-			r.Fmt(FMT_STRING("duration: {:1.3f}\n"),
-				 player_status.total_time.ToDoubleS());
-
-		if (player_status.audio_format.IsDefined())
-			r.Fmt(FMT_STRING(COMMAND_STATUS_AUDIO ": {}\n"),
-			      player_status.audio_format);
-	}
+static void
+PrintPlayerTime(Response &r, const PlayerStatus &player_status)
+{
+	if (player_status.state == PlayerState::STOP)
+		return;
+
+	r.Fmt(FMT_STRING(COMMAND_STATUS_TIME ": {}:{}\n"
+			 "elapsed: {:1.3f}\n"
+			 COMMAND_STATUS_BITRATE ": {}\n"),
+	      player_status.elapsed_time.RoundS(),
+	      player_status.total_time.IsNegative()
+	      ? 0U
+	      : unsigned(player_status.total_time.RoundS()),
+	      player_status.elapsed_time.ToDoubleS(),
+	      player_status.bit_rate);
+
+	if (!player_status.total_time.IsNegative())
+		r.Fmt(FMT_STRING("duration: {:1.3f}\n"),
+		      player_status.total_time.ToDoubleS());
+
+	if (player_status.audio_format.IsDefined())
+		r.Fmt(FMT_STRING(COMMAND_STATUS_AUDIO ": {}\n"),
+		      player_status.audio_format);
+}
 
-#ifdef ENABLE_DATABASE
-	const UpdateService *update_service = partition.instance.update;
-	unsigned updateJobId = update_service != nullptr
-		? update_service->GetId()
-		: 0;
-	if (updateJobId != 0) {
-		r.Fmt(FMT_STRING(COMMAND_STATUS_UPDATING_DB ": {}\n"),
-		      updateJobId);
-	}
-#endif
+static void
+PrintStatusTail(Response &r, Partition &partition)
+{
+	auto &pc = partition.pc;
+	const auto &playlist = partition.playlist;
 
 	try {
 		pc.LockCheckRethrowError();
@@ -195,12 +244,68 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 		      GetFullMessage(std::current_exception()));
 	}
 
-	song = playlist.GetNextPosition();
+	const int song = playlist.GetNextPosition();
 	if (song >= 0)
 		r.Fmt(FMT_STRING(COMMAND_STATUS_NEXTSONG ": {}\n"
 				 COMMAND_STATUS_NEXTSONGID ": {}\n"),
 		      song, playlist.PositionToId(song));
+}
 
+CommandResult
+handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
+{
+	auto &partition = client.GetPartition();
+	auto &pc = partition.pc;
+	auto &cache = partition.status_cache;
+	auto &e = cache.status;
+
+	const auto now = partition.instance.event_loop.SteadyNow();
+
+	PlayerStatus player_status;
+	bool valid = cache.IsValid(e, now);
+	if (valid) {
+		if (e.player_status.state == PlayerState::PLAY) {
+			/* the elapsed time needs to be refreshed */
+			player_status = pc.LockGetStatus();
+			valid = player_status.state == PlayerState::PLAY;
+		} else
+			/* while not playing, the cached time is
+			   still valid */
+			player_status = e.player_status;
+	}
+
+	if (!valid) {
+		e.generation = cache.GetGeneration();
+		e.expires = now + StatusCache::MAX_AGE;
+		e.player_status = player_status = pc.LockGetStatus();
+
+		e.head.clear();
+		e.tail.clear();
+
+		StringResponseSink head_sink{e.head};
+		Response head{client, 0, head_sink};
+		PrintStatusHead(head, partition, player_status);
+
+		StringResponseSink tail_sink{e.tail};
+		Response tail{client, 0, tail_sink};
+		PrintStatusTail(tail, partition);
+	}
+
+	WriteString(r, e.head);
+	PrintPlayerTime(r, player_status);
+
+#ifdef ENABLE_DATABASE
+	const UpdateService *update_service = partition.instance.update;
+	unsigned updateJobId = update_service != nullptr
+		? update_service->GetId()
+		: 0;
+	if (updateJobId != 0) {
+		r.Fmt(FMT_STRING(COMMAND_STATUS_UPDATING_DB ": {}\n"),
+		      updateJobId);
+	}
+#endif
+
+	WriteString(r, e.tail);
 	return CommandResult::OK;
 }
 
@@ -269,6 +374,9 @@ handle_clearerror(Client &client, [[maybe_unused]] Request args,
 		  [[maybe_unused]] Response &r)
 {
 	client.GetPlayerControl().LockClearError();
+
+	/* clearing the error does not emit an idle event */
+	client.GetPartition().status_cache.Invalidate();
 	return CommandResult::OK;
 }
 
@@ -327,6 +435,53 @@ handle_mixrampdelay(Client &client, Request args, [[maybe_unused]] Response &r)
 	return CommandResult::OK;
 }
 
+static double
+ToSeconds(std::chrono::steady_clock::duration d) noexcept
+{
+	return std::chrono::duration<double>(d).count();
+}
+
+static void
+PrintDecoderStats(Response &r, const DecoderStats &stats)
+{
+	if (stats.uri.empty())
+		return;
+
+	r.Fmt(FMT_STRING("uri: {}\n"
+			 "decode_speed: {:.2f}\n"
+			 "audio_time: {:.3f}\n"
+			 "busy_time: {:.3f}\n"
+			 "read_stalls: {}\n"
+			 "read_stall_time: {:.3f}\n"
+			 "pipe_high: {}\n"),
+	      stats.uri,
+	      stats.GetSpeed(),
+	      ToSeconds(stats.audio_time),
+	      ToSeconds(stats.busy_time),
+	      stats.read_stalls,
+	      ToSeconds(stats.read_stall_time),
+	      stats.pipe_high);
+
+	if (stats.pipe_low_valid)
+		r.Fmt(FMT_STRING("pipe_low: {}\n"), stats.pipe_low);
+
+	if (stats.first_chunk_time >= stats.first_chunk_time.zero())
+		r.Fmt(FMT_STRING("first_chunk_time: {:.3f}\n"),
+		      ToSeconds(stats.first_chunk_time));
+}
+
+CommandResult
+handle_decoderstats(Client &client, [[maybe_unused]] Request args,
+		    Response &r)
+{
+	const auto &pc = client.GetPlayerControl();
+
+	/* the song currently being decoded first */
+	PrintDecoderStats(r, pc.LockGetDecoderStats(false));
+	PrintDecoderStats(r, pc.LockGetDecoderStats(true));
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_replay_gain_mode(Client &client, Request args, Response &)
 {
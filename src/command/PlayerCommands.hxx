@@ -28,6 +28,9 @@ handle_pause(Client &client, Request request, Response &response);
 CommandResult
 handle_status(Client &client, Request request, Response &response);
 
+CommandResult
+handle_decoderstats(Client &client, Request request, Response &response);
+
 CommandResult
 handle_next(Client &client, Request request, Response &response);
 
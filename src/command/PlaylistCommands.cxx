@@ -6,6 +6,8 @@
 #include "PositionArg.hxx"
 #include "Request.hxx"
 #include "Instance.hxx"
+#include "Partition.hxx"
+#include "config/PartitionConfig.hxx"
 #include "db/Interface.hxx"
 #include "db/Selection.hxx"
 #include "db/DatabasePlaylist.hxx"
@@ -28,11 +30,15 @@
 #include "fs/AllocatedPath.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/Exception.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/UriExtract.hxx"
 #include "LocateUri.hxx"
 
 #include <fmt/format.h>
 
+#include <string>
+#include <vector>
+
 bool
 playlist_commands_available() noexcept
 {
@@ -94,16 +100,38 @@ handle_load(Client &client, Request args, [[maybe_unused]] Response &r)
 		: old_size;
 
 	const SongLoader loader(client);
+
+#ifdef ENABLE_DATABASE
+	/* with "lazy_playlist_load", songs are added without their
+	   metadata, which is then loaded from the database in the
+	   background */
+	std::vector<unsigned> lazy_ids;
+	const bool lazy = partition.config.queue.lazy_load &&
+		client.GetDatabase() != nullptr;
+
+	/* this also covers the songs which were added before an
+	   error */
+	AtScopeExit(&partition, &lazy_ids) {
+		partition.LoadLazySongs(std::move(lazy_ids));
+	};
+#endif
+
 	playlist_open_into_queue(uri,
 				 range.start, range.end,
 				 playlist,
-				 client.GetPlayerControl(), loader);
+				 client.GetPlayerControl(), loader
+#ifdef ENABLE_DATABASE
+				 , lazy ? &lazy_ids : nullptr
+#endif
+				 );
 
 	/* invoke the RemoteTagScanner on all newly added songs */
-	auto &instance = client.GetInstance();
 	const unsigned new_size = playlist.GetLength();
+	std::vector<std::string> uris;
+	uris.reserve(new_size - old_size);
 	for (unsigned i = old_size; i < new_size; ++i)
-		instance.LookupRemoteTag(playlist.queue.Get(i).GetRealURI());
+		uris.emplace_back(playlist.queue.Get(i).GetRealURI());
+	client.GetInstance().LookupRemoteTags(uris);
 
 	if (position < old_size) {
 		const RangeArg move_range{old_size, new_size};
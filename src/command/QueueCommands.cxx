@@ -238,6 +238,18 @@ handle_plchanges(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_plchangesdiff(Client &client, Request args, Response &r)
+{
+	uint32_t version = ParseCommandArgU32(args.front());
+	if (!playlist_print_edits(r, client.GetPlaylist(), version)) {
+		r.Error(ACK_ERROR_NO_EXIST, "Version not available");
+		return CommandResult::ERROR;
+	}
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_plchangesposid(Client &client, Request args, Response &r)
 {
@@ -253,7 +265,8 @@ handle_playlistinfo(Client &client, Request args, Response &r)
 {
 	RangeArg range = args.ParseOptional(0, RangeArg::All());
 
-	playlist_print_info(r, client.GetPlaylist(), range);
+	playlist_print_info(r, client.GetPlaylist(), range,
+			    client.GetInstance().command_pool.get());
 	return CommandResult::OK;
 }
 
@@ -264,7 +277,8 @@ handle_playlistid(Client &client, Request args, Response &r)
 		unsigned id = args.ParseUnsigned(0);
 		playlist_print_id(r, client.GetPlaylist(), id);
 	} else {
-		playlist_print_info(r, client.GetPlaylist(), RangeArg::All());
+		playlist_print_info(r, client.GetPlaylist(), RangeArg::All(),
+				    client.GetInstance().command_pool.get());
 	}
 
 	return CommandResult::OK;
@@ -37,6 +37,9 @@ handle_clear(Client &client, Request request, Response &response);
 CommandResult
 handle_plchanges(Client &client, Request request, Response &response);
 
+CommandResult
+handle_plchangesdiff(Client &client, Request request, Response &response);
+
 CommandResult
 handle_plchangesposid(Client &client, Request request, Response &response);
 
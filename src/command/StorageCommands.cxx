@@ -13,6 +13,7 @@
 #include "storage/Registry.hxx"
 #include "storage/CompositeStorage.hxx"
 #include "storage/FileInfo.hxx"
+#include "storage/ListingCache.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/update/Service.hxx"
 #include "TimePrint.hxx"
@@ -29,35 +30,84 @@ skip_path(const char *name_utf8) noexcept
 	return std::strchr(name_utf8, '\n') != nullptr;
 }
 
-static void
-handle_listfiles_storage(Response &r, StorageDirectoryReader &reader)
+static StorageListingPtr
+LoadListing(Storage &storage, const char *uri) noexcept
 {
-	const char *name_utf8;
-	while ((name_utf8 = reader.Read()) != nullptr) {
-		if (skip_path(name_utf8))
-			continue;
+	auto listing = std::make_shared<StorageListing>();
 
-		StorageFileInfo info;
-		try {
-			info = reader.GetInfo(false);
-		} catch (...) {
-			continue;
+	try {
+		std::unique_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(uri));
+
+		const char *name_utf8;
+		while ((name_utf8 = reader->Read()) != nullptr) {
+			if (skip_path(name_utf8))
+				continue;
+
+			StorageFileInfo info;
+			try {
+				info = reader->GetInfo(false);
+			} catch (...) {
+				continue;
+			}
+
+			if (info.type == StorageFileInfo::Type::OTHER)
+				/* ignore */
+				continue;
+
+			listing->entries.emplace_back(name_utf8, info);
 		}
+	} catch (...) {
+		listing->entries.clear();
+		listing->error = std::current_exception();
+	}
+
+	return listing;
+}
+
+/**
+ * Obtain a directory listing, either from the #StorageListingCache
+ * (if one is configured) or from the #Storage.
+ *
+ * @param key the cache key or nullptr to bypass the cache
+ */
+static StorageListingPtr
+GetListing(Client &client, Storage &storage, const char *uri,
+	   const char *key) noexcept
+{
+	auto *cache = client.GetInstance().storage_listing_cache.get();
+	if (cache == nullptr || key == nullptr)
+		return LoadListing(storage, uri);
+
+	if (auto listing = cache->Get(key))
+		return listing;
+
+	auto listing = LoadListing(storage, uri);
+	cache->Put(key, listing);
+	return listing;
+}
+
+static void
+handle_listfiles_storage(Response &r, const StorageListing &listing)
+{
+	if (listing.error)
+		std::rethrow_exception(listing.error);
+
+	for (const auto &entry : listing.entries) {
+		const auto &info = entry.info;
 
 		switch (info.type) {
 		case StorageFileInfo::Type::OTHER:
-			/* ignore */
-			continue;
+			break;
 
 		case StorageFileInfo::Type::REGULAR:
 			r.Fmt(FMT_STRING("file: {}\n"
 					 "size: {}\n"),
-			      name_utf8,
+			      entry.name,
 			      info.size);
 			break;
 
 		case StorageFileInfo::Type::DIRECTORY:
-			r.Fmt(FMT_STRING("directory: {}\n"), name_utf8);
+			r.Fmt(FMT_STRING("directory: {}\n"), entry.name);
 			break;
 		}
 
@@ -67,24 +117,45 @@ handle_listfiles_storage(Response &r, StorageDirectoryReader &reader)
 }
 
 CommandResult
-handle_listfiles_storage(Response &r, Storage &storage, const char *uri)
+handle_listfiles_storage(Client &client, Response &r, Storage &storage,
+			 const char *uri)
 {
-	std::unique_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(uri));
-	handle_listfiles_storage(r, *reader);
+	/* only remote directories are cached; the key is the remote
+	   URI, which is shared with "listfiles" on the absolute
+	   storage URI */
+	std::string key;
+	if (client.GetInstance().storage_listing_cache &&
+	    storage.MapFS(uri).IsNull())
+		key = storage.MapUTF8(uri);
+
+	const auto listing = GetListing(client, storage, uri,
+					key.empty() ? nullptr : key.c_str());
+	handle_listfiles_storage(r, *listing);
 	return CommandResult::OK;
 }
 
 CommandResult
 handle_listfiles_storage(Client &client, Response &r, const char *uri)
 {
-	auto &event_loop = client.GetInstance().io_thread.GetEventLoop();
+	auto &instance = client.GetInstance();
+
+	if (instance.storage_listing_cache) {
+		if (auto listing = instance.storage_listing_cache->Get(uri)) {
+			handle_listfiles_storage(r, *listing);
+			return CommandResult::OK;
+		}
+	}
+
+	auto &event_loop = instance.io_thread.GetEventLoop();
 	std::unique_ptr<Storage> storage(CreateStorageURI(event_loop, uri));
 	if (storage == nullptr) {
 		r.Error(ACK_ERROR_ARG, "Unrecognized storage URI");
 		return CommandResult::ERROR;
 	}
 
-	return handle_listfiles_storage(r, *storage, "");
+	const auto listing = GetListing(client, *storage, "", uri);
+	handle_listfiles_storage(r, *listing);
+	return CommandResult::OK;
 }
 
 static void
@@ -186,6 +257,9 @@ handle_mount(Client &client, Request args, Response &r)
 	composite.Mount(local_uri, std::move(storage));
 	instance.EmitIdle(IDLE_MOUNT);
 
+	if (instance.storage_listing_cache)
+		instance.storage_listing_cache->Flush();
+
 #ifdef ENABLE_DATABASE
 	if (auto *db = dynamic_cast<SimpleDatabase *>(instance.GetDatabase())) {
 		bool need_update;
@@ -253,6 +327,9 @@ handle_unmount(Client &client, Request args, Response &r)
 
 	instance.EmitIdle(IDLE_MOUNT);
 
+	if (instance.storage_listing_cache)
+		instance.storage_listing_cache->Flush();
+
 	return CommandResult::OK;
 }
 
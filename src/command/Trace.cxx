@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include "Trace.hxx"
+#include "client/Client.hxx"
+#include "client/Response.hxx"
+#include "client/Domain.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+#include <fmt/format.h>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+using std::chrono::steady_clock;
+
+/**
+ * Returns the CPU time consumed by the calling thread so far, or zero
+ * if that is unknown.
+ */
+static steady_clock::duration
+GetThreadCpuTime() noexcept
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return std::chrono::duration_cast<steady_clock::duration>(std::chrono::seconds{ts.tv_sec} +
+									   std::chrono::nanoseconds{ts.tv_nsec});
+#endif
+
+	return {};
+}
+
+static steady_clock::duration
+GetLockWaitTime() noexcept
+{
+#ifdef ENABLE_DATABASE
+	return GetDatabaseLockWaitTime();
+#else
+	return {};
+#endif
+}
+
+static constexpr double
+ToMS(steady_clock::duration d) noexcept
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void
+CommandTracer::Add(CommandTrace &&trace) noexcept
+{
+	if (slow_threshold > steady_clock::duration::zero() &&
+	    trace.wall >= slow_threshold)
+		FmtWarning(client_domain,
+			   "[{}] slow command \"{}\": wall={:.1f}ms cpu={:.1f}ms lock_wait={:.1f}ms bytes={}",
+			   trace.client, trace.command,
+			   ToMS(trace.wall), ToMS(trace.cpu),
+			   ToMS(trace.lock_wait), trace.bytes);
+
+	if (capacity == 0)
+		return;
+
+	if (traces.size() >= capacity)
+		traces.pop_front();
+
+	traces.emplace_back(std::move(trace));
+}
+
+CommandTraceScope::CommandTraceScope(CommandTracer &_tracer,
+				     const Client &_client,
+				     const Response &_response,
+				     std::string &&_command) noexcept
+	:tracer(_tracer), client(_client), response(_response),
+	 command(std::move(_command)),
+	 start_wall(steady_clock::now()),
+	 start_cpu(GetThreadCpuTime()),
+	 start_lock_wait(GetLockWaitTime()),
+	 start_bytes(response.GetBytesWritten())
+{
+}
+
+CommandTraceScope::~CommandTraceScope() noexcept
+{
+	tracer.Add({
+		std::chrono::system_clock::now(),
+		std::move(command),
+		client.GetNumber(),
+		steady_clock::now() - start_wall,
+		GetThreadCpuTime() - start_cpu,
+		GetLockWaitTime() - start_lock_wait,
+		response.GetBytesWritten() - start_bytes,
+	});
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_COMMAND_TRACE_HXX
+#define MPD_COMMAND_TRACE_HXX
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+
+class Client;
+class Response;
+
+/**
+ * Measurements of one command invocation.
+ */
+struct CommandTrace {
+	std::chrono::system_clock::time_point time;
+
+	/**
+	 * The command line (name and arguments).
+	 */
+	std::string command;
+
+	unsigned client;
+
+	/**
+	 * The wall time spent executing the command.
+	 */
+	std::chrono::steady_clock::duration wall;
+
+	/**
+	 * The CPU time consumed by the thread executing the command.
+	 */
+	std::chrono::steady_clock::duration cpu;
+
+	/**
+	 * The time spent waiting for the database lock.
+	 */
+	std::chrono::steady_clock::duration lock_wait;
+
+	/**
+	 * The size of the response.
+	 */
+	std::size_t bytes;
+};
+
+/**
+ * Collects #CommandTrace objects: it logs slow commands and keeps a
+ * ring buffer of the most recent ones (see "commandtraces").
+ *
+ * This object may only be used in the main thread.
+ */
+class CommandTracer {
+	/**
+	 * Commands taking longer than this are logged; zero means
+	 * don't log.
+	 */
+	const std::chrono::steady_clock::duration slow_threshold;
+
+	/**
+	 * The maximum size of #traces.
+	 */
+	const std::size_t capacity;
+
+	std::deque<CommandTrace> traces;
+
+public:
+	CommandTracer(std::chrono::steady_clock::duration _slow_threshold,
+		      std::size_t _capacity) noexcept
+		:slow_threshold(_slow_threshold), capacity(_capacity) {}
+
+	const auto &GetTraces() const noexcept {
+		return traces;
+	}
+
+	void Add(CommandTrace &&trace) noexcept;
+};
+
+/**
+ * Measures the command being executed during the lifetime of this
+ * object and submits the result to the #CommandTracer.  For commands
+ * running in the background, this only covers the time until the
+ * background command was started.
+ */
+class CommandTraceScope {
+	CommandTracer &tracer;
+	const Client &client;
+	const Response &response;
+
+	std::string command;
+
+	const std::chrono::steady_clock::time_point start_wall;
+	const std::chrono::steady_clock::duration start_cpu;
+	const std::chrono::steady_clock::duration start_lock_wait;
+	const std::size_t start_bytes;
+
+public:
+	CommandTraceScope(CommandTracer &_tracer, const Client &_client,
+			  const Response &_response,
+			  std::string &&_command) noexcept;
+	~CommandTraceScope() noexcept;
+
+	CommandTraceScope(const CommandTraceScope &) = delete;
+	CommandTraceScope &operator=(const CommandTraceScope &) = delete;
+};
+
+#endif
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "protocol/IdleFlags.hxx"
+
+#include <array>
+#include <chrono>
+
+struct IdleConfig {
+	/**
+	 * The "idle_coalesce" setting: the minimum interval between
+	 * two notifications of each idle flag (indexed by bit
+	 * number).  Events arriving earlier are merged and delivered
+	 * when the interval has elapsed.  Zero means every event is
+	 * delivered immediately.
+	 */
+	std::array<std::chrono::milliseconds, IDLE_NUM_FLAGS> coalesce{};
+};
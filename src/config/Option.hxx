@@ -17,15 +17,22 @@ enum class ConfigOption {
 	FOLLOW_OUTSIDE_SYMLINKS,
 	DB_FILE,
 	STICKER_FILE,
+	STICKER_CACHE,
 	LOG_FILE,
 	PID_FILE,
 	STATE_FILE,
 	STATE_FILE_INTERVAL,
+	STATE_FILE_QUEUE,
 	RESTORE_PAUSED,
+	OUTPUT_STATS_FILE,
+	OUTPUT_STATS_INTERVAL,
+	METRICS_PORT,
+	METRICS_BIND_TO_ADDRESS,
 	USER,
 	GROUP,
 	BIND_TO_ADDRESS,
 	PORT,
+	LISTEN_THREADS,
 	LOG_LEVEL,
 	ZEROCONF_NAME,
 	ZEROCONF_ENABLED,
@@ -42,6 +49,11 @@ enum class ConfigOption {
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_BUFFER_MIN_SIZE,
+	AUDIO_BUFFER_HUGE_PAGES,
+	AUDIO_BUFFER_LOCK,
+	AUDIO_BUFFER_NUMA_NODE,
+	LATENCY_TARGET,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
@@ -50,8 +62,21 @@ enum class ConfigOption {
 	CONN_TIMEOUT,
 	MAX_CONN,
 	MAX_PLAYLIST_LENGTH,
+	LAZY_PLAYLIST_LOAD,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	OUTPUT_SPILL_DIRECTORY,
+	MAX_OUTPUT_SPILL_SIZE,
+	OUTPUT_MEMORY_LIMIT,
+	COMMAND_THREADS,
+	COMMAND_TRACE_SIZE,
+	SLOW_COMMAND_THRESHOLD,
+	BACKGROUND_THREADS,
+	IDLE_COALESCE,
+	PICTURE_CACHE_SIZE,
+	STORAGE_CACHE_TTL,
+	ANALYSIS_THREADS,
+	ANALYSIS_DECODE_THREADS,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
@@ -59,6 +84,12 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	AUTO_UPDATE_METHOD,
+	UPDATE_THREADS,
+	UPDATE_MAX_READ_RATE,
+	UPDATE_MAX_IOPS,
+	UPDATE_YIELD_TO_PLAYBACK,
+	UPDATE_TRUST_DIRECTORY_MTIME,
 
 	MIXRAMP_ANALYZER,
 
@@ -70,6 +101,7 @@ enum class ConfigBlockOption {
 	DECODER,
 	INPUT,
 	INPUT_CACHE,
+	REMOTE_TAG_CACHE,
 	ARCHIVE_PLUGIN,
 	PLAYLIST_PLUGIN,
 	RESAMPLER,
@@ -77,6 +109,7 @@ enum class ConfigBlockOption {
 	DATABASE,
 	NEIGHBORS,
 	PARTITION,
+	THREAD,
 	MAX
 };
 
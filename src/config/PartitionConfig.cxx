@@ -3,9 +3,51 @@
 
 #include "PartitionConfig.hxx"
 #include "Data.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringStrip.hxx"
+
+#include <bit> // for std::countr_zero()
+#include <string>
+
+/**
+ * Parse the "idle_coalesce" setting, a comma-separated list of
+ * "NAME:MILLISECONDS" pairs, e.g. "mixer:50,player:50".
+ */
+static IdleConfig
+ParseIdleConfig(const char *s)
+{
+	IdleConfig config;
+	if (s == nullptr)
+		return config;
+
+	for (std::string_view i : IterableSplitString(s, ',')) {
+		i = Strip(i);
+		if (i.empty())
+			continue;
+
+		const auto [name, value] = Split(i, ':');
+		const unsigned flag = idle_parse_name(std::string{Strip(name)}.c_str());
+		if (flag == 0)
+			throw FmtRuntimeError("Unknown idle name {:?}", name);
+
+		const auto ms = ParseInteger<unsigned>(Strip(value));
+		if (value.data() == nullptr || !ms)
+			throw FmtRuntimeError("Invalid idle_coalesce interval for {:?}",
+					      name);
+
+		config.coalesce[std::countr_zero(flag)] =
+			std::chrono::milliseconds{*ms};
+	}
+
+	return config;
+}
 
 PartitionConfig::PartitionConfig(const ConfigData &config)
-	:player(config)
+	:player(config),
+	 idle(config.With(ConfigOption::IDLE_COALESCE, ParseIdleConfig))
 {
 	queue.max_length =
 		config.GetPositive(ConfigOption::MAX_PLAYLIST_LENGTH,
@@ -17,4 +59,7 @@ PartitionConfig::PartitionConfig(const ConfigData &config)
 		   worse, an integer overflow because the allocation
 		   size is larger than SIZE_MAX) */
 		queue.max_length = QueueConfig::MAX_MAX_LENGTH;
+
+	queue.lazy_load = config.GetBool(ConfigOption::LAZY_PLAYLIST_LOAD,
+					 queue.lazy_load);
 }
@@ -5,10 +5,12 @@
 
 #include "QueueConfig.hxx"
 #include "PlayerConfig.hxx"
+#include "IdleConfig.hxx"
 
 struct PartitionConfig {
 	QueueConfig queue;
 	PlayerConfig player;
+	IdleConfig idle;
 
 	PartitionConfig() = default;
 
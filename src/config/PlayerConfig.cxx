@@ -14,26 +14,34 @@ static constexpr
 size_t MIN_BUFFER_SIZE = std::max(CHUNK_SIZE * 32,
 				  64 * KILOBYTE);
 
+static std::size_t
+ParseBufferSize(const ConfigParam &param)
+{
+	return param.With([](const char *s){
+		size_t result = ParseSize(s, KILOBYTE);
+		if (result <= 0)
+			throw FmtRuntimeError("buffer size {:?} is not a "
+					      "positive integer", s);
+
+		if (result < MIN_BUFFER_SIZE) {
+			FmtWarning(config_domain, "buffer size {} is too small, using {} bytes instead",
+				   result, MIN_BUFFER_SIZE);
+			result = MIN_BUFFER_SIZE;
+		}
+
+		return result;
+	});
+}
+
 static unsigned
 GetBufferChunks(const ConfigData &config)
 {
-	size_t buffer_size = PlayerConfig::DEFAULT_BUFFER_SIZE;
-	if (auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_SIZE)) {
-		buffer_size = param->With([](const char *s){
-			size_t result = ParseSize(s, KILOBYTE);
-			if (result <= 0)
-				throw FmtRuntimeError("buffer size {:?} is not a "
-						      "positive integer", s);
-
-			if (result < MIN_BUFFER_SIZE) {
-				FmtWarning(config_domain, "buffer size {} is too small, using {} bytes instead",
-					   result, MIN_BUFFER_SIZE);
-				result = MIN_BUFFER_SIZE;
-			}
-
-			return result;
-		});
-	}
+	/* with a large "chunk_size" build option, the default may
+	   be too small */
+	size_t buffer_size = std::max(PlayerConfig::DEFAULT_BUFFER_SIZE,
+				      MIN_BUFFER_SIZE);
+	if (const auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_SIZE))
+		buffer_size = ParseBufferSize(*param);
 
 	unsigned buffer_chunks = buffer_size / CHUNK_SIZE;
 	if (buffer_chunks >= 1 << 15)
@@ -43,8 +51,42 @@ GetBufferChunks(const ConfigData &config)
 	return buffer_chunks;
 }
 
+static unsigned
+GetBufferMinChunks(const ConfigData &config, unsigned buffer_chunks)
+{
+	const auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_MIN_SIZE);
+	if (param == nullptr)
+		return 0;
+
+	const std::size_t min_size = ParseBufferSize(*param);
+	const unsigned min_chunks = min_size / CHUNK_SIZE;
+	if (min_chunks >= buffer_chunks)
+		throw FmtRuntimeError("audio_buffer_min_size {} is not smaller than audio_buffer_size in line {}",
+				      min_size, param->line);
+
+	return min_chunks;
+}
+
+static MusicBufferOptions
+GetBufferOptions(const ConfigData &config)
+{
+	MusicBufferOptions options;
+	options.huge_pages = config.GetBool(ConfigOption::AUDIO_BUFFER_HUGE_PAGES,
+					    false);
+	options.lock = config.GetBool(ConfigOption::AUDIO_BUFFER_LOCK, false);
+
+	if (config.GetParam(ConfigOption::AUDIO_BUFFER_NUMA_NODE) != nullptr)
+		options.numa_node = config.GetUnsigned(ConfigOption::AUDIO_BUFFER_NUMA_NODE,
+						       0);
+
+	return options;
+}
+
 PlayerConfig::PlayerConfig(const ConfigData &config)
 	:buffer_chunks(GetBufferChunks(config)),
+	 buffer_min_chunks(GetBufferMinChunks(config, buffer_chunks)),
+	 buffer_options(GetBufferOptions(config)),
+	 latency_target(std::chrono::milliseconds{config.GetUnsigned(ConfigOption::LATENCY_TARGET, 0)}),
 	 audio_format(config.With(ConfigOption::AUDIO_OUTPUT_FORMAT, [](const char *s){
 		 if (s == nullptr)
 			 return AudioFormat::Undefined();
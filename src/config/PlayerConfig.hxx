@@ -5,6 +5,9 @@
 
 #include "pcm/AudioFormat.hxx"
 #include "ReplayGainConfig.hxx"
+#include "MusicBufferOptions.hxx"
+
+#include <chrono>
 
 struct ConfigData;
 
@@ -16,6 +19,28 @@ struct PlayerConfig {
 
 	unsigned buffer_chunks = DEFAULT_BUFFER_SIZE;
 
+	/**
+	 * The "audio_buffer_min_size" setting in chunks: if non-zero,
+	 * only this many chunks of the buffer are used at first, and
+	 * more (up to #buffer_chunks) when the decoder falls behind.
+	 */
+	unsigned buffer_min_chunks = 0;
+
+	/**
+	 * The "audio_buffer_huge_pages", "audio_buffer_lock" and
+	 * "audio_buffer_numa_node" settings.
+	 */
+	MusicBufferOptions buffer_options;
+
+	/**
+	 * The "latency_target" setting: the desired maximum time
+	 * from decoding a sample until it is played.  Half of it is
+	 * given to the #MusicPipe, the other half to the audio
+	 * outputs (see AudioOutputDefaults::latency_target).  Zero
+	 * disables this feature.
+	 */
+	std::chrono::steady_clock::duration latency_target{};
+
 	/**
 	 * The "audio_output_format" setting.
 	 */
@@ -8,4 +8,10 @@ struct QueueConfig {
 	static constexpr unsigned MAX_MAX_LENGTH = 16 * 1024 * 1024;
 
 	unsigned max_length = DEFAULT_MAX_LENGTH;
+
+	/**
+	 * Add songs from playlist files to the queue without their
+	 * metadata and load it from the database in the background?
+	 */
+	bool lazy_load = false;
 };
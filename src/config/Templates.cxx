@@ -15,15 +15,22 @@ const ConfigTemplate config_param_templates[] = {
 	{ "follow_outside_symlinks" },
 	{ "db_file" },
 	{ "sticker_file" },
+	{ "sticker_cache" },
 	{ "log_file" },
 	{ "pid_file" },
 	{ "state_file" },
 	{ "state_file_interval" },
+	{ "state_file_queue" },
 	{ "restore_paused" },
+	{ "output_stats_file" },
+	{ "output_stats_interval" },
+	{ "metrics_port" },
+	{ "metrics_bind_to_address" },
 	{ "user" },
 	{ "group" },
 	{ "bind_to_address", true },
 	{ "port" },
+	{ "listen_threads" },
 	{ "log_level" },
 	{ "zeroconf_name" },
 	{ "zeroconf_enabled" },
@@ -40,6 +47,11 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "audio_buffer_min_size" },
+	{ "audio_buffer_huge_pages" },
+	{ "audio_buffer_lock" },
+	{ "audio_buffer_numa_node" },
+	{ "latency_target" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -48,8 +60,21 @@ const ConfigTemplate config_param_templates[] = {
 	{ "connection_timeout" },
 	{ "max_connections" },
 	{ "max_playlist_length" },
+	{ "lazy_playlist_load" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "output_spill_directory" },
+	{ "max_output_spill_size" },
+	{ "output_memory_limit" },
+	{ "command_threads" },
+	{ "command_trace_size" },
+	{ "slow_command_threshold" },
+	{ "background_threads" },
+	{ "idle_coalesce" },
+	{ "picture_cache_size" },
+	{ "storage_cache_ttl" },
+	{ "analysis_threads" },
+	{ "analysis_decode_threads" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
@@ -57,6 +82,12 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback", false, true },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "auto_update_method" },
+	{ "update_threads" },
+	{ "update_max_read_rate" },
+	{ "update_max_iops" },
+	{ "update_yield_to_playback" },
+	{ "update_trust_directory_mtime" },
 	{ "mixramp_analyzer" },
 };
 
@@ -71,6 +102,7 @@ const ConfigTemplate config_block_templates[] = {
 	{ "decoder", true },
 	{ "input", true },
 	{ "input_cache" },
+	{ "remote_tag_cache" },
 	{ "archive_plugin", true },
 	{ "playlist_plugin", true },
 	{ "resampler" },
@@ -78,6 +110,7 @@ const ConfigTemplate config_block_templates[] = {
 	{ "database" },
 	{ "neighbors", true },
 	{ "partition", true },
+	{ "thread", true },
 };
 
 static constexpr unsigned n_config_block_templates =
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ThreadConfig.hxx"
+#include "Data.hxx"
+#include "Block.hxx"
+#include "Parser.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/StringStrip.hxx"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+/**
+ * Names of threads which can be configured.
+ */
+static constexpr std::string_view thread_names[] = {
+	"default",
+	"player",
+	"decoder",
+	"output",
+	"update",
+	"io",
+	"rtio",
+	"command",
+	"background",
+	"analysis",
+};
+
+static std::map<std::string, ThreadScheduling, std::less<>> thread_scheduling;
+
+static unsigned
+ParseCpu(std::string_view s)
+{
+	const std::string buffer{Strip(s)};
+	return ParseUnsigned(buffer.c_str());
+}
+
+/**
+ * Parse a list of CPU numbers and ranges, e.g. "0,2-3".
+ */
+static std::vector<unsigned>
+ParseCpuList(std::string_view s)
+{
+	std::vector<unsigned> result;
+
+	for (const std::string_view i : IterableSplitString(s, ',')) {
+		if (const auto dash = i.find('-'); dash != i.npos) {
+			const unsigned first = ParseCpu(i.substr(0, dash));
+			const unsigned last = ParseCpu(i.substr(dash + 1));
+			if (first > last)
+				throw FmtRuntimeError("Invalid CPU range: {:?}", i);
+
+			for (unsigned cpu = first; cpu <= last; ++cpu)
+				result.push_back(cpu);
+		} else
+			result.push_back(ParseCpu(i));
+	}
+
+	return result;
+}
+
+ThreadScheduling
+ParseThreadScheduling(const ConfigBlock &block)
+{
+	ThreadScheduling result;
+
+	if (const auto *p = block.GetBlockParam("cpu_affinity"))
+		result.cpu_affinity = p->With(ParseCpuList);
+
+	if (const auto *p = block.GetBlockParam("realtime_priority")) {
+		const unsigned priority = p->GetUnsignedValue();
+		if (priority > 99)
+			throw FmtRuntimeError("Invalid realtime_priority {} in line {}",
+					      priority, p->line);
+
+		result.realtime_priority = priority;
+	}
+
+	return result;
+}
+
+void
+thread_config_global_init(const ConfigData &config)
+{
+	config.WithEach(ConfigBlockOption::THREAD, [](const auto &block){
+		const char *name = block.GetBlockValue("name");
+		if (name == nullptr)
+			throw std::runtime_error("Missing 'name'");
+
+		if (std::find(std::begin(thread_names), std::end(thread_names),
+			      name) == std::end(thread_names))
+			throw FmtRuntimeError("Unknown thread name {:?}", name);
+
+		if (!thread_scheduling.try_emplace(name,
+						   ParseThreadScheduling(block)).second)
+			throw FmtRuntimeError("Duplicate thread block {:?}",
+					      name);
+	});
+}
+
+const ThreadScheduling &
+GetThreadScheduling(std::string_view name) noexcept
+{
+	static const ThreadScheduling empty;
+
+	if (auto i = thread_scheduling.find(name);
+	    i != thread_scheduling.end())
+		return i->second;
+
+	if (auto i = thread_scheduling.find("default");
+	    i != thread_scheduling.end())
+		return i->second;
+
+	return empty;
+}
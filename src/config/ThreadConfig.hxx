@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Scheduling.hxx"
+
+#include <string_view>
+
+struct ConfigData;
+struct ConfigBlock;
+
+/**
+ * Parse the settings "cpu_affinity" and "realtime_priority" from a
+ * configuration block.
+ *
+ * Throws on error.
+ */
+ThreadScheduling
+ParseThreadScheduling(const ConfigBlock &block);
+
+/**
+ * Load all "thread" blocks.
+ *
+ * Throws on error.
+ */
+void
+thread_config_global_init(const ConfigData &config);
+
+/**
+ * Look up the scheduling settings for the thread (or group of
+ * threads) with the specified name, e.g. "decoder" or "io".  Falls
+ * back to the "thread" block named "default".
+ */
+[[gnu::pure]]
+const ThreadScheduling &
+GetThreadScheduling(std::string_view name) noexcept;
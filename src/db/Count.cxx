@@ -4,6 +4,7 @@
 #include "Count.hxx"
 #include "Selection.hxx"
 #include "Interface.hxx"
+#include "Stats.hxx"
 #include "Partition.hxx"
 #include "client/Response.hxx"
 #include "song/LightSong.hxx"
@@ -16,19 +17,11 @@
 #include <functional>
 #include <map>
 
-struct SearchStats {
-	unsigned n_songs{0};
-	std::chrono::duration<std::uint64_t, SongTime::period> total_duration;
-
-	constexpr SearchStats()
-		: total_duration(0) {}
-};
-
-class TagCountMap : public std::map<std::string, SearchStats, std::less<>> {
+class TagCountMap : public std::map<std::string, SongCountStats, std::less<>> {
 };
 
 static void
-PrintSearchStats(Response &r, const SearchStats &stats) noexcept
+PrintSearchStats(Response &r, const SongCountStats &stats) noexcept
 {
 	unsigned total_duration_s =
 		std::chrono::duration_cast<std::chrono::seconds>(stats.total_duration).count();
@@ -50,22 +43,16 @@ Print(Response &r, TagType group, const TagCountMap &m) noexcept
 }
 
 static void
-stats_visitor_song(SearchStats &stats, const LightSong &song) noexcept
+stats_visitor_song(SongCountStats &stats, const LightSong &song) noexcept
 {
-	stats.n_songs++;
-
-	if (const auto duration = song.GetDuration(); !duration.IsNegative())
-		stats.total_duration += duration;
+	stats.Add(song.GetDuration());
 }
 
 static void
 CollectGroupCounts(TagCountMap &map, const Tag &tag,
 		   const char *value) noexcept
 {
-	auto &s = map.emplace(value, SearchStats()).first->second;
-	++s.n_songs;
-	if (!tag.duration.IsNegative())
-		s.total_duration += tag.duration;
+	map[value].Add(tag.duration);
 }
 
 static void
@@ -89,7 +76,7 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 	if (group == TAG_NUM_OF_ITEM_TYPES) {
 		/* no grouping */
 
-		SearchStats stats;
+		SongCountStats stats;
 
 		const auto f = [&](const auto &song)
 			{ return stats_visitor_song(stats, song); };
@@ -97,6 +84,13 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 		db.Visit(selection, f);
 
 		PrintSearchStats(r, stats);
+	} else if (db.VisitGroupCounts(selection, group,
+					[&r, group](const char *value,
+						    const SongCountStats &stats){
+						tag_print(r, group, value);
+						PrintSearchStats(r, stats);
+					})) {
+		/* the database had the counts already */
 	} else {
 		/* group by the specified tag: store counts in a
 		   std::map */
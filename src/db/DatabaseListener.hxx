@@ -25,6 +25,14 @@ public:
 	 * the database because the file has disappeared.
 	 */
 	virtual void OnDatabaseSongRemoved(const char *uri) noexcept = 0;
+
+	/**
+	 * Is a player running out of decoded data?  The database
+	 * update pauses while this returns true.  May be called from
+	 * any thread.
+	 */
+	[[gnu::pure]]
+	virtual bool IsPlaybackStarving() const noexcept = 0;
 };
 
 #endif
@@ -3,8 +3,121 @@
 
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+#include <atomic>
+
+using std::chrono::steady_clock;
+
+SharedMutex db_mutex;
 
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
+thread_local bool db_mutex_shared_holder;
 #endif
+
+/**
+ * When was the exclusive lock obtained?  Protected by #db_mutex.
+ */
+static steady_clock::time_point db_exclusive_since;
+
+/**
+ * When did this thread obtain the shared lock?
+ */
+static thread_local steady_clock::time_point db_shared_since;
+
+/**
+ * The total time this thread has waited for the lock.
+ */
+static thread_local steady_clock::duration db_lock_wait_time;
+
+static std::atomic<uint_least64_t> db_exclusive_count, db_shared_count;
+static std::atomic<steady_clock::rep> db_exclusive_duration,
+	db_shared_duration, db_exclusive_max_duration;
+
+void
+db_lock() noexcept
+{
+	assert(!holding_db_lock());
+
+	const auto wait_start = steady_clock::now();
+	db_mutex.lock();
+
+	assert(db_mutex_holder.IsNull());
+#ifndef NDEBUG
+	db_mutex_holder = ThreadId::GetCurrent();
+#endif
+
+	db_exclusive_since = steady_clock::now();
+	db_lock_wait_time += db_exclusive_since - wait_start;
+}
+
+void
+db_unlock() noexcept
+{
+	assert(holding_db_write_lock());
+
+	const auto duration = (steady_clock::now() - db_exclusive_since).count();
+	db_exclusive_count.fetch_add(1, std::memory_order_relaxed);
+	db_exclusive_duration.fetch_add(duration, std::memory_order_relaxed);
+
+	/* no compare-and-swap needed, because only the holder of
+	   the exclusive lock writes this variable */
+	if (duration > db_exclusive_max_duration.load(std::memory_order_relaxed))
+		db_exclusive_max_duration.store(duration,
+						std::memory_order_relaxed);
+
+#ifndef NDEBUG
+	db_mutex_holder = ThreadId::Null();
+#endif
+
+	db_mutex.unlock();
+}
+
+void
+db_lock_shared() noexcept
+{
+	assert(!holding_db_lock());
+
+	const auto wait_start = steady_clock::now();
+	db_mutex.lock_shared();
+
+#ifndef NDEBUG
+	db_mutex_shared_holder = true;
+#endif
+
+	db_shared_since = steady_clock::now();
+	db_lock_wait_time += db_shared_since - wait_start;
+}
+
+void
+db_unlock_shared() noexcept
+{
+	assert(db_mutex_shared_holder);
+
+	const auto duration = (steady_clock::now() - db_shared_since).count();
+	db_shared_count.fetch_add(1, std::memory_order_relaxed);
+	db_shared_duration.fetch_add(duration, std::memory_order_relaxed);
+
+#ifndef NDEBUG
+	db_mutex_shared_holder = false;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
+DatabaseLockStats
+GetDatabaseLockStats() noexcept
+{
+	return {
+		db_exclusive_count.load(std::memory_order_relaxed),
+		db_shared_count.load(std::memory_order_relaxed),
+		steady_clock::duration{db_exclusive_duration.load(std::memory_order_relaxed)},
+		steady_clock::duration{db_shared_duration.load(std::memory_order_relaxed)},
+		steady_clock::duration{db_exclusive_max_duration.load(std::memory_order_relaxed)},
+	};
+}
+
+steady_clock::duration
+GetDatabaseLockWaitTime() noexcept
+{
+	return db_lock_wait_time;
+}
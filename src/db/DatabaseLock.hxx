@@ -5,29 +5,55 @@
  *
  * Support for locking data structures from the database, for safe
  * multi-threading.
+ *
+ * The lock can be obtained for exclusive access (by code which
+ * modifies the database) or shared access (by visitors which only
+ * read it).  Readers may run concurrently with each other.
  */
 
 #ifndef MPD_DB_LOCK_HXX
 #define MPD_DB_LOCK_HXX
 
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 
-extern Mutex db_mutex;
+extern SharedMutex db_mutex;
 
 #ifndef NDEBUG
 
 #include "thread/Id.hxx"
 
+/**
+ * The thread which holds the exclusive database lock.
+ */
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold the shared database lock?
+ */
+extern thread_local bool db_mutex_shared_holder;
+
+/**
+ * Does the current thread hold the database lock (shared or
+ * exclusive)?
  */
 [[gnu::pure]]
 static inline bool
 holding_db_lock() noexcept
+{
+	return db_mutex_holder.IsInside() || db_mutex_shared_holder;
+}
+
+/**
+ * Does the current thread hold the exclusive database lock (which is
+ * needed to modify the database)?
+ */
+[[gnu::pure]]
+static inline bool
+holding_db_write_lock() noexcept
 {
 	return db_mutex_holder.IsInside();
 }
@@ -35,36 +61,67 @@ holding_db_lock() noexcept
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock for exclusive access.  This is
+ * needed before modifying a #song or #directory.  It is not
+ * recursive.
  */
-static inline void
-db_lock(void)
-{
-	assert(!holding_db_lock());
+void
+db_lock() noexcept;
 
-	db_mutex.lock();
+/**
+ * Release the exclusive database lock.
+ */
+void
+db_unlock() noexcept;
 
-	assert(db_mutex_holder.IsNull());
-#ifndef NDEBUG
-	db_mutex_holder = ThreadId::GetCurrent();
-#endif
-}
+/**
+ * Obtain the global database lock for shared access.  This is
+ * needed before dereferencing a #song or #directory.  It is not
+ * recursive.
+ */
+void
+db_lock_shared() noexcept;
 
 /**
- * Release the global database lock.
+ * Release the shared database lock.
  */
-static inline void
-db_unlock(void)
-{
-	assert(holding_db_lock());
-#ifndef NDEBUG
-	db_mutex_holder = ThreadId::Null();
-#endif
+void
+db_unlock_shared() noexcept;
 
-	db_mutex.unlock();
-}
+/**
+ * Counters about the usage of the database lock, see
+ * GetDatabaseLockStats().
+ */
+struct DatabaseLockStats {
+	uint_least64_t exclusive_count, shared_count;
 
+	/**
+	 * The total duration the lock was held.
+	 */
+	std::chrono::steady_clock::duration exclusive_duration,
+		shared_duration;
+
+	/**
+	 * The longest duration the exclusive lock was held at once.
+	 */
+	std::chrono::steady_clock::duration exclusive_max_duration;
+};
+
+[[gnu::pure]]
+DatabaseLockStats
+GetDatabaseLockStats() noexcept;
+
+/**
+ * Returns the total time the calling thread has waited to obtain the
+ * database lock (shared or exclusive).
+ */
+[[gnu::pure]]
+std::chrono::steady_clock::duration
+GetDatabaseLockWaitTime() noexcept;
+
+/**
+ * Hold the exclusive database lock in the current scope.
+ */
 class ScopeDatabaseLock {
 	bool locked = true;
 
@@ -90,7 +147,8 @@ public:
 };
 
 /**
- * Unlock the database while in the current scope.
+ * Unlock the database (which was locked exclusively) while in the
+ * current scope.
  */
 class ScopeDatabaseUnlock {
 public:
@@ -103,4 +161,71 @@ public:
 	}
 };
 
+/**
+ * Hold the shared database lock in the current scope.
+ */
+class ScopeDatabaseReadLock {
+	bool locked = true;
+
+public:
+	ScopeDatabaseReadLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseReadLock() {
+		if (locked)
+			db_unlock_shared();
+	}
+
+	/**
+	 * Unlock the mutex now, making the destructor a no-op.
+	 */
+	void unlock() {
+		assert(locked);
+
+		db_unlock_shared();
+		locked = false;
+	}
+};
+
+/**
+ * Unlock the database (which was locked with shared access) while in
+ * the current scope.
+ */
+class ScopeDatabaseReadUnlock {
+public:
+	ScopeDatabaseReadUnlock() {
+		db_unlock_shared();
+	}
+
+	~ScopeDatabaseReadUnlock() {
+		db_lock_shared();
+	}
+};
+
+/**
+ * Access the database in a helper thread on behalf of another thread
+ * which holds the shared lock and waits for the helper to finish.
+ * This does not lock anything (locking again could deadlock with a
+ * pending writer); it only satisfies the debug assertions.
+ */
+class ScopeBorrowDatabaseReadLock {
+public:
+	ScopeBorrowDatabaseReadLock() noexcept {
+#ifndef NDEBUG
+		assert(!db_mutex_shared_holder);
+		db_mutex_shared_holder = true;
+#endif
+	}
+
+	~ScopeBorrowDatabaseReadLock() noexcept {
+#ifndef NDEBUG
+		db_mutex_shared_holder = false;
+#endif
+	}
+
+	ScopeBorrowDatabaseReadLock(const ScopeBorrowDatabaseReadLock &) = delete;
+	ScopeBorrowDatabaseReadLock &operator=(const ScopeBorrowDatabaseReadLock &) = delete;
+};
+
 #endif
@@ -23,6 +23,13 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * Database::Visit() and Database::GetSong() may be called
+	 * from any thread, even while other threads access the
+	 * #Database.
+	 */
+	static constexpr unsigned FLAG_THREAD_SAFE = 0x2;
+
 	const char *name;
 
 	unsigned flags;
@@ -45,6 +52,10 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool IsThreadSafe() const {
+		return flags & FLAG_THREAD_SAFE;
+	}
 };
 
 #endif
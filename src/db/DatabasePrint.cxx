@@ -9,6 +9,7 @@
 #include "Partition.hxx"
 #include "song/LightSong.hxx"
 #include "tag/Names.hxx"
+#include "tag/Settings.hxx"
 #include "tag/Tag.hxx"
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
@@ -131,7 +132,21 @@ db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
 		   bool full, bool base)
 {
-	const Database &db = partition.GetDatabaseOrThrow();
+	db_selection_print(r, partition.GetDatabaseOrThrow(),
+			   selection, full, base);
+}
+
+void
+db_selection_print(Response &r, const Database &db,
+		   const DatabaseSelection &_selection,
+		   bool full, bool base,
+		   const SongAnnotation &annotate)
+{
+	/* tell the database which tags will be printed */
+	DatabaseSelection selection = _selection;
+	selection.tag_mask = full
+		? global_tag_mask & r.GetTagMask()
+		: TagMask::None();
 
 	const auto d = selection.filter == nullptr
 		? [&,base](const auto &dir)
@@ -141,9 +156,17 @@ db_selection_print(Response &r, Partition &partition,
 		: VisitDirectory();
 
 	VisitSong s = [&,base](const auto &song)
-		{ return full ?
-			PrintSongFull(r, base, song) :
-			PrintSongBrief(r, base, song); };
+		{
+			r.CheckCancel();
+
+			if (full)
+				PrintSongFull(r, base, song);
+			else
+				PrintSongBrief(r, base, song);
+
+			if (annotate)
+				annotate(r, song);
+		};
 
 	const auto p = selection.filter == nullptr
 		? [&,base](const auto &playlist, const auto &dir)
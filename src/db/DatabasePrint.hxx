@@ -5,13 +5,22 @@
 #define MPD_DB_PRINT_H
 
 #include <cstdint>
+#include <functional>
 #include <span>
 
 enum TagType : uint8_t;
 class SongFilter;
 struct DatabaseSelection;
 struct Partition;
+class Database;
 class Response;
+struct LightSong;
+
+/**
+ * A function which prints additional attributes after each song,
+ * e.g. sticker values.
+ */
+using SongAnnotation = std::function<void(Response &r, const LightSong &song)>;
 
 /**
  * @param full print attributes/tags
@@ -22,6 +31,17 @@ db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
 		   bool full, bool base);
 
+/**
+ * Like above, but with a #Database reference instead of a
+ * #Partition; this can be used outside of the main thread if the
+ * #Database is thread-safe.
+ */
+void
+db_selection_print(Response &r, const Database &db,
+		   const DatabaseSelection &selection,
+		   bool full, bool base,
+		   const SongAnnotation &annotate={});
+
 void
 PrintSongUris(Response &r, Partition &partition,
 	      const SongFilter *filter);
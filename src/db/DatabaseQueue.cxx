@@ -9,22 +9,32 @@
 #include "song/DetachedSong.hxx"
 
 #include <functional>
+#include <vector>
 
-static void
-AddToQueue(Partition &partition, const LightSong &song)
-{
-	const auto *storage = partition.instance.storage;
-	partition.playlist.AppendSong(partition.pc,
-				      DatabaseDetachSong(storage,
-							 song));
-}
+/**
+ * Songs are appended to the queue in batches of this size.
+ */
+static constexpr std::size_t ADD_BATCH_SIZE = 256;
 
 void
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection)
 {
 	const Database &db = partition.instance.GetDatabaseOrThrow();
+	const auto *storage = partition.instance.storage;
+
+	std::vector<DetachedSong> songs;
+	songs.reserve(ADD_BATCH_SIZE);
+
+	const auto f = [&](const LightSong &song){
+		songs.emplace_back(DatabaseDetachSong(storage, song));
+
+		if (songs.size() >= ADD_BATCH_SIZE) {
+			partition.playlist.AppendSongs(partition.pc, songs);
+			songs.clear();
+		}
+	};
 
-	const auto f = [&](const auto &song)
-		{ return AddToQueue(partition, song); };
 	db.Visit(selection, f);
+
+	partition.playlist.AppendSongs(partition.pc, songs);
 }
@@ -2,28 +2,15 @@
 // Copyright The Music Player Daemon Project
 
 #include "Helpers.hxx"
-#include "Stats.hxx"
 #include "Interface.hxx"
 #include "song/LightSong.hxx"
 #include "tag/Tag.hxx"
 
-#include <set>
-
-#include <string.h>
-
-struct StringLess {
-	[[gnu::pure]]
-	bool operator()(const char *a, const char *b) const noexcept {
-		return strcmp(a, b) < 0;
-	}
-};
-
-using StringSet = std::set<const char *, StringLess>;
-
-static void
-StatsVisitTag(DatabaseStats &stats, StringSet &artists, StringSet &albums,
-	      const Tag &tag) noexcept
+void
+DatabaseStatsBuilder::Add(const Tag &tag)
 {
+	++stats.song_count;
+
 	if (!tag.duration.IsNegative())
 		stats.total_duration += tag.duration;
 
@@ -43,28 +30,13 @@ StatsVisitTag(DatabaseStats &stats, StringSet &artists, StringSet &albums,
 	}
 }
 
-static void
-StatsVisitSong(DatabaseStats &stats, StringSet &artists, StringSet &albums,
-	       const LightSong &song) noexcept
-{
-	++stats.song_count;
-
-	StatsVisitTag(stats, artists, albums, song.tag);
-}
-
 DatabaseStats
 GetStats(const Database &db, const DatabaseSelection &selection)
 {
-	DatabaseStats stats;
-	stats.Clear();
-
-	StringSet artists, albums;
-	const auto f = [&](const auto &song)
-		{ return StatsVisitSong(stats, artists, albums, song); };
-
-	db.Visit(selection, f);
+	DatabaseStatsBuilder builder;
+	db.Visit(selection, [&builder](const LightSong &song){
+		builder.Add(song.tag);
+	});
 
-	stats.artist_count = artists.size();
-	stats.album_count = albums.size();
-	return stats;
+	return builder.Commit();
 }
@@ -4,9 +4,42 @@
 #ifndef MPD_DATABASE_HELPERS_HXX
 #define MPD_DATABASE_HELPERS_HXX
 
+#include "Stats.hxx"
+
+#include <functional> // for std::less
+#include <set>
+#include <string>
+
 class Database;
 struct DatabaseSelection;
-struct DatabaseStats;
+struct Tag;
+
+/**
+ * Accumulates #DatabaseStats from the tags of songs.
+ */
+class DatabaseStatsBuilder {
+	DatabaseStats stats;
+
+	/**
+	 * The distinct artist and album names.  These are copies,
+	 * because a visited #Tag may be a temporary object.
+	 */
+	std::set<std::string, std::less<>> artists, albums;
+
+public:
+	DatabaseStatsBuilder() noexcept {
+		stats.Clear();
+	}
+
+	void Add(const Tag &tag);
+
+	DatabaseStats Commit() const noexcept {
+		DatabaseStats result = stats;
+		result.artist_count = artists.size();
+		result.album_count = albums.size();
+		return result;
+	}
+};
 
 DatabaseStats
 GetStats(const Database &db, const DatabaseSelection &selection);
@@ -103,6 +103,24 @@ public:
 	 */
 	virtual DatabaseStats GetStats(const DatabaseSelection &selection) const = 0;
 
+	/**
+	 * Visit precomputed song counts grouped by the values of the
+	 * given tag type (with fallbacks, see
+	 * VisitTagWithFallbackOrEmpty()), sorted by value.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if no precomputed counts are available for
+	 * this selection (nothing was visited, and the caller needs
+	 * to walk the database)
+	 */
+	virtual bool VisitGroupCounts([[maybe_unused]] const DatabaseSelection &selection,
+				      [[maybe_unused]] TagType group,
+				      [[maybe_unused]] const VisitGroupCount &visit) const {
+		/* not implemented */
+		return false;
+	}
+
 	/**
 	 * Update the database.
 	 *
@@ -19,7 +19,7 @@ PlaylistVector::find(std::string_view name) noexcept
 bool
 PlaylistVector::UpdateOrInsert(PlaylistInfo &&pi) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	auto i = find(pi.name.c_str());
 	if (i != end()) {
@@ -39,7 +39,7 @@ PlaylistVector::UpdateOrInsert(PlaylistInfo &&pi) noexcept
 bool
 PlaylistVector::erase(std::string_view name) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	auto i = find(name);
 	if (i == end())
@@ -7,6 +7,7 @@
 #include "plugins/simple/SimpleDatabasePlugin.hxx"
 #include "plugins/ProxyDatabasePlugin.hxx"
 #include "plugins/upnp/UpnpDatabasePlugin.hxx"
+#include "plugins/sqlite/SqliteDatabasePlugin.hxx"
 
 #include <string.h>
 
@@ -17,6 +18,9 @@ constinit const DatabasePlugin *const database_plugins[] = {
 #endif
 #ifdef ENABLE_UPNP
 	&upnp_db_plugin,
+#endif
+#ifdef ENABLE_SQLITE
+	&sqlite_db_plugin,
 #endif
 	nullptr
 };
@@ -5,6 +5,7 @@
 #define MPD_DATABASE_SELECTION_HXX
 
 #include "protocol/RangeArg.hxx"
+#include "tag/Mask.hxx"
 #include "tag/Type.hxx"
 
 #include <string>
@@ -30,6 +31,14 @@ struct DatabaseSelection {
 	 */
 	TagType sort = TAG_NUM_OF_ITEM_TYPES;
 
+	/**
+	 * The tags the visitor is interested in.  A database may
+	 * omit all other tags from the #LightSong objects it passes
+	 * to the visitor, if that saves work (the #filter and #sort
+	 * are still evaluated with all tags).
+	 */
+	TagMask tag_mask = TagMask::All();
+
 	/**
 	 * If #sort is set, this flag can reverse the sort order.
 	 */
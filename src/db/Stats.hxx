@@ -34,4 +34,20 @@ struct DatabaseStats {
 	}
 };
 
+/**
+ * The number of songs and their total duration, e.g. of one group
+ * of "count ... group".
+ */
+struct SongCountStats {
+	unsigned n_songs = 0;
+
+	std::chrono::duration<std::uint64_t, SongTime::period> total_duration{};
+
+	void Add(SignedSongTime duration) noexcept {
+		++n_songs;
+		if (!duration.IsNegative())
+			total_duration += duration;
+	}
+};
+
 #endif
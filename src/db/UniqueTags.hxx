@@ -9,10 +9,19 @@
 #include <string>
 
 enum TagType : uint8_t;
+struct Tag;
 class Database;
 struct DatabaseSelection;
 template<typename Key> class RecursiveMap;
 
+/**
+ * Add the values of one #Tag to a CollectUniqueTags() result.
+ */
+void
+CollectUniqueTags(RecursiveMap<std::string> &result,
+		  const Tag &tag,
+		  std::span<const TagType> tag_types) noexcept;
+
 /**
  * Walk the database and collect unique tag values.
  */
@@ -2,10 +2,10 @@
 // Copyright The Music Player Daemon Project
 
 #include "VHelper.hxx"
-#include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "song/Filter.hxx"
 #include "tag/Sort.hxx"
+#include "tag/Tag.hxx"
 
 #include <algorithm>
 #include <cassert>
@@ -22,12 +22,12 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 	if (selection.sort != TAG_NUM_OF_ITEM_TYPES) {
 		/* the client has asked us to sort the result; this is
 		   pretty expensive, because instead of streaming the
-		   result to the client, we need to copy it all into
-		   this std::vector, and then sort it */
+		   result to the client, we need to copy it into this
+		   std::vector, and then sort it */
 
 		original_visit_song = std::move(visit_song);
 		visit_song = [this](const auto &song){
-			songs.emplace_back(song);
+			CollectSorted(song);
 		};
 	} else if (selection.window != RangeArg::All()) {
 		original_visit_song = std::move(visit_song);
@@ -40,6 +40,74 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 
 DatabaseVisitorHelper::~DatabaseVisitorHelper() noexcept = default;
 
+template<typename T>
+static constexpr bool
+CompareTimes(bool descending, T a, T b) noexcept
+{
+	return descending ? a > b : a < b;
+}
+
+inline bool
+DatabaseVisitorHelper::Less(const LightSong &a, unsigned a_position,
+			    const SortedSong &b) const noexcept
+{
+	const auto sort = selection.sort;
+	const auto descending = selection.descending;
+
+	if (sort == TagType(SORT_TAG_LAST_MODIFIED)) {
+		if (a.mtime != b.song.GetLastModified())
+			return CompareTimes(descending, a.mtime,
+					    b.song.GetLastModified());
+	} else if (sort == TagType(SORT_TAG_ADDED)) {
+		if (a.added != b.song.GetAdded())
+			return CompareTimes(descending, a.added,
+					    b.song.GetAdded());
+	} else {
+		if (CompareTags(sort, descending, a.tag, b.song.GetTag()))
+			return true;
+
+		if (CompareTags(sort, descending, b.song.GetTag(), a.tag))
+			return false;
+	}
+
+	/* equal: keep the original order */
+	return a_position < b.position;
+}
+
+inline bool
+DatabaseVisitorHelper::Less(const SortedSong &a,
+			    const SortedSong &b) const noexcept
+{
+	return Less((LightSong)a.song, a.position, b);
+}
+
+void
+DatabaseVisitorHelper::CollectSorted(const LightSong &song)
+{
+	const unsigned position = counter++;
+	const auto cmp = [this](const SortedSong &a, const SortedSong &b){
+		return Less(a, b);
+	};
+
+	if (selection.window.IsOpenEnded()) {
+		songs.push_back({DetachedSong{song}, position});
+		return;
+	}
+
+	/* only the first "window.end" songs can be part of the
+	   result: keep them in a max-heap, and copy a new song only
+	   if it is ordered before the last one */
+
+	if (songs.size() < selection.window.end) {
+		songs.push_back({DetachedSong{song}, position});
+		std::push_heap(songs.begin(), songs.end(), cmp);
+	} else if (!songs.empty() && Less(song, position, songs.front())) {
+		std::pop_heap(songs.begin(), songs.end(), cmp);
+		songs.back() = {DetachedSong{song}, position};
+		std::push_heap(songs.begin(), songs.end(), cmp);
+	}
+}
+
 void
 DatabaseVisitorHelper::Commit()
 {
@@ -49,32 +117,16 @@ DatabaseVisitorHelper::Commit()
 
 	assert(original_visit_song);
 
-	/* sort the song collection */
-	const auto sort = selection.sort;
-	const auto descending = selection.descending;
+	/* sort the song collection; the position makes the order
+	   total, so std::sort() is as good as std::stable_sort() */
+	const auto cmp = [this](const SortedSong &a, const SortedSong &b){
+		return Less(a, b);
+	};
 
-	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetLastModified() > b.GetLastModified()
-						 : a.GetLastModified() < b.GetLastModified();
-				 });
-	else if (sort == TagType(SORT_TAG_ADDED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetAdded() > b.GetAdded()
-						 : a.GetAdded() < b.GetAdded();
-				 });
+	if (selection.window.IsOpenEnded())
+		std::sort(songs.begin(), songs.end(), cmp);
 	else
-		std::stable_sort(songs.begin(), songs.end(),
-				 [sort, descending](const DetachedSong &a,
-						    const DetachedSong &b){
-					 return CompareTags(sort, descending,
-							    a.GetTag(),
-							    b.GetTag());
-				 });
+		std::sort_heap(songs.begin(), songs.end(), cmp);
 
 	/* apply the "window" */
 	if (selection.window.end < songs.size())
@@ -89,5 +141,5 @@ DatabaseVisitorHelper::Commit()
 
 	/* now pass all songs to the original visitor callback */
 	for (const auto &song : songs)
-		original_visit_song((LightSong)song);
+		original_visit_song((LightSong)song.song);
 }
@@ -6,11 +6,10 @@
 
 #include "Visitor.hxx"
 #include "Selection.hxx"
+#include "song/DetachedSong.hxx"
 
 #include <vector>
 
-class DetachedSong;
-
 /**
  * This class helps implementing Database::Visit() by emulating
  * #DatabaseSelection features that the #Database implementation
@@ -23,17 +22,31 @@ class DetachedSong;
 class DatabaseVisitorHelper {
 	const DatabaseSelection selection;
 
+	struct SortedSong {
+		DetachedSong song;
+
+		/**
+		 * The position in the unsorted result; used to
+		 * order songs which compare equal, like
+		 * std::stable_sort() would.
+		 */
+		unsigned position;
+	};
+
 	/**
 	 * If the plugin can't sort, then this container will collect
 	 * all songs, sort them and report them to the visitor in
-	 * Commit().
+	 * Commit().  If the "window" has an end, then only the first
+	 * songs up to the end are kept (in a heap, see
+	 * CollectSorted()).
 	 */
-	std::vector<DetachedSong> songs;
+	std::vector<SortedSong> songs;
 
 	VisitSong original_visit_song;
 
 	/**
-	 * Used to emulate the "window".
+	 * Used to emulate the "window" and to number the songs
+	 * collected for sorting.
 	 */
 	unsigned counter = 0;
 
@@ -49,6 +62,20 @@ public:
 	~DatabaseVisitorHelper() noexcept;
 
 	void Commit();
+
+private:
+	void CollectSorted(const LightSong &song);
+
+	/**
+	 * Is the song with the given attributes ordered before the
+	 * other one?
+	 */
+	[[gnu::pure]]
+	bool Less(const LightSong &a, unsigned a_position,
+		  const SortedSong &b) const noexcept;
+
+	[[gnu::pure]]
+	bool Less(const SortedSong &a, const SortedSong &b) const noexcept;
 };
 
 #endif
@@ -10,6 +10,7 @@ struct LightDirectory;
 struct LightSong;
 struct PlaylistInfo;
 struct Tag;
+struct SongCountStats;
 
 typedef std::function<void(const LightDirectory &)> VisitDirectory;
 typedef std::function<void(const LightSong &)> VisitSong;
@@ -18,4 +19,7 @@ typedef std::function<void(const PlaylistInfo &,
 
 typedef std::function<void(const Tag &)> VisitTag;
 
+typedef std::function<void(const char *value,
+			   const SongCountStats &stats)> VisitGroupCount;
+
 #endif
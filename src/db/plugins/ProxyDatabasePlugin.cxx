@@ -20,9 +20,11 @@
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
 #include "tag/ParseName.hxx"
+#include "tag/Names.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/RecursiveMap.hxx"
 #include "util/ScopeExit.hxx"
+#include "thread/Mutex.hxx"
 #include "protocol/Ack.hxx"
 #include "event/SocketEvent.hxx"
 #include "event/IdleEvent.hxx"
@@ -33,8 +35,12 @@
 
 #include <cassert>
 #include <list>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 class LibmpdclientError final : public std::runtime_error {
 	enum mpd_error code;
@@ -52,7 +58,11 @@ class ProxySong : public LightSong {
 	Tag tag2;
 
 public:
-	explicit ProxySong(const mpd_song *song);
+	/**
+	 * @param tag_mask convert only these tags
+	 */
+	explicit ProxySong(const mpd_song *song,
+			   TagMask tag_mask=TagMask::All());
 };
 
 class AllocatedProxySong : public ProxySong {
@@ -70,6 +80,43 @@ public:
 	AllocatedProxySong &operator=(const AllocatedProxySong &) = delete;
 };
 
+class ProxyEntity {
+	struct mpd_entity *entity;
+
+public:
+	explicit ProxyEntity(struct mpd_entity *_entity) noexcept
+		:entity(_entity) {}
+
+	ProxyEntity(const ProxyEntity &other) = delete;
+
+	ProxyEntity(ProxyEntity &&other) noexcept
+		:entity(other.entity) {
+		other.entity = nullptr;
+	}
+
+	~ProxyEntity() noexcept {
+		if (entity != nullptr)
+			mpd_entity_free(entity);
+	}
+
+	ProxyEntity &operator=(const ProxyEntity &other) = delete;
+
+	operator const struct mpd_entity *() const noexcept {
+		return entity;
+	}
+};
+
+struct MpdSongDeleter {
+	void operator()(mpd_song *song) const noexcept {
+		mpd_song_free(song);
+	}
+};
+
+using MpdSongPtr = std::unique_ptr<mpd_song, MpdSongDeleter>;
+
+using ProxyEntityList = std::list<ProxyEntity>;
+using SharedProxyEntityList = std::shared_ptr<const ProxyEntityList>;
+
 class ProxyDatabase final : public Database {
 	SocketEvent socket_event;
 	IdleEvent idle_event;
@@ -98,6 +145,37 @@ class ProxyDatabase final : public Database {
 	 */
 	bool is_idle;
 
+	/**
+	 * Protects the result caches below.  They are valid only
+	 * until the other MPD reports a "database" idle event (or
+	 * until the connection is lost), because that means its
+	 * database version has changed.
+	 */
+	mutable Mutex cache_mutex;
+
+	/**
+	 * Cached "lsinfo" responses, indexed by directory URI.
+	 */
+	mutable std::map<std::string, SharedProxyEntityList, std::less<>> directory_cache;
+
+	/**
+	 * Cached songs returned by GetSong(), indexed by URI.
+	 */
+	mutable std::map<std::string, MpdSongPtr, std::less<>> song_cache;
+
+	/**
+	 * Cached CollectUniqueTags() results, indexed by a string
+	 * describing the selection and the tag types (see
+	 * MakeUniqueTagsKey()).
+	 */
+	mutable std::map<std::string, RecursiveMap<std::string>> unique_tags_cache;
+
+	mutable std::optional<DatabaseStats> stats_cache;
+
+	static constexpr std::size_t MAX_DIRECTORY_CACHE = 1024;
+	static constexpr std::size_t MAX_SONG_CACHE = 1024;
+	static constexpr std::size_t MAX_UNIQUE_TAGS_CACHE = 16;
+
 public:
 	ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener,
 		      const ConfigBlock &block);
@@ -135,6 +213,23 @@ private:
 
 	void Disconnect() noexcept;
 
+	void ClearCache() noexcept;
+
+	/**
+	 * Obtain the "lsinfo" responses of all the given
+	 * directories.  Those which are not in the cache are
+	 * requested from the other MPD in a command list, i.e. with
+	 * only one round trip.
+	 */
+	std::vector<SharedProxyEntityList> ListDirectories(std::span<const char *const> uris) const;
+
+	void WalkDirectory(const ProxyEntityList &entities,
+			   bool recursive, const SongFilter *filter,
+			   TagMask tag_mask,
+			   const VisitDirectory &visit_directory,
+			   const VisitSong &visit_song,
+			   const VisitPlaylist &visit_playlist) const;
+
 	void OnSocketReady(unsigned flags) noexcept;
 	void OnIdle() noexcept;
 };
@@ -205,7 +300,7 @@ Copy(TagBuilder &tag, TagType d_tag,
 	}
 }
 
-ProxySong::ProxySong(const mpd_song *song)
+ProxySong::ProxySong(const mpd_song *song, TagMask tag_mask)
 	:LightSong(mpd_song_get_uri(song), tag2)
 {
 	const auto _mtime = mpd_song_get_last_modified(song);
@@ -263,7 +358,8 @@ ProxySong::ProxySong(const mpd_song *song)
 		tag_builder.SetDuration(SignedSongTime::FromS(duration));
 
 	for (const auto *i = &tag_table[0]; i->d != TAG_NUM_OF_ITEM_TYPES; ++i)
-		Copy(tag_builder, i->d, song, i->s);
+		if (tag_mask.Test(i->d))
+			Copy(tag_builder, i->d, song, i->s);
 
 	tag_builder.Commit(tag2);
 }
@@ -516,6 +612,20 @@ ProxyDatabase::Disconnect() noexcept
 
 	mpd_connection_free(connection);
 	connection = nullptr;
+
+	/* the other MPD may update its database while we're
+	   disconnected */
+	ClearCache();
+}
+
+void
+ProxyDatabase::ClearCache() noexcept
+{
+	const std::scoped_lock lock{cache_mutex};
+	directory_cache.clear();
+	song_cache.clear();
+	unique_tags_cache.clear();
+	stats_cache.reset();
 }
 
 void
@@ -555,8 +665,10 @@ ProxyDatabase::OnIdle() noexcept
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		ClearCache();
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -576,6 +688,7 @@ ProxyDatabase::OnIdle() noexcept
 		socket_event.ReleaseSocket();
 		mpd_connection_free(connection);
 		connection = nullptr;
+		ClearCache();
 		return;
 	}
 
@@ -586,6 +699,13 @@ ProxyDatabase::OnIdle() noexcept
 const LightSong *
 ProxyDatabase::GetSong(std::string_view uri) const
 {
+	{
+		const std::scoped_lock lock{cache_mutex};
+		if (auto i = song_cache.find(uri); i != song_cache.end())
+			if (auto *song = mpd_song_dup(i->second.get()))
+				return new AllocatedProxySong(song);
+	}
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -603,6 +723,15 @@ ProxyDatabase::GetSong(std::string_view uri) const
 		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 				    "No such song");
 
+	if (auto *copy = mpd_song_dup(song); copy != nullptr) {
+		const std::scoped_lock lock{cache_mutex};
+
+		if (song_cache.size() >= MAX_SONG_CACHE)
+			song_cache.clear();
+
+		song_cache.insert_or_assign(std::string{uri}, MpdSongPtr{copy});
+	}
+
 	return new AllocatedProxySong(song);
 }
 
@@ -617,18 +746,12 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const noexcept
 }
 
 static void
-Visit(struct mpd_connection *connection, const char *uri,
-      bool recursive, const SongFilter *filter,
-      const VisitDirectory& visit_directory, const VisitSong& visit_song,
-      const VisitPlaylist& visit_playlist);
-
-static void
-Visit(struct mpd_connection *connection,
-      bool recursive, const SongFilter *filter,
-      const struct mpd_directory *directory,
-      const VisitDirectory& visit_directory, const VisitSong& visit_song,
-      const VisitPlaylist& visit_playlist)
+Visit(const struct mpd_directory *directory,
+      const VisitDirectory& visit_directory)
 {
+	if (!visit_directory)
+		return;
+
 	const char *path = mpd_directory_get_path(directory);
 
 	std::chrono::system_clock::time_point mtime =
@@ -637,12 +760,7 @@ Visit(struct mpd_connection *connection,
 	if (_mtime > 0)
 		mtime = std::chrono::system_clock::from_time_t(_mtime);
 
-	if (visit_directory)
-		visit_directory(LightDirectory(path, mtime));
-
-	if (recursive)
-		Visit(connection, path, recursive, filter,
-		      visit_directory, visit_song, visit_playlist);
+	visit_directory(LightDirectory(path, mtime));
 }
 
 [[gnu::pure]]
@@ -653,14 +771,14 @@ Match(const SongFilter *filter, const LightSong &song) noexcept
 }
 
 static void
-Visit(const SongFilter *filter,
+Visit(const SongFilter *filter, TagMask tag_mask,
       const mpd_song *_song,
       const VisitSong& visit_song)
 {
 	if (!visit_song)
 		return;
 
-	const ProxySong song(_song);
+	const ProxySong song(_song, tag_mask);
 	if (Match(filter, song))
 		visit_song(song);
 }
@@ -682,55 +800,102 @@ Visit(const struct mpd_playlist *playlist,
 	visit_playlist(p, LightDirectory::Root());
 }
 
-class ProxyEntity {
+static ProxyEntityList
+ReceiveEntities(struct mpd_connection *connection) noexcept
+{
+	ProxyEntityList entities;
 	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(connection)) != nullptr)
+		entities.emplace_back(entity);
 
-public:
-	explicit ProxyEntity(struct mpd_entity *_entity) noexcept
-		:entity(_entity) {}
-
-	ProxyEntity(const ProxyEntity &other) = delete;
+	return entities;
+}
 
-	ProxyEntity(ProxyEntity &&other) noexcept
-		:entity(other.entity) {
-		other.entity = nullptr;
+std::vector<SharedProxyEntityList>
+ProxyDatabase::ListDirectories(std::span<const char *const> uris) const
+{
+	/* send only this number of "lsinfo" commands in one command
+	   list to avoid blowing the server's max_output_buffer_size
+	   limit */
+	constexpr std::size_t MAX_PIPELINE = 32;
+
+	std::vector<SharedProxyEntityList> result(uris.size());
+	std::vector<std::size_t> missing;
+
+	{
+		const std::scoped_lock lock{cache_mutex};
+		for (std::size_t i = 0; i < uris.size(); ++i) {
+			if (auto j = directory_cache.find(std::string_view{uris[i]});
+			    j != directory_cache.end())
+				result[i] = j->second;
+			else
+				missing.push_back(i);
+		}
 	}
 
-	~ProxyEntity() noexcept {
-		if (entity != nullptr)
-			mpd_entity_free(entity);
-	}
+	if (!missing.empty())
+		// TODO: eliminate the const_cast
+		const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
-	ProxyEntity &operator=(const ProxyEntity &other) = delete;
+	for (std::size_t begin = 0; begin < missing.size(); begin += MAX_PIPELINE) {
+		const auto batch = std::span{missing}.subspan(begin,
+							      std::min(missing.size() - begin,
+								       MAX_PIPELINE));
 
-	operator const struct mpd_entity *() const noexcept {
-		return entity;
-	}
-};
+		if (!mpd_command_list_begin(connection, true))
+			ThrowError(connection);
 
-static std::list<ProxyEntity>
-ReceiveEntities(struct mpd_connection *connection) noexcept
-{
-	std::list<ProxyEntity> entities;
-	struct mpd_entity *entity;
-	while ((entity = mpd_recv_entity(connection)) != nullptr)
-		entities.emplace_back(entity);
+		for (const std::size_t i : batch)
+			if (!mpd_send_list_meta(connection, uris[i]))
+				ThrowError(connection);
 
-	mpd_response_finish(connection);
-	return entities;
+		if (!mpd_command_list_end(connection))
+			ThrowError(connection);
+
+		for (const std::size_t i : batch) {
+			auto entities = std::make_shared<ProxyEntityList>(ReceiveEntities(connection));
+
+			if (i == batch.back()
+			    ? !mpd_response_finish(connection)
+			    : !mpd_response_next(connection))
+				ThrowError(connection);
+
+			result[i] = std::move(entities);
+		}
+
+		const std::scoped_lock lock{cache_mutex};
+
+		if (directory_cache.size() + batch.size() > MAX_DIRECTORY_CACHE)
+			directory_cache.clear();
+
+		for (const std::size_t i : batch)
+			directory_cache.insert_or_assign(uris[i], result[i]);
+	}
+
+	return result;
 }
 
-static void
-Visit(struct mpd_connection *connection, const char *uri,
-      bool recursive, const SongFilter *filter,
-      const VisitDirectory& visit_directory, const VisitSong& visit_song,
-      const VisitPlaylist& visit_playlist)
+void
+ProxyDatabase::WalkDirectory(const ProxyEntityList &entities,
+			     bool recursive, const SongFilter *filter,
+			     TagMask tag_mask,
+			     const VisitDirectory &visit_directory,
+			     const VisitSong &visit_song,
+			     const VisitPlaylist &visit_playlist) const
 {
-	if (!mpd_send_list_meta(connection, uri))
-		ThrowError(connection);
+	/* request all sub directories at once, instead of one round
+	   trip per directory */
+	std::vector<SharedProxyEntityList> children;
+	if (recursive) {
+		std::vector<const char *> uris;
+		for (const auto &entity : entities)
+			if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_DIRECTORY)
+				uris.push_back(mpd_directory_get_path(mpd_entity_get_directory(entity)));
+
+		children = ListDirectories(uris);
+	}
 
-	std::list<ProxyEntity> entities(ReceiveEntities(connection));
-	CheckError(connection);
+	auto child = children.begin();
 
 	for (const auto &entity : entities) {
 		switch (mpd_entity_get_type(entity)) {
@@ -738,18 +903,26 @@ Visit(struct mpd_connection *connection, const char *uri,
 			break;
 
 		case MPD_ENTITY_TYPE_DIRECTORY:
-			Visit(connection, recursive, filter,
-			      mpd_entity_get_directory(entity),
-			      visit_directory, visit_song, visit_playlist);
+			::Visit(mpd_entity_get_directory(entity),
+				visit_directory);
+
+			if (recursive) {
+				assert(child != children.end());
+				WalkDirectory(**child++, recursive, filter,
+					      tag_mask, visit_directory, visit_song,
+					      visit_playlist);
+			}
+
 			break;
 
 		case MPD_ENTITY_TYPE_SONG:
-			Visit(filter, mpd_entity_get_song(entity), visit_song);
+			::Visit(filter, tag_mask,
+				mpd_entity_get_song(entity), visit_song);
 			break;
 
 		case MPD_ENTITY_TYPE_PLAYLIST:
-			Visit(mpd_entity_get_playlist(entity),
-			      visit_playlist);
+			::Visit(mpd_entity_get_playlist(entity),
+				visit_playlist);
 			break;
 		}
 	}
@@ -853,15 +1026,32 @@ CheckSelection(DatabaseSelection selection) noexcept
 	return selection;
 }
 
+/**
+ * Which tags need to be converted to #ProxySong for this selection?
+ */
+[[gnu::pure]]
+static TagMask
+GetConvertTagMask(const DatabaseSelection &selection) noexcept
+{
+	if (selection.filter != nullptr)
+		/* the filter is evaluated locally and may need any
+		   tag */
+		return TagMask::All();
+
+	TagMask mask = selection.tag_mask;
+	if (selection.sort < TAG_NUM_OF_ITEM_TYPES)
+		/* sorting is done by DatabaseVisitorHelper */
+		mask |= selection.sort;
+
+	return mask;
+}
+
 void
 ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitDirectory visit_directory,
 		     VisitSong visit_song,
 		     VisitPlaylist visit_playlist) const
 {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
-
 	DatabaseVisitorHelper helper(CheckSelection(selection),
 				     visit_song);
 
@@ -869,23 +1059,66 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 	    selection.IsFiltered()) {
 		/* this optimized code path can only be used under
 		   certain conditions */
+		// TODO: eliminate the const_cast
+		const_cast<ProxyDatabase *>(this)->EnsureConnected();
+
 		::SearchSongs(connection, selection, visit_song);
 		helper.Commit();
 		return;
 	}
 
 	/* fall back to recursive walk (slow!) */
-	::Visit(connection, selection.uri.c_str(),
-		selection.recursive, selection.filter,
-		visit_directory, visit_song, visit_playlist);
+	const char *const uri = selection.uri.c_str();
+	const auto entities = ListDirectories({&uri, 1});
+	WalkDirectory(*entities.front(),
+		      selection.recursive, selection.filter,
+		      GetConvertTagMask(selection),
+		      visit_directory, visit_song, visit_playlist);
 
 	helper.Commit();
 }
 
+/**
+ * Build a string which identifies the parameters of a
+ * CollectUniqueTags() call, to be used as a cache key.
+ */
+[[gnu::pure]]
+static std::string
+MakeUniqueTagsKey(const DatabaseSelection &selection,
+		  std::span<const TagType> tag_types) noexcept
+{
+	std::string key;
+	for (const auto i : tag_types) {
+		key += tag_item_names[i];
+		key.push_back(' ');
+	}
+
+	key += std::to_string(selection.window.start);
+	key.push_back(':');
+	key += std::to_string(selection.window.end);
+	key.push_back(' ');
+	key += selection.uri;
+	key.push_back('\0');
+
+	if (selection.filter != nullptr)
+		key += selection.filter->ToExpression();
+
+	return key;
+}
+
 RecursiveMap<std::string>
 ProxyDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				 std::span<const TagType> tag_types) const
 try {
+	auto key = MakeUniqueTagsKey(selection, tag_types);
+
+	{
+		const std::scoped_lock lock{cache_mutex};
+		if (auto i = unique_tags_cache.find(key);
+		    i != unique_tags_cache.end())
+			return i->second;
+	}
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -935,6 +1168,17 @@ try {
 	if (!mpd_response_finish(connection))
 		ThrowError(connection);
 
+	{
+		const std::scoped_lock lock{cache_mutex};
+
+		/* clients use only a few different queries; don't
+		   let one fill the memory with all combinations */
+		if (unique_tags_cache.size() >= MAX_UNIQUE_TAGS_CACHE)
+			unique_tags_cache.clear();
+
+		unique_tags_cache.insert_or_assign(std::move(key), result);
+	}
+
 	return result;
 } catch (...) {
 	if (connection != nullptr)
@@ -949,6 +1193,12 @@ ProxyDatabase::GetStats(const DatabaseSelection &selection) const
 	// TODO: match
 	(void)selection;
 
+	{
+		const std::scoped_lock lock{cache_mutex};
+		if (stats_cache)
+			return *stats_cache;
+	}
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -965,6 +1215,9 @@ ProxyDatabase::GetStats(const DatabaseSelection &selection) const
 	stats.artist_count = mpd_stats_get_number_of_artists(stats2);
 	stats.album_count = mpd_stats_get_number_of_albums(stats2);
 	mpd_stats_free(stats2);
+
+	const std::scoped_lock lock{cache_mutex};
+	stats_cache = stats;
 	return stats;
 }
 
@@ -0,0 +1,583 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * The binary database format.  All integers are little-endian and
+ * all records are unaligned, which allows the loader to use the
+ * (memory-mapped) file contents directly:
+ *
+ * - header (magic and version)
+ * - directory records (pre-order, the root first)
+ * - song records (grouped by directory, in directory order)
+ * - tag item records (grouped by song, in song order)
+ * - playlist records (grouped by directory, in directory order)
+ * - tag type records (maps the tag type numbers used in this file
+ *   to tag names)
+ * - string table (offset/length pairs pointing into the blob)
+ * - string blob
+ * - trailer (section offsets and sizes)
+ */
+
+#include "DatabaseBinary.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/PlaylistVector.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Names.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
+#include "time/ChronoUtil.hxx"
+#include "fs/Charset.hxx"
+#include "util/PackedLittleEndian.hxx"
+#include "util/SpanCast.hxx"
+#include "Version.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+static constexpr char BINARY_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'D', 'B', '\r', '\n',
+};
+
+static constexpr uint32_t BINARY_FORMAT = 1;
+
+/**
+ * A string index denoting "no string".
+ */
+static constexpr uint32_t NO_STRING = UINT32_MAX;
+
+/**
+ * A parent index denoting "no parent" (the root directory).
+ */
+static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+/**
+ * A duration denoting "unknown".
+ */
+static constexpr uint32_t NO_DURATION = UINT32_MAX;
+
+/**
+ * A time stamp denoting "unknown".
+ */
+static constexpr uint64_t NO_TIME = UINT64_MAX;
+
+static constexpr uint8_t SONG_FLAG_HAS_PLAYLIST = 0x1;
+static constexpr uint8_t SONG_FLAG_IN_PLAYLIST = 0x2;
+
+struct BinaryHeader {
+	char magic[sizeof(BINARY_MAGIC)];
+	PackedLE32 format;
+	PackedLE32 reserved;
+};
+
+struct BinaryDirectory {
+	PackedLE32 name;
+	PackedLE32 parent;
+	PackedLE32 device;
+	PackedLE32 n_songs;
+	PackedLE32 n_playlists;
+	PackedLE64 mtime;
+};
+
+struct BinarySong {
+	PackedLE32 filename;
+	PackedLE32 target;
+	PackedLE32 n_items;
+	PackedLE32 duration_ms;
+	PackedLE32 start_ms, end_ms;
+	PackedLE32 sample_rate;
+	uint8_t format, channels;
+	uint8_t flags;
+	uint8_t reserved;
+	PackedLE64 mtime, added;
+};
+
+struct BinaryTagItem {
+	uint8_t type;
+	uint8_t reserved[3];
+	PackedLE32 value;
+};
+
+struct BinaryPlaylist {
+	PackedLE32 name;
+	PackedLE64 mtime;
+};
+
+struct BinaryTagType {
+	PackedLE32 name;
+	uint8_t enabled;
+	uint8_t reserved[3];
+};
+
+struct BinaryString {
+	PackedLE32 offset, length;
+};
+
+struct BinarySection {
+	PackedLE64 offset;
+	PackedLE32 count;
+	PackedLE32 reserved;
+};
+
+struct BinaryTrailer {
+	BinarySection directories, songs, items, playlists, tag_types, strings;
+	PackedLE64 blob_offset, blob_size;
+	PackedLE32 fs_charset;
+	PackedLE32 mpd_version;
+	char magic[sizeof(BINARY_MAGIC)];
+};
+
+static_assert(sizeof(BinaryDirectory) == 28);
+static_assert(sizeof(BinarySong) == 48);
+static_assert(sizeof(BinaryTagItem) == 8);
+static_assert(alignof(BinaryTrailer) == 1);
+
+static constexpr uint64_t
+ExportTime(std::chrono::system_clock::time_point t) noexcept
+{
+	return IsNegative(t)
+		? NO_TIME
+		: uint64_t(std::chrono::system_clock::to_time_t(t));
+}
+
+static std::chrono::system_clock::time_point
+ImportTime(uint64_t t) noexcept
+{
+	/* values which are out of range (only possible in a corrupt
+	   file) are treated as "unknown" */
+	constexpr uint64_t max_time =
+		std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::duration::max()).count();
+
+	return t >= max_time
+		? std::chrono::system_clock::time_point::min()
+		: std::chrono::system_clock::from_time_t(std::time_t(t));
+}
+
+/**
+ * Invoke a function for each directory which is saved in the
+ * database file, in pre-order.
+ */
+template<typename F>
+static void
+ForEachSavedDirectory(const Directory &directory, F &&f)
+{
+	f(directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			ForEachSavedDirectory(child, f);
+}
+
+class StringTableBuilder {
+	std::unordered_map<std::string_view, uint32_t> map;
+	std::vector<std::string_view> strings;
+
+public:
+	uint32_t Add(std::string_view s) {
+		auto [i, inserted] = map.try_emplace(s, strings.size());
+		if (inserted)
+			strings.push_back(s);
+		return i->second;
+	}
+
+	const auto &GetStrings() const noexcept {
+		return strings;
+	}
+};
+
+class BinaryWriter {
+	BufferedOutputStream &os;
+	uint64_t position = 0;
+
+public:
+	explicit BinaryWriter(BufferedOutputStream &_os) noexcept
+		:os(_os) {}
+
+	uint64_t GetPosition() const noexcept {
+		return position;
+	}
+
+	template<typename T>
+	void WriteT(const T &value) {
+		os.WriteT(value);
+		position += sizeof(value);
+	}
+
+	void Write(std::string_view s) {
+		os.Write(s);
+		position += s.size();
+	}
+};
+
+} // anonymous namespace
+
+bool
+db_is_binary(std::span<const std::byte> src) noexcept
+{
+	return src.size() >= sizeof(BINARY_MAGIC) &&
+		std::memcmp(src.data(), BINARY_MAGIC,
+			    sizeof(BINARY_MAGIC)) == 0;
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root)
+{
+	StringTableBuilder strings;
+	BinaryWriter w{os};
+	BinaryTrailer trailer{};
+
+	BinaryHeader header{};
+	std::memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+	header.format = BINARY_FORMAT;
+	w.WriteT(header);
+
+	/* directories */
+
+	std::unordered_map<const Directory *, uint32_t> directory_index;
+
+	trailer.directories.offset = w.GetPosition();
+	uint32_t n = 0;
+	ForEachSavedDirectory(root, [&](const Directory &directory){
+		BinaryDirectory d{};
+		if (directory.IsRoot()) {
+			d.name = NO_STRING;
+			d.parent = NO_PARENT;
+		} else {
+			d.name = strings.Add(directory.GetName());
+			d.parent = directory_index.at(directory.parent);
+		}
+		d.device = directory.device;
+		d.n_songs = directory.songs.size();
+		d.n_playlists = std::distance(directory.playlists.begin(),
+					      directory.playlists.end());
+		d.mtime = ExportTime(directory.mtime);
+		w.WriteT(d);
+
+		directory_index.emplace(&directory, n++);
+	});
+	trailer.directories.count = n;
+
+	/* songs */
+
+	trailer.songs.offset = w.GetPosition();
+	n = 0;
+	ForEachSavedDirectory(root, [&](const Directory &directory){
+		for (const auto &song : directory.songs) {
+			BinarySong s{};
+			s.filename = strings.Add(song.filename);
+			s.target = song.target.empty()
+				? NO_STRING
+				: strings.Add(song.target);
+
+			s.n_items = song.tag.num_items;
+			s.duration_ms = song.tag.duration.IsNegative()
+				? NO_DURATION
+				: uint32_t(song.tag.duration.ToMS());
+
+			s.start_ms = song.start_time.ToMS();
+			s.end_ms = song.end_time.ToMS();
+			s.sample_rate = song.audio_format.sample_rate;
+			s.format = uint8_t(song.audio_format.format);
+			s.channels = song.audio_format.channels;
+
+			if (song.tag.has_playlist)
+				s.flags |= SONG_FLAG_HAS_PLAYLIST;
+			if (song.in_playlist)
+				s.flags |= SONG_FLAG_IN_PLAYLIST;
+
+			s.mtime = ExportTime(song.mtime);
+			s.added = ExportTime(song.added);
+			w.WriteT(s);
+			++n;
+		}
+	});
+	trailer.songs.count = n;
+
+	/* tag items */
+
+	trailer.items.offset = w.GetPosition();
+	n = 0;
+	ForEachSavedDirectory(root, [&](const Directory &directory){
+		for (const auto &song : directory.songs) {
+			for (const auto &item : song.tag) {
+				BinaryTagItem i{};
+				i.type = item.type;
+				i.value = strings.Add(item.value);
+				w.WriteT(i);
+				++n;
+			}
+		}
+	});
+	trailer.items.count = n;
+
+	/* playlists */
+
+	trailer.playlists.offset = w.GetPosition();
+	n = 0;
+	ForEachSavedDirectory(root, [&](const Directory &directory){
+		for (const auto &pi : directory.playlists) {
+			BinaryPlaylist p{};
+			p.name = strings.Add(pi.name);
+			p.mtime = ExportTime(pi.mtime);
+			w.WriteT(p);
+			++n;
+		}
+	});
+	trailer.playlists.count = n;
+
+	/* tag types */
+
+	trailer.tag_types.offset = w.GetPosition();
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		BinaryTagType t{};
+		t.name = strings.Add(tag_item_names[i]);
+		t.enabled = IsTagEnabled(i);
+		w.WriteT(t);
+	}
+	trailer.tag_types.count = TAG_NUM_OF_ITEM_TYPES;
+
+	trailer.fs_charset = strings.Add(GetFSCharset());
+	trailer.mpd_version = strings.Add(VERSION);
+
+	/* string table */
+
+	trailer.strings.offset = w.GetPosition();
+	uint64_t blob_size = 0;
+	for (const auto s : strings.GetStrings()) {
+		if (blob_size + s.size() > UINT32_MAX)
+			throw std::runtime_error("Database is too large");
+
+		BinaryString bs{};
+		bs.offset = uint32_t(blob_size);
+		bs.length = uint32_t(s.size());
+		w.WriteT(bs);
+
+		blob_size += s.size();
+	}
+	trailer.strings.count = strings.GetStrings().size();
+
+	trailer.blob_offset = w.GetPosition();
+	for (const auto s : strings.GetStrings())
+		w.Write(s);
+	trailer.blob_size = blob_size;
+
+	std::memcpy(trailer.magic, BINARY_MAGIC, sizeof(trailer.magic));
+	w.WriteT(trailer);
+}
+
+namespace {
+
+class BinaryReader {
+	const std::span<const std::byte> src;
+
+	std::span<const BinaryString> strings;
+	std::span<const std::byte> blob;
+
+public:
+	explicit BinaryReader(std::span<const std::byte> _src) noexcept
+		:src(_src) {}
+
+	template<typename T>
+	std::span<const T> GetSection(uint64_t offset, uint64_t count) const {
+		if (offset > src.size() ||
+		    count > (src.size() - offset) / sizeof(T))
+			throw std::runtime_error("Database corrupted");
+
+		return FromBytesStrict<const T>(src.subspan(offset,
+							    count * sizeof(T)));
+	}
+
+	template<typename T>
+	std::span<const T> GetSection(const BinarySection &section) const {
+		return GetSection<T>(section.offset, section.count);
+	}
+
+	void SetStrings(const BinaryTrailer &trailer) {
+		strings = GetSection<BinaryString>(trailer.strings);
+		blob = GetSection<std::byte>(trailer.blob_offset,
+					     trailer.blob_size);
+	}
+
+	std::string_view GetString(uint32_t i) const {
+		if (i >= strings.size())
+			throw std::runtime_error("Database corrupted");
+
+		const auto &s = strings[i];
+		const uint32_t offset = s.offset, length = s.length;
+		if (offset > blob.size() || length > blob.size() - offset)
+			throw std::runtime_error("Database corrupted");
+
+		return ToStringView(blob.subspan(offset, length));
+	}
+};
+
+template<typename T>
+class SectionCursor {
+	std::span<const T> items;
+
+public:
+	explicit SectionCursor(std::span<const T> _items) noexcept
+		:items(_items) {}
+
+	std::span<const T> Take(std::size_t n) {
+		if (n > items.size())
+			throw std::runtime_error("Database corrupted");
+
+		auto result = items.first(n);
+		items = items.subspan(n);
+		return result;
+	}
+};
+
+} // anonymous namespace
+
+void
+db_load_binary(std::span<const std::byte> src, Directory &root,
+	       bool ignore_config_mismatches)
+{
+	if (!db_is_binary(src) ||
+	    src.size() < sizeof(BinaryHeader) + sizeof(BinaryTrailer))
+		throw std::runtime_error("Database corrupted");
+
+	const auto &header = *(const BinaryHeader *)(const void *)src.data();
+	if (header.format != BINARY_FORMAT)
+		throw std::runtime_error("Database format mismatch, "
+					 "discarding database file");
+
+	const auto &trailer = *(const BinaryTrailer *)(const void *)
+		(src.data() + src.size() - sizeof(BinaryTrailer));
+	if (std::memcmp(trailer.magic, BINARY_MAGIC,
+			sizeof(trailer.magic)) != 0)
+		throw std::runtime_error("Database corrupted");
+
+	BinaryReader r{src};
+	r.SetStrings(trailer);
+
+	if (!ignore_config_mismatches) {
+		const auto new_charset = r.GetString(trailer.fs_charset);
+		const std::string_view old_charset = GetFSCharset();
+		if (!old_charset.empty() && new_charset != old_charset)
+			throw FmtRuntimeError("Existing database has charset "
+					      "{:?} instead of {:?}; "
+					      "discarding database file",
+					      new_charset, old_charset);
+	}
+
+	/* map the tag type numbers in the file to ours */
+
+	const auto tag_types = r.GetSection<BinaryTagType>(trailer.tag_types);
+	if (tag_types.size() > 256)
+		throw std::runtime_error("Database corrupted");
+
+	TagType tag_map[256];
+	std::fill(std::begin(tag_map), std::end(tag_map),
+		  TAG_NUM_OF_ITEM_TYPES);
+
+	bool tags[TAG_NUM_OF_ITEM_TYPES]{};
+
+	for (std::size_t i = 0; i < tag_types.size(); ++i) {
+		const auto name = r.GetString(tag_types[i].name);
+		const TagType type = tag_name_parse(name);
+		if (type == TAG_NUM_OF_ITEM_TYPES) {
+			if (ignore_config_mismatches)
+				continue;
+
+			throw FmtRuntimeError("Unrecognized tag {:?}, "
+					      "discarding database file",
+					      name);
+		}
+
+		tag_map[i] = type;
+		tags[type] = tag_types[i].enabled != 0;
+	}
+
+	if (!ignore_config_mismatches)
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			if (IsTagEnabled(i) && !tags[i])
+				throw std::runtime_error("Tag list mismatch, "
+							 "discarding database file");
+
+	const auto directories =
+		r.GetSection<BinaryDirectory>(trailer.directories);
+	if (directories.empty() || directories.front().parent != NO_PARENT)
+		throw std::runtime_error("Database corrupted");
+
+	SectionCursor songs{r.GetSection<BinarySong>(trailer.songs)};
+	SectionCursor items{r.GetSection<BinaryTagItem>(trailer.items)};
+	SectionCursor playlists{r.GetSection<BinaryPlaylist>(trailer.playlists)};
+
+	std::vector<Directory *> directory_map;
+	directory_map.reserve(directories.size());
+
+	const ScopeDatabaseLock protect;
+
+	for (const auto &d : directories) {
+		Directory *directory;
+
+		if (directory_map.empty()) {
+			directory = &root;
+		} else {
+			const uint32_t parent = d.parent;
+			if (parent >= directory_map.size())
+				throw std::runtime_error("Database corrupted");
+
+			directory = directory_map[parent]->CreateChild(r.GetString(d.name));
+			directory->device = d.device;
+			directory->mtime = ImportTime(d.mtime);
+		}
+
+		directory_map.push_back(directory);
+
+		for (const auto &s : songs.Take(d.n_songs)) {
+			auto song = std::make_unique<Song>(r.GetString(s.filename),
+							   *directory);
+
+			if (s.target != NO_STRING)
+				song->target = r.GetString(s.target);
+
+			TagBuilder tag;
+			for (const auto &i : items.Take(s.n_items)) {
+				const TagType type = tag_map[i.type];
+				if (type != TAG_NUM_OF_ITEM_TYPES)
+					tag.AddItemUnchecked(type,
+							     r.GetString(i.value));
+			}
+
+			if (s.duration_ms != NO_DURATION)
+				tag.SetDuration(SignedSongTime::FromMS(s.duration_ms));
+
+			tag.SetHasPlaylist(s.flags & SONG_FLAG_HAS_PLAYLIST);
+			tag.Commit(song->tag);
+
+			song->in_playlist = s.flags & SONG_FLAG_IN_PLAYLIST;
+			song->start_time = SongTime::FromMS(s.start_ms);
+			song->end_time = SongTime::FromMS(s.end_ms);
+
+			song->audio_format = AudioFormat(s.sample_rate,
+							 SampleFormat(s.format),
+							 s.channels);
+			if (song->audio_format.IsDefined() &&
+			    !song->audio_format.IsValid())
+				song->audio_format = AudioFormat::Undefined();
+
+			song->mtime = ImportTime(s.mtime);
+			song->added = ImportTime(s.added);
+
+			directory->AddSong(std::move(song));
+		}
+
+		for (const auto &p : playlists.Take(d.n_playlists))
+			directory->playlists.UpdateOrInsert(PlaylistInfo(r.GetString(p.name),
+									 ImportTime(p.mtime)));
+	}
+}
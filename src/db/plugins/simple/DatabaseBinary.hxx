@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+#include <cstddef>
+#include <span>
+
+struct Directory;
+class BufferedOutputStream;
+
+/**
+ * Does the given buffer look like a binary database file?
+ */
+[[gnu::pure]]
+bool
+db_is_binary(std::span<const std::byte> src) noexcept;
+
+/**
+ * Write the database in the binary format.  It consists of
+ * fixed-layout records for directories, songs, tag items and
+ * playlists, followed by a string table which stores each distinct
+ * string only once.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Load a database file in the binary format, usually from a
+ * memory-mapped file.  The caller must not hold the database lock.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param ignore_config_mismatches if true, then configuration
+ * mismatches (e.g. enabled tags or filesystem charset) are ignored
+ */
+void
+db_load_binary(std::span<const std::byte> src, Directory &root,
+	       bool ignore_config_mismatches=false);
+
+#endif
@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "db/DatabaseLock.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/LineReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#define JOURNAL_BEGIN "journal_begin"
+#define JOURNAL_BASE "base: "
+#define JOURNAL_RECORD_BEGIN "record_begin"
+#define JOURNAL_RECORD_END "record_end"
+#define JOURNAL_REPLACE "replace: "
+#define JOURNAL_CHILD "child: "
+#define JOURNAL_CHILDREN_END "children_end"
+
+static constexpr Domain journal_domain("db_journal");
+
+namespace {
+
+/**
+ * A #LineReader which reads lines collected by db_journal_replay().
+ */
+class VectorLineReader final : public LineReader {
+	std::vector<std::string> &lines;
+	std::size_t next = 0;
+
+public:
+	explicit VectorLineReader(std::vector<std::string> &_lines) noexcept
+		:lines(_lines) {}
+
+	/* virtual methods from class LineReader */
+	char *ReadLine() override {
+		if (next >= lines.size())
+			return nullptr;
+
+		return lines[next++].data();
+	}
+};
+
+} // anonymous namespace
+
+[[gnu::pure]]
+static std::string
+FormatBase(const FileInfo &base)
+{
+	const auto mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(base.GetModificationTime().time_since_epoch());
+	return fmt::format("{} {}", base.GetSize(), mtime.count());
+}
+
+void
+db_journal_write_header(BufferedOutputStream &os, const FileInfo &base)
+{
+	os.Write(JOURNAL_BEGIN "\n");
+	os.Fmt(FMT_STRING(JOURNAL_BASE "{}\n"), FormatBase(base));
+}
+
+/**
+ * Write a "replace" block for each modified #Directory in the given
+ * subtree (but not in mounted databases).
+ *
+ * @param empty true if nothing has been written yet; the
+ * "record_begin" line is written before the first block
+ */
+static void
+WriteModified(BufferedOutputStream &os, const Directory &directory,
+	      bool &empty)
+{
+	if (directory.modified) {
+		if (empty) {
+			os.Write(JOURNAL_RECORD_BEGIN "\n");
+			empty = false;
+		}
+
+		os.Fmt(FMT_STRING(JOURNAL_REPLACE "{}\n"), directory.GetPath());
+		directory_save_contents(os, directory);
+
+		/* the list of children allows db_journal_replay() to
+		   find out which ones have been deleted */
+		for (const auto &child : directory.children)
+			if (!child.IsMount())
+				os.Fmt(FMT_STRING(JOURNAL_CHILD "{}\n"),
+				       child.GetName());
+
+		os.Write(JOURNAL_CHILDREN_END "\n");
+	}
+
+	for (const auto &child : directory.children)
+		if (child.subtree_modified && !child.IsMount())
+			WriteModified(os, child, empty);
+}
+
+bool
+db_journal_write(BufferedOutputStream &os, const Directory &root)
+{
+	assert(holding_db_lock());
+
+	if (!root.subtree_modified)
+		return false;
+
+	bool empty = true;
+	WriteModified(os, root, empty);
+	if (empty)
+		return false;
+
+	os.Write(JOURNAL_RECORD_END "\n");
+	return true;
+}
+
+/**
+ * Look up a #Directory by its path, creating it (and its ancestors)
+ * if it does not exist.
+ */
+static Directory &
+MakeDirectory(Directory &root, std::string_view path)
+{
+	Directory *directory = &root;
+	if (path.empty())
+		return *directory;
+
+	for (const std::string_view name : IterableSplitString(path, '/')) {
+		if (name.empty())
+			throw FmtRuntimeError("Malformed path: {:?}", path);
+
+		directory = directory->MakeChild(name);
+	}
+
+	return *directory;
+}
+
+/**
+ * Read the list of children written by WriteModified() and delete all
+ * children of the given #Directory which are not listed.
+ */
+static void
+LoadChildren(LineReader &reader, Directory &directory)
+{
+	std::unordered_set<std::string_view> names;
+
+	const char *line;
+	while (true) {
+		line = reader.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of record");
+
+		if (StringIsEqual(line, JOURNAL_CHILDREN_END))
+			break;
+
+		const char *p = StringAfterPrefix(line, JOURNAL_CHILD);
+		if (p == nullptr)
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+
+		names.emplace(p);
+	}
+
+	directory.ForEachChildSafe([&names](Directory &child){
+		if (!child.IsMount() && !names.contains(child.GetName()))
+			child.Delete();
+	});
+}
+
+/**
+ * Apply one record (which was read completely already).
+ */
+static void
+ApplyRecord(std::vector<std::string> &lines, Directory &root)
+{
+	VectorLineReader reader{lines};
+
+	const char *line;
+	while ((line = reader.ReadLine()) != nullptr) {
+		const char *p = StringAfterPrefix(line, JOURNAL_REPLACE);
+		if (p == nullptr)
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+
+		Directory &directory = MakeDirectory(root, p);
+		if (directory.IsMount())
+			throw FmtRuntimeError("Mount point in journal: {:?}",
+					      p);
+
+		directory_load_contents(reader, directory);
+		LoadChildren(reader, directory);
+	}
+}
+
+bool
+db_journal_replay(LineReader &file, const FileInfo &base, Directory &root)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringIsEqual(line, JOURNAL_BEGIN)) {
+		LogWarning(journal_domain, "Malformed journal, ignoring it");
+		return false;
+	}
+
+	line = file.ReadLine();
+	const char *p;
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_BASE)) == nullptr ||
+	    FormatBase(base) != p) {
+		LogInfo(journal_domain,
+			"Journal does not belong to the database file, ignoring it");
+		return false;
+	}
+
+	const ScopeDatabaseLock protect;
+
+	unsigned n_records = 0;
+	bool success = true;
+	std::vector<std::string> lines;
+
+	while ((line = file.ReadLine()) != nullptr) {
+		if (!StringIsEqual(line, JOURNAL_RECORD_BEGIN)) {
+			LogWarning(journal_domain, "Malformed journal record");
+			success = false;
+			break;
+		}
+
+		lines.clear();
+		bool complete = false;
+		while ((line = file.ReadLine()) != nullptr) {
+			if (StringIsEqual(line, JOURNAL_RECORD_END)) {
+				complete = true;
+				break;
+			}
+
+			lines.emplace_back(line);
+		}
+
+		if (!complete) {
+			/* the last write was interrupted */
+			LogWarning(journal_domain,
+				   "Ignoring truncated journal record");
+			success = false;
+			break;
+		}
+
+		try {
+			ApplyRecord(lines, root);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to apply journal record");
+			success = false;
+			break;
+		}
+
+		++n_records;
+	}
+
+	if (n_records > 0)
+		/* new directories have been appended to the end of
+		   their parent's list */
+		root.Sort();
+
+	FmtDebug(journal_domain, "Replayed {} journal records", n_records);
+	return success;
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+struct Directory;
+class BufferedOutputStream;
+class LineReader;
+class FileInfo;
+
+/*
+ * The "journal" is an append-only text file next to the database
+ * file.  Instead of rewriting the whole database after each update,
+ * only the directories which have changed are appended to it; each
+ * record replaces the attributes, songs and playlists of a directory
+ * and the list of its children (deleting the ones which are not
+ * listed anymore).  At load time, the journal is replayed on top of
+ * the database file.
+ *
+ * The changed directories are those which have been flagged by the
+ * database update (see Directory::MarkModified()).
+ */
+
+/**
+ * Write the header of a new journal file.
+ *
+ * @param base the database file the journal applies to
+ */
+void
+db_journal_write_header(BufferedOutputStream &os, const FileInfo &base);
+
+/**
+ * Append a record with all directories which have been flagged with
+ * Directory::MarkModified() to the stream.  The caller is responsible
+ * for calling Directory::ClearModified() after the record has been
+ * committed to disk.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @return false if nothing has changed (and nothing was written)
+ */
+bool
+db_journal_write(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Apply all complete records from the journal to the tree.  If the
+ * journal does not belong to the given database file, it is ignored.
+ *
+ * Throws on I/O error.
+ *
+ * @param base the database file which has been loaded into the tree
+ * @return true if the journal was replayed successfully, false if it
+ * was ignored or had a truncated or malformed record (and thus must
+ * be compacted with the next save)
+ */
+bool
+db_journal_replay(LineReader &file, const FileInfo &base, Directory &root);
+
+#endif
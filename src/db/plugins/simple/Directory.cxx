@@ -6,6 +6,7 @@
 #include "SongSort.hxx"
 #include "Song.hxx"
 #include "Mount.hxx"
+#include "NodePool.hxx"
 #include "db/LightDirectory.hxx"
 #include "db/Uri.hxx"
 #include "db/DatabaseLock.hxx"
@@ -15,17 +16,104 @@
 #include "lib/icu/Collate.hxx"
 #include "fs/Traits.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/djb_hash.hxx"
 #include "util/SortList.hxx"
+#include "util/SpanCast.hxx"
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 
 #include <cassert>
+#include <utility>
 
 #include <string.h>
 #include <stdlib.h>
 
 using std::string_view_literals::operator""sv;
 
+static NodePool<Directory, 256> directory_pool;
+
+/**
+ * Identifies a #Directory or a #Song by its parent and its name.
+ */
+struct DirectoryEntryKey {
+	const Directory *parent;
+	std::string_view name;
+
+	friend constexpr bool operator==(const DirectoryEntryKey &,
+					 const DirectoryEntryKey &) noexcept = default;
+
+	struct Hash {
+		[[gnu::pure]]
+		std::size_t operator()(const DirectoryEntryKey &key) const noexcept {
+			return djb_hash(AsBytes(key.name),
+					reinterpret_cast<std::size_t>(key.parent));
+		}
+	};
+
+	struct GetDirectoryKey {
+		[[gnu::pure]]
+		DirectoryEntryKey operator()(const Directory &directory) const noexcept {
+			return {directory.parent, directory.GetName()};
+		}
+	};
+
+	struct GetSongKey {
+		[[gnu::pure]]
+		DirectoryEntryKey operator()(const Song &song) const noexcept {
+			return {&song.parent, song.filename};
+		}
+	};
+};
+
+/**
+ * All child directories of all #Directory objects, indexed by parent
+ * and name.  This avoids a linear search in FindChild(), which would
+ * be slow on large directories.
+ *
+ * Protected with the global #db_mutex.
+ */
+static IntrusiveHashSet<Directory, 8192,
+	IntrusiveHashSetOperators<Directory,
+				  DirectoryEntryKey::GetDirectoryKey,
+				  DirectoryEntryKey::Hash,
+				  std::equal_to<DirectoryEntryKey>>,
+	IntrusiveHashSetMemberHookTraits<&Directory::index_hook>,
+	IntrusiveHashSetOptions{.zero_initialized = true}> directory_index;
+
+/**
+ * All songs of all #Directory objects, indexed by parent and file
+ * name.
+ *
+ * Protected with the global #db_mutex.
+ */
+static IntrusiveHashSet<Song, 32768,
+	IntrusiveHashSetOperators<Song,
+				  DirectoryEntryKey::GetSongKey,
+				  DirectoryEntryKey::Hash,
+				  std::equal_to<DirectoryEntryKey>>,
+	IntrusiveHashSetMemberHookTraits<&Song::index_hook>,
+	IntrusiveHashSetOptions{.zero_initialized = true}> song_index;
+
+void *
+Directory::operator new([[maybe_unused]] std::size_t size)
+{
+	assert(size == sizeof(Directory));
+
+	return directory_pool.Allocate();
+}
+
+void
+Directory::operator delete(void *p) noexcept
+{
+	directory_pool.Free(p);
+}
+
+NodePoolStats
+Directory::GetPoolStats() noexcept
+{
+	return directory_pool.GetStats();
+}
+
 Directory::Directory(std::string &&_path_utf8, Directory *_parent) noexcept
 	:parent(_parent),
 	 path(std::move(_path_utf8))
@@ -46,9 +134,10 @@ Directory::~Directory() noexcept
 void
 Directory::Delete() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(parent != nullptr);
 
+	parent->MarkModified();
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -72,7 +161,7 @@ Directory::GetName() const noexcept
 Directory *
 Directory::CreateChild(std::string_view name_utf8) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(!name_utf8.empty());
 
 	std::string path_utf8 = IsRoot()
@@ -81,6 +170,8 @@ Directory::CreateChild(std::string_view name_utf8) noexcept
 
 	auto *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	directory_index.insert(*child);
+	child->MarkModified();
 	return child;
 }
 
@@ -89,11 +180,8 @@ Directory::FindChild(std::string_view name) const noexcept
 {
 	assert(holding_db_lock());
 
-	for (const auto &child : children)
-		if (child.GetName() == name)
-			return &child;
-
-	return nullptr;
+	const auto i = std::as_const(directory_index).find(DirectoryEntryKey{this, name});
+	return i != directory_index.end() ? &*i : nullptr;
 }
 
 Song *
@@ -114,7 +202,7 @@ Directory::LookupTargetSong(std::string_view target) noexcept
 void
 Directory::ClearInPlaylist() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	for (auto &child : children)
 		child.ClearInPlaylist();
@@ -123,19 +211,32 @@ Directory::ClearInPlaylist() noexcept
 		song.in_playlist = false;
 }
 
+void
+Directory::ClearModified() noexcept
+{
+	assert(holding_db_write_lock());
+
+	modified = subtree_modified = false;
+
+	for (auto &child : children)
+		if (child.subtree_modified)
+			child.ClearModified();
+}
+
 void
 Directory::PruneEmpty() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty() && !child->IsMount())
+		if (child->IsEmpty() && !child->IsMount()) {
 			child = children.erase_and_dispose(child,
 							   DeleteDisposer());
-		else
+			MarkModified();
+		} else
 			++child;
 	}
 }
@@ -172,21 +273,25 @@ Directory::LookupDirectory(std::string_view _uri) noexcept
 void
 Directory::AddSong(SongPtr song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
+	song_index.insert(*song);
 	songs.push_back(*song.release());
+	MarkModified();
 }
 
 SongPtr
 Directory::RemoveSong(Song *song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+	song->index_hook.unlink();
+	MarkModified();
 	return SongPtr(song);
 }
 
@@ -195,14 +300,12 @@ Directory::FindSong(std::string_view name_utf8) const noexcept
 {
 	assert(holding_db_lock());
 
-	for (auto &song : songs) {
-		assert(&song.parent == this);
-
-		if (song.filename == name_utf8)
-			return &song;
-	}
+	const auto i = std::as_const(song_index).find(DirectoryEntryKey{this, name_utf8});
+	if (i == song_index.end())
+		return nullptr;
 
-	return nullptr;
+	assert(&i->parent == this);
+	return &*i;
 }
 
 [[gnu::pure]]
@@ -215,7 +318,7 @@ directory_cmp(const Directory &a, const Directory &b) noexcept
 void
 Directory::Sort() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	SortList(children, directory_cmp);
 	song_list_sort(songs);
@@ -236,7 +339,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		const ScopeDatabaseUnlock unlock;
+		const ScopeDatabaseReadUnlock unlock;
 		WalkMount(GetPath(), *mounted_database,
 			  "", DatabaseSelection("", recursive, filter),
 			  visit_directory, visit_song,
@@ -9,6 +9,7 @@
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "db/Ptr.hxx"
+#include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <string>
@@ -42,6 +43,13 @@ struct Directory : IntrusiveListHook<> {
 
 	using List = IntrusiveList<Directory>;
 
+	/**
+	 * Links this directory into a global hash table indexed by
+	 * parent and name, for FindChild().  Protected with the
+	 * global #db_mutex, just like the list hook.
+	 */
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> index_hook;
+
 	/**
 	 * A doubly linked list of child directories.
 	 *
@@ -81,10 +89,43 @@ struct Directory : IntrusiveListHook<> {
 	 */
 	bool mark;
 
+	/**
+	 * Has this directory (its attributes, songs or playlists, or
+	 * the list of its children) been modified since the database
+	 * was last loaded or saved?  This is used to decide which
+	 * directories need to be written to the journal (see
+	 * DatabaseJournal.hxx).
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	bool modified = false;
+
+	/**
+	 * Has this directory or one of its descendants been modified?
+	 * If this is false, then #modified is false for the whole
+	 * subtree.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	bool subtree_modified = false;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent) noexcept;
 	~Directory() noexcept;
 
+	/**
+	 * Like #Song, #Directory objects are allocated from a
+	 * #NodePool.
+	 */
+	static void *operator new(std::size_t size);
+	static void operator delete(void *p) noexcept;
+
+	/**
+	 * Returns the statistics of the #NodePool which holds all
+	 * #Directory objects.
+	 */
+	static NodePoolStats GetPoolStats() noexcept;
+
 	/**
 	 * Create a new root #Directory object.
 	 */
@@ -119,6 +160,30 @@ public:
 	[[gnu::pure]]
 	bool IsPluginAvailable() const noexcept;
 
+	/**
+	 * Set the #modified flag of this directory and the
+	 * #subtree_modified flag of it and all of its ancestors.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void MarkModified() noexcept {
+		modified = true;
+
+		for (Directory *i = this;
+		     i != nullptr && !i->subtree_modified;
+		     i = i->parent)
+			i->subtree_modified = true;
+	}
+
+	/**
+	 * Clear the #modified and #subtree_modified flags of this
+	 * directory and all of its descendants.  Call this after the
+	 * whole tree has been saved.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void ClearModified() noexcept;
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
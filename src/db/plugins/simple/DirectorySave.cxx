@@ -11,6 +11,7 @@
 #include "io/BufferedOutputStream.hxx"
 #include "time/ChronoUtil.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "util/DeleteDisposer.hxx"
 #include "util/StringAPI.hxx"
 #include "util/StringCompare.hxx"
 #include "util/CNumberParser.hxx"
@@ -61,18 +62,23 @@ ParseTypeString(const char *type) noexcept
 		return 0;
 }
 
+static void
+SaveAttributes(BufferedOutputStream &os, const Directory &directory)
+{
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Fmt(FMT_STRING(DIRECTORY_TYPE "{}\n"), type);
+
+	if (!IsNegative(directory.mtime))
+		os.Fmt(FMT_STRING(DIRECTORY_MTIME "{}\n"),
+		       std::chrono::system_clock::to_time_t(directory.mtime));
+}
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory)
 {
 	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Fmt(FMT_STRING(DIRECTORY_TYPE "{}\n"), type);
-
-		if (!IsNegative(directory.mtime))
-			os.Fmt(FMT_STRING(DIRECTORY_MTIME "{}\n"),
-			       std::chrono::system_clock::to_time_t(directory.mtime));
-
+		SaveAttributes(os, directory);
 		os.Fmt(FMT_STRING(DIRECTORY_BEGIN "{}\n"), directory.GetPath());
 	}
 
@@ -93,6 +99,20 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 		os.Fmt(FMT_STRING(DIRECTORY_END "{}\n"), directory.GetPath());
 }
 
+void
+directory_save_contents(BufferedOutputStream &os, const Directory &directory)
+{
+	if (!directory.IsRoot())
+		SaveAttributes(os, directory);
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Fmt(FMT_STRING(DIRECTORY_END "{}\n"), directory.GetPath());
+}
+
 static bool
 ParseLine(Directory &directory, const char *line)
 {
@@ -136,6 +156,43 @@ directory_load_subdir(LineReader &file, Directory &parent, std::string_view name
 	return directory;
 }
 
+/**
+ * Parse a song or playlist definition.
+ *
+ * @return false if the line was not recognized
+ */
+static bool
+LoadEntry(LineReader &file, Directory &directory, const char *line,
+	  std::set<std::string_view> &songs)
+{
+	const char *p;
+	if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+		const char *name = p;
+
+		std::string target;
+		bool in_playlist = false;
+		auto detached_song = song_load(file, name,
+					       &target, &in_playlist);
+
+		auto song = std::make_unique<Song>(std::move(detached_song),
+						   directory);
+		song->target = std::move(target);
+		song->in_playlist = in_playlist;
+
+		if (!songs.emplace(song->filename).second)
+			throw FmtRuntimeError("Duplicate song {:?}",
+					      name);
+
+		directory.AddSong(std::move(song));
+	} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
+		const char *name = p;
+		playlist_metadata_load(file, directory.playlists, name);
+	} else
+		return false;
+
+	return true;
+}
+
 void
 directory_load(LineReader &file, Directory &directory)
 {
@@ -154,29 +211,34 @@ directory_load(LineReader &file, Directory &directory)
 			const std::string_view name = child->GetName();
 			if (!children.emplace(name).second)
 				throw FmtRuntimeError("Duplicate subdirectory {:?}", name);
-		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
-			const char *name = p;
-
-			std::string target;
-			bool in_playlist = false;
-			auto detached_song = song_load(file, name,
-						       &target, &in_playlist);
-
-			auto song = std::make_unique<Song>(std::move(detached_song),
-							   directory);
-			song->target = std::move(target);
-			song->in_playlist = in_playlist;
-
-			if (!songs.emplace(song->filename).second)
-				throw FmtRuntimeError("Duplicate song {:?}",
-						      name);
-
-			directory.AddSong(std::move(song));
-		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
-			const char *name = p;
-			playlist_metadata_load(file, directory.playlists, name);
-		} else {
+		} else if (!LoadEntry(file, directory, line, songs))
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+	}
+}
+
+void
+directory_load_contents(LineReader &file, Directory &directory)
+{
+	directory.songs.clear_and_dispose(DeleteDisposer{});
+	directory.playlists = {};
+	directory.mtime = std::chrono::system_clock::time_point::min();
+	if (!directory.IsRoot())
+		directory.device = 0;
+
+	std::set<std::string_view> songs;
+
+	while (true) {
+		const char *line = file.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of file");
+
+		if (StringStartsWith(line, DIRECTORY_END))
+			break;
+
+		if (!directory.IsRoot() && ParseLine(directory, line))
+			continue;
+
+		if (!LoadEntry(file, directory, line, songs))
 			throw FmtRuntimeError("Malformed line: {:?}", line);
-		}
 	}
 }
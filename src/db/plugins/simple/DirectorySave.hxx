@@ -17,4 +17,21 @@ directory_save(BufferedOutputStream &os, const Directory &directory);
 void
 directory_load(LineReader &file, Directory &directory);
 
+/**
+ * Save the attributes, songs and playlists of the given directory,
+ * but not its children.  This is used by the database journal.
+ */
+void
+directory_save_contents(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * Load what was saved by directory_save_contents(), replacing the
+ * attributes, songs and playlists of the given #Directory (but not
+ * its children).
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+directory_load_contents(LineReader &file, Directory &directory);
+
 #endif
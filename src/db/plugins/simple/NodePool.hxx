@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_DB_SIMPLE_NODE_POOL_HXX
+#define MPD_DB_SIMPLE_NODE_POOL_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+struct NodePoolStats {
+	/**
+	 * The number of nodes currently in use.
+	 */
+	std::size_t n_allocated;
+
+	/**
+	 * The number of bytes allocated by the pool, including the
+	 * free slots.
+	 */
+	std::size_t size;
+};
+
+/**
+ * A slab allocator for the fixed-size tree nodes of the simple
+ * database (#Song and #Directory).  A database with hundreds of
+ * thousands of songs would otherwise consist of as many small
+ * individual heap allocations, each with its own malloc header and
+ * scattered all over the heap.  This pool carves them from large
+ * blocks instead: nodes created in sequence (e.g. while loading the
+ * database file) are adjacent in memory, which makes walking the
+ * tree much more cache-friendly.
+ *
+ * Freed slots are kept in a free list for reuse; the blocks are
+ * released only after all nodes have been freed.
+ *
+ * This class is thread-safe, because songs may be created by
+ * several update threads concurrently.
+ */
+template<typename T, std::size_t N=1024>
+class NodePool {
+	union Slot {
+		Slot *next;
+		alignas(T) std::byte data[sizeof(T)];
+	};
+
+	struct Block {
+		Block *next;
+		Slot slots[N];
+	};
+
+	Mutex mutex;
+
+	/**
+	 * A linked list of all blocks; the first one is the one
+	 * being filled by Allocate().
+	 */
+	Block *blocks = nullptr;
+
+	/**
+	 * A linked list of slots which were freed.
+	 */
+	Slot *free_list = nullptr;
+
+	/**
+	 * The number of slots in the first block which have been
+	 * handed out already.
+	 */
+	std::size_t block_fill = N;
+
+	/**
+	 * The number of slots currently in use.
+	 */
+	std::size_t n_allocated = 0;
+
+	/**
+	 * The number of blocks in #blocks.
+	 */
+	std::size_t n_blocks = 0;
+
+public:
+	NodePool() noexcept = default;
+
+	~NodePool() noexcept {
+		ReleaseBlocks();
+	}
+
+	NodePool(const NodePool &) = delete;
+	NodePool &operator=(const NodePool &) = delete;
+
+	NodePoolStats GetStats() noexcept {
+		const std::scoped_lock lock{mutex};
+		return {n_allocated, n_blocks * sizeof(Block)};
+	}
+
+	[[gnu::malloc]] [[gnu::returns_nonnull]]
+	void *Allocate() {
+		const std::scoped_lock lock{mutex};
+
+		void *result;
+		if (free_list != nullptr) {
+			Slot *slot = free_list;
+			free_list = slot->next;
+			result = slot;
+		} else {
+			if (block_fill == N) {
+				auto *block = new Block;
+				block->next = blocks;
+				blocks = block;
+				block_fill = 0;
+				++n_blocks;
+			}
+
+			result = &blocks->slots[block_fill++];
+		}
+
+		++n_allocated;
+		return result;
+	}
+
+	void Free(void *p) noexcept {
+		assert(p != nullptr);
+
+		const std::scoped_lock lock{mutex};
+
+		assert(n_allocated > 0);
+
+		Slot *slot = static_cast<Slot *>(p);
+		slot->next = free_list;
+		free_list = slot;
+
+		if (--n_allocated == 0)
+			/* the whole database has been freed; give
+			   the memory back */
+			ReleaseBlocks();
+	}
+
+private:
+	void ReleaseBlocks() noexcept {
+		while (blocks != nullptr) {
+			Block *next = blocks->next;
+			delete blocks;
+			blocks = next;
+		}
+
+		free_list = nullptr;
+		block_fill = N;
+		n_blocks = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ParallelWalk.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/WorkerPool.hxx"
+
+#include <cassert>
+#include <forward_list>
+#include <vector>
+
+namespace {
+
+/**
+ * Collects the songs of one #Directory (not its children) or of one
+ * whole subtree which match the filter.
+ */
+class SongCollector {
+	const SongFilter &filter;
+	const bool hide_playlist_targets;
+
+public:
+	std::vector<const Song *> songs;
+
+	SongCollector(const SongFilter &_filter,
+		      bool _hide_playlist_targets) noexcept
+		:filter(_filter),
+		 hide_playlist_targets(_hide_playlist_targets) {}
+
+	void CollectSongs(const Directory &directory) noexcept {
+		for (const auto &song : directory.songs) {
+			if (hide_playlist_targets && song.in_playlist)
+				continue;
+
+			if (filter.Match(song.Export()))
+				songs.push_back(&song);
+		}
+	}
+
+	void CollectRecursive(const Directory &directory) noexcept {
+		assert(!directory.IsMount());
+
+		CollectSongs(directory);
+
+		for (const auto &child : directory.children)
+			CollectRecursive(child);
+	}
+
+	void Visit(const VisitSong &visit_song) const {
+		for (const Song *song : songs)
+			visit_song(song->Export());
+	}
+};
+
+/**
+ * Counts the #WalkJob instances which have not yet finished.
+ */
+struct WalkJobCounter {
+	Mutex mutex;
+	Cond cond;
+	std::size_t pending = 0;
+
+	void Wait() noexcept {
+		std::unique_lock lock{mutex};
+		cond.wait(lock, [this]{ return pending == 0; });
+	}
+};
+
+class WalkJob final : public WorkerJob {
+	WalkJobCounter &counter;
+
+	const Directory &directory;
+
+public:
+	SongCollector collector;
+
+	WalkJob(WalkJobCounter &_counter, const Directory &_directory,
+		const SongFilter &filter, bool hide_playlist_targets) noexcept
+		:counter(_counter), directory(_directory),
+		 collector(filter, hide_playlist_targets) {}
+
+	/* virtual methods from WorkerJob */
+	void Run() noexcept override {
+		{
+			/* the calling thread holds the lock for
+			   us while waiting */
+			const ScopeBorrowDatabaseReadLock borrow;
+			collector.CollectRecursive(directory);
+		}
+
+		const std::scoped_lock lock{counter.mutex};
+		if (--counter.pending == 0)
+			counter.cond.notify_one();
+	}
+};
+
+} // anonymous namespace
+
+void
+ParallelWalk(WorkerPool &pool, const Directory &directory,
+	     const SongFilter &filter, bool hide_playlist_targets,
+	     const VisitSong &visit_song)
+{
+	assert(holding_db_lock());
+
+	WalkJobCounter counter;
+
+	/* one job per child; they are submitted in order, so the
+	   pool works on the subtrees from the beginning */
+	std::forward_list<WalkJob> jobs;
+	auto tail = jobs.before_begin();
+	for (const auto &child : directory.children)
+		tail = jobs.emplace_after(tail, counter, child,
+					  filter, hide_playlist_targets);
+
+	{
+		const std::scoped_lock lock{counter.mutex};
+		for (auto &job : jobs) {
+			++counter.pending;
+			pool.Push(job);
+		}
+	}
+
+	/* meanwhile, this thread evaluates the songs of the top
+	   directory */
+	SongCollector top(filter, hide_playlist_targets);
+	top.CollectSongs(directory);
+
+	counter.Wait();
+
+	/* merge the results in Directory::Walk() order: first the
+	   songs of this directory, then the subtrees */
+	top.Visit(visit_song);
+	for (const auto &job : jobs)
+		job.collector.Visit(visit_song);
+}
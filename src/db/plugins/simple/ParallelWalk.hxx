@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_SIMPLE_PARALLEL_WALK_HXX
+#define MPD_SIMPLE_PARALLEL_WALK_HXX
+
+#include "db/Visitor.hxx"
+
+struct Directory;
+class SongFilter;
+class WorkerPool;
+
+/**
+ * Like Directory::Walk() with only a song visitor, but evaluate the
+ * #SongFilter on the subtrees of the given #Directory in the threads
+ * of the #WorkerPool.  The matching songs are passed to the visitor
+ * in the calling thread, in the same order as Directory::Walk() does.
+ *
+ * The caller must hold the shared #db_mutex, and the tree must not
+ * contain mount points.
+ */
+void
+ParallelWalk(WorkerPool &pool, const Directory &directory,
+	     const SongFilter &filter, bool hide_playlist_targets,
+	     const VisitSong &visit_song);
+
+#endif
@@ -3,7 +3,7 @@
 
 #include "config.h"
 #include "SimpleDatabasePlugin.hxx"
-#include "PrefixedLightSong.hxx"
+#include "ExportedSong.hxx"
 #include "Mount.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/Selection.hxx"
@@ -15,43 +15,116 @@
 #include "Directory.hxx"
 #include "Song.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
+#include "TagIndex.hxx"
+#include "ParallelWalk.hxx"
+#include "WalkBatch.hxx"
+#include "DatabaseJournal.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 #include "lib/zlib/AutoGunzipFileLineReader.hxx"
 #include "io/BufferedOutputStream.hxx"
 #include "io/FileOutputStream.hxx"
+#include "io/FileLineReader.hxx"
+#include "io/MappedFile.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
+#include "tag/ParseName.hxx"
 #include "lib/fmt/SystemError.hxx"
 #include "util/CharUtil.hxx"
 #include "util/Domain.hxx"
 #include "util/RecursiveMap.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringStrip.hxx"
+#include "util/IterableSplitString.hxx"
+#include "thread/WorkerPool.hxx"
+#include "event/CoarseTimerEvent.hxx"
 #include "Log.hxx"
 
 #ifdef ENABLE_ZLIB
 #include "lib/zlib/GzipOutputStream.hxx"
 #endif
 
+#include <algorithm>
 #include <cerrno>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <vector>
 
 static constexpr Domain simple_db_domain("simple_db");
 
-inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
+/**
+ * The journal is compacted (i.e. the whole database file is
+ * rewritten) as soon as it reaches this fraction of the database
+ * file size (but not before #JOURNAL_MIN_LIMIT).
+ */
+static constexpr unsigned JOURNAL_LIMIT_DIVISOR = 4;
+static constexpr uint_least64_t JOURNAL_MIN_LIMIT = 256 * 1024;
+
+static bool
+ParseFormat(const char *value)
+{
+	if (StringIsEqual(value, "text"))
+		return false;
+	else if (StringIsEqual(value, "binary"))
+		return true;
+	else
+		throw FmtRuntimeError("Unrecognized database format: {:?}",
+				      value);
+}
+
+static TagMask
+ParseTagIndex(const char *value)
+{
+	TagMask mask = TagMask::None();
+	if (value == nullptr)
+		return mask;
+
+	for (std::string_view name : IterableSplitString(value, ',')) {
+		name = Strip(name);
+
+		const auto type = tag_name_parse_i(name);
+		if (type == TAG_NUM_OF_ITEM_TYPES)
+			throw FmtRuntimeError("Unknown tag type: {:?}", name);
+
+		mask.Set(type);
+	}
+
+	return mask;
+}
+
+inline SimpleDatabase::SimpleDatabase(EventLoop &event_loop,
+				      const ConfigBlock &block)
 	:Database(simple_db_plugin),
 	 path(block.GetPath("path")),
 	 cache_path(block.GetPath("cache_directory")),
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
-	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true))
+	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true)),
+	 binary(ParseFormat(block.GetBlockValue("format", "text"))),
+	 tag_index_mask(ParseTagIndex(block.GetBlockValue("tag_index"))),
+	 walk_threads(block.GetBlockValue("walk_threads", 0U)),
+	 use_journal(block.GetBlockValue("journal", false)),
+	 journal_path(path.IsNull() ? nullptr : path + PATH_LITERAL(".journal")),
+	 mount_idle_timeout(block.GetDuration("mount_idle_timeout",
+					      std::chrono::seconds{1},
+					      std::chrono::seconds::zero()))
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
 
 	path_utf8 = path.ToUTF8();
+
+	if (mount_idle_timeout > mount_idle_timeout.zero())
+		unload_timer = std::make_unique<CoarseTimerEvent>(event_loop,
+								  BIND_THIS_METHOD(OnUnloadTimer));
 }
 
 inline
@@ -60,7 +133,10 @@ SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 			       [[maybe_unused]]
 #endif
 			       bool _compress,
-			       bool _hide_playlist_targets) noexcept
+			       bool _hide_playlist_targets,
+			       bool _binary,
+			       TagMask _tag_index_mask,
+			       std::chrono::steady_clock::duration _idle_timeout) noexcept
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
@@ -68,16 +144,25 @@ SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
-	 hide_playlist_targets(_hide_playlist_targets)
+	 hide_playlist_targets(_hide_playlist_targets),
+	 binary(_binary),
+	 tag_index_mask(_tag_index_mask),
+	 walk_threads(0),
+	 use_journal(false),
+	 journal_path(path + PATH_LITERAL(".journal")),
+	 mount_idle_timeout(std::chrono::steady_clock::duration::zero()),
+	 idle_timeout(_idle_timeout)
 {
 }
 
+SimpleDatabase::~SimpleDatabase() noexcept = default;
+
 DatabasePtr
-SimpleDatabase::Create(EventLoop &, EventLoop &,
+SimpleDatabase::Create(EventLoop &main_event_loop, EventLoop &,
 		       [[maybe_unused]] DatabaseListener &listener,
 		       const ConfigBlock &block)
 {
-	return std::make_unique<SimpleDatabase>(block);
+	return std::make_unique<SimpleDatabase>(main_event_loop, block);
 }
 
 void
@@ -135,29 +220,90 @@ SimpleDatabase::Load()
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	AutoGunzipFileLineReader file{path};
-
 	LogDebug(simple_db_domain, "reading DB");
 
-	db_load_internal(file, *root);
+	/* the binary format is detected automatically, no matter
+	   which format is configured; this allows switching
+	   between formats without losing the database */
+	if (const MappedFile mapped{path}; db_is_binary(mapped.GetData())) {
+		db_load_binary(mapped.GetData(), *root);
+	} else {
+		AutoGunzipFileLineReader file{path};
+		db_load_internal(file, *root);
+	}
 
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(path, fi)) {
 		mtime = fi.GetModificationTime();
+		base_size = fi.GetSize();
+		LoadJournal(fi);
+	}
+
+	/* everything which has just been loaded is "saved" */
+	const ScopeDatabaseLock protect;
+	root->ClearModified();
+}
+
+void
+SimpleDatabase::LoadJournal(const FileInfo &base) noexcept
+{
+	journal_size = 0;
+
+	/* the journal is replayed even if "journal" is disabled, or
+	   else changes would get lost after the option was switched
+	   off */
+	FileInfo fi;
+	if (!GetFileInfo(journal_path, fi))
+		return;
+
+	journal_size = fi.GetSize();
+
+	LogDebug(simple_db_domain, "replaying DB journal");
+
+	try {
+		FileLineReader file{journal_path};
+		if (db_journal_replay(file, base, *root))
+			mtime = std::max(mtime, fi.GetModificationTime());
+		else
+			need_compaction = true;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to load database journal");
+		need_compaction = true;
+	}
 }
 
 void
 SimpleDatabase::Open()
 {
-	assert(prefixed_light_song == nullptr);
+	if (walk_threads > 0) {
+		walk_pool = std::make_unique<WorkerPool>("db_walk");
+		walk_pool->Start(walk_threads);
+	}
 
 	root = Directory::NewRoot();
 	mtime = std::chrono::system_clock::time_point::min();
+	base_size = journal_size = 0;
+	need_compaction = false;
 
 #ifndef NDEBUG
 	borrowed_song_count = 0;
 #endif
 
+	loaded = true;
+
+	if (idle_timeout > idle_timeout.zero()) {
+		/* load on demand (see Pin()), but FileExists() needs
+		   to know the modification time now */
+		FileInfo fi;
+		if (GetFileInfo(path, fi)) {
+			mtime = fi.GetModificationTime();
+			loaded = false;
+		}
+
+		return;
+	}
+
 	try {
 		Load();
 	} catch (...) {
@@ -169,86 +315,147 @@ SimpleDatabase::Open()
 
 		root = Directory::NewRoot();
 	}
+
+	RebuildTagIndex();
 }
 
 void
 SimpleDatabase::Close() noexcept
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
+	assert(pins == 0);
+
+	if (unload_timer != nullptr)
+		unload_timer->Cancel();
 
+	/* the mounted databases are closed by the Directory
+	   destructor */
+	lazy_mounts.clear();
+
+	walk_pool.reset();
+	tag_index.reset();
 	delete root;
 }
 
+/**
+ * The #LightSong returned by SimpleDatabase::GetSong().  Each call
+ * allocates a new instance, so concurrent callers (e.g. commands
+ * running in a #WorkerPool) do not share a buffer.
+ */
+class SimpleDatabase::BorrowedSong final : public ExportedSong {
+	/**
+	 * The URI of a song from a mounted #Database, prefixed with
+	 * the mount point.
+	 */
+	std::string prefixed_uri;
+
+public:
+	/**
+	 * For songs from a mounted #Database: that database and the
+	 * song it returned, which this object refers to.  The latter
+	 * is returned together with this object.
+	 */
+	const Database *const mounted_db = nullptr;
+	const LightSong *const mounted_song = nullptr;
+
+	explicit BorrowedSong(ExportedSong &&src) noexcept
+		:ExportedSong(std::move(src)) {}
+
+	BorrowedSong(const Database &_db, const LightSong &_song,
+		     std::string_view base)
+		:ExportedSong(_song, _song.tag),
+		 prefixed_uri(PathTraitsUTF8::Build(base, _song.GetURI())),
+		 mounted_db(&_db), mounted_song(&_song)
+	{
+		uri = prefixed_uri.c_str();
+		directory = nullptr;
+	}
+};
+
 const LightSong *
 SimpleDatabase::GetSong(std::string_view uri) const
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
-	assert(borrowed_song_count == 0);
 
-	ScopeDatabaseLock protect;
+	/* on success, the pin is released by ReturnSong() */
+	Pin();
+	bool success = false;
+	AtScopeExit(this, &success) {
+		if (!success)
+			Unpin();
+	};
+
+	ScopeDatabaseReadLock protect;
 
 	auto r = root->LookupDirectory(uri);
 
+	BorrowedSong *borrowed;
+
 	if (r.directory->IsMount()) {
 		/* pass the request to the mounted database */
 		protect.unlock();
 
-		const LightSong *song =
-			r.directory->mounted_database->GetSong(r.rest);
+		const Database &db = *r.directory->mounted_database;
+		const LightSong *song = db.GetSong(r.rest);
 		if (song == nullptr)
 			return nullptr;
 
-		prefixed_light_song =
-			new PrefixedLightSong(*song, r.uri);
-		r.directory->mounted_database->ReturnSong(song);
-		return prefixed_light_song;
-	}
-
-	if (r.rest.empty())
-		/* it's a directory */
-		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
-				    "No such song");
+		/* the song is returned to the mounted database in
+		   ReturnSong(), because the prefixed copy still
+		   refers to its attributes */
+		try {
+			borrowed = new BorrowedSong(db, *song, r.uri);
+		} catch (...) {
+			db.ReturnSong(song);
+			throw;
+		}
+	} else {
+		if (r.rest.empty())
+			/* it's a directory */
+			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+					    "No such song");
 
-	if (r.rest.find('/') != std::string_view::npos)
-		/* refers to a URI "below" the actual song */
-		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
-				    "No such song");
+		if (r.rest.find('/') != std::string_view::npos)
+			/* refers to a URI "below" the actual song */
+			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+					    "No such song");
 
-	const Song *song = r.directory->FindSong(r.rest);
-	if (song == nullptr)
-		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
-				    "No such song");
+		const Song *song = r.directory->FindSong(r.rest);
+		if (song == nullptr)
+			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+					    "No such song");
 
-	exported_song.Construct(song->Export());
-	protect.unlock();
+		borrowed = new BorrowedSong(song->Export());
+		protect.unlock();
+	}
 
 #ifndef NDEBUG
 	++borrowed_song_count;
 #endif
 
-	return &exported_song.Get();
+	success = true;
+	return borrowed;
 }
 
 void
-SimpleDatabase::ReturnSong([[maybe_unused]] const LightSong *song) const noexcept
+SimpleDatabase::ReturnSong(const LightSong *song) const noexcept
 {
 	assert(song != nullptr);
-	assert(song == prefixed_light_song || song == &exported_song.Get());
 
-	if (prefixed_light_song != nullptr) {
-		delete prefixed_light_song;
-		prefixed_light_song = nullptr;
-	} else {
+	const auto *borrowed = static_cast<const BorrowedSong *>(song);
+	if (borrowed->mounted_db != nullptr)
+		borrowed->mounted_db->ReturnSong(borrowed->mounted_song);
+
+	delete borrowed;
+
 #ifndef NDEBUG
-		assert(borrowed_song_count > 0);
-		--borrowed_song_count;
+	assert(borrowed_song_count > 0);
+	--borrowed_song_count;
 #endif
 
-		exported_song.Destruct();
-	}
+	/* release the pin obtained by GetSong() */
+	Unpin();
 }
 
 [[gnu::const]]
@@ -266,7 +473,9 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitSong visit_song,
 		      VisitPlaylist visit_playlist) const
 {
-	ScopeDatabaseLock protect;
+	const ScopePin pin{*this};
+
+	ScopeDatabaseReadLock protect;
 
 	auto r = root->LookupDirectory(selection.uri);
 
@@ -282,6 +491,10 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		return;
 	}
 
+	if (VisitSorted(selection, visit_directory, visit_song,
+			visit_playlist))
+		return;
+
 	DatabaseVisitorHelper helper(CheckSelection(selection), visit_song);
 
 	if (r.rest.data() == nullptr) {
@@ -290,10 +503,30 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
-		r.directory->Walk(selection.recursive, selection.filter,
-				  hide_playlist_targets,
-				  visit_directory, visit_song,
-				  visit_playlist);
+		if (selection.recursive && !visit_directory &&
+		    !visit_playlist && visit_song &&
+		    (VisitIndexed(*r.directory, selection, visit_song) ||
+		     VisitParallel(*r.directory, selection, visit_song))) {
+			helper.Commit();
+			return;
+		}
+
+		if (!selection.recursive) {
+			r.directory->Walk(false, selection.filter,
+					  hide_playlist_targets,
+					  visit_directory, visit_song,
+					  visit_playlist);
+			helper.Commit();
+			return;
+		}
+
+		/* a recursive walk may take long; generate the
+		   response without holding the lock, so the update is
+		   not blocked meanwhile */
+		WalkRecursive(*r.directory, selection.filter,
+			      visit_directory, visit_song, visit_playlist);
+		protect.unlock();
+
 		helper.Commit();
 		return;
 	}
@@ -316,16 +549,335 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 			    "No such directory");
 }
 
+/**
+ * The number of objects recorded by WalkRecursive() before they are
+ * replayed.  This bounds the size of the #WalkBatch (except
+ * for a single directory with more songs than that).  The lock is
+ * released between two batches, so the walk as a whole is not
+ * atomic.
+ */
+static constexpr std::size_t WALK_BATCH_SIZE = 1024;
+
+void
+SimpleDatabase::WalkRecursive(const Directory &start,
+			      const SongFilter *filter,
+			      const VisitDirectory &visit_directory,
+			      const VisitSong &visit_song,
+			      const VisitPlaylist &visit_playlist) const
+{
+	WalkBatch batch;
+	const auto record_directory = batch.Record(visit_directory);
+	const auto record_song = batch.Record(visit_song);
+	const auto record_playlist = batch.Record(visit_playlist);
+
+	const auto replay = [&]{
+		batch.Replay(visit_directory, visit_song, visit_playlist);
+		batch.clear();
+	};
+
+	/* the URIs of the directories which have not been walked
+	   yet, the next one at the back; they are looked up again
+	   because the tree may be modified whenever the lock is
+	   released */
+	std::vector<std::string> pending;
+
+	const Directory *directory = &start;
+	while (true) {
+		/* songs and playlists of this directory */
+		directory->Walk(false, filter, hide_playlist_targets,
+				{}, record_song, record_playlist);
+
+		const std::size_t n = pending.size();
+		for (const auto &child : directory->children)
+			pending.emplace_back(child.GetPath());
+		std::reverse(std::next(pending.begin(), n), pending.end());
+
+		directory = nullptr;
+		while (directory == nullptr) {
+			if (pending.empty()) {
+				const ScopeDatabaseReadUnlock unlock;
+				replay();
+				return;
+			}
+
+			if (batch.size() >= WALK_BATCH_SIZE) {
+				const ScopeDatabaseReadUnlock unlock;
+				replay();
+			}
+
+			const std::string uri = std::move(pending.back());
+			pending.pop_back();
+
+			const auto r = root->LookupDirectory(uri);
+			if (r.rest.data() != nullptr)
+				/* deleted while the lock was released */
+				continue;
+
+			if (record_directory)
+				record_directory(r.directory->Export());
+
+			if (!r.directory->IsMount()) {
+				directory = r.directory;
+				continue;
+			}
+
+			/* the mounted database is walked by its own
+			   Visit() method, after everything recorded
+			   so far has been replayed */
+			const Database &db = *r.directory->mounted_database;
+			const ScopeDatabaseReadUnlock unlock;
+			replay();
+			WalkMount(uri, db, "",
+				  DatabaseSelection("", true, filter),
+				  visit_directory, visit_song,
+				  visit_playlist);
+		}
+	}
+}
+
+inline bool
+SimpleDatabase::VisitIndexed(const Directory &directory,
+			     const DatabaseSelection &selection,
+			     const VisitSong &visit_song) const
+{
+	if (tag_index == nullptr || n_mounts > 0 ||
+	    selection.filter == nullptr)
+		return false;
+
+	return tag_index->Walk(directory, *selection.filter,
+			       hide_playlist_targets, visit_song);
+}
+
+inline bool
+SimpleDatabase::VisitParallel(const Directory &directory,
+			      const DatabaseSelection &selection,
+			      const VisitSong &visit_song) const
+{
+	/* without a filter, there is nothing worth doing in
+	   parallel; and mounted databases need to be unlocked while
+	   walking them */
+	if (walk_pool == nullptr || n_mounts > 0 ||
+	    selection.filter == nullptr || directory.children.empty())
+		return false;
+
+	ParallelWalk(*walk_pool, directory, *selection.filter,
+		     hide_playlist_targets, visit_song);
+	return true;
+}
+
+inline bool
+SimpleDatabase::VisitSorted(const DatabaseSelection &selection,
+			    const VisitDirectory &visit_directory,
+			    const VisitSong &visit_song,
+			    const VisitPlaylist &visit_playlist) const
+{
+	if (tag_index == nullptr || n_mounts > 0 ||
+	    selection.sort >= TAG_NUM_OF_ITEM_TYPES ||
+	    !selection.uri.empty() || !selection.recursive ||
+	    visit_directory || visit_playlist || !visit_song)
+		return false;
+
+	/* if the filter can be evaluated with the index, it is
+	   cheaper to sort only its (few) matches */
+	if (selection.filter != nullptr &&
+	    tag_index->CanWalk(*selection.filter))
+		return false;
+
+	return tag_index->VisitSorted(selection.sort, selection.descending,
+				      selection.filter, selection.window,
+				      visit_song);
+}
+
+/**
+ * Does this selection cover the whole database, i.e. can it be
+ * answered by the #TagIndex aggregates?
+ */
+[[gnu::pure]]
+static bool
+IsWholeDatabase(const DatabaseSelection &selection) noexcept
+{
+	return selection.recursive && !selection.IsFiltered() &&
+		selection.window.IsAll();
+}
+
 RecursiveMap<std::string>
 SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				  std::span<const TagType> tag_types) const
 {
-	return ::CollectUniqueTags(*this, selection, tag_types);
+	if (!IsWholeDatabase(selection))
+		return ::CollectUniqueTags(*this, selection, tag_types);
+
+	if (idle_timeout == idle_timeout.zero())
+		return CollectAllUniqueTags(selection, tag_types);
+
+	/* a database which is loaded on demand keeps a summary, so
+	   "list" does not need to load it again */
+
+	std::vector<TagType> key{tag_types.begin(), tag_types.end()};
+	unsigned serial;
+
+	{
+		const std::scoped_lock lock{lazy_mutex};
+		if (auto i = unique_tags_summary.find(key);
+		    i != unique_tags_summary.end())
+			return i->second;
+
+		serial = unique_tags_serial;
+	}
+
+	auto result = CollectAllUniqueTags(selection, tag_types);
+
+	const std::scoped_lock lock{lazy_mutex};
+	if (unique_tags_serial == serial) {
+		if (unique_tags_summary.size() >= MAX_UNIQUE_TAGS_SUMMARY)
+			unique_tags_summary.clear();
+
+		unique_tags_summary.emplace(std::move(key), result);
+	}
+
+	return result;
+}
+
+RecursiveMap<std::string>
+SimpleDatabase::CollectAllUniqueTags(const DatabaseSelection &selection,
+				     std::span<const TagType> tag_types) const
+{
+	const ScopePin pin{*this};
+
+	/* "list" over the whole database: the index already knows
+	   all values */
+
+	const TagIndex *index;
+
+	{
+		const ScopeDatabaseReadLock protect;
+
+		index = n_mounts == 0 ? tag_index.get() : nullptr;
+		if (index != nullptr) {
+			const TagIndex::ValueMap *values = tag_types.size() == 1
+				? index->GetValues(tag_types.front())
+				: nullptr;
+
+			if (values != nullptr) {
+				RecursiveMap<std::string> result;
+				for (const auto &[value, stats] : *values)
+					result.emplace_hint(result.end(), value,
+							    RecursiveMap<std::string>{});
+				return result;
+			}
+
+			/* "list ... group ...": these are expensive,
+			   but clients ask for the same few groupings
+			   over and over */
+			if (auto cached = index->GetUniqueTags(tag_types))
+				return std::move(*cached);
+		}
+	}
+
+	/* the fallback must be called without holding the lock,
+	   because Visit() obtains it */
+	auto result = n_mounts > 0 && mount_idle_timeout > mount_idle_timeout.zero()
+		? CollectUniqueTagsWithMounts(tag_types)
+		: ::CollectUniqueTags(*this, selection, tag_types);
+
+	/* store the result only if the index was not replaced by a
+	   database update meanwhile */
+	const ScopeDatabaseReadLock protect;
+	if (index != nullptr && tag_index.get() == index)
+		index->PutUniqueTags(tag_types, result);
+
+	return result;
+}
+
+static void
+CollectLocalUniqueTags(RecursiveMap<std::string> &result,
+		       const Directory &directory,
+		       bool hide_playlist_targets,
+		       std::span<const TagType> tag_types,
+		       std::vector<const Database *> &mounts)
+{
+	if (directory.IsMount()) {
+		mounts.push_back(directory.mounted_database.get());
+		return;
+	}
+
+	for (const auto &song : directory.songs) {
+		if (hide_playlist_targets && song.in_playlist)
+			continue;
+
+		CollectUniqueTags(result, song.Export().tag, tag_types);
+	}
+
+	for (const auto &child : directory.children)
+		CollectLocalUniqueTags(result, child, hide_playlist_targets,
+				       tag_types, mounts);
+}
+
+static void
+MergeUniqueTags(RecursiveMap<std::string> &dest,
+		RecursiveMap<std::string> &&src) noexcept
+{
+	for (auto &&[value, children] : src)
+		MergeUniqueTags(dest[value], std::move(children));
+}
+
+RecursiveMap<std::string>
+SimpleDatabase::CollectUniqueTagsWithMounts(std::span<const TagType> tag_types) const
+{
+	RecursiveMap<std::string> result;
+	std::vector<const Database *> mounts;
+
+	{
+		const ScopeDatabaseReadLock protect;
+		CollectLocalUniqueTags(result, *root, hide_playlist_targets,
+				       tag_types, mounts);
+	}
+
+	/* the mounted databases may answer from their summary
+	   without being loaded; this must be called without holding
+	   the lock, because they obtain it (the pointers remain
+	   valid, because Unmount() is called in the main thread,
+	   too) */
+	for (const Database *db : mounts)
+		MergeUniqueTags(result,
+				db->CollectUniqueTags(DatabaseSelection{"", true},
+						      tag_types));
+
+	return result;
+}
+
+bool
+SimpleDatabase::VisitGroupCounts(const DatabaseSelection &selection,
+				 TagType group,
+				 const VisitGroupCount &visit) const
+{
+	if (!IsWholeDatabase(selection))
+		return false;
+
+	const ScopeDatabaseReadLock protect;
+
+	if (tag_index == nullptr || n_mounts > 0)
+		return false;
+
+	const auto *values = tag_index->GetValues(group);
+	if (values == nullptr)
+		return false;
+
+	for (const auto &[value, stats] : *values)
+		visit(value.c_str(), stats);
+
+	return true;
 }
 
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (IsWholeDatabase(selection)) {
+		const ScopeDatabaseReadLock protect;
+		if (stats_snapshot && n_mounts == 0)
+			return *stats_snapshot;
+	}
+
 	return ::GetStats(*this, selection);
 }
 
@@ -342,10 +894,36 @@ SimpleDatabase::Save()
 		root->Sort();
 	}
 
+	if (use_journal && !need_compaction && FileExists() &&
+	    journal_size < std::max(base_size / JOURNAL_LIMIT_DIVISOR,
+				    JOURNAL_MIN_LIMIT)) {
+		try {
+			SaveJournal();
+			return;
+		} catch (...) {
+			/* fall back to rewriting the whole
+			   database */
+			LogError(std::current_exception(),
+				 "Failed to write database journal");
+		}
+	}
+
 	LogDebug(simple_db_domain, "writing DB");
 
 	FileOutputStream fos(path);
 
+	if (binary) {
+		/* no compression: the binary format is designed to
+		   be memory-mapped */
+		BufferedOutputStream bos(fos);
+		db_save_binary(bos, *root);
+		bos.Flush();
+		fos.Commit();
+
+		OnSaved();
+		return;
+	}
+
 	OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
@@ -371,9 +949,221 @@ SimpleDatabase::Save()
 
 	fos.Commit();
 
+	OnSaved();
+}
+
+void
+SimpleDatabase::SaveJournal()
+{
+	LogDebug(simple_db_domain, "writing DB journal");
+
+	const FileInfo base{path};
+
+	const bool append = journal_size > 0;
+	FileOutputStream fos(journal_path,
+			     append
+			     ? FileOutputStream::Mode::APPEND_EXISTING
+			     : FileOutputStream::Mode::CREATE);
+	BufferedOutputStream bos(fos);
+
+	if (!append)
+		db_journal_write_header(bos, base);
+
+	{
+		const ScopeDatabaseReadLock protect;
+		if (!db_journal_write(bos, *root))
+			/* nothing has changed; the destructor
+			   discards the (new) file */
+			return;
+	}
+
+	bos.Flush();
+	fos.Commit();
+
+	{
+		const ScopeDatabaseLock protect;
+		root->ClearModified();
+	}
+
+	const FileInfo fi{journal_path};
+	journal_size = fi.GetSize();
+	mtime = std::max(mtime, fi.GetModificationTime());
+}
+
+void
+SimpleDatabase::OnSaved()
+{
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(path, fi)) {
 		mtime = fi.GetModificationTime();
+		base_size = fi.GetSize();
+	}
+
+	need_compaction = false;
+
+	if (journal_size > 0 || PathExists(journal_path)) {
+		/* if this fails, the journal will still be ignored
+		   at load time because it does not belong to the new
+		   database file */
+		try {
+			RemoveFile(journal_path);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to delete database journal");
+		}
+
+		journal_size = 0;
+	}
+
+	const ScopeDatabaseLock protect;
+	root->ClearModified();
+}
+
+void
+SimpleDatabase::InvalidateTagIndex() noexcept
+{
+	if (idle_timeout > idle_timeout.zero()) {
+		const std::scoped_lock lock{lazy_mutex};
+		unique_tags_summary.clear();
+		++unique_tags_serial;
+	}
+
+	const ScopeDatabaseLock protect;
+	tag_index.reset();
+	stats_snapshot.reset();
+}
+
+static void
+CollectStats(DatabaseStatsBuilder &builder, const Directory &directory,
+	     bool hide_playlist_targets)
+{
+	if (directory.IsMount())
+		return;
+
+	for (const auto &song : directory.songs) {
+		if (hide_playlist_targets && song.in_playlist)
+			continue;
+
+		builder.Add(song.Export().tag);
+	}
+
+	for (const auto &child : directory.children)
+		CollectStats(builder, child, hide_playlist_targets);
+}
+
+void
+SimpleDatabase::RebuildTagIndex() noexcept
+{
+	std::optional<DatabaseStats> stats;
+	std::unique_ptr<TagIndex> index;
+
+	{
+		/* Mount() and Unmount() may modify the tree
+		   meanwhile */
+		const ScopeDatabaseReadLock protect;
+
+		try {
+			DatabaseStatsBuilder builder;
+			CollectStats(builder, *root, hide_playlist_targets);
+			stats = builder.Commit();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to calculate database statistics");
+		}
+
+		if (tag_index_mask.TestAny()) {
+			LogDebug(simple_db_domain, "building tag index");
+
+			try {
+				index = std::make_unique<TagIndex>(tag_index_mask);
+				index->Build(*root, hide_playlist_targets);
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to build tag index");
+				index.reset();
+			}
+		}
+	}
+
+	const ScopeDatabaseLock protect;
+	if (stats)
+		stats_snapshot = std::move(stats);
+	if (index)
+		tag_index = std::move(index);
+}
+
+void
+SimpleDatabase::Pin() const noexcept
+{
+	if (idle_timeout == idle_timeout.zero())
+		return;
+
+	const std::scoped_lock lock{lazy_mutex};
+	++pins;
+
+	if (!loaded)
+		const_cast<SimpleDatabase *>(this)->LoadLazy();
+}
+
+void
+SimpleDatabase::Unpin() const noexcept
+{
+	if (idle_timeout == idle_timeout.zero())
+		return;
+
+	const std::scoped_lock lock{lazy_mutex};
+	assert(pins > 0);
+	--pins;
+	last_access = std::chrono::steady_clock::now();
+}
+
+void
+SimpleDatabase::LoadLazy() noexcept
+{
+	assert(!loaded);
+
+	FmtDebug(simple_db_domain, "loading {:?}", path_utf8);
+
+	try {
+		Load();
+	} catch (...) {
+		LogError(std::current_exception());
+
+		const ScopeDatabaseLock protect;
+		delete root;
+		root = Directory::NewRoot();
+	}
+
+	RebuildTagIndex();
+	loaded = true;
+}
+
+void
+SimpleDatabase::UnloadIfIdle(std::chrono::steady_clock::time_point now) noexcept
+{
+	const std::scoped_lock lock{lazy_mutex};
+	if (!loaded || pins > 0 || now - last_access < idle_timeout)
+		return;
+
+	FmtDebug(simple_db_domain, "unloading {:?}", path_utf8);
+
+	/* the summary is kept, it is still valid */
+	const ScopeDatabaseLock protect;
+	tag_index.reset();
+	delete root;
+	root = Directory::NewRoot();
+	loaded = false;
+}
+
+void
+SimpleDatabase::OnUnloadTimer() noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+	for (SimpleDatabase *db : lazy_mounts)
+		db->UnloadIfIdle(now);
+
+	if (!lazy_mounts.empty())
+		unload_timer->Schedule(mount_idle_timeout);
 }
 
 void
@@ -399,6 +1189,7 @@ SimpleDatabase::Mount(const char *uri, DatabasePtr db)
 
 	Directory *mnt = r.directory->CreateChild(r.rest);
 	mnt->mounted_database = std::move(db);
+	++n_mounts;
 }
 
 static constexpr bool
@@ -429,13 +1220,22 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	constexpr bool compress = false;
 #endif
 	auto db = std::make_unique<SimpleDatabase>(cache_path / name_fs,
-						   compress, hide_playlist_targets);
+						   compress, hide_playlist_targets,
+						   binary, tag_index_mask,
+						   mount_idle_timeout);
 	db->Open();
 
 	bool exists = db->FileExists();
 
+	SimpleDatabase &ref = *db;
 	Mount(local_uri, std::move(db));
 
+	if (unload_timer != nullptr) {
+		lazy_mounts.push_back(&ref);
+		if (!unload_timer->IsPending())
+			unload_timer->Schedule(mount_idle_timeout);
+	}
+
 	return exists;
 }
 
@@ -451,6 +1251,11 @@ SimpleDatabase::LockUmountSteal(const char *uri) noexcept
 	auto db = std::move(r.directory->mounted_database);
 	r.directory->Delete();
 
+	std::erase(lazy_mounts, db.get());
+
+	assert(n_mounts > 0);
+	--n_mounts;
+
 	return db;
 }
 
@@ -467,6 +1272,6 @@ SimpleDatabase::Unmount(const char *uri) noexcept
 
 constexpr DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_THREAD_SAFE,
 	SimpleDatabase::Create,
 };
@@ -4,21 +4,34 @@
 #ifndef MPD_SIMPLE_DATABASE_PLUGIN_HXX
 #define MPD_SIMPLE_DATABASE_PLUGIN_HXX
 
-#include "ExportedSong.hxx"
 #include "db/Interface.hxx"
 #include "db/Ptr.hxx"
+#include "db/Stats.hxx"
 #include "fs/AllocatedPath.hxx"
-#include "util/Manual.hxx"
+#include "tag/Mask.hxx"
+#include "thread/Mutex.hxx"
+#include "util/RecursiveMap.hxx"
 #include "config.h"
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
 
 struct ConfigBlock;
 struct Directory;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
-class PrefixedLightSong;
+class TagIndex;
+class FileInfo;
+class WorkerPool;
+class CoarseTimerEvent;
+class SongFilter;
 
 class SimpleDatabase : public Database {
 	const AllocatedPath path;
@@ -34,18 +47,18 @@ class SimpleDatabase : public Database {
 	std::chrono::system_clock::time_point mtime;
 
 	/**
-	 * A buffer for GetSong() when prefixing the #LightSong
-	 * instance from a mounted #Database.
+	 * The type returned by GetSong(); it is declared in the
+	 * implementation file.
 	 */
-	mutable PrefixedLightSong *prefixed_light_song = nullptr;
+	class BorrowedSong;
 
+#ifndef NDEBUG
 	/**
-	 * A buffer for GetSong().
+	 * The number of songs returned by GetSong() which have not
+	 * yet been passed to ReturnSong().  Atomic because worker
+	 * threads may call GetSong() concurrently.
 	 */
-	mutable Manual<ExportedSong> exported_song;
-
-#ifndef NDEBUG
-	mutable unsigned borrowed_song_count;
+	mutable std::atomic_uint borrowed_song_count;
 #endif
 
 #ifdef ENABLE_ZLIB
@@ -54,10 +67,175 @@ class SimpleDatabase : public Database {
 
 	const bool hide_playlist_targets;
 
+	/**
+	 * Save the database in the binary format (see
+	 * DatabaseBinary.hxx) instead of the text format?
+	 */
+	const bool binary;
+
+	/**
+	 * The tag types which shall be indexed by #TagIndex.  If
+	 * empty, then there is no index.
+	 */
+	const TagMask tag_index_mask;
+
+	/**
+	 * The secondary tag index; nullptr if disabled or while the
+	 * updater is modifying the database.  Protected by
+	 * #db_mutex.
+	 */
+	std::unique_ptr<TagIndex> tag_index;
+
+	/**
+	 * The result of GetStats() for the whole database (without
+	 * mounted databases), calculated together with the
+	 * #TagIndex, so the "stats" command does not need to walk
+	 * the tree.  It is empty while the updater is modifying the
+	 * database.  Unlike the #TagIndex, it is kept when the
+	 * database is unloaded.  Protected by #db_mutex.
+	 */
+	std::optional<DatabaseStats> stats_snapshot;
+
+	/**
+	 * The number of databases mounted with Mount().  The
+	 * #TagIndex is not used while this is non-zero, because it
+	 * does not know the songs of mounted databases.  Protected
+	 * by #db_mutex.
+	 */
+	unsigned n_mounts = 0;
+
+	/**
+	 * The number of threads which evaluate filters in
+	 * Visit() (see ParallelWalk()); zero disables this.
+	 */
+	const unsigned walk_threads;
+
+	/**
+	 * Runs ParallelWalk() jobs; nullptr if #walk_threads is
+	 * zero.
+	 */
+	std::unique_ptr<WorkerPool> walk_pool;
+
+	/**
+	 * Append changes to the journal file (see
+	 * DatabaseJournal.hxx) instead of rewriting the whole
+	 * database file after each update?
+	 */
+	const bool use_journal;
+
+	/**
+	 * The path of the journal file, i.e. #path with a
+	 * ".journal" suffix.
+	 */
+	const AllocatedPath journal_path;
+
+	/**
+	 * The size of the database file and of the journal file (0
+	 * if there is none); used to decide when the journal needs
+	 * to be compacted.
+	 */
+	uint_least64_t base_size = 0, journal_size = 0;
+
+	/**
+	 * If true, then the next Save() rewrites the whole database
+	 * file, e.g. because the journal could not be replayed
+	 * completely.
+	 */
+	bool need_compaction = false;
+
+	/**
+	 * If this is non-zero, then databases mounted with Mount()
+	 * are loaded on demand and unloaded after they have not
+	 * been used for this duration.
+	 */
+	const std::chrono::steady_clock::duration mount_idle_timeout;
+
+	/**
+	 * Periodically calls UnloadIfIdle() on all #lazy_mounts;
+	 * nullptr if #mount_idle_timeout is zero.
+	 */
+	std::unique_ptr<CoarseTimerEvent> unload_timer;
+
+	/**
+	 * The databases mounted with Mount() which are loaded on
+	 * demand.  Only accessed in the main thread.
+	 */
+	std::vector<SimpleDatabase *> lazy_mounts;
+
+	/**
+	 * If this is non-zero, then this is a mounted database
+	 * which is loaded on demand (see Pin()) and unloaded after
+	 * it has not been used for this duration.
+	 */
+	const std::chrono::steady_clock::duration idle_timeout{};
+
+	/**
+	 * Protects #loaded, #pins, #last_access and
+	 * #unique_tags_summary.  If both are needed, this one must
+	 * be locked before the #db_mutex.
+	 */
+	mutable Mutex lazy_mutex;
+
+	/**
+	 * Has the database file been loaded into #root?  This is
+	 * always true unless #idle_timeout is set.
+	 */
+	bool loaded = true;
+
+	/**
+	 * The number of #ScopePin instances; as long as this is
+	 * non-zero, the database must not be unloaded.
+	 */
+	mutable unsigned pins = 0;
+
+	mutable std::chrono::steady_clock::time_point last_access;
+
+	/**
+	 * CollectUniqueTags() results over the whole database (only
+	 * if #idle_timeout is set).  Unlike the #TagIndex, these are
+	 * kept while the database is unloaded, so "list" does not
+	 * need to load it again.
+	 */
+	mutable std::map<std::vector<TagType>, RecursiveMap<std::string>> unique_tags_summary;
+
+	/**
+	 * Incremented each time #unique_tags_summary is
+	 * invalidated; a result which was collected meanwhile is
+	 * not stored.
+	 */
+	mutable unsigned unique_tags_serial = 0;
+
+	static constexpr std::size_t MAX_UNIQUE_TAGS_SUMMARY = 16;
+
 public:
-	SimpleDatabase(const ConfigBlock &block);
+	/**
+	 * Keeps a database which is loaded on demand loaded while
+	 * this object exists.  It must be held by everybody who
+	 * accesses the #Directory tree (e.g. the update thread).
+	 */
+	class ScopePin {
+		const SimpleDatabase &db;
+
+	public:
+		explicit ScopePin(const SimpleDatabase &_db) noexcept
+			:db(_db) {
+			db.Pin();
+		}
+
+		~ScopePin() noexcept {
+			db.Unpin();
+		}
+
+		ScopePin(const ScopePin &) = delete;
+		ScopePin &operator=(const ScopePin &) = delete;
+	};
+
+	SimpleDatabase(EventLoop &event_loop, const ConfigBlock &block);
 	SimpleDatabase(AllocatedPath &&_path, bool _compress,
-		       bool _hide_playlist_targets) noexcept;
+		       bool _hide_playlist_targets, bool _binary,
+		       TagMask _tag_index_mask,
+		       std::chrono::steady_clock::duration _idle_timeout) noexcept;
+	~SimpleDatabase() noexcept override;
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
@@ -77,6 +255,22 @@ public:
 
 	void Save();
 
+	/**
+	 * Discard the #TagIndex and the statistics snapshot.  This
+	 * must be called by the updater before it modifies the
+	 * #Directory tree.
+	 */
+	void InvalidateTagIndex() noexcept;
+
+	/**
+	 * Calculate the statistics snapshot and build a new
+	 * #TagIndex (if one is configured).  The caller must not
+	 * hold the #db_mutex; the tree is walked with the shared
+	 * lock, and the results are installed with the exclusive
+	 * lock.
+	 */
+	void RebuildTagIndex() noexcept;
+
 	/**
 	 * Returns true if there is a valid database file on the disk.
 	 */
@@ -119,6 +313,10 @@ public:
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
+	bool VisitGroupCounts(const DatabaseSelection &selection,
+			      TagType group,
+			      const VisitGroupCount &visit) const override;
+
 	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
 		return mtime;
 	}
@@ -133,7 +331,114 @@ private:
 	 */
 	void Load();
 
+	/**
+	 * Replay the journal file (if one exists) on top of the
+	 * database file which was just loaded.
+	 *
+	 * @param base the database file
+	 */
+	void LoadJournal(const FileInfo &base) noexcept;
+
+	/**
+	 * Append the changes since the last save to the journal
+	 * file.
+	 *
+	 * Throws on error.
+	 */
+	void SaveJournal();
+
+	/**
+	 * The database file has been rewritten; update the
+	 * attributes and delete the journal which is now obsolete.
+	 */
+	void OnSaved();
+
+	/**
+	 * Visit songs with the help of the #TagIndex.  Caller must
+	 * lock the #db_mutex.
+	 *
+	 * @return false if the #TagIndex cannot be used for this
+	 * selection
+	 */
+	bool VisitIndexed(const Directory &directory,
+			  const DatabaseSelection &selection,
+			  const VisitSong &visit_song) const;
+
+	/**
+	 * Visit songs matching the selection's filter with
+	 * ParallelWalk().  Caller must lock the #db_mutex.
+	 *
+	 * @return false if ParallelWalk() cannot be used for this
+	 * selection
+	 */
+	bool VisitParallel(const Directory &directory,
+			   const DatabaseSelection &selection,
+			   const VisitSong &visit_song) const;
+
+	/**
+	 * Visit songs in the order of a #TagIndex tag type, applying
+	 * the selection's filter and window (see
+	 * TagIndex::VisitSorted()).  Caller must lock the #db_mutex.
+	 *
+	 * @return false if the #TagIndex cannot be used for this
+	 * selection
+	 */
+	bool VisitSorted(const DatabaseSelection &selection,
+			 const VisitDirectory &visit_directory,
+			 const VisitSong &visit_song,
+			 const VisitPlaylist &visit_playlist) const;
+
+	/**
+	 * Walk the given directory recursively (without visiting the
+	 * directory itself).  The objects are copied into a
+	 * #WalkBatch, which is passed to the visitors while the
+	 * #db_mutex is released.  This means that the result is not
+	 * atomic: a database update running meanwhile may modify the
+	 * parts of the tree which have not been walked yet.  Caller
+	 * must lock the #db_mutex (shared).
+	 */
+	void WalkRecursive(const Directory &directory,
+			   const SongFilter *filter,
+			   const VisitDirectory &visit_directory,
+			   const VisitSong &visit_song,
+			   const VisitPlaylist &visit_playlist) const;
+
 	DatabasePtr LockUmountSteal(const char *uri) noexcept;
+
+	/**
+	 * Load the database file if #idle_timeout is set and it is
+	 * not loaded already, and prevent unloading it until
+	 * Unpin() is called.  Errors are logged.
+	 */
+	void Pin() const noexcept;
+	void Unpin() const noexcept;
+
+	/**
+	 * Caller must lock #lazy_mutex.
+	 */
+	void LoadLazy() noexcept;
+
+	/**
+	 * Unload the #Directory tree if it has not been used for
+	 * #idle_timeout.  Must be called in the main thread.
+	 */
+	void UnloadIfIdle(std::chrono::steady_clock::time_point now) noexcept;
+
+	void OnUnloadTimer() noexcept;
+
+	/**
+	 * CollectUniqueTags() for the whole database (without
+	 * #unique_tags_summary).
+	 */
+	RecursiveMap<std::string> CollectAllUniqueTags(const DatabaseSelection &selection,
+						       std::span<const TagType> tag_types) const;
+
+	/**
+	 * Collect the unique tags of the whole database, but ask
+	 * each mounted database for its own songs (see
+	 * CollectUniqueTags()) instead of walking it.
+	 */
+	RecursiveMap<std::string> CollectUniqueTagsWithMounts(std::span<const TagType> tag_types) const;
 };
 
 extern const DatabasePlugin simple_db_plugin;
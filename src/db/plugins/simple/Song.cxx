@@ -4,6 +4,7 @@
 #include "Song.hxx"
 #include "ExportedSong.hxx"
 #include "Directory.hxx"
+#include "NodePool.hxx"
 #include "tag/Tag.hxx"
 #include "tag/Builder.hxx"
 #include "song/DetachedSong.hxx"
@@ -12,8 +13,32 @@
 #include "time/ChronoUtil.hxx"
 #include "util/IterableSplitString.hxx"
 
+#include <cassert>
+
 using std::string_view_literals::operator""sv;
 
+static NodePool<Song> song_pool;
+
+void *
+Song::operator new([[maybe_unused]] std::size_t size)
+{
+	assert(size == sizeof(Song));
+
+	return song_pool.Allocate();
+}
+
+void
+Song::operator delete(void *p) noexcept
+{
+	song_pool.Free(p);
+}
+
+NodePoolStats
+Song::GetPoolStats() noexcept
+{
+	return song_pool.GetStats();
+}
+
 Song::Song(DetachedSong &&other, Directory &_parent) noexcept
 	:parent(_parent),
 	 filename(other.GetURI()),
@@ -8,12 +8,15 @@
 #include "Chrono.hxx"
 #include "tag/Tag.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 #include "config.h"
 
+#include <cstddef>
 #include <string>
 
 struct Directory;
+struct NodePoolStats;
 struct StorageFileInfo;
 class ExportedSong;
 class DetachedSong;
@@ -29,6 +32,13 @@ struct Song : IntrusiveListHook<> {
 	   #db_mutex.  Read access in the update thread does not need
 	   protection. */
 
+	/**
+	 * Links this song into a global hash table indexed by parent
+	 * and file name, for Directory::FindSong().  Protected with
+	 * the global #db_mutex, just like the list hook.
+	 */
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> index_hook;
+
 	/**
 	 * The #Directory that contains this song.
 	 */
@@ -99,6 +109,20 @@ struct Song : IntrusiveListHook<> {
 
 	Song(DetachedSong &&other, Directory &_parent) noexcept;
 
+	/**
+	 * #Song objects are allocated from a #NodePool to reduce
+	 * per-object heap overhead and to keep them close together
+	 * in memory.
+	 */
+	static void *operator new(std::size_t size);
+	static void operator delete(void *p) noexcept;
+
+	/**
+	 * Returns the statistics of the #NodePool which holds all
+	 * #Song objects.
+	 */
+	static NodePoolStats GetPoolStats() noexcept;
+
 	[[gnu::pure]]
 	const char *GetFilenameSuffix() const noexcept;
 
@@ -0,0 +1,369 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Sort.hxx"
+#include "tag/VisitFallback.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+
+/**
+ * The sort values (Tag::GetSortValue()) of all visible songs, per
+ * tag type.  This is only needed temporarily by Build() to fill
+ * PerType::sorted.
+ */
+struct TagIndex::SortKeys
+	: std::array<std::vector<std::pair<std::string, const Song *>>,
+		     TAG_NUM_OF_ITEM_TYPES> {};
+
+TagIndex::TagIndex(TagMask _mask) noexcept
+	:mask(_mask) {}
+
+TagIndex::~TagIndex() noexcept = default;
+
+inline void
+TagIndex::Add(const Song &song, bool visible, SortKeys &keys)
+{
+	for (const auto &item : song.tag) {
+		auto *t = types[item.type].get();
+		if (t == nullptr)
+			continue;
+
+		auto &v = t->songs[item.value];
+		if (v.empty() || v.back() != &song)
+			v.push_back(&song);
+	}
+
+	if (!visible)
+		return;
+
+	/* use the exported song (merged with the tags of the CUE
+	   target), because that is what queries see */
+	const auto exported = song.Export();
+	const Tag &tag = exported.tag;
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		auto *t = types[i].get();
+		if (t == nullptr)
+			continue;
+
+		VisitTagWithFallbackOrEmpty(tag, TagType(i),
+					    [t, &tag](const char *value){
+						    auto v = t->values.find(value);
+						    if (v == t->values.end())
+							    v = t->values.emplace(value, SongCountStats{}).first;
+						    v->second.Add(tag.duration);
+					    });
+
+		keys[i].emplace_back(tag.GetSortValue(TagType(i)), &song);
+	}
+}
+
+inline void
+TagIndex::Build(const Directory &directory, bool hide_playlist_targets,
+		SortKeys &keys)
+{
+	for (const auto &song : directory.songs)
+		Add(song, !hide_playlist_targets || !song.in_playlist, keys);
+
+	for (const auto &child : directory.children)
+		Build(child, hide_playlist_targets, keys);
+}
+
+void
+TagIndex::Build(const Directory &root, bool hide_playlist_targets)
+{
+	assert(root.IsRoot());
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (mask.Test(TagType(i)))
+			types[i] = std::make_unique<PerType>();
+
+	auto keys = std::make_unique<SortKeys>();
+	Build(root, hide_playlist_targets, *keys);
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		auto *t = types[i].get();
+		if (t == nullptr)
+			continue;
+
+		const TagType type = TagType(i);
+		auto &k = (*keys)[i];
+
+		/* stable, so songs with the same value remain in
+		   Directory::Walk() order */
+		std::stable_sort(k.begin(), k.end(),
+				 [type](const auto &a, const auto &b){
+					 return CompareTagValues(type,
+								 a.first.c_str(),
+								 b.first.c_str());
+				 });
+
+		t->sorted.reserve(k.size());
+		for (std::size_t j = 0; j < k.size(); ++j) {
+			if (j == 0 ||
+			    CompareTagValues(type, k[j - 1].first.c_str(),
+					     k[j].first.c_str()))
+				t->sorted_groups.push_back(j);
+
+			t->sorted.push_back(k[j].second);
+		}
+
+		/* free the memory early */
+		k = {};
+	}
+}
+
+const TagIndex::ValueMap *
+TagIndex::GetValues(TagType type) const noexcept
+{
+	const auto *t = Get(type);
+	return t != nullptr ? &t->values : nullptr;
+}
+
+std::optional<RecursiveMap<std::string>>
+TagIndex::GetUniqueTags(std::span<const TagType> tag_types) const noexcept
+{
+	const auto key = MakeUniqueTagsKey(tag_types);
+	if (!key)
+		return std::nullopt;
+
+	const std::scoped_lock lock{cache_mutex};
+	if (auto i = unique_tags_cache.find(*key); i != unique_tags_cache.end())
+		return i->second;
+
+	return std::nullopt;
+}
+
+void
+TagIndex::PutUniqueTags(std::span<const TagType> tag_types,
+			const RecursiveMap<std::string> &result) const noexcept
+{
+	const auto key = MakeUniqueTagsKey(tag_types);
+	if (!key)
+		return;
+
+	const std::scoped_lock lock{cache_mutex};
+
+	/* clients use only a few groupings; don't let one fill
+	   the memory with all combinations */
+	if (unique_tags_cache.size() >= MAX_UNIQUE_TAGS_CACHE)
+		unique_tags_cache.clear();
+
+	unique_tags_cache.insert_or_assign(*key, result);
+}
+
+using SongSet = std::unordered_set<const Song *>;
+using DirectorySet = std::unordered_set<const Directory *>;
+
+/**
+ * Can this #TagSongFilter be evaluated by looking up its value in
+ * the index?  If yes, then all songs which match it are guaranteed
+ * to be contained in the index entries of its tag type and of its
+ * fallback tag types.
+ */
+[[gnu::pure]]
+static bool
+IsIndexable(const TagSongFilter &f) noexcept
+{
+	const auto &sf = f.GetFilter();
+	return f.GetTagType() < TAG_NUM_OF_ITEM_TYPES &&
+		!sf.IsNegated() && !sf.GetFoldCase() && !sf.IsRegex() &&
+		sf.GetPosition() != StringFilter::Position::ANYWHERE &&
+		/* an empty value matches songs without this tag,
+		   and these are not in the index */
+		!sf.empty();
+}
+
+/**
+ * Invoke the given function for all index entries of the given
+ * #PerType object matching the #StringFilter (which must be
+ * indexable).
+ */
+template<typename Map, typename F>
+static void
+ForEachMatch(const Map &songs, const StringFilter &sf, F &&f)
+{
+	const std::string_view value = sf.GetValue();
+
+	if (sf.GetPosition() == StringFilter::Position::FULL) {
+		if (auto i = songs.find(value); i != songs.end())
+			f(i->second);
+		return;
+	}
+
+	for (auto i = songs.lower_bound(value);
+	     i != songs.end() && i->first.starts_with(value); ++i)
+		f(i->second);
+}
+
+/**
+ * Mark the given #Directory and all of its ancestors.
+ */
+static void
+MarkDirectory(DirectorySet &directories, const Directory *directory)
+{
+	while (directory != nullptr && directories.emplace(directory).second)
+		directory = directory->parent;
+}
+
+static void
+WalkCandidates(const Directory &directory, const SongFilter &filter,
+	       bool hide_playlist_targets,
+	       const VisitSong &visit_song,
+	       const SongSet &songs, const DirectorySet &directories)
+{
+	for (const auto &song : directory.songs) {
+		if (hide_playlist_targets && song.in_playlist)
+			continue;
+
+		if (!songs.contains(&song))
+			continue;
+
+		const auto song2 = song.Export();
+		if (filter.Match(song2))
+			visit_song(song2);
+	}
+
+	for (const auto &child : directory.children)
+		if (directories.contains(&child))
+			WalkCandidates(child, filter, hide_playlist_targets,
+				       visit_song, songs, directories);
+}
+
+const TagSongFilter *
+TagIndex::FindBestFilter(const SongFilter &filter,
+			 std::size_t &count_r) const noexcept
+{
+	/* find the most selective indexable filter item; the
+	   number of index entries is a cheap upper estimate */
+
+	const TagSongFilter *best = nullptr;
+	std::size_t best_count = SIZE_MAX;
+
+	for (const auto &item : filter.GetItems()) {
+		const auto *f = dynamic_cast<const TagSongFilter *>(item.get());
+		if (f == nullptr || !IsIndexable(*f))
+			continue;
+
+		std::size_t count = 0;
+		bool indexed = true;
+		ApplyTagWithFallback(f->GetTagType(), [&](TagType type){
+			const auto *t = Get(type);
+			if (t == nullptr) {
+				indexed = false;
+				return true;
+			}
+
+			ForEachMatch(t->songs, f->GetFilter(),
+				     [&count](const auto &v){
+					     count += v.size();
+				     });
+			return false;
+		});
+
+		if (indexed && count < best_count) {
+			best = f;
+			best_count = count;
+		}
+	}
+
+	count_r = best_count;
+	return best;
+}
+
+bool
+TagIndex::Walk(const Directory &directory, const SongFilter &filter,
+	       bool hide_playlist_targets,
+	       const VisitSong &visit_song) const
+{
+	std::size_t best_count;
+	const TagSongFilter *best = FindBestFilter(filter, best_count);
+	if (best == nullptr)
+		return false;
+
+	SongSet songs;
+	songs.reserve(best_count);
+	DirectorySet directories;
+
+	ApplyTagWithFallback(best->GetTagType(), [&](TagType type){
+		ForEachMatch(Get(type)->songs, best->GetFilter(),
+			     [&](const auto &v){
+				     for (const Song *song : v) {
+					     songs.emplace(song);
+					     MarkDirectory(directories,
+							   &song->parent);
+				     }
+			     });
+		return false;
+	});
+
+	if (directories.contains(&directory))
+		WalkCandidates(directory, filter, hide_playlist_targets,
+			       visit_song, songs, directories);
+	return true;
+}
+
+/**
+ * Invoke the given function for all songs of PerType::sorted in the
+ * given order until it returns false.
+ */
+template<typename PerType, typename F>
+static void
+ForEachSorted(const PerType &t, bool descending, F &&f)
+{
+	if (!descending) {
+		for (const Song *song : t.sorted)
+			if (!f(*song))
+				return;
+		return;
+	}
+
+	/* reverse the order of the groups, but not the order
+	   within each group */
+	std::size_t end = t.sorted.size();
+	for (auto g = t.sorted_groups.rbegin();
+	     g != t.sorted_groups.rend(); ++g) {
+		for (std::size_t i = *g; i < end; ++i)
+			if (!f(*t.sorted[i]))
+				return;
+
+		end = *g;
+	}
+}
+
+bool
+TagIndex::VisitSorted(TagType type, bool descending,
+		      const SongFilter *filter, RangeArg window,
+		      const VisitSong &visit_song) const
+{
+	const auto *t = type < TAG_NUM_OF_ITEM_TYPES ? Get(type) : nullptr;
+	if (t == nullptr)
+		return false;
+
+	if (window.IsEmpty())
+		return true;
+
+	unsigned position = 0;
+	ForEachSorted(*t, descending, [&](const Song &song){
+		const auto song2 = song.Export();
+		if (filter != nullptr && !filter->Match(song2))
+			return true;
+
+		if (window.Contains(position))
+			visit_song(song2);
+
+		return ++position < window.end;
+	});
+
+	return true;
+}
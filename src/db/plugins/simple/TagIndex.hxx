@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "tag/Mask.hxx"
+#include "tag/Type.hxx"
+#include "db/Visitor.hxx"
+#include "db/Stats.hxx"
+#include "protocol/RangeArg.hxx"
+#include "thread/Mutex.hxx"
+#include "util/RecursiveMap.hxx"
+
+#include <array>
+#include <functional> // for std::less
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Song;
+struct Directory;
+class SongFilter;
+class TagSongFilter;
+
+/**
+ * An in-memory secondary index which maps (#TagType, value) pairs to
+ * the #Song objects which contain them.  It allows #SimpleDatabase
+ * to look up candidates for "find"/"search"/"count" queries and to
+ * answer "list" and "count ... group" queries without walking the
+ * whole #Directory tree.  It also keeps all songs presorted by each
+ * indexed tag type for "find ... sort".
+ *
+ * The index contains plain pointers to #Song objects; it must be
+ * discarded before the tree gets modified.  All methods must be
+ * called while holding the #db_mutex; for Build(), the shared lock
+ * is enough.
+ */
+class TagIndex {
+public:
+	using ValueMap = std::map<std::string, SongCountStats, std::less<>>;
+
+private:
+	struct PerType {
+		/**
+		 * All songs which have a tag item of this type with the
+		 * given value (ignoring fallbacks).  This is used to
+		 * look up candidates for a #TagSongFilter.
+		 */
+		std::map<std::string, std::vector<const Song *>,
+			 std::less<>> songs;
+
+		/**
+		 * All values this tag type has in visible songs,
+		 * including fallback tags and the empty string for
+		 * songs which have none, just like
+		 * VisitTagWithFallbackOrEmpty() yields them, with
+		 * the number of songs and their total duration.  This
+		 * is used to answer "list" and "count ... group"
+		 * queries.
+		 */
+		ValueMap values;
+
+		/**
+		 * All visible songs sorted by this tag type (see
+		 * CompareTags()); songs with the same sort value are
+		 * in Directory::Walk() order.  This is used to answer
+		 * "find ... sort" queries without sorting.
+		 */
+		std::vector<const Song *> sorted;
+
+		/**
+		 * The indexes of #sorted where a group of songs with
+		 * the same sort value begins.  This is needed to
+		 * iterate in descending order while keeping the order
+		 * within each group, just like std::stable_sort()
+		 * does.
+		 */
+		std::vector<std::size_t> sorted_groups;
+	};
+
+	struct SortKeys;
+
+	const TagMask mask;
+
+	std::array<std::unique_ptr<PerType>, TAG_NUM_OF_ITEM_TYPES> types;
+
+	/**
+	 * Results of CollectUniqueTags() with two tag types over the
+	 * whole database (e.g. "list AlbumArtist group Date"), which
+	 * are filled on demand and discarded together with this
+	 * index.
+	 */
+	using UniqueTagsKey = std::pair<TagType, TagType>;
+	mutable std::map<UniqueTagsKey, RecursiveMap<std::string>> unique_tags_cache;
+
+	/**
+	 * Protects #unique_tags_cache.  The #db_mutex is not enough,
+	 * because queries hold it only in shared mode.
+	 */
+	mutable Mutex cache_mutex;
+
+	static constexpr std::size_t MAX_UNIQUE_TAGS_CACHE = 16;
+
+public:
+	explicit TagIndex(TagMask _mask) noexcept;
+	~TagIndex() noexcept;
+
+	TagIndex(const TagIndex &) = delete;
+	TagIndex &operator=(const TagIndex &) = delete;
+
+	/**
+	 * Add all songs of the database to the index.
+	 *
+	 * @param hide_playlist_targets the setting of the same name
+	 * from #SimpleDatabase; hidden songs are not visible to
+	 * GetValues() and VisitSorted()
+	 */
+	void Build(const Directory &root, bool hide_playlist_targets);
+
+	/**
+	 * Returns the distinct values of the given tag type with
+	 * their song counts (see PerType::values) or nullptr if this
+	 * type is not indexed.
+	 */
+	[[gnu::pure]]
+	const ValueMap *GetValues(TagType type) const noexcept;
+
+	/**
+	 * Look up a CollectUniqueTags() result for the whole database
+	 * which was stored with PutUniqueTags().
+	 */
+	std::optional<RecursiveMap<std::string>> GetUniqueTags(std::span<const TagType> tag_types) const noexcept;
+
+	/**
+	 * Remember a CollectUniqueTags() result for the whole
+	 * database.  Only results for two tag types are stored.
+	 */
+	void PutUniqueTags(std::span<const TagType> tag_types,
+			   const RecursiveMap<std::string> &result) const noexcept;
+
+	/**
+	 * Visit all songs below the given #Directory which match the
+	 * #SongFilter, in the same order as Directory::Walk() does.
+	 * The index is used to look up a (small) superset of matching
+	 * songs, and then the whole filter is applied to each of
+	 * them.
+	 *
+	 * @return false if the filter cannot be evaluated with this
+	 * index (nothing was visited, and the caller needs to walk
+	 * the tree)
+	 */
+	bool Walk(const Directory &directory, const SongFilter &filter,
+		  bool hide_playlist_targets,
+		  const VisitSong &visit_song) const;
+
+	/**
+	 * Can Walk() evaluate this filter?
+	 */
+	[[gnu::pure]]
+	bool CanWalk(const SongFilter &filter) const noexcept {
+		std::size_t count;
+		return FindBestFilter(filter, count) != nullptr;
+	}
+
+	/**
+	 * Visit all visible songs of the database which match the
+	 * (optional) #SongFilter in the order of the given tag type,
+	 * and stop at the end of the window.  This is equivalent to
+	 * walking the whole tree with #DatabaseVisitorHelper sorting
+	 * the result, but without collecting and sorting all songs.
+	 *
+	 * @return false if this tag type is not indexed (nothing was
+	 * visited)
+	 */
+	bool VisitSorted(TagType type, bool descending,
+			 const SongFilter *filter, RangeArg window,
+			 const VisitSong &visit_song) const;
+
+private:
+	void Build(const Directory &directory, bool hide_playlist_targets,
+		   SortKeys &keys);
+
+	void Add(const Song &song, bool visible, SortKeys &keys);
+
+	/**
+	 * Find the most selective #TagSongFilter which can be
+	 * evaluated with this index.
+	 *
+	 * @param count_r receives the number of index entries
+	 * matching it (a cheap upper estimate of the result size)
+	 * @return the filter item or nullptr if there is none
+	 */
+	[[gnu::pure]]
+	const TagSongFilter *FindBestFilter(const SongFilter &filter,
+					    std::size_t &count_r) const noexcept;
+
+	[[gnu::pure]]
+	static std::optional<UniqueTagsKey> MakeUniqueTagsKey(std::span<const TagType> tag_types) noexcept {
+		if (tag_types.size() != 2)
+			return std::nullopt;
+
+		return UniqueTagsKey{tag_types[0], tag_types[1]};
+	}
+
+	[[gnu::pure]]
+	const PerType *Get(TagType type) const noexcept {
+		return types[type].get();
+	}
+};
+
+#endif
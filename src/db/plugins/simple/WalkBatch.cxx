@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "WalkBatch.hxx"
+#include "db/LightDirectory.hxx"
+#include "song/LightSong.hxx"
+
+#include <cassert>
+
+std::size_t
+WalkBatch::AddPath(const char *uri)
+{
+	if (uri == nullptr)
+		return NO_PATH;
+
+	/* songs are visited directory by directory, so comparing
+	   with the most recent path is enough to store each path
+	   only once */
+	if (paths.empty() || paths.back() != uri)
+		paths.emplace_back(uri);
+
+	return paths.size() - 1;
+}
+
+VisitDirectory
+WalkBatch::Record(const VisitDirectory &visit)
+{
+	if (!visit)
+		return {};
+
+	return [this](const LightDirectory &directory){
+		directories.push_back({directory.uri, directory.mtime});
+		order.push_back(Type::DIRECTORY);
+	};
+}
+
+VisitSong
+WalkBatch::Record(const VisitSong &visit)
+{
+	if (!visit)
+		return {};
+
+	return [this](const LightSong &song){
+		songs.push_back({
+			song.uri,
+			song.real_uri != nullptr ? song.real_uri : "",
+			song.tag,
+			song.mtime, song.added,
+			song.start_time, song.end_time,
+			song.audio_format,
+			AddPath(song.directory),
+			song.real_uri != nullptr,
+		});
+		order.push_back(Type::SONG);
+	};
+}
+
+VisitPlaylist
+WalkBatch::Record(const VisitPlaylist &visit)
+{
+	if (!visit)
+		return {};
+
+	return [this](const PlaylistInfo &playlist,
+		      const LightDirectory &directory){
+		playlists.push_back({
+			PlaylistInfo{playlist.name, playlist.mtime},
+			{directory.uri, directory.mtime},
+		});
+		order.push_back(Type::PLAYLIST);
+	};
+}
+
+void
+WalkBatch::Replay(const VisitDirectory &visit_directory,
+			 const VisitSong &visit_song,
+			 const VisitPlaylist &visit_playlist) const
+{
+	auto directory = directories.begin();
+	auto song = songs.begin();
+	auto playlist = playlists.begin();
+
+	for (const Type type : order) {
+		switch (type) {
+		case Type::DIRECTORY:
+			assert(directory != directories.end());
+			visit_directory(LightDirectory{directory->uri.c_str(),
+						       directory->mtime});
+			++directory;
+			break;
+
+		case Type::SONG:
+			assert(song != songs.end());
+
+			{
+				LightSong light{song->uri.c_str(), song->tag};
+				if (song->directory != NO_PATH)
+					light.directory = paths[song->directory].c_str();
+				if (song->has_real_uri)
+					light.real_uri = song->real_uri.c_str();
+				light.mtime = song->mtime;
+				light.added = song->added;
+				light.start_time = song->start_time;
+				light.end_time = song->end_time;
+				light.audio_format = song->audio_format;
+				visit_song(light);
+			}
+
+			++song;
+			break;
+
+		case Type::PLAYLIST:
+			assert(playlist != playlists.end());
+			visit_playlist(playlist->info,
+				       LightDirectory{playlist->directory.uri.c_str(),
+						      playlist->directory.mtime});
+			++playlist;
+			break;
+		}
+	}
+}
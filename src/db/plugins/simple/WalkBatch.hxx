@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_SIMPLE_WALK_BATCH_HXX
+#define MPD_SIMPLE_WALK_BATCH_HXX
+
+#include "db/Visitor.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "Chrono.hxx"
+#include "tag/Tag.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A copy of some of the objects passed to the visitors of
+ * Directory::Walk(), which can be replayed after the #db_mutex has
+ * been released.  This way, a long "listallinfo" holds the lock only
+ * while a part of the tree is being walked, and not while the
+ * response is being generated, which would block the database update
+ * meanwhile.
+ *
+ * This is not a snapshot of the whole database: the walk is recorded
+ * and replayed in batches, so the copy never holds more than a
+ * bounded part of the database, and the database update may modify
+ * the tree between two batches.
+ *
+ * Copying is cheap: the #Tag item arrays are immutable and shared
+ * with the database, and the path of a directory is stored only
+ * once for all of its songs.
+ */
+class WalkBatch {
+	struct Directory {
+		std::string uri;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	struct Song {
+		std::string uri, real_uri;
+		Tag tag;
+		std::chrono::system_clock::time_point mtime, added;
+		SongTime start_time, end_time;
+		AudioFormat audio_format;
+
+		/**
+		 * An index into #paths or #NO_PATH if this song
+		 * is in the root directory.
+		 */
+		std::size_t directory;
+
+		bool has_real_uri;
+	};
+
+	struct Playlist {
+		PlaylistInfo info;
+		Directory directory;
+	};
+
+	static constexpr std::size_t NO_PATH = ~std::size_t{};
+
+	/**
+	 * The paths of the parent directories of all songs.
+	 */
+	std::vector<std::string> paths;
+
+	std::vector<Directory> directories;
+	std::vector<Song> songs;
+	std::vector<Playlist> playlists;
+
+	enum class Type : uint_least8_t {
+		DIRECTORY,
+		SONG,
+		PLAYLIST,
+	};
+
+	/**
+	 * The order in which the objects were visited; each one
+	 * refers to the next element of #directories, #songs or
+	 * #playlists.
+	 */
+	std::vector<Type> order;
+
+public:
+	/**
+	 * The number of recorded objects.
+	 */
+	std::size_t size() const noexcept {
+		return order.size();
+	}
+
+	bool empty() const noexcept {
+		return order.empty();
+	}
+
+	/**
+	 * Remove all recorded objects (after they have been
+	 * replayed), but keep the allocated memory for the next
+	 * batch.
+	 */
+	void clear() noexcept {
+		paths.clear();
+		directories.clear();
+		songs.clear();
+		playlists.clear();
+		order.clear();
+	}
+
+	/**
+	 * Returns visitors which copy into this object (unless the
+	 * given one is empty, i.e. the caller is not interested in
+	 * these objects).
+	 */
+	VisitDirectory Record(const VisitDirectory &visit);
+	VisitSong Record(const VisitSong &visit);
+	VisitPlaylist Record(const VisitPlaylist &visit);
+
+	/**
+	 * Pass all recorded objects to the given visitors, in the
+	 * order they were recorded.  The caller must not hold the
+	 * #db_mutex.
+	 */
+	void Replay(const VisitDirectory &visit_directory,
+		    const VisitSong &visit_song,
+		    const VisitPlaylist &visit_playlist) const;
+
+private:
+	std::size_t AddPath(const char *uri);
+};
+
+#endif
@@ -0,0 +1,1101 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SqliteDatabasePlugin.hxx"
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/Helpers.hxx"
+#include "db/UniqueTags.hxx"
+#include "db/LightDirectory.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "db/Selection.hxx"
+#include "db/Stats.hxx"
+#include "db/VHelper.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Fallback.hxx"
+#include "tag/Names.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Tag.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/AudioParser.hxx"
+#include "lib/sqlite/Database.hxx"
+#include "lib/sqlite/Util.hxx"
+#include "config/Block.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/NarrowPath.hxx"
+#include "time/ChronoUtil.hxx"
+#include "util/Domain.hxx"
+#include "util/RecursiveMap.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/StringBuffer.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Sqlite::Bind;
+using Sqlite::BindAll;
+using Sqlite::ExecuteCommand;
+using Sqlite::ExecuteForEach;
+using Sqlite::ExecuteRow;
+using Sqlite::Prepare;
+
+static constexpr Domain sqlite_db_domain("sqlite_db");
+
+enum sqlite_db_sql {
+	SQLITE_DB_SQL_GET_META,
+	SQLITE_DB_SQL_SET_META,
+	SQLITE_DB_SQL_FIND_DIRECTORY,
+	SQLITE_DB_SQL_CHILD_DIRECTORIES,
+	SQLITE_DB_SQL_DIRECTORY_SONGS,
+	SQLITE_DB_SQL_DIRECTORY_PLAYLISTS,
+	SQLITE_DB_SQL_FIND_SONG,
+	SQLITE_DB_SQL_GET_SONG,
+	SQLITE_DB_SQL_ALL_SONGS,
+	SQLITE_DB_SQL_SUBTREE_SONGS,
+	SQLITE_DB_SQL_SONG_TAGS,
+	SQLITE_DB_SQL_TAG_SONGS,
+	SQLITE_DB_SQL_TAG_PREFIX_SONGS,
+	SQLITE_DB_SQL_STATS,
+	SQLITE_DB_SQL_COUNT_VALUES,
+	SQLITE_DB_SQL_INSERT_DIRECTORY,
+	SQLITE_DB_SQL_INSERT_SONG,
+	SQLITE_DB_SQL_INSERT_TAG,
+	SQLITE_DB_SQL_INSERT_PLAYLIST,
+	SQLITE_DB_SQL_TRANSACTION_BEGIN,
+	SQLITE_DB_SQL_TRANSACTION_COMMIT,
+	SQLITE_DB_SQL_TRANSACTION_ROLLBACK,
+
+	SQLITE_DB_SQL_COUNT
+};
+
+/**
+ * The columns of the "song" table which are needed to construct a
+ * #SqliteSong (see there).
+ */
+#define SONG_COLUMNS "song.id, song.name, song.real_uri, song.mtime, song.added, " \
+	"song.start_ms, song.end_ms, song.duration_ms, song.audio_format"
+
+static constexpr auto sqlite_db_sql = std::array {
+	//[SQLITE_DB_SQL_GET_META] =
+	"SELECT value FROM meta WHERE name=?",
+	//[SQLITE_DB_SQL_SET_META] =
+	"INSERT OR REPLACE INTO meta(name, value) VALUES(?, ?)",
+
+	//[SQLITE_DB_SQL_FIND_DIRECTORY] =
+	"SELECT id, mtime FROM directory WHERE uri=?",
+	//[SQLITE_DB_SQL_CHILD_DIRECTORIES] =
+	"SELECT id, uri, mtime FROM directory WHERE parent=? ORDER BY id",
+	//[SQLITE_DB_SQL_DIRECTORY_SONGS] =
+	"SELECT " SONG_COLUMNS " FROM song WHERE directory=? ORDER BY id",
+	//[SQLITE_DB_SQL_DIRECTORY_PLAYLISTS] =
+	"SELECT name, mtime FROM playlist WHERE directory=? ORDER BY id",
+
+	//[SQLITE_DB_SQL_FIND_SONG] =
+	"SELECT " SONG_COLUMNS " FROM song WHERE directory=? AND name=?",
+	//[SQLITE_DB_SQL_GET_SONG] =
+	"SELECT " SONG_COLUMNS ", directory.uri FROM song"
+	" JOIN directory ON song.directory=directory.id"
+	" WHERE song.id=?",
+	//[SQLITE_DB_SQL_ALL_SONGS] =
+	"SELECT " SONG_COLUMNS ", directory.uri FROM song"
+	" JOIN directory ON song.directory=directory.id",
+	/* the directory itself and all directories in the (index
+	   friendly) range between "BASE/" and "BASE0" ('0' follows
+	   '/' in ASCII) */
+	//[SQLITE_DB_SQL_SUBTREE_SONGS] =
+	"SELECT " SONG_COLUMNS ", directory.uri FROM directory"
+	" JOIN song ON song.directory=directory.id"
+	" WHERE directory.uri=? OR (directory.uri>=? AND directory.uri<?)",
+
+	//[SQLITE_DB_SQL_SONG_TAGS] =
+	"SELECT type, value FROM tag WHERE song=? ORDER BY rowid",
+	//[SQLITE_DB_SQL_TAG_SONGS] =
+	"SELECT song FROM tag WHERE type=? AND value=?",
+	//[SQLITE_DB_SQL_TAG_PREFIX_SONGS] =
+	"SELECT song FROM tag WHERE type=? AND value>=? AND value<?",
+
+	//[SQLITE_DB_SQL_STATS] =
+	"SELECT count(*), total(duration_ms) FROM song",
+	//[SQLITE_DB_SQL_COUNT_VALUES] =
+	"SELECT count(DISTINCT value) FROM tag WHERE type=?",
+
+	//[SQLITE_DB_SQL_INSERT_DIRECTORY] =
+	"INSERT INTO directory(parent, uri, mtime) VALUES(?, ?, ?)",
+	//[SQLITE_DB_SQL_INSERT_SONG] =
+	"INSERT INTO song(directory, name, real_uri, mtime, added,"
+	" start_ms, end_ms, duration_ms, audio_format)"
+	" VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?)",
+	//[SQLITE_DB_SQL_INSERT_TAG] =
+	"INSERT INTO tag(song, type, value) VALUES(?, ?, ?)",
+	//[SQLITE_DB_SQL_INSERT_PLAYLIST] =
+	"INSERT INTO playlist(directory, name, mtime) VALUES(?, ?, ?)",
+
+	//[SQLITE_DB_SQL_TRANSACTION_BEGIN]
+	"BEGIN",
+	//[SQLITE_DB_SQL_TRANSACTION_COMMIT]
+	"COMMIT",
+	//[SQLITE_DB_SQL_TRANSACTION_ROLLBACK]
+	"ROLLBACK",
+};
+
+static_assert(sqlite_db_sql.size() == SQLITE_DB_SQL_COUNT);
+
+/* tag types are stored by name, because the numeric values of
+   #TagType may change between MPD versions */
+static constexpr const char sqlite_db_sql_create[] =
+	"CREATE TABLE IF NOT EXISTS meta("
+	"  name VARCHAR PRIMARY KEY NOT NULL, "
+	"  value INTEGER NOT NULL"
+	");"
+	"CREATE TABLE IF NOT EXISTS directory("
+	"  id INTEGER PRIMARY KEY, "
+	"  parent INTEGER, "
+	"  uri VARCHAR NOT NULL, "
+	"  mtime INTEGER"
+	");"
+	"CREATE UNIQUE INDEX IF NOT EXISTS"
+	" directory_uri ON directory(uri);"
+	"CREATE INDEX IF NOT EXISTS"
+	" directory_parent ON directory(parent);"
+	"CREATE TABLE IF NOT EXISTS song("
+	"  id INTEGER PRIMARY KEY, "
+	"  directory INTEGER NOT NULL, "
+	"  name VARCHAR NOT NULL, "
+	"  real_uri VARCHAR, "
+	"  mtime INTEGER, "
+	"  added INTEGER, "
+	"  start_ms INTEGER NOT NULL, "
+	"  end_ms INTEGER NOT NULL, "
+	"  duration_ms INTEGER, "
+	"  audio_format VARCHAR"
+	");"
+	"CREATE UNIQUE INDEX IF NOT EXISTS"
+	" song_name ON song(directory, name);"
+	"CREATE TABLE IF NOT EXISTS tag("
+	"  song INTEGER NOT NULL, "
+	"  type VARCHAR NOT NULL, "
+	"  value VARCHAR NOT NULL"
+	");"
+	"CREATE INDEX IF NOT EXISTS"
+	" tag_song ON tag(song);"
+	"CREATE INDEX IF NOT EXISTS"
+	" tag_value ON tag(type, value);"
+	"CREATE TABLE IF NOT EXISTS playlist("
+	"  id INTEGER PRIMARY KEY, "
+	"  directory INTEGER NOT NULL, "
+	"  name VARCHAR NOT NULL, "
+	"  mtime INTEGER"
+	");"
+	"CREATE INDEX IF NOT EXISTS"
+	" playlist_directory ON playlist(directory);"
+	"";
+
+static constexpr const char sqlite_db_sql_clear[] =
+	"DELETE FROM tag;"
+	"DELETE FROM song;"
+	"DELETE FROM playlist;"
+	"DELETE FROM directory;"
+	"";
+
+/**
+ * Throws #SqliteError on error.
+ */
+static void
+BindInt64(sqlite3_stmt *stmt, unsigned i, int64_t value)
+{
+	int result = sqlite3_bind_int64(stmt, i, value);
+	if (result != SQLITE_OK)
+		throw SqliteError(stmt, result, "sqlite3_bind_int64() failed");
+}
+
+/**
+ * Bind a time stamp as seconds since the epoch, or NULL if it is
+ * unknown.
+ *
+ * Throws #SqliteError on error.
+ */
+static void
+BindTime(sqlite3_stmt *stmt, unsigned i,
+	 std::chrono::system_clock::time_point t)
+{
+	if (IsNegative(t))
+		Bind(stmt, i, nullptr);
+	else
+		BindInt64(stmt, i, std::chrono::system_clock::to_time_t(t));
+}
+
+static const char *
+ColumnText(sqlite3_stmt *stmt, int i) noexcept
+{
+	return (const char *)sqlite3_column_text(stmt, i);
+}
+
+static std::chrono::system_clock::time_point
+ColumnTime(sqlite3_stmt *stmt, int i) noexcept
+{
+	if (sqlite3_column_type(stmt, i) == SQLITE_NULL)
+		return std::chrono::system_clock::time_point::min();
+
+	return std::chrono::system_clock::from_time_t(sqlite3_column_int64(stmt, i));
+}
+
+/**
+ * A #LightSong which owns copies of all strings loaded from a row
+ * with #SONG_COLUMNS.
+ */
+class SqliteSong : public LightSong {
+	std::string directory_buffer, uri_buffer, real_uri_buffer;
+
+	Tag tag2;
+
+public:
+	SqliteSong(sqlite3_stmt *stmt, std::string_view _directory,
+		   Tag &&_tag) noexcept;
+
+	SqliteSong(const SqliteSong &) = delete;
+	SqliteSong &operator=(const SqliteSong &) = delete;
+};
+
+SqliteSong::SqliteSong(sqlite3_stmt *stmt, std::string_view _directory,
+		       Tag &&_tag) noexcept
+	:LightSong(nullptr, tag2),
+	 directory_buffer(_directory),
+	 uri_buffer(ColumnText(stmt, 1)),
+	 tag2(std::move(_tag))
+{
+	if (!directory_buffer.empty())
+		directory = directory_buffer.c_str();
+
+	uri = uri_buffer.c_str();
+
+	if (const char *s = ColumnText(stmt, 2); s != nullptr)
+		real_uri = real_uri_buffer.assign(s).c_str();
+
+	mtime = ColumnTime(stmt, 3);
+	added = ColumnTime(stmt, 4);
+	start_time = SongTime::FromMS(sqlite3_column_int64(stmt, 5));
+	end_time = SongTime::FromMS(sqlite3_column_int64(stmt, 6));
+
+	if (const char *s = ColumnText(stmt, 8); s != nullptr) {
+		try {
+			audio_format = ParseAudioFormat(s, false);
+		} catch (...) {
+		}
+	}
+}
+
+class SqliteDatabase final : public Database {
+	EventLoop &main_event_loop, &io_event_loop;
+	DatabaseListener &listener;
+
+	const AllocatedPath path;
+
+	/**
+	 * A file written by the "simple" database plugin which gets
+	 * imported whenever it was modified.  May be nullptr.
+	 */
+	const AllocatedPath import_path;
+
+	Sqlite::Database db;
+
+	std::array<sqlite3_stmt *, SQLITE_DB_SQL_COUNT> stmt{};
+
+	std::chrono::system_clock::time_point update_stamp;
+
+	struct DirectoryRow {
+		int64_t id;
+		std::string uri;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+public:
+	SqliteDatabase(EventLoop &_main_event_loop,
+		       EventLoop &_io_event_loop,
+		       DatabaseListener &_listener,
+		       const ConfigBlock &block);
+
+	static DatabasePtr Create(EventLoop &main_event_loop,
+				  EventLoop &io_event_loop,
+				  DatabaseListener &listener,
+				  const ConfigBlock &block) {
+		return std::make_unique<SqliteDatabase>(main_event_loop,
+							io_event_loop,
+							listener, block);
+	}
+
+	/* virtual methods from class Database */
+	void Open() override;
+	void Close() noexcept override;
+	const LightSong *GetSong(std::string_view uri_utf8) const override;
+	void ReturnSong(const LightSong *song) const noexcept override;
+
+	void Visit(const DatabaseSelection &selection,
+		   VisitDirectory visit_directory,
+		   VisitSong visit_song,
+		   VisitPlaylist visit_playlist) const override;
+
+	RecursiveMap<std::string> CollectUniqueTags(const DatabaseSelection &selection,
+						    std::span<const TagType> tag_types) const override;
+
+	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
+
+	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
+		return update_stamp;
+	}
+
+private:
+	/**
+	 * Re-import #import_path in one transaction if it was
+	 * modified since the last import.
+	 */
+	void Import();
+
+	void ImportDatabase(const Database &src);
+
+	int64_t GetMeta(const char *name, int64_t default_value) const;
+	void SetMeta(const char *name, int64_t value);
+
+	void ExecuteSimple(enum sqlite_db_sql sql);
+
+	std::optional<DirectoryRow> FindDirectory(const std::string &uri) const;
+
+	Tag LoadTag(int64_t song_id, sqlite3_stmt *song_stmt) const;
+
+	std::unique_ptr<SqliteSong> FindSong(std::string_view uri) const;
+
+	/**
+	 * Visit a song URI (not a directory) of a #DatabaseSelection.
+	 *
+	 * @return false if there is no such song
+	 */
+	bool VisitSongUri(const DatabaseSelection &selection,
+			  const VisitSong &visit_song) const;
+
+	void WalkDirectory(const DirectoryRow &directory, bool recursive,
+			   const SongFilter *filter,
+			   const VisitDirectory &visit_directory,
+			   const VisitSong &visit_song,
+			   const VisitPlaylist &visit_playlist) const;
+
+	/**
+	 * Visit all songs below the given directory (recursively)
+	 * with one query.
+	 */
+	void VisitSubtree(const std::string &base, const SongFilter *filter,
+			  const VisitSong &visit_song) const;
+
+	/**
+	 * Look up candidates for a #TagSongFilter in the "tag_value"
+	 * index and apply the whole #SongFilter to each of them.
+	 *
+	 * @return false if the filter cannot be evaluated with the
+	 * index (nothing was visited)
+	 */
+	bool VisitIndexed(const std::string &base, const SongFilter &filter,
+			  const VisitSong &visit_song) const;
+};
+
+SqliteDatabase::SqliteDatabase(EventLoop &_main_event_loop,
+			       EventLoop &_io_event_loop,
+			       DatabaseListener &_listener,
+			       const ConfigBlock &block)
+	:Database(sqlite_db_plugin),
+	 main_event_loop(_main_event_loop), io_event_loop(_io_event_loop),
+	 listener(_listener),
+	 path(block.GetPath("path")),
+	 import_path(block.GetPath("import"))
+{
+	if (path.IsNull())
+		throw std::runtime_error("No \"path\" parameter specified");
+}
+
+void
+SqliteDatabase::Open()
+{
+	db = Sqlite::Database{NarrowPath{path}};
+
+	int ret = sqlite3_exec(db, sqlite_db_sql_create,
+			       nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		throw SqliteError(db, ret,
+				  "Failed to create database tables");
+
+	for (std::size_t i = 0; i < sqlite_db_sql.size(); ++i)
+		stmt[i] = Prepare(db, sqlite_db_sql[i]);
+
+	if (!import_path.IsNull()) {
+		try {
+			Import();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to import database");
+		}
+	}
+
+	const int64_t mtime = GetMeta("mtime", -1);
+	update_stamp = mtime >= 0
+		? std::chrono::system_clock::from_time_t(mtime)
+		: std::chrono::system_clock::time_point::min();
+}
+
+void
+SqliteDatabase::Close() noexcept
+{
+	for (auto &s : stmt) {
+		if (s != nullptr)
+			sqlite3_finalize(s);
+		s = nullptr;
+	}
+
+	db = {};
+}
+
+int64_t
+SqliteDatabase::GetMeta(const char *name, int64_t default_value) const
+{
+	sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_GET_META];
+
+	BindAll(s, name);
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	return ExecuteRow(s)
+		? sqlite3_column_int64(s, 0)
+		: default_value;
+}
+
+void
+SqliteDatabase::SetMeta(const char *name, int64_t value)
+{
+	sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_SET_META];
+
+	Bind(s, 1, name);
+	BindInt64(s, 2, value);
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	ExecuteCommand(s);
+}
+
+void
+SqliteDatabase::ExecuteSimple(enum sqlite_db_sql sql)
+{
+	sqlite3_stmt *const s = stmt[sql];
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+	};
+
+	ExecuteCommand(s);
+}
+
+void
+SqliteDatabase::Import()
+{
+	FileInfo fi;
+	if (!GetFileInfo(import_path, fi))
+		return;
+
+	const int64_t import_mtime =
+		std::chrono::system_clock::to_time_t(fi.GetModificationTime());
+	if (GetMeta("import_mtime", -1) == import_mtime)
+		return;
+
+	FmtNotice(sqlite_db_domain, "Importing {:?}", import_path.ToUTF8());
+
+	ConfigBlock block;
+	block.AddBlockParam("path", import_path.ToUTF8Throw());
+
+	/* the "simple" database holds the whole tree in memory, but
+	   only until the import is finished */
+	auto src = simple_db_plugin.create(main_event_loop, io_event_loop,
+					   listener, block);
+	src->Open();
+	AtScopeExit(&src) { src->Close(); };
+
+	ExecuteSimple(SQLITE_DB_SQL_TRANSACTION_BEGIN);
+
+	try {
+		int ret = sqlite3_exec(db, sqlite_db_sql_clear,
+				       nullptr, nullptr, nullptr);
+		if (ret != SQLITE_OK)
+			throw SqliteError(db, ret,
+					  "Failed to clear database tables");
+
+		ImportDatabase(*src);
+
+		const auto src_stamp = src->GetUpdateStamp();
+		SetMeta("mtime", IsNegative(src_stamp)
+			? -1
+			: (int64_t)std::chrono::system_clock::to_time_t(src_stamp));
+		SetMeta("import_mtime", import_mtime);
+
+		ExecuteSimple(SQLITE_DB_SQL_TRANSACTION_COMMIT);
+	} catch (...) {
+		ExecuteSimple(SQLITE_DB_SQL_TRANSACTION_ROLLBACK);
+		throw;
+	}
+}
+
+void
+SqliteDatabase::ImportDatabase(const Database &src)
+{
+	/* maps directory URIs to the "directory.id" column; parents
+	   are always visited before their children */
+	std::unordered_map<std::string, int64_t> directories;
+
+	const auto get_directory_id = [&directories](const char *uri){
+		if (uri == nullptr)
+			uri = "";
+
+		auto i = directories.find(uri);
+		if (i == directories.end())
+			throw std::runtime_error("Directory not found");
+
+		return i->second;
+	};
+
+	const auto visit_directory = [&](const LightDirectory &directory){
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_INSERT_DIRECTORY];
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		const std::string_view uri{directory.uri};
+		if (!uri.empty()) {
+			const auto slash = uri.rfind('/');
+			const std::string parent{slash == uri.npos
+				? std::string_view{}
+				: uri.substr(0, slash)};
+			BindInt64(s, 1, get_directory_id(parent.c_str()));
+		}
+
+		Bind(s, 2, directory.uri);
+		BindTime(s, 3, directory.mtime);
+		ExecuteCommand(s);
+
+		directories.emplace(directory.uri,
+				    sqlite3_last_insert_rowid(db));
+	};
+
+	const auto visit_song = [&](const LightSong &song){
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_INSERT_SONG];
+
+		{
+			AtScopeExit(s) {
+				sqlite3_reset(s);
+				sqlite3_clear_bindings(s);
+			};
+
+			BindInt64(s, 1, get_directory_id(song.directory));
+			Bind(s, 2, song.uri);
+			Bind(s, 3, song.real_uri);
+			BindTime(s, 4, song.mtime);
+			BindTime(s, 5, song.added);
+			BindInt64(s, 6, song.start_time.ToMS());
+			BindInt64(s, 7, song.end_time.ToMS());
+			if (!song.tag.duration.IsNegative())
+				BindInt64(s, 8, song.tag.duration.ToMS());
+
+			const auto af = ToString(song.audio_format);
+			if (song.audio_format.IsDefined())
+				Bind(s, 9, af.c_str());
+
+			ExecuteCommand(s);
+		}
+
+		const int64_t id = sqlite3_last_insert_rowid(db);
+		sqlite3_stmt *const t = stmt[SQLITE_DB_SQL_INSERT_TAG];
+
+		for (const auto &item : song.tag) {
+			AtScopeExit(t) {
+				sqlite3_reset(t);
+				sqlite3_clear_bindings(t);
+			};
+
+			BindInt64(t, 1, id);
+			Bind(t, 2, tag_item_names[item.type]);
+			Bind(t, 3, item.value);
+			ExecuteCommand(t);
+		}
+	};
+
+	const auto visit_playlist = [&](const PlaylistInfo &playlist,
+					const LightDirectory &directory){
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_INSERT_PLAYLIST];
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		BindInt64(s, 1, get_directory_id(directory.uri));
+		Bind(s, 2, playlist.name.c_str());
+		BindTime(s, 3, playlist.mtime);
+		ExecuteCommand(s);
+	};
+
+	src.Visit(DatabaseSelection{"", true},
+		  visit_directory, visit_song, visit_playlist);
+}
+
+std::optional<SqliteDatabase::DirectoryRow>
+SqliteDatabase::FindDirectory(const std::string &uri) const
+{
+	sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_FIND_DIRECTORY];
+
+	BindAll(s, uri.c_str());
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	if (!ExecuteRow(s)) {
+		if (uri.empty())
+			/* nothing was imported yet: an empty root
+			   directory */
+			return DirectoryRow{-1, uri,
+					    std::chrono::system_clock::time_point::min()};
+
+		return std::nullopt;
+	}
+
+	return DirectoryRow{sqlite3_column_int64(s, 0), uri,
+			    ColumnTime(s, 1)};
+}
+
+/**
+ * @param song_stmt a statement pointing to a row with #SONG_COLUMNS
+ */
+Tag
+SqliteDatabase::LoadTag(int64_t song_id, sqlite3_stmt *song_stmt) const
+{
+	TagBuilder builder;
+
+	if (sqlite3_column_type(song_stmt, 7) != SQLITE_NULL)
+		builder.SetDuration(SignedSongTime::FromMS(sqlite3_column_int64(song_stmt, 7)));
+
+	sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_SONG_TAGS];
+
+	BindInt64(s, 1, song_id);
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	ExecuteForEach(s, [s, &builder](){
+		const TagType type = tag_name_parse(ColumnText(s, 0));
+		if (type != TAG_NUM_OF_ITEM_TYPES)
+			builder.AddItemUnchecked(type, ColumnText(s, 1));
+	});
+
+	return builder.Commit();
+}
+
+std::unique_ptr<SqliteSong>
+SqliteDatabase::FindSong(std::string_view uri) const
+{
+	std::string directory_uri;
+	std::string_view name = uri;
+	if (const auto slash = uri.rfind('/'); slash != uri.npos) {
+		directory_uri = uri.substr(0, slash);
+		name = uri.substr(slash + 1);
+	}
+
+	const auto directory = FindDirectory(directory_uri);
+	if (!directory)
+		return nullptr;
+
+	const std::string name_buffer{name};
+
+	sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_FIND_SONG];
+
+	BindInt64(s, 1, directory->id);
+	Bind(s, 2, name_buffer.c_str());
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	if (!ExecuteRow(s))
+		return nullptr;
+
+	return std::make_unique<SqliteSong>(s, directory_uri,
+					    LoadTag(sqlite3_column_int64(s, 0), s));
+}
+
+const LightSong *
+SqliteDatabase::GetSong(std::string_view uri) const
+{
+	auto song = FindSong(uri);
+	if (song == nullptr)
+		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+				    "No such song");
+
+	return song.release();
+}
+
+void
+SqliteDatabase::ReturnSong(const LightSong *song) const noexcept
+{
+	assert(song != nullptr);
+
+	delete static_cast<const SqliteSong *>(song);
+}
+
+[[gnu::const]]
+static DatabaseSelection
+CheckSelection(DatabaseSelection selection) noexcept
+{
+	selection.uri.clear();
+	selection.filter = nullptr;
+	return selection;
+}
+
+void
+SqliteDatabase::Visit(const DatabaseSelection &selection,
+		      VisitDirectory visit_directory,
+		      VisitSong visit_song,
+		      VisitPlaylist visit_playlist) const
+{
+	DatabaseVisitorHelper helper(CheckSelection(selection), visit_song);
+
+	const auto directory = FindDirectory(selection.uri);
+	if (!directory) {
+		if (visit_song && VisitSongUri(selection, visit_song)) {
+			helper.Commit();
+			return;
+		}
+
+		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+				    "No such directory");
+	}
+
+	if (selection.recursive && visit_directory)
+		visit_directory(LightDirectory{directory->uri.c_str(),
+					       directory->mtime});
+
+	if (selection.recursive && !visit_directory && !visit_playlist) {
+		if (visit_song &&
+		    (selection.filter == nullptr ||
+		     !VisitIndexed(directory->uri, *selection.filter,
+				   visit_song)))
+			VisitSubtree(directory->uri, selection.filter,
+				     visit_song);
+	} else
+		WalkDirectory(*directory, selection.recursive,
+			      selection.filter,
+			      visit_directory, visit_song, visit_playlist);
+
+	helper.Commit();
+}
+
+inline bool
+SqliteDatabase::VisitSongUri(const DatabaseSelection &selection,
+			     const VisitSong &visit_song) const
+{
+	const auto song = FindSong(selection.uri);
+	if (song == nullptr)
+		return false;
+
+	if (selection.Match(*song))
+		visit_song(*song);
+
+	return true;
+}
+
+void
+SqliteDatabase::WalkDirectory(const DirectoryRow &directory,
+			      bool recursive, const SongFilter *filter,
+			      const VisitDirectory &visit_directory,
+			      const VisitSong &visit_song,
+			      const VisitPlaylist &visit_playlist) const
+{
+	if (visit_song) {
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_DIRECTORY_SONGS];
+
+		BindInt64(s, 1, directory.id);
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		ExecuteForEach(s, [&](){
+			const SqliteSong song{s, directory.uri,
+				LoadTag(sqlite3_column_int64(s, 0), s)};
+			if (filter == nullptr || filter->Match(song))
+				visit_song(song);
+		});
+	}
+
+	if (visit_playlist) {
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_DIRECTORY_PLAYLISTS];
+
+		BindInt64(s, 1, directory.id);
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		const LightDirectory light_directory{directory.uri.c_str(),
+						     directory.mtime};
+
+		ExecuteForEach(s, [&](){
+			visit_playlist(PlaylistInfo{ColumnText(s, 0),
+						    ColumnTime(s, 1)},
+				       light_directory);
+		});
+	}
+
+	/* collect the children first, because the statement cannot
+	   be used recursively */
+	std::vector<DirectoryRow> children;
+
+	{
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_CHILD_DIRECTORIES];
+
+		BindInt64(s, 1, directory.id);
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		ExecuteForEach(s, [s, &children](){
+			children.push_back({sqlite3_column_int64(s, 0),
+					    ColumnText(s, 1),
+					    ColumnTime(s, 2)});
+		});
+	}
+
+	for (const auto &child : children) {
+		if (visit_directory)
+			visit_directory(LightDirectory{child.uri.c_str(),
+						       child.mtime});
+
+		if (recursive)
+			WalkDirectory(child, recursive, filter,
+				      visit_directory, visit_song,
+				      visit_playlist);
+	}
+}
+
+void
+SqliteDatabase::VisitSubtree(const std::string &base,
+			     const SongFilter *filter,
+			     const VisitSong &visit_song) const
+{
+	sqlite3_stmt *s;
+	std::string lower, upper;
+
+	if (base.empty()) {
+		s = stmt[SQLITE_DB_SQL_ALL_SONGS];
+	} else {
+		s = stmt[SQLITE_DB_SQL_SUBTREE_SONGS];
+		lower = base + '/';
+		upper = base + '0';
+		BindAll(s, base.c_str(), lower.c_str(), upper.c_str());
+	}
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	ExecuteForEach(s, [&](){
+		const SqliteSong song{s, ColumnText(s, 9),
+			LoadTag(sqlite3_column_int64(s, 0), s)};
+		if (filter == nullptr || filter->Match(song))
+			visit_song(song);
+	});
+}
+
+/**
+ * Can this filter item be looked up in the "tag_value" index?
+ */
+[[gnu::pure]]
+static bool
+IsIndexable(const TagSongFilter &f) noexcept
+{
+	const auto &sf = f.GetFilter();
+	return f.GetTagType() < TAG_NUM_OF_ITEM_TYPES &&
+		!sf.IsNegated() && !sf.GetFoldCase() && !sf.IsRegex() &&
+		sf.GetPosition() != StringFilter::Position::ANYWHERE &&
+		/* an empty value matches songs without this tag,
+		   and these are not in the index */
+		!sf.empty();
+}
+
+[[gnu::pure]]
+static bool
+IsInDirectory(std::string_view uri, std::string_view base) noexcept
+{
+	return base.empty() || uri == base ||
+		(uri.starts_with(base) && uri[base.size()] == '/');
+}
+
+bool
+SqliteDatabase::VisitIndexed(const std::string &base,
+			     const SongFilter &filter,
+			     const VisitSong &visit_song) const
+{
+	const TagSongFilter *best = nullptr;
+	for (const auto &item : filter.GetItems()) {
+		const auto *f = dynamic_cast<const TagSongFilter *>(item.get());
+		if (f != nullptr && IsIndexable(*f) &&
+		    /* prefer exact matches over prefixes */
+		    (best == nullptr ||
+		     f->GetFilter().GetPosition() == StringFilter::Position::FULL)) {
+			best = f;
+			if (f->GetFilter().GetPosition() == StringFilter::Position::FULL)
+				break;
+		}
+	}
+
+	if (best == nullptr)
+		return false;
+
+	const auto &sf = best->GetFilter();
+	const bool prefix = sf.GetPosition() == StringFilter::Position::PREFIX;
+	const std::string value{sf.GetValue()};
+
+	/* no valid UTF-8 sequence contains 0xff, so this is greater
+	   than all values which begin with the prefix */
+	const std::string upper = value + '\xff';
+
+	std::vector<TagType> types;
+	ApplyTagWithFallback(best->GetTagType(), [&types](TagType type){
+		types.push_back(type);
+		return false;
+	});
+
+	/* the candidates of the tag type and all of its fallbacks
+	   (a superset of the matching songs) */
+	std::vector<int64_t> ids;
+
+	for (const TagType type : types) {
+		sqlite3_stmt *const s = prefix
+			? stmt[SQLITE_DB_SQL_TAG_PREFIX_SONGS]
+			: stmt[SQLITE_DB_SQL_TAG_SONGS];
+
+		if (prefix)
+			BindAll(s, tag_item_names[type], value.c_str(),
+				upper.c_str());
+		else
+			BindAll(s, tag_item_names[type], value.c_str());
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		ExecuteForEach(s, [s, &ids](){
+			ids.push_back(sqlite3_column_int64(s, 0));
+		});
+	}
+
+	/* visit in import order */
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+	sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_GET_SONG];
+
+	for (const int64_t id : ids) {
+		BindInt64(s, 1, id);
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		if (!ExecuteRow(s) || !IsInDirectory(ColumnText(s, 9), base))
+			continue;
+
+		const SqliteSong song{s, ColumnText(s, 9), LoadTag(id, s)};
+		if (filter.Match(song))
+			visit_song(song);
+	}
+
+	return true;
+}
+
+RecursiveMap<std::string>
+SqliteDatabase::CollectUniqueTags(const DatabaseSelection &selection,
+				  std::span<const TagType> tag_types) const
+{
+	return ::CollectUniqueTags(*this, selection, tag_types);
+}
+
+DatabaseStats
+SqliteDatabase::GetStats(const DatabaseSelection &selection) const
+{
+	if (selection.IsFiltered())
+		return ::GetStats(*this, selection);
+
+	DatabaseStats stats;
+	stats.Clear();
+
+	{
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_STATS];
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+		};
+
+		if (ExecuteRow(s)) {
+			stats.song_count = sqlite3_column_int64(s, 0);
+			const std::chrono::milliseconds duration{sqlite3_column_int64(s, 1)};
+			stats.total_duration = std::chrono::duration_cast<decltype(stats.total_duration)>(duration);
+		}
+	}
+
+	const auto count_values = [this](TagType type) -> unsigned {
+		sqlite3_stmt *const s = stmt[SQLITE_DB_SQL_COUNT_VALUES];
+
+		BindAll(s, tag_item_names[type]);
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		return ExecuteRow(s) ? sqlite3_column_int64(s, 0) : 0;
+	};
+
+	stats.artist_count = count_values(TAG_ARTIST);
+	stats.album_count = count_values(TAG_ALBUM);
+	return stats;
+}
+
+const DatabasePlugin sqlite_db_plugin = {
+	"sqlite",
+	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	SqliteDatabase::Create,
+};
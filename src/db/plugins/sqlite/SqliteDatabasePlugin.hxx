@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_SQLITE_DATABASE_PLUGIN_HXX
+#define MPD_SQLITE_DATABASE_PLUGIN_HXX
+
+struct DatabasePlugin;
+
+extern const DatabasePlugin sqlite_db_plugin;
+
+#endif
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Cache.hxx"
+#include "Directory.hxx"
+#include "lib/upnp/ContentDirectoryService.hxx"
+
+#include <algorithm>
+
+/* this destructor exists here just so it won't get inlined */
+UpnpDirCache::~UpnpDirCache() noexcept = default;
+
+inline std::string
+UpnpDirCache::MakeKey(const ContentDirectoryService &server,
+		      std::string_view id) noexcept
+{
+	std::string key = server.GetURI();
+	key.push_back('\n');
+	key.append(id);
+	return key;
+}
+
+template<typename T>
+inline std::shared_ptr<const T>
+UpnpDirCache::Get(const std::map<std::string, Entry<T>, std::less<>> &map,
+		  std::string_view key) const noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	auto i = map.find(key);
+	if (i == map.end() || i->second.expires <= clock_type::now())
+		return nullptr;
+
+	return i->second.value;
+}
+
+template<typename T>
+void
+UpnpDirCache::Shrink(std::map<std::string, Entry<T>, std::less<>> &map,
+		     std::size_t n, std::size_t max_size,
+		     clock_type::time_point now) noexcept
+{
+	if (map.size() + n <= max_size)
+		return;
+
+	std::erase_if(map, [now](const auto &i){
+		return i.second.expires <= now;
+	});
+
+	/* still too large: this is only a cache, start over */
+	if (map.size() + n > max_size)
+		map.clear();
+}
+
+inline void
+UpnpDirCache::PutObjectLocked(const ContentDirectoryService &server,
+			      std::shared_ptr<const UPnPDirObject> object,
+			      clock_type::time_point expires) noexcept
+{
+	auto key = MakeKey(server, object->id);
+	objects.insert_or_assign(std::move(key),
+				 Entry<UPnPDirObject>{std::move(object), expires});
+}
+
+inline void
+UpnpDirCache::PutObjectsLocked(const ContentDirectoryService &server,
+			       const std::shared_ptr<const UPnPDirContent> &content,
+			       clock_type::time_point now,
+			       clock_type::time_point expires) noexcept
+{
+	Shrink(objects, content->objects.size(), MAX_OBJECTS, now);
+
+	for (const auto &i : content->objects)
+		PutObjectLocked(server, {content, &i}, expires);
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDirCache::GetDirectory(const ContentDirectoryService &server,
+			   std::string_view id) const noexcept
+{
+	if (!IsEnabled())
+		return nullptr;
+
+	return Get(directories, MakeKey(server, id));
+}
+
+void
+UpnpDirCache::PutDirectory(const ContentDirectoryService &server,
+			   std::string_view id,
+			   std::shared_ptr<const UPnPDirContent> content) noexcept
+{
+	if (!IsEnabled())
+		return;
+
+	const auto now = clock_type::now();
+	const auto expires = now + ttl;
+
+	const std::scoped_lock lock{mutex};
+
+	PutObjectsLocked(server, content, now, expires);
+
+	Shrink(directories, 1, MAX_DIRECTORIES, now);
+	directories.insert_or_assign(MakeKey(server, id),
+				     Entry<UPnPDirContent>{std::move(content), expires});
+}
+
+std::shared_ptr<const UPnPDirObject>
+UpnpDirCache::GetObject(const ContentDirectoryService &server,
+			std::string_view id) const noexcept
+{
+	if (!IsEnabled())
+		return nullptr;
+
+	return Get(objects, MakeKey(server, id));
+}
+void
+UpnpDirCache::PutObject(const ContentDirectoryService &server,
+			std::shared_ptr<const UPnPDirObject> object) noexcept
+{
+	if (!IsEnabled())
+		return;
+
+	const auto now = clock_type::now();
+
+	const std::scoped_lock lock{mutex};
+	Shrink(objects, 1, MAX_OBJECTS, now);
+	PutObjectLocked(server, std::move(object), now + ttl);
+}
+
+void
+UpnpDirCache::PutObjects(const ContentDirectoryService &server,
+			 const std::shared_ptr<const UPnPDirContent> &content) noexcept
+{
+	if (!IsEnabled())
+		return;
+
+	const auto now = clock_type::now();
+
+	const std::scoped_lock lock{mutex};
+	PutObjectsLocked(server, content, now, now + ttl);
+}
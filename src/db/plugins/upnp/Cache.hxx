@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class ContentDirectoryService;
+class UPnPDirContent;
+class UPnPDirObject;
+
+/**
+ * A cache for "Browse" responses of UPnP media servers, to avoid
+ * querying the server again for every "lsinfo" and every path
+ * lookup.  Entries expire after a configurable duration, because
+ * UPnP servers do not notify us about changes.
+ *
+ * Besides whole directories (containers), this also caches the
+ * metadata of single objects; those are usually pointers into a
+ * cached directory (via the #std::shared_ptr aliasing constructor),
+ * so they do not need to be copied.
+ *
+ * This class is thread-safe.
+ */
+class UpnpDirCache {
+	using clock_type = std::chrono::steady_clock;
+
+	template<typename T>
+	struct Entry {
+		std::shared_ptr<const T> value;
+		clock_type::time_point expires;
+	};
+
+	const clock_type::duration ttl;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Directory contents, indexed by MakeKey().
+	 */
+	std::map<std::string, Entry<UPnPDirContent>, std::less<>> directories;
+
+	/**
+	 * Object metadata, indexed by MakeKey().
+	 */
+	std::map<std::string, Entry<UPnPDirObject>, std::less<>> objects;
+
+	static constexpr std::size_t MAX_DIRECTORIES = 1024;
+	static constexpr std::size_t MAX_OBJECTS = 65536;
+
+public:
+	/**
+	 * @param _ttl the time after which entries expire; zero
+	 * disables the cache
+	 */
+	explicit UpnpDirCache(clock_type::duration _ttl) noexcept
+		:ttl(_ttl) {}
+
+	~UpnpDirCache() noexcept;
+
+	UpnpDirCache(const UpnpDirCache &) = delete;
+	UpnpDirCache &operator=(const UpnpDirCache &) = delete;
+
+	bool IsEnabled() const noexcept {
+		return ttl > clock_type::duration::zero();
+	}
+
+	[[gnu::pure]]
+	std::shared_ptr<const UPnPDirContent> GetDirectory(const ContentDirectoryService &server,
+							   std::string_view id) const noexcept;
+
+	[[gnu::pure]]
+	bool HasDirectory(const ContentDirectoryService &server,
+			  std::string_view id) const noexcept {
+		return GetDirectory(server, id) != nullptr;
+	}
+
+	/**
+	 * Add the contents of a container, and the metadata of all of
+	 * its children.
+	 */
+	void PutDirectory(const ContentDirectoryService &server,
+			  std::string_view id,
+			  std::shared_ptr<const UPnPDirContent> content) noexcept;
+
+	[[gnu::pure]]
+	std::shared_ptr<const UPnPDirObject> GetObject(const ContentDirectoryService &server,
+						       std::string_view id) const noexcept;
+
+	void PutObject(const ContentDirectoryService &server,
+		       std::shared_ptr<const UPnPDirObject> object) noexcept;
+
+	/**
+	 * Add the metadata of all objects in the given (search)
+	 * result.
+	 */
+	void PutObjects(const ContentDirectoryService &server,
+			const std::shared_ptr<const UPnPDirContent> &content) noexcept;
+
+private:
+	[[gnu::pure]]
+	static std::string MakeKey(const ContentDirectoryService &server,
+				   std::string_view id) noexcept;
+
+	template<typename T>
+	[[gnu::pure]]
+	std::shared_ptr<const T> Get(const std::map<std::string, Entry<T>, std::less<>> &map,
+				     std::string_view key) const noexcept;
+
+	/**
+	 * Make room for @n new items in the given map.  Caller must
+	 * lock the mutex.
+	 */
+	template<typename T>
+	static void Shrink(std::map<std::string, Entry<T>, std::less<>> &map,
+			   std::size_t n, std::size_t max_size,
+			   clock_type::time_point now) noexcept;
+
+	void PutObjectLocked(const ContentDirectoryService &server,
+			     std::shared_ptr<const UPnPDirObject> object,
+			     clock_type::time_point expires) noexcept;
+
+	void PutObjectsLocked(const ContentDirectoryService &server,
+			      const std::shared_ptr<const UPnPDirContent> &content,
+			      clock_type::time_point now,
+			      clock_type::time_point expires) noexcept;
+};
@@ -4,10 +4,17 @@
 #include "lib/upnp/ContentDirectoryService.hxx"
 #include "lib/upnp/Action.hxx"
 #include "Directory.hxx"
+#include "thread/WorkerPool.hxx"
+#include "thread/Cond.hxx"
 #include "util/CNumberParser.hxx"
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <list>
+
 static void
 ReadResultTag(UPnPDirContent &dirbuf, const UpnpActionResponse &response)
 {
@@ -18,7 +25,7 @@ ReadResultTag(UPnPDirContent &dirbuf, const UpnpActionResponse &response)
 	dirbuf.Parse(p);
 }
 
-inline void
+void
 ContentDirectoryService::readDirSlice(UpnpClient_Handle hdl,
 				      const char *objectId, unsigned offset,
 				      unsigned count, UPnPDirContent &dirbuf,
@@ -53,15 +60,124 @@ UPnPDirContent
 ContentDirectoryService::readDir(UpnpClient_Handle handle,
 				 const char *objectId) const
 {
-	UPnPDirContent dirbuf;
-	unsigned offset = 0, total = -1, count;
+	return readDir(handle, objectId, 0, nullptr);
+}
 
-	do {
-		readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
-			     count, total);
+namespace {
+
+/**
+ * Reads a range of a container's children in a #WorkerPool thread.
+ */
+class ReadDirSliceJob final : public WorkerJob {
+	const ContentDirectoryService &service;
+	const UpnpClient_Handle handle;
+	const char *const object_id;
+	const unsigned begin, end, count;
+
+	Mutex &mutex;
+	Cond &cond;
+	unsigned &pending;
+
+public:
+	UPnPDirContent result;
+	std::exception_ptr error;
+
+	ReadDirSliceJob(const ContentDirectoryService &_service,
+			UpnpClient_Handle _handle, const char *_object_id,
+			unsigned _begin, unsigned _end, unsigned _count,
+			Mutex &_mutex, Cond &_cond, unsigned &_pending) noexcept
+		:service(_service), handle(_handle), object_id(_object_id),
+		 begin(_begin), end(_end), count(_count),
+		 mutex(_mutex), cond(_cond), pending(_pending) {}
+
+	/* virtual methods from class WorkerJob */
+	void Run() noexcept override {
+		try {
+			/* the server may return fewer entries than
+			   requested; keep asking until the range is
+			   complete */
+			unsigned offset = begin, total = end, didread;
+			do {
+				service.readDirSlice(handle, object_id,
+						     offset,
+						     std::min(count, end - offset),
+						     result, didread, total);
+				offset += didread;
+			} while (didread > 0 && offset < std::min(end, total));
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		const std::scoped_lock lock{mutex};
+		if (--pending == 0)
+			cond.notify_one();
+	}
+};
+
+} // anonymous namespace
 
-		offset += count;
-	} while (count > 0 && offset < total);
+UPnPDirContent
+ContentDirectoryService::readDir(UpnpClient_Handle handle,
+				 const char *objectId,
+				 unsigned count, WorkerPool *pool) const
+{
+	if (count == 0)
+		count = m_rdreqcnt;
+
+	UPnPDirContent dirbuf;
+	unsigned offset = 0, total = -1, didread;
+
+	readDirSlice(handle, objectId, offset, count, dirbuf,
+		     didread, total);
+	offset += didread;
+
+	if (pool != nullptr && didread > 0 && offset < total &&
+	    /* without "TotalMatches", we don't know how many
+	       slices there are */
+	    total != unsigned(-1)) {
+		/* the server may have a lower limit than the one we
+		   requested; use its slice size for the remaining
+		   requests */
+		count = didread;
+
+		Mutex mutex;
+		Cond cond;
+		unsigned pending = 0;
+
+		std::list<ReadDirSliceJob> jobs;
+		for (unsigned begin = offset; begin < total; begin += count) {
+			const unsigned end = std::min(total - begin, count) + begin;
+			jobs.emplace_back(*this, handle, objectId,
+					  begin, end, count,
+					  mutex, cond, pending);
+			++pending;
+		}
+
+		for (auto &job : jobs)
+			pool->Push(job, WorkerPriority::HIGH);
+
+		{
+			std::unique_lock lock{mutex};
+			cond.wait(lock, [&pending]{ return pending == 0; });
+		}
+
+		for (auto &job : jobs) {
+			if (job.error)
+				std::rethrow_exception(job.error);
+
+			std::move(job.result.objects.begin(),
+				  job.result.objects.end(),
+				  std::back_inserter(dirbuf.objects));
+		}
+
+		return dirbuf;
+	}
+
+	while (didread > 0 && offset < total) {
+		readDirSlice(handle, objectId, offset, count, dirbuf,
+			     didread, total);
+		offset += didread;
+	}
 
 	return dirbuf;
 }
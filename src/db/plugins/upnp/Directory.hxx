@@ -30,6 +30,15 @@ public:
 		return nullptr;
 	}
 
+	[[gnu::pure]]
+	const UPnPDirObject *FindObject(std::string_view name) const noexcept {
+		for (const auto &o : objects)
+			if (o.name == name)
+				return &o;
+
+		return nullptr;
+	}
+
 	/**
 	 * Parse from DIDL-Lite XML data.
 	 *
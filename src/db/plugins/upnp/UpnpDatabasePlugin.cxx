@@ -4,6 +4,7 @@
 #include "UpnpDatabasePlugin.hxx"
 #include "Directory.hxx"
 #include "Tags.hxx"
+#include "Cache.hxx"
 #include "lib/upnp/ClientInit.hxx"
 #include "lib/upnp/Discovery.hxx"
 #include "lib/upnp/ContentDirectoryService.hxx"
@@ -23,10 +24,14 @@
 #include "util/RecursiveMap.hxx"
 #include "util/StringSplit.hxx"
 #include "config/Block.hxx"
+#include "thread/WorkerPool.hxx"
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <cassert>
+#include <list>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -61,10 +66,10 @@ class UpnpSong : UpnpSongData, public LightSong {
 
 public:
 	template<typename U>
-	UpnpSong(UPnPDirObject &&object, U &&_uri) noexcept
-		:UpnpSongData(std::forward<U>(_uri), std::move(object.tag)),
+	UpnpSong(const UPnPDirObject &object, U &&_uri) noexcept
+		:UpnpSongData(std::forward<U>(_uri), object.tag),
 		 LightSong(UpnpSongData::uri.c_str(), UpnpSongData::tag),
-		 real_uri2(std::move(object.url)) {
+		 real_uri2(object.url) {
 		real_uri = real_uri2.c_str();
 	}
 };
@@ -76,16 +81,72 @@ class UpnpDatabase : public Database {
 
 	const char* iface;
 
+	/**
+	 * The "RequestedCount" of "Browse" actions; 0 means the
+	 * device-specific default.
+	 */
+	const unsigned browse_count;
+
+	/**
+	 * The number of threads in #browse_pool; 0 disables parallel
+	 * "Browse" requests and prefetching.
+	 */
+	const unsigned browse_threads;
+
+	mutable UpnpDirCache cache;
+
+	/**
+	 * Fetches slices of large containers concurrently, and
+	 * prefetches child containers in the background.
+	 */
+	mutable WorkerPool browse_pool{"upnp_browse"};
+
+	/**
+	 * Reads one container into the #cache in a #browse_pool
+	 * thread.
+	 */
+	class PrefetchJob final : public WorkerJob {
+		const UpnpDatabase &db;
+
+	public:
+		const ContentDirectoryService server;
+		const std::string id;
+
+		PrefetchJob(const UpnpDatabase &_db,
+			    const ContentDirectoryService &_server,
+			    std::string_view _id) noexcept
+			:db(_db), server(_server), id(_id) {}
+
+		/* virtual methods from class WorkerJob */
+		void Run() noexcept override;
+	};
+
+	/**
+	 * Protects #prefetch_jobs.
+	 */
+	mutable Mutex prefetch_mutex;
+
+	/**
+	 * Pending and running #PrefetchJob instances.  Each one
+	 * removes itself when it has finished.
+	 */
+	mutable std::list<PrefetchJob> prefetch_jobs;
+
+	/**
+	 * Prefetch at most this number of child containers of each
+	 * directory listed by a client.
+	 */
+	static constexpr std::size_t MAX_PREFETCH_CHILDREN = 16;
+
+	static constexpr std::size_t MAX_PREFETCH_JOBS = 64;
+
 public:
-	explicit UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block) noexcept
-		:Database(upnp_db_plugin),
-		 event_loop(_event_loop),
-		 iface(block.GetBlockValue("interface", nullptr)) {}
+	UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block);
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
 				  DatabaseListener &listener,
-				  const ConfigBlock &block) noexcept;
+				  const ConfigBlock &block);
 
 	void Open() override;
 	void Close() noexcept override;
@@ -123,18 +184,38 @@ private:
 			 const DatabaseSelection &selection,
 			 const VisitSong& visit_song) const;
 
-	UPnPDirContent SearchSongs(const ContentDirectoryService &server,
-				   const char *objid,
-				   const DatabaseSelection &selection) const;
+	std::shared_ptr<const UPnPDirContent> SearchSongs(const ContentDirectoryService &server,
+							  const char *objid,
+							  const DatabaseSelection &selection) const;
 
-	UPnPDirObject Namei(const ContentDirectoryService &server,
-			    std::string_view uri) const;
+	std::shared_ptr<const UPnPDirObject> Namei(const ContentDirectoryService &server,
+						   std::string_view uri) const;
 
 	/**
 	 * Take server and objid, return metadata.
 	 */
-	UPnPDirObject ReadNode(const ContentDirectoryService &server,
-			       const char *objid) const;
+	std::shared_ptr<const UPnPDirObject> ReadNode(const ContentDirectoryService &server,
+						      const char *objid) const;
+
+	/**
+	 * Read all children of a container, either from the #cache
+	 * or from the server.
+	 *
+	 * @param parallel read the slices concurrently in
+	 * #browse_pool?  Must be false in #browse_pool threads.
+	 */
+	std::shared_ptr<const UPnPDirContent> ReadDir(const ContentDirectoryService &server,
+						      const char *objid,
+						      bool parallel=true) const;
+
+	/**
+	 * Schedule #PrefetchJob instances for the child containers
+	 * of the given directory which are not yet in the #cache.
+	 */
+	void Prefetch(const ContentDirectoryService &server,
+		      const UPnPDirContent &contents) const noexcept;
+
+	void OnPrefetchFinished(const PrefetchJob &job) const noexcept;
 
 	/**
 	 * Get the path for an object Id. This works much like pwd,
@@ -145,17 +226,31 @@ private:
 			      const UPnPDirObject& dirent) const;
 };
 
+UpnpDatabase::UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block)
+	:Database(upnp_db_plugin),
+	 event_loop(_event_loop),
+	 iface(block.GetBlockValue("interface", nullptr)),
+	 browse_count(block.GetBlockValue("browse_count", 0U)),
+	 browse_threads(block.GetBlockValue("browse_threads", 4U)),
+	 cache(block.GetDuration("cache_ttl", std::chrono::seconds(0),
+				 std::chrono::minutes(5)))
+{
+}
+
 DatabasePtr
 UpnpDatabase::Create(EventLoop &, EventLoop &io_event_loop,
 		     [[maybe_unused]] DatabaseListener &listener,
-		     const ConfigBlock &block) noexcept
+		     const ConfigBlock &block)
 {
-	return std::make_unique<UpnpDatabase>(io_event_loop, block);;
+	return std::make_unique<UpnpDatabase>(io_event_loop, block);
 }
 
 void
 UpnpDatabase::Open()
 {
+	if (browse_threads > 0)
+		browse_pool.Start(browse_threads);
+
 	handle = UpnpClientGlobalInit(iface);
 
 	discovery = new UPnPDeviceDirectory(event_loop, handle);
@@ -164,6 +259,7 @@ UpnpDatabase::Open()
 	} catch (...) {
 		delete discovery;
 		UpnpClientGlobalFinish();
+		browse_pool.Stop();
 		throw;
 	}
 }
@@ -171,6 +267,11 @@ UpnpDatabase::Open()
 void
 UpnpDatabase::Close() noexcept
 {
+	/* wait for running prefetch jobs and discard the others
+	   before their server handle goes away */
+	browse_pool.Stop();
+	prefetch_jobs.clear();
+
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
@@ -196,7 +297,7 @@ UpnpDatabase::GetSong(std::string_view uri) const
 
 	auto server = discovery->GetServer(server_name);
 
-	UPnPDirObject dirent;
+	std::shared_ptr<const UPnPDirObject> dirent;
 	if (const auto id = AfterRootIdSegment(uri_in_server);
 	    id.data() == nullptr) {
 		dirent = Namei(server, uri_in_server);
@@ -204,7 +305,7 @@ UpnpDatabase::GetSong(std::string_view uri) const
 		dirent = ReadNode(server, std::string{id}.c_str());
 	}
 
-	return new UpnpSong(std::move(dirent), uri);
+	return new UpnpSong(*dirent, uri);
 }
 
 /**
@@ -231,18 +332,18 @@ dquote(std::string &out, const char *in) noexcept
 
 // Run an UPnP search, according to MPD parameters. Return results as
 // UPnP items
-UPnPDirContent
+std::shared_ptr<const UPnPDirContent>
 UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 			  const char *objid,
 			  const DatabaseSelection &selection) const
 {
 	const SongFilter *filter = selection.filter;
 	if (selection.filter == nullptr)
-		return {};
+		return nullptr;
 
 	const auto searchcaps = server.getSearchCapabilities(handle);
 	if (searchcaps.empty())
-		return {};
+		return nullptr;
 
 	std::string cond;
 	for (const auto &item : filter->GetItems()) {
@@ -299,7 +400,12 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 		// TODO: support other ISongFilter implementations
 	}
 
-	return server.search(handle, objid, cond.c_str());
+	auto result = std::make_shared<const UPnPDirContent>(server.search(handle, objid, cond.c_str()));
+
+	/* remember the metadata of all results, because clients
+	   usually add some of them to the queue next */
+	cache.PutObjects(server, result);
+	return result;
 }
 
 static void
@@ -339,7 +445,10 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 		return;
 
 	const auto content = SearchSongs(server, objid, selection);
-	for (auto &dirent : content.objects) {
+	if (content == nullptr)
+		return;
+
+	for (const auto &dirent : content->objects) {
 		if (dirent.type != UPnPDirObject::Type::ITEM ||
 		    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
 			continue;
@@ -367,15 +476,84 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	}
 }
 
-UPnPDirObject
+std::shared_ptr<const UPnPDirObject>
 UpnpDatabase::ReadNode(const ContentDirectoryService &server,
 		       const char *objid) const
 {
-	auto dirbuf = server.getMetadata(handle, objid);
-	if (dirbuf.objects.size() != 1)
+	if (auto object = cache.GetObject(server, objid))
+		return object;
+
+	auto dirbuf = std::make_shared<const UPnPDirContent>(server.getMetadata(handle, objid));
+	if (dirbuf->objects.size() != 1)
 		throw std::runtime_error("Bad resource");
 
-	return std::move(dirbuf.objects.front());
+	std::shared_ptr<const UPnPDirObject> object{dirbuf, &dirbuf->objects.front()};
+	cache.PutObject(server, object);
+	return object;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid, bool parallel) const
+{
+	if (auto contents = cache.GetDirectory(server, objid))
+		return contents;
+
+	auto contents = std::make_shared<const UPnPDirContent>(server.readDir(handle, objid, browse_count,
+									      parallel && browse_threads > 0
+									      ? &browse_pool
+									      : nullptr));
+	cache.PutDirectory(server, objid, contents);
+	return contents;
+}
+
+void
+UpnpDatabase::PrefetchJob::Run() noexcept
+{
+	try {
+		db.ReadDir(server, id.c_str(), false);
+	} catch (...) {
+		/* ignore; the client will see this error if it
+		   really asks for this container */
+	}
+
+	/* this deletes the object */
+	db.OnPrefetchFinished(*this);
+}
+
+void
+UpnpDatabase::Prefetch(const ContentDirectoryService &server,
+		       const UPnPDirContent &contents) const noexcept
+{
+	if (browse_threads == 0 || !cache.IsEnabled())
+		return;
+
+	const std::scoped_lock lock{prefetch_mutex};
+
+	std::size_t n = 0;
+	for (const auto &i : contents.objects) {
+		if (i.type != UPnPDirObject::Type::CONTAINER)
+			continue;
+
+		if (n++ >= MAX_PREFETCH_CHILDREN ||
+		    prefetch_jobs.size() >= MAX_PREFETCH_JOBS)
+			break;
+
+		if (cache.HasDirectory(server, i.id) ||
+		    std::any_of(prefetch_jobs.begin(), prefetch_jobs.end(),
+				[&i](const auto &job){ return job.id == i.id; }))
+			continue;
+
+		auto &job = prefetch_jobs.emplace_back(*this, server, i.id);
+		browse_pool.Push(job, WorkerPriority::LOW);
+	}
+}
+
+void
+UpnpDatabase::OnPrefetchFinished(const PrefetchJob &job) const noexcept
+{
+	const std::scoped_lock lock{prefetch_mutex};
+	prefetch_jobs.remove_if([&job](const auto &i){ return &i == &job; });
 }
 
 std::string
@@ -384,21 +562,22 @@ UpnpDatabase::BuildPath(const ContentDirectoryService &server,
 {
 	const char *pid = idirent.id.c_str();
 	std::string path;
+	std::shared_ptr<const UPnPDirObject> dirent;
 	while (strcmp(pid, rootid) != 0) {
-		auto dirent = ReadNode(server, pid);
-		pid = dirent.parent_id.c_str();
+		dirent = ReadNode(server, pid);
+		pid = dirent->parent_id.c_str();
 
 		if (path.empty())
-			path = dirent.name;
+			path = dirent->name;
 		else
-			path = PathTraitsUTF8::Build(dirent.name, path);
+			path = PathTraitsUTF8::Build(dirent->name, path);
 	}
 
 	return PathTraitsUTF8::Build(server.GetFriendlyName(), path);
 }
 
 // Take server and internal title pathname and return objid and metadata.
-UPnPDirObject
+std::shared_ptr<const UPnPDirObject>
 UpnpDatabase::Namei(const ContentDirectoryService &server,
 		    std::string_view uri) const
 {
@@ -406,29 +585,32 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 		// looking for root info
 		return ReadNode(server, rootid);
 
-	std::string objid(rootid_sv);
+	/* this owns the string #objid points to */
+	std::shared_ptr<const UPnPDirContent> parent;
+	const char *objid = rootid;
 
 	// Walk the path elements, read each directory and try to find the next one
 	while (true) {
-		auto dirbuf = server.readDir(handle, objid.c_str());
+		auto dirbuf = ReadDir(server, objid);
 
 		const auto [name, rest] = Split(uri, '/');
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(name);
+		const UPnPDirObject *child = dirbuf->FindObject(name);
 		if (child == nullptr)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "No such object");
 
 		uri = rest;
 		if (uri.empty())
-			return std::move(*child);
+			return {std::move(dirbuf), child};
 
 		if (child->type != UPnPDirObject::Type::CONTAINER)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "Not a container");
 
-		objid = std::move(child->id);
+		objid = child->id.c_str();
+		parent = std::move(dirbuf);
 	}
 }
 
@@ -509,16 +691,16 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 
 	if (const auto id = AfterRootIdSegment(uri); id.data() != nullptr) {
 		if (visit_song) {
-			auto dirent = ReadNode(server, std::string{id}.c_str());
+			const auto dirent = ReadNode(server, std::string{id}.c_str());
 
-			if (dirent.type != UPnPDirObject::Type::ITEM ||
-			    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
+			if (dirent->type != UPnPDirObject::Type::ITEM ||
+			    dirent->item_class != UPnPDirObject::ItemClass::MUSIC)
 				throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 						    "Not found");
 
 			std::string path = songPath(server.GetFriendlyName(),
-						    dirent.id);
-			visitSong(dirent, path.c_str(),
+						    dirent->id);
+			visitSong(*dirent, path.c_str(),
 				  selection, visit_song);
 		}
 
@@ -533,7 +715,7 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	   recursion (1-deep) here, which will handle the "add dir"
 	   case. */
 	if (selection.recursive && selection.filter) {
-		SearchSongs(server, tdirent.id.c_str(), selection, visit_song);
+		SearchSongs(server, tdirent->id.c_str(), selection, visit_song);
 		return;
 	}
 
@@ -541,8 +723,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 		? server.GetFriendlyName().c_str()
 		: selection.uri.c_str();
 
-	if (tdirent.type == UPnPDirObject::Type::ITEM) {
-		VisitItem(tdirent, base_uri,
+	if (tdirent->type == UPnPDirObject::Type::ITEM) {
+		VisitItem(*tdirent, base_uri,
 			  selection,
 			  visit_song, visit_playlist);
 		return;
@@ -551,8 +733,13 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	const auto contents = server.readDir(handle, tdirent.id.c_str());
-	for (const auto &dirent : contents.objects) {
+	const auto contents = ReadDir(server, tdirent->id.c_str());
+
+	/* the client will probably descend into one of the
+	   sub directories next */
+	Prefetch(server, *contents);
+
+	for (const auto &dirent : contents->objects) {
 		const std::string child_uri = PathTraitsUTF8::Build(base_uri,
 								    dirent.name.c_str());
 		VisitObject(dirent, child_uri.c_str(),
@@ -78,7 +78,10 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 					  directory.GetPath(), name);
 			}
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			if (song->UpdateFileInArchive(archive)) {
+				const ScopeDatabaseLock protect;
+				directory.MarkModified();
+			} else {
 				FmtDebug(update_domain,
 					 "deleting unrecognized file {}/{}",
 					 directory.GetPath(), name);
@@ -4,9 +4,31 @@
 #include "Config.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
+#include "config/Parser.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 
 UpdateConfig::UpdateConfig(const ConfigData &config)
 {
+	threads = config.GetPositive(ConfigOption::UPDATE_THREADS,
+				     DEFAULT_THREADS);
+	if (threads > MAX_THREADS)
+		throw FmtRuntimeError("update_threads is too large (maximum {})",
+				      MAX_THREADS);
+
+	max_read_rate = config.With(ConfigOption::UPDATE_MAX_READ_RATE, [](const char *s){
+		return s != nullptr ? ParseSize(s) : std::size_t{0};
+	});
+
+	max_iops = config.GetUnsigned(ConfigOption::UPDATE_MAX_IOPS, 0);
+
+	yield_to_playback =
+		config.GetBool(ConfigOption::UPDATE_YIELD_TO_PLAYBACK,
+			       DEFAULT_YIELD_TO_PLAYBACK);
+
+	trust_directory_mtime =
+		config.GetBool(ConfigOption::UPDATE_TRUST_DIRECTORY_MTIME,
+			       false);
+
 #ifndef _WIN32
 	follow_inside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_INSIDE_SYMLINKS,
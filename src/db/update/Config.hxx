@@ -4,9 +4,48 @@
 #ifndef MPD_UPDATE_CONFIG_HXX
 #define MPD_UPDATE_CONFIG_HXX
 
+#include <cstddef>
+
 struct ConfigData;
 
 struct UpdateConfig {
+	static constexpr unsigned DEFAULT_THREADS = 1;
+	static constexpr unsigned MAX_THREADS = 64;
+
+	/**
+	 * The number of threads which scan song files.  If this is
+	 * 1, then all files are scanned by the update thread.
+	 */
+	unsigned threads = DEFAULT_THREADS;
+
+	/**
+	 * The maximum number of bytes per second which may be read
+	 * while scanning song files; 0 means no limit.
+	 */
+	std::size_t max_read_rate = 0;
+
+	/**
+	 * The maximum number of directory listings and song file
+	 * scans per second; 0 means no limit.
+	 */
+	unsigned max_iops = 0;
+
+	static constexpr bool DEFAULT_YIELD_TO_PLAYBACK = true;
+
+	/**
+	 * Pause the update while the player is running out of
+	 * decoded data?
+	 */
+	bool yield_to_playback = DEFAULT_YIELD_TO_PLAYBACK;
+
+	/**
+	 * Skip the files of directories whose modification time (and
+	 * inode) has not changed since the last update?  Their
+	 * subdirectories are still visited.  This misses files which
+	 * were modified in place.
+	 */
+	bool trust_directory_mtime = false;
+
 #ifndef _WIN32
 	static constexpr bool DEFAULT_FOLLOW_INSIDE_SYMLINKS = true;
 	static constexpr bool DEFAULT_FOLLOW_OUTSIDE_SYMLINKS = true;
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "Walk.hxx"
+#include "ScanBatch.hxx"
 #include "UpdateDomain.hxx"
 #include "song/DetachedSong.hxx"
 #include "db/DatabaseLock.hxx"
@@ -14,8 +15,30 @@
 #include "storage/FileInfo.hxx"
 #include "Log.hxx"
 
+void
+UpdateWalk::AddContainerSongs(Directory &contdir,
+			      std::forward_list<DetachedSong> &&tracks,
+			      const StorageFileInfo &info) noexcept
+{
+	for (auto &vtrack : tracks) {
+		auto song = std::make_unique<Song>(std::move(vtrack),
+						   contdir);
+
+		// shouldn't be necessary but it's there..
+		song->mtime = info.mtime;
+
+		FmtNotice(update_domain, "added {}/{}",
+			  contdir.GetPath(),
+			  song->filename);
+
+		contdir.AddSong(std::move(song));
+
+		modified = true;
+	}
+}
+
 bool
-UpdateWalk::UpdateContainerFile(Directory &directory,
+UpdateWalk::UpdateContainerFile(Directory &directory, Song *song,
 				std::string_view name, std::string_view suffix,
 				const StorageFileInfo &info) noexcept
 {
@@ -26,6 +49,22 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		return false;
 	const DecoderPlugin &plugin = *_plugin;
 
+	if (scan_batch != nullptr && &scan_batch->directory == &directory) {
+		{
+			const ScopeDatabaseLock protect;
+			if (IsVirtualDirectoryUnmodified(directory, name, info,
+							 DEVICE_CONTAINER))
+				return true;
+		}
+
+		/* the worker thread opens the file only once: it
+		   falls back to scanning a plain song file if this
+		   is not a container; FlushScanBatch() creates the
+		   virtual directory */
+		scan_batch->Add(name, info, song, &plugin);
+		return true;
+	}
+
 	Directory *contdir;
 	{
 		const ScopeDatabaseLock protect;
@@ -52,24 +91,8 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 			return false;
 		}
 
-		for (auto &vtrack : v) {
-			auto song = std::make_unique<Song>(std::move(vtrack),
-							   *contdir);
-
-			// shouldn't be necessary but it's there..
-			song->mtime = info.mtime;
-
-			FmtNotice(update_domain, "added {}/{}",
-				  contdir->GetPath(),
-				  song->filename);
-
-			{
-				const ScopeDatabaseLock protect;
-				contdir->AddSong(std::move(song));
-			}
-
-			modified = true;
-		}
+		const ScopeDatabaseLock protect;
+		AddContainerSongs(*contdir, std::move(v), info);
 	} catch (...) {
 		LogError(std::current_exception());
 		editor.LockDeleteDirectory(contdir);
@@ -91,7 +91,8 @@ DatabaseEditor::DeleteNameIn(Directory &parent, std::string_view name)
 		modified = true;
 	}
 
-	parent.playlists.erase(name);
+	if (parent.playlists.erase(name))
+		parent.MarkModified();
 
 	return modified;
 }
@@ -18,11 +18,22 @@
 #ifdef HAVE_CLASS_GLOB
 
 inline void
-ExcludeList::ParseLine(char *line) noexcept
+ExcludeList::ParseLine(char *line)
 {
 	char *p = Strip(line);
-	if (*p != 0 && *p != '#')
-		patterns.emplace_front(p);
+	if (*p == 0 || *p == '#')
+		return;
+
+	if (!own_patterns) {
+		/* copy the parent's patterns, so Check() needs to
+		   look at only one GlobSet */
+		own_patterns = patterns != nullptr
+			? std::make_unique<GlobSet>(*patterns)
+			: std::make_unique<GlobSet>();
+		patterns = own_patterns.get();
+	}
+
+	own_patterns->Add(p);
 }
 
 #endif
@@ -52,18 +63,12 @@ ExcludeList::Check(Path name_fs) const noexcept
 	/* XXX include full path name in check */
 
 #ifdef HAVE_CLASS_GLOB
-	if (parent != nullptr) {
-		if (parent->Check(name_fs)) {
-			return true;
-		}
-	}
+	if (patterns == nullptr)
+		return false;
 
-	for (const auto &i : patterns) {
-		try {
-			if (i.Check(NarrowPath(name_fs).c_str()))
-				return true;
-		} catch (...) {
-		}
+	try {
+		return patterns->Check(NarrowPath(name_fs).c_str());
+	} catch (...) {
 	}
 #else
 	/* not implemented */
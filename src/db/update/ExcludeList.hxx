@@ -9,34 +9,47 @@
 #ifndef MPD_EXCLUDE_H
 #define MPD_EXCLUDE_H
 
-#include "fs/Glob.hxx"
+#include "fs/GlobSet.hxx"
 #include "input/Ptr.hxx"
 #include "config.h"
 
 #ifdef HAVE_CLASS_GLOB
-#include <forward_list>
+#include <memory>
 #endif
 
 class Path;
 
 class ExcludeList {
-	const ExcludeList *const parent;
-
 #ifdef HAVE_CLASS_GLOB
-	std::forward_list<Glob> patterns;
+	/**
+	 * The patterns of this list and all of its parents, compiled
+	 * into one #GlobSet.  This is only set if this list has
+	 * patterns of its own.
+	 */
+	std::unique_ptr<GlobSet> own_patterns;
+
+	/**
+	 * The #GlobSet which is checked: either #own_patterns or the
+	 * one inherited from the parent (which must outlive this
+	 * object).  nullptr if there are no patterns at all.
+	 */
+	const GlobSet *patterns = nullptr;
 #endif
 
 public:
-	ExcludeList() noexcept
-		:parent(nullptr) {}
+	ExcludeList() noexcept = default;
 
+#ifdef HAVE_CLASS_GLOB
 	ExcludeList(const ExcludeList &_parent) noexcept
-		:parent(&_parent) {}
+		:patterns(_parent.patterns) {}
+#else
+	ExcludeList(const ExcludeList &) noexcept {}
+#endif
 
 	[[gnu::pure]]
 	bool IsEmpty() const noexcept {
 #ifdef HAVE_CLASS_GLOB
-		return ((parent == nullptr) || parent->IsEmpty()) && patterns.empty();
+		return patterns == nullptr;
 #else
 		/* not implemented */
 		return true;
@@ -54,10 +67,11 @@ public:
 	 * Checks whether one of the patterns in the .mpdignore file matches
 	 * the specified file name.
 	 */
+	[[gnu::pure]]
 	bool Check(Path name_fs) const noexcept;
 
 private:
-	void ParseLine(char *line) noexcept;
+	void ParseLine(char *line);
 };
 
 
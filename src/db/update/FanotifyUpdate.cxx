@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FanotifyUpdate.hxx"
+#include "InotifyDomain.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
+#include "io/Open.hxx"
+#include "system/Error.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/fanotify.h>
+
+static constexpr uint64_t FAN_MASK =
+	FAN_CLOSE_WRITE|FAN_CREATE|FAN_DELETE|FAN_MOVED_FROM|FAN_MOVED_TO
+	|FAN_ONDIR;
+
+/**
+ * Build the path of a file descriptor's link in /proc.
+ */
+static AllocatedPath
+ProcFdPath(FileDescriptor fd) noexcept
+{
+	return AllocatedPath::FromFS(fmt::format("/proc/self/fd/{}",
+						 fd.Get()));
+}
+
+FanotifyUpdate::FanotifyUpdate(EventLoop &loop, UpdateService &update,
+			       AllocatedPath &&_root)
+	:event(loop, BIND_THIS_METHOD(OnReady)),
+	 queue(loop, update),
+	 root(std::move(_root))
+{
+	int fd = fanotify_init(FAN_CLASS_NOTIF|FAN_REPORT_DFID_NAME|
+			       FAN_CLOEXEC|FAN_NONBLOCK,
+			       O_RDONLY|O_CLOEXEC|O_LARGEFILE);
+	if (fd < 0)
+		throw MakeErrno("fanotify_init() failed");
+
+	event.Open(FileDescriptor{fd});
+
+	/* one mark for the whole file system instead of one watch
+	   per directory */
+	if (fanotify_mark(fd, FAN_MARK_ADD|FAN_MARK_FILESYSTEM,
+			  FAN_MASK, AT_FDCWD, root.c_str()) < 0) {
+		event.Close();
+		throw MakeErrno("fanotify_mark() failed");
+	}
+
+	mount_fd = OpenPath(root.c_str(), O_DIRECTORY);
+
+	event.ScheduleRead();
+}
+
+FanotifyUpdate::~FanotifyUpdate() noexcept
+{
+	event.Close();
+}
+
+const std::string *
+FanotifyUpdate::LookupDirectory(const struct file_handle &handle) noexcept
+{
+	std::string key(reinterpret_cast<const char *>(&handle),
+			sizeof(handle) + handle.handle_bytes);
+
+	if (auto i = uri_cache.find(key); i != uri_cache.end())
+		return i->second ? &*i->second : nullptr;
+
+	if (uri_cache.size() >= MAX_CACHE_SIZE)
+		uri_cache.clear();
+
+	/* open_by_handle_at() wants a non-const pointer */
+	auto *h = reinterpret_cast<struct file_handle *>(key.data());
+
+	std::optional<std::string> uri;
+
+	if (UniqueFileDescriptor fd{open_by_handle_at(mount_fd.Get(), h,
+						       O_PATH)};
+	    fd.IsDefined()) {
+		const auto path = ReadLink(ProcFdPath(fd));
+		if (!path.IsNull()) {
+			const auto *relative = root.Relative(path);
+			if (relative != nullptr) {
+				uri = Path::FromFS(relative).ToUTF8();
+				if (uri->empty() && *relative != 0)
+					/* not representable in UTF-8 */
+					uri.reset();
+			}
+		}
+	} else if (errno == ESTALE)
+		/* the directory has already been deleted; don't
+		   cache this, the handle will not be seen again */
+		return nullptr;
+
+	auto &value = uri_cache.emplace(std::move(key), std::move(uri))
+		.first->second;
+	return value ? &*value : nullptr;
+}
+
+void
+FanotifyUpdate::OnReady(unsigned) noexcept
+{
+	alignas(struct fanotify_event_metadata)
+		std::array<std::byte, 16384> buffer;
+
+	while (true) {
+		ssize_t nbytes = event.GetFileDescriptor().Read(buffer);
+		if (nbytes <= 0) {
+			if (nbytes < 0 && errno != EAGAIN && errno != EINTR)
+				LogError(std::make_exception_ptr(MakeErrno("Failed to read from fanotify")));
+			return;
+		}
+
+		const auto *meta =
+			reinterpret_cast<const struct fanotify_event_metadata *>(buffer.data());
+		std::size_t length = nbytes;
+
+		for (; FAN_EVENT_OK(meta, length);
+		     meta = FAN_EVENT_NEXT(meta, length)) {
+			if (meta->vers != FANOTIFY_METADATA_VERSION)
+				continue;
+
+			if (meta->mask & FAN_Q_OVERFLOW) {
+				/* events were lost: rescan everything */
+				uri_cache.clear();
+				queue.Enqueue("");
+				continue;
+			}
+
+			const auto *info =
+				reinterpret_cast<const struct fanotify_event_info_fid *>(meta + 1);
+			if (meta->event_len < sizeof(*meta) + sizeof(*info) ||
+			    info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+				continue;
+
+			const auto &handle =
+				*reinterpret_cast<const struct file_handle *>(info->handle);
+
+			const auto *uri = LookupDirectory(handle);
+			if (uri == nullptr)
+				/* outside of the music directory */
+				continue;
+
+			queue.Enqueue(uri->c_str());
+
+			if ((meta->mask & FAN_ONDIR) != 0 &&
+			    (meta->mask & (FAN_DELETE|FAN_MOVED_FROM)) != 0)
+				/* a directory has been deleted or
+				   moved away: the cached URIs of its
+				   descendants are stale now */
+				uri_cache.clear();
+		}
+	}
+}
+
+std::unique_ptr<FanotifyUpdate>
+mpd_fanotify_init(EventLoop &loop, Storage &storage, UpdateService &update)
+{
+	LogDebug(inotify_domain, "initializing fanotify");
+
+	const auto path = storage.MapFS("");
+	if (path.IsNull()) {
+		LogDebug(inotify_domain, "no music directory configured");
+		return {};
+	}
+
+	/* resolve symlinks, because that is what the /proc/self/fd
+	   links of the event handles will contain */
+	auto root = ReadLink(ProcFdPath(OpenPath(path.c_str(), O_DIRECTORY)));
+	if (root.IsNull())
+		root = path;
+
+	auto fu = std::make_unique<FanotifyUpdate>(loop, update,
+						   std::move(root));
+
+	LogDebug(inotify_domain, "watching music directory with fanotify");
+
+	return fu;
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_FANOTIFY_UPDATE_HXX
+#define MPD_FANOTIFY_UPDATE_HXX
+
+#include "InotifyQueue.hxx"
+#include "event/PipeEvent.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+struct file_handle;
+class Storage;
+
+/**
+ * Watches the music directory with one fanotify mark on the whole
+ * file system (FAN_REPORT_DFID_NAME).  Unlike #InotifyUpdate, this
+ * needs no per-directory watches, so it neither runs into the
+ * "max_user_watches" limit nor takes long to start on large trees.
+ * It requires CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH.
+ *
+ * Each event names the parent directory of the changed file, which is
+ * then passed to #InotifyQueue; that way, a burst of changes results
+ * in one update per directory.
+ */
+class FanotifyUpdate final {
+	/**
+	 * Resolving a file handle to a path is expensive, so the
+	 * results are cached; when the cache reaches this size, it is
+	 * cleared.
+	 */
+	static constexpr std::size_t MAX_CACHE_SIZE = 16384;
+
+	PipeEvent event;
+	InotifyQueue queue;
+
+	/**
+	 * The music directory, with all symlinks resolved.
+	 */
+	const AllocatedPath root;
+
+	/**
+	 * An O_PATH descriptor of #root for open_by_handle_at().
+	 */
+	UniqueFileDescriptor mount_fd;
+
+	/**
+	 * Maps the raw file handles of directories to their URIs
+	 * relative to #root; std::nullopt means the directory is
+	 * outside of the music directory.
+	 */
+	std::unordered_map<std::string, std::optional<std::string>> uri_cache;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	FanotifyUpdate(EventLoop &loop, UpdateService &update,
+		       AllocatedPath &&_root);
+	~FanotifyUpdate() noexcept;
+
+private:
+	/**
+	 * Determine the URI of the directory with the given file
+	 * handle.
+	 *
+	 * @return the URI or nullptr if the directory is outside the
+	 * music directory (or cannot be resolved)
+	 */
+	const std::string *LookupDirectory(const struct file_handle &handle) noexcept;
+
+	void OnReady(unsigned) noexcept;
+};
+
+/**
+ * Throws on error.
+ */
+std::unique_ptr<FanotifyUpdate>
+mpd_fanotify_init(EventLoop &loop, Storage &storage, UpdateService &update);
+
+#endif
@@ -109,8 +109,10 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		directory.MarkModified();
 		modified = true;
+	}
 
 	return true;
 }
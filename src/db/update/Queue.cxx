@@ -14,6 +14,16 @@ UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
 	return true;
 }
 
+bool
+UpdateQueue::Push(UpdateQueueItem &&item) noexcept
+{
+	if (update_queue.size() >= MAX_UPDATE_QUEUE_SIZE)
+		return false;
+
+	update_queue.emplace_back(std::move(item));
+	return true;
+}
+
 UpdateQueueItem
 UpdateQueue::Pop() noexcept
 {
@@ -7,6 +7,7 @@
 #include <string>
 #include <string_view>
 #include <list>
+#include <vector>
 
 class SimpleDatabase;
 class Storage;
@@ -16,6 +17,14 @@ struct UpdateQueueItem {
 	Storage *storage;
 
 	std::string path_utf8;
+
+	/**
+	 * If not empty, then only these URIs (relative to the
+	 * #storage) are updated, without walking their siblings, and
+	 * #path_utf8 is ignored.  See UpdateService::EnqueueUris().
+	 */
+	std::vector<std::string> uris;
+
 	unsigned id;
 	bool discard;
 
@@ -46,6 +55,8 @@ public:
 	bool Push(SimpleDatabase &db, Storage &storage,
 		  std::string_view path, bool discard, unsigned id) noexcept;
 
+	bool Push(UpdateQueueItem &&item) noexcept;
+
 	UpdateQueueItem Pop() noexcept;
 
 	void Clear() noexcept {
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ScanBatch.hxx"
+#include "Throttle.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Log.hxx"
+
+#include <cassert>
+
+inline void
+UpdateScanBatch::Job::ScanContainer() noexcept
+{
+	assert(container_plugin != nullptr);
+
+	const auto path_fs = batch.storage.MapChildFS(batch.directory.GetPath(),
+						      name);
+	if (path_fs.IsNull())
+		/* not a local file: the container API supports
+		   only local files */
+		return;
+
+	try {
+		container_tracks = container_plugin->container_scan(path_fs);
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+void
+UpdateScanBatch::Job::Run() noexcept
+{
+	try {
+		const UpdateThrottle::Scope throttle_scope{batch.throttle};
+
+		if (container_plugin != nullptr)
+			ScanContainer();
+
+		/* if this is not a container, scan it as a plain
+		   song file right away, without submitting another
+		   job */
+		if (container_tracks.empty())
+			result = Song::LoadFile(batch.storage, name, info,
+						batch.directory);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	finished = true;
+	batch.OnJobFinished();
+}
+
+void
+UpdateScanBatch::Add(std::string_view name, const StorageFileInfo &info,
+		     Song *song,
+		     const DecoderPlugin *container_plugin) noexcept
+{
+	auto &job = jobs.emplace_back(*this, name, info, song,
+				      container_plugin);
+
+	{
+		const std::scoped_lock lock{mutex};
+		++pending;
+	}
+
+	pool.Push(job);
+}
+
+void
+UpdateScanBatch::Cancel() noexcept
+{
+	unsigned n = 0;
+	for (auto &job : jobs)
+		if (pool.Cancel(job))
+			++n;
+
+	if (n > 0) {
+		const std::scoped_lock lock{mutex};
+		pending -= n;
+	}
+
+	cond.notify_all();
+}
+
+void
+UpdateScanBatch::Wait() noexcept
+{
+	std::unique_lock lock{mutex};
+	cond.wait(lock, [this]{ return pending == 0; });
+}
+
+inline void
+UpdateScanBatch::OnJobFinished() noexcept
+{
+	const std::scoped_lock lock{mutex};
+	if (--pending == 0)
+		cond.notify_all();
+}
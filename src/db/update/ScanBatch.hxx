@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_UPDATE_SCAN_BATCH_HXX
+#define MPD_UPDATE_SCAN_BATCH_HXX
+
+#include "db/plugins/simple/Ptr.hxx"
+#include "song/DetachedSong.hxx"
+#include "storage/FileInfo.hxx"
+#include "thread/WorkerPool.hxx"
+
+#include <exception>
+#include <forward_list>
+#include <list>
+#include <string>
+#include <string_view>
+
+struct Directory;
+struct Song;
+struct DecoderPlugin;
+class Storage;
+class UpdateThrottle;
+
+/**
+ * A list of song files in one #Directory whose tags are being
+ * scanned by a #WorkerPool.  After all jobs have finished, the
+ * update thread merges the results into the #Directory
+ * (see UpdateWalk::FlushScanBatch()).
+ */
+class UpdateScanBatch final {
+public:
+	class Job final : public WorkerJob {
+		friend class UpdateScanBatch;
+
+		UpdateScanBatch &batch;
+
+	public:
+		const std::string name;
+
+		const StorageFileInfo info;
+
+		/**
+		 * The existing #Song object which shall be updated
+		 * or nullptr if this is a new file.  The update
+		 * thread owns this pointer; the worker thread does
+		 * not touch it.
+		 */
+		Song *const song;
+
+		/**
+		 * If not nullptr, then the file is first scanned as a
+		 * container with this plugin.
+		 */
+		const DecoderPlugin *const container_plugin;
+
+		/**
+		 * The tracks of the container; if this is empty,
+		 * then the file is not a container, and it was
+		 * scanned as a plain song file.
+		 */
+		std::forward_list<DetachedSong> container_tracks;
+
+		/**
+		 * The newly loaded #Song object; nullptr if the
+		 * file was not recognized.
+		 */
+		SongPtr result;
+
+		std::exception_ptr error;
+
+		/**
+		 * Has Run() finished?  If not, the job was canceled.
+		 */
+		bool finished = false;
+
+		Job(UpdateScanBatch &_batch, std::string_view _name,
+		    const StorageFileInfo &_info, Song *_song,
+		    const DecoderPlugin *_container_plugin) noexcept
+			:batch(_batch), name(_name), info(_info), song(_song),
+			 container_plugin(_container_plugin) {}
+
+	private:
+		void ScanContainer() noexcept;
+
+	public:
+
+		/* virtual methods from class WorkerJob */
+		void Run() noexcept override;
+	};
+
+private:
+	WorkerPool &pool;
+	UpdateThrottle &throttle;
+	Storage &storage;
+
+public:
+	Directory &directory;
+
+private:
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The number of jobs which have not yet finished.  Protected
+	 * by #mutex.
+	 */
+	unsigned pending = 0;
+
+	/**
+	 * All jobs in the order they were submitted.  A std::list
+	 * is used because #WorkerPool keeps pointers to its
+	 * elements.
+	 */
+	std::list<Job> jobs;
+
+public:
+	UpdateScanBatch(WorkerPool &_pool, UpdateThrottle &_throttle,
+			Storage &_storage, Directory &_directory) noexcept
+		:pool(_pool), throttle(_throttle),
+		 storage(_storage), directory(_directory) {}
+
+	~UpdateScanBatch() noexcept {
+		Cancel();
+		Wait();
+	}
+
+	UpdateScanBatch(const UpdateScanBatch &) = delete;
+	UpdateScanBatch &operator=(const UpdateScanBatch &) = delete;
+
+	bool empty() const noexcept {
+		return jobs.empty();
+	}
+
+	/**
+	 * Submit a new file to the #WorkerPool.
+	 */
+	void Add(std::string_view name, const StorageFileInfo &info,
+		 Song *song,
+		 const DecoderPlugin *container_plugin=nullptr) noexcept;
+
+	/**
+	 * Remove all jobs from the #WorkerPool queue which have not
+	 * been started yet.
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * Wait until all jobs have finished (or were canceled).
+	 */
+	void Wait() noexcept;
+
+	auto begin() noexcept {
+		return jobs.begin();
+	}
+
+	auto end() noexcept {
+		return jobs.end();
+	}
+
+	void clear() noexcept {
+		jobs.clear();
+	}
+
+private:
+	void OnJobFinished() noexcept;
+};
+
+#endif
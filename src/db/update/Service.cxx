@@ -15,17 +15,21 @@
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
 #include "thread/Util.hxx"
+#include "config/ThreadConfig.hxx"
 
 #ifndef NDEBUG
 #include "event/Loop.hxx"
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <stdexcept>
+#include <vector>
 
 UpdateService::UpdateService(const ConfigData &_config,
 			     EventLoop &_loop, SimpleDatabase &_db,
 			     CompositeStorage &_storage,
-			     DatabaseListener &_listener) noexcept
+			     DatabaseListener &_listener)
 	:config(_config),
 	 defer(_loop, BIND_THIS_METHOD(RunDeferred)),
 	 db(_db), storage(_storage),
@@ -96,15 +100,35 @@ UpdateService::Task() noexcept
 
 	SetThreadName("update");
 
-	if (!next.path_utf8.empty())
+	if (!next.uris.empty())
+		FmtDebug(update_domain, "starting: {} URIs", next.uris.size());
+	else if (!next.path_utf8.empty())
 		FmtDebug(update_domain, "starting: {}", next.path_utf8);
 	else
 		LogDebug(update_domain, "starting");
 
 	SetThreadIdlePriority();
 
-	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
-			      next.discard);
+	try {
+		GetThreadScheduling("update").Apply(false);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to apply update thread scheduling settings");
+	}
+
+	/* a mounted database which is loaded on demand must not be
+	   unloaded while it is being updated */
+	const SimpleDatabase::ScopePin pin{*next.db};
+
+	/* the tag index would refer to stale song objects while the
+	   tree is being modified; queries are served by walking the
+	   tree until it is rebuilt */
+	next.db->InvalidateTagIndex();
+
+	modified = next.uris.empty()
+		? walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
+			     next.discard)
+		: walk->WalkUris(next.db->GetRoot(), std::move(next.uris));
 
 	if (modified || !next.db->FileExists()) {
 		try {
@@ -115,6 +139,8 @@ UpdateService::Task() noexcept
 		}
 	}
 
+	next.db->RebuildTagIndex();
+
 	if (!next.path_utf8.empty())
 		FmtDebug(update_domain, "finished: {}", next.path_utf8);
 	else
@@ -150,13 +176,9 @@ UpdateService::GenerateId() noexcept
 	return id;
 }
 
-unsigned
-UpdateService::Enqueue(std::string_view path, bool discard)
+std::pair<SimpleDatabase *, Storage *>
+UpdateService::Resolve(std::string_view &path)
 {
-	assert(GetEventLoop().IsInside());
-
-	/* determine which (mounted) database will be updated and what
-	   storage will be scanned */
 	SimpleDatabase *db2;
 	Storage *storage2;
 
@@ -193,9 +215,15 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 		   happen */
 		throw std::runtime_error("No storage at this path");
 
+	return {db2, storage2};
+}
+
+unsigned
+UpdateService::Enqueue(UpdateQueueItem &&item)
+{
 	if (walk != nullptr) {
-		const unsigned id = GenerateId();
-		if (!queue.Push(*db2, *storage2, path, discard, id))
+		const unsigned id = item.id = GenerateId();
+		if (!queue.Push(std::move(item)))
 			throw ProtocolError(ACK_ERROR_UPDATE_ALREADY,
 					    "Update queue is full");
 
@@ -203,14 +231,58 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 		return id;
 	}
 
-	const unsigned id = update_task_id = GenerateId();
-	StartThread(UpdateQueueItem(*db2, *storage2, path, discard, id));
+	const unsigned id = update_task_id = item.id = GenerateId();
+	StartThread(std::move(item));
 
 	idle_add(IDLE_UPDATE);
 
 	return id;
 }
 
+unsigned
+UpdateService::Enqueue(std::string_view path, bool discard)
+{
+	assert(GetEventLoop().IsInside());
+
+	const auto [db2, storage2] = Resolve(path);
+	return Enqueue(UpdateQueueItem(*db2, *storage2, path, discard, 0));
+}
+
+unsigned
+UpdateService::EnqueueUris(std::span<const char *const> uris)
+{
+	assert(GetEventLoop().IsInside());
+	assert(!uris.empty());
+
+	/* one job per (mounted) database */
+	std::vector<UpdateQueueItem> items;
+
+	for (const char *uri : uris) {
+		std::string_view path = uri;
+		const auto [db2, storage2] = Resolve(path);
+		if (path.empty())
+			throw ProtocolError(ACK_ERROR_ARG,
+					    "Cannot update a mount point this way");
+
+		auto i = std::find_if(items.begin(), items.end(),
+				      [db2, storage2](const auto &item){
+					      return item.db == db2 &&
+						      item.storage == storage2;
+				      });
+		if (i == items.end())
+			i = items.emplace(items.end(), *db2, *storage2,
+					  std::string_view{}, false, 0);
+
+		i->uris.emplace_back(path);
+	}
+
+	unsigned id = 0;
+	for (auto &item : items)
+		id = Enqueue(std::move(item));
+
+	return id;
+}
+
 /**
  * Called in the main thread after the database update is finished.
  */
@@ -10,11 +10,14 @@
 #include "thread/Thread.hxx"
 
 #include <memory>
+#include <span>
 #include <string_view>
+#include <utility>
 
 class SimpleDatabase;
 class DatabaseListener;
 class UpdateWalk;
+class Storage;
 class CompositeStorage;
 
 /**
@@ -45,10 +48,13 @@ class UpdateService final {
 	std::unique_ptr<UpdateWalk> walk;
 
 public:
+	/**
+	 * Throws on configuration error.
+	 */
 	UpdateService(const ConfigData &_config,
 		      EventLoop &_loop, SimpleDatabase &_db,
 		      CompositeStorage &_storage,
-		      DatabaseListener &_listener) noexcept;
+		      DatabaseListener &_listener);
 
 	~UpdateService() noexcept;
 
@@ -75,6 +81,23 @@ public:
 	 */
 	unsigned Enqueue(std::string_view path, bool discard);
 
+	/**
+	 * Add a list of songs and directories to the database update
+	 * queue.  Each one is added, rescanned (if modified) or
+	 * removed, depending on its state in the storage, but their
+	 * siblings are not visited.  This is meant for external tools
+	 * which know exactly which files have changed; all URIs are
+	 * handled by one job (per mounted database), so the database
+	 * is saved and idle events are emitted only once.
+	 *
+	 * Throws on error
+	 *
+	 * @param uris a non-empty list of URIs relative to the music
+	 * directory
+	 * @return the job id
+	 */
+	unsigned EnqueueUris(std::span<const char *const> uris);
+
 	/**
 	 * Clear the queue and cancel the current update.  Does not
 	 * wait for the thread to exit.
@@ -98,6 +121,26 @@ private:
 	void StartThread(UpdateQueueItem &&i);
 
 	unsigned GenerateId() noexcept;
+
+	/**
+	 * Determine which (mounted) database will be updated and
+	 * which storage will be scanned for the given path.
+	 *
+	 * Throws on error
+	 *
+	 * @param path the path relative to the music directory; it
+	 * is modified to be relative to the returned storage
+	 */
+	std::pair<SimpleDatabase *, Storage *> Resolve(std::string_view &path);
+
+	/**
+	 * Start the job or append it to the queue.
+	 *
+	 * Throws on error
+	 *
+	 * @return the job id
+	 */
+	unsigned Enqueue(UpdateQueueItem &&item);
 };
 
 #endif
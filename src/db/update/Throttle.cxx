@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Throttle.hxx"
+#include "Config.hxx"
+#include "db/DatabaseListener.hxx"
+
+#ifdef __linux__
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/CNumberParser.hxx"
+
+#include <array>
+#include <cstring>
+#endif
+
+#include <algorithm>
+#include <thread>
+
+using std::chrono::duration_cast;
+
+/**
+ * While waiting, check for cancellation and for the player's state
+ * at this interval.
+ */
+static constexpr std::chrono::milliseconds POLL_INTERVAL{100};
+
+void
+UpdateThrottle::SleepUntil(Clock::time_point t) const noexcept
+{
+	while (!cancel) {
+		const auto now = Clock::now();
+		if (now >= t)
+			break;
+
+		std::this_thread::sleep_for(std::min<Clock::duration>(t - now,
+								      POLL_INTERVAL));
+	}
+}
+
+void
+UpdateThrottle::Wait() noexcept
+{
+	if (config.yield_to_playback)
+		while (!cancel && listener.IsPlaybackStarving())
+			std::this_thread::sleep_for(POLL_INTERVAL);
+
+	if (config.max_iops == 0 && config.max_read_rate == 0)
+		return;
+
+	Clock::time_point until;
+
+	{
+		const std::scoped_lock lock{mutex};
+		const auto now = Clock::now();
+
+		until = std::max(next_op, now);
+
+		if (config.max_iops > 0)
+			next_op = until + Clock::duration{std::chrono::seconds{1}}
+				/ config.max_iops;
+
+		until = std::max(until, next_byte);
+	}
+
+	SleepUntil(until);
+}
+
+inline void
+UpdateThrottle::ChargeBytes(uint_least64_t nbytes) noexcept
+{
+	if (nbytes == 0)
+		return;
+
+	const std::chrono::duration<double> seconds{
+		double(nbytes) / config.max_read_rate,
+	};
+	const auto cost = duration_cast<Clock::duration>(seconds);
+
+	const std::scoped_lock lock{mutex};
+	next_byte = std::max(next_byte, Clock::now()) + cost;
+}
+
+uint_least64_t
+UpdateThrottle::GetThreadReadBytes() const noexcept
+{
+	if (config.max_read_rate == 0)
+		return 0;
+
+#ifdef __linux__
+	/* this counts all read() system calls of this thread,
+	   including those made by decoder libraries which open the
+	   file by themselves */
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly("/proc/thread-self/io"))
+		return 0;
+
+	std::array<char, 512> buffer;
+	const auto dest = std::span{buffer}.first(buffer.size() - 1);
+	const auto nbytes = fd.Read(std::as_writable_bytes(dest));
+	if (nbytes <= 0)
+		return 0;
+
+	buffer[nbytes] = 0;
+
+	const char *p = std::strstr(buffer.data(), "rchar: ");
+	if (p == nullptr)
+		return 0;
+
+	return ParseUint64(p + 7);
+#else
+	return 0;
+#endif
+}
+
+UpdateThrottle::Scope::Scope(UpdateThrottle &_throttle) noexcept
+	:throttle(_throttle),
+	 start((throttle.Wait(), throttle.GetThreadReadBytes()))
+{
+}
+
+UpdateThrottle::Scope::~Scope() noexcept
+{
+	const auto end = throttle.GetThreadReadBytes();
+	if (end > start)
+		throttle.ChargeBytes(end - start);
+}
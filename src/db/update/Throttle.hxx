@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_UPDATE_THROTTLE_HXX
+#define MPD_UPDATE_THROTTLE_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct UpdateConfig;
+class DatabaseListener;
+
+/**
+ * Limits the I/O of a database update, so it does not starve
+ * playback (e.g. when both share the link to a NFS server).  Each
+ * directory listing and each song file scan counts as one operation
+ * (#UpdateConfig::max_iops); the bytes read by the thread which
+ * scans a song file are charged after the scan
+ * (#UpdateConfig::max_read_rate).  Additionally, the update pauses
+ * while the player is running out of decoded data
+ * (#UpdateConfig::yield_to_playback).
+ *
+ * This object is shared by the update thread and the scan worker
+ * threads.
+ */
+class UpdateThrottle final {
+	using Clock = std::chrono::steady_clock;
+
+	const UpdateConfig &config;
+
+	DatabaseListener &listener;
+
+	const std::atomic_bool &cancel;
+
+	Mutex mutex;
+
+	/**
+	 * The earliest time the next operation may start.  Protected
+	 * by #mutex.
+	 */
+	Clock::time_point next_op{};
+
+	/**
+	 * The time when all bytes read so far will have been "paid
+	 * for" at #UpdateConfig::max_read_rate.  Protected by
+	 * #mutex.
+	 */
+	Clock::time_point next_byte{};
+
+public:
+	UpdateThrottle(const UpdateConfig &_config,
+		       DatabaseListener &_listener,
+		       const std::atomic_bool &_cancel) noexcept
+		:config(_config), listener(_listener), cancel(_cancel) {}
+
+	UpdateThrottle(const UpdateThrottle &) = delete;
+	UpdateThrottle &operator=(const UpdateThrottle &) = delete;
+
+	/**
+	 * Wait until one more operation is allowed.  Returns early if
+	 * the update gets canceled.
+	 */
+	void Wait() noexcept;
+
+	/**
+	 * Waits for an operation (in the constructor) and charges
+	 * the bytes read by the calling thread during the lifetime
+	 * of this object (in the destructor).
+	 */
+	class Scope {
+		UpdateThrottle &throttle;
+		const uint_least64_t start;
+
+	public:
+		explicit Scope(UpdateThrottle &_throttle) noexcept;
+		~Scope() noexcept;
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+	};
+
+private:
+	void ChargeBytes(uint_least64_t nbytes) noexcept;
+
+	/**
+	 * Sleep until the given time or until the update gets
+	 * canceled.
+	 */
+	void SleepUntil(Clock::time_point t) const noexcept;
+
+	/**
+	 * Returns the number of bytes read by the calling thread so
+	 * far, or 0 if that is unknown or if there is no bandwidth
+	 * limit.
+	 */
+	uint_least64_t GetThreadReadBytes() const noexcept;
+};
+
+#endif
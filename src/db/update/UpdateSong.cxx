@@ -3,6 +3,7 @@
 
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
+#include "ScanBatch.hxx"
 #include "UpdateDomain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "db/DatabaseLock.hxx"
@@ -33,16 +34,30 @@ try {
 	}
 
 	if (!(song != nullptr && info.mtime == song->mtime && !walk_discard) &&
-	    UpdateContainerFile(directory, name, suffix, info)) {
+	    UpdateContainerFile(directory, song, name, suffix, info)) {
 		return;
 	}
 
+	const bool async = scan_batch != nullptr &&
+		&scan_batch->directory == &directory;
+
 	if (song == nullptr) {
 		FmtDebug(update_domain, "reading {}/{}",
 			 directory.GetPath(), name);
 
-		auto new_song = Song::LoadFile(storage, name, info,
-					       directory);
+		if (async) {
+			scan_batch->Add(name, info, nullptr);
+			return;
+		}
+
+		SongPtr new_song;
+
+		{
+			const UpdateThrottle::Scope throttle_scope{throttle};
+			new_song = Song::LoadFile(storage, name, info,
+						  directory);
+		}
+
 		if (!new_song) {
 			FmtDebug(update_domain,
 				 "ignoring unrecognized file {}/{}",
@@ -64,9 +79,24 @@ try {
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FmtNotice(update_domain, "updating {}/{}",
 			  directory.GetPath(), name);
-		if (song->UpdateFile(storage, info))
+
+		if (async) {
+			scan_batch->Add(name, info, song);
+			return;
+		}
+
+		bool success;
+
+		{
+			const UpdateThrottle::Scope throttle_scope{throttle};
+			success = song->UpdateFile(storage, info);
+		}
+
+		if (success) {
+			const ScopeDatabaseLock protect;
 			song->mark = true;
-		else
+			directory.MarkModified();
+		} else
 			FmtDebug(update_domain,
 				 "deleting unrecognized file {}/{}",
 				 directory.GetPath(), name);
@@ -82,6 +112,83 @@ try {
 		 directory.GetPath(), name, std::current_exception());
 }
 
+void
+UpdateWalk::FlushScanBatch(UpdateScanBatch &batch) noexcept
+{
+	if (cancel)
+		batch.Cancel();
+
+	batch.Wait();
+
+	Directory &directory = batch.directory;
+	const auto now = std::chrono::system_clock::now();
+
+	const ScopeDatabaseLock protect;
+
+	for (auto &job : batch) {
+		if (!job.finished) {
+			/* canceled: keep the old song (if any) */
+			if (job.song != nullptr)
+				job.song->mark = true;
+			continue;
+		}
+
+		if (job.error) {
+			FmtError(update_domain,
+				 "error reading file {}/{}: {}",
+				 directory.GetPath(), job.name, job.error);
+			continue;
+		}
+
+		if (!job.container_tracks.empty()) {
+			/* the old #Song (if any) is not marked and
+			   will be purged */
+			Directory *contdir =
+				MakeVirtualDirectoryIfModified(directory, job.name,
+							       job.info,
+							       DEVICE_CONTAINER);
+			if (contdir != nullptr)
+				AddContainerSongs(*contdir,
+						  std::move(job.container_tracks),
+						  job.info);
+			continue;
+		}
+
+		if (job.song == nullptr) {
+			if (!job.result) {
+				FmtDebug(update_domain,
+					 "ignoring unrecognized file {}/{}",
+					 directory.GetPath(), job.name);
+				continue;
+			}
+
+			job.result->mark = true;
+			job.result->added = now;
+			directory.AddSong(std::move(job.result));
+
+			modified = true;
+			FmtNotice(update_domain, "added {}/{}",
+				  directory.GetPath(), job.name);
+		} else {
+			Song &song = *job.song;
+			if (job.result) {
+				song.tag = std::move(job.result->tag);
+				song.mtime = job.result->mtime;
+				song.audio_format = job.result->audio_format;
+				song.mark = true;
+				directory.MarkModified();
+			} else
+				FmtDebug(update_domain,
+					 "deleting unrecognized file {}/{}",
+					 directory.GetPath(), job.name);
+
+			modified = true;
+		}
+	}
+
+	batch.clear();
+}
+
 bool
 UpdateWalk::UpdateSongFile(Directory &directory,
 			   std::string_view name, std::string_view suffix,
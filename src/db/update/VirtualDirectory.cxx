@@ -6,26 +6,41 @@
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/FileInfo.hxx"
 
+bool
+UpdateWalk::IsVirtualDirectoryUnmodified(Directory &parent,
+					 std::string_view name,
+					 const StorageFileInfo &info,
+					 unsigned virtual_device) noexcept
+{
+	Directory *directory = parent.FindChild(name);
+	if (directory == nullptr)
+		return false;
+
+	if (directory->IsMount())
+		return true;
+
+	if (directory->mtime == info.mtime &&
+	    directory->device == virtual_device &&
+	    !walk_discard) {
+		directory->mark = true;
+		return true;
+	}
+
+	return false;
+}
+
 Directory *
 UpdateWalk::MakeVirtualDirectoryIfModified(Directory &parent, std::string_view name,
 					   const StorageFileInfo &info,
 					   unsigned virtual_device) noexcept
 {
+	if (IsVirtualDirectoryUnmodified(parent, name, info, virtual_device))
+		return nullptr;
+
 	Directory *directory = parent.FindChild(name);
 
-	// directory exists already
+	// directory exists already, but was modified
 	if (directory != nullptr) {
-		if (directory->IsMount())
-			return nullptr;
-
-		if (directory->mtime == info.mtime &&
-		    directory->device == virtual_device &&
-		    !walk_discard) {
-			/* not modified */
-			directory->mark = true;
-			return nullptr;
-		}
-
 		editor.DeleteDirectory(directory);
 		modified = true;
 	}
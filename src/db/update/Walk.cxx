@@ -4,6 +4,7 @@
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
 #include "Editor.hxx"
+#include "ScanBatch.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/Uri.hxx"
@@ -18,11 +19,15 @@
 #include "input/InputStream.hxx"
 #include "input/Error.hxx"
 #include "input/WaitReady.hxx"
+#include "thread/WorkerPool.hxx"
+#include "config/ThreadConfig.hxx"
+#include "time/ChronoUtil.hxx"
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 #include "util/UriExtract.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <exception>
@@ -36,13 +41,27 @@ UpdateWalk::UpdateWalk(const UpdateConfig &_config,
 		       Storage &_storage) noexcept
 	:config(_config), cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 editor(_loop, _listener),
+	 throttle(config, _listener, cancel)
 {
+	if (config.threads > 1) {
+		scan_pool = std::make_unique<WorkerPool>("update_scan", true);
+		scan_pool->SetScheduling(GetThreadScheduling("update"));
+	}
 }
 
+UpdateWalk::~UpdateWalk() noexcept = default;
+
 static void
 directory_set_stat(Directory &dir, const StorageFileInfo &info)
 {
+	if (dir.IsReallyAFile() && dir.device != info.device) {
+		/* a virtual directory has become a real one; this
+		   changes its saved "type" attribute */
+		const ScopeDatabaseLock protect;
+		dir.MarkModified();
+	}
+
 	dir.inode = info.inode;
 	dir.device = info.device;
 }
@@ -123,6 +142,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 		if (!i->mark) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			directory.MarkModified();
 		} else
 			++i;
 	}
@@ -331,6 +351,47 @@ LoadExcludeListOrLog(Storage &storage, const Directory &directory,
 	}
 }
 
+/**
+ * Has the given directory not been modified since the last update,
+ * according to its modification time and inode number?  This does
+ * not notice files which were modified in place.
+ */
+[[gnu::pure]]
+static bool
+IsUnmodifiedDirectory(const Directory &directory,
+		      const StorageFileInfo &info) noexcept
+{
+	if (IsNegative(directory.mtime) || directory.mtime != info.mtime)
+		return false;
+
+	/* the inode number is not stored in the database file, so
+	   it can only be checked after the first update */
+	return directory.inode == 0 ||
+		(directory.inode == info.inode &&
+		 directory.device == info.device);
+}
+
+inline void
+UpdateWalk::UpdateUnmodifiedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list) noexcept
+{
+	ExcludeList child_exclude_list(exclude_list);
+	LoadExcludeListOrLog(storage, directory, child_exclude_list);
+
+	directory.ForEachChildSafe([&](Directory &child){
+		if (cancel || child.IsMount() || child.IsReallyAFile())
+			return;
+
+		StorageFileInfo info;
+		if (!GetInfo(storage, child.GetPath(), info) ||
+		    !info.IsDirectory() ||
+		    !UpdateDirectory(child, child_exclude_list, info)) {
+			editor.LockDeleteDirectory(&child);
+			modified = true;
+		}
+	});
+}
+
 bool
 UpdateWalk::UpdateDirectory(Directory &directory,
 			    const ExcludeList &exclude_list,
@@ -338,10 +399,19 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 {
 	assert(info.IsDirectory());
 
+	if (trust_mtime && IsUnmodifiedDirectory(directory, info)) {
+		directory_set_stat(directory, info);
+		UpdateUnmodifiedDirectory(directory, exclude_list);
+		directory.mark = true;
+		return true;
+	}
+
 	directory_set_stat(directory, info);
 
 	std::unique_ptr<StorageDirectoryReader> reader;
 
+	throttle.Wait();
+
 	try {
 		reader = storage.OpenDirectory(directory.GetPath());
 	} catch (...) {
@@ -357,6 +427,14 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	UnmarkAllIn(directory);
 
+	std::unique_ptr<UpdateScanBatch> batch;
+	if (scan_pool && scan_pool->IsStarted())
+		batch = std::make_unique<UpdateScanBatch>(*scan_pool, throttle,
+							  storage, directory);
+
+	UpdateScanBatch *const old_batch = scan_batch;
+	scan_batch = batch.get();
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
@@ -382,9 +460,19 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
 	}
 
+	scan_batch = old_batch;
+
+	if (batch)
+		FlushScanBatch(*batch);
+
 	PurgeDeletedFromDirectory(directory);
 
-	directory.mtime = info.mtime;
+	if (directory.mtime != info.mtime) {
+		const ScopeDatabaseLock protect;
+		directory.mtime = info.mtime;
+		directory.MarkModified();
+	}
+
 	directory.mark = true;
 
 	return true;
@@ -479,37 +567,110 @@ LoadExcludeLists(Storage &storage, const Directory &directory) noexcept
 }
 
 inline void
-UpdateWalk::UpdateUri(Directory &root, const char *uri) noexcept
+UpdateWalk::UpdateUriIn(Directory &parent, const ExcludeList &exclude_list,
+			const char *uri) noexcept
 try {
-	Directory *parent = DirectoryMakeUriParentChecked(root, uri);
-	if (parent == nullptr)
-		return;
-
 	const char *name = PathTraitsUTF8::GetBase(uri);
 
-	if (SkipSymlink(parent, name)) {
-		modified |= editor.DeleteNameIn(*parent, name);
+	if (SkipSymlink(&parent, name)) {
+		modified |= editor.DeleteNameIn(parent, name);
 		return;
 	}
 
 	StorageFileInfo info;
 	if (!GetInfo(storage, uri, info)) {
-		modified |= editor.DeleteNameIn(*parent, name);
+		modified |= editor.DeleteNameIn(parent, name);
 		return;
 	}
 
-	const auto exclude_lists = LoadExcludeLists(storage, *parent);
-	UpdateDirectoryChild(*parent, exclude_lists.front(), name, info);
+	UpdateDirectoryChild(parent, exclude_list, name, info);
 } catch (...) {
 	LogError(std::current_exception());
 }
 
+inline void
+UpdateWalk::UpdateUri(Directory &root, const char *uri) noexcept
+{
+	Directory *parent = DirectoryMakeUriParentChecked(root, uri);
+	if (parent == nullptr)
+		return;
+
+	const auto exclude_lists = LoadExcludeLists(storage, *parent);
+	UpdateUriIn(*parent, exclude_lists.front(), uri);
+}
+
+inline void
+UpdateWalk::UpdateSiblingUris(Directory &root,
+			      std::span<const std::string> uris) noexcept
+{
+	Directory *parent = DirectoryMakeUriParentChecked(root,
+							  uris.front());
+	if (parent == nullptr)
+		return;
+
+	const auto exclude_lists = LoadExcludeLists(storage, *parent);
+
+	for (const auto &uri : uris) {
+		if (cancel)
+			break;
+
+		UpdateUriIn(*parent, exclude_lists.front(), uri.c_str());
+	}
+}
+
+/**
+ * Copy each Song::in_playlist to Song::mark (which is not needed
+ * anymore after the walk) to be able to find out later which of them
+ * have changed.
+ */
+static void
+SaveInPlaylist(Directory &directory) noexcept
+{
+	for (auto &child : directory.children)
+		SaveInPlaylist(child);
+
+	for (auto &song : directory.songs)
+		song.mark = song.in_playlist;
+}
+
+/**
+ * Mark all directories modified which contain a song whose
+ * Song::in_playlist was changed since SaveInPlaylist().
+ */
+static void
+MarkInPlaylistModified(Directory &directory) noexcept
+{
+	for (auto &child : directory.children)
+		MarkInPlaylistModified(child);
+
+	for (const auto &song : directory.songs) {
+		if (song.mark != song.in_playlist) {
+			directory.MarkModified();
+			break;
+		}
+	}
+}
+
+inline void
+UpdateWalk::FinishWalk(Directory &root) noexcept
+{
+	const ScopeDatabaseLock protect;
+	SaveInPlaylist(root);
+	root.ClearInPlaylist();
+	PurgeDanglingFromPlaylists(root);
+	MarkInPlaylistModified(root);
+}
+
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 {
 	walk_discard = discard;
 	modified = false;
 
+	/* an explicit update of a path always scans it */
+	trust_mtime = config.trust_directory_mtime && !discard &&
+		(path == nullptr || isRootDirectory(path));
+
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
@@ -525,14 +686,54 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 
 		ExcludeList exclude_list;
 
+		if (scan_pool) {
+			try {
+				scan_pool->Start(config.threads);
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to start update scan threads");
+			}
+		}
+
+		/* let remote storages fetch directory listings in
+		   the background */
+		storage.PrefetchTree("");
+
 		UpdateDirectory(root, exclude_list, info);
+
+		storage.CancelPrefetch();
+
+		if (scan_pool)
+			scan_pool->Stop();
 	}
 
-	{
-		const ScopeDatabaseLock protect;
-		root.ClearInPlaylist();
-		PurgeDanglingFromPlaylists(root);
+	FinishWalk(root);
+	return modified;
+}
+
+bool
+UpdateWalk::WalkUris(Directory &root, std::vector<std::string> &&uris) noexcept
+{
+	walk_discard = false;
+	modified = false;
+	trust_mtime = false;
+
+	/* sorting puts most siblings next to each other, so they
+	   can share one parent lookup */
+	std::sort(uris.begin(), uris.end());
+	uris.erase(std::unique(uris.begin(), uris.end()), uris.end());
+
+	for (auto i = uris.begin(), end = uris.end(); i != end && !cancel;) {
+		const auto parent = PathTraitsUTF8::GetParent(*i);
+		const auto next = std::find_if(std::next(i), end,
+					       [parent](const std::string &uri){
+						       return PathTraitsUTF8::GetParent(uri) != parent;
+					       });
+
+		UpdateSiblingUris(root, {i, next});
+		i = next;
 	}
 
+	FinishWalk(root);
 	return modified;
 }
@@ -6,19 +6,29 @@
 
 #include "Config.hxx"
 #include "Editor.hxx"
+#include "Throttle.hxx"
 #include "config.h"
 
 #include <atomic>
+#include <forward_list>
+#include <memory>
+#include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 struct StorageFileInfo;
 struct Directory;
+struct Song;
+class DetachedSong;
 struct ArchivePlugin;
 struct PlaylistPlugin;
 class SongEnumerator;
 class ArchiveFile;
 class Storage;
 class ExcludeList;
+class WorkerPool;
+class UpdateScanBatch;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
@@ -30,6 +40,12 @@ class UpdateWalk final {
 	bool walk_discard;
 	bool modified;
 
+	/**
+	 * Shall directories which appear unmodified be skipped in
+	 * this walk?  See UpdateConfig::trust_directory_mtime.
+	 */
+	bool trust_mtime;
+
 	/**
 	 * Set to true by the main thread when the update thread shall
 	 * cancel as quickly as possible.  Access to this flag is
@@ -41,11 +57,29 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	UpdateThrottle throttle;
+
+	/**
+	 * If #UpdateConfig::threads is larger than 1, then tags of
+	 * new and modified song files are scanned by these worker
+	 * threads.
+	 */
+	std::unique_ptr<WorkerPool> scan_pool;
+
+	/**
+	 * The batch of scan jobs for the #Directory which is
+	 * currently being visited by UpdateDirectory().  If nullptr,
+	 * then songs are scanned synchronously.
+	 */
+	UpdateScanBatch *scan_batch = nullptr;
+
 public:
 	UpdateWalk(const UpdateConfig &_config,
 		   EventLoop &_loop, DatabaseListener &_listener,
 		   Storage &_storage) noexcept;
 
+	~UpdateWalk() noexcept;
+
 	/**
 	 * Cancel the current update and quit the Walk() method as
 	 * soon as possible.
@@ -59,6 +93,16 @@ public:
 	 */
 	bool Walk(Directory &root, const char *path, bool discard) noexcept;
 
+	/**
+	 * Update only the given songs and directories: each one is
+	 * added, rescanned (if modified) or removed, depending on its
+	 * state in the #Storage.  Unlike Walk(), the siblings of
+	 * these URIs are not visited.
+	 *
+	 * Returns true if the database was modified.
+	 */
+	bool WalkUris(Directory &root, std::vector<std::string> &&uris) noexcept;
+
 private:
 	[[gnu::pure]]
 	bool SkipSymlink(const Directory *directory,
@@ -78,6 +122,13 @@ private:
 	 */
 	void PurgeDanglingFromPlaylists(Directory &directory) noexcept;
 
+	/**
+	 * Wait for all jobs in the given batch to finish and merge
+	 * the results into its #Directory.  This locks the database
+	 * only once for the whole batch.
+	 */
+	void FlushScanBatch(UpdateScanBatch &batch) noexcept;
+
 	void UpdateSongFile2(Directory &directory,
 			     std::string_view name, std::string_view suffix,
 			     const StorageFileInfo &info) noexcept;
@@ -86,10 +137,32 @@ private:
 			    std::string_view name, std::string_view suffix,
 			    const StorageFileInfo &info) noexcept;
 
-	bool UpdateContainerFile(Directory &directory,
+	/**
+	 * Check whether the file is a container (e.g. a chiptune
+	 * file with several sub-tunes) and add its tracks.  If a
+	 * #UpdateScanBatch for this #Directory exists, then the
+	 * container is scanned by a worker thread, which falls back
+	 * to scanning a plain song file in the same job.
+	 *
+	 * @param song the existing #Song object with this name or
+	 * nullptr
+	 * @return true if the file has been handled, false if the
+	 * caller shall scan it as a plain song file
+	 */
+	bool UpdateContainerFile(Directory &directory, Song *song,
 				 std::string_view name, std::string_view suffix,
 				 const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Add the tracks returned by DecoderPlugin::container_scan()
+	 * to the given (virtual) #Directory.
+	 *
+	 * The caller must lock the database.
+	 */
+	void AddContainerSongs(Directory &contdir,
+			       std::forward_list<DetachedSong> &&tracks,
+			       const StorageFileInfo &info) noexcept;
+
 
 #ifdef ENABLE_ARCHIVE
 	void UpdateArchiveTree(ArchiveFile &archive, Directory &parent,
@@ -136,6 +209,25 @@ private:
 			     const ExcludeList &exclude_list,
 			     const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Visit only the subdirectories of a #Directory which has
+	 * not been modified since the last update.
+	 */
+	void UpdateUnmodifiedDirectory(Directory &directory,
+				       const ExcludeList &exclude_list) noexcept;
+
+	/**
+	 * Check whether the specified virtual directory exists
+	 * already and is unmodified (or is a mount point); if yes,
+	 * then it is marked.
+	 *
+	 * The caller must lock the database.
+	 */
+	bool IsVirtualDirectoryUnmodified(Directory &parent,
+					  std::string_view name,
+					  const StorageFileInfo &info,
+					  unsigned virtual_device) noexcept;
+
 	/**
 	 * Create the specified directory object if it does not exist
 	 * already or if the #StorageFileInfo object indicates that it has been
@@ -164,7 +256,24 @@ private:
 	Directory *DirectoryMakeUriParentChecked(Directory &root,
 						 std::string_view uri) noexcept;
 
+	void UpdateUriIn(Directory &parent, const ExcludeList &exclude_list,
+			 const char *uri) noexcept;
+
 	void UpdateUri(Directory &root, const char *uri) noexcept;
+
+	/**
+	 * Update URIs which all have the same parent directory;
+	 * that directory is looked up and its exclude lists are
+	 * loaded only once.
+	 */
+	void UpdateSiblingUris(Directory &root,
+			       std::span<const std::string> uris) noexcept;
+
+	/**
+	 * Update the playlist references after songs have been
+	 * added or removed.
+	 */
+	void FinishWalk(Directory &root) noexcept;
 };
 
 #endif
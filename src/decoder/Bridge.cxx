@@ -5,6 +5,7 @@
 #include "DecoderAPI.hxx"
 #include "Domain.hxx"
 #include "Control.hxx"
+#include "Metrics.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "song/DetachedSong.hxx"
 #include "pcm/Convert.hxx"
@@ -18,14 +19,27 @@
 #include "input/cache/Manager.hxx"
 #include "input/cache/Stream.hxx"
 #include "fs/Path.hxx"
+#include "util/StringAPI.hxx"
 #include "util/StringBuffer.hxx"
 
 #include <cassert>
 #include <cmath>
+#include <limits>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <string.h>
 
+/**
+ * How long does ContinueAtEndTime() wait for the player thread to
+ * start the next song?
+ */
+static constexpr std::chrono::steady_clock::duration CONTINUE_TIMEOUT =
+	std::chrono::seconds{2};
+
+DecoderMetrics decoder_metrics;
+
 DecoderBridge::DecoderBridge(DecoderControl &_dc, bool _initial_seek_pending,
 			     bool _initial_seek_essential,
 			     std::unique_ptr<Tag> _tag) noexcept
@@ -39,6 +53,9 @@ DecoderBridge::~DecoderBridge() noexcept
 {
 	/* caller must flush the chunk */
 	assert(current_chunk == nullptr);
+
+	const auto busy = std::chrono::steady_clock::now() - start_time - wait_time;
+	decoder_metrics.busy_ns.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count());
 }
 
 InputStreamPtr
@@ -62,7 +79,7 @@ DecoderBridge::OpenLocal(Path path_fs, const char *uri_utf8)
 bool
 DecoderBridge::CheckCancelRead() const noexcept
 {
-	if (error)
+	if (error || sub_song_finished)
 		/* this translates to DecoderCommand::STOP */
 		return true;
 
@@ -86,8 +103,13 @@ DecoderBridge::CheckCancelRead() const noexcept
 static DecoderCommand
 NeedChunks(DecoderControl &dc, std::unique_lock<Mutex> &lock) noexcept
 {
-	if (dc.command == DecoderCommand::NONE)
+	if (dc.command == DecoderCommand::NONE) {
+		/* the pipe cannot grow any further; wake up the
+		   player, which may be waiting for more chunks than
+		   we can deliver */
+		dc.SignalChunks(std::numeric_limits<unsigned>::max());
 		dc.Wait(lock);
+	}
 
 	return dc.command;
 }
@@ -108,16 +130,25 @@ DecoderBridge::GetChunk() noexcept
 		return current_chunk.get();
 
 	do {
-		current_chunk = dc.buffer->Allocate();
+		/* with "latency_target", the pipe must not grow
+		   beyond DecoderControl::max_pipe_chunks */
+		if (dc.max_pipe_chunks == 0 ||
+		    dc.pipe->GetSize() < dc.max_pipe_chunks)
+			current_chunk = dc.buffer->Allocate();
+
 		if (current_chunk != nullptr) {
 			current_chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
 				current_chunk->replay_gain_info = replay_gain_info;
 
+			current_chunk->submit_time = std::chrono::steady_clock::now();
+
 			return current_chunk.get();
 		}
 
+		const auto wait_start = std::chrono::steady_clock::now();
 		cmd = LockNeedChunks(dc);
+		wait_time += std::chrono::steady_clock::now() - wait_start;
 	} while (cmd == DecoderCommand::NONE);
 
 	return nullptr;
@@ -132,11 +163,32 @@ DecoderBridge::FlushChunk() noexcept
 	assert(current_chunk != nullptr);
 
 	auto chunk = std::move(current_chunk);
-	if (!chunk->IsEmpty())
+	std::chrono::nanoseconds duration{};
+	if (!chunk->IsEmpty()) {
+		duration = dc.out_audio_format.SizeToTime<std::chrono::nanoseconds>(chunk->length);
+		decoder_metrics.audio_ns.Add(duration.count());
+
 		dc.pipe->Push(std::move(chunk));
+	}
+
+	const auto now = std::chrono::steady_clock::now();
 
 	const std::scoped_lock protect{dc.mutex};
-	dc.client_cond.notify_one();
+
+	const unsigned pipe_size = dc.pipe->GetSize();
+
+	if (duration > duration.zero()) {
+		auto &stats = dc.stats;
+		if (stats.first_chunk_time < stats.first_chunk_time.zero())
+			stats.first_chunk_time = now - stats.start;
+
+		stats.audio_time += duration;
+		stats.busy_time = now - stats.start - wait_time;
+		stats.UpdatePipeSize(pipe_size);
+	}
+
+	/* wake up the player only if it is waiting for this */
+	dc.SignalChunks(pipe_size);
 }
 
 bool
@@ -186,6 +238,9 @@ DecoderBridge::GetVirtualCommand() noexcept
 		/* an error has occurred: stop the decoder plugin */
 		return DecoderCommand::STOP;
 
+	if (sub_song_finished)
+		return DecoderCommand::STOP;
+
 	assert(dc.pipe != nullptr);
 
 	if (PrepareInitialSeek())
@@ -243,6 +298,111 @@ DecoderBridge::UpdateStreamTag(InputStream *is) noexcept
 	return true;
 }
 
+DecoderCommand
+DecoderBridge::SubmitStreamTag(InputStream *is) noexcept
+{
+	if (!UpdateStreamTag(is))
+		return DecoderCommand::NONE;
+
+	if (decoder_tag != nullptr)
+		/* merge with tag from decoder plugin */
+		return DoSendTag(Tag::Merge(*decoder_tag, *stream_tag));
+	else
+		/* send only the stream tag */
+		return DoSendTag(*stream_tag);
+}
+
+std::size_t
+DecoderBridge::ClipToEndTime(std::size_t frames,
+			     DecoderCommand &cmd) const noexcept
+{
+	if (!dc.end_time.IsPositive())
+		return frames;
+
+	/* enforce the given end time */
+
+	const auto end_frame =
+		dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
+	if (absolute_frame >= end_frame) {
+		cmd = DecoderCommand::STOP;
+		return 0;
+	}
+
+	const uint64_t remaining_frames = end_frame - absolute_frame;
+	if (frames >= remaining_frames) {
+		/* past the end of the range: truncate this data
+		   submission and stop the decoder */
+		cmd = DecoderCommand::STOP;
+		return remaining_frames;
+	}
+
+	return frames;
+}
+
+bool
+DecoderBridge::ContinueAtEndTime() noexcept
+{
+	assert(dc.end_time.IsPositive());
+	assert(!seeking);
+	assert(!initial_seek_running);
+
+	if (sub_song_finished || error)
+		return false;
+
+	sub_song_finished = true;
+
+	CheckFlushChunk();
+
+	std::unique_lock lock{dc.mutex};
+
+	if (dc.command != DecoderCommand::NONE)
+		/* let the plugin stop and leave this command to
+		   the decoder thread */
+		return false;
+
+	const std::string real_uri = dc.song->GetRealURI();
+	const SongTime end_time = dc.end_time;
+
+	/* this sub-song is finished; this lets the player thread
+	   start the next song, which may be the next sub-song of
+	   this file */
+	dc.state = DecoderState::STOP;
+	dc.client_cond.notify_one();
+
+	if (!dc.cond.wait_for(lock, CONTINUE_TIMEOUT, [this]{
+		return dc.command != DecoderCommand::NONE;
+	}))
+		return false;
+
+	if (dc.command != DecoderCommand::START ||
+	    !StringIsEqual(dc.song->GetRealURI(), real_uri.c_str()) ||
+	    dc.start_time != end_time)
+		/* some other song (or sub-song): this decoder
+		   can't handle it */
+		return false;
+
+	FmtDebug(decoder_domain, "continuing with the next sub-song of {:?}",
+		 real_uri);
+
+	/* do what DecoderControl::RunThread() does for the START
+	   command; the ReplayGain info remains valid, because the
+	   plugin will not submit it again */
+	dc.CycleMixRamp();
+	dc.replay_gain_prev_db = dc.replay_gain_db;
+
+	/* the sub-song tag will be sent with the next chunk */
+	song_tag = std::make_unique<Tag>(dc.song->GetTag());
+	stream_tag.reset();
+
+	/* the audio format is the same, and there is no need to seek
+	   to the start position: we're already there */
+	dc.state = DecoderState::DECODE;
+	dc.CommandFinishedLocked();
+
+	sub_song_finished = false;
+	return true;
+}
+
 void
 DecoderBridge::Ready(const AudioFormat audio_format,
 		     bool seekable, SignedSongTime duration) noexcept
@@ -405,16 +565,21 @@ try {
 
 	std::unique_lock lock{is.mutex};
 
-	while (true) {
-		if (CheckCancelRead())
-			return 0;
+	if (!is.IsAvailable() && !CheckCancelRead()) {
+		/* the InputStream has fallen behind; count this for
+		   DecoderStats */
+		const auto wait_start = std::chrono::steady_clock::now();
 
-		if (is.IsAvailable())
-			break;
+		while (!CheckCancelRead() && !is.IsAvailable())
+			dc.cond.wait(lock);
 
-		dc.cond.wait(lock);
+		++dc.stats.read_stalls;
+		dc.stats.read_stall_time += std::chrono::steady_clock::now() - wait_start;
 	}
 
+	if (CheckCancelRead())
+		return 0;
+
 	size_t nbytes = is.Read(lock, dest);
 	assert(nbytes > 0 || is.IsEOF());
 
@@ -453,42 +618,24 @@ DecoderBridge::SubmitAudio(InputStream *is,
 
 	/* send stream tags */
 
-	if (UpdateStreamTag(is)) {
-		if (decoder_tag != nullptr)
-			/* merge with tag from decoder plugin */
-			cmd = DoSendTag(Tag::Merge(*decoder_tag,
-						   *stream_tag));
-		else
-			/* send only the stream tag */
-			cmd = DoSendTag(*stream_tag);
-
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
-	}
-
-	cmd = DecoderCommand::NONE;
+	cmd = SubmitStreamTag(is);
+	if (cmd != DecoderCommand::NONE)
+		return cmd;
 
 	const size_t frame_size = dc.in_audio_format.GetFrameSize();
-	size_t data_frames = audio.size() / frame_size;
-
-	if (dc.end_time.IsPositive()) {
-		/* enforce the given end time */
+	const size_t data_frames = ClipToEndTime(audio.size() / frame_size,
+						 cmd);
+	if (data_frames == 0) {
+		if (cmd == DecoderCommand::STOP && ContinueAtEndTime())
+			return SubmitAudio(is, audio, kbit_rate);
 
-		const auto end_frame =
-			dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
-		if (absolute_frame >= end_frame)
-			return DecoderCommand::STOP;
-
-		const uint64_t remaining_frames = end_frame - absolute_frame;
-		if (data_frames >= remaining_frames) {
-			/* past the end of the range: truncate this
-			   data submission and stop the decoder */
-			data_frames = remaining_frames;
-			audio = audio.first(data_frames * frame_size);
-			cmd = DecoderCommand::STOP;
-		}
+		return cmd;
 	}
 
+	/* the part after the end of this sub-song */
+	const auto rest = audio.subspan(data_frames * frame_size);
+	audio = audio.first(data_frames * frame_size);
+
 	if (convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
 
@@ -546,9 +693,99 @@ DecoderBridge::SubmitAudio(InputStream *is,
 
 	absolute_frame += data_frames;
 
+	if (cmd == DecoderCommand::STOP && ContinueAtEndTime())
+		/* submit the rest to the next sub-song */
+		return SubmitAudio(is, rest, kbit_rate);
+
 	return cmd;
 }
 
+std::span<std::byte>
+DecoderBridge::GetAudioBuffer(InputStream *is, std::size_t min_size) noexcept
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	if (convert != nullptr)
+		/* the data needs to be converted before it can be
+		   written to a MusicChunk */
+		return {};
+
+	if (LockGetVirtualCommand() != DecoderCommand::NONE)
+		/* let SubmitAudio() handle the command */
+		return {};
+
+	if (SubmitStreamTag(is) != DecoderCommand::NONE)
+		return {};
+
+	while (true) {
+		auto *chunk = GetChunk();
+		if (chunk == nullptr)
+			return {};
+
+		/* the bit rate is set by CommitAudio() */
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     SongTime::Cast(timestamp) -
+				     dc.song->GetStartTime(),
+				     0);
+		if (!dest.empty() && dest.size() >= min_size)
+			return dest;
+
+		if (chunk->IsEmpty())
+			/* even an empty chunk is too small */
+			return {};
+
+		FlushChunk();
+	}
+}
+
+DecoderCommand
+DecoderBridge::CommitAudio(std::size_t nbytes, uint16_t kbit_rate) noexcept
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(convert == nullptr);
+	assert(current_chunk != nullptr);
+
+	const size_t frame_size = dc.out_audio_format.GetFrameSize();
+	assert(nbytes % frame_size == 0);
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+	const size_t data_frames = ClipToEndTime(nbytes / frame_size, cmd);
+
+	/* copy the part after the end of this sub-song before
+	   flushing the chunk, it may belong to the next one (see
+	   ContinueAtEndTime()) */
+	std::vector<std::byte> rest;
+	if (cmd == DecoderCommand::STOP) {
+		const std::byte *p = current_chunk->data + current_chunk->length;
+		rest.assign(p + data_frames * frame_size, p + nbytes);
+	}
+
+	nbytes = data_frames * frame_size;
+
+	if (nbytes > 0) {
+		if (current_chunk->length == 0)
+			current_chunk->bit_rate = kbit_rate;
+
+		if (current_chunk->Expand(dc.out_audio_format, nbytes))
+			/* the chunk is full, flush it */
+			FlushChunk();
+
+		timestamp += dc.out_audio_format.SizeToTime<FloatDuration>(nbytes);
+		absolute_frame += data_frames;
+	}
+
+	if (cmd == DecoderCommand::STOP && ContinueAtEndTime())
+		/* no conversion here, so the rest can be submitted
+		   to the next sub-song as-is */
+		return SubmitAudio(nullptr, rest, kbit_rate);
+
+	return cmd != DecoderCommand::NONE
+		? cmd
+		: LockGetVirtualCommand();
+}
+
 DecoderCommand
 DecoderBridge::SubmitTag(InputStream *is, Tag &&tag) noexcept
 {
@@ -7,6 +7,7 @@
 #include "tag/ReplayGainInfo.hxx"
 #include "MusicChunkPtr.hxx"
 
+#include <chrono>
 #include <cstddef>
 #include <exception>
 #include <memory>
@@ -43,6 +44,19 @@ private:
 	 */
 	uint64_t absolute_frame = 0;
 
+	/**
+	 * When was this object created?  Used for
+	 * #DecoderMetrics::busy_ns.
+	 */
+	const std::chrono::steady_clock::time_point start_time =
+		std::chrono::steady_clock::now();
+
+	/**
+	 * The total time spent waiting for free chunks in
+	 * GetChunk().
+	 */
+	std::chrono::steady_clock::duration wait_time{};
+
 	/**
 	 * Is the initial seek (to the start position of the sub-song)
 	 * pending, or has it been performed already?
@@ -68,6 +82,14 @@ private:
 	 */
 	bool seeking = false;
 
+	/**
+	 * The end of the sub-song (DecoderControl::end_time) has been
+	 * reached, and the decoder could not continue with the next
+	 * sub-song (see ContinueAtEndTime()).  From now on, the plugin
+	 * is asked to stop.
+	 */
+	bool sub_song_finished = false;
+
 	/**
 	 * The tag from the song object.  This is only used for local
 	 * files, because we expect the stream server to send us a new
@@ -165,6 +187,10 @@ public:
 	DecoderCommand SubmitAudio(InputStream *is,
 				   std::span<const std::byte> audio,
 				   uint16_t kbit_rate) noexcept override;
+	std::span<std::byte> GetAudioBuffer(InputStream *is,
+					    std::size_t min_size) noexcept override;
+	DecoderCommand CommitAudio(std::size_t nbytes,
+				   uint16_t kbit_rate) noexcept override;
 	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) noexcept override;
 	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) noexcept override;
 	void SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept override;
@@ -191,4 +217,35 @@ private:
 	DecoderCommand DoSendTag(const Tag &tag) noexcept;
 
 	bool UpdateStreamTag(InputStream *is) noexcept;
+
+	/**
+	 * Send the stream tag to the #MusicPipe if it has changed
+	 * (see UpdateStreamTag()).
+	 */
+	DecoderCommand SubmitStreamTag(InputStream *is) noexcept;
+
+	/**
+	 * Enforce DecoderControl::end_time: returns the number of
+	 * frames (out of the given number) which may still be
+	 * submitted, and sets #cmd to DecoderCommand::STOP if the
+	 * end has been reached.
+	 */
+	std::size_t ClipToEndTime(std::size_t frames,
+				  DecoderCommand &cmd) const noexcept;
+
+	/**
+	 * Called after the end of the sub-song has been reached.
+	 * Reports "finished" to the player thread and waits briefly
+	 * for its next command.  If that command starts the
+	 * following sub-song of the same file (e.g. the next track
+	 * of a CUE sheet), it is acknowledged right here, and the
+	 * plugin keeps decoding into the new #MusicPipe without
+	 * reopening and seeking the file.
+	 *
+	 * Caller must not lock the #DecoderControl object.
+	 *
+	 * @return true if decoding continues with the next sub-song,
+	 * false if the plugin shall stop
+	 */
+	bool ContinueAtEndTime() noexcept;
 };
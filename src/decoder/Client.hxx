@@ -141,6 +141,45 @@ public:
 		return SubmitAudio(is, audio_bytes, kbit_rate);
 	}
 
+	/**
+	 * Lend the decoder plugin a writable buffer inside the
+	 * #MusicBuffer, so it can decode straight into it instead of
+	 * copying its own buffer with SubmitAudio().  After writing,
+	 * the plugin calls CommitAudio(); it must not submit anything
+	 * else (audio, tags, ReplayGain, timestamps) in between.
+	 * Not committing at all discards the data.
+	 *
+	 * This is only possible if the decoder's audio format does
+	 * not need to be converted.  If it returns an empty span
+	 * (e.g. because a command is pending or because the client
+	 * does not support this), the plugin must fall back to
+	 * SubmitAudio().
+	 *
+	 * @param is an input stream which is buffering while we are
+	 * waiting for the player
+	 * @param min_size the minimum size the plugin needs; if the
+	 * current chunk has less room, a new one is started
+	 * @return a buffer whose size is a multiple of the frame size
+	 */
+	virtual std::span<std::byte> GetAudioBuffer([[maybe_unused]] InputStream *is,
+						    [[maybe_unused]] std::size_t min_size) noexcept {
+		return {};
+	}
+
+	/**
+	 * Submit data which was written to the buffer returned by
+	 * GetAudioBuffer().
+	 *
+	 * @param nbytes the number of bytes which were written (a
+	 * multiple of the frame size; may be zero)
+	 * @return the current command, or DecoderCommand::NONE if
+	 * there is no command pending
+	 */
+	virtual DecoderCommand CommitAudio([[maybe_unused]] std::size_t nbytes,
+					   [[maybe_unused]] uint16_t kbit_rate) noexcept {
+		return GetCommand();
+	}
+
 	/**
 	 * This function is called by the decoder plugin when it has
 	 * successfully decoded a tag.
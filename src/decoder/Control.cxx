@@ -3,19 +3,23 @@
 
 #include "Control.hxx"
 #include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
 #include "song/DetachedSong.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
 DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond,
 			       InputCacheManager *_input_cache,
 			       const AudioFormat _configured_audio_format,
-			       const ReplayGainConfig &_replay_gain_config) noexcept
+			       const ReplayGainConfig &_replay_gain_config,
+			       std::chrono::steady_clock::duration _latency_target) noexcept
 	:thread(BIND_THIS_METHOD(RunThread)),
 	 input_cache(_input_cache),
 	 mutex(_mutex), client_cond(_client_cond),
 	 configured_audio_format(_configured_audio_format),
+	 latency_target(_latency_target),
 	 replay_gain_config(_replay_gain_config) {}
 
 DecoderControl::~DecoderControl() noexcept
@@ -39,6 +43,16 @@ DecoderControl::SetReady(const AudioFormat audio_format,
 	seekable = _seekable;
 	total_time = _duration;
 
+	if (latency_target > std::chrono::steady_clock::duration::zero()) {
+		const std::size_t chunk_size = sizeof(MusicChunk::data);
+		const std::size_t n = (out_audio_format.TimeToSize(latency_target)
+				       + chunk_size - 1) / chunk_size;
+		/* at least two chunks: one being played and one
+		   being filled */
+		max_pipe_chunks = std::max<std::size_t>(n, 2);
+	} else
+		max_pipe_chunks = 0;
+
 	state = DecoderState::DECODE;
 	client_cond.notify_one();
 }
@@ -78,6 +92,12 @@ DecoderControl::Start(std::unique_lock<Mutex> &lock,
 	buffer = &_buffer;
 	pipe = std::move(_pipe);
 
+	if (!stats.uri.empty())
+		previous_stats = std::move(stats);
+	stats = {};
+	stats.uri = song->GetURI();
+	stats.start = DecoderStats::Clock::now();
+
 	ClearError();
 	SynchronousCommandLocked(lock, DecoderCommand::START);
 }
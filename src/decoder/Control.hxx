@@ -5,6 +5,7 @@
 #define MPD_DECODER_CONTROL_HXX
 
 #include "Command.hxx"
+#include "Stats.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "tag/MixRampInfo.hxx"
 #include "input/Handler.hxx"
@@ -16,6 +17,7 @@
 #include "ReplayGainMode.hxx"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #include <memory>
@@ -145,6 +147,35 @@ public:
 	/** the #MusicChunk allocator */
 	MusicBuffer *buffer;
 
+	/**
+	 * The "latency_target" setting (the #MusicPipe's share of
+	 * it); zero if disabled.
+	 */
+	const std::chrono::steady_clock::duration latency_target;
+
+	/**
+	 * The maximum number of chunks in the #pipe, derived from
+	 * #latency_target and #out_audio_format by SetReady(); zero
+	 * means no limit (other than the size of the #buffer).
+	 */
+	unsigned max_pipe_chunks = 0;
+
+	/**
+	 * While the client waits in WaitForDecoder(), this is the
+	 * number of chunks in the #pipe which is worth waking it up
+	 * for; zero if the client is not waiting for chunks.  This
+	 * avoids waking up the player thread for each chunk while it
+	 * is buffering or busy with something else.  Protected by
+	 * #mutex.
+	 */
+	unsigned client_wake_chunks = 0;
+
+	/**
+	 * Performance counters of the song currently being decoded,
+	 * and of the previous one.  Protected by #mutex.
+	 */
+	DecoderStats stats, previous_stats;
+
 	/**
 	 * The destination pipe for decoded chunks.  The caller thread
 	 * owns this object, and is responsible for freeing it.
@@ -168,7 +199,8 @@ public:
 	DecoderControl(Mutex &_mutex, Cond &_client_cond,
 		       InputCacheManager *_input_cache,
 		       const AudioFormat _configured_audio_format,
-		       const ReplayGainConfig &_replay_gain_config) noexcept;
+		       const ReplayGainConfig &_replay_gain_config,
+		       std::chrono::steady_clock::duration _latency_target) noexcept;
 	~DecoderControl() noexcept;
 
 	/**
@@ -203,9 +235,29 @@ public:
 	 * is only valid in the player thread.
 	 *
 	 * Caller must hold the lock.
+	 *
+	 * @param wake_chunks the decoder thread wakes up the caller
+	 * only after the #pipe has grown to this number of chunks (or
+	 * if it cannot grow any further); state changes and finished
+	 * commands always wake up the caller
 	 */
-	void WaitForDecoder(std::unique_lock<Mutex> &lock) noexcept {
+	void WaitForDecoder(std::unique_lock<Mutex> &lock,
+			    unsigned wake_chunks=1) noexcept {
+		client_wake_chunks = wake_chunks;
 		client_cond.wait(lock);
+		client_wake_chunks = 0;
+	}
+
+	/**
+	 * Wake up the client if it waits in WaitForDecoder() for
+	 * chunks and the #pipe has at least the given number of
+	 * chunks.
+	 *
+	 * Caller must hold the lock.
+	 */
+	void SignalChunks(unsigned pipe_size) noexcept {
+		if (client_wake_chunks > 0 && pipe_size >= client_wake_chunks)
+			client_cond.notify_one();
 	}
 
 	bool IsIdle() const noexcept {
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_DECODER_METRICS_HXX
+#define MPD_DECODER_METRICS_HXX
+
+#include "metrics/Counter.hxx"
+
+/**
+ * Counters describing the speed of all decoders.  The ratio of
+ * #audio_ns and #busy_ns is the "speed factor", i.e. how much faster
+ * than real time the decoders are.
+ */
+struct DecoderMetrics {
+	/**
+	 * The total duration of the audio submitted to the
+	 * #MusicPipe [nanoseconds].
+	 */
+	ShardedCounter audio_ns;
+
+	/**
+	 * The total wall time spent decoding, not including the time
+	 * spent waiting for the player to free #MusicBuffer chunks
+	 * [nanoseconds].
+	 */
+	ShardedCounter busy_ns;
+};
+
+extern DecoderMetrics decoder_metrics;
+
+#endif
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SeekIndex.hxx"
+#include "Domain.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FileLineReader.hxx"
+#include "io/FileOutputStream.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/CNumberParser.hxx"
+#include "util/djb_hash.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringCompare.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
+
+#define INDEX_URI "uri: "
+#define INDEX_SIZE "size: "
+#define INDEX_STEP "step: "
+
+static uint64_t
+ParseUint64Value(const char *line, const char *prefix)
+{
+	const char *value = StringAfterPrefix(line, prefix);
+	if (value == nullptr)
+		throw FmtRuntimeError("Malformed line: {:?}", line);
+
+	char *endptr;
+	const auto result = ParseUint64(value, &endptr);
+	if (endptr == value || *endptr != 0)
+		throw FmtRuntimeError("Malformed line: {:?}", line);
+
+	return result;
+}
+
+AllocatedPath
+SeekIndexStore::MakePath(std::string_view uri) const noexcept
+{
+	const auto hash = djb_hash(AsBytes(uri));
+	return directory / AllocatedPath::FromUTF8(fmt::format("{:016x}", hash));
+}
+
+inline SeekIndex
+SeekIndexStore::Load(LineReader &file, std::string_view uri)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr)
+		return {};
+
+	const char *file_uri = StringAfterPrefix(line, INDEX_URI);
+	if (file_uri == nullptr || uri != file_uri)
+		/* hash collision */
+		return {};
+
+	SeekIndex index;
+
+	if ((line = file.ReadLine()) == nullptr)
+		return {};
+	index.size = ParseUint64Value(line, INDEX_SIZE);
+
+	if ((line = file.ReadLine()) == nullptr)
+		return {};
+	index.step = ParseUint64Value(line, INDEX_STEP);
+
+	while ((line = file.ReadLine()) != nullptr)
+		index.offsets.push_back(ParseUint64Value(line, ""));
+
+	return index;
+}
+
+SeekIndex
+SeekIndexStore::Load(std::string_view uri, uint64_t size) const noexcept
+{
+	const auto path = MakePath(uri);
+	if (!FileExists(path))
+		return {};
+
+	try {
+		FileLineReader file{path};
+		auto index = Load(file, uri);
+		if (index.size != size)
+			/* the file was modified */
+			return {};
+
+		return index;
+	} catch (...) {
+		FmtError(decoder_domain, "Failed to load {:?}: {}",
+			 path, std::current_exception());
+		return {};
+	}
+}
+
+inline void
+SeekIndexStore::Save(BufferedOutputStream &os, std::string_view uri,
+		     const SeekIndex &index)
+{
+	os.Fmt(FMT_STRING(INDEX_URI "{}\n"), uri);
+	os.Fmt(FMT_STRING(INDEX_SIZE "{}\n"), index.size);
+	os.Fmt(FMT_STRING(INDEX_STEP "{}\n"), index.step);
+
+	for (const auto offset : index.offsets)
+		os.Fmt(FMT_STRING("{}\n"), offset);
+}
+
+void
+SeekIndexStore::Save(std::string_view uri,
+		     const SeekIndex &index) const noexcept
+{
+	const auto path = MakePath(uri);
+
+	try {
+		FileOutputStream fos(path);
+		BufferedOutputStream bos(fos);
+		Save(bos, uri, index);
+		bos.Flush();
+		fos.Commit();
+	} catch (...) {
+		FmtError(decoder_domain, "Failed to save {:?}: {}",
+			 path, std::current_exception());
+	}
+}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "fs/AllocatedPath.hxx"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class LineReader;
+class BufferedOutputStream;
+
+/**
+ * A seek index: the file offsets of every #step-th frame of a song
+ * in a format which has no index of its own (e.g. VBR MP3).  With
+ * this, seeking is exact and needs only one seek in the
+ * #InputStream.
+ */
+struct SeekIndex {
+	/**
+	 * The size of the file in bytes; used to detect whether the
+	 * file was modified.
+	 */
+	uint64_t size = 0;
+
+	/**
+	 * The number of frames between two entries of #offsets.
+	 */
+	uint64_t step = 0;
+
+	std::vector<uint64_t> offsets;
+
+	bool empty() const noexcept {
+		return offsets.empty();
+	}
+};
+
+/**
+ * Stores #SeekIndex instances in a directory, one file per song, so
+ * they can be reused after a restart.  Files are named after a hash
+ * of the song URI.
+ */
+class SeekIndexStore {
+	const AllocatedPath directory;
+
+public:
+	explicit SeekIndexStore(AllocatedPath &&_directory) noexcept
+		:directory(std::move(_directory)) {}
+
+	/**
+	 * Load the seek index of the given song.  Returns an empty
+	 * index if there is none or if it was made for a file of a
+	 * different size.  Errors are logged.
+	 */
+	SeekIndex Load(std::string_view uri, uint64_t size) const noexcept;
+
+	/**
+	 * Store the seek index of the given song, replacing the old
+	 * one.  Errors are logged.
+	 */
+	void Save(std::string_view uri, const SeekIndex &index) const noexcept;
+
+private:
+	AllocatedPath MakePath(std::string_view uri) const noexcept;
+
+	static SeekIndex Load(LineReader &file, std::string_view uri);
+	static void Save(BufferedOutputStream &os, std::string_view uri,
+			 const SeekIndex &index);
+};
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_DECODER_STATS_HXX
+#define MPD_DECODER_STATS_HXX
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Performance counters of decoding one song; see
+ * DecoderControl::stats.
+ */
+struct DecoderStats {
+	using Clock = std::chrono::steady_clock;
+	using Duration = Clock::duration;
+
+	/**
+	 * The URI of the song; empty if no song has been decoded
+	 * yet.
+	 */
+	std::string uri;
+
+	/**
+	 * When was the decoder started?
+	 */
+	Clock::time_point start;
+
+	/**
+	 * The duration of the audio submitted to the #MusicPipe.
+	 */
+	Duration audio_time{};
+
+	/**
+	 * The wall time spent decoding until the most recent chunk
+	 * was submitted, not including the time spent waiting for
+	 * free #MusicBuffer chunks (but including
+	 * #read_stall_time).
+	 */
+	Duration busy_time{};
+
+	/**
+	 * The time from starting the decoder until the first chunk
+	 * was submitted; negative if there was none yet.
+	 */
+	Duration first_chunk_time{-1};
+
+	/**
+	 * The number of times the decoder had to wait for the
+	 * #InputStream, and the total time it waited.
+	 */
+	uint_least64_t read_stalls = 0;
+	Duration read_stall_time{};
+
+	/**
+	 * The largest and smallest number of chunks in the
+	 * #MusicPipe while this song was being decoded and played.
+	 * #pipe_low is only valid if #pipe_low_valid is set.
+	 */
+	unsigned pipe_high = 0, pipe_low = 0;
+	bool pipe_low_valid = false;
+
+	/**
+	 * The number of audio seconds decoded per second of busy
+	 * wall time; zero if unknown.
+	 */
+	[[gnu::pure]]
+	double GetSpeed() const noexcept {
+		return busy_time > Duration::zero()
+			? std::chrono::duration<double>(audio_time) / busy_time
+			: 0.;
+	}
+
+	void UpdatePipeSize(unsigned n) noexcept {
+		if (n > pipe_high)
+			pipe_high = n;
+	}
+
+	void UpdatePipeLow(unsigned n) noexcept {
+		if (!pipe_low_valid || n < pipe_low) {
+			pipe_low = n;
+			pipe_low_valid = true;
+		}
+	}
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "util/ScopeExit.hxx"
 #include "util/StringCompare.hxx"
 #include "thread/Name.hxx"
+#include "config/ThreadConfig.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "Log.hxx"
 
@@ -607,7 +608,11 @@ try {
 	dc.ClearError();
 
 	assert(dc.song != nullptr);
-	const DetachedSong &song = *dc.song;
+
+	/* a copy, because DecoderControl::song may be replaced while
+	   the plugin is still running (see
+	   DecoderBridge::ContinueAtEndTime()) */
+	const DetachedSong song{*dc.song};
 
 	const char *const uri_utf8 = song.GetRealURI();
 
@@ -631,6 +636,13 @@ DecoderControl::RunThread() noexcept
 {
 	SetThreadName("decoder");
 
+	try {
+		GetThreadScheduling("decoder").Apply(false);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to apply decoder thread scheduling settings");
+	}
+
 	std::unique_lock lock{mutex};
 
 	do {
@@ -15,12 +15,14 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "pcm/CheckAudioFormat.hxx"
-#include "util/BitReverse.hxx"
+#include "pcm/DsdSimd.hxx"
 #include "util/PackedBigEndian.hxx"
 #include "util/SpanCast.hxx"
 #include "tag/Handler.hxx"
 #include "DsdLib.hxx"
 
+#include <memory>
+
 struct DsdiffHeader {
 	DsdId id;
 	PackedBE64 size;
@@ -335,13 +337,6 @@ dsdiff_read_metadata(DecoderClient *client, InputStream &is,
 	}
 }
 
-static void
-bit_reverse_buffer(std::byte *p, std::byte *end)
-{
-	for (; p < end; ++p)
-		*p = BitReverse(*p);
-}
-
 static offset_type
 FrameToOffset(uint64_t frame, unsigned channels)
 {
@@ -359,13 +354,17 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 	const unsigned kbit_rate = channels * sample_rate / 1000;
 	const offset_type start_offset = is.GetOffset();
 
-	std::byte buffer[8192];
+	/* read large chunks; small reads are expensive, especially
+	   for high sample rates over the network */
+	static constexpr std::size_t READ_SIZE = 64 * 1024;
 
-	const size_t sample_size = sizeof(buffer[0]);
+	const size_t sample_size = sizeof(std::byte);
 	const size_t frame_size = channels * sample_size;
-	const unsigned buffer_frames = sizeof(buffer) / frame_size;
+	const unsigned buffer_frames = READ_SIZE / frame_size;
 	const size_t buffer_size = buffer_frames * frame_size;
 
+	const auto buffer = std::make_unique_for_overwrite<std::byte[]>(buffer_size);
+
 	auto cmd = client.GetCommand();
 	for (offset_type remaining_bytes = total_bytes;
 	     remaining_bytes >= frame_size && cmd != DecoderCommand::STOP;) {
@@ -394,16 +393,16 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 		}
 
 		if (!decoder_read_full(&client, is,
-				       std::span{buffer}.first(now_size)))
+				       std::span{buffer.get(), now_size}))
 			return false;
 
 		const size_t nbytes = now_size;
 		remaining_bytes -= nbytes;
 
 		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+			PcmBitReverseSimd(buffer.get(), buffer.get(), nbytes);
 
-		cmd = client.SubmitAudio(is, std::span{buffer, nbytes},
+		cmd = client.SubmitAudio(is, std::span{buffer.get(), nbytes},
 					 kbit_rate);
 	}
 
@@ -16,16 +16,23 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "pcm/CheckAudioFormat.hxx"
-#include "util/BitReverse.hxx"
+#include "pcm/DsdSimd.hxx"
 #include "util/PackedLittleEndian.hxx"
 #include "util/SpanCast.hxx"
 #include "DsdLib.hxx"
 #include "tag/Handler.hxx"
 
-#include <string.h>
+#include <algorithm> // for std::min(), std::max()
+#include <memory>
 
 static constexpr unsigned DSF_BLOCK_SIZE = 4096;
 
+/**
+ * Read (up to) this many bytes at a time; the 4 kB blocks of the
+ * DSF format are too small for efficient I/O.
+ */
+static constexpr std::size_t DSF_READ_SIZE = 64 * 1024;
+
 struct DsfMetaData {
 	unsigned sample_rate, channels;
 	bool bitreverse;
@@ -165,66 +172,6 @@ dsf_read_metadata(DecoderClient *client, InputStream &is,
 	return true;
 }
 
-static void
-bit_reverse_buffer(std::byte *p, std::byte *end)
-{
-	for (; p < end; ++p)
-		*p = BitReverse(*p);
-}
-
-static void
-InterleaveDsfBlockMono(std::byte *gcc_restrict dest,
-		       const std::byte *gcc_restrict src)
-{
-	memcpy(dest, src, DSF_BLOCK_SIZE);
-}
-
-/**
- * DSF data is build up of alternating 4096 blocks of DSD samples for left and
- * right. Convert the buffer holding 1 block of 4096 DSD left samples and 1
- * block of 4096 DSD right samples to 8k of samples in normal PCM left/right
- * order.
- */
-static void
-InterleaveDsfBlockStereo(std::byte *gcc_restrict dest,
-			 const std::byte *gcc_restrict src)
-{
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i) {
-		dest[2 * i] = src[i];
-		dest[2 * i + 1] = src[DSF_BLOCK_SIZE + i];
-	}
-}
-
-static void
-InterleaveDsfBlockChannel(std::byte *gcc_restrict dest,
-			  const std::byte *gcc_restrict src,
-			  unsigned channels)
-{
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i, dest += channels, ++src)
-		*dest = *src;
-}
-
-static void
-InterleaveDsfBlockGeneric(std::byte *gcc_restrict dest,
-			  const std::byte *gcc_restrict src,
-			  unsigned channels)
-{
-	for (unsigned c = 0; c < channels; ++c, ++dest, src += DSF_BLOCK_SIZE)
-		InterleaveDsfBlockChannel(dest, src, channels);
-}
-
-static void
-InterleaveDsfBlock(std::byte *gcc_restrict dest, const std::byte *gcc_restrict src,
-		   unsigned channels)
-{
-	if (channels == 1)
-		InterleaveDsfBlockMono(dest, src);
-	else if (channels == 2)
-		InterleaveDsfBlockStereo(dest, src);
-	else
-		InterleaveDsfBlockGeneric(dest, src, channels);
-}
-
 static offset_type
 FrameToBlock(uint64_t frame)
 {
@@ -244,6 +191,14 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 	const size_t block_size = channels * DSF_BLOCK_SIZE;
 	const offset_type start_offset = is.GetOffset();
 
+	/* read as many blocks at a time as fit into DSF_READ_SIZE */
+	const std::size_t read_blocks =
+		std::max<std::size_t>(DSF_READ_SIZE / block_size, 1);
+	const auto buffer =
+		std::make_unique_for_overwrite<std::byte[]>(read_blocks * block_size);
+	const auto interleaved_buffer =
+		std::make_unique_for_overwrite<std::byte[]>(read_blocks * block_size);
+
 	auto cmd = client.GetCommand();
 	for (offset_type i = 0; i < n_blocks && cmd != DecoderCommand::STOP;) {
 		if (cmd == DecoderCommand::SEEK) {
@@ -263,22 +218,28 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 				client.SeekError();
 		}
 
-		/* worst-case buffer size */
-		std::byte buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
+		const std::size_t n = std::min<offset_type>(read_blocks,
+							    n_blocks - i);
+		const std::size_t nbytes = n * block_size;
 		if (!decoder_read_full(&client, is,
-				       std::span{buffer}.first(block_size)))
+				       std::span{buffer.get(), nbytes}))
 			return false;
 
 		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
+			PcmBitReverseSimd(buffer.get(), buffer.get(), nbytes);
 
-		std::byte interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
+		/* DSF data is made of alternating blocks of 4096
+		   bytes for each channel; convert them to the
+		   interleaved order MPD uses */
+		for (std::size_t j = 0; j < n; ++j)
+			PcmInterleaveDsdSimd(interleaved_buffer.get() + j * block_size,
+					     buffer.get() + j * block_size,
+					     DSF_BLOCK_SIZE, channels);
 
 		cmd = client.SubmitAudio(is,
-					 std::span{interleaved_buffer, block_size},
+					 std::span{interleaved_buffer.get(), nbytes},
 					 kbit_rate);
-		++i;
+		i += n;
 	}
 
 	return true;
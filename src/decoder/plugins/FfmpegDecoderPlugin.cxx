@@ -37,6 +37,7 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavformat/avio.h>
 #include <libavutil/avutil.h>
+#include <libavutil/channel_layout.h>
 #include <libavutil/frame.h>
 }
 
@@ -49,6 +50,104 @@ extern "C" {
  */
 static AVDictionary *avformat_options = nullptr;
 
+/**
+ * The "threads" setting: the number of threads of each codec
+ * context; 0 lets FFmpeg choose.
+ */
+static int codec_threads = 1;
+
+/**
+ * The "codec_cache" setting.
+ */
+static bool codec_cache_enabled = true;
+
+[[gnu::pure]]
+static bool
+SameCodecParameters(const AVCodecParameters &a,
+		    const AVCodecParameters &b) noexcept
+{
+	return a.codec_id == b.codec_id &&
+		a.codec_tag == b.codec_tag &&
+		a.format == b.format &&
+		a.sample_rate == b.sample_rate &&
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 25, 100)
+		av_channel_layout_compare(&a.ch_layout, &b.ch_layout) == 0 &&
+#else
+		a.channels == b.channels &&
+		a.channel_layout == b.channel_layout &&
+#endif
+		a.bits_per_coded_sample == b.bits_per_coded_sample &&
+		a.block_align == b.block_align &&
+		a.frame_size == b.frame_size &&
+		a.extradata_size == b.extradata_size &&
+		(a.extradata_size == 0 ||
+		 memcmp(a.extradata, b.extradata, a.extradata_size) == 0);
+}
+
+/**
+ * Keeps the opened codec context of the previous song, to be reused
+ * for the next song if it has the same codec parameters.  This saves
+ * the codec initialization during gapless playback of albums.
+ */
+class FfmpegCodecCache {
+	Ffmpeg::CodecContext context;
+
+	/**
+	 * The parameters #context was opened with.
+	 */
+	AVCodecParameters *parameters = nullptr;
+
+public:
+	FfmpegCodecCache() noexcept = default;
+
+	~FfmpegCodecCache() noexcept {
+		avcodec_parameters_free(&parameters);
+	}
+
+	FfmpegCodecCache(const FfmpegCodecCache &) = delete;
+	FfmpegCodecCache &operator=(const FfmpegCodecCache &) = delete;
+
+	/**
+	 * Remove the cached codec context if it matches the given
+	 * parameters.
+	 *
+	 * @return the codec context or an undefined object on
+	 * mismatch
+	 */
+	Ffmpeg::CodecContext Take(const AVCodecParameters &par) noexcept {
+		if (!context || !SameCodecParameters(*parameters, par))
+			return {};
+
+		return std::move(context);
+	}
+
+	/**
+	 * Store a codec context which is no longer used; it replaces
+	 * the previous one.
+	 */
+	void Put(Ffmpeg::CodecContext &&src,
+		 const AVCodecParameters &par) noexcept {
+		context = {};
+
+		if (parameters == nullptr) {
+			parameters = avcodec_parameters_alloc();
+			if (parameters == nullptr)
+				return;
+		}
+
+		if (avcodec_parameters_copy(parameters, &par) < 0)
+			return;
+
+		src.FlushBuffers();
+		context = std::move(src);
+	}
+};
+
+/**
+ * Each decoder thread has its own cache.
+ */
+static thread_local FfmpegCodecCache codec_cache;
+
 static Ffmpeg::FormatContext
 FfmpegOpenInput(AVIOContext *pb,
 		const char *filename,
@@ -81,6 +180,9 @@ ffmpeg_init(const ConfigBlock &block)
 			av_dict_set(&avformat_options, name, value, 0);
 	}
 
+	codec_threads = block.GetBlockValue("threads", 1U);
+	codec_cache_enabled = block.GetBlockValue("codec_cache", true);
+
 	return true;
 }
 
@@ -491,9 +593,24 @@ FfmpegDecode(DecoderClient &client, InputStream *input,
 		return;
 	}
 
-	Ffmpeg::CodecContext codec_context(*codec);
-	codec_context.FillFromParameters(*av_stream.codecpar);
-	codec_context.Open(*codec, nullptr);
+	Ffmpeg::CodecContext codec_context;
+	if (codec_cache_enabled)
+		codec_context = codec_cache.Take(codec_params);
+
+	if (codec_context)
+		LogDebug(ffmpeg_domain, "reusing codec context");
+	else {
+		codec_context = Ffmpeg::CodecContext(*codec);
+		codec_context.FillFromParameters(codec_params);
+		codec_context->thread_count = codec_threads;
+		codec_context->thread_type = FF_THREAD_FRAME|FF_THREAD_SLICE;
+		codec_context.Open(*codec, nullptr);
+	}
+
+	AtScopeExit(&codec_context, &codec_params) {
+		if (codec_cache_enabled)
+			codec_cache.Put(std::move(codec_context), codec_params);
+	};
 
 	const SampleFormat sample_format =
 		ffmpeg_sample_format(codec_context->sample_fmt);
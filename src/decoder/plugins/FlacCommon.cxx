@@ -120,6 +120,50 @@ FlacDecoder::GetDeltaPosition(const FLAC__StreamDecoder &sd)
 	return nbytes;
 }
 
+/**
+ * Advance all channel pointers by the given number of frames.
+ */
+static void
+AdvanceChannels(const FLAC__int32 *dest[], const FLAC__int32 *const src[],
+		unsigned n_channels, size_t n_frames) noexcept
+{
+	for (unsigned c = 0; c < n_channels; ++c)
+		dest[c] = src[c] + n_frames;
+}
+
+inline size_t
+FlacDecoder::WriteDirect(const FLAC__int32 *const buf[],
+			 const size_t n_frames) noexcept
+{
+	auto &client = *GetClient();
+	const unsigned n_channels = pcm_import.GetAudioFormat().channels;
+
+	size_t position = 0;
+	while (position < n_frames) {
+		const auto dest = client.GetAudioBuffer(&GetInputStream(), 0);
+		if (dest.empty())
+			break;
+
+		const FLAC__int32 *src[FLAC__MAX_CHANNELS];
+		AdvanceChannels(src, buf, n_channels, position);
+
+		const size_t n = pcm_import.ImportTo(dest, src,
+						     n_frames - position);
+		position += n;
+
+		commit_command = client.CommitAudio(n * pcm_import.GetAudioFormat().GetFrameSize(),
+						    kbit_rate);
+		if (commit_command != DecoderCommand::NONE) {
+			/* drop the rest; it's not needed after
+			   SEEK or STOP */
+			position = n_frames;
+			break;
+		}
+	}
+
+	return position;
+}
+
 FLAC__StreamDecoderWriteStatus
 FlacDecoder::OnWrite(const FLAC__Frame &frame,
 		     const FLAC__int32 *const buf[],
@@ -128,10 +172,25 @@ FlacDecoder::OnWrite(const FLAC__Frame &frame,
 	if (!initialized && !OnFirstFrame(frame.header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	chunk = pcm_import.Import(buf, frame.header.blocksize);
-
 	kbit_rate = nbytes * 8 * frame.header.sample_rate /
 		(1000 * frame.header.blocksize);
 
+	const size_t n_frames = frame.header.blocksize;
+
+	/* decode straight into the MusicChunk if possible; pending
+	   tags must be submitted first, so this is skipped then */
+	size_t done = 0;
+	if (tag.IsEmpty() && commit_command == DecoderCommand::NONE)
+		done = WriteDirect(buf, n_frames);
+
+	if (done < n_frames) {
+		/* the rest goes through our own buffer and
+		   DecoderClient::SubmitAudio() */
+		const FLAC__int32 *src[FLAC__MAX_CHANNELS];
+		AdvanceChannels(src, buf,
+				pcm_import.GetAudioFormat().channels, done);
+		chunk = pcm_import.Import(src, n_frames - done);
+	}
+
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -51,6 +51,13 @@ struct FlacDecoder : public FlacInput {
 	 */
 	std::span<const std::byte> chunk = {};
 
+	/**
+	 * The result of the last DecoderClient::CommitAudio() call
+	 * made by OnWrite().  If this is not DecoderCommand::NONE, it
+	 * needs to be handled by the decoder loop.
+	 */
+	DecoderCommand commit_command = DecoderCommand::NONE;
+
 	FlacDecoder(DecoderClient &_client,
 		    InputStream &_input_stream) noexcept
 		:FlacInput(_input_stream, &_client) {}
@@ -74,6 +81,15 @@ struct FlacDecoder : public FlacInput {
 	FLAC__uint64 GetDeltaPosition(const FLAC__StreamDecoder &sd);
 
 private:
+	/**
+	 * Import the given frames straight into buffers obtained from
+	 * DecoderClient::GetAudioBuffer().
+	 *
+	 * @return the number of frames which were submitted
+	 */
+	size_t WriteDirect(const FLAC__int32 *const buf[],
+			   size_t n_frames) noexcept;
+
 	void OnStreamInfo(const FLAC__StreamMetadata_StreamInfo &stream_info) noexcept;
 	void OnVorbisComment(const FLAC__StreamMetadata_VorbisComment &vc) noexcept;
 
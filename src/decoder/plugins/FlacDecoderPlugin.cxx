@@ -13,6 +13,8 @@
 #include "fs/NarrowPath.hxx"
 #include "Log.hxx"
 
+#include <utility> // for std::exchange()
+
 static void
 flacPrintErroredState(FLAC__StreamDecoderState state) noexcept
 {
@@ -140,6 +142,11 @@ flac_decoder_initialize(FlacDecoder *data, FLAC__StreamDecoder *sd) noexcept
 static DecoderCommand
 FlacSubmitToClient(DecoderClient &client, FlacDecoder &d) noexcept
 {
+	if (d.commit_command != DecoderCommand::NONE)
+		/* returned by DecoderClient::CommitAudio() in
+		   FlacDecoder::OnWrite() */
+		return std::exchange(d.commit_command, DecoderCommand::NONE);
+
 	if (d.tag.IsEmpty() && d.chunk.empty())
 		return client.GetCommand();
 
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FlacParallel.hxx"
+#include "FlacPcm.hxx"
+#include "FlacStreamDecoder.hxx"
+#include "../DecoderAPI.hxx"
+#include "fs/Path.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/WorkerPool.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <FLAC/metadata.h>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * The duration of one segment.  Smaller segments mean less memory
+ * and better load balancing, but more seeks.
+ */
+static constexpr unsigned SEGMENT_SECONDS = 10;
+
+namespace {
+
+/**
+ * Decodes one range of samples in a worker thread.
+ */
+class FlacSegmentJob final : public WorkerJob {
+	const Path path;
+	const FLAC__StreamMetadata_StreamInfo &stream_info;
+
+	/**
+	 * The range of samples to be decoded.
+	 */
+	const FLAC__uint64 start, end;
+
+	/**
+	 * The sample number of the next frame passed to
+	 * WriteCallback().
+	 */
+	FLAC__uint64 position;
+
+	const std::atomic_bool &cancel;
+
+	Mutex &mutex;
+	Cond &cond;
+
+	FlacPcmImport import;
+
+public:
+	/**
+	 * The decoded PCM data in the #AudioFormat chosen by
+	 * #FlacPcmImport.
+	 */
+	std::vector<std::byte> pcm;
+
+	std::exception_ptr error;
+
+	/**
+	 * Has Run() finished (or was the job canceled before it was
+	 * started)?  Protected by #mutex.
+	 */
+	bool finished = false;
+
+	FlacSegmentJob(Path _path,
+		       const FLAC__StreamMetadata_StreamInfo &_stream_info,
+		       FLAC__uint64 _start, FLAC__uint64 _end,
+		       const std::atomic_bool &_cancel,
+		       Mutex &_mutex, Cond &_cond) noexcept
+		:path(_path), stream_info(_stream_info),
+		 start(_start), end(_end), position(_start),
+		 cancel(_cancel), mutex(_mutex), cond(_cond) {}
+
+	void SetFinished() noexcept {
+		const std::scoped_lock lock{mutex};
+		finished = true;
+		cond.notify_all();
+	}
+
+	/* virtual methods from class WorkerJob */
+	void Run() noexcept override {
+		try {
+			Decode();
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		SetFinished();
+	}
+
+private:
+	void Decode();
+
+	FLAC__StreamDecoderWriteStatus Write(const FLAC__Frame &frame,
+					     const FLAC__int32 *const buffer[]) noexcept;
+
+	static FLAC__StreamDecoderWriteStatus
+	WriteCallback(const FLAC__StreamDecoder *, const FLAC__Frame *frame,
+		      const FLAC__int32 *const buffer[], void *ctx) noexcept {
+		auto &job = *static_cast<FlacSegmentJob *>(ctx);
+		return job.Write(*frame, buffer);
+	}
+
+	static void ErrorCallback(const FLAC__StreamDecoder *,
+				  FLAC__StreamDecoderErrorStatus,
+				  void *) noexcept {
+		/* libFLAC resynchronizes by itself */
+	}
+};
+
+inline FLAC__StreamDecoderWriteStatus
+FlacSegmentJob::Write(const FLAC__Frame &frame,
+		      const FLAC__int32 *const buffer[]) noexcept
+{
+	if (cancel.load(std::memory_order_relaxed))
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+
+	const std::size_t n_frames =
+		std::min<FLAC__uint64>(frame.header.blocksize, end - position);
+	const auto src = import.Import(buffer, n_frames);
+	pcm.insert(pcm.end(), src.begin(), src.end());
+	position += n_frames;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+inline void
+FlacSegmentJob::Decode()
+{
+	import.Open(stream_info.sample_rate, stream_info.bits_per_sample,
+		    stream_info.channels);
+	pcm.reserve((end - start) * import.GetAudioFormat().GetFrameSize());
+
+	FlacStreamDecoder decoder;
+	if (FLAC__stream_decoder_init_file(decoder.get(), path.c_str(),
+					   WriteCallback, nullptr,
+					   ErrorCallback, this) !=
+	    FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		throw std::runtime_error("FLAC__stream_decoder_init_file() failed");
+
+	/* the first frame after the seek is truncated by libFLAC to
+	   begin exactly at the given sample */
+	if (start > 0 &&
+	    !FLAC__stream_decoder_seek_absolute(decoder.get(), start))
+		throw std::runtime_error("FLAC seek failed");
+
+	while (position < end && !cancel.load(std::memory_order_relaxed)) {
+		if (!FLAC__stream_decoder_process_single(decoder.get()))
+			throw std::runtime_error("FLAC decoder failed");
+
+		if (FLAC__stream_decoder_get_state(decoder.get()) ==
+		    FLAC__STREAM_DECODER_END_OF_STREAM)
+			break;
+	}
+
+	FLAC__stream_decoder_finish(decoder.get());
+}
+
+} // anonymous namespace
+
+bool
+FlacParallelDecode(DecoderClient &client, Path path,
+		   WorkerPool &pool, unsigned max_segments)
+{
+	FLAC__StreamMetadata metadata;
+	if (!FLAC__metadata_get_streaminfo(path.c_str(), &metadata))
+		/* not a native FLAC file */
+		return false;
+
+	const auto &stream_info = metadata.data.stream_info;
+	const FLAC__uint64 total = stream_info.total_samples;
+	const FLAC__uint64 segment_size =
+		FLAC__uint64{stream_info.sample_rate} * SEGMENT_SECONDS;
+	if (segment_size == 0 || total <= segment_size)
+		/* unknown length or too short to be worth it */
+		return false;
+
+	FlacPcmImport import;
+	import.Open(stream_info.sample_rate, stream_info.bits_per_sample,
+		    stream_info.channels);
+
+	client.Ready(import.GetAudioFormat(), false,
+		     SongTime::FromScale<uint64_t>(total,
+						   stream_info.sample_rate));
+
+	std::atomic_bool cancel{false};
+	Mutex mutex;
+	Cond cond;
+
+	/* a std::list because #WorkerPool keeps pointers to its
+	   elements */
+	std::list<FlacSegmentJob> jobs;
+
+	AtScopeExit(&) {
+		cancel = true;
+
+		for (auto &job : jobs)
+			if (pool.Cancel(job))
+				job.SetFinished();
+
+		std::unique_lock lock{mutex};
+		cond.wait(lock, [&jobs]{
+			return std::all_of(jobs.begin(), jobs.end(),
+					   [](const auto &job){
+						   return job.finished;
+					   });
+		});
+	};
+
+	FLAC__uint64 next_start = 0;
+
+	while (true) {
+		while (jobs.size() < max_segments && next_start < total) {
+			const auto next_end = std::min(next_start + segment_size,
+						       total);
+			auto &job = jobs.emplace_back(path, stream_info,
+						      next_start, next_end,
+						      cancel, mutex, cond);
+			pool.Push(job, WorkerPriority::LOW);
+			next_start = next_end;
+		}
+
+		if (jobs.empty())
+			break;
+
+		auto &job = jobs.front();
+
+		{
+			std::unique_lock lock{mutex};
+			cond.wait(lock, [&job]{ return job.finished; });
+		}
+
+		if (job.error)
+			std::rethrow_exception(job.error);
+
+		if (!job.pcm.empty() &&
+		    client.SubmitAudio(nullptr, job.pcm, 0) != DecoderCommand::NONE)
+			break;
+
+		jobs.pop_front();
+	}
+
+	return true;
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_FLAC_PARALLEL_HXX
+#define MPD_FLAC_PARALLEL_HXX
+
+class Path;
+class DecoderClient;
+class WorkerPool;
+
+/**
+ * Decode a local (native) FLAC file by splitting it into segments of
+ * a few seconds which are decoded in parallel by the given
+ * #WorkerPool.  Each segment gets its own libFLAC decoder which seeks
+ * to the first sample of the segment (using the file's seek table,
+ * if there is one).  The PCM data is submitted to the #DecoderClient
+ * in the original order.
+ *
+ * This is meant for batch workloads which need the whole song as
+ * fast as possible (e.g. ReplayGain analysis); it needs more memory
+ * than the #flac_decoder_plugin, and it does not support seeking or
+ * tags.
+ *
+ * Throws on error.
+ *
+ * @param max_segments the maximum number of segments being decoded
+ * (or waiting to be submitted) at a time; this limits the memory
+ * usage and should be a bit larger than the number of threads
+ * @return false if the file is not suitable (e.g. not a native FLAC
+ * file, unknown length or too short); the caller should fall back to
+ * the #flac_decoder_plugin
+ */
+bool
+FlacParallelDecode(DecoderClient &client, Path path,
+		   WorkerPool &pool, unsigned max_segments);
+
+#endif
@@ -6,6 +6,7 @@
 #include "lib/xiph/FlacAudioFormat.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 
+#include <algorithm> // for std::min()
 #include <cassert>
 
 void
@@ -64,6 +65,47 @@ FlacImport(PcmBuffer &buffer, const FLAC__int32 *const src[], size_t n_frames,
 	return std::as_bytes(std::span{dest, n_samples});
 }
 
+template<typename T>
+static size_t
+FlacImportTo(std::span<std::byte> dest, const FLAC__int32 *const src[],
+	     size_t n_frames, unsigned n_channels) noexcept
+{
+	n_frames = std::min(n_frames,
+			    dest.size() / (sizeof(T) * n_channels));
+	FlacImport(reinterpret_cast<T *>(dest.data()), src, n_frames,
+		   n_channels);
+	return n_frames;
+}
+
+size_t
+FlacPcmImport::ImportTo(std::span<std::byte> dest,
+			const FLAC__int32 *const src[],
+			size_t n_frames) const noexcept
+{
+	switch (audio_format.format) {
+	case SampleFormat::S16:
+		return FlacImportTo<int16_t>(dest, src, n_frames,
+					     audio_format.channels);
+
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+		return FlacImportTo<int32_t>(dest, src, n_frames,
+					     audio_format.channels);
+
+	case SampleFormat::S8:
+		return FlacImportTo<int8_t>(dest, src, n_frames,
+					    audio_format.channels);
+
+	case SampleFormat::FLOAT:
+	case SampleFormat::DSD:
+	case SampleFormat::UNDEFINED:
+		break;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
 std::span<const std::byte>
 FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames) noexcept
 {
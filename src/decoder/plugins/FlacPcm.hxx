@@ -34,6 +34,17 @@ public:
 
 	std::span<const std::byte> Import(const FLAC__int32 *const src[],
 					  size_t n_frames) noexcept;
+
+	/**
+	 * Like Import(), but write to the given buffer (e.g. one
+	 * obtained from DecoderClient::GetAudioBuffer()) instead of
+	 * the internal one.  Imports as many frames as fit.
+	 *
+	 * @return the number of frames which were imported
+	 */
+	size_t ImportTo(std::span<std::byte> dest,
+			const FLAC__int32 *const src[],
+			size_t n_frames) const noexcept;
 };
 
 #endif
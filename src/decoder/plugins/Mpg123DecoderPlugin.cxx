@@ -3,12 +3,15 @@
 
 #include "Mpg123DecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndex.hxx"
+#include "config/Block.hxx"
 #include "input/InputStream.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
 #include "tag/ReplayGainParser.hxx"
 #include "tag/MixRampParser.hxx"
+#include "fs/FileInfo.hxx"
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
@@ -19,24 +22,92 @@
 
 #include <mpg123.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <stdio.h>
 
 static constexpr Domain mpg123_domain("mpg123");
 
+/**
+ * Persistent seek indexes; nullptr if "seek_index_directory" is not
+ * configured.
+ */
+static std::unique_ptr<SeekIndexStore> seek_index_store;
+
 static bool
-mpd_mpg123_init([[maybe_unused]] const ConfigBlock &block)
+mpd_mpg123_init(const ConfigBlock &block)
 {
 	mpg123_init();
 
+	if (auto directory = block.GetPath("seek_index_directory");
+	    !directory.IsNull())
+		seek_index_store = std::make_unique<SeekIndexStore>(std::move(directory));
+
 	return true;
 }
 
 static void
 mpd_mpg123_finish() noexcept
 {
+	seek_index_store.reset();
+
 	mpg123_exit();
 }
 
+/**
+ * Load the song's frame index from the #seek_index_store and pass
+ * it to libmpg123, which makes seeking exact without scanning the
+ * file.
+ *
+ * @return true if an index was loaded
+ */
+static bool
+LoadSeekIndex(mpg123_handle &handle, std::string_view uri,
+	      uint64_t size) noexcept
+{
+	if (!seek_index_store || uri.empty() || size == 0)
+		return false;
+
+	const auto index = seek_index_store->Load(uri, size);
+	if (index.empty())
+		return false;
+
+	std::vector<off_t> offsets(index.offsets.begin(),
+				   index.offsets.end());
+	if (mpg123_set_index(&handle, offsets.data(), off_t(index.step),
+			     offsets.size()) != MPG123_OK)
+		return false;
+
+	return true;
+}
+
+/**
+ * Store the frame index which libmpg123 has built while decoding the
+ * whole song in the #seek_index_store.
+ */
+static void
+SaveSeekIndex(mpg123_handle &handle, std::string_view uri,
+	      uint64_t size) noexcept
+{
+	if (!seek_index_store || uri.empty() || size == 0)
+		return;
+
+	off_t *offsets;
+	off_t step;
+	size_t fill;
+	if (mpg123_index(&handle, &offsets, &step, &fill) != MPG123_OK ||
+	    fill == 0 || step <= 0)
+		return;
+
+	SeekIndex index;
+	index.size = size;
+	index.step = step;
+	index.offsets.assign(offsets, offsets + fill);
+	seek_index_store->Save(uri, index);
+}
+
 /**
  * Opens a file with an existing #mpg123_handle.
  *
@@ -255,13 +326,21 @@ GetDuration(mpg123_handle &handle, const AudioFormat &audio_format) noexcept
 					     audio_format.sample_rate);
 }
 
+/**
+ * @param uri the key for the #seek_index_store; empty to disable it
+ * @param size the file size (to validate the seek index); 0 if
+ * unknown
+ */
 static void
-Decode(DecoderClient &client, mpg123_handle &handle, const bool seekable)
+Decode(DecoderClient &client, mpg123_handle &handle, const bool seekable,
+       std::string_view uri, uint64_t size)
 {
 	AudioFormat audio_format;
 	if (!GetAudioFormat(handle, audio_format))
 		return;
 
+	const bool have_index = LoadSeekIndex(handle, uri, size);
+
 	/* tell MPD core we're ready */
 
 	const auto duration = GetDuration(handle, audio_format);
@@ -290,16 +369,28 @@ Decode(DecoderClient &client, mpg123_handle &handle, const bool seekable)
 		/* read metadata */
 		mpd_mpg123_meta(client, &handle);
 
-		/* decode */
+		/* decode; straight into the MusicChunk if possible */
 
 		unsigned char buffer[8192];
+		auto dest = client.GetAudioBuffer(nullptr, 0);
+		const bool direct = !dest.empty();
+		if (!direct)
+			dest = std::as_writable_bytes(std::span{buffer});
+
 		size_t nbytes;
-		if (int error = mpg123_read(&handle, buffer, sizeof(buffer), &nbytes);
+		if (int error = mpg123_read(&handle,
+					    reinterpret_cast<unsigned char *>(dest.data()),
+					    dest.size(), &nbytes);
 		    error != MPG123_OK) {
 			if (error != MPG123_DONE)
 				FmtWarning(mpg123_domain,
 					   "mpg123_read() failed: {}",
 					   mpg123_plain_strerror(error));
+			else if (!have_index)
+				/* libmpg123 has now seen all frames;
+				   remember their offsets for the next
+				   time this song is played */
+				SaveSeekIndex(handle, uri, size);
 			break;
 		}
 
@@ -313,8 +404,10 @@ Decode(DecoderClient &client, mpg123_handle &handle, const bool seekable)
 
 		/* send to MPD */
 
-		cmd = client.SubmitAudio(nullptr, std::span{buffer, nbytes},
-					 info.bitrate);
+		cmd = direct
+			? client.CommitAudio(nbytes, info.bitrate)
+			: client.SubmitAudio(nullptr, std::span{buffer, nbytes},
+					     info.bitrate);
 
 		if (cmd == DecoderCommand::SEEK) {
 			off_t c = client.GetSeekFrame();
@@ -354,10 +447,15 @@ mpd_mpg123_stream_decode(DecoderClient &client, InputStream &is)
 
 	mpd_mpg123_open_stream(*handle, iohandle);
 
-	if (is.KnownSize())
-	    mpg123_set_filesize(handle, is.GetSize());
+	uint64_t size = 0;
+	if (is.KnownSize()) {
+		size = is.GetSize();
+		mpg123_set_filesize(handle, size);
+	}
 
-	Decode(client, *handle, is.IsSeekable());
+	Decode(client, *handle, is.IsSeekable(),
+	       is.IsSeekable() ? std::string_view{is.GetURI()} : std::string_view{},
+	       size);
 }
 
 static void
@@ -379,7 +477,18 @@ mpd_mpg123_file_decode(DecoderClient &client, Path path_fs)
 	if (!mpd_mpg123_open(handle, path_fs))
 		return;
 
-	Decode(client, *handle, true);
+	std::string uri;
+	uint64_t size = 0;
+	if (seek_index_store) {
+		try {
+			size = FileInfo{path_fs}.GetSize();
+			uri = path_fs.ToUTF8Throw();
+		} catch (...) {
+			/* no seek index for this file */
+		}
+	}
+
+	Decode(client, *handle, true, uri, size);
 }
 
 static bool
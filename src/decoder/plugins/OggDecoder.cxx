@@ -5,6 +5,8 @@
 #include "lib/xiph/OggFind.hxx"
 #include "input/InputStream.hxx"
 
+#include <iterator> // for std::prev
+
 /**
  * Load the end-of-stream packet and restore the previous file
  * position.
@@ -63,6 +65,18 @@ OggDecoder::SeekByte(offset_type offset)
 	PostSeek(offset);
 }
 
+void
+OggDecoder::AddPageIndex(ogg_int64_t granulepos, offset_type offset) noexcept
+{
+	if (page_index.size() >= MAX_PAGE_INDEX)
+		/* keep it small; entries close to the new one are
+		   the most useful ones, but this is rare enough to not
+		   bother */
+		page_index.clear();
+
+	page_index.emplace(granulepos, offset);
+}
+
 void
 OggDecoder::SeekGranulePos(ogg_int64_t where_granulepos)
 {
@@ -70,7 +84,9 @@ OggDecoder::SeekGranulePos(ogg_int64_t where_granulepos)
 
 	/* binary search: interpolate the file offset where we expect
 	   to find the given granule position, and repeat until we're
-	   close enough */
+	   close enough; if interpolation does not shrink the range
+	   quickly enough (e.g. because the bit rate varies), bisect
+	   the range instead */
 
 	static const ogg_int64_t MARGIN_BEFORE = 44100 / 3;
 	static const ogg_int64_t MARGIN_AFTER = 44100 / 10;
@@ -78,12 +94,46 @@ OggDecoder::SeekGranulePos(ogg_int64_t where_granulepos)
 	offset_type min_offset = 0, max_offset = input_stream.GetSize();
 	ogg_int64_t min_granule = 0, max_granule = end_granulepos;
 
+	/* start with the closest pages known from previous seeks */
+	if (auto i = page_index.upper_bound(where_granulepos);
+	    i != page_index.end()) {
+		if (i->first < max_granule && i->second < max_offset) {
+			max_granule = i->first;
+			max_offset = i->second;
+		}
+
+		if (i != page_index.begin()) {
+			--i;
+			if (i->first > min_granule && i->second > min_offset) {
+				min_granule = i->first;
+				min_offset = i->second;
+			}
+		}
+	} else if (!page_index.empty()) {
+		i = std::prev(i);
+		if (i->first > min_granule && i->second > min_offset) {
+			min_granule = i->first;
+			min_offset = i->second;
+		}
+	}
+
+	if (min_granule + MARGIN_BEFORE >= where_granulepos &&
+	    min_granule <= where_granulepos) {
+		/* a known page is close enough */
+		SeekByte(min_offset);
+		return;
+	}
+
+	bool bisect = false;
+
 	while (true) {
 		const offset_type delta_offset = max_offset - min_offset;
 		const ogg_int64_t delta_granule = max_granule - min_granule;
 		const ogg_int64_t relative_granule = where_granulepos - min_granule;
 
-		const offset_type offset = min_offset + relative_granule * delta_offset
+		const offset_type offset = bisect
+			? min_offset + delta_offset / 2
+			: min_offset + relative_granule * delta_offset
 			/ delta_granule;
 
 		SeekByte(offset);
@@ -94,6 +144,8 @@ OggDecoder::SeekGranulePos(ogg_int64_t where_granulepos)
 			   - we can't improve, so stop */
 			return;
 
+		AddPageIndex(new_granule, GetStartOffset());
+
 		if (new_granule > where_granulepos + MARGIN_AFTER) {
 			if (new_granule > max_granule)
 				/* something went wrong */
@@ -124,6 +176,10 @@ OggDecoder::SeekGranulePos(ogg_int64_t where_granulepos)
 		} else {
 			break;
 		}
+
+		/* bisect next time unless the range has at least been
+		   halved */
+		bisect = max_offset - min_offset > delta_offset / 2;
 	}
 
 	/* go back to the last page start so OggVisitor can start
@@ -8,9 +8,24 @@
 #include "decoder/Reader.hxx"
 #include "input/Offset.hxx"
 
+#include <map>
+
 class OggDecoder : public OggVisitor {
 	ogg_int64_t end_granulepos;
 
+	/**
+	 * The granule positions and start offsets of pages found by
+	 * SeekGranulePos().  Later seeks use them to narrow down the
+	 * search range, which saves (possibly expensive) seeks in
+	 * the #InputStream.
+	 */
+	std::map<ogg_int64_t, offset_type> page_index;
+
+	/**
+	 * The maximum number of entries in #page_index.
+	 */
+	static constexpr std::size_t MAX_PAGE_INDEX = 256;
+
 protected:
 	DecoderClient &client;
 	InputStream &input_stream;
@@ -45,6 +60,11 @@ protected:
 	 */
 	void SeekByte(offset_type offset);
 
+private:
+	void AddPageIndex(ogg_int64_t granulepos, offset_type offset) noexcept;
+
+protected:
+
 	void SeekGranulePos(ogg_int64_t where_granulepos);
 };
 
@@ -295,10 +295,30 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 		submitted_replay_gain = true;
 	}
 
+	/* decode straight into the MusicChunk if the whole packet
+	   fits and no samples need to be skipped */
+	std::span<std::byte> dest;
+	if (skip == 0) {
+		const int packet_frames =
+			opus_packet_get_nb_samples((const unsigned char *)packet.packet,
+						   packet.bytes,
+						   opus_sample_rate);
+		if (packet_frames > 0)
+			dest = client.GetAudioBuffer(&input_stream,
+						     packet_frames * previous_channels * sizeof(opus_int16));
+	}
+
+	opus_int16 *decode_buffer = output_buffer;
+	int decode_frames = opus_output_buffer_frames;
+	if (!dest.empty()) {
+		decode_buffer = reinterpret_cast<opus_int16 *>(dest.data());
+		decode_frames = dest.size() / (previous_channels * sizeof(opus_int16));
+	}
+
 	int nframes = opus_decode(opus_decoder,
 				  (const unsigned char*)packet.packet,
 				  packet.bytes,
-				  output_buffer, opus_output_buffer_frames,
+				  decode_buffer, decode_frames,
 				  0);
 	if (nframes <= 0) [[unlikely]] {
 		if (nframes < 0)
@@ -322,7 +342,7 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 		return;
 	}
 
-	const opus_int16 *data = output_buffer;
+	const opus_int16 *data = decode_buffer;
 	data += skip * previous_channels;
 	nframes -= skip;
 	AddGranulepos(skip);
@@ -347,9 +367,11 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 
 	/* submit decoded samples to the DecoderClient */
 	const size_t n_samples = nframes * previous_channels;
-	auto cmd = client.SubmitAudio(input_stream,
-				      std::span{data, n_samples},
-				      kbits);
+	auto cmd = !dest.empty()
+		? client.CommitAudio(n_samples * sizeof(*data), kbits)
+		: client.SubmitAudio(input_stream,
+				     std::span{data, n_samples},
+				     kbits);
 	if (cmd != DecoderCommand::NONE)
 		throw cmd;
 
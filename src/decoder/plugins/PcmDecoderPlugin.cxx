@@ -16,10 +16,9 @@
 #include "util/MimeType.hxx"
 #include "Log.hxx"
 
-#ifdef ENABLE_ALSA
 #include "pcm/AudioParser.hxx"
-#endif
 
+#include <algorithm> // for std::copy_n()
 #include <exception>
 
 #include <string.h>
@@ -123,8 +122,11 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 			audio_format.channels = value;
 		}
 
+		if (const auto base = GetMimeTypeBase(mime);
 #ifdef ENABLE_ALSA
-		if (GetMimeTypeBase(mime) == "audio/x-mpd-alsa-pcm") {
+		    base == "audio/x-mpd-alsa-pcm" ||
+#endif
+		    base == "audio/x-mpd-snapcast-pcm") {
 			i = mime_parameters.find("format");
 			if (i != mime_parameters.end()) {
 				const char *s = i->second.c_str();
@@ -137,7 +139,6 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 				}
 			}
 		}
-#endif
 	}
 
 	if (audio_format.sample_rate == 0) {
@@ -165,37 +166,70 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 
 	DecoderCommand cmd;
 	do {
-		if (!FillBuffer(client, is, buffer))
-			break;
-
-		auto r = buffer.Read();
-		/* round down to the nearest frame size, because we
-		   must not pass partial frames to
-		   DecoderClient::SubmitAudio() */
-		r = r.first(r.size() - r.size() % in_frame_size);
-		buffer.Consume(r.size());
-
-		if (reverse_endian)
-			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)r.data(),
-					 (uint16_t *)r.data(),
-					 (uint16_t *)(r.data() + r.size()));
-		else if (l24) {
-			/* convert big-endian packed 24 bit
-			   (audio/L24) to native-endian 24 bit (in 32
-			   bit integers) */
-			pcm_unpack_24be(unpack_buffer,
-					reinterpret_cast<const uint8_t *>(r.data()),
-					reinterpret_cast<const uint8_t *>(r.data() + r.size()));
-			r = {
-				(std::byte *)&unpack_buffer[0],
-				(r.size() / 3) * 4,
-			};
-		}
+		/* read straight into the MusicChunk if possible (not
+		   for audio/L24 which needs to be unpacked, and not
+		   while there is a partial frame in the buffer) */
+		std::span<std::byte> dest;
+		if (!l24 && buffer.empty())
+			dest = client.GetAudioBuffer(&is, in_frame_size);
+
+		if (!dest.empty()) {
+			const size_t nbytes = decoder_read(client, is, dest);
+			if (nbytes == 0 && is.LockIsEOF())
+				break;
+
+			/* move a partial frame to the buffer; it
+			   will be completed by the next read */
+			const size_t partial = nbytes % in_frame_size;
+			if (partial > 0) {
+				auto w = buffer.Write();
+				std::copy_n(dest.data() + nbytes - partial,
+					    partial, w.data());
+				buffer.Append(partial);
+			}
+
+			const auto r = dest.first(nbytes - partial);
+
+			if (reverse_endian)
+				reverse_bytes_16((uint16_t *)r.data(),
+						 (uint16_t *)r.data(),
+						 (uint16_t *)(r.data() + r.size()));
+
+			cmd = client.CommitAudio(r.size(), 0);
+		} else {
+			if (!FillBuffer(client, is, buffer))
+				break;
+
+			auto r = buffer.Read();
+			/* round down to the nearest frame size,
+			   because we must not pass partial frames to
+			   DecoderClient::SubmitAudio() */
+			r = r.first(r.size() - r.size() % in_frame_size);
+			buffer.Consume(r.size());
+
+			if (reverse_endian)
+				/* make sure we deliver samples in
+				   host byte order */
+				reverse_bytes_16((uint16_t *)r.data(),
+						 (uint16_t *)r.data(),
+						 (uint16_t *)(r.data() + r.size()));
+			else if (l24) {
+				/* convert big-endian packed 24 bit
+				   (audio/L24) to native-endian 24 bit
+				   (in 32 bit integers) */
+				pcm_unpack_24be(unpack_buffer,
+						reinterpret_cast<const uint8_t *>(r.data()),
+						reinterpret_cast<const uint8_t *>(r.data() + r.size()));
+				r = {
+					(std::byte *)&unpack_buffer[0],
+					(r.size() / 3) * 4,
+				};
+			}
 
-		cmd = !r.empty()
-			? client.SubmitAudio(is, r, 0)
-			: client.GetCommand();
+			cmd = !r.empty()
+				? client.SubmitAudio(is, r, 0)
+				: client.GetCommand();
+		}
 		if (cmd == DecoderCommand::SEEK) {
 			uint64_t frame = client.GetSeekFrame();
 			offset_type offset = frame * in_frame_size;
@@ -235,6 +269,9 @@ static const char *const pcm_mime_types[] = {
 	"audio/x-mpd-alsa-pcm",
 #endif
 
+	/* for streams obtained by the snapcast input plugin */
+	"audio/x-mpd-snapcast-pcm",
+
 	nullptr
 };
 
@@ -4,10 +4,17 @@
 #include "Configured.hxx"
 #include "EncoderList.hxx"
 #include "EncoderPlugin.hxx"
+#include "EncoderInterface.hxx"
+#include "Shared.hxx"
 #include "config/Block.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/StringAPI.hxx"
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
 static const EncoderPlugin &
 GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 {
@@ -32,9 +39,48 @@ GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 	return *plugin;
 }
 
+/**
+ * Create the #PreparedEncoder and build a key from all settings it
+ * has consumed; outputs with the same key can share an #Encoder.
+ */
+static PreparedEncoder *
+CreateSharedEncoder(const EncoderPlugin &plugin, const ConfigBlock &block)
+{
+	/* remember which settings have been used by the output
+	   already; the others which are used now belong to the
+	   encoder */
+	std::vector<bool> was_used;
+	was_used.reserve(block.block_params.size());
+	for (const auto &i : block.block_params)
+		was_used.push_back(i.used);
+
+	std::unique_ptr<PreparedEncoder> prepared{encoder_init(plugin, block)};
+
+	std::vector<std::string> settings;
+	for (std::size_t i = 0; i < block.block_params.size(); ++i) {
+		const auto &param = block.block_params[i];
+		if (param.used && !was_used[i])
+			settings.emplace_back(param.name + '=' + param.value);
+	}
+
+	std::sort(settings.begin(), settings.end());
+
+	std::string key = plugin.name;
+	for (const auto &i : settings) {
+		key.push_back('\n');
+		key.append(i);
+	}
+
+	return MakeSharedEncoder(std::move(key), std::move(prepared));
+}
+
 PreparedEncoder *
 CreateConfiguredEncoder(const ConfigBlock &block, bool shout_legacy)
 {
-	return encoder_init(GetConfiguredEncoderPlugin(block, shout_legacy),
-			    block);
+	const auto &plugin = GetConfiguredEncoderPlugin(block, shout_legacy);
+
+	if (block.GetBlockValue("shared_encoder", false))
+		return CreateSharedEncoder(plugin, block);
+
+	return encoder_init(plugin, block);
 }
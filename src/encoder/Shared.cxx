@@ -0,0 +1,617 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Shared.hxx"
+#include "EncoderInterface.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/Domain.hxx"
+#include "util/IntrusiveList.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+static constexpr Domain shared_encoder_domain("shared_encoder");
+
+/**
+ * How much encoder input is remembered to verify that all
+ * subscribers feed the same PCM data?
+ */
+static constexpr std::size_t HISTORY_SIZE = 1024 * 1024;
+
+/**
+ * If the encoded data which has not yet been read by all
+ * subscribers grows beyond this size, the slowest subscribers skip
+ * ahead.
+ */
+static constexpr std::size_t MAX_BUFFERED = 8 * 1024 * 1024;
+
+using SharedBuffer = std::shared_ptr<const AllocatedArray<std::byte>>;
+
+[[gnu::pure]]
+static bool
+IsSameTag(const Tag &a, const Tag &b) noexcept
+{
+	if (a.num_items != b.num_items)
+		return false;
+
+	for (unsigned i = 0; i < a.num_items; ++i)
+		if (a.items[i]->type != b.items[i]->type ||
+		    std::strcmp(a.items[i]->value, b.items[i]->value) != 0)
+			return false;
+
+	return true;
+}
+
+class SharedEncoder;
+
+/**
+ * The state shared by all #SharedEncoder instances with the same
+ * key.
+ */
+class SharedEncoderBus {
+	friend class SharedEncoder;
+
+	const std::unique_ptr<PreparedEncoder> prepared;
+
+	Mutex mutex;
+
+	/* all fields below are protected by #mutex */
+
+	/**
+	 * The real encoder; nullptr if there are no subscribers.
+	 */
+	std::unique_ptr<Encoder> encoder;
+
+	/**
+	 * The #AudioFormat passed to PreparedEncoder::Open() (#input)
+	 * and the one modified by it (#output).
+	 */
+	AudioFormat input_format, output_format;
+
+	struct Chunk {
+		SharedBuffer data;
+
+		/**
+		 * The value of #tag_serial when this chunk was
+		 * encoded.
+		 */
+		unsigned tag_serial;
+	};
+
+	/**
+	 * Encoded data which has not yet been read by all
+	 * subscribers.
+	 */
+	std::deque<Chunk> chunks;
+
+	/**
+	 * The sequence number of the first item in #chunks.
+	 */
+	uint_least64_t first_chunk = 0;
+
+	/**
+	 * The total size of all #chunks.
+	 */
+	std::size_t chunks_size = 0;
+
+	/**
+	 * The encoded data which begins the current stream (after
+	 * Open() or after a new tag); it is replayed to new
+	 * subscribers.
+	 */
+	std::vector<SharedBuffer> header;
+
+	/**
+	 * Is all data read from the encoder currently appended to
+	 * #header?  This is true until the next Write() call.
+	 */
+	bool collecting_header = false;
+
+	/**
+	 * Has Encoder::End() been called?
+	 */
+	bool ended = false;
+
+	/**
+	 * Incremented for each tag sent to the encoder.
+	 */
+	unsigned tag_serial = 0;
+
+	/**
+	 * The tag most recently sent to the encoder.
+	 */
+	std::unique_ptr<Tag> last_tag;
+
+	/**
+	 * The total number of PCM bytes passed to the encoder.
+	 */
+	uint_least64_t position = 0;
+
+	/**
+	 * The most recent encoder input; its end is at #position.
+	 */
+	std::vector<std::byte> history;
+
+	IntrusiveList<SharedEncoder> subscribers;
+
+public:
+	explicit SharedEncoderBus(std::unique_ptr<PreparedEncoder> &&_prepared) noexcept
+		:prepared(std::move(_prepared)) {}
+
+	const char *GetMimeType() const noexcept {
+		return prepared->GetMimeType();
+	}
+
+	Encoder *Open(const std::shared_ptr<SharedEncoderBus> &self,
+		      AudioFormat &audio_format);
+
+private:
+	uint_least64_t GetEndChunk() const noexcept {
+		return first_chunk + chunks.size();
+	}
+
+	/**
+	 * Does the given input match what has been encoded at this
+	 * position?
+	 */
+	[[gnu::pure]]
+	bool Verify(uint_least64_t at,
+		    std::span<const std::byte> src) const noexcept;
+
+	/**
+	 * Move all available data from the #encoder to #chunks.
+	 */
+	void Drain() noexcept;
+
+	void Encode(std::span<const std::byte> src);
+
+	void AppendHistory(std::span<const std::byte> src) noexcept;
+
+	/**
+	 * Discard chunks which have been read by all subscribers.
+	 */
+	void Trim() noexcept;
+
+	void Reset() noexcept;
+};
+
+/**
+ * The #Encoder implementation returned to each output; it reads
+ * the encoded stream from the #SharedEncoderBus.
+ */
+class SharedEncoder final : public Encoder, public IntrusiveListHook<> {
+	friend class SharedEncoderBus;
+
+	const std::shared_ptr<SharedEncoderBus> bus;
+
+	/**
+	 * A private encoder used after this output's input has
+	 * diverged from the other subscribers.
+	 */
+	std::unique_ptr<Encoder> private_encoder;
+
+	/**
+	 * The number of PCM bytes passed to Write().
+	 */
+	uint_least64_t position;
+
+	/**
+	 * The sequence number of the next chunk to be read.
+	 */
+	uint_least64_t next_chunk;
+
+	/**
+	 * Header chunks to be read before #next_chunk.
+	 */
+	std::deque<SharedBuffer> pending_header;
+
+	/**
+	 * The chunk most recently returned by Read(); the reference
+	 * keeps the returned memory alive.
+	 */
+	SharedBuffer current;
+
+	unsigned tag_serial;
+
+	/**
+	 * The number of mismatches since the input was last verified
+	 * successfully.
+	 */
+	unsigned resyncs = 0;
+
+public:
+	SharedEncoder(std::shared_ptr<SharedEncoderBus> _bus,
+		      bool _implements_tag) noexcept
+		:Encoder(_implements_tag), bus(std::move(_bus)) {}
+
+	~SharedEncoder() noexcept override;
+
+	/* virtual methods from class Encoder */
+	void End() override;
+	void Flush() override;
+	void PreTag() override;
+	void SendTag(const Tag &tag) override;
+	void Write(std::span<const std::byte> src) override;
+	std::span<const std::byte> Read(std::span<std::byte> buffer) noexcept override;
+
+private:
+	/**
+	 * Stop sharing the encoder; continue with a private one.
+	 * Caller must lock the mutex.
+	 */
+	void Detach();
+};
+
+class SharedPreparedEncoder final : public PreparedEncoder {
+	const std::shared_ptr<SharedEncoderBus> bus;
+
+public:
+	explicit SharedPreparedEncoder(std::shared_ptr<SharedEncoderBus> _bus) noexcept
+		:bus(std::move(_bus)) {}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override {
+		return bus->Open(bus, audio_format);
+	}
+
+	const char *GetMimeType() const noexcept override {
+		return bus->GetMimeType();
+	}
+};
+
+bool
+SharedEncoderBus::Verify(uint_least64_t at,
+			 std::span<const std::byte> src) const noexcept
+{
+	assert(at + src.size() <= position);
+
+	const uint_least64_t history_begin = position - history.size();
+	if (at < history_begin)
+		return false;
+
+	return std::equal(src.begin(), src.end(),
+			  std::next(history.begin(), at - history_begin));
+}
+
+void
+SharedEncoderBus::Drain() noexcept
+{
+	std::byte buffer[32768];
+
+	while (true) {
+		const auto r = encoder->Read(buffer);
+		if (r.empty())
+			break;
+
+		auto data = std::make_shared<const AllocatedArray<std::byte>>(r);
+		if (collecting_header)
+			header.push_back(data);
+
+		chunks_size += r.size();
+		chunks.push_back({std::move(data), tag_serial});
+	}
+
+	Trim();
+}
+
+void
+SharedEncoderBus::AppendHistory(std::span<const std::byte> src) noexcept
+{
+	if (history.size() + src.size() > 2 * HISTORY_SIZE) {
+		/* discard old data in bulk to keep this cheap */
+		const std::size_t keep =
+			std::min(history.size(), HISTORY_SIZE);
+		history.erase(history.begin(),
+			      std::prev(history.end(), keep));
+	}
+
+	history.insert(history.end(), src.begin(), src.end());
+}
+
+void
+SharedEncoderBus::Encode(std::span<const std::byte> src)
+{
+	collecting_header = false;
+
+	encoder->Write(src);
+	AppendHistory(src);
+	position += src.size();
+
+	Drain();
+}
+
+void
+SharedEncoderBus::Trim() noexcept
+{
+	if (subscribers.empty())
+		/* keep the header for the first subscriber, which is
+		   about to be registered */
+		return;
+
+	uint_least64_t min = GetEndChunk();
+	for (const auto &i : subscribers)
+		min = std::min(min, i.next_chunk);
+
+	while (!chunks.empty() &&
+	       (first_chunk < min || chunks_size > MAX_BUFFERED)) {
+		chunks_size -= chunks.front().data->size();
+		chunks.pop_front();
+		++first_chunk;
+	}
+}
+
+void
+SharedEncoderBus::Reset() noexcept
+{
+	assert(subscribers.empty());
+
+	encoder.reset();
+	first_chunk += chunks.size();
+	chunks.clear();
+	chunks_size = 0;
+	header.clear();
+	collecting_header = false;
+	ended = false;
+	last_tag.reset();
+	history.clear();
+	history.shrink_to_fit();
+}
+
+Encoder *
+SharedEncoderBus::Open(const std::shared_ptr<SharedEncoderBus> &self,
+		       AudioFormat &audio_format)
+{
+	const std::scoped_lock lock{mutex};
+
+	const bool first = encoder == nullptr;
+	if (first) {
+		const AudioFormat requested = audio_format;
+		encoder.reset(prepared->Open(audio_format));
+		input_format = requested;
+		output_format = audio_format;
+
+		/* the first data from the encoder is the header */
+		collecting_header = true;
+		Drain();
+	} else if (ended || audio_format != input_format) {
+		/* cannot share this one */
+		return prepared->Open(audio_format);
+	} else
+		audio_format = output_format;
+
+	auto *e = new SharedEncoder(self, encoder->ImplementsTag());
+	e->position = position;
+	e->tag_serial = tag_serial;
+
+	if (first) {
+		e->next_chunk = first_chunk;
+	} else {
+		e->next_chunk = GetEndChunk();
+		e->pending_header.assign(header.begin(), header.end());
+	}
+
+	subscribers.push_back(*e);
+	return e;
+}
+
+SharedEncoder::~SharedEncoder() noexcept
+{
+	if (private_encoder)
+		return;
+
+	const std::scoped_lock lock{bus->mutex};
+	bus->subscribers.erase(bus->subscribers.iterator_to(*this));
+
+	if (bus->subscribers.empty())
+		bus->Reset();
+	else
+		bus->Trim();
+}
+
+void
+SharedEncoder::Detach()
+{
+	assert(!private_encoder);
+
+	FmtInfo(shared_encoder_domain,
+		"Input of shared {:?} encoder differs, using a private one",
+		bus->GetMimeType() != nullptr ? bus->GetMimeType() : "");
+
+	AudioFormat audio_format = bus->input_format;
+	private_encoder.reset(bus->prepared->Open(audio_format));
+	assert(audio_format == bus->output_format);
+
+	bus->subscribers.erase(bus->subscribers.iterator_to(*this));
+	bus->Trim();
+
+	pending_header.clear();
+}
+
+void
+SharedEncoder::End()
+{
+	if (private_encoder) {
+		private_encoder->End();
+		return;
+	}
+
+	const std::scoped_lock lock{bus->mutex};
+
+	/* only the last subscriber may end the stream; all others
+	   just stop reading */
+	if (bus->subscribers.size() == 1 && !bus->ended) {
+		bus->ended = true;
+		bus->encoder->End();
+		bus->Drain();
+	}
+}
+
+void
+SharedEncoder::Flush()
+{
+	if (private_encoder) {
+		private_encoder->Flush();
+		return;
+	}
+
+	const std::scoped_lock lock{bus->mutex};
+
+	/* only a subscriber which has caught up may flush; the
+	   others will get the data soon anyway */
+	if (position == bus->position && !bus->ended) {
+		bus->encoder->Flush();
+		bus->Drain();
+	}
+}
+
+void
+SharedEncoder::PreTag()
+{
+	if (private_encoder) {
+		private_encoder->PreTag();
+		return;
+	}
+
+	/* postponed until SendTag(), because another subscriber
+	   may have sent this tag already */
+}
+
+void
+SharedEncoder::SendTag(const Tag &tag)
+{
+	if (private_encoder) {
+		private_encoder->SendTag(tag);
+		return;
+	}
+
+	const std::scoped_lock lock{bus->mutex};
+
+	if (bus->ended)
+		return;
+
+	if (bus->last_tag == nullptr || !IsSameTag(*bus->last_tag, tag)) {
+		bus->encoder->PreTag();
+		bus->Drain();
+
+		++bus->tag_serial;
+		bus->encoder->SendTag(tag);
+
+		/* a new stream begins here */
+		bus->header.clear();
+		bus->collecting_header = true;
+		bus->Drain();
+
+		bus->last_tag = std::make_unique<Tag>(tag);
+	}
+
+	tag_serial = bus->tag_serial;
+}
+
+void
+SharedEncoder::Write(std::span<const std::byte> src)
+{
+	if (private_encoder) {
+		private_encoder->Write(src);
+		return;
+	}
+
+	const std::scoped_lock lock{bus->mutex};
+	assert(position <= bus->position);
+
+	if (bus->ended)
+		return;
+
+	if (position < bus->position) {
+		/* another subscriber has already encoded this; just
+		   check that it was the same data */
+		const auto overlap = std::min<uint_least64_t>(bus->position - position,
+							      src.size());
+		if (bus->Verify(position, src.first(overlap))) {
+			resyncs = 0;
+			position += overlap;
+			src = src.subspan(overlap);
+			if (src.empty())
+				return;
+		} else if (++resyncs >= 2) {
+			/* this subscriber gets different input than
+			   the others */
+			Detach();
+			private_encoder->Write(src);
+			return;
+		} else {
+			/* probably a gap (e.g. silence written by a
+			   paused output); continue at the current
+			   position */
+			position = bus->position;
+		}
+	}
+
+	bus->Encode(src);
+	position += src.size();
+}
+
+std::span<const std::byte>
+SharedEncoder::Read(std::span<std::byte> buffer) noexcept
+{
+	if (private_encoder)
+		return private_encoder->Read(buffer);
+
+	const std::scoped_lock lock{bus->mutex};
+
+	if (!pending_header.empty()) {
+		current = std::move(pending_header.front());
+		pending_header.pop_front();
+		return *current;
+	}
+
+	/* skip chunks which were discarded because this subscriber
+	   was too slow */
+	next_chunk = std::max(next_chunk, bus->first_chunk);
+
+	if (next_chunk >= bus->GetEndChunk()) {
+		current.reset();
+		return {};
+	}
+
+	const auto &chunk = bus->chunks[next_chunk - bus->first_chunk];
+	if (chunk.tag_serial > tag_serial) {
+		/* this chunk belongs to a new stream; wait until
+		   this subscriber has sent the tag, too */
+		current.reset();
+		return {};
+	}
+
+	current = chunk.data;
+	++next_chunk;
+	bus->Trim();
+
+	return *current;
+}
+
+PreparedEncoder *
+MakeSharedEncoder(std::string &&key,
+		  std::unique_ptr<PreparedEncoder> prepared) noexcept
+{
+	static Mutex registry_mutex;
+	static std::map<std::string, std::weak_ptr<SharedEncoderBus>, std::less<>> registry;
+
+	const std::scoped_lock lock{registry_mutex};
+
+	auto &slot = registry[std::move(key)];
+	auto bus = slot.lock();
+	if (!bus) {
+		bus = std::make_shared<SharedEncoderBus>(std::move(prepared));
+		slot = bus;
+	}
+
+	return new SharedPreparedEncoder(std::move(bus));
+}
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ENCODER_SHARED_HXX
+#define MPD_ENCODER_SHARED_HXX
+
+#include <memory>
+#include <string>
+
+class PreparedEncoder;
+
+/**
+ * Wrap a #PreparedEncoder so that all outputs with the same key
+ * share one #Encoder instance: the PCM data is encoded only once,
+ * and every output reads the same encoded stream.
+ *
+ * This assumes that all outputs feed the same PCM data into the
+ * encoder.  If one output's input differs (e.g. because it has been
+ * moved to another partition), it gets a private #Encoder.
+ *
+ * @param key identifies the encoder configuration; outputs with
+ * the same key share an #Encoder
+ * @param prepared the encoder configuration; it is discarded if
+ * there is already one with the same key
+ */
+PreparedEncoder *
+MakeSharedEncoder(std::string &&key,
+		  std::unique_ptr<PreparedEncoder> prepared) noexcept;
+
+#endif
@@ -7,22 +7,62 @@
 #include "pcm/AudioFormat.hxx"
 #include "pcm/Buffer.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "util/Domain.hxx"
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/Serial.hxx"
 #include "util/SpanCast.hxx"
 #include "util/StringUtil.hxx"
+#include "Log.hxx"
 
 #include <FLAC/stream_encoder.h>
 #include <FLAC/metadata.h>
 
 #include <algorithm>
+#include <string>
+
+static constexpr Domain flac_encoder_domain("flac_encoder");
+
+/**
+ * Settings passed to libFLAC each time the encoder is initialized.
+ */
+struct FlacEncoderSettings {
+	unsigned compression;
+
+	/**
+	 * The number of samples per frame; 0 means the default of
+	 * the compression level.
+	 */
+	unsigned blocksize;
+
+	/**
+	 * The number of encoder threads (libFLAC 1.5 or newer).
+	 */
+	unsigned threads;
+
+	/**
+	 * A libFLAC apodization specification; empty means the
+	 * default of the compression level.
+	 */
+	std::string apodization;
+
+	bool oggflac;
+};
 
 class FlacEncoder final : public Encoder {
 	const AudioFormat audio_format;
 
 	FLAC__StreamEncoder *const fse;
-	const unsigned compression;
-	const bool oggflac;
+	const FlacEncoderSettings settings;
+
+	/**
+	 * Read() returns nothing until at least this number of bytes
+	 * is available (unless flushed).
+	 */
+	const std::size_t page_size;
+
+	/* initialize "flush" to true, so the caller gets the full
+	   headers on the first read */
+	bool flush = true;
 
 	PcmBuffer expand_buffer;
 
@@ -33,7 +73,9 @@ class FlacEncoder final : public Encoder {
 	DynamicFifoBuffer<std::byte> output_buffer{8192};
 
 public:
-	FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse, unsigned _compression, bool _oggflac, bool _oggchaining);
+	FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse,
+		    const FlacEncoderSettings &_settings, bool _oggchaining,
+		    std::size_t _page_size);
 
 	~FlacEncoder() noexcept override {
 		FLAC__stream_encoder_delete(fse);
@@ -45,13 +87,16 @@ public:
 	/* virtual methods from class Encoder */
 	void End() override {
 		(void) FLAC__stream_encoder_finish(fse);
+		flush = true;
 	}
 
 	void Flush() override {
+		flush = true;
 	}
 
 	void PreTag() override {
 		(void) FLAC__stream_encoder_finish(fse);
+		flush = true;
 	}
 
 	void SendTag(const Tag &tag) override;
@@ -60,6 +105,14 @@ public:
 
 	std::span<const std::byte> Read(std::span<std::byte>) noexcept override {
 		auto r = output_buffer.Read();
+		if (r.empty()) {
+			flush = false;
+			return {};
+		}
+
+		if (r.size() < page_size && !flush)
+			return {};
+
 		output_buffer.Consume(r.size());
 		return r;
 	}
@@ -78,9 +131,9 @@ private:
 };
 
 class PreparedFlacEncoder final : public PreparedEncoder {
-	const unsigned compression;
+	FlacEncoderSettings settings;
 	const bool oggchaining;
-	const bool oggflac;
+	const std::size_t page_size;
 
 public:
 	explicit PreparedFlacEncoder(const ConfigBlock &block);
@@ -89,17 +142,36 @@ public:
 	Encoder *Open(AudioFormat &audio_format) override;
 
 	[[nodiscard]] const char *GetMimeType() const noexcept override {
-		if(oggflac)
+		if(settings.oggflac)
 			return  "audio/ogg";
 		return "audio/flac";
 	}
 };
 
 PreparedFlacEncoder::PreparedFlacEncoder(const ConfigBlock &block)
-	:compression(block.GetBlockValue("compression", 5U)),
-	oggchaining(block.GetBlockValue("oggchaining",false)),
-	oggflac(block.GetBlockValue("oggflac",false) || oggchaining)
+	:oggchaining(block.GetBlockValue("oggchaining",false)),
+	page_size(block.GetBlockValue("page_size", 0U))
 {
+	settings.compression = block.GetBlockValue("compression", 5U);
+
+	settings.blocksize = block.GetBlockValue("blocksize", 0U);
+	if (settings.blocksize != 0 &&
+	    (settings.blocksize < 16 || settings.blocksize > 65535))
+		throw FmtRuntimeError("invalid blocksize {} in line {}",
+				      settings.blocksize, block.line);
+
+	settings.threads = block.GetPositiveValue("threads", 1U);
+#if FLAC_API_VERSION_CURRENT < 14
+	if (settings.threads > 1) {
+		FmtWarning(flac_encoder_domain,
+			   "multi-threaded encoding requires libFLAC 1.5 (line {})",
+			   block.line);
+		settings.threads = 1;
+	}
+#endif
+
+	settings.apodization = block.GetBlockValue("apodization", "");
+	settings.oggflac = block.GetBlockValue("oggflac",false) || oggchaining;
 }
 
 static PreparedEncoder *
@@ -109,7 +181,8 @@ flac_encoder_init(const ConfigBlock &block)
 }
 
 static void
-flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression, bool oggflac,
+flac_encoder_setup(FLAC__StreamEncoder *fse,
+		   const FlacEncoderSettings &settings,
 		   const AudioFormat &audio_format)
 {
 	unsigned bits_per_sample;
@@ -127,9 +200,34 @@ flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression, bool oggflac,
 		bits_per_sample = 24;
 	}
 
-	if (!FLAC__stream_encoder_set_compression_level(fse, compression))
+	if (!FLAC__stream_encoder_set_compression_level(fse, settings.compression))
 		throw FmtRuntimeError("error setting flac compression to {}",
-				      compression);
+				      settings.compression);
+
+	/* these override the defaults implied by the compression
+	   level; larger blocks mean fewer (but larger) frames */
+	if (settings.blocksize != 0 &&
+	    !FLAC__stream_encoder_set_blocksize(fse, settings.blocksize))
+		throw FmtRuntimeError("error setting flac block size to {}",
+				      settings.blocksize);
+
+	if (!settings.apodization.empty() &&
+	    !FLAC__stream_encoder_set_apodization(fse, settings.apodization.c_str()))
+		throw FmtRuntimeError("error setting flac apodization to {:?}",
+				      settings.apodization);
+
+#if FLAC_API_VERSION_CURRENT >= 14
+	if (settings.threads > 1) {
+		const auto status =
+			FLAC__stream_encoder_set_num_threads(fse, settings.threads);
+		if (status != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK)
+			/* not fatal: libFLAC may have been built
+			   without thread support */
+			FmtWarning(flac_encoder_domain,
+				   "failed to enable {} encoder threads (error {})",
+				   settings.threads, unsigned(status));
+	}
+#endif
 
 	if (!FLAC__stream_encoder_set_channels(fse, audio_format.channels))
 		throw FmtRuntimeError("error setting flac channels num to {}",
@@ -144,20 +242,22 @@ flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression, bool oggflac,
 		throw FmtRuntimeError("error setting flac sample rate to {}",
 				      audio_format.sample_rate);
 
-	if (oggflac && !FLAC__stream_encoder_set_ogg_serial_number(fse,
+	if (settings.oggflac && !FLAC__stream_encoder_set_ogg_serial_number(fse,
 						  GenerateSerial()))
 		throw std::runtime_error{"error setting ogg serial number"};
 }
 
-FlacEncoder::FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse, unsigned _compression, bool _oggflac, bool _oggchaining)
+FlacEncoder::FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse,
+			 const FlacEncoderSettings &_settings,
+			 bool _oggchaining, std::size_t _page_size)
 	:Encoder(_oggchaining),
 	 audio_format(_audio_format), fse(_fse),
-	 compression(_compression),
-	 oggflac(_oggflac)
+	 settings(_settings),
+	 page_size(_page_size)
 {
 	/* this immediately outputs data through callback */
 
-	auto init_status = oggflac ?
+	auto init_status = settings.oggflac ?
 		FLAC__stream_encoder_init_ogg_stream(fse,
 						     nullptr, WriteCallback,
 						     nullptr, nullptr, nullptr,
@@ -196,20 +296,21 @@ PreparedFlacEncoder::Open(AudioFormat &audio_format)
 		throw std::runtime_error("FLAC__stream_encoder_new() failed");
 
 	try {
-		flac_encoder_setup(fse, compression, oggflac, audio_format);
+		flac_encoder_setup(fse, settings, audio_format);
 	} catch (...) {
 		FLAC__stream_encoder_delete(fse);
 		throw;
 	}
 
-	return new FlacEncoder(audio_format, fse, compression, oggflac, oggchaining);
+	return new FlacEncoder(audio_format, fse, settings,
+			       oggchaining, page_size);
 }
 
 void
 FlacEncoder::SendTag(const Tag &tag)
 {
 	/* re-initialize encoder since flac_encoder_finish resets everything */
-	flac_encoder_setup(fse, compression, oggflac, audio_format);
+	flac_encoder_setup(fse, settings, audio_format);
 
 	FLAC__StreamMetadata *metadata = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
 	FLAC__StreamMetadata_VorbisComment_Entry entry;
@@ -233,6 +334,8 @@ FlacEncoder::SendTag(const Tag &tag)
 	if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
 		throw FmtRuntimeError("failed to initialize encoder: {}",
 				      FLAC__StreamEncoderInitStatusString[init_status]);
+	/* deliver the new headers right away */
+	flush = true;
 }
 
 template<typename T>
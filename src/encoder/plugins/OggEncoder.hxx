@@ -20,12 +20,20 @@ class OggEncoder : public Encoder {
 	   headers on the first read */
 	bool flush = true;
 
+	/**
+	 * The minimum body size of an Ogg page (unless flushed), or 0
+	 * for the libogg default.  Larger pages mean less overhead
+	 * and fewer writes to the clients, but more delay.
+	 */
+	const int page_size;
+
 protected:
 	OggStreamState stream;
 
 public:
-	OggEncoder(bool _implements_tag)
+	explicit OggEncoder(bool _implements_tag, int _page_size=0)
 		:Encoder(_implements_tag),
+		 page_size(_page_size),
 		 stream(GenerateSerial()) {
 	}
 
@@ -36,7 +44,9 @@ public:
 
 	std::span<const std::byte> Read(std::span<std::byte> buffer) noexcept override {
 		ogg_page page;
-		bool success = stream.PageOut(page);
+		bool success = page_size > 0
+			? stream.PageOut(page, page_size)
+			: stream.PageOut(page);
 		if (!success) {
 			if (flush) {
 				flush = false;
@@ -38,7 +38,9 @@ class OpusEncoder final : public OggEncoder {
 	ogg_int64_t granulepos = 0;
 
 public:
-	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining);
+	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+		    std::size_t _buffer_frames, int _page_size,
+		    bool _chaining);
 	~OpusEncoder() noexcept override;
 
 	OpusEncoder(const OpusEncoder &) = delete;
@@ -62,11 +64,23 @@ private:
 
 class PreparedOpusEncoder final : public PreparedEncoder {
 	opus_int32 bitrate;
+	int application;
 	int complexity;
 	int signal;
 	int packet_loss;
 	int vbr;
 	int vbr_constraint;
+
+	/**
+	 * The number of frames (at 48 kHz) per Opus packet.
+	 */
+	unsigned packet_frames;
+
+	/**
+	 * See OggEncoder::page_size.
+	 */
+	unsigned page_size;
+
 	const bool chaining;
 
 public:
@@ -80,6 +94,33 @@ public:
 	}
 };
 
+/**
+ * Parse the "frame_duration" setting (in milliseconds).
+ *
+ * @return the number of frames at 48 kHz
+ */
+static unsigned
+ParseOpusFrameDuration(const char *value)
+{
+	static constexpr struct {
+		const char *name;
+		unsigned frames;
+	} durations[] = {
+		{ "2.5", 120 },
+		{ "5", 240 },
+		{ "10", 480 },
+		{ "20", 960 },
+		{ "40", 1920 },
+		{ "60", 2880 },
+	};
+
+	for (const auto &i : durations)
+		if (strcmp(i.name, value) == 0)
+			return i.frames;
+
+	throw std::runtime_error("Invalid frame duration");
+}
+
 PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 	:chaining(block.GetBlockValue("opustags", false))
 {
@@ -96,6 +137,16 @@ PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 			throw std::runtime_error("Invalid bit rate");
 	}
 
+	value = block.GetBlockValue("application", "audio");
+	if (strcmp(value, "audio") == 0)
+		application = OPUS_APPLICATION_AUDIO;
+	else if (strcmp(value, "voip") == 0)
+		application = OPUS_APPLICATION_VOIP;
+	else if (strcmp(value, "lowdelay") == 0)
+		application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+	else
+		throw std::runtime_error("Invalid application");
+
 	complexity = block.GetBlockValue("complexity", 10U);
 	if (complexity > 10)
 		throw std::runtime_error("Invalid complexity");
@@ -126,6 +177,13 @@ PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 	packet_loss = block.GetBlockValue("packet_loss", 0U);
 	if (packet_loss > 100)
 		throw std::runtime_error("Invalid packet loss");
+
+	packet_frames = ParseOpusFrameDuration(block.GetBlockValue("frame_duration",
+								   "20"));
+
+	page_size = block.GetBlockValue("page_size", 0U);
+	if (page_size > 65025)
+		throw std::runtime_error("Invalid page size");
 }
 
 PreparedEncoder *
@@ -134,11 +192,13 @@ opus_encoder_init(const ConfigBlock &block)
 	return new PreparedOpusEncoder(block);
 }
 
-OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining)
-	:OggEncoder(_chaining),
+OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+			 std::size_t _buffer_frames, int _page_size,
+			 bool _chaining)
+	:OggEncoder(_chaining, _page_size),
 	 audio_format(_audio_format),
 	 frame_size(_audio_format.GetFrameSize()),
-	 buffer_frames(_audio_format.sample_rate / 50),
+	 buffer_frames(_buffer_frames),
 	 buffer_size(frame_size * buffer_frames),
 	 buffer(new std::byte[buffer_size]),
 	 enc(_enc)
@@ -173,7 +233,7 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format)
 	int error_code;
 	auto *enc = opus_encoder_create(audio_format.sample_rate,
 					audio_format.channels,
-					OPUS_APPLICATION_AUDIO,
+					application,
 					&error_code);
 	if (enc == nullptr)
 		throw std::runtime_error(opus_strerror(error_code));
@@ -185,7 +245,8 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format)
 	opus_encoder_ctl(enc, OPUS_SET_VBR_CONSTRAINT(vbr_constraint));
 	opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(packet_loss));
 
-	return new OpusEncoder(audio_format, enc, chaining);
+	return new OpusEncoder(audio_format, enc, packet_frames, page_size,
+			       chaining);
 }
 
 OpusEncoder::~OpusEncoder() noexcept
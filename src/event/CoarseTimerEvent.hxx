@@ -17,7 +17,8 @@ class EventLoop;
  * Unlike #FineTimerEvent, this class has a granularity of about 1
  * second, and is optimized for timeouts between 1 and 60 seconds
  * which are often canceled before they expire (i.e. optimized for
- * fast insertion and deletion, at the cost of granularity).
+ * fast insertion and deletion, at the cost of granularity).  Longer
+ * timeouts are kept in a coarser wheel until they approach.
  *
  * This class is not thread-safe, all methods must be called from the
  * thread that runs the #EventLoop, except where explicitly documented
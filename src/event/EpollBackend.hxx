@@ -12,7 +12,11 @@ class EpollBackendResult
 {
 	friend class EpollBackend;
 
-	std::array<epoll_event, 16> events;
+	/**
+	 * Large enough to collect the events of many busy sockets
+	 * with a single epoll_wait() call.
+	 */
+	std::array<epoll_event, 256> events;
 	size_t n_events = 0;
 
 public:
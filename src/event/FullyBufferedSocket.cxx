@@ -4,14 +4,41 @@
 #include "FullyBufferedSocket.hxx"
 #include "net/SocketError.hxx"
 
+#include <array>
 #include <cassert>
 
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/socket.h> // for MSG_DONTWAIT
+#include <sys/uio.h> // for struct iovec
+#endif
+
+/**
+ * The maximum number of buffer pieces submitted with one sendmsg()
+ * call.
+ */
+static constexpr std::size_t MAX_WRITE_VECTOR = 16;
+
 inline FullyBufferedSocket::ssize_t
-FullyBufferedSocket::DirectWrite(std::span<const std::byte> src) noexcept
+FullyBufferedSocket::DirectWrite() noexcept
 {
-	const auto nbytes = GetSocket().WriteNoWait(src);
+#ifdef _WIN32
+	const auto nbytes = GetSocket().WriteNoWait(output.Read());
+#else
+	/* send all buffer pieces with one system call */
+	std::array<std::span<const std::byte>, MAX_WRITE_VECTOR> pieces;
+	const std::size_t n = output.Read(pieces);
+	assert(n > 0);
+
+	std::array<struct iovec, MAX_WRITE_VECTOR> v;
+	for (std::size_t i = 0; i < n; ++i)
+		v[i] = {const_cast<std::byte *>(pieces[i].data()), pieces[i].size()};
+
+	const auto nbytes = GetSocket().Send(std::span{v}.first(n),
+					     MSG_DONTWAIT);
+#endif
+
 	if (nbytes < 0) [[unlikely]] {
 		const auto code = GetSocketError();
 		if (IsSocketErrorSendWouldBlock(code))
@@ -34,14 +61,13 @@ FullyBufferedSocket::Flush() noexcept
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.empty()) {
+	if (output.empty()) {
 		idle_event.Cancel();
 		event.CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data);
+	auto nbytes = DirectWrite();
 	if (nbytes <= 0) [[unlikely]]
 		return nbytes == 0;
 
@@ -50,31 +76,45 @@ FullyBufferedSocket::Flush() noexcept
 	if (output.empty()) {
 		idle_event.Cancel();
 		event.CancelWrite();
+
+		OnSocketDrained();
+
+		/* the method may have closed the socket */
+		return IsDefined();
 	}
 
 	return true;
 }
 
 bool
-FullyBufferedSocket::Write(const void *data, size_t length) noexcept
+FullyBufferedSocket::TryWrite(std::span<const std::byte> src) noexcept
 {
 	assert(IsDefined());
 
-	if (length == 0)
+	if (src.empty())
 		return true;
 
 	const bool was_empty = output.empty();
 
-	if (!output.Append({(const std::byte *)data, length})) {
-		OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+	if (!output.Append(src))
 		return false;
-	}
 
 	if (was_empty)
 		idle_event.Schedule();
 	return true;
 }
 
+bool
+FullyBufferedSocket::Write(const void *data, size_t length) noexcept
+{
+	if (!TryWrite({(const std::byte *)data, length})) {
+		OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+		return false;
+	}
+
+	return true;
+}
+
 void
 FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 {
@@ -92,6 +132,8 @@ FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 void
 FullyBufferedSocket::OnIdle() noexcept
 {
-	if (Flush() && !output.empty())
+	/* if OnSocketDrained() has appended new data, then the
+	   IdleEvent has been scheduled again */
+	if (Flush() && !output.empty() && !idle_event.IsPending())
 		event.ScheduleWrite();
 }
@@ -37,13 +37,24 @@ public:
 		return output.max_size();
 	}
 
+	bool IsOutputEmpty() const noexcept {
+		return output.empty();
+	}
+
+	std::size_t GetOutputAllocatedSize() const noexcept {
+		return output.GetAllocatedSize();
+	}
+
 private:
 	/**
+	 * Write as much of the output buffer as possible to the
+	 * socket (all pieces with one system call).
+	 *
 	 * @return the number of bytes written to the socket, 0 if the
 	 * socket isn't ready for writing, -1 on error (the socket has
 	 * been closed and probably destructed)
 	 */
-	ssize_t DirectWrite(std::span<const std::byte> src) noexcept;
+	ssize_t DirectWrite() noexcept;
 
 protected:
 	/**
@@ -58,8 +69,23 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+	/**
+	 * Like Write(), but a full output buffer is not an error.
+	 *
+	 * @return false if the output buffer is full (nothing has
+	 * been appended)
+	 */
+	bool TryWrite(std::span<const std::byte> src) noexcept;
+
 	void OnIdle() noexcept;
 
+	/**
+	 * The output buffer has just become empty, i.e. all pending
+	 * data has been sent to the socket.  This method may call
+	 * Write().
+	 */
+	virtual void OnSocketDrained() noexcept {}
+
 	/* virtual methods from class BufferedSocket */
 	void OnSocketReady(unsigned flags) noexcept override;
 };
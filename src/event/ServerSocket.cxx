@@ -39,6 +39,12 @@ class ServerSocket::OneServerSocket final {
 
 	const AllocatedSocketAddress address;
 
+	/**
+	 * Set SO_REUSEPORT?  This is used for sockets which share
+	 * their address with sockets in other #EventLoops.
+	 */
+	bool reuse_port = false;
+
 public:
 	template<typename A>
 	OneServerSocket(EventLoop &_loop, ServerSocket &_parent,
@@ -65,6 +71,12 @@ public:
 		return serial;
 	}
 
+	void SetReusePort() noexcept {
+		assert(!IsDefined());
+
+		reuse_port = true;
+	}
+
 #ifdef HAVE_UN
 	void SetPath(AllocatedPath &&_path) noexcept {
 		assert(path.IsNull());
@@ -93,7 +105,13 @@ public:
 		event.ScheduleRead();
 	}
 
-	void Accept() noexcept;
+	/**
+	 * Accept one pending connection.
+	 *
+	 * @return false if no connection was pending or if accept()
+	 * has failed
+	 */
+	bool Accept() noexcept;
 
 private:
 	void OnSocketReady(unsigned flags) noexcept;
@@ -101,6 +119,18 @@ private:
 
 static constexpr Domain server_socket_domain("server_socket");
 
+/**
+ * The listen() backlog.  It must be large enough for many clients
+ * connecting at the same time (e.g. after a restart).
+ */
+static constexpr int LISTEN_BACKLOG = 256;
+
+/**
+ * The maximum number of connections accepted in one
+ * OneServerSocket::OnSocketReady() call.
+ */
+static constexpr unsigned MAX_ACCEPTS_PER_WAKEUP = 64;
+
 static int
 get_remote_uid(int fd)
 {
@@ -126,34 +156,53 @@ get_remote_uid(int fd)
 #endif
 }
 
-inline void
+inline bool
 ServerSocket::OneServerSocket::Accept() noexcept
 {
 	StaticSocketAddress peer_address;
 	UniqueSocketDescriptor peer_fd(event.GetSocket().AcceptNonBlock(peer_address));
 	if (!peer_fd.IsDefined()) {
-		const SocketErrorMessage msg;
+		const auto code = GetSocketError();
+		if (IsSocketErrorAcceptWouldBlock(code))
+			return false;
+
+		const SocketErrorMessage msg(code);
 		FmtError(server_socket_domain,
 			 "accept() failed: {}", (const char *)msg);
-		return;
+		return false;
 	}
 
-	if (!peer_fd.SetKeepAlive()) {
+	/* skip system calls which are useless for this socket
+	   family; this matters when many clients reconnect at the
+	   same time */
+#ifdef HAVE_UN
+	const bool is_local = address.GetFamily() == AF_LOCAL;
+#else
+	constexpr bool is_local = false;
+#endif
+
+	if (!is_local && !peer_fd.SetKeepAlive()) {
 		const SocketErrorMessage msg;
 		FmtError(server_socket_domain,
 			 "Could not set TCP keepalive option: {}",
 			 (const char *)msg);
 	}
 
-	const auto uid = get_remote_uid(peer_fd.Get());
+	const int uid = is_local ? get_remote_uid(peer_fd.Get()) : -1;
 
 	parent.OnAccept(std::move(peer_fd), peer_address, uid);
+	return true;
 }
 
 void
 ServerSocket::OneServerSocket::OnSocketReady([[maybe_unused]] unsigned flags) noexcept
 {
-	Accept();
+	/* accept all pending connections at once instead of waking
+	   up once per connection; the limit keeps a connection storm
+	   from starving the other events */
+	for (unsigned i = 0; i < MAX_ACCEPTS_PER_WAKEUP; ++i)
+		if (!Accept())
+			break;
 }
 
 inline void
@@ -163,7 +212,7 @@ ServerSocket::OneServerSocket::Open()
 
 	auto _fd = socket_bind_listen(address.GetFamily(),
 				      SOCK_STREAM, 0,
-				      address, 5);
+				      address, LISTEN_BACKLOG, reuse_port);
 
 #ifdef HAVE_TCP
 	if (parent.dscp_class >= 0) {
@@ -278,6 +327,27 @@ ServerSocket::AddAddress(A &&address) noexcept
 	return sockets.back();
 }
 
+template<typename A>
+inline void
+ServerSocket::AddTCPAddress(A &&address) noexcept
+{
+	OneServerSocket &s = AddAddress(std::forward<A>(address));
+
+#ifdef __linux__
+	if (reuse_port_loops.empty())
+		return;
+
+	s.SetReusePort();
+
+	/* the additional sockets have the same serial, so Open()
+	   logs a failure to bind one of them, but does not fail */
+	for (EventLoop *l : reuse_port_loops)
+		sockets.emplace_back(*l, *this, next_serial,
+				     AllocatedSocketAddress{s.GetAddress()})
+			.SetReusePort();
+#endif
+}
+
 void
 ServerSocket::AddFD(UniqueSocketDescriptor fd)
 {
@@ -308,7 +378,7 @@ ServerSocket::AddFD(UniqueSocketDescriptor fd,
 inline void
 ServerSocket::AddPortIPv4(unsigned port) noexcept
 {
-	AddAddress(IPv4Address(port));
+	AddTCPAddress(IPv4Address(port));
 }
 
 #ifdef HAVE_IPV6
@@ -316,7 +386,7 @@ ServerSocket::AddPortIPv4(unsigned port) noexcept
 inline void
 ServerSocket::AddPortIPv6(unsigned port) noexcept
 {
-	AddAddress(IPv6Address(port));
+	AddTCPAddress(IPv6Address(port));
 }
 
 /**
@@ -360,7 +430,7 @@ ServerSocket::AddHost(const char *hostname, unsigned port)
 #ifdef HAVE_TCP
 	for (const auto &i : Resolve(hostname, port,
 				     AI_PASSIVE, SOCK_STREAM))
-		AddAddress(i);
+		AddTCPAddress(i);
 
 	++next_serial;
 #else /* HAVE_TCP */
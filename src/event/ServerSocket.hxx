@@ -8,6 +8,7 @@
 
 #include <cassert>
 #include <list>
+#include <vector>
 
 class SocketAddress;
 class AllocatedSocketAddress;
@@ -35,6 +36,14 @@ class ServerSocket {
 
 	unsigned next_serial = 1;
 
+#ifdef __linux__
+	/**
+	 * Additional #EventLoops which accept connections on TCP
+	 * listeners; see AddReusePortLoop().
+	 */
+	std::vector<EventLoop *> reuse_port_loops;
+#endif
+
 public:
 	ServerSocket(EventLoop &_loop) noexcept;
 	~ServerSocket() noexcept;
@@ -51,10 +60,36 @@ public:
 	}
 #endif
 
+#ifdef __linux__
+	/**
+	 * Bind each TCP listener added after this call once more
+	 * (with SO_REUSEPORT) and accept connections on this
+	 * additional socket in the given #EventLoop.  The kernel
+	 * distributes incoming connections among all sockets bound to
+	 * the same address, so OnAccept() may then be called in this
+	 * #EventLoop's thread.
+	 *
+	 * Local sockets and sockets added with AddFD() are not
+	 * affected.  Must be called before adding any address.
+	 */
+	void AddReusePortLoop(EventLoop &_loop) noexcept {
+		assert(sockets.empty());
+
+		reuse_port_loops.push_back(&_loop);
+	}
+#endif
+
 private:
 	template<typename A>
 	OneServerSocket &AddAddress(A &&address) noexcept;
 
+	/**
+	 * Add a TCP listener, and another one for each of the
+	 * #reuse_port_loops.
+	 */
+	template<typename A>
+	void AddTCPAddress(A &&address) noexcept;
+
 	/**
 	 * Add a listener on a port on all IPv4 interfaces.
 	 *
@@ -133,6 +168,11 @@ public:
 	void Close() noexcept;
 
 protected:
+	/**
+	 * A connection has been accepted.  This is called in the
+	 * thread of the #EventLoop which runs the listener socket
+	 * (see AddReusePortLoop()).
+	 */
 	virtual void OnAccept(UniqueSocketDescriptor fd,
 			      SocketAddress address, int uid) noexcept = 0;
 };
@@ -4,7 +4,6 @@
 #include "Thread.hxx"
 #include "thread/Name.hxx"
 #include "thread/Slack.hxx"
-#include "thread/Util.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
@@ -39,16 +38,16 @@ EventThread::Run() noexcept
 {
 	SetThreadName(realtime ? "rtio" : "io");
 
-	if (realtime) {
+	if (realtime)
 		SetThreadTimerSlack(std::chrono::microseconds(10));
 
-		try {
-			SetThreadRealtime();
-		} catch (...) {
-			FmtInfo(event_domain,
-				"RTIOThread could not get realtime scheduling, continuing anyway: {}",
-				std::current_exception());
-		}
+	try {
+		scheduling.Apply(realtime);
+	} catch (...) {
+		FmtInfo(event_domain,
+			"{} could not apply scheduling settings, continuing anyway: {}",
+			realtime ? "RTIOThread" : "IOThread",
+			std::current_exception());
 	}
 
 	event_loop.Run();
@@ -6,6 +6,7 @@
 
 #include "Loop.hxx"
 #include "thread/Thread.hxx"
+#include "thread/Scheduling.hxx"
 
 /**
  * A thread which runs an #EventLoop.
@@ -17,6 +18,8 @@ class EventThread final {
 
 	const bool realtime;
 
+	ThreadScheduling scheduling;
+
 public:
 	explicit EventThread(bool _realtime=false)
 		:event_loop(ThreadId::Null()), thread(BIND_THIS_METHOD(Run)),
@@ -30,6 +33,14 @@ public:
 		return event_loop;
 	}
 
+	/**
+	 * Configure the CPU affinity and priority of this thread.
+	 * Must be called before Start().
+	 */
+	void SetScheduling(const ThreadScheduling &_scheduling) noexcept {
+		scheduling = _scheduling;
+	}
+
 	void Start();
 
 	void Stop() noexcept;
@@ -23,11 +23,18 @@ TimerWheel::Insert(CoarseTimerEvent &t,
 {
 	assert(now >= last_time);
 
-	auto &list = t.GetDue() > now
-		? buckets[BucketIndexAt(t.GetDue())]
+	const auto due = t.GetDue();
+
+	auto &list = due <= now
 		/* if this timer is already due, insert it into the
 		   "ready" list to be invoked without delay */
-		: ready;
+		? ready
+		: (due - now < SPAN - RESOLUTION ||
+		   GetBucket1StartTime(due) <= last_time1)
+		? buckets[BucketIndexAt(due)]
+		/* far into the future: the coarse wheel will move it
+		   to the fine wheel later */
+		: buckets1[BucketIndex1At(due)];
 
 	list.push_back(t);
 
@@ -53,6 +60,33 @@ TimerWheel::Run(List &list, Event::TimePoint now) noexcept
 	});
 }
 
+inline void
+TimerWheel::Cascade(Event::TimePoint now) noexcept
+{
+	const auto now1 = GetBucket1StartTime(now);
+	if (now1 <= last_time1)
+		/* still in the same coarse bucket (or time warp) */
+		return;
+
+	/* if a whole rotation has passed, check all buckets */
+	const std::size_t n = std::min<std::size_t>((now1 - last_time1) / RESOLUTION1,
+						    N_BUCKETS1);
+
+	std::size_t i = BucketIndex1At(last_time1);
+	last_time1 = now1;
+
+	for (std::size_t j = 0; j < n; ++j) {
+		i = NextBucketIndex1(i);
+
+		/* Insert() moves each timer to the fine wheel or, if
+		   it is still far away, back to the coarse wheel */
+		auto tmp = std::move(buckets1[i]);
+		tmp.clear_and_dispose([&](auto *t){
+			Insert(*t, now);
+		});
+	}
+}
+
 inline Event::TimePoint
 TimerWheel::GetNextDue(const std::size_t bucket_index,
 		       const Event::TimePoint bucket_start_time) const noexcept
@@ -86,6 +120,12 @@ TimerWheel::GetSleep(Event::TimePoint now) const noexcept
 
 	auto t = GetNextDue(BucketIndexAt(now), GetBucketStartTime(now));
 	assert(t > now);
+
+	if (!IsCoarseEmpty())
+		/* wake up when the next coarse bucket needs to be
+		   cascaded */
+		t = std::min(t, GetBucket1StartTime(now) + RESOLUTION1);
+
 	if (t == Event::TimePoint::max()) {
 		empty = true;
 		return Event::Duration(-1);
@@ -97,6 +137,10 @@ TimerWheel::GetSleep(Event::TimePoint now) const noexcept
 Event::Duration
 TimerWheel::Run(const Event::TimePoint now) noexcept
 {
+	/* move timers which are getting close from the coarse wheel
+	   to the fine wheel (or to the "ready" list) */
+	Cascade(now);
+
 	/* invoke the "ready" list unconditionally */
 	ready.clear_and_dispose([&](auto *t){
 		t->Run();
@@ -15,6 +15,11 @@ class CoarseTimerEvent;
 /**
  * A list of #CoarseTimerEvent instances managed in a circular timer
  * wheel.
+ *
+ * Timers which are due later than #SPAN are kept in a second, coarser
+ * wheel and are moved to the fine one when their time approaches;
+ * this way, long timeouts do not get walked over on every rotation
+ * of the fine wheel.
  */
 class TimerWheel final {
 	static constexpr Event::Duration RESOLUTION = std::chrono::seconds(1);
@@ -24,6 +29,13 @@ class TimerWheel final {
 
 	static constexpr std::size_t N_BUCKETS = SPAN / RESOLUTION;
 
+	/**
+	 * The resolution of the coarse wheel is the span of the
+	 * fine wheel.
+	 */
+	static constexpr Event::Duration RESOLUTION1 = SPAN;
+	static constexpr std::size_t N_BUCKETS1 = 64;
+
 	using List = IntrusiveList<CoarseTimerEvent>;
 
 	/**
@@ -36,6 +48,15 @@ class TimerWheel final {
 	 */
 	std::array<List, N_BUCKETS> buckets;
 
+	/**
+	 * The coarse wheel; each bucket contains timers for one
+	 * #RESOLUTION1.  Timers scheduled further than
+	 * #N_BUCKETS1 * #RESOLUTION1 into the future may sit in
+	 * between; they are put back when their bucket gets
+	 * cascaded.
+	 */
+	std::array<List, N_BUCKETS1> buckets1;
+
 	/**
 	 * A list of timers which are already ready.  This can happen
 	 * if they are scheduled with a zero duration or scheduled in
@@ -51,6 +72,12 @@ class TimerWheel final {
 	 */
 	Event::TimePoint last_time{};
 
+	/**
+	 * The start time of the coarse bucket which was most
+	 * recently cascaded into the fine wheel.
+	 */
+	Event::TimePoint last_time1{};
+
 	/**
 	 * If this flag is true, then all buckets are guaranteed to be
 	 * empty.  If it is false, the buckets may or may not be
@@ -70,7 +97,8 @@ public:
 			std::all_of(buckets.begin(), buckets.end(),
 				    [](const auto &list){
 					    return list.empty();
-				    });
+				    }) &&
+			IsCoarseEmpty();
 	}
 
 	void Insert(CoarseTimerEvent &t,
@@ -97,6 +125,33 @@ private:
 		return t - t.time_since_epoch() % RESOLUTION;
 	}
 
+	static constexpr std::size_t NextBucketIndex1(std::size_t i) noexcept {
+		return (i + 1) % N_BUCKETS1;
+	}
+
+	static constexpr std::size_t BucketIndex1At(Event::TimePoint t) noexcept {
+		return std::size_t(t.time_since_epoch() / RESOLUTION1)
+			% N_BUCKETS1;
+	}
+
+	static constexpr Event::TimePoint GetBucket1StartTime(Event::TimePoint t) noexcept {
+		return t - t.time_since_epoch() % RESOLUTION1;
+	}
+
+	[[gnu::pure]]
+	bool IsCoarseEmpty() const noexcept {
+		return std::all_of(buckets1.begin(), buckets1.end(),
+				   [](const auto &list){
+					   return list.empty();
+				   });
+	}
+
+	/**
+	 * Move the timers of all coarse buckets which have begun
+	 * since the last call into the fine wheel.
+	 */
+	void Cascade(Event::TimePoint now) noexcept;
+
 	/**
 	 * What is the end time of the next non-empty bucket?
 	 *
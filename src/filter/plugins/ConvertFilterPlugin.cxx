@@ -15,7 +15,7 @@ class ConvertFilter final : public Filter {
 	 * The input audio format; PCM data is passed to the filter()
 	 * method in this format.
 	 */
-	const AudioFormat in_audio_format;
+	AudioFormat in_audio_format;
 
 	/**
 	 * This object is only "open" if #in_audio_format !=
@@ -28,6 +28,15 @@ public:
 
 	void Set(const AudioFormat &_out_audio_format);
 
+	void SetInFormat(SampleFormat format) noexcept {
+		if (format == in_audio_format.format)
+			return;
+
+		state.reset();
+		in_audio_format.format = format;
+		out_audio_format = in_audio_format;
+	}
+
 	void Reset() noexcept override {
 		if (state)
 			state->Reset();
@@ -116,3 +125,11 @@ convert_filter_set(Filter *_filter, AudioFormat out_audio_format)
 
 	filter->Set(out_audio_format);
 }
+
+void
+convert_filter_set_in_format(Filter *_filter, SampleFormat format) noexcept
+{
+	auto *filter = (ConvertFilter *)_filter;
+
+	filter->SetInFormat(format);
+}
@@ -4,8 +4,10 @@
 #ifndef MPD_CONVERT_FILTER_PLUGIN_HXX
 #define MPD_CONVERT_FILTER_PLUGIN_HXX
 
+#include <cstdint>
 #include <memory>
 
+enum class SampleFormat : uint8_t;
 class PreparedFilter;
 class Filter;
 struct AudioFormat;
@@ -28,4 +30,13 @@ convert_filter_new(AudioFormat in_audio_format,
 void
 convert_filter_set(Filter *filter, AudioFormat out_audio_format);
 
+/**
+ * Announce that the previous filter in the chain now produces the
+ * given #SampleFormat (see volume_filter_set_out_format()).  This
+ * resets the output audio format; call convert_filter_set()
+ * afterwards.
+ */
+void
+convert_filter_set_in_format(Filter *filter, SampleFormat format) noexcept;
+
 #endif
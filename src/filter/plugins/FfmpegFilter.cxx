@@ -49,6 +49,18 @@ FfmpegFilter::ReadOutput()
 	return Ffmpeg::InterleaveFrame(*frame, interleave_buffer);
 }
 
+void
+FfmpegFilter::Reset() noexcept
+{
+	/* discard all output which has not been read yet; the
+	   internal state of the filters (e.g. delay lines) cannot be
+	   reset without rebuilding the graph */
+	while (av_buffersink_get_frame(&buffer_sink, frame.get()) >= 0)
+		frame.Unref();
+
+	frame.Unref();
+}
+
 std::span<const std::byte>
 FfmpegFilter::FilterPCM(std::span<const std::byte> src)
 {
@@ -52,7 +52,16 @@ public:
 		     AVFilterContext &_buffer_src,
 		     AVFilterContext &_buffer_sink) noexcept;
 
+	/**
+	 * Has Flush() been called?  After that, the graph has
+	 * received EOF and cannot be used again.
+	 */
+	bool IsFlushed() const noexcept {
+		return flushed;
+	}
+
 	/* virtual methods from class Filter */
+	void Reset() noexcept override;
 	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
 	std::span<const std::byte> ReadMore() override;
 	std::span<const std::byte> Flush() override;
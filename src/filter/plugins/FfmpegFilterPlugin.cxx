@@ -9,16 +9,149 @@
 #include "lib/ffmpeg/Filter.hxx"
 #include "lib/ffmpeg/DetectFilterFormat.hxx"
 #include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+
+#include <list>
+#include <memory>
+
+/**
+ * Filters which have been closed, kept for the next Open() call with
+ * the same input format.  Building and configuring a complex graph
+ * (e.g. "loudnorm") can take a long time, which would stall playback
+ * each time the song's audio format changes.
+ */
+class FfmpegFilterCache {
+	/**
+	 * Never keep more than this number of graphs.
+	 */
+	static constexpr std::size_t MAX_SIZE = 4;
+
+	Mutex mutex;
+
+	struct Item {
+		/**
+		 * The format passed to PreparedFilter::Open().
+		 */
+		AudioFormat requested_format;
+
+		/**
+		 * The input format of the graph (which may be
+		 * different, e.g. if FFmpeg doesn't support the
+		 * requested sample format).
+		 */
+		AudioFormat in_audio_format;
+
+		std::unique_ptr<FfmpegFilter> filter;
+	};
+
+	/**
+	 * Most recently used first.  Protected by #mutex.
+	 */
+	std::list<Item> items;
+
+public:
+	/**
+	 * Find a graph for the given format.  On success, the
+	 * #AudioFormat is adjusted to the graph's input format.
+	 */
+	std::unique_ptr<FfmpegFilter> Get(AudioFormat &af) noexcept {
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->requested_format == af) {
+				af = i->in_audio_format;
+				auto filter = std::move(i->filter);
+				items.erase(i);
+				return filter;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void Put(const AudioFormat &requested_format,
+		 const AudioFormat &in_audio_format,
+		 std::unique_ptr<FfmpegFilter> &&filter) {
+		const std::scoped_lock lock{mutex};
+
+		items.push_front({requested_format, in_audio_format,
+				  std::move(filter)});
+		if (items.size() > MAX_SIZE)
+			items.pop_back();
+	}
+};
+
+/**
+ * Wraps a #FfmpegFilter and returns it to the #FfmpegFilterCache
+ * when it gets closed.
+ */
+class CachedFfmpegFilter final : public Filter {
+	const std::shared_ptr<FfmpegFilterCache> cache;
+
+	const AudioFormat requested_format, in_audio_format;
+
+	std::unique_ptr<FfmpegFilter> filter;
+
+public:
+	CachedFfmpegFilter(std::shared_ptr<FfmpegFilterCache> _cache,
+			   const AudioFormat &_requested_format,
+			   const AudioFormat &_in_audio_format,
+			   std::unique_ptr<FfmpegFilter> &&_filter) noexcept
+		:Filter(_filter->GetOutAudioFormat()),
+		 cache(std::move(_cache)),
+		 requested_format(_requested_format),
+		 in_audio_format(_in_audio_format),
+		 filter(std::move(_filter)) {}
+
+	~CachedFfmpegFilter() noexcept override {
+		/* a flushed graph has received EOF and cannot be
+		   reused */
+		if (filter->IsFlushed())
+			return;
+
+		filter->Reset();
+
+		try {
+			cache->Put(requested_format, in_audio_format,
+				   std::move(filter));
+		} catch (...) {
+			/* never mind, it was just an optimization */
+		}
+	}
+
+	/* virtual methods from class Filter */
+	void Reset() noexcept override {
+		filter->Reset();
+	}
+
+	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override {
+		return filter->FilterPCM(src);
+	}
+
+	std::span<const std::byte> ReadMore() override {
+		return filter->ReadMore();
+	}
+
+	std::span<const std::byte> Flush() override {
+		return filter->Flush();
+	}
+};
 
 class PreparedFfmpegFilter final : public PreparedFilter {
 	const char *const graph_string;
 
+	const std::shared_ptr<FfmpegFilterCache> cache =
+		std::make_shared<FfmpegFilterCache>();
+
 public:
-	explicit PreparedFfmpegFilter(const char *_graph) noexcept
+	explicit PreparedFfmpegFilter(const char *_graph)
 		:graph_string(_graph) {}
 
 	/* virtual methods from class PreparedFilter */
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
+
+private:
+	std::unique_ptr<FfmpegFilter> OpenGraph(AudioFormat &af);
 };
 
 /**
@@ -54,8 +187,8 @@ OpenWithAformat(const char *graph_string, AudioFormat &in_audio_format)
 					      buffer_sink);
 }
 
-std::unique_ptr<Filter>
-PreparedFfmpegFilter::Open(AudioFormat &in_audio_format)
+inline std::unique_ptr<FfmpegFilter>
+PreparedFfmpegFilter::OpenGraph(AudioFormat &in_audio_format)
 {
 	Ffmpeg::FilterGraph graph;
 
@@ -94,6 +227,24 @@ PreparedFfmpegFilter::Open(AudioFormat &in_audio_format)
 					      buffer_sink);
 }
 
+std::unique_ptr<Filter>
+PreparedFfmpegFilter::Open(AudioFormat &in_audio_format)
+{
+	/* the graph is configured for exactly this input format, so
+	   a cached one can be used without rebuilding; its filters
+	   continue where the previous song left off, just like they
+	   would if the format had never changed */
+	const AudioFormat requested_format = in_audio_format;
+
+	auto filter = cache->Get(in_audio_format);
+	if (!filter)
+		filter = OpenGraph(in_audio_format);
+
+	return std::make_unique<CachedFfmpegFilter>(cache, requested_format,
+						    in_audio_format,
+						    std::move(filter));
+}
+
 static std::unique_ptr<PreparedFilter>
 ffmpeg_filter_init(const ConfigBlock &block)
 {
@@ -9,9 +9,84 @@
 #include "filter/Prepared.hxx"
 #include "lib/ffmpeg/Filter.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "pcm/Buffer.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cstdint>
 
 static constexpr const char *hdcd_graph = "hdcd";
 
+/**
+ * FFmpeg's "hdcd" filter shifts samples without HDCD gain by this
+ * many bits, leaving one bit of headroom for peak extension.  The
+ * bypass path does the same, so switching between the two is
+ * seamless.
+ */
+static constexpr unsigned HDCD_BYPASS_SHIFT = 15;
+
+/**
+ * After this many seconds without HDCD packets, the decoder is
+ * bypassed again.  This is longer than the 10 seconds after which
+ * FFmpeg's decoder drops its gain, so the output is identical.
+ */
+static constexpr unsigned HDCD_TIMEOUT_S = 15;
+
+/**
+ * Watches the least significant bits of a 16 bit stereo stream for
+ * HDCD packets.  This implements only the packet sync detection of
+ * FFmpeg's decoder, which is a few integer operations per sample.
+ */
+class HdcdDetector {
+	/**
+	 * The least significant bits of the most recent samples of
+	 * each channel; bit 0 is the newest.
+	 */
+	uint_least64_t window[2]{};
+
+public:
+	void Reset() noexcept {
+		window[0] = window[1] = 0;
+	}
+
+	/**
+	 * @return the number of frames after the end of the last
+	 * packet preamble in #src or -1 if none was found
+	 */
+	[[gnu::hot]]
+	long Scan(std::span<const int16_t> src) noexcept;
+};
+
+/**
+ * Does the (descrambled) window end with an HDCD packet preamble?
+ */
+static constexpr bool
+IsHdcdPreamble(uint_least64_t window) noexcept
+{
+	const uint32_t bits = window ^ (window >> 5) ^ (window >> 23);
+	return bits == 0x7e0fa005 || bits == 0x7e0fa006;
+}
+
+long
+HdcdDetector::Scan(std::span<const int16_t> src) noexcept
+{
+	/* keep the windows in registers */
+	uint_least64_t l = window[0], r = window[1];
+	long found = -1;
+
+	const std::size_t n_frames = src.size() / 2;
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		l = (l << 1) | (src[2 * i] & 1);
+		r = (r << 1) | (src[2 * i + 1] & 1);
+
+		if (IsHdcdPreamble(l) || IsHdcdPreamble(r)) [[unlikely]]
+			found = n_frames - i - 1;
+	}
+
+	window[0] = l;
+	window[1] = r;
+	return found;
+}
+
 [[gnu::pure]]
 static bool
 MaybeHdcd(const AudioFormat &audio_format) noexcept
@@ -46,6 +121,100 @@ OpenHdcdFilter(AudioFormat &in_audio_format)
 					      buffer_sink);
 }
 
+/**
+ * Runs FFmpeg's HDCD decoder only while HDCD packets are being
+ * received; the vast majority of CDs have none, and for those, the
+ * samples are only widened to 32 bit.
+ */
+class HdcdFilter final : public Filter {
+	const std::unique_ptr<FfmpegFilter> decoder;
+
+	HdcdDetector detector;
+
+	PcmBuffer buffer;
+
+	/**
+	 * The number of frames after which the decoder will be
+	 * bypassed again if no more HDCD packets arrive.
+	 */
+	const unsigned long timeout_frames;
+
+	/**
+	 * The number of frames since the last HDCD packet.
+	 */
+	unsigned long idle_frames;
+
+	/**
+	 * Is the HDCD decoder currently active?
+	 */
+	bool active = false;
+
+public:
+	HdcdFilter(std::unique_ptr<FfmpegFilter> &&_decoder,
+		   const AudioFormat &in_audio_format) noexcept
+		:Filter(_decoder->GetOutAudioFormat()),
+		 decoder(std::move(_decoder)),
+		 timeout_frames(HDCD_TIMEOUT_S * in_audio_format.sample_rate),
+		 idle_frames(timeout_frames) {}
+
+	/* virtual methods from class Filter */
+	void Reset() noexcept override {
+		decoder->Reset();
+		detector.Reset();
+		idle_frames = timeout_frames;
+		active = false;
+	}
+
+	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
+
+	std::span<const std::byte> ReadMore() override {
+		return active ? decoder->ReadMore() : std::span<const std::byte>{};
+	}
+
+	std::span<const std::byte> Flush() override {
+		return active ? decoder->Flush() : std::span<const std::byte>{};
+	}
+
+private:
+	std::span<const std::byte> Bypass(std::span<const int16_t> src) noexcept;
+};
+
+inline std::span<const std::byte>
+HdcdFilter::Bypass(std::span<const int16_t> src) noexcept
+{
+	int32_t *dest = buffer.GetT<int32_t>(src.size());
+
+	/* simple enough to be vectorized by the compiler */
+	for (std::size_t i = 0; i < src.size(); ++i)
+		dest[i] = int32_t(src[i]) * (int32_t(1) << HDCD_BYPASS_SHIFT);
+
+	return std::as_bytes(std::span{dest, src.size()});
+}
+
+std::span<const std::byte>
+HdcdFilter::FilterPCM(std::span<const std::byte> _src)
+{
+	const auto src = FromBytesStrict<const int16_t>(_src);
+	const std::size_t n_frames = src.size() / 2;
+
+	if (const long found = detector.Scan(src); found >= 0) {
+		/* the whole chunk goes to the decoder, including the
+		   packet which was just found */
+		idle_frames = found;
+		active = true;
+	} else if (active) {
+		idle_frames += n_frames;
+		if (idle_frames >= timeout_frames)
+			/* no packets for a while; the decoder has
+			   dropped its gain by now */
+			active = false;
+	}
+
+	return active
+		? decoder->FilterPCM(_src)
+		: Bypass(src);
+}
+
 class PreparedHdcdFilter final : public PreparedFilter {
 public:
 	/* virtual methods from class PreparedFilter */
@@ -56,7 +225,8 @@ std::unique_ptr<Filter>
 PreparedHdcdFilter::Open(AudioFormat &audio_format)
 {
 	if (MaybeHdcd(audio_format))
-		return OpenHdcdFilter(audio_format);
+		return std::make_unique<HdcdFilter>(OpenHdcdFilter(audio_format),
+						    audio_format);
 	else
 		/* this cannot be HDCD, so let's copy as-is using
 		   NullFilter */
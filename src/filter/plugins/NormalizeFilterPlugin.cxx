@@ -46,21 +46,57 @@ normalize_filter_init([[maybe_unused]] const ConfigBlock &block)
 std::unique_ptr<Filter>
 PreparedNormalizeFilter::Open(AudioFormat &audio_format)
 {
-	audio_format.format = SampleFormat::S16;
+	switch (audio_format.format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		/* these are supported natively */
+		break;
+
+	default:
+		audio_format.format = SampleFormat::S16;
+		break;
+	}
 
 	return std::make_unique<NormalizeFilter>(audio_format);
 }
 
-std::span<const std::byte>
-NormalizeFilter::FilterPCM(std::span<const std::byte> _src)
+template<typename T>
+static std::span<const std::byte>
+NormalizeT(PcmNormalizer &normalizer,
+	   void (PcmNormalizer::*process)(T *, std::span<const T>) noexcept,
+	   PcmBuffer &buffer, std::span<const std::byte> _src) noexcept
 {
-	const auto src = FromBytesStrict<const int16_t>(_src);
-	auto *dest = (int16_t *)buffer.GetT<int16_t>(src.size());
+	const auto src = FromBytesStrict<const T>(_src);
+	auto *dest = buffer.GetT<T>(src.size());
 
-	normalizer.ProcessS16(dest, src);
+	(normalizer.*process)(dest, src);
 	return std::as_bytes(std::span{dest, src.size()});
 }
 
+std::span<const std::byte>
+NormalizeFilter::FilterPCM(std::span<const std::byte> src)
+{
+	switch (out_audio_format.format) {
+	case SampleFormat::S24_P32:
+		return NormalizeT(normalizer, &PcmNormalizer::ProcessS24,
+				  buffer, src);
+
+	case SampleFormat::S32:
+		return NormalizeT(normalizer, &PcmNormalizer::ProcessS32,
+				  buffer, src);
+
+	case SampleFormat::FLOAT:
+		return NormalizeT(normalizer, &PcmNormalizer::ProcessFloat,
+				  buffer, src);
+
+	default:
+		return NormalizeT(normalizer, &PcmNormalizer::ProcessS16,
+				  buffer, src);
+	}
+}
+
 const FilterPlugin normalize_filter_plugin = {
 	"normalize",
 	normalize_filter_init,
@@ -74,6 +74,10 @@ public:
 		Update();
 	}
 
+	unsigned GetVolume() const noexcept {
+		return pv.GetVolume();
+	}
+
 	void SetMode(ReplayGainMode _mode) {
 		if (_mode == mode)
 			/* no change */
@@ -215,3 +219,11 @@ replay_gain_filter_set_mode(Filter &_filter, ReplayGainMode mode)
 
 	filter.SetMode(mode);
 }
+
+unsigned
+replay_gain_filter_get_volume(const Filter &_filter) noexcept
+{
+	const auto &filter = (const ReplayGainFilter &)_filter;
+
+	return filter.GetVolume();
+}
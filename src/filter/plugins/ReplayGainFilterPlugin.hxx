@@ -46,4 +46,14 @@ replay_gain_filter_set_info(Filter &filter, const ReplayGainInfo *info);
 void
 replay_gain_filter_set_mode(Filter &filter, ReplayGainMode mode);
 
+/**
+ * Returns the software volume level calculated from the current
+ * #ReplayGainInfo and #ReplayGainMode (see #PCM_VOLUME_1).  This
+ * allows the caller to apply it elsewhere instead of calling
+ * Filter::FilterPCM().
+ */
+[[gnu::pure]]
+unsigned
+replay_gain_filter_get_volume(const Filter &filter) noexcept;
+
 #endif
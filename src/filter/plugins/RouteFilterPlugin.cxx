@@ -20,7 +20,14 @@
  * front-right (1) and rear-right (3).
  *
  * If multiple sources are copied to the same destination channel, only
- * one of them takes effect.
+ * the last one takes effect.
+ *
+ * A pair may have a gain suffix, e.g. "2>0*0.7"; such a pair is added
+ * to the destination channel instead of replacing it, which allows
+ * downmixing.
+ *
+ * The routes are converted to a #PcmChannelMatrix; plain copies are
+ * done without arithmetic.
  */
 
 #include "RouteFilterPlugin.hxx"
@@ -29,55 +36,30 @@
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "pcm/AudioFormat.hxx"
-#include "pcm/Buffer.hxx"
-#include "pcm/Silence.hxx"
+#include "pcm/ChannelMatrix.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/StringStrip.hxx"
 
+#include <algorithm>
 #include <array>
-#include <cstdint>
 #include <stdexcept>
 
-#include <string.h>
 #include <stdlib.h>
 
 class RouteFilter final : public Filter {
-	/**
-	 * The set of copy operations to perform on each sample
-	 * The index is an output channel to use, the value is
-	 * a corresponding input channel from which to take the
-	 * data. A -1 means "no source"
-	 */
-	const std::array<int8_t, MAX_CHANNELS> sources;
-
-	/**
-	 * The actual input format of our signal, once opened
-	 */
-	const AudioFormat input_format;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * input buffer
-	 */
-	const size_t input_frame_size;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * output buffer
-	 */
-	size_t output_frame_size;
+	PcmChannelMixer mixer;
 
+public:
 	/**
-	 * The output buffer used last time around, can be reused if the size doesn't differ.
+	 * Throws on error.
 	 */
-	PcmBuffer output_buffer;
-
-public:
-	RouteFilter(const AudioFormat &audio_format, unsigned out_channels,
-		    const std::array<int8_t, MAX_CHANNELS> &_sources);
+	RouteFilter(const AudioFormat &audio_format,
+		    const PcmChannelMatrix &matrix);
 
 	/* virtual methods from class Filter */
-	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
+	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override {
+		return mixer.Apply(src);
+	}
 };
 
 class PreparedRouteFilter final : public PreparedFilter {
@@ -88,29 +70,20 @@ class PreparedRouteFilter final : public PreparedFilter {
 	unsigned min_output_channels;
 
 	/**
-	 * The minimum number of input channels we need to
-	 * copy all the data the user has requested. If fewer
-	 * than this many are supplied by the input, undefined
-	 * copy operations are given zeroed sources in stead.
+	 * The gain of each input channel in each output channel,
+	 * indexed as [dest][src].  Input channels which are not
+	 * supplied by the input are silent.
 	 */
-	unsigned min_input_channels;
-
-	/**
-	 * The set of copy operations to perform on each sample
-	 * The index is an output channel to use, the value is
-	 * a corresponding input channel from which to take the
-	 * data. A -1 means "no source"
-	 */
-	std::array<int8_t, MAX_CHANNELS> sources;
+	std::array<std::array<float, MAX_CHANNELS>, MAX_CHANNELS> gain{};
 
 public:
 	/**
 	 * Parse the "routes" section, a string on the form
-	 *  a>b, c>d, e>f, ...
+	 *  a>b, c>d, e>f*g, ...
 	 * where a... are non-unique, non-negative integers
-	 * and input channel a gets copied to output channel b, etc.
+	 * and input channel a gets copied to output channel b, etc.;
+	 * the optional gain g adds the input channel instead.
 	 * @param block the configuration block to read
-	 * @param filter a route_filter whose min_channels and sources[] to set
 	 */
 	explicit PreparedRouteFilter(const ConfigBlock &block);
 
@@ -120,15 +93,6 @@ public:
 
 PreparedRouteFilter::PreparedRouteFilter(const ConfigBlock &block)
 {
-	/* TODO:
-	 * With a more clever way of marking "don't copy to output N",
-	 * This could easily be merged into a single loop with some
-	 * dynamic realloc() instead of one count run and one malloc().
-	 */
-
-	sources.fill(-1);
-
-	min_input_channels = 0;
 	min_output_channels = 0;
 
 	// A cowardly default, just passthrough stereo
@@ -146,9 +110,6 @@ PreparedRouteFilter::PreparedRouteFilter(const ConfigBlock &block)
 			throw FmtRuntimeError("Invalid source channel number: {}",
 					      source);
 
-		if (source >= min_input_channels)
-			min_input_channels = source + 1;
-
 		routes = StripLeft(endptr + 1);
 
 		unsigned dest = strtoul(routes, &endptr, 10);
@@ -163,7 +124,19 @@ PreparedRouteFilter::PreparedRouteFilter(const ConfigBlock &block)
 		if (dest >= min_output_channels)
 			min_output_channels = dest + 1;
 
-		sources[dest] = source;
+		if (*endptr == '*') {
+			routes = StripLeft(endptr + 1);
+
+			const float g = strtof(routes, &endptr);
+			if (endptr == routes)
+				throw std::runtime_error("Malformed 'routes' specification");
+
+			gain[dest][source] += g;
+			endptr = StripLeft(endptr);
+		} else {
+			gain[dest].fill(0);
+			gain[dest][source] = 1;
+		}
 
 		routes = endptr;
 
@@ -184,74 +157,23 @@ route_filter_init(const ConfigBlock &block)
 }
 
 RouteFilter::RouteFilter(const AudioFormat &audio_format,
-			 unsigned out_channels,
-			 const std::array<int8_t, MAX_CHANNELS> &_sources)
-	:Filter(audio_format), sources(_sources), input_format(audio_format),
-	 input_frame_size(input_format.GetFrameSize())
+			 const PcmChannelMatrix &matrix)
+	:Filter(audio_format)
 {
-	// Decide on an output format which has enough channels,
-	// and is otherwise identical
-	out_audio_format.channels = out_channels;
+	out_audio_format.channels = matrix.dest_channels;
 
-	// Precalculate this simple value, to speed up allocation later
-	output_frame_size = out_audio_format.GetFrameSize();
+	mixer.Open(audio_format.format, matrix);
 }
 
 std::unique_ptr<Filter>
 PreparedRouteFilter::Open(AudioFormat &audio_format)
 {
-	return std::make_unique<RouteFilter>(audio_format, min_output_channels,
-					     sources);
-}
-
-std::span<const std::byte>
-RouteFilter::FilterPCM(std::span<const std::byte> src)
-{
-	size_t number_of_frames = src.size() / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
-
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const auto *base_source = (const uint8_t *)src.data();
-
-	// Grow our reusable buffer, if needed, and set the moving pointer
-	const size_t result_size = number_of_frames * output_frame_size;
-	void *const result = output_buffer.Get(result_size);
-
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	auto *chan_destination = (std::byte *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned c = 0; c < out_audio_format.channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				PcmSilence({chan_destination, bytes_per_frame_per_channel},
-					   input_format.format);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
-	}
+	PcmChannelMatrix matrix{audio_format.channels, min_output_channels};
+	for (unsigned d = 0; d < min_output_channels; ++d)
+		std::copy_n(gain[d].begin(), audio_format.channels,
+			    matrix.gain[d].begin());
 
-	// Here it is, ladies and gentlemen! Rerouted data!
-	return { (const std::byte *)result, result_size };
+	return std::make_unique<RouteFilter>(audio_format, matrix);
 }
 
 const FilterPlugin route_filter_plugin = {
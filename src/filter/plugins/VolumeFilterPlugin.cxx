@@ -7,22 +7,48 @@
 #include "pcm/Volume.hxx"
 #include "pcm/AudioFormat.hxx"
 
+#include <atomic>
+#include <cstdint>
+
 class VolumeFilter final : public Filter {
 	PcmVolume pv;
 
+	/**
+	 * The volume set by the #SoftwareMixer.  It is atomic
+	 * because it is set by another thread.
+	 */
+	std::atomic_uint volume{PCM_VOLUME_1};
+
+	/**
+	 * An additional gain set by the #AudioOutputSource (the
+	 * ReplayGain of the current song), see
+	 * volume_filter_set_gain().
+	 */
+	unsigned gain = PCM_VOLUME_1;
+
+	/**
+	 * The input sample format.
+	 */
+	const SampleFormat in_format;
+
 public:
 	explicit VolumeFilter(const AudioFormat &audio_format)
-		:Filter(audio_format) {
-		out_audio_format.format = pv.Open(out_audio_format.format,
-						  true);
+		:Filter(audio_format), in_format(audio_format.format) {
+		out_audio_format.format = pv.Open(in_format, true);
 	}
 
+	SampleFormat SetOutFormat(SampleFormat out_format) noexcept;
+
 	[[nodiscard]] unsigned GetVolume() const noexcept {
-		return pv.GetVolume();
+		return volume.load(std::memory_order_relaxed);
 	}
 
 	void SetVolume(unsigned _volume) noexcept {
-		pv.SetVolume(_volume);
+		volume.store(_volume, std::memory_order_relaxed);
+	}
+
+	void SetGain(unsigned _gain) noexcept {
+		gain = _gain;
 	}
 
 	/* virtual methods from class Filter */
@@ -41,9 +67,31 @@ PreparedVolumeFilter::Open(AudioFormat &audio_format)
 	return std::make_unique<VolumeFilter>(audio_format);
 }
 
+SampleFormat
+VolumeFilter::SetOutFormat(SampleFormat out_format) noexcept
+{
+	if (out_format == out_audio_format.format)
+		return out_format;
+
+	pv.Close();
+
+	if (out_format == SampleFormat::UNDEFINED ||
+	    !pv.Open(in_format, out_format))
+		/* can't do this conversion in the same pass; fall
+		   back to the default (which cannot fail, because
+		   it has succeeded in the constructor) */
+		out_format = pv.Open(in_format, true);
+
+	return out_audio_format.format = out_format;
+}
+
 std::span<const std::byte>
 VolumeFilter::FilterPCM(std::span<const std::byte> src)
 {
+	const unsigned v = GetVolume();
+	pv.SetVolume(gain == PCM_VOLUME_1
+		     ? v
+		     : unsigned(uint_least64_t(v) * gain / PCM_VOLUME_1));
 	return pv.Apply(src);
 }
 
@@ -69,3 +117,20 @@ volume_filter_set(Filter *_filter, unsigned volume) noexcept
 
 	filter->SetVolume(volume);
 }
+
+void
+volume_filter_set_gain(Filter *_filter, unsigned gain) noexcept
+{
+	auto *filter = (VolumeFilter *)_filter;
+
+	filter->SetGain(gain);
+}
+
+SampleFormat
+volume_filter_set_out_format(Filter *_filter,
+			     SampleFormat out_format) noexcept
+{
+	auto *filter = (VolumeFilter *)_filter;
+
+	return filter->SetOutFormat(out_format);
+}
@@ -4,8 +4,10 @@
 #ifndef MPD_VOLUME_FILTER_PLUGIN_HXX
 #define MPD_VOLUME_FILTER_PLUGIN_HXX
 
+#include <cstdint>
 #include <memory>
 
+enum class SampleFormat : uint8_t;
 class PreparedFilter;
 class Filter;
 
@@ -18,4 +20,30 @@ volume_filter_get(const Filter *filter) noexcept;
 void
 volume_filter_set(Filter *filter, unsigned volume) noexcept;
 
+/**
+ * Let the volume filter convert to the given #SampleFormat in the
+ * same pass which applies the volume, to avoid a separate
+ * conversion pass by the following filter.
+ *
+ * @param out_format the desired output format;
+ * SampleFormat::UNDEFINED restores the default
+ * @return the sample format which will be produced by the filter
+ * from now on; this is the default if the requested conversion is
+ * not implemented
+ */
+SampleFormat
+volume_filter_set_out_format(Filter *filter,
+			     SampleFormat out_format) noexcept;
+
+/**
+ * Set an additional gain (e.g. ReplayGain) which is multiplied with
+ * the volume, so both are applied in one pass.  Unlike
+ * volume_filter_set(), this is meant to be called by the thread
+ * which runs the filter, before each chunk.
+ *
+ * @param gain the gain level (see #PCM_VOLUME_1)
+ */
+void
+volume_filter_set_gain(Filter *filter, unsigned gain) noexcept;
+
 #endif
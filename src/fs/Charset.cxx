@@ -6,6 +6,8 @@
 #include "Domain.hxx"
 #include "lib/icu/Converter.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/StringCompare.hxx"
+#include "util/UTF8.hxx"
 #include "config.h"
 
 #ifdef _WIN32
@@ -15,6 +17,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <stdexcept>
 
 #ifdef HAVE_FS_CHARSET
 
@@ -22,6 +25,21 @@ static std::string fs_charset;
 
 static std::unique_ptr<IcuConverter> fs_converter;
 
+/**
+ * The file system charset was explicitly configured to be UTF-8.
+ * Instead of converting each path from UTF-8 to UTF-8, it is only
+ * validated.
+ */
+static bool fs_charset_utf8;
+
+[[gnu::pure]]
+static bool
+IsUTF8Charset(std::string_view charset) noexcept
+{
+	return StringIsEqualIgnoreCase(charset, "UTF-8") ||
+		StringIsEqualIgnoreCase(charset, "UTF8");
+}
+
 void
 SetFSCharset(const char *charset)
 {
@@ -29,6 +47,12 @@ SetFSCharset(const char *charset)
 	assert(fs_converter == nullptr);
 
 	fs_charset = charset;
+
+	if (IsUTF8Charset(charset)) {
+		fs_charset_utf8 = true;
+		return;
+	}
+
 	fs_converter = IcuConverter::Create(charset);
 	assert(fs_converter != nullptr);
 }
@@ -40,6 +64,7 @@ DeinitFSCharset() noexcept
 {
 #ifdef HAVE_FS_CHARSET
 	fs_converter.reset();
+	fs_charset_utf8 = false;
 #endif
 }
 
@@ -80,6 +105,9 @@ PathToUTF8(PathTraitsFS::string_view path_fs)
 	return FixSeparators(buffer);
 #else
 #ifdef HAVE_FS_CHARSET
+	if (fs_charset_utf8 && !ValidateUTF8(path_fs))
+		throw std::runtime_error("Path is not valid UTF-8");
+
 	if (fs_converter == nullptr)
 #endif
 		return FixSeparators(path_fs);
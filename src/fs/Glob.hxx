@@ -27,6 +27,7 @@ public:
 	explicit Glob(const char *_pattern)
 		:pattern(_pattern) {}
 
+	Glob(const Glob &) = default;
 	Glob(Glob &&other) noexcept = default;
 	Glob &operator=(Glob &&other) noexcept = default;
 
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "GlobSet.hxx"
+
+#ifdef HAVE_CLASS_GLOB
+
+[[gnu::pure]]
+static bool
+IsLiteral(std::string_view s) noexcept
+{
+	return s.find_first_of("*?[\\") == s.npos;
+}
+
+void
+GlobSet::Add(const char *_pattern)
+{
+#ifdef _WIN32
+	/* PathMatchSpecA() is case-insensitive; don't bother
+	   emulating that in the hash tables */
+	others.emplace_front(_pattern);
+#else
+	const std::string_view pattern{_pattern};
+
+	if (IsLiteral(pattern))
+		literals.emplace(pattern);
+	else if (pattern.front() == '*' && IsLiteral(pattern.substr(1)))
+		suffixes[pattern.size() - 1].emplace(pattern.substr(1));
+	else if (pattern.back() == '*' &&
+		 IsLiteral(pattern.substr(0, pattern.size() - 1)))
+		prefixes[pattern.size() - 1].emplace(pattern.substr(0, pattern.size() - 1));
+	else
+		others.emplace_front(_pattern);
+#endif
+}
+
+bool
+GlobSet::Check(const char *name_fs) const noexcept
+{
+	const std::string_view name{name_fs};
+
+	if (literals.contains(name))
+		return true;
+
+	for (const auto &[length, set] : suffixes) {
+		if (length > name.size())
+			break;
+
+		if (set.contains(name.substr(name.size() - length)))
+			return true;
+	}
+
+	for (const auto &[length, set] : prefixes) {
+		if (length > name.size())
+			break;
+
+		if (set.contains(name.substr(0, length)))
+			return true;
+	}
+
+	for (const auto &i : others)
+		if (i.Check(name_fs))
+			return true;
+
+	return false;
+}
+
+#endif /* HAVE_CLASS_GLOB */
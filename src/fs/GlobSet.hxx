@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Glob.hxx"
+
+#ifdef HAVE_CLASS_GLOB
+
+#include <cstddef>
+#include <forward_list>
+#include <functional> // for std::equal_to, std::hash
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+/**
+ * A set of #Glob patterns which are checked together.  Literal
+ * names, "*suffix" and "prefix*" patterns (the most common ones in
+ * ".mpdignore" files) are looked up in hash tables, so the cost of
+ * Check() does not grow with the number of such patterns; only the
+ * remaining patterns are matched one by one.
+ */
+class GlobSet {
+	struct StringHash : std::hash<std::string_view> {
+		using is_transparent = void;
+	};
+
+	using StringSet = std::unordered_set<std::string, StringHash,
+					     std::equal_to<>>;
+
+	/**
+	 * Patterns without wildcards.
+	 */
+	StringSet literals;
+
+	/**
+	 * The literal parts of "*suffix" and "prefix*" patterns,
+	 * grouped by their length.
+	 */
+	std::map<std::size_t, StringSet> suffixes, prefixes;
+
+	/**
+	 * All other patterns.
+	 */
+	std::forward_list<Glob> others;
+
+public:
+	GlobSet() noexcept = default;
+	GlobSet(const GlobSet &) = default;
+	GlobSet(GlobSet &&) noexcept = default;
+	GlobSet &operator=(GlobSet &&) noexcept = default;
+
+	bool IsEmpty() const noexcept {
+		return literals.empty() && suffixes.empty() &&
+			prefixes.empty() && others.empty();
+	}
+
+	void Add(const char *pattern);
+
+	[[gnu::pure]]
+	bool Check(const char *name_fs) const noexcept;
+};
+
+#endif /* HAVE_CLASS_GLOB */
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "AsyncBufferConfig.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+
+#include <algorithm>
+
+static constexpr std::size_t KILOBYTE = 1024;
+static constexpr std::size_t MEGABYTE = 1024 * KILOBYTE;
+
+static constexpr std::size_t DEFAULT_MAX_BUFFER_SIZE = 16 * MEGABYTE;
+
+static std::size_t
+GetSize(const ConfigBlock &block, const char *name, std::size_t default_value)
+{
+	const auto *param = block.GetBlockParam(name);
+	if (param == nullptr)
+		return default_value;
+
+	return param->With([](const char *s){
+		return ParseSize(s);
+	});
+}
+
+void
+AsyncInputBufferConfig::Load(const ConfigBlock &block)
+{
+	size = GetSize(block, "buffer_size", size);
+	if (size < 64 * KILOBYTE)
+		throw FmtRuntimeError("buffer_size is too small in line {}",
+				      block.line);
+
+	max_size = size;
+	if (block.GetBlockValue("adaptive_buffer", false)) {
+		max_size = GetSize(block, "max_buffer_size",
+				   std::max(size, DEFAULT_MAX_BUFFER_SIZE));
+		if (max_size < size)
+			throw FmtRuntimeError("max_buffer_size is smaller than buffer_size in line {}",
+					      block.line);
+	}
+}
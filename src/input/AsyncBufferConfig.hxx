@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+
+struct ConfigBlock;
+
+/**
+ * The buffer settings of an #AsyncInputStream or a
+ * #ThreadInputStream, configurable per input plugin.
+ */
+struct AsyncInputBufferConfig {
+	/**
+	 * The (initial) size of the buffer.
+	 */
+	std::size_t size;
+
+	/**
+	 * If this is larger than #size, then the buffer grows
+	 * adaptively up to this size when the reader stalls.
+	 */
+	std::size_t max_size;
+
+	explicit constexpr AsyncInputBufferConfig(std::size_t _size) noexcept
+		:size(_size), max_size(_size) {}
+
+	constexpr bool IsAdaptive() const noexcept {
+		return max_size > size;
+	}
+
+	/**
+	 * Resume the stream at this number of bytes after it has
+	 * been paused.
+	 */
+	static constexpr std::size_t GetResumeAt(std::size_t size) noexcept {
+		return size / 4 * 3;
+	}
+
+	/**
+	 * Load the settings "buffer_size", "adaptive_buffer" and
+	 * "max_buffer_size" from the input plugin's configuration
+	 * block.
+	 *
+	 * Throws on error.
+	 */
+	void Load(const ConfigBlock &block);
+};
@@ -2,14 +2,21 @@
 // Copyright The Music Player Daemon Project
 
 #include "AsyncInputStream.hxx"
+#include "AsyncBufferConfig.hxx"
 #include "tag/Tag.hxx"
 #include "event/Loop.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <stdexcept>
 
 #include <string.h>
 
+static constexpr Domain async_input_domain("async_input");
+
 AsyncInputStream::AsyncInputStream(EventLoop &event_loop, std::string_view _url,
 				   Mutex &_mutex,
 				   size_t _buffer_size,
@@ -18,15 +25,57 @@ AsyncInputStream::AsyncInputStream(EventLoop &event_loop, std::string_view _url,
 	 deferred_resume(event_loop, BIND_THIS_METHOD(DeferredResume)),
 	 deferred_seek(event_loop, BIND_THIS_METHOD(DeferredSeek)),
 	 allocation(_buffer_size),
-	 resume_at(_resume_at)
+	 buffer(std::in_place, allocation),
+	 resume_at(_resume_at),
+	 max_buffer_size(_buffer_size),
+	 estimator(std::chrono::steady_clock::now())
 {
 	allocation.SetName("InputStream");
 	allocation.ForkCow(false);
 }
 
+AsyncInputStream::AsyncInputStream(EventLoop &event_loop, std::string_view _url,
+				   Mutex &_mutex,
+				   const AsyncInputBufferConfig &config) noexcept
+	:AsyncInputStream(event_loop, _url, _mutex,
+			  config.size,
+			  AsyncInputBufferConfig::GetResumeAt(config.size))
+{
+	max_buffer_size = config.max_size;
+}
+
 AsyncInputStream::~AsyncInputStream() noexcept
 {
-	buffer.Clear();
+	buffer->Clear();
+}
+
+inline void
+AsyncInputStream::Grow() noexcept
+{
+	assert(buffer->empty());
+
+	const size_t capacity = buffer->GetCapacity();
+	const size_t target = std::min(std::bit_ceil(estimator.GetTargetSize()),
+				       max_buffer_size);
+	if (target <= capacity)
+		return;
+
+	try {
+		HugeArray<std::byte> new_allocation(target);
+		new_allocation.SetName("InputStream");
+		new_allocation.ForkCow(false);
+
+		buffer.reset();
+		allocation = std::move(new_allocation);
+		buffer.emplace(allocation);
+		resume_at = AsyncInputBufferConfig::GetResumeAt(target);
+	} catch (...) {
+		/* out of memory: keep the old buffer */
+		return;
+	}
+
+	FmtDebug(async_input_domain, "Growing input buffer of {:?} to {} kB",
+		 GetURI(), target / 1024);
 }
 
 void
@@ -73,7 +122,7 @@ bool
 AsyncInputStream::IsEOF() const noexcept
 {
 	return (KnownSize() && offset >= size) ||
-		(!open && buffer.empty());
+		(!open && buffer->empty());
 }
 
 void
@@ -101,7 +150,7 @@ AsyncInputStream::Seek(std::unique_lock<Mutex> &lock,
 	/* check if we can fast-forward the buffer */
 
 	while (new_offset > offset) {
-		auto r = buffer.Read();
+		auto r = buffer->Read();
 		if (r.empty())
 			break;
 
@@ -110,7 +159,7 @@ AsyncInputStream::Seek(std::unique_lock<Mutex> &lock,
 			? new_offset - offset
 			: r.size();
 
-		buffer.Consume(nbytes);
+		buffer->Consume(nbytes);
 		offset += nbytes;
 	}
 
@@ -156,7 +205,7 @@ AsyncInputStream::IsAvailable() const noexcept
 {
 	return postponed_exception ||
 		IsEOF() ||
-		!buffer.empty();
+		!buffer->empty();
 }
 
 size_t
@@ -170,20 +219,34 @@ AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
 	while (true) {
 		Check();
 
-		r = buffer.Read();
+		r = buffer->Read();
 		if (!r.empty() || IsEOF())
 			break;
 
+		if (IsAdaptive() && !estimator.IsStalled()) {
+			/* the buffer has run dry: make it larger
+			   if previous stalls suggest so, and measure
+			   this one */
+			Grow();
+			estimator.OnStallBegin(std::chrono::steady_clock::now());
+		}
+
 		caller_cond.wait(lock);
 	}
 
 	const size_t nbytes = std::min(dest.size(), r.size());
 	memcpy(dest.data(), r.data(), nbytes);
-	buffer.Consume(nbytes);
+	buffer->Consume(nbytes);
 
 	offset += (offset_type)nbytes;
 
-	if (paused && buffer.GetSize() < resume_at)
+	if (IsAdaptive()) {
+		const auto now = std::chrono::steady_clock::now();
+		estimator.OnStallEnd(now);
+		estimator.OnConsumed(nbytes, now);
+	}
+
+	if (paused && buffer->GetSize() < resume_at)
 		deferred_resume.Schedule();
 
 	return nbytes;
@@ -192,7 +255,7 @@ AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
 void
 AsyncInputStream::CommitWriteBuffer(size_t nbytes) noexcept
 {
-	buffer.Append(nbytes);
+	buffer->Append(nbytes);
 
 	if (!IsReady())
 		SetReady();
@@ -205,7 +268,7 @@ AsyncInputStream::CommitWriteBuffer(size_t nbytes) noexcept
 void
 AsyncInputStream::AppendToBuffer(std::span<const std::byte> src) noexcept
 {
-	auto w = buffer.Write();
+	auto w = buffer->Write();
 	assert(!w.empty());
 
 	std::span<const std::byte> second{};
@@ -216,15 +279,15 @@ AsyncInputStream::AppendToBuffer(std::span<const std::byte> src) noexcept
 	}
 
 	std::copy(src.begin(), src.end(), w.begin());
-	buffer.Append(src.size());
+	buffer->Append(src.size());
 
 	if (!second.empty()) {
-		w = buffer.Write();
+		w = buffer->Write();
 		assert(!w.empty());
 		assert(w.size() >= second.size());
 
 		std::copy(second.begin(), second.end(), w.begin());
-		buffer.Append(second.size());
+		buffer->Append(second.size());
 	}
 
 	if (!IsReady())
@@ -260,7 +323,7 @@ AsyncInputStream::DeferredSeek() noexcept
 		Resume();
 
 		seek_state = SeekState::PENDING;
-		buffer.Clear();
+		buffer->Clear();
 		paused = false;
 
 		DoSeek(seek_offset);
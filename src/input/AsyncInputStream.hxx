@@ -4,6 +4,7 @@
 #pragma once
 
 #include "InputStream.hxx"
+#include "BufferEstimator.hxx"
 #include "thread/Cond.hxx"
 #include "event/InjectEvent.hxx"
 #include "util/HugeAllocator.hxx"
@@ -11,6 +12,9 @@
 
 #include <cstddef>
 #include <exception>
+#include <optional>
+
+struct AsyncInputBufferConfig;
 
 /**
  * Helper class for moving asynchronous (non-blocking) InputStream
@@ -29,8 +33,25 @@ class AsyncInputStream : public InputStream {
 
 	HugeArray<std::byte> allocation;
 
-	CircularBuffer<std::byte> buffer{allocation};
-	const size_t resume_at;
+	/**
+	 * The ring buffer inside #allocation.  This is only empty
+	 * while it is being replaced by Grow().
+	 */
+	std::optional<CircularBuffer<std::byte>> buffer;
+
+	size_t resume_at;
+
+	/**
+	 * The maximum size the buffer may grow to; equal to the
+	 * initial size if the buffer size is fixed.
+	 */
+	size_t max_buffer_size;
+
+	/**
+	 * Only used if #max_buffer_size is larger than the initial
+	 * buffer size.
+	 */
+	InputBufferEstimator estimator;
 
 	enum class SeekState : uint_least8_t {
 		NONE, SCHEDULED, PENDING
@@ -62,6 +83,10 @@ public:
 			 size_t _buffer_size,
 			 size_t _resume_at) noexcept;
 
+	AsyncInputStream(EventLoop &event_loop, std::string_view _url,
+			 Mutex &_mutex,
+			 const AsyncInputBufferConfig &config) noexcept;
+
 	~AsyncInputStream() noexcept override;
 
 	auto &GetEventLoop() const noexcept {
@@ -101,11 +126,11 @@ protected:
 	}
 
 	bool IsBufferEmpty() const noexcept {
-		return buffer.empty();
+		return buffer->empty();
 	}
 
 	bool IsBufferFull() const noexcept {
-		return buffer.IsFull();
+		return buffer->IsFull();
 	}
 
 	/**
@@ -113,11 +138,11 @@ protected:
 	 */
 	[[gnu::pure]]
 	size_t GetBufferSpace() const noexcept {
-		return buffer.GetSpace();
+		return buffer->GetSpace();
 	}
 
 	auto PrepareWriteBuffer() noexcept {
-		return buffer.Write();
+		return buffer->Write();
 	}
 
 	void CommitWriteBuffer(size_t nbytes) noexcept;
@@ -152,6 +177,16 @@ protected:
 	void SeekDone() noexcept;
 
 private:
+	bool IsAdaptive() const noexcept {
+		return max_buffer_size > buffer->GetCapacity();
+	}
+
+	/**
+	 * Replace the (empty) buffer with a larger one if the
+	 * #estimator suggests so.
+	 */
+	void Grow() noexcept;
+
 	void Resume();
 
 	/* for InjectEvent */
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BufferEstimator.hxx"
+
+void
+InputBufferEstimator::OnConsumed(std::size_t nbytes,
+				 Clock::time_point now) noexcept
+{
+	window_bytes += nbytes;
+
+	const auto elapsed = now - window_start;
+	if (elapsed < WINDOW)
+		return;
+
+	using FloatSeconds = std::chrono::duration<double>;
+	const double window_rate =
+		window_bytes / std::chrono::duration_cast<FloatSeconds>(elapsed).count();
+
+	/* exponential moving average; the first window is taken
+	   as-is */
+	rate = rate > 0
+		? (rate * 3 + window_rate) / 4
+		: window_rate;
+
+	/* let the stall estimate decay by 1/8 each window */
+	max_stall -= max_stall / 8;
+
+	window_start = now;
+	window_bytes = 0;
+}
+
+void
+InputBufferEstimator::OnStallEnd(Clock::time_point now) noexcept
+{
+	if (!stalled)
+		return;
+
+	stalled = false;
+
+	const auto duration = now - stall_start;
+	if (duration > max_stall)
+		max_stall = duration;
+
+	/* the time spent waiting does not count towards the
+	   consumption rate */
+	window_start += duration;
+}
+
+std::size_t
+InputBufferEstimator::GetTargetSize() const noexcept
+{
+	using FloatSeconds = std::chrono::duration<double>;
+	const double stall =
+		std::chrono::duration_cast<FloatSeconds>(max_stall).count();
+
+	return static_cast<std::size_t>(2 * rate * stall);
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Estimates how large the buffer of an #AsyncInputStream needs to be
+ * so the reader does not run dry: the rate at which data is consumed
+ * multiplied with the longest recent stall (the time the reader had
+ * to wait for data).  This is similar to the bandwidth-delay product
+ * of a network connection, but measured from the reader's point of
+ * view, so it includes jitter.
+ */
+class InputBufferEstimator {
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * The consumption rate is measured in windows of (at least)
+	 * this duration.
+	 */
+	static constexpr Clock::duration WINDOW = std::chrono::seconds{1};
+
+	Clock::time_point window_start;
+	std::size_t window_bytes = 0;
+
+	/**
+	 * The smoothed consumption rate [bytes per second].
+	 */
+	double rate = 0;
+
+	/**
+	 * The longest recent stall; it decays slowly, so a single
+	 * hiccup does not keep the buffer large forever.
+	 */
+	Clock::duration max_stall = Clock::duration::zero();
+
+	Clock::time_point stall_start;
+
+	bool stalled = false;
+
+public:
+	explicit InputBufferEstimator(Clock::time_point now) noexcept
+		:window_start(now) {}
+
+	bool IsStalled() const noexcept {
+		return stalled;
+	}
+
+	/**
+	 * The reader has consumed the given number of bytes.
+	 */
+	void OnConsumed(std::size_t nbytes, Clock::time_point now) noexcept;
+
+	/**
+	 * The reader has found the buffer empty and waits for data.
+	 */
+	void OnStallBegin(Clock::time_point now) noexcept {
+		stalled = true;
+		stall_start = now;
+	}
+
+	/**
+	 * Data has arrived after OnStallBegin().
+	 */
+	void OnStallEnd(Clock::time_point now) noexcept;
+
+	/**
+	 * Calculate the buffer size which would have bridged the
+	 * longest recent stall (with a safety factor of two).
+	 *
+	 * @return the suggested size in bytes or 0 if nothing is
+	 * known yet
+	 */
+	[[gnu::pure]]
+	std::size_t GetTargetSize() const noexcept;
+};
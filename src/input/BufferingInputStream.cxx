@@ -4,9 +4,19 @@
 #include "BufferingInputStream.hxx"
 #include "InputStream.hxx"
 #include "thread/Name.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <algorithm>
 
 #include <string.h>
 
+/* enforce an upper limit for each InputStream::Read() call; this is
+   necessary for plugins which are unable to do partial reads,
+   e.g. when reading local files, the read() system call will not
+   return until all requested bytes have been read from the hard
+   disk, instead of returning when "some" data has been read */
+static constexpr size_t MAX_READ = 64 * 1024;
+
 BufferingInputStream::BufferingInputStream(InputStreamPtr _input)
 	:input(std::move(_input)),
 	 mutex(input->mutex),
@@ -83,26 +93,206 @@ BufferingInputStream::Read(std::unique_lock<Mutex> &lock, size_t offset,
 	}
 }
 
+bool
+BufferingInputStream::IsSegmentAt(size_t offset) const noexcept
+{
+	return std::any_of(segments.begin(), segments.end(),
+			   [offset](const auto &segment){
+				   return segment->GetOffset() == offset;
+			   });
+}
+
 size_t
 BufferingInputStream::FindFirstHole() const noexcept
 {
-	auto r = buffer.Read(0);
-	if (r.undefined_size > 0)
-		/* a hole at the beginning */
-		return 0;
+	size_t offset = 0;
+	while (offset < size()) {
+		const auto r = buffer.Read(offset);
+		if (r.undefined_size > 0) {
+			if (!IsSegmentAt(offset))
+				return offset;
+
+			/* this hole is being filled already */
+			offset += r.undefined_size;
+		}
 
-	if (r.defined_buffer.size() < size())
-		/* a hole in the middle */
-		return r.defined_buffer.size();
+		offset += r.defined_buffer.size();
+	}
 
-	/* the file has been read completely */
+	/* the file has been read completely (or will be soon) */
 	return INVALID_OFFSET;
 }
 
+size_t
+BufferingInputStream::SplitLargestHole() const noexcept
+{
+	size_t largest_offset = INVALID_OFFSET, largest_size = 0;
+
+	size_t offset = 0;
+	while (offset < size()) {
+		const auto r = buffer.Read(offset);
+		if (r.undefined_size > largest_size) {
+			largest_offset = offset;
+			largest_size = r.undefined_size;
+		}
+
+		offset += r.undefined_size + r.defined_buffer.size();
+	}
+
+	if (largest_size < 2 * MIN_SEGMENT_SIZE)
+		/* not worth it */
+		return INVALID_OFFSET;
+
+	return largest_offset + largest_size / 2;
+}
+
+inline void
+BufferingInputStream::OpenSegments() noexcept
+{
+	const size_t start = input->GetOffset();
+	if (start >= size())
+		return;
+
+	const size_t n = std::min<size_t>(input->GetMaxSegments(),
+					  (size() - start) / MIN_SEGMENT_SIZE);
+
+	for (size_t i = 1; i < n && !stop; ++i) {
+		const size_t offset = start + (size() - start) / n * i;
+		if (buffer.Read(offset).HasData())
+			continue;
+
+		InputStreamPtr segment;
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			segment = input->OpenSegment(offset);
+		} catch (...) {
+			/* ignore; our input will read everything */
+			break;
+		}
+
+		if (!segment)
+			break;
+
+		segment->SetHandler(this);
+		segments.push_front(std::move(segment));
+	}
+}
+
+inline void
+BufferingInputStream::CloseSegments(std::unique_lock<Mutex> &lock,
+				    std::forward_list<InputStreamPtr> &&closed) noexcept
+{
+	/* the mutex must be unlocked while an InputStream can be
+	   destructed */
+	lock.unlock();
+	AtScopeExit(&lock) { lock.lock(); };
+
+	closed.clear();
+}
+
+inline bool
+BufferingInputStream::ReadSegments(std::unique_lock<Mutex> &lock) noexcept
+{
+	if (rate_limit > 0)
+		/* throttled; only our input reads */
+		return false;
+
+	bool progress = false;
+	std::forward_list<InputStreamPtr> closed;
+
+	for (auto prev = segments.before_begin(), i = std::next(prev);
+	     i != segments.end();) {
+		auto &segment = **i;
+		bool close = false;
+
+		try {
+			segment.Check();
+
+			if (!segment.IsReady() || !segment.IsAvailable()) {
+			} else if (segment.IsEOF()) {
+				close = true;
+			} else {
+				const size_t read_offset = segment.GetOffset();
+				auto w = buffer.Write(read_offset);
+				if (w.empty()) {
+					/* this segment has reached
+					   data which is already in the
+					   buffer */
+					close = true;
+				} else {
+					if (w.size() > MAX_READ)
+						w = w.first(MAX_READ);
+
+					size_t nbytes = segment.Read(lock, w);
+					buffer.Commit(read_offset,
+						      read_offset + nbytes);
+					progress = true;
+				}
+			}
+		} catch (...) {
+			/* ignore; the hole will be filled by our input
+			   later */
+			close = true;
+		}
+
+		if (close) {
+			closed.splice_after(closed.before_begin(),
+					    segments, prev);
+			i = std::next(prev);
+		} else
+			prev = i++;
+	}
+
+	if (progress) {
+		client_cond.notify_all();
+		OnBufferAvailable();
+	}
+
+	if (!closed.empty()) {
+		CloseSegments(lock, std::move(closed));
+		progress = true;
+	}
+
+	return progress;
+}
+
+inline bool
+BufferingInputStream::SeekNextHole(std::unique_lock<Mutex> &lock,
+				   bool segment_progress)
+{
+	size_t new_offset = FindFirstHole();
+	if (new_offset == INVALID_OFFSET)
+		new_offset = SplitLargestHole();
+
+	if (new_offset != INVALID_OFFSET) {
+		input->Seek(lock, new_offset);
+		return true;
+	}
+
+	if (segments.empty())
+		/* the file has been read completely */
+		return false;
+
+	/* the remaining holes are being filled by segments; wait
+	   for them */
+	if (!segment_progress)
+		wake_cond.wait(lock);
+	return true;
+}
+
 inline void
 BufferingInputStream::RunThreadLocked(std::unique_lock<Mutex> &lock)
 {
 	while (!stop) {
+		if (!segments_opened && rate_limit == 0) {
+			segments_opened = true;
+			OpenSegments();
+			continue;
+		}
+
+		const bool segment_progress = ReadSegments(lock);
+
 		if (want_offset != INVALID_OFFSET) {
 			assert(want_offset < size());
 
@@ -114,49 +304,44 @@ BufferingInputStream::RunThreadLocked(std::unique_lock<Mutex> &lock)
 			/* our input has reached its end: prepare
 			   reading the first remaining hole */
 
-			size_t new_offset = FindFirstHole();
-			if (new_offset == INVALID_OFFSET) {
-				/* the file has been read completely */
+			if (!SeekNextHole(lock, segment_progress))
 				break;
+		} else if (input->IsAvailable()) {
+			if (rate_limit > 0 &&
+			    std::chrono::steady_clock::now() < throttle_until) {
+				/* throttled; SetRateLimit() interrupts
+				   this wait */
+				wake_cond.wait_until(lock, throttle_until);
+				continue;
 			}
 
-			/* seek to the first hole */
-			input->Seek(lock, new_offset);
-		} else if (input->IsAvailable()) {
 			const auto read_offset = input->GetOffset();
 			auto w = buffer.Write(read_offset);
 
 			if (w.empty()) {
-				size_t new_offset = FindFirstHole();
-				if (new_offset == INVALID_OFFSET)
-					/* the file has been read
-					   completely */
+				if (!SeekNextHole(lock, segment_progress))
 					break;
 
-				input->Seek(lock, new_offset);
-
 				continue;
 			}
 
-			/* enforce an upper limit for each
-			   InputStream::Read() call; this is necessary
-			   for plugins which are unable to do partial
-			   reads, e.g. when reading local files, the
-			   read() system call will not return until
-			   all requested bytes have been read from the
-			   hard disk, instead of returning when "some"
-			   data has been read */
-			constexpr size_t MAX_READ = 64 * 1024;
-
 			if (w.size() > MAX_READ)
 				w = w.first(MAX_READ);
 
 			size_t nbytes = input->Read(lock, w);
 			buffer.Commit(read_offset, read_offset + nbytes);
 
+			if (rate_limit > 0) {
+				using namespace std::chrono;
+				const auto now = steady_clock::now();
+				throttle_until = std::max(throttle_until, now) +
+					duration_cast<steady_clock::duration>(duration<double>(double(nbytes) / rate_limit));
+			} else
+				throttle_until = {};
+
 			client_cond.notify_all();
 			OnBufferAvailable();
-		} else
+		} else if (!segment_progress)
 			wake_cond.wait(lock);
 	}
 }
@@ -178,11 +363,13 @@ BufferingInputStream::RunThread() noexcept
 
 	/* clear the "input" attribute while holding the mutex */
 	auto _input = std::move(input);
+	auto _segments = std::move(segments);
 
 	/* the mutex must be unlocked while an InputStream can be
 	   destructed */
 	lock.unlock();
 
 	/* and now actually destruct the InputStream */
+	_segments.clear();
 	_input.reset();
 }
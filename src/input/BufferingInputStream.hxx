@@ -10,8 +10,11 @@
 #include "thread/Cond.hxx"
 #include "util/SparseBuffer.hxx"
 
+#include <chrono>
 #include <cstddef>
 #include <exception>
+#include <forward_list>
+#include <span>
 
 /**
  * A "huge" buffer which remembers the (partial) contents of an
@@ -19,8 +22,21 @@
  * a "stream".
  */
 class BufferingInputStream : InputStreamHandler {
+	/**
+	 * Don't open additional segments smaller than this.
+	 */
+	static constexpr std::size_t MIN_SEGMENT_SIZE = 1024 * 1024;
+
 	InputStreamPtr input;
 
+	/**
+	 * Additional streams of the same resource (see
+	 * InputStream::OpenSegment()) which fill other parts of the
+	 * buffer in parallel.  Each one is closed as soon as it
+	 * reaches data which is already in the buffer.
+	 */
+	std::forward_list<InputStreamPtr> segments;
+
 public:
 	Mutex &mutex;
 
@@ -43,12 +59,29 @@ private:
 
 	bool stop = false;
 
+	/**
+	 * Has OpenSegments() been called already?
+	 */
+	bool segments_opened = false;
+
 	/* must be mutable because IsAvailable() acts as a hint to
 	   modify this attribute */
 	mutable size_t want_offset = INVALID_OFFSET;
 
 	std::exception_ptr error, seek_error;
 
+	/**
+	 * The maximum number of bytes per second to be read by the
+	 * thread; 0 means unlimited.  See SetRateLimit().
+	 */
+	std::size_t rate_limit = 0;
+
+	/**
+	 * While #rate_limit is non-zero, the thread does not read
+	 * before this time.
+	 */
+	std::chrono::steady_clock::time_point throttle_until{};
+
 	static constexpr size_t INVALID_OFFSET = ~size_t(0);
 
 public:
@@ -75,6 +108,24 @@ public:
 		return buffer.size();
 	}
 
+	/**
+	 * Returns the whole buffer if the file has been read
+	 * completely (without an error), or an empty span otherwise.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	[[gnu::pure]]
+	std::span<const std::byte> GetCompleteBuffer() const noexcept {
+		if (error)
+			return {};
+
+		const auto r = buffer.Read(0);
+		if (r.undefined_size > 0 || r.defined_buffer.size() < size())
+			return {};
+
+		return r.defined_buffer;
+	}
+
 	/**
 	 * Wrapper for InputStream::Check().
 	 *
@@ -98,6 +149,18 @@ public:
 	size_t Read(std::unique_lock<Mutex> &lock, size_t offset,
 		    std::span<std::byte> dest);
 
+	/**
+	 * Limit the number of bytes per second read by the thread;
+	 * 0 means unlimited.  This is used to give background
+	 * transfers a lower priority.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void SetRateLimit(std::size_t _rate_limit) noexcept {
+		rate_limit = _rate_limit;
+		wake_cond.notify_one();
+	}
+
 protected:
 	/**
 	 * This virtual method gets called each time data has been
@@ -107,15 +170,60 @@ protected:
 	virtual void OnBufferAvailable() noexcept {}
 
 private:
+	/**
+	 * Is somebody already filling the hole at the given offset?
+	 */
+	[[gnu::pure]]
+	bool IsSegmentAt(size_t offset) const noexcept;
+
+	/**
+	 * Find the first hole which is not being filled by one of
+	 * the #segments.
+	 */
 	size_t FindFirstHole() const noexcept;
 
+	/**
+	 * If all holes are being filled by #segments, find the
+	 * middle of the largest one, so our input can help.
+	 */
+	size_t SplitLargestHole() const noexcept;
+
+	/**
+	 * Open additional segments if our input supports it.
+	 */
+	void OpenSegments() noexcept;
+
+	/**
+	 * Close segments which have finished or failed.
+	 */
+	void CloseSegments(std::unique_lock<Mutex> &lock,
+			   std::forward_list<InputStreamPtr> &&closed) noexcept;
+
+	/**
+	 * Read from all #segments which have data available.
+	 *
+	 * @return true if some data was read
+	 */
+	bool ReadSegments(std::unique_lock<Mutex> &lock) noexcept;
+
+	/**
+	 * Determine where to continue reading after our input has
+	 * reached data which is already in the buffer or the end of
+	 * the file, and seek there.
+	 *
+	 * @return false if the file has been read completely
+	 */
+	bool SeekNextHole(std::unique_lock<Mutex> &lock,
+			  bool segment_progress);
+
 	void RunThreadLocked(std::unique_lock<Mutex> &lock);
 	void RunThread() noexcept;
 
 	/* virtual methods from class InputStreamHandler */
 	void OnInputStreamReady() noexcept final {
-		/* this should never be called, because our input must
-		   be "ready" already */
+		/* our input must be "ready" already, but new
+		   segments become ready later */
+		wake_cond.notify_one();
 	}
 
 	void OnInputStreamAvailable() noexcept final {
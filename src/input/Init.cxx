@@ -25,12 +25,18 @@ static constexpr Domain input_domain("input");
 void
 input_stream_global_init(const ConfigData &config, EventLoop &event_loop)
 {
+	const ConfigBlock empty;
+
 #ifdef HAVE_URING
-	InitUringInputPlugin(event_loop);
+	if (const auto *block =
+	    config.FindBlock(ConfigBlockOption::INPUT, "plugin", "io_uring")) {
+		block->SetUsed();
+		if (block->GetBlockValue("enabled", true))
+			InitUringInputPlugin(event_loop, *block);
+	} else
+		InitUringInputPlugin(event_loop, empty);
 #endif
 
-	const ConfigBlock empty;
-
 	for (unsigned i = 0; input_plugins[i] != nullptr; ++i) {
 		const InputPlugin *plugin = input_plugins[i];
 
@@ -76,4 +82,8 @@ input_stream_global_finish() noexcept
 	for (const auto &plugin : GetEnabledInputPlugins())
 		if (plugin.finish != nullptr)
 			plugin.finish();
+
+#ifdef HAVE_URING
+	FinishUringInputPlugin();
+#endif
 }
@@ -85,6 +85,18 @@ InputStream::LockReadTag() noexcept
 	return ReadTag();
 }
 
+unsigned
+InputStream::GetMaxSegments() const noexcept
+{
+	return 1;
+}
+
+InputStreamPtr
+InputStream::OpenSegment([[maybe_unused]] offset_type new_offset)
+{
+	return nullptr;
+}
+
 bool
 InputStream::IsAvailable() const noexcept
 {
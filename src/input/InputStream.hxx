@@ -336,6 +336,29 @@ public:
 	[[nodiscard]]
 	std::unique_ptr<Tag> LockReadTag() noexcept;
 
+	/**
+	 * How many streams of this resource may be read in parallel
+	 * (this one and those returned by OpenSegment())?
+	 *
+	 * The caller must lock the mutex.
+	 */
+	[[gnu::pure]]
+	virtual unsigned GetMaxSegments() const noexcept;
+
+	/**
+	 * Open another stream of the same resource which starts at
+	 * the given offset (e.g. a HTTP "Range" request), so several
+	 * parts can be read in parallel.  The new stream uses the
+	 * same mutex and may not be ready yet.
+	 *
+	 * The caller must not lock the mutex.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the new stream or nullptr if this is not supported
+	 */
+	virtual InputStreamPtr OpenSegment(offset_type new_offset);
+
 	/**
 	 * Returns true if the next read operation will not block: either data
 	 * is available, or end-of-stream has been reached, or an error has
@@ -21,6 +21,14 @@ LastInputStream::Close() noexcept
 	close_timer.Cancel();
 }
 
+InputStreamPtr
+LastInputStream::Steal() noexcept
+{
+	uri.clear();
+	close_timer.Cancel();
+	return std::move(is);
+}
+
 void
 LastInputStream::OnCloseTimer() noexcept
 {
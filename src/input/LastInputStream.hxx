@@ -59,6 +59,13 @@ public:
 
 	void Close() noexcept;
 
+	/**
+	 * Transfer ownership of the #InputStream to the caller, e.g.
+	 * to use it in another thread.  Its #Mutex is still owned by
+	 * this object, which must therefore outlive it.
+	 */
+	InputStreamPtr Steal() noexcept;
+
 private:
 	void ScheduleClose() noexcept {
 		close_timer.Schedule(std::chrono::seconds(20));
@@ -97,6 +97,21 @@ ProxyInputStream::ReadTag() noexcept
 	return input->ReadTag();
 }
 
+unsigned
+ProxyInputStream::GetMaxSegments() const noexcept
+{
+	return input ? input->GetMaxSegments() : 1;
+}
+
+InputStreamPtr
+ProxyInputStream::OpenSegment(offset_type new_offset)
+{
+	if (!input)
+		return nullptr;
+
+	return input->OpenSegment(new_offset);
+}
+
 bool
 ProxyInputStream::IsAvailable() const noexcept
 {
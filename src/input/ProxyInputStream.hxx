@@ -48,6 +48,8 @@ public:
 		  offset_type new_offset) override;
 	bool IsEOF() const noexcept override;
 	std::unique_ptr<Tag> ReadTag() noexcept override;
+	unsigned GetMaxSegments() const noexcept override;
+	InputStreamPtr OpenSegment(offset_type new_offset) override;
 	bool IsAvailable() const noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    std::span<std::byte> dest) override;
@@ -31,6 +31,10 @@
 #include "plugins/MmsInputPlugin.hxx"
 #endif
 
+#ifdef ENABLE_SNAPCAST_INPUT
+#include "plugins/SnapcastInputPlugin.hxx"
+#endif
+
 #ifdef ENABLE_CDIO_PARANOIA
 #include "plugins/CdioParanoiaInputPlugin.hxx"
 #endif
@@ -57,6 +61,9 @@ constinit const InputPlugin *const input_plugins[] = {
 #ifdef ENABLE_MMS
 	&input_plugin_mms,
 #endif
+#ifdef ENABLE_SNAPCAST_INPUT
+	&input_plugin_snapcast,
+#endif
 #ifdef ENABLE_CDIO_PARANOIA
 	&input_plugin_cdio_paranoia,
 #endif
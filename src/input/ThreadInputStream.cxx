@@ -2,12 +2,19 @@
 // Copyright The Music Player Daemon Project
 
 #include "ThreadInputStream.hxx"
+#include "AsyncBufferConfig.hxx"
 #include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 
 #include <string.h>
 
+static constexpr Domain thread_input_domain("thread_input");
+
 ThreadInputStream::ThreadInputStream(const char *_plugin,
 				     const char *_uri,
 				     Mutex &_mutex,
@@ -15,12 +22,25 @@ ThreadInputStream::ThreadInputStream(const char *_plugin,
 	:InputStream(_uri, _mutex),
 	 plugin(_plugin),
 	 thread(BIND_THIS_METHOD(ThreadFunc)),
-	 allocation(_buffer_size)
+	 allocation(_buffer_size),
+	 buffer(std::in_place, allocation),
+	 resume_at(AsyncInputBufferConfig::GetResumeAt(_buffer_size)),
+	 max_buffer_size(_buffer_size),
+	 estimator(std::chrono::steady_clock::now())
 {
 	allocation.SetName("InputStream");
 	allocation.ForkCow(false);
 }
 
+ThreadInputStream::ThreadInputStream(const char *_plugin,
+				     const char *_uri,
+				     Mutex &_mutex,
+				     const AsyncInputBufferConfig &config) noexcept
+	:ThreadInputStream(_plugin, _uri, _mutex, config.size)
+{
+	max_buffer_size = config.max_size;
+}
+
 void
 ThreadInputStream::Stop() noexcept
 {
@@ -37,7 +57,7 @@ ThreadInputStream::Stop() noexcept
 
 	thread.Join();
 
-	buffer.Clear();
+	buffer->Clear();
 }
 
 void
@@ -54,6 +74,43 @@ ThreadInputStream::ThreadSeek([[maybe_unused]] offset_type new_offset)
 	throw std::runtime_error{"Not seekable"};
 }
 
+inline void
+ThreadInputStream::Grow() noexcept
+{
+	const std::size_t capacity = buffer->GetCapacity();
+	const std::size_t target = std::min(std::bit_ceil(estimator.GetTargetSize()),
+					    max_buffer_size);
+	if (target <= capacity)
+		return;
+
+	try {
+		HugeArray<std::byte> new_allocation(target);
+		new_allocation.SetName("InputStream");
+		new_allocation.ForkCow(false);
+
+		/* move the buffered data to the beginning of the
+		   new buffer */
+		std::size_t buffered = 0;
+		for (auto r = buffer->Read(); !r.empty(); r = buffer->Read()) {
+			std::copy(r.begin(), r.end(), new_allocation.begin() + buffered);
+			buffered += r.size();
+			buffer->Consume(r.size());
+		}
+
+		buffer.reset();
+		allocation = std::move(new_allocation);
+		buffer.emplace(allocation);
+		buffer->Append(buffered);
+		resume_at = AsyncInputBufferConfig::GetResumeAt(target);
+	} catch (...) {
+		/* out of memory: keep the old buffer */
+		return;
+	}
+
+	FmtDebug(thread_input_domain, "Growing input buffer of {:?} to {} kB",
+		 GetURI(), target / 1024);
+}
+
 inline void
 ThreadInputStream::ThreadFunc() noexcept
 {
@@ -79,7 +136,8 @@ ThreadInputStream::ThreadFunc() noexcept
 			const auto seek_offset_copy = offset = seek_offset;
 			seek_offset = UNKNOWN_SIZE;
 			eof = false;
-			buffer.Clear();
+			paused = false;
+			buffer->Clear();
 
 			try {
 				const ScopeUnlock unlock(mutex);
@@ -93,8 +151,26 @@ ThreadInputStream::ThreadFunc() noexcept
 			offset = seek_offset_copy;
 		}
 
-		auto w = buffer.Write();
-		if (w.empty()) {
+		if (grow_requested) {
+			grow_requested = false;
+			if (IsAdaptive())
+				Grow();
+		}
+
+		if (buffer->empty())
+			/* rewind to make the whole buffer available
+			   to the next ThreadRead() call */
+			buffer->Clear();
+
+		if (buffer->IsFull())
+			paused = true;
+		else if (paused && buffer->GetSize() < resume_at)
+			paused = false;
+
+		auto w = buffer->Write();
+		if (paused || eof) {
+			/* after the end of the stream, keep the
+			   thread around for a Seek() */
 			wake_cond.wait(lock);
 		} else {
 			size_t nbytes;
@@ -114,10 +190,10 @@ ThreadInputStream::ThreadFunc() noexcept
 
 			if (nbytes == 0) {
 				eof = true;
-				break;
+				continue;
 			}
 
-			buffer.Append(nbytes);
+			buffer->Append(nbytes);
 		}
 	}
 
@@ -145,7 +221,9 @@ void
 ThreadInputStream::Seek([[maybe_unused]] std::unique_lock<Mutex> &lock,
 			offset_type new_offset)
 {
-	seek_offset = new_offset;
+	/* Read() waits until the thread has completed the seek,
+	   but the new offset is visible immediately */
+	offset = seek_offset = new_offset;
 	wake_cond.notify_one();
 }
 
@@ -164,19 +242,38 @@ ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
 			continue;
 		}
 
-		auto r = buffer.Read();
+		auto r = buffer->Read();
 		if (!r.empty()) {
 			size_t nbytes = std::min(dest.size(), r.size());
 			memcpy(dest.data(), r.data(), nbytes);
-			buffer.Consume(nbytes);
-			wake_cond.notify_one();
+			buffer->Consume(nbytes);
 			offset += nbytes;
+
+			/* wake up the thread only if it has paused
+			   and there is enough room for a burst */
+			if (paused && buffer->GetSize() < resume_at)
+				wake_cond.notify_one();
+
+			if (IsAdaptive()) {
+				const auto now = std::chrono::steady_clock::now();
+				estimator.OnStallEnd(now);
+				estimator.OnConsumed(nbytes, now);
+			}
+
 			return nbytes;
 		}
 
 		if (eof)
 			return 0;
 
+		if (IsAdaptive() && !estimator.IsStalled()) {
+			/* the buffer has run dry: let the thread
+			   make it larger if previous stalls suggest
+			   so, and measure this one */
+			grow_requested = true;
+			estimator.OnStallBegin(std::chrono::steady_clock::now());
+		}
+
 		caller_cond.wait(lock);
 	}
 }
@@ -186,5 +283,5 @@ ThreadInputStream::IsEOF() const noexcept
 {
 	assert(!thread.IsInside());
 
-	return eof && buffer.empty() && !IsSeeking();
+	return eof && buffer->empty() && !IsSeeking();
 }
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "InputStream.hxx"
+#include "BufferEstimator.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Cond.hxx"
 #include "util/HugeAllocator.hxx"
@@ -12,6 +13,9 @@
 #include <cassert>
 #include <cstddef>
 #include <exception>
+#include <optional>
+
+struct AsyncInputBufferConfig;
 
 /**
  * Helper class for moving InputStream implementations with blocking
@@ -20,6 +24,13 @@
  * another thread using the regular #InputStream API.  This class
  * manages the thread and the buffer.
  *
+ * Once the buffer is full, the thread pauses until it has been
+ * drained below the "resume" mark (see
+ * AsyncInputBufferConfig::GetResumeAt()) and then refills it in one
+ * burst with read requests as large as possible, instead of
+ * resuming with a small read each time the reader consumes a few
+ * bytes.
+ *
  * The implementation must call Stop() before its destruction
  * completes.  This cannot be done in ~ThreadInputStream() because at
  * this point, the class has been morphed back to #ThreadInputStream
@@ -46,7 +57,29 @@ class ThreadInputStream : public InputStream {
 
 	HugeArray<std::byte> allocation;
 
-	CircularBuffer<std::byte> buffer{allocation};
+	/**
+	 * The ring buffer inside #allocation.  This is only empty
+	 * while it is being replaced by Grow().
+	 */
+	std::optional<CircularBuffer<std::byte>> buffer;
+
+	/**
+	 * After the buffer has become full, the thread waits until
+	 * it contains less than this number of bytes.
+	 */
+	std::size_t resume_at;
+
+	/**
+	 * The maximum size the buffer may grow to; equal to the
+	 * initial size if the buffer size is fixed.
+	 */
+	std::size_t max_buffer_size;
+
+	/**
+	 * Only used if #max_buffer_size is larger than the buffer
+	 * size.
+	 */
+	InputBufferEstimator estimator;
 
 	offset_type seek_offset = UNKNOWN_SIZE;
 
@@ -60,11 +93,32 @@ class ThreadInputStream : public InputStream {
 	 */
 	bool eof = false;
 
+	/**
+	 * Has the buffer become full?  The thread does not read
+	 * until the buffer has been drained below #resume_at.
+	 */
+	bool paused = false;
+
+	/**
+	 * Has the reader found the buffer empty?  The thread will
+	 * consider growing the buffer (see #estimator).
+	 */
+	bool grow_requested = false;
+
 public:
 	ThreadInputStream(const char *_plugin,
 			  const char *_uri, Mutex &_mutex,
 			  size_t _buffer_size) noexcept;
 
+	/**
+	 * Construct with a buffer configured by the input plugin
+	 * (settings "buffer_size", "adaptive_buffer" and
+	 * "max_buffer_size").
+	 */
+	ThreadInputStream(const char *_plugin,
+			  const char *_uri, Mutex &_mutex,
+			  const AsyncInputBufferConfig &config) noexcept;
+
 #ifndef NDEBUG
 	~ThreadInputStream() override {
 		/* Stop() must have been called already */
@@ -155,5 +209,16 @@ private:
 		return seek_offset != UNKNOWN_SIZE;
 	}
 
+	bool IsAdaptive() const noexcept {
+		return max_buffer_size > buffer->GetCapacity();
+	}
+
+	/**
+	 * Replace the buffer with a larger one if the #estimator
+	 * suggests so, moving the buffered data.  This is called
+	 * by the thread while it is not reading.
+	 */
+	void Grow() noexcept;
+
 	void ThreadFunc() noexcept;
 };
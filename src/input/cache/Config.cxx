@@ -4,9 +4,24 @@
 #include "Config.hxx"
 #include "config/Block.hxx"
 #include "config/Parser.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/StringAPI.hxx"
 
 static constexpr size_t KILOBYTE = 1024;
 static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
+static constexpr size_t GIGABYTE = 1024 * MEGABYTE;
+
+static InputCachePolicy
+ParseInputCachePolicy(const char *s)
+{
+	if (StringIsEqual(s, "lru"))
+		return InputCachePolicy::LRU;
+	else if (StringIsEqual(s, "slru"))
+		return InputCachePolicy::SLRU;
+	else
+		throw FmtRuntimeError("Unknown cache policy: {:?}", s);
+}
 
 InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 {
@@ -16,4 +31,31 @@ InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 		size = size_param->With([](const char *s){
 			return ParseSize(s);
 		});
+
+	policy = InputCachePolicy::LRU;
+	const auto *policy_param = block.GetBlockParam("policy");
+	if (policy_param != nullptr)
+		policy = policy_param->With(ParseInputCachePolicy);
+
+	prefetch = block.GetPositiveValue("prefetch", 1U);
+
+	prefetch_duration = block.GetDuration("prefetch_duration",
+					      std::chrono::seconds{1},
+					      std::chrono::steady_clock::duration::zero());
+
+	max_prefetch_rate = 0;
+	const auto *rate_param = block.GetBlockParam("max_prefetch_rate");
+	if (rate_param != nullptr)
+		max_prefetch_rate = rate_param->With([](const char *s){
+			return ParseSize(s);
+		});
+
+	disk_directory = block.GetPath("disk_directory");
+
+	disk_size = uint_least64_t{4} * GIGABYTE;
+	const auto *disk_size_param = block.GetBlockParam("disk_size");
+	if (disk_size_param != nullptr)
+		disk_size = disk_size_param->With([](const char *s){
+			return ParseSize(s);
+		});
 }
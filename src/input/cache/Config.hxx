@@ -4,13 +4,65 @@
 #ifndef MPD_INPUT_CACHE_CONFIG_HXX
 #define MPD_INPUT_CACHE_CONFIG_HXX
 
+#include "fs/AllocatedPath.hxx"
+
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 
 struct ConfigBlock;
 
+enum class InputCachePolicy : uint_least8_t {
+	/**
+	 * Evict the least recently used item.
+	 */
+	LRU,
+
+	/**
+	 * Segmented LRU: new items are "probationary" and are
+	 * promoted to the "protected" segment when they are used
+	 * again.  Probationary items are evicted first, so a series
+	 * of files which are used only once cannot flush the
+	 * frequently used ones.
+	 */
+	SLRU,
+};
+
 struct InputCacheConfig {
 	size_t size;
 
+	InputCachePolicy policy;
+
+	/**
+	 * The directory of the on-disk cache tier; nullptr if it is
+	 * disabled.
+	 */
+	AllocatedPath disk_directory = nullptr;
+
+	/**
+	 * The maximum size of the on-disk cache tier.
+	 */
+	uint_least64_t disk_size;
+
+	/**
+	 * The number of upcoming queue songs to be prefetched.
+	 */
+	unsigned prefetch;
+
+	/**
+	 * The maximum known duration of the upcoming queue songs to
+	 * be prefetched; zero means no limit (other than
+	 * #prefetch).
+	 */
+	std::chrono::steady_clock::duration prefetch_duration;
+
+	/**
+	 * The maximum transfer rate (bytes per second) of each
+	 * prefetch while the song is not being played; 0 means no
+	 * limit.
+	 */
+	size_t max_prefetch_rate;
+
 	explicit InputCacheConfig(const ConfigBlock &block);
 };
 
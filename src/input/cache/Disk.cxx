@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Disk.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FileLineReader.hxx"
+#include "io/FileOutputStream.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "system/Error.hxx"
+#include "util/CharUtil.hxx"
+#include "util/CNumberParser.hxx"
+#include "util/Domain.hxx"
+#include "util/SpanCast.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+static constexpr Domain cache_disk_domain("input_cache_disk");
+
+/**
+ * The number of hex digits of the hash in a content file name.
+ */
+static constexpr std::size_t HASH_DIGITS = 16;
+
+static constexpr std::string_view INDEX_NAME = "index";
+
+static std::string
+MakeContentName(std::span<const std::byte> data) noexcept
+{
+	/* the size is part of the name to make collisions even less
+	   likely */
+	const uint_least64_t hash =
+		std::hash<std::string_view>{}(ToStringView(data));
+	return fmt::format("{:0{}x}-{}", hash, HASH_DIGITS, data.size());
+}
+
+/**
+ * Does this look like a name generated by MakeContentName()?
+ */
+[[gnu::pure]]
+static bool
+IsContentName(std::string_view name) noexcept
+{
+	if (name.size() < HASH_DIGITS + 2 || name[HASH_DIGITS] != '-')
+		return false;
+
+	const auto hash = name.substr(0, HASH_DIGITS);
+	const auto size = name.substr(HASH_DIGITS + 1);
+	return std::all_of(hash.begin(), hash.end(), IsHexDigit) &&
+		std::all_of(size.begin(), size.end(), IsDigitASCII);
+}
+
+static constexpr uint_least64_t
+ToNanoseconds(std::chrono::system_clock::time_point t) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+static constexpr std::chrono::system_clock::time_point
+FromNanoseconds(uint_least64_t ns) noexcept
+{
+	using std::chrono::system_clock;
+	return system_clock::time_point{std::chrono::duration_cast<system_clock::duration>(std::chrono::nanoseconds(ns))};
+}
+
+/**
+ * Obtain the size and modification time of the original (local)
+ * file.
+ *
+ * @return false if the file is not accessible
+ */
+static bool
+GetOriginalFileInfo(std::string_view uri, FileInfo &info) noexcept
+{
+	const auto path = AllocatedPath::FromUTF8(uri);
+	return !path.IsNull() && GetFileInfo(path, info) && info.IsRegular();
+}
+
+InputCacheDisk::InputCacheDisk(AllocatedPath _directory,
+			       uint_least64_t _max_size) noexcept
+	:directory(std::move(_directory)),
+	 index_path(GetContentPath(INDEX_NAME)),
+	 max_size(_max_size)
+{
+	try {
+		Load();
+	} catch (...) {
+		FmtError(cache_disk_domain,
+			 "Failed to load the index {:?}: {}",
+			 index_path, std::current_exception());
+	}
+
+	RemoveOrphans();
+
+	FmtDebug(cache_disk_domain, "Loaded {} entries ({} bytes)",
+		 entries.size(), total_size);
+}
+
+AllocatedPath
+InputCacheDisk::GetContentPath(std::string_view name) const noexcept
+{
+	return directory / AllocatedPath::FromUTF8(name);
+}
+
+inline void
+InputCacheDisk::Load()
+{
+	FileInfo index_info;
+	if (!GetFileInfo(index_path, index_info))
+		/* no index yet */
+		return;
+
+	FileLineReader reader{index_path};
+
+	const char *line;
+	while ((line = reader.ReadLine()) != nullptr) {
+		/* format: "NAME MTIME URI" */
+
+		const char *space = std::strchr(line, ' ');
+		if (space == nullptr)
+			continue;
+
+		std::string_view name{line, space};
+		if (!IsContentName(name))
+			continue;
+
+		char *endptr;
+		const auto mtime = ParseUint64(space + 1, &endptr);
+		if (*endptr != ' ' || endptr[1] == 0)
+			continue;
+
+		const std::string_view uri{endptr + 1};
+		if (by_uri.contains(uri))
+			continue;
+
+		/* make sure the content file still exists */
+		FileInfo info;
+		if (!GetFileInfo(GetContentPath(name), info) ||
+		    !info.IsRegular())
+			continue;
+
+		Insert({
+			std::string{uri},
+			std::string{name},
+			info.GetSize(),
+			FromNanoseconds(mtime),
+		});
+	}
+}
+
+void
+InputCacheDisk::RemoveOrphans() noexcept
+try {
+	DirectoryReader reader{directory};
+	while (reader.ReadEntry()) {
+		const auto name = reader.GetEntry().ToUTF8();
+		if (IsContentName(name) && !references.contains(name))
+			RemoveFile(GetContentPath(name));
+	}
+} catch (...) {
+	FmtError(cache_disk_domain,
+		 "Failed to clean up {:?}: {}",
+		 directory, std::current_exception());
+}
+
+void
+InputCacheDisk::Save() noexcept
+try {
+	FileOutputStream fos{index_path};
+	BufferedOutputStream bos{fos};
+
+	for (const auto &i : entries)
+		bos.Fmt(FMT_STRING("{} {} {}\n"),
+			i.name, ToNanoseconds(i.mtime), i.uri);
+
+	bos.Flush();
+	fos.Commit();
+} catch (...) {
+	FmtError(cache_disk_domain,
+		 "Failed to save the index {:?}: {}",
+		 index_path, std::current_exception());
+}
+
+void
+InputCacheDisk::Insert(Entry &&entry) noexcept
+{
+	if (++references[entry.name] == 1)
+		total_size += entry.size;
+
+	entries.push_back(std::move(entry));
+
+	const auto i = std::prev(entries.end());
+	by_uri.emplace(i->uri, i);
+}
+
+void
+InputCacheDisk::Erase(EntryList::iterator i) noexcept
+{
+	by_uri.erase(i->uri);
+
+	if (auto r = references.find(i->name); --r->second == 0) {
+		references.erase(r);
+
+		assert(total_size >= i->size);
+		total_size -= i->size;
+
+		try {
+			RemoveFile(GetContentPath(i->name));
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+
+	entries.erase(i);
+}
+
+void
+InputCacheDisk::Shrink(uint_least64_t add) noexcept
+{
+	while (!entries.empty() && total_size + add > max_size)
+		Erase(entries.begin());
+}
+
+AllocatedPath
+InputCacheDisk::Lookup(std::string_view uri) noexcept
+{
+	const auto i = by_uri.find(uri);
+	if (i == by_uri.end())
+		return nullptr;
+
+	const auto e = i->second;
+
+	if (FileInfo info;
+	    !GetOriginalFileInfo(uri, info) ||
+	    info.GetSize() != e->size ||
+	    info.GetModificationTime() != e->mtime) {
+		/* the original file has been modified or deleted */
+		Erase(e);
+		Save();
+		return nullptr;
+	}
+
+	auto path = GetContentPath(e->name);
+	if (FileInfo info;
+	    !GetFileInfo(path, info) || info.GetSize() != e->size) {
+		/* the copy has been deleted or damaged */
+		Erase(e);
+		Save();
+		return nullptr;
+	}
+
+	/* refresh */
+	entries.splice(entries.end(), entries, e);
+
+	return path;
+}
+
+void
+InputCacheDisk::Store(std::string_view uri,
+		      std::span<const std::byte> data) noexcept
+{
+	if (data.size() > max_size)
+		return;
+
+	FileInfo info;
+	if (!GetOriginalFileInfo(uri, info) || info.GetSize() != data.size())
+		/* the file has been modified meanwhile */
+		return;
+
+	if (auto i = by_uri.find(uri); i != by_uri.end()) {
+		const auto e = i->second;
+		if (e->size == data.size() &&
+		    e->mtime == info.GetModificationTime()) {
+			/* already stored */
+			entries.splice(entries.end(), entries, e);
+			Save();
+			return;
+		}
+
+		Erase(e);
+	}
+
+	auto name = MakeContentName(data);
+
+	if (!references.contains(name)) {
+		Shrink(data.size());
+
+		try {
+			const auto path = GetContentPath(name);
+			FileOutputStream fos{path};
+			fos.Write(data);
+			fos.Commit();
+		} catch (...) {
+			FmtError(cache_disk_domain,
+				 "Failed to store {:?}: {}",
+				 uri, std::current_exception());
+			Save();
+			return;
+		}
+	}
+
+	Insert({
+		std::string{uri},
+		std::move(name),
+		data.size(),
+		info.GetModificationTime(),
+	});
+
+	Save();
+}
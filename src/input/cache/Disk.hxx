@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_INPUT_CACHE_DISK_HXX
+#define MPD_INPUT_CACHE_DISK_HXX
+
+#include "fs/AllocatedPath.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * The persistent second tier of the #InputCacheManager: files which
+ * are evicted from RAM are stored in a directory (which should be on
+ * a fast local disk), and can be loaded from there instead of
+ * fetching them again from (slow) network storage.
+ *
+ * Each file is named after a hash of its contents, therefore
+ * identical files are stored only once.  An index file maps URIs to
+ * content files; it is rewritten after each modification and loaded
+ * at startup.
+ *
+ * This class is not thread-safe.
+ */
+class InputCacheDisk {
+	struct Entry {
+		std::string uri;
+
+		/**
+		 * The name of the content file in #directory.
+		 */
+		std::string name;
+
+		uint_least64_t size;
+
+		/**
+		 * The modification time of the original file at the
+		 * time it was stored.
+		 */
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	const AllocatedPath directory;
+	const AllocatedPath index_path;
+
+	const uint_least64_t max_size;
+
+	/**
+	 * The total size of all content files.
+	 */
+	uint_least64_t total_size = 0;
+
+	/**
+	 * All entries, the least recently used one first.
+	 */
+	EntryList entries;
+
+	/**
+	 * Look up #entries by their URI; the keys point to
+	 * Entry::uri.
+	 */
+	std::unordered_map<std::string_view, EntryList::iterator> by_uri;
+
+	/**
+	 * The number of #entries referring to each content file.
+	 */
+	std::map<std::string, unsigned, std::less<>> references;
+
+public:
+	/**
+	 * Loads the index.  Errors are logged.
+	 */
+	InputCacheDisk(AllocatedPath _directory,
+		       uint_least64_t _max_size) noexcept;
+
+	InputCacheDisk(const InputCacheDisk &) = delete;
+	InputCacheDisk &operator=(const InputCacheDisk &) = delete;
+
+	/**
+	 * The total size of all files in this cache.
+	 */
+	uint_least64_t GetTotalSize() const noexcept {
+		return total_size;
+	}
+
+	/**
+	 * Look up a copy of the given local file.  It is only
+	 * returned if the original file's size and modification time
+	 * have not changed since.
+	 *
+	 * @return the path of the copy or nullptr if there is none
+	 */
+	AllocatedPath Lookup(std::string_view uri) noexcept;
+
+	/**
+	 * Store the complete contents of the given local file.
+	 * Least recently used files are removed to make room for it.
+	 * Errors are logged.
+	 */
+	void Store(std::string_view uri,
+		   std::span<const std::byte> data) noexcept;
+
+private:
+	AllocatedPath GetContentPath(std::string_view name) const noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Load();
+
+	/**
+	 * Delete content files which are not referenced by the index
+	 * (e.g. left over by a crash).
+	 */
+	void RemoveOrphans() noexcept;
+
+	/**
+	 * Rewrite the index file.  Errors are logged.
+	 */
+	void Save() noexcept;
+
+	void Insert(Entry &&entry) noexcept;
+
+	/**
+	 * Remove the entry and delete its content file if it is not
+	 * referenced anymore.
+	 */
+	void Erase(EntryList::iterator i) noexcept;
+
+	/**
+	 * Remove least recently used entries until the given number
+	 * of bytes fits.
+	 */
+	void Shrink(uint_least64_t add) noexcept;
+};
+
+#endif
@@ -13,16 +13,36 @@ InputCacheItem::InputCacheItem(InputStreamPtr _input) noexcept
 {
 }
 
+InputCacheItem::InputCacheItem(InputStreamPtr _input,
+			       std::string_view _uri) noexcept
+	:BufferingInputStream(std::move(_input)),
+	 uri(_uri)
+{
+}
+
 InputCacheItem::~InputCacheItem() noexcept
 {
 	assert(leases.empty());
 }
 
+void
+InputCacheItem::SetBackgroundRateLimit(std::size_t rate) noexcept
+{
+	const std::scoped_lock lock{mutex};
+	background_rate_limit = rate;
+
+	if (leases.empty())
+		SetRateLimit(background_rate_limit);
+}
+
 void
 InputCacheItem::AddLease(InputCacheLease &lease) noexcept
 {
 	const std::scoped_lock lock{mutex};
 	leases.push_back(lease);
+
+	/* somebody needs this item now; stop throttling */
+	SetRateLimit(0);
 }
 
 void
@@ -34,6 +54,9 @@ InputCacheItem::RemoveLease(InputCacheLease &lease) noexcept
 		++next_lease;
 	leases.erase(i);
 
+	if (leases.empty())
+		SetRateLimit(background_rate_limit);
+
 	// TODO: ensure that OnBufferAvailable() isn't currently running
 }
 
@@ -9,6 +9,7 @@
 #include "util/IntrusiveList.hxx"
 #include "util/IntrusiveHashSet.hxx"
 
+#include <cstddef>
 #include <string>
 
 class InputCacheLease;
@@ -32,8 +33,40 @@ class InputCacheItem final
 	LeaseList leases;
 	LeaseList::iterator next_lease = leases.end();
 
+	/**
+	 * See SetBackgroundRateLimit().  Protected by the mutex.
+	 */
+	std::size_t background_rate_limit = 0;
+
 public:
+	/**
+	 * Is this item in the "protected" segment of the
+	 * #InputCacheManager?  Managed by #InputCacheManager.
+	 */
+	bool is_protected = false;
+
+	/**
+	 * Was this item created by InputCacheManager::Prefetch() and
+	 * has it not been used by a real Get() call since?  Such
+	 * items are canceled when they fall out of the prefetch
+	 * window.  Managed by #InputCacheManager.
+	 */
+	bool prefetch_only = false;
+
+	/**
+	 * The InputCacheManager::prefetch_generation in which this
+	 * item was last part of the prefetch window.
+	 */
+	unsigned prefetch_generation = 0;
+
 	explicit InputCacheItem(InputStreamPtr _input) noexcept;
+
+	/**
+	 * @param _uri the URI of this item, if it differs from the
+	 * #InputStream's URI (e.g. when it is loaded from the
+	 * #InputCacheDisk)
+	 */
+	InputCacheItem(InputStreamPtr _input, std::string_view _uri) noexcept;
 	~InputCacheItem() noexcept;
 
 	const std::string &GetUri() const noexcept {
@@ -47,6 +80,21 @@ public:
 		return !leases.empty();
 	}
 
+	/**
+	 * Has the file been read completely?
+	 */
+	[[gnu::pure]]
+	bool IsComplete() const noexcept {
+		const std::scoped_lock lock{mutex};
+		return !GetCompleteBuffer().empty();
+	}
+
+	/**
+	 * Limit the transfer rate (bytes per second) while this item
+	 * has no leases, i.e. while nobody is waiting for it.
+	 */
+	void SetBackgroundRateLimit(std::size_t rate) noexcept;
+
 	void AddLease(InputCacheLease &lease) noexcept;
 	void RemoveLease(InputCacheLease &lease) noexcept;
 
@@ -3,11 +3,15 @@
 
 #include "Manager.hxx"
 #include "Config.hxx"
+#include "Disk.hxx"
 #include "Item.hxx"
 #include "Lease.hxx"
 #include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
 #include "fs/Traits.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <string.h>
 
@@ -17,32 +21,82 @@ InputCacheManager::ItemGetUri::operator()(const InputCacheItem &item) const noex
 	return item.GetUri();
 }
 
+static constexpr Domain cache_domain("input_cache");
+
+/**
+ * The share of the cache (in percent) which may be occupied by
+ * "protected" items with InputCachePolicy::SLRU.
+ */
+static constexpr unsigned SLRU_PROTECTED_PERCENT = 80;
+
 InputCacheManager::InputCacheManager(const InputCacheConfig &config) noexcept
-	:max_total_size(config.size)
+	:max_total_size(config.size),
+	 max_protected_size(config.size / 100 * SLRU_PROTECTED_PERCENT),
+	 policy(config.policy),
+	 prefetch_count(config.prefetch),
+	 prefetch_duration(config.prefetch_duration),
+	 max_prefetch_rate(config.max_prefetch_rate)
 {
+	if (!config.disk_directory.IsNull())
+		disk = std::make_unique<InputCacheDisk>(config.disk_directory,
+							config.disk_size);
 }
 
 InputCacheManager::~InputCacheManager() noexcept
 {
-	items_by_time.clear_and_dispose(DeleteDisposer());
+	/* keep the RAM contents for the next run (the protected
+	   items last, because they are the most valuable ones) */
+	const auto spill_and_delete = [this](InputCacheItem *item){
+		Spill(*item);
+		delete item;
+	};
+
+	items_by_time.clear_and_dispose(spill_and_delete);
+	protected_items.clear_and_dispose(spill_and_delete);
 }
 
 void
 InputCacheManager::Flush() noexcept
 {
-	items_by_time.remove_and_dispose_if([](const InputCacheItem &item){
+	const auto is_unused = [](const InputCacheItem &item){
 		return !item.IsInUse();
-	}, [this](InputCacheItem *item){
+	};
+
+	const auto dispose = [this](InputCacheItem *item){
 		// TODO: eliminate code duplication, see method Remove()
 		assert(total_size >= item->size());
 		total_size -= item->size();
+
+		if (item->is_protected) {
+			assert(protected_size >= item->size());
+			protected_size -= item->size();
+		}
+
 		items_by_uri.erase(items_by_uri.iterator_to(*item));
 		delete item;
-	});
+	};
+
+	items_by_time.remove_and_dispose_if(is_unused, dispose);
+	protected_items.remove_and_dispose_if(is_unused, dispose);
 
 	// TODO: invalidate busy items and flush them later
 }
 
+InputCacheStats
+InputCacheManager::GetStats() const noexcept
+{
+	return {
+		.size = total_size,
+		.max_size = max_total_size,
+		.n_items = items_by_uri.size(),
+		.hits = n_hits.load(std::memory_order_relaxed),
+		.misses = n_misses.load(std::memory_order_relaxed),
+		.disk_hits = n_disk_hits.load(std::memory_order_relaxed),
+		.evictions = n_evictions.load(std::memory_order_relaxed),
+		.disk_size = disk ? disk->GetTotalSize() : 0,
+	};
+}
+
 bool
 InputCacheManager::IsEligible(const InputStream &input) const noexcept
 {
@@ -69,9 +123,15 @@ InputCacheManager::Get(const char *uri, bool create)
 	if (auto iter = items_by_uri.find(uri); iter != items_by_uri.end()) {
 		auto &item = *iter;
 
-		/* refresh */
-		items_by_time.erase(items_by_time.iterator_to(item));
-		items_by_time.push_back(item);
+		/* only count real uses, not Contains() */
+		if (create) {
+			n_hits.fetch_add(1, std::memory_order_relaxed);
+
+			/* it is not just a prefetch anymore */
+			item.prefetch_only = false;
+		}
+
+		Touch(item, create);
 
 		// TODO revalidate the cache item using the file's mtime?
 		// TODO if cache item contains error, retry now?
@@ -82,28 +142,142 @@ InputCacheManager::Get(const char *uri, bool create)
 	if (!create)
 		return {};
 
+	InputStreamPtr is;
+
+	if (disk) {
+		if (const auto path = disk->Lookup(uri); !path.IsNull()) {
+			try {
+				is = OpenLocalInputStream(path, mutex);
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to open cached file");
+			}
+		}
+	}
+
+	const bool from_disk = is != nullptr;
+
 	// TODO: wait for "ready" without blocking here
-	auto is = InputStream::OpenReady(uri, mutex);
+	if (!from_disk)
+		is = InputStream::OpenReady(uri, mutex);
 
 	if (!IsEligible(*is))
 		return {};
 
+	n_misses.fetch_add(1, std::memory_order_relaxed);
+	if (from_disk)
+		n_disk_hits.fetch_add(1, std::memory_order_relaxed);
+
 	const size_t size = is->GetSize();
 	total_size += size;
 
 	while (total_size > max_total_size && EvictOldestUnused()) {}
 
-	auto *item = new InputCacheItem(std::move(is));
+	auto *item = from_disk
+		? new InputCacheItem(std::move(is), uri)
+		: new InputCacheItem(std::move(is));
 	items_by_uri.insert(*item);
 	items_by_time.push_back(*item);
 
 	return InputCacheLease(*item);
 }
 
-void
+bool
 InputCacheManager::Prefetch(const char *uri)
 {
-	Get(uri, true);
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		return false;
+
+	if (auto iter = items_by_uri.find(uri); iter != items_by_uri.end()) {
+		/* already cached (or being loaded); just keep it
+		   alive */
+		iter->prefetch_generation = prefetch_generation;
+		Touch(*iter, false);
+		return false;
+	}
+
+	const auto lease = Get(uri, true);
+	if (!lease)
+		return false;
+
+	auto &item = lease.GetCacheItem();
+	item.prefetch_only = true;
+	item.prefetch_generation = prefetch_generation;
+	if (max_prefetch_rate > 0)
+		item.SetBackgroundRateLimit(max_prefetch_rate);
+	return true;
+}
+
+void
+InputCacheManager::EndPrefetch() noexcept
+{
+	/* prefetch-only items are never protected, so there is no
+	   need to look at #protected_items */
+	for (auto i = items_by_time.begin(); i != items_by_time.end();) {
+		auto &item = *i++;
+		if (item.prefetch_only &&
+		    item.prefetch_generation != prefetch_generation &&
+		    !item.IsInUse() && !item.IsComplete()) {
+			/* this prefetch has fallen out of the window
+			   (e.g. because the queue was modified) */
+			FmtDebug(cache_domain, "Cancel prefetch {:?}",
+				 item.GetUri());
+			Delete(&item);
+		}
+	}
+}
+
+void
+InputCacheManager::Spill(InputCacheItem &item) noexcept
+{
+	if (!disk)
+		return;
+
+	std::span<const std::byte> data;
+
+	{
+		const std::scoped_lock lock{item.mutex};
+		data = item.GetCompleteBuffer();
+	}
+
+	/* the buffer of a complete item is not modified anymore, so
+	   it can be accessed without holding the mutex */
+	if (!data.empty())
+		disk->Store(item.GetUri(), data);
+}
+
+void
+InputCacheManager::Touch(InputCacheItem &item, bool hit) noexcept
+{
+	if (item.is_protected) {
+		protected_items.erase(protected_items.iterator_to(item));
+		protected_items.push_back(item);
+		return;
+	}
+
+	items_by_time.erase(items_by_time.iterator_to(item));
+
+	if (!hit || policy != InputCachePolicy::SLRU) {
+		items_by_time.push_back(item);
+		return;
+	}
+
+	/* promote to the protected segment */
+	item.is_protected = true;
+	protected_items.push_back(item);
+	protected_size += item.size();
+
+	/* if the protected segment is full, demote its least
+	   recently used items; they get another chance in the
+	   probationary segment */
+	while (protected_size > max_protected_size) {
+		auto &oldest = protected_items.front();
+		protected_items.pop_front();
+		oldest.is_protected = false;
+		assert(protected_size >= oldest.size());
+		protected_size -= oldest.size();
+		items_by_time.push_back(oldest);
+	}
 }
 
 void
@@ -112,7 +286,13 @@ InputCacheManager::Remove(InputCacheItem &item) noexcept
 	assert(total_size >= item.size());
 	total_size -= item.size();
 
-	items_by_time.erase(items_by_time.iterator_to(item));
+	if (item.is_protected) {
+		assert(protected_size >= item.size());
+		protected_size -= item.size();
+		protected_items.erase(protected_items.iterator_to(item));
+	} else
+		items_by_time.erase(items_by_time.iterator_to(item));
+
 	items_by_uri.erase(items_by_uri.iterator_to(item));
 }
 
@@ -126,10 +306,16 @@ InputCacheManager::Delete(InputCacheItem *item) noexcept
 InputCacheItem *
 InputCacheManager::FindOldestUnused() noexcept
 {
+	/* with InputCachePolicy::SLRU, probationary items are
+	   evicted before protected ones */
 	for (auto &i : items_by_time)
 		if (!i.IsInUse())
 			return &i;
 
+	for (auto &i : protected_items)
+		if (!i.IsInUse())
+			return &i;
+
 	return nullptr;
 }
 
@@ -140,6 +326,8 @@ InputCacheManager::EvictOldestUnused() noexcept
 	if (item == nullptr)
 		return false;
 
+	Spill(*item);
 	Delete(item);
+	n_evictions.fetch_add(1, std::memory_order_relaxed);
 	return true;
 }
@@ -8,40 +8,156 @@
 #include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
 class InputStream;
+class InputCacheDisk;
 class InputCacheItem;
 class InputCacheLease;
 struct InputCacheConfig;
+enum class InputCachePolicy : uint_least8_t;
+
+/**
+ * Statistics about an #InputCacheManager, see
+ * InputCacheManager::GetStats().
+ */
+struct InputCacheStats {
+	/**
+	 * The total size of all items in RAM (in bytes).
+	 */
+	size_t size, max_size;
+
+	std::size_t n_items;
+
+	/**
+	 * The number of Get() calls which found the file in RAM.
+	 */
+	uint_least64_t hits;
+
+	/**
+	 * The number of Get() calls which had to load the file;
+	 * this includes #disk_hits.
+	 */
+	uint_least64_t misses;
+
+	/**
+	 * The number of misses which were satisfied by the
+	 * #InputCacheDisk.
+	 */
+	uint_least64_t disk_hits;
+
+	/**
+	 * The number of items which were evicted from RAM to make
+	 * room for new ones.
+	 */
+	uint_least64_t evictions;
+
+	/**
+	 * The total size of the #InputCacheDisk (in bytes); 0 if
+	 * there is none.
+	 */
+	uint_least64_t disk_size;
+};
 
 /**
  * A class which caches files in RAM.  It is supposed to prefetch
- * files before they are played.
+ * files before they are played.  Optionally, evicted files are moved
+ * to a persistent on-disk tier (#InputCacheDisk).
  */
 class InputCacheManager {
 	const size_t max_total_size;
 
+	/**
+	 * The maximum total size of #protected_items (only used by
+	 * InputCachePolicy::SLRU).
+	 */
+	const size_t max_protected_size;
+
+	const InputCachePolicy policy;
+
+	const unsigned prefetch_count;
+
+	const std::chrono::steady_clock::duration prefetch_duration;
+
+	const size_t max_prefetch_rate;
+
+	/**
+	 * Incremented by BeginPrefetch(); items which are part of the
+	 * current prefetch window have this value in
+	 * InputCacheItem::prefetch_generation.
+	 */
+	unsigned prefetch_generation = 0;
+
 	mutable Mutex mutex;
 
 	size_t total_size = 0;
 
+	/**
+	 * The total size of #protected_items.
+	 */
+	size_t protected_size = 0;
+
+	/**
+	 * Counters for GetStats().  They are atomic because they are
+	 * read by another thread.
+	 */
+	std::atomic<uint_least64_t> n_hits{0}, n_misses{0}, n_disk_hits{0},
+		n_evictions{0};
+
 	struct ItemGetUri {
 		[[gnu::pure]]
 		std::string_view operator()(const InputCacheItem &item) const noexcept;
 	};
 
+	/**
+	 * All items (with InputCachePolicy::SLRU: only the
+	 * "probationary" ones), the least recently used one first.
+	 */
 	IntrusiveList<InputCacheItem> items_by_time;
 
+	/**
+	 * With InputCachePolicy::SLRU: items which have been used at
+	 * least twice, the least recently used one first.
+	 */
+	IntrusiveList<InputCacheItem> protected_items;
+
 	IntrusiveHashSet<InputCacheItem, 127,
 			 IntrusiveHashSetOperators<InputCacheItem, ItemGetUri,
 						   std::hash<std::string_view>,
 						   std::equal_to<std::string_view>>> items_by_uri;
 
+	/**
+	 * The on-disk tier; nullptr if it is not configured.
+	 */
+	std::unique_ptr<InputCacheDisk> disk;
+
 public:
 	explicit InputCacheManager(const InputCacheConfig &config) noexcept;
 	~InputCacheManager() noexcept;
 
+	/**
+	 * How many upcoming queue songs shall be prefetched?
+	 */
+	unsigned GetPrefetchCount() const noexcept {
+		return prefetch_count;
+	}
+
+	/**
+	 * The maximum duration of upcoming queue songs to be
+	 * prefetched; zero means no limit.
+	 */
+	std::chrono::steady_clock::duration GetPrefetchDuration() const noexcept {
+		return prefetch_duration;
+	}
+
 	void Flush() noexcept;
 
+	[[gnu::pure]]
+	InputCacheStats GetStats() const noexcept;
+
 	[[gnu::pure]]
 	bool Contains(const char *uri) noexcept;
 
@@ -56,10 +172,30 @@ public:
 	InputCacheLease Get(const char *uri, bool create);
 
 	/**
-	 * Shortcut for "Get(uri,true)", discarding the returned
-	 * lease.
+	 * Start a new prefetch window.  Call Prefetch() for each song
+	 * in the window, followed by EndPrefetch().
 	 */
-	void Prefetch(const char *uri);
+	void BeginPrefetch() noexcept {
+		++prefetch_generation;
+	}
+
+	/**
+	 * Add the file to the current prefetch window and start
+	 * loading it in the background (unless it is already in the
+	 * cache).  The transfer is throttled to "max_prefetch_rate"
+	 * until somebody actually uses the file.
+	 *
+	 * Throws if opening the #InputStream fails.
+	 *
+	 * @return true if a new transfer was started
+	 */
+	bool Prefetch(const char *uri);
+
+	/**
+	 * Cancel all incomplete prefetches which have not been
+	 * added to the window since BeginPrefetch().
+	 */
+	void EndPrefetch() noexcept;
 
 private:
 	/**
@@ -68,6 +204,21 @@ private:
 	 */
 	bool IsEligible(const InputStream &input) const noexcept;
 
+	/**
+	 * Copy the item to the #InputCacheDisk (if it has been read
+	 * completely).
+	 */
+	void Spill(InputCacheItem &item) noexcept;
+
+	/**
+	 * Mark the item as "recently used".
+	 *
+	 * @param hit true if the item is being used (which promotes
+	 * it with InputCachePolicy::SLRU), false if only its
+	 * presence was checked
+	 */
+	void Touch(InputCacheItem &item, bool hit) noexcept;
+
 	void Remove(InputCacheItem &item) noexcept;
 	void Delete(InputCacheItem *item) noexcept;
 
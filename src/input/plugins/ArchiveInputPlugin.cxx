@@ -7,14 +7,94 @@
 #include "archive/ArchiveFile.hxx"
 #include "../InputStream.hxx"
 #include "fs/LookupFile.hxx"
-#include "fs/Path.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <chrono>
+#include <list>
+#include <memory>
+
 static constexpr Domain input_domain("input");
 
+/**
+ * Keeps the most recently used archives open, so playing several
+ * songs from one archive doesn't open and scan it each time.
+ */
+class ArchiveFileCache {
+	static constexpr std::size_t MAX_SIZE = 4;
+
+	struct Item {
+		AllocatedPath path;
+		std::chrono::system_clock::time_point mtime;
+		uint_least64_t size;
+
+		std::shared_ptr<ArchiveFile> file;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The most recently used item is at the front.
+	 */
+	std::list<Item> items;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	std::shared_ptr<ArchiveFile> Open(const ArchivePlugin &plugin,
+					  const AllocatedPath &path);
+};
+
+std::shared_ptr<ArchiveFile>
+ArchiveFileCache::Open(const ArchivePlugin &plugin,
+		       const AllocatedPath &path)
+{
+	const FileInfo info{path};
+
+	{
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->path != path)
+				continue;
+
+			if (i->mtime == info.GetModificationTime() &&
+			    i->size == info.GetSize()) {
+				items.splice(items.begin(), items, i);
+				return i->file;
+			}
+
+			/* the file has been modified */
+			items.erase(i);
+			break;
+		}
+	}
+
+	std::shared_ptr<ArchiveFile> file = archive_file_open(&plugin, path);
+
+	const std::scoped_lock lock{mutex};
+
+	items.push_front({
+		path,
+		info.GetModificationTime(),
+		info.GetSize(),
+		file,
+	});
+
+	if (items.size() > MAX_SIZE)
+		items.pop_back();
+
+	return file;
+}
+
+static ArchiveFileCache archive_file_cache;
+
 InputStreamPtr
 OpenArchiveInputStream(Path path, Mutex &mutex)
 {
@@ -43,6 +123,6 @@ OpenArchiveInputStream(Path path, Mutex &mutex)
 		return nullptr;
 	}
 
-	return archive_file_open(arplug, l.archive)
+	return archive_file_cache.Open(*arplug, l.archive)
 		->OpenStream(l.inside.c_str(), mutex);
 }
@@ -8,8 +8,12 @@
 #include "CdioParanoiaInputPlugin.hxx"
 #include "lib/cdio/Paranoia.hxx"
 #include "lib/fmt/RuntimeError.hxx"
-#include "../InputStream.hxx"
+#include "../ThreadInputStream.hxx"
+#include "../AsyncBufferConfig.hxx"
 #include "../InputPlugin.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
 #include "util/TruncateString.hxx"
 #include "util/StringCompare.hxx"
 #include "util/Domain.hxx"
@@ -22,12 +26,19 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include <cdio/cd_types.h>
+#include <cdio/cdtext.h>
+
+#include <fmt/format.h>
 
 static constexpr Domain cdio_domain("cdio");
 
@@ -37,55 +48,201 @@ static unsigned speed = 0;
 /* Default to full paranoia, but allow skipping sectors. */
 static int mode_flags = PARANOIA_MODE_FULL^PARANOIA_MODE_NEVERSKIP;
 
-class CdioParanoiaInputStream final : public InputStream {
-	cdrom_drive_t *const drv;
+static AsyncInputBufferConfig cdio_buffer_config{512 * 1024};
+
+/**
+ * The number of sectors read by one ThreadRead() call.  The thread
+ * reads at most this much before the data becomes visible to the
+ * decoder (about 0.4 seconds).
+ */
+static constexpr unsigned MAX_READ_SECTORS = 32;
+
+/**
+ * How many discs are remembered in #disc_cache?
+ */
+static constexpr std::size_t MAX_CACHED_DISCS = 8;
+
+/**
+ * Information about an audio CD which is expensive to obtain: the
+ * byte order detection reads (and spins up) the disc, and reading
+ * CD-Text takes a while.  This is cached by disc id.
+ */
+struct CdioDiscInfo {
+	/**
+	 * The FreeDB/CDDB disc id calculated from the TOC.
+	 */
+	uint32_t id;
+
+	bool reverse_endian;
+
+	/**
+	 * The CD-Text of each track (index is the track number);
+	 * element 0 contains the album information for playing the
+	 * whole disc.  Empty if the disc has no CD-Text.
+	 */
+	std::vector<Tag> cdtext;
+};
+
+/**
+ * An open CD drive.  After a stream has been closed, it is kept in
+ * #idle_drive for the next stream, which saves opening the device,
+ * reading the TOC and spinning up the drive; for gapless playback,
+ * the next track usually begins right where the #para cursor is.
+ */
+struct CdioDrive {
+	/**
+	 * The device part of the URI (empty for the default drive).
+	 */
+	const std::string spec;
+
 	CdIo_t *const cdio;
+	cdrom_drive_t *const drv;
 	CdromParanoia para;
 
+	std::shared_ptr<const CdioDiscInfo> info;
+
+	/**
+	 * The sector which will be returned by the next
+	 * CdromParanoia::Read() call without seeking (or -1 if
+	 * unknown).
+	 */
+	lsn_t next_lsn = -1;
+
+	CdioDrive(std::string_view _spec,
+		  CdIo_t *_cdio, cdrom_drive_t *_drv) noexcept
+		:spec(_spec), cdio(_cdio), drv(_drv), para(drv)
+	{
+		para.SetMode(mode_flags);
+	}
+
+	~CdioDrive() noexcept {
+		para = {};
+		cdio_cddap_close_no_free_cdio(drv);
+		cdio_destroy(cdio);
+	}
+
+	CdioDrive(const CdioDrive &) = delete;
+	CdioDrive &operator=(const CdioDrive &) = delete;
+
+	/**
+	 * Read one sector, seeking only if necessary.
+	 *
+	 * Throws on error.
+	 */
+	std::span<const int16_t> ReadSector(lsn_t lsn);
+};
+
+/**
+ * Protects #idle_drive and #disc_cache.
+ */
+static Mutex cdio_pool_mutex;
+
+static std::unique_ptr<CdioDrive> idle_drive;
+
+/**
+ * Recently used discs; the most recent one is at the front.
+ */
+static std::list<std::shared_ptr<const CdioDiscInfo>> disc_cache;
+
+std::span<const int16_t>
+CdioDrive::ReadSector(lsn_t lsn)
+{
+	if (lsn != next_lsn) {
+		next_lsn = -1;
+		para.Seek(lsn);
+	}
+
+	try {
+		const auto result = para.Read();
+		next_lsn = lsn + 1;
+		return result;
+	} catch (...) {
+		next_lsn = -1;
+
+		char *s_err = cdio_cddap_errors(drv);
+		if (s_err) {
+			FmtError(cdio_domain,
+				 "paranoia_read: {}", s_err);
+			cdio_cddap_free_messages(s_err);
+		}
+
+		throw;
+	}
+}
+
+class CdioParanoiaInputStream final : public ThreadInputStream {
+	std::unique_ptr<CdioDrive> drive;
+
 	const lsn_t lsn_from;
 
-	char buffer[CDIO_CD_FRAMESIZE_RAW];
-	lsn_t buffer_lsn;
+	const bool reverse_endian;
+
+	/**
+	 * The CD-Text tag, to be returned by ReadTag().
+	 */
+	std::unique_ptr<Tag> tag;
+
+	/**
+	 * The stream offset of the next ThreadRead() call.  Only
+	 * used by the thread.
+	 */
+	offset_type position = 0;
+
+	/**
+	 * A copy of the sector #buffer_lsn, used for reads which do
+	 * not begin at a sector boundary (after seeking).
+	 */
+	std::byte buffer[CDIO_CD_FRAMESIZE_RAW];
+	lsn_t buffer_lsn = -1;
 
  public:
 	CdioParanoiaInputStream(const char *_uri, Mutex &_mutex,
-				cdrom_drive_t *_drv, CdIo_t *_cdio,
-				bool reverse_endian,
-				lsn_t _lsn_from, lsn_t lsn_to)
-		:InputStream(_uri, _mutex),
-		 drv(_drv), cdio(_cdio), para(drv),
+				std::unique_ptr<CdioDrive> &&_drive,
+				lsn_t _lsn_from, lsn_t lsn_to,
+				std::unique_ptr<Tag> &&_tag)
+		:ThreadInputStream(input_plugin_cdio_paranoia.name,
+				   _uri, _mutex, cdio_buffer_config),
+		 drive(std::move(_drive)),
 		 lsn_from(_lsn_from),
-		 buffer_lsn(-1)
+		 reverse_endian(drive->info->reverse_endian),
+		 tag(std::move(_tag))
 	{
-		para.SetMode(mode_flags);
-
-		/* seek to beginning of the track */
-		para.Seek(lsn_from);
-
 		seekable = true;
 		size = (lsn_to - lsn_from + 1) * CDIO_CD_FRAMESIZE_RAW;
 
-		/* hack to make MPD select the "pcm" decoder plugin */
-		SetMimeType(reverse_endian
-			    ? "audio/x-mpd-cdda-pcm-reverse"
-			    : "audio/x-mpd-cdda-pcm");
-		SetReady();
+		Start();
 	}
 
-	~CdioParanoiaInputStream() override {
-		para = {};
-		cdio_cddap_close_no_free_cdio(drv);
-		cdio_destroy(cdio);
+	~CdioParanoiaInputStream() noexcept override {
+		Stop();
+
+		/* keep the drive open for the next stream; the
+		   previous idle drive is closed outside of the
+		   mutex */
+		std::unique_ptr<CdioDrive> old;
+		const std::scoped_lock lock{cdio_pool_mutex};
+		old = std::exchange(idle_drive, std::move(drive));
 	}
 
 	CdioParanoiaInputStream(const CdioParanoiaInputStream &) = delete;
 	CdioParanoiaInputStream &operator=(const CdioParanoiaInputStream &) = delete;
 
 	/* virtual methods from InputStream */
-	[[nodiscard]] bool IsEOF() const noexcept override;
-	size_t Read(std::unique_lock<Mutex> &lock,
-		    std::span<std::byte> dest) override;
-	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
+	std::unique_ptr<Tag> ReadTag() noexcept override {
+		return std::exchange(tag, nullptr);
+	}
+
+protected:
+	/* virtual methods from ThreadInputStream */
+	void Open() override {
+		/* hack to make MPD select the "pcm" decoder plugin */
+		SetMimeType(reverse_endian
+			    ? "audio/x-mpd-cdda-pcm-reverse"
+			    : "audio/x-mpd-cdda-pcm");
+	}
+
+	std::size_t ThreadRead(std::span<std::byte> dest) override;
+	void ThreadSeek(offset_type new_offset) override;
 };
 
 static void
@@ -122,6 +279,15 @@ input_cdio_init(EventLoop &, const ConfigBlock &block)
 		else
 			mode_flags |= PARANOIA_MODE_NEVERSKIP;
 	}
+
+	cdio_buffer_config.Load(block);
+}
+
+static void
+input_cdio_finish() noexcept
+{
+	idle_drive.reset();
+	disc_cache.clear();
 }
 
 struct CdioUri {
@@ -186,18 +352,164 @@ cdio_detect_device()
 	return AllocatedPath::FromFS(devices[0]);
 }
 
-static InputStreamPtr
-input_cdio_open(const char *uri,
-		Mutex &mutex)
+/**
+ * Calculate the FreeDB/CDDB disc id.
+ */
+[[gnu::pure]]
+static uint32_t
+CalculateDiscId(cdrom_drive_t *drv) noexcept
 {
-	uri = StringAfterPrefixIgnoreCase(uri, "cdda://");
-	assert(uri != nullptr);
+	auto to_seconds = [](lsn_t lsn){
+		return unsigned(lsn + CDIO_PREGAP_SECTORS) / CDIO_CD_FRAMES_PER_SEC;
+	};
 
-	const auto parsed_uri = parse_cdio_uri(uri);
+	const unsigned n_tracks = cdio_cddap_tracks(drv);
+
+	unsigned n = 0;
+	for (unsigned i = 1; i <= n_tracks; ++i)
+		for (unsigned t = to_seconds(cdio_cddap_track_firstsector(drv, i));
+		     t > 0; t /= 10)
+			n += t % 10;
+
+	const unsigned length =
+		to_seconds(cdio_cddap_disc_lastsector(drv) + 1) -
+		to_seconds(cdio_cddap_disc_firstsector(drv));
+
+	return (n % 0xff) << 24 | length << 8 | n_tracks;
+}
+
+static bool
+DetectReverseEndian(cdrom_drive_t *drv)
+{
+	const int be = data_bigendianp(drv);
+	switch (be) {
+	case -1:
+		LogDebug(cdio_domain, "drive returns unknown audio data");
+		return default_reverse_endian;
+
+	case 0:
+		LogDebug(cdio_domain, "drive returns audio data Little Endian");
+		return IsBigEndian();
 
+	case 1:
+		LogDebug(cdio_domain, "drive returns audio data Big Endian");
+		return IsLittleEndian();
+
+	default:
+		throw FmtRuntimeError("Drive returns unknown data type {}",
+				      be);
+	}
+}
+
+static void
+AddCdText(TagBuilder &tag, TagType type, const cdtext_t *cdtext,
+	  cdtext_field_t field, track_t track) noexcept
+{
+	const char *value = cdtext_get_const(cdtext, field, track);
+	if (value != nullptr && *value != 0)
+		tag.AddItem(type, value);
+}
+
+static std::vector<Tag>
+ReadCdText(CdIo_t *cdio, unsigned n_tracks) noexcept
+{
+	std::vector<Tag> result;
+
+	const cdtext_t *cdtext = cdio_get_cdtext(cdio);
+	if (cdtext == nullptr)
+		return result;
+
+	result.reserve(n_tracks + 1);
+
+	for (unsigned i = 0; i <= n_tracks; ++i) {
+		TagBuilder tag;
+		AddCdText(tag, TAG_ALBUM, cdtext, CDTEXT_FIELD_TITLE, 0);
+		AddCdText(tag, TAG_ALBUM_ARTIST, cdtext, CDTEXT_FIELD_PERFORMER, 0);
+
+		if (i > 0) {
+			const track_t track = i;
+			AddCdText(tag, TAG_TITLE, cdtext, CDTEXT_FIELD_TITLE, track);
+			AddCdText(tag, TAG_ARTIST, cdtext, CDTEXT_FIELD_PERFORMER, track);
+			AddCdText(tag, TAG_COMPOSER, cdtext, CDTEXT_FIELD_COMPOSER, track);
+			tag.AddItem(TAG_TRACK, fmt::format_int{i}.c_str());
+		}
+
+		if (!tag.HasType(TAG_ARTIST))
+			AddCdText(tag, TAG_ARTIST, cdtext, CDTEXT_FIELD_PERFORMER, 0);
+
+		result.emplace_back(tag.Commit());
+	}
+
+	return result;
+}
+
+/**
+ * Look up the #CdioDiscInfo of the disc in the given drive in
+ * #disc_cache, or obtain it from the disc.
+ */
+static std::shared_ptr<const CdioDiscInfo>
+GetDiscInfo(CdIo_t *cdio, cdrom_drive_t *drv)
+{
+	const uint32_t id = CalculateDiscId(drv);
+
+	{
+		const std::scoped_lock lock{cdio_pool_mutex};
+		for (auto i = disc_cache.begin(); i != disc_cache.end(); ++i) {
+			if ((*i)->id == id) {
+				disc_cache.splice(disc_cache.begin(),
+						  disc_cache, i);
+				return disc_cache.front();
+			}
+		}
+	}
+
+	auto info = std::make_shared<CdioDiscInfo>();
+	info->id = id;
+	info->reverse_endian = DetectReverseEndian(drv);
+	info->cdtext = ReadCdText(cdio, cdio_cddap_tracks(drv));
+
+	FmtDebug(cdio_domain, "New disc {:08x}", id);
+
+	const std::scoped_lock lock{cdio_pool_mutex};
+	disc_cache.emplace_front(info);
+	if (disc_cache.size() > MAX_CACHED_DISCS)
+		disc_cache.pop_back();
+
+	return info;
+}
+
+/**
+ * Reuse the idle drive if it matches the given device
+ * specification and if the disc has not been changed.
+ */
+static std::unique_ptr<CdioDrive>
+TakeIdleDrive(std::string_view spec) noexcept
+{
+	std::unique_ptr<CdioDrive> drive;
+
+	{
+		const std::scoped_lock lock{cdio_pool_mutex};
+		drive = std::move(idle_drive);
+	}
+
+	if (drive == nullptr || drive->spec != spec)
+		/* close it (outside of the mutex) */
+		return nullptr;
+
+	if (cdio_get_media_changed(drive->cdio) != 0) {
+		LogDebug(cdio_domain, "Disc has been changed");
+		return nullptr;
+	}
+
+	return drive;
+}
+
+static std::unique_ptr<CdioDrive>
+OpenDrive(std::string_view spec)
+{
 	/* get list of CD's supporting CD-DA */
-	const AllocatedPath device = parsed_uri.device[0] != 0
-		? AllocatedPath::FromFS(parsed_uri.device)
+	const AllocatedPath device = !spec.empty()
+		? AllocatedPath::FromFS(spec)
 		: cdio_detect_device();
 	if (device.IsNull())
 		throw std::runtime_error("Unable find or access a CD-ROM drive with an audio CD in it.");
@@ -230,30 +542,25 @@ input_cdio_open(const char *uri,
 				 speed);
 	}
 
-	bool reverse_endian;
-	const int be = data_bigendianp(drv);
-	switch (be) {
-	case -1:
-		LogDebug(cdio_domain, "drive returns unknown audio data");
-		reverse_endian = default_reverse_endian;
-		break;
+	auto drive = std::make_unique<CdioDrive>(spec, cdio, drv);
+	drive->info = GetDiscInfo(cdio, drv);
+	return drive;
+}
 
-	case 0:
-		LogDebug(cdio_domain, "drive returns audio data Little Endian");
-		reverse_endian = IsBigEndian();
-		break;
+static InputStreamPtr
+input_cdio_open(const char *uri,
+		Mutex &mutex)
+{
+	uri = StringAfterPrefixIgnoreCase(uri, "cdda://");
+	assert(uri != nullptr);
 
-	case 1:
-		LogDebug(cdio_domain, "drive returns audio data Big Endian");
-		reverse_endian = IsLittleEndian();
-		break;
+	const auto parsed_uri = parse_cdio_uri(uri);
 
-	default:
-		cdio_cddap_close_no_free_cdio(drv);
-		cdio_destroy(cdio);
-		throw FmtRuntimeError("Drive returns unknown data type {}",
-				      be);
-	}
+	auto drive = TakeIdleDrive(parsed_uri.device);
+	if (drive == nullptr)
+		drive = OpenDrive(parsed_uri.device);
+
+	cdrom_drive_t *const drv = drive->drv;
 
 	lsn_t lsn_from, lsn_to;
 	if (parsed_uri.track >= 0) {
@@ -274,91 +581,74 @@ input_cdio_open(const char *uri,
 		throw FmtRuntimeError("No audio track: {}",
 				      parsed_uri.track);
 
+	std::unique_ptr<Tag> tag;
+	const auto &cdtext = drive->info->cdtext;
+	const std::size_t cdtext_index = parsed_uri.track > 0
+		? std::size_t(parsed_uri.track)
+		: 0;
+	if (cdtext_index < cdtext.size() && !cdtext[cdtext_index].IsEmpty())
+		tag = std::make_unique<Tag>(cdtext[cdtext_index]);
+
 	return std::make_unique<CdioParanoiaInputStream>(uri, mutex,
-							 drv, cdio,
-							 reverse_endian,
-							 lsn_from, lsn_to);
+							 std::move(drive),
+							 lsn_from, lsn_to,
+							 std::move(tag));
 }
 
 void
-CdioParanoiaInputStream::Seek(std::unique_lock<Mutex> &,
-			      offset_type new_offset)
+CdioParanoiaInputStream::ThreadSeek(offset_type new_offset)
 {
 	if (new_offset > size)
 		throw FmtRuntimeError("Invalid offset to seek {} ({})",
 				      new_offset, size);
 
-	/* simple case */
-	if (new_offset == offset)
-		return;
-
-	/* calculate current LSN */
-	const lsn_t lsn_relofs = new_offset / CDIO_CD_FRAMESIZE_RAW;
-
-	if (lsn_relofs != buffer_lsn) {
-		const ScopeUnlock unlock(mutex);
-		para.Seek(lsn_from + lsn_relofs);
-	}
-
-	offset = new_offset;
+	/* the drive seeks lazily in CdioDrive::ReadSector() */
+	position = new_offset;
 }
 
-size_t
-CdioParanoiaInputStream::Read(std::unique_lock<Mutex> &,
-			      std::span<std::byte> dest)
+std::size_t
+CdioParanoiaInputStream::ThreadRead(std::span<std::byte> dest)
 {
 	/* end of track ? */
-	if (IsEOF())
+	if (position >= size)
 		return 0;
 
-	//current sector was changed ?
-	const int16_t *rbuf;
+	const lsn_t lsn_relofs = position / CDIO_CD_FRAMESIZE_RAW;
+	const std::size_t diff = position % CDIO_CD_FRAMESIZE_RAW;
+
+	if (diff == 0 && dest.size() >= CDIO_CD_FRAMESIZE_RAW) {
+		/* read whole sectors directly into the buffer */
+		const lsn_t remaining_sectors = (size - position) / CDIO_CD_FRAMESIZE_RAW;
+		const lsn_t n_sectors = std::min({
+				lsn_t(dest.size() / CDIO_CD_FRAMESIZE_RAW),
+				remaining_sectors,
+				lsn_t(MAX_READ_SECTORS),
+			});
+
+		for (lsn_t i = 0; i < n_sectors; ++i) {
+			const auto src = std::as_bytes(drive->ReadSector(lsn_from + lsn_relofs + i));
+			std::copy(src.begin(), src.end(),
+				  dest.begin() + i * CDIO_CD_FRAMESIZE_RAW);
+		}
 
-	const lsn_t lsn_relofs = offset / CDIO_CD_FRAMESIZE_RAW;
-	const std::size_t diff = offset % CDIO_CD_FRAMESIZE_RAW;
+		const std::size_t nbytes = n_sectors * CDIO_CD_FRAMESIZE_RAW;
+		position += nbytes;
+		return nbytes;
+	}
 
 	if (lsn_relofs != buffer_lsn) {
-		const ScopeUnlock unlock(mutex);
-
-		try {
-			rbuf = para.Read().data();
-		} catch (...) {
-			char *s_err = cdio_cddap_errors(drv);
-			if (s_err) {
-				FmtError(cdio_domain,
-					 "paranoia_read: {}", s_err);
-				cdio_cddap_free_messages(s_err);
-			}
-
-			throw;
-		}
-
-		//store current buffer
-		memcpy(buffer, rbuf, CDIO_CD_FRAMESIZE_RAW);
+		const auto src = std::as_bytes(drive->ReadSector(lsn_from + lsn_relofs));
+		std::copy(src.begin(), src.end(), buffer);
 		buffer_lsn = lsn_relofs;
-	} else {
-		//use cached sector
-		rbuf = (const int16_t *)buffer;
 	}
 
-	const size_t maxwrite = CDIO_CD_FRAMESIZE_RAW - diff;  //# of bytes pending in current buffer
-	const std::size_t nbytes = std::min(dest.size(), maxwrite);
-
-	//skip diff bytes from this lsn
-	memcpy(dest.data(), ((const char *)rbuf) + diff, nbytes);
-
-	//update offset
-	offset += nbytes;
-
+	const std::size_t nbytes = std::min(dest.size(),
+					    CDIO_CD_FRAMESIZE_RAW - diff);
+	std::copy_n(buffer + diff, nbytes, dest.begin());
+	position += nbytes;
 	return nbytes;
 }
 
-bool
-CdioParanoiaInputStream::IsEOF() const noexcept
-{
-	return offset >= size;
-}
-
 static constexpr const char *cdio_paranoia_prefixes[] = {
 	"cdda://",
 	nullptr
@@ -368,7 +658,7 @@ const InputPlugin input_plugin_cdio_paranoia = {
 	"cdio_paranoia",
 	cdio_paranoia_prefixes,
 	input_cdio_init,
-	nullptr,
+	input_cdio_finish,
 	input_cdio_open,
 	nullptr
 };
@@ -10,6 +10,7 @@
 #include "lib/curl/Slist.hxx"
 #include "../MaybeBufferedInputStream.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../AsyncBufferConfig.hxx"
 #include "../IcyInputStream.hxx"
 #include "tag/IcyMetaDataParser.hxx"
 #include "../InputPlugin.hxx"
@@ -43,16 +44,12 @@
 #include <curl/curl.h>
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * Do not buffer more than this number of bytes (unless configured
+ * differently).  It should be a reasonable limit that doesn't make
+ * low-end machines suffer too much, but doesn't cause stuttering on
+ * high-latency lines.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
-
-/**
- * Resume the stream at this number of bytes after it has been paused.
- */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static AsyncInputBufferConfig curl_buffer_config{512 * 1024};
 
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
@@ -64,6 +61,18 @@ class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/** parser for icy-metadata */
 	std::shared_ptr<IcyMetaDataParser> icy;
 
+	/**
+	 * The custom request headers; needed to open more segments
+	 * of the same resource.
+	 */
+	const Curl::Headers custom_headers;
+
+	/**
+	 * Is this a stream opened by OpenSegment()?  Then the server
+	 * must respond with "206 Partial Content".
+	 */
+	bool is_segment = false;
+
 public:
 	template<typename I>
 	CurlInputStream(EventLoop &event_loop, std::string_view _url,
@@ -124,6 +133,11 @@ private:
 	/* virtual methods from AsyncInputStream */
 	void DoResume() override;
 	void DoSeek(offset_type new_offset) override;
+
+public:
+	/* virtual methods from InputStream */
+	unsigned GetMaxSegments() const noexcept override;
+	InputStreamPtr OpenSegment(offset_type new_offset) override;
 };
 
 /** libcurl should accept "ICY 200 OK" */
@@ -140,6 +154,12 @@ static bool verify_peer, verify_host;
 /** Connection settings */
 static std::chrono::duration<long> connect_timeout;
 
+/**
+ * The number of parallel "Range" requests used to download a
+ * seekable resource into a buffer; 1 disables this.
+ */
+static unsigned segments;
+
 /**
  * CURLOPT_VERBOSE - verbose mode
  * DEFAULT 0, meaning disabled.
@@ -266,6 +286,10 @@ CurlInputStream::OnHeaders(unsigned status,
 				      FmtBuffer<40>("got HTTP status {}",
 						    status).c_str());
 
+	if (is_segment && status != 206)
+		throw HttpStatusError(status,
+				      "Server does not support Range requests");
+
 	const std::scoped_lock protect{mutex};
 
 	if (IsSeekPending()) {
@@ -423,6 +447,12 @@ input_curl_init(EventLoop &event_loop, const ConfigBlock &block)
 	tcp_keepidle  = block.GetBlockValue("tcp_keepidle",default_tcp_keepidle);
 
 	tcp_keepintvl = block.GetBlockValue("tcp_keepintvl",default_tcp_keepintvl);
+
+	curl_buffer_config.Load(block);
+
+	segments = block.GetPositiveValue("segments", 1U);
+
+	(*curl_init)->SetMaxHostConnections(block.GetBlockValue("max_host_connections", 0U));
 }
 
 static void
@@ -437,17 +467,18 @@ input_curl_finish() noexcept
 template<typename I>
 inline
 CurlInputStream::CurlInputStream(EventLoop &event_loop, std::string_view _url,
-				 const Curl::Headers &headers,
+				 const Curl::Headers &_headers,
 				 I &&_icy,
 				 Mutex &_mutex)
 	:AsyncInputStream(event_loop, _url, _mutex,
-			  CURL_MAX_BUFFERED,
-			  CURL_RESUME_AT),
-	 icy(std::forward<I>(_icy))
+			  curl_buffer_config),
+	 icy(std::forward<I>(_icy)),
+	 custom_headers(_headers)
 {
-	request_headers.Append("Icy-Metadata: 1");
+	if (icy)
+		request_headers.Append("Icy-Metadata: 1");
 
-	for (const auto &[key, header] : headers)
+	for (const auto &[key, header] : custom_headers)
 		request_headers.Append((key + ":" += header).c_str());
 }
 
@@ -568,6 +599,37 @@ CurlInputStream::DoSeek(offset_type new_offset)
 		});
 }
 
+unsigned
+CurlInputStream::GetMaxSegments() const noexcept
+{
+	if (!IsSeekable() || !KnownSize() || (icy && icy->IsDefined()))
+		return 1;
+
+	return segments;
+}
+
+InputStreamPtr
+CurlInputStream::OpenSegment(offset_type new_offset)
+{
+	assert(new_offset > 0);
+
+	auto c = std::make_unique<CurlInputStream>(GetEventLoop(),
+						   GetURI(), custom_headers,
+						   std::shared_ptr<IcyMetaDataParser>{},
+						   mutex);
+	c->is_segment = true;
+	c->offset = new_offset;
+
+	BlockingCall(c->GetEventLoop(), [&c, new_offset](){
+		c->InitEasy();
+		c->request->GetEasy().SetOption(CURLOPT_RANGE,
+						FmtBuffer<32>("{}-", new_offset).c_str());
+		c->StartRequest();
+	});
+
+	return c;
+}
+
 inline InputStreamPtr
 CurlInputStream::Open(std::string_view url,
 		      const Curl::Headers &headers,
@@ -8,18 +8,19 @@
 #include "lib/ffmpeg/IOContext.hxx"
 #include "lib/ffmpeg/Init.hxx"
 #include "../ThreadInputStream.hxx"
+#include "../AsyncBufferConfig.hxx"
 #include "PluginUnavailable.hxx"
 #include "../InputPlugin.hxx"
 #include "util/StringAPI.hxx"
 
-class FfmpegInputStream final : public ThreadInputStream {
-	static constexpr std::size_t BUFFER_SIZE = 256 * 1024;
+static AsyncInputBufferConfig ffmpeg_buffer_config{256 * 1024};
 
+class FfmpegInputStream final : public ThreadInputStream {
 	Ffmpeg::IOContext io;
 
 public:
 	FfmpegInputStream(const char *_uri, Mutex &_mutex)
-		:ThreadInputStream("ffmpeg", _uri, _mutex, BUFFER_SIZE)
+		:ThreadInputStream("ffmpeg", _uri, _mutex, ffmpeg_buffer_config)
 	{
 		Start();
 	}
@@ -47,13 +48,15 @@ input_ffmpeg_supported() noexcept
 }
 
 static void
-input_ffmpeg_init(EventLoop &, const ConfigBlock &)
+input_ffmpeg_init(EventLoop &, const ConfigBlock &block)
 {
 	FfmpegInit();
 
 	/* disable this plugin if there's no registered protocol */
 	if (!input_ffmpeg_supported())
 		throw PluginUnavailable("No protocol");
+
+	ffmpeg_buffer_config.Load(block);
 }
 
 static std::set<std::string, std::less<>>
@@ -4,21 +4,22 @@
 #include "MmsInputPlugin.hxx"
 #include "input/ThreadInputStream.hxx"
 #include "input/InputPlugin.hxx"
+#include "input/AsyncBufferConfig.hxx"
 #include "system/Error.hxx"
 
 #include <libmms/mmsx.h>
 
 #include <stdexcept>
 
-class MmsInputStream final : public ThreadInputStream {
-	static constexpr std::size_t BUFFER_SIZE = 256 * 1024;
+static AsyncInputBufferConfig mms_buffer_config{256 * 1024};
 
+class MmsInputStream final : public ThreadInputStream {
 	mmsx_t *mms;
 
 public:
 	MmsInputStream(const char *_uri, Mutex &_mutex)
 		:ThreadInputStream(input_plugin_mms.name, _uri, _mutex,
-				   BUFFER_SIZE)
+				   mms_buffer_config)
 	{
 		Start();
 	}
@@ -55,6 +56,12 @@ MmsInputStream::Open()
 	SetMimeType("audio/x-ms-wma");
 }
 
+static void
+input_mms_init(EventLoop &, const ConfigBlock &block)
+{
+	mms_buffer_config.Load(block);
+}
+
 static InputStreamPtr
 input_mms_open(const char *url,
 	       Mutex &mutex)
@@ -93,7 +100,7 @@ static constexpr const char *mms_prefixes[] = {
 const InputPlugin input_plugin_mms = {
 	"mms",
 	mms_prefixes,
-	nullptr,
+	input_mms_init,
 	nullptr,
 	input_mms_open,
 	nullptr
@@ -3,33 +3,54 @@
 
 #include "NfsInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../AsyncBufferConfig.hxx"
 #include "../InputPlugin.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * Do not buffer more than this number of bytes (unless configured
+ * differently).  It should be a reasonable limit that doesn't make
+ * low-end machines suffer too much, but doesn't cause stuttering on
+ * high-latency lines.
  */
-static const size_t NFS_MAX_BUFFERED = 512 * 1024;
+static AsyncInputBufferConfig nfs_buffer_config{512 * 1024};
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The maximum size of one READ request; 0 means use the "rsize"
+ * negotiated with the server, but no more than #DEFAULT_READ_SIZE.
  */
-static const size_t NFS_RESUME_AT = 384 * 1024;
+static size_t nfs_read_size;
+
+static constexpr size_t DEFAULT_READ_SIZE = 128 * 1024;
+
+/**
+ * The maximum number of READ requests in flight per stream.
+ */
+static unsigned nfs_max_reads = 4;
 
 class NfsInputStream final : NfsFileReader, public AsyncInputStream {
+	/**
+	 * The file offset of the next Read() call.
+	 */
 	uint64_t next_offset;
 
+	/**
+	 * The file offset of the data which will be received next.
+	 * The difference to #next_offset is the number of bytes in
+	 * flight.
+	 */
+	uint64_t read_offset;
+
 	bool reconnect_on_resume = false, reconnecting = false;
 
 public:
 	NfsInputStream(std::string_view _uri, Mutex &_mutex) noexcept
 		:AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  _uri, _mutex,
-				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  nfs_buffer_config) {}
 
 	NfsInputStream(NfsConnection &_connection, std::string_view _path,
 		       Mutex &_mutex) noexcept
@@ -37,8 +58,7 @@ public:
 		 AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  NfsFileReader::GetAbsoluteUri(),
 				  _mutex,
-				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  nfs_buffer_config) {}
 
 	~NfsInputStream() override {
 		DeferClose();
@@ -56,6 +76,9 @@ public:
 private:
 	void DoRead();
 
+	[[gnu::pure]]
+	size_t GetReadSize() const noexcept;
+
 protected:
 	/* virtual methods from AsyncInputStream */
 	void DoResume() override;
@@ -68,30 +91,55 @@ private:
 	void OnNfsFileError(std::exception_ptr &&e) noexcept override;
 };
 
-void
-NfsInputStream::DoRead()
+inline size_t
+NfsInputStream::GetReadSize() const noexcept
 {
-	assert(NfsFileReader::IsIdle());
+	if (nfs_read_size > 0)
+		return nfs_read_size;
 
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return;
-
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return;
-	}
-
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
+	const size_t read_max = NfsFileReader::GetReadMax();
+	return read_max > 0
+		? std::min(read_max, DEFAULT_READ_SIZE)
+		: DEFAULT_READ_SIZE;
+}
 
-	try {
-		const ScopeUnlock unlock(mutex);
-		NfsFileReader::Read(next_offset, nbytes);
-	} catch (...) {
-		postponed_exception = std::current_exception();
-		InvokeOnAvailable();
+void
+NfsInputStream::DoRead()
+{
+	if (GetPendingReads() == 0)
+		/* resynchronize after a short read or after the
+		   reads were cancelled */
+		next_offset = read_offset;
+
+	const size_t read_size = GetReadSize();
+
+	while (GetPendingReads() < nfs_max_reads) {
+		int64_t remaining = size - next_offset;
+		if (remaining <= 0)
+			return;
+
+		/* reserve buffer space for all reads in flight */
+		const size_t buffer_space = GetBufferSpace();
+		const size_t in_flight = next_offset - read_offset;
+		if (buffer_space <= in_flight) {
+			if (in_flight == 0)
+				Pause();
+			return;
+		}
+
+		size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, read_size),
+						 buffer_space - in_flight);
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			NfsFileReader::Read(next_offset, nbytes);
+		} catch (...) {
+			postponed_exception = std::current_exception();
+			InvokeOnAvailable();
+			return;
+		}
+
+		next_offset += nbytes;
 	}
 }
 
@@ -126,7 +174,7 @@ NfsInputStream::DoSeek(offset_type new_offset)
 		NfsFileReader::CancelRead();
 	}
 
-	next_offset = offset = new_offset;
+	next_offset = read_offset = offset = new_offset;
 	SeekDone();
 
 	if (!IsIdle())
@@ -150,7 +198,7 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size) noexcept
 
 	size = _size;
 	seekable = true;
-	next_offset = 0;
+	next_offset = read_offset = 0;
 	SetReady();
 	DoRead();
 }
@@ -164,7 +212,7 @@ NfsInputStream::OnNfsFileRead(std::span<const std::byte> src) noexcept
 
 	AppendToBuffer(src);
 
-	next_offset += src.size();
+	read_offset += src.size();
 
 	DoRead();
 }
@@ -201,8 +249,17 @@ NfsInputStream::OnNfsFileError(std::exception_ptr &&e) noexcept
  */
 
 static void
-input_nfs_init(EventLoop &event_loop, const ConfigBlock &)
+input_nfs_init(EventLoop &event_loop, const ConfigBlock &block)
 {
+	nfs_buffer_config.Load(block);
+
+	if (const auto *param = block.GetBlockParam("read_size"))
+		nfs_read_size = param->With([](const char *s){
+			return ParseSize(s);
+		});
+
+	nfs_max_reads = block.GetPositiveValue("max_reads", nfs_max_reads);
+
 	nfs_init(event_loop);
 }
 
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "QobuzAlbumRequest.hxx"
+#include "QobuzErrorParser.hxx"
+#include "QobuzClient.hxx"
+#include "lib/yajl/Callbacks.hxx"
+#include "tag/Builder.hxx"
+
+#include <fmt/format.h>
+
+#include <list>
+
+using std::string_view_literals::operator""sv;
+
+using Wrapper = Yajl::CallbacksWrapper<QobuzAlbumRequest::ResponseParser>;
+static constexpr yajl_callbacks parse_callbacks = {
+	nullptr,
+	nullptr,
+	Wrapper::Integer,
+	nullptr,
+	nullptr,
+	Wrapper::String,
+	Wrapper::StartMap,
+	Wrapper::MapKey,
+	Wrapper::EndMap,
+	nullptr,
+	nullptr,
+};
+
+class QobuzAlbumRequest::ResponseParser final : public YajlResponseParser {
+	enum class State {
+		NONE,
+		TITLE,
+		ARTIST,
+		ARTIST_NAME,
+		TRACKS,
+		ITEMS,
+		TRACK,
+		TRACK_ID,
+		TRACK_TITLE,
+		TRACK_DURATION,
+		TRACK_PERFORMER,
+		TRACK_PERFORMER_NAME,
+		TRACK_COMPOSER,
+		TRACK_COMPOSER_NAME,
+	} state = State::NONE;
+
+	unsigned map_depth = 0;
+
+	std::string album_title, album_artist;
+
+	struct Track {
+		std::string id;
+		TagBuilder tag;
+	};
+
+	/**
+	 * The album title and artist may appear after the tracks,
+	 * so the tags are committed by GetTracks().
+	 */
+	std::list<Track> tracks;
+
+public:
+	explicit ResponseParser() noexcept
+		:YajlResponseParser(&parse_callbacks, nullptr, this) {}
+
+	std::vector<std::pair<std::string, Tag>> GetTracks() noexcept;
+
+	/* yajl callbacks */
+	bool Integer(long long value) noexcept;
+	bool String(std::string_view value) noexcept;
+	bool StartMap() noexcept;
+	bool MapKey(std::string_view value) noexcept;
+	bool EndMap() noexcept;
+};
+
+static std::string
+MakeAlbumUrl(QobuzClient &client, const char *album_id)
+{
+	return client.MakeUrl("album", "get",
+			      {
+				      {"album_id", album_id},
+			      });
+}
+
+QobuzAlbumRequest::QobuzAlbumRequest(QobuzClient &client,
+				     const char *album_id,
+				     QobuzAlbumHandler &_handler)
+	:request(client.GetCurl(),
+		 MakeAlbumUrl(client, album_id).c_str(),
+		 *this),
+	 handler(_handler)
+{
+}
+
+QobuzAlbumRequest::~QobuzAlbumRequest() noexcept
+{
+	request.StopIndirect();
+}
+
+std::unique_ptr<CurlResponseParser>
+QobuzAlbumRequest::MakeParser(unsigned status, Curl::Headers &&headers)
+{
+	if (status != 200)
+		return std::make_unique<QobuzErrorParser>(status, headers);
+
+	auto i = headers.find("content-type");
+	if (i == headers.end() || i->second.find("/json") == i->second.npos)
+		throw std::runtime_error("Not a JSON response from Qobuz");
+
+	return std::make_unique<ResponseParser>();
+}
+
+void
+QobuzAlbumRequest::FinishParser(std::unique_ptr<CurlResponseParser> p)
+{
+	assert(dynamic_cast<ResponseParser *>(p.get()) != nullptr);
+	auto &rp = (ResponseParser &)*p;
+	handler.OnQobuzAlbumSuccess(*this, rp.GetTracks());
+}
+
+void
+QobuzAlbumRequest::OnError(std::exception_ptr e) noexcept
+{
+	handler.OnQobuzAlbumError(*this, e);
+}
+
+std::vector<std::pair<std::string, Tag>>
+QobuzAlbumRequest::ResponseParser::GetTracks() noexcept
+{
+	std::vector<std::pair<std::string, Tag>> result;
+	result.reserve(tracks.size());
+
+	for (auto &i : tracks) {
+		if (i.id.empty())
+			continue;
+
+		if (!album_title.empty())
+			i.tag.AddItem(TAG_ALBUM, album_title);
+		if (!album_artist.empty())
+			i.tag.AddItem(TAG_ALBUM_ARTIST, album_artist);
+
+		result.emplace_back(std::move(i.id), i.tag.Commit());
+	}
+
+	return result;
+}
+
+inline bool
+QobuzAlbumRequest::ResponseParser::Integer(long long value) noexcept
+{
+	switch (state) {
+	case State::TRACK_ID:
+		tracks.back().id = fmt::format_int{value}.c_str();
+		break;
+
+	case State::TRACK_DURATION:
+		if (value > 0)
+			tracks.back().tag.SetDuration(SignedSongTime::FromS((unsigned)value));
+		break;
+
+	default:
+		break;
+	}
+
+	return true;
+}
+
+inline bool
+QobuzAlbumRequest::ResponseParser::String(std::string_view value) noexcept
+{
+	switch (state) {
+	case State::TITLE:
+		if (map_depth == 1)
+			album_title = value;
+		break;
+
+	case State::ARTIST_NAME:
+		if (map_depth == 2)
+			album_artist = value;
+		break;
+
+	case State::TRACK_ID:
+		tracks.back().id = value;
+		break;
+
+	case State::TRACK_TITLE:
+		tracks.back().tag.AddItem(TAG_TITLE, value);
+		break;
+
+	case State::TRACK_PERFORMER_NAME:
+		tracks.back().tag.AddItem(TAG_PERFORMER, value);
+		break;
+
+	case State::TRACK_COMPOSER_NAME:
+		tracks.back().tag.AddItem(TAG_COMPOSER, value);
+		break;
+
+	default:
+		break;
+	}
+
+	return true;
+}
+
+inline bool
+QobuzAlbumRequest::ResponseParser::StartMap() noexcept
+{
+	++map_depth;
+
+	if (map_depth == 3 && state == State::ITEMS) {
+		/* an element of the "items" array */
+		tracks.emplace_back();
+		state = State::TRACK;
+	}
+
+	return true;
+}
+
+inline bool
+QobuzAlbumRequest::ResponseParser::MapKey(std::string_view value) noexcept
+{
+	switch (map_depth) {
+	case 1:
+		if (value == "title"sv)
+			state = State::TITLE;
+		else if (value == "artist"sv)
+			state = State::ARTIST;
+		else if (value == "tracks"sv)
+			state = State::TRACKS;
+		else
+			state = State::NONE;
+		break;
+
+	case 2:
+		switch (state) {
+		case State::ARTIST:
+		case State::ARTIST_NAME:
+			state = value == "name"sv
+				? State::ARTIST_NAME
+				: State::ARTIST;
+			break;
+
+		case State::TRACKS:
+		case State::ITEMS:
+			state = value == "items"sv
+				? State::ITEMS
+				: State::TRACKS;
+			break;
+
+		default:
+			break;
+		}
+		break;
+
+	case 3:
+		switch (state) {
+		case State::NONE:
+		case State::TITLE:
+		case State::ARTIST:
+		case State::ARTIST_NAME:
+		case State::TRACKS:
+		case State::ITEMS:
+			break;
+
+		default:
+			if (value == "id"sv)
+				state = State::TRACK_ID;
+			else if (value == "title"sv)
+				state = State::TRACK_TITLE;
+			else if (value == "duration"sv)
+				state = State::TRACK_DURATION;
+			else if (value == "performer"sv)
+				state = State::TRACK_PERFORMER;
+			else if (value == "composer"sv)
+				state = State::TRACK_COMPOSER;
+			else
+				state = State::TRACK;
+			break;
+		}
+		break;
+
+	case 4:
+		switch (state) {
+		case State::TRACK_PERFORMER:
+		case State::TRACK_PERFORMER_NAME:
+			state = value == "name"sv
+				? State::TRACK_PERFORMER_NAME
+				: State::TRACK_PERFORMER;
+			break;
+
+		case State::TRACK_COMPOSER:
+		case State::TRACK_COMPOSER_NAME:
+			state = value == "name"sv
+				? State::TRACK_COMPOSER_NAME
+				: State::TRACK_COMPOSER;
+			break;
+
+		default:
+			break;
+		}
+		break;
+	}
+
+	return true;
+}
+
+inline bool
+QobuzAlbumRequest::ResponseParser::EndMap() noexcept
+{
+	switch (map_depth) {
+	case 2:
+		state = State::NONE;
+		break;
+
+	case 3:
+		switch (state) {
+		case State::NONE:
+		case State::TITLE:
+		case State::ARTIST:
+		case State::ARTIST_NAME:
+		case State::TRACKS:
+		case State::ITEMS:
+			break;
+
+		default:
+			/* end of a track */
+			state = State::ITEMS;
+			break;
+		}
+		break;
+
+	case 4:
+		switch (state) {
+		case State::NONE:
+		case State::TITLE:
+		case State::ARTIST:
+		case State::ARTIST_NAME:
+		case State::TRACKS:
+		case State::ITEMS:
+			break;
+
+		default:
+			/* end of a map inside a track */
+			state = State::TRACK;
+			break;
+		}
+		break;
+	}
+
+	--map_depth;
+
+	return true;
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef QOBUZ_ALBUM_REQUEST_HXX
+#define QOBUZ_ALBUM_REQUEST_HXX
+
+#include "lib/curl/Delegate.hxx"
+#include "lib/curl/Request.hxx"
+#include "tag/Tag.hxx"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class QobuzClient;
+class QobuzAlbumRequest;
+
+class QobuzAlbumHandler {
+public:
+	/**
+	 * @param tracks the tags of all tracks of the album by
+	 * track id
+	 */
+	virtual void OnQobuzAlbumSuccess(QobuzAlbumRequest &request,
+					 std::vector<std::pair<std::string, Tag>> &&tracks) noexcept = 0;
+	virtual void OnQobuzAlbumError(QobuzAlbumRequest &request,
+				       std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * Load the tags of all tracks of an album with one "album/get"
+ * request.
+ */
+class QobuzAlbumRequest final : DelegateCurlResponseHandler {
+	CurlRequest request;
+
+	QobuzAlbumHandler &handler;
+
+public:
+	class ResponseParser;
+
+	QobuzAlbumRequest(QobuzClient &client, const char *album_id,
+			  QobuzAlbumHandler &_handler);
+
+	~QobuzAlbumRequest() noexcept;
+
+	void Start() noexcept {
+		request.StartIndirect();
+	}
+
+private:
+	/* virtual methods from DelegateCurlResponseHandler */
+	std::unique_ptr<CurlResponseParser> MakeParser(unsigned status,
+						       Curl::Headers &&headers) override;
+	void FinishParser(std::unique_ptr<CurlResponseParser> p) override;
+
+	/* virtual methods from CurlResponseHandler */
+	void OnError(std::exception_ptr e) noexcept override;
+};
+
+#endif
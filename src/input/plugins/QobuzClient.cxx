@@ -3,10 +3,42 @@
 
 #include "QobuzClient.hxx"
 #include "lib/crypto/MD5.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <stdexcept>
 
+using std::string_view_literals::operator""sv;
+
+static constexpr Domain qobuz_domain("qobuz");
+
+/**
+ * How long are file URLs kept if their expiry cannot be determined?
+ */
+static constexpr std::chrono::steady_clock::duration DEFAULT_URL_TTL =
+	std::chrono::minutes{5};
+
+/**
+ * File URLs are discarded this long before they expire, leaving some
+ * time for the actual HTTP request.
+ */
+static constexpr std::chrono::steady_clock::duration URL_EXPIRY_MARGIN =
+	std::chrono::minutes{1};
+
+static constexpr std::size_t MAX_CACHED_URLS = 256;
+static constexpr std::size_t MAX_CACHED_TAGS = 4096;
+
+/**
+ * The maximum number of "album/get" requests in flight; this keeps
+ * us well below the API rate limit even when a large playlist is
+ * being queued.
+ */
+static constexpr std::size_t MAX_ALBUM_REQUESTS = 2;
+
 namespace {
 
 class QueryStringBuilder {
@@ -199,3 +231,151 @@ QobuzClient::MakeSignedUrl(const char *object, const char *method,
 
 	return uri;
 }
+
+/**
+ * Determine when the given signed file URL expires.  Qobuz file
+ * URLs contain the expiry as a UNIX timestamp in the "etsp" query
+ * parameter.
+ */
+[[gnu::pure]]
+static std::chrono::steady_clock::time_point
+GetUrlExpiry(std::string_view url) noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	const auto i = url.find("etsp="sv);
+	if (i == url.npos)
+		return now + DEFAULT_URL_TTL;
+
+	const std::string value{url.substr(i + 5, 20)};
+	char *endptr;
+	const auto etsp = std::strtoll(value.c_str(), &endptr, 10);
+	if (endptr == value.c_str())
+		return now + DEFAULT_URL_TTL;
+
+	const auto remaining = std::chrono::system_clock::from_time_t(etsp)
+		- std::chrono::system_clock::now();
+	return now
+		+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(remaining)
+		- URL_EXPIRY_MARGIN;
+}
+
+std::string
+QobuzClient::LookupTrackUrl(std::string_view track_id) noexcept
+{
+	const std::scoped_lock protect{cache_mutex};
+
+	auto i = url_cache.find(track_id);
+	if (i == url_cache.end())
+		return {};
+
+	if (i->second.expires <= std::chrono::steady_clock::now()) {
+		url_cache.erase(i);
+		return {};
+	}
+
+	return i->second.url;
+}
+
+void
+QobuzClient::StoreTrackUrl(std::string_view track_id,
+			   std::string_view url) noexcept
+{
+	const auto expires = GetUrlExpiry(url);
+	if (expires <= std::chrono::steady_clock::now())
+		return;
+
+	const std::scoped_lock protect{cache_mutex};
+
+	if (url_cache.size() >= MAX_CACHED_URLS) {
+		/* purge expired URLs, and if that didn't help, the
+		   one which expires first */
+		const auto now = std::chrono::steady_clock::now();
+		std::erase_if(url_cache, [now](const auto &i){
+			return i.second.expires <= now;
+		});
+
+		if (url_cache.size() >= MAX_CACHED_URLS)
+			url_cache.erase(std::min_element(url_cache.begin(),
+							 url_cache.end(),
+							 [](const auto &a, const auto &b){
+								 return a.second.expires < b.second.expires;
+							 }));
+	}
+
+	url_cache.insert_or_assign(std::string{track_id},
+				   CachedUrl{std::string{url}, expires});
+}
+
+std::unique_ptr<Tag>
+QobuzClient::LookupTag(std::string_view track_id) noexcept
+{
+	const std::scoped_lock protect{cache_mutex};
+
+	auto i = tag_cache.find(track_id);
+	if (i == tag_cache.end())
+		return nullptr;
+
+	return std::make_unique<Tag>(i->second);
+}
+
+void
+QobuzClient::PrefetchAlbum(std::string_view album_id) noexcept
+{
+	if (album_id.empty())
+		return;
+
+	const std::scoped_lock protect{cache_mutex};
+
+	if (album_requests.size() >= MAX_ALBUM_REQUESTS ||
+	    known_albums.contains(album_id))
+		return;
+
+	try {
+		const std::string id{album_id};
+
+		QobuzAlbumHandler &handler = *this;
+		auto request = std::make_unique<QobuzAlbumRequest>(*this,
+								   id.c_str(),
+								   handler);
+		request->Start();
+		album_requests.emplace_back(std::move(request));
+		known_albums.emplace(id);
+	} catch (...) {
+		FmtError(qobuz_domain, "Failed to load Qobuz album {:?}: {}",
+			 album_id, std::current_exception());
+	}
+}
+
+void
+QobuzClient::OnQobuzAlbumSuccess(QobuzAlbumRequest &request,
+				 std::vector<std::pair<std::string, Tag>> &&tracks) noexcept
+{
+	const std::scoped_lock protect{cache_mutex};
+
+	if (tag_cache.size() + tracks.size() > MAX_CACHED_TAGS) {
+		/* the cache is only a shortcut for queueing whole
+		   albums; there's no point in keeping old entries */
+		tag_cache.clear();
+		known_albums.clear();
+	}
+
+	for (auto &[id, tag] : tracks)
+		tag_cache.insert_or_assign(std::move(id), std::move(tag));
+
+	album_requests.remove_if([&request](const auto &i){
+		return i.get() == &request;
+	});
+}
+
+void
+QobuzClient::OnQobuzAlbumError(QobuzAlbumRequest &request,
+			       std::exception_ptr _error) noexcept
+{
+	FmtError(qobuz_domain, "Failed to load Qobuz album: {}", _error);
+
+	const std::scoped_lock protect{cache_mutex};
+	album_requests.remove_if([&request](const auto &i){
+		return i.get() == &request;
+	});
+}
@@ -6,13 +6,19 @@
 
 #include "QobuzSession.hxx"
 #include "QobuzLoginRequest.hxx"
+#include "QobuzAlbumRequest.hxx"
 #include "lib/curl/Init.hxx"
 #include "lib/curl/Headers.hxx"
 #include "thread/Mutex.hxx"
 #include "event/DeferEvent.hxx"
 #include "util/IntrusiveList.hxx"
+#include "tag/Tag.hxx"
 
+#include <chrono>
+#include <list>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 
 class QobuzSessionHandler
@@ -22,7 +28,7 @@ public:
 	virtual void OnQobuzSession() noexcept = 0;
 };
 
-class QobuzClient final : QobuzLoginHandler {
+class QobuzClient final : QobuzLoginHandler, QobuzAlbumHandler {
 	const char *const base_url;
 	const char *const app_id, *const app_secret;
 	const char *const device_manufacturer_id;
@@ -48,6 +54,38 @@ class QobuzClient final : QobuzLoginHandler {
 
 	std::unique_ptr<QobuzLoginRequest> login_request;
 
+	/**
+	 * Protects #url_cache, #tag_cache, #known_albums,
+	 * #album_requests.
+	 */
+	mutable Mutex cache_mutex;
+
+	struct CachedUrl {
+		std::string url;
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	/**
+	 * Signed file URLs obtained by "track/getFileUrl" by track
+	 * id; they remain valid until they expire, and replaying a
+	 * track does not need a new request.
+	 */
+	std::map<std::string, CachedUrl, std::less<>> url_cache;
+
+	/**
+	 * Tags of tracks which were loaded by "album/get", by track
+	 * id.
+	 */
+	std::map<std::string, Tag, std::less<>> tag_cache;
+
+	/**
+	 * The ids of all albums which have been passed to
+	 * PrefetchAlbum(), to avoid loading an album twice.
+	 */
+	std::set<std::string, std::less<>> known_albums;
+
+	std::list<std::unique_ptr<QobuzAlbumRequest>> album_requests;
+
 public:
 	QobuzClient(EventLoop &event_loop,
 		    const char *_base_url,
@@ -57,6 +95,10 @@ public:
 		    const char *_password,
 		    const char *_format_id);
 
+	EventLoop &GetEventLoop() const noexcept {
+		return defer_invoke_handlers.GetEventLoop();
+	}
+
 	const char *GetFormatId() const noexcept {
 		return format_id;
 	}
@@ -83,6 +125,34 @@ public:
 	std::string MakeSignedUrl(const char *object, const char *method,
 				  const Curl::Headers &query) const noexcept;
 
+	/**
+	 * Look up a file URL which was previously passed to
+	 * StoreTrackUrl() and has not yet expired.
+	 *
+	 * @return the URL or an empty string if there is none
+	 */
+	std::string LookupTrackUrl(std::string_view track_id) noexcept;
+
+	void StoreTrackUrl(std::string_view track_id,
+			   std::string_view url) noexcept;
+
+	/**
+	 * Look up the tag of a track which was loaded by
+	 * PrefetchAlbum().
+	 *
+	 * @return the tag or nullptr if it is not in the cache
+	 */
+	std::unique_ptr<Tag> LookupTag(std::string_view track_id) noexcept;
+
+	/**
+	 * Load the tags of all tracks of the given album in the
+	 * background, so subsequent LookupTag() calls for the other
+	 * tracks of this album succeed without another request.
+	 * This is a no-op if the album has been seen already or if
+	 * too many requests are in flight.
+	 */
+	void PrefetchAlbum(std::string_view album_id) noexcept;
+
 private:
 	void StartLogin();
 
@@ -95,6 +165,12 @@ private:
 	/* virtual methods from QobuzLoginHandler */
 	void OnQobuzLoginSuccess(QobuzSession &&session) noexcept override;
 	void OnQobuzLoginError(std::exception_ptr error) noexcept override;
+
+	/* virtual methods from QobuzAlbumHandler */
+	void OnQobuzAlbumSuccess(QobuzAlbumRequest &request,
+				 std::vector<std::pair<std::string, Tag>> &&tracks) noexcept override;
+	void OnQobuzAlbumError(QobuzAlbumRequest &request,
+			       std::exception_ptr error) noexcept override;
 };
 
 #endif
@@ -10,8 +10,11 @@
 #include "input/ProxyInputStream.hxx"
 #include "input/FailingInputStream.hxx"
 #include "input/InputPlugin.hxx"
+#include "input/RemoteTagScanner.hxx"
 #include "config/Block.hxx"
+#include "event/InjectEvent.hxx"
 #include "lib/crypto/MD5.hxx"
+#include "tag/Tag.hxx"
 #include "thread/Mutex.hxx"
 #include "util/StringCompare.hxx"
 
@@ -71,6 +74,15 @@ QobuzInputStream::OnQobuzSession() noexcept
 	const std::scoped_lock protect{mutex};
 
 	try {
+		if (auto url = qobuz_client->LookupTrackUrl(track_id);
+		    !url.empty()) {
+			/* this track was played recently and its
+			   file URL is still valid */
+			SetInput(OpenCurlInputStream(url.c_str(), {},
+						     mutex));
+			return;
+		}
+
 		const auto session = qobuz_client->GetSession();
 
 		QobuzTrackHandler &h = *this;
@@ -87,6 +99,8 @@ QobuzInputStream::OnQobuzSession() noexcept
 void
 QobuzInputStream::OnQobuzTrackSuccess(std::string url) noexcept
 {
+	qobuz_client->StoreTrackUrl(track_id, url);
+
 	const std::scoped_lock protect{mutex};
 	track_request.reset();
 
@@ -179,6 +193,36 @@ OpenQobuzInput(const char *uri, Mutex &mutex)
 	return std::make_unique<QobuzInputStream>(uri, track_id, mutex);
 }
 
+/**
+ * A #RemoteTagScanner which delivers a tag from the
+ * #QobuzClient's cache.  The handler must not be invoked from
+ * within Start(), therefore this is deferred to the event loop.
+ */
+class QobuzCachedTagScanner final : public RemoteTagScanner {
+	InjectEvent defer_invoke_handler;
+
+	std::unique_ptr<Tag> tag;
+
+	RemoteTagHandler &handler;
+
+public:
+	QobuzCachedTagScanner(EventLoop &event_loop,
+			      std::unique_ptr<Tag> &&_tag,
+			      RemoteTagHandler &_handler) noexcept
+		:defer_invoke_handler(event_loop,
+				      BIND_THIS_METHOD(InvokeHandler)),
+		 tag(std::move(_tag)), handler(_handler) {}
+
+	void Start() noexcept override {
+		defer_invoke_handler.Schedule();
+	}
+
+private:
+	void InvokeHandler() noexcept {
+		handler.OnRemoteTag(std::move(*tag));
+	}
+};
+
 static std::unique_ptr<RemoteTagScanner>
 ScanQobuzTags(const char *uri, RemoteTagHandler &handler)
 {
@@ -188,6 +232,11 @@ ScanQobuzTags(const char *uri, RemoteTagHandler &handler)
 	if (track_id == nullptr)
 		return nullptr;
 
+	if (auto tag = qobuz_client->LookupTag(track_id))
+		return std::make_unique<QobuzCachedTagScanner>(qobuz_client->GetEventLoop(),
+							       std::move(tag),
+							       handler);
+
 	return std::make_unique<QobuzTagScanner>(*qobuz_client, track_id,
 						 handler);
 }
@@ -8,6 +8,8 @@
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
 
+#include <fmt/format.h>
+
 using std::string_view_literals::operator""sv;
 
 using Wrapper = Yajl::CallbacksWrapper<QobuzTagScanner::ResponseParser>;
@@ -33,6 +35,7 @@ class QobuzTagScanner::ResponseParser final : public YajlResponseParser {
 		DURATION,
 		TITLE,
 		ALBUM,
+		ALBUM_ID,
 		ALBUM_TITLE,
 		ALBUM_ARTIST,
 		ALBUM_ARTIST_NAME,
@@ -44,6 +47,8 @@ class QobuzTagScanner::ResponseParser final : public YajlResponseParser {
 
 	TagBuilder tag;
 
+	std::string album_id;
+
 public:
 	explicit ResponseParser() noexcept
 		:YajlResponseParser(&parse_callbacks, nullptr, this) {}
@@ -52,6 +57,10 @@ public:
 		return tag.Commit();
 	}
 
+	const std::string &GetAlbumId() const noexcept {
+		return album_id;
+	}
+
 	/* yajl callbacks */
 	bool Integer(long long value) noexcept;
 	bool String(std::string_view value) noexcept;
@@ -69,10 +78,11 @@ MakeTrackUrl(QobuzClient &client, const char *track_id)
 			      });
 }
 
-QobuzTagScanner::QobuzTagScanner(QobuzClient &client,
+QobuzTagScanner::QobuzTagScanner(QobuzClient &_client,
 				 const char *track_id,
 				 RemoteTagHandler &_handler)
-	:request(client.GetCurl(),
+	:client(_client),
+	 request(client.GetCurl(),
 		 MakeTrackUrl(client, track_id).c_str(),
 		 *this),
 	 handler(_handler)
@@ -102,6 +112,11 @@ QobuzTagScanner::FinishParser(std::unique_ptr<CurlResponseParser> p)
 {
 	assert(dynamic_cast<ResponseParser *>(p.get()) != nullptr);
 	auto &rp = (ResponseParser &)*p;
+
+	/* the other tracks of this album are likely to be queued
+	   next; load all of them with one request */
+	client.PrefetchAlbum(rp.GetAlbumId());
+
 	handler.OnRemoteTag(rp.GetTag());
 }
 
@@ -115,6 +130,11 @@ inline bool
 QobuzTagScanner::ResponseParser::Integer(long long value) noexcept
 {
 	switch (state) {
+	case State::ALBUM_ID:
+		if (map_depth == 2)
+			album_id = fmt::format_int{value}.c_str();
+		break;
+
 	case State::DURATION:
 		if (value > 0)
 			tag.SetDuration(SignedSongTime::FromS((unsigned)value));
@@ -141,6 +161,11 @@ QobuzTagScanner::ResponseParser::String(std::string_view value) noexcept
 			tag.AddItem(TAG_COMPOSER, value);
 		break;
 
+	case State::ALBUM_ID:
+		if (map_depth == 2)
+			album_id = value;
+		break;
+
 	case State::ALBUM_TITLE:
 		if (map_depth == 2)
 			tag.AddItem(TAG_ALBUM, value);
@@ -205,10 +230,13 @@ QobuzTagScanner::ResponseParser::MapKey(std::string_view value) noexcept
 			break;
 
 		case State::ALBUM:
+		case State::ALBUM_ID:
 		case State::ALBUM_TITLE:
 		case State::ALBUM_ARTIST:
 		case State::ALBUM_ARTIST_NAME:
-			if (value == "title"sv)
+			if (value == "id"sv)
+				state = State::ALBUM_ID;
+			else if (value == "title"sv)
 				state = State::ALBUM_TITLE;
 			else if (value == "artist"sv)
 				state = State::ALBUM_ARTIST;
@@ -258,6 +286,7 @@ QobuzTagScanner::ResponseParser::EndMap() noexcept
 
 	case 3:
 		switch (state) {
+		case State::ALBUM_ID:
 		case State::ALBUM_TITLE:
 		case State::ALBUM_ARTIST:
 		case State::ALBUM_ARTIST_NAME:
@@ -13,6 +13,8 @@ class QobuzClient;
 class QobuzTagScanner final
 	: public RemoteTagScanner, DelegateCurlResponseHandler
 {
+	QobuzClient &client;
+
 	CurlRequest request;
 
 	RemoteTagHandler &handler;
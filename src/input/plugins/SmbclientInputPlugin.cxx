@@ -3,46 +3,157 @@
 
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Context.hxx"
-#include "../InputStream.hxx"
+#include "lib/smbclient/Pool.hxx"
+#include "../ThreadInputStream.hxx"
+#include "../AsyncBufferConfig.hxx"
 #include "../InputPlugin.hxx"
 #include "../MaybeBufferedInputStream.hxx"
 #include "PluginUnavailable.hxx"
+#include "config/Block.hxx"
 #include "system/Error.hxx"
 
 #include <libsmbclient.h>
 
-class SmbclientInputStream final : public InputStream {
-	SmbclientContext ctx;
-	SMBCFILE *const handle;
+#include <optional>
+#include <utility>
+
+/**
+ * The read-ahead buffer of each stream.  The stream's thread keeps
+ * it filled, so the SMB round trips overlap with decoding.
+ */
+static AsyncInputBufferConfig smbclient_buffer_config{512 * 1024};
+
+/**
+ * How many streams may read one file in parallel (see
+ * InputStream::OpenSegment()).
+ */
+static unsigned smbclient_segments = 1;
+
+/**
+ * Keeps idle libsmbclient contexts (and their server connections)
+ * for the next stream.
+ */
+static std::optional<SmbclientContextPool> smbclient_pool;
+
+class SmbclientInputStream final : public ThreadInputStream {
+	SmbclientContextPool::Lease ctx;
+	SMBCFILE *handle = nullptr;
+
+	/**
+	 * The offset where this stream begins reading (non-zero for
+	 * segments).
+	 */
+	const offset_type start_offset;
 
 public:
-	SmbclientInputStream(const char *_uri,
-			     Mutex &_mutex,
-			     SmbclientContext &&_ctx,
-			     SMBCFILE *_handle, const struct stat &st)
-		:InputStream(_uri, _mutex),
-		 ctx(std::move(_ctx)), handle(_handle)
+	SmbclientInputStream(const char *_uri, Mutex &_mutex,
+			     offset_type _start_offset=0) noexcept
+		:ThreadInputStream(input_plugin_smbclient.name, _uri, _mutex,
+				   smbclient_buffer_config),
+		 start_offset(_start_offset) {}
+
+	~SmbclientInputStream() noexcept override {
+		Stop();
+	}
+
+	SmbclientInputStream(const SmbclientInputStream &) = delete;
+	SmbclientInputStream &operator=(const SmbclientInputStream &) = delete;
+
+	/* virtual methods from InputStream */
+	unsigned GetMaxSegments() const noexcept override;
+	InputStreamPtr OpenSegment(offset_type new_offset) override;
+
+protected:
+	/* virtual methods from ThreadInputStream */
+	void Open() override;
+	std::size_t ThreadRead(std::span<std::byte> dest) override;
+	void ThreadSeek(offset_type new_offset) override;
+	void Close() noexcept override;
+};
+
+void
+SmbclientInputStream::Open()
+{
+	struct stat st;
+
 	{
-		seekable = true;
-		size = st.st_size;
-		SetReady();
+		const ScopeUnlock unlock(mutex);
+
+		ctx = smbclient_pool->Get();
+
+		handle = ctx->OpenReadOnly(GetURI());
+		if (handle == nullptr)
+			throw MakeErrno("smbc_open() failed");
+
+		if (ctx->Stat(handle, st) < 0) {
+			const int e = errno;
+			ctx->Close(std::exchange(handle, nullptr));
+			throw MakeErrno(e, "smbc_fstat() failed");
+		}
+
+		if (start_offset > 0 &&
+		    ctx->Seek(handle, start_offset) < 0) {
+			const int e = errno;
+			ctx->Close(std::exchange(handle, nullptr));
+			throw MakeErrno(e, "smbc_lseek() failed");
+		}
 	}
 
-	~SmbclientInputStream() override {
-		ctx.Close(handle);
+	seekable = true;
+	size = st.st_size;
+	offset = start_offset;
+}
+
+std::size_t
+SmbclientInputStream::ThreadRead(std::span<std::byte> dest)
+{
+	ssize_t nbytes = ctx->Read(handle, dest.data(), dest.size());
+	if (nbytes < 0) {
+		const int e = errno;
+		ctx.Discard();
+		throw MakeErrno(e, "smbc_read() failed");
 	}
 
-	/* virtual methods from InputStream */
+	return nbytes;
+}
 
-	[[nodiscard]] bool IsEOF() const noexcept override {
-		return offset >= size;
+void
+SmbclientInputStream::ThreadSeek(offset_type new_offset)
+{
+	if (ctx->Seek(handle, new_offset) < 0) {
+		const int e = errno;
+		ctx.Discard();
+		throw MakeErrno(e, "smbc_lseek() failed");
 	}
+}
 
-	size_t Read(std::unique_lock<Mutex> &lock,
-		    std::span<std::byte> dest) override;
-	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
-};
+void
+SmbclientInputStream::Close() noexcept
+{
+	if (handle != nullptr)
+		ctx->Close(handle);
+
+	/* return the context to the pool */
+	ctx = {};
+}
+
+unsigned
+SmbclientInputStream::GetMaxSegments() const noexcept
+{
+	if (!IsSeekable() || !KnownSize())
+		return 1;
+
+	return smbclient_segments;
+}
+
+InputStreamPtr
+SmbclientInputStream::OpenSegment(offset_type new_offset)
+{
+	auto s = std::make_unique<SmbclientInputStream>(GetURI(), mutex,
+							 new_offset);
+	s->Start();
+	return s;
+}
 
 /*
  * InputPlugin methods
@@ -50,7 +161,7 @@ public:
  */
 
 static void
-input_smbclient_init(EventLoop &, const ConfigBlock &)
+input_smbclient_init(EventLoop &, const ConfigBlock &block)
 {
 	try {
 		SmbclientInit();
@@ -58,67 +169,29 @@ input_smbclient_init(EventLoop &, const ConfigBlock &)
 		std::throw_with_nested(PluginUnavailable("libsmbclient initialization failed"));
 	}
 
-	// TODO: create one global SMBCCTX here?
+	smbclient_buffer_config.Load(block);
 
-	// TODO: evaluate ConfigBlock, call smbc_setOption*()
-}
+	smbclient_segments = block.GetPositiveValue("segments", 1U);
 
-static InputStreamPtr
-input_smbclient_open(const char *uri,
-		     Mutex &mutex)
-{
-	auto ctx = SmbclientContext::New();
-
-	SMBCFILE *handle = ctx.OpenReadOnly(uri);
-	if (handle == nullptr)
-		throw MakeErrno("smbc_open() failed");
-
-	struct stat st;
-	if (ctx.Stat(handle, st) < 0) {
-		const int e = errno;
-		ctx.Close(handle);
-		throw MakeErrno(e, "smbc_fstat() failed");
-	}
+	smbclient_pool.emplace(block.GetPositiveValue("idle_contexts", 4U));
 
-	return std::make_unique<MaybeBufferedInputStream>
-		(std::make_unique<SmbclientInputStream>(uri, mutex,
-							std::move(ctx),
-							handle, st));
+	// TODO: evaluate ConfigBlock, call smbc_setOption*()
 }
 
-size_t
-SmbclientInputStream::Read(std::unique_lock<Mutex> &,
-			   std::span<std::byte> dest)
+static void
+input_smbclient_finish() noexcept
 {
-	ssize_t nbytes;
-
-	{
-		const ScopeUnlock unlock(mutex);
-		nbytes = ctx.Read(handle, dest.data(), dest.size());
-	}
-
-	if (nbytes < 0)
-		throw MakeErrno("smbc_read() failed");
-
-	offset += nbytes;
-	return nbytes;
+	smbclient_pool.reset();
 }
 
-void
-SmbclientInputStream::Seek(std::unique_lock<Mutex> &,
-			   offset_type new_offset)
+static InputStreamPtr
+input_smbclient_open(const char *uri,
+		     Mutex &mutex)
 {
-	off_t result;
-
-	{
-		const ScopeUnlock unlock(mutex);
-		result = ctx.Seek(handle, new_offset);
-	}
-
-	if (result < 0)
-		throw MakeErrno("smbc_lseek() failed");
+	auto is = std::make_unique<SmbclientInputStream>(uri, mutex);
+	is->Start();
 
-	offset = result;
+	return std::make_unique<MaybeBufferedInputStream>(std::move(is));
 }
 
 static constexpr const char *smbclient_prefixes[] = {
@@ -130,7 +203,7 @@ const InputPlugin input_plugin_smbclient = {
 	"smbclient",
 	smbclient_prefixes,
 	input_smbclient_init,
-	nullptr,
+	input_smbclient_finish,
 	input_smbclient_open,
 	nullptr
 };
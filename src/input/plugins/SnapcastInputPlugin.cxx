@@ -0,0 +1,682 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * A Snapcast client which allows one MPD instance to play the stream
+ * of another MPD's "snapcast" output (or of a snapserver) in sync
+ * with all other clients.
+ */
+
+#include "SnapcastInputPlugin.hxx"
+#include "../ThreadInputStream.hxx"
+#include "output/plugins/snapcast/Protocol.hxx"
+#include "output/plugins/snapcast/Timestamp.hxx"
+#include "tag/RiffFormat.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/CheckAudioFormat.hxx"
+#include "pcm/Pack.hxx"
+#include "config/Block.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/Resolver.hxx"
+#include "net/SocketError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/CNumberParser.hxx"
+#include "util/Domain.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/StringCompare.hxx"
+#include "Log.hxx"
+#include "Version.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <sys/socket.h> // for SOCK_STREAM
+
+using std::string_view_literals::operator""sv;
+
+static constexpr Domain snapcast_input_domain("snapcast_input");
+
+static constexpr unsigned DEFAULT_PORT = 1704;
+
+/**
+ * Send a TIME request to the server at this interval.
+ */
+static constexpr std::chrono::seconds TIME_REQUEST_INTERVAL{1};
+
+/**
+ * If a chunk arrives earlier than this, wait until it is due;
+ * this happens mostly while the stream starts.
+ */
+static constexpr std::chrono::milliseconds RESYNC_THRESHOLD{50};
+
+/**
+ * Chunks which are late by more than this are skipped.  This is
+ * the same as the maximum age of chunks sent by the "snapcast"
+ * output plugin.
+ */
+static constexpr std::chrono::milliseconds MAX_LATE{500};
+
+/**
+ * If the stream deviates from the server's clock by more than this,
+ * drop or duplicate one frame per chunk.
+ */
+static constexpr std::chrono::milliseconds TRIM_THRESHOLD{2};
+
+static struct {
+	/**
+	 * The time it takes from reading a chunk until it comes out
+	 * of the speakers.
+	 */
+	std::chrono::milliseconds latency;
+} snapcast_input_config;
+
+/**
+ * Estimates the offset between the server's clock and ours from the
+ * TIME request round trips (like NTP).  The median of the most recent
+ * samples filters out round trips with asymmetric network delays.
+ */
+class SnapcastClockOffset {
+	using Duration = std::chrono::microseconds;
+
+	std::array<Duration, 32> samples;
+	std::size_t n_samples = 0, next = 0;
+
+	Duration median{};
+
+public:
+	bool IsDefined() const noexcept {
+		return n_samples > 0;
+	}
+
+	/**
+	 * @param c2s the difference between the server's receive time
+	 * and our send time
+	 * @param s2c the difference between our receive time and the
+	 * server's send time
+	 */
+	void Add(Duration c2s, Duration s2c) noexcept {
+		samples[next] = (c2s - s2c) / 2;
+		next = (next + 1) % samples.size();
+		if (n_samples < samples.size())
+			++n_samples;
+
+		auto sorted = samples;
+		const auto end = std::next(sorted.begin(), n_samples);
+		const auto middle = std::next(sorted.begin(), n_samples / 2);
+		std::nth_element(sorted.begin(), middle, end);
+		median = *middle;
+	}
+
+	/**
+	 * Returns the server's clock minus ours.
+	 */
+	Duration Get() const noexcept {
+		return median;
+	}
+};
+
+class SnapcastInputStream final : public ThreadInputStream {
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * Keep the buffer small, because the time when the decoder
+	 * reads from it is what the synchronization is based on.
+	 */
+	static constexpr std::size_t BUFFER_SIZE = 16 * 1024;
+
+	UniqueSocketDescriptor socket;
+
+	SnapcastClockOffset clock_offset;
+
+	Clock::time_point next_time_request;
+
+	/**
+	 * The "bufferMs" setting announced by the server: the time
+	 * between the timestamp of a chunk and when it shall be
+	 * played.
+	 */
+	std::chrono::milliseconds buffer_time{1000};
+
+	/**
+	 * The (wire) sample size in bits as announced by the codec
+	 * header.
+	 */
+	unsigned wire_bits = 0;
+
+	std::size_t wire_frame_size, frame_size;
+
+	std::uint16_t next_id = 0;
+
+	/**
+	 * The converted PCM data of the current chunk.
+	 */
+	std::vector<std::byte> pcm;
+	std::size_t pcm_position = 0;
+
+	std::vector<std::byte> receive_buffer;
+
+	Mutex sleep_mutex;
+	Cond sleep_cond;
+	std::atomic_bool cancel{false};
+
+public:
+	SnapcastInputStream(const char *_uri, Mutex &_mutex)
+		:ThreadInputStream(input_plugin_snapcast.name, _uri, _mutex,
+				   BUFFER_SIZE)
+	{
+		Start();
+	}
+
+	~SnapcastInputStream() noexcept override {
+		Stop();
+	}
+
+	SnapcastInputStream(const SnapcastInputStream &) = delete;
+	SnapcastInputStream &operator=(const SnapcastInputStream &) = delete;
+
+protected:
+	void Open() override;
+	std::size_t ThreadRead(std::span<std::byte> dest) override;
+
+	void Close() noexcept override {
+		socket.Close();
+	}
+
+	void Cancel() noexcept override {
+		{
+			const std::scoped_lock lock{sleep_mutex};
+			cancel = true;
+			sleep_cond.notify_one();
+		}
+
+		socket.Shutdown();
+	}
+
+private:
+	void Connect(const char *host_port);
+
+	void ReceiveFull(std::span<std::byte> dest);
+
+	/**
+	 * Receive the next message into #receive_buffer.
+	 *
+	 * @return false on end-of-stream
+	 */
+	bool ReceiveMessage(SnapcastBase &base);
+
+	void SendMessage(SnapcastMessageType type,
+			 std::span<const std::byte> payload);
+
+	void SendHello();
+	void SendTimeRequest();
+
+	/**
+	 * Handle all messages except for WIRE_CHUNK.
+	 */
+	void HandleMessage(const SnapcastBase &base,
+			   std::span<const std::byte> payload);
+
+	void HandleTime(const SnapcastBase &base,
+			std::span<const std::byte> payload) noexcept;
+	void HandleServerSettings(std::span<const std::byte> payload) noexcept;
+	void HandleCodecHeader(std::span<const std::byte> payload);
+
+	/**
+	 * Schedule a wire chunk and convert its PCM data to #pcm.
+	 *
+	 * @return false if the chunk was skipped
+	 */
+	bool HandleWireChunk(std::span<const std::byte> payload);
+
+	void ImportPcm(std::span<const std::byte> src);
+
+	/**
+	 * @return false if the stream was canceled
+	 */
+	bool SleepUntil(Clock::time_point t) noexcept;
+
+	/**
+	 * Receive messages until the next chunk can be delivered.
+	 *
+	 * @return false on end-of-stream
+	 */
+	bool ReceiveChunk();
+};
+
+inline void
+SnapcastInputStream::Connect(const char *host_port)
+{
+	const auto address_list = Resolve(host_port, DEFAULT_PORT,
+					  0, SOCK_STREAM);
+
+	for (const auto &i : address_list) {
+		UniqueSocketDescriptor s;
+		if (!s.Create(i.GetFamily(), i.GetType(), i.GetProtocol()))
+			throw MakeSocketError("Failed to create socket");
+
+		if (s.Connect(i)) {
+			socket = std::move(s);
+			return;
+		}
+	}
+
+	throw MakeSocketError(fmt::format("Failed to connect to {:?}",
+					  host_port).c_str());
+}
+
+void
+SnapcastInputStream::ReceiveFull(std::span<std::byte> dest)
+{
+	while (!dest.empty()) {
+		const auto nbytes = socket.Receive(dest);
+		if (nbytes < 0)
+			throw MakeSocketError("Failed to receive from Snapcast server");
+
+		if (nbytes == 0)
+			throw std::runtime_error("Snapcast server closed the connection");
+
+		dest = dest.subspan(nbytes);
+	}
+}
+
+bool
+SnapcastInputStream::ReceiveMessage(SnapcastBase &base)
+{
+	const auto nbytes = socket.Receive(ReferenceAsWritableBytes(base),
+					   MSG_WAITALL);
+	if (nbytes == 0 || cancel)
+		return false;
+
+	if (nbytes < 0)
+		throw MakeSocketError("Failed to receive from Snapcast server");
+
+	if (std::size_t(nbytes) < sizeof(base))
+		ReceiveFull(ReferenceAsWritableBytes(base).subspan(nbytes));
+
+	const std::size_t message_size = base.size;
+	if (message_size > 1024 * 1024)
+		throw std::runtime_error("Snapcast message too large");
+
+	receive_buffer.resize(message_size);
+	ReceiveFull(receive_buffer);
+
+	base.received = ToSnapcastTimestamp(Clock::now());
+	return true;
+}
+
+void
+SnapcastInputStream::SendMessage(SnapcastMessageType type,
+				 std::span<const std::byte> payload)
+{
+	SnapcastBase base{};
+	base.type = uint16_t(type);
+	base.id = next_id++;
+	base.sent = ToSnapcastTimestamp(Clock::now());
+	base.size = payload.size();
+
+	std::vector<std::byte> message;
+	message.reserve(sizeof(base) + payload.size());
+	message.insert(message.end(), ReferenceAsBytes(base).begin(),
+		       ReferenceAsBytes(base).end());
+	message.insert(message.end(), payload.begin(), payload.end());
+
+	std::span<const std::byte> src{message};
+	while (!src.empty()) {
+		const auto nbytes = socket.Send(src);
+		if (nbytes < 0)
+			throw MakeSocketError("Failed to send to Snapcast server");
+
+		src = src.subspan(nbytes);
+	}
+}
+
+inline void
+SnapcastInputStream::SendHello()
+{
+	const std::string json =
+		R"({"ClientName":"Music Player Daemon","Version":")" VERSION
+		R"(","SnapStreamProtocolVersion":2,"Instance":1})";
+	const PackedLE32 json_size = json.size();
+
+	std::vector<std::byte> payload;
+	payload.insert(payload.end(), ReferenceAsBytes(json_size).begin(),
+		       ReferenceAsBytes(json_size).end());
+	payload.insert(payload.end(), AsBytes(json).begin(),
+		       AsBytes(json).end());
+
+	SendMessage(SnapcastMessageType::HELLO, payload);
+}
+
+void
+SnapcastInputStream::SendTimeRequest()
+{
+	const SnapcastTime payload{};
+	SendMessage(SnapcastMessageType::TIME, ReferenceAsBytes(payload));
+
+	next_time_request = Clock::now() + TIME_REQUEST_INTERVAL;
+}
+
+inline void
+SnapcastInputStream::HandleTime(const SnapcastBase &base,
+				std::span<const std::byte> payload) noexcept
+{
+	if (payload.size() < sizeof(SnapcastTime))
+		return;
+
+	const auto &time = *(const SnapcastTime *)(const void *)payload.data();
+	clock_offset.Add(FromSnapcastTimestamp(time.latency),
+			 FromSnapcastTimestamp(base.received - base.sent));
+}
+
+inline void
+SnapcastInputStream::HandleServerSettings(std::span<const std::byte> payload) noexcept
+{
+	/* this is a JSON object, but we're interested only in
+	   "bufferMs" */
+	const std::string json{ToStringView(payload.subspan(std::min<std::size_t>(payload.size(), sizeof(PackedLE32))))};
+	const auto i = json.find(R"("bufferMs":)");
+	if (i == json.npos)
+		return;
+
+	const char *s = json.c_str() + i + 11;
+	while (*s == ' ')
+		++s;
+
+	char *endptr;
+	const unsigned value = ParseUnsigned(s, &endptr);
+	if (endptr > s)
+		buffer_time = std::chrono::milliseconds{value};
+}
+
+inline void
+SnapcastInputStream::HandleCodecHeader(std::span<const std::byte> payload)
+{
+	const auto read_string = [&payload](){
+		if (payload.size() < sizeof(PackedLE32))
+			throw std::runtime_error("Malformed Snapcast codec header");
+
+		const std::size_t length =
+			*(const PackedLE32 *)(const void *)payload.data();
+		payload = payload.subspan(sizeof(PackedLE32));
+		if (payload.size() < length)
+			throw std::runtime_error("Malformed Snapcast codec header");
+
+		const auto result = payload.first(length);
+		payload = payload.subspan(length);
+		return result;
+	};
+
+	const auto codec = ToStringView(read_string());
+	if (codec != "pcm"sv)
+		throw FmtRuntimeError("Unsupported Snapcast codec {:?}",
+				      codec);
+
+	const auto header = read_string();
+	if (header.size() < sizeof(RiffFileHeader) + sizeof(RiffChunkHeader) +
+	    sizeof(RiffFmtChunk))
+		throw std::runtime_error("Malformed Snapcast codec header");
+
+	const auto &fmt = *(const RiffFmtChunk *)(const void *)
+		(header.data() + sizeof(RiffFileHeader) + sizeof(RiffChunkHeader));
+
+	wire_bits = FromLE16(fmt.bits_per_sample);
+
+	AudioFormat audio_format;
+	switch (wire_bits) {
+	case 8:
+		audio_format.format = SampleFormat::S8;
+		break;
+
+	case 16:
+		audio_format.format = SampleFormat::S16;
+		break;
+
+	case 24:
+		audio_format.format = SampleFormat::S24_P32;
+		break;
+
+	case 32:
+		audio_format.format = SampleFormat::S32;
+		break;
+
+	default:
+		throw FmtRuntimeError("Unsupported Snapcast sample size: {}",
+				      wire_bits);
+	}
+
+	audio_format.sample_rate = FromLE32(fmt.sample_rate);
+	audio_format.channels = FromLE16(fmt.channels);
+	CheckSampleRate(audio_format.sample_rate);
+	CheckChannelCount(audio_format.channels);
+
+	wire_frame_size = wire_bits / 8 * audio_format.channels;
+	frame_size = audio_format.GetFrameSize();
+
+	SetMimeType(fmt::format("audio/x-mpd-snapcast-pcm;format={}",
+				ToString(audio_format).c_str()).c_str());
+}
+
+void
+SnapcastInputStream::HandleMessage(const SnapcastBase &base,
+				   std::span<const std::byte> payload)
+{
+	switch (SnapcastMessageType(uint16_t(base.type))) {
+	case SnapcastMessageType::TIME:
+		HandleTime(base, payload);
+		break;
+
+	case SnapcastMessageType::SERVER_SETTINGS:
+		HandleServerSettings(payload);
+		break;
+
+	case SnapcastMessageType::CODEC_HEADER:
+		if (wire_bits == 0)
+			HandleCodecHeader(payload);
+		break;
+
+	default:
+		/* ignore stream tags and unknown messages */
+		break;
+	}
+}
+
+void
+SnapcastInputStream::Open()
+{
+	if (!IsLittleEndian())
+		throw std::runtime_error("Snapcast PCM is not supported on big-endian hosts");
+
+	const char *host_port = StringAfterPrefix(GetURI(), "snapcast://");
+	if (host_port == nullptr || *host_port == 0)
+		throw std::runtime_error("Malformed Snapcast URI");
+
+	const ScopeUnlock unlock(mutex);
+
+	Connect(host_port);
+	SendHello();
+	SendTimeRequest();
+
+	/* wait for the codec header which announces the audio
+	   format */
+	do {
+		SnapcastBase base;
+		if (!ReceiveMessage(base))
+			throw std::runtime_error("Snapcast server closed the connection");
+
+		if (SnapcastMessageType(uint16_t(base.type)) !=
+		    SnapcastMessageType::WIRE_CHUNK)
+			HandleMessage(base, receive_buffer);
+	} while (wire_bits == 0);
+}
+
+inline void
+SnapcastInputStream::ImportPcm(std::span<const std::byte> src)
+{
+	/* ignore partial frames */
+	src = src.first(src.size() - src.size() % wire_frame_size);
+
+	switch (wire_bits) {
+	case 8:
+		/* WAV has unsigned 8 bit samples */
+		pcm.resize(src.size());
+		std::transform(src.begin(), src.end(), pcm.begin(),
+			       [](std::byte b){ return b ^ std::byte{0x80}; });
+		break;
+
+	case 24:
+		pcm.resize(src.size() / 3 * sizeof(int32_t));
+		pcm_unpack_24((int32_t *)(void *)pcm.data(),
+			      (const uint8_t *)src.data(),
+			      (const uint8_t *)src.data() + src.size());
+		break;
+
+	default:
+		pcm.assign(src.begin(), src.end());
+		break;
+	}
+}
+
+bool
+SnapcastInputStream::SleepUntil(Clock::time_point t) noexcept
+{
+	std::unique_lock lock{sleep_mutex};
+	sleep_cond.wait_until(lock, t, [this]{ return cancel.load(); });
+	return !cancel;
+}
+
+inline bool
+SnapcastInputStream::HandleWireChunk(std::span<const std::byte> payload)
+{
+	if (payload.size() < sizeof(SnapcastWireChunk))
+		throw std::runtime_error("Malformed Snapcast wire chunk");
+
+	const auto &wire = *(const SnapcastWireChunk *)(const void *)payload.data();
+	payload = payload.subspan(sizeof(wire));
+	payload = payload.first(std::min<std::size_t>(payload.size(),
+						      wire.size));
+
+	if (!clock_offset.IsDefined())
+		/* can't schedule this chunk without knowing the
+		   server's clock */
+		return false;
+
+	/* convert the server's timestamp to our clock and calculate
+	   when this chunk must be read so it gets played at the
+	   same time as on all other clients */
+	const auto play_time = Clock::time_point{
+		std::chrono::duration_cast<Clock::duration>(FromSnapcastTimestamp(wire.timestamp) -
+							    clock_offset.Get())
+	} + buffer_time;
+	const auto due = play_time - snapcast_input_config.latency;
+
+	auto error = Clock::now() - due;
+	if (error < -Clock::duration{RESYNC_THRESHOLD}) {
+		if (!SleepUntil(due))
+			return false;
+
+		error = {};
+	} else if (error > Clock::duration{MAX_LATE}) {
+		FmtDebug(snapcast_input_domain,
+			 "Skipping chunk which is late by {} ms",
+			 std::chrono::duration_cast<std::chrono::milliseconds>(error).count());
+		return false;
+	}
+
+	ImportPcm(payload);
+	if (pcm.size() < frame_size)
+		return false;
+
+	/* trim the sample rate by dropping or duplicating one frame,
+	   to compensate the drift between our audio device's clock
+	   and the server's clock */
+	if (error > Clock::duration{TRIM_THRESHOLD})
+		pcm.resize(pcm.size() - frame_size);
+	else if (error < -Clock::duration{TRIM_THRESHOLD}) {
+		const std::size_t old_size = pcm.size();
+		pcm.resize(old_size + frame_size);
+		std::copy_n(pcm.begin() + (old_size - frame_size), frame_size,
+			    pcm.begin() + old_size);
+	}
+
+	return !pcm.empty();
+}
+
+inline bool
+SnapcastInputStream::ReceiveChunk()
+{
+	while (true) {
+		if (Clock::now() >= next_time_request)
+			SendTimeRequest();
+
+		SnapcastBase base;
+		if (!ReceiveMessage(base))
+			return false;
+
+		if (SnapcastMessageType(uint16_t(base.type)) ==
+		    SnapcastMessageType::WIRE_CHUNK) {
+			if (HandleWireChunk(receive_buffer))
+				return true;
+
+			if (cancel)
+				return false;
+		} else
+			HandleMessage(base, receive_buffer);
+	}
+}
+
+std::size_t
+SnapcastInputStream::ThreadRead(std::span<std::byte> dest)
+{
+	if (pcm_position >= pcm.size()) {
+		pcm.clear();
+		pcm_position = 0;
+
+		if (!ReceiveChunk())
+			return 0;
+	}
+
+	const auto src = std::span{pcm}.subspan(pcm_position);
+	const std::size_t nbytes = std::min(src.size(), dest.size());
+	std::copy_n(src.begin(), nbytes, dest.begin());
+	pcm_position += nbytes;
+	return nbytes;
+}
+
+static void
+input_snapcast_init(EventLoop &, const ConfigBlock &block)
+{
+	snapcast_input_config.latency =
+		std::chrono::milliseconds{block.GetBlockValue("latency", 0U)};
+}
+
+static InputStreamPtr
+input_snapcast_open(const char *uri, Mutex &mutex)
+{
+	return std::make_unique<SnapcastInputStream>(uri, mutex);
+}
+
+static constexpr const char *snapcast_prefixes[] = {
+	"snapcast://",
+	nullptr
+};
+
+const InputPlugin input_plugin_snapcast = {
+	"snapcast",
+	snapcast_prefixes,
+	input_snapcast_init,
+	nullptr,
+	input_snapcast_open,
+	nullptr
+};
@@ -3,56 +3,380 @@
 
 #include "UringInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../AsyncBufferConfig.hxx"
+#include "config/Block.hxx"
 #include "event/Call.hxx"
 #include "event/Loop.hxx"
+#include "event/UringManager.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "lib/fmt/SystemError.hxx"
 #include "io/Open.hxx"
 #include "io/UniqueFileDescriptor.hxx"
-#include "io/uring/ReadOperation.hxx"
+#include "io/uring/Operation.hxx"
 #include "io/uring/Queue.hxx"
+#include "util/Domain.hxx"
+#include "util/IntrusiveList.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <sys/stat.h>
+#include <sys/uio.h> // for struct iovec
+
+static constexpr Domain uring_domain("io_uring");
 
 /**
  * Read at most this number of bytes in each read request.
  */
-static const size_t URING_MAX_READ = 256 * 1024;
+static constexpr size_t URING_MAX_READ = 128 * 1024;
+
+/**
+ * Do not submit read requests smaller than this (unless the end of
+ * the file is near or no other request is pending).
+ */
+static constexpr size_t URING_MIN_READ = 16 * 1024;
+
+/**
+ * Keep up to this number of read requests per stream in flight.
+ */
+static constexpr unsigned URING_MAX_READS = 4;
+
+/**
+ * Do not buffer more than this number of bytes (unless configured
+ * differently).  It should be a reasonable limit that doesn't make
+ * low-end machines suffer too much, but doesn't cause stuttering on
+ * high-latency lines.
+ */
+static AsyncInputBufferConfig uring_buffer_config{1024 * 1024};
+
+/**
+ * The number of buffers (of #URING_MAX_READ bytes each) registered
+ * with the kernel.  Requests which do not get one of them use a
+ * regular (heap) buffer.
+ */
+static constexpr unsigned URING_N_FIXED_BUFFERS = 16;
+
+/**
+ * The size of the registered file table.  Streams which do not get
+ * a slot use their regular file descriptor.
+ */
+static constexpr unsigned URING_N_FIXED_FILES = 64;
+
+static constexpr unsigned URING_QUEUE_ENTRIES = 256;
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * Buffers and file table slots registered with our io_uring.  This
+ * avoids mapping the buffer pages and looking up the file in the
+ * kernel for each request.  Only accessed from the I/O thread.
  */
-static const size_t URING_MAX_BUFFERED = 512 * 1024;
+class UringRegistry {
+	std::unique_ptr<std::byte[]> buffers;
+
+	std::vector<unsigned> free_buffers, free_files;
+
+public:
+	/**
+	 * Register as much as possible; errors are logged.
+	 */
+	void Init(Uring::Ring &ring) noexcept;
+
+	/**
+	 * @return the index of a free buffer or -1 if there is none
+	 */
+	int AllocateBuffer() noexcept {
+		if (free_buffers.empty())
+			return -1;
+
+		const unsigned i = free_buffers.back();
+		free_buffers.pop_back();
+		return i;
+	}
+
+	void FreeBuffer(unsigned i) noexcept {
+		free_buffers.push_back(i);
+	}
+
+	std::byte *GetBuffer(unsigned i) noexcept {
+		return &buffers[i * URING_MAX_READ];
+	}
+
+	/**
+	 * Add the file descriptor to the registered file table.
+	 *
+	 * @return the slot or -1 if none is available
+	 */
+	int RegisterFile(Uring::Ring &ring, FileDescriptor fd) noexcept;
+
+	void UnregisterFile(Uring::Ring &ring, unsigned slot) noexcept;
+};
+
+void
+UringRegistry::Init(Uring::Ring &ring) noexcept
+{
+	try {
+		buffers = std::make_unique<std::byte[]>(URING_N_FIXED_BUFFERS * URING_MAX_READ);
+
+		std::array<struct iovec, URING_N_FIXED_BUFFERS> iov;
+		for (unsigned i = 0; i < iov.size(); ++i)
+			iov[i] = {GetBuffer(i), URING_MAX_READ};
+
+		ring.RegisterBuffers(iov);
+
+		for (unsigned i = URING_N_FIXED_BUFFERS; i-- > 0;)
+			free_buffers.push_back(i);
+	} catch (...) {
+		/* probably RLIMIT_MEMLOCK is too small; continue
+		   without registered buffers */
+		FmtWarning(uring_domain,
+			   "Failed to register buffers: {}",
+			   std::current_exception());
+		buffers.reset();
+	}
+
+	try {
+		std::array<int, URING_N_FIXED_FILES> fds;
+		fds.fill(-1);
+		ring.RegisterFiles(fds);
+
+		for (unsigned i = URING_N_FIXED_FILES; i-- > 0;)
+			free_files.push_back(i);
+	} catch (...) {
+		FmtWarning(uring_domain,
+			   "Failed to register the file table: {}",
+			   std::current_exception());
+	}
+}
+
+int
+UringRegistry::RegisterFile(Uring::Ring &ring, FileDescriptor fd) noexcept
+{
+	if (free_files.empty())
+		return -1;
+
+	const unsigned slot = free_files.back();
+
+	try {
+		ring.UpdateFile(slot, fd.Get());
+	} catch (...) {
+		LogError(std::current_exception());
+		return -1;
+	}
+
+	free_files.pop_back();
+	return slot;
+}
+
+void
+UringRegistry::UnregisterFile(Uring::Ring &ring, unsigned slot) noexcept
+{
+	try {
+		ring.UpdateFile(slot, -1);
+	} catch (...) {
+		/* don't reuse this slot */
+		LogError(std::current_exception());
+		return;
+	}
+
+	free_files.push_back(slot);
+}
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The io_uring owned by this plugin.  It is separate from the
+ * #EventLoop's io_uring because it has its own registered buffers
+ * and files, and it may be configured to use a kernel thread for
+ * submission polling.
  */
-static const size_t URING_RESUME_AT = 384 * 1024;
+struct UringInputContext {
+	/* declared before #manager because the buffers must remain
+	   valid until the io_uring has been destroyed */
+	UringRegistry registry;
+
+	Uring::Manager manager;
+
+	UringInputContext(EventLoop &event_loop, unsigned flags)
+		:manager(event_loop, URING_QUEUE_ENTRIES, flags)
+	{
+		registry.Init(manager.GetRing());
+	}
+};
 
 static EventLoop *uring_input_event_loop;
 static Uring::Queue *uring_input_queue;
 
-class UringInputStream final : public AsyncInputStream, Uring::ReadHandler {
+/**
+ * nullptr if we're using the #EventLoop's io_uring.
+ */
+static UringInputContext *uring_input_context;
+
+class UringInputStream;
+
+/**
+ * One read request.  It reads into a registered buffer if one is
+ * available.
+ *
+ * Instances of this class must be allocated with `new`, because
+ * cancellation will require this object (and the buffer) to persist
+ * until the kernel completes the operation.
+ */
+class UringRead final
+	: public IntrusiveListHook<IntrusiveHookMode::NORMAL>,
+	  Uring::Operation
+{
+	UringInputStream *stream;
+
+	UringRegistry *const registry;
+
+	const uint64_t offset;
+	const size_t size;
+
+	/**
+	 * The index of the registered buffer or -1 if #heap_buffer
+	 * is used.
+	 */
+	int fixed_buffer = -1;
+
+	std::unique_ptr<std::byte[]> heap_buffer;
+
+	struct iovec iov;
+
+	int result;
+
+	bool complete = false;
+
+public:
+	UringRead(UringInputStream &_stream, UringRegistry *_registry,
+		  uint64_t _offset, size_t _size) noexcept
+		:stream(&_stream), registry(_registry),
+		 offset(_offset), size(_size) {}
+
+	~UringRead() noexcept {
+		if (fixed_buffer >= 0)
+			registry->FreeBuffer(fixed_buffer);
+	}
+
+	uint64_t GetOffset() const noexcept {
+		return offset;
+	}
+
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	bool IsComplete() const noexcept {
+		return complete;
+	}
+
+	/**
+	 * The result code (only valid if IsComplete()).
+	 */
+	int GetResult() const noexcept {
+		return result;
+	}
+
+	std::span<const std::byte> GetData(size_t nbytes) const noexcept {
+		assert(nbytes <= size);
+
+		return {
+			fixed_buffer >= 0
+			? registry->GetBuffer(fixed_buffer)
+			: heap_buffer.get(),
+			nbytes,
+		};
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @param fixed_file the registered file slot or -1
+	 */
+	void Start(Uring::Queue &queue, FileDescriptor fd, int fixed_file);
+
+	/**
+	 * Cancel this operation.  This instance will be freed using
+	 * `delete` after the kernel has finished cancellation,
+	 * i.e. the caller resigns ownership.
+	 */
+	void Cancel() noexcept {
+		stream = nullptr;
+	}
+
+private:
+	/* virtual methods from class Uring::Operation */
+	void OnUringCompletion(int res) noexcept override;
+};
+
+void
+UringRead::Start(Uring::Queue &queue, FileDescriptor fd, int fixed_file)
+{
+	auto &s = queue.RequireSubmitEntry();
+
+	const int file = fixed_file >= 0 ? fixed_file : fd.Get();
+
+	if (registry != nullptr)
+		fixed_buffer = registry->AllocateBuffer();
+
+	if (fixed_buffer >= 0) {
+		io_uring_prep_read_fixed(&s, file,
+					 registry->GetBuffer(fixed_buffer),
+					 size, offset, fixed_buffer);
+	} else {
+		heap_buffer = std::make_unique<std::byte[]>(size);
+		iov.iov_base = heap_buffer.get();
+		iov.iov_len = size;
+		io_uring_prep_readv(&s, file, &iov, 1, offset);
+	}
+
+	if (fixed_file >= 0)
+		s.flags |= IOSQE_FIXED_FILE;
+
+	/* this does not submit immediately; Uring::Manager collects
+	   all requests submitted in one event loop iteration */
+	queue.Push(s, *this);
+}
+
+class UringInputStream final : public AsyncInputStream {
+	friend class UringRead;
+
 	Uring::Queue &uring;
 
+	UringRegistry *const registry;
+
 	UniqueFileDescriptor fd;
 
+	/**
+	 * The slot of #fd in the registered file table or -1.
+	 */
+	int fixed_file = -1;
+
 	uint64_t next_offset = 0;
 
-	std::unique_ptr<Uring::ReadOperation> read_operation;
+	/**
+	 * The number of bytes requested by #reads.
+	 */
+	size_t in_flight = 0;
+
+	/**
+	 * Pending read requests, ordered by offset.
+	 */
+	IntrusiveList<UringRead, IntrusiveListBaseHookTraits<UringRead>,
+		      IntrusiveListOptions{.constant_time_size = true}> reads;
 
 public:
 	UringInputStream(EventLoop &event_loop, Uring::Queue &_uring,
+			 UringRegistry *_registry,
 			 std::string_view path,
 			 UniqueFileDescriptor &&_fd,
 			 offset_type _size, Mutex &_mutex)
 		:AsyncInputStream(event_loop,
 				  path, _mutex,
-				  URING_MAX_BUFFERED,
-				  URING_RESUME_AT),
-		 uring(_uring),
+				  uring_buffer_config),
+		 uring(_uring), registry(_registry),
 		 fd(std::move(_fd))
 	{
 		size = _size;
@@ -60,104 +384,186 @@ public:
 		SetReady();
 
 		BlockingCall(GetEventLoop(), [this](){
-			SubmitRead();
+			if (registry != nullptr)
+				fixed_file = registry->RegisterFile(uring.GetRing(),
+								    fd);
+
+			SubmitReads();
 		});
 	}
 
 	~UringInputStream() noexcept override {
 		BlockingCall(GetEventLoop(), [this](){
-			CancelRead();
+			CancelReads();
+
+			if (fixed_file >= 0)
+				registry->UnregisterFile(uring.GetRing(),
+							 fixed_file);
 		});
 	}
 
 private:
-	void SubmitRead() noexcept;
+	/**
+	 * Submit read requests until #URING_MAX_READS are in flight
+	 * or the buffer would be full.
+	 */
+	void SubmitReads() noexcept;
+
+	void CancelReads() noexcept {
+		reads.clear_and_dispose([](UringRead *read){
+			if (read->IsComplete())
+				/* the kernel is done with it, but we
+				   haven't consumed it yet */
+				delete read;
+			else
+				read->Cancel();
+		});
+
+		in_flight = 0;
+	}
+
+	void OnReadComplete() noexcept;
+
+	/**
+	 * Move the data of the given request (which must be the
+	 * first one and complete) to the buffer.
+	 *
+	 * @return false if the stream has failed or if the
+	 * remaining requests have been canceled
+	 */
+	bool ConsumeRead(UringRead &read) noexcept;
 
-	void CancelRead() noexcept {
-		if (read_operation)
-			read_operation.release()->Cancel();
+	void SetError(std::exception_ptr e) noexcept {
+		CancelReads();
+		postponed_exception = std::move(e);
+		InvokeOnAvailable();
 	}
 
 protected:
 	/* virtual methods from AsyncInputStream */
 	void DoResume() override;
 	void DoSeek(offset_type new_offset) override;
-
-private:
-	/* virtual methods from class Uring::Operation */
-	void OnRead(std::unique_ptr<std::byte[]> buffer,
-		    std::size_t size) noexcept override;
-	void OnReadError(int error) noexcept override;
 };
 
 void
-UringInputStream::SubmitRead() noexcept
+UringRead::OnUringCompletion(int res) noexcept
 {
-	assert(!read_operation);
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return;
-
-	auto w = PrepareWriteBuffer();
-	if (w.empty()) {
-		Pause();
+	if (stream == nullptr) {
+		/* operation was canceled */
+		delete this;
 		return;
 	}
 
-	read_operation = std::make_unique<Uring::ReadOperation>();
-	read_operation->Start(uring, fd, next_offset,
-			      std::min(w.size(), URING_MAX_READ),
-			      *this);
+	result = res;
+	complete = true;
+	stream->OnReadComplete();
+}
+
+void
+UringInputStream::SubmitReads() noexcept
+{
+	while (reads.size() < URING_MAX_READS && next_offset < size) {
+		const size_t space = GetBufferSpace();
+		if (space <= in_flight) {
+			if (reads.empty())
+				Pause();
+			return;
+		}
+
+		const uint64_t remaining = size - next_offset;
+		const size_t nbytes = std::min<uint64_t>({space - in_flight,
+				URING_MAX_READ, remaining});
+		if (nbytes < std::min<uint64_t>(URING_MIN_READ, remaining) &&
+		    !reads.empty())
+			/* wait until the client has consumed more */
+			return;
+
+		auto *read = new UringRead(*this, registry,
+					   next_offset, nbytes);
+
+		try {
+			read->Start(uring, fd, fixed_file);
+		} catch (...) {
+			delete read;
+			SetError(std::current_exception());
+			return;
+		}
+
+		reads.push_back(*read);
+		in_flight += nbytes;
+		next_offset += nbytes;
+	}
 }
 
 void
 UringInputStream::DoResume()
 {
-	SubmitRead();
+	SubmitReads();
 }
 
 void
 UringInputStream::DoSeek(offset_type new_offset)
 {
-	CancelRead();
+	CancelReads();
 
 	next_offset = offset = new_offset;
 	SeekDone();
-	SubmitRead();
+	SubmitReads();
 }
 
-void
-UringInputStream::OnRead(std::unique_ptr<std::byte[]> data,
-			 std::size_t nbytes) noexcept
+inline bool
+UringInputStream::ConsumeRead(UringRead &read) noexcept
 {
-	read_operation.reset();
+	assert(&read == &reads.front());
+	assert(read.IsComplete());
 
-	const std::scoped_lock protect{mutex};
+	const int res = read.GetResult();
+	if (res < 0) {
+		SetError(std::make_exception_ptr(MakeErrno(-res, "Read failed")));
+		return false;
+	}
 
-	if (nbytes == 0) {
-		postponed_exception = std::make_exception_ptr(std::runtime_error("Premature end of file"));
-		InvokeOnAvailable();
-		return;
+	if (res == 0) {
+		SetError(std::make_exception_ptr(std::runtime_error("Premature end of file")));
+		return false;
 	}
 
-	auto w = PrepareWriteBuffer();
-	assert(w.size() >= nbytes);
-	memcpy(w.data(), data.get(), nbytes);
-	CommitWriteBuffer(nbytes);
-	next_offset += nbytes;
-	SubmitRead();
+	const size_t nbytes = res;
+	AppendToBuffer(read.GetData(nbytes));
+
+	assert(in_flight >= read.GetSize());
+	in_flight -= read.GetSize();
+
+	const bool short_read = nbytes < read.GetSize();
+	if (short_read)
+		next_offset = read.GetOffset() + nbytes;
+
+	reads.pop_front();
+	delete &read;
+
+	if (short_read) {
+		/* the following requests have left a gap; discard
+		   them and read again */
+		CancelReads();
+		return false;
+	}
+
+	return true;
 }
 
 void
-UringInputStream::OnReadError(int error) noexcept
+UringInputStream::OnReadComplete() noexcept
 {
-	read_operation.reset();
-
 	const std::scoped_lock protect{mutex};
 
-	postponed_exception = std::make_exception_ptr(MakeErrno(error, "Read failed"));
-	InvokeOnAvailable();
+	/* requests may complete in any order, but the data must be
+	   appended to the buffer in order */
+	while (!reads.empty() && reads.front().IsComplete())
+		if (!ConsumeRead(reads.front()))
+			break;
+
+	if (!postponed_exception)
+		SubmitReads();
 }
 
 InputStreamPtr
@@ -179,16 +585,66 @@ OpenUringInputStream(const char *path, Mutex &mutex)
 
 	return std::make_unique<UringInputStream>(*uring_input_event_loop,
 						  *uring_input_queue,
+						  uring_input_context != nullptr
+						  ? &uring_input_context->registry
+						  : nullptr,
 						  path, std::move(fd),
 						  st.st_size, mutex);
 }
 
 void
-InitUringInputPlugin(EventLoop &event_loop) noexcept
+InitUringInputPlugin(EventLoop &event_loop, const ConfigBlock &block)
 {
 	uring_input_event_loop = &event_loop;
 
-	BlockingCall(event_loop, [](){
+	uring_buffer_config.Load(block);
+
+	const unsigned flags = block.GetBlockValue("sqpoll", false)
+		? IORING_SETUP_SQPOLL
+		: 0;
+
+	BlockingCall(event_loop, [flags](){
+		try {
+			try {
+				uring_input_context =
+					new UringInputContext(*uring_input_event_loop,
+							      flags);
+			} catch (...) {
+				if (flags == 0)
+					throw;
+
+				/* SQPOLL may require privileges; try
+				   again without it */
+				FmtWarning(uring_domain,
+					   "Failed to enable SQPOLL: {}",
+					   std::current_exception());
+				uring_input_context =
+					new UringInputContext(*uring_input_event_loop,
+							      0);
+			}
+
+			uring_input_queue = &uring_input_context->manager;
+			return;
+		} catch (...) {
+			FmtError(uring_domain,
+				 "Failed to initialize io_uring: {}",
+				 std::current_exception());
+		}
+
+		/* fall back to the EventLoop's io_uring, without
+		   registered buffers */
 		uring_input_queue = uring_input_event_loop->GetUring();
 	});
 }
+
+void
+FinishUringInputPlugin() noexcept
+{
+	if (uring_input_event_loop == nullptr)
+		return;
+
+	BlockingCall(*uring_input_event_loop, [](){
+		delete std::exchange(uring_input_context, nullptr);
+		uring_input_queue = nullptr;
+	});
+}
@@ -8,9 +8,19 @@
 #include "thread/Mutex.hxx"
 
 class EventLoop;
+struct ConfigBlock;
 
+/**
+ * Throws on error.
+ *
+ * @param block the "input" block with plugin "io_uring" (may be
+ * empty)
+ */
 void
-InitUringInputPlugin(EventLoop &event_loop) noexcept;
+InitUringInputPlugin(EventLoop &event_loop, const ConfigBlock &block);
+
+void
+FinishUringInputPlugin() noexcept;
 
 InputStreamPtr
 OpenUringInputStream(const char *path, Mutex &mutex);
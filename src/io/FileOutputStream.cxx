@@ -137,6 +137,12 @@ FileOutputStream::Sync()
 		throw FmtLastError("Failed to sync {}", GetPath());
 }
 
+void
+FileOutputStream::Preallocate(uint64_t, uint64_t) noexcept
+{
+	assert(IsDefined());
+}
+
 void
 FileOutputStream::Commit()
 try {
@@ -271,6 +277,19 @@ FileOutputStream::Sync()
 		throw FmtErrno("Failed to sync {}", GetPath());
 }
 
+void
+FileOutputStream::Preallocate(uint64_t offset, uint64_t length) noexcept
+{
+	assert(IsDefined());
+
+#ifdef __linux__
+	fallocate(fd.Get(), FALLOC_FL_KEEP_SIZE, offset, length);
+#else
+	(void)offset;
+	(void)length;
+#endif
+}
+
 void
 FileOutputStream::Commit()
 try {
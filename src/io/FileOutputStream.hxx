@@ -137,6 +137,14 @@ public:
 	 */
 	void Sync();
 
+	/**
+	 * Reserve disk space for the given range without changing
+	 * the file size, to reduce fragmentation of a file which
+	 * keeps growing.  This is only a hint; it is a no-op if the
+	 * operating system or the filesystem does not support it.
+	 */
+	void Preallocate(uint64_t offset, uint64_t length) noexcept;
+
 	/**
 	 * Commit all data written to the file and make the file
 	 * visible on the specified path.
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/Path.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/SystemError.hxx"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile(Path path)
+{
+	FileReader reader{path};
+
+	const auto size = reader.GetSize();
+	if (size == 0)
+		return;
+
+	if (size > SIZE_MAX)
+		throw std::runtime_error("File is too large");
+
+#ifdef _WIN32
+	buffer = std::make_unique<std::byte[]>(size);
+
+	std::size_t position = 0;
+	while (position < size) {
+		std::size_t nbytes = reader.Read({buffer.get() + position,
+						  std::size_t(size - position)});
+		if (nbytes == 0)
+			throw std::runtime_error("Unexpected end of file");
+		position += nbytes;
+	}
+
+	data = {buffer.get(), std::size_t(size)};
+#else
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		throw FmtErrno("Failed to map {}", path);
+
+	/* the whole file is usually read sequentially */
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	data = {(const std::byte *)p, std::size_t(size)};
+#endif
+}
+
+MappedFile::~MappedFile() noexcept
+{
+#ifndef _WIN32
+	if (!data.empty())
+		munmap(const_cast<std::byte *>(data.data()), data.size());
+#endif
+}
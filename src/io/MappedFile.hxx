@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+
+class Path;
+
+/**
+ * Map a whole file into memory (read-only).  On platforms without
+ * mmap(), the file contents are copied into a heap allocation.
+ */
+class MappedFile {
+	std::span<const std::byte> data;
+
+#ifdef _WIN32
+	std::unique_ptr<std::byte[]> buffer;
+#endif
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit MappedFile(Path path);
+
+	~MappedFile() noexcept;
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	std::span<const std::byte> GetData() const noexcept {
+		return data;
+	}
+};
@@ -29,6 +29,14 @@ public:
 		return ring.GetFileDescriptor();
 	}
 
+	/**
+	 * Access the low-level #Ring, e.g. to register buffers or
+	 * files.
+	 */
+	Ring &GetRing() noexcept {
+		return ring;
+	}
+
 	struct io_uring_sqe *GetSubmitEntry() noexcept {
 		return ring.GetSubmitEntry();
 	}
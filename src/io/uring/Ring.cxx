@@ -14,6 +14,31 @@ Ring::Ring(unsigned entries, unsigned flags)
 		throw MakeErrno(-error, "io_uring_queue_init() failed");
 }
 
+void
+Ring::RegisterBuffers(std::span<const struct iovec> buffers)
+{
+	int error = io_uring_register_buffers(&ring, buffers.data(),
+					      buffers.size());
+	if (error < 0)
+		throw MakeErrno(-error, "io_uring_register_buffers() failed");
+}
+
+void
+Ring::RegisterFiles(std::span<const int> fds)
+{
+	int error = io_uring_register_files(&ring, fds.data(), fds.size());
+	if (error < 0)
+		throw MakeErrno(-error, "io_uring_register_files() failed");
+}
+
+void
+Ring::UpdateFile(unsigned slot, int fd)
+{
+	int error = io_uring_register_files_update(&ring, slot, &fd, 1);
+	if (error < 0)
+		throw MakeErrno(-error, "io_uring_register_files_update() failed");
+}
+
 void
 Ring::Submit()
 {
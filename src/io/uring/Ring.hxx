@@ -8,6 +8,8 @@
 
 #include <liburing.h>
 
+#include <span>
+
 namespace Uring {
 
 /**
@@ -40,6 +42,32 @@ public:
 		return FileDescriptor(ring.ring_fd);
 	}
 
+	/**
+	 * Register buffers for IORING_OP_READ_FIXED and
+	 * IORING_OP_WRITE_FIXED using io_uring_register_buffers().
+	 *
+	 * Throws on error.
+	 */
+	void RegisterBuffers(std::span<const struct iovec> buffers);
+
+	/**
+	 * Register a file table for #IOSQE_FIXED_FILE using
+	 * io_uring_register_files().  Entries may be -1 (sparse).
+	 *
+	 * Throws on error.
+	 */
+	void RegisterFiles(std::span<const int> fds);
+
+	/**
+	 * Replace one entry of the file table registered with
+	 * RegisterFiles() using io_uring_register_files_update().
+	 *
+	 * Throws on error.
+	 *
+	 * @param fd the new file descriptor or -1 to clear the slot
+	 */
+	void UpdateFile(unsigned slot, int fd);
+
 	/**
 	 * Returns a submit queue entry or nullptr if the submit queue
 	 * is full.
@@ -160,7 +160,7 @@ SetupSampleFormat(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 
 HwResult
 SetupHw(snd_pcm_t *pcm,
-	unsigned buffer_time, unsigned period_time,
+	unsigned buffer_time, unsigned period_time, bool mmap,
 	AudioFormat &audio_format, PcmExport::Params &params)
 {
 	snd_pcm_hw_params_t *hwparams;
@@ -175,7 +175,9 @@ SetupHw(snd_pcm_t *pcm,
 		throw Alsa::MakeError(err, "snd_pcm_hw_params_any() failed");
 
 	err = snd_pcm_hw_params_set_access(pcm, hwparams,
-					   SND_PCM_ACCESS_RW_INTERLEAVED);
+					   mmap
+					   ? SND_PCM_ACCESS_MMAP_INTERLEAVED
+					   : SND_PCM_ACCESS_RW_INTERLEAVED);
 	if (err < 0)
 		throw Alsa::MakeError(err, "snd_pcm_hw_params_set_access() failed");
 
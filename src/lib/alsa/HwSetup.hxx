@@ -22,13 +22,15 @@ struct HwResult {
  *
  * @param buffer_time the configured buffer time, or 0 if not configured
  * @param period_time the configured period time, or 0 if not configured
+ * @param mmap request SND_PCM_ACCESS_MMAP_INTERLEAVED instead of
+ * SND_PCM_ACCESS_RW_INTERLEAVED
  * @param audio_format an #AudioFormat to be configured (or modified)
  * by this function
  * @param params to be modified by this function
  */
 HwResult
 SetupHw(snd_pcm_t *pcm,
-	unsigned buffer_time, unsigned period_time,
+	unsigned buffer_time, unsigned period_time, bool mmap,
 	AudioFormat &audio_format, PcmExport::Params &params);
 
 } // namespace Alsa
@@ -5,6 +5,8 @@
 #include "Error.hxx"
 #include "event/MultiSocketMonitor.hxx"
 
+#include <algorithm>
+
 namespace Alsa {
 
 std::span<pollfd>
@@ -69,6 +71,7 @@ NonBlockMixer::PrepareSockets(MultiSocketMonitor &m, snd_mixer_t *mixer) noexcep
 {
 	int count = snd_mixer_poll_descriptors_count(mixer);
 	if (count <= 0) {
+		registered = nullptr;
 		m.ClearSocketList();
 		return Event::Duration(-1);
 	}
@@ -79,7 +82,22 @@ NonBlockMixer::PrepareSockets(MultiSocketMonitor &m, snd_mixer_t *mixer) noexcep
 	if (count < 0)
 		count = 0;
 
-	m.ReplaceSocketList(pfds.first(count));
+	const auto current = pfds.first(count);
+
+	/* the mixer's descriptors hardly ever change; skip the
+	   socket registration syscalls if they are the same as last
+	   time */
+	if (!registered.empty() &&
+	    std::equal(current.begin(), current.end(),
+		       std::span<const pollfd>{registered}.begin(),
+		       std::span<const pollfd>{registered}.end(),
+		       [](const pollfd &a, const pollfd &b){
+			       return a.fd == b.fd && a.events == b.events;
+		       }))
+		return Event::Duration(-1);
+
+	registered = std::span<const pollfd>{current};
+	m.ReplaceSocketList(current);
 	return Event::Duration(-1);
 }
 
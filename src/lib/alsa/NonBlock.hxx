@@ -56,6 +56,13 @@ public:
 class NonBlockMixer {
 	NonBlock base;
 
+	/**
+	 * A copy of the descriptors which were last passed to
+	 * MultiSocketMonitor::ReplaceSocketList(); if they did not
+	 * change, the socket registrations are left alone.
+	 */
+	AllocatedArray<pollfd> registered;
+
 public:
 	Event::Duration PrepareSockets(MultiSocketMonitor &m,
 				       snd_mixer_t *mixer) noexcept;
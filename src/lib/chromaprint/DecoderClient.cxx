@@ -3,9 +3,19 @@
 
 #include "DecoderClient.hxx"
 #include "pcm/Convert.hxx"
+#include "pcm/ShiftConvert.hxx"
+#include "pcm/FloatConvert.hxx"
 #include "input/InputStream.hxx"
 #include "util/SpanCast.hxx"
 
+#include <algorithm>
+
+/**
+ * libchromaprint's default algorithm does not look beyond this
+ * duration, so decoding more would be wasted effort.
+ */
+static constexpr std::chrono::minutes chromaprint_duration{2};
+
 ChromaprintDecoderClient::ChromaprintDecoderClient() = default;
 ChromaprintDecoderClient::~ChromaprintDecoderClient() noexcept = default;
 
@@ -30,10 +40,10 @@ void
 ChromaprintDecoderClient::Ready(AudioFormat audio_format, bool,
 				SignedSongTime) noexcept
 {
-	/* feed the first two minutes into libchromaprint */
-	remaining_bytes = audio_format.TimeToSize(std::chrono::minutes(2));
+	remaining_bytes = audio_format.TimeToSize(chromaprint_duration);
+	src_format = audio_format.format;
 
-	if (audio_format.format != SampleFormat::S16) {
+	if (audio_format.format == SampleFormat::DSD) {
 		const AudioFormat src_audio_format = audio_format;
 		audio_format.format = SampleFormat::S16;
 
@@ -46,6 +56,16 @@ ChromaprintDecoderClient::Ready(AudioFormat audio_format, bool,
 	ready = true;
 }
 
+template<typename C>
+static std::span<const int16_t>
+ConvertTo16(PcmBuffer &buffer, std::span<const std::byte> _src) noexcept
+{
+	const auto src = FromBytesStrict<const typename C::SV>(_src);
+	int16_t *dest = buffer.GetT<int16_t>(src.size());
+	std::transform(src.begin(), src.end(), dest, C::Convert);
+	return {dest, src.size()};
+}
+
 DecoderCommand
 ChromaprintDecoderClient::SubmitAudio(InputStream *,
 				      std::span<const std::byte> audio,
@@ -53,15 +73,49 @@ ChromaprintDecoderClient::SubmitAudio(InputStream *,
 {
 	assert(ready);
 
+	/* feed exactly the configured duration, so the fingerprint
+	   does not depend on the decoder's chunk size */
 	if (audio.size() > remaining_bytes)
-		remaining_bytes = 0;
-	else
-		remaining_bytes -= audio.size();
+		audio = audio.first(remaining_bytes);
+	remaining_bytes -= audio.size();
 
-	if (convert)
-		audio = convert->Convert(audio);
-
-	chromaprint.Feed(FromBytesStrict<const int16_t>(audio));
+	try {
+		switch (src_format) {
+		case SampleFormat::S8:
+			chromaprint.Feed(ConvertTo16<LeftShiftSampleConvert<SampleFormat::S8,
+									    SampleFormat::S16>>(buffer, audio));
+			break;
+
+		case SampleFormat::S16:
+			chromaprint.Feed(FromBytesStrict<const int16_t>(audio));
+			break;
+
+		case SampleFormat::S24_P32:
+			chromaprint.Feed(ConvertTo16<RightShiftSampleConvert<SampleFormat::S24_P32,
+									     SampleFormat::S16>>(buffer, audio));
+			break;
+
+		case SampleFormat::S32:
+			chromaprint.Feed(ConvertTo16<RightShiftSampleConvert<SampleFormat::S32,
+									     SampleFormat::S16>>(buffer, audio));
+			break;
+
+		case SampleFormat::FLOAT:
+			chromaprint.Feed(ConvertTo16<FloatToIntegerSampleConvert<SampleFormat::S16>>(buffer, audio));
+			break;
+
+		case SampleFormat::DSD:
+			assert(convert);
+			chromaprint.Feed(FromBytesStrict<const int16_t>(convert->Convert(audio)));
+			break;
+
+		case SampleFormat::UNDEFINED:
+			assert(false);
+			break;
+		}
+	} catch (...) {
+		error = std::current_exception();
+	}
 
 	return GetCommand();
 }
@@ -6,6 +6,8 @@
 
 #include "Context.hxx"
 #include "decoder/Client.hxx"
+#include "pcm/Buffer.hxx"
+#include "pcm/SampleFormat.hxx"
 #include "thread/Mutex.hxx"
 
 #include <cstdint>
@@ -17,10 +19,32 @@ class PcmConvert;
 class ChromaprintDecoderClient : public DecoderClient {
 	bool ready = false;
 
+	/**
+	 * The sample format submitted by the decoder.  Everything but
+	 * DSD is converted to 16 bit by truncating (see #buffer);
+	 * dithering would only waste CPU time, because libchromaprint
+	 * downmixes and resamples to 11 kHz anyway.
+	 */
+	SampleFormat src_format;
+
+	/**
+	 * The destination buffer for the conversion to 16 bit.
+	 */
+	PcmBuffer buffer;
+
+	/**
+	 * Only used for DSD, which needs to be converted to PCM
+	 * first.
+	 */
 	std::unique_ptr<PcmConvert> convert;
 
 	Chromaprint::Context chromaprint;
 
+	/**
+	 * The number of bytes (in #src_format) which still need to
+	 * be fed into libchromaprint.  Once this reaches zero, the
+	 * decoder is stopped.
+	 */
 	uint64_t remaining_bytes;
 
 protected:
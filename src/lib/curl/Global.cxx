@@ -84,8 +84,16 @@ CurlGlobal::CurlGlobal(EventLoop &_loop)
 	:defer_read_info(_loop, BIND_THIS_METHOD(ReadInfo)),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout))
 {
+	share.Share(CURL_LOCK_DATA_DNS);
+	share.Share(CURL_LOCK_DATA_SSL_SESSION);
+
 	multi.SetSocketFunction(CurlSocket::SocketFunction, this);
 	multi.SetTimerFunction(TimerFunction, this);
+
+	/* send concurrent requests to the same server (e.g. many
+	   WebDAV PROPFIND requests during a database update) over
+	   one HTTP/2 connection */
+	multi.SetOption(CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
 }
 
 int
@@ -128,6 +136,13 @@ CurlGlobal::Add(CurlRequest &r)
 {
 	assert(GetEventLoop().IsInside());
 
+	auto &easy = r.GetEasy();
+	easy.SetOption(CURLOPT_SHARE, share.Get());
+
+	/* prefer waiting for a connection which can be multiplexed
+	   over opening a new one */
+	easy.TrySetOption(CURLOPT_PIPEWAIT, 1L);
+
 	multi.Add(r.Get());
 
 	InvalidateSockets();
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "Multi.hxx"
+#include "Share.hxx"
 #include "event/CoarseTimerEvent.hxx"
 #include "event/DeferEvent.hxx"
 
@@ -14,6 +15,12 @@ class CurlRequest;
  * Manager for the global CURLM object.
  */
 class CurlGlobal final {
+	/**
+	 * The DNS cache and the TLS session cache shared by all
+	 * requests.  (Connections are already shared by #multi.)
+	 */
+	CurlShare share;
+
 	CurlMulti multi;
 
 	DeferEvent defer_read_info;
@@ -26,6 +33,18 @@ public:
 		return timeout_event.GetEventLoop();
 	}
 
+	/**
+	 * Limit the number of connections to a single host; further
+	 * requests are queued until a connection becomes available
+	 * (or are multiplexed over an existing HTTP/2 connection).
+	 *
+	 * @param n the maximum number of connections per host; 0
+	 * means unlimited
+	 */
+	void SetMaxHostConnections(unsigned n) {
+		multi.SetOption(CURLMOPT_MAX_HOST_CONNECTIONS, (long)n);
+	}
+
 	void Add(CurlRequest &r);
 	void Remove(CurlRequest &r) noexcept;
 
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// author: Max Kellermann <max.kellermann@gmail.com>
+
+#pragma once
+
+#include <curl/curl.h>
+
+#include <stdexcept>
+#include <utility>
+
+/**
+ * An OO wrapper for a "CURLSH*" (a libCURL "share" handle).
+ */
+class CurlShare {
+	CURLSH *handle = nullptr;
+
+public:
+	/**
+	 * Allocate a new CURLSH*.
+	 *
+	 * Throws on error.
+	 */
+	CurlShare()
+		:handle(curl_share_init())
+	{
+		if (handle == nullptr)
+			throw std::runtime_error("curl_share_init() failed");
+	}
+
+	/**
+	 * Create an empty instance.
+	 */
+	CurlShare(std::nullptr_t) noexcept:handle(nullptr) {}
+
+	CurlShare(CurlShare &&src) noexcept
+		:handle(std::exchange(src.handle, nullptr)) {}
+
+	~CurlShare() noexcept {
+		if (handle != nullptr)
+			curl_share_cleanup(handle);
+	}
+
+	CurlShare &operator=(CurlShare &&src) noexcept {
+		std::swap(handle, src.handle);
+		return *this;
+	}
+
+	operator bool() const noexcept {
+		return handle != nullptr;
+	}
+
+	CURLSH *Get() noexcept {
+		return handle;
+	}
+
+	template<typename T>
+	void SetOption(CURLSHoption option, T value) {
+		auto code = curl_share_setopt(handle, option, value);
+		if (code != CURLSHE_OK)
+			throw std::runtime_error(curl_share_strerror(code));
+	}
+
+	/**
+	 * Share the specified kind of data (CURL_LOCK_DATA_*)
+	 * between all easy handles using this object.
+	 */
+	void Share(curl_lock_data data) {
+		SetOption(CURLSHOPT_SHARE, data);
+	}
+};
@@ -41,6 +41,10 @@ public:
 		return *this;
 	}
 
+	explicit operator bool() const noexcept {
+		return codec_context != nullptr;
+	}
+
 	AVCodecContext &operator*() noexcept {
 		return *codec_context;
 	}
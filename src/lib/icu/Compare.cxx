@@ -7,6 +7,12 @@
 #include "util/StringCompare.hxx"
 #include "config.h"
 
+#ifdef HAVE_ICU_CANONICALIZE
+#include "util/CharUtil.hxx"
+
+#include <span>
+#endif
+
 #ifdef _WIN32
 #include "Win32.hxx"
 #include <windows.h>
@@ -17,6 +23,42 @@
 IcuCompare::IcuCompare(std::string_view _needle) noexcept
 	:needle(IcuCanonicalize(_needle, true)) {}
 
+/**
+ * The size of the stack buffer for FoldASCII().  Most tag values
+ * are shorter than this.
+ */
+static constexpr std::size_t FOLD_ASCII_BUFFER_SIZE = 256;
+
+/**
+ * Fast path for IcuCanonicalize(src, true) which avoids ICU and heap
+ * allocations: if the string is pure ASCII, canonicalization is just
+ * conversion to lower case.  The loop has no early exit, so the
+ * compiler can vectorize it.
+ *
+ * @return the null-terminated folded string in the given buffer or
+ * nullptr if the string is not ASCII or too long
+ */
+static const char *
+FoldASCII(const char *src, std::span<char> buffer) noexcept
+{
+	const std::size_t length = strlen(src);
+	if (length >= buffer.size())
+		return nullptr;
+
+	unsigned char all = 0;
+	for (std::size_t i = 0; i < length; ++i) {
+		all |= static_cast<unsigned char>(src[i]);
+		buffer[i] = ToLowerASCII(src[i]);
+	}
+
+	if (all & 0x80)
+		/* not ASCII */
+		return nullptr;
+
+	buffer[length] = 0;
+	return buffer.data();
+}
+
 #elif defined(_WIN32)
 
 IcuCompare::IcuCompare(std::string_view _needle) noexcept
@@ -39,6 +81,10 @@ bool
 IcuCompare::operator==(const char *haystack) const noexcept
 {
 #ifdef HAVE_ICU_CANONICALIZE
+	char buffer[FOLD_ASCII_BUFFER_SIZE];
+	if (const char *folded = FoldASCII(haystack, buffer))
+		return StringIsEqual(folded, needle.c_str());
+
 	return StringIsEqual(IcuCanonicalize(haystack, true).c_str(), needle.c_str());
 #elif defined(_WIN32)
 	if (needle == nullptr)
@@ -65,6 +111,10 @@ bool
 IcuCompare::IsIn(const char *haystack) const noexcept
 {
 #ifdef HAVE_ICU_CANONICALIZE
+	char buffer[FOLD_ASCII_BUFFER_SIZE];
+	if (const char *folded = FoldASCII(haystack, buffer))
+		return StringFind(folded, needle.c_str()) != nullptr;
+
 	return StringFind(IcuCanonicalize(haystack, true).c_str(),
 			  needle.c_str()) != nullptr;
 #elif defined(_WIN32)
@@ -102,6 +152,10 @@ bool
 IcuCompare::StartsWith(const char *haystack) const noexcept
 {
 #ifdef HAVE_ICU_CANONICALIZE
+	char buffer[FOLD_ASCII_BUFFER_SIZE];
+	if (const char *folded = FoldASCII(haystack, buffer))
+		return StringStartsWith(folded, needle);
+
 	return StringStartsWith(IcuCanonicalize(haystack, true).c_str(),
 				needle);
 #elif defined(_WIN32)
@@ -4,7 +4,10 @@
 #ifndef MPD_ICU_COMPARE_HXX
 #define MPD_ICU_COMPARE_HXX
 
+#include "Canonicalize.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
 
 #include <string_view>
 
@@ -59,6 +62,29 @@ public:
 
 	[[gnu::pure]]
 	bool StartsWith(const char *haystack) const noexcept;
+
+#ifdef HAVE_ICU_CANONICALIZE
+	/*
+	 * The following methods are like the ones above, but the
+	 * haystack has already been transformed with
+	 * IcuCanonicalize(haystack, true).
+	 */
+
+	[[gnu::pure]]
+	bool EqualsCanonical(const char *haystack) const noexcept {
+		return StringIsEqual(haystack, needle.c_str());
+	}
+
+	[[gnu::pure]]
+	bool IsInCanonical(const char *haystack) const noexcept {
+		return StringFind(haystack, needle.c_str()) != nullptr;
+	}
+
+	[[gnu::pure]]
+	bool StartsWithCanonical(const char *haystack) const noexcept {
+		return StringStartsWith(haystack, needle);
+	}
+#endif
 };
 
 #endif
@@ -6,13 +6,17 @@
 #include "event/Call.hxx"
 
 void
-BlockingNfsOperation::Run()
+BlockingNfsOperation::Launch()
 {
 	/* subscribe to the connection, which will invoke either
 	   OnNfsConnectionReady() or OnNfsConnectionFailed() */
 	BlockingCall(connection.GetEventLoop(),
 		    [this](){ connection.AddLease(*this); });
+}
 
+void
+BlockingNfsOperation::Wait()
+{
 	/* wait for completion */
 	if (!LockWaitFinished())
 		throw std::runtime_error("Timeout");
@@ -39,7 +39,33 @@ public:
 	/**
 	 * Throws std::runtime_error on error.
 	 */
-	void Run();
+	void Run() {
+		Launch();
+		Wait();
+	}
+
+	/**
+	 * Start the operation in the #EventLoop thread, but don't
+	 * wait for its completion.  Call Wait() later.
+	 */
+	void Launch();
+
+	/**
+	 * Wait for the completion of an operation started with
+	 * Launch().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Wait();
+
+	/**
+	 * Has the operation finished (successfully or not)?  If yes,
+	 * then Wait() will return immediately.
+	 */
+	bool LockIsFinished() noexcept {
+		const std::scoped_lock protect{mutex};
+		return finished;
+	}
 
 private:
 	bool LockWaitFinished() noexcept {
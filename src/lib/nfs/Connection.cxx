@@ -126,7 +126,13 @@ NfsConnection::CancellableCallback::PrepareDestroyContext() noexcept
 
 	if (close_fh != nullptr) {
 		connection.InternalClose(close_fh);
-		close_fh = nullptr;
+
+		/* other cancelled operations may refer to the same
+		   file handle; don't let them close it again */
+		connection.callbacks.ForEach([fh = close_fh](CancellableCallback &c){
+			if (c.close_fh == fh)
+				c.close_fh = nullptr;
+		});
 	}
 }
 
@@ -157,7 +163,10 @@ NfsConnection::CancellableCallback::Callback(int err, void *data) noexcept
 				auto *fh = (struct nfsfh *)data;
 				connection.Close(fh);
 			}
-		} else if (close_fh != nullptr)
+		} else if (close_fh != nullptr &&
+			   !connection.IsClosePending(*this, close_fh))
+			/* only the last of several cancelled
+			   operations on this file handle closes it */
 			connection.DeferClose(close_fh);
 
 		connection.callbacks.Remove(*this);
@@ -378,6 +387,24 @@ NfsConnection::Cancel(NfsCallback &callback,
 	cancel.CancelAndScheduleClose(fh, std::move(dispose_value));
 }
 
+bool
+NfsConnection::IsClosePending(const CancellableCallback &except,
+			      const struct nfsfh *fh) noexcept
+{
+	bool result = false;
+	callbacks.ForEach([&except, fh, &result](const CancellableCallback &c){
+		if (&c != &except && c.close_fh == fh)
+			result = true;
+	});
+	return result;
+}
+
+unsigned
+NfsConnection::GetReadMax() const noexcept
+{
+	return nfs_get_readmax(context);
+}
+
 static void
 DummyCallback(int, struct nfs_context *, void *, void *) noexcept
 {
@@ -48,6 +48,8 @@ class NfsConnection {
 		 */
 		DisposablePointer dispose_value;
 
+		friend class NfsConnection;
+
 	public:
 		explicit CancellableCallback(NfsCallback &_callback,
 					     NfsConnection &_connection,
@@ -224,9 +226,19 @@ public:
 #endif
 		  NfsCallback &callback);
 
+	/**
+	 * Returns the maximum size of one READ request (the "rsize")
+	 * which was negotiated with the server while mounting.
+	 * Larger reads are split by libnfs.
+	 */
+	[[gnu::pure]]
+	unsigned GetReadMax() const noexcept;
+
 	/**
 	 * Cancel the asynchronous operation associated with the
-	 * specified #NfsCallback.
+	 * specified #NfsCallback.  Several operations on the same
+	 * file handle may be cancelled with the same #fh; it will be
+	 * closed after the last one completes.
 	 *
 	 * After this method returns, the caller may delete the
 	 * #NfsCallback.
@@ -264,6 +276,14 @@ private:
 	 */
 	void DeferClose(struct nfsfh *fh) noexcept;
 
+	/**
+	 * Is there another cancelled operation (other than #except)
+	 * which will close the specified file handle?
+	 */
+	[[gnu::pure]]
+	bool IsClosePending(const CancellableCallback &except,
+			    const struct nfsfh *fh) noexcept;
+
 	void MountInternal();
 	void BroadcastMountSuccess() noexcept;
 	void BroadcastMountError(std::exception_ptr e) noexcept;
@@ -12,6 +12,7 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
@@ -75,21 +76,20 @@ NfsFileReader::CancelOrClose() noexcept
 	assert(state != State::INITIAL &&
 	       state != State::DEFER);
 
-	if (state == State::IDLE)
-		/* no async operation in progress: can close
-		   immediately */
-		connection->Close(fh);
-	else if (state > State::OPEN) {
+	if (state == State::IDLE) {
+		if (reads.empty())
+			/* no async operation in progress: can close
+			   immediately */
+			connection->Close(fh);
+		else
+			/* cancel all reads and defer the
+			   nfs_close_async() call */
+			CancelReads(fh);
+	} else if (state == State::STAT)
 		/* one async operation in progress: cancel it and
 		   defer the nfs_close_async() call */
-		DisposablePointer dispose_value{};
-
-#ifdef LIBNFS_API_2
-		dispose_value = ToDeleteArray(read_buffer.release());
-#endif
-
-		connection->Cancel(*this, fh, std::move(dispose_value));
-	} else if (state > State::MOUNT)
+		connection->Cancel(*this, fh, {});
+	else if (state > State::MOUNT)
 		/* we don't have a file handle yet - just cancel the
 		   async operation */
 		connection->Cancel(*this, nullptr, {});
@@ -140,37 +140,59 @@ NfsFileReader::Open(const char *uri)
 	defer_open.Schedule();
 }
 
+std::size_t
+NfsFileReader::GetReadMax() const noexcept
+{
+	assert(connection != nullptr);
+
+	return connection->GetReadMax();
+}
+
 void
 NfsFileReader::Read(uint64_t offset, size_t size)
 {
 	assert(state == State::IDLE);
 
+	auto &r = reads.emplace_back(*this, size);
+
+	try {
 #ifdef LIBNFS_API_2
-	assert(!read_buffer);
-	// TOOD read into caller-provided buffer
-	read_buffer = std::make_unique<std::byte[]>(size);
-	connection->Read(fh, offset, {read_buffer.get(), size}, *this);
+		// TOOD read into caller-provided buffer
+		r.buffer = std::make_unique<std::byte[]>(size);
+		connection->Read(fh, offset, {r.buffer.get(), size}, r);
 #else
-	connection->Read(fh, offset, size, *this);
+		connection->Read(fh, offset, size, r);
 #endif
-
-	state = State::READ;
+	} catch (...) {
+		reads.pop_back();
+		throw;
+	}
 }
 
 void
-NfsFileReader::CancelRead() noexcept
+NfsFileReader::CancelReads(nfsfh *close_fh) noexcept
 {
-	if (state == State::READ) {
+	for (auto &r : reads) {
+		if (r.done)
+			continue;
+
 		DisposablePointer dispose_value{};
 
 #ifdef LIBNFS_API_2
-		assert(read_buffer);
-		dispose_value = ToDeleteArray(read_buffer.release());
+		dispose_value = ToDeleteArray(r.buffer.release());
 #endif
 
-		connection->Cancel(*this, nullptr, std::move(dispose_value));
-		state = State::IDLE;
+		connection->Cancel(r, close_fh, std::move(dispose_value));
 	}
+
+	reads.clear();
+}
+
+void
+NfsFileReader::CancelRead() noexcept
+{
+	if (state == State::IDLE)
+		CancelReads(nullptr);
 }
 
 void
@@ -241,23 +263,91 @@ NfsFileReader::StatCallback(const struct nfs_stat_64 *st) noexcept
 	OnNfsFileOpen(st->nfs_size);
 }
 
+void
+NfsFileReader::FlushReads() noexcept
+{
+	while (!reads.empty() && reads.front().done) {
+		auto &r = reads.front();
+		const auto buffer = std::move(r.buffer);
+		const std::size_t nbytes = r.size;
+		reads.pop_front();
+
+		if (!reads.empty() && nbytes < reads.front().size)
+			/* short read: the following requests are
+			   at the wrong offset; let the caller
+			   submit new ones */
+			CancelReads(nullptr);
+
+		OnNfsFileRead({buffer.get(), nbytes});
+	}
+}
+
 inline void
-NfsFileReader::ReadCallback(std::size_t nbytes, const void *data) noexcept
+NfsFileReader::ReadCallback(ReadRequest &r, std::size_t nbytes,
+			    const void *data) noexcept
 {
+	assert(state == State::IDLE);
+	assert(!r.done);
+	assert(nbytes <= r.size);
+
 #ifdef LIBNFS_API_2
 	(void)data;
+#else
+	if (&r == &reads.front()) {
+		/* fast path: this is the oldest request, deliver
+		   it without copying */
+		const bool short_read = nbytes < r.size;
+		reads.pop_front();
 
-	assert(read_buffer);
-	const auto buffer = std::move(read_buffer);
+		if (short_read)
+			CancelReads(nullptr);
 
-	OnNfsFileRead({buffer.get(), nbytes});
-#else
-	OnNfsFileRead({static_cast<const std::byte *>(data), nbytes});
+		OnNfsFileRead({static_cast<const std::byte *>(data), nbytes});
+		FlushReads();
+		return;
+	}
+
+	/* a preceding request is still pending; keep a copy until
+	   it completes */
+	r.buffer = std::make_unique<std::byte[]>(nbytes);
+	std::copy_n(static_cast<const std::byte *>(data), nbytes,
+		    r.buffer.get());
 #endif
+
+	r.size = nbytes;
+	r.done = true;
+
+	FlushReads();
+}
+
+inline void
+NfsFileReader::ReadError(ReadRequest &r, std::exception_ptr &&e) noexcept
+{
+	assert(state == State::IDLE);
+	assert(!r.done);
+
+	/* the failed request has already been removed from the
+	   connection; cancel all others and discard their data */
+	r.done = true;
+	CancelReads(nullptr);
+
+	OnNfsFileError(std::move(e));
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsCallback(unsigned status, void *data) noexcept
+{
+	reader.ReadCallback(*this, static_cast<std::size_t>(status), data);
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
+NfsFileReader::ReadRequest::OnNfsError(std::exception_ptr &&e) noexcept
+{
+	reader.ReadError(*this, std::move(e));
+}
+
+void
+NfsFileReader::OnNfsCallback([[maybe_unused]] unsigned status, void *data) noexcept
 {
 	switch (std::exchange(state, State::IDLE)) {
 	case State::INITIAL:
@@ -274,10 +364,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
 	case State::STAT:
 		StatCallback((const struct nfs_stat_64 *)data);
 		break;
-
-	case State::READ:
-		ReadCallback(static_cast<std::size_t>(status), data);
-		break;
 	}
 }
 
@@ -302,10 +388,6 @@ NfsFileReader::OnNfsError(std::exception_ptr &&e) noexcept
 		connection->Close(fh);
 		state = State::INITIAL;
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		break;
 	}
 
 	OnNfsFileError(std::move(e));
@@ -11,13 +11,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <list>
+#include <memory>
 #include <span>
 #include <string>
 
-#ifdef LIBNFS_API_2
-#include <memory>
-#endif
-
 struct nfsfh;
 struct nfs_stat_64;
 class NfsConnection;
@@ -37,10 +35,41 @@ class NfsFileReader : NfsLease, NfsCallback {
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
+	/**
+	 * One READ operation.  Each has its own #NfsCallback, which
+	 * allows several of them to be in flight at the same time.
+	 */
+	class ReadRequest final : public NfsCallback {
+		NfsFileReader &reader;
+
+	public:
+		/**
+		 * The destination buffer (with #LIBNFS_API_2) or a
+		 * copy of the data if it was received before a
+		 * preceding request completed.
+		 */
+		std::unique_ptr<std::byte[]> buffer;
+
+		/**
+		 * The number of bytes requested; after completion,
+		 * the number of bytes received.
+		 */
+		std::size_t size;
+
+		bool done = false;
+
+		ReadRequest(NfsFileReader &_reader, std::size_t _size) noexcept
+			:reader(_reader), size(_size) {}
+
+	private:
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) noexcept override;
+		void OnNfsError(std::exception_ptr &&e) noexcept override;
+	};
+
 	State state = State::INITIAL;
 
 	std::string server, export_name, path;
@@ -54,9 +83,11 @@ class NfsFileReader : NfsLease, NfsCallback {
 	 */
 	InjectEvent defer_open;
 
-#ifdef LIBNFS_API_2
-	std::unique_ptr<std::byte[]> read_buffer;
-#endif
+	/**
+	 * The READ operations in flight, in the order they were
+	 * submitted.  Their results are delivered in this order.
+	 */
+	std::list<ReadRequest> reads;
 
 public:
 	NfsFileReader() noexcept;
@@ -83,8 +114,10 @@ public:
 
 	/**
 	 * Attempt to read from the file.  This may only be done after
-	 * OnNfsFileOpen() has been called.  Only one read operation
-	 * may be performed at a time.
+	 * OnNfsFileOpen() has been called.  Several read operations
+	 * may be in flight at a time (see GetPendingReads()); their
+	 * results are passed to OnNfsFileRead() in the order they
+	 * were submitted.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
@@ -94,7 +127,7 @@ public:
 	void Read(uint64_t offset, size_t size);
 
 	/**
-	 * Cancel the most recent Read() call.
+	 * Cancel all pending Read() calls.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
@@ -102,9 +135,25 @@ public:
 	void CancelRead() noexcept;
 
 	bool IsIdle() const noexcept {
-		return state == State::IDLE;
+		return state == State::IDLE && reads.empty();
 	}
 
+	/**
+	 * Returns the number of Read() calls which have not yet
+	 * completed.
+	 */
+	std::size_t GetPendingReads() const noexcept {
+		return reads.size();
+	}
+
+	/**
+	 * Returns the maximum size of one READ request negotiated
+	 * with the server.  This may only be called after
+	 * OnNfsFileOpen().
+	 */
+	[[gnu::pure]]
+	std::size_t GetReadMax() const noexcept;
+
 protected:
 	/**
 	 * The file has been opened successfully.  It is a regular
@@ -116,7 +165,8 @@ protected:
 	virtual void OnNfsFileOpen(uint64_t size) noexcept = 0;
 
 	/**
-	 * A Read() has completed successfully.
+	 * A Read() has completed successfully.  The reader may
+	 * submit more Read() calls from within this method.
 	 *
 	 * This method will be called from within the I/O thread.
 	 */
@@ -136,9 +186,25 @@ private:
 	 */
 	void CancelOrClose() noexcept;
 
+	/**
+	 * Cancel all pending reads.
+	 *
+	 * @param close_fh if not nullptr, then close this file
+	 * handle after all cancelled reads have completed
+	 */
+	void CancelReads(nfsfh *close_fh) noexcept;
+
+	/**
+	 * Deliver completed reads at the front of the #reads list to
+	 * OnNfsFileRead().
+	 */
+	void FlushReads() noexcept;
+
 	void OpenCallback(nfsfh *_fh) noexcept;
 	void StatCallback(const struct nfs_stat_64 *st) noexcept;
-	void ReadCallback(std::size_t nbytes, const void *data) noexcept;
+	void ReadCallback(ReadRequest &r, std::size_t nbytes,
+			  const void *data) noexcept;
+	void ReadError(ReadRequest &r, std::exception_ptr &&e) noexcept;
 
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() noexcept final;
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <mk@cm4all.com>
+
+#include "RegexPointer.hxx"
+
+#include <memory>
+
+namespace {
+
+struct MatchDataDeleter {
+	void operator()(pcre2_match_data_8 *match_data) const noexcept {
+		pcre2_match_data_free_8(match_data);
+	}
+};
+
+} // anonymous namespace
+
+bool
+RegexPointer::Test(std::string_view s) const noexcept
+{
+	/* one ovector pair is enough because we don't look at the
+	   captures; if there are more, pcre2_match() returns 0,
+	   which still means "match" */
+	static thread_local const std::unique_ptr<pcre2_match_data_8, MatchDataDeleter>
+		match_data{pcre2_match_data_create_8(1, nullptr)};
+
+	if (!match_data)
+		/* out of memory */
+		return Match(s);
+
+	return pcre2_match_8(re, (PCRE2_SPTR8)s.data(), s.size(),
+			     0, 0, match_data.get(), nullptr) >= 0;
+}
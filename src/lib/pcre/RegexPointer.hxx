@@ -46,4 +46,12 @@ public:
 
 		return match_data;
 	}
+
+	/**
+	 * Like Match(), but only check whether the string matches.
+	 * This reuses a per-thread #pcre2_match_data object instead
+	 * of allocating a new one for each call.
+	 */
+	[[gnu::pure]]
+	bool Test(std::string_view s) const noexcept;
 };
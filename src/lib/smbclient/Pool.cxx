@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Pool.hxx"
+
+SmbclientContextPool::Lease
+SmbclientContextPool::Get()
+{
+	{
+		const std::scoped_lock protect{mutex};
+		if (!idle.empty()) {
+			Lease lease{*this, std::move(idle.front())};
+			idle.pop_front();
+			--n_idle;
+			return lease;
+		}
+	}
+
+	return {*this, SmbclientContext::New()};
+}
+
+void
+SmbclientContextPool::Put(SmbclientContext &&ctx) noexcept
+{
+	{
+		const std::scoped_lock protect{mutex};
+		if (n_idle < max_idle) {
+			idle.push_front(std::move(ctx));
+			++n_idle;
+			return;
+		}
+	}
+
+	/* the pool is full: the context is freed by the caller's
+	   destructor (outside of the lock) */
+}
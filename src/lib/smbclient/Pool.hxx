@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_SMBCLIENT_POOL_HXX
+#define MPD_SMBCLIENT_POOL_HXX
+
+#include "Context.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstddef>
+#include <forward_list>
+#include <utility>
+
+/**
+ * A pool of idle #SmbclientContext instances.  Each caller gets a
+ * context of its own, so concurrent SMB operations do not need to
+ * be serialized, and returning the context to the pool allows the
+ * next caller to reuse its server connections.
+ *
+ * Callers are never blocked when all contexts are in use (a new one
+ * is created), because one thread may need several at a time, e.g.
+ * for nested input streams; only the number of idle contexts is
+ * limited.
+ *
+ * This class is thread-safe.
+ */
+class SmbclientContextPool {
+	Mutex mutex;
+
+	std::forward_list<SmbclientContext> idle;
+
+	std::size_t n_idle = 0;
+
+	const std::size_t max_idle;
+
+public:
+	/**
+	 * A #SmbclientContext borrowed from the pool.  It is returned
+	 * to the pool by the destructor.
+	 */
+	class Lease {
+		SmbclientContextPool *pool = nullptr;
+
+		SmbclientContext ctx;
+
+	public:
+		Lease() noexcept = default;
+
+		Lease(SmbclientContextPool &_pool,
+		      SmbclientContext &&_ctx) noexcept
+			:pool(&_pool), ctx(std::move(_ctx)) {}
+
+		Lease(Lease &&src) noexcept
+			:pool(std::exchange(src.pool, nullptr)),
+			 ctx(std::move(src.ctx)) {}
+
+		~Lease() noexcept {
+			if (pool != nullptr)
+				pool->Put(std::move(ctx));
+		}
+
+		Lease &operator=(Lease &&src) noexcept {
+			using std::swap;
+			swap(pool, src.pool);
+			swap(ctx, src.ctx);
+			return *this;
+		}
+
+		/**
+		 * Don't return this context to the pool, because it
+		 * may be in a bad state (e.g. after a connection
+		 * error); it will be freed instead.
+		 */
+		void Discard() noexcept {
+			pool = nullptr;
+		}
+
+		SmbclientContext &operator*() noexcept {
+			return ctx;
+		}
+
+		SmbclientContext *operator->() noexcept {
+			return &ctx;
+		}
+	};
+
+	explicit SmbclientContextPool(std::size_t _max_idle) noexcept
+		:max_idle(_max_idle) {}
+
+	SmbclientContextPool(const SmbclientContextPool &) = delete;
+	SmbclientContextPool &operator=(const SmbclientContextPool &) = delete;
+
+	/**
+	 * Borrow an idle context or create a new one.
+	 *
+	 * Throws on error.
+	 */
+	Lease Get();
+
+private:
+	void Put(SmbclientContext &&ctx) noexcept;
+};
+
+#endif
@@ -11,6 +11,7 @@
 class UPnPDevice;
 struct UPnPService;
 class UPnPDirContent;
+class WorkerPool;
 
 /**
  * Content Directory Service class.
@@ -58,6 +59,22 @@ public:
 	UPnPDirContent readDir(UpnpClient_Handle handle,
 			       const char *objectId) const;
 
+	/**
+	 * Like readDir(), but with a caller-specified slice size, and
+	 * optionally fetching the slices concurrently: after the
+	 * first slice has revealed the number of children, all
+	 * remaining slices are submitted to the #WorkerPool at once.
+	 *
+	 * @param count the number of entries per slice; 0 means the
+	 * device-specific default
+	 * @param pool the #WorkerPool for the remaining slices or
+	 * nullptr to read them sequentially; must not be the pool
+	 * this method is called from
+	 */
+	UPnPDirContent readDir(UpnpClient_Handle handle,
+			       const char *objectId,
+			       unsigned count, WorkerPool *pool) const;
+
 	void readDirSlice(UpnpClient_Handle handle,
 			  const char *objectId, unsigned offset,
 			  unsigned count, UPnPDirContent& dirbuf,
@@ -17,12 +17,19 @@
 
 #include <upnptools.h>
 
+#include <algorithm>
+
 #include <stdlib.h>
 
 class UPnPDeviceDirectory::ContentDirectoryDescriptor {
 public:
 	UPnPDevice device;
 
+	/**
+	 * The URL of the device description.
+	 */
+	std::string location;
+
 	/**
 	 * The time stamp when this device expires.
 	 */
@@ -32,7 +39,13 @@ public:
 				   std::chrono::steady_clock::duration exp) noexcept
 		:expires(last + exp + std::chrono::seconds(20)) {}
 
+	void Refresh(std::chrono::steady_clock::time_point last,
+		     std::chrono::steady_clock::duration exp) noexcept {
+		expires = std::max(expires, last + exp + std::chrono::seconds(20));
+	}
+
 	void Parse(std::string_view url, std::string_view description) {
+		location = url;
 		device.Parse(url, description);
 	}
 };
@@ -56,6 +69,10 @@ public:
 	Downloader(UPnPDeviceDirectory &_parent,
 		   const UpnpDiscovery &disco);
 
+	const std::string &GetId() const noexcept {
+		return id;
+	}
+
 	void Start() noexcept {
 		defer_start_event.Schedule();
 	}
@@ -186,12 +203,50 @@ AnnounceLostUPnP(UPnPDiscoveryListener &listener, const UPnPDevice &device) noex
 								  service));
 }
 
+inline bool
+UPnPDeviceDirectory::LockRefresh(std::string_view id, std::string_view location,
+				 std::chrono::steady_clock::duration expires) noexcept
+{
+	const std::scoped_lock protect{mutex};
+
+	if (auto i = directories.find(id); i != directories.end()) {
+		if (i->second.location != location)
+			/* the device has moved; download its new
+			   description */
+			return false;
+
+		i->second.Refresh(std::chrono::steady_clock::now(), expires);
+		return true;
+	}
+
+	/* devices send several "alive" notifications at a time (and
+	   answer both searches); download only once */
+	for (const auto &i : downloaders)
+		if (i.GetId() == id)
+			return true;
+
+	return false;
+}
+
 inline void
 UPnPDeviceDirectory::LockAdd(std::string &&id, ContentDirectoryDescriptor &&d) noexcept
 {
 	const std::scoped_lock protect{mutex};
 
-	const auto i = directories.insert_or_assign(std::move(id), std::move(d)).first;
+	auto i = directories.find(id);
+	if (i != directories.end()) {
+		/* the device has moved to a new description
+		   URL: replace it */
+		if (listener != nullptr) {
+			AnnounceLostUPnP(*listener, i->second.device);
+			AnnounceFoundUPnP(*listener, d.device);
+		}
+
+		i->second = std::move(d);
+		return;
+	}
+
+	i = directories.emplace(std::move(id), std::move(d)).first;
 
 	if (listener != nullptr)
 		AnnounceFoundUPnP(*listener, i->second.device);
@@ -215,6 +270,11 @@ UPnPDeviceDirectory::OnAlive(const UpnpDiscovery *disco) noexcept
 {
 	if (isMSDevice(UpnpDiscovery_get_DeviceType_cstr(disco)) ||
 	    isCDService(UpnpDiscovery_get_ServiceType_cstr(disco))) {
+		if (LockRefresh(UpnpDiscovery_get_DeviceID_cstr(disco),
+				UpnpDiscovery_get_Location_cstr(disco),
+				std::chrono::seconds(UpnpDiscovery_get_Expires(disco))))
+			return UPNP_E_SUCCESS;
+
 		try {
 			auto *downloader = new Downloader(*this, *disco);
 			downloader->Start();
@@ -274,16 +334,25 @@ UPnPDeviceDirectory::ExpireDevices() noexcept
 	const auto now = std::chrono::steady_clock::now();
 	bool didsomething = false;
 
-	std::erase_if(directories, [now, &didsomething](const auto &i){
+	std::erase_if(directories, [this, now, &didsomething](const auto &i){
 		const auto &d = i.second;
 		bool expired = now > d.expires;
-		if (expired)
+		if (expired) {
 			didsomething = true;
+
+			if (listener != nullptr)
+				AnnounceLostUPnP(*listener, d.device);
+		}
 		return expired;
 	});
 
-	if (didsomething)
-		Search();
+	if (didsomething) {
+		try {
+			Search();
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
 }
 
 UPnPDeviceDirectory::UPnPDeviceDirectory(EventLoop &event_loop,
@@ -90,13 +90,25 @@ private:
 
 	/**
 	 * Look at the devices and get rid of those which have not
-	 * been seen for too long. We do this when listing the top
-	 * directory.
+	 * been seen for too long (and tell the listener). We do this
+	 * when listing the top directory.
 	 *
 	 * Caller must lock #mutex.
 	 */
 	void ExpireDevices() noexcept;
 
+	/**
+	 * Handle an "alive" notification of a device which is
+	 * already known (or whose description is being downloaded
+	 * already): extend its expiry time, so the description does
+	 * not need to be downloaded (and parsed) again.
+	 *
+	 * @return true if the device is known, false if the
+	 * description needs to be downloaded
+	 */
+	bool LockRefresh(std::string_view id, std::string_view location,
+			 std::chrono::steady_clock::duration expires) noexcept;
+
 	void LockAdd(std::string &&id, ContentDirectoryDescriptor &&d) noexcept;
 	void LockRemove(std::string_view id) noexcept;
 
@@ -59,6 +59,15 @@ public:
 		return ogg_stream_pageout(&state, &page) != 0;
 	}
 
+	/**
+	 * Like PageOut(), but collect at least the given number of
+	 * body bytes in one page (instead of the libogg default of
+	 * approximately 4 kB).
+	 */
+	bool PageOut(ogg_page &page, int fill) noexcept {
+		return ogg_stream_pageout_fill(&state, &page, fill) != 0;
+	}
+
 	bool Flush(ogg_page &page) noexcept {
 		return ogg_stream_flush(&state, &page) != 0;
 	}
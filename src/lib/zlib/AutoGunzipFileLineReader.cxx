@@ -4,7 +4,7 @@
 #include "AutoGunzipFileLineReader.hxx"
 #include "io/FileReader.hxx"
 #include "io/BufferedReader.hxx"
-#include "lib/zlib/AutoGunzipReader.hxx"
+#include "ThreadedGunzipReader.hxx"
 #include "fs/Path.hxx"
 
 #include <cassert>
@@ -12,7 +12,7 @@
 AutoGunzipFileLineReader::AutoGunzipFileLineReader(Path path_fs)
 	:file_reader(std::make_unique<FileReader>(path_fs)),
 #ifdef ENABLE_ZLIB
-	 gunzip_reader(std::make_unique<AutoGunzipReader>(*file_reader)),
+	 gunzip_reader(std::make_unique<ThreadedGunzipReader>(*file_reader)),
 #endif
 	 buffered_reader(std::make_unique<BufferedReader>(*
 #ifdef ENABLE_ZLIB
@@ -13,13 +13,19 @@
 
 class Path;
 class FileReader;
-class AutoGunzipReader;
+class ThreadedGunzipReader;
 class BufferedReader;
 
+/**
+ * Reads lines from a file which may be gzip-compressed.  The file is
+ * decompressed in a separate thread (see #ThreadedGunzipReader), so
+ * the caller can parse lines while the next buffers are being
+ * decompressed.
+ */
 class AutoGunzipFileLineReader final : public LineReader {
 	const std::unique_ptr<FileReader> file_reader;
 
-	const std::unique_ptr<AutoGunzipReader> gunzip_reader;
+	const std::unique_ptr<ThreadedGunzipReader> gunzip_reader;
 
 	const std::unique_ptr<BufferedReader> buffered_reader;
 
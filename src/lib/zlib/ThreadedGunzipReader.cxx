@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ThreadedGunzipReader.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+
+ThreadedGunzipReader::ThreadedGunzipReader(Reader &_next)
+	:gunzip(_next)
+{
+	thread.Start();
+}
+
+ThreadedGunzipReader::~ThreadedGunzipReader() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+		cond.notify_all();
+	}
+
+	thread.Join();
+}
+
+std::size_t
+ThreadedGunzipReader::Read(std::span<std::byte> dest)
+{
+	if (position >= current.size()) {
+		std::unique_lock lock{mutex};
+
+		if (!current.empty()) {
+			spare.emplace_back(std::move(current));
+			current.clear();
+		}
+
+		position = 0;
+
+		cond.wait(lock, [this]{
+			return eof || !filled.empty();
+		});
+
+		if (filled.empty()) {
+			if (error)
+				std::rethrow_exception(error);
+
+			return 0;
+		}
+
+		current = std::move(filled.front());
+		filled.pop_front();
+
+		/* there is room for another buffer */
+		cond.notify_all();
+	}
+
+	const std::size_t nbytes = std::min(dest.size(),
+					    current.size() - position);
+	std::copy_n(current.begin() + position, nbytes, dest.begin());
+	position += nbytes;
+	return nbytes;
+}
+
+inline std::size_t
+ThreadedGunzipReader::FillBuffer(std::span<std::byte> dest)
+{
+	std::size_t fill = 0;
+
+	while (fill < dest.size()) {
+		const std::size_t nbytes = gunzip.Read(dest.subspan(fill));
+		if (nbytes == 0)
+			break;
+
+		fill += nbytes;
+	}
+
+	return fill;
+}
+
+void
+ThreadedGunzipReader::Run() noexcept
+{
+	SetThreadName("gunzip");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		cond.wait(lock, [this]{
+			return quit || filled.size() < MAX_FILLED;
+		});
+
+		if (quit)
+			break;
+
+		std::vector<std::byte> buffer;
+		if (!spare.empty()) {
+			buffer = std::move(spare.back());
+			spare.pop_back();
+		}
+
+		buffer.resize(BUFFER_SIZE);
+
+		std::size_t nbytes;
+		std::exception_ptr read_error;
+
+		{
+			const ScopeUnlock unlock{mutex};
+
+			try {
+				nbytes = FillBuffer(buffer);
+			} catch (...) {
+				nbytes = 0;
+				read_error = std::current_exception();
+			}
+		}
+
+		if (nbytes > 0) {
+			buffer.resize(nbytes);
+			filled.emplace_back(std::move(buffer));
+		}
+
+		if (read_error || nbytes < BUFFER_SIZE) {
+			/* end of stream */
+			error = std::move(read_error);
+			eof = true;
+		}
+
+		cond.notify_all();
+
+		if (eof)
+			break;
+	}
+}
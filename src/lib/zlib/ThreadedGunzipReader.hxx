@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "AutoGunzipReader.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <vector>
+
+/**
+ * A #Reader which runs an #AutoGunzipReader in a separate thread, so
+ * decompressing the next buffers overlaps with parsing the current
+ * one.  The number of buffers decompressed ahead is bounded.
+ */
+class ThreadedGunzipReader final : public Reader {
+	static constexpr std::size_t BUFFER_SIZE = 256 * 1024;
+
+	/**
+	 * The maximum number of buffers in #filled.
+	 */
+	static constexpr std::size_t MAX_FILLED = 4;
+
+	AutoGunzipReader gunzip;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by both threads whenever #filled, #eof or #quit
+	 * changes.
+	 */
+	Cond cond;
+
+	/**
+	 * Decompressed buffers which have not yet been passed to
+	 * Read().  Protected by #mutex.
+	 */
+	std::deque<std::vector<std::byte>> filled;
+
+	/**
+	 * Buffers which have been consumed by Read() and may be
+	 * reused by the decompressor thread.  Protected by #mutex.
+	 */
+	std::vector<std::vector<std::byte>> spare;
+
+	/**
+	 * The error which has occurred in the decompressor thread.
+	 * Protected by #mutex.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Has the decompressor thread finished (end of stream or
+	 * error)?  Protected by #mutex.
+	 */
+	bool eof = false;
+
+	/**
+	 * Shall the decompressor thread exit?  Protected by #mutex.
+	 */
+	bool quit = false;
+
+	/**
+	 * The buffer currently being consumed by Read().  Only
+	 * accessed by the reading thread.
+	 */
+	std::vector<std::byte> current;
+	std::size_t position = 0;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit ThreadedGunzipReader(Reader &_next);
+	~ThreadedGunzipReader() noexcept;
+
+	/* virtual methods from class Reader */
+	std::size_t Read(std::span<std::byte> dest) override;
+
+private:
+	/**
+	 * Fill the given buffer completely, unless the end of the
+	 * stream is reached.
+	 *
+	 * @return the number of bytes read
+	 */
+	std::size_t FillBuffer(std::span<std::byte> dest);
+
+	void Run() noexcept;
+};
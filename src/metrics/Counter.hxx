@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_METRICS_COUNTER_HXX
+#define MPD_METRICS_COUNTER_HXX
+
+#include "Shard.hxx"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * A monotonic counter which can be incremented cheaply by many
+ * threads.
+ */
+class ShardedCounter {
+	struct alignas(METRICS_SHARD_ALIGN) Shard {
+		std::atomic<uint_least64_t> value{0};
+	};
+
+	std::array<Shard, N_METRICS_SHARDS> shards;
+
+public:
+	void Add(uint_least64_t n) noexcept {
+		shards[GetMetricsShard()].value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	[[gnu::pure]]
+	uint_least64_t Load() const noexcept {
+		uint_least64_t result = 0;
+		for (const auto &shard : shards)
+			result += shard.value.load(std::memory_order_relaxed);
+		return result;
+	}
+};
+
+#endif
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_METRICS_HISTOGRAM_HXX
+#define MPD_METRICS_HISTOGRAM_HXX
+
+#include "Shard.hxx"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * A histogram of durations with fixed buckets, which can be updated
+ * cheaply by many threads.
+ */
+class LatencyHistogram {
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The upper bounds of the buckets (inclusive); there is an
+	 * implicit "+Inf" bucket after the last one.
+	 */
+	static constexpr std::array<Duration, 6> bounds{
+		std::chrono::microseconds{100},
+		std::chrono::milliseconds{1},
+		std::chrono::milliseconds{10},
+		std::chrono::milliseconds{100},
+		std::chrono::seconds{1},
+		std::chrono::seconds{10},
+	};
+
+	static constexpr std::size_t N_BUCKETS = bounds.size() + 1;
+
+	struct Snapshot {
+		/**
+		 * The number of observations in each bucket
+		 * (cumulative, i.e. each bucket includes all previous
+		 * ones).
+		 */
+		std::array<uint_least64_t, N_BUCKETS> buckets{};
+
+		/**
+		 * The sum of all observations.
+		 */
+		Duration sum{};
+
+		uint_least64_t GetCount() const noexcept {
+			return buckets.back();
+		}
+	};
+
+private:
+	/* the bucket counters and the sum fill exactly one cache
+	   line per shard */
+	struct alignas(METRICS_SHARD_ALIGN) Shard {
+		std::array<std::atomic<uint_least64_t>, N_BUCKETS> buckets{};
+		std::atomic<Duration::rep> sum{0};
+	};
+
+	std::array<Shard, N_METRICS_SHARDS> shards;
+
+public:
+	void Add(Duration d) noexcept {
+		std::size_t i = 0;
+		while (i < bounds.size() && d > bounds[i])
+			++i;
+
+		auto &shard = shards[GetMetricsShard()];
+		shard.buckets[i].fetch_add(1, std::memory_order_relaxed);
+		shard.sum.fetch_add(d.count(), std::memory_order_relaxed);
+	}
+
+	[[gnu::pure]]
+	Snapshot Load() const noexcept {
+		Snapshot result;
+
+		for (const auto &shard : shards) {
+			for (std::size_t i = 0; i < N_BUCKETS; ++i)
+				result.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+			result.sum += Duration{shard.sum.load(std::memory_order_relaxed)};
+		}
+
+		for (std::size_t i = 1; i < N_BUCKETS; ++i)
+			result.buckets[i] += result.buckets[i - 1];
+
+		return result;
+	}
+};
+
+#endif
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Prometheus.hxx"
+#include "Partition.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "output/Control.hxx"
+#include "io/BufferedOutputStream.hxx"
+
+#include <fmt/format.h>
+
+std::string
+EscapeLabelValue(std::string_view src) noexcept
+{
+	std::string result;
+	result.reserve(src.size());
+
+	for (const char ch : src) {
+		switch (ch) {
+		case '\\':
+			result += "\\\\";
+			break;
+
+		case '"':
+			result += "\\\"";
+			break;
+
+		case '\n':
+			result += "\\n";
+			break;
+
+		default:
+			result += ch;
+		}
+	}
+
+	return result;
+}
+
+void
+WriteMetricHeader(BufferedOutputStream &os, const char *name,
+		  const char *type, const char *help)
+{
+	os.Fmt("# HELP {} {}\n"
+	       "# TYPE {} {}\n",
+	       name, help,
+	       name, type);
+}
+
+void
+WriteSimpleMetric(BufferedOutputStream &os, const char *name,
+		  const char *type, const char *help, double value)
+{
+	WriteMetricHeader(os, name, type, help);
+	os.Fmt("{} {}\n", name, value);
+}
+
+void
+WriteHistogram(BufferedOutputStream &os, const char *name,
+	       std::string_view labels,
+	       const LatencyHistogram::Snapshot &snapshot)
+{
+	const std::string_view separator = labels.empty() ? "" : ",";
+
+	for (std::size_t i = 0; i < LatencyHistogram::bounds.size(); ++i)
+		os.Fmt("{}_bucket{{{}{}le=\"{}\"}} {}\n",
+		       name, labels, separator,
+		       DurationToSeconds(LatencyHistogram::bounds[i]),
+		       snapshot.buckets[i]);
+
+	os.Fmt("{}_bucket{{{}{}le=\"+Inf\"}} {}\n",
+	       name, labels, separator, snapshot.GetCount());
+
+	if (labels.empty()) {
+		os.Fmt("{}_sum {}\n", name, DurationToSeconds(snapshot.sum));
+		os.Fmt("{}_count {}\n", name, snapshot.GetCount());
+	} else {
+		os.Fmt("{}_sum{{{}}} {}\n", name, labels,
+		       DurationToSeconds(snapshot.sum));
+		os.Fmt("{}_count{{{}}} {}\n", name, labels,
+		       snapshot.GetCount());
+	}
+}
+
+static constexpr struct {
+	const char *name;
+	const char *type;
+	const char *help;
+	double (*get)(const AudioOutputStats &stats) noexcept;
+} output_metrics[] = {
+	{ "mpd_output_played_bytes_total", "counter",
+	  "Number of bytes passed to the output plugin",
+	  [](const AudioOutputStats &stats) noexcept -> double {
+		  return stats.played_bytes;
+	  } },
+	{ "mpd_output_device_underruns_total", "counter",
+	  "Number of buffer underruns reported by the device",
+	  [](const AudioOutputStats &stats) noexcept -> double {
+		  return stats.device_underruns;
+	  } },
+	{ "mpd_output_pipe_underruns_total", "counter",
+	  "Number of times the output had to wait for decoded data",
+	  [](const AudioOutputStats &stats) noexcept -> double {
+		  return stats.pipe_underruns;
+	  } },
+	{ "mpd_output_play_seconds_total", "counter",
+	  "Time spent in the output plugin's play method",
+	  [](const AudioOutputStats &stats) noexcept {
+		  return DurationToSeconds(stats.play_time);
+	  } },
+	{ "mpd_output_pipe_wait_seconds_total", "counter",
+	  "Time spent waiting for decoded data",
+	  [](const AudioOutputStats &stats) noexcept {
+		  return DurationToSeconds(stats.pipe_wait_time);
+	  } },
+	{ "mpd_output_filter_seconds_total", "counter",
+	  "Time spent running filters",
+	  [](const AudioOutputStats &stats) noexcept {
+		  return DurationToSeconds(stats.filter_time);
+	  } },
+	{ "mpd_output_buffered_seconds", "gauge",
+	  "Duration of the data buffered by the device",
+	  [](const AudioOutputStats &stats) noexcept {
+		  return DurationToSeconds(stats.buffered);
+	  } },
+	{ "mpd_output_buffered_min_seconds", "gauge",
+	  "Minimum duration of the data buffered by the device since the output was opened",
+	  [](const AudioOutputStats &stats) noexcept {
+		  return DurationToSeconds(stats.buffered_min);
+	  } },
+};
+
+void
+WriteOutputMetrics(BufferedOutputStream &os,
+		   const std::list<Partition> &partitions)
+{
+	for (const auto &metric : output_metrics) {
+		WriteMetricHeader(os, metric.name, metric.type, metric.help);
+
+		for (const auto &partition : partitions) {
+			const auto partition_label =
+				EscapeLabelValue(partition.name);
+
+			const auto &outputs = partition.outputs;
+			for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+				const auto &ao = outputs.Get(i);
+				if (ao.IsDummy())
+					continue;
+
+				os.Fmt("{}{{partition=\"{}\",output=\"{}\",plugin=\"{}\"}} {}\n",
+				       metric.name, partition_label,
+				       EscapeLabelValue(ao.GetName()),
+				       ao.GetPluginName(),
+				       metric.get(ao.LockGetStats()));
+			}
+		}
+	}
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_METRICS_PROMETHEUS_HXX
+#define MPD_METRICS_PROMETHEUS_HXX
+
+#include "Histogram.hxx"
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <string_view>
+
+struct Partition;
+class BufferedOutputStream;
+
+/*
+ * Helpers for the Prometheus text exposition format.
+ */
+
+/**
+ * Escape a Prometheus label value.
+ */
+std::string
+EscapeLabelValue(std::string_view src) noexcept;
+
+constexpr double
+DurationToSeconds(std::chrono::steady_clock::duration d) noexcept
+{
+	return std::chrono::duration<double>(d).count();
+}
+
+void
+WriteMetricHeader(BufferedOutputStream &os, const char *name,
+		  const char *type, const char *help);
+
+/**
+ * Write a metric which consists of just one sample without labels.
+ */
+void
+WriteSimpleMetric(BufferedOutputStream &os, const char *name,
+		  const char *type, const char *help, double value);
+
+/**
+ * Write the samples of a histogram.
+ *
+ * @param labels a (possibly empty) comma-separated list of labels
+ * which is added to each sample
+ */
+void
+WriteHistogram(BufferedOutputStream &os, const char *name,
+	       std::string_view labels,
+	       const LatencyHistogram::Snapshot &snapshot);
+
+/**
+ * Write the #AudioOutputStats of all outputs.
+ */
+void
+WriteOutputMetrics(BufferedOutputStream &os,
+		   const std::list<Partition> &partitions);
+
+#endif
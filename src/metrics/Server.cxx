@@ -0,0 +1,319 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include "Server.hxx"
+#include "Counter.hxx"
+#include "Prometheus.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "player/Control.hxx"
+#include "decoder/Metrics.hxx"
+#include "command/AllCommands.hxx"
+#include "input/cache/Manager.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/SocketAddress.hxx"
+#include "io/OutputStream.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+#include <fmt/format.h>
+
+#include <string>
+#include <string_view>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * How often is the event loop lag measured?
+ */
+static constexpr Event::Duration LAG_INTERVAL = std::chrono::seconds{1};
+
+/**
+ * Don't buffer more than this many bytes of the request header.
+ */
+static constexpr std::size_t MAX_REQUEST_SIZE = 4096;
+
+/**
+ * An #OutputStream which appends to a std::string.
+ */
+class StringOutputStream final : public OutputStream {
+	std::string &value;
+
+public:
+	explicit StringOutputStream(std::string &_value) noexcept
+		:value(_value) {}
+
+	/* virtual methods from class OutputStream */
+	void Write(std::span<const std::byte> src) override {
+		value.append(reinterpret_cast<const char *>(src.data()),
+			     src.size());
+	}
+};
+
+class MetricsServer::Connection final
+	: FullyBufferedSocket, public IntrusiveListHook<>
+{
+	MetricsServer &server;
+
+	/**
+	 * Has the response been submitted to the output buffer?
+	 * After that, all input is ignored and the connection is
+	 * closed as soon as the output buffer is drained.
+	 */
+	bool responded = false;
+
+public:
+	Connection(MetricsServer &_server, UniqueSocketDescriptor &&_fd) noexcept
+		:FullyBufferedSocket(_fd.Release(), _server.GetEventLoop(),
+				     16384, 1024 * 1024),
+		 server(_server) {}
+
+	~Connection() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+	void Destroy() noexcept {
+		server.connections.erase_and_dispose(server.connections.iterator_to(*this),
+						     DeleteDisposer{});
+	}
+
+private:
+	void SendResponse() noexcept;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override;
+
+	void OnSocketError(std::exception_ptr ep) noexcept override {
+		LogError(ep);
+		Destroy();
+	}
+
+	void OnSocketClosed() noexcept override {
+		Destroy();
+	}
+
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketDrained() noexcept override {
+		if (responded)
+			Destroy();
+	}
+};
+
+inline void
+MetricsServer::Connection::SendResponse() noexcept
+{
+	std::string body;
+
+	try {
+		StringOutputStream sos(body);
+		BufferedOutputStream bos(sos);
+		server.WriteMetrics(bos);
+		bos.Flush();
+	} catch (...) {
+		LogError(std::current_exception());
+		Destroy();
+		return;
+	}
+
+	const auto header =
+		fmt::format("HTTP/1.0 200 OK\r\n"
+			    "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			    "Content-Length: {}\r\n"
+			    "Connection: close\r\n"
+			    "\r\n",
+			    body.size());
+
+	responded = true;
+
+	if (Write(header.data(), header.size()))
+		Write(body.data(), body.size());
+}
+
+BufferedSocket::InputResult
+MetricsServer::Connection::OnSocketInput(std::span<std::byte> src) noexcept
+{
+	if (responded) {
+		ConsumeInput(src.size());
+		return InputResult::MORE;
+	}
+
+	const std::string_view request{
+		reinterpret_cast<const char *>(src.data()),
+		src.size(),
+	};
+
+	if (request.find("\r\n\r\n"sv) == request.npos &&
+	    request.find("\n\n"sv) == request.npos) {
+		if (request.size() >= MAX_REQUEST_SIZE) {
+			Destroy();
+			return InputResult::CLOSED;
+		}
+
+		/* wait for the rest of the request header */
+		return InputResult::MORE;
+	}
+
+	ConsumeInput(src.size());
+	SendResponse();
+	return responded ? InputResult::MORE : InputResult::CLOSED;
+}
+
+MetricsServer::MetricsServer(EventLoop &_loop, Instance &_instance) noexcept
+	:ServerSocket(_loop), instance(_instance),
+	 lag_timer(_loop, BIND_THIS_METHOD(OnLagTimer))
+{
+}
+
+MetricsServer::~MetricsServer() noexcept
+{
+	connections.clear_and_dispose(DeleteDisposer{});
+}
+
+void
+MetricsServer::Open()
+{
+	ServerSocket::Open();
+	ScheduleLagTimer();
+}
+
+inline void
+MetricsServer::ScheduleLagTimer() noexcept
+{
+	lag_due = std::chrono::steady_clock::now() + LAG_INTERVAL;
+	lag_timer.Schedule(LAG_INTERVAL);
+}
+
+void
+MetricsServer::OnLagTimer() noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+	last_lag = now > lag_due
+		? now - lag_due
+		: std::chrono::steady_clock::duration::zero();
+	lag_histogram.Add(last_lag);
+
+	ScheduleLagTimer();
+}
+
+void
+MetricsServer::WriteMetrics(BufferedOutputStream &os)
+{
+	WriteSimpleMetric(os, "mpd_event_loop_lag_seconds", "gauge",
+			  "The most recently measured event loop lag",
+			  DurationToSeconds(last_lag));
+
+	WriteMetricHeader(os, "mpd_event_loop_lag_histogram_seconds",
+			  "histogram",
+			  "How late the event loop runs timers");
+	WriteHistogram(os, "mpd_event_loop_lag_histogram_seconds", {},
+		       lag_histogram.Load());
+
+	WriteMetricHeader(os, "mpd_command_duration_seconds", "histogram",
+			  "The execution time of client commands");
+	command_visit_latency([&os](const char *name,
+				    const LatencyHistogram &latency){
+		const auto snapshot = latency.Load();
+		if (snapshot.GetCount() == 0)
+			/* omit commands which were never used */
+			return;
+
+		WriteHistogram(os, "mpd_command_duration_seconds",
+			       fmt::format("command=\"{}\"", name),
+			       snapshot);
+	});
+
+#ifdef ENABLE_DATABASE
+	const auto db_lock = GetDatabaseLockStats();
+	WriteSimpleMetric(os, "mpd_db_lock_exclusive_total", "counter",
+			  "Number of times the exclusive database lock was obtained",
+			  db_lock.exclusive_count);
+	WriteSimpleMetric(os, "mpd_db_lock_exclusive_seconds_total", "counter",
+			  "Total time the exclusive database lock was held",
+			  DurationToSeconds(db_lock.exclusive_duration));
+	WriteSimpleMetric(os, "mpd_db_lock_exclusive_max_seconds", "gauge",
+			  "Longest time the exclusive database lock was held at once",
+			  DurationToSeconds(db_lock.exclusive_max_duration));
+	WriteSimpleMetric(os, "mpd_db_lock_shared_total", "counter",
+			  "Number of times the shared database lock was obtained",
+			  db_lock.shared_count);
+	WriteSimpleMetric(os, "mpd_db_lock_shared_seconds_total", "counter",
+			  "Total time the shared database lock was held",
+			  DurationToSeconds(db_lock.shared_duration));
+#endif
+
+	WriteMetricHeader(os, "mpd_music_buffer_chunks", "gauge",
+			  "Total number of chunks in the music buffer");
+	for (const auto &partition : instance.partitions)
+		os.Fmt("mpd_music_buffer_chunks{{partition=\"{}\"}} {}\n",
+		       EscapeLabelValue(partition.name),
+		       partition.pc.LockGetBufferStats().chunks);
+
+	WriteMetricHeader(os, "mpd_music_buffer_limit_chunks", "gauge",
+			  "Number of music buffer chunks which may be used (adaptive buffer)");
+	for (const auto &partition : instance.partitions)
+		os.Fmt("mpd_music_buffer_limit_chunks{{partition=\"{}\"}} {}\n",
+		       EscapeLabelValue(partition.name),
+		       partition.pc.LockGetBufferStats().limit);
+
+	WriteMetricHeader(os, "mpd_music_buffer_grown_total", "counter",
+			  "Number of times the adaptive music buffer has grown");
+	for (const auto &partition : instance.partitions)
+		os.Fmt("mpd_music_buffer_grown_total{{partition=\"{}\"}} {}\n",
+		       EscapeLabelValue(partition.name),
+		       partition.pc.LockGetBufferStats().grown);
+
+	WriteMetricHeader(os, "mpd_music_buffer_used_chunks", "gauge",
+			  "Number of music buffer chunks currently in use");
+	for (const auto &partition : instance.partitions)
+		os.Fmt("mpd_music_buffer_used_chunks{{partition=\"{}\"}} {}\n",
+		       EscapeLabelValue(partition.name),
+		       partition.pc.LockGetBufferUsage());
+
+	if (const auto *cache = instance.input_cache.get()) {
+		const auto s = cache->GetStats();
+
+		WriteSimpleMetric(os, "mpd_input_cache_size_bytes", "gauge",
+				  "Total size of all items in the input cache",
+				  s.size);
+		WriteSimpleMetric(os, "mpd_input_cache_max_size_bytes", "gauge",
+				  "Configured size of the input cache",
+				  s.max_size);
+		WriteSimpleMetric(os, "mpd_input_cache_hits_total", "counter",
+				  "Number of lookups which found the file in RAM",
+				  s.hits);
+		WriteSimpleMetric(os, "mpd_input_cache_misses_total", "counter",
+				  "Number of lookups which had to load the file",
+				  s.misses);
+		WriteSimpleMetric(os, "mpd_input_cache_disk_hits_total", "counter",
+				  "Number of misses which were satisfied by the disk cache",
+				  s.disk_hits);
+		WriteSimpleMetric(os, "mpd_input_cache_evictions_total", "counter",
+				  "Number of items evicted from RAM",
+				  s.evictions);
+	}
+
+	WriteSimpleMetric(os, "mpd_decoder_audio_seconds_total", "counter",
+			  "Duration of the audio produced by all decoders",
+			  decoder_metrics.audio_ns.Load() / 1e9);
+	WriteSimpleMetric(os, "mpd_decoder_busy_seconds_total", "counter",
+			  "Wall time spent decoding, not including waits for free buffer space",
+			  decoder_metrics.busy_ns.Load() / 1e9);
+
+	WriteOutputMetrics(os, instance.partitions);
+}
+
+void
+MetricsServer::OnAccept(UniqueSocketDescriptor fd,
+			SocketAddress, int) noexcept
+{
+	auto *connection = new Connection(*this, std::move(fd));
+	connections.push_back(*connection);
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_METRICS_SERVER_HXX
+#define MPD_METRICS_SERVER_HXX
+
+#include "Histogram.hxx"
+#include "event/ServerSocket.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "util/IntrusiveList.hxx"
+
+struct Instance;
+class BufferedOutputStream;
+
+/**
+ * A minimal HTTP server which exports internal metrics in the
+ * Prometheus text exposition format.  Every request (regardless of
+ * its method and URI) gets the current metrics, and the connection
+ * is closed after the response has been sent.
+ *
+ * Most metrics are collected by cheap per-thread counters (see
+ * #ShardedCounter) which are summed only here, when the metrics are
+ * scraped.
+ */
+class MetricsServer final : public ServerSocket {
+	class Connection;
+
+	Instance &instance;
+
+	IntrusiveList<Connection> connections;
+
+	/**
+	 * This timer measures the event loop lag, i.e. how late the
+	 * #EventLoop runs it.
+	 */
+	FineTimerEvent lag_timer;
+
+	/**
+	 * When #lag_timer is supposed to fire.
+	 */
+	std::chrono::steady_clock::time_point lag_due;
+
+	LatencyHistogram lag_histogram;
+
+	/**
+	 * The lag measured most recently.
+	 */
+	std::chrono::steady_clock::duration last_lag{};
+
+public:
+	MetricsServer(EventLoop &_loop, Instance &_instance) noexcept;
+	~MetricsServer() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Open();
+
+private:
+	void WriteMetrics(BufferedOutputStream &os);
+
+	void ScheduleLagTimer() noexcept;
+
+	/* callback for #lag_timer */
+	void OnLagTimer() noexcept;
+
+	/* virtual methods from class ServerSocket */
+	void OnAccept(UniqueSocketDescriptor fd,
+		      SocketAddress address, int uid) noexcept override;
+};
+
+#endif
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Shard.hxx"
+
+#include <atomic>
+
+static std::atomic_uint next_metrics_shard{0};
+
+unsigned
+GetMetricsShard() noexcept
+{
+	static thread_local const unsigned shard =
+		next_metrics_shard.fetch_add(1, std::memory_order_relaxed)
+		% N_METRICS_SHARDS;
+	return shard;
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_METRICS_SHARD_HXX
+#define MPD_METRICS_SHARD_HXX
+
+/**
+ * The number of shards of each metric.  Each thread updates only
+ * "its" shard, which avoids cache line bouncing between threads; all
+ * shards are summed only when the metrics are scraped.
+ */
+inline constexpr unsigned N_METRICS_SHARDS = 8;
+
+/**
+ * The size of one shard; it should be (at least) one cache line.
+ */
+inline constexpr unsigned METRICS_SHARD_ALIGN = 64;
+
+/**
+ * Returns the index of the shard to be updated by the calling
+ * thread.  Threads are assigned to shards round-robin when they call
+ * this function for the first time.
+ */
+[[gnu::const]]
+unsigned
+GetMetricsShard() noexcept;
+
+#endif
@@ -20,6 +20,8 @@
 
 #include <alsa/asoundlib.h>
 
+#include <atomic>
+
 #define VOLUME_MIXER_ALSA_DEFAULT		"default"
 #define VOLUME_MIXER_ALSA_CONTROL_DEFAULT	"PCM"
 static constexpr unsigned VOLUME_MIXER_ALSA_INDEX_DEFAULT = 0;
@@ -31,6 +33,12 @@ class AlsaMixerMonitor final : MultiSocketMonitor {
 
 	Alsa::NonBlockMixer non_block;
 
+	/**
+	 * Cleared when the sound device has been unplugged; after
+	 * that, no more mixer events will be received.
+	 */
+	std::atomic_bool alive{true};
+
 public:
 	AlsaMixerMonitor(EventLoop &_loop, snd_mixer_t *_mixer) noexcept
 		:MultiSocketMonitor(_loop),
@@ -50,6 +58,15 @@ public:
 	AlsaMixerMonitor(const AlsaMixerMonitor &) = delete;
 	AlsaMixerMonitor &operator=(const AlsaMixerMonitor &) = delete;
 
+	/**
+	 * Are mixer events still being received?  As long as this is
+	 * true, ElemCallback() will be invoked for every volume
+	 * change.
+	 */
+	bool IsAlive() const noexcept {
+		return alive.load(std::memory_order_relaxed);
+	}
+
 private:
 	Event::Duration PrepareSockets() noexcept override;
 	void DispatchSockets() noexcept override;
@@ -85,6 +102,16 @@ class AlsaMixer final : public Mixer {
 	 */
 	int desired_volume, resulting_volume;
 
+	/**
+	 * The most recent volume reported by ElemCallback() or set
+	 * by SetVolume(), or -1 if unknown.  While the
+	 * #AlsaMixerMonitor receives events, this is always up to
+	 * date, and GetVolume() does not need to ask ALSA.  This is
+	 * written by the #EventLoop thread and read by GetVolume()
+	 * in another thread.
+	 */
+	std::atomic_int cached_volume;
+
 public:
 	AlsaMixer(EventLoop &_event_loop, MixerListener &_listener) noexcept
 		:Mixer(alsa_mixer_plugin, _listener),
@@ -156,6 +183,7 @@ AlsaMixerMonitor::DispatchSockets() noexcept
 			/* the sound device was unplugged; disable
 			   this GSource */
 			mixer = nullptr;
+			alive.store(false, std::memory_order_relaxed);
 			InvalidateSockets();
 			return;
 		}
@@ -186,6 +214,7 @@ AlsaMixer::ElemCallback(snd_mixer_elem_t *elem, unsigned mask) noexcept
 			/* flush */
 			mixer.desired_volume = mixer.resulting_volume = -1;
 
+		mixer.cached_volume.store(volume, std::memory_order_relaxed);
 		mixer.listener.OnMixerVolumeChanged(mixer, volume);
 	}
 
@@ -272,6 +301,7 @@ void
 AlsaMixer::Open()
 {
 	desired_volume = resulting_volume = -1;
+	cached_volume.store(-1, std::memory_order_relaxed);
 
 	int err;
 
@@ -305,6 +335,14 @@ AlsaMixer::GetVolume()
 
 	assert(handle != nullptr);
 
+	if (monitor->IsAlive()) {
+		/* the monitor keeps the cache up to date; no need to
+		   query ALSA */
+		if (int volume = cached_volume.load(std::memory_order_relaxed);
+		    volume >= 0)
+			return volume;
+	}
+
 	err = snd_mixer_handle_events(handle);
 	if (err < 0)
 		throw Alsa::MakeError(err, "snd_mixer_handle_events() failed");
@@ -314,6 +352,7 @@ AlsaMixer::GetVolume()
 		/* we're still on the value passed to SetVolume() */
 		volume = desired_volume;
 
+	cached_volume.store(volume, std::memory_order_relaxed);
 	return volume;
 }
 
@@ -328,6 +367,7 @@ AlsaMixer::SetVolume(unsigned volume)
 
 	desired_volume = volume;
 	resulting_volume = GetPercentVolume();
+	cached_volume.store(volume, std::memory_order_relaxed);
 }
 
 const MixerPlugin alsa_mixer_plugin = {
@@ -13,12 +13,15 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
+#include "config/Block.hxx"
 #include "Log.hxx"
 
 #include <libsmbclient.h>
 
 #include <cerrno>
 #include <cstring>
+#include <string_view>
+#include <unordered_set>
 #include <utility>
 
 class SmbclientNeighborExplorer final : public NeighborExplorer {
@@ -51,12 +54,19 @@ class SmbclientNeighborExplorer final : public NeighborExplorer {
 
 	List list;
 
+	/**
+	 * The time between two scans.
+	 */
+	const std::chrono::steady_clock::duration interval;
+
 	bool quit;
 
 public:
-	explicit SmbclientNeighborExplorer(NeighborListener &_listener)
+	SmbclientNeighborExplorer(NeighborListener &_listener,
+				  std::chrono::steady_clock::duration _interval)
 		:NeighborExplorer(_listener),
-		 thread(BIND_THIS_METHOD(ThreadFunc)) {}
+		 thread(BIND_THIS_METHOD(ThreadFunc)),
+		 interval(_interval) {}
 
 	/* virtual methods from class NeighborExplorer */
 	void Open() override;
@@ -164,58 +174,62 @@ DetectServers(SmbclientContext &ctx) noexcept
 	return list;
 }
 
-[[gnu::pure]]
-static NeighborExplorer::List::iterator
-FindBeforeServerByURI(NeighborExplorer::List::iterator prev,
-		      NeighborExplorer::List::iterator end,
-		      const std::string &uri) noexcept
-{
-	for (auto i = std::next(prev); i != end; prev = i, i = std::next(prev))
-		if (i->uri == uri)
-			return prev;
-
-	return end;
-}
-
 inline void
 SmbclientNeighborExplorer::Run() noexcept
 {
-	List found, lost;
+	List found;
 
 	{
 		const ScopeUnlock unlock(mutex);
 		found = DetectServers(ctx);
 	}
 
-	const auto found_before_begin = found.before_begin();
-	const auto found_end = found.end();
-
-	for (auto prev = list.before_begin(), i = std::next(prev), end = list.end();
-	     i != end; i = std::next(prev)) {
-		auto f = FindBeforeServerByURI(found_before_begin, found_end,
-					       i->uri);
-		if (f != found_end) {
-			/* still visible: remove from "found" so we
-			   don't believe it's a new one */
-			*i = std::move(*std::next(f));
-			found.erase_after(f);
+	/* compare the new scan with the known list by URI (with
+	   hash sets, because a large network may have hundreds of
+	   servers); only the differences are passed to the
+	   listener */
+
+	std::unordered_set<std::string_view> found_uris;
+	for (const auto &i : found)
+		found_uris.emplace(i.uri);
+
+	std::unordered_set<std::string_view> known_uris;
+	for (const auto &i : list)
+		known_uris.emplace(i.uri);
+
+	List lost;
+	for (auto prev = list.before_begin(), i = std::next(prev);
+	     i != list.end(); i = std::next(prev)) {
+		if (found_uris.contains(i->uri))
+			/* still visible */
 			prev = i;
-		} else {
+		else
 			/* can't see it anymore: move to "lost" */
 			lost.splice_after(lost.before_begin(), list, prev);
-		}
 	}
 
-	for (auto prev = found_before_begin, i = std::next(prev);
-	     i != found_end; prev = i, i = std::next(prev))
-		list.push_front(*i);
+	List added;
+	for (auto prev = found.before_begin(), i = std::next(prev);
+	     i != found.end(); i = std::next(prev)) {
+		if (known_uris.emplace(i->uri).second)
+			/* a new one (the list node is spliced, so the
+			   string_view in "known_uris" remains valid) */
+			added.splice_after(added.before_begin(), found, prev);
+		else
+			/* already known (or a duplicate from another
+			   workgroup) */
+			prev = i;
+	}
+
+	for (const auto &i : added)
+		list.push_front(i);
 
 	const ScopeUnlock unlock(mutex);
 
 	for (auto &i : lost)
 		listener.LostNeighbor(i);
 
-	for (auto &i : found)
+	for (auto &i : added)
 		listener.FoundNeighbor(i);
 }
 
@@ -232,19 +246,23 @@ SmbclientNeighborExplorer::ThreadFunc() noexcept
 		if (quit)
 			break;
 
-		// TODO: sleep for how long?
-		cond.wait_for(lock, std::chrono::seconds(10));
+		cond.wait_for(lock, interval);
 	}
 }
 
 static std::unique_ptr<NeighborExplorer>
 smbclient_neighbor_create([[maybe_unused]] EventLoop &loop,
 			  NeighborListener &listener,
-			  [[maybe_unused]] const ConfigBlock &block)
+			  const ConfigBlock &block)
 {
+	const auto interval = block.GetDuration("interval",
+						std::chrono::seconds(1),
+						std::chrono::seconds(10));
+
 	SmbclientInit();
 
-	return std::make_unique<SmbclientNeighborExplorer>(listener);
+	return std::make_unique<SmbclientNeighborExplorer>(listener,
+							   interval);
 }
 
 const NeighborPlugin smbclient_neighbor_plugin = {
@@ -12,7 +12,7 @@
 UniqueSocketDescriptor
 socket_bind_listen(int domain, int type, int protocol,
 		   SocketAddress address,
-		   int backlog)
+		   int backlog, [[maybe_unused]] bool reuse_port)
 {
 	UniqueSocketDescriptor fd;
 	if (!fd.CreateNonBlock(domain, type, protocol))
@@ -28,6 +28,11 @@ socket_bind_listen(int domain, int type, int protocol,
 	if (!fd.SetReuseAddress())
 		throw MakeSocketError("setsockopt() failed");
 
+#ifdef __linux__
+	if (reuse_port && !fd.SetReusePort())
+		throw MakeSocketError("Failed to set SO_REUSEPORT");
+#endif
+
 	if (!fd.Bind(address))
 		throw MakeSocketError("Failed to bind socket");
 
@@ -28,11 +28,14 @@ class SocketAddress;
  * @param protocol the protocol, usually 0 to let the kernel choose
  * @param address the address to listen on
  * @param backlog the backlog parameter for the listen() system call
+ * @param reuse_port set SO_REUSEPORT (Linux only), which allows
+ * binding several sockets to the same address; the kernel distributes
+ * incoming connections among them
  * @return the socket file descriptor
  */
 UniqueSocketDescriptor
 socket_bind_listen(int domain, int type, int protocol,
 		   SocketAddress address,
-		   int backlog);
+		   int backlog, bool reuse_port=false);
 
 #endif
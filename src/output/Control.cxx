@@ -8,6 +8,7 @@
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "mixer/Mixer.hxx"
 #include "config/Block.hxx"
+#include "config/ThreadConfig.hxx"
 #include "Log.hxx"
 
 #include <cassert>
@@ -16,6 +17,19 @@
     automatically reopening the device */
 static constexpr PeriodClock::Duration REOPEN_AFTER = std::chrono::seconds(10);
 
+/**
+ * The settings in the "audio_output" block override the "thread"
+ * block named "output".
+ */
+static ThreadScheduling
+GetOutputThreadScheduling(const ConfigBlock &block)
+{
+	auto scheduling = ParseThreadScheduling(block);
+	if (scheduling.IsDefault())
+		scheduling = GetThreadScheduling("output");
+	return scheduling;
+}
+
 AudioOutputControl::AudioOutputControl(std::unique_ptr<FilteredAudioOutput> _output,
 				       AudioOutputClient &_client,
 				       const ConfigBlock &block)
@@ -26,6 +40,8 @@ AudioOutputControl::AudioOutputControl(std::unique_ptr<FilteredAudioOutput> _out
 	 tags(block.GetBlockValue("tags", true)),
 	 always_on(block.GetBlockValue("always_on", false)),
 	 always_off(block.GetBlockValue("always_off", false)),
+	 scheduling(GetOutputThreadScheduling(block)),
+	 filter_lookahead(block.GetBlockValue("filter_lookahead", 0U)),
 	 enabled(block.GetBlockValue("enabled", true))
 {
 }
@@ -38,7 +54,9 @@ AudioOutputControl::AudioOutputControl(AudioOutputControl &&src,
 	 thread(BIND_THIS_METHOD(Task)),
 	 tags(src.tags),
 	 always_on(src.always_on),
-	 always_off(src.always_off)
+	 always_off(src.always_off),
+	 scheduling(src.scheduling),
+	 filter_lookahead(src.filter_lookahead)
 {
 }
 
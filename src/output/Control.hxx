@@ -5,12 +5,15 @@
 #define MPD_OUTPUT_CONTROL_HXX
 
 #include "Source.hxx"
+#include "Stats.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "thread/Thread.hxx"
+#include "thread/Scheduling.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "time/PeriodClock.hxx"
 
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #include <map>
@@ -24,6 +27,7 @@ struct ConfigBlock;
 class MusicPipe;
 class Mixer;
 class AudioOutputClient;
+class SharedConvertRegistry;
 
 /**
  * Controller for an #AudioOutput and its output thread.
@@ -148,6 +152,23 @@ class AudioOutputControl {
 	 */
 	const bool always_off;
 
+	/**
+	 * CPU affinity and priority of the output thread.
+	 */
+	const ThreadScheduling scheduling;
+
+	/**
+	 * The number of chunks to be filtered ahead of time in a
+	 * #WorkerPool; 0 means the filters run in the output thread.
+	 */
+	const unsigned filter_lookahead;
+
+	/**
+	 * Shares the final conversion (resampling) with other outputs
+	 * of the same partition.  May be nullptr.
+	 */
+	SharedConvertRegistry *shared_convert_registry = nullptr;
+
 	/**
 	 * Has the user enabled this device?
 	 */
@@ -232,6 +253,28 @@ class AudioOutputControl {
 	 */
 	bool killed;
 
+	/**
+	 * The most recently measured time from decoding to playing
+	 * (see MusicChunk::submit_time and
+	 * AudioOutput::GetBufferedDuration()); zero if unknown.
+	 *
+	 * Protected by #mutex.
+	 */
+	std::chrono::steady_clock::duration latency{};
+
+	/**
+	 * Protected by #mutex.
+	 */
+	AudioOutputStats stats;
+
+	/**
+	 * The time when the output thread started waiting for the
+	 * next chunk while playing; the default value if it is not
+	 * waiting.  This is used to update
+	 * AudioOutputStats::pipe_wait_time.
+	 */
+	std::chrono::steady_clock::time_point pipe_wait_start{};
+
 public:
 	/**
 	 * This mutex protects #open, #fail_timer, #pipe.
@@ -272,6 +315,18 @@ public:
 		return client;
 	}
 
+	[[gnu::pure]]
+	std::chrono::steady_clock::duration LockGetLatency() const noexcept {
+		const std::scoped_lock protect{mutex};
+		return latency;
+	}
+
+	[[gnu::pure]]
+	AudioOutputStats LockGetStats() const noexcept {
+		const std::scoped_lock protect{mutex};
+		return stats;
+	}
+
 	[[gnu::pure]]
 	Mixer *GetMixer() const noexcept;
 
@@ -426,6 +481,29 @@ public:
 		source.SetReplayGainMode(_mode);
 	}
 
+	unsigned GetFilterLookahead() const noexcept {
+		return filter_lookahead;
+	}
+
+	/**
+	 * Run the filters of this output in the given #WorkerPool
+	 * (if "filter_lookahead" is configured).  Must be called
+	 * before the output is opened.
+	 */
+	void SetFilterPool(WorkerPool &pool) noexcept {
+		if (filter_lookahead > 0)
+			source.EnableLookahead(pool, filter_lookahead);
+	}
+
+	/**
+	 * Allow this output to share its final conversion with other
+	 * outputs in the given registry.  Must be called before the
+	 * output is opened.
+	 */
+	void SetSharedConvertRegistry(SharedConvertRegistry &registry) noexcept {
+		shared_convert_registry = &registry;
+	}
+
 	/**
 	 * Caller must lock the mutex.
 	 *
@@ -433,6 +511,14 @@ public:
 	 */
 	void InternalOpen2(AudioFormat in_audio_format);
 
+	/**
+	 * Join (or leave) a #SharedConvert after the output has been
+	 * (re)configured.
+	 *
+	 * Caller must not lock the mutex.
+	 */
+	void UpdateSharedConvert() noexcept;
+
 	/**
 	 * Caller must lock the mutex.
 	 */
@@ -7,7 +7,8 @@
 AudioOutputDefaults::AudioOutputDefaults(const ConfigData &config)
 	:normalize(config.GetBool(ConfigOption::VOLUME_NORMALIZATION, false)),
 	 mixer_type(mixer_type_parse(config.GetString(ConfigOption::MIXER_TYPE,
-						      "hardware")))
+						      "hardware"))),
+	 latency_target(std::chrono::milliseconds{config.GetUnsigned(ConfigOption::LATENCY_TARGET, 0)} / 2)
 
 {
 }
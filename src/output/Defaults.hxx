@@ -6,6 +6,8 @@
 
 #include "mixer/Type.hxx"
 
+#include <chrono>
+
 struct ConfigData;
 
 /**
@@ -17,6 +19,13 @@ struct AudioOutputDefaults {
 
 	MixerType mixer_type = MixerType::HARDWARE;
 
+	/**
+	 * The output's share of the global "latency_target" setting
+	 * (see PlayerConfig::latency_target); zero if not
+	 * configured.
+	 */
+	std::chrono::steady_clock::duration latency_target{};
+
 	constexpr AudioOutputDefaults() = default;
 
 	/**
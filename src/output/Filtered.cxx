@@ -3,6 +3,7 @@
 
 #include "Filtered.hxx"
 #include "Interface.hxx"
+#include "SharedConvert.hxx"
 #include "Domain.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
@@ -10,8 +11,10 @@
 #include "mixer/Control.hxx"
 #include "mixer/Mixer.hxx"
 #include "mixer/plugins/SoftwareMixerPlugin.hxx"
+#include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "filter/plugins/ConvertFilterPlugin.hxx"
+#include "filter/plugins/VolumeFilterPlugin.hxx"
 #include "util/StringBuffer.hxx"
 #include "Log.hxx"
 
@@ -65,6 +68,20 @@ FilteredAudioOutput::Disable() noexcept
 void
 FilteredAudioOutput::ConfigureConvertFilter()
 {
+	if (auto *vf = volume_filter.Get(); vf != nullptr) {
+		/* the software volume filter is right before the
+		   convert filter; if only the sample format needs to
+		   be converted, let it do that in the same pass */
+		const auto &in = vf->GetOutAudioFormat();
+		const bool fuse = in.sample_rate == out_audio_format.sample_rate &&
+			in.channels == out_audio_format.channels;
+		const auto format =
+			volume_filter_set_out_format(vf, fuse
+						     ? out_audio_format.format
+						     : SampleFormat::UNDEFINED);
+		convert_filter_set_in_format(convert_filter.Get(), format);
+	}
+
 	try {
 		convert_filter_set(convert_filter.Get(), out_audio_format);
 	} catch (...) {
@@ -73,6 +90,20 @@ FilteredAudioOutput::ConfigureConvertFilter()
 	}
 }
 
+std::optional<SharedConvertKey>
+FilteredAudioOutput::GetSharedConvertKey(AudioFormat in_audio_format) const noexcept
+{
+	if (!convert_only ||
+	    in_audio_format.sample_rate == out_audio_format.sample_rate)
+		return std::nullopt;
+
+	return SharedConvertKey{
+		in_audio_format,
+		out_audio_format,
+		software_replay_gain,
+	};
+}
+
 void
 FilteredAudioOutput::OpenOutputAndConvert(AudioFormat desired_audio_format)
 {
@@ -159,6 +190,18 @@ FilteredAudioOutput::Delay() noexcept
 	return output->Delay();
 }
 
+std::chrono::steady_clock::duration
+FilteredAudioOutput::GetBufferedDuration() const noexcept
+{
+	return output->GetBufferedDuration();
+}
+
+uint_least64_t
+FilteredAudioOutput::GetUnderrunCount() const noexcept
+{
+	return output->GetUnderrunCount();
+}
+
 void
 FilteredAudioOutput::SendTag(const Tag &tag)
 {
@@ -8,8 +8,10 @@
 #include "filter/Observer.hxx"
 
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <optional>
 #include <span>
 #include <string>
 
@@ -24,6 +26,7 @@ class AudioOutput;
 struct AudioOutputDefaults;
 struct ReplayGainConfig;
 struct Tag;
+struct SharedConvertKey;
 
 struct FilteredAudioOutput {
 	const char *const plugin_name;
@@ -107,6 +110,27 @@ public:
 	 */
 	FilterObserver convert_filter;
 
+	/**
+	 * Does #prepared_filter consist of nothing but the
+	 * #convert_filter?  Only then is the input of the
+	 * #convert_filter the same for all outputs, and the
+	 * conversion can be shared (see GetSharedConvertKey()).
+	 */
+	bool convert_only = true;
+
+	/**
+	 * Does #prepared_replay_gain_filter modify the samples (as
+	 * opposed to using the hardware mixer)?
+	 */
+	bool software_replay_gain = false;
+
+	/**
+	 * Shall the #volume_filter apply the replay gain in the same
+	 * pass as the software volume?  This is only possible if
+	 * the #volume_filter is the first filter in the chain.
+	 */
+	bool fused_replay_gain = false;
+
 	/**
 	 * Throws on error.
 	 */
@@ -175,6 +199,18 @@ public:
 
 	void ConfigureConvertFilter();
 
+	/**
+	 * Determine whether the final conversion can be shared with
+	 * other outputs which have the same #SharedConvertKey.  This
+	 * is only done if it includes resampling, because the other
+	 * conversions are too cheap to be worth it.
+	 *
+	 * @param in_audio_format the input format of the
+	 * #AudioOutputSource
+	 */
+	[[gnu::pure]]
+	std::optional<SharedConvertKey> GetSharedConvertKey(AudioFormat in_audio_format) const noexcept;
+
 	/**
 	 * Invoke OutputPlugin::open() and configure the
 	 * #ConvertFilter.
@@ -207,6 +243,12 @@ public:
 	[[gnu::pure]]
 	std::chrono::steady_clock::duration Delay() noexcept;
 
+	[[gnu::pure]]
+	std::chrono::steady_clock::duration GetBufferedDuration() const noexcept;
+
+	[[gnu::pure]]
+	uint_least64_t GetUnderrunCount() const noexcept;
+
 	void SendTag(const Tag &tag);
 
 	std::size_t Play(std::span<const std::byte> src);
@@ -126,6 +126,7 @@ audio_output_load_mixer(EventLoop &event_loop, FilteredAudioOutput &ao,
 		filter_chain = ChainFilters(std::move(filter_chain),
 					    ao.volume_filter.Set(volume_filter_prepare()),
 					    "software_mixer");
+		ao.convert_only = false;
 		return mixer;
 	}
 
@@ -162,12 +163,16 @@ FilteredAudioOutput::Configure(const ConfigBlock &block,
 		prepared_filter = ChainFilters(std::move(prepared_filter),
 					       autoconvert_filter_new(normalize_filter_prepare()),
 					       "normalize");
+		convert_only = false;
 	}
 
 	try {
-		if (filter_factory != nullptr)
+		const char *filters = block.GetBlockValue(AUDIO_FILTERS, "");
+		if (filter_factory != nullptr && *filters != 0) {
+			convert_only = false;
 			filter_chain_parse(prepared_filter, *filter_factory,
-					   block.GetBlockValue(AUDIO_FILTERS, ""));
+					   filters);
+		}
 	} catch (...) {
 		/* It's not really fatal - Part of the filter chain
 		   has been set up already and even an empty one will
@@ -197,12 +202,22 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 	const char *replay_gain_handler =
 		block.GetBlockValue("replay_gain_handler", "software");
 
+	/* if the software volume filter will be the first filter
+	   (i.e. there are no other filters yet), the replay gain can
+	   be applied by it */
+	const bool fuse_replay_gain = mixer_type == MixerType::SOFTWARE &&
+		convert_only &&
+		StringIsEqual(replay_gain_handler, "software");
+
 	if (!StringIsEqual(replay_gain_handler, "none")) {
 		/* when using software volume, we lose quality by
 		   invoking PcmVolume::Apply() twice; to avoid losing
 		   too much precision, we allow the ReplayGainFilter
-		   to convert 16 bit to 24 bit */
-		const bool allow_convert = mixer_type == MixerType::SOFTWARE;
+		   to convert 16 bit to 24 bit (unless it gets fused
+		   with the software volume, which must not change
+		   the sample format) */
+		const bool allow_convert = mixer_type == MixerType::SOFTWARE &&
+			!fuse_replay_gain;
 
 		prepared_replay_gain_filter =
 			NewReplayGainFilter(replay_gain_config, allow_convert);
@@ -229,11 +244,16 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 
 	/* use the hardware mixer for replay gain? */
 
+	software_replay_gain = prepared_replay_gain_filter != nullptr;
+	fused_replay_gain = fuse_replay_gain && software_replay_gain &&
+		mixer != nullptr;
+
 	if (StringIsEqual(replay_gain_handler, "mixer")) {
-		if (mixer != nullptr)
+		if (mixer != nullptr) {
 			replay_gain_filter_set_mixer(*prepared_replay_gain_filter,
 						     mixer, 100);
-		else
+			software_replay_gain = false;
+		} else
 			FmtError(output_domain,
 				 "No such mixer for output {:?}", name);
 	} else if (!StringIsEqual(replay_gain_handler, "software") &&
@@ -292,6 +312,9 @@ audio_output_new(EventLoop &normal_event_loop, EventLoop &rt_event_loop,
 						       block));
 	assert(ao != nullptr);
 
+	if (defaults.latency_target > std::chrono::steady_clock::duration::zero())
+		ao->SetLatencyTarget(defaults.latency_target);
+
 	auto f = std::make_unique<FilteredAudioOutput>(plugin->name,
 						       std::move(ao), block,
 						       defaults,
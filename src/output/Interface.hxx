@@ -6,6 +6,7 @@
 
 #include <map>
 #include <chrono>
+#include <cstdint>
 #include <span>
 #include <string>
 
@@ -60,6 +61,14 @@ public:
 	 */
 	virtual void SetAttribute(std::string &&name, std::string &&value);
 
+	/**
+	 * Apply the "latency_target" setting: the output shall size
+	 * its buffers so they hold no more than the given duration,
+	 * unless the user has configured their sizes explicitly.
+	 * This is called once, before Enable().
+	 */
+	virtual void SetLatencyTarget(std::chrono::steady_clock::duration) noexcept {}
+
 	/**
 	 * Enable the device.  This may allocate resources, preparing
 	 * for the device to be opened.
@@ -146,6 +155,29 @@ public:
 		return std::chrono::steady_clock::duration::zero();
 	}
 
+	/**
+	 * Returns the duration of the audio data which was accepted
+	 * by Play() but has not been played yet (i.e. the contents
+	 * of internal and hardware buffers), or zero if that is
+	 * unknown.  This is used to measure the end-to-end latency.
+	 *
+	 * This method must be thread-safe.
+	 */
+	virtual std::chrono::steady_clock::duration GetBufferedDuration() const noexcept {
+		return std::chrono::steady_clock::duration::zero();
+	}
+
+	/**
+	 * Returns the number of buffer underruns of the device since
+	 * this object was created (or zero if the plugin does not
+	 * know).
+	 *
+	 * This method must be thread-safe.
+	 */
+	virtual uint_least64_t GetUnderrunCount() const noexcept {
+		return 0;
+	}
+
 	/**
 	 * Display metadata for the next chunk.  Optional method,
 	 * because not all devices can display metadata.
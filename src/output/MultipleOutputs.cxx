@@ -11,11 +11,17 @@
 #include "config/Block.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
+#include "config/ThreadConfig.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "thread/WorkerPool.hxx"
 #include "util/StringAPI.hxx"
+#include "Domain.hxx"
+#include "Log.hxx"
 
 #include <cassert>
 #include <stdexcept>
+#include <thread>
 
 #include <string.h>
 
@@ -87,6 +93,7 @@ MultipleOutputs::Configure(EventLoop &event_loop, EventLoop &rt_event_loop,
 					      "names: {}",
 					      output->GetName());
 
+		output->SetSharedConvertRegistry(shared_convert);
 		outputs.emplace_back(std::move(output));
 	});
 
@@ -100,6 +107,33 @@ MultipleOutputs::Configure(EventLoop &event_loop, EventLoop &rt_event_loop,
 						       client, empty, defaults,
 						       nullptr));
 	}
+
+	const unsigned n_lookahead =
+		std::count_if(outputs.begin(), outputs.end(), [](const auto &ao){
+			return ao->GetFilterLookahead() > 0;
+		});
+	if (n_lookahead > 0) {
+		/* one worker thread per output is enough, because
+		   each output filters its chunks sequentially */
+		auto &pool = MakeFilterPool(std::min(n_lookahead,
+						     std::max(std::thread::hardware_concurrency(),
+							      1U)));
+		for (const auto &ao : outputs)
+			ao->SetFilterPool(pool);
+	}
+}
+
+WorkerPool &
+MultipleOutputs::MakeFilterPool(unsigned n_threads)
+{
+	if (!filter_pool) {
+		auto pool = std::make_unique<WorkerPool>("output_filter");
+		pool->SetScheduling(GetThreadScheduling("output"));
+		pool->Start(n_threads);
+		filter_pool = std::move(pool);
+	}
+
+	return *filter_pool;
 }
 
 AudioOutputControl *
@@ -120,7 +154,20 @@ MultipleOutputs::AddMoveFrom(AudioOutputControl &&src,
 	outputs.push_back(std::make_unique<AudioOutputControl>(std::move(src),
 							       client));
 
-	outputs.back()->LockSetEnabled(enable);
+	auto &ao = *outputs.back();
+	ao.SetSharedConvertRegistry(shared_convert);
+
+	if (ao.GetFilterLookahead() > 0) {
+		try {
+			ao.SetFilterPool(MakeFilterPool(1));
+		} catch (...) {
+			FmtError(output_domain,
+				 "Failed to start filter threads for {}: {}",
+				 ao.GetLogName(), std::current_exception());
+		}
+	}
+
+	ao.LockSetEnabled(enable);
 
 	client.ApplyEnabled();
 }
@@ -271,7 +318,7 @@ MultipleOutputs::CheckPipe() noexcept
 			   provides a defined value */
 			elapsed_time = chunk->time;
 
-		const bool is_tail = chunk->next == nullptr;
+		const bool is_tail = chunk->GetNext() == nullptr;
 		if (is_tail)
 			/* this is the tail of the pipe - clear the
 			   chunk reference in all outputs */
@@ -32,6 +32,20 @@ class MultipleOutputs final : public PlayerOutputs {
 
 	MixerListener &mixer_listener;
 
+	/**
+	 * Runs the filters of outputs with "filter_lookahead".  It is
+	 * only created if at least one output uses it.  It must be
+	 * declared before #outputs, because the outputs must be
+	 * destroyed first.
+	 */
+	std::unique_ptr<WorkerPool> filter_pool;
+
+	/**
+	 * Allows outputs to share their resampler.  It is declared
+	 * before #outputs for the same reason as #filter_pool.
+	 */
+	SharedConvertRegistry shared_convert;
+
 	std::vector<std::unique_ptr<AudioOutputControl>> outputs;
 
 	AudioFormat input_audio_format = AudioFormat::Undefined();
@@ -147,6 +161,14 @@ public:
 	void SetSoftwareVolume(unsigned volume) noexcept;
 
 private:
+	/**
+	 * Start #filter_pool with the given number of threads if it
+	 * has not been started yet.
+	 *
+	 * Throws on error.
+	 */
+	WorkerPool &MakeFilterPool(unsigned n_threads);
+
 	/**
 	 * Was Open() called successfully?
 	 *
@@ -26,8 +26,50 @@ printAudioDevices(Response &r, const MultipleOutputs &outputs)
 		      ao.GetName(), ao.GetPluginName(),
 		      (unsigned)ao.IsEnabled());
 
+		if (const auto latency = ao.LockGetLatency();
+		    latency > std::chrono::steady_clock::duration::zero())
+			r.Fmt(FMT_STRING("latency: {:.3f}\n"),
+			      std::chrono::duration<double>(latency).count());
+
 		for (const auto &[attribute, value] : ao.GetAttributes())
 			r.Fmt(FMT_STRING("attribute: {}={}\n"),
 			      attribute, value);
 	}
 }
+
+static double
+ToSeconds(std::chrono::steady_clock::duration d) noexcept
+{
+	return std::chrono::duration<double>(d).count();
+}
+
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs)
+{
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+		const auto &ao = outputs.Get(i);
+		const auto stats = ao.LockGetStats();
+
+		r.Fmt(FMT_STRING("outputid: {}\n"
+				 "outputname: {}\n"
+				 "played_bytes: {}\n"
+				 "device_underruns: {}\n"
+				 "pipe_underruns: {}\n"
+				 "play_time: {:.3f}\n"
+				 "pipe_wait_time: {:.3f}\n"
+				 "filter_time: {:.3f}\n"),
+		      i, ao.GetName(),
+		      stats.played_bytes,
+		      stats.device_underruns,
+		      stats.pipe_underruns,
+		      ToSeconds(stats.play_time),
+		      ToSeconds(stats.pipe_wait_time),
+		      ToSeconds(stats.filter_time));
+
+		if (stats.buffered > std::chrono::steady_clock::duration::zero())
+			r.Fmt(FMT_STRING("buffered: {:.3f}\n"
+					 "buffered_min: {:.3f}\n"),
+			      ToSeconds(stats.buffered),
+			      ToSeconds(stats.buffered_min));
+	}
+}
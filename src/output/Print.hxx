@@ -15,4 +15,10 @@ class MultipleOutputs;
 void
 printAudioDevices(Response &r, const MultipleOutputs &outputs);
 
+/**
+ * Print the #AudioOutputStats of all outputs.
+ */
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs);
+
 #endif
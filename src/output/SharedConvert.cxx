@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SharedConvert.hxx"
+#include "MusicChunk.hxx"
+
+#include <algorithm>
+#include <bit>
+
+SharedConvert::SharedConvert(const SharedConvertKey &_key)
+	:key(_key), convert(key.in_format, key.out_format)
+{
+}
+
+uint_least64_t
+SharedConvert::Subscribe() noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const unsigned n = std::countr_one(subscribers);
+	if (n >= 64)
+		return 0;
+
+	const uint_least64_t bit = uint_least64_t{1} << n;
+
+	subscribers |= bit;
+	return bit;
+}
+
+inline void
+SharedConvert::DiscardLocked(uint_least64_t bit) noexcept
+{
+	for (auto &i : entries)
+		i.pending &= ~bit;
+
+	std::erase_if(entries, [](const auto &i){ return i.pending == 0; });
+}
+
+void
+SharedConvert::Unsubscribe(uint_least64_t bit) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	DiscardLocked(bit);
+	subscribers &= ~bit;
+}
+
+void
+SharedConvert::Discard(uint_least64_t bit) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	DiscardLocked(bit);
+
+	if (entries.empty())
+		/* nobody is lagging behind; this is probably a
+		   seek, and the next chunk is not contiguous with the
+		   previous one */
+		convert.Reset();
+}
+
+bool
+SharedConvert::Convert(uint_least64_t bit, std::vector<std::byte> &dest,
+		       uint_least64_t serial, std::span<const std::byte> src)
+{
+	const std::scoped_lock lock{mutex};
+
+	if (serial > last_serial) {
+		/* this subscriber is the first one to get here */
+		const auto result = convert.Convert(src);
+		last_serial = serial;
+		dest.assign(result.begin(), result.end());
+
+		if (const auto pending = subscribers & ~bit; pending != 0) {
+			if (entries.size() >= MAX_ENTRIES)
+				entries.pop_front();
+
+			entries.push_back({serial, pending, dest});
+		}
+
+		return true;
+	}
+
+	const auto i = std::find_if(entries.begin(), entries.end(),
+				    [serial](const auto &e){
+					    return e.serial == serial;
+				    });
+	if (i == entries.end() || (i->pending & bit) == 0)
+		return false;
+
+	i->pending &= ~bit;
+	if (i->pending == 0) {
+		dest = std::move(i->data);
+		entries.erase(i);
+	} else
+		dest.assign(i->data.begin(), i->data.end());
+
+	return true;
+}
+
+std::optional<std::span<const std::byte>>
+SharedConvert::Subscriber::Convert(const MusicChunk &chunk,
+				   std::span<const std::byte> src)
+{
+	if (!parent->Convert(bit, buffer, chunk.serial, src))
+		return std::nullopt;
+
+	return buffer;
+}
+
+std::unique_ptr<SharedConvert::Subscriber>
+SharedConvertRegistry::Subscribe(const SharedConvertKey &key)
+{
+	const std::scoped_lock lock{mutex};
+
+	list.remove_if([](const auto &i){ return i.expired(); });
+
+	for (const auto &i : list) {
+		auto shared = i.lock();
+		if (shared == nullptr || shared->GetKey() != key)
+			continue;
+
+		if (const auto bit = shared->Subscribe(); bit != 0)
+			return std::make_unique<SharedConvert::Subscriber>(std::move(shared),
+									   bit);
+	}
+
+	auto shared = std::make_shared<SharedConvert>(key);
+	list.emplace_front(shared);
+
+	const auto bit = shared->Subscribe();
+	return std::make_unique<SharedConvert::Subscriber>(std::move(shared),
+							   bit);
+}
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_OUTPUT_SHARED_CONVERT_HXX
+#define MPD_OUTPUT_SHARED_CONVERT_HXX
+
+#include "pcm/AudioFormat.hxx"
+#include "pcm/Convert.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <forward_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct MusicChunk;
+
+/**
+ * Describes the PCM data which is passed to the final
+ * #ConvertFilter of an audio output.  Outputs with equal keys get
+ * the same input and can share the conversion.
+ */
+struct SharedConvertKey {
+	/**
+	 * The #AudioFormat of the #MusicPipe.
+	 */
+	AudioFormat in_format;
+
+	/**
+	 * The #AudioFormat sent to the device.
+	 */
+	AudioFormat out_format;
+
+	/**
+	 * Is the software ReplayGain filter applied to the samples?
+	 */
+	bool replay_gain;
+
+	constexpr bool operator==(const SharedConvertKey &) const noexcept = default;
+};
+
+/**
+ * One #PcmConvert instance (usually resampling with libsoxr) shared
+ * by all outputs of a partition which have the same
+ * #SharedConvertKey.  The first subscriber which asks for a
+ * #MusicChunk converts it; the others get a copy of the result.
+ * Since all outputs play the chunks of the #MusicPipe in order, the
+ * #PcmConvert sees a contiguous stream.
+ */
+class SharedConvert {
+	/**
+	 * Keep at most this many converted chunks for subscribers
+	 * which are lagging behind; beyond that, they have to use
+	 * their own #ConvertFilter.
+	 */
+	static constexpr std::size_t MAX_ENTRIES = 256;
+
+	const SharedConvertKey key;
+
+	Mutex mutex;
+
+	PcmConvert convert;
+
+	struct Entry {
+		uint_least64_t serial;
+
+		/**
+		 * A bit mask of subscribers which have not yet
+		 * fetched this entry.
+		 */
+		uint_least64_t pending;
+
+		std::vector<std::byte> data;
+	};
+
+	/**
+	 * Converted chunks which have not yet been fetched by all
+	 * subscribers, ordered by MusicChunk::serial.  Protected by
+	 * #mutex.
+	 */
+	std::deque<Entry> entries;
+
+	/**
+	 * The MusicChunk::serial of the last chunk which was passed
+	 * to #convert.  Protected by #mutex.
+	 */
+	uint_least64_t last_serial = 0;
+
+	/**
+	 * A bit mask of all subscribers.  Protected by #mutex.
+	 */
+	uint_least64_t subscribers = 0;
+
+	/**
+	 * Caller must lock #mutex.
+	 */
+	void DiscardLocked(uint_least64_t bit) noexcept;
+
+public:
+	class Subscriber;
+
+	/**
+	 * Throws on error.
+	 */
+	explicit SharedConvert(const SharedConvertKey &_key);
+
+	const SharedConvertKey &GetKey() const noexcept {
+		return key;
+	}
+
+	/**
+	 * @return the bit of the new subscriber or 0 if there are
+	 * already too many subscribers
+	 */
+	uint_least64_t Subscribe() noexcept;
+
+	void Unsubscribe(uint_least64_t bit) noexcept;
+
+	/**
+	 * Forget all chunks which have not yet been fetched by the
+	 * given subscriber (after a seek).
+	 */
+	void Discard(uint_least64_t bit) noexcept;
+
+	/**
+	 * Throws on error.
+	 *
+	 * @param dest the subscriber's buffer which receives the
+	 * converted data
+	 * @return false if the chunk has been converted before this
+	 * subscriber joined or after it has been discarded; the
+	 * caller must convert it with its own #ConvertFilter
+	 */
+	bool Convert(uint_least64_t bit, std::vector<std::byte> &dest,
+		     uint_least64_t serial, std::span<const std::byte> src);
+};
+
+/**
+ * The handle of one audio output which uses a #SharedConvert.
+ */
+class SharedConvert::Subscriber {
+	const std::shared_ptr<SharedConvert> parent;
+
+	const uint_least64_t bit;
+
+	std::vector<std::byte> buffer;
+
+public:
+	Subscriber(std::shared_ptr<SharedConvert> _parent,
+		   uint_least64_t _bit) noexcept
+		:parent(std::move(_parent)), bit(_bit) {}
+
+	~Subscriber() noexcept {
+		parent->Unsubscribe(bit);
+	}
+
+	Subscriber(const Subscriber &) = delete;
+	Subscriber &operator=(const Subscriber &) = delete;
+
+	const SharedConvertKey &GetKey() const noexcept {
+		return parent->GetKey();
+	}
+
+	void Cancel() noexcept {
+		parent->Discard(bit);
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return the converted data (valid until the next call) or
+	 * std::nullopt if the caller must convert the chunk itself
+	 */
+	std::optional<std::span<const std::byte>> Convert(const MusicChunk &chunk,
+							  std::span<const std::byte> src);
+};
+
+/**
+ * Manages the #SharedConvert instances of one partition.
+ */
+class SharedConvertRegistry {
+	Mutex mutex;
+
+	std::forward_list<std::weak_ptr<SharedConvert>> list;
+
+public:
+	/**
+	 * Join the #SharedConvert for the given key, creating it if
+	 * necessary.
+	 *
+	 * Throws on error.
+	 */
+	std::unique_ptr<SharedConvert::Subscriber> Subscribe(const SharedConvertKey &key);
+};
+
+#endif
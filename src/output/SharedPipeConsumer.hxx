@@ -16,6 +16,10 @@ class MusicPipe;
  * to be called from two distinct threads (PlayerThread=feeder and
  * OutputThread=consumer), all methods must be called with a mutex
  * locked to serialize access.  Usually, this is #AudioOutput::mutex.
+ *
+ * The #MusicPipe itself is never locked by this class; it walks the
+ * chunks with the lock-free MusicPipe::Peek() and
+ * MusicChunk::GetNext().
  */
 class SharedPipeConsumer {
 	/**
@@ -5,7 +5,10 @@
 #include "MusicChunk.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
+#include "filter/Observer.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "filter/plugins/VolumeFilterPlugin.hxx"
+#include "pcm/Volume.hxx"
 #include "pcm/Mix.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
@@ -14,34 +17,43 @@
 #include <string.h>
 
 AudioOutputSource::AudioOutputSource() noexcept = default;
-AudioOutputSource::~AudioOutputSource() noexcept = default;
+
+AudioOutputSource::~AudioOutputSource() noexcept
+{
+	CancelLookahead();
+}
 
 AudioFormat
 AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
 			PreparedFilter *prepared_replay_gain_filter,
 			PreparedFilter *prepared_other_replay_gain_filter,
-			PreparedFilter &prepared_filter)
+			PreparedFilter &prepared_filter,
+			FilterObserver *_replay_gain_volume_filter)
 {
 	assert(audio_format.IsValid());
 
 	if (!IsOpen() || &_pipe != &pipe.GetPipe()) {
+		CancelLookahead();
 		current_chunk = nullptr;
 		pipe.Init(_pipe);
 	}
 
 	/* (re)open the filter */
 
-	if (filter && audio_format != in_audio_format)
+	if (filter && audio_format != in_audio_format) {
 		/* the filter must be reopened on all input format
 		   changes */
+		DiscardLookahead();
 		CloseFilter();
+	}
 
 	if (filter == nullptr)
 		/* open the filter */
 		OpenFilter(audio_format,
 			   prepared_replay_gain_filter,
 			   prepared_other_replay_gain_filter,
-			   prepared_filter);
+			   prepared_filter,
+			   _replay_gain_volume_filter);
 
 	in_audio_format = audio_format;
 	return filter->GetOutAudioFormat();
@@ -51,8 +63,11 @@ void
 AudioOutputSource::Close() noexcept
 {
 	assert(in_audio_format.IsValid());
-	in_audio_format.Clear();
 
+	CancelLookahead();
+
+	in_audio_format.Clear();
+	shared_convert.reset();
 	CloseFilter();
 
 	Cancel();
@@ -61,9 +76,14 @@ AudioOutputSource::Close() noexcept
 void
 AudioOutputSource::Cancel() noexcept
 {
+	CancelLookahead();
+
 	current_chunk = nullptr;
 	pipe.Cancel();
 
+	if (shared_convert)
+		shared_convert->Cancel();
+
 	if (replay_gain_filter)
 		replay_gain_filter->Reset();
 
@@ -78,10 +98,13 @@ inline void
 AudioOutputSource::OpenFilter(AudioFormat audio_format,
 			      PreparedFilter *prepared_replay_gain_filter,
 			      PreparedFilter *prepared_other_replay_gain_filter,
-			      PreparedFilter &prepared_filter)
+			      PreparedFilter &prepared_filter,
+			      FilterObserver *_replay_gain_volume_filter)
 try {
 	assert(audio_format.IsValid());
 
+	[[maybe_unused]] const AudioFormat in_format = audio_format;
+
 	/* the replay_gain filter cannot fail here */
 	if (prepared_other_replay_gain_filter) {
 		other_replay_gain_serial = 0;
@@ -101,6 +124,14 @@ try {
 	}
 
 	filter = prepared_filter.Open(audio_format);
+
+	if (_replay_gain_volume_filter != nullptr && replay_gain_filter) {
+		/* skipping the ReplayGainFilter must not change
+		   the input of the filter chain */
+		assert(audio_format == in_format);
+
+		replay_gain_volume_filter = _replay_gain_volume_filter->Get();
+	}
 } catch (...) {
 	CloseFilter();
 	throw;
@@ -109,6 +140,7 @@ try {
 void
 AudioOutputSource::CloseFilter() noexcept
 {
+	replay_gain_volume_filter = nullptr;
 	replay_gain_filter.reset();
 	other_replay_gain_filter.reset();
 	filter.reset();
@@ -117,7 +149,8 @@ AudioOutputSource::CloseFilter() noexcept
 std::span<const std::byte>
 AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 				Filter *current_replay_gain_filter,
-				unsigned *replay_gain_serial_p)
+				unsigned *replay_gain_serial_p,
+				bool apply_replay_gain)
 {
 	assert(!chunk.IsEmpty());
 	assert(chunk.CheckFormat(in_audio_format));
@@ -140,7 +173,8 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 
 		/* note: the ReplayGainFilter doesn't have a
 		   ReadMore() method */
-		data = current_replay_gain_filter->FilterPCM(data);
+		if (apply_replay_gain)
+			data = current_replay_gain_filter->FilterPCM(data);
 	}
 
 	return data;
@@ -151,11 +185,22 @@ AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 {
 	assert(filter);
 
+	/* while cross-fading, each song's ReplayGain must be applied
+	   before mixing, so it cannot be fused with the volume */
+	const bool fuse_replay_gain = replay_gain_volume_filter != nullptr &&
+		chunk.other == nullptr;
+
 	auto data = GetChunkData(chunk, replay_gain_filter.get(),
-				 &replay_gain_serial);
+				 &replay_gain_serial, !fuse_replay_gain);
 	if (data.empty())
 		return data;
 
+	if (replay_gain_volume_filter != nullptr)
+		volume_filter_set_gain(replay_gain_volume_filter,
+				       fuse_replay_gain
+				       ? replay_gain_filter_get_volume(*replay_gain_filter)
+				       : PCM_VOLUME_1);
+
 	/* cross-fade */
 
 	if (chunk.other != nullptr) {
@@ -195,9 +240,161 @@ AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 
 	/* apply filter chain */
 
+	if (shared_convert)
+		if (const auto result = shared_convert->Convert(chunk, data))
+			return *result;
+
 	return filter->FilterPCM(data);
 }
 
+inline void
+AudioOutputSource::StartLookahead() noexcept
+{
+	assert(lookahead_pool != nullptr);
+
+	if (lookahead_running || lookahead_ready.size() >= lookahead)
+		return;
+
+	lookahead_running = true;
+	lookahead_pool->Push(lookahead_job);
+}
+
+void
+AudioOutputSource::WaitLookahead(std::unique_lock<Mutex> &lock) noexcept
+{
+	if (lookahead_running && lookahead_pool->Cancel(lookahead_job))
+		/* it was still queued */
+		lookahead_running = false;
+
+	lookahead_cancel = true;
+	lookahead_cond.wait(lock, [this]{ return !lookahead_running; });
+	lookahead_cancel = false;
+}
+
+void
+AudioOutputSource::DiscardLookahead() noexcept
+{
+	if (lookahead_pool == nullptr)
+		return;
+
+	std::unique_lock lock{lookahead_mutex};
+	WaitLookahead(lock);
+
+	lookahead_spare.splice(lookahead_spare.end(), lookahead_ready);
+	lookahead_last = current_chunk;
+}
+
+void
+AudioOutputSource::CancelLookahead() noexcept
+{
+	if (lookahead_pool == nullptr)
+		return;
+
+	std::unique_lock lock{lookahead_mutex};
+	WaitLookahead(lock);
+
+	lookahead_spare.splice(lookahead_spare.end(), lookahead_ready);
+	lookahead_spare.splice(lookahead_spare.end(), lookahead_current);
+	lookahead_last = nullptr;
+}
+
+void
+AudioOutputSource::RunLookahead() noexcept
+{
+	std::unique_lock lock{lookahead_mutex};
+
+	while (!lookahead_cancel && lookahead_ready.size() < lookahead) {
+		const MusicChunk *chunk = lookahead_last != nullptr
+			? lookahead_last->GetNext()
+			: lookahead_start;
+		if (chunk == nullptr)
+			/* the pipe has run empty; Fill() will
+			   resubmit this job */
+			break;
+
+		if (lookahead_spare.empty())
+			lookahead_spare.emplace_back();
+
+		/* the output thread only appends to
+		   #lookahead_spare, therefore this iterator remains
+		   at the front while the mutex is unlocked */
+		const auto i = lookahead_spare.begin();
+		i->chunk = chunk;
+		i->data.clear();
+		i->error = nullptr;
+
+		{
+			const ScopeUnlock unlock{lookahead_mutex};
+
+			try {
+				for (auto src = FilterChunk(*chunk); !src.empty();
+				     src = filter->ReadMore())
+					i->data.insert(i->data.end(),
+						       src.begin(), src.end());
+			} catch (...) {
+				i->error = std::current_exception();
+			}
+		}
+
+		const bool failed = i->error != nullptr;
+		lookahead_ready.splice(lookahead_ready.end(),
+				       lookahead_spare, i);
+		lookahead_last = chunk;
+		lookahead_cond.notify_all();
+
+		if (failed)
+			/* the filter state is undefined now; the
+			   error will be rethrown by Fill() */
+			break;
+	}
+
+	lookahead_running = false;
+	lookahead_cond.notify_all();
+}
+
+std::span<const std::byte>
+AudioOutputSource::FillLookahead(const MusicChunk &chunk)
+{
+	assert(lookahead_current.empty());
+
+	std::unique_lock lock{lookahead_mutex};
+
+	if (lookahead_last == nullptr) {
+		assert(lookahead_ready.empty());
+		lookahead_start = &chunk;
+	}
+
+	if (lookahead_ready.empty())
+		StartLookahead();
+
+	lookahead_cond.wait(lock, [this]{
+		return !lookahead_ready.empty() || !lookahead_running;
+	});
+
+	/* the job only stops without progress if the pipe is
+	   empty, but we know there's at least this chunk */
+	assert(!lookahead_ready.empty());
+
+	auto &slot = lookahead_ready.front();
+	assert(slot.chunk == &chunk);
+
+	lookahead_current.splice(lookahead_current.end(),
+				 lookahead_ready, lookahead_ready.begin());
+
+	if (slot.error) {
+		auto error = std::move(slot.error);
+		lookahead_spare.splice(lookahead_spare.end(),
+				       lookahead_current);
+		std::rethrow_exception(std::move(error));
+	}
+
+	/* prepare the next chunks while this one is being
+	   played */
+	StartLookahead();
+
+	return slot.data;
+}
+
 bool
 AudioOutputSource::Fill(Mutex &mutex)
 {
@@ -221,7 +418,9 @@ AudioOutputSource::Fill(Mutex &mutex)
 		   that may take a while */
 		const ScopeUnlock unlock(mutex);
 
-		pending_data = FilterChunk(*current_chunk);
+		pending_data = lookahead_pool != nullptr
+			? FillLookahead(*current_chunk)
+			: FilterChunk(*current_chunk);
 	} catch (...) {
 		current_chunk = nullptr;
 		throw;
@@ -239,18 +438,35 @@ AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 
 	if (pending_data.empty()) {
 		/* give the filter a chance to return more data in
-		   another buffer */
-		pending_data = filter->ReadMore();
+		   another buffer (the #LookaheadJob has already
+		   collected all of it) */
+		if (lookahead_pool == nullptr)
+			pending_data = filter->ReadMore();
 
 		if (pending_data.empty())
 			DropCurrentChunk();
 	}
 }
 
+std::chrono::steady_clock::time_point
+AudioOutputSource::GetSubmitTime() const noexcept
+{
+	assert(current_chunk != nullptr);
+
+	return current_chunk->submit_time;
+}
+
 std::span<const std::byte>
 AudioOutputSource::Flush()
 {
 	assert(filter);
 
+	if (lookahead_pool != nullptr) {
+		/* the filter is owned by the #LookaheadJob while it
+		   runs */
+		std::unique_lock lock{lookahead_mutex};
+		lookahead_cond.wait(lock, [this]{ return !lookahead_running; });
+	}
+
 	return filter->Flush();
 }
@@ -5,30 +5,71 @@
 #define AUDIO_OUTPUT_SOURCE_HXX
 
 #include "SharedPipeConsumer.hxx"
+#include "SharedConvert.hxx"
 #include "ReplayGainMode.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "pcm/Buffer.hxx"
 #include "pcm/Dither.hxx"
 #include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/WorkerPool.hxx"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <exception>
+#include <list>
 #include <memory>
 #include <span>
 #include <utility>
+#include <vector>
 
 struct MusicChunk;
 struct Tag;
 class Filter;
 class PreparedFilter;
+class FilterObserver;
 
 /**
  * Source of audio data to be played by an #AudioOutput.  It receives
  * #MusicChunk instances from a #MusicPipe (via #SharedPipeConsumer).
  * It applies configured filters, ReplayGain and returns plain PCM
  * data.
+ *
+ * Optionally, the filters run in a #WorkerPool a few chunks ahead of
+ * the chunk being played ("lookahead"), so the output thread only
+ * copies prepared data to the device.
  */
 class AudioOutputSource {
+	/**
+	 * The filtered data of one #MusicChunk, prepared by the
+	 * #LookaheadJob.
+	 */
+	struct LookaheadSlot {
+		const MusicChunk *chunk;
+
+		/**
+		 * The output of the filter including everything
+		 * returned by Filter::ReadMore().
+		 */
+		std::vector<std::byte> data;
+
+		std::exception_ptr error;
+	};
+
+	class LookaheadJob final : public WorkerJob {
+		AudioOutputSource &source;
+
+	public:
+		explicit LookaheadJob(AudioOutputSource &_source) noexcept
+			:source(_source) {}
+
+		/* virtual methods from class WorkerJob */
+		void Run() noexcept override {
+			source.RunLookahead();
+		}
+	};
+
 	/**
 	 * The audio_format in which audio data is received from the
 	 * player thread (which in turn receives it from the decoder).
@@ -67,6 +108,15 @@ class AudioOutputSource {
 	 */
 	std::unique_ptr<Filter> other_replay_gain_filter;
 
+	/**
+	 * If set, then this #VolumeFilter (the first one in #filter)
+	 * applies the ReplayGain calculated by #replay_gain_filter in
+	 * the same pass as the software volume, and
+	 * #replay_gain_filter itself is only used during
+	 * cross-fading.
+	 */
+	Filter *replay_gain_volume_filter = nullptr;
+
 	/**
 	 * The buffer used to allocate the cross-fading result.
 	 */
@@ -83,6 +133,14 @@ class AudioOutputSource {
 	 */
 	std::unique_ptr<Filter> filter;
 
+	/**
+	 * If set, then the final conversion (which is otherwise done
+	 * by the #ConvertFilter at the end of #filter) is shared with
+	 * other outputs.  This is only used if #filter contains
+	 * nothing else.
+	 */
+	std::unique_ptr<SharedConvert::Subscriber> shared_convert;
+
 	/**
 	 * The #MusicChunk currently being processed (see
 	 * #pending_tag, #pending_data).
@@ -101,6 +159,65 @@ class AudioOutputSource {
 	 */
 	std::span<const std::byte> pending_data;
 
+	/**
+	 * The #WorkerPool which runs the filters ahead of time.  If
+	 * this is nullptr, then the filters run inline in Fill().
+	 */
+	WorkerPool *lookahead_pool = nullptr;
+
+	/**
+	 * The maximum number of chunks filtered ahead of
+	 * #current_chunk.
+	 */
+	unsigned lookahead = 0;
+
+	LookaheadJob lookahead_job{*this};
+
+	/**
+	 * Protects the "lookahead_" attributes below.  While
+	 * #lookahead_running is set, the filters are owned by the
+	 * #LookaheadJob.
+	 */
+	Mutex lookahead_mutex;
+
+	/**
+	 * Signalled by the #LookaheadJob after each chunk and when it
+	 * finishes.
+	 */
+	Cond lookahead_cond;
+
+	/**
+	 * Chunks which have been filtered but not yet been returned
+	 * by Fill(), in pipe order.
+	 */
+	std::list<LookaheadSlot> lookahead_ready;
+
+	/**
+	 * The slot of #current_chunk; #pending_data points into it.
+	 */
+	std::list<LookaheadSlot> lookahead_current;
+
+	/**
+	 * Unused slots, kept to reuse their buffers.
+	 */
+	std::list<LookaheadSlot> lookahead_spare;
+
+	/**
+	 * The chunk which was filtered most recently by the
+	 * #LookaheadJob; the next one is its successor.  If nullptr,
+	 * then the #LookaheadJob starts at #lookahead_start.
+	 */
+	const MusicChunk *lookahead_last = nullptr;
+
+	const MusicChunk *lookahead_start = nullptr;
+
+	bool lookahead_running = false;
+
+	/**
+	 * Shall the #LookaheadJob stop as soon as possible?
+	 */
+	bool lookahead_cancel = false;
+
 public:
 	AudioOutputSource() noexcept;
 	~AudioOutputSource() noexcept;
@@ -109,20 +226,55 @@ public:
 		replay_gain_mode = _mode;
 	}
 
+	/**
+	 * Run the filters in the given #WorkerPool, up to the given
+	 * number of chunks ahead.  Must be called before Open().
+	 */
+	void EnableLookahead(WorkerPool &pool, unsigned n) noexcept {
+		assert(!IsOpen());
+		assert(n > 0);
+
+		lookahead_pool = &pool;
+		lookahead = n;
+	}
+
 	bool IsOpen() const {
 		return in_audio_format.IsDefined();
 	}
 
+	[[gnu::pure]]
+	const SharedConvertKey *GetSharedConvertKey() const noexcept {
+		return shared_convert ? &shared_convert->GetKey() : nullptr;
+	}
+
+	/**
+	 * Replace the final #ConvertFilter with the given
+	 * #SharedConvert (or stop using it if nullptr is passed).
+	 */
+	void SetSharedConvert(std::unique_ptr<SharedConvert::Subscriber> _shared_convert) noexcept {
+		DiscardLookahead();
+		shared_convert = std::move(_shared_convert);
+	}
+
 	const AudioFormat &GetInputAudioFormat() const {
 		assert(IsOpen());
 
 		return in_audio_format;
 	}
 
+	/**
+	 * @param replay_gain_volume_filter if not nullptr, then
+	 * this observes the #VolumeFilter at the beginning of
+	 * #prepared_filter, and the ReplayGain shall be applied by
+	 * it (see volume_filter_set_gain()); this requires a
+	 * #prepared_replay_gain_filter which does not change the
+	 * sample format
+	 */
 	AudioFormat Open(AudioFormat audio_format, const MusicPipe &_pipe,
 			 PreparedFilter *prepared_replay_gain_filter,
 			 PreparedFilter *prepared_other_replay_gain_filter,
-			 PreparedFilter &prepared_filter);
+			 PreparedFilter &prepared_filter,
+			 FilterObserver *replay_gain_volume_filter);
 
 	void Close() noexcept;
 	void Cancel() noexcept;
@@ -167,6 +319,14 @@ public:
 	 */
 	void ConsumeData(size_t nbytes) noexcept;
 
+	/**
+	 * Returns MusicChunk::submit_time of the chunk being
+	 * played.  Be sure to call Fill() successfully before
+	 * calling this method.
+	 */
+	[[gnu::pure]]
+	std::chrono::steady_clock::time_point GetSubmitTime() const noexcept;
+
 	bool IsChunkConsumed(const MusicChunk &chunk) const  noexcept {
 		assert(IsOpen());
 
@@ -186,19 +346,69 @@ private:
 	void OpenFilter(AudioFormat audio_format,
 			PreparedFilter *prepared_replay_gain_filter,
 			PreparedFilter *prepared_other_replay_gain_filter,
-			PreparedFilter &prepared_filter);
+			PreparedFilter &prepared_filter,
+			FilterObserver *_replay_gain_volume_filter);
 
 	void CloseFilter() noexcept;
 
+	/**
+	 * @param apply_replay_gain false if the ReplayGain is
+	 * applied by #replay_gain_volume_filter; the
+	 * #replay_gain_filter is updated, but not invoked
+	 */
 	std::span<const std::byte> GetChunkData(const MusicChunk &chunk,
 						Filter *replay_gain_filter,
-						unsigned *replay_gain_serial_p);
+						unsigned *replay_gain_serial_p,
+						bool apply_replay_gain=true);
 
 	std::span<const std::byte> FilterChunk(const MusicChunk &chunk);
 
+	/**
+	 * Obtain the filtered data of the given chunk from the
+	 * #LookaheadJob, and schedule the following chunks.
+	 *
+	 * Throws if the filter has failed.
+	 */
+	std::span<const std::byte> FillLookahead(const MusicChunk &chunk);
+
+	/**
+	 * Submit the #LookaheadJob unless it is already running.
+	 * Caller must lock #lookahead_mutex.
+	 */
+	void StartLookahead() noexcept;
+
+	/**
+	 * Wait for the #LookaheadJob to finish, so the caller may
+	 * access the filters.  Caller must lock #lookahead_mutex.
+	 */
+	void WaitLookahead(std::unique_lock<Mutex> &lock) noexcept;
+
+	/**
+	 * Stop the #LookaheadJob and discard all prepared chunks
+	 * after #current_chunk.
+	 */
+	void DiscardLookahead() noexcept;
+
+	/**
+	 * Like DiscardLookahead(), but discard #current_chunk's slot
+	 * as well.
+	 */
+	void CancelLookahead() noexcept;
+
+	/**
+	 * Runs in a #WorkerPool thread.
+	 */
+	void RunLookahead() noexcept;
+
 	void DropCurrentChunk() noexcept {
 		assert(current_chunk != nullptr);
 
+		if (!lookahead_current.empty()) {
+			const std::scoped_lock lock{lookahead_mutex};
+			lookahead_spare.splice(lookahead_spare.end(),
+					       lookahead_current);
+		}
+
 		pipe.Consume(*std::exchange(current_chunk, nullptr));
 	}
 };
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_OUTPUT_STATS_HXX
+#define MPD_OUTPUT_STATS_HXX
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Performance counters of one #AudioOutputControl.  All counters
+ * accumulate over the lifetime of the output, except for the
+ * #buffered fields which are reset when the output is closed.
+ */
+struct AudioOutputStats {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The number of bytes passed to AudioOutput::Play().
+	 */
+	uint_least64_t played_bytes = 0;
+
+	/**
+	 * The number of buffer underruns reported by the device
+	 * (e.g. ALSA "xruns"); see AudioOutput::GetUnderrunCount().
+	 */
+	uint_least64_t device_underruns = 0;
+
+	/**
+	 * The number of times the output thread has found the
+	 * #MusicPipe empty while playing and had to wait for the
+	 * next chunk.
+	 */
+	uint_least64_t pipe_underruns = 0;
+
+	/**
+	 * The total time spent inside AudioOutput::Play(), i.e.
+	 * mostly waiting for the device to accept more data.
+	 */
+	Duration play_time{};
+
+	/**
+	 * The total time the output thread had to wait for the next
+	 * chunk (see #pipe_underruns).
+	 */
+	Duration pipe_wait_time{};
+
+	/**
+	 * The total time spent running the filters.
+	 */
+	Duration filter_time{};
+
+	/**
+	 * The amount of data buffered by the device after the most
+	 * recent AudioOutput::Play() call, and the minimum since the
+	 * output was opened; zero if the plugin does not implement
+	 * AudioOutput::GetBufferedDuration().
+	 */
+	Duration buffered{}, buffered_min{};
+};
+
+#endif
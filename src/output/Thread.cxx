@@ -9,7 +9,6 @@
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
-#include "thread/Util.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
 #include "util/StringBuffer.hxx"
@@ -65,10 +64,38 @@ AudioOutputControl::InternalOpen2(const AudioFormat in_audio_format)
 
 	{
 		const ScopeUnlock unlock(mutex);
+		UpdateSharedConvert();
 		output->OpenSoftwareMixer();
 	}
 }
 
+void
+AudioOutputControl::UpdateSharedConvert() noexcept
+{
+	if (shared_convert_registry == nullptr)
+		return;
+
+	const auto key =
+		output->GetSharedConvertKey(source.GetInputAudioFormat());
+	const auto *current = source.GetSharedConvertKey();
+	if (key ? current != nullptr && *current == *key : current == nullptr)
+		/* no change */
+		return;
+
+	std::unique_ptr<SharedConvert::Subscriber> subscriber;
+	if (key) {
+		try {
+			subscriber = shared_convert_registry->Subscribe(*key);
+		} catch (...) {
+			FmtError(output_domain,
+				 "Failed to share conversion for {}: {}",
+				 GetLogName(), std::current_exception());
+		}
+	}
+
+	source.SetSharedConvert(std::move(subscriber));
+}
+
 inline bool
 AudioOutputControl::InternalEnable() noexcept
 {
@@ -127,7 +154,10 @@ AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 			f = source.Open(in_audio_format, pipe,
 					output->prepared_replay_gain_filter.get(),
 					output->prepared_other_replay_gain_filter.get(),
-					*output->prepared_filter);
+					*output->prepared_filter,
+					output->fused_replay_gain
+					? &output->volume_filter
+					: nullptr);
 		} catch (...) {
 			std::throw_with_nested(FmtRuntimeError("Failed to open filter for {}",
 							       GetLogName()));
@@ -167,6 +197,8 @@ AudioOutputControl::InternalClose(bool drain) noexcept
 	assert(IsOpen());
 
 	open = false;
+	latency = {};
+	stats.buffered = stats.buffered_min = {};
 
 	{
 		const ScopeUnlock unlock(mutex);
@@ -210,6 +242,11 @@ AudioOutputControl::WaitForDelay(std::unique_lock<Mutex> &lock) noexcept
 inline bool
 AudioOutputControl::FillSourceOrClose() noexcept
 try {
+	const auto start = std::chrono::steady_clock::now();
+	AtScopeExit(this, start) {
+		stats.filter_time += std::chrono::steady_clock::now() - start;
+	};
+
 	return source.Fill(mutex);
 } catch (...) {
 	FmtError(output_domain,
@@ -249,6 +286,7 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 			break;
 
 		size_t nbytes;
+		const auto play_start = std::chrono::steady_clock::now();
 
 		try {
 			const ScopeUnlock unlock(mutex);
@@ -268,6 +306,24 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 
 		assert(nbytes % output->out_audio_format.GetFrameSize() == 0);
 
+		const auto now = std::chrono::steady_clock::now();
+		const auto buffered = output->GetBufferedDuration();
+
+		stats.played_bytes += nbytes;
+		stats.play_time += now - play_start;
+		stats.device_underruns = output->GetUnderrunCount();
+
+		if (buffered > std::chrono::steady_clock::duration::zero()) {
+			if (stats.buffered_min == std::chrono::steady_clock::duration::zero() ||
+			    buffered < stats.buffered_min)
+				stats.buffered_min = buffered;
+			stats.buffered = buffered;
+		}
+
+		if (const auto submit_time = source.GetSubmitTime();
+		    submit_time != std::chrono::steady_clock::time_point{})
+			latency = now - submit_time + buffered;
+
 		source.ConsumeData(nbytes);
 
 		/* there's data to be drained from now on */
@@ -280,9 +336,26 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 inline bool
 AudioOutputControl::InternalPlay(std::unique_lock<Mutex> &lock) noexcept
 {
-	if (!FillSourceOrClose())
+	if (!FillSourceOrClose()) {
 		/* no chunk available */
+		if (playing &&
+		    pipe_wait_start == std::chrono::steady_clock::time_point{})
+			pipe_wait_start = std::chrono::steady_clock::now();
 		return false;
+	}
+
+	if (pipe_wait_start != std::chrono::steady_clock::time_point{}) {
+		/* count this only if the output hasn't been stopped
+		   (or drained) in the meantime; running out of data
+		   at the end of the playlist is not an underrun */
+		if (playing) {
+			++stats.pipe_underruns;
+			stats.pipe_wait_time += std::chrono::steady_clock::now()
+				- pipe_wait_start;
+		}
+
+		pipe_wait_start = {};
+	}
 
 	assert(!in_playback_loop);
 	in_playback_loop = true;
@@ -411,10 +484,10 @@ AudioOutputControl::Task() noexcept
 	FmtThreadName("output:{}", GetName());
 
 	try {
-		SetThreadRealtime();
+		scheduling.Apply(true);
 	} catch (...) {
 		FmtInfo(output_domain,
-			"OutputThread could not get realtime scheduling, continuing anyway: {}",
+			"OutputThread could not apply scheduling settings, continuing anyway: {}",
 			std::current_exception());
 	}
 
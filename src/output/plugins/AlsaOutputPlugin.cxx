@@ -33,6 +33,7 @@
 
 #include <alsa/asoundlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <string>
 #include <forward_list>
@@ -131,14 +132,39 @@ class AlsaOutput final
 	snd_pcm_sframes_t max_avail_frames;
 
 	/** libasound's buffer_time setting (in microseconds) */
-	const unsigned buffer_time;
+	unsigned buffer_time;
 
 	/** libasound's period_time setting (in microseconds) */
-	const unsigned period_time;
+	unsigned period_time;
+
+	/**
+	 * Were #buffer_time or #period_time configured explicitly?
+	 * If yes, then SetLatencyTarget() does not override them.
+	 */
+	const bool explicit_buffer_time;
+
+	/**
+	 * The value of snd_pcm_delay() after the most recent write,
+	 * for GetBufferedDuration().
+	 */
+	std::atomic<snd_pcm_sframes_t> hw_delay_frames{0};
+
+	/**
+	 * The number of underruns ("xruns") handled by Recover(), for
+	 * GetUnderrunCount().
+	 */
+	std::atomic<uint_least64_t> underruns{0};
 
 	/** the mode flags passed to snd_pcm_open */
 	const int mode;
 
+	/**
+	 * Use SND_PCM_ACCESS_MMAP_INTERLEAVED and copy from
+	 * #ring_buffer directly to the hardware buffer, bypassing
+	 * #period_buffer and snd_pcm_writei()?
+	 */
+	const bool use_mmap;
+
 #ifdef ENABLE_DSD
 	/**
 	 * Enable DSD over PCM according to the DoP standard?
@@ -270,8 +296,15 @@ private:
 	void Open(AudioFormat &audio_format) override;
 	void Close() noexcept override;
 
+	void SetLatencyTarget(std::chrono::steady_clock::duration target) noexcept override;
+
 	void Interrupt() noexcept override;
 	std::chrono::steady_clock::duration Delay() const noexcept override;
+	std::chrono::steady_clock::duration GetBufferedDuration() const noexcept override;
+
+	uint_least64_t GetUnderrunCount() const noexcept override {
+		return underruns.load(std::memory_order_relaxed);
+	}
 
 	std::size_t Play(std::span<const std::byte> src) override;
 	void Drain() override;
@@ -368,6 +401,25 @@ private:
 
 	snd_pcm_sframes_t WriteFromPeriodBuffer() noexcept;
 
+	/**
+	 * Is there at least one period of data in #ring_buffer?  Only
+	 * used with #use_mmap.
+	 */
+	bool IsRingPeriodAvailable() const noexcept {
+		return ring_buffer.ReadAvailable() >= period_frames * out_frame_size;
+	}
+
+	/**
+	 * Copy one period of data from the #ring_buffer to the
+	 * hardware buffer, filling it up with #silence if there is
+	 * too little data.  Only used with #use_mmap; this replaces
+	 * CopyRingToPeriodBuffer() and WriteFromPeriodBuffer().
+	 *
+	 * @return the number of frames committed or a negative error
+	 * code
+	 */
+	snd_pcm_sframes_t WriteRingToMmap() noexcept;
+
 	void LockCaughtError() noexcept {
 		period_buffer.Clear();
 
@@ -433,7 +485,10 @@ AlsaOutput::AlsaOutput(EventLoop &_loop, const ConfigBlock &block)
 	 buffer_time(block.GetPositiveValue("buffer_time",
 					    MPD_ALSA_BUFFER_TIME_US)),
 	 period_time(block.GetPositiveValue("period_time", 0U)),
+	 explicit_buffer_time(block.GetBlockParam("buffer_time") != nullptr ||
+			      block.GetBlockParam("period_time") != nullptr),
 	 mode(GetAlsaOpenMode(block)),
+	 use_mmap(block.GetBlockValue("mmap", false)),
 #ifdef ENABLE_DSD
 	 dop_setting(block.GetBlockValue("dop", false) ||
 		     /* legacy name from MPD 0.18 and older: */
@@ -546,7 +601,7 @@ AlsaOutput::Setup(AudioFormat &audio_format,
 		  PcmExport::Params &params)
 {
 	const auto hw_result = Alsa::SetupHw(pcm,
-					     buffer_time, period_time,
+					     buffer_time, period_time, use_mmap,
 					     audio_format, params);
 
 	FmtDebug(alsa_output_domain, "format={} ({})",
@@ -864,6 +919,7 @@ AlsaOutput::Open(AudioFormat &audio_format)
 	waiting = false;
 	must_prepare = false;
 	written = false;
+	hw_delay_frames = 0;
 	error = {};
 }
 
@@ -879,6 +935,23 @@ AlsaOutput::Interrupt() noexcept
 	cond.notify_one();
 }
 
+void
+AlsaOutput::SetLatencyTarget(std::chrono::steady_clock::duration target) noexcept
+{
+	if (explicit_buffer_time)
+		return;
+
+	/* the hardware buffer and our ring_buffer (four periods,
+	   i.e. the same size) get one half each */
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(target / 2);
+	buffer_time = std::max<unsigned>(us.count(), 1000);
+	period_time = buffer_time / 4;
+
+	FmtDebug(alsa_output_domain,
+		 "latency_target: buffer_time={} period_time={}",
+		 buffer_time, period_time);
+}
+
 std::chrono::steady_clock::duration
 AlsaOutput::Delay() const noexcept
 {
@@ -888,10 +961,22 @@ AlsaOutput::Delay() const noexcept
 	return AudioOutput::Delay();
 }
 
+std::chrono::steady_clock::duration
+AlsaOutput::GetBufferedDuration() const noexcept
+{
+	if (!ring_buffer.IsDefined() || period_frames == 0)
+		return std::chrono::steady_clock::duration::zero();
+
+	const auto frames = ring_buffer.ReadAvailable() / out_frame_size
+		+ std::max<snd_pcm_sframes_t>(hw_delay_frames.load(std::memory_order_relaxed), 0);
+	return effective_period_duration * frames / period_frames;
+}
+
 inline int
 AlsaOutput::Recover(int err) noexcept
 {
 	if (err == -EPIPE) {
+		underruns.fetch_add(1, std::memory_order_relaxed);
 		FmtDebug(alsa_output_domain,
 			 "Underrun on ALSA device {:?}",
 			 GetDevice());
@@ -978,6 +1063,49 @@ AlsaOutput::WriteFromPeriodBuffer() noexcept
 	return frames_written;
 }
 
+snd_pcm_sframes_t
+AlsaOutput::WriteRingToMmap() noexcept
+{
+	assert(use_mmap);
+
+	const auto avail = snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		return avail;
+
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames = period_frames;
+	int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+	if (err < 0)
+		return err;
+
+	if (frames == 0)
+		return -EAGAIN;
+
+	/* with interleaved access, all channels share one area */
+	const std::span<std::byte> dest{
+		static_cast<std::byte *>(areas[0].addr)
+		+ areas[0].first / 8 + offset * (areas[0].step / 8),
+		frames * out_frame_size,
+	};
+
+	const size_t nbytes = ring_buffer.ReadTo(dest);
+	if (nbytes > 0) {
+		const std::scoped_lock lock{mutex};
+		/* notify the OutputThread that there is now
+		   room in ring_buffer */
+		cond.notify_one();
+	}
+
+	/* insert some silence if the buffer has not enough data */
+	std::copy_n(silence, dest.size() - nbytes, dest.data() + nbytes);
+
+	const auto frames_written = snd_pcm_mmap_commit(pcm, offset, frames);
+	if (frames_written > 0)
+		written = true;
+
+	return frames_written;
+}
+
 inline bool
 AlsaOutput::DrainInternal()
 {
@@ -989,12 +1117,33 @@ AlsaOutput::DrainInternal()
 		in_stop_dsd_silence = false;
 		ring_buffer.Clear();
 		period_buffer.Clear();
-		period_buffer.FillWithSilence(silence, out_frame_size);
+
+		if (use_mmap)
+			/* with an empty ring_buffer, this writes one
+			   period of silence */
+			WriteRingToMmap();
+		else
+			period_buffer.FillWithSilence(silence, out_frame_size);
 	}
 #endif
 
-	/* drain ring_buffer */
-	CopyRingToPeriodBuffer();
+	if (use_mmap) {
+		/* drain ring_buffer directly into the hardware
+		   buffer; the last period is padded with silence */
+		if (ring_buffer.ReadAvailable() > 0) {
+			auto frames_written = WriteRingToMmap();
+			if (frames_written < 0 &&
+			    frames_written != -EAGAIN && frames_written != -EINTR &&
+			    Recover(frames_written) < 0)
+				throw Alsa::MakeError(frames_written,
+						      "snd_pcm_mmap_commit() failed");
+
+			/* check again in the next iteration */
+			return false;
+		}
+	} else
+		/* drain ring_buffer */
+		CopyRingToPeriodBuffer();
 
 	/* drain period_buffer */
 	if (!period_buffer.IsCleared()) {
@@ -1283,9 +1432,15 @@ try {
 		}
 	}
 
-	CopyRingToPeriodBuffer();
+	bool have_period;
+	if (use_mmap) {
+		have_period = IsRingPeriodAvailable();
+	} else {
+		CopyRingToPeriodBuffer();
+		have_period = period_buffer.IsFull();
+	}
 
-	if (!period_buffer.IsFull()) {
+	if (!have_period) {
 		if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED ||
 		    snd_pcm_avail(pcm) <= max_avail_frames) {
 			/* at SND_PCM_STATE_PREPARED (not yet switched
@@ -1313,7 +1468,9 @@ try {
 			   arrived meanwhile before disabling the
 			   event (but after setting the "waiting"
 			   flag) */
-			if (!CopyRingToPeriodBuffer()) {
+			if (use_mmap
+			    ? !IsRingPeriodAvailable()
+			    : !CopyRingToPeriodBuffer()) {
 				UnregisterSockets();
 
 				/* just in case Play() doesn't get
@@ -1335,11 +1492,20 @@ try {
 			LogWarning(alsa_output_domain, "Decoder is too slow; playing silence to avoid xrun");
 
 		/* insert some silence if the buffer has not enough
-		   data yet, to avoid ALSA xrun */
-		period_buffer.FillWithSilence(silence, out_frame_size);
+		   data yet, to avoid ALSA xrun (WriteRingToMmap()
+		   does this by itself) */
+		if (!use_mmap)
+			period_buffer.FillWithSilence(silence, out_frame_size);
+	}
+
+	auto frames_written = use_mmap
+		? WriteRingToMmap()
+		: WriteFromPeriodBuffer();
+	if (frames_written > 0) {
+		if (snd_pcm_sframes_t delay; snd_pcm_delay(pcm, &delay) == 0)
+			hw_delay_frames.store(delay, std::memory_order_relaxed);
 	}
 
-	auto frames_written = WriteFromPeriodBuffer();
 	if (frames_written < 0) {
 		if (frames_written == -EAGAIN || frames_written == -EINTR)
 			/* try again in the next DispatchSockets()
@@ -1348,7 +1514,9 @@ try {
 
 		if (Recover(frames_written) < 0)
 			throw Alsa::MakeError(frames_written,
-					      "snd_pcm_writei() failed");
+					      use_mmap
+					      ? "snd_pcm_mmap_commit() failed"
+					      : "snd_pcm_writei() failed");
 
 		/* recovered; try again in the next DispatchSockets()
 		   call */
@@ -5,12 +5,12 @@
 #include "JackOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
 #include "../Error.hxx"
+#include "pcm/DeinterleaveSimd.hxx"
 #include "output/Features.h"
 #include "lib/fmt/RuntimeError.hxx"
 #include "thread/Mutex.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/IterableSplitString.hxx"
-#include "util/SpanCast.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -135,9 +135,14 @@ private:
 	}
 
 	/**
+	 * Convert and de-interleave the given frames directly into
+	 * the ring buffers.  This writes only to the first writable
+	 * area of each ring buffer; call it again after the ring
+	 * buffer has wrapped.
+	 *
 	 * @return the number of frames that were written
 	 */
-	size_t WriteSamples(const float *src, size_t n_frames);
+	size_t WriteSamples(const std::byte *src, size_t n_frames);
 
 public:
 	/* virtual methods from class AudioOutput */
@@ -605,9 +610,12 @@ JackOutput::Open(AudioFormat &new_audio_format)
 		new_audio_format.channels = 2;
 
 	/* JACK uses 32 bit float in the range [-1 .. 1] - just like
-	   MPD's SampleFormat::FLOAT*/
+	   MPD's SampleFormat::FLOAT; integer samples are converted
+	   by WriteSamples() while they are being de-interleaved,
+	   which saves a separate conversion pass */
 	static_assert(jack_sample_size == sizeof(float), "Expected float32");
-	new_audio_format.format = SampleFormat::FLOAT;
+	if (!IsDeinterleaveToFloatSupported(new_audio_format.format))
+		new_audio_format.format = SampleFormat::FLOAT;
 	audio_format = new_audio_format;
 
 	interrupted = false;
@@ -626,7 +634,7 @@ JackOutput::Interrupt() noexcept
 }
 
 inline size_t
-JackOutput::WriteSamples(const float *src, size_t n_frames)
+JackOutput::WriteSamples(const std::byte *src, size_t n_frames)
 {
 	assert(n_frames > 0);
 
@@ -652,11 +660,10 @@ JackOutput::WriteSamples(const float *src, size_t n_frames)
 	if (space == 0)
 		return 0;
 
-	const size_t result = n_frames = std::min(space, n_frames);
+	const size_t result = std::min(space, n_frames);
 
-	while (n_frames-- > 0)
-		for (unsigned i = 0; i < n_channels; ++i)
-			*dest[i]++ = *src++;
+	PcmDeinterleaveToFloat(dest, src, result, n_channels,
+			       audio_format.format);
 
 	const size_t per_channel_advance = result * jack_sample_size;
 	for (unsigned i = 0; i < n_channels; ++i)
@@ -667,16 +674,14 @@ JackOutput::WriteSamples(const float *src, size_t n_frames)
 }
 
 std::size_t
-JackOutput::Play(std::span<const std::byte> _src)
+JackOutput::Play(std::span<const std::byte> src)
 {
 	const size_t frame_size = audio_format.GetFrameSize();
-	assert(_src.size() % frame_size == 0);
-
-	const auto src = FromBytesStrict<const float>(_src);
+	assert(src.size() % frame_size == 0);
 
 	pause = false;
 
-	const std::size_t n_frames = src.size() / audio_format.channels;
+	const std::size_t n_frames = src.size() / frame_size;
 
 	while (true) {
 		{
@@ -690,8 +695,17 @@ JackOutput::Play(std::span<const std::byte> _src)
 
 		size_t frames_written =
 			WriteSamples(src.data(), n_frames);
-		if (frames_written > 0)
+		if (frames_written > 0) {
+			if (frames_written < n_frames)
+				/* the ring buffers may have wrapped;
+				   fill the area at their beginning,
+				   too */
+				frames_written +=
+					WriteSamples(src.data() + frames_written * frame_size,
+						     n_frames - frames_written);
+
 			return frames_written * frame_size;
+		}
 
 		/* XXX do something more intelligent to
 		   synchronize */
@@ -4,15 +4,60 @@
 #include "PipeOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
 #include "lib/fmt/SystemError.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
 
 #include <string>
 #include <stdexcept>
 
-#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr Domain pipe_output_domain("pipe_output");
 
 class PipeOutput final : AudioOutput {
 	const std::string cmd;
-	FILE *fh;
+
+	/**
+	 * Keep the process running when the output is closed, and
+	 * reuse it when the output is opened again?  It is only
+	 * stopped when the output is disabled.
+	 */
+	const bool persistent;
+
+	/**
+	 * Write a line with the #AudioFormat before the PCM data
+	 * whenever the format changes?
+	 */
+	const bool format_header;
+
+	/**
+	 * If non-zero, then the pipe buffer is resized to this
+	 * number of bytes (Linux only).
+	 */
+	const unsigned pipe_size;
+
+	/**
+	 * The write end of the pipe connected to the process's
+	 * standard input.
+	 */
+	UniqueFileDescriptor fd;
+
+	pid_t pid = -1;
+
+	/**
+	 * The #AudioFormat which was last announced to the process
+	 * with #format_header.
+	 */
+	AudioFormat announced_format = AudioFormat::Undefined();
 
 	explicit PipeOutput(const ConfigBlock &block);
 
@@ -22,40 +67,163 @@ public:
 		return new PipeOutput(block);
 	}
 
+	~PipeOutput() noexcept override {
+		StopProcess();
+	}
+
 private:
+	/**
+	 * Throws on error.
+	 */
+	void StartProcess();
+
+	/**
+	 * Close the pipe and wait for the process to exit.
+	 */
+	void StopProcess() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void WriteFull(std::span<const std::byte> src);
+
+	/**
+	 * Write the #format_header (if enabled and the format has
+	 * changed).
+	 *
+	 * Throws on error.
+	 */
+	void AnnounceFormat(AudioFormat audio_format);
+
+	void Disable() noexcept override {
+		StopProcess();
+	}
+
 	void Open(AudioFormat &audio_format) override;
 
 	void Close() noexcept override {
-		pclose(fh);
+		if (!persistent)
+			StopProcess();
+	}
+
+	bool ChangeAudioFormat(AudioFormat &audio_format) override {
+		if (!persistent)
+			return false;
+
+		AnnounceFormat(audio_format);
+		return true;
 	}
 
 	std::size_t Play(std::span<const std::byte> src) override;
 };
 
 PipeOutput::PipeOutput(const ConfigBlock &block)
-	:AudioOutput(0),
-	 cmd(block.GetBlockValue("command", ""))
+	:AudioOutput(FLAG_ENABLE_DISABLE),
+	 cmd(block.GetBlockValue("command", "")),
+	 persistent(block.GetBlockValue("persistent", false)),
+	 format_header(block.GetBlockValue("format_header", false)),
+	 pipe_size(block.GetBlockValue("pipe_size", 0U))
 {
 	if (cmd.empty())
 		throw std::runtime_error("No \"command\" parameter specified");
 }
 
-inline void
-PipeOutput::Open([[maybe_unused]] AudioFormat &audio_format)
+void
+PipeOutput::StartProcess()
+{
+	UniqueFileDescriptor r, w;
+	if (!UniqueFileDescriptor::CreatePipe(r, w))
+		throw MakeErrno("Failed to create pipe");
+
+#ifdef F_SETPIPE_SZ
+	if (pipe_size > 0 && fcntl(w.Get(), F_SETPIPE_SZ, pipe_size) < 0)
+		FmtError(pipe_output_domain,
+			 "Failed to set pipe size: {}", strerror(errno));
+#endif
+
+	pid = fork();
+	if (pid < 0)
+		throw MakeErrno("fork() failed");
+
+	if (pid == 0) {
+		/* in the child process */
+
+		/* the output thread may have blocked some signals */
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+		if (!r.CheckDuplicate(FileDescriptor{STDIN_FILENO}))
+			_exit(127);
+
+		execl("/bin/sh", "sh", "-c", cmd.c_str(), nullptr);
+		_exit(127);
+	}
+
+	fd = std::move(w);
+	announced_format.Clear();
+}
+
+void
+PipeOutput::StopProcess() noexcept
+{
+	if (pid < 0)
+		return;
+
+	/* closing the pipe signals EOF to the process */
+	fd.Close();
+
+	while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {}
+	pid = -1;
+}
+
+void
+PipeOutput::WriteFull(std::span<const std::byte> src)
+{
+	while (!src.empty()) {
+		const auto nbytes = fd.Write(src);
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+
+			const int e = errno;
+
+			/* the process is probably gone; start a new
+			   one on the next Open() */
+			StopProcess();
+			throw MakeErrno(e, "Write error on pipe");
+		}
+
+		src = src.subspan(nbytes);
+	}
+}
+
+void
+PipeOutput::AnnounceFormat(AudioFormat audio_format)
 {
-	fh = popen(cmd.c_str(), "w");
-	if (fh == nullptr)
-		throw FmtErrno("Error opening pipe {:?}", cmd);
+	if (!format_header || audio_format == announced_format)
+		return;
+
+	const auto line = fmt::format("audio_format: {}\n",
+				      ToString(audio_format).c_str());
+	WriteFull(std::as_bytes(std::span{line}));
+	announced_format = audio_format;
+}
+
+void
+PipeOutput::Open(AudioFormat &audio_format)
+{
+	if (pid < 0)
+		StartProcess();
+
+	AnnounceFormat(audio_format);
 }
 
 std::size_t
 PipeOutput::Play(std::span<const std::byte> src)
 {
-	size_t nbytes = fwrite(src.data(), 1, src.size(), fh);
-	if (nbytes == 0)
-		throw MakeErrno("Write error on pipe");
-
-	return nbytes;
+	WriteFull(src);
+	return src.size();
 }
 
 const struct AudioOutputPlugin pipe_output_plugin = {
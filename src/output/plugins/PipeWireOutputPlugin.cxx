@@ -8,9 +8,9 @@
 #include "../Error.hxx"
 #include "mixer/plugins/PipeWireMixerPlugin.hxx"
 #include "pcm/Silence.hxx"
+#include "pcm/DsdSimd.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "system/Error.hxx"
-#include "util/BitReverse.hxx"
 #include "util/Domain.hxx"
 #include "util/RingBuffer.hxx"
 #include "util/ScopeExit.hxx"
@@ -30,6 +30,7 @@
 
 #include <pipewire/pipewire.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/param.h>
 #include <spa/param/props.h>
 
 #include <cmath>
@@ -63,11 +64,20 @@ class PipeWireOutput final : AudioOutput {
 	std::size_t frame_size;
 
 	/**
-	 * This buffer passes PCM data from Play() to Process().
+	 * This buffer passes PCM data from Play() to Process().  It
+	 * is not used in #direct mode.
 	 */
 	using RingBuffer = ::RingBuffer<std::byte>;
 	RingBuffer ring_buffer;
 
+	/**
+	 * The "direct" setting: instead of copying to the
+	 * #ring_buffer, Play() dequeues PipeWire buffers and copies
+	 * the PCM data right into them, and Process() only wakes up
+	 * Play().
+	 */
+	const bool direct;
+
 	uint32_t target_id = PW_ID_ANY;
 
 	/**
@@ -192,6 +202,31 @@ private:
 		o.StateChanged(state, error);
 	}
 
+	/**
+	 * Returns the granularity of data to be copied to a PipeWire
+	 * buffer, in bytes.
+	 */
+	[[gnu::pure]]
+	std::size_t GetChunkSize() const noexcept;
+
+	/**
+	 * Finish a PipeWire buffer which has been filled with the
+	 * given number of bytes (post-processing DSD data if
+	 * necessary) and return it to PipeWire.
+	 */
+	void QueueBuffer(struct pw_buffer &b, std::size_t nbytes) noexcept;
+
+	/**
+	 * Tell PipeWire which buffers we want (after the format has
+	 * been negotiated).
+	 */
+	void UpdateBufferParams() noexcept;
+
+	/**
+	 * The implementation of Play() in #direct mode.
+	 */
+	std::size_t PlayDirect(std::span<const std::byte> src);
+
 	void Process() noexcept;
 
 	static void Process(void *data) noexcept {
@@ -290,7 +325,8 @@ PipeWireOutput::PipeWireOutput(const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE),
 	 name(block.GetBlockValue("name", "pipewire")),
 	 remote(block.GetBlockValue("remote", nullptr)),
-	 target(block.GetBlockValue("target", nullptr))
+	 target(block.GetBlockValue("target", nullptr)),
+	 direct(block.GetBlockValue("direct", false))
 #if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
 	, enable_dsd(block.GetBlockValue("dsd", false))
 #endif
@@ -555,8 +591,9 @@ PipeWireOutput::Open(AudioFormat &audio_format)
 	channels = audio_format.channels;
 	interrupted = false;
 
-	/* allocate a ring buffer of 0.5 seconds */
-	ring_buffer = RingBuffer{frame_size * (audio_format.sample_rate / 2)};
+	if (!direct)
+		/* allocate a ring buffer of 0.5 seconds */
+		ring_buffer = RingBuffer{frame_size * (audio_format.sample_rate / 2)};
 
 	const struct spa_pod *params[1];
 
@@ -586,14 +623,20 @@ PipeWireOutput::Open(AudioFormat &audio_format)
 						       SPA_PARAM_EnumFormat,
 						       &raw);
 
+	unsigned flags = PW_STREAM_FLAG_AUTOCONNECT |
+		PW_STREAM_FLAG_INACTIVE |
+		PW_STREAM_FLAG_MAP_BUFFERS;
+
+	if (!direct)
+		/* in direct mode, Process() only wakes up Play(),
+		   which is better done in the thread loop */
+		flags |= PW_STREAM_FLAG_RT_PROCESS;
+
 	int error =
 		pw_stream_connect(stream,
 				  PW_DIRECTION_OUTPUT,
 				  target_id,
-				  (enum pw_stream_flags)(PW_STREAM_FLAG_AUTOCONNECT |
-							 PW_STREAM_FLAG_INACTIVE |
-							 PW_STREAM_FLAG_MAP_BUFFERS |
-							 PW_STREAM_FLAG_RT_PROCESS),
+				  (enum pw_stream_flags)flags,
 				  params, 1);
 	if (error < 0)
 		throw PipeWire::MakeError(error, "Failed to connect stream");
@@ -676,6 +719,42 @@ PipeWireOutput::ParamChanged([[maybe_unused]] uint32_t id,
 	if (use_dsd && id == SPA_PARAM_Format && param != nullptr)
 		DsdFormatChanged(*param);
 #endif
+
+	if (id == SPA_PARAM_Format && param != nullptr)
+		UpdateBufferParams();
+}
+
+inline void
+PipeWireOutput::UpdateBufferParams() noexcept
+{
+	std::byte buffer[256];
+	auto b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	const int stride = frame_size;
+
+	/* shared memory (memfd) can be mapped by the PipeWire
+	   daemon, i.e. the data we write into a buffer is passed to
+	   the graph without another copy */
+	const struct spa_pod *params[1];
+	params[0] = (const struct spa_pod *)
+		spa_pod_builder_add_object(&b,
+					   SPA_TYPE_OBJECT_ParamBuffers,
+					   SPA_PARAM_Buffers,
+					   SPA_PARAM_BUFFERS_buffers,
+					   SPA_POD_CHOICE_RANGE_Int(4, 2, 16),
+					   SPA_PARAM_BUFFERS_blocks,
+					   SPA_POD_Int(1),
+					   SPA_PARAM_BUFFERS_size,
+					   SPA_POD_CHOICE_RANGE_Int(stride * 1024,
+								    stride * 32,
+								    stride * 8192),
+					   SPA_PARAM_BUFFERS_stride,
+					   SPA_POD_Int(stride),
+					   SPA_PARAM_BUFFERS_dataType,
+					   SPA_POD_CHOICE_FLAGS_Int((1 << SPA_DATA_MemFd) |
+								    (1 << SPA_DATA_MemPtr)));
+
+	pw_stream_update_params(stream, params, 1);
 }
 
 #if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
@@ -708,13 +787,6 @@ Interleave(std::byte *data, std::byte *end,
 	}
 }
 
-static void
-BitReverse(std::byte *data, std::size_t n) noexcept
-{
-	while (n-- > 0)
-		*data = BitReverse(*data);
-}
-
 static void
 PostProcessDsd(std::byte *data, struct spa_chunk &chunk, unsigned channels,
 	       bool reverse_bits, unsigned interleave) noexcept
@@ -729,14 +801,55 @@ PostProcessDsd(std::byte *data, struct spa_chunk &chunk, unsigned channels,
 	}
 
 	if (reverse_bits)
-		BitReverse(data, chunk.size);
+		PcmBitReverseSimd(data, data, chunk.size);
 }
 
 #endif
 
+std::size_t
+PipeWireOutput::GetChunkSize() const noexcept
+{
+	std::size_t chunk_size = frame_size;
+
+#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
+	if (use_dsd && dsd_interleave > 1) {
+		/* make sure we don't get partial interleave frames */
+		chunk_size *= dsd_interleave;
+	}
+#endif
+
+	return chunk_size;
+}
+
+inline void
+PipeWireOutput::QueueBuffer(struct pw_buffer &b, std::size_t nbytes) noexcept
+{
+	auto &d = b.buffer->datas[0];
+
+	auto &chunk = *d.chunk;
+	chunk.offset = 0;
+	chunk.stride = frame_size;
+	chunk.size = nbytes;
+
+#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
+	if (use_dsd)
+		PostProcessDsd((std::byte *)d.data, chunk, channels,
+			       dsd_reverse_bits, dsd_interleave);
+#endif
+
+	pw_stream_queue_buffer(stream, &b);
+}
+
 inline void
 PipeWireOutput::Process() noexcept
 {
+	if (direct) {
+		/* Play() dequeues buffers by itself; a buffer may
+		   have become available, so wake it up */
+		pw_thread_loop_signal(thread_loop, false);
+		return;
+	}
+
 	auto *b = pw_stream_dequeue_buffer(stream);
 	if (b == nullptr) {
 		pw_log_warn("out of buffers: %m");
@@ -750,14 +863,7 @@ PipeWireOutput::Process() noexcept
 	if (dest == nullptr)
 		return;
 
-	std::size_t chunk_size = frame_size;
-
-#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
-	if (use_dsd && dsd_interleave > 1) {
-		/* make sure we don't get partial interleave frames */
-		chunk_size *= dsd_interleave;
-	}
-#endif
+	const std::size_t chunk_size = GetChunkSize();
 
 	size_t nbytes = ring_buffer.ReadFramesTo({dest, d.maxsize}, chunk_size);
 	assert(nbytes % chunk_size == 0);
@@ -775,18 +881,7 @@ PipeWireOutput::Process() noexcept
 		LogWarning(pipewire_output_domain, "Decoder is too slow; playing silence to avoid xrun");
 	}
 
-	auto &chunk = *d.chunk;
-	chunk.offset = 0;
-	chunk.stride = frame_size;
-	chunk.size = nbytes;
-
-#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
-	if (use_dsd)
-		PostProcessDsd(dest, chunk, channels,
-			       dsd_reverse_bits, dsd_interleave);
-#endif
-
-	pw_stream_queue_buffer(stream, b);
+	QueueBuffer(*b, nbytes);
 
 	pw_thread_loop_signal(thread_loop, false);
 }
@@ -804,6 +899,56 @@ PipeWireOutput::Delay() const noexcept
 	return result;
 }
 
+inline std::size_t
+PipeWireOutput::PlayDirect(std::span<const std::byte> src)
+{
+	while (true) {
+		CheckThrowError();
+
+		if (auto *b = pw_stream_dequeue_buffer(stream)) {
+			auto &d = b->buffer->datas[0];
+			auto *dest = (std::byte *)d.data;
+			const std::size_t chunk_size = GetChunkSize();
+			if (dest == nullptr || d.maxsize < chunk_size) {
+				pw_stream_queue_buffer(stream, b);
+				throw std::runtime_error("Unusable PipeWire buffer");
+			}
+
+			std::size_t nbytes = std::min<std::size_t>(src.size(),
+								   d.maxsize);
+			nbytes -= nbytes % chunk_size;
+
+			std::size_t consumed = nbytes;
+			if (nbytes == 0) {
+				/* less than one DSD interleave
+				   chunk left: pad with silence */
+				consumed = src.size();
+				nbytes = chunk_size;
+				PcmSilence({dest + consumed, nbytes - consumed},
+					   sample_format);
+			}
+
+			std::copy_n(src.data(), consumed, dest);
+			QueueBuffer(*b, nbytes);
+
+			drained = false;
+			return consumed;
+		}
+
+		if (!active) {
+			/* all buffers are filled; now that there is
+			   enough data, resume the stream */
+			active = true;
+			pw_stream_set_active(stream, true);
+		}
+
+		if (interrupted)
+			throw AudioOutputInterrupted{};
+
+		pw_thread_loop_wait(thread_loop);
+	}
+}
+
 std::size_t
 PipeWireOutput::Play(std::span<const std::byte> src)
 {
@@ -811,6 +956,9 @@ PipeWireOutput::Play(std::span<const std::byte> src)
 
 	paused = false;
 
+	if (direct)
+		return PlayDirect(src);
+
 	while (true) {
 		CheckThrowError();
 
@@ -852,6 +1000,10 @@ PipeWireOutput::Drain()
 		pw_stream_set_active(stream, true);
 	}
 
+	if (direct)
+		/* all data has been queued already */
+		pw_stream_flush(stream, true);
+
 	drain_requested = true;
 	AtScopeExit(this) { drain_requested = false; };
 
@@ -17,6 +17,7 @@
 #include <pulse/subscribe.h>
 #include <pulse/version.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <stdexcept>
@@ -35,6 +36,13 @@ class PulseOutput final : AudioOutput {
 	const char *sink;
 	const char *const media_role;
 
+	/**
+	 * The buffer attributes "tlength", "minreq" and "prebuf" in
+	 * milliseconds; #NO_ATTR lets the server choose.
+	 */
+	static constexpr uint32_t NO_ATTR = uint32_t(-1);
+	const uint32_t tlength_ms, minreq_ms, prebuf_ms;
+
 	PulseMixer *mixer = nullptr;
 
 	struct pa_threaded_mainloop *mainloop = nullptr;
@@ -172,12 +180,38 @@ private:
 	void StreamPause(bool pause);
 };
 
+static uint32_t
+GetAttrValue(const ConfigBlock &block, const char *name)
+{
+	const auto *param = block.GetBlockParam(name);
+	if (param == nullptr)
+		return uint32_t(-1);
+
+	return param->GetUnsignedValue();
+}
+
+/**
+ * Convert a buffer attribute from milliseconds to bytes.
+ */
+[[gnu::pure]]
+static uint32_t
+AttrToBytes(uint32_t ms, const pa_sample_spec &ss) noexcept
+{
+	if (ms == uint32_t(-1))
+		return ms;
+
+	return pa_usec_to_bytes(pa_usec_t(ms) * 1000, &ss);
+}
+
 PulseOutput::PulseOutput(const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
 	 name(block.GetBlockValue("name", "mpd_pulse")),
 	 server(block.GetBlockValue("server")),
 	 sink(block.GetBlockValue("sink")),
-	 media_role(block.GetBlockValue("media_role"))
+	 media_role(block.GetBlockValue("media_role")),
+	 tlength_ms(GetAttrValue(block, "tlength")),
+	 minreq_ms(GetAttrValue(block, "minreq")),
+	 prebuf_ms(GetAttrValue(block, "prebuf"))
 {
 #ifdef _WIN32
 	SetEnvironmentVariableA("PULSE_PROP_media.role", "music");
@@ -670,8 +704,22 @@ PulseOutput::Open(AudioFormat &audio_format)
 
 	/* .. and connect it (asynchronously) */
 
+	pa_buffer_attr attr;
+	attr.maxlength = uint32_t(-1);
+	attr.tlength = AttrToBytes(tlength_ms, ss);
+	attr.prebuf = AttrToBytes(prebuf_ms, ss);
+	attr.minreq = AttrToBytes(minreq_ms, ss);
+	attr.fragsize = uint32_t(-1);
+
+	/* with a configured "tlength", let the server adjust the
+	   sink latency to it (instead of having the server buffer
+	   "tlength" on top of the sink latency) */
+	const auto flags = tlength_ms != NO_ATTR
+		? PA_STREAM_ADJUST_LATENCY
+		: pa_stream_flags_t(0);
+
 	if (pa_stream_connect_playback(stream, sink,
-				       nullptr, pa_stream_flags_t(0),
+				       &attr, flags,
 				       nullptr, nullptr) < 0) {
 		DeleteStream();
 
@@ -803,18 +851,28 @@ PulseOutput::Play(std::span<const std::byte> src)
 
 	/* now write */
 
-	if (src.size() > writable)
-		/* don't send more than possible */
-		src = src.first(writable);
+	/* copy directly into a memory block obtained from the
+	   server (a shared memory segment if possible), which saves
+	   libpulse from copying it again */
+
+	void *data;
+	std::size_t nbytes = std::min(src.size(), writable);
+	if (pa_stream_begin_write(stream, &data, &nbytes) < 0)
+		throw Pulse::MakeError(context, "pa_stream_begin_write() failed");
+
+	/* don't send more than possible; the block may be smaller
+	   than requested */
+	nbytes = std::min({nbytes, src.size(), writable});
+	std::copy_n(src.data(), nbytes, (std::byte *)data);
 
-	writable -= src.size();
+	writable -= nbytes;
 
-	int result = pa_stream_write(stream, src.data(), src.size(), nullptr,
+	int result = pa_stream_write(stream, data, nbytes, nullptr,
 				     0, PA_SEEK_RELATIVE);
 	if (result < 0)
 		throw Pulse::MakeError(context, "pa_stream_write() failed");
 
-	return src.size();
+	return nbytes;
 }
 
 void
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "RecorderFile.hxx"
+#include "thread/Name.hxx"
+#include "util/StringAPI.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+
+RecorderSync
+ParseRecorderSync(const char *s)
+{
+	if (StringIsEqual(s, "no"))
+		return RecorderSync::NONE;
+	else if (StringIsEqual(s, "close"))
+		return RecorderSync::CLOSE;
+	else if (StringIsEqual(s, "always"))
+		return RecorderSync::ALWAYS;
+	else
+		throw std::invalid_argument("Invalid sync policy; expected \"no\", \"close\" or \"always\"");
+}
+
+RecorderFile::RecorderFile(Path path, const RecorderFileOptions &_options)
+	:file(path), options(_options)
+{
+	if (options.buffer_size > 0) {
+		pending.reserve(options.buffer_size);
+		thread.Start();
+	}
+}
+
+RecorderFile::~RecorderFile() noexcept
+{
+	if (thread.IsDefined()) {
+		{
+			const std::scoped_lock lock{mutex};
+			pending.clear();
+			quit = true;
+			cond.notify_all();
+		}
+
+		thread.Join();
+	}
+}
+
+inline void
+RecorderFile::WriteToFile(std::span<const std::byte> src)
+{
+	if (options.preallocate > 0 && position + src.size() > preallocated) {
+		/* reserve the next step */
+		const uint64_t end = position + src.size();
+		const uint64_t new_preallocated =
+			(end + options.preallocate - 1)
+			/ options.preallocate * options.preallocate;
+		file.Preallocate(preallocated,
+				 new_preallocated - preallocated);
+		preallocated = new_preallocated;
+	}
+
+	file.Write(src);
+	position += src.size();
+
+	if (options.sync == RecorderSync::ALWAYS)
+		file.Sync();
+}
+
+void
+RecorderFile::Write(std::span<const std::byte> src)
+{
+	if (!thread.IsDefined()) {
+		WriteToFile(src);
+		return;
+	}
+
+	std::unique_lock lock{mutex};
+
+	/* wait for room in the buffer; a chunk which is larger
+	   than the whole buffer is accepted if the buffer is
+	   empty */
+	cond.wait(lock, [this, src]{
+		return error ||
+			pending.empty() ||
+			pending.size() + src.size() <= options.buffer_size;
+	});
+
+	if (error)
+		std::rethrow_exception(error);
+
+	pending.insert(pending.end(), src.begin(), src.end());
+	cond.notify_all();
+}
+
+inline void
+RecorderFile::Drain()
+{
+	if (!thread.IsDefined())
+		return;
+
+	std::unique_lock lock{mutex};
+	cond.wait(lock, [this]{
+		return error || (pending.empty() && !busy);
+	});
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void
+RecorderFile::Commit()
+{
+	Drain();
+
+	if (options.sync == RecorderSync::CLOSE)
+		file.Sync();
+
+	file.Commit();
+}
+
+void
+RecorderFile::Run() noexcept
+{
+	SetThreadName("recorder");
+
+	std::vector<std::byte> writing;
+	writing.reserve(options.buffer_size);
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		cond.wait(lock, [this]{
+			return quit || !pending.empty();
+		});
+
+		if (pending.empty())
+			/* quit */
+			break;
+
+		writing.clear();
+		std::swap(writing, pending);
+		busy = true;
+
+		/* there is room in the buffer again */
+		cond.notify_all();
+
+		std::exception_ptr write_error;
+
+		{
+			const ScopeUnlock unlock{mutex};
+
+			try {
+				WriteToFile(writing);
+			} catch (...) {
+				write_error = std::current_exception();
+			}
+		}
+
+		error = std::move(write_error);
+		busy = false;
+		cond.notify_all();
+
+		if (error)
+			break;
+	}
+}
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_RECORDER_FILE_HXX
+#define MPD_RECORDER_FILE_HXX
+
+#include "io/FileOutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+/**
+ * When shall #RecorderFile call fdatasync()?
+ */
+enum class RecorderSync : uint8_t {
+	/**
+	 * Never; leave it to the kernel.
+	 */
+	NONE,
+
+	/**
+	 * Once before the file is committed.
+	 */
+	CLOSE,
+
+	/**
+	 * After each write.
+	 */
+	ALWAYS,
+};
+
+/**
+ * Throws on error.
+ */
+RecorderSync
+ParseRecorderSync(const char *s);
+
+struct RecorderFileOptions {
+	/**
+	 * The size of the write-behind buffer.  If this is zero,
+	 * then data is written synchronously by the caller.
+	 */
+	std::size_t buffer_size = 0;
+
+	/**
+	 * If non-zero, then disk space is reserved in steps of this
+	 * many bytes.
+	 */
+	uint64_t preallocate = 0;
+
+	RecorderSync sync = RecorderSync::NONE;
+};
+
+/**
+ * The file written by the "recorder" output plugin.  With a
+ * write-behind buffer, Write() only copies the data to the buffer
+ * and a separate thread writes it to the file, so a slow disk does
+ * not stall the output thread (until the buffer is full).
+ */
+class RecorderFile final : public OutputStream {
+	FileOutputStream file;
+
+	const RecorderFileOptions options;
+
+	/**
+	 * The number of bytes written to #file so far.  Only
+	 * accessed by the thread which writes to #file.
+	 */
+	uint64_t position = 0;
+
+	/**
+	 * The file offset up to which disk space has been reserved.
+	 * Only accessed by the thread which writes to #file.
+	 */
+	uint64_t preallocated = 0;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by both threads whenever #pending, #busy or
+	 * #error changes.
+	 */
+	Cond cond;
+
+	/**
+	 * Data which has not yet been submitted to the writer
+	 * thread.  Protected by #mutex.
+	 */
+	std::vector<std::byte> pending;
+
+	/**
+	 * Is the writer thread currently writing?  Protected by
+	 * #mutex.
+	 */
+	bool busy = false;
+
+	/**
+	 * Shall the writer thread exit?  Protected by #mutex.
+	 */
+	bool quit = false;
+
+	/**
+	 * The error which has occurred in the writer thread.
+	 * Protected by #mutex.
+	 */
+	std::exception_ptr error;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	RecorderFile(Path path, const RecorderFileOptions &_options);
+
+	/**
+	 * Discards all pending data and rolls back the file.
+	 */
+	~RecorderFile() noexcept;
+
+	/**
+	 * Write all pending data, sync it (if configured) and commit
+	 * the file.
+	 *
+	 * After returning, this object must not be used again.
+	 *
+	 * Throws on error.
+	 */
+	void Commit();
+
+	/* virtual methods from class OutputStream */
+	void Write(std::span<const std::byte> src) override;
+
+private:
+	/**
+	 * Wait until the writer thread has written all pending data.
+	 *
+	 * Throws on error.
+	 */
+	void Drain();
+
+	void WriteToFile(std::span<const std::byte> src);
+
+	void Run() noexcept;
+};
+
+#endif
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "RecorderOutputPlugin.hxx"
+#include "RecorderFile.hxx"
 #include "../OutputAPI.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "tag/Format.hxx"
@@ -9,9 +10,10 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/Configured.hxx"
 #include "config/Path.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
-#include "io/FileOutputStream.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
 
@@ -47,10 +49,12 @@ class RecorderOutput final : AudioOutput {
 	 */
 	AudioFormat effective_audio_format;
 
+	RecorderFileOptions file_options;
+
 	/**
 	 * The destination file.
 	 */
-	FileOutputStream *file;
+	RecorderFile *file;
 
 	explicit RecorderOutput(const ConfigBlock &block);
 
@@ -105,6 +109,15 @@ RecorderOutput::RecorderOutput(const ConfigBlock &block)
 
 	if (!path.IsNull() && fmt != nullptr)
 		throw std::runtime_error("Cannot have both 'path' and 'format_path'");
+
+	if (const char *s = block.GetBlockValue("write_buffer"))
+		file_options.buffer_size = ParseSize(s);
+
+	if (const char *s = block.GetBlockValue("preallocate"))
+		file_options.preallocate = ParseSize(s);
+
+	if (const char *s = block.GetBlockValue("sync"))
+		file_options.sync = ParseRecorderSync(s);
 }
 
 inline void
@@ -123,7 +136,7 @@ RecorderOutput::Open(AudioFormat &audio_format)
 	if (!HasDynamicPath()) {
 		assert(!path.IsNull());
 
-		file = new FileOutputStream(path);
+		file = new RecorderFile(path, file_options);
 	} else {
 		/* don't open the file just yet; wait until we have
 		   a tag that we can use to build the path */
@@ -235,7 +248,7 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 	assert(path.IsNull());
 	assert(file == nullptr);
 
-	auto *new_file = new FileOutputStream(new_path);
+	auto *new_file = new RecorderFile(new_path, file_options);
 
 	AudioFormat new_audio_format = effective_audio_format;
 
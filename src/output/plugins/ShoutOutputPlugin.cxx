@@ -5,7 +5,10 @@
 #include "../OutputAPI.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/Configured.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "tag/Tag.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/StringAPI.hxx"
@@ -15,10 +18,30 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <stdexcept>
 
+/**
+ * Encoded pages are queued in #ShoutOutput::queue until libshout's
+ * own queue is shorter than this.
+ */
+static constexpr std::size_t MAX_SHOUT_QUEUE = 64 * 1024;
+
+/**
+ * If the server does not accept data fast enough and the queue grows
+ * larger than this, the oldest pages are discarded.
+ */
+static constexpr std::size_t MAX_QUEUE_SIZE = 256 * 1024;
+
+static constexpr std::chrono::steady_clock::duration MIN_RECONNECT_DELAY =
+	std::chrono::seconds{1};
+static constexpr std::chrono::steady_clock::duration MAX_RECONNECT_DELAY =
+	std::chrono::minutes{1};
+
 class ShoutConfig {
 	const char *const host;
 	const char *const mount;
@@ -54,6 +77,59 @@ struct ShoutOutput final : AudioOutput {
 
 	Encoder *encoder;
 
+	AudioFormat audio_format;
+
+	/**
+	 * Encoded pages which have not yet been passed to libshout.
+	 */
+	std::deque<AllocatedArray<std::byte>> queue;
+
+	/**
+	 * The total size of all pages in #queue.
+	 */
+	std::size_t queue_size = 0;
+
+	/**
+	 * The most recent tag; it is sent again after reconnecting.
+	 */
+	Tag last_tag;
+
+	/**
+	 * When shall the next connection attempt be made?
+	 */
+	std::chrono::steady_clock::time_point reconnect_time;
+
+	/**
+	 * How long to wait after the next connection failure?  This
+	 * doubles after each failure.
+	 */
+	std::chrono::steady_clock::duration reconnect_delay;
+
+	/**
+	 * While not connected, Play() discards data in real time;
+	 * this is the time when the discarded data would have been
+	 * played.
+	 */
+	std::chrono::steady_clock::time_point discard_time;
+
+	/**
+	 * The connection is nonblocking; shout_open() returns
+	 * immediately, and shout_get_connected() reports when the
+	 * connection has been established.
+	 */
+	enum class State : uint_least8_t {
+		DISCONNECTED,
+		CONNECTING,
+		CONNECTED,
+	} state = State::DISCONNECTED;
+
+	/**
+	 * Has data been passed to the #encoder since it was opened?
+	 * If yes, it needs to be reopened after reconnecting, to
+	 * send the stream headers again.
+	 */
+	bool encoder_dirty;
+
 	explicit ShoutOutput(const ConfigBlock &block);
 	~ShoutOutput() override;
 
@@ -76,7 +152,54 @@ struct ShoutOutput final : AudioOutput {
 	bool Pause() override;
 
 private:
+	/**
+	 * Move the pages generated by the encoder to the queue and
+	 * pass as much as possible to libshout.  Connection errors
+	 * are handled by scheduling a reconnect.
+	 */
 	void WritePage();
+
+	/**
+	 * Pass queued pages to libshout.
+	 *
+	 * Throws on error.
+	 */
+	void Flush();
+
+	void ClearQueue() noexcept {
+		queue.clear();
+		queue_size = 0;
+	}
+
+	/**
+	 * Continue connecting to the server, unless the reconnect
+	 * delay has not yet expired.
+	 *
+	 * @return true if the connection is established
+	 */
+	bool CheckConnected() noexcept;
+
+	/**
+	 * The connection has been established: reopen the encoder
+	 * if necessary and send the stream headers.
+	 *
+	 * Throws on error.
+	 */
+	void OnConnected();
+
+	/**
+	 * The connection has failed: close it and schedule a
+	 * reconnect.
+	 */
+	void OnConnectionError(std::exception_ptr e) noexcept;
+
+	/**
+	 * Throw away the given amount of PCM data, but make Delay()
+	 * pretend it is being played.
+	 */
+	void Discard(std::size_t size) noexcept;
+
+	void SubmitTag(const Tag &tag);
 };
 
 static int shout_init_count;
@@ -244,7 +367,13 @@ ShoutConfig::Setup(shout_t &connection) const
 #ifdef SHOUT_TLS
 	    shout_set_tls(&connection, tls) != SHOUTERR_SUCCESS ||
 #endif
-	    shout_set_agent(&connection, "MPD") != SHOUTERR_SUCCESS)
+	    shout_set_agent(&connection, "MPD") != SHOUTERR_SUCCESS ||
+#ifdef SHOUT_BLOCKING_NONE
+	    /* since libshout 2.4.6 */
+	    shout_set_nonblocking(&connection, SHOUT_BLOCKING_NONE) != SHOUTERR_SUCCESS)
+#else
+	    shout_set_nonblocking(&connection, 1) != SHOUTERR_SUCCESS)
+#endif
 		throw std::runtime_error(shout_get_error(&connection));
 
 	SetMeta(connection, SHOUT_META_NAME, name);
@@ -305,19 +434,23 @@ HandleShoutError(shout_t *shout_conn, int err)
 	}
 }
 
-static void
-EncoderToShout(shout_t *shout_conn, Encoder &encoder)
+void
+ShoutOutput::Flush()
 {
-	while (true) {
-		std::byte buffer[32768];
-		const auto e = encoder.Read(std::span{buffer});
-		if (e.empty() == 0)
-			return;
-
+	/* libshout queues everything which cannot be sent right
+	   away; hand over only as much as fits into its queue, and
+	   keep the rest in our own queue, where old pages can be
+	   discarded */
+	while (!queue.empty() &&
+	       shout_queuelen(shout_conn) < ssize_t(MAX_SHOUT_QUEUE)) {
+		const auto &page = queue.front();
 		int err = shout_send(shout_conn,
-				     (const unsigned char *)e.data(),
-				     e.size());
+				     (const unsigned char *)page.data(),
+				     page.size());
 		HandleShoutError(shout_conn, err);
+
+		queue_size -= page.size();
+		queue.pop_front();
 	}
 }
 
@@ -326,20 +459,64 @@ ShoutOutput::WritePage()
 {
 	assert(encoder != nullptr);
 
-	EncoderToShout(shout_conn, *encoder);
+	while (true) {
+		std::byte buffer[32768];
+		const auto e = encoder->Read(std::span{buffer});
+		if (e.empty())
+			break;
+
+		queue.emplace_back(e);
+		queue_size += e.size();
+	}
+
+	if (state != State::CONNECTED) {
+		/* the pages will be generated again by a new
+		   encoder after reconnecting */
+		ClearQueue();
+		return;
+	}
+
+	try {
+		Flush();
+	} catch (...) {
+		OnConnectionError(std::current_exception());
+		return;
+	}
+
+	/* the server is too slow: discard the oldest pages (but
+	   never the most recent one, which may be a stream header
+	   that has just been generated) */
+	unsigned n_dropped = 0;
+	while (queue_size > MAX_QUEUE_SIZE && queue.size() > 1) {
+		queue_size -= queue.front().size();
+		queue.pop_front();
+		++n_dropped;
+	}
+
+	if (n_dropped > 0)
+		FmtWarning(shout_output_domain,
+			   "Shout server {}:{} is too slow, dropped {} pages",
+			   shout_get_host(shout_conn),
+			   shout_get_port(shout_conn),
+			   n_dropped);
 }
 
 void
 ShoutOutput::Close() noexcept
 {
-	try {
-		encoder->End();
-		WritePage();
-	} catch (...) {
-		/* ignore */
+	if (state == State::CONNECTED) {
+		try {
+			encoder->End();
+			WritePage();
+		} catch (...) {
+			/* ignore */
+		}
 	}
 
 	delete encoder;
+	ClearQueue();
+	last_tag.Clear();
+	state = State::DISCONNECTED;
 
 	if (shout_get_connected(shout_conn) != SHOUTERR_UNCONNECTED &&
 	    shout_close(shout_conn) != SHOUTERR_SUCCESS) {
@@ -352,16 +529,26 @@ ShoutOutput::Close() noexcept
 void
 ShoutOutput::Cancel() noexcept
 {
-	/* needs to be implemented for shout */
+	/* discard the pages which have not yet been passed to
+	   libshout; what libshout has already queued cannot be
+	   revoked */
+	ClearQueue();
 }
 
-static void
+/**
+ * @return true if the connection is established, false if
+ * connecting is still in progress
+ */
+static bool
 ShoutOpen(shout_t *shout_conn)
 {
 	switch (shout_open(shout_conn)) {
 	case SHOUTERR_SUCCESS:
 	case SHOUTERR_CONNECTED:
-		break;
+		return true;
+
+	case SHOUTERR_BUSY:
+		return false;
 
 	default:
 		throw FmtRuntimeError("problem opening connection to shout server {}:{}: {}",
@@ -372,16 +559,125 @@ ShoutOpen(shout_t *shout_conn)
 }
 
 void
-ShoutOutput::Open(AudioFormat &audio_format)
+ShoutOutput::OnConnected()
 {
-	encoder = prepared_encoder->Open(audio_format);
+	state = State::CONNECTED;
+	reconnect_delay = MIN_RECONNECT_DELAY;
+
+	if (encoder_dirty) {
+		/* start a new stream, because the server expects
+		   the stream headers first */
+		delete encoder;
+		encoder = nullptr;
+
+		AudioFormat new_audio_format = audio_format;
+		encoder = prepared_encoder->Open(new_audio_format);
+		encoder_dirty = false;
+	}
+
+	WritePage();
+
+	if (state == State::CONNECTED && !last_tag.IsEmpty())
+		SubmitTag(last_tag);
+}
+
+void
+ShoutOutput::OnConnectionError(std::exception_ptr e) noexcept
+{
+	if (shout_get_connected(shout_conn) != SHOUTERR_UNCONNECTED)
+		shout_close(shout_conn);
+
+	state = State::DISCONNECTED;
+	ClearQueue();
+
+	const auto now = std::chrono::steady_clock::now();
+	reconnect_time = now + reconnect_delay;
+	discard_time = now;
+
+	FmtError(shout_output_domain, "{}; reconnecting in {} seconds", e,
+		 std::chrono::duration_cast<std::chrono::seconds>(reconnect_delay).count());
+
+	reconnect_delay = std::min(reconnect_delay * 2, MAX_RECONNECT_DELAY);
+}
+
+bool
+ShoutOutput::CheckConnected() noexcept
+{
+	try {
+		switch (state) {
+		case State::DISCONNECTED:
+			if (std::chrono::steady_clock::now() < reconnect_time)
+				return false;
+
+			if (!ShoutOpen(shout_conn)) {
+				state = State::CONNECTING;
+				return false;
+			}
+
+			OnConnected();
+			break;
+
+		case State::CONNECTING:
+			switch (shout_get_connected(shout_conn)) {
+			case SHOUTERR_BUSY:
+				return false;
+
+			case SHOUTERR_CONNECTED:
+				OnConnected();
+				break;
+
+			default:
+				throw FmtRuntimeError("problem opening connection to shout server {}:{}: {}",
+						      shout_get_host(shout_conn),
+						      shout_get_port(shout_conn),
+						      shout_get_error(shout_conn));
+			}
+
+			break;
+
+		case State::CONNECTED:
+			break;
+		}
+	} catch (...) {
+		OnConnectionError(std::current_exception());
+	}
+
+	return state == State::CONNECTED;
+}
+
+void
+ShoutOutput::Discard(std::size_t size) noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (discard_time < now)
+		discard_time = now;
+
+	discard_time += audio_format.SizeToTime<std::chrono::steady_clock::duration>(size);
+}
+
+void
+ShoutOutput::Open(AudioFormat &_audio_format)
+{
+	encoder = prepared_encoder->Open(_audio_format);
+	encoder_dirty = false;
+	audio_format = _audio_format;
+	reconnect_delay = MIN_RECONNECT_DELAY;
+	discard_time = std::chrono::steady_clock::now();
 
 	try {
 		ShoutSetAudioInfo(shout_conn, audio_format);
-		ShoutOpen(shout_conn);
-		WritePage();
+
+		/* errors which are detected right away are reported
+		   to the caller; everything later is handled by
+		   reconnecting */
+		if (ShoutOpen(shout_conn))
+			OnConnected();
+		else
+			state = State::CONNECTING;
 	} catch (...) {
 		delete encoder;
+		ClearQueue();
+		state = State::DISCONNECTED;
 		throw;
 	}
 }
@@ -389,6 +685,13 @@ ShoutOutput::Open(AudioFormat &audio_format)
 std::chrono::steady_clock::duration
 ShoutOutput::Delay() const noexcept
 {
+	if (state != State::CONNECTED) {
+		const auto now = std::chrono::steady_clock::now();
+		return discard_time > now
+			? discard_time - now
+			: std::chrono::steady_clock::duration::zero();
+	}
+
 	int delay = shout_delay(shout_conn);
 	if (delay < 0)
 		delay = 0;
@@ -399,7 +702,13 @@ ShoutOutput::Delay() const noexcept
 std::size_t
 ShoutOutput::Play(std::span<const std::byte> src)
 {
+	if (!CheckConnected()) {
+		Discard(src.size());
+		return src.size();
+	}
+
 	encoder->Write(src);
+	encoder_dirty = true;
 	WritePage();
 	return src.size();
 }
@@ -409,7 +718,13 @@ ShoutOutput::Pause()
 {
 	static std::byte silence[1020];
 
+	if (!CheckConnected()) {
+		Discard(sizeof(silence));
+		return true;
+	}
+
 	encoder->Write(std::span{silence});
+	encoder_dirty = true;
 	WritePage();
 
 	return true;
@@ -428,6 +743,17 @@ shout_tag_to_metadata(const Tag &tag) noexcept
 
 void
 ShoutOutput::SendTag(const Tag &tag)
+{
+	last_tag = Tag{tag};
+
+	/* if not connected, the tag will be submitted by
+	   OnConnected() */
+	if (state == State::CONNECTED)
+		SubmitTag(tag);
+}
+
+void
+ShoutOutput::SubmitTag(const Tag &tag)
 {
 	if (encoder->ImplementsTag()) {
 		/* encoder plugin supports stream tags */
@@ -435,6 +761,7 @@ ShoutOutput::SendTag(const Tag &tag)
 		encoder->PreTag();
 		WritePage();
 		encoder->SendTag(tag);
+		encoder_dirty = true;
 	} else {
 		/* no stream tag support: fall back to icy-metadata */
 
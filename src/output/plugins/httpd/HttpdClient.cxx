@@ -3,8 +3,10 @@
 
 #include "HttpdClient.hxx"
 #include "HttpdInternal.hxx"
+#include "encoder/EncoderInterface.hxx"
 #include "util/AllocatedString.hxx"
 #include "Page.hxx"
+#include "PageRing.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "net/SocketError.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
@@ -15,8 +17,15 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 
+#ifndef _WIN32
+#include <sys/socket.h> // for MSG_DONTWAIT
+#include <sys/uio.h> // for struct iovec
+#endif
+
 using std::string_view_literals::operator""sv;
 
 HttpdClient::~HttpdClient() noexcept
@@ -42,10 +51,18 @@ void
 HttpdClient::BeginResponse() noexcept
 {
 	assert(state != State::RESPONSE);
+	assert(rendition != nullptr);
 
 	state = State::RESPONSE;
 	current_page = nullptr;
 
+	{
+		/* start streaming at the current position; older
+		   pages are not sent to new clients */
+		const std::scoped_lock protect{httpd.mutex};
+		next_page = rendition->ring.GetEnd();
+	}
+
 	if (!head_method)
 		httpd.SendHeader(*this);
 }
@@ -67,6 +84,9 @@ HttpdClient::HandleLine(std::string_view line) noexcept
 
 		const auto [uri, rest] = Split(line, ' ');
 
+		rendition = &httpd.FindRendition(Split(uri, '?').first);
+		metadata_supported = !rendition->encoder->ImplementsTag();
+
 		/* blacklist some well-known request paths */
 		if (uri == "favicon.ico"sv ||
 		    uri == "robots.txt"sv ||
@@ -127,7 +147,7 @@ HttpdClient::SendResponse() noexcept
 		allocated =
 			icy_server_metadata_header(httpd.name, httpd.genre,
 						   httpd.website,
-						   httpd.content_type,
+						   rendition->content_type,
 						   metaint);
 		response = allocated;
 	} else { /* revert to a normal HTTP request */
@@ -138,7 +158,7 @@ HttpdClient::SendResponse() noexcept
 					"Cache-Control: no-cache, no-store\r\n"
 					"Access-Control-Allow-Origin: *\r\n"
 					"\r\n",
-					httpd.content_type);
+					rendition->content_type);
 		response = allocated;
 	}
 
@@ -155,45 +175,13 @@ HttpdClient::SendResponse() noexcept
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput &_httpd, UniqueSocketDescriptor _fd,
-			 EventLoop &_loop,
-			 bool _metadata_supported)
-	:BufferedSocket(_fd.Release(), _loop),
-	 httpd(_httpd),
-	 metadata_supported(_metadata_supported)
+HttpdClient::HttpdClient(HttpdOutput &_httpd, HttpdShard &_shard,
+			 UniqueSocketDescriptor _fd) noexcept
+	:BufferedSocket(_fd.Release(), _shard.GetEventLoop()),
+	 httpd(_httpd), shard(_shard)
 {
 }
 
-void
-HttpdClient::ClearQueue() noexcept
-{
-	assert(state == State::RESPONSE);
-
-	while (!pages.empty()) {
-#ifndef NDEBUG
-		auto &page = pages.front();
-		assert(queue_size >= page->size());
-		queue_size -= page->size();
-#endif
-
-		pages.pop();
-	}
-
-	assert(queue_size == 0);
-}
-
-void
-HttpdClient::CancelQueue() noexcept
-{
-	if (state != State::RESPONSE)
-		return;
-
-	ClearQueue();
-
-	if (current_page == nullptr)
-		event.CancelWrite();
-}
-
 ssize_t
 HttpdClient::TryWritePage(const Page &page, size_t position) noexcept
 {
@@ -211,6 +199,58 @@ HttpdClient::TryWritePageN(const Page &page,
 		: TryWritePage(page, position);
 }
 
+ssize_t
+HttpdClient::TryWritePages(const PageRing &ring) noexcept
+{
+	assert(current_position < current_page->size());
+
+#ifdef _WIN32
+	return TryWritePage(*current_page, current_position);
+#else
+	std::array<struct iovec, 16> v;
+	std::size_t n = 0;
+
+	const auto append = [&v, &n](std::span<const std::byte> src){
+		v[n++] = {const_cast<std::byte *>(src.data()), src.size()};
+	};
+
+	append(std::span<const std::byte>{*current_page}.subspan(current_position));
+
+	for (auto i = next_page; n < v.size() && i < ring.GetEnd(); ++i)
+		append(*ring.Get(i));
+
+	return GetSocket().Send(std::span{v}.first(n), MSG_DONTWAIT);
+#endif
+}
+
+void
+HttpdClient::ConsumePages(const PageRing &ring, std::size_t nbytes) noexcept
+{
+	while (true) {
+		const std::size_t remaining =
+			current_page->size() - current_position;
+		if (nbytes < remaining) {
+			current_position += nbytes;
+			return;
+		}
+
+		nbytes -= remaining;
+		if (nbytes == 0)
+			break;
+
+		/* the following page was sent by TryWritePages() as
+		   well */
+		current_page = ring.Get(next_page++);
+		current_position = 0;
+	}
+
+	current_page.reset();
+
+	if (next_page >= ring.GetEnd())
+		/* all pages are sent: remove the event source */
+		event.CancelWrite();
+}
+
 ssize_t
 HttpdClient::GetBytesTillMetaData() const noexcept
 {
@@ -228,8 +268,14 @@ HttpdClient::TryWrite() noexcept
 
 	assert(state == State::RESPONSE);
 
+	const auto &ring = rendition->ring;
+
 	if (current_page == nullptr) {
-		if (pages.empty()) {
+		/* skip pages which were discarded by
+		   HttpdOutput::CancelAllClients() */
+		next_page = std::max(next_page, ring.GetBegin());
+
+		if (next_page >= ring.GetEnd()) {
 			/* another thread has removed the event source
 			   while this thread was waiting for
 			   httpd.mutex */
@@ -237,12 +283,8 @@ HttpdClient::TryWrite() noexcept
 			return true;
 		}
 
-		current_page = pages.front();
-		pages.pop();
+		current_page = ring.Get(next_page++);
 		current_position = 0;
-
-		assert(queue_size >= current_page->size());
-		queue_size -= current_page->size();
 	}
 
 	const ssize_t bytes_to_write = GetBytesTillMetaData();
@@ -296,6 +338,27 @@ HttpdClient::TryWrite() noexcept
 			metadata_fill = 0;
 			metadata_current_position = 0;
 		}
+	} else if (bytes_to_write < 0 && !metadata_requested) {
+		/* no metadata to be interleaved: send as many pages
+		   as possible at once */
+		ssize_t nbytes = TryWritePages(ring);
+		if (nbytes < 0) {
+			auto e = GetSocketError();
+			if (IsSocketErrorSendWouldBlock(e))
+				return true;
+
+			if (!IsSocketErrorClosed(e)) {
+				SocketErrorMessage msg(e);
+				FmtWarning(httpd_output_domain,
+					   "failed to write to client: {}",
+					   (const char *)msg);
+			}
+
+			Close();
+			return false;
+		}
+
+		ConsumePages(ring, nbytes);
 	} else {
 		ssize_t nbytes =
 			TryWritePageN(*current_page, current_position,
@@ -325,7 +388,7 @@ HttpdClient::TryWrite() noexcept
 		if (current_position >= current_page->size()) {
 			current_page.reset();
 
-			if (pages.empty())
+			if (next_page >= ring.GetEnd())
 				/* all pages are sent: remove the
 				   event source */
 				event.CancelWrite();
@@ -336,20 +399,36 @@ HttpdClient::TryWrite() noexcept
 }
 
 void
-HttpdClient::PushPage(PagePtr page) noexcept
+HttpdClient::PushHeader(PagePtr page) noexcept
+{
+	assert(state == State::RESPONSE);
+	assert(current_page == nullptr);
+
+	current_page = std::move(page);
+	current_position = 0;
+
+	event.ScheduleWrite();
+}
+
+void
+HttpdClient::OnPagesAvailable() noexcept
 {
 	if (state != State::RESPONSE)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
+	const auto &ring = rendition->ring;
+	if (current_page == nullptr && next_page >= ring.GetEnd())
+		/* nothing new in this client's rendition */
+		return;
+
+	if (ring.GetSizeFrom(next_page) > 256 * 1024) {
 		LogDebug(httpd_output_domain,
 			 "client is too slow, flushing its queue");
-		ClearQueue();
-	}
 
-	queue_size += page->size();
-	pages.emplace(std::move(page));
+		/* skip everything but the newest page */
+		next_page = ring.GetEnd() - 1;
+	}
 
 	event.ScheduleWrite();
 }
@@ -8,12 +8,14 @@
 #include "util/IntrusiveList.hxx"
 
 #include <cstddef>
-#include <list>
-#include <queue>
+#include <cstdint>
 #include <string_view>
 
 class UniqueSocketDescriptor;
 class HttpdOutput;
+struct HttpdShard;
+struct HttpdRendition;
+class PageRing;
 
 class HttpdClient final
 	: BufferedSocket,
@@ -24,6 +26,17 @@ class HttpdClient final
 	 */
 	HttpdOutput &httpd;
 
+	/**
+	 * The shard whose #EventLoop handles this client.
+	 */
+	HttpdShard &shard;
+
+	/**
+	 * The stream requested by this client; nullptr until the
+	 * request line has been received.
+	 */
+	HttpdRendition *rendition = nullptr;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -39,17 +52,16 @@ class HttpdClient final
 	} state = State::REQUEST;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
-	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
-
-	/**
-	 * The sum of all page sizes in #pages.
+	 * The sequence number of the next page in the shared
+	 * #PageRing to be sent to the client.  UINT_LEAST64_MAX until
+	 * the response begins.  Protected by HttpdOutput::mutex.
 	 */
-	size_t queue_size = 0;
+	uint_least64_t next_page = UINT_LEAST64_MAX;
 
 	/**
 	 * The #page which is currently being sent to the client.
+	 * Holding a reference here allows the #PageRing to discard
+	 * it while it is being sent.
 	 */
 	PagePtr current_page;
 
@@ -73,9 +85,9 @@ class HttpdClient final
 
 	/**
 	 * Do we support sending Icy-Metadata to the client?  This is
-	 * disabled if the httpd audio output uses encoder tags.
+	 * disabled if the requested rendition uses encoder tags.
 	 */
-	bool metadata_supported;
+	bool metadata_supported = false;
 
 	/**
 	 * If we should sent icy metadata.
@@ -113,12 +125,13 @@ class HttpdClient final
 
 public:
 	/**
+	 * Must be called in the shard's #EventLoop.
+	 *
 	 * @param httpd the HTTP output device
 	 * @param _fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput &httpd, UniqueSocketDescriptor _fd,
-		    EventLoop &_loop,
-		    bool _metadata_supported);
+	HttpdClient(HttpdOutput &httpd, HttpdShard &_shard,
+		    UniqueSocketDescriptor _fd) noexcept;
 
 	/**
 	 * Note: this does not remove the client from the
@@ -135,10 +148,30 @@ public:
 
 	void LockClose() noexcept;
 
+	HttpdShard &GetShard() const noexcept {
+		return shard;
+	}
+
 	/**
-	 * Clears the page queue.
+	 * Returns the rendition requested by this client or nullptr
+	 * if the request has not been received yet.
 	 */
-	void CancelQueue() noexcept;
+	HttpdRendition *GetRendition() const noexcept {
+		return rendition;
+	}
+
+	/**
+	 * Returns the sequence number of the oldest page in the
+	 * #PageRing this client still needs, or UINT_LEAST64_MAX if
+	 * it does not need any.  Pages discarded by
+	 * HttpdOutput::CancelAllClients() are skipped by TryWrite().
+	 *
+	 * Caller must lock the mutex.
+	 */
+	[[gnu::pure]]
+	uint_least64_t GetNextPage() const noexcept {
+		return next_page;
+	}
 
 	/**
 	 * Handle a line of the HTTP request.
@@ -162,12 +195,26 @@ public:
 	ssize_t TryWritePageN(const Page &page,
 			      size_t position, ssize_t n) noexcept;
 
+	/**
+	 * Send the rest of #current_page and as many following
+	 * pages from the #PageRing as possible with one system call.
+	 */
+	ssize_t TryWritePages(const PageRing &ring) noexcept;
+
 	bool TryWrite() noexcept;
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends the given page to this client before the pages from
+	 * the #PageRing.  This is used for the encoder header.
 	 */
-	void PushPage(PagePtr page) noexcept;
+	void PushHeader(PagePtr page) noexcept;
+
+	/**
+	 * New pages may have been added to the #PageRing.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void OnPagesAvailable() noexcept;
 
 	/**
 	 * Sends the passed metadata.
@@ -175,7 +222,11 @@ public:
 	void PushMetaData(PagePtr page) noexcept;
 
 private:
-	void ClearQueue() noexcept;
+	/**
+	 * Mark the given number of bytes (starting at
+	 * #current_position) as sent.
+	 */
+	void ConsumePages(const PageRing &ring, std::size_t nbytes) noexcept;
 
 protected:
 	/* virtual methods from class BufferedSocket */
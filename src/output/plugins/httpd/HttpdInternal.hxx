@@ -9,12 +9,15 @@
 #pragma once
 
 #include "HttpdClient.hxx"
+#include "PageRing.hxx"
 #include "output/Interface.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "event/ServerSocket.hxx"
 #include "event/InjectEvent.hxx"
+#include "event/Thread.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
 #include "util/Cast.hxx"
 #include "util/IntrusiveList.hxx"
 
@@ -22,6 +25,9 @@
 #include <list>
 #include <memory>
 #include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 struct ConfigBlock;
 class EventLoop;
@@ -29,23 +35,34 @@ class ServerSocket;
 class HttpdClient;
 class PreparedEncoder;
 class Encoder;
+class PcmConvert;
 struct Tag;
 
-class HttpdOutput final : AudioOutput, ServerSocket {
+/**
+ * One encoded stream offered by a #HttpdOutput.  Each rendition has
+ * its own encoder and URI path; all of its clients share the encoded
+ * pages.
+ */
+struct HttpdRendition {
 	/**
-	 * True if the audio output is open and accepts client
-	 * connections.
+	 * The URI path (without the leading slash).  It is empty for
+	 * the default rendition, which is sent for all paths not
+	 * claimed by another rendition.
 	 */
-	bool open;
-
-	bool pause;
+	const std::string path;
 
 	/**
 	 * The configured encoder plugin.
 	 */
-	std::unique_ptr<PreparedEncoder> prepared_encoder;
+	const std::unique_ptr<PreparedEncoder> prepared_encoder;
 	Encoder *encoder = nullptr;
 
+	/**
+	 * Converts the PCM data if this rendition's encoder needs a
+	 * different #AudioFormat than the output.
+	 */
+	std::unique_ptr<PcmConvert> convert;
+
 	/**
 	 * Number of bytes which were fed into the encoder, without
 	 * ever receiving new output.  This is used to estimate
@@ -54,12 +71,124 @@ class HttpdOutput final : AudioOutput, ServerSocket {
 	 */
 	size_t unflushed_input = 0;
 
-public:
 	/**
 	 * The MIME type produced by the #encoder.
 	 */
 	const char *content_type;
 
+	/**
+	 * The header page, which is sent to every client on connect.
+	 */
+	PagePtr header;
+
+	/**
+	 * The page queue, i.e. pages from the encoder to be
+	 * broadcasted to all clients.  This container is necessary to
+	 * pass pages from the OutputThread to the IOThread.  It is
+	 * protected by HttpdOutput::mutex, and removing signals
+	 * HttpdOutput::cond.
+	 */
+	std::queue<PagePtr, std::list<PagePtr>> pages;
+
+	/**
+	 * Pages which have been broadcasted, but not yet sent to all
+	 * clients.  It is shared by all clients, each of which only
+	 * keeps a cursor.  Protected by HttpdOutput::mutex.
+	 */
+	PageRing ring;
+
+	HttpdRendition(std::string_view _path,
+		       std::unique_ptr<PreparedEncoder> _prepared_encoder);
+	~HttpdRendition() noexcept;
+
+	HttpdRendition(const HttpdRendition &) = delete;
+	HttpdRendition &operator=(const HttpdRendition &) = delete;
+
+	/**
+	 * Throws on error.
+	 */
+	void OpenEncoder(AudioFormat &audio_format);
+
+	void CloseEncoder() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Write(std::span<const std::byte> src);
+
+	/**
+	 * Reads data from the encoder (as much as available) and
+	 * returns it as a new #page object.
+	 */
+	PagePtr ReadPage() noexcept;
+};
+
+using HttpdClientList =
+	IntrusiveList<HttpdClient, IntrusiveListBaseHookTraits<HttpdClient>,
+		      IntrusiveListOptions{.constant_time_size = true}>;
+
+/**
+ * An #EventLoop which handles a subset of the clients of a
+ * #HttpdOutput.  All fields are protected by HttpdOutput::mutex.
+ */
+struct HttpdShard {
+	HttpdOutput &httpd;
+
+	/**
+	 * Wakes up the #EventLoop after connections have been
+	 * accepted or pages have been added to the #PageRing.
+	 */
+	InjectEvent inject;
+
+	/**
+	 * Connections which were accepted by the listener socket and
+	 * shall be handled by this shard.
+	 */
+	std::vector<UniqueSocketDescriptor> accepted;
+
+	/**
+	 * The clients which are handled by this shard's #EventLoop.
+	 */
+	HttpdClientList clients;
+
+	/**
+	 * Have pages been added to the #PageRing which the #clients
+	 * have not yet been notified about?
+	 */
+	bool pages_available = false;
+
+	HttpdShard(HttpdOutput &_httpd, EventLoop &_loop) noexcept;
+
+	HttpdShard(const HttpdShard &) = delete;
+	HttpdShard &operator=(const HttpdShard &) = delete;
+
+	EventLoop &GetEventLoop() const noexcept {
+		return inject.GetEventLoop();
+	}
+
+private:
+	/* InjectEvent callback */
+	void OnInject() noexcept;
+};
+
+class HttpdOutput final : AudioOutput, ServerSocket {
+	friend struct HttpdShard;
+
+	/**
+	 * True if the audio output is open and accepts client
+	 * connections.
+	 */
+	bool open;
+
+	bool pause;
+
+	/**
+	 * The streams offered to clients; the first one is the
+	 * default.  This list is not modified after construction.
+	 */
+	std::list<HttpdRendition> renditions;
+
+public:
 	/**
 	 * This mutex protects the listener socket and the client
 	 * list.
@@ -68,7 +197,7 @@ public:
 
 	/**
 	 * This condition gets signalled when an item is removed from
-	 * #pages.
+	 * HttpdRendition::pages.
 	 */
 	Cond cond;
 
@@ -79,24 +208,11 @@ private:
 	 */
 	Timer *timer;
 
-	/**
-	 * The header page, which is sent to every client on connect.
-	 */
-	PagePtr header;
-
 	/**
 	 * The metadata, which is sent to every client.
 	 */
 	PagePtr metadata;
 
-	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
-	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
-
 	InjectEvent defer_broadcast;
 
  public:
@@ -117,12 +233,26 @@ private:
 
 private:
 	/**
-	 * A linked list containing all clients which are currently
-	 * connected.
+	 * Dedicated threads for the clients (setting "threads").  If
+	 * this is empty, all clients run in the #EventLoop of the
+	 * listener socket.
 	 */
-	IntrusiveList<
-		HttpdClient, IntrusiveListBaseHookTraits<HttpdClient>,
-		IntrusiveListOptions{.constant_time_size = true}> clients;
+	std::list<EventThread> threads;
+
+	bool threads_started = false;
+
+	/**
+	 * One #HttpdShard per #EventLoop; each new client is assigned
+	 * to the shard with the fewest clients.
+	 */
+	std::list<HttpdShard> shards;
+
+	/**
+	 * The number of clients in all #shards (including accepted
+	 * connections which have not been passed to their shard's
+	 * #EventLoop yet).  Protected by #mutex.
+	 */
+	unsigned n_clients = 0;
 
 	/**
 	 * The maximum number of clients connected at the same time.
@@ -151,11 +281,13 @@ public:
 	}
 
 	/**
+	 * Open the encoders of all renditions.
+	 *
 	 * Caller must lock the mutex.
 	 *
 	 * Throws on error.
 	 */
-	void OpenEncoder(AudioFormat &audio_format);
+	void OpenEncoders(AudioFormat &audio_format);
 
 	/**
 	 * Caller must lock the mutex.
@@ -174,7 +306,7 @@ public:
 	 */
 	[[gnu::pure]]
 	bool HasClients() const noexcept {
-		return !clients.empty();
+		return n_clients > 0;
 	}
 
 	/**
@@ -189,7 +321,7 @@ public:
 	/**
 	 * Caller must lock the mutex.
 	 */
-	void AddClient(UniqueSocketDescriptor fd) noexcept;
+	void AddClient(HttpdShard &shard, UniqueSocketDescriptor fd) noexcept;
 
 	/**
 	 * Removes a client from the httpd_output.clients linked list.
@@ -198,6 +330,14 @@ public:
 	 */
 	void RemoveClient(HttpdClient &client) noexcept;
 
+	/**
+	 * Find the rendition for the given request URI path (without
+	 * the leading slash and without the query string).  Falls
+	 * back to the default rendition.
+	 */
+	[[gnu::pure]]
+	HttpdRendition &FindRendition(std::string_view path) noexcept;
+
 	/**
 	 * Sends the encoder header to the client.  This is called
 	 * right after the response headers have been sent.
@@ -208,24 +348,18 @@ public:
 	std::chrono::steady_clock::duration Delay() const noexcept override;
 
 	/**
-	 * Reads data from the encoder (as much as available) and
-	 * returns it as a new #page object.
-	 */
-	PagePtr ReadPage() noexcept;
-
-	/**
-	 * Broadcasts a page struct to all clients.
+	 * Broadcasts a page struct to all clients of the rendition.
 	 *
 	 * Mutext must not be locked.
 	 */
-	void BroadcastPage(PagePtr page) noexcept;
+	void BroadcastPage(HttpdRendition &rendition, PagePtr page) noexcept;
 
 	/**
-	 * Broadcasts data from the encoder to all clients.
+	 * Broadcasts data from all encoders to all clients.
 	 *
 	 * Mutext must not be locked.
 	 */
-	void BroadcastFromEncoder() noexcept;
+	void BroadcastFromEncoders() noexcept;
 
 	/**
 	 * Mutext must not be locked.
@@ -243,10 +377,30 @@ public:
 	 */
 	void CancelAllClients() noexcept;
 
+	/**
+	 * Caller must lock the mutex.
+	 */
+	[[gnu::pure]]
+	HttpdShard &GetLeastLoadedShard() noexcept;
+
 	void Cancel() noexcept override;
 	bool Pause() override;
 
 private:
+	/**
+	 * Discard all pages from the #PageRing instances which have
+	 * been sent to all clients.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void TrimPageRings() noexcept;
+
+	/**
+	 * Called by HttpdShard::OnInject() in the shard's
+	 * #EventLoop.
+	 */
+	void OnShardInject(HttpdShard &shard) noexcept;
+
 	/* InjectEvent callback */
 	void OnDeferredBroadcast() noexcept;
 
@@ -7,6 +7,8 @@
 #include "output/OutputAPI.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/Configured.hxx"
+#include "pcm/Convert.hxx"
+#include "config/Block.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "net/SocketAddress.hxx"
 #include "Page.hxx"
@@ -15,8 +17,15 @@
 #include "net/DscpParser.hxx"
 #include "util/Domain.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/StringSplit.hxx"
 #include "config/Net.hxx"
+#include "config/ThreadConfig.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 
+#include <fmt/format.h>
+
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -24,11 +33,56 @@
 
 const Domain httpd_output_domain("httpd_output");
 
+HttpdShard::HttpdShard(HttpdOutput &_httpd, EventLoop &_loop) noexcept
+	:httpd(_httpd), inject(_loop, BIND_THIS_METHOD(OnInject))
+{
+}
+
+void
+HttpdShard::OnInject() noexcept
+{
+	httpd.OnShardInject(*this);
+}
+
+HttpdRendition::HttpdRendition(std::string_view _path,
+			       std::unique_ptr<PreparedEncoder> _prepared_encoder)
+	:path(_path), prepared_encoder(std::move(_prepared_encoder))
+{
+	/* determine content type */
+	content_type = prepared_encoder->GetMimeType();
+	if (content_type == nullptr)
+		content_type = "application/octet-stream";
+}
+
+HttpdRendition::~HttpdRendition() noexcept = default;
+
+/**
+ * Collect the settings of the given rendition, i.e. all settings
+ * with the prefix "rendition_NAME_", into a new #ConfigBlock without
+ * the prefix.
+ */
+static ConfigBlock
+GetRenditionBlock(const ConfigBlock &block, std::string_view name)
+{
+	const std::string prefix = fmt::format("rendition_{}_", name);
+
+	ConfigBlock result{block.line};
+	for (const auto &i : block.block_params) {
+		if (!i.name.starts_with(prefix))
+			continue;
+
+		i.used = true;
+		result.AddBlockParam(i.name.c_str() + prefix.size(),
+				     i.value.c_str(), i.line);
+	}
+
+	return result;
+}
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
 	 ServerSocket(_loop),
-	 prepared_encoder(CreateConfiguredEncoder(block)),
 	 defer_broadcast(_loop, BIND_THIS_METHOD(OnDeferredBroadcast)),
 	 name(block.GetBlockValue("name", "Set name in config")),
 	 genre(block.GetBlockValue("genre", "Set genre in config")),
@@ -48,10 +102,47 @@ HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 
 	ServerSocketAddGeneric(*this, block.GetBlockValue("bind_to_address"), block.GetBlockValue("port", 8000U));
 
-	/* determine content type */
-	content_type = prepared_encoder->GetMimeType();
-	if (content_type == nullptr)
-		content_type = "application/octet-stream";
+	/* set up the encoders */
+
+	renditions.emplace_back(std::string_view{},
+				std::unique_ptr<PreparedEncoder>(CreateConfiguredEncoder(block)));
+
+	if (const char *s = block.GetBlockValue("renditions")) {
+		for (const std::string_view rendition : IterableSplitString(s, ' ')) {
+			if (rendition.empty())
+				continue;
+
+			const auto sub = GetRenditionBlock(block, rendition);
+			std::string_view path = sub.GetBlockValue("path", "");
+			if (path.starts_with('/'))
+				path.remove_prefix(1);
+			if (path.empty())
+				path = rendition;
+
+			for (const auto &i : renditions)
+				if (i.path == path)
+					throw FmtRuntimeError("Duplicate rendition path {:?}",
+							      path);
+
+			renditions.emplace_back(path,
+						std::unique_ptr<PreparedEncoder>(CreateConfiguredEncoder(sub)));
+		}
+	}
+
+	/* set up the client threads */
+
+	const unsigned n_threads = block.GetBlockValue("threads", 0U);
+	if (n_threads > 64)
+		throw std::runtime_error("Too many threads");
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		auto &thread = threads.emplace_back();
+		thread.SetScheduling(GetThreadScheduling("io"));
+		shards.emplace_back(*this, thread.GetEventLoop());
+	}
+
+	if (shards.empty())
+		shards.emplace_back(*this, _loop);
 }
 
 inline void
@@ -59,6 +150,16 @@ HttpdOutput::Bind()
 {
 	open = false;
 
+	if (!threads_started) {
+		/* the threads are started only once, because an
+		   EventLoop cannot be run by another thread after its
+		   first thread has exited; they will be stopped by
+		   the destructor */
+		for (auto &thread : threads)
+			thread.Start();
+		threads_started = true;
+	}
+
 	BlockingCall(GetEventLoop(), [this](){
 			ServerSocket::Open();
 		});
@@ -76,18 +177,83 @@ HttpdOutput::Unbind() noexcept
 
 /**
  * Creates a new #HttpdClient object and adds it into the
- * HttpdOutput.clients linked list.
+ * HttpdShard.clients linked list.
  */
 inline void
-HttpdOutput::AddClient(UniqueSocketDescriptor fd) noexcept
+HttpdOutput::AddClient(HttpdShard &shard, UniqueSocketDescriptor fd) noexcept
 {
-	auto *client = new HttpdClient(*this, std::move(fd), GetEventLoop(),
-				       !encoder->ImplementsTag());
-	clients.push_front(*client);
+	auto *client = new HttpdClient(*this, shard, std::move(fd));
+	shard.clients.push_front(*client);
 
 	/* pass metadata to client */
 	if (metadata != nullptr)
-		clients.front().PushMetaData(metadata);
+		client->PushMetaData(metadata);
+}
+
+HttpdShard &
+HttpdOutput::GetLeastLoadedShard() noexcept
+{
+	assert(!shards.empty());
+
+	auto *result = &shards.front();
+	for (auto &shard : shards)
+		if (shard.clients.size() + shard.accepted.size() <
+		    result->clients.size() + result->accepted.size())
+			result = &shard;
+
+	return *result;
+}
+
+void
+HttpdOutput::OnShardInject(HttpdShard &shard) noexcept
+{
+	/* this method runs in the shard's EventLoop */
+
+	const std::scoped_lock protect{mutex};
+
+	for (auto &fd : shard.accepted) {
+		if (open)
+			AddClient(shard, std::move(fd));
+		else
+			--n_clients;
+	}
+
+	shard.accepted.clear();
+
+	if (shard.pages_available) {
+		shard.pages_available = false;
+
+		for (auto &client : shard.clients)
+			client.OnPagesAvailable();
+
+		TrimPageRings();
+	}
+}
+
+void
+HttpdOutput::TrimPageRings() noexcept
+{
+	for (auto &rendition : renditions) {
+		uint_least64_t min = rendition.ring.GetEnd();
+		for (const auto &shard : shards)
+			for (const auto &client : shard.clients)
+				if (client.GetRendition() == &rendition)
+					min = std::min(min, client.GetNextPage());
+
+		rendition.ring.TrimBefore(min);
+	}
+}
+
+HttpdRendition &
+HttpdOutput::FindRendition(std::string_view path) noexcept
+{
+	assert(!renditions.empty());
+
+	for (auto &i : renditions)
+		if (!i.path.empty() && i.path == path)
+			return i;
+
+	return renditions.front();
 }
 
 void
@@ -98,12 +264,21 @@ HttpdOutput::OnDeferredBroadcast() noexcept
 
 	const std::scoped_lock protect{mutex};
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
+	bool pages_available = false;
+	for (auto &rendition : renditions) {
+		while (!rendition.pages.empty()) {
+			rendition.ring.Push(std::move(rendition.pages.front()));
+			rendition.pages.pop();
+			pages_available = true;
+		}
+	}
 
-		for (auto &client : clients)
-			client.PushPage(page);
+	if (pages_available) {
+		/* let each shard's EventLoop notify its clients */
+		for (auto &shard : shards) {
+			shard.pages_available = true;
+			shard.inject.Schedule();
+		}
 	}
 
 	/* wake up the client that may be waiting for the queue to be
@@ -121,12 +296,18 @@ HttpdOutput::OnAccept(UniqueSocketDescriptor fd,
 	const std::scoped_lock protect{mutex};
 
 	/* can we allow additional client */
-	if (open && (clients_max == 0 || clients.size() < clients_max))
-		AddClient(std::move(fd));
+	if (open && (clients_max == 0 || n_clients < clients_max)) {
+		/* the client is created by the shard's EventLoop
+		   thread */
+		auto &shard = GetLeastLoadedShard();
+		shard.accepted.emplace_back(std::move(fd));
+		++n_clients;
+		shard.inject.Schedule();
+	}
 }
 
 PagePtr
-HttpdOutput::ReadPage() noexcept
+HttpdRendition::ReadPage() noexcept
 {
 	if (unflushed_input >= 65536) {
 		/* we have fed a lot of input into the encoder, but it
@@ -178,8 +359,8 @@ HttpdOutput::ReadPage() noexcept
 	return std::make_shared<Page>(std::span{buffer, size});
 }
 
-inline void
-HttpdOutput::OpenEncoder(AudioFormat &audio_format)
+void
+HttpdRendition::OpenEncoder(AudioFormat &audio_format)
 {
 	encoder = prepared_encoder->Open(audio_format);
 
@@ -191,15 +372,66 @@ HttpdOutput::OpenEncoder(AudioFormat &audio_format)
 	unflushed_input = 0;
 }
 
+void
+HttpdRendition::CloseEncoder() noexcept
+{
+	ring.Clear();
+	header.reset();
+	convert.reset();
+
+	delete encoder;
+	encoder = nullptr;
+}
+
+void
+HttpdRendition::Write(std::span<const std::byte> src)
+{
+	if (convert)
+		src = convert->Convert(src);
+
+	encoder->Write(src);
+
+	unflushed_input += src.size();
+}
+
+inline void
+HttpdOutput::OpenEncoders(AudioFormat &audio_format)
+{
+	/* the default rendition may modify the output's audio
+	   format */
+	auto &first = renditions.front();
+	first.OpenEncoder(audio_format);
+
+	try {
+		for (auto &i : renditions) {
+			if (&i == &first)
+				continue;
+
+			/* if this encoder wants a different audio
+			   format, convert it */
+			AudioFormat rendition_format = audio_format;
+			i.OpenEncoder(rendition_format);
+			if (rendition_format != audio_format)
+				i.convert = std::make_unique<PcmConvert>(audio_format,
+									 rendition_format);
+		}
+	} catch (...) {
+		for (auto &i : renditions)
+			if (i.encoder != nullptr)
+				i.CloseEncoder();
+		throw;
+	}
+}
+
 void
 HttpdOutput::Open(AudioFormat &audio_format)
 {
 	assert(!open);
-	assert(clients.empty());
+	assert(n_clients == 0);
 
 	const std::scoped_lock protect{mutex};
 
-	OpenEncoder(audio_format);
+	OpenEncoders(audio_format);
 
 	/* initialize other attributes */
 
@@ -221,19 +453,36 @@ HttpdOutput::Close() noexcept
 
 			const std::scoped_lock protect{mutex};
 			open = false;
-			clients.clear_and_dispose(DeleteDisposer());
 		});
 
-	header.reset();
+	/* each client must be destroyed in its own EventLoop */
+	for (auto &shard : shards) {
+		BlockingCall(shard.GetEventLoop(), [this, &shard](){
+			shard.inject.Cancel();
 
-	delete encoder;
+			const std::scoped_lock protect{mutex};
+			n_clients -= shard.accepted.size() + shard.clients.size();
+			shard.accepted.clear();
+			shard.clients.clear_and_dispose(DeleteDisposer());
+			shard.pages_available = false;
+		});
+	}
+
+	const std::scoped_lock protect{mutex};
+	assert(n_clients == 0);
+
+	for (auto &i : renditions)
+		i.CloseEncoder();
 }
 
 void
 HttpdOutput::RemoveClient(HttpdClient &client) noexcept
 {
+	auto &clients = client.GetShard().clients;
 	assert(!clients.empty());
+	assert(n_clients > 0);
 
+	--n_clients;
 	clients.erase_and_dispose(clients.iterator_to(client),
 				  DeleteDisposer());
 }
@@ -241,8 +490,9 @@ HttpdOutput::RemoveClient(HttpdClient &client) noexcept
 void
 HttpdOutput::SendHeader(HttpdClient &client) const noexcept
 {
-	if (header != nullptr)
-		client.PushPage(header);
+	const auto &rendition = *client.GetRendition();
+	if (rendition.header != nullptr)
+		client.PushHeader(rendition.header);
 }
 
 std::chrono::steady_clock::duration
@@ -267,34 +517,41 @@ HttpdOutput::Delay() const noexcept
 }
 
 void
-HttpdOutput::BroadcastPage(PagePtr page) noexcept
+HttpdOutput::BroadcastPage(HttpdRendition &rendition, PagePtr page) noexcept
 {
 	assert(page != nullptr);
 
 	{
 		const std::scoped_lock lock{mutex};
-		pages.emplace(std::move(page));
+		rendition.pages.emplace(std::move(page));
 	}
 
 	defer_broadcast.Schedule();
 }
 
 void
-HttpdOutput::BroadcastFromEncoder() noexcept
+HttpdOutput::BroadcastFromEncoders() noexcept
 {
 	/* synchronize with the IOThread */
 	{
 		std::unique_lock lock{mutex};
-		cond.wait(lock, [this]{ return pages.empty(); });
+		cond.wait(lock, [this]{
+			return std::all_of(renditions.begin(), renditions.end(),
+					   [](const auto &i){
+						   return i.pages.empty();
+					   });
+		});
 	}
 
 	bool empty = true;
 
-	PagePtr page;
-	while ((page = ReadPage()) != nullptr) {
-		const std::scoped_lock lock{mutex};
-		pages.emplace(std::move(page));
-		empty = false;
+	for (auto &rendition : renditions) {
+		PagePtr page;
+		while ((page = rendition.ReadPage()) != nullptr) {
+			const std::scoped_lock lock{mutex};
+			rendition.pages.emplace(std::move(page));
+			empty = false;
+		}
 	}
 
 	if (!empty)
@@ -304,11 +561,10 @@ HttpdOutput::BroadcastFromEncoder() noexcept
 inline void
 HttpdOutput::EncodeAndPlay(std::span<const std::byte> src)
 {
-	encoder->Write(src);
-
-	unflushed_input += src.size();
+	for (auto &rendition : renditions)
+		rendition.Write(src);
 
-	BroadcastFromEncoder();
+	BroadcastFromEncoders();
 }
 
 std::size_t
@@ -342,39 +598,59 @@ HttpdOutput::Pause()
 void
 HttpdOutput::SendTag(const Tag &tag)
 {
-	if (encoder->ImplementsTag()) {
+	bool use_icy = false, use_encoder = false;
+	for (const auto &rendition : renditions) {
+		if (rendition.encoder->ImplementsTag())
+			use_encoder = true;
+		else
+			use_icy = true;
+	}
+
+	if (use_encoder) {
 		/* embed encoder tags */
 
 		/* flush the current stream, and end it */
 
-		try {
-			encoder->PreTag();
-		} catch (...) {
-			/* ignore */
+		for (auto &rendition : renditions) {
+			if (!rendition.encoder->ImplementsTag())
+				continue;
+
+			try {
+				rendition.encoder->PreTag();
+			} catch (...) {
+				/* ignore */
+			}
 		}
 
-		BroadcastFromEncoder();
+		BroadcastFromEncoders();
 
-		/* send the tag to the encoder - which starts a new
-		   stream now */
+		for (auto &rendition : renditions) {
+			if (!rendition.encoder->ImplementsTag())
+				continue;
 
-		try {
-			encoder->SendTag(tag);
-			encoder->Flush();
-		} catch (...) {
-			/* ignore */
-		}
+			/* send the tag to the encoder - which starts
+			   a new stream now */
+
+			try {
+				rendition.encoder->SendTag(tag);
+				rendition.encoder->Flush();
+			} catch (...) {
+				/* ignore */
+			}
 
-		/* the first page generated by the encoder will now be
-		   used as the new "header" page, which is sent to all
-		   new clients */
+			/* the first page generated by the encoder
+			   will now be used as the new "header" page,
+			   which is sent to all new clients */
 
-		auto page = ReadPage();
-		if (page != nullptr) {
-			header = page;
-			BroadcastPage(page);
+			auto page = rendition.ReadPage();
+			if (page != nullptr) {
+				rendition.header = page;
+				BroadcastPage(rendition, page);
+			}
 		}
-	} else {
+	}
+
+	if (use_icy) {
 		/* use Icy-Metadata */
 
 		static constexpr TagType types[] = {
@@ -385,8 +661,9 @@ HttpdOutput::SendTag(const Tag &tag)
 		metadata = icy_server_metadata_page(tag, &types[0]);
 		if (metadata != nullptr) {
 			const std::scoped_lock protect{mutex};
-			for (auto &client : clients)
-				client.PushMetaData(metadata);
+			for (auto &shard : shards)
+				for (auto &client : shard.clients)
+					client.PushMetaData(metadata);
 		}
 	}
 }
@@ -396,13 +673,14 @@ HttpdOutput::CancelAllClients() noexcept
 {
 	const std::scoped_lock protect{mutex};
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
-	}
+	for (auto &rendition : renditions) {
+		while (!rendition.pages.empty())
+			rendition.pages.pop();
 
-	for (auto &client : clients)
-		client.CancelQueue();
+		/* the clients will skip the discarded pages in
+		   HttpdClient::TryWrite() */
+		rendition.ring.Clear();
+	}
 
 	cond.notify_all();
 }
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Page.hxx"
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+
+/**
+ * The encoded stream which is shared by all #HttpdClient instances.
+ * Each page is stored only once; clients only keep a cursor (a page
+ * sequence number) into this ring, and pages are discarded as soon
+ * as the slowest client has passed them.
+ *
+ * This class is not thread-safe.
+ */
+class PageRing {
+	struct Item {
+		PagePtr page;
+
+		/**
+		 * The stream position (in bytes) of the end of this
+		 * page.
+		 */
+		uint_least64_t end_position;
+	};
+
+	std::deque<Item> items;
+
+	/**
+	 * The sequence number of the first item in #items.
+	 */
+	uint_least64_t first = 0;
+
+	/**
+	 * The stream position of the beginning of the first item.
+	 */
+	uint_least64_t begin_position = 0;
+
+public:
+	/**
+	 * The sequence number of the oldest page still available.
+	 */
+	uint_least64_t GetBegin() const noexcept {
+		return first;
+	}
+
+	/**
+	 * The sequence number of the next page which will be pushed.
+	 */
+	uint_least64_t GetEnd() const noexcept {
+		return first + items.size();
+	}
+
+	const PagePtr &Get(uint_least64_t seq) const noexcept {
+		assert(seq >= GetBegin());
+		assert(seq < GetEnd());
+
+		return items[seq - first].page;
+	}
+
+	/**
+	 * Returns the number of bytes from the beginning of the given
+	 * page to the end of the ring.  Discarded pages are not
+	 * counted.
+	 */
+	[[gnu::pure]]
+	uint_least64_t GetSizeFrom(uint_least64_t seq) const noexcept {
+		if (seq >= GetEnd())
+			return 0;
+
+		const uint_least64_t end_position = items.empty()
+			? begin_position
+			: items.back().end_position;
+
+		if (seq <= first)
+			return end_position - begin_position;
+
+		return end_position - items[seq - first - 1].end_position;
+	}
+
+	void Push(PagePtr page) noexcept {
+		assert(page != nullptr);
+
+		const uint_least64_t end_position = (items.empty()
+						     ? begin_position
+						     : items.back().end_position)
+			+ page->size();
+		items.push_back({std::move(page), end_position});
+	}
+
+	/**
+	 * Discard all pages before the given sequence number.
+	 */
+	void TrimBefore(uint_least64_t seq) noexcept {
+		while (first < seq && !items.empty()) {
+			begin_position = items.front().end_position;
+			items.pop_front();
+			++first;
+		}
+	}
+
+	/**
+	 * Discard all pages.  The sequence numbers continue to grow.
+	 */
+	void Clear() noexcept {
+		TrimBefore(GetEnd());
+	}
+};
@@ -6,11 +6,12 @@
 
 #include "util/AllocatedArray.hxx"
 
+#include <cassert>
 #include <chrono>
 #include <cstddef>
-#include <list>
+#include <cstdint>
+#include <deque>
 #include <memory>
-#include <queue>
 
 /**
  * A chunk of data to be transmitted to connected Snapcast clients.
@@ -26,14 +27,79 @@ struct SnapcastChunk {
 
 using SnapcastChunkPtr = std::shared_ptr<SnapcastChunk>;
 
-using SnapcastChunkQueue = std::queue<SnapcastChunkPtr,
-				      std::list<SnapcastChunkPtr>>;
+/**
+ * The encoded stream which is shared by all #SnapcastClient
+ * instances.  Each chunk is stored only once; clients only keep a
+ * cursor (a chunk sequence number) into this ring.
+ *
+ * This class is not thread-safe.
+ */
+class SnapcastChunkRing {
+	std::deque<SnapcastChunkPtr> items;
+
+	/**
+	 * The sequence number of the first item in #items.
+	 */
+	uint_least64_t first = 0;
+
+public:
+	bool empty() const noexcept {
+		return items.empty();
+	}
+
+	/**
+	 * The sequence number of the oldest chunk still available.
+	 */
+	uint_least64_t GetBegin() const noexcept {
+		return first;
+	}
+
+	/**
+	 * The sequence number of the next chunk which will be pushed.
+	 */
+	uint_least64_t GetEnd() const noexcept {
+		return first + items.size();
+	}
+
+	const SnapcastChunkPtr &Get(uint_least64_t seq) const noexcept {
+		assert(seq >= GetBegin());
+		assert(seq < GetEnd());
 
-inline void
-ClearQueue(SnapcastChunkQueue &q) noexcept
-{
-	while (!q.empty())
-		q.pop();
-}
+		return items[seq - first];
+	}
+
+	void Push(SnapcastChunkPtr chunk) noexcept {
+		assert(chunk != nullptr);
+
+		items.push_back(std::move(chunk));
+	}
+
+	/**
+	 * Discard all chunks before the given sequence number.
+	 */
+	void TrimBefore(uint_least64_t seq) noexcept {
+		while (first < seq && !items.empty()) {
+			items.pop_front();
+			++first;
+		}
+	}
+
+	/**
+	 * Discard all chunks older than the given time.
+	 */
+	void TrimOlderThan(std::chrono::steady_clock::time_point t) noexcept {
+		while (!items.empty() && items.front()->time < t) {
+			items.pop_front();
+			++first;
+		}
+	}
+
+	/**
+	 * Discard all chunks.  The sequence numbers continue to grow.
+	 */
+	void Clear() noexcept {
+		TrimBefore(GetEnd());
+	}
+};
 
 #endif
@@ -14,10 +14,17 @@
 #include "util/SpanCast.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <string_view>
 
+#ifndef _WIN32
+#include <sys/socket.h> // for MSG_DONTWAIT
+#include <sys/uio.h> // for struct iovec
+#endif
+
 SnapcastClient::SnapcastClient(SnapcastOutput &_output,
 			       UniqueSocketDescriptor _fd) noexcept
 	:BufferedSocket(_fd.Release(), _output.GetEventLoop()),
@@ -45,79 +52,215 @@ SnapcastClient::LockClose() noexcept
 }
 
 void
-SnapcastClient::Push(SnapcastChunkPtr chunk) noexcept
+SnapcastClient::Enqueue(AllocatedArray<std::byte> &&control) noexcept
+{
+	auto &m = messages.emplace_back();
+	m.control = std::move(control);
+}
+
+void
+SnapcastClient::OnChunksAvailable() noexcept
 {
 	if (!active)
 		return;
 
-	chunks.emplace(std::move(chunk));
-	event.ScheduleWrite();
+	if (!messages.empty() || next_chunk < output.chunks.GetEnd())
+		event.ScheduleWrite();
+}
+
+bool
+SnapcastClient::IsDrained() const noexcept
+{
+	return !active ||
+		(messages.empty() && next_chunk >= output.chunks.GetEnd());
+}
+
+void
+SnapcastClient::Cancel() noexcept
+{
+	auto i = messages.begin();
+	if (i != messages.end() && message_position > 0)
+		/* keep the partially sent message, because the
+		   stream cannot be resynchronized in the middle of a
+		   message */
+		++i;
+
+	while (i != messages.end()) {
+		if (i->chunk != nullptr)
+			i = messages.erase(i);
+		else
+			++i;
+	}
+
+	next_chunk = output.chunks.GetEnd();
+}
+
+inline void
+SnapcastClient::FillMessages() noexcept
+{
+	/* don't fill more than this number of chunks into the
+	   #messages queue; this is the amount which can be sent
+	   with one sendmsg() call */
+	constexpr std::size_t max_messages = 8;
+
+	/* skip chunks which are older than this, because the
+	   client will not be able to play them anyway */
+	constexpr auto max_age = std::chrono::milliseconds(500);
+	const auto min_time = GetEventLoop().SteadyNow() - max_age;
+
+	const auto &ring = output.chunks;
+
+	/* skip chunks which were discarded by
+	   SnapcastOutput::Cancel() or TrimChunks() */
+	next_chunk = std::max(next_chunk, ring.GetBegin());
+
+	while (messages.size() < max_messages &&
+	       next_chunk < ring.GetEnd()) {
+		const auto &chunk = ring.Get(next_chunk++);
+		if (chunk->time < min_time)
+			/* this client is too slow: skip ahead to the
+			   next chunk */
+			continue;
+
+		auto &m = messages.emplace_back();
+		m.chunk = chunk;
+
+		auto &h = m.wire_header;
+		h.wire = {};
+		h.wire.timestamp = ToSnapcastTimestamp(chunk->time);
+		h.wire.size = chunk->payload.size();
+
+		h.base = {};
+		h.base.type = uint16_t(SnapcastMessageType::WIRE_CHUNK);
+		h.base.id = next_id++;
+		h.base.sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
+		h.base.size = sizeof(h.wire) + chunk->payload.size();
+	}
 }
 
-SnapcastChunkPtr
-SnapcastClient::LockPopQueue() noexcept
+inline void
+SnapcastClient::ConsumeMessages(std::size_t nbytes) noexcept
+{
+	while (nbytes > 0) {
+		assert(!messages.empty());
+
+		const auto &m = messages.front();
+		const std::size_t size = m.GetHeader().size() +
+			m.GetPayload().size();
+		const std::size_t remaining = size - message_position;
+		if (nbytes < remaining) {
+			message_position += nbytes;
+			return;
+		}
+
+		nbytes -= remaining;
+		messages.pop_front();
+		message_position = 0;
+	}
+}
+
+inline bool
+SnapcastClient::TryWrite() noexcept
 {
 	const std::scoped_lock protect{output.mutex};
-	if (chunks.empty())
-		return nullptr;
 
-	auto chunk = std::move(chunks.front());
-	chunks.pop();
+	FillMessages();
 
-	if (chunks.empty())
+	if (messages.empty()) {
+		/* everything has been sent: remove the event
+		   source */
+		event.CancelWrite();
 		output.drain_cond.notify_one();
+		return true;
+	}
+
+#ifdef _WIN32
+	/* no scatter/gather I/O on Windows: send only the first
+	   fragment */
+	const auto &m = messages.front();
+	const auto header = m.GetHeader();
+	const auto src = message_position < header.size()
+		? header.subspan(message_position)
+		: m.GetPayload().subspan(message_position - header.size());
+	const auto nbytes = GetSocket().Send(src);
+#else
+	std::array<struct iovec, 16> v;
+	std::size_t n = 0;
+
+	std::size_t skip = message_position;
+	const auto append = [&v, &n, &skip](std::span<const std::byte> src){
+		if (skip >= src.size()) {
+			skip -= src.size();
+			return;
+		}
+
+		src = src.subspan(skip);
+		skip = 0;
+		v[n++] = {const_cast<std::byte *>(src.data()), src.size()};
+	};
+
+	for (const auto &m : messages) {
+		if (n + 2 > v.size())
+			break;
+
+		append(m.GetHeader());
+		append(m.GetPayload());
+	}
 
-	return chunk;
+	const auto nbytes = GetSocket().Send(std::span{v}.first(n),
+					     MSG_DONTWAIT);
+#endif
+
+	if (nbytes < 0) {
+		const auto e = GetSocketError();
+		if (IsSocketErrorSendWouldBlock(e))
+			return true;
+
+		if (!IsSocketErrorClosed(e))
+			LogError(std::make_exception_ptr(MakeSocketError(e, "Failed to send to client")));
+
+		Close();
+		return false;
+	}
+
+	ConsumeMessages(nbytes);
+	return true;
 }
 
 void
 SnapcastClient::OnSocketReady(unsigned flags) noexcept
 {
 	if (flags & SocketEvent::WRITE) {
-		constexpr auto max_age = std::chrono::milliseconds(500);
-		const auto min_time = GetEventLoop().SteadyNow() - max_age;
-
-		while (auto chunk = LockPopQueue()) {
-			if (chunk->time < min_time)
-				/* discard old chunks */
-				continue;
-
-			const std::span payload = chunk->payload;
-			if (!SendWireChunk(payload, chunk->time)) {
-				// TODO: handle EAGAIN
-				LockClose();
-				return;
-			}
-		}
-
-		event.CancelWrite();
+		if (!TryWrite())
+			return;
 	}
 
 	BufferedSocket::OnSocketReady(flags);
 }
 
-static bool
-Send(SocketDescriptor s, std::span<const std::byte> buffer) noexcept
+template<typename... Args>
+static AllocatedArray<std::byte>
+MakeMessage(const SnapcastBase &base, Args... args) noexcept
 {
-	auto nbytes = s.Send(buffer);
-	return nbytes == ssize_t(buffer.size());
-}
+	const std::span<const std::byte> parts[] = {
+		ReferenceAsBytes(base),
+		args...,
+	};
 
-template<typename T>
-static bool
-SendT(SocketDescriptor s, const T &buffer) noexcept
-{
-	return Send(s, ReferenceAsBytes(buffer));
-}
+	std::size_t size = 0;
+	for (const auto &i : parts)
+		size += i.size();
 
-static bool
-Send(SocketDescriptor s, std::string_view buffer) noexcept
-{
-	return Send(s, AsBytes(buffer));
+	AllocatedArray<std::byte> result{size};
+	std::byte *p = result.data();
+	for (const auto &i : parts)
+		p = std::copy(i.begin(), i.end(), p);
+
+	return result;
 }
 
-static bool
-SendServerSettings(SocketDescriptor s, const PackedBE16 id,
+static AllocatedArray<std::byte>
+MakeServerSettings(const PackedBE16 id,
 		   const SnapcastBase &request,
 		   const std::string_view payload) noexcept
 {
@@ -130,19 +273,20 @@ SendServerSettings(SocketDescriptor s, const PackedBE16 id,
 	base.sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
 	base.size = sizeof(payload_size) + payload.size();
 
-	return SendT(s, base) && SendT(s, payload_size) && Send(s, payload);
+	return MakeMessage(base, ReferenceAsBytes(payload_size),
+			   AsBytes(payload));
 }
 
-bool
+void
 SnapcastClient::SendServerSettings(const SnapcastBase &request) noexcept
 {
 	// TODO: make settings configurable
-	return ::SendServerSettings(GetSocket(), next_id++, request,
-				    R"({"bufferMs": 1000})");
+	Enqueue(MakeServerSettings(next_id++, request,
+				   R"({"bufferMs": 1000})"));
 }
 
-static bool
-SendCodecHeader(SocketDescriptor s, const PackedBE16 id,
+static AllocatedArray<std::byte>
+MakeCodecHeader(const PackedBE16 id,
 		const SnapcastBase &request,
 		const std::string_view codec,
 		const std::span<const std::byte> payload) noexcept
@@ -158,21 +302,21 @@ SendCodecHeader(SocketDescriptor s, const PackedBE16 id,
 	base.size = sizeof(codec_size) + codec.size() +
 		sizeof(payload_size) + payload.size();
 
-	return SendT(s, base) &&
-		SendT(s, codec_size) && Send(s, codec) &&
-		SendT(s, payload_size) && Send(s, payload);
+	return MakeMessage(base,
+			   ReferenceAsBytes(codec_size), AsBytes(codec),
+			   ReferenceAsBytes(payload_size), payload);
 }
 
-bool
+void
 SnapcastClient::SendCodecHeader(const SnapcastBase &request) noexcept
 {
-	return ::SendCodecHeader(GetSocket(), next_id++, request,
-				 output.GetCodecName(),
-				 output.GetCodecHeader());
+	Enqueue(MakeCodecHeader(next_id++, request,
+				output.GetCodecName(),
+				output.GetCodecHeader()));
 }
 
-static bool
-SendTime(SocketDescriptor s, const PackedBE16 id,
+static AllocatedArray<std::byte>
+MakeTime(const PackedBE16 id,
 	 const SnapcastBase &request_header,
 	 const SnapcastTime &request_payload) noexcept
 {
@@ -186,45 +330,18 @@ SendTime(SocketDescriptor s, const PackedBE16 id,
 	base.sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
 	base.size = sizeof(payload);
 
-	return SendT(s, base) && SendT(s, payload);
+	return MakeMessage(base, ReferenceAsBytes(payload));
 }
 
-bool
+void
 SnapcastClient::SendTime(const SnapcastBase &request_header,
 			 const SnapcastTime &request_payload) noexcept
 {
-	return ::SendTime(GetSocket(), next_id++,
-			  request_header, request_payload);
-}
-
-static bool
-SendWireChunk(SocketDescriptor s, const PackedBE16 id,
-	      const std::span<const std::byte> payload,
-	      std::chrono::steady_clock::time_point t) noexcept
-{
-	SnapcastWireChunk hdr{};
-	hdr.timestamp = ToSnapcastTimestamp(t);
-	hdr.size = payload.size();
-
-	SnapcastBase base{};
-	base.type = uint16_t(SnapcastMessageType::WIRE_CHUNK);
-	base.id = id;
-	base.sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
-	base.size = sizeof(hdr) + payload.size();
-
-	// TODO: no blocking send()
-	return SendT(s, base) && SendT(s, hdr) && Send(s, payload);
-}
-
-bool
-SnapcastClient::SendWireChunk(std::span<const std::byte> payload,
-			      std::chrono::steady_clock::time_point t) noexcept
-{
-	return ::SendWireChunk(GetSocket(), next_id++, payload, t);
+	Enqueue(MakeTime(next_id++, request_header, request_payload));
 }
 
-static bool
-SendStreamTags(SocketDescriptor s, const PackedBE16 id,
+static AllocatedArray<std::byte>
+MakeStreamTags(const PackedBE16 id,
 	       const std::span<const std::byte> payload) noexcept
 {
 	const PackedLE32 payload_size = payload.size();
@@ -235,13 +352,16 @@ SendStreamTags(SocketDescriptor s, const PackedBE16 id,
 	base.sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
 	base.size = sizeof(payload_size) + payload.size();
 
-	return SendT(s, base) && SendT(s, payload_size) && Send(s, payload);
+	return MakeMessage(base, ReferenceAsBytes(payload_size), payload);
 }
 
 void
 SnapcastClient::SendStreamTags(std::span<const std::byte> payload) noexcept
 {
-	::SendStreamTags(GetSocket(), next_id++, payload);
+	if (!active)
+		return;
+
+	Enqueue(MakeStreamTags(next_id++, payload));
 }
 
 BufferedSocket::InputResult
@@ -259,24 +379,34 @@ SnapcastClient::OnSocketInput(std::span<std::byte> src) noexcept
 
 	const std::span<const std::byte> payload{(const std::byte *)(&base + 1), base.size};
 
+	const std::scoped_lock protect{output.mutex};
+
 	switch (SnapcastMessageType(uint16_t(base.type))) {
 	case SnapcastMessageType::HELLO:
-		if (!SendServerSettings(base) ||
-		    !SendCodecHeader(base)) {
-			LockClose();
-			return InputResult::CLOSED;
-		}
+		if (active)
+			break;
+
+		SendServerSettings(base);
+		SendCodecHeader(base);
 
+		/* start streaming with the next chunk */
+		next_chunk = output.chunks.GetEnd();
 		active = true;
+		event.ScheduleWrite();
 		break;
 
 	case SnapcastMessageType::TIME:
-		if (payload.size() >= sizeof(SnapcastTime))
+		if (!active)
+			break;
+
+		if (payload.size() >= sizeof(SnapcastTime)) {
 			SendTime(base, *(const SnapcastTime *)(const void *)payload.data());
+			event.ScheduleWrite();
+		}
 		break;
 
 	default:
-		LockClose();
+		Close();
 		return InputResult::CLOSED;
 	}
 
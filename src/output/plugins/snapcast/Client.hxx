@@ -5,11 +5,14 @@
 #define MPD_OUTPUT_SNAPCAST_CLIENT_HXX
 
 #include "Chunk.hxx"
+#include "Protocol.hxx"
 #include "event/BufferedSocket.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <chrono>
 #include <cstdint>
+#include <deque>
 #include <span>
 
 struct SnapcastBase;
@@ -22,9 +25,70 @@ class SnapcastClient final : BufferedSocket, public IntrusiveListHook<>
 	SnapcastOutput &output;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
+	 * A message which is about to be sent to the client.
 	 */
-	SnapcastChunkQueue chunks;
+	struct Message {
+		/**
+		 * The header of a WIRE_CHUNK message.
+		 */
+		struct WireHeader {
+			SnapcastBase base;
+			SnapcastWireChunk wire;
+		} wire_header;
+
+		static_assert(sizeof(WireHeader) ==
+			      sizeof(SnapcastBase) + sizeof(SnapcastWireChunk));
+
+		/**
+		 * The WIRE_CHUNK payload (shared with all other
+		 * clients) or nullptr if this is a control message.
+		 */
+		SnapcastChunkPtr chunk;
+
+		/**
+		 * The complete control message (if #chunk is
+		 * nullptr).
+		 */
+		AllocatedArray<std::byte> control;
+
+		std::span<const std::byte> GetHeader() const noexcept {
+			if (chunk == nullptr)
+				return control;
+
+			return std::as_bytes(std::span{&wire_header, 1});
+		}
+
+		std::span<const std::byte> GetPayload() const noexcept {
+			if (chunk == nullptr)
+				return {};
+
+			return chunk->payload;
+		}
+	};
+
+	/**
+	 * Messages to be sent to the client.  This contains all
+	 * control messages, but only a few chunks from
+	 * SnapcastOutput::chunks, just enough to fill one
+	 * sendmsg() call.
+	 *
+	 * Protected by SnapcastOutput::mutex.
+	 */
+	std::deque<Message> messages;
+
+	/**
+	 * The number of bytes of messages.front() which have already
+	 * been sent.
+	 */
+	std::size_t message_position = 0;
+
+	/**
+	 * The sequence number of the next chunk in
+	 * SnapcastOutput::chunks to be sent.
+	 *
+	 * Protected by SnapcastOutput::mutex.
+	 */
+	uint_least64_t next_chunk = 0;
 
 	uint16_t next_id = 1;
 
@@ -45,36 +109,77 @@ public:
 
 	void LockClose() noexcept;
 
+	/**
+	 * Enqueue a STREAM_TAGS message.  The caller is responsible
+	 * for calling OnChunksAvailable() in the #EventLoop thread.
+	 *
+	 * Caller must lock the mutex.
+	 */
 	void SendStreamTags(std::span<const std::byte> payload) noexcept;
 
 	/**
+	 * New chunks have been added to SnapcastOutput::chunks, or
+	 * new messages have been enqueued.  Must be called in the
+	 * #EventLoop thread.
+	 *
 	 * Caller must lock the mutex.
 	 */
-	void Push(SnapcastChunkPtr chunk) noexcept;
+	void OnChunksAvailable() noexcept;
 
 	/**
+	 * The sequence number of the next chunk needed by this
+	 * client.  Chunks before that may be discarded.
+	 *
 	 * Caller must lock the mutex.
 	 */
-	bool IsDrained() const noexcept {
-		return chunks.empty();
+	uint_least64_t GetNextChunk(uint_least64_t end) const noexcept {
+		return active ? next_chunk : end;
 	}
 
 	/**
 	 * Caller must lock the mutex.
 	 */
-	void Cancel() noexcept {
-		ClearQueue(chunks);
-	}
+	bool IsDrained() const noexcept;
+
+	/**
+	 * Discard all chunks which have been enqueued, except for
+	 * one which has already been sent partially.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Cancel() noexcept;
 
 private:
-	SnapcastChunkPtr LockPopQueue() noexcept;
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Enqueue(AllocatedArray<std::byte> &&control) noexcept;
 
-	bool SendWireChunk(std::span<const std::byte> payload,
-			   std::chrono::steady_clock::time_point t) noexcept;
+	/**
+	 * Move chunks from SnapcastOutput::chunks to #messages.
+	 * Chunks which are too old are skipped.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void FillMessages() noexcept;
+
+	/**
+	 * Remove the given number of sent bytes from #messages.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void ConsumeMessages(std::size_t nbytes) noexcept;
+
+	/**
+	 * Send as many #messages as possible without blocking.
+	 *
+	 * @return false if the client has been closed
+	 */
+	bool TryWrite() noexcept;
 
-	bool SendServerSettings(const SnapcastBase &request) noexcept;
-	bool SendCodecHeader(const SnapcastBase &request) noexcept;
-	bool SendTime(const SnapcastBase &request_header,
+	void SendServerSettings(const SnapcastBase &request) noexcept;
+	void SendCodecHeader(const SnapcastBase &request) noexcept;
+	void SendTime(const SnapcastBase &request_header,
 		      const SnapcastTime &request_payload) noexcept;
 
 	/* virtual methods from class BufferedSocket */
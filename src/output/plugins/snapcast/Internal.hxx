@@ -75,15 +75,20 @@ class SnapcastOutput final : AudioOutput, ServerSocket {
 	 */
 	IntrusiveList<SnapcastClient> clients;
 
-	SnapcastChunkQueue chunks;
-
 public:
 	/**
 	 * This mutex protects the listener socket, the #clients list
-	 * and the #chunks queue.
+	 * and the #chunks ring.
 	 */
 	mutable Mutex mutex;
 
+	/**
+	 * The encoded stream shared by all clients.  Chunks are
+	 * discarded when all clients have sent them or when they
+	 * are too old.
+	 */
+	SnapcastChunkRing chunks;
+
 	/**
 	 * This cond is signalled when a #SnapcastClient has an empty
 	 * queue.
@@ -176,6 +181,13 @@ public:
 private:
 	void OnInject() noexcept;
 
+	/**
+	 * Discard chunks which are not needed anymore.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void TrimChunks() noexcept;
+
 	/**
 	 * Caller must lock the mutex.
 	 */
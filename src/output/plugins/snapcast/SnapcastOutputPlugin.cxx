@@ -13,6 +13,7 @@
 #include "net/UniqueSocketDescriptor.hxx"
 #include "net/SocketAddress.hxx"
 #include "event/Call.hxx"
+#include "event/Loop.hxx"
 #include "util/Domain.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/SpanCast.hxx"
@@ -157,24 +158,37 @@ SnapcastOutput::Close() noexcept
 		clients.clear_and_dispose(DeleteDisposer{});
 	});
 
-	ClearQueue(chunks);
+	chunks.Clear();
 
 	codec_header = std::span<const std::byte>{};
 	delete encoder;
 }
 
+inline void
+SnapcastOutput::TrimChunks() noexcept
+{
+	auto seq = chunks.GetEnd();
+	for (const auto &client : clients)
+		seq = std::min(seq, client.GetNextChunk(chunks.GetEnd()));
+
+	chunks.TrimBefore(seq);
+
+	/* chunks older than this would be skipped by all clients
+	   anyway; this limits the amount of memory occupied by slow
+	   clients */
+	constexpr auto max_age = std::chrono::milliseconds(500);
+	chunks.TrimOlderThan(GetEventLoop().SteadyNow() - max_age);
+}
+
 void
 SnapcastOutput::OnInject() noexcept
 {
 	const std::scoped_lock protect{mutex};
 
-	while (!chunks.empty()) {
-		const auto chunk = std::move(chunks.front());
-		chunks.pop();
+	for (auto &client : clients)
+		client.OnChunksAvailable();
 
-		for (auto &client : clients)
-			client.Push(chunk);
-	}
+	TrimChunks();
 }
 
 void
@@ -273,9 +287,10 @@ SnapcastOutput::SendTag(const Tag &tag)
 	const auto payload = std::as_bytes(std::span{json});
 
 	const std::scoped_lock protect{mutex};
-	// TODO: enqueue StreamTags, don't send directly
 	for (auto &client : clients)
 		client.SendStreamTags(payload);
+
+	inject_event.Schedule();
 #else
 	(void)tag;
 #endif
@@ -321,10 +336,8 @@ SnapcastOutput::Play(std::span<const std::byte> src)
 		unflushed_input = 0;
 
 		const std::scoped_lock protect{mutex};
-		if (chunks.empty())
-			inject_event.Schedule();
-
-		chunks.push(std::make_shared<SnapcastChunk>(now, AllocatedArray{payload}));
+		chunks.Push(std::make_shared<SnapcastChunk>(now, AllocatedArray{payload}));
+		inject_event.Schedule();
 	}
 
 	return src.size();
@@ -341,9 +354,6 @@ SnapcastOutput::Pause()
 inline bool
 SnapcastOutput::IsDrained() const noexcept
 {
-	if (!chunks.empty())
-		return false;
-
 	return std::all_of(clients.begin(), clients.end(), [](auto&& c){ return c.IsDrained(); });
 }
 
@@ -359,7 +369,7 @@ SnapcastOutput::Cancel() noexcept
 {
 	const std::scoped_lock protect{mutex};
 
-	ClearQueue(chunks);
+	chunks.Clear();
 
 	for (auto &client : clients)
 		client.Cancel();
@@ -26,4 +26,16 @@ ToSnapcastTimestamp(TimePoint t) noexcept
 	return st;
 }
 
+/**
+ * Convert a #SnapcastTimestamp (or the difference between two of
+ * them) back to a signed duration.
+ */
+constexpr std::chrono::microseconds
+FromSnapcastTimestamp(SnapcastTimestamp t) noexcept
+{
+	const uint32_t sec = t.sec, usec = t.usec;
+	return std::chrono::seconds{int32_t(sec)} +
+		std::chrono::microseconds{usec};
+}
+
 #endif
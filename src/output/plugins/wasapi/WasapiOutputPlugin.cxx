@@ -39,6 +39,7 @@
 #include <variant>
 
 #include <audioclient.h>
+#include <avrt.h>
 #include <initguid.h>
 #include <functiondiscoverykeys_devpkey.h>
 #include <mmdeviceapi.h>
@@ -140,6 +141,32 @@ SetDSDFallback(AudioFormat &audio_format) noexcept
 }
 #endif
 
+/**
+ * Register the calling thread with the Multimedia Class Scheduler
+ * Service as a "Pro Audio" task, which gives it a real-time
+ * priority boost while it is waiting for the next device period.
+ *
+ * @return a handle to be passed to AvRevertMmThreadCharacteristics()
+ * or nullptr on error
+ */
+HANDLE
+RegisterMmcss() noexcept
+{
+	DWORD task_index = 0;
+	HANDLE handle = AvSetMmThreadCharacteristicsW(L"Pro Audio",
+						      &task_index);
+	if (handle == nullptr) {
+		FmtWarning(wasapi_output_domain,
+			   "Failed to register with MMCSS: error {}",
+			   GetLastError());
+		return nullptr;
+	}
+
+	FmtDebug(wasapi_output_domain,
+		 "Registered with MMCSS, task index {}", task_index);
+	return handle;
+}
+
 } // namespace
 
 class WasapiOutputThread {
@@ -407,6 +434,12 @@ try {
 	LogDebug(wasapi_output_domain, "Working thread started");
 	COM com;
 
+	HANDLE mmcss = RegisterMmcss();
+	AtScopeExit(mmcss) {
+		if (mmcss != nullptr)
+			AvRevertMmThreadCharacteristics(mmcss);
+	};
+
 	AtScopeExit(this) {
 		if (started) {
 			try {
@@ -482,12 +515,19 @@ try {
 		const UINT32 write_size = write_in_frames * frame_size;
 		std::span w{data, write_size};
 
+		/* copy straight from the ring buffer into the
+		   device buffer */
 		const std::size_t new_data_size = ring_buffer.ReadTo(std::as_writable_bytes(w));
-		if (new_data_size == 0)
+		if (new_data_size == 0) {
 			empty.store(true);
 
-		std::fill_n(data + new_data_size,
-			    write_size - new_data_size, 0);
+			/* let the audio engine generate the silence
+			   instead of filling the buffer with zeroes */
+			mode = AUDCLNT_BUFFERFLAGS_SILENT;
+		} else
+			std::fill_n(data + new_data_size,
+				    write_size - new_data_size, 0);
+
 		InterruptWaiter();
 	}
 } catch (...) {
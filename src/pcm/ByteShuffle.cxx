@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ByteShuffle.hxx"
+#include "DsdSimd.hxx"
+
+static void
+ScalarShuffle(std::byte *dest, const std::byte *src, std::size_t n_groups,
+	      std::size_t in_group, std::size_t out_group,
+	      const uint8_t *source, const std::byte *constant) noexcept
+{
+	for (std::size_t g = 0; g < n_groups; ++g) {
+		for (std::size_t i = 0; i < out_group; ++i) {
+			const uint8_t s = source[i];
+			dest[i] = s != PcmByteShuffle::CONSTANT
+				? src[s]
+				: constant[i];
+		}
+
+		src += in_group;
+		dest += out_group;
+	}
+}
+
+void
+PcmByteShuffle::Apply(std::byte *dest, const std::byte *src,
+		      std::size_t n_groups) const noexcept
+{
+	if (period_in > 0) {
+		const std::size_t groups_per_period = period_in / in_group;
+		const std::size_t n_periods = n_groups / groups_per_period;
+
+		if (n_periods > 0 &&
+		    PcmShuffleSimd(dest, src, n_periods,
+				   period_in, period_out,
+				   source.data(), constant.data())) {
+			src += n_periods * period_in;
+			dest += n_periods * period_out;
+			n_groups -= n_periods * groups_per_period;
+		}
+	}
+
+	ScalarShuffle(dest, src, n_groups, in_group, out_group,
+		      source.data(), constant.data());
+}
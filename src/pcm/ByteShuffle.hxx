@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Rearranges bytes according to a pattern which repeats for each
+ * "group" of input bytes; each output byte is either copied from the
+ * group or a constant.  This implements the DSD packing formats
+ * (DSD_U16, DSD_U32, DoP) including byte order changes in one pass,
+ * using vectorized byte shuffles (see PcmGetSimdLevel()) where the
+ * pattern allows it.
+ */
+class PcmByteShuffle {
+public:
+	/**
+	 * The maximum size of one vectorized period (a whole
+	 * number of groups whose input and output sizes are
+	 * multiples of 16 bytes).
+	 */
+	static constexpr std::size_t MAX_PERIOD_IN = 64, MAX_PERIOD_OUT = 128;
+
+	/**
+	 * The #source value for constant output bytes.
+	 */
+	static constexpr uint8_t CONSTANT = 0xff;
+
+	/**
+	 * Describes one output byte of a group; see Build().
+	 */
+	struct Code {
+		uint8_t source;
+		std::byte constant;
+
+		static constexpr Code Copy(std::size_t offset) noexcept {
+			return {uint8_t(offset), std::byte{}};
+		}
+
+		static constexpr Code Constant(std::byte value) noexcept {
+			return {CONSTANT, value};
+		}
+	};
+
+private:
+	std::size_t in_group, out_group;
+
+	/**
+	 * The number of input/output bytes of one vectorized period;
+	 * zero if the pattern is not suitable for the vectorized
+	 * kernels.
+	 */
+	std::size_t period_in, period_out;
+
+	/**
+	 * For each output byte of one period: the input offset or
+	 * #CONSTANT.
+	 */
+	std::array<uint8_t, MAX_PERIOD_OUT> source;
+
+	/**
+	 * For each output byte of one period: the constant (zero for
+	 * copied bytes).
+	 */
+	std::array<std::byte, MAX_PERIOD_OUT> constant;
+
+public:
+	/**
+	 * @param f a function which returns the #Code of each output
+	 * byte of a group; it is called with offsets from 0 to
+	 * #_out_group-1
+	 */
+	template<typename F>
+	void Build(std::size_t _in_group, std::size_t _out_group, F &&f) noexcept {
+		in_group = _in_group;
+		out_group = _out_group;
+
+		/* find the smallest number of groups which fills
+		   whole vectors */
+		std::size_t n = 1;
+		while ((n * in_group) % 16 != 0 || (n * out_group) % 16 != 0)
+			++n;
+
+		if (n * in_group <= MAX_PERIOD_IN && n * out_group <= MAX_PERIOD_OUT) {
+			period_in = n * in_group;
+			period_out = n * out_group;
+		} else {
+			/* the scalar code needs only the first group */
+			n = 1;
+			period_in = period_out = 0;
+		}
+
+		for (std::size_t g = 0; g < n; ++g) {
+			for (std::size_t i = 0; i < out_group; ++i) {
+				const Code code = f(i);
+				const std::size_t o = g * out_group + i;
+
+				if (code.source == CONSTANT) {
+					source[o] = CONSTANT;
+					constant[o] = code.constant;
+				} else {
+					source[o] = g * in_group + code.source;
+					constant[o] = {};
+				}
+			}
+		}
+	}
+
+	std::size_t GetInputGroupSize() const noexcept {
+		return in_group;
+	}
+
+	std::size_t GetOutputGroupSize() const noexcept {
+		return out_group;
+	}
+
+	void Apply(std::byte *dest, const std::byte *src,
+		   std::size_t n_groups) const noexcept;
+};
@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ChannelMatrix.hxx"
+#include "ChannelMatrixSimd.hxx"
+#include "Silence.hxx"
+#include "Traits.hxx"
+#include "lib/fmt/AudioFormatFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+
+#include <cassert>
+#include <cmath>
+
+#include <string.h>
+
+PcmChannelMatrix
+PcmChannelMatrix::Default(unsigned src_channels,
+			  unsigned dest_channels) noexcept
+{
+	assert(audio_valid_channel_count(src_channels));
+	assert(audio_valid_channel_count(dest_channels));
+
+	PcmChannelMatrix m{src_channels, dest_channels};
+
+	if (src_channels == 1 && dest_channels == 2) {
+		m.gain[0][0] = m.gain[1][0] = 1;
+	} else if (src_channels == 2 && dest_channels > 2) {
+		/* left/right go to front-left/front-right, which is
+		   the first two channels in all multi-channel
+		   configurations; all others are silent */
+		m.gain[0][0] = m.gain[1][1] = 1;
+	} else {
+		/* TODO: this is actually only mono ... */
+		const float average = 1.f / src_channels;
+		for (unsigned d = 0; d < dest_channels; ++d)
+			for (unsigned s = 0; s < src_channels; ++s)
+				m.gain[d][s] = average;
+	}
+
+	return m;
+}
+
+bool
+PcmChannelMatrix::IsRouting() const noexcept
+{
+	for (unsigned d = 0; d < dest_channels; ++d) {
+		unsigned n = 0;
+		for (unsigned s = 0; s < src_channels; ++s) {
+			if (gain[d][s] == 1)
+				++n;
+			else if (gain[d][s] != 0)
+				return false;
+		}
+
+		if (n > 1)
+			return false;
+	}
+
+	return true;
+}
+
+int
+PcmChannelMatrix::GetSource(unsigned dest) const noexcept
+{
+	assert(dest < dest_channels);
+
+	for (unsigned s = 0; s < src_channels; ++s)
+		if (gain[dest][s] != 0)
+			return s;
+
+	return -1;
+}
+
+/**
+ * Copy samples through the routing table.  #T is an unsigned
+ * integer with the size of one sample (the bits are copied
+ * verbatim).  #SRC and #DEST are the channel counts, or 0 if they
+ * are only known at runtime.
+ */
+template<typename T, unsigned SRC, unsigned DEST>
+void
+PcmChannelMixer::RouteKernel(const PcmChannelMixer &mixer,
+			     void *_dest, const void *_src,
+			     std::size_t n_frames) noexcept
+{
+	const unsigned src_channels = SRC > 0 ? SRC : mixer.matrix.src_channels;
+	const unsigned dest_channels = DEST > 0 ? DEST : mixer.matrix.dest_channels;
+
+	T silence;
+	memcpy(&silence, &mixer.silence, sizeof(silence));
+
+	auto *dest = (T *)_dest;
+	const auto *src = (const T *)_src;
+
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < dest_channels; ++c) {
+			const int s = mixer.sources[c];
+			*dest++ = s >= 0 ? src[s] : silence;
+		}
+
+		src += src_channels;
+	}
+}
+
+/**
+ * Multiply float samples with the matrix.  #SRC and #DEST are the
+ * channel counts, or 0 if they are only known at runtime.
+ */
+template<unsigned SRC, unsigned DEST>
+void
+PcmChannelMixer::FloatKernel(const PcmChannelMixer &mixer,
+			     void *_dest, const void *_src,
+			     std::size_t n_frames) noexcept
+{
+	const unsigned src_channels = SRC > 0 ? SRC : mixer.matrix.src_channels;
+	const unsigned dest_channels = DEST > 0 ? DEST : mixer.matrix.dest_channels;
+	const auto &gain = mixer.matrix.gain;
+
+	auto *dest = (float *)_dest;
+	const auto *src = (const float *)_src;
+
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		for (unsigned d = 0; d < dest_channels; ++d) {
+			float sum = 0;
+			for (unsigned s = 0; s < src_channels; ++s)
+				sum += src[s] * gain[d][s];
+			*dest++ = sum;
+		}
+
+		src += src_channels;
+	}
+}
+
+void
+PcmChannelMixer::FloatToStereoKernel(const PcmChannelMixer &mixer,
+				     void *dest, const void *src,
+				     std::size_t n_frames) noexcept
+{
+	PcmMixToStereoSimd((float *)dest, (const float *)src, n_frames,
+			   mixer.matrix.src_channels,
+			   mixer.matrix.gain[0].data(),
+			   mixer.matrix.gain[1].data());
+}
+
+/**
+ * Multiply integer samples with the matrix, rounding and clamping
+ * the result.  S16 and S24 fit into the mantissa of a float, S32
+ * needs a double.
+ */
+template<SampleFormat F>
+void
+PcmChannelMixer::IntegerKernel(const PcmChannelMixer &mixer,
+			       void *_dest, const void *_src,
+			       std::size_t n_frames) noexcept
+{
+	using Traits = SampleTraits<F>;
+	using T = typename Traits::value_type;
+	using Sum = std::conditional_t<(Traits::BITS > 24), double, float>;
+
+	const unsigned src_channels = mixer.matrix.src_channels;
+	const unsigned dest_channels = mixer.matrix.dest_channels;
+	const auto &gain = mixer.matrix.gain;
+
+	auto *dest = (T *)_dest;
+	const auto *src = (const T *)_src;
+
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		for (unsigned d = 0; d < dest_channels; ++d) {
+			Sum sum = 0;
+			for (unsigned s = 0; s < src_channels; ++s)
+				sum += Sum(src[s]) * Sum(gain[d][s]);
+
+			if (sum <= Sum(Traits::MIN)) [[unlikely]]
+				*dest++ = Traits::MIN;
+			else if (sum >= Sum(Traits::MAX)) [[unlikely]]
+				*dest++ = Traits::MAX;
+			else
+				*dest++ = T(std::lrint(sum));
+		}
+
+		src += src_channels;
+	}
+}
+
+template<typename T>
+PcmChannelMixer::Kernel
+PcmChannelMixer::FindRouteKernel(unsigned src_channels,
+				 unsigned dest_channels) noexcept
+{
+	/* specializations for the most common layouts; the
+	   compiler unrolls their inner loops */
+	if (src_channels == 1 && dest_channels == 2)
+		return RouteKernel<T, 1, 2>;
+	if (src_channels == 2 && dest_channels == 2)
+		return RouteKernel<T, 2, 2>;
+	if (src_channels == 2 && dest_channels == 6)
+		return RouteKernel<T, 2, 6>;
+	if (src_channels == 2 && dest_channels == 8)
+		return RouteKernel<T, 2, 8>;
+	if (src_channels == 6 && dest_channels == 6)
+		return RouteKernel<T, 6, 6>;
+	if (src_channels == 8 && dest_channels == 8)
+		return RouteKernel<T, 8, 8>;
+
+	return RouteKernel<T, 0, 0>;
+}
+
+inline PcmChannelMixer::Kernel
+PcmChannelMixer::FindRouteKernel(std::size_t sample_size,
+				 unsigned src_channels,
+				 unsigned dest_channels) noexcept
+{
+	switch (sample_size) {
+	case 1:
+		return FindRouteKernel<uint8_t>(src_channels, dest_channels);
+
+	case 2:
+		return FindRouteKernel<uint16_t>(src_channels, dest_channels);
+
+	case 4:
+		return FindRouteKernel<uint32_t>(src_channels, dest_channels);
+
+	default:
+		return nullptr;
+	}
+}
+
+inline PcmChannelMixer::Kernel
+PcmChannelMixer::FindFloatKernel(unsigned src_channels,
+				 unsigned dest_channels) noexcept
+{
+	if (dest_channels == 2)
+		/* downmix to stereo is the most common case; it
+		   has vectorized kernels */
+		return FloatToStereoKernel;
+
+	if (src_channels == 2 && dest_channels == 1)
+		return FloatKernel<2, 1>;
+	if (src_channels == 6 && dest_channels == 1)
+		return FloatKernel<6, 1>;
+	if (src_channels == 8 && dest_channels == 1)
+		return FloatKernel<8, 1>;
+	if (src_channels == 2 && dest_channels == 6)
+		return FloatKernel<2, 6>;
+	if (src_channels == 8 && dest_channels == 6)
+		return FloatKernel<8, 6>;
+
+	return FloatKernel<0, 0>;
+}
+
+void
+PcmChannelMixer::Open(SampleFormat format, const PcmChannelMatrix &_matrix)
+{
+	assert(format != SampleFormat::UNDEFINED);
+	assert(audio_valid_channel_count(_matrix.src_channels));
+	assert(audio_valid_channel_count(_matrix.dest_channels));
+
+	matrix = _matrix;
+
+	const std::size_t sample_size = sample_format_size(format);
+	src_frame_size = sample_size * matrix.src_channels;
+	dest_frame_size = sample_size * matrix.dest_channels;
+
+	if (matrix.IsRouting()) {
+		for (unsigned c = 0; c < matrix.dest_channels; ++c)
+			sources[c] = matrix.GetSource(c);
+
+		silence = 0;
+		PcmSilence(std::as_writable_bytes(std::span{&silence, 1}).first(sample_size),
+			   format);
+
+		kernel = FindRouteKernel(sample_size, matrix.src_channels,
+					 matrix.dest_channels);
+		assert(kernel != nullptr);
+		return;
+	}
+
+	switch (format) {
+	case SampleFormat::S16:
+		kernel = IntegerKernel<SampleFormat::S16>;
+		break;
+
+	case SampleFormat::S24_P32:
+		kernel = IntegerKernel<SampleFormat::S24_P32>;
+		break;
+
+	case SampleFormat::S32:
+		kernel = IntegerKernel<SampleFormat::S32>;
+		break;
+
+	case SampleFormat::FLOAT:
+		kernel = FindFloatKernel(matrix.src_channels,
+					 matrix.dest_channels);
+		break;
+
+	default:
+		throw FmtRuntimeError("Channel mixing for {} is not implemented",
+				      format);
+	}
+}
+
+std::span<const std::byte>
+PcmChannelMixer::Apply(std::span<const std::byte> src) noexcept
+{
+	assert(src.size() % src_frame_size == 0);
+
+	const std::size_t n_frames = src.size() / src_frame_size;
+	const std::size_t dest_size = n_frames * dest_frame_size;
+	void *dest = buffer.Get(dest_size);
+
+	kernel(*this, dest, src.data(), n_frames);
+
+	return {(const std::byte *)dest, dest_size};
+}
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_CHANNEL_MATRIX_HXX
+#define MPD_PCM_CHANNEL_MATRIX_HXX
+
+#include "ChannelDefs.hxx"
+#include "SampleFormat.hxx"
+#include "Buffer.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * A table of coefficients which describes how each output channel is
+ * mixed from the input channels.
+ */
+struct PcmChannelMatrix {
+	unsigned src_channels = 0, dest_channels = 0;
+
+	/**
+	 * The gain of each input channel in each output channel,
+	 * indexed as [dest][src].  Unused elements are zero.
+	 */
+	std::array<std::array<float, MAX_CHANNELS>, MAX_CHANNELS> gain{};
+
+	PcmChannelMatrix() noexcept = default;
+
+	constexpr PcmChannelMatrix(unsigned _src_channels,
+				   unsigned _dest_channels) noexcept
+		:src_channels(_src_channels), dest_channels(_dest_channels) {}
+
+	/**
+	 * The matrix which implements pcm_convert_channels_16() and
+	 * its siblings: mono is copied to both stereo channels,
+	 * stereo is copied to the front channels of a multi-channel
+	 * layout, and everything else is the average of all input
+	 * channels.
+	 */
+	[[gnu::const]]
+	static PcmChannelMatrix Default(unsigned src_channels,
+					unsigned dest_channels) noexcept;
+
+	/**
+	 * Does each output channel copy exactly one input channel (or
+	 * is it silent)?
+	 */
+	[[gnu::pure]]
+	bool IsRouting() const noexcept;
+
+	/**
+	 * Returns the input channel which is copied to the given
+	 * output channel or -1 if it is silent.  Only valid if
+	 * IsRouting() is true.
+	 */
+	[[gnu::pure]]
+	int GetSource(unsigned dest) const noexcept;
+};
+
+/**
+ * Applies a #PcmChannelMatrix to PCM data.  Routing tables are
+ * implemented by copying samples (in any sample format), everything
+ * else by multiplying and adding; common layouts have specialized
+ * (and vectorized) kernels.
+ */
+class PcmChannelMixer {
+	using Kernel = void (*)(const PcmChannelMixer &mixer,
+				void *dest, const void *src,
+				std::size_t n_frames) noexcept;
+
+	PcmChannelMatrix matrix;
+
+	/**
+	 * The input channel for each output channel (-1 for silence);
+	 * only used if the matrix is a routing table.
+	 */
+	std::array<int8_t, MAX_CHANNELS> sources;
+
+	/**
+	 * One silent sample in the input format.
+	 */
+	uint32_t silence;
+
+	Kernel kernel;
+
+	std::size_t src_frame_size, dest_frame_size;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param format the sample format; it is not modified
+	 */
+	void Open(SampleFormat format, const PcmChannelMatrix &_matrix);
+
+	const PcmChannelMatrix &GetMatrix() const noexcept {
+		return matrix;
+	}
+
+	/**
+	 * @return the destination buffer (owned by this object)
+	 */
+	std::span<const std::byte> Apply(std::span<const std::byte> src) noexcept;
+
+	/**
+	 * Same as Apply(), but don't use the internal buffer.  The
+	 * destination must have room for the converted frames.
+	 */
+	void Apply(void *dest, const void *src, std::size_t n_frames) const noexcept {
+		kernel(*this, dest, src, n_frames);
+	}
+
+private:
+	template<typename T>
+	static Kernel FindRouteKernel(unsigned src_channels,
+				      unsigned dest_channels) noexcept;
+	static Kernel FindRouteKernel(std::size_t sample_size,
+				      unsigned src_channels,
+				      unsigned dest_channels) noexcept;
+	static Kernel FindFloatKernel(unsigned src_channels,
+				      unsigned dest_channels) noexcept;
+
+	template<typename T, unsigned SRC, unsigned DEST>
+	static void RouteKernel(const PcmChannelMixer &mixer,
+				void *dest, const void *src,
+				std::size_t n_frames) noexcept;
+
+	template<unsigned SRC, unsigned DEST>
+	static void FloatKernel(const PcmChannelMixer &mixer,
+				void *dest, const void *src,
+				std::size_t n_frames) noexcept;
+
+	static void FloatToStereoKernel(const PcmChannelMixer &mixer,
+					void *dest, const void *src,
+					std::size_t n_frames) noexcept;
+
+	template<SampleFormat F>
+	static void IntegerKernel(const PcmChannelMixer &mixer,
+				  void *dest, const void *src,
+				  std::size_t n_frames) noexcept;
+};
+
+#endif
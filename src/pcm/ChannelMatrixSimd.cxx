@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ChannelMatrixSimd.hxx"
+#include "ChannelDefs.hxx"
+#include "Simd.hxx"
+
+#include <array>
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static inline void
+ScalarMixToStereo(float *dest, const float *src, std::size_t n_frames,
+		  unsigned src_channels,
+		  const float *left, const float *right) noexcept
+{
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		float l = 0, r = 0;
+		for (unsigned c = 0; c < src_channels; ++c) {
+			l += src[c] * left[c];
+			r += src[c] * right[c];
+		}
+
+		*dest++ = l;
+		*dest++ = r;
+		src += src_channels;
+	}
+}
+
+/*
+ * The vectorized kernels below need between 4 and 8 source
+ * channels: the first four are loaded into one vector, the rest
+ * into a second one (padded with zeroes); the gain tables are
+ * padded with zeroes, too.
+ */
+
+#ifdef PCM_SIMD_X86
+
+/**
+ * Load the source channels 4..N-1 of one frame.
+ */
+template<unsigned N>
+[[gnu::target("sse2")]]
+static inline __m128
+Sse2LoadHigh(const float *src) noexcept
+{
+	if constexpr (N == 8)
+		return _mm_loadu_ps(src + 4);
+	else if constexpr (N == 7)
+		return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double *)(src + 4))),
+				     _mm_load_ss(src + 6));
+	else if constexpr (N == 6)
+		return _mm_castpd_ps(_mm_load_sd((const double *)(src + 4)));
+	else if constexpr (N == 5)
+		return _mm_load_ss(src + 4);
+	else
+		return _mm_setzero_ps();
+}
+
+template<unsigned N>
+[[gnu::target("sse2")]]
+static void
+Sse2MixToStereo(float *dest, const float *src, std::size_t n_frames,
+		const float *left, const float *right) noexcept
+{
+	const __m128 l_lo = _mm_loadu_ps(left), l_hi = _mm_loadu_ps(left + 4);
+	const __m128 r_lo = _mm_loadu_ps(right), r_hi = _mm_loadu_ps(right + 4);
+
+	/* two frames per iteration; the four partial sums are
+	   transposed, so adding the rows yields L0,R0,L1,R1 */
+	std::size_t i = 0;
+	for (; i + 2 <= n_frames; i += 2, src += 2 * N, dest += 4) {
+		const __m128 a0 = _mm_loadu_ps(src), b0 = Sse2LoadHigh<N>(src);
+		const __m128 a1 = _mm_loadu_ps(src + N), b1 = Sse2LoadHigh<N>(src + N);
+
+		__m128 l0 = _mm_add_ps(_mm_mul_ps(a0, l_lo), _mm_mul_ps(b0, l_hi));
+		__m128 r0 = _mm_add_ps(_mm_mul_ps(a0, r_lo), _mm_mul_ps(b0, r_hi));
+		__m128 l1 = _mm_add_ps(_mm_mul_ps(a1, l_lo), _mm_mul_ps(b1, l_hi));
+		__m128 r1 = _mm_add_ps(_mm_mul_ps(a1, r_lo), _mm_mul_ps(b1, r_hi));
+
+		_MM_TRANSPOSE4_PS(l0, r0, l1, r1);
+
+		_mm_storeu_ps(dest, _mm_add_ps(_mm_add_ps(l0, r0),
+					       _mm_add_ps(l1, r1)));
+	}
+
+	ScalarMixToStereo(dest, src, n_frames - i, N, left, right);
+}
+
+template<unsigned N>
+[[gnu::target("avx2")]]
+static void
+Avx2MixToStereo(float *dest, const float *src, std::size_t n_frames,
+		const float *left, const float *right) noexcept
+{
+	/* all source channels of one frame fit into one vector;
+	   the mask loads only the first N floats */
+	const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(N),
+						_mm256_setr_epi32(0, 1, 2, 3,
+								  4, 5, 6, 7));
+	const __m256 l = _mm256_loadu_ps(left), r = _mm256_loadu_ps(right);
+
+	/* two frames per iteration: two horizontal additions leave
+	   the partial sums of L0,R0,L1,R1 in both 128 bit lanes */
+	std::size_t i = 0;
+	for (; i + 2 <= n_frames; i += 2, src += 2 * N, dest += 4) {
+		const __m256 f0 = N == 8
+			? _mm256_loadu_ps(src)
+			: _mm256_maskload_ps(src, mask);
+		const __m256 f1 = N == 8
+			? _mm256_loadu_ps(src + N)
+			: _mm256_maskload_ps(src + N, mask);
+
+		const __m256 h0 = _mm256_hadd_ps(_mm256_mul_ps(f0, l),
+						 _mm256_mul_ps(f0, r));
+		const __m256 h1 = _mm256_hadd_ps(_mm256_mul_ps(f1, l),
+						 _mm256_mul_ps(f1, r));
+		const __m256 h = _mm256_hadd_ps(h0, h1);
+
+		_mm_storeu_ps(dest, _mm_add_ps(_mm256_castps256_ps128(h),
+					       _mm256_extractf128_ps(h, 1)));
+	}
+
+	ScalarMixToStereo(dest, src, n_frames - i, N, left, right);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+template<unsigned N>
+static void
+NeonMixToStereo(float *dest, const float *src, std::size_t n_frames,
+		const float *left, const float *right) noexcept
+{
+	const float32x4_t l_lo = vld1q_f32(left), l_hi = vld1q_f32(left + 4);
+	const float32x4_t r_lo = vld1q_f32(right), r_hi = vld1q_f32(right + 4);
+
+	for (std::size_t i = 0; i < n_frames; ++i, src += N, dest += 2) {
+		const float32x4_t a = vld1q_f32(src);
+
+		float32x4_t b;
+		if constexpr (N == 8) {
+			b = vld1q_f32(src + 4);
+		} else {
+			std::array<float, 4> tmp{};
+			for (unsigned c = 4; c < N; ++c)
+				tmp[c - 4] = src[c];
+			b = vld1q_f32(tmp.data());
+		}
+
+		const float32x4_t l = vmlaq_f32(vmulq_f32(a, l_lo), b, l_hi);
+		const float32x4_t r = vmlaq_f32(vmulq_f32(a, r_lo), b, r_hi);
+
+		/* pairwise additions yield L,R */
+		const float32x2_t lp = vpadd_f32(vget_low_f32(l), vget_high_f32(l));
+		const float32x2_t rp = vpadd_f32(vget_low_f32(r), vget_high_f32(r));
+		vst1_f32(dest, vpadd_f32(lp, rp));
+	}
+}
+
+#endif // PCM_SIMD_NEON
+
+using MixToStereoFunction = void (*)(float *dest, const float *src,
+				     std::size_t n_frames,
+				     const float *left,
+				     const float *right) noexcept;
+
+/**
+ * The vectorized kernels for 4 to 8 source channels.
+ */
+using MixToStereoTable = std::array<MixToStereoFunction, MAX_CHANNELS - 3>;
+
+static const MixToStereoTable *
+SelectMixToStereo() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2: {
+		static constexpr MixToStereoTable table{
+			Sse2MixToStereo<4>, Sse2MixToStereo<5>,
+			Sse2MixToStereo<6>, Sse2MixToStereo<7>,
+			Sse2MixToStereo<8>,
+		};
+		return &table;
+	}
+
+	case PcmSimdLevel::AVX2: {
+		static constexpr MixToStereoTable table{
+			Avx2MixToStereo<4>, Avx2MixToStereo<5>,
+			Avx2MixToStereo<6>, Avx2MixToStereo<7>,
+			Avx2MixToStereo<8>,
+		};
+		return &table;
+	}
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON: {
+		static constexpr MixToStereoTable table{
+			NeonMixToStereo<4>, NeonMixToStereo<5>,
+			NeonMixToStereo<6>, NeonMixToStereo<7>,
+			NeonMixToStereo<8>,
+		};
+		return &table;
+	}
+#endif
+
+	default:
+		break;
+	}
+
+	return nullptr;
+}
+
+/**
+ * Selected during static initialization, before any output thread
+ * runs (MPD is built with -fno-threadsafe-statics).
+ */
+static const MixToStereoTable *const mix_to_stereo =
+	SelectMixToStereo();
+
+void
+PcmMixToStereoSimd(float *dest, const float *src, std::size_t n_frames,
+		   unsigned src_channels,
+		   const float *left, const float *right) noexcept
+{
+	if (mix_to_stereo != nullptr &&
+	    src_channels >= 4 && src_channels <= MAX_CHANNELS)
+		(*mix_to_stereo)[src_channels - 4](dest, src, n_frames,
+						   left, right);
+	else
+		ScalarMixToStereo(dest, src, n_frames, src_channels,
+				  left, right);
+}
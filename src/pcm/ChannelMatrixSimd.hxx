@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_CHANNEL_MATRIX_SIMD_HXX
+#define MPD_PCM_CHANNEL_MATRIX_SIMD_HXX
+
+#include <cstddef>
+
+/*
+ * Vectorized kernels for #PcmChannelMixer, selected at startup (see
+ * PcmGetSimdLevel()).
+ */
+
+/**
+ * Mix interleaved float samples with #src_channels channels down to
+ * stereo.
+ *
+ * @param left the gain of each source channel in the left output
+ * channel; must be readable for #MAX_CHANNELS elements (padded with
+ * zeroes)
+ * @param right the same for the right output channel
+ */
+void
+PcmMixToStereoSimd(float *dest, const float *src, std::size_t n_frames,
+		   unsigned src_channels,
+		   const float *left, const float *right) noexcept;
+
+#endif
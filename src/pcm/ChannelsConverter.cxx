@@ -27,6 +27,12 @@ PcmChannelsConverter::Open(SampleFormat _format,
 				      _format);
 	}
 
+	const auto matrix = PcmChannelMatrix::Default(_src_channels,
+						      _dest_channels);
+	use_mixer = _format == SampleFormat::FLOAT || matrix.IsRouting();
+	if (use_mixer)
+		mixer.Open(_format, matrix);
+
 	format = _format;
 	src_channels = _src_channels;
 	dest_channels = _dest_channels;
@@ -43,6 +49,9 @@ PcmChannelsConverter::Close() noexcept
 std::span<const std::byte>
 PcmChannelsConverter::Convert(std::span<const std::byte> src) noexcept
 {
+	if (use_mixer)
+		return mixer.Apply(src);
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
 	case SampleFormat::S8:
@@ -5,6 +5,7 @@
 #define MPD_PCM_CHANNELS_CONVERTER_HXX
 
 #include "SampleFormat.hxx"
+#include "ChannelMatrix.hxx"
 #include "Buffer.hxx"
 
 #include <span>
@@ -20,6 +21,16 @@ class PcmChannelsConverter {
 	SampleFormat format;
 	unsigned src_channels, dest_channels;
 
+	/**
+	 * Use #mixer instead of the pcm_convert_channels_*()
+	 * functions?  This is the case for floating point samples and
+	 * for conversions which only copy channels; integer
+	 * averaging keeps the exact integer arithmetic.
+	 */
+	bool use_mixer;
+
+	PcmChannelMixer mixer;
+
 	PcmBuffer buffer;
 
 public:
@@ -3,6 +3,7 @@
 
 #include "ConfiguredResampler.hxx"
 #include "FallbackResampler.hxx"
+#include "PolyphaseResampler.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "config/Block.hxx"
@@ -25,6 +26,8 @@
 enum class SelectedResampler {
 	FALLBACK,
 
+	POLYPHASE,
+
 #ifdef ENABLE_LIBSAMPLERATE
 	LIBSAMPLERATE,
 #endif
@@ -125,7 +128,9 @@ pcm_resampler_global_init(const ConfigData &config)
 				      block->line);
 
 	if (strcmp(plugin_name, "internal") == 0) {
-		selected_resampler = SelectedResampler::FALLBACK;
+		selected_resampler = pcm_resample_polyphase_global_init(*block)
+			? SelectedResampler::POLYPHASE
+			: SelectedResampler::FALLBACK;
 #ifdef ENABLE_SOXR
 	} else if (strcmp(plugin_name, "soxr") == 0) {
 		selected_resampler = SelectedResampler::SOXR;
@@ -149,6 +154,9 @@ pcm_resampler_create()
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
+	case SelectedResampler::POLYPHASE:
+		return new PolyphasePcmResampler();
+
 #ifdef ENABLE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
 		return new LibsampleratePcmResampler();
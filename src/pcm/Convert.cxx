@@ -5,6 +5,7 @@
 #include "ConfiguredResampler.hxx"
 #include "util/SpanCast.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -28,6 +29,21 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 		format.format = dsd2pcm_float
 			? SampleFormat::FLOAT
 			: SampleFormat::S24_P32;
+
+		/* if a resampler is going to be used anyway, reduce
+		   the huge sample rates of DSD128 and above with the
+		   (much cheaper) half-band decimator, but never below
+		   352.8 kHz */
+		unsigned decimation = 0;
+		while (decimation < PcmDsd::MAX_DECIMATION &&
+		       format.sample_rate != dest_format.sample_rate &&
+		       format.sample_rate / 2 >= std::max(dest_format.sample_rate,
+							  352800U)) {
+			format.sample_rate /= 2;
+			++decimation;
+		}
+
+		dsd.SetDecimation(decimation);
 #else
 		throw std::runtime_error("DSD support is disabled");
 #endif
@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ConvertSimd.hxx"
+#include "Simd.hxx"
+#include "ShiftConvert.hxx"
+#include "FloatConvert.hxx"
+#include "util/TransformN.hxx"
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+using C16To24 = LeftShiftSampleConvert<SampleFormat::S16,
+				       SampleFormat::S24_P32>;
+using C16To32 = LeftShiftSampleConvert<SampleFormat::S16,
+				       SampleFormat::S32>;
+using C24To32 = LeftShiftSampleConvert<SampleFormat::S24_P32,
+				       SampleFormat::S32>;
+using C32To24 = RightShiftSampleConvert<SampleFormat::S32,
+					SampleFormat::S24_P32>;
+using CFloatTo16 = FloatToIntegerSampleConvert<SampleFormat::S16>;
+using CFloatTo24 = FloatToIntegerSampleConvert<SampleFormat::S24_P32>;
+using CFloatTo32 = FloatToIntegerSampleConvert<SampleFormat::S32>;
+using C16ToFloat = IntegerToFloatSampleConvert<SampleFormat::S16>;
+using C24ToFloat = IntegerToFloatSampleConvert<SampleFormat::S24_P32>;
+using C32ToFloat = IntegerToFloatSampleConvert<SampleFormat::S32>;
+
+template<typename C>
+static void
+ScalarConvert(typename C::DstTraits::pointer dest,
+	      typename C::SrcTraits::const_pointer src,
+	      std::size_t n) noexcept
+{
+	transform_n(src, n, dest, C::Convert);
+}
+
+#ifdef PCM_SIMD_X86
+
+/*
+ * Notes on the float-to-integer conversions:
+ *
+ * - the scalar code truncates and then clamps; clamping in the
+ *   floating point domain and then truncating gives the same
+ *   results, as long as the limits are representable as float
+ *
+ * - that is not the case with INT32_MAX; instead, we rely on
+ *   cvttps2dq returning 0x80000000 for all values out of range,
+ *   which is already the right result for negative values, and flip
+ *   all bits for the positive ones
+ */
+
+[[gnu::target("sse2")]]
+static void
+Sse2_16To24(int32_t *dest, const int16_t *src, std::size_t n) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+		/* move the 16 bit samples to the upper half of
+		   each 32 bit lane, then shift back with sign
+		   extension */
+		const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(zero, x), 8);
+		const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(zero, x), 8);
+
+		_mm_storeu_si128((__m128i *)(dest + i), a);
+		_mm_storeu_si128((__m128i *)(dest + i + 4), b);
+	}
+
+	ScalarConvert<C16To24>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2_16To32(int32_t *dest, const int16_t *src, std::size_t n) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_unpacklo_epi16(zero, x));
+		_mm_storeu_si128((__m128i *)(dest + i + 4),
+				 _mm_unpackhi_epi16(zero, x));
+	}
+
+	ScalarConvert<C16To32>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2_24To32(int32_t *dest, const int32_t *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_slli_epi32(x, 8));
+	}
+
+	ScalarConvert<C24To32>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2_32To24(int32_t *dest, const int32_t *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_srai_epi32(x, 8));
+	}
+
+	ScalarConvert<C32To24>(dest + i, src + i, n - i);
+}
+
+template<typename C>
+[[gnu::target("sse2")]]
+static inline __m128i
+Sse2FloatToInt(__m128 x) noexcept
+{
+	x = _mm_mul_ps(x, _mm_set1_ps(C::factor));
+	x = _mm_max_ps(x, _mm_set1_ps(C::DstTraits::MIN));
+	x = _mm_min_ps(x, _mm_set1_ps(C::DstTraits::MAX));
+	return _mm_cvttps_epi32(x);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2FloatTo16(int16_t *dest, const float *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i a = Sse2FloatToInt<CFloatTo16>(_mm_loadu_ps(src + i));
+		const __m128i b = Sse2FloatToInt<CFloatTo16>(_mm_loadu_ps(src + i + 4));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(a, b));
+	}
+
+	ScalarConvert<CFloatTo16>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2FloatTo24(int32_t *dest, const float *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 Sse2FloatToInt<CFloatTo24>(_mm_loadu_ps(src + i)));
+
+	ScalarConvert<CFloatTo24>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2FloatTo32(int32_t *dest, const float *src, std::size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(CFloatTo32::factor);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), factor);
+		const __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, factor));
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_xor_si128(_mm_cvttps_epi32(x), overflow));
+	}
+
+	ScalarConvert<CFloatTo32>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2_16ToFloat(float *dest, const int16_t *src, std::size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(C16ToFloat::factor);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(a), factor));
+		_mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), factor));
+	}
+
+	ScalarConvert<C16ToFloat>(dest + i, src + i, n - i);
+}
+
+template<typename C>
+[[gnu::target("sse2")]]
+static void
+Sse2_32ToFloat(float *dest, const int32_t *src, std::size_t n) noexcept
+{
+	const __m128 factor = _mm_set1_ps(C::factor);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(x), factor));
+	}
+
+	ScalarConvert<C>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2_16To24(int32_t *dest, const int16_t *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_slli_epi32(x, 8));
+	}
+
+	ScalarConvert<C16To24>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2_16To32(int32_t *dest, const int16_t *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_slli_epi32(x, 16));
+	}
+
+	ScalarConvert<C16To32>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2_24To32(int32_t *dest, const int32_t *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_slli_epi32(x, 8));
+	}
+
+	ScalarConvert<C24To32>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2_32To24(int32_t *dest, const int32_t *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_srai_epi32(x, 8));
+	}
+
+	ScalarConvert<C32To24>(dest + i, src + i, n - i);
+}
+
+template<typename C>
+[[gnu::target("avx2")]]
+static inline __m256i
+Avx2FloatToInt(__m256 x) noexcept
+{
+	x = _mm256_mul_ps(x, _mm256_set1_ps(C::factor));
+	x = _mm256_max_ps(x, _mm256_set1_ps(C::DstTraits::MIN));
+	x = _mm256_min_ps(x, _mm256_set1_ps(C::DstTraits::MAX));
+	return _mm256_cvttps_epi32(x);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2FloatTo16(int16_t *dest, const float *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i a = Avx2FloatToInt<CFloatTo16>(_mm256_loadu_ps(src + i));
+		const __m256i b = Avx2FloatToInt<CFloatTo16>(_mm256_loadu_ps(src + i + 8));
+
+		/* _mm256_packs_epi32() works on each 128 bit lane
+		   separately; restore the order */
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+								_MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(dest + i), packed);
+	}
+
+	ScalarConvert<CFloatTo16>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2FloatTo24(int32_t *dest, const float *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    Avx2FloatToInt<CFloatTo24>(_mm256_loadu_ps(src + i)));
+
+	ScalarConvert<CFloatTo24>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2FloatTo32(int32_t *dest, const float *src, std::size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(CFloatTo32::factor);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), factor);
+		const __m256i overflow =
+			_mm256_castps_si256(_mm256_cmp_ps(x, factor, _CMP_GE_OQ));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_xor_si256(_mm256_cvttps_epi32(x),
+						     overflow));
+	}
+
+	ScalarConvert<CFloatTo32>(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2_16ToFloat(float *dest, const int16_t *src, std::size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(C16ToFloat::factor);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	ScalarConvert<C16ToFloat>(dest + i, src + i, n - i);
+}
+
+template<typename C>
+[[gnu::target("avx2")]]
+static void
+Avx2_32ToFloat(float *dest, const int32_t *src, std::size_t n) noexcept
+{
+	const __m256 factor = _mm256_set1_ps(C::factor);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	ScalarConvert<C>(dest + i, src + i, n - i);
+}
+
+#endif // PCM_SIMD_X86
+
+namespace {
+
+struct ConvertKernels {
+	void (*s16_to_24)(int32_t *, const int16_t *, std::size_t) noexcept;
+	void (*s16_to_32)(int32_t *, const int16_t *, std::size_t) noexcept;
+	void (*s24_to_32)(int32_t *, const int32_t *, std::size_t) noexcept;
+	void (*s32_to_24)(int32_t *, const int32_t *, std::size_t) noexcept;
+	void (*float_to_16)(int16_t *, const float *, std::size_t) noexcept;
+	void (*float_to_24)(int32_t *, const float *, std::size_t) noexcept;
+	void (*float_to_32)(int32_t *, const float *, std::size_t) noexcept;
+	void (*s16_to_float)(float *, const int16_t *, std::size_t) noexcept;
+	void (*s24_to_float)(float *, const int32_t *, std::size_t) noexcept;
+	void (*s32_to_float)(float *, const int32_t *, std::size_t) noexcept;
+};
+
+} // anonymous namespace
+
+static ConvertKernels
+SelectKernels() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+		return {
+			Sse2_16To24, Sse2_16To32, Sse2_24To32, Sse2_32To24,
+			Sse2FloatTo16, Sse2FloatTo24, Sse2FloatTo32,
+			Sse2_16ToFloat,
+			Sse2_32ToFloat<C24ToFloat>, Sse2_32ToFloat<C32ToFloat>,
+		};
+
+	case PcmSimdLevel::AVX2:
+		return {
+			Avx2_16To24, Avx2_16To32, Avx2_24To32, Avx2_32To24,
+			Avx2FloatTo16, Avx2FloatTo24, Avx2FloatTo32,
+			Avx2_16ToFloat,
+			Avx2_32ToFloat<C24ToFloat>, Avx2_32ToFloat<C32ToFloat>,
+		};
+#endif
+
+	default:
+		break;
+	}
+
+	return {
+		ScalarConvert<C16To24>, ScalarConvert<C16To32>,
+		ScalarConvert<C24To32>, ScalarConvert<C32To24>,
+		ScalarConvert<CFloatTo16>, ScalarConvert<CFloatTo24>,
+		ScalarConvert<CFloatTo32>,
+		ScalarConvert<C16ToFloat>, ScalarConvert<C24ToFloat>,
+		ScalarConvert<C32ToFloat>,
+	};
+}
+
+/* resolved at static initialization time; a function-local static
+   would be unsafe with -fno-threadsafe-statics */
+static const ConvertKernels kernels = SelectKernels();
+
+void
+PcmConvertSimd16To24(int32_t *dest, const int16_t *src, std::size_t n) noexcept
+{
+	kernels.s16_to_24(dest, src, n);
+}
+
+void
+PcmConvertSimd16To32(int32_t *dest, const int16_t *src, std::size_t n) noexcept
+{
+	kernels.s16_to_32(dest, src, n);
+}
+
+void
+PcmConvertSimd24To32(int32_t *dest, const int32_t *src, std::size_t n) noexcept
+{
+	kernels.s24_to_32(dest, src, n);
+}
+
+void
+PcmConvertSimd32To24(int32_t *dest, const int32_t *src, std::size_t n) noexcept
+{
+	kernels.s32_to_24(dest, src, n);
+}
+
+void
+PcmConvertSimdFloatTo16(int16_t *dest, const float *src, std::size_t n) noexcept
+{
+	kernels.float_to_16(dest, src, n);
+}
+
+void
+PcmConvertSimdFloatTo24(int32_t *dest, const float *src, std::size_t n) noexcept
+{
+	kernels.float_to_24(dest, src, n);
+}
+
+void
+PcmConvertSimdFloatTo32(int32_t *dest, const float *src, std::size_t n) noexcept
+{
+	kernels.float_to_32(dest, src, n);
+}
+
+void
+PcmConvertSimd16ToFloat(float *dest, const int16_t *src, std::size_t n) noexcept
+{
+	kernels.s16_to_float(dest, src, n);
+}
+
+void
+PcmConvertSimd24ToFloat(float *dest, const int32_t *src, std::size_t n) noexcept
+{
+	kernels.s24_to_float(dest, src, n);
+}
+
+void
+PcmConvertSimd32ToFloat(float *dest, const int32_t *src, std::size_t n) noexcept
+{
+	kernels.s32_to_float(dest, src, n);
+}
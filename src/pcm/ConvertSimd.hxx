@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_CONVERT_SIMD_HXX
+#define MPD_PCM_CONVERT_SIMD_HXX
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Vectorized sample format conversions for PcmFormat.cxx, selected
+ * at startup (see PcmGetSimdLevel()).  Currently, there are SSE2 and
+ * AVX2 implementations, and all others fall back to the
+ * scalar code from ShiftConvert.hxx and FloatConvert.hxx.  The
+ * results are bit-exact with the scalar code.
+ *
+ * The conversions to 16 bit which need dithering are not here,
+ * because #PcmDither cannot be vectorized.
+ */
+
+void
+PcmConvertSimd16To24(int32_t *dest, const int16_t *src,
+		     std::size_t n) noexcept;
+
+void
+PcmConvertSimd16To32(int32_t *dest, const int16_t *src,
+		     std::size_t n) noexcept;
+
+void
+PcmConvertSimd24To32(int32_t *dest, const int32_t *src,
+		     std::size_t n) noexcept;
+
+void
+PcmConvertSimd32To24(int32_t *dest, const int32_t *src,
+		     std::size_t n) noexcept;
+
+void
+PcmConvertSimdFloatTo16(int16_t *dest, const float *src,
+			std::size_t n) noexcept;
+
+void
+PcmConvertSimdFloatTo24(int32_t *dest, const float *src,
+			std::size_t n) noexcept;
+
+void
+PcmConvertSimdFloatTo32(int32_t *dest, const float *src,
+			std::size_t n) noexcept;
+
+void
+PcmConvertSimd16ToFloat(float *dest, const int16_t *src,
+			std::size_t n) noexcept;
+
+void
+PcmConvertSimd24ToFloat(float *dest, const int32_t *src,
+			std::size_t n) noexcept;
+
+void
+PcmConvertSimd32ToFloat(float *dest, const int32_t *src,
+			std::size_t n) noexcept;
+
+#endif
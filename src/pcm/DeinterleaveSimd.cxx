@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "DeinterleaveSimd.hxx"
+#include "Simd.hxx"
+#include "FloatConvert.hxx"
+
+#include <cassert>
+#include <cstdint>
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+template<typename T>
+static void
+ScalarDeinterleave(float *const*dest, const T *src, std::size_t n_frames,
+		   unsigned channels, float factor) noexcept
+{
+	for (std::size_t i = 0; i < n_frames; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			dest[c][i] = float(*src++) * factor;
+}
+
+template<typename T>
+static void
+ScalarDeinterleaveStereo(float *left, float *right, const T *src,
+			 std::size_t n, float factor) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i) {
+		left[i] = float(src[2 * i]) * factor;
+		right[i] = float(src[2 * i + 1]) * factor;
+	}
+}
+
+#ifdef PCM_SIMD_X86
+
+[[gnu::target("sse2")]]
+static void
+Sse2DeinterleaveStereoFloat(float *left, float *right, const float *src,
+			    std::size_t n, float factor) noexcept
+{
+	assert(factor == 1.0f);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 a = _mm_loadu_ps(src + 2 * i);
+		const __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+		_mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+	ScalarDeinterleaveStereo(left + i, right + i, src + 2 * i, n - i, factor);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2DeinterleaveStereo16(float *left, float *right, const int16_t *src,
+			 std::size_t n, float factor) noexcept
+{
+	const __m128 f = _mm_set1_ps(factor);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		/* each 32 bit lane contains one frame; the left
+		   sample is in the lower half */
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+		const __m128i l = _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+		const __m128i r = _mm_srai_epi32(x, 16);
+		_mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(l), f));
+		_mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(r), f));
+	}
+
+	ScalarDeinterleaveStereo(left + i, right + i, src + 2 * i, n - i, factor);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2DeinterleaveStereo32(float *left, float *right, const int32_t *src,
+			 std::size_t n, float factor) noexcept
+{
+	const __m128 f = _mm_set1_ps(factor);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+		const __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + 2 * i + 4)));
+		const __m128i l = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i r = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(l), f));
+		_mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(r), f));
+	}
+
+	ScalarDeinterleaveStereo(left + i, right + i, src + 2 * i, n - i, factor);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+static void
+NeonDeinterleaveStereoFloat(float *left, float *right, const float *src,
+			    std::size_t n, float factor) noexcept
+{
+	assert(factor == 1.0f);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4x2_t x = vld2q_f32(src + 2 * i);
+		vst1q_f32(left + i, x.val[0]);
+		vst1q_f32(right + i, x.val[1]);
+	}
+
+	ScalarDeinterleaveStereo(left + i, right + i, src + 2 * i, n - i, factor);
+}
+
+static void
+NeonDeinterleaveStereo16(float *left, float *right, const int16_t *src,
+			 std::size_t n, float factor) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int16x4x2_t x = vld2_s16(src + 2 * i);
+		vst1q_f32(left + i,
+			  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(x.val[0])), factor));
+		vst1q_f32(right + i,
+			  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(x.val[1])), factor));
+	}
+
+	ScalarDeinterleaveStereo(left + i, right + i, src + 2 * i, n - i, factor);
+}
+
+static void
+NeonDeinterleaveStereo32(float *left, float *right, const int32_t *src,
+			 std::size_t n, float factor) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4x2_t x = vld2q_s32(src + 2 * i);
+		vst1q_f32(left + i, vmulq_n_f32(vcvtq_f32_s32(x.val[0]), factor));
+		vst1q_f32(right + i, vmulq_n_f32(vcvtq_f32_s32(x.val[1]), factor));
+	}
+
+	ScalarDeinterleaveStereo(left + i, right + i, src + 2 * i, n - i, factor);
+}
+
+#endif // PCM_SIMD_NEON
+
+namespace {
+
+struct DeinterleaveKernels {
+	void (*stereo_float)(float *left, float *right, const float *src,
+			     std::size_t n, float factor) noexcept;
+	void (*stereo_16)(float *left, float *right, const int16_t *src,
+			  std::size_t n, float factor) noexcept;
+	void (*stereo_32)(float *left, float *right, const int32_t *src,
+			  std::size_t n, float factor) noexcept;
+};
+
+} // anonymous namespace
+
+static DeinterleaveKernels
+SelectKernels() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+	case PcmSimdLevel::AVX2:
+		/* the kernels are bound by memory bandwidth; AVX2
+		   does not gain anything here */
+		return {
+			Sse2DeinterleaveStereoFloat,
+			Sse2DeinterleaveStereo16,
+			Sse2DeinterleaveStereo32,
+		};
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON:
+		return {
+			NeonDeinterleaveStereoFloat,
+			NeonDeinterleaveStereo16,
+			NeonDeinterleaveStereo32,
+		};
+#endif
+
+	default:
+		break;
+	}
+
+	return {
+		ScalarDeinterleaveStereo<float>,
+		ScalarDeinterleaveStereo<int16_t>,
+		ScalarDeinterleaveStereo<int32_t>,
+	};
+}
+
+/**
+ * Selected during static initialization, before the JACK process
+ * thread exists (MPD is built with -fno-threadsafe-statics).
+ */
+static const DeinterleaveKernels kernels = SelectKernels();
+
+template<typename T>
+static void
+Deinterleave(float *const*dest, const T *src, std::size_t n_frames,
+	     unsigned channels, float factor,
+	     void (*stereo)(float *left, float *right, const T *src,
+			    std::size_t n, float factor) noexcept) noexcept
+{
+	if (channels == 2)
+		stereo(dest[0], dest[1], src, n_frames, factor);
+	else
+		ScalarDeinterleave(dest, src, n_frames, channels, factor);
+}
+
+void
+PcmDeinterleaveToFloat(float *const*dest, const void *src,
+		       std::size_t n_frames, unsigned channels,
+		       SampleFormat format) noexcept
+{
+	assert(IsDeinterleaveToFloatSupported(format));
+
+
+	switch (format) {
+	case SampleFormat::S16:
+		Deinterleave(dest, (const int16_t *)src, n_frames, channels,
+			     IntegerToFloatSampleConvert<SampleFormat::S16>::factor,
+			     kernels.stereo_16);
+		break;
+
+	case SampleFormat::S24_P32:
+		Deinterleave(dest, (const int32_t *)src, n_frames, channels,
+			     IntegerToFloatSampleConvert<SampleFormat::S24_P32>::factor,
+			     kernels.stereo_32);
+		break;
+
+	case SampleFormat::S32:
+		Deinterleave(dest, (const int32_t *)src, n_frames, channels,
+			     IntegerToFloatSampleConvert<SampleFormat::S32>::factor,
+			     kernels.stereo_32);
+		break;
+
+	case SampleFormat::FLOAT:
+		Deinterleave(dest, (const float *)src, n_frames, channels,
+			     1.0f, kernels.stereo_float);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+}
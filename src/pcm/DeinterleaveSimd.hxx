@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_DEINTERLEAVE_SIMD_HXX
+#define MPD_PCM_DEINTERLEAVE_SIMD_HXX
+
+#include "SampleFormat.hxx"
+
+#include <cstddef>
+
+/**
+ * Can PcmDeinterleaveToFloat() convert from this sample format?
+ */
+constexpr bool
+IsDeinterleaveToFloatSupported(SampleFormat format) noexcept
+{
+	return format == SampleFormat::S16 ||
+		format == SampleFormat::S24_P32 ||
+		format == SampleFormat::S32 ||
+		format == SampleFormat::FLOAT;
+}
+
+/**
+ * Convert interleaved samples to planar float (in the range
+ * [-1 .. 1]) in one pass.  This is what sound servers like JACK
+ * want; doing the conversion while de-interleaving saves one pass
+ * over the data.  The implementation is selected at startup (see
+ * PcmGetSimdLevel()); the results are bit-exact with
+ * IntegerToFloatSampleConvert.
+ *
+ * @param dest one destination array for each channel, each with
+ * room for #n_frames samples
+ * @param src #n_frames interleaved frames
+ * @param format the sample format of #src; must be supported by
+ * IsDeinterleaveToFloatSupported()
+ */
+void
+PcmDeinterleaveToFloat(float *const*dest, const void *src,
+		       std::size_t n_frames, unsigned channels,
+		       SampleFormat format) noexcept;
+
+#endif
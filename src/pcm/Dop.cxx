@@ -4,76 +4,62 @@
 #include "Dop.hxx"
 #include "ChannelDefs.hxx"
 
+#include <bit>
 #include <cassert>
-#include <functional>
 
-static constexpr uint32_t
-pcm_two_dsd_to_dop_marker1(std::byte a, std::byte b) noexcept
-{
-	return 0xff050000 | (static_cast<uint32_t>(a) << 8) | static_cast<uint32_t>(b);
-}
+static constexpr std::byte DOP_MARKER1{0x05}, DOP_MARKER2{0xfa};
 
-static constexpr uint32_t
-pcm_two_dsd_to_dop_marker2(std::byte a, std::byte b) noexcept
+void
+DsdToDopConverter::Open(unsigned _channels,
+			bool shift8, bool reverse_endian) noexcept
 {
-	return 0xfffa0000 | (static_cast<uint32_t>(a) << 8) | static_cast<uint32_t>(b);
-}
+	assert(audio_valid_channel_count(_channels));
 
-/**
- * @param num_dop_quads the number of "quad" bytes per channel in the
- * source buffer; each "quad" will be converted to two 24 bit samples
- * in the destination buffer, one for each marker
- */
-static void
-DsdToDop(uint32_t *dest, const std::byte *src,
-	 size_t num_dop_quads, unsigned channels) noexcept
-{
-	for (size_t i = num_dop_quads; i > 0; --i) {
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0x05 marker */
+	channels = _channels;
 
-			*dest++ = pcm_two_dsd_to_dop_marker1(src[0], src[channels]);
+	rest_buffer.Open(channels);
 
-			/* seek the source pointer to the next
-			   channel */
-			++src;
+	/* one group is a "quad" (four bytes) of each channel, which
+	   is converted to two 24 bit samples per channel, one for
+	   each marker; each sample has 16 DSD sample bits plus the
+	   magic marker, padded to 32 bit with 0xff (or shifted to
+	   the most significant bits with 0x00 in the least
+	   significant byte) */
+	const bool msb_first = (std::endian::native == std::endian::big) != reverse_endian;
+	shuffle.Build(4 * channels, 8 * channels, [this, msb_first, shift8](std::size_t i){
+		const std::size_t j = i / 4, b = i % 4;
+		const std::size_t half = j / channels, c = j % channels;
+
+		std::size_t significance = msb_first ? b : 3 - b;
+		if (shift8) {
+			if (significance == 3)
+				return PcmByteShuffle::Code::Constant(std::byte{0});
+			++significance;
 		}
 
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
+		switch (significance) {
+		case 0:
+			return PcmByteShuffle::Code::Constant(std::byte{0xff});
 
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0xfa marker */
+		case 1:
+			return PcmByteShuffle::Code::Constant(half == 0
+							      ? DOP_MARKER1
+							      : DOP_MARKER2);
 
-			*dest++ = pcm_two_dsd_to_dop_marker2(src[0], src[channels]);
-
-			/* seek the source pointer to the next
-			   channel */
-			++src;
+		default:
+			/* the older byte is the more significant one */
+			return PcmByteShuffle::Code::Copy(half * 2 * channels +
+							  (significance - 2) * channels +
+							  c);
 		}
-
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
-	}
-}
-
-void
-DsdToDopConverter::Open(unsigned _channels) noexcept
-{
-	assert(audio_valid_channel_count(_channels));
-
-	channels = _channels;
-
-	rest_buffer.Open(channels);
+	});
 }
 
 std::span<const uint32_t>
 DsdToDopConverter::Convert(std::span<const std::byte> src) noexcept
 {
 	return rest_buffer.Process<uint32_t>(buffer, src, 2 * channels,
-					     [this](auto && arg1, auto && arg2, auto && arg3) { return DsdToDop(arg1, arg2, arg3, channels); });
+					     [this](uint32_t *dest, const std::byte *s, size_t n){
+						     shuffle.Apply((std::byte *)dest, s, n);
+					     });
 }
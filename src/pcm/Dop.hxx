@@ -4,6 +4,7 @@
 #pragma once
 
 #include "Buffer.hxx"
+#include "ByteShuffle.hxx"
 #include "RestBuffer.hxx"
 
 #include <cstdint>
@@ -17,12 +18,22 @@
 class DsdToDopConverter {
 	unsigned channels;
 
+	PcmByteShuffle shuffle;
+
 	PcmBuffer buffer;
 
 	PcmRestBuffer<std::byte, 4> rest_buffer;
 
 public:
-	void Open(unsigned _channels) noexcept;
+	/**
+	 * @param shift8 shift the 24 bit samples to the most
+	 * significant bits of the 32 bit word (see
+	 * PcmExport::Params::shift8)
+	 * @param reverse_endian store the samples in the opposite of
+	 * the native byte order
+	 */
+	void Open(unsigned _channels,
+		  bool shift8=false, bool reverse_endian=false) noexcept;
 
 	void Reset() noexcept {
 		rest_buffer.Reset();
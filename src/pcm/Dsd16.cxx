@@ -3,47 +3,30 @@
 
 #include "Dsd16.hxx"
 
-/**
- * Construct a 16 bit integer from two bytes.
- */
-static constexpr uint16_t
-Construct16(std::byte a, std::byte b) noexcept
-{
-	/* "a" is the oldest byte, which must be in the most
-	   significant byte */
-
-	return uint16_t(b) | (uint16_t(a) << 8);
-}
-
-static constexpr uint16_t
-Dsd8To16Sample(const std::byte *src, unsigned channels) noexcept
-{
-	return Construct16(src[0], src[channels]);
-}
-
-static void
-Dsd8To16(uint16_t *dest, const std::byte *src,
-	 size_t out_frames, unsigned channels) noexcept
-{
-	for (size_t i = 0; i < out_frames; ++i) {
-		for (size_t c = 0; c < channels; ++c)
-			*dest++ = Dsd8To16Sample(src++, channels);
-
-		src += channels;
-	}
-}
+#include <bit>
 
 void
-Dsd16Converter::Open(unsigned _channels) noexcept
+Dsd16Converter::Open(unsigned _channels, bool reverse_endian) noexcept
 {
 	channels = _channels;
 
 	rest_buffer.Open(channels);
+
+	/* each 16 bit sample is made of two bytes of the same
+	   channel; the oldest byte is the most significant one */
+	const bool msb_first = (std::endian::native == std::endian::big) != reverse_endian;
+	shuffle.Build(2 * channels, 2 * channels, [this, msb_first](std::size_t i){
+		const std::size_t c = i / 2, b = i % 2;
+		const std::size_t significance = msb_first ? b : 1 - b;
+		return PcmByteShuffle::Code::Copy(significance * channels + c);
+	});
 }
 
 std::span<const uint16_t>
 Dsd16Converter::Convert(std::span<const std::byte> src) noexcept
 {
 	return rest_buffer.Process<uint16_t>(buffer, src, channels,
-					     [this](auto && arg1, auto && arg2, auto && arg3) { return Dsd8To16(arg1, arg2, arg3, channels); });
+					     [this](uint16_t *dest, const std::byte *s, size_t n){
+						     shuffle.Apply((std::byte *)dest, s, n);
+					     });
 }
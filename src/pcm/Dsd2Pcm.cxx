@@ -31,22 +31,26 @@ or implied, of Sebastian Gesemann.
  */
 
 #include "Dsd2Pcm.hxx"
+#include "Simd.hxx"
 #include "Traits.hxx"
 #include "util/BitReverse.hxx"
 #include "util/GenerateArray.hxx"
 
-#include <cassert>
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#endif
 
-#include <stdlib.h>
-#include <string.h>
+#include <algorithm>
+#include <cassert>
 
 /** number of FIR constants */
 static constexpr size_t HTAPS = 48;
 
 /** number of "8 MACs" lookup tables */
 static constexpr size_t CTABLES = (HTAPS + 7) / 8;
+static_assert(CTABLES == Dsd2Pcm::CTABLES);
 
-static_assert(Dsd2Pcm::FIFOSIZE * 8 >= HTAPS * 2, "FIFOSIZE too small");
+static constexpr size_t HISTORY = Dsd2Pcm::HISTORY;
 
 /*
  * Properties of this 96-tap lowpass filter when applied on a signal
@@ -168,61 +172,218 @@ GenerateCtableS24(size_t i) noexcept
 
 static constexpr auto ctables_s24 = GenerateArray<CTABLES>(GenerateCtableS24);
 
+/**
+ * Generate a copy of the given lookup tables with bit-reversed
+ * indices.  These are used for the second half of the symmetric
+ * filter, which would otherwise need the input bytes bit-reversed.
+ */
+template<typename T>
+static constexpr auto
+GenerateReversedCtables(const std::array<std::array<T, 256>, CTABLES> &src) noexcept
+{
+	return GenerateArray<CTABLES>([&src](size_t i){
+		return GenerateArray<256>([&src, i](size_t j){
+			return src[i][static_cast<std::size_t>(BitReverseMultiplyModulus(std::byte(j)))];
+		});
+	});
+}
+
+static constexpr auto rctables = GenerateReversedCtables(ctables);
+static constexpr auto rctables_s24 = GenerateReversedCtables(ctables_s24);
+
 void
 Dsd2Pcm::Reset() noexcept
 {
 	/* my favorite silence pattern */
-	fifo.fill(SampleTraits<SampleFormat::DSD>::SILENCE);
-
-	fifopos = 0;
+	constexpr auto silence = SampleTraits<SampleFormat::DSD>::SILENCE;
+
+	/* the old FIFO implementation used to bit-reverse each byte
+	   in place while calculating the output for the byte
+	   CTABLES positions after it; the initial silence bytes
+	   before that were never reversed, and this emulates that for
+	   bit-exact output */
+	std::fill_n(history.begin(), HISTORY - CTABLES,
+		    BitReverseMultiplyModulus(silence));
+	std::fill(history.begin() + (HISTORY - CTABLES), history.end(),
+		  silence);
 }
 
 inline void
-Dsd2Pcm::ApplySample(size_t ffp, std::byte src) noexcept
+Dsd2Pcm::LoadBlock(std::byte *buffer, size_t n,
+		   const std::byte *src, ptrdiff_t src_stride) noexcept
 {
-	fifo[ffp] = src;
-	std::byte *p = fifo.data() + ((ffp-CTABLES) & FIFOMASK);
-	*p = BitReverse(*p);
+	assert(n <= BLOCK_SIZE);
+
+	std::copy(history.begin(), history.end(), buffer);
+
+	for (size_t i = 0; i < n; ++i, src += src_stride)
+		buffer[HISTORY + i] = *src;
+
+	std::copy_n(buffer + n, HISTORY, history.begin());
 }
 
-inline float
-Dsd2Pcm::CalcOutputSample(size_t ffp) const noexcept
+/**
+ * Calculate one output sample.
+ *
+ * @param p pointer to the newest input byte in the linear buffer;
+ * #HISTORY bytes before it must be valid
+ */
+template<typename T, typename Tables>
+static inline auto
+CalcOutputSample(const Tables &tables, const Tables &rtables,
+		 const std::byte *p) noexcept
 {
-	double acc = 0;
+	T acc = 0;
 	for (size_t i = 0; i < CTABLES; ++i) {
-		std::byte bite1 = fifo[(ffp              -i) & FIFOMASK];
-		std::byte bite2 = fifo[(ffp-(CTABLES*2-1)+i) & FIFOMASK];
-		acc += double(ctables[i][static_cast<std::size_t>(bite1)]
-			      + ctables[i][static_cast<std::size_t>(bite2)]);
+		const auto bite1 = static_cast<std::size_t>(p[-ptrdiff_t(i)]);
+		const auto bite2 = static_cast<std::size_t>(p[ptrdiff_t(i) - ptrdiff_t(HISTORY)]);
+		acc += T(tables[i][bite1] + rtables[i][bite2]);
 	}
-	return float(acc);
+
+	return acc;
 }
 
-inline float
-Dsd2Pcm::TranslateSample(size_t ffp, std::byte src) noexcept
+static void
+ScalarTranslateBlock(const std::byte *p, size_t n, float *out) noexcept
 {
-	ApplySample(ffp, src);
-	return CalcOutputSample(ffp);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = float(CalcOutputSample<double>(ctables, rctables, p + i));
 }
 
-inline int32_t
-Dsd2Pcm::CalcOutputSampleS24(size_t ffp) const noexcept
+static void
+ScalarTranslateBlockS24(const std::byte *p, size_t n, int32_t *out) noexcept
 {
-	int32_t acc = 0;
-	for (size_t i = 0; i < CTABLES; ++i) {
-		std::byte bite1 = fifo[(ffp              -i) & FIFOMASK];
-		std::byte bite2 = fifo[(ffp-(CTABLES*2-1)+i) & FIFOMASK];
-		acc += ctables_s24[i][static_cast<std::size_t>(bite1)]
-			+ ctables_s24[i][static_cast<std::size_t>(bite2)];
+	for (size_t i = 0; i < n; ++i)
+		out[i] = CalcOutputSample<int32_t>(ctables_s24, rctables_s24,
+						   p + i);
+}
+
+#ifdef PCM_SIMD_X86
+
+/**
+ * Load 8 bytes and zero-extend them to 32 bit lookup table indices.
+ */
+[[gnu::target("avx2")]]
+static inline __m256i
+Avx2LoadIndices(const std::byte *p) noexcept
+{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+/**
+ * Calculate 8 output samples at a time, with each table lookup done
+ * by a gather instruction.  The floating point operations are the
+ * same as in CalcOutputSample(), which makes the result bit-exact.
+ */
+[[gnu::target("avx2")]]
+static void
+Avx2TranslateBlock(const std::byte *p, size_t n, float *out) noexcept
+{
+	size_t j = 0;
+	for (; j + 8 <= n; j += 8) {
+		__m256d acc_lo = _mm256_setzero_pd();
+		__m256d acc_hi = _mm256_setzero_pd();
+
+		for (size_t i = 0; i < CTABLES; ++i) {
+			const __m256i bite1 = Avx2LoadIndices(p + j - i);
+			const __m256i bite2 = Avx2LoadIndices(p + j + i - HISTORY);
+			const __m256 sum =
+				_mm256_add_ps(_mm256_i32gather_ps(ctables[i].data(),
+								  bite1, 4),
+					      _mm256_i32gather_ps(rctables[i].data(),
+								  bite2, 4));
+
+			acc_lo = _mm256_add_pd(acc_lo,
+					       _mm256_cvtps_pd(_mm256_castps256_ps128(sum)));
+			acc_hi = _mm256_add_pd(acc_hi,
+					       _mm256_cvtps_pd(_mm256_extractf128_ps(sum, 1)));
+		}
+
+		_mm256_storeu_ps(out + j,
+				 _mm256_set_m128(_mm256_cvtpd_ps(acc_hi),
+						 _mm256_cvtpd_ps(acc_lo)));
 	}
-	return acc;
+
+	ScalarTranslateBlock(p + j, n - j, out + j);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2TranslateBlockS24(const std::byte *p, size_t n, int32_t *out) noexcept
+{
+	size_t j = 0;
+	for (; j + 8 <= n; j += 8) {
+		__m256i acc = _mm256_setzero_si256();
+
+		for (size_t i = 0; i < CTABLES; ++i) {
+			const __m256i bite1 = Avx2LoadIndices(p + j - i);
+			const __m256i bite2 = Avx2LoadIndices(p + j + i - HISTORY);
+			const __m256i a = _mm256_i32gather_epi32((const int *)ctables_s24[i].data(),
+								 bite1, 4);
+			const __m256i b = _mm256_i32gather_epi32((const int *)rctables_s24[i].data(),
+								 bite2, 4);
+			acc = _mm256_add_epi32(acc, _mm256_add_epi32(a, b));
+		}
+
+		_mm256_storeu_si256((__m256i *)(out + j), acc);
+	}
+
+	ScalarTranslateBlockS24(p + j, n - j, out + j);
+}
+
+#endif // PCM_SIMD_X86
+
+namespace {
+
+struct Dsd2PcmKernels {
+	void (*translate)(const std::byte *p, size_t n, float *out) noexcept;
+	void (*translate_s24)(const std::byte *p, size_t n,
+			      int32_t *out) noexcept;
+};
+
+} // anonymous namespace
+
+static Dsd2PcmKernels
+SelectKernels() noexcept
+{
+#ifdef PCM_SIMD_X86
+	if (PcmGetSimdLevel() == PcmSimdLevel::AVX2)
+		return {Avx2TranslateBlock, Avx2TranslateBlockS24};
+#endif
+
+	return {ScalarTranslateBlock, ScalarTranslateBlockS24};
 }
 
-inline int32_t
-Dsd2Pcm::TranslateSampleS24(size_t ffp, std::byte src) noexcept
+/* resolved at static initialization time, before any decoder
+   thread runs (MPD is built with -fno-threadsafe-statics) */
+static const Dsd2PcmKernels kernels = SelectKernels();
+
+template<typename T, typename K>
+inline void
+Dsd2Pcm::TranslateBlocks(size_t samples,
+			 const std::byte *src, ptrdiff_t src_stride,
+			 T *dst, ptrdiff_t dst_stride,
+			 K kernel) noexcept
 {
-	ApplySample(ffp, src);
-	return CalcOutputSampleS24(ffp);
+	std::byte buffer[HISTORY + BLOCK_SIZE];
+	T out[BLOCK_SIZE];
+
+	while (samples > 0) {
+		const size_t n = std::min(samples, BLOCK_SIZE);
+		LoadBlock(buffer, n, src, src_stride);
+
+		if (dst_stride == 1) {
+			kernel(buffer + HISTORY, n, dst);
+		} else {
+			kernel(buffer + HISTORY, n, out);
+			for (size_t i = 0; i < n; ++i)
+				dst[i * dst_stride] = out[i];
+		}
+
+		src += ptrdiff_t(n) * src_stride;
+		dst += ptrdiff_t(n) * dst_stride;
+		samples -= n;
+	}
 }
 
 void
@@ -230,15 +391,8 @@ Dsd2Pcm::Translate(size_t samples,
 		   const std::byte *gcc_restrict src, ptrdiff_t src_stride,
 		   float *dst, ptrdiff_t dst_stride) noexcept
 {
-	size_t ffp = fifopos;
-	while (samples-- > 0) {
-		std::byte bite1 = *src;
-		src += src_stride;
-		*dst = TranslateSample(ffp, bite1);
-		dst += dst_stride;
-		ffp = (ffp + 1) & FIFOMASK;
-	}
-	fifopos = ffp;
+	TranslateBlocks(samples, src, src_stride, dst, dst_stride,
+			kernels.translate);
 }
 
 void
@@ -246,15 +400,8 @@ Dsd2Pcm::TranslateS24(size_t samples,
 		      const std::byte *gcc_restrict src, ptrdiff_t src_stride,
 		      int32_t *dst, ptrdiff_t dst_stride) noexcept
 {
-	size_t ffp = fifopos;
-	while (samples-- > 0) {
-		std::byte bite1 = *src;
-		src += src_stride;
-		*dst = TranslateSampleS24(ffp, bite1);
-		dst += dst_stride;
-		ffp = (ffp + 1) & FIFOMASK;
-	}
-	fifopos = ffp;
+	TranslateBlocks(samples, src, src_stride, dst, dst_stride,
+			kernels.translate_s24);
 }
 
 void
@@ -263,11 +410,6 @@ MultiDsd2Pcm::Translate(unsigned channels, size_t n_frames,
 {
 	assert(channels <= per_channel.max_size());
 
-	if (channels == 2) {
-		TranslateStereo(n_frames, src, dest);
-		return;
-	}
-
 	for (unsigned i = 0; i < channels; ++i) {
 		per_channel[i].Translate(n_frames,
 					 src++, channels,
@@ -275,46 +417,15 @@ MultiDsd2Pcm::Translate(unsigned channels, size_t n_frames,
 	}
 }
 
-inline void
-MultiDsd2Pcm::TranslateStereo(size_t n_frames,
-			      const std::byte *src, float *dest) noexcept
-{
-	size_t ffp = fifopos;
-	while (n_frames-- > 0) {
-		*dest++ = per_channel[0].TranslateSample(ffp, *src++);
-		*dest++ = per_channel[1].TranslateSample(ffp, *src++);
-		ffp = (ffp + 1) & Dsd2Pcm::FIFOMASK;
-	}
-	fifopos = ffp;
-}
-
 void
 MultiDsd2Pcm::TranslateS24(unsigned channels, size_t n_frames,
 			   const std::byte *src, int32_t *dest) noexcept
 {
 	assert(channels <= per_channel.max_size());
 
-	if (channels == 2) {
-		TranslateStereoS24(n_frames, src, dest);
-		return;
-	}
-
 	for (unsigned i = 0; i < channels; ++i) {
 		per_channel[i].TranslateS24(n_frames,
 					    src++, channels,
 					    dest++, channels);
 	}
 }
-
-inline void
-MultiDsd2Pcm::TranslateStereoS24(size_t n_frames,
-				 const std::byte *src, int32_t *dest) noexcept
-{
-	size_t ffp = fifopos;
-	while (n_frames-- > 0) {
-		*dest++ = per_channel[0].TranslateSampleS24(ffp, *src++);
-		*dest++ = per_channel[1].TranslateSampleS24(ffp, *src++);
-		ffp = (ffp + 1) & Dsd2Pcm::FIFOMASK;
-	}
-	fifopos = ffp;
-}
@@ -39,20 +39,34 @@ or implied, of Sebastian Gesemann.
 
 /**
  * A "dsd2pcm engine" for one channel.
+ *
+ * Input is processed in blocks: the bytes of one block (plus the
+ * history from the previous one) are copied to a linear buffer, and
+ * the output samples are calculated from there without any ring
+ * buffer arithmetic, which allows using SIMD gather instructions to
+ * look up several output samples at a time.
  */
 class Dsd2Pcm {
-	friend class MultiDsd2Pcm;
-
 public:
-	/* must be a power of two */
-	static constexpr size_t FIFOSIZE = 16;
+	/** number of "8 MACs" lookup tables */
+	static constexpr size_t CTABLES = 6;
 
-private:
-	/** bit mask for FIFO offsets */
-	static constexpr size_t FIFOMASK = FIFOSIZE - 1;
+	/**
+	 * The number of previous input bytes needed to calculate an
+	 * output sample.
+	 */
+	static constexpr size_t HISTORY = CTABLES * 2 - 1;
+
+	/**
+	 * The number of input bytes converted in one block.
+	 */
+	static constexpr size_t BLOCK_SIZE = 256;
 
-	std::array<std::byte, FIFOSIZE> fifo;
-	size_t fifopos;
+private:
+	/**
+	 * The last #HISTORY input bytes.
+	 */
+	std::array<std::byte, HISTORY> history;
 
 public:
 	Dsd2Pcm() noexcept {
@@ -67,7 +81,6 @@ public:
 	/**
 	 * "translates" a stream of octets to a stream of floats
 	 * (8:1 decimation)
-	 * @param ctx -- pointer to abstract context (buffers)
 	 * @param samples -- number of octets/samples to "translate"
 	 * @param src -- pointer to first octet (input)
 	 * @param src_stride -- src pointer increment
@@ -83,24 +96,33 @@ public:
 			  int32_t *dst, ptrdiff_t dst_stride) noexcept;
 
 private:
-	void ApplySample(size_t ffp, std::byte src) noexcept;
-	float CalcOutputSample(size_t ffp) const noexcept;
-	float TranslateSample(size_t ffp, std::byte src) noexcept;
+	/**
+	 * Copy the history and the given input bytes to the linear
+	 * buffer and update the history.
+	 *
+	 * @param n the number of input bytes (at most #BLOCK_SIZE)
+	 */
+	void LoadBlock(std::byte *buffer, size_t n,
+		       const std::byte *src, ptrdiff_t src_stride) noexcept;
 
-	int32_t CalcOutputSampleS24(size_t ffp) const noexcept;
-	int32_t TranslateSampleS24(size_t ffp, std::byte src) noexcept;
+	/**
+	 * Convert the input bytes block by block with the given
+	 * kernel.
+	 */
+	template<typename T, typename K>
+	void TranslateBlocks(size_t samples,
+			     const std::byte *src, ptrdiff_t src_stride,
+			     T *dst, ptrdiff_t dst_stride,
+			     K kernel) noexcept;
 };
 
 class MultiDsd2Pcm {
 	std::array<Dsd2Pcm, MAX_CHANNELS> per_channel;
 
-	size_t fifopos = 0;
-
 public:
 	void Reset() noexcept {
 		for (auto &i : per_channel)
 			i.Reset();
-		fifopos = 0;
 	}
 
 	void Translate(unsigned channels, size_t n_frames,
@@ -108,16 +130,6 @@ public:
 
 	void TranslateS24(unsigned channels, size_t n_frames,
 			  const std::byte *src, int32_t *dest) noexcept;
-
-private:
-	/**
-	 * Optimized implementation for the common case.
-	 */
-	void TranslateStereo(size_t n_frames,
-			     const std::byte *src, float *dest) noexcept;
-
-	void TranslateStereoS24(size_t n_frames,
-				const std::byte *src, int32_t *dest) noexcept;
 };
 
 #endif /* include guard DSD2PCM_H_INCLUDED */
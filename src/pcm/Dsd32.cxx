@@ -3,49 +3,30 @@
 
 #include "Dsd32.hxx"
 
-/**
- * Construct a 32 bit integer from four bytes.
- */
-static constexpr uint32_t
-Construct32(std::byte a, std::byte b, std::byte c, std::byte d) noexcept
-{
-	/* "a" is the oldest byte, which must be in the most
-	   significant byte */
-
-	return uint32_t(d) | (uint32_t(c) << 8) |
-		(uint32_t(b) << 16) | (uint32_t(a) << 24);
-}
-
-static constexpr uint32_t
-Dsd8To32Sample(const std::byte *src, unsigned channels) noexcept
-{
-	return Construct32(src[0], src[channels],
-			   src[2 * channels], src[3 * channels]);
-}
-
-static void
-Dsd8To32(uint32_t *dest, const std::byte *src,
-	 size_t out_frames, unsigned channels) noexcept
-{
-	for (size_t i = 0; i < out_frames; ++i) {
-		for (size_t c = 0; c < channels; ++c)
-			*dest++ = Dsd8To32Sample(src++, channels);
-
-		src += 3 * channels;
-	}
-}
+#include <bit>
 
 void
-Dsd32Converter::Open(unsigned _channels) noexcept
+Dsd32Converter::Open(unsigned _channels, bool reverse_endian) noexcept
 {
 	channels = _channels;
 
 	rest_buffer.Open(channels);
+
+	/* each 32 bit sample is made of four bytes of the same
+	   channel; the oldest byte is the most significant one */
+	const bool msb_first = (std::endian::native == std::endian::big) != reverse_endian;
+	shuffle.Build(4 * channels, 4 * channels, [this, msb_first](std::size_t i){
+		const std::size_t c = i / 4, b = i % 4;
+		const std::size_t significance = msb_first ? b : 3 - b;
+		return PcmByteShuffle::Code::Copy(significance * channels + c);
+	});
 }
 
 std::span<const uint32_t>
 Dsd32Converter::Convert(std::span<const std::byte> src) noexcept
 {
 	return rest_buffer.Process<uint32_t>(buffer, src, channels,
-					     [this](auto && arg1, auto && arg2, auto && arg3) { return Dsd8To32(arg1, arg2, arg3, channels); });
+					     [this](uint32_t *dest, const std::byte *s, size_t n){
+						     shuffle.Apply((std::byte *)dest, s, n);
+					     });
 }
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "Buffer.hxx"
+#include "ByteShuffle.hxx"
 #include "RestBuffer.hxx"
 
 #include <cstdint>
@@ -15,12 +16,18 @@
 class Dsd32Converter {
 	unsigned channels;
 
+	PcmByteShuffle shuffle;
+
 	PcmBuffer buffer;
 
 	PcmRestBuffer<std::byte, 4> rest_buffer;
 
 public:
-	void Open(unsigned _channels) noexcept;
+	/**
+	 * @param reverse_endian store the samples in the opposite of
+	 * the native byte order
+	 */
+	void Open(unsigned _channels, bool reverse_endian=false) noexcept;
 
 	void Reset() noexcept {
 		rest_buffer.Reset();
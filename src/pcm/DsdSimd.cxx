@@ -0,0 +1,362 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "DsdSimd.hxx"
+#include "Simd.hxx"
+#include "util/BitReverse.hxx"
+
+#include <cstdint>
+
+#include <string.h>
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr std::size_t MAX_IN_VECTORS = 64 / 16;
+static constexpr std::size_t MAX_OUT_VECTORS = 128 / 16;
+
+static inline void
+ScalarBitReverse(std::byte *dest, const std::byte *src, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = BitReverse(src[i]);
+}
+
+static void
+ScalarInterleaveStereo(std::byte *dest, const std::byte *left,
+		       const std::byte *right, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i) {
+		dest[2 * i] = left[i];
+		dest[2 * i + 1] = right[i];
+	}
+}
+
+#ifdef PCM_SIMD_X86
+
+/*
+ * The shuffle kernel needs PSHUFB (SSSE3), which is only assumed to
+ * be present at the AVX2 level.
+ */
+
+[[gnu::target("avx2")]]
+static bool
+Avx2Shuffle(std::byte *dest, const std::byte *src, std::size_t n_periods,
+	    std::size_t period_in, std::size_t period_out,
+	    const uint8_t *source, const std::byte *constant) noexcept
+{
+	const std::size_t n_in = period_in / 16, n_out = period_out / 16;
+
+	/* one PSHUFB mask for each pair of input and output vector;
+	   0x80 clears the byte */
+	__m128i masks[MAX_OUT_VECTORS][MAX_IN_VECTORS];
+	__m128i constants[MAX_OUT_VECTORS];
+	unsigned used[MAX_OUT_VECTORS];
+
+	for (std::size_t k = 0; k < n_out; ++k) {
+		constants[k] = _mm_loadu_si128((const __m128i *)(constant + 16 * k));
+		used[k] = 0;
+
+		for (std::size_t j = 0; j < n_in; ++j) {
+			alignas(16) uint8_t m[16];
+			for (std::size_t b = 0; b < 16; ++b) {
+				const uint8_t s = source[16 * k + b];
+				if (s != 0xff && s / 16 == j) {
+					m[b] = s % 16;
+					used[k] |= 1U << j;
+				} else
+					m[b] = 0x80;
+			}
+
+			masks[k][j] = _mm_load_si128((const __m128i *)m);
+		}
+	}
+
+	for (std::size_t p = 0; p < n_periods; ++p) {
+		__m128i in[MAX_IN_VECTORS];
+		for (std::size_t j = 0; j < n_in; ++j)
+			in[j] = _mm_loadu_si128((const __m128i *)(src + 16 * j));
+
+		for (std::size_t k = 0; k < n_out; ++k) {
+			__m128i out = constants[k];
+			for (std::size_t j = 0; j < n_in; ++j)
+				if (used[k] & (1U << j))
+					out = _mm_or_si128(out, _mm_shuffle_epi8(in[j], masks[k][j]));
+
+			_mm_storeu_si128((__m128i *)(dest + 16 * k), out);
+		}
+
+		src += period_in;
+		dest += period_out;
+	}
+
+	return true;
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2BitReverse(std::byte *dest, const std::byte *src, std::size_t n) noexcept
+{
+	/* swap adjacent bits, then bit pairs, then nibbles; the
+	   masks remove the bits shifted in from the neighbouring
+	   byte */
+	const __m128i m1 = _mm_set1_epi8(0x55);
+	const __m128i m2 = _mm_set1_epi8(0x33);
+	const __m128i m4 = _mm_set1_epi8(0x0f);
+
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 1), m1),
+				 _mm_slli_epi16(_mm_and_si128(x, m1), 1));
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 2), m2),
+				 _mm_slli_epi16(_mm_and_si128(x, m2), 2));
+		x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 4), m4),
+				 _mm_slli_epi16(_mm_and_si128(x, m4), 4));
+		_mm_storeu_si128((__m128i *)(dest + i), x);
+	}
+
+	ScalarBitReverse(dest + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2BitReverse(std::byte *dest, const std::byte *src, std::size_t n) noexcept
+{
+	/* look up the reversed nibbles with VPSHUFB */
+	static constexpr uint8_t reversed_nibbles[16] = {
+		0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+		0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+	};
+
+	const __m256i hi_table =
+		_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)reversed_nibbles));
+	const __m256i lo_table = _mm256_slli_epi16(hi_table, 4);
+	const __m256i m4 = _mm256_set1_epi8(0x0f);
+
+	std::size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		const __m256i lo = _mm256_and_si256(x, m4);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), m4);
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_or_si256(_mm256_shuffle_epi8(lo_table, lo),
+						    _mm256_shuffle_epi8(hi_table, hi)));
+	}
+
+	ScalarBitReverse(dest + i, src + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2InterleaveStereo(std::byte *dest, const std::byte *left,
+		     const std::byte *right, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+		const __m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+		_mm_storeu_si128((__m128i *)(dest + 2 * i),
+				 _mm_unpacklo_epi8(l, r));
+		_mm_storeu_si128((__m128i *)(dest + 2 * i + 16),
+				 _mm_unpackhi_epi8(l, r));
+	}
+
+	ScalarInterleaveStereo(dest + 2 * i, left + i, right + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2InterleaveStereo(std::byte *dest, const std::byte *left,
+		     const std::byte *right, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i l = _mm256_loadu_si256((const __m256i *)(left + i));
+		const __m256i r = _mm256_loadu_si256((const __m256i *)(right + i));
+
+		/* the unpack instructions work within 128 bit lanes;
+		   reorder the lanes afterwards */
+		const __m256i lo = _mm256_unpacklo_epi8(l, r);
+		const __m256i hi = _mm256_unpackhi_epi8(l, r);
+		_mm256_storeu_si256((__m256i *)(dest + 2 * i),
+				    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dest + 2 * i + 32),
+				    _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	ScalarInterleaveStereo(dest + 2 * i, left + i, right + i, n - i);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+#ifdef __aarch64__
+
+static bool
+NeonShuffle(std::byte *dest, const std::byte *src, std::size_t n_periods,
+	    std::size_t period_in, std::size_t period_out,
+	    const uint8_t *source, const std::byte *constant) noexcept
+{
+	/* TBL with four table registers covers the whole input
+	   period; out-of-range indices (0xff for constants) yield
+	   zero */
+	const std::size_t n_in = period_in / 16, n_out = period_out / 16;
+
+	uint8x16_t indices[MAX_OUT_VECTORS], constants[MAX_OUT_VECTORS];
+	for (std::size_t k = 0; k < n_out; ++k) {
+		indices[k] = vld1q_u8(source + 16 * k);
+		constants[k] = vld1q_u8((const uint8_t *)constant + 16 * k);
+	}
+
+	for (std::size_t p = 0; p < n_periods; ++p) {
+		uint8x16x4_t in;
+		in.val[0] = vld1q_u8((const uint8_t *)src);
+		in.val[1] = n_in > 1 ? vld1q_u8((const uint8_t *)src + 16) : vdupq_n_u8(0);
+		in.val[2] = n_in > 2 ? vld1q_u8((const uint8_t *)src + 32) : vdupq_n_u8(0);
+		in.val[3] = n_in > 3 ? vld1q_u8((const uint8_t *)src + 48) : vdupq_n_u8(0);
+
+		for (std::size_t k = 0; k < n_out; ++k)
+			vst1q_u8((uint8_t *)dest + 16 * k,
+				 vorrq_u8(vqtbl4q_u8(in, indices[k]), constants[k]));
+
+		src += period_in;
+		dest += period_out;
+	}
+
+	return true;
+}
+
+#endif // __aarch64__
+
+static void
+NeonBitReverse(std::byte *dest, const std::byte *src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t x = vld1q_u8((const uint8_t *)src + i);
+#ifdef __aarch64__
+		x = vrbitq_u8(x);
+#else
+		x = vorrq_u8(vshrq_n_u8(vandq_u8(x, vdupq_n_u8(0xaa)), 1),
+			     vshlq_n_u8(vandq_u8(x, vdupq_n_u8(0x55)), 1));
+		x = vorrq_u8(vshrq_n_u8(vandq_u8(x, vdupq_n_u8(0xcc)), 2),
+			     vshlq_n_u8(vandq_u8(x, vdupq_n_u8(0x33)), 2));
+		x = vorrq_u8(vshrq_n_u8(x, 4), vshlq_n_u8(x, 4));
+#endif
+		vst1q_u8((uint8_t *)dest + i, x);
+	}
+
+	ScalarBitReverse(dest + i, src + i, n - i);
+}
+
+static void
+NeonInterleaveStereo(std::byte *dest, const std::byte *left,
+		     const std::byte *right, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		uint8x16x2_t x;
+		x.val[0] = vld1q_u8((const uint8_t *)left + i);
+		x.val[1] = vld1q_u8((const uint8_t *)right + i);
+		vst2q_u8((uint8_t *)dest + 2 * i, x);
+	}
+
+	ScalarInterleaveStereo(dest + 2 * i, left + i, right + i, n - i);
+}
+
+#endif // PCM_SIMD_NEON
+
+namespace {
+
+struct DsdKernels {
+	bool (*shuffle)(std::byte *dest, const std::byte *src,
+			std::size_t n_periods,
+			std::size_t period_in, std::size_t period_out,
+			const uint8_t *source, const std::byte *constant) noexcept;
+
+	void (*bit_reverse)(std::byte *dest, const std::byte *src,
+			    std::size_t n) noexcept;
+
+	void (*interleave_stereo)(std::byte *dest, const std::byte *left,
+				  const std::byte *right,
+				  std::size_t n) noexcept;
+};
+
+} // anonymous namespace
+
+static DsdKernels
+SelectKernels() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+		return {nullptr, Sse2BitReverse, Sse2InterleaveStereo};
+
+	case PcmSimdLevel::AVX2:
+		return {Avx2Shuffle, Avx2BitReverse, Avx2InterleaveStereo};
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON:
+#ifdef __aarch64__
+		return {NeonShuffle, NeonBitReverse, NeonInterleaveStereo};
+#else
+		return {nullptr, NeonBitReverse, NeonInterleaveStereo};
+#endif
+#endif
+
+	default:
+		break;
+	}
+
+	return {nullptr, ScalarBitReverse, ScalarInterleaveStereo};
+}
+
+/* resolved before main(); see -fno-threadsafe-statics */
+static const DsdKernels kernels = SelectKernels();
+
+bool
+PcmShuffleSimd(std::byte *dest, const std::byte *src, std::size_t n_periods,
+	       std::size_t period_in, std::size_t period_out,
+	       const uint8_t *source, const std::byte *constant) noexcept
+{
+	const auto f = kernels.shuffle;
+	return f != nullptr &&
+		f(dest, src, n_periods, period_in, period_out,
+		  source, constant);
+}
+
+void
+PcmBitReverseSimd(std::byte *dest, const std::byte *src, std::size_t n) noexcept
+{
+	kernels.bit_reverse(dest, src, n);
+}
+
+void
+PcmInterleaveDsdSimd(std::byte *dest, const std::byte *src,
+		     std::size_t n, unsigned channels) noexcept
+{
+	switch (channels) {
+	case 1:
+		memcpy(dest, src, n);
+		break;
+
+	case 2:
+		kernels.interleave_stereo(dest, src, src + n, n);
+		break;
+
+	default:
+		for (unsigned c = 0; c < channels; ++c, src += n)
+			for (std::size_t i = 0; i < n; ++i)
+				dest[i * channels + c] = src[i];
+		break;
+	}
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_DSD_SIMD_HXX
+#define MPD_PCM_DSD_SIMD_HXX
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Vectorized kernels for exporting DSD, selected at startup (see
+ * PcmGetSimdLevel()).
+ */
+
+/**
+ * Rearrange bytes according to a #PcmByteShuffle period.
+ *
+ * @param period_in the number of input bytes per period (a multiple
+ * of 16, at most 64)
+ * @param period_out the number of output bytes per period (a
+ * multiple of 16, at most 128)
+ * @param source the input offset of each output byte of a period or
+ * 0xff for constant bytes
+ * @param constant the value of each output byte which is not copied
+ * (zero for copied bytes)
+ * @return false if there is no vectorized implementation (nothing
+ * was done)
+ */
+bool
+PcmShuffleSimd(std::byte *dest, const std::byte *src, std::size_t n_periods,
+	       std::size_t period_in, std::size_t period_out,
+	       const uint8_t *source, const std::byte *constant) noexcept;
+
+/**
+ * Reverse the bit order of each byte (DSD LSB-first to MSB-first
+ * and vice versa).  #dest and #src may be the same buffer.
+ */
+void
+PcmBitReverseSimd(std::byte *dest, const std::byte *src, std::size_t n) noexcept;
+
+/**
+ * Interleave planar DSD: #src contains one block of #n bytes for
+ * each channel, and #dest receives n*channels bytes with one byte
+ * of each channel after the other (the order used by MPD).  The
+ * buffers must not overlap.
+ */
+void
+PcmInterleaveDsdSimd(std::byte *dest, const std::byte *src,
+		     std::size_t n, unsigned channels) noexcept;
+
+#endif
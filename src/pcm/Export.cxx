@@ -29,12 +29,18 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		? params.dsd_mode
 		: DsdMode::NONE;
 
+	/* the DSD converters can change the byte order (and shift
+	   DoP samples) in the same pass; only packing to 24 bit
+	   needs another one */
+	bool dsd_reverse_endian = false;
+
 	switch (dsd_mode) {
 	case DsdMode::NONE:
 		break;
 
 	case DsdMode::U16:
-		dsd16_converter.Open(_channels);
+		dsd_reverse_endian = params.reverse_endian;
+		dsd16_converter.Open(_channels, dsd_reverse_endian);
 
 		/* after the conversion to DSD_U16, the DSD samples
 		   are stuffed inside fake 16 bit samples */
@@ -42,7 +48,8 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		break;
 
 	case DsdMode::U32:
-		dsd32_converter.Open(_channels);
+		dsd_reverse_endian = params.reverse_endian;
+		dsd32_converter.Open(_channels, dsd_reverse_endian);
 
 		/* after the conversion to DSD_U32, the DSD samples
 		   are stuffed inside fake 32 bit samples */
@@ -50,13 +57,24 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		break;
 
 	case DsdMode::DOP:
-		dop_converter.Open(_channels);
+		if (!params.pack24) {
+			dsd_reverse_endian = params.reverse_endian;
+			dop_converter.Open(_channels, params.shift8,
+					   dsd_reverse_endian);
+
+			/* the converter has already done it */
+			params.shift8 = false;
+		} else
+			dop_converter.Open(_channels);
 
 		/* after the conversion to DoP, the DSD
 		   samples are stuffed inside fake 24 bit samples */
 		sample_format = SampleFormat::S24_P32;
 		break;
 	}
+
+	if (dsd_reverse_endian)
+		params.reverse_endian = false;
 #endif
 
 	shift8 = params.shift8 && sample_format == SampleFormat::S24_P32;
@@ -81,7 +99,7 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 	assert(buffer_size < sizeof(buffer));
 	PcmSilence({buffer, buffer_size}, src_sample_format);
 	auto s = Export({buffer, buffer_size});
-	assert(s.size() < sizeof(silence_buffer));
+	assert(s.size() <= sizeof(silence_buffer));
 	silence_size = s.size();
 	std::copy(s.begin(), s.end(), silence_buffer);
 }
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "HalfBandDecimator.hxx"
+#include "Clamp.hxx"
+#include "Traits.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+/**
+ * The odd taps (1, 3, 5, ...) of a 31-tap half-band filter (Kaiser
+ * window, beta=8), normalized to unity gain at DC.  All even taps are
+ * zero, except for the center tap.
+ */
+static constexpr float odd_taps[] = {
+	0.313045527433702,
+	-0.09122480814029418,
+	0.041536704659328606,
+	-0.019227637930233982,
+	0.008020324010272311,
+	-0.0027344414174941068,
+	0.0006422540255711147,
+	-4.962987862434643e-05,
+};
+
+static constexpr float center_tap = 0.49998341447554523;
+
+static constexpr std::size_t HISTORY = PcmHalfBandDecimator::HISTORY;
+static_assert(std::size(odd_taps) * 4 == HISTORY + 2);
+
+/**
+ * Calculate one output sample.
+ *
+ * @param p pointer to the newest input sample in the linear buffer;
+ * #HISTORY samples before it must be valid
+ */
+static inline float
+CalcOutputSample(const float *p) noexcept
+{
+	const float *center = p - HISTORY / 2;
+
+	float acc = center_tap * *center;
+	for (std::size_t i = 0; i < std::size(odd_taps); ++i) {
+		const std::ptrdiff_t offset = 2 * i + 1;
+		acc += odd_taps[i] * (center[-offset] + center[offset]);
+	}
+
+	return acc;
+}
+
+static inline float
+ConvertOutput(float x, float) noexcept
+{
+	return x;
+}
+
+static inline int32_t
+ConvertOutput(float x, int32_t) noexcept
+{
+	return PcmClamp<SampleFormat::S24_P32>(std::lrint(x));
+}
+
+void
+PcmHalfBandDecimator::Reset() noexcept
+{
+	for (auto &i : history)
+		i.fill(0);
+
+	odd = false;
+}
+
+template<typename T>
+inline std::span<const T>
+PcmHalfBandDecimator::ProcessT(unsigned channels,
+			       std::span<const T> src) noexcept
+{
+	assert(channels > 0 && channels <= MAX_CHANNELS);
+	assert(src.size() % channels == 0);
+
+	const std::size_t n_frames = src.size() / channels;
+	const std::size_t n_out_frames = (n_frames + odd) / 2;
+
+	T *dest = buffer.GetT<T>(n_out_frames * channels);
+
+	/* process each channel in blocks, using a linear buffer
+	   which contains the history followed by the new samples */
+	constexpr std::size_t BLOCK_SIZE = 256;
+	float linear[HISTORY + BLOCK_SIZE];
+
+	for (unsigned c = 0; c < channels; ++c) {
+		auto &h = history[c];
+		bool block_odd = odd;
+		T *out = dest + c;
+
+		for (std::size_t start = 0; start < n_frames; start += BLOCK_SIZE) {
+			const std::size_t n = std::min(n_frames - start,
+						       BLOCK_SIZE);
+
+			std::copy(h.begin(), h.end(), linear);
+			for (std::size_t i = 0; i < n; ++i)
+				linear[HISTORY + i] = float(src[(start + i) * channels + c]);
+			std::copy_n(linear + n, HISTORY, h.begin());
+
+			/* the first input sample which completes an
+			   output sample */
+			for (std::size_t i = !block_odd; i < n; i += 2) {
+				*out = ConvertOutput(CalcOutputSample(linear + HISTORY + i),
+						     T{});
+				out += channels;
+			}
+
+			if (n % 2)
+				block_odd = !block_odd;
+		}
+	}
+
+	if (n_frames % 2)
+		odd = !odd;
+
+	return {dest, n_out_frames * channels};
+}
+
+std::span<const float>
+PcmHalfBandDecimator::Process(unsigned channels,
+			      std::span<const float> src) noexcept
+{
+	return ProcessT(channels, src);
+}
+
+std::span<const int32_t>
+PcmHalfBandDecimator::Process(unsigned channels,
+			      std::span<const int32_t> src) noexcept
+{
+	return ProcessT(channels, src);
+}
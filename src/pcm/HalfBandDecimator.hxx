@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_HALF_BAND_DECIMATOR_HXX
+#define MPD_PCM_HALF_BAND_DECIMATOR_HXX
+
+#include "Buffer.hxx"
+#include "ChannelDefs.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * A half-band FIR lowpass filter which halves the sample rate.  It
+ * is flat up to 0.17 times the input sample rate; everything which
+ * would alias into that range is attenuated by more than 60 dB, and
+ * by more than 90 dB near the Nyquist frequency.
+ *
+ * This is used to reduce the huge sample rates of DSD128 and above
+ * after dsd2pcm, because that's much cheaper than letting the
+ * resampler do it.
+ */
+class PcmHalfBandDecimator {
+public:
+	/**
+	 * The number of previous input samples (per channel)
+	 * needed to calculate an output sample.
+	 */
+	static constexpr std::size_t HISTORY = 30;
+
+private:
+	PcmBuffer buffer;
+
+	std::array<std::array<float, HISTORY>, MAX_CHANNELS> history;
+
+	/**
+	 * Has an odd number of frames been consumed so far?  Only
+	 * every second input frame produces an output frame.
+	 */
+	bool odd;
+
+public:
+	PcmHalfBandDecimator() noexcept {
+		Reset();
+	}
+
+	void Reset() noexcept;
+
+	/**
+	 * @param src interleaved samples
+	 * @return the decimated samples; this buffer is owned by
+	 * this object and is invalidated by the next call
+	 */
+	std::span<const float> Process(unsigned channels,
+				       std::span<const float> src) noexcept;
+
+	/**
+	 * Like the other overload, but with S24_P32 samples; the
+	 * result is clamped to 24 bits.
+	 */
+	std::span<const int32_t> Process(unsigned channels,
+					 std::span<const int32_t> src) noexcept;
+
+private:
+	template<typename T>
+	std::span<const T> ProcessT(unsigned channels,
+				    std::span<const T> src) noexcept;
+};
+
+#endif
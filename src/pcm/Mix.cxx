@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "Mix.hxx"
+#include "MixSimd.hxx"
 #include "Volume.hxx"
 #include "Clamp.hxx"
 #include "Traits.hxx"
@@ -10,6 +11,7 @@
 
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -55,20 +57,57 @@ PcmAddVolumeVoid(PcmDither &dither,
 				volume1, volume2);
 }
 
+/**
+ * Like PcmAddVolume(), but let a vectorized "premix" function
+ * calculate the products block by block; only the dither is applied
+ * sample by sample, which keeps the result bit-exact.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>, typename P>
 static void
-pcm_add_vol_float(float *buffer1, const float *buffer2,
-		  unsigned num_samples, float volume1, float volume2) noexcept
+PcmAddVolumePremix(PcmDither &dither,
+		   typename Traits::pointer a,
+		   typename Traits::const_pointer b,
+		   size_t n, int volume1, int volume2,
+		   P premix) noexcept
 {
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
+	assert(volume1 >= 0 && volume1 <= PCM_VOLUME_1S);
+	assert(volume2 >= 0 && volume2 <= PCM_VOLUME_1S);
 
-		sample1 = (sample1 * volume1 + sample2 * volume2);
-		*buffer1++ = sample1;
-		--num_samples;
+	constexpr size_t BLOCK_SIZE = 256;
+	typename Traits::long_type c[BLOCK_SIZE];
+
+	while (n > 0) {
+		const size_t chunk = std::min(n, BLOCK_SIZE);
+		premix(c, a, b, chunk, volume1, volume2);
+
+		for (size_t i = 0; i != chunk; ++i)
+			a[i] = dither.DitherShift<typename Traits::long_type,
+						  Traits::BITS + PCM_VOLUME_BITS,
+						  Traits::BITS>(c[i]);
+
+		a += chunk;
+		b += chunk;
+		n -= chunk;
 	}
 }
 
+template<SampleFormat F, class Traits=SampleTraits<F>, typename P>
+static void
+PcmAddVolumePremixVoid(PcmDither &dither,
+		       void *a, const void *b, size_t size,
+		       int volume1, int volume2,
+		       P premix) noexcept
+{
+	constexpr size_t sample_size = Traits::SAMPLE_SIZE;
+	assert(size % sample_size == 0);
+
+	PcmAddVolumePremix<F, Traits>(dither,
+				      typename Traits::pointer(a),
+				      typename Traits::const_pointer(b),
+				      size / sample_size,
+				      volume1, volume2, premix);
+}
+
 static bool
 pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	    int vol1, int vol2,
@@ -87,28 +126,31 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVolumeVoid<SampleFormat::S16>(dither,
-						    buffer1, buffer2, size,
-						    vol1, vol2);
+		PcmAddVolumePremixVoid<SampleFormat::S16>(dither,
+							  buffer1, buffer2, size,
+							  vol1, vol2,
+							  PcmPremixSimd16);
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVolumeVoid<SampleFormat::S24_P32>(dither,
-							buffer1, buffer2, size,
-							vol1, vol2);
+		PcmAddVolumePremixVoid<SampleFormat::S24_P32>(dither,
+							      buffer1, buffer2, size,
+							      vol1, vol2,
+							      PcmPremixSimd32);
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVolumeVoid<SampleFormat::S32>(dither,
-						    buffer1, buffer2, size,
-						    vol1, vol2);
+		PcmAddVolumePremixVoid<SampleFormat::S32>(dither,
+							  buffer1, buffer2, size,
+							  vol1, vol2,
+							  PcmPremixSimd32);
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_vol_float((float *)buffer1, (const float *)buffer2,
-				  size / 4,
-				  pcm_volume_to_float(vol1),
-				  pcm_volume_to_float(vol2));
+		PcmAddVolumeSimdFloat((float *)buffer1, (const float *)buffer2,
+				      size / sizeof(float),
+				      pcm_volume_to_float(vol1),
+				      pcm_volume_to_float(vol2));
 		return true;
 	}
 
@@ -147,18 +189,6 @@ PcmAddVoid(void *a, const void *b, size_t size) noexcept
 			  size / sample_size);
 }
 
-static void
-pcm_add_float(float *buffer1, const float *buffer2,
-	      unsigned num_samples) noexcept
-{
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
-		*buffer1++ = sample1 + sample2;
-		--num_samples;
-	}
-}
-
 static bool
 pcm_add(void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format) noexcept
@@ -174,20 +204,23 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		PcmAddSimd16((int16_t *)buffer1, (const int16_t *)buffer2,
+			     size / sizeof(int16_t));
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
+		PcmAddSimd24((int32_t *)buffer1, (const int32_t *)buffer2,
+			     size / sizeof(int32_t));
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
+		PcmAddSimd32((int32_t *)buffer1, (const int32_t *)buffer2,
+			     size / sizeof(int32_t));
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_float((float *)buffer1, (const float *)buffer2,
-			      size / 4);
+		PcmAddSimdFloat((float *)buffer1, (const float *)buffer2,
+				size / sizeof(float));
 		return true;
 	}
 
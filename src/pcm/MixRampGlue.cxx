@@ -67,6 +67,13 @@ ToString(const MixRampData &mr, FloatDuration total_time,
 	gcc_unreachable();
 }
 
+std::string
+MixRampToString(const MixRampAnalyzer &a,
+		MixRampDirection direction) noexcept
+{
+	return ToString(a.GetResult(), a.GetTime(), direction);
+}
+
 std::string
 AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
 	       MixRampDirection direction) noexcept
@@ -86,5 +93,5 @@ AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
 		a.Process(FromBytesStrict<const ReplayGainAnalyzer::Frame>({chunk->data, chunk->length}));
 	} while ((chunk = chunk->next.get()) != nullptr);
 
-	return ToString(a.GetResult(), a.GetTime(), direction);
+	return MixRampToString(a, direction);
 }
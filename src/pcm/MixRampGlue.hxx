@@ -7,11 +7,21 @@
 
 struct AudioFormat;
 class MusicPipe;
+class MixRampAnalyzer;
 
 enum class MixRampDirection {
 	START, END
 };
 
+/**
+ * Format the result of a #MixRampAnalyzer which has been fed a whole
+ * song as a "mixramp_start" or "mixramp_end" value.
+ */
+[[gnu::pure]]
+std::string
+MixRampToString(const MixRampAnalyzer &a,
+		MixRampDirection direction) noexcept;
+
 [[gnu::pure]]
 std::string
 AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
@@ -0,0 +1,573 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MixSimd.hxx"
+#include "Simd.hxx"
+#include "Clamp.hxx"
+#include "Traits.hxx"
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr int32_t S24_MIN = SampleTraits<SampleFormat::S24_P32>::MIN;
+static constexpr int32_t S24_MAX = SampleTraits<SampleFormat::S24_P32>::MAX;
+
+static inline void
+ScalarAdd16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		a[i] = PcmClamp<SampleFormat::S16>(int32_t(a[i]) + b[i]);
+}
+
+static inline void
+ScalarAdd24(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		a[i] = PcmClamp<SampleFormat::S24_P32>(a[i] + b[i]);
+}
+
+static inline void
+ScalarAdd32(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		a[i] = PcmClamp<SampleFormat::S32>(int64_t(a[i]) + b[i]);
+}
+
+static inline void
+ScalarAddFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		a[i] += b[i];
+}
+
+static inline void
+ScalarAddVolumeFloat(float *a, const float *b, std::size_t n,
+		     float volume1, float volume2) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		a[i] = a[i] * volume1 + b[i] * volume2;
+}
+
+static inline void
+ScalarPremix16(int32_t *dest, const int16_t *a, const int16_t *b,
+	       std::size_t n, int volume1, int volume2) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = int32_t(a[i]) * volume1 + int32_t(b[i]) * volume2;
+}
+
+static inline void
+ScalarPremix32(int64_t *dest, const int32_t *a, const int32_t *b,
+	       std::size_t n, int volume1, int volume2) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = int64_t(a[i]) * volume1 + int64_t(b[i]) * volume2;
+}
+
+#ifdef PCM_SIMD_X86
+
+/**
+ * Clamp each 32 bit integer to the given range; SSE2 doesn't have
+ * _mm_min_epi32() and _mm_max_epi32().
+ */
+[[gnu::target("sse2")]]
+static inline __m128i
+Sse2Clamp32(__m128i x, __m128i min, __m128i max) noexcept
+{
+	const __m128i gt = _mm_cmpgt_epi32(x, max);
+	x = _mm_or_si128(_mm_andnot_si128(gt, x), _mm_and_si128(gt, max));
+
+	const __m128i lt = _mm_cmplt_epi32(x, min);
+	return _mm_or_si128(_mm_andnot_si128(lt, x), _mm_and_si128(lt, min));
+}
+
+/**
+ * Add two vectors of 32 bit integers with signed saturation.
+ */
+[[gnu::target("sse2")]]
+static inline __m128i
+Sse2AddSaturate32(__m128i a, __m128i b) noexcept
+{
+	const __m128i sum = _mm_add_epi32(a, b);
+
+	/* overflow if both operands have the same sign, but the sum
+	   has a different sign */
+	const __m128i overflow =
+		_mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, sum),
+					     _mm_xor_si128(b, sum)), 31);
+
+	/* INT32_MIN if "a" is negative, INT32_MAX otherwise */
+	const __m128i saturated = _mm_xor_si128(_mm_srai_epi32(a, 31),
+						_mm_set1_epi32(INT32_MAX));
+
+	return _mm_or_si128(_mm_andnot_si128(overflow, sum),
+			    _mm_and_si128(overflow, saturated));
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2Add16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i), _mm_adds_epi16(x, y));
+	}
+
+	ScalarAdd16(a + i, b + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2Add24(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	const __m128i min = _mm_set1_epi32(S24_MIN);
+	const __m128i max = _mm_set1_epi32(S24_MAX);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i),
+				 Sse2Clamp32(_mm_add_epi32(x, y), min, max));
+	}
+
+	ScalarAdd24(a + i, b + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2Add32(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i), Sse2AddSaturate32(x, y));
+	}
+
+	ScalarAdd32(a + i, b + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2AddFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i, _mm_add_ps(_mm_loadu_ps(a + i),
+						_mm_loadu_ps(b + i)));
+
+	ScalarAddFloat(a + i, b + i, n - i);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2AddVolumeFloat(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 x = _mm_mul_ps(_mm_loadu_ps(a + i), v1);
+		const __m128 y = _mm_mul_ps(_mm_loadu_ps(b + i), v2);
+		_mm_storeu_ps(a + i, _mm_add_ps(x, y));
+	}
+
+	ScalarAddVolumeFloat(a + i, b + i, n - i, volume1, volume2);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2Premix16(int32_t *dest, const int16_t *a, const int16_t *b,
+	     std::size_t n, int volume1, int volume2) noexcept
+{
+	/* interleave the samples of "a" and "b" and let
+	   _mm_madd_epi16() calculate a*volume1+b*volume2 */
+	const __m128i v = _mm_set1_epi32((volume2 << 16) | volume1);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_madd_epi16(_mm_unpacklo_epi16(x, y), v));
+		_mm_storeu_si128((__m128i *)(dest + i + 4),
+				 _mm_madd_epi16(_mm_unpackhi_epi16(x, y), v));
+	}
+
+	ScalarPremix16(dest + i, a + i, b + i, n - i, volume1, volume2);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2Add16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		_mm256_storeu_si256((__m256i *)(a + i),
+				    _mm256_adds_epi16(x, y));
+	}
+
+	ScalarAdd16(a + i, b + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2Add24(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	const __m256i min = _mm256_set1_epi32(S24_MIN);
+	const __m256i max = _mm256_set1_epi32(S24_MAX);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i sum = _mm256_add_epi32(x, y);
+		_mm256_storeu_si256((__m256i *)(a + i),
+				    _mm256_max_epi32(_mm256_min_epi32(sum, max),
+						     min));
+	}
+
+	ScalarAdd24(a + i, b + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2Add32(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	const __m256i int32_max = _mm256_set1_epi32(INT32_MAX);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i sum = _mm256_add_epi32(x, y);
+
+		/* see Sse2AddSaturate32() */
+		const __m256i overflow =
+			_mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(x, sum),
+							   _mm256_xor_si256(y, sum)),
+					  31);
+		const __m256i saturated =
+			_mm256_xor_si256(_mm256_srai_epi32(x, 31), int32_max);
+
+		_mm256_storeu_si256((__m256i *)(a + i),
+				    _mm256_blendv_epi8(sum, saturated,
+						       overflow));
+	}
+
+	ScalarAdd32(a + i, b + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2AddFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i, _mm256_add_ps(_mm256_loadu_ps(a + i),
+						      _mm256_loadu_ps(b + i)));
+
+	ScalarAddFloat(a + i, b + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2AddVolumeFloat(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(a + i), v1);
+		const __m256 y = _mm256_mul_ps(_mm256_loadu_ps(b + i), v2);
+		_mm256_storeu_ps(a + i, _mm256_add_ps(x, y));
+	}
+
+	ScalarAddVolumeFloat(a + i, b + i, n - i, volume1, volume2);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2Premix16(int32_t *dest, const int16_t *a, const int16_t *b,
+	     std::size_t n, int volume1, int volume2) noexcept
+{
+	const __m256i v1 = _mm256_set1_epi32(volume1);
+	const __m256i v2 = _mm256_set1_epi32(volume2);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(a + i)));
+		const __m256i y = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(b + i)));
+
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_add_epi32(_mm256_mullo_epi32(x, v1),
+						     _mm256_mullo_epi32(y, v2)));
+	}
+
+	ScalarPremix16(dest + i, a + i, b + i, n - i, volume1, volume2);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2Premix32(int64_t *dest, const int32_t *a, const int32_t *b,
+	     std::size_t n, int volume1, int volume2) noexcept
+{
+	/* _mm256_mul_epi32() multiplies the lower (signed) 32 bits
+	   of each 64 bit lane */
+	const __m256i v1 = _mm256_set1_epi64x(volume1);
+	const __m256i v2 = _mm256_set1_epi64x(volume2);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256i x = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(a + i)));
+		const __m256i y = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(b + i)));
+
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_add_epi64(_mm256_mul_epi32(x, v1),
+						     _mm256_mul_epi32(y, v2)));
+	}
+
+	ScalarPremix32(dest + i, a + i, b + i, n - i, volume1, volume2);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+static void
+NeonAdd16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(a + i, vqaddq_s16(vld1q_s16(a + i),
+					    vld1q_s16(b + i)));
+
+	ScalarAdd16(a + i, b + i, n - i);
+}
+
+static void
+NeonAdd24(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	const int32x4_t min = vdupq_n_s32(S24_MIN);
+	const int32x4_t max = vdupq_n_s32(S24_MAX);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4_t sum = vaddq_s32(vld1q_s32(a + i),
+						vld1q_s32(b + i));
+		vst1q_s32(a + i, vmaxq_s32(vminq_s32(sum, max), min));
+	}
+
+	ScalarAdd24(a + i, b + i, n - i);
+}
+
+static void
+NeonAdd32(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_s32(a + i, vqaddq_s32(vld1q_s32(a + i),
+					    vld1q_s32(b + i)));
+
+	ScalarAdd32(a + i, b + i, n - i);
+}
+
+static void
+NeonAddFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(a + i, vaddq_f32(vld1q_f32(a + i),
+					   vld1q_f32(b + i)));
+
+	ScalarAddFloat(a + i, b + i, n - i);
+}
+
+static void
+NeonAddVolumeFloat(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t x = vmulq_n_f32(vld1q_f32(a + i), volume1);
+		const float32x4_t y = vmulq_n_f32(vld1q_f32(b + i), volume2);
+		vst1q_f32(a + i, vaddq_f32(x, y));
+	}
+
+	ScalarAddVolumeFloat(a + i, b + i, n - i, volume1, volume2);
+}
+
+static void
+NeonPremix16(int32_t *dest, const int16_t *a, const int16_t *b,
+	     std::size_t n, int volume1, int volume2) noexcept
+{
+	const int16_t v1 = volume1, v2 = volume2;
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(a + i);
+		const int16x8_t y = vld1q_s16(b + i);
+
+		vst1q_s32(dest + i,
+			  vmlal_n_s16(vmull_n_s16(vget_low_s16(x), v1),
+				      vget_low_s16(y), v2));
+		vst1q_s32(dest + i + 4,
+			  vmlal_n_s16(vmull_n_s16(vget_high_s16(x), v1),
+				      vget_high_s16(y), v2));
+	}
+
+	ScalarPremix16(dest + i, a + i, b + i, n - i, volume1, volume2);
+}
+
+static void
+NeonPremix32(int64_t *dest, const int32_t *a, const int32_t *b,
+	     std::size_t n, int volume1, int volume2) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4_t x = vld1q_s32(a + i);
+		const int32x4_t y = vld1q_s32(b + i);
+
+		vst1q_s64(dest + i,
+			  vmlal_n_s32(vmull_n_s32(vget_low_s32(x), volume1),
+				      vget_low_s32(y), volume2));
+		vst1q_s64(dest + i + 2,
+			  vmlal_n_s32(vmull_n_s32(vget_high_s32(x), volume1),
+				      vget_high_s32(y), volume2));
+	}
+
+	ScalarPremix32(dest + i, a + i, b + i, n - i, volume1, volume2);
+}
+
+#endif // PCM_SIMD_NEON
+
+namespace {
+
+struct MixKernels {
+	void (*add16)(int16_t *a, const int16_t *b,
+		      std::size_t n) noexcept;
+	void (*add24)(int32_t *a, const int32_t *b,
+		      std::size_t n) noexcept;
+	void (*add32)(int32_t *a, const int32_t *b,
+		      std::size_t n) noexcept;
+	void (*add_float)(float *a, const float *b,
+			  std::size_t n) noexcept;
+
+	void (*add_volume_float)(float *a, const float *b, std::size_t n,
+				 float volume1, float volume2) noexcept;
+
+	void (*premix16)(int32_t *dest, const int16_t *a, const int16_t *b,
+			 std::size_t n, int volume1, int volume2) noexcept;
+	void (*premix32)(int64_t *dest, const int32_t *a, const int32_t *b,
+			 std::size_t n, int volume1, int volume2) noexcept;
+};
+
+} // anonymous namespace
+
+static MixKernels
+SelectKernels() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+		/* SSE2 has no signed 32x32=64 bit multiplication,
+		   therefore ScalarPremix32() */
+		return {
+			Sse2Add16, Sse2Add24, Sse2Add32, Sse2AddFloat,
+			Sse2AddVolumeFloat,
+			Sse2Premix16, ScalarPremix32,
+		};
+
+	case PcmSimdLevel::AVX2:
+		return {
+			Avx2Add16, Avx2Add24, Avx2Add32, Avx2AddFloat,
+			Avx2AddVolumeFloat,
+			Avx2Premix16, Avx2Premix32,
+		};
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON:
+		return {
+			NeonAdd16, NeonAdd24, NeonAdd32, NeonAddFloat,
+			NeonAddVolumeFloat,
+			NeonPremix16, NeonPremix32,
+		};
+#endif
+
+	default:
+		break;
+	}
+
+	return {
+		ScalarAdd16, ScalarAdd24, ScalarAdd32, ScalarAddFloat,
+		ScalarAddVolumeFloat,
+		ScalarPremix16, ScalarPremix32,
+	};
+}
+
+/**
+ * Chosen before main() runs; a function-local static would race
+ * because of -fno-threadsafe-statics.
+ */
+static const MixKernels kernels = SelectKernels();
+
+void
+PcmAddSimd16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	kernels.add16(a, b, n);
+}
+
+void
+PcmAddSimd24(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	kernels.add24(a, b, n);
+}
+
+void
+PcmAddSimd32(int32_t *a, const int32_t *b, std::size_t n) noexcept
+{
+	kernels.add32(a, b, n);
+}
+
+void
+PcmAddSimdFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	kernels.add_float(a, b, n);
+}
+
+void
+PcmAddVolumeSimdFloat(float *a, const float *b, std::size_t n,
+		      float volume1, float volume2) noexcept
+{
+	kernels.add_volume_float(a, b, n, volume1, volume2);
+}
+
+void
+PcmPremixSimd16(int32_t *dest, const int16_t *a, const int16_t *b,
+		std::size_t n, int volume1, int volume2) noexcept
+{
+	kernels.premix16(dest, a, b, n, volume1, volume2);
+}
+
+void
+PcmPremixSimd32(int64_t *dest, const int32_t *a, const int32_t *b,
+		std::size_t n, int volume1, int volume2) noexcept
+{
+	kernels.premix32(dest, a, b, n, volume1, volume2);
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_MIX_SIMD_HXX
+#define MPD_PCM_MIX_SIMD_HXX
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Vectorized kernels for pcm_mix(), selected at startup (see
+ * PcmGetSimdLevel()).  All of them yield exactly the same results as
+ * the scalar code in Mix.cxx.
+ */
+
+/**
+ * Add the samples of #b to #a, clamping the result.
+ */
+void
+PcmAddSimd16(int16_t *a, const int16_t *b, std::size_t n) noexcept;
+
+/**
+ * Add the S24_P32 samples of #b to #a, clamping the result to 24
+ * bits.
+ */
+void
+PcmAddSimd24(int32_t *a, const int32_t *b, std::size_t n) noexcept;
+
+/**
+ * Add the samples of #b to #a, clamping the result.
+ */
+void
+PcmAddSimd32(int32_t *a, const int32_t *b, std::size_t n) noexcept;
+
+void
+PcmAddSimdFloat(float *a, const float *b, std::size_t n) noexcept;
+
+/**
+ * Calculate `a*volume1 + b*volume2` and store the result in #a.
+ */
+void
+PcmAddVolumeSimdFloat(float *a, const float *b, std::size_t n,
+		      float volume1, float volume2) noexcept;
+
+/*
+ * The following functions calculate `a*volume1 + b*volume2` with
+ * the full precision, without dithering and without shifting.  The
+ * caller passes the result to #PcmDither, which cannot be vectorized,
+ * because each sample depends on the state left behind by the
+ * previous one.
+ *
+ * The volume values must be in the range [0..#PCM_VOLUME_1].
+ */
+
+void
+PcmPremixSimd16(int32_t *dest, const int16_t *a, const int16_t *b,
+		std::size_t n, int volume1, int volume2) noexcept;
+
+/**
+ * Works with both S24_P32 and S32.
+ */
+void
+PcmPremixSimd32(int64_t *dest, const int32_t *a, const int32_t *b,
+		std::size_t n, int volume1, int volume2) noexcept;
+
+#endif
@@ -3,12 +3,11 @@
 // Based on AudioCompress (c)2007 busybee (http://beesbuzz.biz/
 
 #include "Normalizer.hxx"
-#include "Clamp.hxx"
-#include "SampleFormat.hxx"
-#include "Traits.hxx"
+#include "NormalizerSimd.hxx"
 #include "util/Compiler.h"
 
 #include <algorithm> // for std::fill_n()
+#include <cmath>
 
 void
 PcmNormalizer::Reset() noexcept
@@ -18,28 +17,102 @@ PcmNormalizer::Reset() noexcept
 	std::fill_n(peaks, bufsz, 0);
 }
 
+namespace {
+
+/**
+ * The format-specific parts of PcmNormalizer::Process(): finding
+ * the peak (scaled to 16 bit) and applying the gain.
+ */
+template<SampleFormat F> struct NormalizerKernel;
+
+template<>
+struct NormalizerKernel<SampleFormat::S16> {
+	using value_type = int16_t;
+
+	static int_least64_t Peak(std::span<const value_type> src) noexcept {
+		return PcmPeakSimd16(src.data(), src.size());
+	}
+
+	static int_least64_t Scale(value_type value) noexcept {
+		return std::abs(int_least64_t(value));
+	}
+
+	static void Apply(value_type *dest, std::span<const value_type> src,
+			  int_least64_t gain, int_least64_t delta) noexcept {
+		PcmRampGainSimd16(dest, src.data(), src.size(), gain, delta);
+	}
+};
+
+template<SampleFormat F>
+struct NormalizerKernel32 {
+	using Traits = SampleTraits<F>;
+	using value_type = typename Traits::value_type;
+
+	static constexpr unsigned SCALE_SHIFT = Traits::BITS - 16;
+
+	static int_least64_t Peak(std::span<const value_type> src) noexcept {
+		return PcmPeakSimd32(src.data(), src.size()) >> SCALE_SHIFT;
+	}
+
+	static int_least64_t Scale(value_type value) noexcept {
+		return std::abs(int_least64_t(value)) >> SCALE_SHIFT;
+	}
+
+	static void Apply(value_type *dest, std::span<const value_type> src,
+			  int_least64_t gain, int_least64_t delta) noexcept {
+		PcmRampGainSimd32(dest, src.data(), src.size(), gain, delta,
+				  Traits::MIN, Traits::MAX);
+	}
+};
+
+template<>
+struct NormalizerKernel<SampleFormat::S24_P32>
+	: NormalizerKernel32<SampleFormat::S24_P32> {};
+
+template<>
+struct NormalizerKernel<SampleFormat::S32>
+	: NormalizerKernel32<SampleFormat::S32> {};
+
+template<>
+struct NormalizerKernel<SampleFormat::FLOAT> {
+	using value_type = float;
+
+	static int_least64_t Scale(value_type value) noexcept {
+		/* limit the value to avoid integer overflows in the
+		   gain calculation */
+		return std::min(std::fabs(value), 1024.f) * 32768;
+	}
+
+	static int_least64_t Peak(std::span<const value_type> src) noexcept {
+		return Scale(PcmPeakSimdFloat(src.data(), src.size()));
+	}
+
+	static void Apply(value_type *dest, std::span<const value_type> src,
+			  int_least64_t gain, int_least64_t delta) noexcept {
+		constexpr float factor = 1.f / (1 << PCM_NORMALIZER_SHIFT);
+		PcmRampGainSimdFloat(dest, src.data(), src.size(),
+				     gain * factor, delta * factor);
+	}
+};
+
+} // anonymous namespace
+
+template<SampleFormat F>
 void
-PcmNormalizer::ProcessS16(int16_t *gcc_restrict dest,
-			  const std::span<const int16_t> src) noexcept
+PcmNormalizer::Process(typename SampleTraits<F>::pointer gcc_restrict dest,
+		       const std::span<const typename SampleTraits<F>::value_type> src) noexcept
 {
-	constexpr SampleFormat format = SampleFormat::S16;
-	using Traits = SampleTraits<format>;
-	using long_type = Traits::long_type;
-
-	constexpr unsigned SHIFT = 10;
-
-	int peakVal = 1;
-	std::size_t peakPos = 0;
-	for (std::size_t i = 0; i < src.size(); i++) {
-		int val = src[i];
-                if (val < 0)
-                        val = -val;
-		if (val > peakVal)
-                {
-			peakVal = val;
-                        peakPos = i;
-                }
-	}
+	using Kernel = NormalizerKernel<F>;
+	using long_type = int_least64_t;
+
+	constexpr unsigned SHIFT = PCM_NORMALIZER_SHIFT;
+
+	//! The maximum peak on the 16 bit scale
+	constexpr long_type MAX = SampleTraits<SampleFormat::S16>::MAX;
+
+	const long_type chunkPeak = std::max<long_type>(Kernel::Peak(src), 1);
+	long_type peakVal = chunkPeak;
+	bool peakInChunk = true;
 
         pos = (pos + 1) % bufsz;
 	peaks[pos] = peakVal;
@@ -48,7 +121,7 @@ PcmNormalizer::ProcessS16(int16_t *gcc_restrict dest,
 		if (peaks[i] > peakVal)
 		{
 			peakVal = peaks[i];
-			peakPos = 0;
+			peakInChunk = false;
 		}
 	}
 
@@ -69,11 +142,16 @@ PcmNormalizer::ProcessS16(int16_t *gcc_restrict dest,
 
         //! Make sure the adjusted gain won't cause clipping
         std::size_t ramp = src.size();
-        if ((peakVal*newGain >> SHIFT) > Traits::MAX)
+        if ((peakVal*newGain >> SHIFT) > MAX)
         {
-                newGain = (Traits::MAX << SHIFT)/peakVal;
-                //! Truncate the ramp time
-                ramp = peakPos;
+                newGain = (MAX << SHIFT)/peakVal;
+
+                //! Truncate the ramp time at the (first) peak
+		ramp = peakInChunk
+			? std::size_t(std::find_if(src.begin(), src.end(), [chunkPeak](auto value){
+				return Kernel::Scale(value) >= chunkPeak;
+			}) - src.begin())
+			: 0;
         }
 
         //! Record the new gain
@@ -85,18 +163,39 @@ PcmNormalizer::ProcessS16(int16_t *gcc_restrict dest,
                 curGain = 1 << SHIFT;
 	const long_type delta = (newGain - curGain) / (long_type)ramp;
 
-	for (const auto sample : src.first(ramp)) {
-		//! Amplify the sample
-		*dest++ = PcmClamp<format>(sample * curGain >> SHIFT);
+	ramp = std::min(ramp, src.size());
 
-                //! Adjust the gain
-		curGain += delta;
-	}
+	//! Amplify the samples, adjusting the gain
+	Kernel::Apply(dest, src.first(ramp), curGain, delta);
 
-	curGain = newGain;
+	//! Amplify the rest with the new gain
+	Kernel::Apply(dest + ramp, src.subspan(ramp), newGain, 0);
+}
 
-	for (const auto sample : src.subspan(ramp)) {
-		//! Amplify the sample
-		*dest++ = PcmClamp<format>(sample * curGain >> SHIFT);
-	}
+void
+PcmNormalizer::ProcessS16(int16_t *dest,
+			  std::span<const int16_t> src) noexcept
+{
+	Process<SampleFormat::S16>(dest, src);
+}
+
+void
+PcmNormalizer::ProcessS24(int32_t *dest,
+			  std::span<const int32_t> src) noexcept
+{
+	Process<SampleFormat::S24_P32>(dest, src);
+}
+
+void
+PcmNormalizer::ProcessS32(int32_t *dest,
+			  std::span<const int32_t> src) noexcept
+{
+	Process<SampleFormat::S32>(dest, src);
+}
+
+void
+PcmNormalizer::ProcessFloat(float *dest,
+			    std::span<const float> src) noexcept
+{
+	Process<SampleFormat::FLOAT>(dest, src);
 }
@@ -4,12 +4,15 @@
 
 #pragma once
 
+#include "SampleFormat.hxx"
+#include "Traits.hxx"
+
 #include <cstddef>
 #include <cstdint>
 #include <span>
 
 class PcmNormalizer {
-	///! Target level (on a scale of 0-32767)
+	///! Target level (on a scale of 0-32767; peaks of other sample formats are scaled to 16 bit)
 	static constexpr int target = 16384;
 
 	//! The maximum amount to amplify by
@@ -41,6 +44,18 @@ public:
 
 	//! Process 16-bit signed data
 	void ProcessS16(int16_t *dest, std::span<const int16_t> src) noexcept;
-};
 
-//! TODO: Compressor_Process_int32, Compressor_Process_float, others as needed
+	//! Process 24-bit signed data (aligned at 32 bit boundaries)
+	void ProcessS24(int32_t *dest, std::span<const int32_t> src) noexcept;
+
+	//! Process 32-bit signed data
+	void ProcessS32(int32_t *dest, std::span<const int32_t> src) noexcept;
+
+	//! Process 32-bit floating point data
+	void ProcessFloat(float *dest, std::span<const float> src) noexcept;
+
+private:
+	template<SampleFormat F>
+	void Process(typename SampleTraits<F>::pointer dest,
+		     std::span<const typename SampleTraits<F>::value_type> src) noexcept;
+};
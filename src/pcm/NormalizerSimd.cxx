@@ -0,0 +1,569 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "NormalizerSimd.hxx"
+#include "Simd.hxx"
+#include "Clamp.hxx"
+#include "Traits.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr unsigned SHIFT = PCM_NORMALIZER_SHIFT;
+
+static inline int_least32_t
+ScalarPeak16(const int16_t *src, std::size_t n) noexcept
+{
+	int_least32_t peak = 0;
+	for (std::size_t i = 0; i < n; ++i)
+		peak = std::max(peak, std::abs(int_least32_t(src[i])));
+	return peak;
+}
+
+static inline int_least64_t
+ScalarPeak32(const int32_t *src, std::size_t n) noexcept
+{
+	int_least64_t peak = 0;
+	for (std::size_t i = 0; i < n; ++i)
+		peak = std::max(peak, std::abs(int_least64_t(src[i])));
+	return peak;
+}
+
+static inline float
+ScalarPeakFloat(const float *src, std::size_t n) noexcept
+{
+	float peak = 0;
+	for (std::size_t i = 0; i < n; ++i)
+		peak = std::max(peak, std::fabs(src[i]));
+	return peak;
+}
+
+static inline void
+ScalarRampGain16(int16_t *dest, const int16_t *src, std::size_t n,
+		 int_least32_t gain, int_least32_t delta) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i, gain += delta)
+		dest[i] = PcmClamp<SampleFormat::S16>(src[i] * gain >> SHIFT);
+}
+
+static inline void
+ScalarRampGain32(int32_t *dest, const int32_t *src, std::size_t n,
+		 int_least64_t gain, int_least64_t delta,
+		 int32_t min, int32_t max) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i, gain += delta)
+		dest[i] = std::clamp<int_least64_t>(src[i] * gain >> SHIFT,
+						    min, max);
+}
+
+static inline void
+ScalarRampGainFloat(float *dest, const float *src, std::size_t n,
+		    float gain, float delta) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = std::clamp(src[i] * (gain + float(i) * delta),
+				     -1.f, 1.f);
+}
+
+#ifdef PCM_SIMD_X86
+
+[[gnu::target("sse2")]]
+static inline __m128i
+Sse2Max32(__m128i a, __m128i b) noexcept
+{
+	const __m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+[[gnu::target("sse2")]]
+static inline __m128i
+Sse2Min32(__m128i a, __m128i b) noexcept
+{
+	const __m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+/**
+ * Combine the minimum and maximum values found by a vectorized loop
+ * with the scalar peak of the remaining samples.
+ */
+template<typename T, typename P, std::size_t N>
+static inline P
+CombinePeak(const T (&min)[N], const T (&max)[N], P tail) noexcept
+{
+	const T lo = *std::min_element(min, min + N);
+	const T hi = *std::max_element(max, max + N);
+	return std::max({tail, -P(lo), P(hi)});
+}
+
+[[gnu::target("sse2")]]
+static int_least32_t
+Sse2Peak16(const int16_t *src, std::size_t n) noexcept
+{
+	/* track the minimum and maximum instead of the absolute
+	   value, because -32768 has no positive counterpart */
+	__m128i min = _mm_setzero_si128(), max = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		min = _mm_min_epi16(min, x);
+		max = _mm_max_epi16(max, x);
+	}
+
+	int16_t min_a[8], max_a[8];
+	_mm_storeu_si128((__m128i *)min_a, min);
+	_mm_storeu_si128((__m128i *)max_a, max);
+	return CombinePeak(min_a, max_a, ScalarPeak16(src + i, n - i));
+}
+
+[[gnu::target("sse2")]]
+static int_least64_t
+Sse2Peak32(const int32_t *src, std::size_t n) noexcept
+{
+	__m128i min = _mm_setzero_si128(), max = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		min = Sse2Min32(min, x);
+		max = Sse2Max32(max, x);
+	}
+
+	int32_t min_a[4], max_a[4];
+	_mm_storeu_si128((__m128i *)min_a, min);
+	_mm_storeu_si128((__m128i *)max_a, max);
+	return CombinePeak(min_a, max_a, ScalarPeak32(src + i, n - i));
+}
+
+[[gnu::target("sse2")]]
+static float
+Sse2PeakFloat(const float *src, std::size_t n) noexcept
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 peak = _mm_setzero_ps();
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(src + i),
+						   abs_mask));
+
+	float a[4];
+	_mm_storeu_ps(a, peak);
+	return std::max({a[0], a[1], a[2], a[3],
+			 ScalarPeakFloat(src + i, n - i)});
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2RampGainFloat(float *dest, const float *src, std::size_t n,
+		  float gain, float delta) noexcept
+{
+	const __m128 min = _mm_set1_ps(-1), max = _mm_set1_ps(1);
+	const __m128 step = _mm_set1_ps(4 * delta);
+	__m128 g = _mm_add_ps(_mm_set1_ps(gain),
+			      _mm_mul_ps(_mm_set1_ps(delta),
+					 _mm_setr_ps(0, 1, 2, 3)));
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 y = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+		_mm_storeu_ps(dest + i, _mm_min_ps(_mm_max_ps(y, min), max));
+		g = _mm_add_ps(g, step);
+	}
+
+	ScalarRampGainFloat(dest + i, src + i, n - i,
+			    gain + float(i) * delta, delta);
+}
+
+/*
+ * SSE2 lacks a 32 bit multiplication and a 64 bit arithmetic shift;
+ * the integer gain kernels are only implemented with AVX2.
+ */
+
+[[gnu::target("avx2")]]
+static int_least32_t
+Avx2Peak16(const int16_t *src, std::size_t n) noexcept
+{
+	__m256i min = _mm256_setzero_si256(), max = _mm256_setzero_si256();
+
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		min = _mm256_min_epi16(min, x);
+		max = _mm256_max_epi16(max, x);
+	}
+
+	int16_t min_a[16], max_a[16];
+	_mm256_storeu_si256((__m256i *)min_a, min);
+	_mm256_storeu_si256((__m256i *)max_a, max);
+	return CombinePeak(min_a, max_a, ScalarPeak16(src + i, n - i));
+}
+
+[[gnu::target("avx2")]]
+static int_least64_t
+Avx2Peak32(const int32_t *src, std::size_t n) noexcept
+{
+	__m256i min = _mm256_setzero_si256(), max = _mm256_setzero_si256();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		min = _mm256_min_epi32(min, x);
+		max = _mm256_max_epi32(max, x);
+	}
+
+	int32_t min_a[8], max_a[8];
+	_mm256_storeu_si256((__m256i *)min_a, min);
+	_mm256_storeu_si256((__m256i *)max_a, max);
+	return CombinePeak(min_a, max_a, ScalarPeak32(src + i, n - i));
+}
+
+[[gnu::target("avx2")]]
+static float
+Avx2PeakFloat(const float *src, std::size_t n) noexcept
+{
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 peak = _mm256_setzero_ps();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(src + i),
+							 abs_mask));
+
+	float a[8];
+	_mm256_storeu_ps(a, peak);
+	return std::max({a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7],
+			 ScalarPeakFloat(src + i, n - i)});
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2RampGain16(int16_t *dest, const int16_t *src, std::size_t n,
+	       int_least32_t gain, int_least32_t delta) noexcept
+{
+	/* the product of a sample and the gain (at most
+	   maxgain<<SHIFT) fits in 32 bits */
+	const __m256i step = _mm256_set1_epi32(8 * delta);
+	__m256i g = _mm256_add_epi32(_mm256_set1_epi32(gain),
+				     _mm256_mullo_epi32(_mm256_set1_epi32(delta),
+							_mm256_setr_epi32(0, 1, 2, 3,
+									  4, 5, 6, 7)));
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		const __m256i y = _mm256_srai_epi32(_mm256_mullo_epi32(x, g),
+						    SHIFT);
+
+		/* pack with signed saturation, i.e. clamp to S16 */
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_packs_epi32(_mm256_castsi256_si128(y),
+						 _mm256_extracti128_si256(y, 1)));
+
+		g = _mm256_add_epi32(g, step);
+	}
+
+	ScalarRampGain16(dest + i, src + i, n - i,
+			 gain + int_least32_t(i) * delta, delta);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2RampGain32(int32_t *dest, const int32_t *src, std::size_t n,
+	       int_least64_t gain, int_least64_t delta,
+	       int32_t min, int32_t max) noexcept
+{
+	/* the product of a sample and the gain has at most 47 bits,
+	   which is exact in a double; multiplying with 2^-SHIFT and
+	   rounding down is the same as the arithmetic shift */
+	const __m256d scale = _mm256_set1_pd(1. / (1 << SHIFT));
+	const __m256d min_d = _mm256_set1_pd(min), max_d = _mm256_set1_pd(max);
+	const __m256d step = _mm256_set1_pd(4. * delta);
+	__m256d g = _mm256_setr_pd(gain, gain + delta,
+				   gain + 2 * delta, gain + 3 * delta);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d x =
+			_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(src + i)));
+		__m256d y = _mm256_floor_pd(_mm256_mul_pd(_mm256_mul_pd(x, g),
+							  scale));
+		y = _mm256_min_pd(_mm256_max_pd(y, min_d), max_d);
+
+		_mm_storeu_si128((__m128i *)(dest + i), _mm256_cvtpd_epi32(y));
+
+		g = _mm256_add_pd(g, step);
+	}
+
+	ScalarRampGain32(dest + i, src + i, n - i,
+			 gain + int_least64_t(i) * delta, delta, min, max);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2RampGainFloat(float *dest, const float *src, std::size_t n,
+		  float gain, float delta) noexcept
+{
+	const __m256 min = _mm256_set1_ps(-1), max = _mm256_set1_ps(1);
+	const __m256 step = _mm256_set1_ps(8 * delta);
+	__m256 g = _mm256_add_ps(_mm256_set1_ps(gain),
+				 _mm256_mul_ps(_mm256_set1_ps(delta),
+					       _mm256_setr_ps(0, 1, 2, 3,
+							      4, 5, 6, 7)));
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 y = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+		_mm256_storeu_ps(dest + i,
+				 _mm256_min_ps(_mm256_max_ps(y, min), max));
+		g = _mm256_add_ps(g, step);
+	}
+
+	ScalarRampGainFloat(dest + i, src + i, n - i,
+			    gain + float(i) * delta, delta);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+static int_least32_t
+NeonPeak16(const int16_t *src, std::size_t n) noexcept
+{
+	int16x8_t min = vdupq_n_s16(0), max = vdupq_n_s16(0);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(src + i);
+		min = vminq_s16(min, x);
+		max = vmaxq_s16(max, x);
+	}
+
+	int16_t min_a[8], max_a[8];
+	vst1q_s16(min_a, min);
+	vst1q_s16(max_a, max);
+	return CombinePeak(min_a, max_a, ScalarPeak16(src + i, n - i));
+}
+
+static int_least64_t
+NeonPeak32(const int32_t *src, std::size_t n) noexcept
+{
+	int32x4_t min = vdupq_n_s32(0), max = vdupq_n_s32(0);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4_t x = vld1q_s32(src + i);
+		min = vminq_s32(min, x);
+		max = vmaxq_s32(max, x);
+	}
+
+	int32_t min_a[4], max_a[4];
+	vst1q_s32(min_a, min);
+	vst1q_s32(max_a, max);
+	return CombinePeak(min_a, max_a, ScalarPeak32(src + i, n - i));
+}
+
+static float
+NeonPeakFloat(const float *src, std::size_t n) noexcept
+{
+	float32x4_t peak = vdupq_n_f32(0);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(src + i)));
+
+	float a[4];
+	vst1q_f32(a, peak);
+	return std::max({a[0], a[1], a[2], a[3],
+			 ScalarPeakFloat(src + i, n - i)});
+}
+
+static void
+NeonRampGain16(int16_t *dest, const int16_t *src, std::size_t n,
+	       int_least32_t gain, int_least32_t delta) noexcept
+{
+	static constexpr int32_t index_lo[4] = {0, 1, 2, 3};
+	static constexpr int32_t index_hi[4] = {4, 5, 6, 7};
+
+	const int32x4_t step = vdupq_n_s32(8 * delta);
+	int32x4_t g_lo = vmlaq_n_s32(vdupq_n_s32(gain), vld1q_s32(index_lo), delta);
+	int32x4_t g_hi = vmlaq_n_s32(vdupq_n_s32(gain), vld1q_s32(index_hi), delta);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(src + i);
+		const int32x4_t lo = vshrq_n_s32(vmulq_s32(vmovl_s16(vget_low_s16(x)), g_lo), SHIFT);
+		const int32x4_t hi = vshrq_n_s32(vmulq_s32(vmovl_s16(vget_high_s16(x)), g_hi), SHIFT);
+
+		/* narrow with signed saturation, i.e. clamp to S16 */
+		vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+
+		g_lo = vaddq_s32(g_lo, step);
+		g_hi = vaddq_s32(g_hi, step);
+	}
+
+	ScalarRampGain16(dest + i, src + i, n - i,
+			 gain + int_least32_t(i) * delta, delta);
+}
+
+static void
+NeonRampGain32(int32_t *dest, const int32_t *src, std::size_t n,
+	       int_least64_t gain, int_least64_t delta,
+	       int32_t min, int32_t max) noexcept
+{
+	/* the gain (at most maxgain<<SHIFT) fits in 32 bits, so
+	   vmull_s32() can calculate the 64 bit product */
+	static constexpr int32_t index[4] = {0, 1, 2, 3};
+
+	const int32x4_t step = vdupq_n_s32(4 * delta);
+	const int32x4_t min_v = vdupq_n_s32(min), max_v = vdupq_n_s32(max);
+	int32x4_t g = vmlaq_n_s32(vdupq_n_s32(gain), vld1q_s32(index), delta);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4_t x = vld1q_s32(src + i);
+		const int64x2_t lo = vshrq_n_s64(vmull_s32(vget_low_s32(x), vget_low_s32(g)), SHIFT);
+		const int64x2_t hi = vshrq_n_s64(vmull_s32(vget_high_s32(x), vget_high_s32(g)), SHIFT);
+
+		int32x4_t y = vcombine_s32(vqmovn_s64(lo), vqmovn_s64(hi));
+		y = vminq_s32(vmaxq_s32(y, min_v), max_v);
+		vst1q_s32(dest + i, y);
+
+		g = vaddq_s32(g, step);
+	}
+
+	ScalarRampGain32(dest + i, src + i, n - i,
+			 gain + int_least64_t(i) * delta, delta, min, max);
+}
+
+static void
+NeonRampGainFloat(float *dest, const float *src, std::size_t n,
+		  float gain, float delta) noexcept
+{
+	static constexpr float index[4] = {0, 1, 2, 3};
+
+	const float32x4_t min = vdupq_n_f32(-1), max = vdupq_n_f32(1);
+	const float32x4_t step = vdupq_n_f32(4 * delta);
+	float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(index), delta);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t y = vmulq_f32(vld1q_f32(src + i), g);
+		vst1q_f32(dest + i, vminq_f32(vmaxq_f32(y, min), max));
+		g = vaddq_f32(g, step);
+	}
+
+	ScalarRampGainFloat(dest + i, src + i, n - i,
+			    gain + float(i) * delta, delta);
+}
+
+#endif // PCM_SIMD_NEON
+
+namespace {
+
+struct NormalizerKernels {
+	int_least32_t (*peak16)(const int16_t *src, std::size_t n) noexcept;
+	int_least64_t (*peak32)(const int32_t *src, std::size_t n) noexcept;
+	float (*peak_float)(const float *src, std::size_t n) noexcept;
+
+	void (*gain16)(int16_t *dest, const int16_t *src, std::size_t n,
+		       int_least32_t gain, int_least32_t delta) noexcept;
+	void (*gain32)(int32_t *dest, const int32_t *src, std::size_t n,
+		       int_least64_t gain, int_least64_t delta,
+		       int32_t min, int32_t max) noexcept;
+	void (*gain_float)(float *dest, const float *src, std::size_t n,
+			   float gain, float delta) noexcept;
+};
+
+} // anonymous namespace
+
+static NormalizerKernels
+SelectKernels() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+		return {
+			Sse2Peak16, Sse2Peak32, Sse2PeakFloat,
+			ScalarRampGain16, ScalarRampGain32, Sse2RampGainFloat,
+		};
+
+	case PcmSimdLevel::AVX2:
+		return {
+			Avx2Peak16, Avx2Peak32, Avx2PeakFloat,
+			Avx2RampGain16, Avx2RampGain32, Avx2RampGainFloat,
+		};
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON:
+		return {
+			NeonPeak16, NeonPeak32, NeonPeakFloat,
+			NeonRampGain16, NeonRampGain32, NeonRampGainFloat,
+		};
+#endif
+
+	default:
+		break;
+	}
+
+	return {
+		ScalarPeak16, ScalarPeak32, ScalarPeakFloat,
+		ScalarRampGain16, ScalarRampGain32, ScalarRampGainFloat,
+	};
+}
+
+/* resolved before main(), because function-local statics are not
+   thread-safe with -fno-threadsafe-statics */
+static const NormalizerKernels kernels = SelectKernels();
+
+int_least32_t
+PcmPeakSimd16(const int16_t *src, std::size_t n) noexcept
+{
+	return kernels.peak16(src, n);
+}
+
+int_least64_t
+PcmPeakSimd32(const int32_t *src, std::size_t n) noexcept
+{
+	return kernels.peak32(src, n);
+}
+
+float
+PcmPeakSimdFloat(const float *src, std::size_t n) noexcept
+{
+	return kernels.peak_float(src, n);
+}
+
+void
+PcmRampGainSimd16(int16_t *dest, const int16_t *src, std::size_t n,
+		  int_least32_t gain, int_least32_t delta) noexcept
+{
+	kernels.gain16(dest, src, n, gain, delta);
+}
+
+void
+PcmRampGainSimd32(int32_t *dest, const int32_t *src, std::size_t n,
+		  int_least64_t gain, int_least64_t delta,
+		  int32_t min, int32_t max) noexcept
+{
+	kernels.gain32(dest, src, n, gain, delta, min, max);
+}
+
+void
+PcmRampGainSimdFloat(float *dest, const float *src, std::size_t n,
+		     float gain, float delta) noexcept
+{
+	kernels.gain_float(dest, src, n, gain, delta);
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_NORMALIZER_SIMD_HXX
+#define MPD_PCM_NORMALIZER_SIMD_HXX
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Vectorized kernels for #PcmNormalizer, selected at startup (see
+ * PcmGetSimdLevel()).  The integer kernels yield exactly the same
+ * results as the scalar code.
+ */
+
+/**
+ * Find the largest absolute sample value.
+ */
+[[gnu::pure]]
+int_least32_t
+PcmPeakSimd16(const int16_t *src, std::size_t n) noexcept;
+
+/**
+ * Find the largest absolute sample value (works with both S24_P32
+ * and S32).
+ */
+[[gnu::pure]]
+int_least64_t
+PcmPeakSimd32(const int32_t *src, std::size_t n) noexcept;
+
+[[gnu::pure]]
+float
+PcmPeakSimdFloat(const float *src, std::size_t n) noexcept;
+
+/*
+ * The following functions multiply each sample with a gain which
+ * starts at #gain and grows by #delta after each sample.  The
+ * integer gains are fixed-point numbers with #PCM_NORMALIZER_SHIFT
+ * fractional bits; the results are clamped.
+ */
+
+static constexpr unsigned PCM_NORMALIZER_SHIFT = 10;
+
+void
+PcmRampGainSimd16(int16_t *dest, const int16_t *src, std::size_t n,
+		  int_least32_t gain, int_least32_t delta) noexcept;
+
+/**
+ * Works with both S24_P32 and S32; the result is clamped to
+ * [#min..#max].
+ */
+void
+PcmRampGainSimd32(int32_t *dest, const int32_t *src, std::size_t n,
+		  int_least64_t gain, int_least64_t delta,
+		  int32_t min, int32_t max) noexcept;
+
+/**
+ * The result is clamped to [-1..1].
+ */
+void
+PcmRampGainSimdFloat(float *dest, const float *src, std::size_t n,
+		     float gain, float delta) noexcept;
+
+#endif
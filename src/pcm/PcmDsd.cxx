@@ -6,6 +6,16 @@
 
 #include <cassert>
 
+template<typename T>
+inline std::span<const T>
+PcmDsd::Decimate(unsigned channels, std::span<const T> src) noexcept
+{
+	for (unsigned i = 0; i < n_decimators; ++i)
+		src = decimators[i].Process(channels, src);
+
+	return src;
+}
+
 std::span<const float>
 PcmDsd::ToFloat(unsigned channels, std::span<const std::byte> src) noexcept
 {
@@ -18,7 +28,7 @@ PcmDsd::ToFloat(unsigned channels, std::span<const std::byte> src) noexcept
 	auto *dest = buffer.GetT<float>(num_samples);
 
 	dsd2pcm.Translate(channels, num_frames, src.data(), dest);
-	return { dest, num_samples };
+	return Decimate<float>(channels, { dest, num_samples });
 }
 
 std::span<const int32_t>
@@ -33,5 +43,5 @@ PcmDsd::ToS24(unsigned channels, std::span<const std::byte> src) noexcept
 	auto *dest = buffer.GetT<int32_t>(num_samples);
 
 	dsd2pcm.TranslateS24(channels, num_frames, src.data(), dest);
-	return { dest, num_samples };
+	return Decimate<int32_t>(channels, { dest, num_samples });
 }
@@ -5,7 +5,10 @@
 
 #include "Buffer.hxx"
 #include "Dsd2Pcm.hxx"
+#include "HalfBandDecimator.hxx"
 
+#include <array>
+#include <cassert>
 #include <cstdint>
 #include <span>
 
@@ -18,8 +21,33 @@ class PcmDsd {
 	MultiDsd2Pcm dsd2pcm;
 
 public:
+	/**
+	 * The maximum number of decimation stages; each one halves
+	 * the sample rate.
+	 */
+	static constexpr unsigned MAX_DECIMATION = 3;
+
+private:
+	std::array<PcmHalfBandDecimator, MAX_DECIMATION> decimators;
+
+	unsigned n_decimators = 0;
+
+public:
+	/**
+	 * Enable decimation after dsd2pcm: the output sample rate is
+	 * divided by 2 to the power of the given number.
+	 */
+	void SetDecimation(unsigned n) noexcept {
+		assert(n <= MAX_DECIMATION);
+
+		n_decimators = n;
+	}
+
 	void Reset() noexcept {
 		dsd2pcm.Reset();
+
+		for (auto &i : decimators)
+			i.Reset();
 	}
 
 	std::span<const float> ToFloat(unsigned channels,
@@ -27,4 +55,9 @@ public:
 
 	std::span<const int32_t> ToS24(unsigned channels,
 				       std::span<const std::byte> src) noexcept;
+
+private:
+	template<typename T>
+	std::span<const T> Decimate(unsigned channels,
+				    std::span<const T> src) noexcept;
 };
@@ -6,6 +6,7 @@
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
 #include "ShiftConvert.hxx"
+#include "ConvertSimd.hxx"
 #include "util/SpanCast.hxx"
 #include "util/TransformN.hxx"
 
@@ -27,6 +28,25 @@ struct PerSampleConvert : C {
 	}
 };
 
+/**
+ * Wrapper for a vectorized kernel from ConvertSimd.hxx which
+ * implements the per-sample conversion class C.
+ */
+template<typename C,
+	 void (*kernel)(typename C::DstTraits::pointer,
+			typename C::SrcTraits::const_pointer,
+			size_t) noexcept>
+struct SimdConvert {
+	using SrcTraits = typename C::SrcTraits;
+	using DstTraits = typename C::DstTraits;
+
+	void Convert(typename DstTraits::pointer out,
+		     typename SrcTraits::const_pointer in,
+		     size_t n) const noexcept {
+		kernel(out, in, n);
+	}
+};
+
 struct Convert8To16
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S16>> {};
@@ -64,6 +84,16 @@ struct PortableFloatToInteger
 template<SampleFormat F, class Traits=SampleTraits<F>>
 struct FloatToInteger : PortableFloatToInteger<F, Traits> {};
 
+template<>
+struct FloatToInteger<SampleFormat::S24_P32, SampleTraits<SampleFormat::S24_P32>>
+	: SimdConvert<FloatToIntegerSampleConvert<SampleFormat::S24_P32>,
+		      PcmConvertSimdFloatTo24> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: SimdConvert<FloatToIntegerSampleConvert<SampleFormat::S32>,
+		      PcmConvertSimdFloatTo32> {};
+
 /**
  * A template class that attempts to use the "optimized" algorithm for
  * large portions of the buffer, and calls the "portable" algorithm"
@@ -96,6 +126,13 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 	: GlueOptimizedConvert<NeonFloatTo16,
 			       PortableFloatToInteger<SampleFormat::S16>> {};
 
+#else
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: SimdConvert<FloatToIntegerSampleConvert<SampleFormat::S16>,
+		      PcmConvertSimdFloatTo16> {};
+
 #endif
 
 template<class C>
@@ -178,8 +215,9 @@ struct Convert8To24
 						  SampleFormat::S24_P32>> {};
 
 struct Convert16To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S24_P32>> {};
+	: SimdConvert<LeftShiftSampleConvert<SampleFormat::S16,
+					     SampleFormat::S24_P32>,
+		      PcmConvertSimd16To24> {};
 
 static std::span<const int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, std::span<const int8_t> src)
@@ -194,8 +232,9 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, std::span<const int16_t> src)
 }
 
 struct Convert32To24
-	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
-						   SampleFormat::S24_P32>> {};
+	: SimdConvert<RightShiftSampleConvert<SampleFormat::S32,
+					      SampleFormat::S24_P32>,
+		      PcmConvertSimd32To24> {};
 
 static std::span<const int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, std::span<const int32_t> src)
@@ -246,12 +285,14 @@ struct Convert8To32
 						  SampleFormat::S32>> {};
 
 struct Convert16To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S32>> {};
+	: SimdConvert<LeftShiftSampleConvert<SampleFormat::S16,
+					     SampleFormat::S32>,
+		      PcmConvertSimd16To32> {};
 
 struct Convert24To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
-						  SampleFormat::S32>> {};
+	: SimdConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
+					     SampleFormat::S32>,
+		      PcmConvertSimd24To32> {};
 
 static std::span<const int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, std::span<const int8_t> src)
@@ -313,13 +354,16 @@ struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
 struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
+	: SimdConvert<IntegerToFloatSampleConvert<SampleFormat::S16>,
+		      PcmConvertSimd16ToFloat> {};
 
 struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
+	: SimdConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>,
+		      PcmConvertSimd24ToFloat> {};
 
 struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
+	: SimdConvert<IntegerToFloatSampleConvert<SampleFormat::S32>,
+		      PcmConvertSimd32ToFloat> {};
 
 static std::span<const float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, std::span<const int8_t> src)
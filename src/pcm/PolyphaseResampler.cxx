@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PolyphaseResampler.hxx"
+#include "ResamplerSimd.hxx"
+#include "AudioFormat.hxx"
+#include "config/Block.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <numeric>
+
+#include <string.h>
+
+static constexpr Domain polyphase_domain("polyphase_resampler");
+
+/**
+ * The maximum number of phases in the filter table.  Common ratios
+ * (e.g. 44.1 kHz to 48 kHz = 160/147) fit; others use the nearest
+ * phase.
+ */
+static constexpr unsigned MAX_TABLE_PHASES = 1024;
+
+/**
+ * The maximum number of taps per phase (after scaling for
+ * downsampling).
+ */
+static constexpr unsigned MAX_TAPS = 512;
+
+struct PolyphasePreset {
+	const char *name;
+
+	/**
+	 * The number of filter taps per phase when upsampling; a
+	 * multiple of 8 for the vectorized kernels.
+	 */
+	unsigned taps;
+
+	/**
+	 * The Kaiser window parameter; larger values mean more stop
+	 * band attenuation, but a wider transition band.
+	 */
+	double beta;
+
+	/**
+	 * The cutoff frequency relative to the lower Nyquist
+	 * frequency.
+	 */
+	double rolloff;
+};
+
+static constexpr PolyphasePreset polyphase_presets[] = {
+	{ "low", 16, 5.0, 0.80 },
+	{ "medium", 32, 7.0, 0.90 },
+	{ "high", 64, 9.0, 0.95 },
+};
+
+static const PolyphasePreset *polyphase_preset = &polyphase_presets[1];
+
+bool
+pcm_resample_polyphase_global_init(const ConfigBlock &block)
+{
+	const char *quality = block.GetBlockValue("quality", "medium");
+	if (strcmp(quality, "quick") == 0)
+		return false;
+
+	for (const auto &i : polyphase_presets) {
+		if (strcmp(i.name, quality) == 0) {
+			polyphase_preset = &i;
+			return true;
+		}
+	}
+
+	throw FmtRuntimeError("unknown quality setting {:?} in line {}",
+			      quality, block.line);
+}
+
+/**
+ * The zeroth-order modified Bessel function of the first kind,
+ * needed for the Kaiser window.
+ */
+static double
+BesselI0(double x) noexcept
+{
+	double sum = 1, term = 1;
+	for (unsigned k = 1; k < 64; ++k) {
+		const double y = x / (2 * k);
+		term *= y * y;
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+/**
+ * Generate the filter table: a windowed-sinc low-pass filter at
+ * #table_phases times the input sample rate, split into phases.
+ */
+static std::vector<float>
+MakeTable(unsigned table_phases, unsigned taps,
+	  double cutoff, double beta) noexcept
+{
+	const std::size_t n = std::size_t(table_phases) * taps;
+	const double center = (n - 1) / 2.0;
+	const double i0_beta = BesselI0(beta);
+
+	std::vector<float> table(n);
+
+	for (unsigned p = 0; p < table_phases; ++p) {
+		float *const dest = &table[std::size_t(p) * taps];
+		double sum = 0;
+
+		for (unsigned k = 0; k < taps; ++k) {
+			const std::size_t i = std::size_t(k) * table_phases + p;
+
+			/* the time in input frames */
+			const double t = (i - center) / table_phases;
+			const double x = 2 * cutoff * t;
+			const double sinc = x == 0
+				? 1.
+				: std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+
+			const double r = 2.0 * i / (n - 1) - 1;
+			const double window =
+				BesselI0(beta * std::sqrt(std::max(0., 1 - r * r))) / i0_beta;
+
+			const double value = sinc * window;
+			dest[taps - 1 - k] = value;
+			sum += value;
+		}
+
+		/* normalize each phase to unity gain */
+		const float scale = 1 / sum;
+		for (unsigned k = 0; k < taps; ++k)
+			dest[k] *= scale;
+	}
+
+	return table;
+}
+
+AudioFormat
+PolyphasePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	const auto &preset = *polyphase_preset;
+
+	const unsigned g = std::gcd(af.sample_rate, new_sample_rate);
+	n_phases = new_sample_rate / g;
+	step = af.sample_rate / g;
+	table_phases = std::min(n_phases, MAX_TABLE_PHASES);
+
+	/* when downsampling, the filter needs to be longer by the
+	   same factor to keep the transition band equally steep */
+	const unsigned factor = (step + n_phases - 1) / n_phases;
+	taps = std::min(preset.taps * factor, MAX_TAPS);
+
+	const double cutoff = 0.5 * preset.rolloff *
+		std::min(1., double(n_phases) / step);
+
+	table = MakeTable(table_phases, taps, cutoff, preset.beta);
+
+	channels = af.channels;
+	input.resize(channels);
+	Reset();
+
+	FmtDebug(polyphase_domain,
+		 "quality={:?} phases={}/{} taps={}",
+		 preset.name, n_phases, step, taps);
+
+	/* this resampler works with floating point samples */
+	af.format = SampleFormat::FLOAT;
+
+	AudioFormat result = af;
+	result.sample_rate = new_sample_rate;
+	return result;
+}
+
+void
+PolyphasePcmResampler::Close() noexcept
+{
+	table = {};
+	input = {};
+}
+
+void
+PolyphasePcmResampler::Reset() noexcept
+{
+	for (auto &i : input)
+		i.assign(taps - 1, 0.f);
+
+	position = taps - 1;
+	phase = 0;
+	flushed = false;
+}
+
+inline std::span<const std::byte>
+PolyphasePcmResampler::Process() noexcept
+{
+	const std::size_t total = input.front().size();
+
+	/* worst case: one more frame because of rounding */
+	const std::size_t max_frames = total > position
+		? ((total - position) * n_phases) / step + 1
+		: 0;
+	float *const dest = (float *)buffer.Get(max_frames * channels * sizeof(float));
+
+	std::size_t n_frames = 0;
+	while (position < total) {
+		assert(n_frames < max_frames);
+
+		const unsigned table_phase = table_phases == n_phases
+			? phase
+			: unsigned(uint_least64_t(phase) * table_phases / n_phases);
+		const float *h = &table[std::size_t(table_phase) * taps];
+		const std::size_t first = position + 1 - taps;
+
+		for (unsigned c = 0; c < channels; ++c)
+			dest[n_frames * channels + c] =
+				PcmDotProductSimd(&input[c][first], h, taps);
+
+		++n_frames;
+
+		phase += step;
+		position += phase / n_phases;
+		phase %= n_phases;
+	}
+
+	/* keep the last taps-1 frames needed by the next output
+	   frame */
+	const std::size_t consumed = std::min(position + 1 - taps, total);
+	for (auto &i : input)
+		i.erase(i.begin(), std::next(i.begin(), consumed));
+	position -= consumed;
+
+	return {(const std::byte *)dest, n_frames * channels * sizeof(float)};
+}
+
+std::span<const std::byte>
+PolyphasePcmResampler::Resample(std::span<const std::byte> src)
+{
+	const std::size_t frame_size = channels * sizeof(float);
+	assert(src.size() % frame_size == 0);
+
+	const std::size_t n_frames = src.size() / frame_size;
+	const auto *s = (const float *)src.data();
+
+	/* deinterleave into the planar input buffers */
+	for (unsigned c = 0; c < channels; ++c) {
+		auto &i = input[c];
+		const std::size_t old_size = i.size();
+		i.resize(old_size + n_frames);
+
+		for (std::size_t f = 0; f < n_frames; ++f)
+			i[old_size + f] = s[f * channels + c];
+	}
+
+	return Process();
+}
+
+std::span<const std::byte>
+PolyphasePcmResampler::Flush()
+{
+	if (flushed)
+		return {};
+
+	flushed = true;
+
+	/* push the delayed frames out of the filter with silence */
+	for (auto &i : input)
+		i.resize(i.size() + taps / 2, 0.f);
+
+	return Process();
+}
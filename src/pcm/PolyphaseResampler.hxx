@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_POLYPHASE_RESAMPLER_HXX
+#define MPD_PCM_POLYPHASE_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "Buffer.hxx"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+struct ConfigBlock;
+
+/**
+ * A windowed-sinc polyphase resampler built into MPD.  It needs no
+ * external library and gives decent quality at low CPU usage.
+ *
+ * The ratio between the two sample rates is reduced to
+ * #n_phases/#step; each output frame advances the filter by #step
+ * phases, and the input by one frame every #n_phases phases.
+ */
+class PolyphasePcmResampler final : public PcmResampler {
+	unsigned channels;
+
+	unsigned n_phases, step;
+
+	/**
+	 * The number of phases stored in #table.  This is equal to
+	 * #n_phases unless the ratio is so odd that the table would
+	 * become too large; then the nearest phase is used.
+	 */
+	unsigned table_phases;
+
+	/**
+	 * The number of filter coefficients per phase.
+	 */
+	unsigned taps;
+
+	/**
+	 * The filter coefficients; #taps for each phase, in reverse
+	 * order, so they can be multiplied with the input samples
+	 * in ascending order.
+	 */
+	std::vector<float> table;
+
+	/**
+	 * Planar input buffers, one for each channel.  They begin
+	 * with the last #taps-1 frames of the previous call.
+	 */
+	std::vector<std::vector<float>> input;
+
+	/**
+	 * The index of the newest input frame used by the next output
+	 * frame.
+	 */
+	std::size_t position;
+
+	/**
+	 * The phase of the next output frame.
+	 */
+	unsigned phase;
+
+	bool flushed;
+
+	PcmBuffer buffer;
+
+public:
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
+	void Close() noexcept override;
+	void Reset() noexcept override;
+	std::span<const std::byte> Resample(std::span<const std::byte> src) override;
+	std::span<const std::byte> Flush() override;
+
+private:
+	std::span<const std::byte> Process() noexcept;
+};
+
+/**
+ * Parse the settings of the "internal" resampler.
+ *
+ * Throws on error.
+ *
+ * @return false if the naive #FallbackPcmResampler shall be used
+ * (quality "quick")
+ */
+bool
+pcm_resample_polyphase_global_init(const ConfigBlock &block);
+
+#endif
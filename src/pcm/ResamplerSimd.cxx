@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ResamplerSimd.hxx"
+#include "Simd.hxx"
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static inline float
+ScalarDotProduct(const float *a, const float *b, std::size_t n) noexcept
+{
+	float sum = 0;
+	for (std::size_t i = 0; i < n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+#ifdef PCM_SIMD_X86
+
+[[gnu::target("sse2")]]
+static float
+Sse2DotProduct(const float *a, const float *b, std::size_t n) noexcept
+{
+	/* two accumulators to hide the latency of the additions */
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i),
+						   _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+						   _mm_loadu_ps(b + i + 4)));
+	}
+
+	float tmp[4];
+	_mm_storeu_ps(tmp, _mm_add_ps(sum0, sum1));
+
+	return tmp[0] + tmp[1] + tmp[2] + tmp[3] +
+		ScalarDotProduct(a + i, b + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+static float
+Avx2DotProduct(const float *a, const float *b, std::size_t n) noexcept
+{
+	__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+							 _mm256_loadu_ps(b + i)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+							 _mm256_loadu_ps(b + i + 8)));
+	}
+
+	const __m256 sum = _mm256_add_ps(sum0, sum1);
+	__m128 x = _mm_add_ps(_mm256_castps256_ps128(sum),
+			      _mm256_extractf128_ps(sum, 1));
+
+	float tmp[4];
+	_mm_storeu_ps(tmp, x);
+
+	return tmp[0] + tmp[1] + tmp[2] + tmp[3] +
+		ScalarDotProduct(a + i, b + i, n - i);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+static float
+NeonDotProduct(const float *a, const float *b, std::size_t n) noexcept
+{
+	float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+		sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4),
+				 vld1q_f32(b + i + 4));
+	}
+
+	const float32x4_t sum = vaddq_f32(sum0, sum1);
+	return vgetq_lane_f32(sum, 0) + vgetq_lane_f32(sum, 1) +
+		vgetq_lane_f32(sum, 2) + vgetq_lane_f32(sum, 3) +
+		ScalarDotProduct(a + i, b + i, n - i);
+}
+
+#endif // PCM_SIMD_NEON
+
+using DotProductFunction = float (*)(const float *a, const float *b,
+				     std::size_t n) noexcept;
+
+static DotProductFunction
+SelectDotProduct() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+		return Sse2DotProduct;
+
+	case PcmSimdLevel::AVX2:
+		return Avx2DotProduct;
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON:
+		return NeonDotProduct;
+#endif
+
+	default:
+		break;
+	}
+
+	return ScalarDotProduct;
+}
+
+/* selected during static initialization; a function-local static
+   would not be thread-safe with -fno-threadsafe-statics */
+static const DotProductFunction dot_product = SelectDotProduct();
+
+float
+PcmDotProductSimd(const float *a, const float *b, std::size_t n) noexcept
+{
+	return dot_product(a, b, n);
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_RESAMPLER_SIMD_HXX
+#define MPD_PCM_RESAMPLER_SIMD_HXX
+
+#include <cstddef>
+
+/*
+ * Vectorized kernels for the #PolyphasePcmResampler, selected at
+ * startup (see PcmGetSimdLevel()).
+ */
+
+/**
+ * Calculate the dot product of two float vectors, i.e. apply one
+ * phase of the FIR filter to #n input samples.
+ */
+[[gnu::pure]]
+float
+PcmDotProductSimd(const float *a, const float *b, std::size_t n) noexcept;
+
+#endif
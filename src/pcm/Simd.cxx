@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Simd.hxx"
+#include "util/StringAPI.hxx"
+
+#include <atomic>
+
+#include <stdlib.h>
+
+static PcmSimdLevel
+DetectCpuSimdLevel() noexcept
+{
+#ifdef PCM_SIMD_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return PcmSimdLevel::AVX2;
+
+	if (__builtin_cpu_supports("sse2"))
+		return PcmSimdLevel::SSE2;
+#elif defined(PCM_SIMD_NEON)
+	return PcmSimdLevel::NEON;
+#endif
+
+	return PcmSimdLevel::SCALAR;
+}
+
+/**
+ * Can code for the #requested level run on a CPU which supports
+ * #supported?
+ */
+static constexpr bool
+IsCompatible(PcmSimdLevel requested, PcmSimdLevel supported) noexcept
+{
+	return requested == PcmSimdLevel::SCALAR ||
+		requested == supported ||
+		(requested == PcmSimdLevel::SSE2 &&
+		 supported == PcmSimdLevel::AVX2);
+}
+
+static PcmSimdLevel
+DetectSimdLevel() noexcept
+{
+	const auto supported = DetectCpuSimdLevel();
+
+	/* the environment variable MPD_PCM_SIMD selects a lower
+	   level, e.g. for benchmarks and for testing the fallback
+	   kernels */
+	if (const char *value = getenv("MPD_PCM_SIMD")) {
+		static constexpr PcmSimdLevel levels[] = {
+			PcmSimdLevel::SCALAR,
+			PcmSimdLevel::SSE2,
+			PcmSimdLevel::AVX2,
+			PcmSimdLevel::NEON,
+		};
+
+		for (const auto i : levels)
+			if (StringIsEqual(value, ToString(i)) &&
+			    IsCompatible(i, supported))
+				return i;
+	}
+
+	return supported;
+}
+
+/**
+ * The cached result of DetectSimdLevel(), or -1 if it has not been
+ * called yet.  This is an atomic instead of a function-local static,
+ * because MPD is built with -fno-threadsafe-statics.  Detection
+ * always returns the same value, so it does not matter if two threads
+ * run it concurrently.
+ */
+static std::atomic_int cached_simd_level{-1};
+
+PcmSimdLevel
+PcmGetSimdLevel() noexcept
+{
+	int level = cached_simd_level.load(std::memory_order_relaxed);
+	if (level < 0) {
+		level = int(DetectSimdLevel());
+		cached_simd_level.store(level, std::memory_order_relaxed);
+	}
+
+	return PcmSimdLevel(level);
+}
+
+const char *
+ToString(PcmSimdLevel level) noexcept
+{
+	switch (level) {
+	case PcmSimdLevel::SCALAR:
+		return "scalar";
+
+	case PcmSimdLevel::SSE2:
+		return "sse2";
+
+	case PcmSimdLevel::AVX2:
+		return "avx2";
+
+	case PcmSimdLevel::NEON:
+		return "neon";
+	}
+
+	return "?";
+}
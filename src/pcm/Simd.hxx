@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_SIMD_HXX
+#define MPD_PCM_SIMD_HXX
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PCM_SIMD_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PCM_SIMD_NEON
+#endif
+
+/**
+ * The instruction set extension used by the vectorized PCM kernels.
+ */
+enum class PcmSimdLevel : uint8_t {
+	SCALAR,
+	SSE2,
+	AVX2,
+	NEON,
+};
+
+/**
+ * Determine the best #PcmSimdLevel supported by this CPU.  On x86,
+ * this is a runtime check; NEON is enabled at compile time.
+ *
+ * The environment variable MPD_PCM_SIMD may name a lower level
+ * (e.g. "scalar") to be used instead.
+ *
+ * Each family of vectorized kernels (the *Simd.hxx headers) calls
+ * this once during static initialization, i.e. at startup, and
+ * uses the implementation for the returned level from then on.
+ * Changing MPD_PCM_SIMD later has no effect.
+ */
+[[gnu::pure]]
+PcmSimdLevel
+PcmGetSimdLevel() noexcept;
+
+[[gnu::const]]
+const char *
+ToString(PcmSimdLevel level) noexcept;
+
+#endif
@@ -128,6 +128,21 @@ SoxrParseStopbandBegin(const char *svalue) {
 	return value / 100.0;
 }
 
+/**
+ * Parse a base-2 logarithm of a DFT size (see struct
+ * soxr_runtime_spec).
+ */
+static unsigned
+SoxrParseDftSize(const char *name, unsigned value,
+		 unsigned min, unsigned max)
+{
+	if (value < min || value > max)
+		throw FmtInvalidArgument("soxr converter invalid {}: {} ({}-{})",
+					 name, value, min, max);
+
+	return value;
+}
+
 static double
 SoxrParseAttenuation(const char *svalue) {
 	char *endptr;
@@ -182,6 +197,22 @@ pcm_resample_soxr_global_init(const ConfigBlock &block)
 
 	const unsigned n_threads = block.GetBlockValue("threads", 1);
 	soxr_runtime = soxr_runtime_spec(n_threads);
+
+	soxr_runtime.log2_min_dft_size =
+		SoxrParseDftSize("min_dft_size",
+				 block.GetBlockValue("min_dft_size",
+						     soxr_runtime.log2_min_dft_size),
+				 8, 15);
+	soxr_runtime.log2_large_dft_size =
+		SoxrParseDftSize("large_dft_size",
+				 block.GetBlockValue("large_dft_size",
+						     soxr_runtime.log2_large_dft_size),
+				 8, 20);
+
+	FmtDebug(soxr_domain,
+		 "soxr threads={}, min_dft_size={}, large_dft_size={}",
+		 n_threads, soxr_runtime.log2_min_dft_size,
+		 soxr_runtime.log2_large_dft_size);
 }
 
 AudioFormat
@@ -2,132 +2,150 @@
 // Copyright The Music Player Daemon Project
 
 #include "Volume.hxx"
+#include "VolumeSimd.hxx"
 #include "Silence.hxx"
 #include "Traits.hxx"
+#include "Clamp.hxx"
+#include "FloatConvert.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/TransformN.hxx"
 
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <type_traits>
 
 #include <string.h>
 
 /**
- * Apply software volume, converting to a different sample type.
+ * Apply the volume to one sample and convert it to a different
+ * integer format.  The result is dithered if bits are discarded.
  */
-template<SampleFormat SF, SampleFormat DF,
-	 class STraits=SampleTraits<SF>,
-	 class DTraits=SampleTraits<DF>>
-static constexpr typename DTraits::value_type
-PcmVolumeConvert(typename STraits::value_type _sample, int volume) noexcept
+template<SampleFormat IN, SampleFormat OUT,
+	 class ST=SampleTraits<IN>, class DT=SampleTraits<OUT>>
+static inline typename DT::value_type
+pcm_volume_sample(PcmDither &dither,
+		  typename ST::value_type _sample,
+		  int volume) noexcept
 {
-	typename STraits::long_type sample(_sample);
-	sample *= volume;
-
-	static_assert(DTraits::BITS > STraits::BITS,
-		      "Destination sample must be larger than source sample");
+	constexpr unsigned SBITS = ST::BITS + PCM_VOLUME_BITS;
 
-	/* after multiplying with the volume value, the "sample"
-	   variable contains this number of precision bits: source
-	   bits plus the volume bits */
-	constexpr unsigned BITS = STraits::BITS + PCM_VOLUME_BITS;
+	using L = std::conditional_t<std::max(SBITS, DT::BITS) < 32,
+				     int_least32_t, int_least64_t>;
 
-	/* .. and now we need to scale to the requested destination
-	   bits */
+	const L sample = L(_sample) * volume;
 
-	typename DTraits::value_type result;
-	if (BITS > DTraits::BITS)
-		result = sample >> (BITS - DTraits::BITS);
-	else if (BITS < DTraits::BITS)
-		result = sample << (DTraits::BITS - BITS);
+	if constexpr (SBITS > DT::BITS)
+		return dither.DitherShift<L, SBITS, DT::BITS>(sample);
 	else
-		result = sample;
-
-	return result;
-}
-
-template<SampleFormat F, class Traits=SampleTraits<F>>
-static inline typename Traits::value_type
-pcm_volume_sample(PcmDither &dither,
-		  typename Traits::value_type _sample,
-		  int volume) noexcept
-{
-	typename Traits::long_type sample(_sample);
-
-	return dither.DitherShift<typename Traits::long_type,
-				  Traits::BITS + PCM_VOLUME_BITS,
-				  Traits::BITS>(sample * volume);
+		return PcmClamp<OUT, DT>(sample << (DT::BITS - SBITS));
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
+template<SampleFormat IN, SampleFormat OUT,
+	 class ST=SampleTraits<IN>, class DT=SampleTraits<OUT>>
 static void
-pcm_volume_change(PcmDither &dither,
-		  typename Traits::pointer dest,
-		  typename Traits::const_pointer src,
-		  size_t n,
-		  int volume) noexcept
+pcm_volume_kernel(PcmDither &dither, void *_dest, const void *_src,
+		  size_t n, unsigned volume) noexcept
 {
-	transform_n(src, n, dest,
-		    [&dither, volume](auto x){
-			    return pcm_volume_sample<F, Traits>(dither, x,
-								volume);
-		    });
+	const auto src = (typename ST::const_pointer)_src;
+	const auto dest = (typename DT::pointer)_dest;
+
+	if constexpr (IN == SampleFormat::FLOAT && OUT == SampleFormat::FLOAT) {
+		PcmVolumeSimdFloat(dest, src, n, pcm_volume_to_float(volume));
+	} else if constexpr (IN == SampleFormat::S16 &&
+			     OUT == SampleFormat::S24_P32) {
+		PcmVolumeSimd16to24(dest, src, n, volume);
+	} else if constexpr (OUT == SampleFormat::FLOAT) {
+		const float factor = pcm_volume_to_float(volume) *
+			IntegerToFloatSampleConvert<IN>::factor;
+		transform_n(src, n, dest, [factor](auto x){
+			return float(x) * factor;
+		});
+	} else if constexpr (IN == SampleFormat::FLOAT) {
+		const float factor = pcm_volume_to_float(volume);
+		transform_n(src, n, dest, [factor](auto x){
+			return FloatToIntegerSampleConvert<OUT>::Convert(x * factor);
+		});
+	} else {
+		transform_n(src, n, dest, [&dither, volume](auto x){
+			return pcm_volume_sample<IN, OUT>(dither, x, volume);
+		});
+	}
 }
 
-static void
-pcm_volume_change_8(PcmDither &dither,
-		    int8_t *dest, const int8_t *src, size_t n,
-		    int volume) noexcept
-{
-	pcm_volume_change<SampleFormat::S8>(dither, dest, src, n, volume);
-}
+using PcmVolumeKernel = void (*)(PcmDither &dither, void *dest,
+				 const void *src,
+				 size_t n, unsigned volume) noexcept;
 
-static void
-pcm_volume_change_16(PcmDither &dither,
-		     int16_t *dest, const int16_t *src, size_t n,
-		     int volume) noexcept
+/**
+ * Find the kernel for the given input format (compile-time) and
+ * output format (run-time).
+ *
+ * @return nullptr if this combination is not implemented
+ */
+template<SampleFormat IN>
+static constexpr PcmVolumeKernel
+FindKernel(SampleFormat out) noexcept
 {
-	pcm_volume_change<SampleFormat::S16>(dither, dest, src, n, volume);
-}
+	if constexpr (IN == SampleFormat::S8) {
+		/* 8 bit samples are only supported without
+		   conversion, because dithering a 32 bit sample
+		   down to 8 bits would overflow PcmDither */
+		return out == IN
+			? pcm_volume_kernel<IN, SampleFormat::S8>
+			: nullptr;
+	} else {
+		switch (out) {
+		case SampleFormat::S16:
+			return pcm_volume_kernel<IN, SampleFormat::S16>;
+
+		case SampleFormat::S24_P32:
+			return pcm_volume_kernel<IN, SampleFormat::S24_P32>;
+
+		case SampleFormat::S32:
+			return pcm_volume_kernel<IN, SampleFormat::S32>;
+
+		case SampleFormat::FLOAT:
+			return pcm_volume_kernel<IN, SampleFormat::FLOAT>;
+
+		case SampleFormat::UNDEFINED:
+		case SampleFormat::S8:
+		case SampleFormat::DSD:
+			break;
+		}
 
-static void
-PcmVolumeChange16to32(int32_t *dest, const int16_t *src, size_t n,
-		      int volume) noexcept
-{
-	transform_n(src, n, dest,
-		    [volume](auto x){
-			    return PcmVolumeConvert<SampleFormat::S16,
-						    SampleFormat::S24_P32>(x,
-									   volume);
-		    });
+		return nullptr;
+	}
 }
 
-static void
-pcm_volume_change_24(PcmDither &dither,
-		     int32_t *dest, const int32_t *src, size_t n,
-		     int volume) noexcept
+static constexpr PcmVolumeKernel
+FindKernel(SampleFormat in, SampleFormat out) noexcept
 {
-	pcm_volume_change<SampleFormat::S24_P32>(dither, dest, src, n,
-						 volume);
-}
+	switch (in) {
+	case SampleFormat::S8:
+		return FindKernel<SampleFormat::S8>(out);
 
-static void
-pcm_volume_change_32(PcmDither &dither,
-		     int32_t *dest, const int32_t *src, size_t n,
-		     int volume) noexcept
-{
-	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume);
-}
+	case SampleFormat::S16:
+		return FindKernel<SampleFormat::S16>(out);
 
-static void
-pcm_volume_change_float(float *dest, const float *src, size_t n,
-			float volume) noexcept
-{
-	transform_n(src, n, dest,
-		    [volume](float x){ return x * volume; });
+	case SampleFormat::S24_P32:
+		return FindKernel<SampleFormat::S24_P32>(out);
+
+	case SampleFormat::S32:
+		return FindKernel<SampleFormat::S32>(out);
+
+	case SampleFormat::FLOAT:
+		return FindKernel<SampleFormat::FLOAT>(out);
+
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		break;
+	}
+
+	return nullptr;
 }
 
 SampleFormat
@@ -135,27 +153,22 @@ PcmVolume::Open(SampleFormat _format, bool allow_convert)
 {
 	assert(format == SampleFormat::UNDEFINED);
 
-	convert = false;
-
 	switch (_format) {
 	case SampleFormat::UNDEFINED:
 		throw FmtRuntimeError("Software volume for {} is not implemented",
 				      _format);
 
-	case SampleFormat::S8:
-		break;
-
 	case SampleFormat::S16:
 		if (allow_convert) {
 			/* convert S16 to S24 to avoid discarding too
 			   many bits of precision in this stage */
-			format = _format;
-			convert = true;
-			return SampleFormat::S24_P32;
+			Open(_format, SampleFormat::S24_P32);
+			return out_format;
 		}
 
 		break;
 
+	case SampleFormat::S8:
 	case SampleFormat::S24_P32:
 	case SampleFormat::S32:
 	case SampleFormat::FLOAT:
@@ -163,10 +176,29 @@ PcmVolume::Open(SampleFormat _format, bool allow_convert)
 
 	case SampleFormat::DSD:
 		// TODO: implement this; currently, it's a no-op
-		break;
+		format = out_format = _format;
+		convert = false;
+		kernel = nullptr;
+		return _format;
 	}
 
-	return format = _format;
+	Open(_format, _format);
+	return out_format;
+}
+
+bool
+PcmVolume::Open(SampleFormat _format, SampleFormat _out_format) noexcept
+{
+	assert(format == SampleFormat::UNDEFINED);
+
+	kernel = FindKernel(_format, _out_format);
+	if (kernel == nullptr)
+		return false;
+
+	format = _format;
+	out_format = _out_format;
+	convert = out_format != format;
+	return true;
 }
 
 std::span<const std::byte>
@@ -175,73 +207,22 @@ PcmVolume::Apply(std::span<const std::byte> src) noexcept
 	if (volume == PCM_VOLUME_1 && !convert)
 		return src;
 
-	size_t dest_size = src.size();
-	if (convert) {
-		assert(format == SampleFormat::S16);
-
-		/* converting to S24_P32 */
-		dest_size *= 2;
-	}
+	const size_t n = src.size() / sample_format_size(format);
+	const size_t dest_size = n * sample_format_size(out_format);
 
 	void *data = buffer.Get(dest_size);
 
 	if (volume == 0) {
 		/* optimized special case: 0% volume = memset(0) */
 		PcmSilence(std::span{(std::byte *)data, dest_size},
-			   format);
+			   out_format);
 		return { (const std::byte *)data, dest_size };
 	}
 
-	switch (format) {
-	case SampleFormat::UNDEFINED:
-		assert(false);
-		gcc_unreachable();
-
-	case SampleFormat::S8:
-		pcm_volume_change_8(dither, (int8_t *)data,
-				    (const int8_t *)src.data(),
-				    src.size() / sizeof(int8_t),
-				    volume);
-		break;
-
-	case SampleFormat::S16:
-		if (convert)
-			PcmVolumeChange16to32((int32_t *)data,
-					      (const int16_t *)src.data(),
-					      src.size() / sizeof(int16_t),
-					      volume);
-		else
-			pcm_volume_change_16(dither, (int16_t *)data,
-					     (const int16_t *)src.data(),
-					     src.size() / sizeof(int16_t),
-					     volume);
-		break;
-
-	case SampleFormat::S24_P32:
-		pcm_volume_change_24(dither, (int32_t *)data,
-				     (const int32_t *)src.data(),
-				     src.size() / sizeof(int32_t),
-				     volume);
-		break;
-
-	case SampleFormat::S32:
-		pcm_volume_change_32(dither, (int32_t *)data,
-				     (const int32_t *)src.data(),
-				     src.size() / sizeof(int32_t),
-				     volume);
-		break;
-
-	case SampleFormat::FLOAT:
-		pcm_volume_change_float((float *)data,
-					(const float *)src.data(),
-					src.size() / sizeof(float),
-					pcm_volume_to_float(volume));
-		break;
-
-	case SampleFormat::DSD:
-		// TODO: implement this; currently, it's a no-op
+	if (kernel == nullptr)
+		/* DSD: not implemented; currently, it's a no-op */
 		return src;
-	}
 
+	kernel(dither, data, src.data(), n, volume);
 	return { (const std::byte *)data, dest_size };
 }
@@ -46,14 +46,35 @@ pcm_volume_to_float(int volume) noexcept
  * Software volume implementation.
  */
 class PcmVolume {
+	/**
+	 * A kernel which applies the volume to #n samples and
+	 * converts them from the input to the output format in the
+	 * same pass.
+	 */
+	using Kernel = void (*)(PcmDither &dither, void *dest, const void *src,
+				std::size_t n, unsigned volume) noexcept;
+
 	SampleFormat format;
 
+	/**
+	 * The output sample format.  This is set by Open().
+	 */
+	SampleFormat out_format;
+
 	/**
 	 * Are we currently converting to a different #SampleFormat?
 	 * This is set by Open().
 	 */
 	bool convert;
 
+	/**
+	 * The kernel for the (#format, #out_format) pair; it is
+	 * chosen by Open(), so Apply() does not need to dispatch on
+	 * the sample format for each chunk.  May be nullptr if the
+	 * format is not implemented (DSD); Apply() is a no-op then.
+	 */
+	Kernel kernel;
+
 	unsigned volume;
 
 	PcmBuffer buffer;
@@ -92,6 +113,16 @@ public:
 	 */
 	SampleFormat Open(SampleFormat format, bool allow_convert);
 
+	/**
+	 * Like Open(), but convert to the given output
+	 * #SampleFormat in the same pass, instead of leaving that to
+	 * a #PcmConvert instance afterwards.
+	 *
+	 * @return false if this combination is not implemented; the
+	 * object remains closed then
+	 */
+	bool Open(SampleFormat format, SampleFormat out_format) noexcept;
+
 	/**
 	 * Closes the object.  After that, you may call Open() again.
 	 */
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "VolumeSimd.hxx"
+#include "Volume.hxx"
+#include "Simd.hxx"
+
+#ifdef PCM_SIMD_X86
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * After multiplying a 16 bit sample with the volume, this many bits
+ * need to be discarded to get a 24 bit sample.
+ */
+static constexpr unsigned SHIFT_16_TO_24 = 16 + PCM_VOLUME_BITS - 24;
+
+static inline void
+ScalarFloat(float *dest, const float *src, std::size_t n,
+	    float volume) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = src[i] * volume;
+}
+
+static inline void
+Scalar16to24(int32_t *dest, const int16_t *src, std::size_t n,
+	     unsigned volume) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = (int32_t(src[i]) * int32_t(volume)) >> SHIFT_16_TO_24;
+}
+
+#ifdef PCM_SIMD_X86
+
+[[gnu::target("sse2")]]
+static void
+Sse2Float(float *dest, const float *src, std::size_t n,
+	  float volume) noexcept
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128 a = _mm_loadu_ps(src + i);
+		__m128 b = _mm_loadu_ps(src + i + 4);
+		_mm_storeu_ps(dest + i, _mm_mul_ps(a, v));
+		_mm_storeu_ps(dest + i + 4, _mm_mul_ps(b, v));
+	}
+
+	ScalarFloat(dest + i, src + i, n - i, volume);
+}
+
+[[gnu::target("sse2")]]
+static void
+Sse2_16to24(int32_t *dest, const int16_t *src, std::size_t n,
+	    unsigned volume) noexcept
+{
+	if (volume > 0x7fff) {
+		/* SSE2 has only a 16x16 bit multiplication, and
+		   this volume doesn't fit into a 16 bit operand */
+		Scalar16to24(dest, src, n, volume);
+		return;
+	}
+
+	const __m128i v = _mm_set1_epi16(int16_t(volume));
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+		/* combine the low and high halves of the 32 bit
+		   products */
+		const __m128i lo = _mm_mullo_epi16(x, v);
+		const __m128i hi = _mm_mulhi_epi16(x, v);
+		__m128i a = _mm_unpacklo_epi16(lo, hi);
+		__m128i b = _mm_unpackhi_epi16(lo, hi);
+
+		a = _mm_srai_epi32(a, SHIFT_16_TO_24);
+		b = _mm_srai_epi32(b, SHIFT_16_TO_24);
+
+		_mm_storeu_si128((__m128i *)(dest + i), a);
+		_mm_storeu_si128((__m128i *)(dest + i + 4), b);
+	}
+
+	Scalar16to24(dest + i, src + i, n - i, volume);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2Float(float *dest, const float *src, std::size_t n,
+	  float volume) noexcept
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256 a = _mm256_loadu_ps(src + i);
+		__m256 b = _mm256_loadu_ps(src + i + 8);
+		_mm256_storeu_ps(dest + i, _mm256_mul_ps(a, v));
+		_mm256_storeu_ps(dest + i + 8, _mm256_mul_ps(b, v));
+	}
+
+	ScalarFloat(dest + i, src + i, n - i, volume);
+}
+
+[[gnu::target("avx2")]]
+static void
+Avx2_16to24(int32_t *dest, const int16_t *src, std::size_t n,
+	    unsigned volume) noexcept
+{
+	const __m256i v = _mm256_set1_epi32(int32_t(volume));
+
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m128i x0 = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i x1 = _mm_loadu_si128((const __m128i *)(src + i + 8));
+
+		__m256i a = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(x0), v);
+		__m256i b = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(x1), v);
+
+		a = _mm256_srai_epi32(a, SHIFT_16_TO_24);
+		b = _mm256_srai_epi32(b, SHIFT_16_TO_24);
+
+		_mm256_storeu_si256((__m256i *)(dest + i), a);
+		_mm256_storeu_si256((__m256i *)(dest + i + 8), b);
+	}
+
+	Scalar16to24(dest + i, src + i, n - i, volume);
+}
+
+#endif // PCM_SIMD_X86
+
+#ifdef PCM_SIMD_NEON
+
+static void
+NeonFloat(float *dest, const float *src, std::size_t n,
+	  float volume) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		float32x4_t a = vld1q_f32(src + i);
+		float32x4_t b = vld1q_f32(src + i + 4);
+		vst1q_f32(dest + i, vmulq_n_f32(a, volume));
+		vst1q_f32(dest + i + 4, vmulq_n_f32(b, volume));
+	}
+
+	ScalarFloat(dest + i, src + i, n - i, volume);
+}
+
+static void
+Neon16to24(int32_t *dest, const int16_t *src, std::size_t n,
+	   unsigned volume) noexcept
+{
+	const int32_t v = volume;
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(src + i);
+
+		int32x4_t a = vmulq_n_s32(vmovl_s16(vget_low_s16(x)), v);
+		int32x4_t b = vmulq_n_s32(vmovl_s16(vget_high_s16(x)), v);
+
+		vst1q_s32(dest + i, vshrq_n_s32(a, SHIFT_16_TO_24));
+		vst1q_s32(dest + i + 4, vshrq_n_s32(b, SHIFT_16_TO_24));
+	}
+
+	Scalar16to24(dest + i, src + i, n - i, volume);
+}
+
+#endif // PCM_SIMD_NEON
+
+namespace {
+
+struct VolumeKernels {
+	void (*float_)(float *dest, const float *src, std::size_t n,
+		       float volume) noexcept;
+
+	void (*s16_to_24)(int32_t *dest, const int16_t *src, std::size_t n,
+			  unsigned volume) noexcept;
+};
+
+} // anonymous namespace
+
+static VolumeKernels
+SelectKernels() noexcept
+{
+	switch (PcmGetSimdLevel()) {
+	case PcmSimdLevel::SCALAR:
+		break;
+
+#ifdef PCM_SIMD_X86
+	case PcmSimdLevel::SSE2:
+		return {Sse2Float, Sse2_16to24};
+
+	case PcmSimdLevel::AVX2:
+		return {Avx2Float, Avx2_16to24};
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case PcmSimdLevel::NEON:
+		return {NeonFloat, Neon16to24};
+#endif
+
+	default:
+		break;
+	}
+
+	return {ScalarFloat, Scalar16to24};
+}
+
+/**
+ * Selected once during static initialization, before any other
+ * thread exists (MPD is built with -fno-threadsafe-statics, so a
+ * function-local static would not be safe here).
+ */
+static const VolumeKernels kernels = SelectKernels();
+
+void
+PcmVolumeSimdFloat(float *dest, const float *src, std::size_t n,
+		   float volume) noexcept
+{
+	kernels.float_(dest, src, n, volume);
+}
+
+void
+PcmVolumeSimd16to24(int32_t *dest, const int16_t *src, std::size_t n,
+		    unsigned volume) noexcept
+{
+	kernels.s16_to_24(dest, src, n, volume);
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_PCM_VOLUME_SIMD_HXX
+#define MPD_PCM_VOLUME_SIMD_HXX
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Vectorized kernels for the software volume code paths which do not
+ * need dithering, selected at startup (see PcmGetSimdLevel()).
+ *
+ * The dithered integer formats are not vectorized, because each
+ * sample depends on the error feedback and on the PRNG state left
+ * behind by the previous one; that is a serial recurrence, and
+ * changing it would make the output differ between CPUs.
+ */
+
+/**
+ * Multiply 32 bit floating point samples with a volume factor.
+ */
+void
+PcmVolumeSimdFloat(float *dest, const float *src, std::size_t n,
+		   float volume) noexcept;
+
+/**
+ * Apply the fixed-point volume to 16 bit samples, converting them
+ * to S24_P32 (see #PCM_VOLUME_BITS).  The output is bit-exact with
+ * the scalar implementation.
+ */
+void
+PcmVolumeSimd16to24(int32_t *dest, const int16_t *src, std::size_t n,
+		    unsigned volume) noexcept;
+
+#endif
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "AdaptiveBuffer.hxx"
+#include "MusicBuffer.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+static constexpr Domain adaptive_buffer_domain("adaptive_buffer");
+
+bool
+AdaptiveBuffer::OnStarving() noexcept
+{
+	if (min_chunks == 0)
+		return false;
+
+	last_change = Clock::now();
+
+	const unsigned max_chunks = buffer.GetSize();
+	const unsigned limit = buffer.GetLimit();
+	if (limit >= max_chunks)
+		return false;
+
+	/* grow quickly: the next stall may come soon */
+	const unsigned new_limit = std::min(limit + std::max(limit / 2, 1U),
+					    max_chunks);
+	buffer.SetLimit(new_limit);
+
+	FmtDebug(adaptive_buffer_domain, "growing to {} chunks", new_limit);
+	return true;
+}
+
+bool
+AdaptiveBuffer::OnSteady() noexcept
+{
+	if (min_chunks == 0)
+		return false;
+
+	const auto now = Clock::now();
+	if (now < last_change + SHRINK_INTERVAL)
+		return false;
+
+	last_change = now;
+
+	const unsigned limit = buffer.GetLimit();
+	if (limit <= min_chunks)
+		return false;
+
+	/* shrink slowly */
+	const unsigned new_limit = std::max(limit - std::max(limit / 8, 1U),
+					    min_chunks);
+	buffer.SetLimit(new_limit);
+
+	FmtDebug(adaptive_buffer_domain, "shrinking to {} chunks", new_limit);
+	return true;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ADAPTIVE_BUFFER_HXX
+#define MPD_ADAPTIVE_BUFFER_HXX
+
+#include <chrono>
+
+class MusicBuffer;
+
+/**
+ * Adjusts the number of usable chunks of a #MusicBuffer
+ * ("audio_buffer_min_size"): it grows each time the decoder falls
+ * behind (e.g. because a remote stream stalls), and shrinks back
+ * slowly while playback is steady.
+ */
+class AdaptiveBuffer {
+	using Clock = std::chrono::steady_clock;
+
+	/**
+	 * Shrink the buffer after playback has been steady for this
+	 * long.
+	 */
+	static constexpr Clock::duration SHRINK_INTERVAL = std::chrono::minutes{1};
+
+	MusicBuffer &buffer;
+
+	/**
+	 * The lower bound; zero if this feature is disabled.
+	 */
+	const unsigned min_chunks;
+
+	/**
+	 * The last time the buffer was grown or shrunk (or playback
+	 * was started).
+	 */
+	Clock::time_point last_change = Clock::now();
+
+public:
+	AdaptiveBuffer(MusicBuffer &_buffer, unsigned _min_chunks) noexcept
+		:buffer(_buffer), min_chunks(_min_chunks) {}
+
+	/**
+	 * The decoder has fallen behind.
+	 *
+	 * @return true if the limit has been changed
+	 */
+	bool OnStarving() noexcept;
+
+	/**
+	 * A chunk has been played without starving.
+	 *
+	 * @return true if the limit has been changed
+	 */
+	bool OnSteady() noexcept;
+};
+
+#endif
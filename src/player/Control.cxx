@@ -4,6 +4,8 @@
 #include "Control.hxx"
 #include "Outputs.hxx"
 #include "Listener.hxx"
+#include "MusicBuffer.hxx"
+#include "decoder/Control.hxx"
 #include "song/DetachedSong.hxx"
 
 #include <algorithm>
@@ -98,6 +100,23 @@ PlayerControl::Kill() noexcept
 	listener.OnPlayerStateChanged();
 }
 
+void
+PlayerControl::LockPark() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	{
+		std::unique_lock lock{mutex};
+		if (state != PlayerState::STOP || next_song != nullptr)
+			return;
+
+		SynchronousCommand(lock, PlayerCommand::PARK);
+	}
+
+	thread.Join();
+}
+
 void
 PlayerControl::PauseLocked(std::unique_lock<Mutex> &lock) noexcept
 {
@@ -166,6 +185,27 @@ PlayerControl::LockGetStatus() noexcept
 	return status;
 }
 
+unsigned
+PlayerControl::LockGetBufferUsage() const noexcept
+{
+	const std::scoped_lock protect{mutex};
+	return music_buffer != nullptr
+		? music_buffer->GetAllocatedCount()
+		: 0;
+}
+
+DecoderStats
+PlayerControl::LockGetDecoderStats(bool previous) const noexcept
+{
+	const std::scoped_lock protect{mutex};
+	if (decoder_control == nullptr)
+		return {};
+
+	return previous
+		? decoder_control->previous_stats
+		: decoder_control->stats;
+}
+
 void
 PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 {
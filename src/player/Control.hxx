@@ -24,6 +24,9 @@ struct PlayerConfig;
 class PlayerListener;
 class PlayerOutputs;
 class InputCacheManager;
+class MusicBuffer;
+class DecoderControl;
+struct DecoderStats;
 class DetachedSong;
 
 enum class PlayerState : uint8_t {
@@ -70,6 +73,13 @@ enum class PlayerCommand : uint8_t {
 	 * e.g. elapsed_time.
 	 */
 	REFRESH,
+
+	/**
+	 * Like #EXIT, but release the outputs instead of closing
+	 * them.  This terminates the thread of an idle player to
+	 * free its resources; it will be restarted on demand.
+	 */
+	PARK,
 };
 
 enum class PlayerError : uint8_t {
@@ -211,6 +221,24 @@ class PlayerControl final : public AudioOutputClient {
 
 	FloatDuration total_play_time = FloatDuration::zero();
 
+	/**
+	 * Information about the #MusicBuffer allocated by the player
+	 * thread.  Protected by #mutex.
+	 */
+	MusicBufferStats buffer_stats;
+
+	/**
+	 * The #MusicBuffer allocated by the player thread, or nullptr
+	 * if the thread is not running.  Protected by #mutex.
+	 */
+	const MusicBuffer *music_buffer = nullptr;
+
+	/**
+	 * The #DecoderControl of the player thread, or nullptr if
+	 * the thread is not running.  Protected by #mutex.
+	 */
+	const DecoderControl *decoder_control = nullptr;
+
 public:
 	PlayerControl(PlayerListener &_listener,
 		      PlayerOutputs &_outputs,
@@ -220,6 +248,22 @@ public:
 
 	void Kill() noexcept;
 
+	/**
+	 * Is the player thread running?  It is started on demand
+	 * and may be stopped by LockPark().
+	 */
+	bool IsThreadRunning() const noexcept {
+		return thread.IsDefined();
+	}
+
+	/**
+	 * Terminate the player thread (and the decoder thread and
+	 * free the #MusicBuffer) if the player is stopped.  The
+	 * thread will be started again by the next Play() or
+	 * LockSeek() call.
+	 */
+	void LockPark() noexcept;
+
 	/**
 	 * Like CheckRethrowError(), but locks and unlocks the object.
 	 */
@@ -324,6 +368,24 @@ public:
 		return total_play_time;
 	}
 
+	MusicBufferStats LockGetBufferStats() const noexcept {
+		const std::scoped_lock protect{mutex};
+		return buffer_stats;
+	}
+
+	/**
+	 * Returns the number of #MusicBuffer chunks currently in
+	 * use.
+	 */
+	unsigned LockGetBufferUsage() const noexcept;
+
+	/**
+	 * Returns the performance counters of the song currently
+	 * being decoded (or the previous one).  The URI is empty if
+	 * there is no such song.
+	 */
+	DecoderStats LockGetDecoderStats(bool previous) const noexcept;
+
 private:
 	/**
 	 * Signals the object.  The object should be locked prior to
@@ -135,7 +135,7 @@ CrossFadeSettings::Calculate(float replay_gain_db, float replay_gain_prev_db,
 	if (chunks > max_chunks) {
 		chunks = max_chunks;
 		LogWarning(cross_fade_domain,
-			   "audio_buffer_size too small for computed MixRamp overlap");
+			   "audio_buffer_size too small for the cross-fade duration, shortening it");
 	}
 
 	return chunks;
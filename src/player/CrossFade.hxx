@@ -58,7 +58,9 @@ struct CrossFadeSettings {
 	 * @param mixramp_start the next songs mixramp_start tag
 	 * @param mixramp_prev_end the last songs mixramp_end setting
 	 * @param af the audio format of the new song
-	 * @param max_chunks the maximum number of chunks
+	 * @param max_chunks the maximum number of chunks (the part of
+	 * the buffer which is not reserved for other purposes); a
+	 * longer fade is shortened to this
 	 * @return the number of chunks for crossfading, or 0 if cross fading
 	 * should be disabled for this song change
 	 */
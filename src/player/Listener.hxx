@@ -4,6 +4,8 @@
 #ifndef MPD_PLAYER_LISTENER_HXX
 #define MPD_PLAYER_LISTENER_HXX
 
+class MixRampInfo;
+
 class PlayerListener {
 public:
 	/**
@@ -38,6 +40,24 @@ public:
 	 * Playback went into border pause.
 	 */
 	virtual void OnBorderPause() noexcept = 0;
+
+	/**
+	 * The player has started (or stopped) running out of
+	 * decoded data, i.e. the decoder cannot keep up.  Called
+	 * only on transitions, from the player thread; the last call
+	 * before the player thread exits passes false.
+	 */
+	virtual void OnPlayerStarving(bool starving) noexcept = 0;
+
+	/**
+	 * Look up MixRamp values which were stored for the given
+	 * song (database URI), e.g. by the analysis service.  Called
+	 * from the player thread without holding the
+	 * #PlayerControl mutex.
+	 *
+	 * @return the stored values (empty if there are none)
+	 */
+	virtual MixRampInfo LoadStoredMixRamp(const char *uri) noexcept = 0;
 };
 
 #endif
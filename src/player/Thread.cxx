@@ -28,12 +28,16 @@
 #include "MusicChunk.hxx"
 #include "song/DetachedSong.hxx"
 #include "CrossFade.hxx"
+#include "AdaptiveBuffer.hxx"
 #include "pcm/MixRampGlue.hxx"
 #include "tag/Tag.hxx"
+#include "tag/MixRampInfo.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "config/ThreadConfig.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
 #include <exception>
 #include <memory>
 
@@ -47,6 +51,12 @@ static constexpr Domain player_domain("player");
  */
 static constexpr auto buffer_before_play_duration = std::chrono::seconds(1);
 
+/**
+ * PlayNextChunk() sends chunks to the outputs until they hold this
+ * many.
+ */
+static constexpr unsigned output_queue_chunks = 64;
+
 class Player {
 	PlayerControl &pc;
 
@@ -54,6 +64,8 @@ class Player {
 
 	MusicBuffer &buffer;
 
+	AdaptiveBuffer adaptive_buffer;
+
 	std::shared_ptr<MusicPipe> pipe;
 
 	/**
@@ -75,16 +87,6 @@ class Player {
 	 */
 	unsigned buffer_before_play;
 
-	/**
-	 * If the decoder pipe gets consumed below this threshold,
-	 * it's time to wake up the decoder.
-	 *
-	 * It is calculated in a way which should prevent a wakeup
-	 * after each single consumed chunk; it is more efficient to
-	 * make the decoder decode a larger block at a time.
-	 */
-	const unsigned decoder_wakeup_threshold;
-
 	/**
 	 * Are we waiting for #buffer_before_play?
 	 */
@@ -120,6 +122,13 @@ class Player {
 	 */
 	bool output_open = false;
 
+	/**
+	 * Is the decoder failing to keep the pipe above
+	 * #buffer_before_play?  Reported to
+	 * PlayerListener::OnPlayerStarving().
+	 */
+	bool starving = false;
+
 	/**
 	 * Is cross-fading to the next song enabled?
 	 */
@@ -154,6 +163,12 @@ class Player {
 	 */
 	unsigned cross_fade_chunks = 0;
 
+	/**
+	 * Has LoadStoredMixRamp() already been called for the current
+	 * song transition?
+	 */
+	bool stored_mixramp_loaded = false;
+
 	/**
 	 * The current audio format for the audio outputs.
 	 */
@@ -182,7 +197,7 @@ public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
 	       MusicBuffer &_buffer) noexcept
 		:pc(_pc), dc(_dc), buffer(_buffer),
-		 decoder_wakeup_threshold(buffer.GetSize() * 3 / 4)
+		 adaptive_buffer(buffer, pc.config.buffer_min_chunks)
 	{
 	}
 
@@ -193,6 +208,7 @@ private:
 	 */
 	void ResetCrossFade() noexcept {
 		xfade_state = CrossFadeState::UNKNOWN;
+		stored_mixramp_loaded = false;
 	}
 
 	template<typename P>
@@ -301,6 +317,16 @@ private:
 	 */
 	void ActivateDecoder() noexcept;
 
+	void SetStarving(bool _starving) noexcept {
+		if (_starving != starving) {
+			starving = _starving;
+			pc.listener.OnPlayerStarving(starving);
+
+			if (starving && adaptive_buffer.OnStarving())
+				pc.buffer_stats = buffer.GetStats();
+		}
+	}
+
 	/**
 	 * Wrapper for MultipleOutputs::Open().  Upon failure, it
 	 * pauses the player.
@@ -315,6 +341,15 @@ private:
 					 const AudioFormat &audio_format,
 					 MixRampDirection direction) noexcept;
 
+	/**
+	 * Fill in missing MixRamp values of the current and the next
+	 * song from the values stored by the analysis service (if
+	 * any), which saves scanning the pipes.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void LoadStoredMixRamp() noexcept;
+
 	/**
 	 * @return false if more chunks of the next song are needed to
 	 * scan for MixRamp data
@@ -479,6 +514,54 @@ Player::UnlockAnalyzeMixRamp(const MusicPipe &_pipe,
 	return AnalyzeMixRamp(_pipe, audio_format, direction);
 }
 
+inline void
+Player::LoadStoredMixRamp() noexcept
+{
+	if (stored_mixramp_loaded)
+		return;
+
+	stored_mixramp_loaded = true;
+
+	/* copy the URIs, because the songs may be replaced while
+	   the mutex is unlocked */
+	std::string end_uri, start_uri;
+
+	if (dc.GetMixRampPreviousEnd() == nullptr &&
+	    song != nullptr && song->IsInDatabase())
+		end_uri = song->GetURI();
+
+	if (dc.GetMixRampStart() == nullptr &&
+	    dc.song != nullptr && dc.song->IsInDatabase())
+		start_uri = dc.song->GetURI();
+
+	if (end_uri.empty() && start_uri.empty())
+		return;
+
+	MixRampInfo end_info, start_info;
+
+	{
+		const ScopeUnlock unlock(pc.mutex);
+
+		if (!end_uri.empty())
+			end_info = pc.listener.LoadStoredMixRamp(end_uri.c_str());
+
+		if (!start_uri.empty())
+			start_info = pc.listener.LoadStoredMixRamp(start_uri.c_str());
+	}
+
+	if (const char *s = end_info.GetEnd();
+	    s != nullptr && dc.GetMixRampPreviousEnd() == nullptr) {
+		FmtDebug(player_domain, "Stored MixRamp end: {}", s);
+		dc.SetMixRampPreviousEnd(s);
+	}
+
+	if (const char *s = start_info.GetStart();
+	    s != nullptr && dc.GetMixRampStart() == nullptr) {
+		FmtDebug(player_domain, "Stored MixRamp start: {}", s);
+		dc.SetMixRampStart(s);
+	}
+}
+
 inline bool
 Player::MixRampScannerReady() noexcept
 {
@@ -488,6 +571,8 @@ Player::MixRampScannerReady() noexcept
 	if (!pc.cross_fade.IsMixRampEnabled())
 		return true;
 
+	LoadStoredMixRamp();
+
 	if (!pc.config.mixramp_analyzer)
 		/* always ready if the scanner is disabled */
 		return true;
@@ -515,7 +600,7 @@ Player::MixRampScannerReady() noexcept
 		const std::size_t want_pipe_chunks =
 			std::min((want_pipe_bytes + sizeof(MusicChunk::data) - 1)
 				 / sizeof(MusicChunk::data),
-				 buffer.GetSize() / std::size_t{3});
+				 buffer.GetLimit() / std::size_t{3});
 
 		if (dc.pipe->GetSize() < want_pipe_chunks) {
 			/* need more data */
@@ -601,6 +686,13 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
 			/ sizeof(MusicChunk::data);
 
+		if (dc.max_pipe_chunks > 0)
+			/* "latency_target": the pipe will never
+			   grow to one second */
+			buffer_before_play = std::min(buffer_before_play,
+						      std::max(dc.max_pipe_chunks / 2,
+							       1U));
+
 		pc.listener.OnPlayerStateChanged();
 
 		if (pending_seek > SongTime::zero()) {
@@ -767,6 +859,7 @@ Player::ProcessCommand(std::unique_lock<Mutex> &lock) noexcept
 
 	case PlayerCommand::STOP:
 	case PlayerCommand::EXIT:
+	case PlayerCommand::PARK:
 	case PlayerCommand::CLOSE_AUDIO:
 		return false;
 
@@ -879,15 +972,27 @@ Player::CheckCrossFade() noexcept
 		return;
 
 	/* enable cross fading in this song?  if yes, calculate how
-	   many chunks will be required for it */
+	   many chunks will be required for it; with an adaptive
+	   buffer, only the chunks usable right now count */
+	const unsigned buffer_limit = buffer.GetLimit();
+
+	/* while fading, each chunk in the output queue holds a chunk
+	   of both songs, and the decoder needs room for some chunks
+	   of the new song ahead of the fade; reserve that, or the
+	   decoder would run out of buffer and the outputs would
+	   underrun */
+	const unsigned reserved_chunks =
+		buffer_before_play + 2 * output_queue_chunks;
+
 	cross_fade_chunks =
 		pc.cross_fade.Calculate(dc.replay_gain_db,
 					dc.replay_gain_prev_db,
 					dc.GetMixRampStart(),
 					dc.GetMixRampPreviousEnd(),
 					play_audio_format,
-					buffer.GetSize() -
-					buffer_before_play);
+					buffer_limit > reserved_chunks
+					? buffer_limit - reserved_chunks
+					: 0);
 	if (cross_fade_chunks > 0)
 		xfade_state = CrossFadeState::ENABLED;
 	else
@@ -941,18 +1046,28 @@ PlayerControl::PlayChunk(DetachedSong &song, MusicChunkPtr chunk,
 inline bool
 Player::PlayNextChunk() noexcept
 {
-	if (!pc.LockWaitOutputConsumed(64))
+	if (!pc.LockWaitOutputConsumed(output_queue_chunks))
 		/* the output pipe is still large enough, don't send
 		   another chunk */
 		return true;
 
-	/* activate cross-fading? */
+	/* activate cross-fading?  Only if the decoder is far enough
+	   ahead; if it is not, keep playing the old song alone and
+	   start a shorter fade later, instead of letting the fade
+	   wait for the decoder */
 	if (xfade_state == CrossFadeState::ENABLED &&
 	    IsDecoderAtNextSong() &&
-	    pipe->GetSize() <= cross_fade_chunks) {
+	    pipe->GetSize() <= cross_fade_chunks &&
+	    dc.pipe->GetSize() >= std::min(pipe->GetSize(),
+					   buffer_before_play)) {
 		/* beginning of the cross fade - adjust
 		   cross_fade_chunks which might be bigger than the
 		   remaining number of chunks in the old song */
+		if (pipe->GetSize() < cross_fade_chunks)
+			FmtDebug(player_domain,
+				 "cross-fading {} of {} chunks",
+				 pipe->GetSize(), cross_fade_chunks);
+
 		cross_fade_chunks = pipe->GetSize();
 		xfade_state = CrossFadeState::ACTIVE;
 	}
@@ -1052,8 +1167,13 @@ Player::PlayNextChunk() noexcept
 
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
-	   larger block at a time */
-	if (!dc.IsIdle() && dc.pipe->GetSize() <= decoder_wakeup_threshold) {
+	   larger block at a time; with "latency_target", the pipe is
+	   small and the decoder needs to be woken as soon as there is
+	   room */
+	const unsigned wakeup_threshold = dc.max_pipe_chunks > 0
+		? dc.max_pipe_chunks - 1
+		: buffer.GetLimit() * 3 / 4;
+	if (!dc.IsIdle() && dc.pipe->GetSize() <= wakeup_threshold) {
 		if (!decoder_woken) {
 			decoder_woken = true;
 			dc.Signal();
@@ -1061,6 +1181,15 @@ Player::PlayNextChunk() noexcept
 	} else
 		decoder_woken = false;
 
+	SetStarving(!dc.IsIdle() && dc.pipe == pipe &&
+		    pipe->GetSize() < buffer_before_play);
+
+	if (!dc.IsIdle() && dc.pipe == pipe)
+		dc.stats.UpdatePipeLow(pipe->GetSize());
+
+	if (!starving && adaptive_buffer.OnSteady())
+		pc.buffer_stats = buffer.GetStats();
+
 	return true;
 }
 
@@ -1125,9 +1254,13 @@ Player::Run() noexcept
 
 			if (pipe->GetSize() < buffer_before_play &&
 			    !dc.IsIdle() && !buffer.IsFull()) {
-				/* not enough decoded buffer space yet */
+				/* not enough decoded buffer space yet;
+				   don't wake up for each chunk */
 
-				dc.WaitForDecoder(lock);
+				dc.WaitForDecoder(lock,
+						  IsDecoderAtCurrentSong()
+						  ? buffer_before_play
+						  : 1);
 				continue;
 			} else {
 				/* buffering is complete */
@@ -1148,6 +1281,8 @@ Player::Run() noexcept
 		CheckCrossFade();
 
 		if (paused) {
+			SetStarving(false);
+
 			if (pc.command == PlayerCommand::NONE)
 				pc.Wait(lock);
 		} else if (!pipe->IsEmpty()) {
@@ -1198,6 +1333,8 @@ Player::Run() noexcept
 			   new PCM data in time: wait for the
 			   decoder */
 
+			SetStarving(true);
+
 			/* wake up the decoder (just in case it's
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
@@ -1208,6 +1345,8 @@ Player::Run() noexcept
 		}
 	}
 
+	SetStarving(false);
+
 	CancelPendingSeek();
 	StopDecoder(lock);
 
@@ -1243,15 +1382,28 @@ PlayerControl::RunThread() noexcept
 try {
 	SetThreadName("player");
 
+	try {
+		GetThreadScheduling("player").Apply(false);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to apply player thread scheduling settings");
+	}
+
 	DecoderControl dc(mutex, cond,
 			  input_cache,
 			  config.audio_format,
-			  config.replay_gain);
+			  config.replay_gain,
+			  config.latency_target / 2);
 	dc.StartThread();
 
-	MusicBuffer buffer{config.buffer_chunks};
+	MusicBuffer buffer{config.buffer_chunks, config.buffer_options};
+	if (config.buffer_min_chunks > 0)
+		buffer.SetLimit(config.buffer_min_chunks);
 
 	std::unique_lock lock{mutex};
+	buffer_stats = buffer.GetStats();
+	music_buffer = &buffer;
+	decoder_control = &dc;
 
 	while (true) {
 		switch (command) {
@@ -1315,6 +1467,20 @@ try {
 				outputs.Close();
 			}
 
+			music_buffer = nullptr;
+			decoder_control = nullptr;
+			CommandFinished();
+			return;
+
+		case PlayerCommand::PARK:
+			{
+				const ScopeUnlock unlock(mutex);
+				dc.Quit();
+				outputs.Release();
+			}
+
+			music_buffer = nullptr;
+			decoder_control = nullptr;
 			CommandFinished();
 			return;
 
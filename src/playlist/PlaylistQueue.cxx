@@ -13,6 +13,7 @@
 #include "input/Error.hxx"
 #include "thread/Mutex.hxx"
 #include "fs/Traits.hxx"
+#include "util/ScopeExit.hxx"
 #include "Log.hxx"
 
 #ifdef ENABLE_DATABASE
@@ -20,12 +21,22 @@
 #endif
 
 #include <memory>
+#include <vector>
+
+/**
+ * Songs are appended to the queue in batches of this size.  This
+ * bounds the memory used for songs which have been read but not yet
+ * added, and playlist::AppendSongs() updates the "queued" song and the
+ * random order only once per batch.
+ */
+static constexpr std::size_t LOAD_BATCH_SIZE = 256;
 
 void
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader)
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_ids)
 {
 	const unsigned max_log_msgs = 8;
 
@@ -33,6 +44,31 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 		? PathTraitsUTF8::GetParent(uri)
 		: ".";
 
+	std::vector<DetachedSong> batch;
+	batch.reserve(LOAD_BATCH_SIZE);
+
+	/* indexes into #batch of the songs whose metadata shall be
+	   loaded from the database later */
+	std::vector<unsigned> lazy_indexes;
+
+	const auto flush = [&]{
+		const unsigned first = dest.GetLength();
+
+		AtScopeExit(&) {
+			/* this also covers the songs which were added
+			   before an error */
+			const unsigned n = dest.GetLength() - first;
+			for (const unsigned i : lazy_indexes)
+				if (i < n)
+					lazy_ids->push_back(dest.queue.PositionToId(first + i));
+
+			batch.clear();
+			lazy_indexes.clear();
+		};
+
+		dest.AppendSongs(pc, batch);
+	};
+
 	std::unique_ptr<DetachedSong> song;
 	for (unsigned i = 0, failures = 0;
 	     i < end_index && (song = e.NextSong()) != nullptr;
@@ -42,8 +78,21 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			continue;
 		}
 
-		if (!playlist_check_translate_song(*song, base_uri,
-						   loader)) {
+		bool success;
+		if (lazy_ids != nullptr) {
+			playlist_translate_song_uri(*song, base_uri);
+
+			if (!PathTraitsUTF8::IsAbsoluteOrHasScheme(song->GetURI())) {
+				/* a database song: load it later */
+				lazy_indexes.push_back(batch.size());
+				success = true;
+			} else
+				success = playlist_check_load_song(*song, loader);
+		} else
+			success = playlist_check_translate_song(*song, base_uri,
+								loader);
+
+		if (!success) {
 			failures += 1;
 			if (failures < max_log_msgs) {
 				FmtError(playlist_domain, "Failed to load {:?}.", song->GetURI());
@@ -53,8 +102,14 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			continue;
 		}
 
-		dest.AppendSong(pc, std::move(*song));
+		batch.emplace_back(std::move(*song));
+		if (batch.size() >= LOAD_BATCH_SIZE)
+			flush();
 	}
+
+	if (!batch.empty())
+		flush();
+
 	dest.SetLastLoadedPlaylist(uri);
 }
 
@@ -62,7 +117,8 @@ void
 playlist_open_into_queue(const LocatedUri &uri,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader)
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_ids)
 try {
 	Mutex mutex;
 
@@ -76,7 +132,7 @@ try {
 
 	playlist_load_into_queue(uri.canonical_uri, *playlist,
 				 start_index, end_index,
-				 dest, pc, loader);
+				 dest, pc, loader, lazy_ids);
 } catch (...) {
 	if (IsFileNotFound(std::current_exception()))
 		throw PlaylistError::NoSuchList();
@@ -7,6 +7,9 @@
  * \brief Glue between playlist plugin and the play queue
  */
 
+#include <vector>
+
+struct LocatedUri;
 class SongLoader;
 class SongEnumerator;
 struct playlist;
@@ -20,12 +23,18 @@ class PlayerControl;
  * URIs
  * @param start_index the index of the first song
  * @param end_index the index of the last song (excluding)
+ * @param lazy_ids if not nullptr, then songs which refer to the
+ * database are appended without loading them from the database
+ * (this is done later by the caller, e.g. with
+ * playlist::LoadLazySongs()), and their queue ids are appended to
+ * this vector
  */
 void
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader);
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_ids=nullptr);
 
 /**
  * Opens a playlist with a playlist plugin and append to the specified
@@ -37,4 +46,5 @@ void
 playlist_open_into_queue(const LocatedUri &uri,
 			 unsigned start_index, unsigned end_index,
 			 playlist &dest, PlayerControl &pc,
-			 const SongLoader &loader);
+			 const SongLoader &loader,
+			 std::vector<unsigned> *lazy_ids=nullptr);
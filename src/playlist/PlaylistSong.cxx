@@ -16,9 +16,14 @@
 #include <string.h>
 
 static void
-merge_song_metadata(DetachedSong &add, const DetachedSong &base) noexcept
+merge_song_metadata(DetachedSong &add, DetachedSong &&base) noexcept
 {
-	if (base.GetTag().IsDefined()) {
+	if (!add.GetTag().IsDefined() && !add.GetTag().has_playlist) {
+		/* nothing to merge: take over the other tag, which
+		   shares its item array instead of building a new
+		   one */
+		add.SetTag(std::move(base.WritableTag()));
+	} else if (base.GetTag().IsDefined()) {
 		TagBuilder builder(add.GetTag());
 		builder.Complement(base.GetTag());
 		add.SetTag(builder.Commit());
@@ -38,7 +43,7 @@ merge_song_metadata(DetachedSong &add, const DetachedSong &base) noexcept
 		add.SetAudioFormat(base.GetAudioFormat());
 }
 
-static bool
+bool
 playlist_check_load_song(DetachedSong &song, const SongLoader &loader) noexcept
 try {
 	DetachedSong tmp = loader.LoadSong(song.GetURI());
@@ -47,15 +52,15 @@ try {
 	if (!song.HasRealURI() && tmp.HasRealURI())
 		song.SetRealURI(tmp.GetRealURI());
 
-	merge_song_metadata(song, tmp);
+	merge_song_metadata(song, std::move(tmp));
 	return true;
 } catch (...) {
 	return false;
 }
 
-bool
-playlist_check_translate_song(DetachedSong &song, std::string_view base_uri,
-			      const SongLoader &loader) noexcept
+void
+playlist_translate_song_uri(DetachedSong &song,
+			    std::string_view base_uri) noexcept
 {
 	if (base_uri.compare(".") == 0)
 		/* PathTraitsUTF8::GetParent() returns "." when there
@@ -90,6 +95,12 @@ playlist_check_translate_song(DetachedSong &song, std::string_view base_uri,
 	/* Remove dot segments */
 	std::string new_uri = uri_squash_dot_segments(uri);
 	song.SetURI(std::move(new_uri));
+}
 
+bool
+playlist_check_translate_song(DetachedSong &song, std::string_view base_uri,
+			      const SongLoader &loader) noexcept
+{
+	playlist_translate_song_uri(song, base_uri);
 	return playlist_check_load_song(song, loader);
 }
@@ -9,6 +9,26 @@
 class SongLoader;
 class DetachedSong;
 
+/**
+ * Make the song URI absolute (or relative to the music directory)
+ * by applying the base URI of the playlist, and normalize it.  This
+ * is the first half of playlist_check_translate_song().
+ */
+void
+playlist_translate_song_uri(DetachedSong &song,
+			    std::string_view base_uri) noexcept;
+
+/**
+ * Load the song with the #SongLoader and merge its metadata into the
+ * given song.  This is the second half of
+ * playlist_check_translate_song().
+ *
+ * @return true on success, false if the song should not be used
+ */
+bool
+playlist_check_load_song(DetachedSong &song,
+			 const SongLoader &loader) noexcept;
+
 /**
  * Verifies the song, returns false if it is unsafe.  Translate the
  * song to a song within the database, if it is a local file.
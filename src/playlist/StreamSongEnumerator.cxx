@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "StreamSongEnumerator.hxx"
+#include "input/InputStream.hxx"
+
+StreamSongEnumerator::StreamSongEnumerator(InputStreamPtr &&_is) noexcept
+	:is(std::move(_is)) {}
+
+StreamSongEnumerator::~StreamSongEnumerator() noexcept = default;
+
+std::unique_ptr<DetachedSong>
+StreamSongEnumerator::NextSong()
+{
+	while (songs.empty()) {
+		if (!is)
+			/* end of file */
+			return nullptr;
+
+		std::byte buffer[4096];
+		const std::size_t nbytes = is->LockRead(buffer);
+		if (nbytes == 0) {
+			is.reset();
+			CompleteParse();
+		} else
+			Parse(std::span{buffer}.first(nbytes));
+	}
+
+	auto result = std::make_unique<DetachedSong>(std::move(songs.front()));
+	songs.pop_front();
+	return result;
+}
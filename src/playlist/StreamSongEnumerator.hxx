@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_STREAM_SONG_ENUMERATOR_HXX
+#define MPD_STREAM_SONG_ENUMERATOR_HXX
+
+#include "SongEnumerator.hxx"
+#include "song/DetachedSong.hxx"
+#include "input/Ptr.hxx"
+
+#include <cstddef>
+#include <deque>
+#include <span>
+#include <utility>
+
+/**
+ * A #SongEnumerator which feeds an #InputStream into an incremental
+ * (push) parser chunk by chunk, only as far as needed to obtain the
+ * next song.  This way, the first song of a large document is
+ * available as soon as it has been parsed, and only the songs which
+ * have been parsed but not yet consumed occupy memory.
+ *
+ * Parser errors are thrown by NextSong(); the songs which were
+ * parsed before the error have already been returned.
+ */
+class StreamSongEnumerator : public SongEnumerator {
+	/**
+	 * The stream being parsed; nullptr after end of file.
+	 */
+	InputStreamPtr is;
+
+	/**
+	 * Songs which have been parsed but not yet returned by
+	 * NextSong().
+	 */
+	std::deque<DetachedSong> songs;
+
+public:
+	explicit StreamSongEnumerator(InputStreamPtr &&_is) noexcept;
+	~StreamSongEnumerator() noexcept override;
+
+	/**
+	 * Called by the parser after it has finished a song.
+	 */
+	template<typename... Args>
+	void EmplaceSong(Args&&... args) {
+		songs.emplace_back(std::forward<Args>(args)...);
+	}
+
+	std::unique_ptr<DetachedSong> NextSong() override;
+
+protected:
+	/**
+	 * Pass a chunk of the document to the parser.
+	 *
+	 * Throws on error.
+	 */
+	virtual void Parse(std::span<const std::byte> src) = 0;
+
+	/**
+	 * The end of the document has been reached.
+	 *
+	 * Throws on error.
+	 */
+	virtual void CompleteParse() = 0;
+};
+
+#endif
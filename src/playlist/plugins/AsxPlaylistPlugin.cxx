@@ -3,22 +3,17 @@
 
 #include "AsxPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../StreamSongEnumerator.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Table.hxx"
 #include "util/ASCII.hxx"
+#include "util/SpanCast.hxx"
 #include "lib/expat/ExpatParser.hxx"
 
 /**
  * This is the state object for our XML parser.
  */
-struct AsxParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+struct AsxParser final : StreamSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -42,6 +37,20 @@ struct AsxParser {
 	TagBuilder tag_builder;
 
 	std::string value;
+
+	ExpatParser expat{this};
+
+	explicit AsxParser(InputStreamPtr &&_is);
+
+protected:
+	/* virtual methods from class StreamSongEnumerator */
+	void Parse(std::span<const std::byte> src) override {
+		expat.Parse(ToStringView(src));
+	}
+
+	void CompleteParse() override {
+		expat.CompleteParse();
+	}
 };
 
 static constexpr struct tag_table asx_tag_elements[] = {
@@ -100,8 +109,8 @@ asx_end_element(void *user_data, const XML_Char *element_name)
 	case AsxParser::ENTRY:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->EmplaceSong(std::move(parser->location),
+						    parser->tag_builder.Commit());
 
 			parser->state = AsxParser::ROOT;
 		}
@@ -140,20 +149,18 @@ asx_char_data(void *user_data, const XML_Char *s, int len)
  *
  */
 
+inline
+AsxParser::AsxParser(InputStreamPtr &&_is)
+	:StreamSongEnumerator(std::move(_is))
+{
+	expat.SetElementHandler(asx_start_element, asx_end_element);
+	expat.SetCharacterDataHandler(asx_char_data);
+}
+
 static std::unique_ptr<SongEnumerator>
 asx_open_stream(InputStreamPtr &&is)
 {
-	AsxParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(asx_start_element, asx_end_element);
-		expat.SetCharacterDataHandler(asx_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<AsxParser>(std::move(is));
 }
 
 static const char *const asx_suffixes[] = {
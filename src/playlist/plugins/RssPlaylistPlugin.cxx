@@ -3,21 +3,16 @@
 
 #include "RssPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../StreamSongEnumerator.hxx"
 #include "tag/Builder.hxx"
 #include "util/ASCII.hxx"
+#include "util/SpanCast.hxx"
 #include "lib/expat/ExpatParser.hxx"
 
 /**
  * This is the state object for the our XML parser.
  */
-struct RssParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+struct RssParser final : StreamSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -40,7 +35,19 @@ struct RssParser {
 
 	TagBuilder tag_builder;
 
-	RssParser() = default;
+	ExpatParser expat{this};
+
+	explicit RssParser(InputStreamPtr &&_is);
+
+protected:
+	/* virtual methods from class StreamSongEnumerator */
+	void Parse(std::span<const std::byte> src) override {
+		expat.Parse(ToStringView(src));
+	}
+
+	void CompleteParse() override {
+		expat.CompleteParse();
+	}
 };
 
 static void XMLCALL
@@ -86,8 +93,8 @@ rss_end_element(void *user_data, const XML_Char *element_name)
 	case RssParser::ITEM:
 		if (StringEqualsCaseASCII(element_name, "item")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->EmplaceSong(std::move(parser->location),
+						    parser->tag_builder.Commit());
 
 			parser->state = RssParser::ROOT;
 		} else
@@ -120,20 +127,18 @@ rss_char_data(void *user_data, const XML_Char *s, int len)
  *
  */
 
+inline
+RssParser::RssParser(InputStreamPtr &&_is)
+	:StreamSongEnumerator(std::move(_is))
+{
+	expat.SetElementHandler(rss_start_element, rss_end_element);
+	expat.SetCharacterDataHandler(rss_char_data);
+}
+
 static std::unique_ptr<SongEnumerator>
 rss_open_stream(InputStreamPtr &&is)
 {
-	RssParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(rss_start_element, rss_end_element);
-		expat.SetCharacterDataHandler(rss_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<RssParser>(std::move(is));
 }
 
 static constexpr const char *rss_suffixes[] = {
@@ -3,15 +3,15 @@
 
 #include "SoundCloudPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../StreamSongEnumerator.hxx"
 #include "lib/yajl/Handle.hxx"
 #include "lib/yajl/Callbacks.hxx"
-#include "lib/yajl/ParseInputStream.hxx"
 #include "config/Block.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Builder.hxx"
 #include "util/AllocatedString.hxx"
 #include "util/ASCII.hxx"
+#include "util/SpanCast.hxx"
 #include "util/StringCompare.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
@@ -113,7 +113,7 @@ static const char *const key_str[] = {
 	nullptr,
 };
 
-struct SoundCloudJsonData {
+struct SoundCloudJsonData final : StreamSongEnumerator {
 	enum class Key {
 		DURATION,
 		TITLE,
@@ -127,13 +127,26 @@ struct SoundCloudJsonData {
 	std::string title;
 	int got_url = 0; /* nesting level of last stream_url */
 
-	std::forward_list<DetachedSong> songs;
+	Yajl::Handle handle;
+
+	explicit SoundCloudJsonData(InputStreamPtr &&_is);
 
 	bool Integer(long long value) noexcept;
 	bool String(std::string_view value) noexcept;
 	bool StartMap() noexcept;
 	bool MapKey(std::string_view value) noexcept;
 	bool EndMap() noexcept;
+
+protected:
+	/* virtual methods from class StreamSongEnumerator */
+	void Parse(std::span<const std::byte> src) override {
+		const auto u = FromBytesStrict<const unsigned char>(src);
+		handle.Parse(u.data(), u.size());
+	}
+
+	void CompleteParse() override {
+		handle.CompleteParse();
+	}
 };
 
 inline bool
@@ -212,7 +225,7 @@ SoundCloudJsonData::EndMap() noexcept
 	if (!title.empty())
 		tag.AddItem(TAG_NAME, title);
 
-	songs.emplace_front(u.c_str(), tag.Commit());
+	EmplaceSong(u.c_str(), tag.Commit());
 
 	return true;
 }
@@ -232,18 +245,10 @@ static constexpr yajl_callbacks parse_callbacks = {
 	nullptr,
 };
 
-/**
- * Read JSON data and parse it using the given YAJL parser.
- * @param url URL of the JSON data.
- * @param handle YAJL parser handle.
- */
-static void
-soundcloud_parse_json(const char *url, Yajl::Handle &handle,
-		      Mutex &mutex)
-{
-	auto input_stream = InputStream::OpenReady(url, mutex);
-	Yajl::ParseInputStream(handle, *input_stream);
-}
+inline
+SoundCloudJsonData::SoundCloudJsonData(InputStreamPtr &&_is)
+	:StreamSongEnumerator(std::move(_is)),
+	 handle(&parse_callbacks, nullptr, this) {}
 
 /**
  * Parse a soundcloud:// URL and create a playlist.
@@ -264,12 +269,8 @@ soundcloud_open_uri(const char *uri, Mutex &mutex)
 		return nullptr;
 	}
 
-	SoundCloudJsonData data;
-	Yajl::Handle handle(&parse_callbacks, nullptr, &data);
-	soundcloud_parse_json(u.c_str(), handle, mutex);
-
-	data.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(data.songs));
+	return std::make_unique<SoundCloudJsonData>(InputStream::OpenReady(u.c_str(),
+									   mutex));
 }
 
 static const char *const soundcloud_schemes[] = {
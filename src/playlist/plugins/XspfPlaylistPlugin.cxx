@@ -3,25 +3,20 @@
 
 #include "XspfPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../StreamSongEnumerator.hxx"
 #include "song/DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Table.hxx"
 #include "lib/expat/ExpatParser.hxx"
+#include "util/SpanCast.hxx"
 
 #include <string.h>
 
 /**
  * This is the state object for our XML parser.
  */
-struct XspfParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+struct XspfParser final : StreamSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -45,6 +40,20 @@ struct XspfParser {
 	TagBuilder tag_builder;
 
 	std::string value;
+
+	ExpatParser expat{this};
+
+	explicit XspfParser(InputStreamPtr &&_is);
+
+protected:
+	/* virtual methods from class StreamSongEnumerator */
+	void Parse(std::span<const std::byte> src) override {
+		expat.Parse(ToStringView(src));
+	}
+
+	void CompleteParse() override {
+		expat.CompleteParse();
+	}
 };
 
 static constexpr struct tag_table xspf_tag_elements[] = {
@@ -130,8 +139,8 @@ xspf_end_element(void *user_data, const XML_Char *element_name)
 	case XspfParser::TRACK:
 		if (strcmp(element_name, "track") == 0) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->EmplaceSong(std::move(parser->location),
+						    parser->tag_builder.Commit());
 
 			parser->state = XspfParser::TRACKLIST;
 		}
@@ -179,20 +188,18 @@ xspf_char_data(void *user_data, const XML_Char *s, int len)
  *
  */
 
+inline
+XspfParser::XspfParser(InputStreamPtr &&_is)
+	:StreamSongEnumerator(std::move(_is))
+{
+	expat.SetElementHandler(xspf_start_element, xspf_end_element);
+	expat.SetCharacterDataHandler(xspf_char_data);
+}
+
 static std::unique_ptr<SongEnumerator>
 xspf_open_stream(InputStreamPtr &&is)
 {
-	XspfParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(xspf_start_element, xspf_end_element);
-		expat.SetCharacterDataHandler(xspf_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<XspfParser>(std::move(is));
 }
 
 static constexpr const char *xspf_suffixes[] = {
@@ -10,6 +10,7 @@
 #include "util/ASCII.hxx"
 
 #include <cassert>
+#include <iterator> // for std::size()
 
 static constexpr const char * idle_names[] = {
 	"database",
@@ -26,9 +27,12 @@ static constexpr const char * idle_names[] = {
 	"neighbor",
 	"mount",
 	"partition",
+	"analysis",
 	nullptr,
 };
 
+static_assert(std::size(idle_names) == IDLE_NUM_FLAGS + 1);
+
 const char*const*
 idle_get_names() noexcept
 {
@@ -52,6 +52,12 @@ static constexpr unsigned IDLE_MOUNT = 0x1000;
 /** the partition list has changed */
 static constexpr unsigned IDLE_PARTITION = 0x2000;
 
+/** the background analysis has made progress */
+static constexpr unsigned IDLE_ANALYSIS = 0x4000;
+
+/** the number of idle flags defined above */
+static constexpr unsigned IDLE_NUM_FLAGS = 15;
+
 /**
  * Get idle names
  */
@@ -7,8 +7,9 @@
 #include <cassert>
 
 /**
- * A table that maps id numbers to position numbers.
+ * A table that maps id numbers to queue items.
  */
+template<typename T>
 class IdTable {
 	const unsigned size;
 
@@ -29,13 +30,17 @@ class IdTable {
 
 	/**
 	 * A lookup table: the index is the id number and the value is
-	 * the position; -1 means this id is unassigned.
+	 * the item; nullptr means this id is unassigned.
 	 */
-	int *const data = new int[size];
+	T **const data = new T *[size];
 
 public:
 	explicit constexpr IdTable(unsigned _size) noexcept
-		:size(_size) {}
+		:size(_size)
+	{
+		/* id 0 is never assigned */
+		data[0] = nullptr;
+	}
 
 	constexpr ~IdTable() noexcept {
 		delete[] data;
@@ -44,10 +49,10 @@ public:
 	IdTable(const IdTable &) = delete;
 	IdTable &operator=(const IdTable &) = delete;
 
-	constexpr int IdToPosition(unsigned id) const noexcept {
+	constexpr T *Lookup(unsigned id) const noexcept {
 		return id < initialized
 			? data[id]
-			: -1;
+			: nullptr;
 	}
 
 	constexpr unsigned GenerateId() noexcept {
@@ -70,30 +75,23 @@ public:
 
 			assert(id < initialized);
 
-			if (data[id] < 0)
+			if (data[id] == nullptr)
 				return id;
 		}
 	}
 
-	constexpr unsigned Insert(unsigned position) noexcept {
+	constexpr unsigned Insert(T &item) noexcept {
 		unsigned id = GenerateId();
 		assert(id < initialized);
-		data[id] = position;
+		data[id] = &item;
 		return id;
 	}
 
-	constexpr void Move(unsigned id, unsigned position) noexcept {
-		assert(id < initialized);
-		assert(data[id] >= 0);
-
-		data[id] = position;
-	}
-
 	constexpr void Erase(unsigned id) noexcept {
 		assert(id < initialized);
-		assert(data[id] >= 0);
+		assert(data[id] != nullptr);
 
-		data[id] = -1;
+		data[id] = nullptr;
 	}
 };
 
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Index.hxx"
+#include "tag/Tag.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+QueueIndex::QueueIndex() noexcept = default;
+QueueIndex::~QueueIndex() noexcept = default;
+
+void
+QueueIndex::Add(unsigned id, const Tag &tag) noexcept
+{
+	assert(!songs.contains(id));
+
+	std::vector<Ref> refs;
+
+	for (const auto &item : tag) {
+		auto &values = types[item.type];
+		auto value = values.try_emplace(item.value).first;
+
+		/* ids are mostly appended in ascending order */
+		auto &ids = value->second;
+		if (ids.empty() || ids.back() < id)
+			ids.push_back(id);
+		else if (auto i = std::lower_bound(ids.begin(), ids.end(), id);
+			 i == ids.end() || *i != id)
+			ids.insert(i, id);
+		else
+			/* duplicate tag item */
+			continue;
+
+		refs.push_back({item.type, value});
+	}
+
+	if (!refs.empty())
+		songs.emplace(id, std::move(refs));
+}
+
+void
+QueueIndex::Remove(unsigned id) noexcept
+{
+	auto i = songs.find(id);
+	if (i == songs.end())
+		return;
+
+	for (const auto &ref : i->second) {
+		auto &ids = ref.value->second;
+		auto j = std::lower_bound(ids.begin(), ids.end(), id);
+		assert(j != ids.end() && *j == id);
+		ids.erase(j);
+
+		if (ids.empty())
+			types[ref.type].erase(ref.value);
+	}
+
+	songs.erase(i);
+}
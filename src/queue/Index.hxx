@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/Type.hxx"
+
+#include <array>
+#include <functional> // for std::less
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Tag;
+
+/**
+ * An index which maps (#TagType, value) pairs to the ids of the
+ * #Queue items which contain them.  It is used by "playlistfind" and
+ * "playlistsearch" to evaluate each filter once per distinct tag
+ * value instead of once per queue item.
+ *
+ * The #Queue updates it incrementally; see Queue::GetIndex().
+ */
+class QueueIndex {
+public:
+	/**
+	 * A sorted list of song ids.
+	 */
+	using IdList = std::vector<unsigned>;
+
+	using ValueMap = std::map<std::string, IdList, std::less<>>;
+
+private:
+	std::array<ValueMap, TAG_NUM_OF_ITEM_TYPES> types;
+
+	struct Ref {
+		TagType type;
+		ValueMap::iterator value;
+	};
+
+	/**
+	 * The index entries of each song id, needed to remove a song
+	 * after its #Tag has been modified.
+	 */
+	std::unordered_map<unsigned, std::vector<Ref>> songs;
+
+public:
+	QueueIndex() noexcept;
+	~QueueIndex() noexcept;
+
+	QueueIndex(const QueueIndex &) = delete;
+	QueueIndex &operator=(const QueueIndex &) = delete;
+
+	void Add(unsigned id, const Tag &tag) noexcept;
+	void Remove(unsigned id) noexcept;
+
+	/**
+	 * The #Tag of the given song has been modified.
+	 */
+	void Update(unsigned id, const Tag &tag) noexcept {
+		Remove(id);
+		Add(id, tag);
+	}
+
+	const ValueMap &GetValues(TagType type) const noexcept {
+		return types[type];
+	}
+};
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Journal.hxx"
+
+#include <cassert>
+
+inline QueueJournal::Entry &
+QueueJournal::Add(uint32_t version, Type type,
+		  unsigned start, unsigned count, unsigned to) noexcept
+{
+	assert(entries.empty() || entries.back().version <= version);
+
+	return entries.emplace_back(Entry{version, type, start, count, to, {}});
+}
+
+void
+QueueJournal::Grow(std::size_t n) noexcept
+{
+	size += n;
+
+	while (size > max_size && !entries.empty()) {
+		const auto &e = entries.front();
+		size -= 1 + e.ids.size();
+
+		/* a client which knows the queue at this version
+		   cannot be updated anymore */
+		min_version = e.version + 1;
+
+		entries.pop_front();
+	}
+}
+
+void
+QueueJournal::Insert(uint32_t version, unsigned position,
+		     unsigned id) noexcept
+{
+	if (auto *e = GetMergeable(version, Type::INSERT);
+	    e != nullptr && e->start + e->count == position) {
+		/* append to the previous insertion */
+		e->ids.push_back(id);
+		++e->count;
+		Grow(1);
+		return;
+	}
+
+	auto &e = Add(version, Type::INSERT, position, 1);
+	e.ids.push_back(id);
+	Grow(2);
+}
+
+void
+QueueJournal::Delete(uint32_t version, unsigned position) noexcept
+{
+	if (auto *e = GetMergeable(version, Type::DELETE); e != nullptr) {
+		if (position == e->start) {
+			/* deleting forward */
+			++e->count;
+			return;
+		}
+
+		if (position + 1 == e->start) {
+			/* deleting backward */
+			--e->start;
+			++e->count;
+			return;
+		}
+	}
+
+	Add(version, Type::DELETE, position, 1);
+	Grow(1);
+}
+
+void
+QueueJournal::Move(uint32_t version, unsigned start, unsigned end,
+		   unsigned to) noexcept
+{
+	assert(start < end);
+
+	if (start == to)
+		return;
+
+	Add(version, Type::MOVE, start, end - start, to);
+	Grow(1);
+}
+
+void
+QueueJournal::Swap(uint32_t version, unsigned a, unsigned b) noexcept
+{
+	if (a == b)
+		return;
+
+	Add(version, Type::SWAP, a, 1, b);
+	Grow(1);
+}
+
+void
+QueueJournal::Modify(uint32_t version, unsigned position) noexcept
+{
+	if (auto *e = GetMergeable(version, Type::MODIFY); e != nullptr) {
+		if (position >= e->start && position < e->start + e->count)
+			/* already recorded */
+			return;
+
+		if (position == e->start + e->count) {
+			++e->count;
+			return;
+		}
+	}
+
+	Add(version, Type::MODIFY, position, 1);
+	Grow(1);
+}
+
+void
+QueueJournal::Reorder(uint32_t version, unsigned start,
+		      std::vector<unsigned> &&ids) noexcept
+{
+	if (ids.size() < 2)
+		return;
+
+	const std::size_t n = ids.size();
+	auto &e = Add(version, Type::REORDER, start, n);
+	e.ids = std::move(ids);
+	Grow(1 + n);
+}
+
+void
+QueueJournal::Clear(uint32_t version) noexcept
+{
+	/* after deleting all songs, older entries are irrelevant,
+	   and every client can be updated */
+	entries.clear();
+	size = 0;
+	min_version = 1;
+
+	Add(version, Type::CLEAR, 0, 0);
+	Grow(1);
+}
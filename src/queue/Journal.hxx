@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_QUEUE_JOURNAL_HXX
+#define MPD_QUEUE_JOURNAL_HXX
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * A log of structural modifications of a #Queue.  Clients which
+ * know the queue at a certain version can replay this log to
+ * obtain the current queue, instead of downloading all changed
+ * songs (which, after a "shuffle", are all songs).
+ *
+ * Each entry refers to positions at the time of its own
+ * modification, i.e. entries must be applied in order.  Adjacent
+ * modifications of the same kind are merged.
+ *
+ * The size of the log is limited; the oldest entries are discarded
+ * when this limit is exceeded.
+ */
+class QueueJournal {
+public:
+	enum class Type : uint8_t {
+		/**
+		 * Songs were inserted at #start; #ids contains their
+		 * ids.
+		 */
+		INSERT,
+
+		/**
+		 * #count songs were deleted at #start.
+		 */
+		DELETE,
+
+		/**
+		 * #count songs were moved from #start, so that the
+		 * first one is now at #to.
+		 */
+		MOVE,
+
+		/**
+		 * The songs at #start and #to were swapped.
+		 */
+		SWAP,
+
+		/**
+		 * The metadata or the priority of #count songs at
+		 * #start has changed (but not their ids).
+		 */
+		MODIFY,
+
+		/**
+		 * The #count songs at #start were reordered; #ids
+		 * contains their ids in the new order.
+		 */
+		REORDER,
+
+		/**
+		 * All songs were deleted.
+		 */
+		CLEAR,
+	};
+
+	struct Entry {
+		/**
+		 * The queue version during which this modification
+		 * was made.
+		 */
+		uint32_t version;
+
+		Type type;
+
+		unsigned start, count;
+
+		/**
+		 * The destination position (#Type::MOVE) or the
+		 * second position (#Type::SWAP).
+		 */
+		unsigned to;
+
+		std::vector<unsigned> ids;
+	};
+
+private:
+	std::deque<Entry> entries;
+
+	/**
+	 * The maximum value of #size.
+	 */
+	const std::size_t max_size;
+
+	/**
+	 * The number of entries plus the number of ids in all
+	 * entries.
+	 */
+	std::size_t size = 0;
+
+	/**
+	 * The oldest version from which this journal is complete.
+	 */
+	uint32_t min_version = 1;
+
+public:
+	explicit QueueJournal(std::size_t _max_size) noexcept
+		:max_size(_max_size) {}
+
+	QueueJournal(const QueueJournal &) = delete;
+	QueueJournal &operator=(const QueueJournal &) = delete;
+
+	/**
+	 * Can a client which knows the queue at version #since be
+	 * updated from this journal?
+	 */
+	[[gnu::pure]]
+	bool IsAvailable(uint32_t since, uint32_t current) const noexcept {
+		return since >= min_version && since <= current;
+	}
+
+	/**
+	 * Invoke a function for all entries which are needed by a
+	 * client which knows the queue at the specified version.
+	 * Call IsAvailable() first.
+	 */
+	template<typename F>
+	void ForEachSince(uint32_t since, F &&f) const {
+		const auto begin = std::partition_point(entries.begin(),
+							entries.end(),
+							[since](const Entry &e){
+								return e.version < since;
+							});
+
+		for (auto i = begin; i != entries.end(); ++i)
+			f(*i);
+	}
+
+	/**
+	 * Forget everything; this is called after the version number
+	 * has been reset due to integer overflow.
+	 */
+	void Reset(uint32_t version) noexcept {
+		entries.clear();
+		size = 0;
+		min_version = version;
+	}
+
+	void Insert(uint32_t version, unsigned position, unsigned id) noexcept;
+	void Delete(uint32_t version, unsigned position) noexcept;
+	void Move(uint32_t version, unsigned start, unsigned end,
+		  unsigned to) noexcept;
+	void Swap(uint32_t version, unsigned a, unsigned b) noexcept;
+	void Modify(uint32_t version, unsigned position) noexcept;
+	void Reorder(uint32_t version, unsigned start,
+		     std::vector<unsigned> &&ids) noexcept;
+	void Clear(uint32_t version) noexcept;
+
+private:
+	/**
+	 * Returns the last entry if it is of the specified type and
+	 * version (i.e. if a new modification may be merged into it).
+	 */
+	Entry *GetMergeable(uint32_t version, Type type) noexcept {
+		if (entries.empty())
+			return nullptr;
+
+		auto &e = entries.back();
+		if (e.version != version || e.type != type)
+			return nullptr;
+
+		return &e;
+	}
+
+	Entry &Add(uint32_t version, Type type,
+		   unsigned start, unsigned count,
+		   unsigned to=0) noexcept;
+
+	/**
+	 * Account for #n more ids and discard old entries if the
+	 * journal has become too large.
+	 */
+	void Grow(std::size_t n) noexcept;
+};
+
+#endif
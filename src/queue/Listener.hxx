@@ -4,6 +4,10 @@
 #ifndef MPD_QUEUE_LISTENER_HXX
 #define MPD_QUEUE_LISTENER_HXX
 
+#include <vector>
+
+class DetachedSong;
+
 class QueueListener {
 public:
 	/**
@@ -22,6 +26,24 @@ public:
 	 * been notified by the player thread.
 	 */
 	virtual void OnQueueSongStarted() noexcept = 0;
+
+	/**
+	 * Called before a song is passed to the player.  This gives
+	 * the listener a chance to complete a song which was added
+	 * without its metadata (see playlist_load_into_queue()).
+	 *
+	 * @return true if the song was modified
+	 */
+	virtual bool OnQueueSongNeeded(unsigned id,
+				       DetachedSong &song) noexcept = 0;
+
+	/**
+	 * The given songs were added to the queue without their
+	 * metadata; the listener shall load it in the background.
+	 *
+	 * @param ids the queue ids of the songs
+	 */
+	virtual void OnQueueLazySongs(std::vector<unsigned> &&ids) noexcept = 0;
 };
 
 #endif
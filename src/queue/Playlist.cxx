@@ -34,7 +34,7 @@ playlist::TagModified(const char *real_uri, const Tag &tag) noexcept
 	bool modified = false;
 
 	for (unsigned i = 0; i < queue.length; ++i) {
-		auto &song = *queue.items[i].song;
+		auto &song = queue.Get(i);
 		if (song.IsRealURI(real_uri)) {
 			song.SetTag(tag);
 			queue.ModifyAtPosition(i);
@@ -46,6 +46,21 @@ playlist::TagModified(const char *real_uri, const Tag &tag) noexcept
 		OnModified();
 }
 
+const DetachedSong &
+playlist::PrepareSongOrder(unsigned order) noexcept
+{
+	assert(queue.IsValidOrder(order));
+
+	const unsigned position = queue.OrderToPosition(order);
+	auto &song = queue.Get(position);
+	if (listener.OnQueueSongNeeded(queue.PositionToId(position), song)) {
+		queue.ModifyAtPosition(position);
+		OnModified();
+	}
+
+	return song;
+}
+
 inline void
 playlist::QueueSongOrder(PlayerControl &pc, unsigned order) noexcept
 
@@ -54,7 +69,7 @@ playlist::QueueSongOrder(PlayerControl &pc, unsigned order) noexcept
 
 	queued = order;
 
-	const DetachedSong &song = queue.GetOrder(order);
+	const DetachedSong &song = PrepareSongOrder(order);
 
 	FmtDebug(playlist_domain, "queue song {}:{:?}",
 		 queued, song.GetURI());
@@ -114,7 +129,7 @@ playlist::UpdateQueuedSong(PlayerControl &pc,
 	if (!playing)
 		return;
 
-	if (prev == nullptr && bulk_edit)
+	if (prev == nullptr && bulk_edit > 0)
 		/* postponed until CommitBulk() to avoid always
 		   queueing the first song that is being added (in
 		   random mode) */
@@ -166,7 +181,7 @@ playlist::PlayOrder(PlayerControl &pc, unsigned order)
 	playing = true;
 	queued = -1;
 
-	const DetachedSong &song = queue.GetOrder(order);
+	const DetachedSong &song = PrepareSongOrder(order);
 
 	FmtDebug(playlist_domain, "play {}:{:?}", order, song.GetURI());
 
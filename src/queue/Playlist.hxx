@@ -9,6 +9,8 @@
 #include "queue/Queue.hxx"
 #include "config.h"
 
+#include <span>
+
 enum TagType : uint8_t;
 struct Tag;
 struct RangeArg;
@@ -42,11 +44,14 @@ struct playlist {
 	bool stop_on_error;
 
 	/**
-	 * If true, then a bulk edit has been initiated by
+	 * If non-zero, then a bulk edit has been initiated by
 	 * BeginBulk(), and UpdateQueuedSong() and OnModified() will
-	 * be postponed until CommitBulk()
+	 * be postponed until CommitBulk().  This is a counter
+	 * because bulk edits may be nested (e.g. "add" inside a
+	 * command list); only the outermost CommitBulk() applies the
+	 * postponed changes.
 	 */
-	bool bulk_edit = false;
+	unsigned bulk_edit = 0;
 
 	/**
 	 * Has the queue been modified during bulk edit mode?
@@ -160,6 +165,14 @@ protected:
 	 */
 	void UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev) noexcept;
 
+	/**
+	 * Returns the song at the given order number after giving
+	 * the #QueueListener a chance to complete it (see
+	 * QueueListener::OnQueueSongNeeded()).  Call this before
+	 * passing a song to the player.
+	 */
+	const DetachedSong &PrepareSongOrder(unsigned order) noexcept;
+
 	/**
 	 * Queue a song, addressed by its order number.
 	 */
@@ -202,6 +215,15 @@ public:
 	 * The database has been modified.  Pull all updates.
 	 */
 	void DatabaseModified(const Database &db);
+
+	/**
+	 * Load the metadata of songs which were added without it
+	 * (see playlist_load_into_queue()).  Songs which cannot be
+	 * found are removed from the queue.  Ids which no longer
+	 * exist are ignored.
+	 */
+	void LoadLazySongs(PlayerControl &pc, const SongLoader &loader,
+			   std::span<const unsigned> ids) noexcept;
 #endif
 
 	/**
@@ -211,6 +233,18 @@ public:
 	 */
 	unsigned AppendSong(PlayerControl &pc, DetachedSong &&song);
 
+	/**
+	 * Append several songs at once.  This is cheaper than calling
+	 * AppendSong() for each one: the queued song is updated only
+	 * once, and in random mode, the new songs are shuffled into
+	 * the list of remaining songs in one pass.
+	 *
+	 * The songs are moved out of the given span.  If not all of
+	 * them fit, as many as possible are appended, and then
+	 * PlaylistError is thrown.
+	 */
+	void AppendSongs(PlayerControl &pc, std::span<DetachedSong> songs);
+
 	/**
 	 * Throws #std::runtime_error on error.
 	 *
@@ -219,7 +219,8 @@ playlist::SeekSongOrder(PlayerControl &pc, unsigned i, SongTime seek_time)
 	queued = -1;
 
 	try {
-		pc.LockSeek(std::make_unique<DetachedSong>(queue.GetOrder(i)), seek_time);
+		pc.LockSeek(std::make_unique<DetachedSong>(PrepareSongOrder(i)),
+			    seek_time);
 	} catch (...) {
 		UpdateQueuedSong(pc, nullptr);
 		throw;
@@ -15,12 +15,14 @@
 #include "song/DetachedSong.hxx"
 #include "SongLoader.hxx"
 
+#include <algorithm>
+
 #include <stdlib.h>
 
 void
 playlist::OnModified() noexcept
 {
-	if (bulk_edit) {
+	if (bulk_edit > 0) {
 		/* postponed to CommitBulk() */
 		bulk_modified = true;
 		return;
@@ -45,19 +47,16 @@ playlist::Clear(PlayerControl &pc) noexcept
 void
 playlist::BeginBulk() noexcept
 {
-	assert(!bulk_edit);
-
-	bulk_edit = true;
-	bulk_modified = false;
+	if (bulk_edit++ == 0)
+		bulk_modified = false;
 }
 
 void
 playlist::CommitBulk(PlayerControl &pc) noexcept
 {
-	assert(bulk_edit);
+	assert(bulk_edit > 0);
 
-	bulk_edit = false;
-	if (!bulk_modified)
+	if (--bulk_edit > 0 || !bulk_modified)
 		return;
 
 	if (queued < 0)
@@ -103,6 +102,42 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song)
 	return id;
 }
 
+void
+playlist::AppendSongs(PlayerControl &pc, std::span<DetachedSong> songs)
+{
+	const std::size_t n = std::min<std::size_t>(songs.size(),
+						    queue.max_length - queue.GetLength());
+
+	if (n > 0) {
+		const DetachedSong *const queued_song = GetQueuedSong();
+
+		for (auto &song : songs.first(n))
+			queue.Append(std::move(song), 0);
+
+		if (queue.random) {
+			/* shuffle the new songs into the list of
+			   remaining songs to play */
+
+			unsigned start;
+			if (queued >= 0)
+				start = queued + 1;
+			else
+				start = current + 1;
+			if (start < queue.GetLength())
+				queue.ShuffleOrderLastGroup(start,
+							    queue.GetLength(),
+							    n);
+		}
+
+		UpdateQueuedSong(pc, queued_song);
+		OnModified();
+	}
+
+	if (n < songs.size())
+		throw PlaylistError(PlaylistResult::TOO_LARGE,
+				    "Playlist is too large");
+}
+
 unsigned
 playlist::AppendURI(PlayerControl &pc, const SongLoader &loader,
 		    const char *uri)
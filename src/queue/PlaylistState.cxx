@@ -9,10 +9,11 @@
 #include "PlaylistState.hxx"
 #include "PlaylistError.hxx"
 #include "Playlist.hxx"
+#include "Listener.hxx"
 #include "SingleMode.hxx"
 #include "StateFileConfig.hxx"
 #include "Save.hxx"
-#include "io/LineReader.hxx"
+#include "io/FileLineReader.hxx"
 #include "io/BufferedOutputStream.hxx"
 #include "player/Control.hxx"
 #include "util/CharUtil.hxx"
@@ -23,6 +24,8 @@
 
 #include <fmt/format.h>
 
+#include <exception>
+
 #include <string.h>
 #include <stdlib.h>
 
@@ -39,14 +42,16 @@
 #define PLAYLIST_STATE_FILE_LOADED_PLAYLIST	"lastloadedplaylist: "
 #define PLAYLIST_STATE_FILE_PLAYLIST_BEGIN	"playlist_begin"
 #define PLAYLIST_STATE_FILE_PLAYLIST_END	"playlist_end"
+#define PLAYLIST_STATE_FILE_QUEUE_GENERATION	"queue_generation: "
 
 #define PLAYLIST_STATE_FILE_STATE_PLAY		"play"
 #define PLAYLIST_STATE_FILE_STATE_PAUSE		"pause"
 #define PLAYLIST_STATE_FILE_STATE_STOP		"stop"
 
-void
-playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
-		    PlayerControl &pc)
+static void
+playlist_state_save_options(BufferedOutputStream &os,
+			    const struct playlist &playlist,
+			    PlayerControl &pc)
 {
 	const auto player_status = pc.LockGetStatus();
 
@@ -88,14 +93,46 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	       pc.GetMixRampDelay().count());
 	os.Fmt(FMT_STRING(PLAYLIST_STATE_FILE_LOADED_PLAYLIST "{}\n"),
 	       playlist.GetLastLoadedPlaylist());
+}
+
+void
+playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
+		    PlayerControl &pc)
+{
+	playlist_state_save_options(os, playlist, pc);
+
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
 	queue_save(os, playlist.queue);
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
 }
 
+void
+playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
+		    PlayerControl &pc, unsigned queue_generation)
+{
+	playlist_state_save_options(os, playlist, pc);
+
+	os.Fmt(FMT_STRING(PLAYLIST_STATE_FILE_QUEUE_GENERATION "{}\n"),
+	       queue_generation);
+}
+
+void
+playlist_state_save_queue(BufferedOutputStream &os,
+			  const struct playlist &playlist,
+			  unsigned generation)
+{
+	/* the generation is appended to the "playlist_begin" line,
+	   where older MPD versions ignore it */
+	os.Fmt(FMT_STRING(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN " {}\n"),
+	       generation);
+	queue_save(os, playlist.queue);
+	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
+}
+
 static void
 playlist_state_load(LineReader &file, const SongLoader &song_loader,
-		    struct playlist &playlist)
+		    struct playlist &playlist,
+		    std::vector<unsigned> *lazy_ids)
 {
 	const char *line = file.ReadLine();
 	if (line == nullptr) {
@@ -104,7 +141,8 @@ playlist_state_load(LineReader &file, const SongLoader &song_loader,
 	}
 
 	while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
-		queue_load_song(file, song_loader, line, playlist.queue);
+		queue_load_song(file, song_loader, line, playlist.queue,
+				lazy_ids);
 
 		line = file.ReadLine();
 		if (line == nullptr) {
@@ -118,11 +156,43 @@ playlist_state_load(LineReader &file, const SongLoader &song_loader,
 	playlist.queue.IncrementVersion();
 }
 
+/**
+ * Load the queue from the separate file (#StateFileConfig::queue_path).
+ *
+ * @return false if the file does not belong to the state file (it
+ * was not written with the given generation number)
+ */
+static bool
+playlist_state_load_queue(Path path, unsigned generation,
+			  const SongLoader &song_loader,
+			  struct playlist &playlist,
+			  std::vector<unsigned> *lazy_ids)
+{
+	FileLineReader file{path};
+
+	const char *line = file.ReadLine();
+	if (line == nullptr ||
+	    (line = StringAfterPrefix(line, PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) == nullptr) {
+		LogWarning(playlist_domain, "No playlist in queue file");
+		return false;
+	}
+
+	/* the queue is loaded even if it was written by another
+	   generation (e.g. MPD was killed between writing the two
+	   files); only the position is not trustworthy then */
+	const bool consistent = *line == ' ' &&
+		ParseUint64(line + 1) == generation;
+
+	playlist_state_load(file, song_loader, playlist, lazy_ids);
+	return consistent;
+}
+
 bool
 playlist_state_restore(const StateFileConfig &config,
 		       const char *line, LineReader &file,
 		       const SongLoader &song_loader,
-		       struct playlist &playlist, PlayerControl &pc)
+		       struct playlist &playlist, PlayerControl &pc,
+		       bool lazy_load)
 {
 	int current = -1;
 	SongTime seek_time = SongTime::zero();
@@ -167,7 +237,37 @@ playlist_state_restore(const StateFileConfig &config,
 			current = atoi(p);
 		} else if (StringStartsWith(line,
 					    PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) {
-			playlist_state_load(file, song_loader, playlist);
+			std::vector<unsigned> lazy_ids;
+			playlist_state_load(file, song_loader, playlist,
+					    lazy_load ? &lazy_ids : nullptr);
+
+			/* this must be registered before playback
+			   starts, so the current song gets loaded on
+			   demand */
+			if (!lazy_ids.empty())
+				playlist.listener.OnQueueLazySongs(std::move(lazy_ids));
+		} else if ((p = StringAfterPrefix(line, PLAYLIST_STATE_FILE_QUEUE_GENERATION)) &&
+			   !config.queue_path.IsNull()) {
+			std::vector<unsigned> lazy_ids;
+
+			try {
+				if (!playlist_state_load_queue(config.queue_path,
+							       ParseUint64(p),
+							       song_loader,
+							       playlist,
+							       lazy_load ? &lazy_ids : nullptr)) {
+					LogWarning(playlist_domain,
+						   "Queue file does not match the state file");
+					state = PlayerState::STOP;
+					current = -1;
+				}
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to load the queue file");
+			}
+
+			if (!lazy_ids.empty())
+				playlist.listener.OnQueueLazySongs(std::move(lazy_ids));
 		}
 	}
 
@@ -20,11 +20,33 @@ void
 playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
 		    PlayerControl &pc);
 
+/**
+ * Save the playlist state without the queue; instead, refer to a
+ * queue file written by playlist_state_save_queue() with the same
+ * generation number.
+ */
+void
+playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
+		    PlayerControl &pc, unsigned queue_generation);
+
+/**
+ * Save only the queue, to be stored in a separate file (see
+ * #StateFileConfig::queue_path).
+ */
+void
+playlist_state_save_queue(BufferedOutputStream &os, const playlist &playlist,
+			  unsigned generation);
+
+/**
+ * @param lazy_load load the metadata of database songs in the
+ * background (see QueueListener::OnQueueLazySongs())
+ */
 bool
 playlist_state_restore(const StateFileConfig &config,
 		       const char *line, LineReader &file,
 		       const SongLoader &song_loader,
-		       playlist &playlist, PlayerControl &pc);
+		       playlist &playlist, PlayerControl &pc,
+		       bool lazy_load);
 
 /**
  * Generates a hash number for the current state of the playlist and
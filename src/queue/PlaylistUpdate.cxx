@@ -2,10 +2,13 @@
 // Copyright The Music Player Daemon Project
 
 #include "Playlist.hxx"
+#include "playlist/PlaylistSong.hxx"
 #include "db/Interface.hxx"
 #include "song/LightSong.hxx"
 #include "song/DetachedSong.hxx"
 
+#include <vector>
+
 static bool
 UpdatePlaylistSong(const Database &db, DetachedSong &song)
 {
@@ -55,3 +58,37 @@ playlist::DatabaseModified(const Database &db)
 	if (modified)
 		OnModified();
 }
+
+void
+playlist::LoadLazySongs(PlayerControl &pc, const SongLoader &loader,
+			std::span<const unsigned> ids) noexcept
+{
+	bool modified = false;
+	std::vector<unsigned> missing;
+
+	for (const unsigned id : ids) {
+		const int position = queue.IdToPosition(id);
+		if (position < 0)
+			/* deleted meanwhile */
+			continue;
+
+		if (playlist_check_load_song(queue.Get(position), loader)) {
+			queue.ModifyAtPosition(position);
+			modified = true;
+		} else
+			missing.push_back(id);
+	}
+
+	if (modified)
+		OnModified();
+
+	/* songs which are not in the database are removed, just
+	   like playlist_load_into_queue() skips them when not
+	   loading lazily */
+	for (const unsigned id : missing) {
+		try {
+			DeleteId(pc, id);
+		} catch (...) {
+		}
+	}
+}
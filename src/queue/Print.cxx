@@ -6,15 +6,22 @@
 #include "Selection.hxx"
 #include "song/Filter.hxx"
 #include "SongPrint.hxx"
+#include "BinarySongPrint.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "tag/Sort.hxx"
 #include "client/Response.hxx"
 #include "PlaylistError.hxx"
+#include "thread/WorkerPool.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/SpanCast.hxx"
 
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <list>
+#include <string>
 
 /**
  * Send detailed information about a range of songs in the queue to a
@@ -28,6 +35,15 @@ static void
 queue_print_song_info(Response &r, const Queue &queue,
 		      unsigned position)
 {
+	if (r.WantBinarySongs()) {
+		BinarySongWriter w(r);
+		w.AddSong(queue.Get(position), false);
+		w.AddQueuePosition(position, queue.PositionToId(position),
+				   queue.GetPriorityAtPosition(position));
+		w.Commit();
+		return;
+	}
+
 	song_print_info(r, queue.Get(position));
 	r.Fmt(FMT_STRING("Pos: {}\nId: {}\n"),
 	      position, queue.PositionToId(position));
@@ -37,13 +53,126 @@ queue_print_song_info(Response &r, const Queue &queue,
 		r.Fmt(FMT_STRING("Prio: {}\n"), priority);
 }
 
+/**
+ * Ranges larger than this are split into slices of this size which
+ * are formatted in parallel.
+ */
+static constexpr unsigned PARALLEL_SLICE_SIZE = 1024;
+
+namespace {
+
+/**
+ * Formats a slice of the queue in a #WorkerPool thread into a
+ * private buffer.
+ */
+class QueuePrintSliceJob final : public WorkerJob, ResponseSink {
+	const Response &parent;
+	const Queue &queue;
+	const unsigned begin, end;
+
+	Mutex &mutex;
+	Cond &cond;
+	unsigned &pending;
+
+public:
+	std::string buffer;
+
+	QueuePrintSliceJob(const Response &_parent, const Queue &_queue,
+			   unsigned _begin, unsigned _end,
+			   Mutex &_mutex, Cond &_cond,
+			   unsigned &_pending) noexcept
+		:parent(_parent), queue(_queue), begin(_begin), end(_end),
+		 mutex(_mutex), cond(_cond), pending(_pending) {}
+
+	/* virtual methods from class WorkerJob */
+	void Run() noexcept override {
+		Response r{parent, *this};
+		for (unsigned i = begin; i < end; ++i)
+			queue_print_song_info(r, queue, i);
+
+		const std::scoped_lock lock{mutex};
+		if (--pending == 0)
+			cond.notify_one();
+	}
+
+private:
+	/* virtual methods from class ResponseSink */
+	bool Write(std::span<const std::byte> src) noexcept override {
+		buffer.append(ToStringView(src));
+		return true;
+	}
+
+	bool IsCancelled() const noexcept override {
+		return false;
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * Format the first slice directly into the client's output buffer
+ * while the #WorkerPool formats the others into private buffers;
+ * then append those in order.  The calling (main) thread is blocked
+ * meanwhile, therefore the #Queue and the tags of its songs remain
+ * unmodified.
+ */
+static void
+queue_print_info_parallel(Response &r, const Queue &queue,
+			  unsigned start, unsigned end,
+			  WorkerPool &pool)
+{
+	Mutex mutex;
+	Cond cond;
+	unsigned pending = 0;
+
+	std::list<QueuePrintSliceJob> jobs;
+	for (unsigned begin = start + PARALLEL_SLICE_SIZE; begin < end;
+	     begin += PARALLEL_SLICE_SIZE) {
+		jobs.emplace_back(r, queue,
+				  begin,
+				  std::min(end - begin, PARALLEL_SLICE_SIZE) + begin,
+				  mutex, cond, pending);
+		++pending;
+	}
+
+	for (auto &job : jobs)
+		pool.Push(job, WorkerPriority::HIGH);
+
+	for (unsigned i = start; i < start + PARALLEL_SLICE_SIZE; ++i)
+		queue_print_song_info(r, queue, i);
+
+	/* the worker threads may be busy with other commands; don't
+	   wait for them, but format the slices which have not been
+	   started yet right here */
+	for (auto &job : jobs)
+		if (pool.Cancel(job))
+			job.Run();
+
+	{
+		std::unique_lock lock{mutex};
+		cond.wait(lock, [&pending]{ return pending == 0; });
+	}
+
+	for (const auto &job : jobs)
+		r.Write(job.buffer.data(), job.buffer.size());
+}
+
 void
 queue_print_info(Response &r, const Queue &queue,
-		 unsigned start, unsigned end)
+		 unsigned start, unsigned end,
+		 WorkerPool *pool)
 {
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
+	if (pool != nullptr && end - start > PARALLEL_SLICE_SIZE &&
+	    /* the binary encoding sends each tag name only once per
+	       response, which requires sequential formatting */
+	    !r.WantBinarySongs()) {
+		queue_print_info_parallel(r, queue, start, end, *pool);
+		return;
+	}
+
 	for (unsigned i = start; i < end; ++i)
 		queue_print_song_info(r, queue, i);
 }
@@ -69,9 +198,9 @@ queue_print_changes_info(Response &r, const Queue &queue,
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
-			queue_print_song_info(r, queue, i);
+	queue.ForEachNewer(version, start, end, [&r, &queue](unsigned i){
+		queue_print_song_info(r, queue, i);
+	});
 }
 
 void
@@ -82,21 +211,102 @@ queue_print_changes_position(Response &r, const Queue &queue,
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
-			r.Fmt(FMT_STRING("cpos: {}\nId: {}\n"),
-			      i, queue.PositionToId(i));
+	queue.ForEachNewer(version, start, end, [&r, &queue](unsigned i){
+		r.Fmt(FMT_STRING("cpos: {}\nId: {}\n"),
+		      i, queue.PositionToId(i));
+	});
+}
+
+static void
+PrintIds(Response &r, const std::vector<unsigned> &ids)
+{
+	for (const unsigned id : ids)
+		r.Fmt(FMT_STRING("Id: {}\n"), id);
+}
+
+static void
+PrintJournalEntry(Response &r, const QueueJournal::Entry &e)
+{
+	using Type = QueueJournal::Type;
+
+	const unsigned end = e.start + e.count;
+
+	switch (e.type) {
+	case Type::INSERT:
+		r.Fmt(FMT_STRING("insert: {}\n"), e.start);
+		PrintIds(r, e.ids);
+		break;
+
+	case Type::DELETE:
+		r.Fmt(FMT_STRING("delete: {}:{}\n"), e.start, end);
+		break;
+
+	case Type::MOVE:
+		r.Fmt(FMT_STRING("move: {}:{}\nto: {}\n"),
+		      e.start, end, e.to);
+		break;
+
+	case Type::SWAP:
+		r.Fmt(FMT_STRING("swap: {}\nto: {}\n"), e.start, e.to);
+		break;
+
+	case Type::MODIFY:
+		r.Fmt(FMT_STRING("modify: {}:{}\n"), e.start, end);
+		break;
+
+	case Type::REORDER:
+		r.Fmt(FMT_STRING("reorder: {}:{}\n"), e.start, end);
+		PrintIds(r, e.ids);
+		break;
+
+	case Type::CLEAR:
+		r.Write("delete: 0:\n");
+		break;
+	}
+}
+
+bool
+queue_print_edits(Response &r, const Queue &queue, uint32_t version)
+{
+	if (!queue.journal.IsAvailable(version, queue.version))
+		return false;
+
+	queue.journal.ForEachSince(version, [&r](const auto &e){
+		PrintJournalEntry(r, e);
+	});
+
+	return true;
+}
+
+/**
+ * Invoke the given function for each position (in ascending order)
+ * which matches the #QueueSelection until it returns false.
+ */
+template<typename F>
+static void
+ForEachMatch(const Queue &queue, const QueueSelection &selection, F &&f)
+{
+	if (const auto candidates = selection.FindCandidates(queue)) {
+		for (const unsigned i : *candidates)
+			if (selection.MatchPosition(queue, i) && !f(i))
+				return;
+		return;
+	}
+
+	for (unsigned i = 0; i < queue.GetLength(); i++)
+		if (selection.MatchPosition(queue, i) && !f(i))
+			return;
 }
 
-[[gnu::pure]]
 static std::vector<unsigned>
 CollectQueue(const Queue &queue, const QueueSelection &selection) noexcept
 {
 	std::vector<unsigned> v;
 
-	for (unsigned i = 0; i < queue.GetLength(); i++)
-		if (selection.MatchPosition(queue, i))
-			v.emplace_back(i);
+	ForEachMatch(queue, selection, [&v](unsigned i){
+		v.emplace_back(i);
+		return true;
+	});
 
 	return v;
 }
@@ -183,18 +393,13 @@ PrintQueue(Response &r, const Queue &queue,
 	unsigned skip = window.start;
 	unsigned n = window.Count();
 
-	for (unsigned i = 0; i < queue.GetLength(); i++) {
-		if (!selection.MatchPosition(queue, i))
-			continue;
-
+	ForEachMatch(queue, selection, [&](unsigned i){
 		if (skip > 0) {
 			--skip;
-			continue;
+			return true;
 		}
 
 		queue_print_song_info(r, queue, i);
-
-		if (--n == 0)
-			break;
-	}
+		return --n > 0;
+	});
 }
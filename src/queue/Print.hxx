@@ -13,10 +13,17 @@
 struct Queue;
 struct QueueSelection;
 class Response;
+class WorkerPool;
 
+/**
+ * @param pool if not nullptr, then large ranges are split into
+ * slices which are formatted in parallel by this #WorkerPool; the
+ * caller must not modify the #Queue until this function returns
+ */
 void
 queue_print_info(Response &r, const Queue &queue,
-		 unsigned start, unsigned end);
+		 unsigned start, unsigned end,
+		 WorkerPool *pool=nullptr);
 
 void
 queue_print_uris(Response &r, const Queue &queue,
@@ -32,6 +39,15 @@ queue_print_changes_position(Response &r, const Queue &queue,
 			     uint32_t version,
 			     unsigned start, unsigned end);
 
+/**
+ * Print the structural modifications since the specified version
+ * from the #QueueJournal.
+ *
+ * @return false if the journal does not reach back to this version
+ */
+bool
+queue_print_edits(Response &r, const Queue &queue, uint32_t version);
+
 void
 PrintQueue(Response &response, const Queue &queue,
 	   const QueueSelection &selection);
@@ -2,25 +2,41 @@
 // Copyright The Music Player Daemon Project
 
 #include "Queue.hxx"
+#include "Index.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 
 #include <algorithm>
+#include <array>
+#include <vector>
+
+/**
+ * Generate a pseudo-random heap key for a #SequenceTree node from
+ * the song id (using the MurmurHash3 finalizer).  This does not use
+ * Queue::rand, because that would change the outcome of "shuffle"
+ * and random mode.
+ */
+static constexpr uint32_t
+MakeKey(uint32_t id) noexcept
+{
+	id ^= id >> 16;
+	id *= 0x85ebca6b;
+	id ^= id >> 13;
+	id *= 0xc2b2ae35;
+	id ^= id >> 16;
+	return id;
+}
 
 Queue::Queue(unsigned _max_length) noexcept
 	:max_length(_max_length),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
-	 id_table(max_length * HASH_MULT)
+	 id_table(max_length * HASH_MULT),
+	 journal(std::size_t(max_length) * JOURNAL_MULT)
 {
 }
 
 Queue::~Queue() noexcept
 {
 	Clear();
-
-	delete[] items;
-	delete[] order;
 }
 
 LightSong
@@ -58,10 +74,14 @@ Queue::IncrementVersion() noexcept
 	version++;
 
 	if (version >= max) {
-		for (unsigned i = 0; i < length; i++)
-			items[i].version = 0;
+		items.ForEach([](Node &node){
+			node.version = 0;
+			node.subtree_version = 0;
+			node.min_version = node.max_version = 0;
+		});
 
 		version = 1;
+		journal.Reset(version);
 	}
 }
 
@@ -70,8 +90,7 @@ Queue::ModifyAtOrder(unsigned _order) noexcept
 {
 	assert(_order < length);
 
-	unsigned position = order[_order];
-	ModifyAtPosition(position);
+	ModifyAtPosition(OrderToPosition(_order));
 }
 
 unsigned
@@ -80,111 +99,73 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 	assert(!IsFull());
 
 	const unsigned position = length++;
-	const unsigned id = id_table.Insert(position);
 
-	auto &item = items[position];
-	item.song = new DetachedSong(std::move(song));
-	item.id = id;
-	item.version = version;
-	item.priority = priority;
+	auto *node = new Node();
+	node->song = new DetachedSong(std::move(song));
+	node->id = id_table.Insert(*node);
+	node->version = version;
+	node->priority = priority;
+	node->key = MakeKey(node->id);
+	node->subtree_version = 0;
+
+	items.PushBack(*node);
+	order.PushBack(*node);
+
+	const unsigned id = node->id;
+	journal.Insert(version, position, id);
 
-	order[position] = position;
+	if (index)
+		index->Add(id, node->song->GetTag());
 
 	return id;
 }
 
 void
-Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
+Queue::SwapItems(unsigned position1, unsigned position2) noexcept
 {
-	unsigned id1 = items[position1].id;
-	unsigned id2 = items[position2].id;
+	/* the "order" list refers to positions, not to songs; so
+	   the two songs swap their order numbers as well */
+	const unsigned order1 = PositionToOrder(position1);
+	const unsigned order2 = PositionToOrder(position2);
 
-	std::swap(items[position1], items[position2]);
+	items.Swap(position1, position2);
+	order.Swap(order1, order2);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	SetVersion(items[position1]);
+	SetVersion(items[position2]);
+}
 
-	id_table.Move(id1, position2);
-	id_table.Move(id2, position1);
+void
+Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
+{
+	SwapItems(position1, position2);
+	journal.Swap(version, position1, position2);
 }
 
 void
 Queue::MovePostion(unsigned from, unsigned to) noexcept
 {
-	const Item tmp = items[from];
-
-	/* move songs to one less in from->to */
-
-	for (unsigned i = from; i < to; i++)
-		MoveItemTo(i + 1, i);
-
-	/* move songs to one more in to->from */
-
-	for (unsigned i = from; i > to; i--)
-		MoveItemTo(i - 1, i);
-
-	/* put song at _to_ */
-
-	id_table.Move(tmp.id, to);
-	items[to] = tmp;
-	items[to].version = version;
-
-	/* now deal with order */
-
-	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
-		}
-	}
+	MoveRange(from, from + 1, to);
 }
 
 void
 Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 {
-	const auto tmp = std::make_unique<Item[]>(end - start);
+	assert(start <= end);
+	assert(end <= length);
+	assert(to + (end - start) <= length);
 
-	// Copy the original block [start,end-1]
-	for (unsigned i = start; i < end; i++)
-		tmp[i - start] = items[i];
-
-	// If to > start, we need to move to-start items to start, starting from end
-	for (unsigned i = end; i < end + to - start; i++)
-		MoveItemTo(i, start + i - end);
-
-	// If to < start, we need to move start-to items to newend (= end + to - start), starting from to
-	// This is the same as moving items from start-1 to to (decreasing), with start-1 going to end-1
-	// We have to iterate in this order to avoid writing over something we haven't yet moved
-	for (int i = start - 1; i >= int(to); i--)
-		MoveItemTo(i, i + end - start);
-
-	// Copy the original block back in, starting at to.
-	for (unsigned i = start; i< end; i++)
-	{
-		id_table.Move(tmp[i - start].id, to + i - start);
-		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
-	}
+	items.MoveRange(start, end, to);
 
-	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
-		}
-	}
+	if (!random)
+		/* without random mode, "order" equals "position" */
+		order.MoveRange(start, end, to);
+
+	/* all songs between the old and the new location have
+	   changed their positions */
+	ModifyRange(std::min(start, to), std::max(end, to + end - start));
+
+	journal.Move(version, start, end, to);
 }
 
 unsigned
@@ -193,17 +174,9 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order) noexcept
 	assert(from_order < length);
 	assert(to_order <= length);
 
-	const unsigned from_position = OrderToPosition(from_order);
-
-	if (from_order < to_order) {
-		for (unsigned i = from_order; i < to_order; ++i)
-			order[i] = order[i + 1];
-	} else {
-		for (unsigned i = from_order; i > to_order; --i)
-			order[i] = order[i - 1];
-	}
-
-	order[to_order] = from_position;
+	auto &node = order[from_order];
+	order.Erase(node);
+	order.Insert(std::min(to_order, order.size()), node);
 	return to_order;
 }
 
@@ -230,66 +203,47 @@ Queue::DeletePosition(unsigned position) noexcept
 {
 	assert(position < length);
 
-	delete items[position].song;
+	auto &node = items[position];
 
-	const unsigned id = PositionToId(position);
-	const unsigned _order = PositionToOrder(position);
+	if (index)
+		index->Remove(node.id);
 
-	--length;
+	delete node.song;
 
 	/* release the song id */
 
-	id_table.Erase(id);
+	id_table.Erase(node.id);
 
-	/* delete song from songs array */
-
-	for (unsigned i = position; i < length; i++)
-		MoveItemTo(i + 1, i);
+	--length;
 
-	/* delete the entry from the order array */
+	items.Erase(node);
+	order.Erase(node);
+	delete &node;
 
-	for (unsigned i = _order; i < length; i++)
-		order[i] = order[i + 1];
+	/* all following songs have moved */
 
-	/* readjust values in the order array */
+	ModifyRange(position, length);
 
-	for (unsigned i = 0; i < length; i++)
-		if (order[i] > position)
-			--order[i];
+	journal.Delete(version, position);
 }
 
 void
 Queue::Clear() noexcept
 {
-	for (unsigned i = 0; i < length; i++) {
-		Item *item = &items[i];
+	order.Clear();
+	items.ClearAndDispose([this](Node &node){
+		delete node.song;
 
-		delete item->song;
+		id_table.Erase(node.id);
 
-		id_table.Erase(item->id);
-	}
+		delete &node;
+	});
 
 	length = 0;
 	last_loaded_playlist.clear();
-}
-
-static void
-queue_sort_order_by_priority(Queue *queue,
-			     unsigned start, unsigned end) noexcept
-{
-	assert(queue != nullptr);
-	assert(queue->random);
-	assert(start <= end);
-	assert(end <= queue->length);
-
-	auto cmp = [queue](unsigned a_pos, unsigned b_pos){
-		const Queue::Item &a = queue->items[a_pos];
-		const Queue::Item &b = queue->items[b_pos];
-
-		return a.priority > b.priority;
-	};
+	index.reset();
 
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
+	journal.Clear(version);
 }
 
 void
@@ -300,7 +254,9 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 	assert(end <= length);
 
 	rand.AutoCreate();
-	std::shuffle(order + start, order + end, rand);
+	order.Rearrange(start, end, [this](auto &v){
+		std::shuffle(v.begin(), v.end(), rand);
+	});
 }
 
 /**
@@ -317,28 +273,42 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end) noexcept
 	if (start == end)
 		return;
 
-	/* first group the range by priority */
-	queue_sort_order_by_priority(this, start, end);
-
-	/* now shuffle each priority group */
-	unsigned group_start = start;
-	uint8_t group_priority = GetOrderPriority(start);
+	rand.AutoCreate();
 
-	for (unsigned i = start + 1; i < end; ++i) {
-		const uint8_t priority = GetOrderPriority(i);
-		assert(priority <= group_priority);
+	order.Rearrange(start, end, [this](auto &v){
+		/* first group the range by priority (descending);
+		   there are only 256 priorities, so a counting sort
+		   does this in O(n) */
+		std::array<unsigned, 256> counts{};
+		for (const auto *node : v)
+			++counts[node->priority];
+
+		std::array<unsigned, 256> group_starts;
+		unsigned n = 0;
+		for (int priority = 255; priority >= 0; --priority) {
+			group_starts[priority] = n;
+			n += counts[priority];
+		}
 
-		if (priority != group_priority) {
-			/* start of a new group - shuffle the one that
-			   has just ended */
-			ShuffleOrderRange(group_start, i);
-			group_start = i;
-			group_priority = priority;
+		std::vector<Node *> sorted(v.size());
+		auto next = group_starts;
+		for (auto *node : v)
+			sorted[next[node->priority]++] = node;
+
+		/* now shuffle each priority group */
+		for (unsigned priority = 0; priority < 256; ++priority) {
+			if (counts[priority] < 2)
+				continue;
+
+			const auto group_start = std::next(sorted.begin(),
+							   group_starts[priority]);
+			std::shuffle(group_start,
+				     std::next(group_start, counts[priority]),
+				     rand);
 		}
-	}
 
-	/* shuffle the last group */
-	ShuffleOrderRange(group_start, end);
+		v = std::move(sorted);
+	});
 }
 
 void
@@ -356,8 +326,8 @@ Queue::ShuffleOrderFirst(unsigned start, unsigned end) noexcept
 	SwapOrders(start, distribution(rand));
 }
 
-void
-Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept
+inline unsigned
+Queue::FindLastGroup(unsigned start, unsigned end) const noexcept
 {
 	assert(end <= length);
 	assert(start < end);
@@ -365,11 +335,24 @@ Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept
 	/* skip all items at the start which have a higher priority,
 	   because the last item shall only be shuffled within its
 	   priority group */
-	const auto last_priority = items[OrderToPosition(end - 1)].priority;
-	while (items[OrderToPosition(start)].priority != last_priority) {
-		++start;
-		assert(start < end);
-	}
+	const auto last_priority = GetOrderPriority(end - 1);
+	start = order.FindFirst(start,
+				[last_priority](const Node &subtree){
+					return subtree.min_priority <= last_priority &&
+						subtree.max_priority >= last_priority;
+				},
+				[last_priority](const Node &node){
+					return node.priority == last_priority;
+				});
+	assert(start < end);
+
+	return start;
+}
+
+void
+Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept
+{
+	start = FindLastGroup(start, end);
 
 	rand.AutoCreate();
 
@@ -377,6 +360,25 @@ Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept
 	SwapOrders(end - 1, distribution(rand));
 }
 
+void
+Queue::ShuffleOrderLastGroup(unsigned start, unsigned end,
+			     unsigned n) noexcept
+{
+	start = FindLastGroup(start, end);
+	n = std::min(n, end - start);
+
+	rand.AutoCreate();
+
+	/* the older items of the group have already been shuffled;
+	   continue the "inside-out" Fisher-Yates shuffle with the new
+	   ones, which costs O(n log length) instead of shuffling the
+	   whole group */
+	for (unsigned i = end - n; i < end; ++i) {
+		std::uniform_int_distribution<unsigned> distribution(start, i);
+		SwapOrders(i, distribution(rand));
+	}
+}
+
 void
 Queue::ShuffleRange(unsigned start, unsigned end) noexcept
 {
@@ -385,12 +387,44 @@ Queue::ShuffleRange(unsigned start, unsigned end) noexcept
 
 	rand.AutoCreate();
 
-	for (unsigned i = start; i < end; i++) {
-		std::uniform_int_distribution<unsigned> distribution(start,
-								     end - 1);
-		unsigned ri = distribution(rand);
-		SwapPositions(i, ri);
-	}
+	/* the "order" list refers to positions, not to songs; so
+	   remember the order numbers of these positions */
+	std::vector<unsigned> orders;
+	orders.reserve(end - start);
+	for (unsigned i = start; i < end; i++)
+		orders.push_back(PositionToOrder(i));
+
+	std::vector<unsigned> ids;
+	ids.reserve(end - start);
+
+	std::vector<Node *> shuffled;
+
+	items.Rearrange(start, end, [this, start, end, &ids, &shuffled](auto &v){
+		for (unsigned i = start; i < end; i++) {
+			std::uniform_int_distribution<unsigned> distribution(start,
+									     end - 1);
+			unsigned ri = distribution(rand);
+			std::swap(v[i - start], v[ri - start]);
+		}
+
+		for (auto *node : v) {
+			node->version = version;
+			ids.push_back(node->id);
+		}
+
+		shuffled = v;
+	});
+
+	/* assign the old order numbers to the songs now occupying
+	   these positions */
+	auto v = order.ToVector();
+	for (unsigned i = 0; i < orders.size(); ++i)
+		v[orders[i]] = shuffled[i];
+	order.Assign(v);
+
+	/* record the result as one entry instead of one per
+	   swap */
+	journal.Reorder(version, start, std::move(ids));
 }
 
 unsigned
@@ -400,14 +434,20 @@ Queue::FindPriorityOrder(unsigned start_order, uint8_t priority,
 	assert(random);
 	assert(start_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority <= priority && i != exclude_order)
-			return i;
-	}
+	auto subtree_predicate = [priority](const Node &subtree){
+		return subtree.min_priority <= priority;
+	};
+
+	auto node_predicate = [priority](const Node &node){
+		return node.priority <= priority;
+	};
+
+	unsigned i = order.FindFirst(start_order, subtree_predicate,
+				     node_predicate);
+	if (i == exclude_order)
+		i = order.FindFirst(i + 1, subtree_predicate, node_predicate);
 
-	return length;
+	return i;
 }
 
 unsigned
@@ -416,14 +456,14 @@ Queue::CountSamePriority(unsigned start_order, uint8_t priority) const noexcept
 	assert(random);
 	assert(start_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority != priority)
-			return i - start_order;
-	}
-
-	return length - start_order;
+	return order.FindFirst(start_order,
+			       [priority](const Node &subtree){
+				       return subtree.min_priority != priority ||
+					       subtree.max_priority != priority;
+			       },
+			       [priority](const Node &node){
+				       return node.priority != priority;
+			       }) - start_order;
 }
 
 bool
@@ -432,13 +472,15 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 {
 	assert(position < length);
 
-	Item *item = &items[position];
-	uint8_t old_priority = item->priority;
+	Node &node = items[position];
+	uint8_t old_priority = node.priority;
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
-	item->priority = priority;
+	node.priority = priority;
+	SetVersion(node);
+	OrderTree::UpdatePath(node);
+	journal.Modify(version, position);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
@@ -456,12 +498,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 			   increased and is now bigger than the
 			   current one's */
 
-			const unsigned after_position =
-				OrderToPosition(after_order);
-			const Item *after_item =
-				&items[after_position];
 			if (priority <= old_priority ||
-			    priority <= after_item->priority)
+			    priority <= GetOrderPriority(after_order))
 				/* priority hasn't become bigger */
 				return true;
 		}
@@ -507,3 +545,27 @@ Queue::SetPriorityRange(unsigned start_position, unsigned end_position,
 
 	return modified;
 }
+
+const QueueIndex *
+Queue::GetIndex() const noexcept
+{
+	if (!index) {
+		if (length < INDEX_MIN_LENGTH)
+			return nullptr;
+
+		index = std::make_unique<QueueIndex>();
+		items.ForEach([this](const Node &node){
+			index->Add(node.id, node.song->GetTag());
+		});
+	}
+
+	return index.get();
+}
+
+void
+Queue::UpdateIndex(const Node &node) noexcept
+{
+	assert(index);
+
+	index->Update(node.id, node.song->GetTag());
+}
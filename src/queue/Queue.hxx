@@ -5,16 +5,21 @@
 #define MPD_QUEUE_HXX
 
 #include "IdTable.hxx"
+#include "Journal.hxx"
+#include "SequenceTree.hxx"
 #include "SingleMode.hxx"
 #include "ConsumeMode.hxx"
 #include "util/LazyRandomEngine.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <memory>
 #include <utility>
 
 struct LightSong;
 class DetachedSong;
+class QueueIndex;
 
 /**
  * A queue of songs.  This is the backend of the playlist: it contains
@@ -25,6 +30,10 @@ class DetachedSong;
  * - the position in the queue
  * - the unique id (which stays the same, regardless of moves)
  * - the order number (which only differs from "position" in random mode)
+ *
+ * Each item is a member of two #SequenceTree instances: one in
+ * "position" order and one in "order" order.  This makes all
+ * lookups and modifications O(log n), even for very large queues.
  */
 struct Queue {
 	/**
@@ -33,6 +42,12 @@ struct Queue {
 	 */
 	static constexpr unsigned HASH_MULT = 4;
 
+	/**
+	 * The #journal may contain up to max_length * JOURNAL_MULT
+	 * entries and ids.
+	 */
+	static constexpr unsigned JOURNAL_MULT = 4;
+
 	/**
 	 * One element of the queue: basically a song plus some queue specific
 	 * information attached.
@@ -43,7 +58,10 @@ struct Queue {
 		/** the unique id of this item in the queue */
 		unsigned id;
 
-		/** when was this item last changed? */
+		/**
+		 * When was this item last changed?  This may be
+		 * outdated; see Node::subtree_version.
+		 */
 		uint32_t version;
 
 		/**
@@ -54,6 +72,119 @@ struct Queue {
 		uint8_t priority;
 	};
 
+	struct Node : Item {
+		SequenceTreeLink<Node> position_link, order_link;
+
+		/**
+		 * The (random) heap key for both #SequenceTree
+		 * instances.
+		 */
+		uint32_t key;
+
+		/**
+		 * A lazy modification of the "position" tree: all
+		 * items in this subtree have been changed at this
+		 * version.  This allows moving a range of songs
+		 * without touching each of them.
+		 */
+		uint32_t subtree_version;
+
+		/**
+		 * The lowest and highest version in this subtree of
+		 * the "position" tree (not including this node's
+		 * #subtree_version).
+		 */
+		uint32_t min_version, max_version;
+
+		/**
+		 * The effective lowest and highest version in this
+		 * subtree of the "position" tree.
+		 */
+		std::pair<uint32_t, uint32_t> GetVersionRange() const noexcept {
+			return {
+				std::max(min_version, subtree_version),
+				std::max(max_version, subtree_version),
+			};
+		}
+
+		/**
+		 * The lowest and highest priority in this subtree of
+		 * the "order" tree.
+		 */
+		uint8_t min_priority, max_priority;
+	};
+
+	struct PositionTraits {
+		static uint32_t GetKey(const Node &node) noexcept {
+			return node.key;
+		}
+
+		static void PushDown(Node &node) noexcept {
+			if (node.subtree_version == 0)
+				return;
+
+			node.version = std::max(node.version,
+						node.subtree_version);
+			node.min_version = std::max(node.min_version,
+						    node.subtree_version);
+			node.max_version = std::max(node.max_version,
+						    node.subtree_version);
+
+			for (Node *child : {node.position_link.left,
+					    node.position_link.right})
+				if (child != nullptr)
+					child->subtree_version =
+						std::max(child->subtree_version,
+							 node.subtree_version);
+
+			node.subtree_version = 0;
+		}
+
+		static void Update(Node &node) noexcept {
+			node.min_version = node.max_version = node.version;
+
+			for (const Node *child : {node.position_link.left,
+						  node.position_link.right}) {
+				if (child != nullptr) {
+					const auto [min, max] =
+						child->GetVersionRange();
+					node.min_version =
+						std::min(node.min_version, min);
+					node.max_version =
+						std::max(node.max_version, max);
+				}
+			}
+		}
+	};
+
+	struct OrderTraits {
+		static uint32_t GetKey(const Node &node) noexcept {
+			return node.key;
+		}
+
+		static void PushDown(Node &) noexcept {}
+
+		static void Update(Node &node) noexcept {
+			node.min_priority = node.max_priority = node.priority;
+
+			for (const Node *child : {node.order_link.left,
+						  node.order_link.right}) {
+				if (child != nullptr) {
+					node.min_priority =
+						std::min(node.min_priority,
+							 child->min_priority);
+					node.max_priority =
+						std::max(node.max_priority,
+							 child->max_priority);
+				}
+			}
+		}
+	};
+
+	using PositionTree = SequenceTree<Node, &Node::position_link,
+					  PositionTraits>;
+	using OrderTree = SequenceTree<Node, &Node::order_link, OrderTraits>;
+
 	/** configured maximum length of the queue */
 	const unsigned max_length;
 
@@ -64,13 +195,29 @@ struct Queue {
 	uint32_t version = 1;
 
 	/** all songs in "position" order */
-	Item *const items;
+	PositionTree items;
+
+	/** all songs in "order" order */
+	OrderTree order;
 
-	/** map order numbers to positions */
-	unsigned *const order;
+	/** map song ids to items */
+	IdTable<Node> id_table;
 
-	/** map song ids to positions */
-	IdTable id_table;
+	/** structural modifications, for "plchangesdiff" */
+	QueueJournal journal;
+
+	/**
+	 * The queue is only indexed if it has at least this many
+	 * songs; below that, a linear search is fast enough.
+	 */
+	static constexpr unsigned INDEX_MIN_LENGTH = 1024;
+
+	/**
+	 * An index of the songs' tags for "playlistfind" and
+	 * "playlistsearch".  It is created on demand by GetIndex()
+	 * and then updated by all methods which modify the queue.
+	 */
+	mutable std::unique_ptr<QueueIndex> index;
 
 	/** repeat playback when the end of the queue has been
 	    reached? */
@@ -134,7 +281,10 @@ struct Queue {
 	}
 
 	int IdToPosition(unsigned id) const noexcept {
-		return id_table.IdToPosition(id);
+		const Node *node = id_table.Lookup(id);
+		return node != nullptr
+			? (int)PositionTree::IndexOf(*node)
+			: -1;
 	}
 
 	int PositionToId(unsigned position) const noexcept {
@@ -147,19 +297,14 @@ struct Queue {
 	unsigned OrderToPosition(unsigned _order) const noexcept {
 		assert(_order < length);
 
-		return order[_order];
+		return PositionTree::IndexOf(order[_order]);
 	}
 
 	[[gnu::pure]]
 	unsigned PositionToOrder(unsigned position) const noexcept {
 		assert(position < length);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return OrderTree::IndexOf(items[position]);
 	}
 
 	[[gnu::pure]]
@@ -169,14 +314,11 @@ struct Queue {
 		return items[position].priority;
 	}
 
-	const Item &GetOrderItem(unsigned i) const noexcept {
+	[[gnu::pure]]
+	uint8_t GetOrderPriority(unsigned i) const noexcept {
 		assert(IsValidOrder(i));
 
-		return items[OrderToPosition(i)];
-	}
-
-	uint8_t GetOrderPriority(unsigned i) const noexcept {
-		return GetOrderItem(i).priority;
+		return order[i].priority;
 	}
 
 	/**
@@ -208,9 +350,10 @@ struct Queue {
 			       uint32_t _version) const noexcept {
 		assert(position < length);
 
+		const uint32_t item_version = GetVersion(items[position]);
 		return _version > version ||
-			items[position].version >= _version ||
-			items[position].version == 0;
+			item_version >= _version ||
+			item_version == 0;
 	}
 
 	/**
@@ -236,7 +379,33 @@ struct Queue {
 	void ModifyAtPosition(unsigned position) noexcept {
 		assert(position < length);
 
-		items[position].version = version;
+		SetVersion(items[position]);
+		journal.Modify(version, position);
+
+		if (index)
+			UpdateIndex(items[position]);
+	}
+
+	/**
+	 * Invoke a function for each position in the range
+	 * [start,end) whose song is newer than the specified version
+	 * (see IsNewerAtPosition()).  Subtrees without changes are
+	 * skipped, which makes this much faster than checking each
+	 * position.
+	 */
+	template<typename F>
+	void ForEachNewer(uint32_t _version, unsigned start, unsigned end,
+			  F &&f) const {
+		assert(start <= end);
+		assert(end <= length);
+
+		if (_version > version) {
+			for (unsigned i = start; i < end; ++i)
+				f(i);
+			return;
+		}
+
+		ForEachNewer(items.GetRoot(), 0, 0, _version, start, end, f);
 	}
 
 	/**
@@ -267,7 +436,7 @@ struct Queue {
 	 * Swaps two songs, addressed by their order number.
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) noexcept {
-		std::swap(order[order1], order[order2]);
+		order.Swap(order1, order2);
 	}
 
 	/**
@@ -319,8 +488,7 @@ struct Queue {
 	 * Initializes the "order" array, and restores "normal" order.
 	 */
 	void RestoreOrder() noexcept {
-		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+		order.Assign(items.ToVector());
 	}
 
 	/**
@@ -352,6 +520,15 @@ struct Queue {
 	 */
 	void ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept;
 
+	/**
+	 * Shuffles the last #n songs of the specified (order) range
+	 * into the priority group of the last song.  This is used in
+	 * random mode after several songs with the same priority have
+	 * been appended by Append().
+	 */
+	void ShuffleOrderLastGroup(unsigned start, unsigned end,
+				   unsigned n) noexcept;
+
 	/**
 	 * Shuffles a (position) range in the queue.  The songs are physically
 	 * shuffled, not by using the "order" mapping.
@@ -364,15 +541,98 @@ struct Queue {
 	bool SetPriorityRange(unsigned start_position, unsigned end_position,
 			      uint8_t priority, int after_order) noexcept;
 
+	/**
+	 * Returns the tag index, building it if necessary.
+	 *
+	 * @return the index or nullptr if the queue is too short to
+	 * be indexed
+	 */
+	const QueueIndex *GetIndex() const noexcept;
+
 private:
-	void MoveItemTo(unsigned from, unsigned to) noexcept {
-		unsigned from_id = items[from].id;
+	/**
+	 * The tags of this item may have been modified.
+	 */
+	void UpdateIndex(const Node &node) noexcept;
+
+	/**
+	 * Like SwapPositions(), but don't record it in the #journal.
+	 */
+	void SwapItems(unsigned position1, unsigned position2) noexcept;
 
-		items[to] = items[from];
-		items[to].version = version;
-		id_table.Move(from_id, to);
+	/**
+	 * Mark all items in the specified position range as
+	 * "modified".
+	 */
+	void ModifyRange(unsigned start, unsigned end) noexcept {
+		items.ApplyRange(start, end, [this](Node &node){
+			node.subtree_version = version;
+		});
+	}
+
+	void SetVersion(Node &node) noexcept {
+		node.version = version;
+		PositionTree::UpdatePath(node);
 	}
 
+	template<typename F>
+	static void ForEachNewer(const Node *node, unsigned offset,
+				 uint32_t inherited_version,
+				 uint32_t _version,
+				 unsigned start, unsigned end, F &f) {
+		while (node != nullptr) {
+			const auto &link = node->position_link;
+			if (offset >= end || offset + link.size <= start)
+				return;
+
+			inherited_version = std::max(inherited_version,
+						     node->subtree_version);
+
+			const auto [min, max] = node->GetVersionRange();
+			if (std::max(max, inherited_version) < _version &&
+			    std::max(min, inherited_version) != 0)
+				/* nothing has changed in this subtree */
+				return;
+
+			const unsigned left_size = link.left != nullptr
+				? link.left->position_link.size
+				: 0;
+
+			ForEachNewer(link.left, offset, inherited_version,
+				     _version, start, end, f);
+
+			const unsigned position = offset + left_size;
+			const uint32_t node_version =
+				std::max(node->version, inherited_version);
+			if (position >= start && position < end &&
+			    (node_version >= _version || node_version == 0))
+				f(position);
+
+			offset = position + 1;
+			node = link.right;
+		}
+	}
+
+	/**
+	 * Determine the version of an item, taking lazy
+	 * modifications (Node::subtree_version) into account.
+	 */
+	[[gnu::pure]]
+	static uint32_t GetVersion(const Node &node) noexcept {
+		uint32_t result = node.version;
+		PositionTree::ForEachAncestor(node, [&result](const Node &i){
+			result = std::max(result, i.subtree_version);
+		});
+		return result;
+	}
+
+	/**
+	 * Find the first order number of the priority group of the
+	 * last song in the specified (order) range.
+	 */
+	[[gnu::pure]]
+	unsigned FindLastGroup(unsigned start, unsigned end) const noexcept;
+
 	/**
 	 * Find the first item that has this specified priority or
 	 * higher.
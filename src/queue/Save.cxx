@@ -7,10 +7,17 @@
 #include "song/DetachedSong.hxx"
 #include "SongSave.hxx"
 #include "playlist/PlaylistSong.hxx"
+#include "SongLoader.hxx"
 #include "io/LineReader.hxx"
 #include "io/BufferedOutputStream.hxx"
+#include "fs/Traits.hxx"
 #include "util/StringCompare.hxx"
 #include "Log.hxx"
+#include "config.h"
+
+#ifdef ENABLE_DATABASE
+#include "storage/StorageInterface.hxx"
+#endif
 
 #include <fmt/format.h>
 
@@ -79,9 +86,37 @@ LoadQueueSong(LineReader &file, const char *line)
 	}
 }
 
+/**
+ * Can this song (loaded from the long format) be used as-is, without
+ * loading it again with the #SongLoader?  This is true for local files
+ * outside of the music directory whose tags were saved; scanning all
+ * of them again would make restoring a large queue slow.  Whether
+ * the file still exists is checked when it gets played.
+ */
+[[gnu::pure]]
+static bool
+IsSavedLocalFile(const DetachedSong &song,
+		 [[maybe_unused]] const SongLoader &loader) noexcept
+{
+	if (!song.GetTag().IsDefined() || !song.IsAbsoluteFile())
+		return false;
+
+#ifdef ENABLE_DATABASE
+	/* files inside the music directory are translated to
+	   database songs by the SongLoader */
+	if (const Storage *storage = loader.GetStorage();
+	    storage != nullptr &&
+	    storage->MapToRelativeUTF8(song.GetURI()).data() != nullptr)
+		return false;
+#endif
+
+	return true;
+}
+
 void
 queue_load_song(LineReader &file, const SongLoader &loader,
-		const char *line, Queue &queue)
+		const char *line, Queue &queue,
+		std::vector<unsigned> *lazy_ids)
 {
 	if (queue.IsFull())
 		return;
@@ -98,7 +133,23 @@ queue_load_song(LineReader &file, const SongLoader &loader,
 
 	auto song = LoadQueueSong(file, line);
 
-	if (!playlist_check_translate_song(song, {}, loader))
+	if (lazy_ids != nullptr) {
+		playlist_translate_song_uri(song, {});
+
+		if (!PathTraitsUTF8::IsAbsoluteOrHasScheme(song.GetURI())) {
+			/* a database song: load it later */
+			const unsigned position =
+				queue.Append(std::move(song), priority);
+			lazy_ids->push_back(queue.PositionToId(position));
+			return;
+		}
+
+		if (!IsSavedLocalFile(song, loader) &&
+		    !playlist_check_load_song(song, loader))
+			return;
+	} else if (IsSavedLocalFile(song, loader))
+		playlist_translate_song_uri(song, {});
+	else if (!playlist_check_translate_song(song, {}, loader))
 		return;
 
 	queue.Append(std::move(song), priority);
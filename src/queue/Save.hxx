@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <vector>
+
 struct Queue;
 class BufferedOutputStream;
 class LineReader;
@@ -20,7 +22,12 @@ queue_save(BufferedOutputStream &os, const Queue &queue);
  * Loads one song from the state file and appends it to the queue.
  *
  * Throws on error.
+ *
+ * @param lazy_ids if not nullptr, then database songs are appended
+ * without looking them up in the database, and their queue ids are
+ * appended to this vector (see QueueListener::OnQueueLazySongs())
  */
 void
 queue_load_song(LineReader &file, const SongLoader &loader,
-		const char *line, Queue &queue);
+		const char *line, Queue &queue,
+		std::vector<unsigned> *lazy_ids=nullptr);
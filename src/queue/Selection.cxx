@@ -3,9 +3,14 @@
 
 #include "Selection.hxx"
 #include "Queue.hxx"
+#include "Index.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/Filter.hxx"
 #include "song/LightSong.hxx"
+#include "song/TagSongFilter.hxx"
+#include "tag/Fallback.hxx"
+
+#include <algorithm>
 
 bool
 QueueSelection::MatchPosition(const Queue &queue,
@@ -19,3 +24,135 @@ QueueSelection::MatchPosition(const Queue &queue,
 
 	return true;
 }
+
+/**
+ * Can the given filter item be evaluated with a #QueueIndex?
+ */
+[[gnu::pure]]
+static bool
+IsIndexable(const TagSongFilter &f) noexcept
+{
+	const auto &sf = f.GetFilter();
+
+	/* an empty value matches songs without this tag, and these
+	   are not in the index */
+	return !sf.IsNegated() && !sf.empty();
+}
+
+/**
+ * Invoke the given function for the ids of all index entries of
+ * this tag type which match the #StringFilter.
+ */
+template<typename F>
+static void
+ForEachMatch(const QueueIndex::ValueMap &values, const StringFilter &sf,
+	     F &&f) noexcept
+{
+	if (!sf.GetFoldCase() && !sf.IsRegex()) {
+		/* the map is sorted by the exact value, so these can
+		   be looked up directly */
+
+		const std::string_view value = sf.GetValue();
+
+		switch (sf.GetPosition()) {
+		case StringFilter::Position::FULL:
+			if (auto i = values.find(value); i != values.end())
+				f(i->second);
+			return;
+
+		case StringFilter::Position::PREFIX:
+			for (auto i = values.lower_bound(value);
+			     i != values.end() && i->first.starts_with(value);
+			     ++i)
+				f(i->second);
+			return;
+
+		case StringFilter::Position::ANYWHERE:
+			break;
+		}
+	}
+
+	/* evaluate the filter once per distinct value */
+	for (const auto &[value, ids] : values)
+		if (sf.MatchWithoutNegation(value.c_str()))
+			f(ids);
+}
+
+/**
+ * Collect the ids of all songs which may match the given filter
+ * item.
+ *
+ * @param limit give up if there are more than this many
+ * @return false if the limit was exceeded
+ */
+static bool
+CollectIds(const QueueIndex &index, const TagSongFilter &f,
+	   std::size_t limit, std::vector<unsigned> &ids) noexcept
+{
+	const auto &sf = f.GetFilter();
+
+	auto collect = [&](TagType type){
+		ForEachMatch(index.GetValues(type), sf,
+			     [&ids](const QueueIndex::IdList &v){
+				     ids.insert(ids.end(), v.begin(), v.end());
+			     });
+		return ids.size() > limit;
+	};
+
+	if (f.GetTagType() == TAG_NUM_OF_ITEM_TYPES) {
+		/* "any" */
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			if (collect(TagType(i)))
+				return false;
+	} else if (ApplyTagWithFallback(f.GetTagType(), collect))
+		return false;
+
+	/* a song may be found more than once (with several values,
+	   or with "any" or fallback tags) */
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	return true;
+}
+
+std::optional<std::vector<unsigned>>
+QueueSelection::FindCandidates(const Queue &queue) const noexcept
+{
+	if (filter == nullptr)
+		return std::nullopt;
+
+	const QueueIndex *index = queue.GetIndex();
+	if (index == nullptr)
+		return std::nullopt;
+
+	/* looking up many positions by id is slower than checking
+	   all of them */
+	std::size_t limit = queue.GetLength() / 4;
+
+	std::optional<std::vector<unsigned>> best;
+
+	for (const auto &item : filter->GetItems()) {
+		const auto *f = dynamic_cast<const TagSongFilter *>(item.get());
+		if (f == nullptr || !IsIndexable(*f))
+			continue;
+
+		std::vector<unsigned> ids;
+		if (!CollectIds(*index, *f, limit, ids))
+			continue;
+
+		/* the smallest candidate set wins */
+		limit = ids.size();
+		best = std::move(ids);
+
+		if (limit == 0)
+			break;
+	}
+
+	if (!best)
+		return std::nullopt;
+
+	for (auto &i : *best)
+		i = queue.IdToPosition(i);
+
+	std::sort(best->begin(), best->end());
+	return best;
+}
@@ -6,6 +6,9 @@
 #include "protocol/RangeArg.hxx"
 #include "tag/Type.hxx"
 
+#include <optional>
+#include <vector>
+
 struct Queue;
 class SongFilter;
 
@@ -36,4 +39,15 @@ struct QueueSelection {
 	[[gnu::pure]]
 	bool MatchPosition(const Queue &queue,
 			   unsigned position) const noexcept;
+
+	/**
+	 * Use the queue's tag index to find a (small) superset of the
+	 * positions matching the #filter.  The caller still needs to
+	 * check each of them with MatchPosition().
+	 *
+	 * @return a sorted list of positions or std::nullopt if the
+	 * index cannot be used (or would not be faster than checking
+	 * all positions)
+	 */
+	std::optional<std::vector<unsigned>> FindCandidates(const Queue &queue) const noexcept;
 };
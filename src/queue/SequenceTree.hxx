@@ -0,0 +1,489 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_QUEUE_SEQUENCE_TREE_HXX
+#define MPD_QUEUE_SEQUENCE_TREE_HXX
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * The links of a node in a #SequenceTree.
+ */
+template<typename T>
+struct SequenceTreeLink {
+	T *parent, *left, *right;
+
+	/**
+	 * The number of nodes in this subtree (including this one).
+	 */
+	unsigned size;
+};
+
+/**
+ * A sequence of nodes stored in an implicit treap, i.e. a randomized
+ * balanced binary tree which is ordered by the (implicit) index of
+ * each node.  Looking up a node by its index, determining the index
+ * of a node, inserting, erasing and moving ranges of nodes have
+ * O(log n) complexity.
+ *
+ * A node may be a member of several trees at a time, each one with
+ * its own #SequenceTreeLink.  This class does not own the nodes.
+ *
+ * @param link the #SequenceTreeLink field used by this tree
+ *
+ * @param Traits a class with these static methods:
+ *
+ * - `uint32_t GetKey(const T &)` returns the random heap key of a
+ *   node; it must not change while the node is in the tree
+ *
+ * - `void PushDown(T &)` propagates lazy modifications stored in a
+ *   node to its children; this is called before the children of a
+ *   node are changed
+ *
+ * - `void Update(T &)` recalculates aggregate values of a subtree
+ *   after its children have been changed
+ */
+template<typename T, SequenceTreeLink<T> T::*link, typename Traits>
+class SequenceTree {
+	using Link = SequenceTreeLink<T>;
+
+	T *root = nullptr;
+
+public:
+	SequenceTree() noexcept = default;
+
+	SequenceTree(const SequenceTree &) = delete;
+	SequenceTree &operator=(const SequenceTree &) = delete;
+
+	bool empty() const noexcept {
+		return root == nullptr;
+	}
+
+	unsigned size() const noexcept {
+		return SizeOf(root);
+	}
+
+	/**
+	 * Returns the root node (or nullptr if the tree is empty).
+	 * This may be used to walk the tree to obtain information
+	 * from lazy modifications.
+	 */
+	T *GetRoot() const noexcept {
+		return root;
+	}
+
+	[[gnu::pure]]
+	T &operator[](unsigned i) const noexcept {
+		assert(i < size());
+
+		T *t = root;
+		while (true) {
+			const Link &l = (*t).*link;
+			const unsigned left_size = SizeOf(l.left);
+			if (i < left_size) {
+				t = l.left;
+			} else if (i == left_size) {
+				return *t;
+			} else {
+				i -= left_size + 1;
+				t = l.right;
+			}
+		}
+	}
+
+	/**
+	 * Determine the index of the specified node.
+	 */
+	[[gnu::pure]]
+	static unsigned IndexOf(const T &t) noexcept {
+		unsigned i = SizeOf((t.*link).left);
+
+		for (const T *n = &t, *p = (t.*link).parent; p != nullptr;
+		     n = p, p = (p->*link).parent)
+			if ((p->*link).right == n)
+				i += SizeOf((p->*link).left) + 1;
+
+		return i;
+	}
+
+	/**
+	 * Invoke a function for the specified node and all of its
+	 * ancestors, starting with the node.
+	 */
+	template<typename F>
+	static void ForEachAncestor(const T &t, F &&f) {
+		for (const T *n = &t; n != nullptr; n = (n->*link).parent)
+			f(*n);
+	}
+
+	void PushBack(T &t) noexcept {
+		InitNode(t);
+		SetRoot(Merge(root, &t));
+	}
+
+	void Insert(unsigned i, T &t) noexcept {
+		assert(i <= size());
+
+		InitNode(t);
+		auto [a, b] = Split(root, i);
+		SetRoot(Merge(Merge(a, &t), b));
+	}
+
+	void Erase(T &t) noexcept {
+		auto [a, bc] = Split(root, IndexOf(t));
+		[[maybe_unused]] auto [b, c] = Split(bc, 1);
+		assert(b == &t);
+		SetRoot(Merge(a, c));
+	}
+
+	/**
+	 * Forget all nodes without touching them.
+	 */
+	void Clear() noexcept {
+		root = nullptr;
+	}
+
+	/**
+	 * Remove all nodes, invoking a function for each one.  The
+	 * function may free the node.
+	 */
+	template<typename F>
+	void ClearAndDispose(F &&dispose) {
+		Dispose(root, dispose);
+		root = nullptr;
+	}
+
+	/**
+	 * Replace the contents of this tree with the specified
+	 * nodes (which must not be in this tree currently).
+	 */
+	void Assign(const std::vector<T *> &v) noexcept {
+		SetRoot(Build(v));
+	}
+
+	/**
+	 * Invoke a function for each node in order (without
+	 * propagating lazy modifications).
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		Visit(root, f);
+	}
+
+	/**
+	 * Copy pointers to all nodes (in order) into a vector.
+	 */
+	std::vector<T *> ToVector() const noexcept {
+		std::vector<T *> v;
+		v.reserve(size());
+		ForEach([&v](T &t){ v.push_back(&t); });
+		return v;
+	}
+
+	/**
+	 * Recalculate the aggregate values of the specified node and
+	 * all of its ancestors.  Call this after a node's value which
+	 * is referenced by Traits::Update() has changed.
+	 */
+	static void UpdatePath(T &t) noexcept {
+		for (T *n = &t; n != nullptr; n = (n->*link).parent)
+			Pull(*n);
+	}
+
+	/**
+	 * Swap the nodes at the specified indexes.
+	 */
+	void Swap(unsigned i, unsigned j) noexcept {
+		assert(i < size());
+		assert(j < size());
+
+		if (i == j)
+			return;
+
+		if (i > j)
+			std::swap(i, j);
+
+		auto [a, rest1] = Split(root, i);
+		auto [x, rest2] = Split(rest1, 1);
+		auto [middle, rest3] = Split(rest2, j - i - 1);
+		auto [y, b] = Split(rest3, 1);
+
+		SetRoot(Merge(Merge(Merge(Merge(a, y), middle), x), b));
+	}
+
+	/**
+	 * Move the nodes in the range [start,end) so that the first
+	 * one has the index #to afterwards.
+	 */
+	void MoveRange(unsigned start, unsigned end, unsigned to) noexcept {
+		assert(start <= end);
+		assert(end <= size());
+		assert(to + (end - start) <= size());
+
+		auto [a, bc] = Split(root, start);
+		auto [b, c] = Split(bc, end - start);
+		auto [d, e] = Split(Merge(a, c), to);
+		SetRoot(Merge(Merge(d, b), e));
+	}
+
+	/**
+	 * Invoke a function on the root of a subtree containing
+	 * exactly the nodes in the range [start,end).  The function
+	 * may store a lazy modification in it which will be
+	 * propagated by Traits::PushDown().
+	 */
+	template<typename F>
+	void ApplyRange(unsigned start, unsigned end, F &&f) {
+		assert(start <= end);
+		assert(end <= size());
+
+		if (start == end)
+			return;
+
+		auto [a, bc] = Split(root, start);
+		auto [b, c] = Split(bc, end - start);
+		f(*b);
+		Pull(*b);
+		SetRoot(Merge(Merge(a, b), c));
+	}
+
+	/**
+	 * Pass the nodes in the range [start,end) as a vector to a
+	 * function which may reorder (but not add or remove) them.
+	 * Lazy modifications have been propagated to all nodes in
+	 * the vector.
+	 */
+	template<typename F>
+	void Rearrange(unsigned start, unsigned end, F &&f) {
+		assert(start <= end);
+		assert(end <= size());
+
+		auto [a, bc] = Split(root, start);
+		auto [b, c] = Split(bc, end - start);
+
+		std::vector<T *> v;
+		v.reserve(end - start);
+		Flatten(b, v);
+
+		f(v);
+		assert(v.size() == end - start);
+
+		SetRoot(Merge(Merge(a, Build(v)), c));
+	}
+
+	/**
+	 * Find the first node with an index equal to or greater than
+	 * #start which matches a predicate.
+	 *
+	 * @param subtree_predicate returns false if no node in the
+	 * specified subtree can match (based on aggregate values)
+	 * @param node_predicate checks whether the specified node
+	 * (without its children) matches
+	 * @return the index of the first matching node or size() if
+	 * there is none
+	 */
+	template<typename SP, typename NP>
+	[[gnu::pure]]
+	unsigned FindFirst(unsigned start, SP &&subtree_predicate,
+			   NP &&node_predicate) const noexcept {
+		const unsigned i = Find(root, 0, start,
+					subtree_predicate, node_predicate);
+		return i < size() ? i : size();
+	}
+
+private:
+	static constexpr unsigned NOT_FOUND = ~0U;
+
+	static unsigned SizeOf(const T *t) noexcept {
+		return t != nullptr ? (t->*link).size : 0;
+	}
+
+	static void InitNode(T &t) noexcept {
+		Link &l = t.*link;
+		l.parent = l.left = l.right = nullptr;
+		l.size = 1;
+		Traits::Update(t);
+	}
+
+	/**
+	 * Recalculate the size and aggregate values of a node after
+	 * its children have been changed, and fix up their parent
+	 * pointers.
+	 */
+	static void Pull(T &t) noexcept {
+		Link &l = t.*link;
+		l.size = 1 + SizeOf(l.left) + SizeOf(l.right);
+
+		if (l.left != nullptr)
+			(l.left->*link).parent = &t;
+		if (l.right != nullptr)
+			(l.right->*link).parent = &t;
+
+		Traits::Update(t);
+	}
+
+	void SetRoot(T *t) noexcept {
+		root = t;
+		if (t != nullptr)
+			(t->*link).parent = nullptr;
+	}
+
+	/**
+	 * Split a subtree into two: the first #n nodes and the rest.
+	 * The parent pointers of the returned subtrees are
+	 * undefined.
+	 */
+	static std::pair<T *, T *> Split(T *t, unsigned n) noexcept {
+		if (t == nullptr)
+			return {nullptr, nullptr};
+
+		Traits::PushDown(*t);
+
+		Link &l = t->*link;
+		const unsigned left_size = SizeOf(l.left);
+		if (n <= left_size) {
+			auto [a, b] = Split(l.left, n);
+			l.left = b;
+			Pull(*t);
+			return {a, t};
+		} else {
+			auto [a, b] = Split(l.right, n - left_size - 1);
+			l.right = a;
+			Pull(*t);
+			return {t, b};
+		}
+	}
+
+	/**
+	 * Concatenate two subtrees.
+	 */
+	static T *Merge(T *a, T *b) noexcept {
+		if (a == nullptr)
+			return b;
+		if (b == nullptr)
+			return a;
+
+		if (Traits::GetKey(*a) > Traits::GetKey(*b)) {
+			Traits::PushDown(*a);
+			Link &l = a->*link;
+			l.right = Merge(l.right, b);
+			Pull(*a);
+			return a;
+		} else {
+			Traits::PushDown(*b);
+			Link &l = b->*link;
+			l.left = Merge(a, l.left);
+			Pull(*b);
+			return b;
+		}
+	}
+
+	/**
+	 * Build a tree from a sequence of nodes in O(n).
+	 */
+	static T *Build(const std::vector<T *> &v) noexcept {
+		/* the right spine of the tree built so far */
+		std::vector<T *> spine;
+
+		for (T *t : v) {
+			Link &l = t->*link;
+			l.left = l.right = nullptr;
+
+			T *last = nullptr;
+			while (!spine.empty() &&
+			       Traits::GetKey(*spine.back()) < Traits::GetKey(*t)) {
+				last = spine.back();
+				spine.pop_back();
+				Pull(*last);
+			}
+
+			l.left = last;
+			if (!spine.empty())
+				(spine.back()->*link).right = t;
+
+			spine.push_back(t);
+		}
+
+		if (spine.empty())
+			return nullptr;
+
+		T *const result = spine.front();
+
+		while (!spine.empty()) {
+			Pull(*spine.back());
+			spine.pop_back();
+		}
+
+		return result;
+	}
+
+	static void Flatten(T *t, std::vector<T *> &v) noexcept {
+		if (t == nullptr)
+			return;
+
+		Traits::PushDown(*t);
+
+		const Link &l = t->*link;
+		Flatten(l.left, v);
+		v.push_back(t);
+		Flatten(l.right, v);
+	}
+
+	template<typename F>
+	static void Visit(T *t, F &f) {
+		while (t != nullptr) {
+			const Link &l = t->*link;
+			Visit(l.left, f);
+
+			T *const right = l.right;
+			f(*t);
+			t = right;
+		}
+	}
+
+	template<typename F>
+	static void Dispose(T *t, F &dispose) {
+		if (t == nullptr)
+			return;
+
+		const Link &l = t->*link;
+		T *const left = l.left, *const right = l.right;
+		Dispose(left, dispose);
+		Dispose(right, dispose);
+		dispose(*t);
+	}
+
+	template<typename SP, typename NP>
+	static unsigned Find(const T *t, unsigned offset, unsigned start,
+			     SP &subtree_predicate,
+			     NP &node_predicate) noexcept {
+		while (t != nullptr) {
+			const Link &l = t->*link;
+
+			if (offset + l.size <= start || !subtree_predicate(*t))
+				return NOT_FOUND;
+
+			const unsigned i = offset + SizeOf(l.left);
+			if (start < i) {
+				const unsigned result =
+					Find(l.left, offset, start,
+					     subtree_predicate, node_predicate);
+				if (result != NOT_FOUND)
+					return result;
+			}
+
+			if (i >= start && node_predicate(*t))
+				return i;
+
+			offset = i + 1;
+			t = l.right;
+		}
+
+		return NOT_FOUND;
+	}
+};
+
+#endif
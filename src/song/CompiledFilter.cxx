@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "CompiledFilter.hxx"
+#include "AndSongFilter.hxx"
+#include "TagSongFilter.hxx"
+#include "UriSongFilter.hxx"
+#include "NotSongFilter.hxx"
+#include "LightSong.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Fallback.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+[[gnu::pure]]
+static unsigned
+EstimateCost(const StringFilter &f) noexcept
+{
+	unsigned cost = f.GetPosition() == StringFilter::Position::ANYWHERE
+		? 4 : 2;
+
+	if (f.GetFoldCase())
+		/* needs Unicode case folding of each haystack */
+		cost += 8;
+
+	if (f.IsRegex())
+		cost += 16;
+
+	return cost;
+}
+
+[[gnu::pure]]
+static unsigned
+EstimateCost(const ISongFilter &f) noexcept
+{
+	if (dynamic_cast<const UriSongFilter *>(&f) != nullptr)
+		return 3;
+
+	if (dynamic_cast<const AndSongFilter *>(&f) != nullptr ||
+	    dynamic_cast<const NotSongFilter *>(&f) != nullptr)
+		/* nested filters may contain anything */
+		return 32;
+
+	/* "base", "modified-since", "added-since", "prio" and
+	   "AudioFormat" are simple comparisons */
+	return 1;
+}
+
+[[gnu::const]]
+static TagMask
+WithFallback(TagType type) noexcept
+{
+	TagMask mask = type;
+	ApplyTagFallback(type, [&mask](TagType fallback){
+		mask.Set(fallback);
+		return false;
+	});
+	return mask;
+}
+
+void
+CompiledSongFilter::Compile(const AndSongFilter &filter) noexcept
+{
+	required.clear();
+	program.clear();
+
+	for (const auto &item : filter.GetItems()) {
+		if (const auto *t = dynamic_cast<const TagSongFilter *>(item.get())) {
+			const auto &sf = t->GetFilter();
+			const TagType type = t->GetTagType();
+
+			if (type != TAG_NUM_OF_ITEM_TYPES &&
+			    !sf.IsNegated() && !sf.empty())
+				/* this can only match if the tag (or
+				   a fallback) is present */
+				required.push_back(WithFallback(type));
+
+			unsigned cost = EstimateCost(sf);
+			if (type == TAG_NUM_OF_ITEM_TYPES)
+				/* "any" looks at all tag items */
+				cost *= 2;
+
+			program.push_back({&sf, nullptr, type, cost});
+		} else
+			program.push_back({nullptr, item.get(),
+					   TAG_NUM_OF_ITEM_TYPES,
+					   EstimateCost(*item)});
+	}
+
+	/* all items are combined with logical "and", therefore they
+	   can be evaluated in any order */
+	std::stable_sort(program.begin(), program.end(),
+			 [](const Instruction &a, const Instruction &b){
+				 return a.cost < b.cost;
+			 });
+
+	defined = true;
+}
+
+/**
+ * This implements the same logic as TagSongFilter::Match(), but
+ * uses the precalculated #TagMask to find the effective tag type.
+ */
+inline bool
+CompiledSongFilter::MatchTag(const Tag &tag, TagMask present,
+			     TagType type,
+			     const StringFilter &filter) noexcept
+{
+	if (type != TAG_NUM_OF_ITEM_TYPES && !present.Test(type)) {
+		/* if the specified tag is not present, try the
+		   fallback tags */
+		TagType fallback = TAG_NUM_OF_ITEM_TYPES;
+		ApplyTagFallback(type, [present, &fallback](TagType t){
+			if (!present.Test(t))
+				return false;
+
+			fallback = t;
+			return true;
+		});
+
+		if (fallback == TAG_NUM_OF_ITEM_TYPES)
+			/* the tag is absent; this matches only an
+			   empty search string */
+			return filter.empty() != filter.IsNegated();
+
+		type = fallback;
+	}
+
+	for (const auto &item : tag)
+		if ((type == TAG_NUM_OF_ITEM_TYPES || item.type == type) &&
+		    filter.MatchWithoutNegation(item))
+			return !filter.IsNegated();
+
+	return filter.IsNegated();
+}
+
+bool
+CompiledSongFilter::Match(const LightSong &song) const noexcept
+{
+	assert(defined);
+
+	const Tag &tag = song.tag;
+
+	const TagMask present = tag.types;
+
+	for (const TagMask mask : required)
+		if (!(present & mask).TestAny())
+			return false;
+
+	for (const auto &i : program) {
+		if (i.tag_filter != nullptr) {
+			if (!MatchTag(tag, present, i.type, *i.tag_filter))
+				return false;
+		} else if (!i.other->Match(song))
+			return false;
+	}
+
+	return true;
+}
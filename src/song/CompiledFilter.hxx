@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_COMPILED_SONG_FILTER_HXX
+#define MPD_COMPILED_SONG_FILTER_HXX
+
+#include "tag/Mask.hxx"
+#include "tag/Type.hxx"
+
+#include <vector>
+
+struct LightSong;
+struct Tag;
+class ISongFilter;
+class AndSongFilter;
+class StringFilter;
+
+/**
+ * A flat program compiled from an (optimized) #AndSongFilter.  It is
+ * meant for matching lots of songs quickly:
+ *
+ * - the #TagType of each item of the song's #Tag is collected into a
+ *   #TagMask just once per song
+ *
+ * - items which require a certain tag (or one of its fallbacks) to
+ *   be present are rejected with a bit test before any string is
+ *   compared
+ *
+ * - each #TagSongFilter only looks at the items of its (effective)
+ *   tag type
+ *
+ * - cheap items are evaluated first
+ *
+ * The program refers to the #ISongFilter objects it was compiled
+ * from, which must therefore outlive it.
+ */
+class CompiledSongFilter {
+	struct Instruction {
+		/**
+		 * If not nullptr, then this instruction is a
+		 * #TagSongFilter using this #StringFilter and #type.
+		 * Otherwise, #other is evaluated.
+		 */
+		const StringFilter *tag_filter;
+
+		const ISongFilter *other;
+
+		/**
+		 * The tag type of the #TagSongFilter;
+		 * #TAG_NUM_OF_ITEM_TYPES means "any".
+		 */
+		TagType type;
+
+		/**
+		 * An estimate of how expensive this instruction is.
+		 */
+		unsigned cost;
+	};
+
+	/**
+	 * For each of these masks, at least one of the tag types
+	 * must be present in the song, or else the song doesn't
+	 * match.
+	 */
+	std::vector<TagMask> required;
+
+	/**
+	 * The instructions, sorted by #Instruction::cost.
+	 */
+	std::vector<Instruction> program;
+
+	bool defined = false;
+
+public:
+	bool IsDefined() const noexcept {
+		return defined;
+	}
+
+	void Compile(const AndSongFilter &filter) noexcept;
+
+	[[gnu::pure]]
+	bool Match(const LightSong &song) const noexcept;
+
+private:
+	[[gnu::pure]]
+	static bool MatchTag(const Tag &tag, TagMask present,
+			     TagType type, const StringFilter &filter) noexcept;
+};
+
+#endif
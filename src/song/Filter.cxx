@@ -22,6 +22,12 @@
 #include "util/ASCII.hxx"
 #include "util/UriUtil.hxx"
 
+#ifdef HAVE_PCRE
+#include "thread/Mutex.hxx"
+
+#include <list>
+#endif
+
 #include <cassert>
 
 #include <stdlib.h>
@@ -229,6 +235,60 @@ static constexpr std::array<OperatorDef, 12> operators = {
  *
  * Throws on error.
  */
+#ifdef HAVE_PCRE
+
+/**
+ * Clients tend to send the same regular expressions over and over
+ * (e.g. a search field which is re-evaluated on every keystroke), so
+ * the most recently compiled ones are kept in this LRU cache to skip
+ * compiling (and JIT-compiling) them again.
+ */
+class RegexCache {
+	static constexpr std::size_t MAX_SIZE = 32;
+
+	struct Item {
+		std::string pattern;
+		bool caseless;
+		std::shared_ptr<UniqueRegex> regex;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The most recently used item is at the front.
+	 */
+	std::list<Item> items;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	std::shared_ptr<UniqueRegex> Get(const std::string &pattern,
+					 bool caseless) {
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->caseless == caseless && i->pattern == pattern) {
+				items.splice(items.begin(), items, i);
+				return i->regex;
+			}
+		}
+
+		auto regex = std::make_shared<UniqueRegex>(pattern.c_str(),
+							   Pcre::CompileOptions{.caseless=caseless});
+
+		if (items.size() >= MAX_SIZE)
+			items.pop_back();
+
+		items.emplace_front(pattern, caseless, regex);
+		return regex;
+	}
+};
+
+static RegexCache regex_cache;
+
+#endif
+
 static StringFilter
 ParseStringFilter(const char *&s, bool fold_case)
 {
@@ -295,8 +355,7 @@ ParseStringFilter(const char *&s, bool fold_case)
 			StringFilter::Position::FULL,
 			negated,
 		};
-		f.SetRegex(std::make_shared<UniqueRegex>(f.GetValue().c_str(),
-							 Pcre::CompileOptions{.caseless=fold_case}));
+		f.SetRegex(regex_cache.Get(f.GetValue(), fold_case));
 		return f;
 	}
 #endif
@@ -503,6 +562,9 @@ SongFilter::Parse(std::span<const char *const> args, bool fold_case)
 	if (args.empty())
 		throw std::runtime_error("Incorrect number of filter arguments");
 
+	/* new items invalidate the compiled program */
+	compiled = {};
+
 	do {
 		if (*args.front() == '(') {
 			const char *s = args.front();
@@ -530,11 +592,15 @@ void
 SongFilter::Optimize() noexcept
 {
 	OptimizeSongFilter(and_filter);
+	compiled.Compile(and_filter);
 }
 
 bool
 SongFilter::Match(const LightSong &song) const noexcept
 {
+	if (compiled.IsDefined())
+		return compiled.Match(song);
+
 	return and_filter.Match(song);
 }
 
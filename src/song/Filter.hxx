@@ -5,6 +5,7 @@
 #define MPD_SONG_FILTER_HXX
 
 #include "AndSongFilter.hxx"
+#include "CompiledFilter.hxx"
 
 #include <cstdint>
 #include <span>
@@ -32,6 +33,12 @@ struct LightSong;
 class SongFilter {
 	AndSongFilter and_filter;
 
+	/**
+	 * A compiled version of #and_filter for faster matching;
+	 * created by Optimize().
+	 */
+	CompiledSongFilter compiled;
+
 public:
 	SongFilter() = default;
 
@@ -59,6 +66,11 @@ public:
 	 */
 	void Parse(std::span<const char *const> args, bool fold_case=false);
 
+	/**
+	 * Optimize the filter and compile it for faster matching.
+	 * This should be called after parsing and before matching
+	 * many songs.
+	 */
 	void Optimize() noexcept;
 
 	[[gnu::pure]]
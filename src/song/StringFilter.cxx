@@ -2,6 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "StringFilter.hxx"
+#include "tag/Item.hxx"
+#include "tag/Pool.hxx"
 #include "util/StringAPI.hxx"
 
 #include <cassert>
@@ -13,7 +15,7 @@ StringFilter::MatchWithoutNegation(const char *s) const noexcept
 
 #ifdef HAVE_PCRE
 	if (regex)
-		return regex->Match(s);
+		return regex->Test(s);
 #endif
 
 	if (fold_case) {
@@ -45,6 +47,31 @@ StringFilter::MatchWithoutNegation(const char *s) const noexcept
 	}
 }
 
+bool
+StringFilter::MatchWithoutNegation(const TagItem &item) const noexcept
+{
+#ifdef HAVE_ICU_CANONICALIZE
+	if (fold_case && !IsRegex()) {
+		if (const char *folded = tag_pool_get_folded(item)) {
+			switch (position) {
+			case Position::FULL:
+				break;
+
+			case Position::ANYWHERE:
+				return fold_case.IsInCanonical(folded);
+
+			case Position::PREFIX:
+				return fold_case.StartsWithCanonical(folded);
+			}
+
+			return fold_case.EqualsCanonical(folded);
+		}
+	}
+#endif
+
+	return MatchWithoutNegation(item.value);
+}
+
 bool
 StringFilter::Match(const char *s) const noexcept
 {
@@ -15,6 +15,8 @@
 #include <string>
 #include <memory>
 
+struct TagItem;
+
 class StringFilter {
 public:
 	enum class Position : uint_least8_t {
@@ -81,6 +83,10 @@ public:
 		return fold_case;
 	}
 
+	Position GetPosition() const noexcept {
+		return position;
+	}
+
 	bool IsNegated() const noexcept {
 		return negated;
 	}
@@ -115,6 +121,14 @@ public:
 	 */
 	[[gnu::pure]]
 	bool MatchWithoutNegation(const char *s) const noexcept;
+
+	/**
+	 * Like MatchWithoutNegation(const char *), but with a
+	 * #TagItem from the tag pool.  This allows using the case-folded
+	 * value cached by the pool.
+	 */
+	[[gnu::pure]]
+	bool MatchWithoutNegation(const TagItem &item) const noexcept;
 };
 
 #endif
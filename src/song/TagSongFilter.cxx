@@ -22,49 +22,42 @@ TagSongFilter::ToExpression() const noexcept
 bool
 TagSongFilter::Match(const Tag &tag) const noexcept
 {
-	bool visited_types[TAG_NUM_OF_ITEM_TYPES]{};
+	if (type == TAG_NUM_OF_ITEM_TYPES || tag.HasType(type)) {
+		for (const auto &i : tag)
+			if ((type == TAG_NUM_OF_ITEM_TYPES || i.type == type) &&
+			    filter.MatchWithoutNegation(i))
+				return !filter.IsNegated();
 
-	for (const auto &i : tag) {
-		visited_types[i.type] = true;
-
-		if ((type == TAG_NUM_OF_ITEM_TYPES || i.type == type) &&
-		    filter.MatchWithoutNegation(i.value))
-			return !filter.IsNegated();
+		return filter.IsNegated();
 	}
 
-	if (type < TAG_NUM_OF_ITEM_TYPES && !visited_types[type]) {
-		/* if the specified tag is not present, try the
-		   fallback tags */
+	/* if the specified tag is not present, try the fallback
+	   tags */
 
-		bool result = false;
-		if (ApplyTagFallback(type, [&](TagType tag2) {
-			if (!visited_types[tag2])
-				/* we already know that this tag type
-				   isn't present, so let's bail out
-				   without checking again */
-				return false;
+	bool result = false;
+	if (ApplyTagFallback(type, [&](TagType tag2) {
+		if (!tag.HasType(tag2))
+			/* we already know that this tag type isn't
+			   present, so let's bail out without checking
+			   again */
+			return false;
 
-			for (const auto &item : tag) {
-				if (item.type == tag2 &&
-				    filter.MatchWithoutNegation(item.value)) {
-					result = true;
-					break;
-				}
+		for (const auto &item : tag) {
+			if (item.type == tag2 &&
+			    filter.MatchWithoutNegation(item)) {
+				result = true;
+				break;
 			}
+		}
 
-			return true;
-		}))
-			return result != filter.IsNegated();
+		return true;
+	}))
+		return result != filter.IsNegated();
 
-		/* If the search critieron was not visited during the
-		   sweep through the song's tag, it means this field
-		   is absent from the tag or empty. Thus, if the
-		   searched string is also empty
-		   then it's a match as well and we should return
-		   true. */
-		if (filter.empty())
-			return !filter.IsNegated();
-	}
+	/* If the search critieron is absent from the tag, then it
+	   matches only if the searched string is empty, too. */
+	if (filter.empty())
+		return !filter.IsNegated();
 
 	return filter.IsNegated();
 }
@@ -26,6 +26,10 @@ public:
 		return type;
 	}
 
+	const auto &GetFilter() const noexcept {
+		return filter;
+	}
+
 	const auto &GetValue() const noexcept {
 		return filter.GetValue();
 	}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Cache.hxx"
+
+#include <cassert>
+#include <mutex>
+#include <shared_mutex>
+
+std::string
+StickerCache::MakeKey(std::string_view type, std::string_view uri,
+		      std::string_view name) noexcept
+{
+	std::string key;
+	key.reserve(type.size() + uri.size() + name.size() + 2);
+	key.append(type);
+	key.push_back('\0');
+	key.append(uri);
+	key.push_back('\0');
+	key.append(name);
+	return key;
+}
+
+std::string
+StickerCache::Get(std::string_view type, std::string_view uri,
+		  std::string_view name) const noexcept
+{
+	assert(IsCached(name));
+
+	const auto key = MakeKey(type, uri, name);
+
+	const std::shared_lock lock{mutex};
+	if (auto i = values.find(key); i != values.end())
+		return i->second;
+
+	return {};
+}
+
+void
+StickerCache::Put(std::string_view type, std::string_view uri,
+		  std::string_view name, std::string_view value) noexcept
+{
+	if (!IsCached(name))
+		return;
+
+	auto key = MakeKey(type, uri, name);
+
+	const std::unique_lock lock{mutex};
+	values.insert_or_assign(std::move(key), std::string{value});
+}
+
+void
+StickerCache::Remove(std::string_view type, std::string_view uri,
+		     std::string_view name) noexcept
+{
+	if (!IsCached(name))
+		return;
+
+	const auto key = MakeKey(type, uri, name);
+
+	const std::unique_lock lock{mutex};
+	values.erase(key);
+}
+
+void
+StickerCache::Remove(std::string_view type, std::string_view uri) noexcept
+{
+	const std::unique_lock lock{mutex};
+	for (const auto &name : names)
+		values.erase(MakeKey(type, uri, name));
+}
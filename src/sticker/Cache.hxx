@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_STICKER_CACHE_HXX
+#define MPD_STICKER_CACHE_HXX
+
+#include "thread/SharedMutex.hxx"
+
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * An in-memory copy of all sticker values with certain names
+ * (configured with "sticker_cache"), e.g. "rating" or "playcount".
+ * Clients which display such a sticker for each song in a list would
+ * otherwise cause one SQLite query per song.
+ *
+ * The cache is complete: all values with a cached name are loaded
+ * at startup, so a value which is not in the cache does not exist.
+ *
+ * This class is thread-safe; it is shared by all #StickerDatabase
+ * connections and read by database commands running in worker
+ * threads.
+ */
+class StickerCache {
+	const std::set<std::string, std::less<>> names;
+
+	mutable SharedMutex mutex;
+
+	/**
+	 * Key is "TYPE\0URI\0NAME".
+	 */
+	std::unordered_map<std::string, std::string> values;
+
+public:
+	explicit StickerCache(std::set<std::string, std::less<>> &&_names) noexcept
+		:names(std::move(_names)) {}
+
+	StickerCache(const StickerCache &) = delete;
+	StickerCache &operator=(const StickerCache &) = delete;
+
+	const auto &GetNames() const noexcept {
+		return names;
+	}
+
+	[[gnu::pure]]
+	bool IsCached(std::string_view name) const noexcept {
+		return names.contains(name);
+	}
+
+	/**
+	 * Look up a value.  The name must be cached.
+	 *
+	 * @return the value or an empty string if there is no such
+	 * sticker
+	 */
+	[[gnu::pure]]
+	std::string Get(std::string_view type, std::string_view uri,
+			std::string_view name) const noexcept;
+
+	/**
+	 * Add or replace a value.  Ignored if the name is not cached.
+	 */
+	void Put(std::string_view type, std::string_view uri,
+		 std::string_view name, std::string_view value) noexcept;
+
+	/**
+	 * Remove one value.
+	 */
+	void Remove(std::string_view type, std::string_view uri,
+		    std::string_view name) noexcept;
+
+	/**
+	 * Remove all values of one object.
+	 */
+	void Remove(std::string_view type, std::string_view uri) noexcept;
+
+private:
+	static std::string MakeKey(std::string_view type, std::string_view uri,
+				   std::string_view name) noexcept;
+};
+
+#endif
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "Database.hxx"
+#include "Cache.hxx"
 #include "Sticker.hxx"
 #include "lib/sqlite/Util.hxx"
 #include "fs/Path.hxx"
@@ -50,6 +51,7 @@ enum sticker_sql {
 	STICKER_SQL_NAMES_TYPES_BY_TYPE,
 	STICKER_SQL_INC,
 	STICKER_SQL_DEC,
+	STICKER_SQL_LOAD_NAME,
 
 	STICKER_SQL_COUNT
 };
@@ -127,6 +129,9 @@ static constexpr auto sticker_sql = std::array {
 	"INSERT INTO sticker (type, uri, name, value) VALUES (?, ?, ?, ?) "
 	"ON CONFLICT(type, uri, name) DO "
 	"UPDATE set value = value - ?",
+
+	//[STICKER_SQL_LOAD_NAME] =
+	"SELECT type,uri,value FROM sticker WHERE name=?",
 };
 
 static constexpr const char sticker_sql_create[] =
@@ -138,14 +143,35 @@ static constexpr const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	/* for "sticker find", which filters by type and name, but
+	   only by an URI prefix */
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name ON sticker(type, name);"
 	"";
 
+/**
+ * Write-ahead logging lets the cleanup thread's connection read
+ * while the main thread writes, and with "synchronous=NORMAL", a
+ * commit does not need to wait for fsync() (only checkpoints do).
+ * Sticker writes (e.g. play counts from scrobblers) therefore don't
+ * stall the event loop on slow disks.
+ */
+static constexpr const char sticker_sql_pragmas[] =
+	"PRAGMA journal_mode=WAL;"
+	"PRAGMA synchronous=NORMAL;";
+
 StickerDatabase::StickerDatabase(const char *_path)
 	:path(_path),
 	 db(path.c_str())
 {
 	int ret;
 
+	ret = sqlite3_exec(db, sticker_sql_pragmas,
+			   nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		throw SqliteError(db, ret,
+				  "Failed to configure sticker database");
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(db, sticker_sql_create,
@@ -176,13 +202,60 @@ StickerDatabase::~StickerDatabase() noexcept
 
 		sqlite3_finalize(sticker);
 	}
+
+	for (const auto &[sql, s] : find_stmt_cache)
+		sqlite3_finalize(s);
+}
+
+sqlite3_stmt *
+StickerDatabase::PrepareFind(const std::string &sql)
+{
+	if (auto i = find_stmt_cache.find(sql); i != find_stmt_cache.end())
+		return i->second;
+
+	/* the number of distinct queries is small (operator, sort
+	   and window), but don't let a client fill the cache with
+	   arbitrary windows */
+	if (find_stmt_cache.size() >= MAX_FIND_STMT_CACHE) {
+		for (const auto &[old_sql, s] : find_stmt_cache)
+			sqlite3_finalize(s);
+		find_stmt_cache.clear();
+	}
+
+	sqlite3_stmt *s = Prepare(db, sql.c_str());
+	find_stmt_cache.emplace(sql, s);
+	return s;
+}
+
+void
+StickerDatabase::EnableCache(std::shared_ptr<StickerCache> _cache)
+{
+	assert(_cache != nullptr);
+
+	sqlite3_stmt *const s = stmt[STICKER_SQL_LOAD_NAME];
+
+	for (const auto &name : _cache->GetNames()) {
+		BindAll(s, name.c_str());
+
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		ExecuteForEach(s, [s, &name, &c=*_cache](){
+			c.Put((const char*)sqlite3_column_text(s, 0),
+			      (const char*)sqlite3_column_text(s, 1),
+			      name,
+			      (const char*)sqlite3_column_text(s, 2));
+		});
+	}
+
+	cache = std::move(_cache);
 }
 
 std::string
 StickerDatabase::LoadValue(const char *type, const char *uri, const char *name)
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_GET];
-
 	assert(type != nullptr);
 	assert(uri != nullptr);
 	assert(name != nullptr);
@@ -190,6 +263,18 @@ StickerDatabase::LoadValue(const char *type, const char *uri, const char *name)
 	if (StringIsEmpty(name))
 		return {};
 
+	if (cache && cache->IsCached(name))
+		return cache->Get(type, uri, name);
+
+	return LoadValueFromDatabase(type, uri, name);
+}
+
+std::string
+StickerDatabase::LoadValueFromDatabase(const char *type, const char *uri,
+				       const char *name)
+{
+	sqlite3_stmt *const s = stmt[STICKER_SQL_GET];
+
 	BindAll(s, type, uri, name);
 
 	AtScopeExit(s) {
@@ -290,6 +375,18 @@ StickerDatabase::StoreValue(const char *type, const char *uri,
 
 	if (!UpdateValue(type, uri, name, value))
 		InsertValue(type, uri, name, value);
+
+	if (cache)
+		cache->Put(type, uri, name, value);
+}
+
+void
+StickerDatabase::ReloadCachedValue(const char *type, const char *uri,
+				   const char *name)
+{
+	if (cache && cache->IsCached(name))
+		cache->Put(type, uri, name,
+			   LoadValueFromDatabase(type, uri, name));
 }
 
 void
@@ -304,14 +401,20 @@ StickerDatabase::IncValue(const char *type, const char *uri,
 	assert(*name != 0);
 	assert(value != nullptr);
 
-	BindAll(s, type, uri, name, value, value);
+	{
+		BindAll(s, type, uri, name, value, value);
 
-	AtScopeExit(s) {
-		sqlite3_reset(s);
-		sqlite3_clear_bindings(s);
-	};
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		ExecuteCommand(s);
+	}
+
+	/* the new value was calculated by SQLite */
+	ReloadCachedValue(type, uri, name);
 
-	ExecuteCommand(s);
 	idle_add(IDLE_STICKER);
 }
 
@@ -327,14 +430,20 @@ StickerDatabase::DecValue(const char *type, const char *uri,
 	assert(*name != 0);
 	assert(value != nullptr);
 
-	BindAll(s, type, uri, name, value, value);
+	{
+		BindAll(s, type, uri, name, value, value);
 
-	AtScopeExit(s) {
-		sqlite3_reset(s);
-		sqlite3_clear_bindings(s);
-	};
+		AtScopeExit(s) {
+			sqlite3_reset(s);
+			sqlite3_clear_bindings(s);
+		};
+
+		ExecuteCommand(s);
+	}
+
+	/* the new value was calculated by SQLite */
+	ReloadCachedValue(type, uri, name);
 
-	ExecuteCommand(s);
 	idle_add(IDLE_STICKER);
 }
 
@@ -354,8 +463,11 @@ StickerDatabase::Delete(const char *type, const char *uri)
 	};
 
 	bool modified = ExecuteModified(s);
-	if (modified)
+	if (modified) {
+		if (cache)
+			cache->Remove(type, uri);
 		idle_add(IDLE_STICKER);
+	}
 	return modified;
 }
 
@@ -376,8 +488,11 @@ StickerDatabase::DeleteValue(const char *type, const char *uri,
 	};
 
 	bool modified = ExecuteModified(s);
-	if (modified)
+	if (modified) {
+		if (cache)
+			cache->Remove(type, uri, name);
 		idle_add(IDLE_STICKER);
+	}
 	return modified;
 }
 
@@ -422,63 +537,63 @@ StickerDatabase::BindFind(const char *type, const char *base_uri,
 	case StickerOperator::EXISTS:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name);
 		return sql;
 
 	case StickerOperator::EQUALS:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_VALUE], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::LESS_THAN:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_LT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::GREATER_THAN:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_GT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::EQUALS_INT:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_EQ_INT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::LESS_THAN_INT:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_LT_INT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::GREATER_THAN_INT:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_GT_INT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::CONTAINS:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_CONTAINS], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 
 	case StickerOperator::STARTS_WITH:
 		sql_str = fmt::format("{} {} {}",
 			sticker_sql_find[STICKER_SQL_FIND_STARTS_WITH], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
+		sql = PrepareFind(sql_str);
 		BindAll(sql, type, base_uri, name, value);
 		return sql;
 	}
@@ -501,7 +616,8 @@ StickerDatabase::Find(const char *type, const char *base_uri, const char *name,
 	assert(s != nullptr);
 
 	AtScopeExit(s) {
-		sqlite3_finalize(s);
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
 	};
 
 	ExecuteForEach(s, [s, func, user_data](){
@@ -591,6 +707,10 @@ StickerDatabase::BatchDeleteNoIdle(const std::list<StickerTypeUriPair> &stickers
 		}
 
 		ExecuteBusy(commit);
+
+		if (cache)
+			for (const auto &sticker : stickers)
+				cache->Remove(sticker.first, sticker.second);
 	} catch (...) {
 		// "If the transaction has already been rolled back automatically by the error response,
 		// then the ROLLBACK command will fail with an error, but no harm is caused by this."
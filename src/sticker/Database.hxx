@@ -33,10 +33,12 @@
 #include <sqlite3.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <list>
 
 class Path;
+class StickerCache;
 struct Sticker;
 
 class StickerDatabase {
@@ -56,6 +58,7 @@ class StickerDatabase {
 		  SQL_NAMES_TYPES_BY_TYPE,
 		  STICKER_SQL_INC,
 		  STICKER_SQL_DEC,
+		  SQL_LOAD_NAME,
 
 		  SQL_COUNT
 	};
@@ -81,6 +84,22 @@ class StickerDatabase {
 	Sqlite::Database db;
 	sqlite3_stmt *stmt[SQL_COUNT];
 
+	/**
+	 * Prepared statements for Find(), keyed by their SQL text
+	 * (which depends on the operator, the sort order and the
+	 * window).
+	 */
+	std::map<std::string, sqlite3_stmt *, std::less<>> find_stmt_cache;
+
+	static constexpr std::size_t MAX_FIND_STMT_CACHE = 64;
+
+	/**
+	 * If not nullptr, then values with the names covered by
+	 * this cache are served from memory.  It is shared with all
+	 * connections created by Reopen().
+	 */
+	std::shared_ptr<StickerCache> cache;
+
 	explicit StickerDatabase(const char *_path);
 
 public:
@@ -100,7 +119,24 @@ public:
 	 */
 	[[nodiscard]]
 	StickerDatabase Reopen() const {
-		return StickerDatabase{path.c_str()};
+		StickerDatabase result{path.c_str()};
+		result.cache = cache;
+		return result;
+	}
+
+	/**
+	 * Load all values with the names covered by the given cache
+	 * and use it from now on.
+	 *
+	 * Throws #SqliteError on error.
+	 */
+	void EnableCache(std::shared_ptr<StickerCache> _cache);
+
+	/**
+	 * @return the cache or nullptr if none was enabled
+	 */
+	const std::shared_ptr<StickerCache> &GetCache() const noexcept {
+		return cache;
 	}
 
 	/**
@@ -208,6 +244,16 @@ public:
 	void BatchDeleteNoIdle(const std::list<StickerTypeUriPair> &stickers);
 
 private:
+	std::string LoadValueFromDatabase(const char *type, const char *uri,
+					  const char *name);
+
+	/**
+	 * Update the cached copy of a value which was modified by an
+	 * SQL expression.
+	 */
+	void ReloadCachedValue(const char *type, const char *uri,
+			       const char *name);
+
 	void ListValues(std::map<std::string, std::string, std::less<>> &table,
 			const char *type, const char *uri);
 
@@ -217,6 +263,8 @@ private:
 	void InsertValue(const char *type, const char *uri,
 			 const char *name, const char *value);
 
+	sqlite3_stmt *PrepareFind(const std::string &sql);
+
 	sqlite3_stmt *BindFind(const char *type, const char *base_uri,
 			       const char *name,
 			       StickerOperator op, const char *value,
@@ -281,6 +281,25 @@ CompositeStorage::OpenDirectory(std::string_view uri)
 							  directory->children);
 }
 
+void
+CompositeStorage::PrefetchTree(std::string_view uri) noexcept
+{
+	const std::scoped_lock protect{mutex};
+
+	auto f = FindStorage(uri);
+	if (f.directory->storage != nullptr)
+		f.directory->storage->PrefetchTree(f.uri);
+}
+
+void
+CompositeStorage::CancelPrefetch() noexcept
+{
+	const std::scoped_lock protect{mutex};
+
+	if (root.storage != nullptr)
+		root.storage->CancelPrefetch();
+}
+
 std::string
 CompositeStorage::MapUTF8(std::string_view uri) const noexcept
 {
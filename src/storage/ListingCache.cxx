@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ListingCache.hxx"
+
+#include <cassert>
+
+StorageListingCache::~StorageListingCache() noexcept
+{
+	Flush();
+}
+
+void
+StorageListingCache::Remove(Item &item) noexcept
+{
+	lru.erase(lru.iterator_to(item));
+
+	/* this frees the item */
+	map.erase(map.find(item.key));
+}
+
+StorageListingPtr
+StorageListingCache::Get(std::string_view key) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	auto i = map.find(key);
+	if (i == map.end())
+		return nullptr;
+
+	auto &item = *i->second;
+	if (std::chrono::steady_clock::now() >= item.expires) {
+		/* stale */
+		Remove(item);
+		return nullptr;
+	}
+
+	/* mark as "most recently used" */
+	lru.erase(lru.iterator_to(item));
+	lru.push_back(item);
+
+	return item.listing;
+}
+
+void
+StorageListingCache::Put(std::string_view key,
+			 StorageListingPtr listing) noexcept
+{
+	assert(listing);
+
+	const auto expires = std::chrono::steady_clock::now() +
+		(listing->error ? negative_ttl : ttl);
+	auto item = std::make_unique<Item>(key, std::move(listing), expires);
+
+	const std::scoped_lock lock{mutex};
+
+	if (auto i = map.find(key); i != map.end())
+		Remove(*i->second);
+
+	while (map.size() >= MAX_ITEMS)
+		Remove(lru.front());
+
+	lru.push_back(*item);
+
+	const std::string_view item_key = item->key;
+	map.emplace(item_key, std::move(item));
+}
+
+void
+StorageListingCache::Flush() noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	lru.clear();
+	map.clear();
+}
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_STORAGE_LISTING_CACHE_HXX
+#define MPD_STORAGE_LISTING_CACHE_HXX
+
+#include "FileInfo.hxx"
+#include "thread/Mutex.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * The contents of a storage directory, as obtained by
+ * Storage::OpenDirectory().
+ */
+struct StorageListing {
+	struct Entry {
+		std::string name;
+
+		StorageFileInfo info;
+
+		Entry(const char *_name, const StorageFileInfo &_info) noexcept
+			:name(_name), info(_info) {}
+	};
+
+	std::vector<Entry> entries;
+
+	/**
+	 * If this is set, then the directory could not be listed (a
+	 * negative cache entry), and #entries is empty.
+	 */
+	std::exception_ptr error;
+};
+
+using StorageListingPtr = std::shared_ptr<const StorageListing>;
+
+/**
+ * An in-memory cache for the directory listings sent by "listfiles"
+ * on remote storages (NFS, SMB, WebDAV), where each listing costs
+ * several network round trips.  Failed listings are cached for a
+ * shorter time.  Absolute storage URIs and mounted storages share
+ * this cache; it is flushed after each database update and when a
+ * storage is mounted or unmounted.
+ *
+ * This class is thread-safe, because "listfiles" runs in worker
+ * threads.
+ */
+class StorageListingCache {
+	struct Item : IntrusiveListHook<> {
+		const std::string key;
+
+		const StorageListingPtr listing;
+
+		const std::chrono::steady_clock::time_point expires;
+
+		Item(std::string_view _key, StorageListingPtr &&_listing,
+		     std::chrono::steady_clock::time_point _expires) noexcept
+			:key(_key), listing(std::move(_listing)),
+			 expires(_expires) {}
+	};
+
+	/**
+	 * The maximum number of cached directories.
+	 */
+	static constexpr std::size_t MAX_ITEMS = 1024;
+
+	/**
+	 * How long are successful listings valid?
+	 */
+	const std::chrono::steady_clock::duration ttl;
+
+	/**
+	 * How long are failed listings valid?
+	 */
+	const std::chrono::steady_clock::duration negative_ttl;
+
+	mutable Mutex mutex;
+
+	std::map<std::string_view, std::unique_ptr<Item>, std::less<>> map;
+
+	/**
+	 * All items, the least recently used first.
+	 */
+	IntrusiveList<Item> lru;
+
+public:
+	static constexpr std::chrono::steady_clock::duration DEFAULT_TTL =
+		std::chrono::seconds{60};
+
+	explicit StorageListingCache(std::chrono::steady_clock::duration _ttl) noexcept
+		:ttl(_ttl),
+		 negative_ttl(std::min<std::chrono::steady_clock::duration>(_ttl,
+									     std::chrono::seconds{10})) {}
+
+	~StorageListingCache() noexcept;
+
+	StorageListingCache(const StorageListingCache &) = delete;
+	StorageListingCache &operator=(const StorageListingCache &) = delete;
+
+	/**
+	 * Look up a directory listing.
+	 *
+	 * @param key the storage URI or the URI relative to the
+	 * music directory
+	 * @return the listing or nullptr if it is not in the cache
+	 */
+	StorageListingPtr Get(std::string_view key) noexcept;
+
+	/**
+	 * Add a listing to the cache, replacing an existing entry.
+	 */
+	void Put(std::string_view key, StorageListingPtr listing) noexcept;
+
+	/**
+	 * Remove all entries, e.g. after the music directory was
+	 * modified.
+	 */
+	void Flush() noexcept;
+
+private:
+	void Remove(Item &item) noexcept;
+};
+
+#endif
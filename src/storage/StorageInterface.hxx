@@ -47,6 +47,23 @@ public:
 	[[nodiscard]]
 	virtual std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) = 0;
 
+	/**
+	 * Announce that the caller is about to walk the whole
+	 * directory tree below the given directory (e.g. a database
+	 * update).  Remote storages may use this hint to fetch
+	 * directory listings in the background, so later
+	 * OpenDirectory() calls return without a network round
+	 * trip.  The listings are kept until CancelPrefetch() is
+	 * called.
+	 */
+	virtual void PrefetchTree([[maybe_unused]] std::string_view uri_utf8) noexcept {}
+
+	/**
+	 * Stop fetching directory listings announced by
+	 * PrefetchTree() and discard those which have not been used.
+	 */
+	virtual void CancelPrefetch() noexcept {}
+
 	/**
 	 * Map the given relative URI to an absolute URI.
 	 */
@@ -18,8 +18,10 @@
 #include "lib/curl/Handler.hxx"
 #include "lib/curl/Escape.hxx"
 #include "lib/expat/ExpatParser.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/ToBuffer.hxx"
 #include "fs/Traits.hxx"
+#include "event/Call.hxx"
 #include "event/InjectEvent.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
@@ -29,34 +31,131 @@
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 #include "util/UriExtract.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <cassert>
+#include <deque>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 using std::string_view_literals::operator""sv;
 
+static constexpr Domain curl_storage_domain("curl_storage");
+
+class HttpListDirectoryOperation;
+class HttpListTreeOperation;
+
 class CurlStorage final : public Storage {
+	/**
+	 * The maximum number of PROPFIND requests started by
+	 * PrefetchTree() which may be in flight at the same time.
+	 */
+	static constexpr std::size_t MAX_PREFETCH = 16;
+
 	const std::string base;
 
 	CurlInit curl;
 
+	/**
+	 * Protects all prefetch attributes below.
+	 */
+	Mutex prefetch_mutex;
+
+	/**
+	 * Set by PrefetchTree(), cleared by CancelPrefetch().  While
+	 * set, the child collections of each listing are fetched in
+	 * the background.
+	 */
+	bool prefetching = false;
+
+	/**
+	 * Shall we try a "Depth: infinity" PROPFIND to get the whole
+	 * tree at once?  Cleared after the server has refused it.
+	 */
+	bool depth_infinity = true;
+
+	/**
+	 * The "Depth: infinity" request started by PrefetchTree().
+	 */
+	std::unique_ptr<HttpListTreeOperation> tree_operation;
+
+	/**
+	 * Directories (relative URIs) which shall be fetched next,
+	 * in the order the walker is likely going to need them.
+	 */
+	std::deque<std::string> prefetch_queue;
+
+	/**
+	 * PROPFIND requests which have been started by the prefetcher
+	 * and have not yet been consumed by OpenDirectory().
+	 */
+	std::map<std::string, std::unique_ptr<HttpListDirectoryOperation>,
+		 std::less<>> prefetch_running;
+
+	/**
+	 * Listings obtained by #tree_operation which have not yet
+	 * been consumed by OpenDirectory().
+	 */
+	std::map<std::string, MemoryStorageDirectoryReader::List,
+		 std::less<>> prefetch_done;
+
 public:
 	CurlStorage(EventLoop &_loop, const char *_base)
 		:base(_base),
 		 curl(_loop) {}
 
+	~CurlStorage() noexcept override;
+
 	/* virtual methods from class Storage */
 	StorageFileInfo GetInfo(std::string_view uri_utf8, bool follow) override;
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) override;
 
+	void PrefetchTree(std::string_view uri_utf8) noexcept override;
+
+	void CancelPrefetch() noexcept override;
+
 	[[nodiscard]] std::string MapUTF8(std::string_view uri_utf8) const noexcept override;
 
 	[[nodiscard]] std::string_view MapToRelativeUTF8(std::string_view uri_utf8) const noexcept override;
 
 	InputStreamPtr OpenFile(std::string_view uri_utf8, Mutex &mutex) override;
+
+private:
+	/**
+	 * Map the given relative URI to the absolute URI of a
+	 * collection (with a trailing slash).
+	 */
+	[[gnu::pure]]
+	std::string MapCollection(std::string_view uri_utf8) const noexcept;
+
+	/**
+	 * Wait for #tree_operation and move its listings to
+	 * #prefetch_done.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void FinishTreeOperation(std::unique_lock<Mutex> &lock) noexcept;
+
+	/**
+	 * Add the child collections of the given listing to the front
+	 * of #prefetch_queue.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void QueueCollections(std::string_view uri_utf8,
+			      const MemoryStorageDirectoryReader::List &entries) noexcept;
+
+	/**
+	 * Start more requests from #prefetch_queue.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void StartPrefetch() noexcept;
 };
 
 std::string
@@ -103,6 +202,20 @@ public:
 		// TODO: use CurlInputStream's configuration
 	}
 
+	~BlockingHttpRequest() noexcept {
+		if (!LockIsDone())
+			/* cancel the transfer inside the IOThread */
+			BlockingCall(defer_start.GetEventLoop(), [this](){
+				defer_start.Cancel();
+				request.Stop();
+			});
+	}
+
+	bool LockIsDone() noexcept {
+		const std::scoped_lock lock{mutex};
+		return done;
+	}
+
 	void DeferStart() noexcept {
 		/* start the transfer inside the IOThread */
 		defer_start.Schedule();
@@ -247,7 +360,12 @@ class PropfindOperation : BlockingHttpRequest, CommonExpatParser {
 	DavResponse response;
 
 public:
-	PropfindOperation(CurlGlobal &_curl, const char *_uri, unsigned depth)
+	/**
+	 * @param depth the value of the "Depth" request header: "0",
+	 * "1" or "infinity"
+	 */
+	PropfindOperation(CurlGlobal &_curl, const char *_uri,
+			  const char *depth)
 		:BlockingHttpRequest(_curl, _uri),
 		 CommonExpatParser(ExpatNamespaceSeparator{'|'})
 	{
@@ -280,6 +398,7 @@ public:
 	using BlockingHttpRequest::GetEasy;
 	using BlockingHttpRequest::DeferStart;
 	using BlockingHttpRequest::Wait;
+	using BlockingHttpRequest::LockIsDone;
 
 protected:
 	virtual void OnDavResponse(DavResponse &&r) = 0;
@@ -431,7 +550,7 @@ class HttpGetInfoOperation final : public PropfindOperation {
 
 public:
 	HttpGetInfoOperation(CurlGlobal &curl, const char *uri)
-		:PropfindOperation(curl, uri, 0),
+		:PropfindOperation(curl, uri, "0"),
 		 info(StorageFileInfo::Type::OTHER) {
 	}
 
@@ -484,19 +603,21 @@ class HttpListDirectoryOperation final : public PropfindOperation {
 
 public:
 	HttpListDirectoryOperation(CurlGlobal &curl, const char *uri)
-		:PropfindOperation(curl, uri, 1),
+		:PropfindOperation(curl, uri, "1"),
 		 base_path(CurlUnescape(GetEasy(), UriPathOrSlash(uri))) {}
 
-	std::unique_ptr<StorageDirectoryReader> Perform() {
-		DeferStart();
+	/**
+	 * Wait for the response to a request which was started with
+	 * DeferStart() and return the listing.
+	 *
+	 * Throws on error.
+	 */
+	MemoryStorageDirectoryReader::List Finish() {
 		Wait();
-		return ToReader();
+		return std::move(entries);
 	}
 
 private:
-	std::unique_ptr<StorageDirectoryReader> ToReader() {
-		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
-	}
 
 	/**
 	 * Convert a "href" attribute (which may be an absolute URI)
@@ -549,8 +670,83 @@ protected:
 	}
 };
 
-std::unique_ptr<StorageDirectoryReader>
-CurlStorage::OpenDirectory(std::string_view uri_utf8)
+/**
+ * Obtain the listings of a whole directory tree with one
+ * "Depth: infinity" PROPFIND.  Many servers refuse this (with "403
+ * Forbidden"); then the caller falls back to one "Depth: 1" request
+ * per directory.
+ */
+class HttpListTreeOperation final : public PropfindOperation {
+	const std::string base_path;
+
+public:
+	/**
+	 * The listings, indexed by the directory URI relative to the
+	 * storage root.
+	 */
+	std::map<std::string, MemoryStorageDirectoryReader::List,
+		 std::less<>> tree;
+
+	HttpListTreeOperation(CurlGlobal &curl, const char *uri)
+		:PropfindOperation(curl, uri, "infinity"),
+		 base_path(CurlUnescape(GetEasy(), UriPathOrSlash(uri))) {}
+
+protected:
+	/* virtual methods from PropfindOperation */
+	void OnDavResponse(DavResponse &&r) override {
+		if (r.status != 200)
+			return;
+
+		std::string href = CurlUnescape(GetEasy(), r.href.c_str());
+		std::string_view path = uri_get_path(href.c_str());
+		if (path.data() == nullptr)
+			return;
+
+		path = StringAfterPrefixIgnoreCase(path, base_path);
+		if (path.data() == nullptr)
+			return;
+
+		if (r.collection && path.ends_with('/'))
+			path.remove_suffix(1);
+
+		if (r.collection)
+			/* make sure empty collections have an
+			   (empty) listing, too */
+			tree.try_emplace(std::string{path});
+
+		if (path.empty())
+			/* the root collection itself */
+			return;
+
+		const auto slash = path.rfind('/');
+		const auto parent = slash == path.npos
+			? std::string_view{}
+			: path.substr(0, slash);
+		const auto name = slash == path.npos
+			? path
+			: path.substr(slash + 1);
+		if (name.empty())
+			return;
+
+		auto &entries = tree.try_emplace(std::string{parent}).first->second;
+		entries.emplace_front(name);
+
+		auto &info = entries.front().info;
+		info = StorageFileInfo(r.collection
+				       ? StorageFileInfo::Type::DIRECTORY
+				       : StorageFileInfo::Type::REGULAR);
+		info.size = r.length;
+		info.mtime = r.mtime;
+	}
+};
+
+CurlStorage::~CurlStorage() noexcept
+{
+	CancelPrefetch();
+}
+
+std::string
+CurlStorage::MapCollection(std::string_view uri_utf8) const noexcept
 {
 	std::string uri = MapUTF8(uri_utf8);
 
@@ -558,7 +754,168 @@ CurlStorage::OpenDirectory(std::string_view uri_utf8)
 	if (uri.back() != '/')
 		uri.push_back('/');
 
-	return HttpListDirectoryOperation(*curl, uri.c_str()).Perform();
+	return uri;
+}
+
+inline void
+CurlStorage::FinishTreeOperation(std::unique_lock<Mutex> &lock) noexcept
+{
+	auto operation = std::move(tree_operation);
+
+	/* don't block other callers while waiting for the
+	   response */
+	lock.unlock();
+
+	try {
+		operation->Wait();
+	} catch (...) {
+		FmtDebug(curl_storage_domain,
+			 "Depth: infinity refused by {:?}: {}",
+			 base, std::current_exception());
+		lock.lock();
+		depth_infinity = false;
+		return;
+	}
+
+	lock.lock();
+
+	if (!prefetching)
+		/* canceled meanwhile */
+		return;
+
+	prefetch_done.merge(operation->tree);
+}
+
+void
+CurlStorage::StartPrefetch() noexcept
+{
+	std::size_t n_running = 0;
+	for (const auto &[uri, operation] : prefetch_running)
+		if (!operation->LockIsDone())
+			++n_running;
+
+	while (n_running < MAX_PREFETCH && !prefetch_queue.empty()) {
+		auto uri = std::move(prefetch_queue.front());
+		prefetch_queue.pop_front();
+
+		if (prefetch_done.contains(uri) ||
+		    prefetch_running.contains(uri))
+			continue;
+
+		try {
+			auto operation = std::make_unique<HttpListDirectoryOperation>(*curl, MapCollection(uri).c_str());
+			operation->DeferStart();
+			prefetch_running.emplace(std::move(uri),
+						 std::move(operation));
+			++n_running;
+		} catch (...) {
+			/* ignore; OpenDirectory() will try again and
+			   report the error */
+		}
+	}
+}
+
+void
+CurlStorage::PrefetchTree(std::string_view uri_utf8) noexcept
+{
+	std::unique_lock lock{prefetch_mutex};
+
+	prefetching = true;
+
+	if (depth_infinity && tree_operation == nullptr) {
+		try {
+			tree_operation = std::make_unique<HttpListTreeOperation>(*curl, MapCollection(uri_utf8).c_str());
+			tree_operation->DeferStart();
+			return;
+		} catch (...) {
+			tree_operation.reset();
+		}
+	}
+
+	prefetch_queue.emplace_front(uri_utf8);
+	StartPrefetch();
+}
+
+void
+CurlStorage::CancelPrefetch() noexcept
+{
+	std::unique_ptr<HttpListTreeOperation> old_tree_operation;
+	decltype(prefetch_running) old_running;
+
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+		prefetching = false;
+		prefetch_queue.clear();
+		prefetch_done.clear();
+		old_tree_operation = std::move(tree_operation);
+		old_running = std::move(prefetch_running);
+		prefetch_running.clear();
+	}
+
+	/* the requests are canceled by the destructors (outside of
+	   the lock) */
+}
+
+void
+CurlStorage::QueueCollections(std::string_view uri_utf8,
+			      const MemoryStorageDirectoryReader::List &entries) noexcept
+{
+	/* the walker is going to descend into the child collections
+	   in this order; fetch them before those queued earlier */
+	std::vector<std::string> children;
+	for (const auto &i : entries)
+		if (i.info.IsDirectory())
+			children.emplace_back(PathTraitsUTF8::Build(uri_utf8, i.name));
+
+	prefetch_queue.insert(prefetch_queue.begin(),
+			      std::make_move_iterator(children.begin()),
+			      std::make_move_iterator(children.end()));
+}
+
+std::unique_ptr<StorageDirectoryReader>
+CurlStorage::OpenDirectory(std::string_view uri_utf8)
+{
+	std::unique_ptr<HttpListDirectoryOperation> operation;
+	MemoryStorageDirectoryReader::List entries;
+	bool found = false;
+
+	{
+		std::unique_lock lock{prefetch_mutex};
+
+		if (tree_operation != nullptr)
+			FinishTreeOperation(lock);
+
+		if (auto i = prefetch_done.find(uri_utf8);
+		    i != prefetch_done.end()) {
+			entries = std::move(i->second);
+			prefetch_done.erase(i);
+			found = true;
+		} else if (auto j = prefetch_running.find(uri_utf8);
+			   j != prefetch_running.end()) {
+			operation = std::move(j->second);
+			prefetch_running.erase(j);
+		}
+	}
+
+	if (!found) {
+		if (operation == nullptr) {
+			operation = std::make_unique<HttpListDirectoryOperation>(*curl, MapCollection(uri_utf8).c_str());
+			operation->DeferStart();
+		}
+
+		entries = operation->Finish();
+	}
+
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+
+		if (prefetching) {
+			QueueCollections(uri_utf8, entries);
+			StartPrefetch();
+		}
+	}
+
+	return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 }
 
 static std::unique_ptr<Storage>
@@ -11,6 +11,21 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/DirectoryReader.hxx"
 #include "util/StringCompare.hxx"
+#include "io/uring/Features.h"
+
+#ifdef HAVE_URING
+#include "io/uring/Operation.hxx"
+#include "io/uring/Queue.hxx"
+#include "system/Error.hxx"
+
+#include <cassert>
+#include <list>
+#include <memory>
+
+#include <fcntl.h> // for AT_FDCWD
+#include <sys/stat.h>
+#include <sys/sysmacros.h> // for makedev()
+#endif
 
 #include <string>
 
@@ -30,6 +45,124 @@ public:
 	StorageFileInfo GetInfo(bool follow) override;
 };
 
+#ifdef HAVE_URING
+
+/**
+ * The maximum number of IORING_OP_STATX requests in flight.
+ */
+static constexpr unsigned LOCAL_STAT_BATCH = 256;
+
+/**
+ * An io_uring used by #UringLocalDirectoryReader.  Submitting is
+ * deferred until Flush(), so a whole batch is submitted with one
+ * system call.
+ */
+class LocalStatQueue final : public Uring::Queue {
+public:
+	LocalStatQueue()
+		:Queue(LOCAL_STAT_BATCH, 0) {}
+
+	void Flush() {
+		Queue::Submit();
+	}
+
+	/**
+	 * Wait for all pending requests to complete.
+	 *
+	 * Throws on error.
+	 */
+	void WaitAll() {
+		while (HasPending()) {
+			try {
+				WaitDispatchOneCompletion();
+			} catch (const std::system_error &e) {
+				if (!IsErrno(e, EINTR))
+					throw;
+			}
+		}
+	}
+
+	/* virtual methods from class Uring::Queue */
+	void Submit() override {}
+};
+
+/**
+ * Returns this thread's #LocalStatQueue or nullptr if io_uring is
+ * not available.
+ */
+static LocalStatQueue *
+GetLocalStatQueue() noexcept
+{
+	/* one per thread because the database update runs in its
+	   own thread, and other storage accesses happen in the main
+	   thread */
+	thread_local std::unique_ptr<LocalStatQueue> queue;
+	thread_local bool initialized = false;
+
+	if (!initialized) {
+		initialized = true;
+
+		try {
+			queue = std::make_unique<LocalStatQueue>();
+		} catch (...) {
+			/* fall back to synchronous stat() */
+		}
+	}
+
+	return queue.get();
+}
+
+/**
+ * A #StorageDirectoryReader which reads the whole directory at once
+ * and then obtains the attributes of all entries with batches of
+ * asynchronous IORING_OP_STATX requests.  This hides most of the
+ * latency of cold inode caches, e.g. during a database update.
+ */
+class UringLocalDirectoryReader final : public StorageDirectoryReader {
+	struct Entry final : Uring::Operation {
+		const std::string name_utf8;
+		const AllocatedPath path_fs;
+
+		struct statx stx;
+
+		/**
+		 * 0 if #stx is valid, an errno value on error, -1 if
+		 * no result is available.
+		 */
+		int error = -1;
+
+		Entry(std::string &&_name_utf8, AllocatedPath &&_path_fs) noexcept
+			:name_utf8(std::move(_name_utf8)),
+			 path_fs(std::move(_path_fs)) {}
+
+		/* virtual methods from class Uring::Operation */
+		void OnUringCompletion(int res) noexcept override {
+			error = res < 0 ? -res : 0;
+		}
+	};
+
+	using EntryList = std::list<Entry>;
+
+	EntryList entries;
+
+	EntryList::iterator next, current;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	UringLocalDirectoryReader(LocalStatQueue &queue, Path base_fs);
+
+	/* virtual methods from class StorageDirectoryReader */
+	const char *Read() noexcept override;
+	StorageFileInfo GetInfo(bool follow) override;
+
+private:
+	void StatAll(LocalStatQueue &queue);
+};
+
+#endif
+
 class LocalStorage final : public Storage {
 	const AllocatedPath base_fs;
 	const std::string base_utf8;
@@ -135,6 +268,12 @@ LocalStorage::GetInfo(std::string_view uri_utf8, bool follow)
 std::unique_ptr<StorageDirectoryReader>
 LocalStorage::OpenDirectory(std::string_view uri_utf8)
 {
+#ifdef HAVE_URING
+	if (auto *queue = GetLocalStatQueue())
+		return std::make_unique<UringLocalDirectoryReader>(*queue,
+								   MapFSOrThrow(uri_utf8));
+#endif
+
 	return std::make_unique<LocalDirectoryReader>(MapFSOrThrow(uri_utf8));
 }
 
@@ -162,6 +301,104 @@ LocalDirectoryReader::GetInfo(bool follow)
 	return Stat(base_fs / reader.GetEntry(), follow);
 }
 
+#ifdef HAVE_URING
+
+UringLocalDirectoryReader::UringLocalDirectoryReader(LocalStatQueue &queue,
+						     Path base_fs)
+{
+	DirectoryReader reader{base_fs};
+	while (reader.ReadEntry()) {
+		const Path name_fs = reader.GetEntry();
+		if (PathTraitsFS::IsSpecialFilename(name_fs.c_str()))
+			continue;
+
+		try {
+			entries.emplace_back(name_fs.ToUTF8Throw(),
+					     base_fs / name_fs);
+		} catch (...) {
+		}
+	}
+
+	StatAll(queue);
+
+	next = entries.begin();
+	current = entries.end();
+}
+
+inline void
+UringLocalDirectoryReader::StatAll(LocalStatQueue &queue)
+{
+	auto i = entries.begin();
+
+	try {
+		while (i != entries.end()) {
+			for (unsigned n = 0;
+			     n < LOCAL_STAT_BATCH && i != entries.end();
+			     ++n, ++i) {
+				auto &s = queue.RequireSubmitEntry();
+				io_uring_prep_statx(&s, AT_FDCWD,
+						    i->path_fs.c_str(), 0,
+						    STATX_BASIC_STATS,
+						    &i->stx);
+				queue.Push(s, *i);
+			}
+
+			queue.Flush();
+			queue.WaitAll();
+		}
+	} catch (...) {
+		/* the kernel may still write to the #Entry
+		   instances, so wait for them before giving up;
+		   entries without a result fall back to stat() in
+		   GetInfo() */
+		queue.WaitAll();
+	}
+}
+
+const char *
+UringLocalDirectoryReader::Read() noexcept
+{
+	if (next == entries.end())
+		return nullptr;
+
+	current = next++;
+	return current->name_utf8.c_str();
+}
+
+StorageFileInfo
+UringLocalDirectoryReader::GetInfo(bool follow)
+{
+	assert(current != entries.end());
+
+	const auto &e = *current;
+	if (!follow || e.error != 0)
+		/* IORING_OP_STATX has followed symlinks; for
+		   lstat() and for generating error messages (or if
+		   this kernel doesn't support IORING_OP_STATX), use
+		   the synchronous code path */
+		return Stat(e.path_fs, follow);
+
+	StorageFileInfo info;
+
+	if (S_ISREG(e.stx.stx_mode))
+		info.type = StorageFileInfo::Type::REGULAR;
+	else if (S_ISDIR(e.stx.stx_mode))
+		info.type = StorageFileInfo::Type::DIRECTORY;
+	else
+		info.type = StorageFileInfo::Type::OTHER;
+
+	info.size = e.stx.stx_size;
+
+	/* same precision as FileInfo::GetModificationTime() */
+	info.mtime = std::chrono::system_clock::from_time_t(e.stx.stx_mtime.tv_sec);
+
+	info.device = makedev(e.stx.stx_dev_major, e.stx.stx_dev_minor);
+	info.inode = e.stx.stx_ino;
+	return info;
+}
+
+#endif
+
 std::unique_ptr<Storage>
 CreateLocalStorage(Path base_fs)
 {
@@ -22,6 +22,7 @@
 #include "event/CoarseTimerEvent.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringCompare.hxx"
+#include "fs/Traits.hxx"
 
 extern "C" {
 #include <nfsc/libnfs.h>
@@ -31,13 +32,19 @@ extern "C" {
 #include <fmt/core.h>
 
 #include <cassert>
+#include <deque>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <sys/stat.h>
 #include <fcntl.h>
 
 using std::string_view_literals::operator""sv;
 
+class NfsListDirectoryOperation;
+
 class NfsStorage final
 	: public Storage, NfsLease {
 
@@ -45,6 +52,12 @@ class NfsStorage final
 		INITIAL, CONNECTING, READY, DELAY,
 	};
 
+	/**
+	 * The maximum number of directory listings started by
+	 * PrefetchTree() which may be in flight at the same time.
+	 */
+	static constexpr std::size_t MAX_PREFETCH = 8;
+
 	/**
 	 * The full configured URL (with all arguemnts).  This is used
 	 * to reconnect.
@@ -66,6 +79,40 @@ class NfsStorage final
 	State state = State::CONNECTING;
 	std::exception_ptr last_exception;
 
+	/**
+	 * Protects all prefetch attributes below.
+	 */
+	Mutex prefetch_mutex;
+
+	/**
+	 * Set by PrefetchTree(), cleared by CancelPrefetch().  While
+	 * set, the subdirectories of each listing are fetched in the
+	 * background, and the attributes of all entries are kept in
+	 * #attributes.
+	 */
+	bool prefetching = false;
+
+	/**
+	 * Directories (relative URIs) which shall be listed next, in
+	 * the order the walker is likely going to need them.
+	 */
+	std::deque<std::string> prefetch_queue;
+
+	/**
+	 * Listings which have been started by the prefetcher and
+	 * have not yet been consumed by OpenDirectory().
+	 */
+	std::map<std::string, std::unique_ptr<NfsListDirectoryOperation>,
+		 std::less<>> prefetch_running;
+
+	/**
+	 * The attributes of all directory entries listed since
+	 * PrefetchTree() (obtained with READDIRPLUS), indexed by
+	 * their relative URI.  This answers GetInfo() calls without
+	 * another round trip.
+	 */
+	std::map<std::string, StorageFileInfo, std::less<>> attributes;
+
 public:
 	NfsStorage(const char *_url, NfsConnection &_connection)
 		:url(_url),
@@ -80,6 +127,7 @@ public:
 	}
 
 	~NfsStorage() override {
+		CancelPrefetch();
 		BlockingCall(GetEventLoop(), [this](){ Disconnect(); });
 		nfs_finish();
 	}
@@ -92,6 +140,10 @@ public:
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) override;
 
+	void PrefetchTree(std::string_view uri_utf8) noexcept override;
+
+	void CancelPrefetch() noexcept override;
+
 	[[nodiscard]] std::string MapUTF8(std::string_view uri_utf8) const noexcept override;
 
 	[[nodiscard]] std::string_view MapToRelativeUTF8(std::string_view uri_utf8) const noexcept override;
@@ -198,6 +250,23 @@ private:
 		}
 	}
 
+	/**
+	 * Add the subdirectories of the given listing to the front of
+	 * #prefetch_queue and remember the attributes of all
+	 * entries.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void AddListing(std::string_view uri_utf8,
+			const MemoryStorageDirectoryReader::List &entries) noexcept;
+
+	/**
+	 * Start more listings from #prefetch_queue.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void StartPrefetch() noexcept;
+
 	void Disconnect() noexcept {
 		assert(!GetEventLoop().IsAlive() || GetEventLoop().IsInside());
 
@@ -305,6 +374,17 @@ protected:
 StorageFileInfo
 NfsStorage::GetInfo(std::string_view uri_utf8, bool follow)
 {
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+
+		/* symlinks are listed as "other"; only a real stat
+		   call can follow them */
+		if (auto i = attributes.find(uri_utf8);
+		    i != attributes.end() &&
+		    (!follow || i->second.type != StorageFileInfo::Type::OTHER))
+			return i->second;
+	}
+
 	const std::string path = UriToNfsPath(uri_utf8);
 
 	WaitConnected();
@@ -345,22 +425,29 @@ Copy(StorageFileInfo &info, const struct nfsdirent &ent)
 }
 
 class NfsListDirectoryOperation final : public BlockingNfsOperation {
-	const char *const path;
+	const std::string path;
 
 	MemoryStorageDirectoryReader::List entries;
 
 public:
 	NfsListDirectoryOperation(NfsConnection &_connection,
-				  const char *_path)
-		:BlockingNfsOperation(_connection), path(_path) {}
+				  std::string &&_path)
+		:BlockingNfsOperation(_connection), path(std::move(_path)) {}
 
-	std::unique_ptr<StorageDirectoryReader> ToReader() {
-		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
+	/**
+	 * Wait for an operation which was started with Launch() and
+	 * return the listing.
+	 *
+	 * Throws on error.
+	 */
+	MemoryStorageDirectoryReader::List Finish() {
+		Wait();
+		return std::move(entries);
 	}
 
 protected:
 	void Start() override {
-		connection.OpenDirectory(path, *this);
+		connection.OpenDirectory(path.c_str(), *this);
 	}
 
 	void HandleResult([[maybe_unused]] unsigned status,
@@ -403,17 +490,139 @@ NfsListDirectoryOperation::CollectEntries(struct nfsdir *dir)
 	}
 }
 
+void
+NfsStorage::AddListing(std::string_view uri_utf8,
+		       const MemoryStorageDirectoryReader::List &entries) noexcept
+{
+	/* the walker is going to descend into the subdirectories in
+	   this order; list them before those queued earlier */
+	std::vector<std::string> children;
+
+	for (const auto &i : entries) {
+		auto child = PathTraitsUTF8::Build(uri_utf8, i.name);
+		if (i.info.IsDirectory())
+			children.emplace_back(child);
+
+		attributes.insert_or_assign(std::move(child), i.info);
+	}
+
+	prefetch_queue.insert(prefetch_queue.begin(),
+			      std::make_move_iterator(children.begin()),
+			      std::make_move_iterator(children.end()));
+}
+
+void
+NfsStorage::StartPrefetch() noexcept
+{
+	{
+		const std::scoped_lock protect{mutex};
+		if (state != State::CONNECTING && state != State::READY)
+			return;
+	}
+
+	std::size_t n_running = 0;
+	for (const auto &[uri, operation] : prefetch_running)
+		if (!operation->LockIsFinished())
+			++n_running;
+
+	while (n_running < MAX_PREFETCH && !prefetch_queue.empty()) {
+		auto uri = std::move(prefetch_queue.front());
+		prefetch_queue.pop_front();
+
+		if (prefetch_running.contains(uri))
+			continue;
+
+		try {
+			auto operation = std::make_unique<NfsListDirectoryOperation>(*connection, UriToNfsPath(uri));
+			operation->Launch();
+			prefetch_running.emplace(std::move(uri),
+						 std::move(operation));
+			++n_running;
+		} catch (...) {
+			/* ignore; OpenDirectory() will try again and
+			   report the error */
+		}
+	}
+}
+
+void
+NfsStorage::PrefetchTree(std::string_view uri_utf8) noexcept
+{
+	try {
+		WaitConnected();
+	} catch (...) {
+		/* OpenDirectory() will report the error */
+		return;
+	}
+
+	const std::scoped_lock lock{prefetch_mutex};
+
+	prefetching = true;
+	prefetch_queue.emplace_front(uri_utf8);
+	StartPrefetch();
+}
+
+void
+NfsStorage::CancelPrefetch() noexcept
+{
+	decltype(prefetch_running) old_running;
+
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+		prefetching = false;
+		prefetch_queue.clear();
+		attributes.clear();
+		old_running = std::move(prefetch_running);
+		prefetch_running.clear();
+	}
+
+	/* libnfs cannot cancel a directory listing without leaking
+	   it, so wait for the remaining ones to finish (outside of
+	   the lock) */
+	for (auto &[uri, operation] : old_running) {
+		try {
+			operation->Finish();
+		} catch (...) {
+		}
+	}
+}
+
 std::unique_ptr<StorageDirectoryReader>
 NfsStorage::OpenDirectory(std::string_view uri_utf8)
 {
-	const std::string path = UriToNfsPath(uri_utf8);
+	std::unique_ptr<NfsListDirectoryOperation> operation;
 
-	WaitConnected();
+	{
+		const std::scoped_lock lock{prefetch_mutex};
 
-	NfsListDirectoryOperation operation(*connection, path.c_str());
-	operation.Run();
+		if (auto i = prefetch_running.find(uri_utf8);
+		    i != prefetch_running.end()) {
+			operation = std::move(i->second);
+			prefetch_running.erase(i);
+		}
+	}
+
+	if (operation == nullptr) {
+		std::string path = UriToNfsPath(uri_utf8);
+
+		WaitConnected();
+
+		operation = std::make_unique<NfsListDirectoryOperation>(*connection, std::move(path));
+		operation->Launch();
+	}
+
+	auto entries = operation->Finish();
+
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+
+		if (prefetching) {
+			AddListing(uri_utf8, entries);
+			StartPrefetch();
+		}
+	}
 
-	return operation.ToReader();
+	return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 }
 
 static std::unique_ptr<Storage>
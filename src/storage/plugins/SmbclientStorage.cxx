@@ -7,9 +7,8 @@
 #include "storage/FileInfo.hxx"
 #include "input/InputStream.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Pool.hxx"
 #include "fs/Traits.hxx"
-#include "thread/Mutex.hxx"
 #include "system/Error.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringCompare.hxx"
@@ -17,22 +16,30 @@
 
 #include <libsmbclient.h>
 
+#include <cassert>
+#include <forward_list>
+
 class SmbclientStorage;
 
+/**
+ * The directory is read completely by SmbclientStorage::OpenDirectory()
+ * so no #SmbclientContext needs to be held while the caller walks
+ * through the entries (and possibly opens subdirectories).
+ */
 class SmbclientDirectoryReader final : public StorageDirectoryReader {
 	SmbclientStorage &storage;
 	const std::string base;
-	SMBCFILE *const handle;
 
-	const char *name;
+	std::forward_list<std::string> names;
+
+	bool first = true;
 
 public:
 	SmbclientDirectoryReader(SmbclientStorage &_storage,
 				 std::string &&_base,
-				 SMBCFILE *_handle) noexcept
-		:storage(_storage), base(std::move(_base)), handle(_handle) {}
-
-	~SmbclientDirectoryReader() override;
+				 std::forward_list<std::string> &&_names) noexcept
+		:storage(_storage), base(std::move(_base)),
+		 names(std::move(_names)) {}
 
 	/* virtual methods from class StorageDirectoryReader */
 	const char *Read() noexcept override;
@@ -44,13 +51,14 @@ class SmbclientStorage final : public Storage {
 
 	const std::string base;
 
+	static constexpr std::size_t MAX_IDLE_CONTEXTS = 4;
+
 	/**
-	 * This mutex protects all calls into the #SmbclientContext,
-	 * which is not thread-safe.
+	 * The #SmbclientContext is not thread-safe; each caller
+	 * borrows one from this pool, so concurrent callers do not
+	 * block each other.
 	 */
-	Mutex mutex;
-
-	SmbclientContext ctx = SmbclientContext::New();
+	SmbclientContextPool pool{MAX_IDLE_CONTEXTS};
 
 public:
 	explicit SmbclientStorage(const char *_base)
@@ -84,13 +92,13 @@ SmbclientStorage::MapToRelativeUTF8(std::string_view uri_utf8) const noexcept
 }
 
 static StorageFileInfo
-GetInfo(SmbclientContext &ctx, Mutex &mutex, const char *path)
+GetInfo(SmbclientContextPool &pool, const char *path)
 {
 	struct stat st;
 
 	{
-		const std::scoped_lock protect{mutex};
-		if (ctx.Stat(path, st) != 0)
+		auto ctx = pool.Get();
+		if (ctx->Stat(path, st) != 0)
 			throw MakeErrno("Failed to access file");
 	}
 
@@ -113,7 +121,7 @@ StorageFileInfo
 SmbclientStorage::GetInfo(std::string_view uri_utf8, [[maybe_unused]] bool follow)
 {
 	const std::string mapped = MapUTF8(uri_utf8);
-	return ::GetInfo(ctx, mutex, mapped.c_str());
+	return ::GetInfo(pool, mapped.c_str());
 }
 
 InputStreamPtr
@@ -123,58 +131,57 @@ SmbclientStorage::OpenFile(std::string_view uri_utf8, Mutex &file_mutex)
 	return InputStream::Open(uri.c_str(), file_mutex);
 }
 
+[[gnu::pure]]
+static bool
+SkipNameFS(PathTraitsFS::const_pointer name) noexcept
+{
+	return PathTraitsFS::IsSpecialFilename(name);
+}
+
 std::unique_ptr<StorageDirectoryReader>
 SmbclientStorage::OpenDirectory(std::string_view uri_utf8)
 {
 	std::string mapped = MapUTF8(uri_utf8);
 
-	SMBCFILE *handle;
+	std::forward_list<std::string> names;
 
 	{
-		const std::scoped_lock protect{mutex};
-		handle = ctx.OpenDirectory(mapped.c_str());
-	}
+		auto ctx = pool.Get();
 
-	if (handle == nullptr)
-		throw MakeErrno("Failed to open directory");
+		SMBCFILE *handle = ctx->OpenDirectory(mapped.c_str());
+		if (handle == nullptr)
+			throw MakeErrno("Failed to open directory");
 
-	return std::make_unique<SmbclientDirectoryReader>(*this,
-							  std::move(mapped),
-							  handle);
-}
+		AtScopeExit(&ctx, handle) { ctx->CloseDirectory(handle); };
 
-[[gnu::pure]]
-static bool
-SkipNameFS(PathTraitsFS::const_pointer name) noexcept
-{
-	return PathTraitsFS::IsSpecialFilename(name);
-}
+		while (auto e = ctx->ReadDirectory(handle))
+			if (!SkipNameFS(e->name))
+				names.emplace_front(e->name);
+	}
 
-SmbclientDirectoryReader::~SmbclientDirectoryReader()
-{
-	const std::scoped_lock lock{storage.mutex};
-	storage.ctx.CloseDirectory(handle);
+	return std::make_unique<SmbclientDirectoryReader>(*this,
+							  std::move(mapped),
+							  std::move(names));
 }
 
 const char *
 SmbclientDirectoryReader::Read() noexcept
 {
-	const std::scoped_lock protect{storage.mutex};
-
-	while (auto e = storage.ctx.ReadDirectory(handle)) {
-		name = e->name;
-		if (!SkipNameFS(name))
-			return name;
-	}
+	if (first)
+		first = false;
+	else
+		names.pop_front();
 
-	return nullptr;
+	return names.empty() ? nullptr : names.front().c_str();
 }
 
 StorageFileInfo
 SmbclientDirectoryReader::GetInfo([[maybe_unused]] bool follow)
 {
-	const std::string path = PathTraitsUTF8::Build(base, name);
-	return ::GetInfo(storage.ctx, storage.mutex, path.c_str());
+	assert(!names.empty());
+
+	const std::string path = PathTraitsUTF8::Build(base, names.front());
+	return ::GetInfo(storage.pool, path.c_str());
 }
 
 static std::unique_ptr<Storage>
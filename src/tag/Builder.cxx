@@ -6,7 +6,7 @@
 #include "Pool.hxx"
 #include "FixString.hxx"
 #include "Tag.hxx"
-#include "util/AllocatedArray.hxx"
+#include "ItemArray.hxx"
 
 #include <algorithm>
 #include <array>
@@ -20,25 +20,45 @@ TagBuilder::TagBuilder(const Tag &other) noexcept
 	const std::size_t n = other.num_items;
 	if (n > 0) {
 		items.reserve(other.num_items);
-		const std::scoped_lock protect{tag_pool_lock};
 		for (std::size_t i = 0; i != n; ++i)
 			items.push_back(tag_pool_dup_item(other.items[i]));
 	}
 }
 
-TagBuilder::TagBuilder(Tag &&other) noexcept
-	:duration(other.duration), has_playlist(other.has_playlist)
+inline void
+TagBuilder::MoveItemsFrom(Tag &&other) noexcept
 {
+	if (other.items == nullptr)
+		return;
+
+	items.reserve(items.size() + other.num_items);
+
+	if (TagItemArray::IsShared(other.items)) {
+		/* the array is shared with other Tag objects; we
+		   need our own references */
+		for (unsigned i = 0; i < other.num_items; ++i)
+			items.push_back(tag_pool_dup_item(other.items[i]));
+
+		other.Clear();
+		return;
+	}
+
 	/* move all TagItem pointers from the Tag object; we don't
 	   need to contact the tag pool, because all we do is move
 	   references */
-	items.reserve(other.num_items);
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
+	TagItemArray::Free(other.items);
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
+	other.types = TagMask::None();
+}
+
+TagBuilder::TagBuilder(Tag &&other) noexcept
+	:duration(other.duration), has_playlist(other.has_playlist)
+{
+	MoveItemsFrom(std::move(other));
 }
 
 TagBuilder &
@@ -54,7 +74,6 @@ TagBuilder::operator=(const TagBuilder &other) noexcept
 		items = other.items;
 
 		/* increment the tag pool refcounters */
-		const std::scoped_lock protect{tag_pool_lock};
 		for (auto &i : items)
 			i = tag_pool_dup_item(i);
 	}
@@ -83,17 +102,8 @@ TagBuilder::operator=(Tag &&other) noexcept
 	duration = other.duration;
 	has_playlist = other.has_playlist;
 
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
 	RemoveAll();
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	MoveItemsFrom(std::move(other));
 
 	return *this;
 }
@@ -120,8 +130,13 @@ TagBuilder::Commit(Tag &tag) noexcept
 	   object */
 	const unsigned n_items = items.size();
 	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
+	if (n_items > 0) {
+		tag.items = TagItemArray::Allocate(n_items);
+		std::copy_n(items.begin(), n_items, tag.items);
+
+		for (const TagItem *i : items)
+			tag.types.Set(i->type);
+	}
 	items.clear();
 
 	/* now ensure that this object is fresh (will not delete any
@@ -170,7 +185,6 @@ TagBuilder::Complement(const Tag &other) noexcept
 
 		items.reserve(items.size() + n);
 
-		const std::scoped_lock protect{tag_pool_lock};
 		for (std::size_t i = 0; i != n; ++i) {
 			TagItem *item = other.items[i];
 			if (!present[item->type])
@@ -182,14 +196,7 @@ TagBuilder::Complement(const Tag &other) noexcept
 void
 TagBuilder::AddItemUnchecked(TagType type, std::string_view value) noexcept
 {
-	TagItem *i;
-
-	{
-		const std::scoped_lock protect{tag_pool_lock};
-		i = tag_pool_get_item(type, value);
-	}
-
-	items.push_back(i);
+	items.push_back(tag_pool_get_item(type, value));
 }
 
 inline void
@@ -197,11 +204,7 @@ TagBuilder::AddItemInternal(TagType type, std::string_view value) noexcept
 {
 	assert(!value.empty());
 
-	auto f = FixTagString(value);
-	if (f != nullptr)
-		value = { f.data(), f.size() };
-
-	AddItemUnchecked(type, value);
+	AddItemUnchecked(type, FixTagString(value));
 }
 
 void
@@ -222,16 +225,8 @@ TagBuilder::AddEmptyItem(TagType type) noexcept
 void
 TagBuilder::RemoveAll() noexcept
 {
-	if (items.empty())
-		/* don't acquire the tag_pool_lock if we're not going
-		   to call tag_pool_put_item() anyway */
-		return;
-
-	{
-		const std::scoped_lock protect{tag_pool_lock};
-		for (auto i : items)
-			tag_pool_put_item(i);
-	}
+	for (auto i : items)
+		tag_pool_put_item(i);
 
 	items.clear();
 }
@@ -239,14 +234,8 @@ TagBuilder::RemoveAll() noexcept
 void
 TagBuilder::RemoveType(TagType type) noexcept
 {
-	if (items.empty())
-		/* don't acquire the tag_pool_lock if we're not going
-		   to call tag_pool_put_item() anyway */
-		return;
-
 	const auto begin = items.begin(), end = items.end();
 
-	const std::scoped_lock protect{tag_pool_lock};
 	items.erase(std::remove_if(begin, end,
 				   [type](TagItem *item) {
 					   if (item->type != type)
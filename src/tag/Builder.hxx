@@ -150,6 +150,12 @@ public:
 	void RemoveType(TagType type) noexcept;
 
 private:
+	/**
+	 * Take over all items from the #Tag (without touching the
+	 * #TagPool if its item array is not shared).
+	 */
+	void MoveItemsFrom(Tag &&other) noexcept;
+
 	void AddItemInternal(TagType type, std::string_view value) noexcept;
 };
 
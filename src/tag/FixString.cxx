@@ -2,15 +2,13 @@
 // Copyright The Music Player Daemon Project
 
 #include "FixString.hxx"
-#include "util/AllocatedArray.hxx"
 #include "util/CharUtil.hxx"
+#include "util/ReusableArray.hxx"
 #include "util/UTF8.hxx"
 
 #include <algorithm>
 #include <cassert>
 
-#include <stdlib.h>
-
 [[gnu::pure]]
 static const char *
 FindInvalidUTF8(const char *p, const char *const end) noexcept
@@ -35,37 +33,17 @@ FindInvalidUTF8(const char *p, const char *const end) noexcept
 }
 
 /**
- * Replace invalid sequences with the question mark.
+ * Replace invalid sequences with the question mark (in place).
  */
-static AllocatedArray<char>
-patch_utf8(std::string_view src, const char *_invalid) noexcept
+static void
+patch_utf8(char *invalid, const char *const end) noexcept
 {
-	/* duplicate the string, and replace invalid bytes in that
-	   buffer */
-	AllocatedArray<char> dest{src};
-	char *const end = dest.data() + src.size();
-
-	char *invalid = dest.data() + (_invalid - src.data());
 	do {
 		*invalid = '?';
 
 		const char *__invalid = FindInvalidUTF8(invalid + 1, end);
 		invalid = const_cast<char *>(__invalid);
 	} while (invalid != nullptr);
-
-	return dest;
-}
-
-static AllocatedArray<char>
-fix_utf8(std::string_view p) noexcept
-{
-	/* check if the string is already valid UTF-8 */
-	const char *invalid = FindInvalidUTF8(p.data(), p.data() + p.size());
-	if (invalid == nullptr)
-		return nullptr;
-
-	/* no, broken - patch invalid sequences */
-	return patch_utf8(p, invalid);
 }
 
 [[gnu::pure]]
@@ -80,23 +58,15 @@ find_non_printable(std::string_view p) noexcept
 }
 
 /**
- * Clears all non-printable characters, convert them to space.
- * Returns nullptr if nothing needs to be cleared.
+ * Clears all non-printable characters (in place), convert them to
+ * space.
  */
-static AllocatedArray<char>
-clear_non_printable(std::string_view src)
+static void
+clear_non_printable(char *p, const char *const end) noexcept
 {
-	const char *first = find_non_printable(src);
-	if (first == nullptr)
-		return nullptr;
-
-	AllocatedArray<char> dest{src};
-
-	for (size_t i = first - src.data(); i < src.size(); ++i)
-		if (IsNonPrintableASCII(dest[i]))
-			dest[i] = ' ';
-
-	return dest;
+	for (; p < end; ++p)
+		if (IsNonPrintableASCII(*p))
+			*p = ' ';
 }
 
 [[gnu::pure]]
@@ -109,20 +79,31 @@ IsSafe(std::string_view s) noexcept
 			   });
 }
 
-AllocatedArray<char>
+std::string_view
 FixTagString(std::string_view p) noexcept
 {
 	if (IsSafe(p))
 		/* optimistic optimization for the common case */
-		return nullptr;
+		return p;
+
+	const char *invalid = FindInvalidUTF8(p.data(), p.data() + p.size());
+	const char *non_printable = find_non_printable(p);
+	if (invalid == nullptr && non_printable == nullptr)
+		return p;
+
+	/* this buffer is reused for all strings fixed in this thread,
+	   therefore it does not need to be allocated again for each
+	   tag value */
+	static thread_local ReusableArray<char, 256> buffer;
+
+	char *const dest = buffer.Get(p.size());
+	char *const end = std::copy(p.begin(), p.end(), dest);
 
-	auto utf8 = fix_utf8(p);
-	if (utf8 != nullptr)
-		p = {utf8.data(), utf8.size()};
+	if (invalid != nullptr)
+		patch_utf8(dest + (invalid - p.data()), end);
 
-	auto cleared = clear_non_printable(p);
-	if (cleared == nullptr)
-		cleared = std::move(utf8);
+	if (non_printable != nullptr)
+		clear_non_printable(dest + (non_printable - p.data()), end);
 
-	return cleared;
+	return {dest, p.size()};
 }
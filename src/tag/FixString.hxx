@@ -6,9 +6,15 @@
 
 #include <string_view>
 
-template<typename T> class AllocatedArray;
-
-AllocatedArray<char>
+/**
+ * Replace invalid UTF-8 sequences and non-printable characters in a
+ * tag value.
+ *
+ * @return the fixed string; this is either the given string (if it
+ * was already valid) or a view into a per-thread buffer which remains
+ * valid until the next call in the same thread
+ */
+std::string_view
 FixTagString(std::string_view p) noexcept;
 
 #endif
@@ -2,69 +2,94 @@
 // Copyright The Music Player Daemon Project
 
 #include "Names.hxx"
+#include "NameHash.hxx"
 
+#include <algorithm>
 #include <cstdlib>
-#include <map>
-#include <string_view>
+#include <vector>
 
 #include <stdio.h>
 
 /*
 
-  This program generates an optimized parser for tag names, by doign
-  switch() on the first character.  This reduces the number of
-  strcmp() calls.
+  This program generates a perfect hash table for tag names: it
+  searches a seed for TagNameHash() which maps each name to a
+  different slot, so looking up a name needs only one hash
+  calculation and one string comparison.  The hash ignores case,
+  therefore the same table is used by tag_name_parse() and
+  tag_name_parse_i().
 
  */
 
+static bool
+TryTable(std::vector<unsigned> &table, uint32_t seed) noexcept
+{
+	const std::size_t mask = table.size() - 1;
+
+	std::fill(table.begin(), table.end(), unsigned(TAG_NUM_OF_ITEM_TYPES));
+
+	for (unsigned i = 0; i < unsigned(TAG_NUM_OF_ITEM_TYPES); ++i) {
+		auto &slot = table[TagNameHash(tag_item_names[i], seed) & mask];
+		if (slot != unsigned(TAG_NUM_OF_ITEM_TYPES))
+			return false;
+
+		slot = i;
+	}
+
+	return true;
+}
+
 int
 main(int argc, char **argv)
 {
 	if (argc != 2)
 		return EXIT_FAILURE;
 
-	FILE *out = fopen(argv[1], "w");
+	std::vector<unsigned> table;
+	uint32_t seed = 0;
+	bool found = false;
 
-	std::map<std::string_view, TagType> names;
-	for (unsigned i = 0; i < unsigned(TAG_NUM_OF_ITEM_TYPES); ++i)
-		names[tag_item_names[i]] = TagType(i);
+	/* prefer small tables; a few hundred bytes fit easily in
+	   the CPU cache */
+	for (std::size_t size = 64; !found && size <= 4096; size *= 2) {
+		table.resize(size);
 
-	fprintf(out,
-		"#include \"ParseName.hxx\"\n"
-		"#include \"Type.hxx\"\n"
-		"\n"
-		"#include <assert.h>\n"
-		"#include <string.h>\n"
-		"\n"
-		"TagType\n"
-		"tag_name_parse(const char *name) noexcept\n"
-		"{\n"
-		"  assert(name != nullptr);\n"
-		"\n"
-		"  switch (*name) {\n");
-
-	char first = 0;
-
-	for (const auto &[name, tag] : names) {
-		if (name.front() != first) {
-			if (first != 0)
-				fprintf(out, "    break;\n\n");
-			first = name.front();
-			fprintf(out, "  case '%c':\n", first);
+		for (seed = 0; seed < 100000; ++seed) {
+			if (TryTable(table, seed)) {
+				found = true;
+				break;
+			}
 		}
+	}
 
-		fprintf(out,
-			"    if (strcmp(name + 1, \"%.*s\") == 0) return TagType(%u);\n",
-			int(name.size() - 1), name.data() + 1, unsigned(tag));
+	if (!found) {
+		fprintf(stderr, "No perfect hash found\n");
+		return EXIT_FAILURE;
 	}
 
-	fprintf(out, "    break;\n\n");
+	FILE *out = fopen(argv[1], "w");
+	if (out == nullptr)
+		return EXIT_FAILURE;
+
+	fprintf(out,
+		"#include \"NameHash.hxx\"\n"
+		"#include \"Type.hxx\"\n"
+		"\n"
+		"static constexpr TagType tag_name_hash_table[%zu] = {\n",
+		table.size());
+
+	for (const unsigned i : table)
+		fprintf(out, "  TagType(%u),\n", i);
 
 	fprintf(out,
-		"  }\n"
+		"};\n"
 		"\n"
-		"  return TAG_NUM_OF_ITEM_TYPES;\n"
-		"}\n");
+		"TagType\n"
+		"tag_name_hash_lookup(std::string_view name) noexcept\n"
+		"{\n"
+		"  return tag_name_hash_table[TagNameHash(name, %uU) & %zuU];\n"
+		"}\n",
+		unsigned(seed), table.size() - 1);
 
-	return EXIT_SUCCESS;
+	return fclose(out) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -9,9 +9,21 @@
 #include <id3tag.h>
 
 #include <algorithm>
+#include <cassert>
+#include <vector>
 
 static constexpr size_t ID3V1_SIZE = 128;
 
+/**
+ * ID3v2 tags smaller than this are always loaded completely;
+ * filtering frames is not worth the effort.
+ */
+static constexpr size_t ID3V2_FILTER_THRESHOLD = 64 * 1024;
+
+static constexpr id3_byte_t ID3V2_FLAG_UNSYNCHRONISATION = 0x80;
+static constexpr id3_byte_t ID3V2_FLAG_EXTENDED_HEADER = 0x40;
+static constexpr id3_byte_t ID3V2_FLAG_FOOTER = 0x10;
+
 [[gnu::pure]]
 static inline bool
 tag_is_id3v1(struct id3_tag *tag) noexcept
@@ -32,8 +44,163 @@ try {
 	return 0;
 }
 
+/**
+ * Skip input bytes without seeking if seeking is expensive.
+ */
+static void
+SkipBytes(InputStream &is, std::unique_lock<Mutex> &lock, offset_type n)
+{
+	if (is.CheapSeeking()) {
+		is.Skip(lock, n);
+		return;
+	}
+
+	std::byte buffer[4096];
+	while (n > 0) {
+		const std::size_t nbytes = std::min<offset_type>(n, sizeof(buffer));
+		is.ReadFull(lock, std::span{buffer, nbytes});
+		n -= nbytes;
+	}
+}
+
+static constexpr uint_least32_t
+ParseSyncSafe(const id3_byte_t *p) noexcept
+{
+	return (uint_least32_t(p[0] & 0x7f) << 21) |
+		(uint_least32_t(p[1] & 0x7f) << 14) |
+		(uint_least32_t(p[2] & 0x7f) << 7) |
+		uint_least32_t(p[3] & 0x7f);
+}
+
+static constexpr void
+FormatSyncSafe(id3_byte_t *p, uint_least32_t value) noexcept
+{
+	p[0] = (value >> 21) & 0x7f;
+	p[1] = (value >> 14) & 0x7f;
+	p[2] = (value >> 7) & 0x7f;
+	p[3] = value & 0x7f;
+}
+
+/**
+ * Does this ID3v2 frame header describe a picture ("APIC", or "PIC"
+ * in ID3v2.2)?
+ */
+[[gnu::pure]]
+static bool
+IsPictureFrame(const id3_byte_t *header, unsigned version) noexcept
+{
+	return version == 2
+		? std::equal(header, header + 3, "PIC")
+		: std::equal(header, header + 4, "APIC");
+}
+
+/**
+ * Can ReadId3TagWithoutPictures() parse the frame headers of this
+ * ID3v2 tag?
+ */
+[[gnu::pure]]
+static bool
+CanSkipId3Frames(const id3_byte_t *header, size_t tag_size) noexcept
+{
+	const unsigned version = header[3];
+	const id3_byte_t flags = header[5];
+
+	if (!std::equal(header, header + 3, "ID3") ||
+	    version < 2 || version > 4 ||
+	    /* in older versions, unsynchronisation applies to the
+	       frame headers, too */
+	    ((flags & ID3V2_FLAG_UNSYNCHRONISATION) && version < 4) ||
+	    (flags & ID3V2_FLAG_EXTENDED_HEADER))
+		return false;
+
+	const size_t footer_size = (flags & ID3V2_FLAG_FOOTER) != 0
+		? ID3_TAG_QUERYSIZE
+		: 0;
+	return tag_size >= ID3_TAG_QUERYSIZE + footer_size;
+}
+
+/**
+ * Read the rest of an ID3v2 tag, but skip picture frames instead of
+ * loading them into memory (they can be several megabytes large).
+ * Call CanSkipId3Frames() first.
+ *
+ * @param header the tag header which has already been read
+ * @param tag_size the total size of the tag, including header and
+ * footer
+ */
 static UniqueId3Tag
-ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock)
+ReadId3TagWithoutPictures(InputStream &is, std::unique_lock<Mutex> &lock,
+			  const id3_byte_t *header, size_t tag_size)
+{
+	assert(CanSkipId3Frames(header, tag_size));
+
+	const unsigned version = header[3];
+	const size_t footer_size = (header[5] & ID3V2_FLAG_FOOTER) != 0
+		? ID3_TAG_QUERYSIZE
+		: 0;
+
+	const size_t frame_header_size = version == 2 ? 6 : 10;
+
+	std::vector<id3_byte_t> buffer(header, header + ID3_TAG_QUERYSIZE);
+
+	size_t remaining = tag_size - ID3_TAG_QUERYSIZE - footer_size;
+	while (remaining >= frame_header_size) {
+		id3_byte_t frame_header[10];
+		is.ReadFull(lock, std::as_writable_bytes(std::span{frame_header,
+								   frame_header_size}));
+		remaining -= frame_header_size;
+
+		if (frame_header[0] == 0) {
+			/* padding */
+			break;
+		}
+
+		const size_t frame_size = version == 2
+			? ((size_t(frame_header[3]) << 16) |
+			   (size_t(frame_header[4]) << 8) |
+			   size_t(frame_header[5]))
+			: version == 3
+			? ((size_t(frame_header[4]) << 24) |
+			   (size_t(frame_header[5]) << 16) |
+			   (size_t(frame_header[6]) << 8) |
+			   size_t(frame_header[7]))
+			: ParseSyncSafe(frame_header + 4);
+		if (frame_size > remaining)
+			/* malformed */
+			break;
+
+		remaining -= frame_size;
+
+		if (IsPictureFrame(frame_header, version)) {
+			SkipBytes(is, lock, frame_size);
+			continue;
+		}
+
+		buffer.insert(buffer.end(),
+			      frame_header, frame_header + frame_header_size);
+
+		const size_t position = buffer.size();
+		buffer.resize(position + frame_size);
+		is.ReadFull(lock,
+			    std::as_writable_bytes(std::span{buffer}.subspan(position)));
+	}
+
+	/* move to the end of the tag, just like
+	   id3_tag_parse() after reading all of it; the SEEK frame
+	   handling in tag_id3_find_from_beginning() relies on it */
+	SkipBytes(is, lock, remaining + footer_size);
+
+	/* update the header: the new size, and there is no footer
+	   anymore */
+	buffer[5] &= ~ID3V2_FLAG_FOOTER;
+	FormatSyncSafe(buffer.data() + 6, buffer.size() - ID3_TAG_QUERYSIZE);
+
+	return UniqueId3Tag(id3_tag_parse(buffer.data(), buffer.size()));
+}
+
+static UniqueId3Tag
+ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock,
+	   bool want_pictures)
 try {
 	id3_byte_t query_buffer[ID3_TAG_QUERYSIZE];
 	is.ReadFull(lock, std::as_writable_bytes(std::span{query_buffer}));
@@ -42,6 +209,11 @@ try {
 	long tag_size = id3_tag_query(query_buffer, sizeof(query_buffer));
 	if (tag_size <= 0) return nullptr;
 
+	if (!want_pictures && size_t(tag_size) >= ID3V2_FILTER_THRESHOLD &&
+	    CanSkipId3Frames(query_buffer, tag_size))
+		return ReadId3TagWithoutPictures(is, lock, query_buffer,
+						 tag_size);
+
 	/* Found a tag.  Allocate a buffer and read it in. */
 	if (size_t(tag_size) <= sizeof(query_buffer))
 		/* we have enough data already */
@@ -64,11 +236,12 @@ try {
 }
 
 static UniqueId3Tag
-ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, offset_type offset)
+ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, offset_type offset,
+	   bool want_pictures)
 try {
 	is.Seek(lock, offset);
 
-	return ReadId3Tag(is, lock);
+	return ReadId3Tag(is, lock, want_pictures);
 } catch (...) {
 	return nullptr;
 }
@@ -95,9 +268,10 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_find_from_beginning(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_find_from_beginning(InputStream &is, std::unique_lock<Mutex> &lock,
+			    bool want_pictures)
 try {
-	auto tag = ReadId3Tag(is, lock);
+	auto tag = ReadId3Tag(is, lock, want_pictures);
 	if (!tag) {
 		return nullptr;
 	} else if (tag_is_id3v1(tag.get())) {
@@ -114,7 +288,8 @@ try {
 			break;
 
 		/* Get the tag specified by the SEEK frame */
-		auto seektag = ReadId3Tag(is, lock, is.GetOffset() + seek);
+		auto seektag = ReadId3Tag(is, lock, is.GetOffset() + seek,
+					  want_pictures);
 		if (!seektag || tag_is_id3v1(seektag.get()))
 			break;
 
@@ -128,7 +303,8 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_find_from_end(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_find_from_end(InputStream &is, std::unique_lock<Mutex> &lock,
+		      bool want_pictures)
 try {
 	if (!is.KnownSize() || !is.CheapSeeking())
 		return nullptr;
@@ -158,7 +334,7 @@ try {
 		return v1tag;
 
 	/* Get the tag which the footer belongs to */
-	auto tag = ReadId3Tag(is, lock, offset - tag_size);
+	auto tag = ReadId3Tag(is, lock, offset - tag_size, want_pictures);
 	if (!tag)
 		return v1tag;
 
@@ -169,7 +345,8 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_riff_aiff_load(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_riff_aiff_load(InputStream &is, std::unique_lock<Mutex> &lock,
+		       bool want_pictures)
 try {
 	size_t size;
 	try {
@@ -178,6 +355,10 @@ try {
 		size = aiff_seek_id3(is, lock);
 	}
 
+	if (!want_pictures)
+		/* the chunk begins with an ID3 tag header */
+		return ReadId3Tag(is, lock, false);
+
 	if (size > 4 * 1024 * 1024)
 		/* too large, don't allocate so much memory */
 		return nullptr;
@@ -191,15 +372,15 @@ try {
 }
 
 UniqueId3Tag
-tag_id3_load(InputStream &is)
+tag_id3_load(InputStream &is, bool want_pictures)
 try {
 	std::unique_lock lock{is.mutex};
 
-	auto tag = tag_id3_find_from_beginning(is, lock);
+	auto tag = tag_id3_find_from_beginning(is, lock, want_pictures);
 	if (tag == nullptr && is.CheapSeeking()) {
-		tag = tag_id3_riff_aiff_load(is, lock);
+		tag = tag_id3_riff_aiff_load(is, lock, want_pictures);
 		if (tag == nullptr)
-			tag = tag_id3_find_from_end(is, lock);
+			tag = tag_id3_find_from_end(is, lock, want_pictures);
 	}
 
 	return tag;
@@ -11,9 +11,11 @@ class InputStream;
 /**
  * Loads the ID3 tags from the #InputStream into a libid3tag object.
  *
+ * @param want_pictures if false, then large picture frames may be
+ * skipped instead of being loaded into memory
  * @return nullptr on error or if no ID3 tag was found in the file
  */
 UniqueId3Tag
-tag_id3_load(InputStream &is);
+tag_id3_load(InputStream &is, bool want_pictures=true);
 
 #endif
@@ -9,8 +9,10 @@
 #include "Builder.hxx"
 #include "Tag.hxx"
 #include "Id3MusicBrainz.hxx"
+#include "util/ReusableArray.hxx"
 #include "util/StringAPI.hxx"
 #include "util/StringStrip.hxx"
+#include "util/UTF8.hxx"
 
 #include <id3tag.h>
 
@@ -70,17 +72,35 @@ tag_id3_getstring(const struct id3_frame *frame, unsigned i) noexcept
 	return Id3String::FromUCS4(ucs4);
 }
 
+/**
+ * Convert a UCS-4 string to UTF-8 into a per-thread buffer which is
+ * reused for all frames, instead of allocating a new string with
+ * id3_ucs4_utf8duplicate().
+ *
+ * @return a view into the buffer which remains valid until the next
+ * call in the same thread
+ */
+static std::string_view
+UCS4ToUTF8(const id3_ucs4_t *ucs4) noexcept
+{
+	static thread_local ReusableArray<char, 256> buffer;
+
+	/* UnicodeToUTF8() emits up to 6 bytes per character */
+	char *const dest = buffer.Get(id3_ucs4_length(ucs4) * 6);
+	char *p = dest;
+	for (; *ucs4 != 0; ++ucs4)
+		p = UnicodeToUTF8(*ucs4, p);
+
+	return {dest, std::size_t(p - dest)};
+}
+
 static void
 InvokeOnTag(TagHandler &handler, TagType type, const id3_ucs4_t *ucs4) noexcept
 {
 	assert(type < TAG_NUM_OF_ITEM_TYPES);
 	assert(ucs4 != nullptr);
 
-	const auto utf8 = Id3String::FromUCS4(ucs4);
-	if (!utf8)
-		return;
-
-	handler.OnTag(type, Strip(std::string_view{utf8.c_str()}));
+	handler.OnTag(type, Strip(UCS4ToUTF8(ucs4)));
 }
 
 /**
@@ -359,7 +379,7 @@ tag_id3_import(const struct id3_tag *tag) noexcept
 bool
 tag_id3_scan(InputStream &is, TagHandler &handler)
 {
-	auto tag = tag_id3_load(is);
+	auto tag = tag_id3_load(is, handler.WantPicture());
 	if (!tag)
 		return false;
 
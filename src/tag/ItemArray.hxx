@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_TAG_ITEM_ARRAY_HXX
+#define MPD_TAG_ITEM_ARRAY_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+struct TagItem;
+
+/**
+ * Functions which manage the #TagItem pointer array of a #Tag.  The
+ * array is reference-counted: copying a #Tag shares the array
+ * instead of duplicating it, which is why it must never be modified
+ * after it has been filled.  Each #TagItem in it holds one #TagPool
+ * reference which is owned by the array.
+ *
+ * The reference counter lives in a header in front of the array.
+ */
+namespace TagItemArray {
+
+struct alignas(TagItem *) Header {
+	std::atomic_uint refs{1};
+};
+
+static_assert(sizeof(Header) % alignof(TagItem *) == 0);
+
+inline Header &
+GetHeader(TagItem *const*items) noexcept
+{
+	return *(reinterpret_cast<Header *>(const_cast<TagItem **>(items)) - 1);
+}
+
+/**
+ * Allocate an uninitialized array with a reference count of 1.
+ */
+inline TagItem **
+Allocate(std::size_t n)
+{
+	void *p = ::operator new(sizeof(Header) + n * sizeof(TagItem *));
+	auto *header = new(p) Header();
+	return reinterpret_cast<TagItem **>(header + 1);
+}
+
+/**
+ * Add a reference to the array.
+ */
+inline TagItem **
+Ref(TagItem **items) noexcept
+{
+	GetHeader(items).refs.fetch_add(1, std::memory_order_relaxed);
+	return items;
+}
+
+/**
+ * Is this array referenced by more than one #Tag?  If not, the
+ * caller is the only owner, and it may take over the #TagItem
+ * references.
+ */
+[[gnu::pure]]
+inline bool
+IsShared(TagItem *const*items) noexcept
+{
+	return GetHeader(items).refs.load(std::memory_order_acquire) > 1;
+}
+
+/**
+ * Release a reference.
+ *
+ * @return true if this was the last reference; the caller must then
+ * release the #TagItem references and call Free()
+ */
+inline bool
+Unref(TagItem *const*items) noexcept
+{
+	return GetHeader(items).refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+/**
+ * Free an array whose last reference has been released (or which
+ * has never been shared).
+ */
+inline void
+Free(TagItem **items) noexcept
+{
+	Header *header = &GetHeader(items);
+	header->~Header();
+	::operator delete(header);
+}
+
+} // namespace TagItemArray
+
+#endif
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+enum TagType : uint8_t;
+
+/**
+ * A case-insensitive (ASCII only) FNV-1a hash for tag names.
+ * GenParseName.cxx chooses a seed which makes it a perfect hash for
+ * #tag_item_names.
+ */
+constexpr uint32_t
+TagNameHash(std::string_view name, uint32_t seed) noexcept
+{
+	uint32_t hash = UINT32_C(2166136261) ^ seed;
+
+	for (char ch : name) {
+		if (ch >= 'A' && ch <= 'Z')
+			ch += 'a' - 'A';
+
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= UINT32_C(16777619);
+	}
+
+	return hash;
+}
+
+/**
+ * Look up the name in the perfect hash table generated by
+ * GenParseName.cxx.  The result is the only #TagType whose name may
+ * be equal to the given string (ignoring case); the caller must
+ * still compare the string with #tag_item_names.  Returns
+ * #TAG_NUM_OF_ITEM_TYPES if no name has this hash.
+ */
+[[gnu::pure]]
+TagType
+tag_name_hash_lookup(std::string_view name) noexcept;
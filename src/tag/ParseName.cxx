@@ -2,25 +2,28 @@
 // Copyright The Music Player Daemon Project
 
 #include "ParseName.hxx"
+#include "NameHash.hxx"
 #include "Names.hxx"
-#include "util/ASCII.hxx"
 #include "util/StringCompare.hxx"
 
 #include <cassert>
 
-#include <string.h>
+TagType
+tag_name_parse(const char *name) noexcept
+{
+	assert(name != nullptr);
+
+	return tag_name_parse(std::string_view{name});
+}
 
 TagType
 tag_name_parse(std::string_view name) noexcept
 {
-	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
-		assert(tag_item_names[i] != nullptr);
+	const TagType type = tag_name_hash_lookup(name);
+	if (type == TAG_NUM_OF_ITEM_TYPES || name != tag_item_names[type])
+		return TAG_NUM_OF_ITEM_TYPES;
 
-		if (name == tag_item_names[i])
-			return (TagType)i;
-	}
-
-	return TAG_NUM_OF_ITEM_TYPES;
+	return type;
 }
 
 TagType
@@ -28,25 +31,16 @@ tag_name_parse_i(const char *name) noexcept
 {
 	assert(name != nullptr);
 
-	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
-		assert(tag_item_names[i] != nullptr);
-
-		if (StringEqualsCaseASCII(name, tag_item_names[i]))
-			return (TagType)i;
-	}
-
-	return TAG_NUM_OF_ITEM_TYPES;
+	return tag_name_parse_i(std::string_view{name});
 }
 
 TagType
 tag_name_parse_i(std::string_view name) noexcept
 {
-	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
-		assert(tag_item_names[i] != nullptr);
-
-		if (StringIsEqualIgnoreCase(name, tag_item_names[i]))
-			return (TagType)i;
-	}
+	const TagType type = tag_name_hash_lookup(name);
+	if (type == TAG_NUM_OF_ITEM_TYPES ||
+	    !StringIsEqualIgnoreCase(name, tag_item_names[type]))
+		return TAG_NUM_OF_ITEM_TYPES;
 
-	return TAG_NUM_OF_ITEM_TYPES;
+	return type;
 }
@@ -3,18 +3,30 @@
 
 #include "Pool.hxx"
 #include "Item.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/djb_hash.hxx"
 #include "util/IntrusiveHashSet.hxx"
 #include "util/SpanCast.hxx"
 #include "util/VarSize.hxx"
 
+#ifdef HAVE_ICU_CANONICALIZE
+#include "util/AllocatedString.hxx"
+#include <atomic>
+#endif
+
 #include <array>
 #include <cassert>
 #include <cstdint>
 #include <limits>
 
-Mutex tag_pool_lock;
+/**
+ * The pool is split into this many shards (a power of 2), each with
+ * its own lock, so threads interning different values rarely
+ * contend.
+ */
+static constexpr unsigned TAG_POOL_SHARD_BITS = 4;
+static constexpr std::size_t N_TAG_POOL_SHARDS = 1U << TAG_POOL_SHARD_BITS;
 
 struct TagPoolKey {
 	std::string_view value;
@@ -33,18 +45,41 @@ struct TagPoolKey {
 
 struct TagPoolItem {
 	IntrusiveHashSetHook<IntrusiveHookMode::NORMAL> hash_set_hook;
+
+#ifdef HAVE_ICU_CANONICALIZE
+	/**
+	 * The canonical (case-folded) value; allocated on demand by
+	 * tag_pool_get_folded().
+	 */
+	mutable std::atomic<char *> folded{nullptr};
+#endif
+
 	uint8_t ref = 1;
+
+	/**
+	 * The index of the #TagPoolShard this item lives in.
+	 */
+	uint8_t shard;
+
 	TagItem item;
 
 	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
 
-	TagPoolItem(TagType type,
-		    std::string_view value) noexcept {
+	TagPoolItem(uint8_t _shard, TagType type,
+		    std::string_view value) noexcept
+		:shard(_shard)
+	{
 		item.type = type;
 		*std::copy(value.begin(), value.end(), item.value) = 0;
 	}
 
-	static TagPoolItem *Create(TagType type,
+#ifdef HAVE_ICU_CANONICALIZE
+	~TagPoolItem() noexcept {
+		delete[] folded.load(std::memory_order_relaxed);
+	}
+#endif
+
+	static TagPoolItem *Create(uint8_t shard, TagType type,
 				   std::string_view value) noexcept;
 
 	struct GetKey {
@@ -66,23 +101,62 @@ struct TagPoolItem {
 	};
 };
 
+/**
+ * The number of bytes allocated by TagPoolItem::Create() (for
+ * statistics).
+ */
+static constexpr std::size_t
+GetPoolItemSize(std::string_view value) noexcept
+{
+	return sizeof(TagPoolItem) + value.size();
+}
+
 TagPoolItem *
-TagPoolItem::Create(TagType type,
+TagPoolItem::Create(uint8_t shard, TagType type,
 		    std::string_view value) noexcept
 {
 	TagPoolItem *dummy;
 	return NewVarSize<TagPoolItem>(sizeof(dummy->item.value),
 				       value.size() + 1,
-				       type,
+				       shard, type,
 				       value);
 }
 
-static IntrusiveHashSet<TagPoolItem, 16384,
-	IntrusiveHashSetOperators<TagPoolItem, TagPoolItem::GetKey,
-				  TagPoolKey::Hash,
-				  std::equal_to<TagPoolKey>>,
-	IntrusiveHashSetMemberHookTraits<&TagPoolItem::hash_set_hook>,
-	IntrusiveHashSetOptions{.zero_initialized = true}> tag_pool;
+struct alignas(64) TagPoolShard {
+	/**
+	 * Protects #set and the reference counters of all items in
+	 * it.
+	 */
+	Mutex mutex;
+
+	IntrusiveHashSet<TagPoolItem, 16384 / N_TAG_POOL_SHARDS,
+		IntrusiveHashSetOperators<TagPoolItem, TagPoolItem::GetKey,
+					  TagPoolKey::Hash,
+					  std::equal_to<TagPoolKey>>,
+		IntrusiveHashSetMemberHookTraits<&TagPoolItem::hash_set_hook>,
+		IntrusiveHashSetOptions{.zero_initialized = true}> set;
+
+	/**
+	 * Statistics about the items in #set.  Protected by
+	 * #mutex.
+	 */
+	TagPoolStats stats;
+};
+
+static std::array<TagPoolShard, N_TAG_POOL_SHARDS> tag_pool;
+
+/**
+ * Determine the shard for the given key.  This uses Fibonacci
+ * hashing to pick other bits than the hash set's bucket index, which
+ * is derived from the same hash.
+ */
+[[gnu::pure]]
+static unsigned
+GetShardIndex(const TagPoolKey &key) noexcept
+{
+	const uint_least64_t hash = TagPoolKey::Hash{}(key);
+	return (hash * 0x9e3779b97f4a7c15ULL) >> (64 - TAG_POOL_SHARD_BITS);
+}
 
 static constexpr TagPoolItem *
 TagItemToPoolItem(TagItem *item) noexcept
@@ -90,16 +164,31 @@ TagItemToPoolItem(TagItem *item) noexcept
 	return &ContainerCast(*item, &TagPoolItem::item);
 }
 
+static constexpr const TagPoolItem *
+TagItemToPoolItem(const TagItem *item) noexcept
+{
+	return &ContainerCast(*item, &TagPoolItem::item);
+}
+
 TagItem *
 tag_pool_get_item(TagType type, std::string_view value) noexcept
 {
+	const TagPoolKey key{value, type};
+	const unsigned shard_index = GetShardIndex(key);
+	auto &shard = tag_pool[shard_index];
+
+	const std::scoped_lock lock{shard.mutex};
+
 	const auto [position, inserted] =
-		tag_pool.insert_check_if(TagPoolKey{value, type},
-					 TagPoolItem::CanIncrementRef{});
+		shard.set.insert_check_if(key,
+					  TagPoolItem::CanIncrementRef{});
 
 	if (inserted) {
-		auto *pool_item = TagPoolItem::Create(type, value);
-		tag_pool.insert_commit(position, *pool_item);
+		auto *pool_item = TagPoolItem::Create(shard_index,
+						      type, value);
+		shard.set.insert_commit(position, *pool_item);
+		++shard.stats.n_items;
+		shard.stats.size += GetPoolItemSize(value);
 		return &pool_item->item;
 	} else {
 		++position->ref;
@@ -112,29 +201,85 @@ tag_pool_dup_item(TagItem *item) noexcept
 {
 	TagPoolItem *pool_item = TagItemToPoolItem(item);
 
-	assert(pool_item->ref > 0);
+	{
+		const std::scoped_lock lock{tag_pool[pool_item->shard].mutex};
 
-	if (pool_item->ref < TagPoolItem::MAX_REF) {
-		++pool_item->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above MAX_REF;
-		   obtain a reference to a different TagPoolItem which
-		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
+		assert(pool_item->ref > 0);
+
+		if (pool_item->ref < TagPoolItem::MAX_REF) {
+			++pool_item->ref;
+			return item;
+		}
 	}
+
+	/* the reference counter overflows above MAX_REF; obtain a
+	   reference to a different TagPoolItem which isn't yet
+	   "full" */
+	return tag_pool_get_item(item->type, item->value);
 }
 
 void
 tag_pool_put_item(TagItem *item) noexcept
 {
 	TagPoolItem *const pool_item = TagItemToPoolItem(item);
-	assert(pool_item->ref > 0);
-	--pool_item->ref;
+	auto &shard = tag_pool[pool_item->shard];
+
+	{
+		const std::scoped_lock lock{shard.mutex};
+
+		assert(pool_item->ref > 0);
+		--pool_item->ref;
 
-	if (pool_item->ref > 0)
-		return;
+		if (pool_item->ref > 0)
+			return;
 
-	tag_pool.erase(tag_pool.iterator_to(*pool_item));
+		shard.set.erase(shard.set.iterator_to(*pool_item));
+		--shard.stats.n_items;
+		shard.stats.size -= GetPoolItemSize(pool_item->item.value);
+	}
+
+	/* free the item after releasing the lock */
 	DeleteVarSize(pool_item);
 }
+
+TagPoolStats
+tag_pool_get_stats() noexcept
+{
+	TagPoolStats result;
+
+	for (auto &shard : tag_pool) {
+		const std::scoped_lock lock{shard.mutex};
+		result.n_items += shard.stats.n_items;
+		result.size += shard.stats.size;
+	}
+
+	return result;
+}
+
+#ifdef HAVE_ICU_CANONICALIZE
+
+const char *
+tag_pool_get_folded(const TagItem &item) noexcept
+{
+	auto &folded = TagItemToPoolItem(&item)->folded;
+
+	if (const char *value = folded.load(std::memory_order_acquire))
+		return value;
+
+	char *value = IcuCanonicalize(item.value, true).Steal();
+	if (value == nullptr)
+		return nullptr;
+
+	/* another thread may have been faster; in that case,
+	   discard our copy and use the other one */
+	char *expected = nullptr;
+	if (!folded.compare_exchange_strong(expected, value,
+					    std::memory_order_acq_rel)) {
+		delete[] value;
+		return expected;
+	}
+
+	return value;
+}
+
+#endif
@@ -4,17 +4,34 @@
 #ifndef MPD_TAG_POOL_HXX
 #define MPD_TAG_POOL_HXX
 
-#include "thread/Mutex.hxx"
+#include "lib/icu/Canonicalize.hxx"
 
+#include <cstddef>
 #include <cstdint>
 #include <string_view>
 
-enum TagType : uint8_t;
+/*
+ * The tag pool interns #TagItem objects.  It is split into shards
+ * with one lock each; all functions are thread-safe and lock the
+ * shard they need internally.
+ */
 
-extern Mutex tag_pool_lock;
+enum TagType : uint8_t;
 
 struct TagItem;
 
+struct TagPoolStats {
+	/**
+	 * The number of distinct items in the pool.
+	 */
+	std::size_t n_items = 0;
+
+	/**
+	 * The number of bytes allocated for these items.
+	 */
+	std::size_t size = 0;
+};
+
 [[nodiscard]]
 TagItem *
 tag_pool_get_item(TagType type, std::string_view value) noexcept;
@@ -26,4 +43,28 @@ tag_pool_dup_item(TagItem *item) noexcept;
 void
 tag_pool_put_item(TagItem *item) noexcept;
 
+/**
+ * Obtain statistics about the memory used by the tag pool.
+ */
+TagPoolStats
+tag_pool_get_stats() noexcept;
+
+#ifdef HAVE_ICU_CANONICALIZE
+
+/**
+ * Returns the value of the given #TagItem (which must have been
+ * obtained from the pool) transformed with IcuCanonicalize(value,
+ * true).  It is calculated on the first call and cached in the pool,
+ * so case-insensitive searches do not need to fold each value again
+ * for each query.  This function does not lock the pool.
+ *
+ * @return the canonical value (valid as long as the #TagItem) or
+ * nullptr on error
+ */
+[[gnu::pure]]
+const char *
+tag_pool_get_folded(const TagItem &item) noexcept;
+
+#endif
+
 #endif
@@ -19,6 +19,19 @@ CompareNumeric(const char *a, const char *b) noexcept
 	return a_value < b_value;
 }
 
+bool
+CompareTagValues(TagType type, const char *a, const char *b) noexcept
+{
+	switch (type) {
+	case TAG_DISC:
+	case TAG_TRACK:
+		return CompareNumeric(a, b);
+
+	default:
+		return strcmp(a, b) < 0;
+	}
+}
+
 bool
 CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
 {
@@ -30,12 +43,5 @@ CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
 		swap(a_value, b_value);
 	}
 
-	switch (type) {
-	case TAG_DISC:
-	case TAG_TRACK:
-		return CompareNumeric(a_value, b_value);
-
-	default:
-		return strcmp(a_value, b_value) < 0;
-	}
+	return CompareTagValues(type, a_value, b_value);
 }
@@ -8,6 +8,14 @@
 enum TagType : uint8_t;
 struct Tag;
 
+/**
+ * Compare two values returned by Tag::GetSortValue() the way
+ * CompareTags() does (ascending).
+ */
+[[gnu::pure]]
+bool
+CompareTagValues(TagType type, const char *a, const char *b) noexcept;
+
 [[gnu::pure]]
 bool
 CompareTags(TagType type, bool descending,
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "Tag.hxx"
+#include "ItemArray.hxx"
 #include "Pool.hxx"
 #include "Builder.hxx"
 
@@ -13,29 +14,31 @@ Tag::Clear() noexcept
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	if (num_items > 0) {
-		assert(items != nullptr);
-		const std::scoped_lock protect{tag_pool_lock};
-		for (unsigned i = 0; i < num_items; ++i)
-			tag_pool_put_item(items[i]);
-		num_items = 0;
+	if (items != nullptr) {
+		if (TagItemArray::Unref(items)) {
+			/* this was the last reference to the array */
+			for (unsigned i = 0; i < num_items; ++i)
+				tag_pool_put_item(items[i]);
+
+			TagItemArray::Free(items);
+		}
+
+		items = nullptr;
 	}
 
-	delete[] items;
-	items = nullptr;
+	num_items = 0;
+	types = TagMask::None();
 }
 
 Tag::Tag(const Tag &other) noexcept
 	:duration(other.duration), has_playlist(other.has_playlist),
-	 num_items(other.num_items)
+	 num_items(other.num_items),
+	 /* share the (immutable) item array instead of copying it */
+	 items(other.items != nullptr
+	       ? TagItemArray::Ref(other.items)
+	       : nullptr),
+	 types(other.types)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
-
-		const std::scoped_lock protect{tag_pool_lock};
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-	}
 }
 
 Tag
@@ -87,6 +90,9 @@ Tag::GetValue(TagType type) const noexcept
 {
 	assert(type < TAG_NUM_OF_ITEM_TYPES);
 
+	if (!HasType(type))
+		return nullptr;
+
 	for (const auto &item : *this)
 		if (item.type == type)
 			return item.value;
@@ -94,12 +100,6 @@ Tag::GetValue(TagType type) const noexcept
 	return nullptr;
 }
 
-bool
-Tag::HasType(TagType type) const noexcept
-{
-	return GetValue(type) != nullptr;
-}
-
 static TagType
 DecaySort(TagType type) noexcept
 {
@@ -6,6 +6,7 @@
 
 #include "Type.hxx" // IWYU pragma: export
 #include "Item.hxx" // IWYU pragma: export
+#include "Mask.hxx"
 #include "Chrono.hxx"
 #include "util/DereferenceIterator.hxx"
 
@@ -32,9 +33,20 @@ struct Tag {
 	/** the total number of tag items in the #items array */
 	unsigned short num_items = 0;
 
-	/** an array of tag items */
+	/**
+	 * An array of tag items.  It is reference-counted (see
+	 * #TagItemArray) and may be shared with other #Tag
+	 * instances, therefore it must not be modified; use
+	 * #TagBuilder instead.
+	 */
 	TagItem **items = nullptr;
 
+	/**
+	 * The types of all items in #items.  This allows checking
+	 * whether a type is present without scanning the array.
+	 */
+	TagMask types = TagMask::None();
+
 	/**
 	 * Create an empty tag.
 	 */
@@ -44,9 +56,11 @@ struct Tag {
 
 	Tag(Tag &&other) noexcept
 		:duration(other.duration), has_playlist(other.has_playlist),
-		 num_items(other.num_items), items(other.items) {
+		 num_items(other.num_items), items(other.items),
+		 types(other.types) {
 		other.items = nullptr;
 		other.num_items = 0;
+		other.types = TagMask::None();
 	}
 
 	/**
@@ -72,6 +86,7 @@ struct Tag {
 	void MoveItemsFrom(Tag &&other) noexcept {
 		std::swap(items, other.items);
 		std::swap(num_items, other.num_items);
+		std::swap(types, other.types);
 	}
 
 	/**
@@ -136,7 +151,9 @@ struct Tag {
 	 * the specified type.
 	 */
 	[[gnu::pure]]
-	bool HasType(TagType type) const noexcept;
+	bool HasType(TagType type) const noexcept {
+		return types.Test(type);
+	}
 
 	/**
 	 * Returns a value for sorting on the specified type, with
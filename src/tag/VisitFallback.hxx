@@ -11,6 +11,9 @@ template<typename F>
 bool
 VisitTagType(const Tag &tag, TagType type, F &&f) noexcept
 {
+	if (!tag.HasType(type))
+		return false;
+
 	bool found = false;
 
 	for (const auto &item : tag) {
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Scheduling.hxx"
+#include "Util.hxx"
+
+void
+ThreadScheduling::Apply(bool realtime) const
+{
+	if (!cpu_affinity.empty())
+		SetThreadAffinity(cpu_affinity);
+
+	if (realtime_priority > 0)
+		SetThreadRealtime(realtime_priority);
+	else if (realtime_priority < 0 && realtime)
+		SetThreadRealtime();
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_THREAD_SCHEDULING_HXX
+#define MPD_THREAD_SCHEDULING_HXX
+
+#include <vector>
+
+/**
+ * Scheduling settings for one thread (or a group of threads):
+ * CPU affinity and real-time priority.
+ */
+struct ThreadScheduling {
+	/**
+	 * The CPUs this thread may run on.  An empty list means no
+	 * restriction.
+	 */
+	std::vector<unsigned> cpu_affinity;
+
+	/**
+	 * The SCHED_FIFO priority.  0 means "not real-time", and -1
+	 * means the thread's built-in default.
+	 */
+	int realtime_priority = -1;
+
+	bool IsDefault() const noexcept {
+		return cpu_affinity.empty() && realtime_priority < 0;
+	}
+
+	/**
+	 * Apply these settings to the current thread.
+	 *
+	 * Throws std::system_error on error.
+	 *
+	 * @param realtime does this thread get real-time scheduling
+	 * by default (i.e. if #realtime_priority is -1)?
+	 */
+	void Apply(bool realtime) const;
+};
+
+#endif
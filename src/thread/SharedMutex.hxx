@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_THREAD_SHARED_MUTEX_HXX
+#define MPD_THREAD_SHARED_MUTEX_HXX
+
+#include "Mutex.hxx"
+#include "Cond.hxx"
+
+#include <cassert>
+
+/**
+ * A reader/writer lock which can be used with std::unique_lock (for
+ * exclusive access) and std::shared_lock (for shared access).
+ *
+ * Unlike std::shared_mutex (which is a pthread_rwlock with reader
+ * preference on glibc), this implementation prefers writers: as soon
+ * as a thread waits for exclusive access, no new readers are
+ * admitted.  This way, a steady stream of overlapping readers cannot
+ * starve the writer.
+ *
+ * This lock is not recursive.
+ */
+class SharedMutex {
+	Mutex mutex;
+
+	/**
+	 * Signalled when the exclusive lock is released.
+	 */
+	Cond readers_cond;
+
+	/**
+	 * Signalled when the last reader or the writer releases the
+	 * lock, while there are waiting writers.
+	 */
+	Cond writers_cond;
+
+	unsigned n_readers = 0, n_waiting_writers = 0;
+
+	bool writer = false;
+
+public:
+	SharedMutex() noexcept = default;
+
+	SharedMutex(const SharedMutex &) = delete;
+	SharedMutex &operator=(const SharedMutex &) = delete;
+
+	void lock() noexcept {
+		std::unique_lock lock{mutex};
+		++n_waiting_writers;
+		writers_cond.wait(lock, [this]{
+			return !writer && n_readers == 0;
+		});
+		--n_waiting_writers;
+		writer = true;
+	}
+
+	void unlock() noexcept {
+		bool notify_writer;
+
+		{
+			const std::scoped_lock lock{mutex};
+			assert(writer);
+			writer = false;
+			notify_writer = n_waiting_writers > 0;
+		}
+
+		if (notify_writer)
+			writers_cond.notify_one();
+		else
+			readers_cond.notify_all();
+	}
+
+	void lock_shared() noexcept {
+		std::unique_lock lock{mutex};
+		readers_cond.wait(lock, [this]{
+			return !writer && n_waiting_writers == 0;
+		});
+		++n_readers;
+	}
+
+	void unlock_shared() noexcept {
+		bool notify_writer;
+
+		{
+			const std::scoped_lock lock{mutex};
+			assert(n_readers > 0);
+			--n_readers;
+			notify_writer = n_readers == 0 && n_waiting_writers > 0;
+		}
+
+		if (notify_writer)
+			writers_cond.notify_one();
+	}
+};
+
+#endif
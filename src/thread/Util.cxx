@@ -72,10 +72,16 @@ SetThreadIdlePriority() noexcept
 
 void
 SetThreadRealtime()
+{
+	SetThreadRealtime(40);
+}
+
+void
+SetThreadRealtime([[maybe_unused]] int priority)
 {
 #ifdef __linux__
 	struct sched_param sched_param;
-	sched_param.sched_priority = 40;
+	sched_param.sched_priority = priority;
 
 	int policy = SCHED_FIFO;
 #ifdef SCHED_RESET_ON_FORK
@@ -86,3 +92,33 @@ SetThreadRealtime()
 		throw MakeErrno("sched_setscheduler failed");
 #endif	// __linux__
 }
+
+void
+SetThreadAffinity([[maybe_unused]] std::span<const unsigned> cpus)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const unsigned cpu : cpus) {
+		if (cpu >= CPU_SETSIZE)
+			throw MakeErrno(EINVAL, "CPU number too large");
+
+		CPU_SET(cpu, &set);
+	}
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		throw MakeErrno("sched_setaffinity failed");
+#elif defined(_WIN32)
+	DWORD_PTR mask = 0;
+	for (const unsigned cpu : cpus) {
+		if (cpu >= sizeof(mask) * 8)
+			throw MakeLastError(ERROR_INVALID_PARAMETER,
+					    "CPU number too large");
+
+		mask |= DWORD_PTR(1) << cpu;
+	}
+
+	if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+		throw MakeLastError("SetThreadAffinityMask() failed");
+#endif
+}
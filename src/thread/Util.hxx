@@ -4,6 +4,8 @@
 #ifndef THREAD_UTIL_HXX
 #define THREAD_UTIL_HXX
 
+#include <span>
+
 /**
  * Lower the current thread's priority to "idle" (very low).
  */
@@ -18,4 +20,22 @@ SetThreadIdlePriority() noexcept;
 void
 SetThreadRealtime();
 
+/**
+ * Like SetThreadRealtime(), but with the specified SCHED_FIFO
+ * priority (1..99).
+ *
+ * Throws std::system_error on error.
+ */
+void
+SetThreadRealtime(int priority);
+
+/**
+ * Restrict the current thread to the specified CPUs.  Does nothing
+ * on operating systems which are not supported.
+ *
+ * Throws std::system_error on error.
+ */
+void
+SetThreadAffinity(std::span<const unsigned> cpus);
+
 #endif
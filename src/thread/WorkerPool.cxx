@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "WorkerPool.hxx"
+#include "Name.hxx"
+#include "Util.hxx"
+
+#include <cassert>
+
+void
+WorkerPool::Start(unsigned n_threads)
+{
+	assert(!IsStarted());
+	assert(n_threads > 0);
+
+	quit = false;
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i) {
+			auto &thread = threads.emplace_front(BIND_THIS_METHOD(Run));
+			thread.Start();
+		}
+	} catch (...) {
+		/* the last (failed) thread has not been started */
+		threads.pop_front();
+		Stop();
+		throw;
+	}
+}
+
+void
+WorkerPool::Stop() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+
+		for (auto &queue : queues)
+			queue.clear();
+	}
+
+	cond.notify_all();
+
+	for (auto &thread : threads)
+		thread.Join();
+
+	threads.clear();
+}
+
+void
+WorkerPool::Push(WorkerJob &job, WorkerPriority priority) noexcept
+{
+	assert(IsStarted());
+
+	{
+		const std::scoped_lock lock{mutex};
+		queues[static_cast<std::size_t>(priority)].push_back(job);
+	}
+
+	cond.notify_one();
+}
+
+bool
+WorkerPool::Cancel(WorkerJob &job) noexcept
+{
+	const std::scoped_lock lock{mutex};
+	if (!job.is_linked())
+		return false;
+
+	job.unlink();
+	return true;
+}
+
+inline WorkerJob *
+WorkerPool::PopJob() noexcept
+{
+	for (auto &queue : queues)
+		if (!queue.empty())
+			return &queue.pop_front();
+
+	return nullptr;
+}
+
+inline void
+WorkerPool::Run() noexcept
+{
+	SetThreadName(name);
+
+	if (idle_priority)
+		SetThreadIdlePriority();
+
+	try {
+		scheduling.Apply(false);
+	} catch (...) {
+		/* ignore; the worker runs with the default settings
+		   then */
+	}
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		WorkerJob *job;
+		cond.wait(lock, [this, &job]{
+			return quit || (job = PopJob()) != nullptr;
+		});
+		if (quit)
+			break;
+
+		{
+			const ScopeUnlock unlock{mutex};
+			job->Run();
+		}
+	}
+}
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_THREAD_WORKER_POOL_HXX
+#define MPD_THREAD_WORKER_POOL_HXX
+
+#include "Mutex.hxx"
+#include "Cond.hxx"
+#include "Thread.hxx"
+#include "Scheduling.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <forward_list>
+
+/**
+ * A unit of work which can be submitted to a #WorkerPool.  The
+ * caller owns the object and must keep it alive until Run() has
+ * finished.
+ */
+class WorkerJob : public IntrusiveListHook<IntrusiveHookMode::TRACK> {
+public:
+	virtual ~WorkerJob() noexcept = default;
+
+	/**
+	 * Invoked in one of the worker threads.
+	 */
+	virtual void Run() noexcept = 0;
+};
+
+/**
+ * The order in which queued #WorkerJob instances are picked by a
+ * #WorkerPool.  Jobs with the same priority run in FIFO order.
+ */
+enum class WorkerPriority : uint_least8_t {
+	/**
+	 * Short jobs a client is waiting for.
+	 */
+	HIGH,
+
+	NORMAL,
+
+	/**
+	 * Long-running jobs which may be overtaken by all others.
+	 */
+	LOW,
+};
+
+/**
+ * A fixed number of threads which execute #WorkerJob instances in
+ * FIFO order (per #WorkerPriority).
+ */
+class WorkerPool final {
+	const char *const name;
+
+	const bool idle_priority;
+
+	ThreadScheduling scheduling;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * One queue per #WorkerPriority.
+	 */
+	std::array<IntrusiveList<WorkerJob>, 3> queues;
+
+	std::forward_list<Thread> threads;
+
+	bool quit = false;
+
+public:
+	/**
+	 * @param _name the name of the worker threads (shown by the
+	 * operating system)
+	 * @param _idle_priority run the worker threads with idle
+	 * priority (see SetThreadIdlePriority())
+	 */
+	WorkerPool(const char *_name, bool _idle_priority=false) noexcept
+		:name(_name), idle_priority(_idle_priority) {}
+
+	~WorkerPool() noexcept {
+		Stop();
+	}
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	bool IsStarted() const noexcept {
+		return !threads.empty();
+	}
+
+	/**
+	 * Configure the CPU affinity and priority of the worker
+	 * threads.  Must be called before Start().
+	 */
+	void SetScheduling(const ThreadScheduling &_scheduling) noexcept {
+		assert(!IsStarted());
+
+		scheduling = _scheduling;
+	}
+
+	/**
+	 * Launch the specified number of threads.
+	 *
+	 * Throws on error.
+	 */
+	void Start(unsigned n_threads);
+
+	/**
+	 * Wait for all threads to finish.  Jobs which are still
+	 * queued are discarded without being run.
+	 */
+	void Stop() noexcept;
+
+	/**
+	 * Submit a job.  It will be executed by the next idle worker
+	 * thread after all queued jobs with the same or a higher
+	 * priority.
+	 */
+	void Push(WorkerJob &job,
+		  WorkerPriority priority=WorkerPriority::NORMAL) noexcept;
+
+	/**
+	 * Remove a job from the queue if it has not been started
+	 * yet.
+	 *
+	 * @return true if the job was removed, false if it is
+	 * already running (or has finished)
+	 */
+	bool Cancel(WorkerJob &job) noexcept;
+
+private:
+	/**
+	 * Remove the first job from the highest-priority non-empty
+	 * queue.  Caller must lock the mutex.
+	 *
+	 * @return the job or nullptr if all queues are empty
+	 */
+	WorkerJob *PopJob() noexcept;
+
+	void Run() noexcept;
+};
+
+#endif
@@ -8,12 +8,21 @@
 #include <new>
 
 #ifdef __linux__
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#include <linux/mempolicy.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #else
 #include <stdlib.h>
 #endif
 
+std::atomic_size_t huge_allocated_size{0};
+
 #ifdef __linux__
 
 /**
@@ -48,13 +57,97 @@ HugeAllocate(size_t size)
 	madvise(p, size, MADV_HUGEPAGE);
 #endif
 
+	huge_allocated_size.fetch_add(size, std::memory_order_relaxed);
+	return {(std::byte *)p, size};
+}
+
+/**
+ * Determine the default huge page size from /proc/meminfo.
+ */
+static size_t
+ReadHugePageSize() noexcept
+{
+	size_t result = 2 * 1024 * 1024;
+
+	FILE *file = fopen("/proc/meminfo", "r");
+	if (file == nullptr)
+		return result;
+
+	char line[128];
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		static constexpr char prefix[] = "Hugepagesize:";
+		if (strncmp(line, prefix, sizeof(prefix) - 1) == 0) {
+			char *endptr;
+			unsigned long kb = strtoul(line + sizeof(prefix) - 1,
+						   &endptr, 10);
+			if (endptr > line + sizeof(prefix) - 1 && kb > 0)
+				result = size_t(kb) * 1024;
+			break;
+		}
+	}
+
+	fclose(file);
+	return result;
+}
+
+std::span<std::byte>
+HugeAllocateHugeTlb(size_t size)
+{
+#ifdef MAP_HUGETLB
+	static const size_t huge_page_size = ReadHugePageSize();
+	size = RoundUpToPowerOfTwo(size, huge_page_size);
+
+	constexpr int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE|MAP_HUGETLB;
+	void *p = mmap(nullptr, size,
+		       PROT_READ|PROT_WRITE, flags,
+		       -1, 0);
+	if (p == (void *)-1)
+		throw std::bad_alloc();
+
+	huge_allocated_size.fetch_add(size, std::memory_order_relaxed);
 	return {(std::byte *)p, size};
+#else
+	(void)size;
+	throw std::bad_alloc();
+#endif
 }
 
 void
 HugeFree(void *p, size_t size) noexcept
 {
-	munmap(p, AlignToPageSize(size));
+	size = AlignToPageSize(size);
+	huge_allocated_size.fetch_sub(size, std::memory_order_relaxed);
+	munmap(p, size);
+}
+
+bool
+HugeLock(void *p, size_t size) noexcept
+{
+	return mlock(p, AlignToPageSize(size)) == 0;
+}
+
+bool
+HugeBindNumaNode(void *p, size_t size, unsigned node) noexcept
+{
+#ifdef SYS_mbind
+	/* calling the system call directly, because we don't want to
+	   depend on libnuma just for this */
+	constexpr unsigned long bits = sizeof(unsigned long) * 8;
+	unsigned long nodemask[4]{};
+	if (node >= std::size(nodemask) * bits)
+		return false;
+
+	nodemask[node / bits] = 1UL << (node % bits);
+
+	return syscall(SYS_mbind, p, AlignToPageSize(size),
+		       MPOL_BIND, nodemask, std::size(nodemask) * bits,
+		       0) == 0;
+#else
+	(void)p;
+	(void)size;
+	(void)node;
+	return false;
+#endif
 }
 
 void
@@ -92,6 +185,8 @@ HugeAllocate(size_t size)
 	if (p == nullptr)
 		throw std::bad_alloc();
 
+	huge_allocated_size.fetch_add(size, std::memory_order_relaxed);
+
 	// TODO: round size up to the page size
 	return {(std::byte *)p, size};
 }
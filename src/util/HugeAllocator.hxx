@@ -5,10 +5,19 @@
 
 #include "SpanCast.hxx"
 
+#include <atomic>
 #include <cstddef>
+#include <new>
 #include <span>
 #include <utility>
 
+/**
+ * The total size of all allocations made with HugeAllocate() and
+ * HugeAllocateHugeTlb() which have not yet been freed.  This is
+ * only used for statistics.
+ */
+extern std::atomic_size_t huge_allocated_size;
+
 #ifdef __linux__
 
 /**
@@ -25,6 +34,20 @@
 std::span<std::byte>
 HugeAllocate(size_t size);
 
+/**
+ * Like HugeAllocate(), but the memory is backed by explicit huge
+ * pages from the hugetlbfs pool (MAP_HUGETLB).  The pool must have
+ * been reserved by the administrator (vm.nr_hugepages).
+ *
+ * Throws std::bad_alloc on error (e.g. if there are not enough free
+ * huge pages)
+ *
+ * @returns the allocated buffer with a size rounded up to the huge
+ * page size; this exact size must be passed to HugeFree()
+ */
+std::span<std::byte>
+HugeAllocateHugeTlb(size_t size);
+
 /**
  * @param p an allocation returned by HugeAllocate()
  * @param size the allocation's size as passed to HugeAllocate()
@@ -32,6 +55,24 @@ HugeAllocate(size_t size);
 void
 HugeFree(void *p, size_t size) noexcept;
 
+/**
+ * Lock the allocation into RAM (mlock()), so accessing it will never
+ * cause a page fault.  This may fail due to RLIMIT_MEMLOCK.
+ *
+ * @return true on success
+ */
+bool
+HugeLock(void *p, size_t size) noexcept;
+
+/**
+ * Bind the allocation to the specified NUMA node (mbind()).  This
+ * must be called before the memory is touched (or locked).
+ *
+ * @return true on success
+ */
+bool
+HugeBindNumaNode(void *p, size_t size, unsigned node) noexcept;
+
 /**
  * Set a name for the specified virtual memory area.
  *
@@ -64,12 +105,31 @@ HugeDiscard(void *p, size_t size) noexcept;
 std::span<std::byte>
 HugeAllocate(size_t size);
 
+static inline std::span<std::byte>
+HugeAllocateHugeTlb(size_t)
+{
+	throw std::bad_alloc{};
+}
+
 static inline void
-HugeFree(void *p, size_t) noexcept
+HugeFree(void *p, size_t size) noexcept
 {
+	huge_allocated_size.fetch_sub(size, std::memory_order_relaxed);
 	VirtualFree(p, 0, MEM_RELEASE);
 }
 
+static inline bool
+HugeLock(void *p, size_t size) noexcept
+{
+	return VirtualLock(p, size);
+}
+
+static inline bool
+HugeBindNumaNode(void *, size_t, unsigned) noexcept
+{
+	return false;
+}
+
 static inline void
 HugeSetName(void *, size_t, const char *) noexcept
 {
@@ -95,16 +155,37 @@ HugeDiscard(void *p, size_t size) noexcept
 static inline std::span<std::byte>
 HugeAllocate(size_t size)
 {
-	return {new std::byte[size], size};
+	std::span<std::byte> result{new std::byte[size], size};
+	huge_allocated_size.fetch_add(size, std::memory_order_relaxed);
+	return result;
+}
+
+static inline std::span<std::byte>
+HugeAllocateHugeTlb(size_t)
+{
+	throw std::bad_alloc{};
 }
 
 static inline void
-HugeFree(void *_p, size_t) noexcept
+HugeFree(void *_p, size_t size) noexcept
 {
+	huge_allocated_size.fetch_sub(size, std::memory_order_relaxed);
 	auto *p = (std::byte *)_p;
 	delete[] p;
 }
 
+static inline bool
+HugeLock(void *, size_t) noexcept
+{
+	return false;
+}
+
+static inline bool
+HugeBindNumaNode(void *, size_t, unsigned) noexcept
+{
+	return false;
+}
+
 static inline void
 HugeSetName(void *, size_t, const char *) noexcept
 {
@@ -128,8 +209,21 @@ HugeDiscard(void *, size_t) noexcept
 template<typename T>
 class HugeArray {
 	using Buffer = std::span<T>;
+
+	/**
+	 * The raw allocation as returned by HugeAllocate(); it may
+	 * be a bit larger than #buffer.
+	 */
+	std::span<std::byte> allocation;
+
 	Buffer buffer{nullptr};
 
+	/**
+	 * Was HugeLock() successful?  Locked memory is never
+	 * discarded.
+	 */
+	bool locked = false;
+
 public:
 	typedef typename Buffer::size_type size_type;
 	typedef typename Buffer::value_type value_type;
@@ -140,37 +234,66 @@ public:
 	constexpr HugeArray() noexcept = default;
 
 	explicit HugeArray(size_type _size)
-		:buffer(FromBytesFloor<value_type>(HugeAllocate(sizeof(value_type) * _size))) {}
+		:HugeArray(HugeAllocate(sizeof(value_type) * _size)) {}
+
+	/**
+	 * Adopt an allocation returned by HugeAllocate() or
+	 * HugeAllocateHugeTlb().
+	 */
+	explicit HugeArray(std::span<std::byte> _allocation) noexcept
+		:allocation(_allocation),
+		 buffer(FromBytesFloor<value_type>(_allocation)) {}
 
 	constexpr HugeArray(HugeArray &&other) noexcept
-		:buffer(std::exchange(other.buffer, nullptr)) {}
+		:allocation(std::exchange(other.allocation, {})),
+		 buffer(std::exchange(other.buffer, nullptr)),
+		 locked(std::exchange(other.locked, false)) {}
 
 	~HugeArray() noexcept {
-		if (!buffer.empty()) {
-			auto v = std::as_writable_bytes(buffer);
-			HugeFree(v.data(), v.size());
-		}
+		if (!allocation.empty())
+			HugeFree(allocation.data(), allocation.size());
 	}
 
 	constexpr HugeArray &operator=(HugeArray &&other) noexcept {
 		using std::swap;
+		swap(allocation, other.allocation);
 		swap(buffer, other.buffer);
+		swap(locked, other.locked);
 		return *this;
 	}
 
 	void SetName(const char *name) noexcept {
-		const auto v = std::as_writable_bytes(buffer);
-		HugeSetName(v.data(), v.size(), name);
+		HugeSetName(allocation.data(), allocation.size(), name);
 	}
 
 	void ForkCow(bool enable) noexcept {
-		const auto v = std::as_writable_bytes(buffer);
-		HugeForkCow(v.data(), v.size(), enable);
+		HugeForkCow(allocation.data(), allocation.size(), enable);
+	}
+
+	/**
+	 * @see HugeLock()
+	 */
+	bool Lock() noexcept {
+		if (!locked)
+			locked = HugeLock(allocation.data(), allocation.size());
+		return locked;
+	}
+
+	constexpr bool IsLocked() const noexcept {
+		return locked;
+	}
+
+	/**
+	 * @see HugeBindNumaNode()
+	 */
+	bool BindNumaNode(unsigned node) noexcept {
+		return HugeBindNumaNode(allocation.data(), allocation.size(),
+					node);
 	}
 
 	void Discard() noexcept {
-		const auto v = std::as_writable_bytes(buffer);
-		HugeDiscard(v.data(), v.size());
+		if (!locked)
+			HugeDiscard(allocation.data(), allocation.size());
 	}
 
 	constexpr bool operator==(std::nullptr_t) const noexcept {
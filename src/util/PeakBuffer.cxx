@@ -5,19 +5,138 @@
 #include "DynamicFifoBuffer.hxx"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <utility>
+
+static constexpr std::size_t PEAK_CHUNK_SIZE = 64 * 1024;
+
+struct PeakBuffer::Chunk {
+	Chunk *next = nullptr;
+
+	/**
+	 * The range of #data which contains data.
+	 */
+	std::size_t head = 0, tail = 0;
+
+	std::array<std::byte, PEAK_CHUNK_SIZE> data;
+
+	bool empty() const noexcept {
+		return head == tail;
+	}
+
+	std::span<std::byte> Read() noexcept {
+		return std::span{data}.subspan(head, tail - head);
+	}
+
+	std::span<std::byte> Write() noexcept {
+		return std::span{data}.subspan(tail);
+	}
+};
+
+namespace {
+
+/**
+ * A per-thread list of unused chunks.  Each #EventLoop runs in its
+ * own thread, so this is effectively a per-loop free list and needs
+ * no locking.
+ */
+class PeakChunkPool {
+	/**
+	 * Keep at most this many chunks; anything beyond that is
+	 * given back to the kernel.
+	 */
+	static constexpr std::size_t MAX_CHUNKS = 16;
+
+	PeakBuffer::Chunk *head = nullptr;
+	std::size_t n = 0;
+
+public:
+	~PeakChunkPool() noexcept {
+		while (head != nullptr)
+			delete std::exchange(head, head->next);
+	}
+
+	PeakBuffer::Chunk *Get() noexcept {
+		if (head == nullptr)
+			return new PeakBuffer::Chunk();
+
+		auto *chunk = std::exchange(head, head->next);
+		--n;
+		chunk->next = nullptr;
+		chunk->head = chunk->tail = 0;
+		return chunk;
+	}
+
+	void Put(PeakBuffer::Chunk *chunk) noexcept {
+		if (n >= MAX_CHUNKS) {
+			delete chunk;
+			return;
+		}
+
+		chunk->next = head;
+		head = chunk;
+		++n;
+	}
+};
+
+} // anonymous namespace
+
+static thread_local PeakChunkPool peak_chunk_pool;
+
+/**
+ * The total size of all chunks which are attached to a #PeakBuffer.
+ */
+static std::atomic_size_t total_peak_size;
 
 PeakBuffer::~PeakBuffer() noexcept
 {
 	delete normal_buffer;
-	delete peak_buffer;
+
+	while (peak_head != nullptr)
+		PopPeakChunk();
+}
+
+inline void
+PeakBuffer::PopPeakChunk() noexcept
+{
+	assert(peak_head != nullptr);
+
+	auto *chunk = std::exchange(peak_head, peak_head->next);
+	if (peak_head == nullptr)
+		peak_tail = nullptr;
+
+	total_peak_size -= sizeof(*chunk);
+	peak_chunk_pool.Put(chunk);
 }
 
 bool
 PeakBuffer::empty() const noexcept
 {
 	return (normal_buffer == nullptr || normal_buffer->empty()) &&
-		(peak_buffer == nullptr || peak_buffer->empty());
+		peak_fill == 0;
+}
+
+std::size_t
+PeakBuffer::GetAllocatedSize() const noexcept
+{
+	std::size_t result = 0;
+
+	if (normal_buffer != nullptr)
+		result += normal_buffer->GetCapacity();
+
+	for (const Chunk *chunk = peak_head; chunk != nullptr;
+	     chunk = chunk->next)
+		result += sizeof(*chunk);
+
+	return result;
+}
+
+std::size_t
+PeakBuffer::GetTotalPeakSize() noexcept
+{
+	return total_peak_size;
 }
 
 std::span<std::byte>
@@ -29,31 +148,52 @@ PeakBuffer::Read() const noexcept
 			return p;
 	}
 
-	if (peak_buffer != nullptr) {
-		const auto p = peak_buffer->Read();
+	if (peak_head != nullptr)
+		return peak_head->Read();
+
+	return {};
+}
+
+std::size_t
+PeakBuffer::Read(std::span<std::span<const std::byte>> dest) const noexcept
+{
+	std::size_t n = 0;
+
+	if (n < dest.size() && normal_buffer != nullptr) {
+		const auto p = normal_buffer->Read();
 		if (!p.empty())
-			return p;
+			dest[n++] = p;
 	}
 
-	return {};
+	for (Chunk *chunk = peak_head; chunk != nullptr && n < dest.size();
+	     chunk = chunk->next)
+		if (!chunk->empty())
+			dest[n++] = chunk->Read();
+
+	return n;
 }
 
 void
 PeakBuffer::Consume(std::size_t length) noexcept
 {
 	if (normal_buffer != nullptr && !normal_buffer->empty()) {
-		normal_buffer->Consume(length);
-		return;
+		const std::size_t n = std::min(length,
+					       normal_buffer->GetAvailable());
+		normal_buffer->Consume(n);
+		length -= n;
 	}
 
-	if (peak_buffer != nullptr && !peak_buffer->empty()) {
-		peak_buffer->Consume(length);
-		if (peak_buffer->empty()) {
-			delete peak_buffer;
-			peak_buffer = nullptr;
-		}
+	while (length > 0) {
+		assert(peak_head != nullptr);
+
+		const std::size_t n = std::min(length,
+					       peak_head->tail - peak_head->head);
+		peak_head->head += n;
+		peak_fill -= n;
+		length -= n;
 
-		return;
+		if (peak_head->empty())
+			PopPeakChunk();
 	}
 }
 
@@ -81,20 +221,55 @@ AppendTo(DynamicFifoBuffer<std::byte> &buffer,
 	return total;
 }
 
+inline bool
+PeakBuffer::AppendPeak(std::span<const std::byte> src) noexcept
+{
+	assert(!src.empty());
+
+	if (peak_fill + src.size() > peak_size)
+		return false;
+
+	peak_fill += src.size();
+
+	do {
+		if (peak_tail == nullptr || peak_tail->Write().empty()) {
+			auto *chunk = peak_chunk_pool.Get();
+			total_peak_size += sizeof(*chunk);
+			if (peak_tail != nullptr)
+				peak_tail->next = chunk;
+			else
+				peak_head = chunk;
+			peak_tail = chunk;
+		}
+
+		const auto p = peak_tail->Write();
+		const std::size_t nbytes = std::min(src.size(), p.size());
+		std::copy_n(src.begin(), nbytes, p.begin());
+		peak_tail->tail += nbytes;
+		src = src.subspan(nbytes);
+	} while (!src.empty());
+
+	return true;
+}
+
 bool
 PeakBuffer::Append(std::span<const std::byte> src)
 {
 	if (src.empty())
 		return true;
 
-	if (peak_buffer != nullptr && !peak_buffer->empty()) {
-		std::size_t nbytes = AppendTo(*peak_buffer, src);
-		return nbytes == src.size();
-	}
+	if (peak_fill > 0)
+		/* preserve the order: once the peak buffer is in
+		   use, everything goes there */
+		return AppendPeak(src);
 
 	if (normal_buffer == nullptr)
 		normal_buffer = new DynamicFifoBuffer<std::byte>(normal_size);
 
+	if (src.size() > normal_size - normal_buffer->GetAvailable() + peak_size)
+		/* don't append a partial piece of data */
+		return false;
+
 	std::size_t nbytes = AppendTo(*normal_buffer, src);
 	if (nbytes > 0) {
 		src = src.subspan(nbytes);
@@ -102,13 +277,5 @@ PeakBuffer::Append(std::span<const std::byte> src)
 			return true;
 	}
 
-	if (peak_buffer == nullptr) {
-		if (peak_size > 0)
-			peak_buffer = new DynamicFifoBuffer<std::byte>(peak_size);
-		if (peak_buffer == nullptr)
-			return false;
-	}
-
-	nbytes = AppendTo(*peak_buffer, src);
-	return nbytes == src.size();
+	return AppendPeak(src);
 }
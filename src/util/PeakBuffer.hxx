@@ -11,25 +11,45 @@ template<typename T> class DynamicFifoBuffer;
 
 /**
  * A FIFO-like buffer that will allocate more memory on demand to
- * allow large peaks.  This second buffer will be given back to the
- * kernel when it has been consumed.
+ * allow large peaks.  The peak memory is a chain of fixed-size
+ * chunks which are handed back to a small per-thread pool when they
+ * have been consumed, so bursts do not allocate and free large
+ * buffers over and over.
  */
 class PeakBuffer {
+public:
+	struct Chunk;
+
+private:
 	std::size_t normal_size, peak_size;
 
-	DynamicFifoBuffer<std::byte> *normal_buffer, *peak_buffer;
+	DynamicFifoBuffer<std::byte> *normal_buffer;
+
+	/**
+	 * The chain of peak chunks; data is read from #peak_head
+	 * and appended to #peak_tail.
+	 */
+	Chunk *peak_head, *peak_tail;
+
+	/**
+	 * The number of bytes in the peak chunks.
+	 */
+	std::size_t peak_fill;
 
 public:
 	PeakBuffer(std::size_t _normal_size, std::size_t _peak_size) noexcept
 		:normal_size(_normal_size), peak_size(_peak_size),
-		 normal_buffer(nullptr), peak_buffer(nullptr) {}
+		 normal_buffer(nullptr),
+		 peak_head(nullptr), peak_tail(nullptr), peak_fill(0) {}
 
 	PeakBuffer(PeakBuffer &&other) noexcept
 		:normal_size(other.normal_size), peak_size(other.peak_size),
 		 normal_buffer(other.normal_buffer),
-		 peak_buffer(other.peak_buffer) {
+		 peak_head(other.peak_head), peak_tail(other.peak_tail),
+		 peak_fill(other.peak_fill) {
 		other.normal_buffer = nullptr;
-		other.peak_buffer = nullptr;
+		other.peak_head = other.peak_tail = nullptr;
+		other.peak_fill = 0;
 	}
 
 	~PeakBuffer() noexcept;
@@ -44,12 +64,52 @@ public:
 	[[gnu::pure]]
 	bool empty() const noexcept;
 
+	/**
+	 * Returns the number of bytes allocated by this object (for
+	 * statistics), which may be much more than the amount of
+	 * data in it.
+	 */
+	[[gnu::pure]]
+	std::size_t GetAllocatedSize() const noexcept;
+
+	/**
+	 * Returns the number of bytes of peak memory currently in
+	 * use by all #PeakBuffer instances (in all threads).
+	 */
+	[[gnu::pure]]
+	static std::size_t GetTotalPeakSize() noexcept;
+
+	/**
+	 * Returns the first contiguous piece of data.
+	 */
 	[[gnu::pure]]
 	std::span<std::byte> Read() const noexcept;
 
+	/**
+	 * Fill the given array with the pieces of buffered data, in
+	 * order, e.g. for writev().
+	 *
+	 * @return the number of array elements filled
+	 */
+	std::size_t Read(std::span<std::span<const std::byte>> dest) const noexcept;
+
+	/**
+	 * Remove data from the beginning of the buffer; this may span
+	 * several of the pieces returned by Read().
+	 */
 	void Consume(std::size_t length) noexcept;
 
+	/**
+	 * Append data to the end of the buffer.
+	 *
+	 * @return false if there is not enough room for all of the
+	 * data (in which case nothing is appended)
+	 */
 	bool Append(std::span<const std::byte> src);
+
+private:
+	void PopPeakChunk() noexcept;
+	bool AppendPeak(std::span<const std::byte> src) noexcept;
 };
 
 #endif
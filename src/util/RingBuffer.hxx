@@ -107,7 +107,7 @@ public:
 		const auto wp = write_position.load(std::memory_order_acquire);
 		assert(wp < buffer.capacity());
 
-		const auto rp = GetPreviousIndex(read_position.load(std::memory_order_relaxed));
+		const auto rp = GetPreviousIndex(read_position.load(std::memory_order_acquire));
 		assert(rp < buffer.capacity());
 
 		std::size_t n = (wp <= rp ? rp : buffer.capacity()) - wp;
@@ -145,7 +145,7 @@ public:
 	 */
 	std::size_t WriteFrom(std::span<const T> src) noexcept {
 		auto wp = write_position.load(std::memory_order_acquire);
-		const auto rp = GetPreviousIndex(read_position.load(std::memory_order_relaxed));
+		const auto rp = GetPreviousIndex(read_position.load(std::memory_order_acquire));
 
 		std::size_t n = std::min((wp <= rp ? rp : buffer.capacity()) - wp,
 					 src.size());
@@ -195,7 +195,7 @@ public:
 	[[gnu::pure]]
 	std::span<const T> Read() const noexcept {
 		const auto rp = read_position.load(std::memory_order_acquire);
-		const auto wp = write_position.load(std::memory_order_relaxed);
+		const auto wp = write_position.load(std::memory_order_acquire);
 
 		std::size_t n = (rp <= wp ? wp : buffer.capacity()) - rp;
 		return {&buffer[rp], n};
@@ -232,7 +232,7 @@ public:
 	 */
 	std::size_t ReadTo(std::span<T> dest) noexcept {
 		auto rp = read_position.load(std::memory_order_acquire);
-		const auto wp = write_position.load(std::memory_order_relaxed);
+		const auto wp = write_position.load(std::memory_order_acquire);
 
 		std::size_t n = std::min((rp <= wp ? wp : buffer.capacity()) - rp,
 					 dest.size());
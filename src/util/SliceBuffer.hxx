@@ -9,6 +9,7 @@
 #include <cassert>
 #include <cstddef>
 #include <new>
+#include <span>
 #include <utility>
 
 /**
@@ -48,6 +49,20 @@ public:
 		buffer.ForkCow(false);
 	}
 
+	/**
+	 * Adopt an allocation returned by HugeAllocate() or
+	 * HugeAllocateHugeTlb(); it should be (at least)
+	 * GetAllocationSize() bytes large.
+	 */
+	explicit SliceBuffer(std::span<std::byte> allocation) noexcept
+		:buffer(allocation) {
+		buffer.ForkCow(false);
+	}
+
+	static constexpr std::size_t GetAllocationSize(unsigned count) noexcept {
+		return sizeof(Slice) * count;
+	}
+
 	~SliceBuffer() noexcept {
 		/* all slices must be freed explicitly, and this
 		   assertion checks for leaks */
@@ -61,6 +76,10 @@ public:
 		return buffer.size();
 	}
 
+	unsigned GetAllocatedCount() const noexcept {
+		return n_allocated;
+	}
+
 	bool empty() const noexcept {
 		return n_allocated == 0;
 	}
@@ -73,6 +92,24 @@ public:
 		buffer.SetName(name);
 	}
 
+	/**
+	 * @see HugeArray::Lock()
+	 */
+	bool Lock() noexcept {
+		return buffer.Lock();
+	}
+
+	bool IsLocked() const noexcept {
+		return buffer.IsLocked();
+	}
+
+	/**
+	 * @see HugeArray::BindNumaNode()
+	 */
+	bool BindNumaNode(unsigned node) noexcept {
+		return buffer.BindNumaNode(node);
+	}
+
 	void DiscardMemory() noexcept {
 		assert(empty());
 
@@ -5,6 +5,7 @@
 #include "CharUtil.hxx"
 #include "StringStrip.hxx"
 
+#include <cstring>
 #include <stdexcept>
 
 static inline bool
@@ -98,8 +99,6 @@ Tokenizer::NextUnquoted()
 char *
 Tokenizer::NextString()
 {
-	char *const word = input, *dest = input;
-
 	if (*input == 0)
 		/* end of line */
 		return nullptr;
@@ -109,9 +108,17 @@ Tokenizer::NextString()
 	if (*input != '"')
 		throw std::runtime_error("'\"' expected");
 
-	++input;
+	char *const word = ++input;
+
+	/* fast path: as long as there is no backslash, the string
+	   can be used in place */
+
+	input += std::strcspn(input, "\"\\");
+
+	/* slow path: unescape the rest of the string, moving it
+	   towards the beginning */
 
-	/* copy all characters */
+	char *dest = input;
 
 	while (*input != '"') {
 		if (*input == '\\')
@@ -141,6 +141,40 @@ ValidateUTF8(const char *p) noexcept
 	return true;
 }
 
+bool
+ValidateUTF8(std::string_view s) noexcept
+{
+	const char *p = s.data();
+	const char *const end = p + s.size();
+
+	while (p < end) {
+		if (end - p >= 8) {
+			/* fast path: skip 8 ASCII characters at a
+			   time */
+			uint_least64_t word;
+			std::copy_n(p, sizeof(word), (char *)&word);
+			if ((word & 0x8080808080808080ULL) == 0) {
+				p += sizeof(word);
+				continue;
+			}
+		}
+
+		if (IsASCII(*p)) {
+			++p;
+			continue;
+		}
+
+		const std::size_t n = SequenceLengthUTF8(*p);
+		if (n == 0 || std::size_t(end - p) < n ||
+		    SequenceLengthUTF8(p) != n)
+			return false;
+
+		p += n;
+	}
+
+	return true;
+}
+
 std::size_t
 SequenceLengthUTF8(char ch) noexcept
 {
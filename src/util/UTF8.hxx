@@ -5,6 +5,7 @@
 #define UTF8_HXX
 
 #include <cstddef>
+#include <string_view>
 
 /**
  * Is this a valid UTF-8 string?
@@ -13,6 +14,14 @@
 bool
 ValidateUTF8(const char *p) noexcept;
 
+/**
+ * Is this a valid UTF-8 string?  This overload checks runs of ASCII
+ * characters one machine word at a time.
+ */
+[[gnu::pure]]
+bool
+ValidateUTF8(std::string_view s) noexcept;
+
 /**
  * @return the number of the sequence beginning with the given
  * character, or 0 if the character is not a valid start byte
@@ -0,0 +1,356 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * This program generates synthetic music libraries and measures the
+ * performance of the "simple" database plugin: saving and loading
+ * (text and binary format), memory usage and common queries.
+ *
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/Selection.hxx"
+#include "db/Stats.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Builder.hxx"
+#include "config/Block.hxx"
+#include "event/Loop.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/NarrowPath.hxx"
+#include "util/PrintException.hxx"
+#include "util/RecursiveMap.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+static unsigned songs_per_album = 12;
+static unsigned albums_per_artist = 8;
+static unsigned n_genres = 50;
+static unsigned n_repeat = 10;
+static unsigned walk_threads = 0;
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() noexcept override {}
+	void OnDatabaseSongRemoved(const char *) noexcept override {}
+
+	bool IsPlaybackStarving() const noexcept override {
+		return false;
+	}
+};
+
+/**
+ * Determine the resident set size of this process in bytes, or 0 if
+ * that is not possible on this platform.
+ */
+static std::size_t
+GetResidentSetSize() noexcept
+{
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (file == nullptr)
+		return 0;
+
+	unsigned long size, resident;
+	const bool success = fscanf(file, "%lu %lu", &size, &resident) == 2;
+	fclose(file);
+
+	return success ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+/**
+ * @return the duration of one call in milliseconds
+ */
+template<typename F>
+static double
+Measure(unsigned n, F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < n; ++i)
+		f();
+
+	const std::chrono::duration<double, std::milli> duration =
+		std::chrono::steady_clock::now() - start;
+	return duration.count() / n;
+}
+
+/**
+ * Fill the given (empty) directory with songs in a "Artist/Album/Track"
+ * layout.
+ */
+static void
+Generate(Directory &root, unsigned n_songs)
+{
+	const unsigned songs_per_artist = songs_per_album * albums_per_artist;
+
+	Directory *artist_directory = nullptr, *album_directory = nullptr;
+	TagBuilder tag;
+
+	for (unsigned i = 0; i < n_songs; ++i) {
+		const unsigned artist = i / songs_per_artist;
+		const unsigned album = (i / songs_per_album) % albums_per_artist;
+		const unsigned track = i % songs_per_album;
+
+		const auto artist_name = fmt::format("Artist {}", artist);
+		const auto album_name = fmt::format("Album {}.{}", artist, album);
+
+		if (i % songs_per_artist == 0)
+			artist_directory = root.MakeChild(artist_name);
+
+		if (track == 0)
+			album_directory = artist_directory->MakeChild(album_name);
+
+		tag.Clear();
+		tag.SetDuration(SignedSongTime::FromS(180 + i % 120));
+		tag.AddItem(TAG_ARTIST, artist_name);
+		tag.AddItem(TAG_ALBUM_ARTIST, artist_name);
+		tag.AddItem(TAG_ALBUM, album_name);
+		tag.AddItem(TAG_TITLE, fmt::format("Title {}", i));
+		tag.AddItem(TAG_TRACK, fmt::format("{}", track + 1));
+		tag.AddItem(TAG_GENRE, fmt::format("Genre {}", artist % n_genres));
+		tag.AddItem(TAG_DATE, fmt::format("{}", 1960 + artist % 60));
+
+		auto song = std::make_unique<Song>(fmt::format("{:02} - Title {}.flac",
+							       track + 1, i),
+						   *album_directory);
+		song->tag = tag.Commit();
+		album_directory->AddSong(std::move(song));
+	}
+}
+
+static void
+PrintResult(const char *name, double ms)
+{
+	fmt::print("  {:<40} {:12.3f} ms\n", name, ms);
+}
+
+static void
+BenchVisit(const Database &db, const char *name,
+	   const char *expression, bool fold_case)
+{
+	SongFilter filter;
+	const char *const args[] = {expression};
+	filter.Parse(args, fold_case);
+	filter.Optimize();
+
+	const DatabaseSelection selection{"", true, &filter};
+
+	std::size_t n_songs = 0;
+	uint_least64_t total_time = 0;
+
+	const double ms = Measure(n_repeat, [&]{
+		n_songs = 0;
+		total_time = 0;
+
+		db.Visit(selection, [&](const LightSong &song){
+			++n_songs;
+			if (const auto duration = song.GetDuration();
+			    !duration.IsNegative())
+				total_time += duration.ToMS();
+		});
+	});
+
+	const auto label = fmt::format("{} ({} songs)", name, n_songs);
+	PrintResult(label.c_str(), ms);
+}
+
+static void
+BenchUniqueTags(const Database &db, const char *name,
+		std::span<const TagType> tag_types)
+{
+	const DatabaseSelection selection{"", true};
+
+	std::size_t n_values = 0;
+
+	const double ms = Measure(n_repeat, [&]{
+		const auto result = db.CollectUniqueTags(selection, tag_types);
+		n_values = result.size();
+	});
+
+	const auto label = fmt::format("{} ({} values)", name, n_values);
+	PrintResult(label.c_str(), ms);
+}
+
+static void
+BenchQueries(const Database &db)
+{
+	BenchVisit(db, "find Artist", "(Artist == \"Artist 7\")", false);
+	BenchVisit(db, "find Album", "(Album == \"Album 3.2\")", false);
+	BenchVisit(db, "search Title", "(Title contains \"title 99\")", true);
+	BenchVisit(db, "count Genre", "(Genre == \"Genre 3\")", false);
+	BenchVisit(db, "find Artist AND Date",
+		   "((Artist == \"Artist 7\") AND (Date == \"1967\"))", false);
+
+	static constexpr TagType artist[] = {TAG_ARTIST};
+	BenchUniqueTags(db, "list Artist", artist);
+
+	static constexpr TagType album_by_artist[] = {TAG_ALBUM_ARTIST, TAG_ALBUM};
+	BenchUniqueTags(db, "list Album group AlbumArtist", album_by_artist);
+
+	const DatabaseSelection all{"", true};
+	const double ms = Measure(n_repeat, [&]{
+		db.GetStats(all);
+	});
+	PrintResult("stats", ms);
+}
+
+static std::unique_ptr<SimpleDatabase>
+CreateDatabase(EventLoop &event_loop, DatabaseListener &listener,
+	       Path path, bool binary, const char *tag_index=nullptr)
+{
+	ConfigBlock block;
+	block.AddBlockParam("path", path.ToUTF8Throw());
+	block.AddBlockParam("compress", "no");
+	block.AddBlockParam("format", binary ? "binary" : "text");
+	block.AddBlockParam("walk_threads", fmt::format("{}", walk_threads));
+	if (tag_index != nullptr)
+		block.AddBlockParam("tag_index", tag_index);
+
+	auto db = SimpleDatabase::Create(event_loop, event_loop,
+					 listener, block);
+	return std::unique_ptr<SimpleDatabase>{static_cast<SimpleDatabase *>(db.release())};
+}
+
+static void
+Bench(const AllocatedPath &base_path, unsigned n_songs, bool binary)
+{
+	EventLoop event_loop;
+	NullDatabaseListener listener;
+
+	const auto path = base_path + (binary
+				       ? PATH_LITERAL(".bin")
+				       : PATH_LITERAL(".txt"));
+
+	fmt::print("{} songs, {} format:\n", n_songs,
+		   binary ? "binary" : "text");
+
+	{
+		const auto db = CreateDatabase(event_loop, listener,
+					       path, binary);
+		db->Open();
+
+		PrintResult("generate", Measure(1, [&]{
+			const ScopeDatabaseLock protect;
+			Generate(db->GetRoot(), n_songs);
+		}));
+
+		PrintResult("save", Measure(1, [&]{ db->Save(); }));
+		db->Close();
+	}
+
+	{
+#ifdef __GLIBC__
+		/* return the memory freed by the generated database
+		   to the kernel, or else the next one would reuse it
+		   and the RSS growth would be meaningless */
+		malloc_trim(0);
+#endif
+
+		const std::size_t rss_before = GetResidentSetSize();
+
+		const auto db = CreateDatabase(event_loop, listener,
+					       path, binary);
+		PrintResult("load", Measure(1, [&]{ db->Open(); }));
+
+		if (rss_before > 0)
+			fmt::print("  {:<40} {:12.1f} MiB\n", "RSS after load",
+				   (double(GetResidentSetSize()) - double(rss_before)) / (1024 * 1024));
+
+		BenchQueries(*db);
+		db->Close();
+	}
+
+	{
+		/* again, with a tag index */
+		const auto db = CreateDatabase(event_loop, listener,
+					       path, binary,
+					       "artist,album,genre");
+		PrintResult("load with tag index", Measure(1, [&]{
+			db->Open();
+		}));
+
+		BenchQueries(*db);
+		db->Close();
+	}
+
+	RemoveFile(path);
+}
+
+static unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const auto value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0)
+		throw std::invalid_argument("Not a number");
+
+	return value;
+}
+
+int
+main(int argc, char **argv)
+try {
+	std::vector<unsigned> sizes;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *value;
+
+		if ((value = StringAfterPrefix(arg, "--songs-per-album=")))
+			songs_per_album = ParseUnsigned(value);
+		else if ((value = StringAfterPrefix(arg, "--albums-per-artist=")))
+			albums_per_artist = ParseUnsigned(value);
+		else if ((value = StringAfterPrefix(arg, "--genres=")))
+			n_genres = ParseUnsigned(value);
+		else if ((value = StringAfterPrefix(arg, "--repeat=")))
+			n_repeat = ParseUnsigned(value);
+		else if ((value = StringAfterPrefix(arg, "--walk-threads=")))
+			walk_threads = ParseUnsigned(value);
+		else if (*arg != '-')
+			sizes.push_back(ParseUnsigned(arg));
+		else {
+			fmt::print(stderr, "Usage: BenchDatabase [--songs-per-album=N] [--albums-per-artist=N] [--genres=N] [--repeat=N] [--walk-threads=N] [SONGS...]\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (songs_per_album == 0 || albums_per_artist == 0 ||
+	    n_genres == 0 || n_repeat == 0)
+		throw std::invalid_argument("Zero is not allowed");
+
+	if (sizes.empty())
+		sizes = {10000, 100000, 1000000};
+
+	const auto base_path = AllocatedPath::Build(Path::FromFS(PATH_LITERAL("/tmp")),
+						    fmt::format("BenchDatabase.{}", getpid()));
+
+	for (const unsigned n_songs : sizes) {
+		Bench(base_path, n_songs, false);
+		Bench(base_path, n_songs, true);
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * This program measures the throughput of MPD's PCM library: volume,
+ * mixing, conversion, channel conversion, resampling, export and
+ * DSD-to-PCM.
+ *
+ * The vectorized kernels use the best implementation for this CPU;
+ * set the environment variable MPD_PCM_SIMD (see PcmGetSimdLevel())
+ * to measure a lower level.
+ *
+ */
+
+#include "config.h"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/ChannelsConverter.hxx"
+#include "pcm/Convert.hxx"
+#include "pcm/Dither.hxx"
+#include "pcm/Export.hxx"
+#include "pcm/FallbackResampler.hxx"
+#include "pcm/Mix.hxx"
+#include "pcm/PolyphaseResampler.hxx"
+#include "pcm/Simd.hxx"
+#include "pcm/Volume.hxx"
+#include "util/PrintException.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/StringAPI.hxx"
+
+#ifdef ENABLE_DSD
+#include "pcm/Dsd2Pcm.hxx"
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 4096 frames is roughly what a decoder produces per chunk */
+static constexpr std::size_t N_FRAMES = 4096;
+
+/**
+ * Print comma-separated values instead of a table?
+ */
+static bool csv;
+
+/**
+ * The minimum duration of each benchmark.
+ */
+static std::chrono::duration<double> min_duration{0.2};
+
+static std::vector<std::byte>
+MakeSamples(SampleFormat format, std::size_t n_samples)
+{
+	const std::size_t size = n_samples * sample_format_size(format);
+	std::vector<std::byte> buffer(size);
+	std::minstd_rand engine;
+
+	switch (format) {
+	case SampleFormat::FLOAT:
+		/* random bits may be NaN; use valid samples */
+		for (std::size_t i = 0; i < size; i += sizeof(float)) {
+			const float f = float(engine()) / float(engine.max()) * 2.f - 1.f;
+			memcpy(&buffer[i], &f, sizeof(f));
+		}
+		break;
+
+	case SampleFormat::S24_P32:
+		for (std::size_t i = 0; i < size; i += sizeof(int32_t)) {
+			const int32_t s = int32_t(engine() << 8) >> 8;
+			memcpy(&buffer[i], &s, sizeof(s));
+		}
+		break;
+
+	default:
+		for (auto &i : buffer)
+			i = std::byte(engine());
+		break;
+	}
+
+	return buffer;
+}
+
+/**
+ * Call the given function repeatedly for at least #min_duration and
+ * print its throughput.
+ *
+ * @param n_samples the number of input samples (of all channels)
+ * processed by one call
+ */
+template<typename F>
+static void
+Measure(const char *group, const char *variant, std::size_t n_samples,
+	F &&f)
+{
+	using Clock = std::chrono::steady_clock;
+
+	/* warm up, e.g. allocate the buffers */
+	f();
+
+	std::size_t n_iterations = 0;
+	const auto start = Clock::now();
+	std::chrono::duration<double> duration;
+
+	do {
+		for (unsigned i = 0; i < 16; ++i) {
+			const auto result = f();
+
+			/* don't let the compiler optimize the loop away */
+			asm volatile("" : : "g"(&result) : "memory");
+		}
+
+		n_iterations += 16;
+		duration = Clock::now() - start;
+	} while (duration < min_duration);
+
+	const double msamples = double(n_samples) * n_iterations / 1e6;
+	const double value = msamples / duration.count();
+
+	if (csv)
+		printf("%s,%s,%s,%.1f\n",
+		       group, variant, ToString(PcmGetSimdLevel()), value);
+	else
+		printf("%-10s %-24s %10.1f Msamples/s\n",
+		       group, variant, value);
+}
+
+static constexpr SampleFormat integer_and_float_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+static constexpr SampleFormat convert_formats[] = {
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+static void
+BenchVolume(SampleFormat format, bool allow_convert)
+{
+	constexpr unsigned channels = 2;
+	const auto src = MakeSamples(format, N_FRAMES * channels);
+
+	PcmVolume pv;
+	const auto out_format = pv.Open(format, allow_convert);
+	pv.SetVolume(PCM_VOLUME_1 * 3 / 4);
+
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s->%s",
+		 sample_format_to_string(format),
+		 sample_format_to_string(out_format));
+
+	Measure("volume", variant, N_FRAMES * channels, [&]{
+		return pv.Apply(src).data();
+	});
+
+	pv.Close();
+}
+
+static void
+BenchMix(SampleFormat format, float portion)
+{
+	constexpr unsigned channels = 2;
+	auto a = MakeSamples(format, N_FRAMES * channels);
+	const auto b = MakeSamples(format, N_FRAMES * channels);
+
+	PcmDither dither;
+
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s %s",
+		 sample_format_to_string(format),
+		 portion < 0 ? "add" : "portion");
+
+	Measure("mix", variant, N_FRAMES * channels, [&]{
+		return pcm_mix(dither, a.data(), b.data(), a.size(),
+			       format, portion);
+	});
+}
+
+static void
+BenchConvert(AudioFormat src_format, AudioFormat dest_format)
+{
+	const std::size_t n_samples = N_FRAMES * src_format.channels;
+	const auto src = MakeSamples(src_format.format, n_samples);
+
+	PcmConvert convert{src_format, dest_format};
+
+	char variant[64];
+	snprintf(variant, sizeof(variant), "%s->%s",
+		 ToString(src_format).c_str(),
+		 ToString(dest_format).c_str());
+
+	Measure("convert", variant, n_samples, [&]{
+		return convert.Convert(src).data();
+	});
+}
+
+static void
+BenchChannels(SampleFormat format,
+	      unsigned src_channels, unsigned dest_channels)
+{
+	const std::size_t n_samples = N_FRAMES * src_channels;
+	const auto src = MakeSamples(format, n_samples);
+
+	PcmChannelsConverter converter;
+	converter.Open(format, src_channels, dest_channels);
+
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s %u->%u",
+		 sample_format_to_string(format),
+		 src_channels, dest_channels);
+
+	Measure("channels", variant, n_samples, [&]{
+		return converter.Convert(src).data();
+	});
+
+	converter.Close();
+}
+
+static void
+BenchResampler(const char *name, PcmResampler &resampler,
+	       AudioFormat af, unsigned new_sample_rate)
+{
+	/* the resampler may choose a different sample format */
+	resampler.Open(af, new_sample_rate);
+
+	const std::size_t n_samples = N_FRAMES * af.channels;
+	const auto src = MakeSamples(af.format, n_samples);
+
+	char variant[48];
+	snprintf(variant, sizeof(variant), "%s %s %u->%u",
+		 name, sample_format_to_string(af.format),
+		 af.sample_rate, new_sample_rate);
+
+	Measure("resample", variant, n_samples, [&]{
+		return resampler.Resample(src).data();
+	});
+
+	resampler.Close();
+}
+
+static void
+BenchResampler(unsigned sample_rate, unsigned new_sample_rate)
+{
+	const AudioFormat af{sample_rate, SampleFormat::S16, 2};
+
+	FallbackPcmResampler fallback;
+	BenchResampler("fallback", fallback, af, new_sample_rate);
+
+	PolyphasePcmResampler polyphase;
+	BenchResampler("polyphase", polyphase, af, new_sample_rate);
+}
+
+static void
+BenchExport(const char *name, SampleFormat format, unsigned channels,
+	    PcmExport::Params params)
+{
+	const std::size_t n_samples = N_FRAMES * channels;
+	const auto src = MakeSamples(format, n_samples);
+
+	PcmExport e;
+	e.Open(format, channels, params);
+
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s %s %uch",
+		 name, sample_format_to_string(format), channels);
+
+	Measure("export", variant, n_samples, [&]{
+		return e.Export(src).data();
+	});
+}
+
+static void
+BenchExport()
+{
+	PcmExport::Params params;
+	params.pack24 = true;
+	BenchExport("pack24", SampleFormat::S24_P32, 2, params);
+
+	params = {};
+	params.shift8 = true;
+	BenchExport("shift8", SampleFormat::S24_P32, 2, params);
+
+	params = {};
+	params.reverse_endian = true;
+	BenchExport("reverse", SampleFormat::S16, 2, params);
+	BenchExport("reverse", SampleFormat::S32, 2, params);
+
+	params = {};
+	params.alsa_channel_order = true;
+	BenchExport("alsa_order", SampleFormat::S16, 6, params);
+	BenchExport("alsa_order", SampleFormat::FLOAT, 6, params);
+
+#ifdef ENABLE_DSD
+	params = {};
+	params.dsd_mode = PcmExport::DsdMode::DOP;
+	BenchExport("dop", SampleFormat::DSD, 2, params);
+
+	params.dsd_mode = PcmExport::DsdMode::U32;
+	BenchExport("dsd_u32", SampleFormat::DSD, 2, params);
+#endif
+}
+
+#ifdef ENABLE_DSD
+
+static void
+BenchDsd2Pcm(unsigned channels)
+{
+	/* one DSD "sample" is one byte (8 bits) per channel */
+	const std::size_t n_samples = N_FRAMES * channels;
+	const auto src = MakeSamples(SampleFormat::DSD, n_samples);
+	std::vector<float> dest(n_samples);
+
+	MultiDsd2Pcm dsd2pcm;
+
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%uch", channels);
+
+	Measure("dsd2pcm", variant, n_samples, [&]{
+		dsd2pcm.Translate(channels, N_FRAMES, src.data(),
+				  dest.data());
+		return dest.data();
+	});
+}
+
+#endif
+
+int
+main(int argc, char **argv)
+try {
+	int i = 1;
+	if (i < argc && StringIsEqual(argv[i], "--csv")) {
+		csv = true;
+		++i;
+	}
+
+	if (i < argc)
+		min_duration = std::chrono::duration<double>{strtod(argv[i++], nullptr)};
+
+	if (i < argc) {
+		fprintf(stderr, "Usage: BenchPcm [--csv] [SECONDS]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (csv)
+		printf("group,variant,simd,msamples_per_second\n");
+	else
+		printf("implementation: %s\n", ToString(PcmGetSimdLevel()));
+
+	for (const auto format : integer_and_float_formats)
+		BenchVolume(format, false);
+	BenchVolume(SampleFormat::S16, true);
+
+	for (const auto format : integer_and_float_formats) {
+		BenchMix(format, 0.3f);
+		BenchMix(format, -1.f);
+	}
+
+	for (const auto src_format : convert_formats)
+		for (const auto dest_format : convert_formats)
+			if (src_format != dest_format)
+				BenchConvert({44100, src_format, 2},
+					     {44100, dest_format, 2});
+
+	for (const auto format : convert_formats) {
+		BenchChannels(format, 1, 2);
+		BenchChannels(format, 2, 1);
+		BenchChannels(format, 6, 2);
+		BenchChannels(format, 2, 6);
+	}
+
+	BenchResampler(44100, 48000);
+	BenchResampler(48000, 44100);
+	BenchResampler(44100, 96000);
+	BenchResampler(96000, 44100);
+
+	BenchExport();
+
+#ifdef ENABLE_DSD
+	BenchDsd2Pcm(2);
+	BenchDsd2Pcm(6);
+#endif
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
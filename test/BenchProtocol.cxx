@@ -0,0 +1,691 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * This program connects many simulated clients to a running MPD and
+ * measures the latency of protocol commands and the throughput.
+ *
+ * Some clients just sit in "idle" (like most real clients do); the
+ * others send a random mix of "status", "playlistinfo", "search" and
+ * (if a song URI was specified) "addid"/"deleteid" at a configurable
+ * rate.  The latency of "idle" is the time between sending a queue
+ * edit and the idle client being woken up.
+ *
+ * Note that MPD accepts only 100 clients by default; increase
+ * "max_connections" in the server's configuration for large numbers.
+ *
+ */
+
+#include "config.h"
+#include "ShutdownHandler.hxx"
+#include "event/Loop.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/Resolver.hxx"
+#include "net/SocketError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/PrintException.hxx"
+#include "util/StringCompare.hxx"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using std::string_view_literals::operator""sv;
+
+enum class Command : uint_least8_t {
+	STATUS,
+	PLAYLISTINFO,
+	SEARCH,
+	ADDID,
+	DELETEID,
+	IDLE,
+};
+
+static constexpr std::size_t N_COMMANDS = std::size_t(Command::IDLE) + 1;
+
+static constexpr const char *command_names[N_COMMANDS] = {
+	"status",
+	"playlistinfo",
+	"search",
+	"addid",
+	"deleteid",
+	"idle",
+};
+
+using Clock = std::chrono::steady_clock;
+
+static unsigned n_clients = 100;
+static unsigned idle_percent = 20;
+static double rate = 1;
+static std::chrono::duration<double> duration{10};
+
+/**
+ * Relative weights of the commands sent by active clients.  A queue
+ * edit is an "addid" followed by a "deleteid".
+ */
+static unsigned weight_status = 70, weight_playlistinfo = 10,
+	weight_search = 10, weight_edit = 10;
+
+static std::string search_command = "search \"(any contains \\\"a\\\")\"\n";
+static std::string addid_command;
+
+static std::minstd_rand random_engine;
+
+struct CommandStats {
+	/**
+	 * Latencies in microseconds.
+	 */
+	std::vector<uint_least32_t> latencies;
+
+	unsigned errors = 0;
+
+	/**
+	 * Has an error message been printed already?
+	 */
+	bool reported = false;
+
+	void Add(Clock::duration d) noexcept {
+		latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+	}
+};
+
+static std::array<CommandStats, N_COMMANDS> stats;
+
+/**
+ * Are results being recorded?  This begins after all clients have
+ * connected.
+ */
+static bool recording = false;
+
+static unsigned n_connected = 0, n_failed = 0;
+
+/**
+ * The time the most recent queue edit was sent; used to measure
+ * the wakeup latency of idle clients.
+ */
+static Clock::time_point last_edit;
+
+static void OnClientReady(EventLoop &event_loop) noexcept;
+
+class LoadClient final : FullyBufferedSocket {
+	FineTimerEvent timer;
+
+	const bool idle;
+
+	bool greeted = false;
+
+	bool has_pending = false;
+	Command pending;
+	Clock::time_point start;
+
+	/**
+	 * The song id returned by the last "addid".
+	 */
+	int added_id = -1;
+
+public:
+	LoadClient(EventLoop &event_loop, SocketDescriptor fd,
+		   bool _idle) noexcept
+		:FullyBufferedSocket(fd, event_loop, 16384, 1024 * 1024),
+		 timer(event_loop, BIND_THIS_METHOD(OnTimer)),
+		 idle(_idle) {}
+
+	~LoadClient() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+private:
+	bool Send(Command command) noexcept;
+	void ScheduleNext() noexcept;
+	bool OnLine(std::string_view line) noexcept;
+	bool OnResponse(bool success) noexcept;
+	void Fail() noexcept;
+
+	void OnTimer() noexcept;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override;
+	void OnSocketError(std::exception_ptr ep) noexcept override;
+	void OnSocketClosed() noexcept override;
+};
+
+bool
+LoadClient::Send(Command command) noexcept
+{
+	std::string buffer;
+	std::string_view line;
+
+	switch (command) {
+	case Command::STATUS:
+		line = "status\n"sv;
+		break;
+
+	case Command::PLAYLISTINFO:
+		line = "playlistinfo\n"sv;
+		break;
+
+	case Command::SEARCH:
+		line = search_command;
+		break;
+
+	case Command::ADDID:
+		line = addid_command;
+		added_id = -1;
+		break;
+
+	case Command::DELETEID:
+		buffer = fmt::format("deleteid {}\n", added_id);
+		line = buffer;
+		break;
+
+	case Command::IDLE:
+		line = "idle\n"sv;
+		break;
+	}
+
+	has_pending = true;
+	pending = command;
+	start = Clock::now();
+
+	if (command == Command::ADDID || command == Command::DELETEID)
+		last_edit = start;
+
+	return Write(line.data(), line.size());
+}
+
+void
+LoadClient::ScheduleNext() noexcept
+{
+	std::exponential_distribution<double> d{rate};
+	timer.Schedule(std::chrono::duration_cast<Event::Duration>(std::chrono::duration<double>{d(random_engine)}));
+}
+
+void
+LoadClient::OnTimer() noexcept
+{
+	const unsigned total = weight_status + weight_playlistinfo +
+		weight_search + weight_edit;
+	unsigned r = std::uniform_int_distribution<unsigned>{0, total - 1}(random_engine);
+
+	Command command;
+	if (r < weight_status)
+		command = Command::STATUS;
+	else if ((r -= weight_status) < weight_playlistinfo)
+		command = Command::PLAYLISTINFO;
+	else if ((r -= weight_playlistinfo) < weight_search)
+		command = Command::SEARCH;
+	else
+		command = Command::ADDID;
+
+	Send(command);
+}
+
+bool
+LoadClient::OnResponse(bool success) noexcept
+{
+	const auto now = Clock::now();
+	auto &s = stats[std::size_t(pending)];
+	has_pending = false;
+
+	if (recording) {
+		if (!success)
+			++s.errors;
+		else if (pending != Command::IDLE)
+			s.Add(now - start);
+		else if (last_edit > start)
+			s.Add(now - last_edit);
+		else
+			/* woken up by something else */
+			s.Add(now - start);
+	}
+
+	if (idle)
+		return Send(Command::IDLE);
+
+	if (pending == Command::ADDID && success && added_id >= 0)
+		return Send(Command::DELETEID);
+
+	ScheduleNext();
+	return true;
+}
+
+bool
+LoadClient::OnLine(std::string_view line) noexcept
+{
+	if (!greeted) {
+		if (!line.starts_with("OK MPD "sv)) {
+			fmt::print(stderr, "Malformed greeting: {:?}\n", line);
+			Fail();
+			return false;
+		}
+
+		greeted = true;
+		++n_connected;
+		OnClientReady(GetEventLoop());
+
+		if (idle)
+			return Send(Command::IDLE);
+
+		ScheduleNext();
+		return true;
+	}
+
+	if (!has_pending) {
+		fmt::print(stderr, "Unexpected response: {:?}\n", line);
+		Fail();
+		return false;
+	}
+
+	if (line == "OK"sv)
+		return OnResponse(true);
+
+	if (line.starts_with("ACK "sv)) {
+		if (auto &s = stats[std::size_t(pending)]; !s.reported) {
+			s.reported = true;
+			fmt::print(stderr, "{}: {}\n",
+				   command_names[std::size_t(pending)], line);
+		}
+		return OnResponse(false);
+	}
+
+	if (pending == Command::ADDID) {
+		if (line.starts_with("Id: "sv))
+			added_id = atoi(std::string{line.substr(4)}.c_str());
+	}
+
+	return true;
+}
+
+BufferedSocket::InputResult
+LoadClient::OnSocketInput(std::span<std::byte> src) noexcept
+{
+	std::string_view s{reinterpret_cast<const char *>(src.data()), src.size()};
+	std::size_t consumed = 0;
+
+	while (true) {
+		const auto newline = s.find('\n');
+		if (newline == s.npos)
+			break;
+
+		const auto line = s.substr(0, newline);
+		s = s.substr(newline + 1);
+		consumed += newline + 1;
+
+		if (!OnLine(line))
+			return InputResult::CLOSED;
+	}
+
+	if (consumed == 0 && src.size() >= 4096)
+		/* an overlong response line (e.g. a huge tag value):
+		   skip it, it cannot be "OK" or "ACK" */
+		consumed = src.size();
+
+	ConsumeInput(consumed);
+	return InputResult::MORE;
+}
+
+void
+LoadClient::Fail() noexcept
+{
+	timer.Cancel();
+	Close();
+
+	if (!greeted) {
+		++n_failed;
+		OnClientReady(GetEventLoop());
+	} else if (--n_connected == 0 && recording)
+		GetEventLoop().Break();
+}
+
+void
+LoadClient::OnSocketError(std::exception_ptr ep) noexcept
+{
+	PrintException(ep);
+	Fail();
+}
+
+void
+LoadClient::OnSocketClosed() noexcept
+{
+	if (!greeted)
+		fmt::print(stderr, "Connection failed\n");
+	else
+		fmt::print(stderr, "Connection closed by server\n");
+	Fail();
+}
+
+static UniqueSocketDescriptor
+Connect(const AllocatedSocketAddress &local_address,
+	const AddressInfo *address)
+{
+	UniqueSocketDescriptor fd;
+
+	if (address != nullptr) {
+		if (!fd.CreateNonBlock(address->GetFamily(), address->GetType(),
+				       address->GetProtocol()))
+			throw MakeSocketError("Failed to create socket");
+
+		if (!fd.Connect(*address) &&
+		    !IsSocketErrorConnectWouldBlock(GetSocketError()))
+			throw MakeSocketError("Failed to connect");
+	} else {
+#ifdef HAVE_UN
+		if (!fd.CreateNonBlock(AF_LOCAL, SOCK_STREAM, 0))
+			throw MakeSocketError("Failed to create socket");
+
+		if (!fd.Connect(local_address) &&
+		    !IsSocketErrorConnectWouldBlock(GetSocketError()))
+			throw MakeSocketError("Failed to connect");
+#else
+		(void)local_address;
+#endif
+	}
+
+	return fd;
+}
+
+/**
+ * The maximum number of connections being established at a time;
+ * more would overflow the server's listen() backlog.
+ */
+static constexpr unsigned MAX_CONNECTING = 64;
+
+static const AllocatedSocketAddress *server_local_address;
+static const AddressInfo *server_address;
+
+static std::vector<std::unique_ptr<LoadClient>> clients;
+static unsigned n_idle;
+
+/**
+ * Create more clients, up to #n_clients, while keeping no more
+ * than #MAX_CONNECTING connections pending.
+ */
+static void
+ConnectMore(EventLoop &event_loop) noexcept
+{
+	while (clients.size() < n_clients &&
+	       clients.size() - n_connected - n_failed < MAX_CONNECTING) {
+		const bool idle = clients.size() < n_idle;
+
+		try {
+			auto fd = Connect(*server_local_address, server_address);
+			clients.emplace_back(std::make_unique<LoadClient>(event_loop,
+									  fd.Release(),
+									  idle));
+		} catch (...) {
+			PrintException(std::current_exception());
+			clients.emplace_back();
+			++n_failed;
+		}
+	}
+}
+
+static FineTimerEvent *stop_timer;
+static Clock::time_point recording_start, recording_end;
+
+/**
+ * Called when a client has received the greeting or has failed to
+ * connect; starts recording after all clients are ready.
+ */
+static void
+OnClientReady(EventLoop &event_loop) noexcept
+{
+	ConnectMore(event_loop);
+
+	if (recording || n_connected + n_failed < n_clients)
+		return;
+
+	if (n_connected == 0) {
+		event_loop.Break();
+		return;
+	}
+
+	fmt::print(stderr, "{} clients connected, {} failed; recording for {} s\n",
+		   n_connected, n_failed, duration.count());
+
+	recording = true;
+	recording_start = Clock::now();
+	stop_timer->Schedule(std::chrono::duration_cast<Event::Duration>(duration));
+}
+
+static double
+Percentile(const std::vector<uint_least32_t> &sorted, unsigned p) noexcept
+{
+	if (sorted.empty())
+		return 0;
+
+	const std::size_t i = std::min(sorted.size() * p / 100,
+				       sorted.size() - 1);
+	return sorted[i] / 1000.;
+}
+
+static void
+PrintReport() noexcept
+{
+	const std::chrono::duration<double> elapsed = recording_end - recording_start;
+
+	fmt::print("{:<14} {:>9} {:>7} {:>10} {:>9} {:>9} {:>9} {:>9}\n",
+		   "command", "count", "errors", "per second",
+		   "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+	std::size_t total = 0;
+
+	for (std::size_t i = 0; i < N_COMMANDS; ++i) {
+		auto &s = stats[i];
+		if (s.latencies.empty() && s.errors == 0)
+			continue;
+
+		std::sort(s.latencies.begin(), s.latencies.end());
+
+		const std::size_t count = s.latencies.size() + s.errors;
+		total += count;
+
+		fmt::print("{:<14} {:>9} {:>7} {:>10.1f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}\n",
+			   command_names[i], count, s.errors,
+			   count / elapsed.count(),
+			   Percentile(s.latencies, 50),
+			   Percentile(s.latencies, 90),
+			   Percentile(s.latencies, 99),
+			   Percentile(s.latencies, 100));
+	}
+
+	fmt::print("{:<14} {:>9} {:>7} {:>10.1f}\n",
+		   "total", total, "", total / elapsed.count());
+}
+
+static unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const auto value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0)
+		throw std::invalid_argument("Not a number");
+
+	return value;
+}
+
+static double
+ParsePositiveDouble(const char *s)
+{
+	char *endptr;
+	const auto value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || !(value > 0))
+		throw std::invalid_argument("Not a positive number");
+
+	return value;
+}
+
+static void
+ParseMix(std::string_view s)
+{
+	weight_status = weight_playlistinfo = weight_search = weight_edit = 0;
+
+	for (const std::string_view i : IterableSplitString(s, ',')) {
+		const auto colon = i.find(':');
+		if (colon == i.npos)
+			throw std::invalid_argument("Malformed mix");
+
+		const auto name = i.substr(0, colon);
+		const unsigned weight =
+			ParseUnsigned(std::string{i.substr(colon + 1)}.c_str());
+
+		if (name == "status"sv)
+			weight_status = weight;
+		else if (name == "playlistinfo"sv)
+			weight_playlistinfo = weight;
+		else if (name == "search"sv)
+			weight_search = weight;
+		else if (name == "edit"sv)
+			weight_edit = weight;
+		else
+			throw std::invalid_argument("Unknown command in mix");
+	}
+}
+
+/**
+ * Quote a string for the MPD protocol.
+ */
+static std::string
+Quote(std::string_view s) noexcept
+{
+	std::string result;
+	result.push_back('"');
+	for (const char ch : s) {
+		if (ch == '"' || ch == '\\')
+			result.push_back('\\');
+		result.push_back(ch);
+	}
+	result.push_back('"');
+	return result;
+}
+
+#ifndef _WIN32
+
+/**
+ * Each client needs a file descriptor; raise the soft limit as far
+ * as allowed.
+ */
+static void
+RaiseFileLimit() noexcept
+{
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+	    limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+#endif
+
+int
+main(int argc, char **argv)
+try {
+	const char *server = nullptr;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *value;
+
+		if ((value = StringAfterPrefix(arg, "--clients=")))
+			n_clients = ParseUnsigned(value);
+		else if ((value = StringAfterPrefix(arg, "--idle=")))
+			idle_percent = std::min(ParseUnsigned(value), 100U);
+		else if ((value = StringAfterPrefix(arg, "--rate=")))
+			rate = ParsePositiveDouble(value);
+		else if ((value = StringAfterPrefix(arg, "--duration=")))
+			duration = std::chrono::duration<double>{ParsePositiveDouble(value)};
+		else if ((value = StringAfterPrefix(arg, "--mix=")))
+			ParseMix(value);
+		else if ((value = StringAfterPrefix(arg, "--search=")))
+			search_command = "search " + Quote(value) + "\n";
+		else if ((value = StringAfterPrefix(arg, "--uri=")))
+			addid_command = "addid " + Quote(value) + "\n";
+		else if (*arg != '-' && server == nullptr)
+			server = arg;
+		else {
+			fmt::print(stderr, "Usage: BenchProtocol [--clients=N] [--idle=PERCENT] [--rate=PER_SECOND] [--duration=SECONDS] [--mix=status:N,playlistinfo:N,search:N,edit:N] [--search=EXPRESSION] [--uri=SONG] HOST[:PORT]|SOCKET\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (server == nullptr)
+		server = "localhost";
+
+	if (addid_command.empty())
+		/* queue edits need a song to add */
+		weight_edit = 0;
+
+	if (n_clients == 0 ||
+	    weight_status + weight_playlistinfo + weight_search + weight_edit == 0)
+		throw std::invalid_argument("Nothing to do");
+
+#ifndef _WIN32
+	RaiseFileLimit();
+#endif
+
+	AllocatedSocketAddress local_address;
+	AddressInfoList address_list;
+	const AddressInfo *address = nullptr;
+
+#ifdef HAVE_UN
+	if (*server == '/' || *server == '@')
+		local_address.SetLocal(server);
+	else
+#endif
+	{
+		address_list = Resolve(server, 6600, AI_ADDRCONFIG, SOCK_STREAM);
+		address = &address_list.GetBest();
+	}
+
+	EventLoop event_loop;
+	const ShutdownHandler shutdown_handler(event_loop);
+
+	FineTimerEvent stop_timer_event{event_loop, BIND_METHOD(event_loop, &EventLoop::Break)};
+	stop_timer = &stop_timer_event;
+
+	n_idle = n_clients * idle_percent / 100;
+	server_local_address = &local_address;
+	server_address = address;
+
+	clients.reserve(n_clients);
+	ConnectMore(event_loop);
+	if (n_connected + n_failed == n_clients)
+		/* all have failed synchronously */
+		OnClientReady(event_loop);
+
+	event_loop.Run();
+
+	recording_end = Clock::now();
+	clients.clear();
+
+	if (!recording)
+		throw std::runtime_error(fmt::format("Not all clients have connected ({} connected, {} failed)", n_connected, n_failed));
+
+	fmt::print("{} clients: {} idle, {} active sending {} commands/s each\n",
+		   n_clients, n_idle, n_clients - n_idle, rate);
+	PrintReport();
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -57,6 +57,10 @@ public:
 	void OnDatabaseSongRemoved(const char *uri) noexcept override {
 		fmt::print("SongRemoved {:?}\n", uri);
 	}
+
+	bool IsPlaybackStarving() const noexcept override {
+		return false;
+	}
 };
 
 static void
@@ -23,6 +23,17 @@ public:
 		return initialized;
 	}
 
+protected:
+	/**
+	 * For derived classes which override Ready() without calling
+	 * this class's implementation.
+	 */
+	void SetInitialized() noexcept {
+		initialized = true;
+	}
+
+public:
+
 	/* virtual methods from DecoderClient */
 	void Ready(AudioFormat audio_format,
 		   bool seekable, SignedSongTime duration) noexcept override;
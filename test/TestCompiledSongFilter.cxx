@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Type.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+class CompiledSongFilterTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		IcuInit();
+	}
+
+	void TearDown() override {
+		IcuFinish();
+	}
+};
+
+static SongFilter
+ParseFilter(const char *expression, bool optimize)
+{
+	const std::array<const char *, 1> args{expression};
+
+	SongFilter filter;
+	filter.Parse(args);
+	if (optimize)
+		filter.Optimize();
+	return filter;
+}
+
+/**
+ * Verify that the compiled program (created by
+ * SongFilter::Optimize()) yields the same results as the
+ * #ISongFilter tree.
+ */
+TEST_F(CompiledSongFilterTest, SameAsTree)
+{
+	static constexpr const char *expressions[] = {
+		"(Artist == \"foo\")",
+		"(Artist != \"foo\")",
+		"(Artist == \"\")",
+		"(Artist != \"\")",
+		"(AlbumArtist == \"foo\")",
+		"(AlbumArtist != \"foo\")",
+		"(AlbumArtist == \"\")",
+		"(AlbumArtistSort == \"foo\")",
+		"(AlbumArtistSort starts_with \"fo\")",
+		"(any == \"foo\")",
+		"(any contains \"ar\")",
+		"(Title contains \"a\")",
+		"(!(Title contains \"a\"))",
+		"((Artist == \"foo\") AND (Title == \"bar\"))",
+		"((Artist == \"foo\") AND (Album == \"\"))",
+		"((AlbumArtist starts_with \"b\") AND (!(Artist == \"bar\")))",
+		"((file == \"dummy\") AND (AlbumArtist == \"foo\"))",
+		"((file != \"dummy\") AND (AlbumArtist == \"foo\"))",
+	};
+
+	const Tag tags[] = {
+		MakeTag(),
+		MakeTag(TAG_ARTIST, "foo"),
+		MakeTag(TAG_ARTIST, "bar"),
+		MakeTag(TAG_ARTIST, "bar", TAG_ARTIST, "foo"),
+		MakeTag(TAG_ALBUM_ARTIST, "foo"),
+		MakeTag(TAG_ALBUM_ARTIST, "bar", TAG_ARTIST, "foo"),
+		MakeTag(TAG_ARTIST_SORT, "foo", TAG_ARTIST, "bar"),
+		MakeTag(TAG_ARTIST, "foo", TAG_TITLE, "bar"),
+		MakeTag(TAG_TITLE, "bar", TAG_ALBUM, "foo"),
+	};
+
+	for (const char *expression : expressions) {
+		const auto tree = ParseFilter(expression, false);
+		const auto compiled = ParseFilter(expression, true);
+
+		for (const Tag &tag : tags) {
+			const LightSong song{"dummy", tag};
+			EXPECT_EQ(tree.Match(song), compiled.Match(song))
+				<< expression;
+		}
+	}
+}
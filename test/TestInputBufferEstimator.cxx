@@ -0,0 +1,74 @@
+/*
+ * Unit tests for class InputBufferEstimator.
+ */
+
+#include "input/BufferEstimator.hxx"
+
+#include <gtest/gtest.h>
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using Clock = std::chrono::steady_clock;
+
+TEST(InputBufferEstimator, Empty)
+{
+	const auto t = Clock::now();
+	InputBufferEstimator e{t};
+
+	EXPECT_EQ(e.GetTargetSize(), 0U);
+
+	/* no stall: nothing to compensate */
+	e.OnConsumed(100000, t + seconds{1});
+	EXPECT_EQ(e.GetTargetSize(), 0U);
+}
+
+TEST(InputBufferEstimator, Stall)
+{
+	auto t = Clock::now();
+	InputBufferEstimator e{t};
+
+	/* 100 kB/s */
+	t += seconds{1};
+	e.OnConsumed(100000, t);
+
+	/* a stall of 2 seconds */
+	e.OnStallBegin(t);
+	EXPECT_TRUE(e.IsStalled());
+	t += seconds{2};
+	e.OnStallEnd(t);
+	EXPECT_FALSE(e.IsStalled());
+
+	/* the buffer should bridge twice the stall */
+	EXPECT_EQ(e.GetTargetSize(), 400000U);
+
+	/* a shorter stall doesn't lower the estimate */
+	e.OnStallBegin(t);
+	t += milliseconds{500};
+	e.OnStallEnd(t);
+	EXPECT_EQ(e.GetTargetSize(), 400000U);
+}
+
+TEST(InputBufferEstimator, Decay)
+{
+	auto t = Clock::now();
+	InputBufferEstimator e{t};
+
+	t += seconds{1};
+	e.OnConsumed(100000, t);
+
+	e.OnStallBegin(t);
+	t += seconds{2};
+	e.OnStallEnd(t);
+
+	const auto initial = e.GetTargetSize();
+
+	/* the waiting time does not count towards the rate, and
+	   the stall estimate decays with each window */
+	for (unsigned i = 0; i < 16; ++i) {
+		t += seconds{1};
+		e.OnConsumed(100000, t);
+	}
+
+	EXPECT_LT(e.GetTargetSize(), initial / 4);
+	EXPECT_GT(e.GetTargetSize(), 0U);
+}
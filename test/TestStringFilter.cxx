@@ -7,6 +7,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 class StringFilterTest : public ::testing::Test {
 protected:
 	void SetUp() override {
@@ -161,3 +163,40 @@ TEST_F(StringFilterTest, FoldCase)
 	EXPECT_FALSE(f.Match("foo"));
 	EXPECT_FALSE(f.Match("FOOnëedleBAR"));
 }
+
+#ifdef HAVE_ICU
+
+TEST_F(StringFilterTest, FoldCaseASCII)
+{
+	const StringFilter full{"Needle", true, StringFilter::Position::FULL, false};
+	EXPECT_TRUE(full.Match("needle"));
+	EXPECT_TRUE(full.Match("NEEDLE"));
+	EXPECT_TRUE(full.Match("nEeDlE"));
+	EXPECT_FALSE(full.Match("needles"));
+	EXPECT_FALSE(full.Match("nëedle"));
+	EXPECT_FALSE(full.Match(""));
+
+	const StringFilter prefix{"NEEDLE", true, StringFilter::Position::PREFIX, false};
+	EXPECT_TRUE(prefix.Match("needle"));
+	EXPECT_TRUE(prefix.Match("NeedleBAR"));
+	EXPECT_FALSE(prefix.Match("FOOneedle"));
+	EXPECT_FALSE(prefix.Match("needl"));
+
+	const StringFilter anywhere{"needle", true, StringFilter::Position::ANYWHERE, false};
+	EXPECT_TRUE(anywhere.Match("FOONEEDLEBAR"));
+	EXPECT_TRUE(anywhere.Match("fooNeedle"));
+	EXPECT_FALSE(anywhere.Match("FOONEEDBAR"));
+
+	/* longer than the fast path's buffer */
+	std::string long_haystack(1000, 'x');
+	long_haystack += "NEEDLE";
+	EXPECT_TRUE(anywhere.Match(long_haystack.c_str()));
+	EXPECT_FALSE(prefix.Match(long_haystack.c_str()));
+
+	/* non-ASCII needle can't match an ASCII haystack */
+	const StringFilter latin{"nëedle", true, StringFilter::Position::ANYWHERE, false};
+	EXPECT_FALSE(latin.Match("NEEDLE"));
+	EXPECT_TRUE(latin.Match("NËEDLE"));
+}
+
+#endif
@@ -191,3 +191,25 @@ TEST_F(TagSongFilterTest, NegatedFallback)
 	EXPECT_FALSE(InvokeFilter(f, MakeTag(TAG_ARTIST, "needle")));
 	EXPECT_TRUE(InvokeFilter(f, MakeTag(TAG_ARTIST, "needle", TAG_ALBUM_ARTIST, "foo")));
 }
+
+/**
+ * Case folding; the second round uses the folded values cached in
+ * the tag pool.
+ */
+TEST_F(TagSongFilterTest, FoldCase)
+{
+	const TagSongFilter f{
+		TAG_TITLE,
+		{"needle", true, StringFilter::Position::ANYWHERE, false},
+	};
+
+	const Tag a = MakeTag(TAG_TITLE, "FOONEEDLEBAR");
+	const Tag b = MakeTag(TAG_TITLE, "foo", TAG_TITLE, "Needle");
+	const Tag c = MakeTag(TAG_TITLE, "NEDLE");
+
+	for (unsigned i = 0; i < 2; ++i) {
+		EXPECT_TRUE(InvokeFilter(f, a));
+		EXPECT_TRUE(InvokeFilter(f, b));
+		EXPECT_FALSE(InvokeFilter(f, c));
+	}
+}
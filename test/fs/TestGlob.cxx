@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "fs/Glob.hxx"
+#include "fs/GlobSet.hxx"
 
 #include <gtest/gtest.h>
 
@@ -76,4 +77,73 @@ TEST(Glob, SuffixWildcard)
 	EXPECT_TRUE(glob.Check("foo"));
 }
 
+TEST(GlobSet, Empty)
+{
+	const GlobSet set;
+	EXPECT_TRUE(set.IsEmpty());
+	EXPECT_FALSE(set.Check("foo"));
+	EXPECT_FALSE(set.Check(""));
+}
+
+TEST(GlobSet, Basic)
+{
+	GlobSet set;
+	set.Add("foo");
+	set.Add("*.jpg");
+	set.Add("*.jpeg");
+	set.Add("cover*");
+	set.Add("a?c");
+	set.Add("x*y");
+	EXPECT_FALSE(set.IsEmpty());
+
+	EXPECT_TRUE(set.Check("foo"));
+	EXPECT_FALSE(set.Check("fooo"));
+	EXPECT_FALSE(set.Check("_foo"));
+
+	EXPECT_TRUE(set.Check("a.jpg"));
+	EXPECT_TRUE(set.Check(".jpg"));
+	EXPECT_TRUE(set.Check("b.jpeg"));
+	EXPECT_FALSE(set.Check("jpg"));
+	EXPECT_FALSE(set.Check("a.jpg_"));
+
+	EXPECT_TRUE(set.Check("cover"));
+	EXPECT_TRUE(set.Check("cover.png"));
+	EXPECT_FALSE(set.Check("cove"));
+	EXPECT_FALSE(set.Check("_cover"));
+
+	EXPECT_TRUE(set.Check("abc"));
+	EXPECT_FALSE(set.Check("abbc"));
+
+	EXPECT_TRUE(set.Check("xy"));
+	EXPECT_TRUE(set.Check("x_y"));
+	EXPECT_FALSE(set.Check("x_y_"));
+
+	EXPECT_FALSE(set.Check(""));
+	EXPECT_FALSE(set.Check("bar"));
+}
+
+TEST(GlobSet, Asterisk)
+{
+	GlobSet set;
+	set.Add("foo");
+	set.Add("*");
+	EXPECT_TRUE(set.Check("foo"));
+	EXPECT_TRUE(set.Check("bar"));
+	EXPECT_TRUE(set.Check(""));
+}
+
+TEST(GlobSet, Copy)
+{
+	GlobSet parent;
+	parent.Add("*.jpg");
+
+	GlobSet child{parent};
+	child.Add("foo*bar");
+
+	EXPECT_TRUE(child.Check("a.jpg"));
+	EXPECT_TRUE(child.Check("foo_bar"));
+	EXPECT_TRUE(parent.Check("a.jpg"));
+	EXPECT_FALSE(parent.Check("foo_bar"));
+}
+
 #endif
@@ -15,16 +15,64 @@
 #include "cmdline/OptionDef.hxx"
 #include "cmdline/OptionParser.hxx"
 #include "util/PrintException.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringBuffer.hxx"
+#include "util/UriExtract.hxx"
 #include "Log.hxx"
 #include "LogBackend.hxx"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
+#include <time.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+
+/* count all heap allocations (including those made by codec
+   libraries) for the benchmark; glibc allows replacing malloc() by
+   forwarding to these internal symbols */
+
+#define HAVE_ALLOCATION_COUNTER
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+static std::atomic<uint_least64_t> n_allocations;
+
+extern "C" void *
+malloc(size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+extern "C" void *
+calloc(size_t n, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+extern "C" void *
+realloc(void *p, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+
+#endif
+
 struct CommandLine {
 	const char *decoder = nullptr;
 	const char *uri = nullptr;
@@ -33,6 +81,10 @@ struct CommandLine {
 
 	bool verbose = false;
 
+	bool benchmark = false;
+
+	unsigned n_seeks = 0;
+
 	SongTime seek_where{};
 };
 
@@ -40,12 +92,16 @@ enum Option {
 	OPTION_CONFIG,
 	OPTION_VERBOSE,
 	OPTION_SEEK,
+	OPTION_BENCHMARK,
+	OPTION_SEEKS,
 };
 
 static constexpr OptionDef option_defs[] = {
 	{"config", 0, true, "Load a MPD configuration file"},
 	{"verbose", 'v', false, "Verbose logging"},
 	{"seek", 0, true, "Seek to this position"},
+	{"benchmark", 0, false, "Decode to nowhere and report the speed (DECODER may be \"all\")"},
+	{"seeks", 0, true, "Benchmark: measure the latency of this many seeks"},
 };
 
 static CommandLine
@@ -67,12 +123,20 @@ ParseCommandLine(int argc, char **argv)
 		case OPTION_SEEK:
 			c.seek_where = SongTime::FromS(strtod(o.value, nullptr));
 			break;
+
+		case OPTION_BENCHMARK:
+			c.benchmark = true;
+			break;
+
+		case OPTION_SEEKS:
+			c.n_seeks = strtoul(o.value, nullptr, 10);
+			break;
 		}
 	}
 
 	auto args = option_parser.GetRemaining();
 	if (args.size() != 2)
-		throw std::runtime_error("Usage: run_decoder [--verbose] [--config=FILE] DECODER URI");
+		throw std::runtime_error("Usage: run_decoder [--verbose] [--config=FILE] [--benchmark [--seeks=N]] DECODER URI");
 
 	c.decoder = args[0];
 	c.uri = args[1];
@@ -172,6 +236,301 @@ public:
 	}
 };
 
+/**
+ * Decode the URI with the given plugin.
+ *
+ * @return false if the plugin is not usable for this URI
+ */
+static bool
+Decode(const DecoderPlugin &plugin, DumpDecoderClient &client,
+       const char *uri)
+{
+	if (plugin.SupportsUri(uri)) {
+		try {
+			plugin.UriDecode(client, uri);
+		} catch (StopDecoder) {
+		}
+	} else if (plugin.file_decode != nullptr) {
+		try {
+			plugin.FileDecode(client, FromNarrowPath(uri));
+		} catch (StopDecoder) {
+		}
+	} else if (plugin.stream_decode != nullptr) {
+		auto is = InputStream::OpenReady(uri, client.mutex);
+		try {
+			plugin.StreamDecode(client, *is);
+		} catch (StopDecoder) {
+		}
+	} else
+		return false;
+
+	return true;
+}
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * The I/O counters of this process from /proc/self/io (Linux only).
+ */
+struct IoCounters {
+	uint_least64_t read_bytes = 0, read_syscalls = 0;
+
+	bool valid = false;
+
+	static IoCounters Now() noexcept {
+		IoCounters c;
+
+		FILE *file = fopen("/proc/self/io", "r");
+		if (file == nullptr)
+			return c;
+
+		char name[64];
+		unsigned long long value;
+		while (fscanf(file, "%63s %llu", name, &value) == 2) {
+			if (StringIsEqual(name, "rchar:"))
+				c.read_bytes = value;
+			else if (StringIsEqual(name, "syscr:"))
+				c.read_syscalls = value;
+		}
+
+		fclose(file);
+		c.valid = true;
+		return c;
+	}
+};
+
+static std::chrono::duration<double>
+GetProcessCpuTime() noexcept
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) < 0)
+		return {};
+
+	return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+/**
+ * A #DecoderClient which discards the decoded data and collects
+ * statistics.  If seek positions are given, it seeks to each of them
+ * and measures the time until the first chunk of audio data arrives.
+ */
+class BenchDecoderClient final : public DumpDecoderClient {
+	AudioFormat audio_format;
+	SignedSongTime duration;
+	bool seekable;
+
+	/**
+	 * The positions to seek to, see SetSeeks().
+	 */
+	std::vector<SongTime> seeks;
+	std::size_t next_seek = 0;
+
+	bool seeking = false, awaiting_audio = false;
+	Clock::time_point seek_start;
+
+public:
+	uint_least64_t n_frames = 0;
+	uint_least64_t n_read_calls = 0, n_read_bytes = 0;
+
+	std::vector<Clock::duration> seek_latencies;
+	unsigned n_seek_errors = 0;
+
+	const AudioFormat &GetAudioFormat() const noexcept {
+		return audio_format;
+	}
+
+	SignedSongTime GetDuration() const noexcept {
+		return duration;
+	}
+
+	bool IsSeekable() const noexcept {
+		return seekable;
+	}
+
+	void SetSeeks(std::vector<SongTime> &&_seeks) noexcept {
+		seeks = std::move(_seeks);
+	}
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat _audio_format,
+		   bool _seekable, SignedSongTime _duration) noexcept override {
+		assert(!IsInitialized());
+
+		/* don't call DumpDecoderClient::Ready(), it prints */
+		audio_format = _audio_format;
+		seekable = _seekable;
+		duration = _duration;
+		DumpDecoderClient::SetInitialized();
+	}
+
+	DecoderCommand GetCommand() noexcept override {
+		if (seeks.empty() || awaiting_audio)
+			return DecoderCommand::NONE;
+
+		if (seeking)
+			return DecoderCommand::SEEK;
+
+		if (next_seek >= seeks.size())
+			return DecoderCommand::STOP;
+
+		seeking = true;
+		seek_start = Clock::now();
+		return DecoderCommand::SEEK;
+	}
+
+	void CommandFinished() noexcept override {
+		if (seeking) {
+			seeking = false;
+			++next_seek;
+			awaiting_audio = true;
+		}
+	}
+
+	SongTime GetSeekTime() noexcept override {
+		assert(seeking);
+
+		return seeks[next_seek];
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return GetSeekTime().ToScale<uint64_t>(audio_format.sample_rate);
+	}
+
+	void SeekError() noexcept override {
+		assert(seeking);
+
+		seeking = false;
+		++next_seek;
+		++n_seek_errors;
+	}
+
+	size_t Read(InputStream &is,
+		    std::span<std::byte> dest) noexcept override {
+		const std::size_t nbytes = DumpDecoderClient::Read(is, dest);
+		++n_read_calls;
+		n_read_bytes += nbytes;
+		return nbytes;
+	}
+
+	DecoderCommand SubmitAudio(InputStream *,
+				   std::span<const std::byte> audio,
+				   uint16_t) noexcept override {
+		n_frames += audio.size() / audio_format.GetFrameSize();
+
+		if (awaiting_audio) {
+			awaiting_audio = false;
+			seek_latencies.push_back(Clock::now() - seek_start);
+		}
+
+		return GetCommand();
+	}
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) noexcept override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *) noexcept override {}
+	void SubmitMixRamp(MixRampInfo &&) noexcept override {}
+};
+
+static double
+Percentile(std::vector<Clock::duration> &v, unsigned p) noexcept
+{
+	assert(!v.empty());
+
+	std::sort(v.begin(), v.end());
+	const std::size_t i = std::min(v.size() * p / 100, v.size() - 1);
+	return std::chrono::duration<double, std::milli>(v[i]).count();
+}
+
+static void
+Benchmark(const DecoderPlugin &plugin, const char *uri, unsigned n_seeks)
+{
+	printf("%s:\n", plugin.name);
+
+	BenchDecoderClient client;
+
+	const auto io_before = IoCounters::Now();
+#ifdef HAVE_ALLOCATION_COUNTER
+	const auto allocations_before = n_allocations.load();
+#endif
+	const auto cpu_before = GetProcessCpuTime();
+	const auto start = Clock::now();
+
+	if (!Decode(plugin, client, uri)) {
+		printf("  not usable\n");
+		return;
+	}
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	const auto cpu = GetProcessCpuTime() - cpu_before;
+#ifdef HAVE_ALLOCATION_COUNTER
+	const auto allocations = n_allocations.load() - allocations_before;
+#endif
+	const auto io_after = IoCounters::Now();
+
+	if (!client.IsInitialized()) {
+		printf("  unrecognized file\n");
+		return;
+	}
+
+	const auto &af = client.GetAudioFormat();
+	const double decoded_s = double(client.n_frames) / af.sample_rate;
+
+	printf("  audio_format=%s duration=%.3f s seekable=%d\n",
+	       ToString(af).c_str(),
+	       client.GetDuration().ToDoubleS(),
+	       client.IsSeekable());
+	printf("  decoded %.3f s in %.3f s (%.1fx real time), CPU %.3f s\n",
+	       decoded_s, elapsed.count(),
+	       elapsed.count() > 0 ? decoded_s / elapsed.count() : 0.,
+	       cpu.count());
+
+	if (client.n_read_calls > 0)
+		printf("  InputStream: %llu bytes in %llu Read() calls\n",
+		       (unsigned long long)client.n_read_bytes,
+		       (unsigned long long)client.n_read_calls);
+
+	if (io_before.valid && io_after.valid)
+		printf("  process: %llu bytes in %llu read syscalls\n",
+		       (unsigned long long)(io_after.read_bytes - io_before.read_bytes),
+		       (unsigned long long)(io_after.read_syscalls - io_before.read_syscalls));
+
+#ifdef HAVE_ALLOCATION_COUNTER
+	printf("  allocations: %llu\n", (unsigned long long)allocations);
+#endif
+
+	if (n_seeks == 0)
+		return;
+
+	if (!client.IsSeekable() || client.GetDuration().IsNegative()) {
+		printf("  seek: not seekable\n");
+		return;
+	}
+
+	/* stay away from the end, where some decoders would finish
+	   before the first chunk */
+	std::minstd_rand engine;
+	std::uniform_int_distribution<SongTime::rep> distribution{0, SongTime{client.GetDuration()}.count() * 9 / 10};
+	std::vector<SongTime> seeks;
+	for (unsigned i = 0; i < n_seeks; ++i)
+		seeks.emplace_back(SongTime{distribution(engine)});
+
+	BenchDecoderClient seek_client;
+	seek_client.SetSeeks(std::move(seeks));
+	Decode(plugin, seek_client, uri);
+
+	auto &l = seek_client.seek_latencies;
+	if (l.empty()) {
+		printf("  seek: %u errors\n", seek_client.n_seek_errors);
+		return;
+	}
+
+	printf("  seek (%zu): p50 %.3f ms, p90 %.3f ms, max %.3f ms, %u errors\n",
+	       l.size(), Percentile(l, 50), Percentile(l, 90),
+	       Percentile(l, 100), seek_client.n_seek_errors);
+}
+
 int main(int argc, char **argv)
 try {
 	const auto c = ParseCommandLine(argc, argv);
@@ -179,30 +538,30 @@ try {
 	SetLogThreshold(c.verbose ? LogLevel::DEBUG : LogLevel::INFO);
 	const GlobalInit init(c.config_path);
 
+	if (c.benchmark && StringIsEqual(c.decoder, "all")) {
+		const auto suffix = uri_get_suffix(c.uri);
+
+		for (const auto &plugin : GetEnabledDecoderPlugins())
+			if (plugin.SupportsUri(c.uri) ||
+			    (!suffix.empty() && plugin.SupportsSuffix(suffix)))
+				Benchmark(plugin, c.uri, c.n_seeks);
+
+		return EXIT_SUCCESS;
+	}
+
 	const DecoderPlugin *plugin = decoder_plugin_from_name(c.decoder);
 	if (plugin == nullptr) {
 		fprintf(stderr, "No such decoder: %s\n", c.decoder);
 		return EXIT_FAILURE;
 	}
 
+	if (c.benchmark) {
+		Benchmark(*plugin, c.uri, c.n_seeks);
+		return EXIT_SUCCESS;
+	}
+
 	MyDecoderClient client(c.seek_where);
-	if (plugin->SupportsUri(c.uri)) {
-		try {
-			plugin->UriDecode(client, c.uri);
-		} catch (StopDecoder) {
-		}
-	} else if (plugin->file_decode != nullptr) {
-		try {
-			plugin->FileDecode(client, FromNarrowPath(c.uri));
-		} catch (StopDecoder) {
-		}
-	} else if (plugin->stream_decode != nullptr) {
-		auto is = InputStream::OpenReady(c.uri, client.mutex);
-		try {
-			plugin->StreamDecode(client, *is);
-		} catch (StopDecoder) {
-		}
-	} else {
+	if (!Decode(*plugin, client, c.uri)) {
 		fprintf(stderr, "Decoder plugin is not usable\n");
 		return EXIT_FAILURE;
 	}
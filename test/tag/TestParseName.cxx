@@ -0,0 +1,44 @@
+/*
+ * Unit tests for the tag name parser and its perfect hash table
+ */
+
+#include "tag/ParseName.hxx"
+#include "tag/Names.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(ParseName, AllNames)
+{
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		const char *name = tag_item_names[i];
+		EXPECT_EQ(tag_name_parse(name), TagType(i));
+		EXPECT_EQ(tag_name_parse(std::string_view{name}), TagType(i));
+		EXPECT_EQ(tag_name_parse_i(name), TagType(i));
+		EXPECT_EQ(tag_name_parse_i(std::string_view{name}), TagType(i));
+	}
+}
+
+TEST(ParseName, Case)
+{
+	EXPECT_EQ(tag_name_parse("artist"), TAG_NUM_OF_ITEM_TYPES);
+	EXPECT_EQ(tag_name_parse_i("artist"), TAG_ARTIST);
+	EXPECT_EQ(tag_name_parse_i("ALBUMARTIST"), TAG_ALBUM_ARTIST);
+	EXPECT_EQ(tag_name_parse_i("MusicBrainz_TrackId"),
+		  TAG_MUSICBRAINZ_TRACKID);
+}
+
+TEST(ParseName, Unknown)
+{
+	EXPECT_EQ(tag_name_parse(""), TAG_NUM_OF_ITEM_TYPES);
+	EXPECT_EQ(tag_name_parse_i(""), TAG_NUM_OF_ITEM_TYPES);
+	EXPECT_EQ(tag_name_parse("Artis"), TAG_NUM_OF_ITEM_TYPES);
+	EXPECT_EQ(tag_name_parse("Artists"), TAG_NUM_OF_ITEM_TYPES);
+	EXPECT_EQ(tag_name_parse_i("foo"), TAG_NUM_OF_ITEM_TYPES);
+
+	/* a prefix of a valid name must not match */
+	EXPECT_EQ(tag_name_parse(std::string_view{"ArtistSort", 6}), TAG_ARTIST);
+	EXPECT_EQ(tag_name_parse(std::string_view{"ArtistSort", 7}),
+		  TAG_NUM_OF_ITEM_TYPES);
+}
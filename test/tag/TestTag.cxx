@@ -0,0 +1,100 @@
+/*
+ * Unit tests for the shared TagItem array of struct Tag
+ */
+
+#include "tag/Tag.hxx"
+#include "tag/Builder.hxx"
+
+#include <gtest/gtest.h>
+
+static Tag
+MakeTestTag()
+{
+	TagBuilder b;
+	b.AddItem(TAG_ARTIST, "foo");
+	b.AddItem(TAG_TITLE, "bar");
+	return b.Commit();
+}
+
+TEST(Tag, CopySharesItems)
+{
+	const Tag a = MakeTestTag();
+	const Tag b(a);
+
+	EXPECT_EQ(a.items, b.items);
+	EXPECT_EQ(a.num_items, b.num_items);
+	EXPECT_STREQ(b.GetValue(TAG_ARTIST), "foo");
+}
+
+TEST(Tag, ModifyCopy)
+{
+	const Tag a = MakeTestTag();
+
+	/* modifying a copy must not affect the original */
+	TagBuilder builder{Tag{a}};
+	builder.RemoveType(TAG_ARTIST);
+	builder.AddItem(TAG_ALBUM, "baz");
+	const Tag b = builder.Commit();
+
+	EXPECT_EQ(a.num_items, 2u);
+	EXPECT_STREQ(a.GetValue(TAG_ARTIST), "foo");
+	EXPECT_STREQ(a.GetValue(TAG_TITLE), "bar");
+	EXPECT_EQ(a.GetValue(TAG_ALBUM), nullptr);
+
+	EXPECT_EQ(b.num_items, 2u);
+	EXPECT_EQ(b.GetValue(TAG_ARTIST), nullptr);
+	EXPECT_STREQ(b.GetValue(TAG_TITLE), "bar");
+	EXPECT_STREQ(b.GetValue(TAG_ALBUM), "baz");
+}
+
+TEST(Tag, OutliveOriginal)
+{
+	auto a = std::make_unique<Tag>(MakeTestTag());
+	const Tag b(*a);
+	a.reset();
+
+	EXPECT_STREQ(b.GetValue(TAG_ARTIST), "foo");
+	EXPECT_STREQ(b.GetValue(TAG_TITLE), "bar");
+}
+
+TEST(Tag, Types)
+{
+	const Tag a = MakeTestTag();
+	EXPECT_TRUE(a.HasType(TAG_ARTIST));
+	EXPECT_TRUE(a.HasType(TAG_TITLE));
+	EXPECT_FALSE(a.HasType(TAG_ALBUM));
+	EXPECT_FALSE(a.HasType(TAG_MUSICBRAINZ_TRACKID));
+
+	const Tag b(a);
+	EXPECT_TRUE(b.HasType(TAG_ARTIST));
+	EXPECT_FALSE(b.HasType(TAG_ALBUM));
+
+	Tag c(MakeTestTag());
+	const Tag d(std::move(c));
+	EXPECT_TRUE(d.HasType(TAG_TITLE));
+	EXPECT_FALSE(c.HasType(TAG_TITLE));
+
+	TagBuilder builder{Tag{a}};
+	builder.RemoveType(TAG_ARTIST);
+	const Tag e = builder.Commit();
+	EXPECT_FALSE(e.HasType(TAG_ARTIST));
+	EXPECT_TRUE(e.HasType(TAG_TITLE));
+	EXPECT_EQ(e.GetValue(TAG_ARTIST), nullptr);
+
+	Tag f = MakeTestTag();
+	f.Clear();
+	EXPECT_FALSE(f.HasType(TAG_ARTIST));
+}
+
+TEST(Tag, FixString)
+{
+	TagBuilder b;
+	b.AddItem(TAG_ARTIST, "a\x01" "b");
+	b.AddItem(TAG_TITLE, "x\xff" "y");
+	b.AddItem(TAG_ALBUM, "\xc3\xa4");
+	const Tag tag = b.Commit();
+
+	EXPECT_STREQ(tag.GetValue(TAG_ARTIST), "a b");
+	EXPECT_STREQ(tag.GetValue(TAG_TITLE), "x?y");
+	EXPECT_STREQ(tag.GetValue(TAG_ALBUM), "\xc3\xa4");
+}
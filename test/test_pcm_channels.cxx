@@ -3,7 +3,9 @@
 
 #include "test_pcm_util.hxx"
 #include "pcm/PcmChannels.hxx"
+#include "pcm/ChannelMatrix.hxx"
 #include "pcm/Buffer.hxx"
+#include "util/SpanCast.hxx"
 
 #include <gtest/gtest.h>
 
@@ -90,3 +92,81 @@ TEST(PcmTest, Channels32)
 		EXPECT_EQ(silence, dest[i * 6 + 5]);
 	}
 }
+
+TEST(PcmTest, ChannelMatrixFloat)
+{
+	constexpr size_t N = 509;
+
+	for (unsigned src_channels = 1; src_channels <= MAX_CHANNELS; ++src_channels) {
+		const TestDataBuffer<float, N * MAX_CHANNELS> src{RandomFloat()};
+
+		for (unsigned dest_channels = 1; dest_channels <= MAX_CHANNELS; ++dest_channels) {
+			/* an arbitrary matrix */
+			PcmChannelMatrix matrix{src_channels, dest_channels};
+			for (unsigned d = 0; d < dest_channels; ++d)
+				for (unsigned s = 0; s < src_channels; ++s)
+					matrix.gain[d][s] = 0.1f * int(d + 1) - 0.05f * int(s);
+
+			PcmChannelMixer mixer;
+			mixer.Open(SampleFormat::FLOAT, matrix);
+
+			const auto dest = FromBytesStrict<const float>(mixer.Apply(std::as_bytes(std::span{src.begin(), N * src_channels})));
+			ASSERT_EQ(N * dest_channels, dest.size());
+
+			for (unsigned i = 0; i < N; ++i) {
+				for (unsigned d = 0; d < dest_channels; ++d) {
+					float expected = 0;
+					for (unsigned s = 0; s < src_channels; ++s)
+						expected += src[i * src_channels + s] * matrix.gain[d][s];
+
+					EXPECT_NEAR(expected, dest[i * dest_channels + d], 1e-5);
+				}
+			}
+		}
+	}
+}
+
+TEST(PcmTest, ChannelMatrixRoute)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int16_t, N * 6>();
+
+	/* 5.1 to stereo, swapping left and right; plus a silent
+	   third channel */
+	PcmChannelMatrix matrix{6, 3};
+	matrix.gain[0][1] = 1;
+	matrix.gain[1][0] = 1;
+	EXPECT_TRUE(matrix.IsRouting());
+
+	PcmChannelMixer mixer;
+	mixer.Open(SampleFormat::S16, matrix);
+
+	const auto dest = FromBytesStrict<const int16_t>(mixer.Apply(src));
+	ASSERT_EQ(N * 3, dest.size());
+	for (unsigned i = 0; i < N; ++i) {
+		EXPECT_EQ(src[i * 6 + 1], dest[i * 3]);
+		EXPECT_EQ(src[i * 6], dest[i * 3 + 1]);
+		EXPECT_EQ(0, dest[i * 3 + 2]);
+	}
+}
+
+TEST(PcmTest, ChannelMatrixInteger)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int16_t, N * 2>();
+
+	PcmChannelMatrix matrix{2, 1};
+	matrix.gain[0][0] = 1;
+	matrix.gain[0][1] = 1;
+	EXPECT_FALSE(matrix.IsRouting());
+
+	PcmChannelMixer mixer;
+	mixer.Open(SampleFormat::S16, matrix);
+
+	const auto dest = FromBytesStrict<const int16_t>(mixer.Apply(src));
+	ASSERT_EQ(N, dest.size());
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(std::clamp(int(src[i * 2]) + int(src[i * 2 + 1]),
+				     -32768, 32767),
+			  dest[i]);
+}
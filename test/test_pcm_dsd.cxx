@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+
+#ifdef ENABLE_DSD
+
+#include "pcm/Dsd2Pcm.hxx"
+#include "pcm/HalfBandDecimator.hxx"
+#include "test_pcm_util.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Verify that the output does not depend on how the input is split
+ * into chunks.
+ */
+TEST(PcmTest, Dsd2PcmChunks)
+{
+	constexpr unsigned channels = 3;
+	constexpr std::size_t n_frames = 1000;
+
+	const TestDataBuffer<uint8_t, n_frames * channels> buffer;
+	const auto *src = reinterpret_cast<const std::byte *>(buffer.begin());
+
+	MultiDsd2Pcm a;
+	a.Reset();
+	std::vector<float> expected(n_frames * channels);
+	a.Translate(channels, n_frames, src, expected.data());
+
+	static constexpr std::size_t chunk_sizes[] = { 1, 7, 300, 1 };
+
+	MultiDsd2Pcm b;
+	b.Reset();
+	std::vector<float> actual(n_frames * channels);
+	std::size_t position = 0;
+	for (std::size_t i = 0; position < n_frames; ++i) {
+		const std::size_t n = std::min(chunk_sizes[i % std::size(chunk_sizes)],
+					       n_frames - position);
+		b.Translate(channels, n, src + position * channels,
+			    actual.data() + position * channels);
+		position += n;
+	}
+
+	EXPECT_EQ(expected, actual);
+}
+
+TEST(PcmTest, HalfBandDecimator)
+{
+	constexpr unsigned channels = 2;
+
+	PcmHalfBandDecimator d;
+
+	/* odd chunk sizes: the phase must be preserved */
+	std::vector<float> src(7 * channels, 1.0f);
+	std::size_t n_out = 0;
+	float last = 0;
+	for (unsigned i = 0; i < 10; ++i) {
+		const auto dest = d.Process(channels, std::span<const float>{src});
+		n_out += dest.size();
+		if (!dest.empty())
+			last = dest.back();
+	}
+
+	EXPECT_EQ(n_out, 35u * channels);
+
+	/* unity gain at DC */
+	EXPECT_NEAR(last, 1.0f, 1e-5f);
+
+	/* S24 output is clamped */
+	std::vector<int32_t> loud(64 * channels, 0x7fffff);
+	for (std::size_t i = 0; i < loud.size(); i += 4)
+		loud[i] = -0x800000;
+
+	d.Reset();
+	for (const int32_t i : d.Process(channels, std::span<const int32_t>{loud})) {
+		EXPECT_GE(i, -0x800000);
+		EXPECT_LE(i, 0x7fffff);
+	}
+}
+
+#endif
@@ -4,10 +4,15 @@
 #include "config.h"
 #include "pcm/Export.hxx"
 #include "pcm/Traits.hxx"
+#include "pcm/DsdSimd.hxx"
+#include "util/BitReverse.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/SpanCast.hxx"
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include <string.h>
 
 TEST(PcmTest, ExportShift8)
@@ -340,6 +345,109 @@ TEST(PcmTest, ExportDop)
 			 sizeof(expected_silence)), 0);
 }
 
+TEST(PcmTest, BitReverseSimd)
+{
+	std::byte src[1027], dest[sizeof(src)];
+	for (std::size_t i = 0; i < sizeof(src); ++i)
+		src[i] = std::byte(i * 7);
+
+	PcmBitReverseSimd(dest, src, sizeof(src));
+	for (std::size_t i = 0; i < sizeof(src); ++i)
+		EXPECT_EQ(dest[i], BitReverse(src[i]));
+}
+
+TEST(PcmTest, InterleaveDsdSimd)
+{
+	static constexpr std::size_t n = 1027;
+	std::byte src[8 * n], dest[sizeof(src)];
+	for (std::size_t i = 0; i < sizeof(src); ++i)
+		src[i] = std::byte(i * 7);
+
+	for (unsigned channels = 1; channels <= 8; ++channels) {
+		PcmInterleaveDsdSimd(dest, src, n, channels);
+		for (std::size_t i = 0; i < n; ++i)
+			for (unsigned c = 0; c < channels; ++c)
+				EXPECT_EQ(dest[i * channels + c], src[c * n + i]);
+	}
+}
+
+/**
+ * Compare the (vectorized) DSD converters with a straightforward
+ * implementation, for all channel counts and with enough data to
+ * use the vectorized kernels.
+ */
+TEST(PcmTest, ExportDsdLarge)
+{
+	std::vector<uint8_t> src(4 * 8 * 257);
+	unsigned seed = 1;
+	for (auto &i : src)
+		i = (seed = seed * 1103515245 + 12345) >> 16;
+
+	for (unsigned channels = 1; channels <= 8; ++channels) {
+		const std::size_t n_quads = src.size() / (4 * channels);
+		const auto in = std::as_bytes(std::span{src}.first(n_quads * 4 * channels));
+
+		auto byte = [&](std::size_t quad, std::size_t i, unsigned c){
+			return uint32_t(src[(quad * 4 + i) * channels + c]);
+		};
+
+		for (bool reverse : {false, true}) {
+			auto fix = [reverse](uint32_t x){
+				return reverse ? ByteSwap32(x) : x;
+			};
+
+			PcmExport::Params params;
+			params.reverse_endian = reverse;
+
+			/* DSD_U32 */
+			params.dsd_mode = PcmExport::DsdMode::U32;
+			PcmExport e;
+			e.Open(SampleFormat::DSD, channels, params);
+			auto dest = FromBytesStrict<const uint32_t>(e.Export(in));
+			ASSERT_EQ(dest.size(), n_quads * channels);
+			for (std::size_t q = 0; q < n_quads; ++q)
+				for (unsigned c = 0; c < channels; ++c)
+					EXPECT_EQ(dest[q * channels + c],
+						  fix(byte(q, 0, c) << 24 | byte(q, 1, c) << 16 |
+						      byte(q, 2, c) << 8 | byte(q, 3, c)));
+
+			/* DSD_U16 */
+			params.dsd_mode = PcmExport::DsdMode::U16;
+			e.Open(SampleFormat::DSD, channels, params);
+			const auto dest16 = FromBytesStrict<const uint16_t>(e.Export(in));
+			ASSERT_EQ(dest16.size(), n_quads * 2 * channels);
+			for (std::size_t q = 0; q < n_quads; ++q)
+				for (unsigned h = 0; h < 2; ++h)
+					for (unsigned c = 0; c < channels; ++c) {
+						const uint16_t x = byte(q, 2 * h, c) << 8 | byte(q, 2 * h + 1, c);
+						EXPECT_EQ(dest16[(q * 2 + h) * channels + c],
+							  reverse ? ByteSwap16(x) : x);
+					}
+
+			/* DoP */
+			params.dsd_mode = PcmExport::DsdMode::DOP;
+			for (bool shift8 : {false, true}) {
+				params.shift8 = shift8;
+				e.Open(SampleFormat::DSD, channels, params);
+				dest = FromBytesStrict<const uint32_t>(e.Export(in));
+				ASSERT_EQ(dest.size(), n_quads * 2 * channels);
+				for (std::size_t q = 0; q < n_quads; ++q) {
+					for (unsigned h = 0; h < 2; ++h) {
+						for (unsigned c = 0; c < channels; ++c) {
+							uint32_t x = (h == 0 ? 0xff050000 : 0xfffa0000) |
+								byte(q, 2 * h, c) << 8 | byte(q, 2 * h + 1, c);
+							if (shift8)
+								x <<= 8;
+
+							EXPECT_EQ(dest[(q * 2 + h) * channels + c], fix(x));
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
 #endif
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
@@ -6,6 +6,8 @@
 #include "pcm/Dither.hxx"
 #include "pcm/Buffer.hxx"
 #include "pcm/SampleFormat.hxx"
+#include "pcm/ShiftConvert.hxx"
+#include "pcm/FloatConvert.hxx"
 
 #include <gtest/gtest.h>
 
@@ -143,3 +145,94 @@ TEST(PcmTest, FormatFloat32)
 	for (size_t i = 4; i < N; ++i)
 		EXPECT_NEAR(src[i], d[i], error);
 }
+
+template<SampleFormat DF>
+static auto
+ConvertTo(PcmBuffer &buffer, SampleFormat src_format,
+	  std::span<const std::byte> src) noexcept
+{
+	if constexpr (DF == SampleFormat::S16) {
+		PcmDither dither;
+		return pcm_convert_to_16(buffer, dither, src_format, src);
+	} else if constexpr (DF == SampleFormat::S24_P32)
+		return pcm_convert_to_24(buffer, src_format, src);
+	else if constexpr (DF == SampleFormat::S32)
+		return pcm_convert_to_32(buffer, src_format, src);
+	else
+		return pcm_convert_to_float(buffer, src_format, src);
+}
+
+/**
+ * Compare the (possibly vectorized) buffer conversion with the
+ * per-sample conversion class C.
+ */
+template<SampleFormat SF, SampleFormat DF, typename C>
+static void
+TestFormatExact(std::span<const typename C::SrcTraits::value_type> src)
+{
+	PcmBuffer buffer;
+	const auto d = ConvertTo<DF>(buffer, SF, std::as_bytes(src));
+	ASSERT_EQ(src.size(), d.size());
+
+	for (size_t i = 0; i < src.size(); ++i)
+		EXPECT_EQ(C::Convert(src[i]), d[i]) << "i=" << i;
+}
+
+template<SampleFormat SF, SampleFormat DF>
+static void
+TestLeftShiftExact(std::span<const typename SampleTraits<SF>::value_type> src)
+{
+	TestFormatExact<SF, DF, LeftShiftSampleConvert<SF, DF>>(src);
+}
+
+template<SampleFormat DF>
+static void
+TestFromFloatExact(std::span<const float> src)
+{
+	TestFormatExact<SampleFormat::FLOAT, DF,
+			FloatToIntegerSampleConvert<DF>>(src);
+}
+
+template<SampleFormat SF>
+static void
+TestToFloatExact(std::span<const typename SampleTraits<SF>::value_type> src)
+{
+	TestFormatExact<SF, SampleFormat::FLOAT,
+			IntegerToFloatSampleConvert<SF>>(src);
+}
+
+TEST(PcmTest, FormatExact)
+{
+	/* not a multiple of the vector size */
+	constexpr size_t N = 509;
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+
+	auto srcf = TestDataBuffer<float, N>(RandomFloat());
+	static constexpr float specials[] = {
+		1.f, -1.f, 1.5f, -1.5f, 0.99999994f, -0.99999994f,
+		10.f, -10.f, 0.f, -0.f, 0.5f, -0.5f, 1e-10f,
+	};
+	std::copy(std::begin(specials), std::end(specials),
+		  const_cast<float *>(srcf.begin()));
+
+	TestLeftShiftExact<SampleFormat::S16, SampleFormat::S24_P32>(src16);
+	TestLeftShiftExact<SampleFormat::S16, SampleFormat::S32>(src16);
+	TestLeftShiftExact<SampleFormat::S24_P32, SampleFormat::S32>(src24);
+
+	TestFormatExact<SampleFormat::S32, SampleFormat::S24_P32,
+			RightShiftSampleConvert<SampleFormat::S32,
+						SampleFormat::S24_P32>>(src32);
+
+#ifndef __ARM_NEON__
+	/* the NEON implementation rounds instead of truncating */
+	TestFromFloatExact<SampleFormat::S16>(srcf);
+#endif
+	TestFromFloatExact<SampleFormat::S24_P32>(srcf);
+	TestFromFloatExact<SampleFormat::S32>(srcf);
+
+	TestToFloatExact<SampleFormat::S16>(src16);
+	TestToFloatExact<SampleFormat::S24_P32>(src24);
+	TestToFloatExact<SampleFormat::S32>(src32);
+}
@@ -2,10 +2,13 @@
 // Copyright The Music Player Daemon Project
 
 #include "pcm/Interleave.hxx"
+#include "pcm/DeinterleaveSimd.hxx"
+#include "pcm/FloatConvert.hxx"
 
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <vector>
 
 template<typename T>
 static void
@@ -106,3 +109,55 @@ TEST(PcmTest, Interleave64)
 {
 	TestInterleaveN<uint64_t>();
 }
+
+/**
+ * Compare PcmDeinterleaveToFloat() with IntegerToFloatSampleConvert,
+ * with enough frames to use the vectorized kernels and a few more
+ * for the scalar tail.
+ */
+template<SampleFormat F, typename T=typename SampleTraits<F>::value_type>
+static void
+TestDeinterleaveToFloat()
+{
+	static constexpr std::size_t n_frames = 131;
+
+	std::vector<T> src(n_frames * 8);
+	unsigned seed = 1;
+	for (auto &i : src) {
+		seed = seed * 1103515245 + 12345;
+		if constexpr (F == SampleFormat::FLOAT)
+			i = float(int(seed >> 8) % 65536) / 32768.0f - 1.0f;
+		else
+			i = T(int32_t(seed) >> (32 - SampleTraits<F>::BITS));
+	}
+
+	for (unsigned channels = 1; channels <= 8; ++channels) {
+		std::vector<float> planes[8];
+		float *dest[8];
+		for (unsigned c = 0; c < channels; ++c) {
+			planes[c].resize(n_frames);
+			dest[c] = planes[c].data();
+		}
+
+		PcmDeinterleaveToFloat(dest, src.data(), n_frames, channels, F);
+
+		for (std::size_t i = 0; i < n_frames; ++i) {
+			for (unsigned c = 0; c < channels; ++c) {
+				const T x = src[i * channels + c];
+				if constexpr (F == SampleFormat::FLOAT)
+					EXPECT_EQ(planes[c][i], x);
+				else
+					EXPECT_EQ(planes[c][i],
+						  IntegerToFloatSampleConvert<F>::Convert(x));
+			}
+		}
+	}
+}
+
+TEST(PcmTest, DeinterleaveToFloat)
+{
+	TestDeinterleaveToFloat<SampleFormat::S16>();
+	TestDeinterleaveToFloat<SampleFormat::S24_P32>();
+	TestDeinterleaveToFloat<SampleFormat::S32>();
+	TestDeinterleaveToFloat<SampleFormat::FLOAT>();
+}
@@ -4,9 +4,16 @@
 #include "test_pcm_util.hxx"
 #include "pcm/Mix.hxx"
 #include "pcm/Dither.hxx"
+#include "pcm/Clamp.hxx"
+#include "pcm/Traits.hxx"
+#include "pcm/Volume.hxx"
+
+#include "pcm/Dither.cxx" // including the .cxx file to get inlined templates
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+
 template<typename T, SampleFormat format, typename G=RandomInt<T>>
 static void
 TestPcmMix(G g=G())
@@ -65,3 +72,67 @@ TEST(PcmTest, Mix32)
 {
 	TestPcmMix<int32_t, SampleFormat::S32>();
 }
+
+/**
+ * Compare pcm_mix() (which may use vectorized kernels) with a
+ * straightforward scalar implementation; the results must be
+ * bit-exact, including the dither.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>,
+	 typename G=RandomInt<typename Traits::value_type>>
+static void
+TestPcmMixExact(G g=G())
+{
+	using T = typename Traits::value_type;
+	using L = typename Traits::long_type;
+
+	/* not a multiple of the vector or block size */
+	constexpr unsigned N = 509;
+	auto src1 = TestDataBuffer<T, N>(g);
+	auto src2 = TestDataBuffer<T, N>(g);
+
+	/* provoke clipping */
+	src1[0] = src2[0] = T(Traits::MAX);
+	src1[1] = src2[1] = T(Traits::MIN);
+
+	for (const float portion : {-1.0f, 0.0f, 0.3f, 0.5f, 1.0f}) {
+		PcmDither dither, expected_dither;
+
+		auto result = src1;
+		ASSERT_TRUE(pcm_mix(dither, result.begin(), src2.begin(),
+				    sizeof(result), F, portion));
+
+		T expected[N];
+		if (portion < 0) {
+			for (unsigned i = 0; i < N; ++i)
+				expected[i] = PcmClamp<F>(typename Traits::sum_type(src1[i]) + src2[i]);
+		} else {
+			float s = std::sin((float)M_PI_2 * portion);
+			s *= s;
+			const int vol1 = std::clamp<int>(lround(s * PCM_VOLUME_1S),
+							 0, PCM_VOLUME_1S);
+			const int vol2 = PCM_VOLUME_1S - vol1;
+
+			for (unsigned i = 0; i < N; ++i)
+				expected[i] = expected_dither.DitherShift<L, Traits::BITS + PCM_VOLUME_BITS, Traits::BITS>(L(src1[i]) * vol1 + L(src2[i]) * vol2);
+		}
+
+		for (unsigned i = 0; i < N; ++i)
+			ASSERT_EQ(result[i], expected[i]) << "portion=" << portion << " i=" << i;
+	}
+}
+
+TEST(PcmTest, MixExact16)
+{
+	TestPcmMixExact<SampleFormat::S16>();
+}
+
+TEST(PcmTest, MixExact24)
+{
+	TestPcmMixExact<SampleFormat::S24_P32>(RandomInt24());
+}
+
+TEST(PcmTest, MixExact32)
+{
+	TestPcmMixExact<SampleFormat::S32>();
+}
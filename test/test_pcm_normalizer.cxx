@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "test_pcm_util.hxx"
+#include "pcm/Normalizer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+/**
+ * All sample formats see the same peaks (scaled to 16 bit), so they
+ * must choose the same gain.
+ */
+TEST(PcmTest, NormalizerFormats)
+{
+	constexpr size_t N = 1021;
+
+	PcmNormalizer n16, n24, n32, nf;
+
+	std::array<int16_t, N> src16, dest16;
+	std::array<int32_t, N> src24, dest24, src32, dest32;
+	std::array<float, N> srcf, destf;
+
+	RandomInt<int16_t> r;
+	for (unsigned chunk = 0; chunk < 50; ++chunk) {
+		/* quiet at first, then loud enough to clip */
+		const int amplitude = chunk < 40 ? 1000 : 30000;
+
+		for (size_t i = 0; i < N; ++i) {
+			const int16_t x = int16_t(r()) % amplitude;
+			src16[i] = x;
+			src24[i] = x * 256;
+			src32[i] = x * 65536;
+			srcf[i] = x / 32768.f;
+		}
+
+		n16.ProcessS16(dest16.data(), src16);
+		n24.ProcessS24(dest24.data(), src24);
+		n32.ProcessS32(dest32.data(), src32);
+		nf.ProcessFloat(destf.data(), srcf);
+
+		for (size_t i = 0; i < N; ++i) {
+			EXPECT_NEAR(dest16[i], dest24[i] / 256., 1);
+			EXPECT_NEAR(dest16[i], dest32[i] / 65536., 1);
+			EXPECT_NEAR(dest16[i], double(destf[i]) * 32768., 1);
+			EXPECT_LE(std::fabs(destf[i]), 1.f);
+		}
+	}
+
+	/* the quiet part has been amplified */
+	EXPECT_GT(*std::max_element(dest16.begin(), dest16.end()), 16000);
+}
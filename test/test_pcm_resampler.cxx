@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "pcm/PolyphaseResampler.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+/**
+ * Resample one second of a 1 kHz sine wave and check the number of
+ * frames, the frequency and the amplitude of the result.
+ */
+static void
+TestPolyphase(unsigned in_rate, unsigned out_rate)
+{
+	constexpr unsigned channels = 2;
+	constexpr double frequency = 1000, amplitude = 0.5;
+
+	PolyphasePcmResampler r;
+	AudioFormat af{in_rate, SampleFormat::S16, channels};
+	const auto out_af = r.Open(af, out_rate);
+	EXPECT_EQ(af.format, SampleFormat::FLOAT);
+	EXPECT_EQ(out_af.sample_rate, out_rate);
+	EXPECT_EQ(out_af.channels, channels);
+
+	std::vector<float> output;
+
+	constexpr unsigned chunk_frames = 1000;
+	std::vector<float> chunk;
+	for (unsigned start = 0; start < in_rate; start += chunk_frames) {
+		const unsigned n = std::min(chunk_frames, in_rate - start);
+		chunk.resize(n * channels);
+
+		for (unsigned i = 0; i < n; ++i) {
+			const double t = double(start + i) / in_rate;
+			const float x = amplitude *
+				std::sin(2 * std::numbers::pi * frequency * t);
+			chunk[i * channels] = chunk[i * channels + 1] = x;
+		}
+
+		const auto dest = FromBytesStrict<const float>(r.Resample(std::as_bytes(std::span{chunk})));
+		output.insert(output.end(), dest.begin(), dest.end());
+	}
+
+	for (auto dest = r.Flush(); !dest.empty(); dest = r.Flush()) {
+		const auto f = FromBytesStrict<const float>(dest);
+		output.insert(output.end(), f.begin(), f.end());
+	}
+
+	r.Close();
+
+	const std::size_t n_frames = output.size() / channels;
+	EXPECT_NEAR(double(n_frames), double(out_rate), out_rate / 100.);
+
+	/* skip the filter's delay at both ends */
+	const std::size_t begin = out_rate / 10, end = n_frames - out_rate / 10;
+
+	double sum = 0;
+	unsigned crossings = 0;
+	for (std::size_t i = begin; i < end; ++i) {
+		const double x = output[i * channels];
+		EXPECT_FLOAT_EQ(x, output[i * channels + 1]);
+		sum += x * x;
+
+		if ((output[(i - 1) * channels] < 0) != (x < 0))
+			++crossings;
+	}
+
+	const double rms = std::sqrt(sum / (end - begin));
+	EXPECT_NEAR(rms, amplitude / std::numbers::sqrt2, 0.01);
+
+	const double seconds = double(end - begin) / out_rate;
+	EXPECT_NEAR(crossings, 2 * frequency * seconds, 2);
+}
+
+TEST(PcmTest, PolyphaseUpsample)
+{
+	TestPolyphase(44100, 48000);
+	TestPolyphase(44100, 96000);
+}
+
+TEST(PcmTest, PolyphaseDownsample)
+{
+	TestPolyphase(48000, 44100);
+	TestPolyphase(192000, 44100);
+}
+
+TEST(PcmTest, PolyphaseOddRatio)
+{
+	/* the phase table is smaller than the ratio here */
+	TestPolyphase(44100, 47999);
+}
@@ -102,6 +102,37 @@ TEST(PcmTest, Volume16to32)
 	pv.Close();
 }
 
+/**
+ * Verify that the vectorized S16 to S24_P32 conversion is bit-exact
+ * at volume levels beyond 100% and for buffer sizes which are not a
+ * multiple of the vector size.
+ */
+TEST(PcmTest, Volume16to32Exact)
+{
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const std::span<const std::byte> src = _src;
+
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(SampleFormat::S16, true), SampleFormat::S24_P32);
+
+	for (const unsigned volume : {1U, 333U, PCM_VOLUME_1 * 5 / 2, 40000U}) {
+		pv.SetVolume(volume);
+
+		for (const size_t n : {N, N - 1, size_t{7}}) {
+			const auto dest = pv.Apply(src.first(n * sizeof(int16_t)));
+			EXPECT_EQ(n * sizeof(int32_t), dest.size());
+
+			const auto s = FromBytesStrict<const int16_t>(src);
+			const auto d = FromBytesStrict<const int32_t>(dest);
+			for (size_t i = 0; i < n; ++i)
+				EXPECT_EQ(d[i], (int32_t(s[i]) * int32_t(volume)) >> 2);
+		}
+	}
+
+	pv.Close();
+}
+
 TEST(PcmTest, Volume24)
 {
 	TestVolume<SampleFormat::S24_P32>(RandomInt24());
@@ -142,3 +173,45 @@ TEST(PcmTest, VolumeFloat)
 
 	pv.Close();
 }
+
+/**
+ * Verify the kernels which apply the volume and convert to a
+ * different sample format in the same pass.
+ */
+TEST(PcmTest, VolumeFused)
+{
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const std::span<const std::byte> src = _src;
+	const auto s = FromBytesStrict<const int16_t>(src);
+
+	PcmVolume pv;
+	pv.SetVolume(PCM_VOLUME_1 / 2);
+
+	/* S16 to S32 */
+	ASSERT_TRUE(pv.Open(SampleFormat::S16, SampleFormat::S32));
+
+	auto dest = pv.Apply(src);
+	EXPECT_EQ(src.size() * 2, dest.size());
+
+	const auto d32 = FromBytesStrict<const int32_t>(dest);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_EQ(d32[i], (int32_t(s[i]) << 16) / 2);
+
+	pv.Close();
+
+	/* S16 to float */
+	ASSERT_TRUE(pv.Open(SampleFormat::S16, SampleFormat::FLOAT));
+
+	dest = pv.Apply(src);
+	EXPECT_EQ(src.size() * 2, dest.size());
+
+	const auto df = FromBytesStrict<const float>(dest);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_FLOAT_EQ(df[i], s[i] / 65536.f);
+
+	pv.Close();
+
+	/* this one is not implemented */
+	EXPECT_FALSE(pv.Open(SampleFormat::S16, SampleFormat::S8));
+}
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "queue/Queue.hxx"
+#include "queue/Selection.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/Filter.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <fmt/core.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+class QueueIndexTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		IcuInit();
+	}
+
+	void TearDown() override {
+		IcuFinish();
+	}
+};
+
+static DetachedSong
+MakeSong(unsigned i)
+{
+	const auto artist = fmt::format("Artist {}", i % 50);
+	const auto album = fmt::format("Album {}", i % 200);
+	const auto title = fmt::format("Title {}", i);
+
+	Tag tag = i % 3 == 0
+		/* some songs have an AlbumArtist */
+		? MakeTag(TAG_ARTIST, artist.c_str(),
+			  TAG_ALBUM_ARTIST, fmt::format("Various {}", i % 7).c_str(),
+			  TAG_ALBUM, album.c_str(),
+			  TAG_TITLE, title.c_str())
+		: MakeTag(TAG_ARTIST, artist.c_str(),
+			  TAG_ALBUM, album.c_str(),
+			  TAG_TITLE, title.c_str());
+
+	return DetachedSong{fmt::format("song{}.flac", i), std::move(tag)};
+}
+
+/**
+ * Find all matching positions without the index.
+ */
+static std::vector<unsigned>
+FindLinear(const Queue &queue, const QueueSelection &selection)
+{
+	std::vector<unsigned> result;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (selection.MatchPosition(queue, i))
+			result.push_back(i);
+	return result;
+}
+
+/**
+ * Find all matching positions with the index.
+ */
+static std::vector<unsigned>
+FindIndexed(const Queue &queue, const QueueSelection &selection)
+{
+	const auto candidates = selection.FindCandidates(queue);
+	if (!candidates)
+		return FindLinear(queue, selection);
+
+	std::vector<unsigned> result;
+	for (const unsigned i : *candidates)
+		if (selection.MatchPosition(queue, i))
+			result.push_back(i);
+	return result;
+}
+
+struct Expression {
+	const char *expression;
+	bool fold_case;
+
+	/**
+	 * Is the index expected to be used for this expression?
+	 */
+	bool indexed;
+};
+
+static constexpr Expression expressions[] = {
+	{ "(Artist == \"Artist 7\")", false, true },
+	{ "(Artist == \"artist 7\")", true, true },
+	{ "(Artist == \"nonexistent\")", false, true },
+	{ "(Album starts_with \"Album 19\")", false, true },
+	{ "(Title contains \"TLE 12\")", true, true },
+	{ "(AlbumArtist == \"Artist 4\")", false, true },
+	{ "(AlbumArtist == \"Various 2\")", false, true },
+	{ "(any contains \"itle 99\")", false, true },
+	{ "((Artist == \"Artist 3\") AND (Album == \"Album 53\"))", false, true },
+
+	/* too many candidates */
+	{ "(Title contains \"Title\")", false, false },
+
+	/* these cannot be evaluated with the index */
+	{ "(Artist != \"Artist 7\")", false, false },
+	{ "(Composer == \"\")", false, false },
+	{ "(file == \"song1.flac\")", false, false },
+};
+
+/**
+ * @param indexed is the queue long enough to be indexed?
+ */
+static void
+Check(const Queue &queue, bool indexed=true)
+{
+	for (const auto &e : expressions) {
+		SongFilter filter;
+		const char *const args[] = {e.expression};
+		filter.Parse(args, e.fold_case);
+		filter.Optimize();
+
+		QueueSelection selection;
+		selection.filter = &filter;
+
+		EXPECT_EQ(selection.FindCandidates(queue).has_value(),
+			  indexed && e.indexed)
+			<< e.expression;
+		EXPECT_EQ(FindIndexed(queue, selection),
+			  FindLinear(queue, selection))
+			<< e.expression;
+	}
+}
+
+TEST_F(QueueIndexTest, Basic)
+{
+	Queue queue{8192};
+
+	for (unsigned i = 0; i < 4000; ++i)
+		queue.Append(MakeSong(i), 0);
+
+	Check(queue);
+
+	/* modify tags */
+	for (unsigned i = 0; i < queue.GetLength(); i += 17) {
+		queue.Get(i).SetTag(MakeTag(TAG_ARTIST, "Artist 7",
+					    TAG_TITLE, "Title 1299"));
+		queue.ModifyAtPosition(i);
+	}
+
+	Check(queue);
+
+	/* delete and move songs */
+	for (unsigned i = 0; i < 500; ++i)
+		queue.DeletePosition((i * 7919) % queue.GetLength());
+
+	queue.MoveRange(100, 400, 2000);
+	queue.SwapPositions(0, 3000);
+
+	Check(queue);
+
+	/* append more */
+	for (unsigned i = 4000; i < 4500; ++i)
+		queue.Append(MakeSong(i), 0);
+
+	Check(queue);
+
+	queue.Clear();
+	EXPECT_EQ(queue.GetIndex(), nullptr);
+}
+
+TEST_F(QueueIndexTest, Short)
+{
+	Queue queue{8192};
+
+	for (unsigned i = 0; i < 100; ++i)
+		queue.Append(MakeSong(i), 0);
+
+	/* too short to be indexed */
+	EXPECT_EQ(queue.GetIndex(), nullptr);
+
+	Check(queue, false);
+}
@@ -0,0 +1,160 @@
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/LightSong.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+Tag::Tag(const Tag &) noexcept {}
+void Tag::Clear() noexcept {}
+
+DetachedSong::operator LightSong() const noexcept
+{
+	return {uri.c_str(), tag};
+}
+
+using Type = QueueJournal::Type;
+
+/**
+ * Apply the journal entries since the specified version to a copy of
+ * the queue's song ids, the way a client would.
+ */
+static void
+Apply(std::vector<unsigned> &ids, const Queue &queue, uint32_t since)
+{
+	ASSERT_TRUE(queue.journal.IsAvailable(since, queue.version));
+
+	queue.journal.ForEachSince(since, [&ids](const QueueJournal::Entry &e){
+		const auto begin = ids.begin() + e.start;
+		const auto end = begin + e.count;
+
+		switch (e.type) {
+		case Type::INSERT:
+			ids.insert(begin, e.ids.begin(), e.ids.end());
+			break;
+
+		case Type::DELETE:
+			ids.erase(begin, end);
+			break;
+
+		case Type::MOVE:
+			{
+				std::vector<unsigned> tmp(begin, end);
+				ids.erase(begin, end);
+				ids.insert(ids.begin() + e.to,
+					   tmp.begin(), tmp.end());
+			}
+			break;
+
+		case Type::SWAP:
+			std::swap(ids[e.start], ids[e.to]);
+			break;
+
+		case Type::MODIFY:
+			break;
+
+		case Type::REORDER:
+			std::copy(e.ids.begin(), e.ids.end(), begin);
+			break;
+
+		case Type::CLEAR:
+			ids.clear();
+			break;
+		}
+	});
+}
+
+static std::vector<unsigned>
+GetIds(const Queue &queue)
+{
+	std::vector<unsigned> ids;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		ids.push_back(queue.PositionToId(i));
+	return ids;
+}
+
+static std::size_t
+CountEntries(const Queue &queue, uint32_t since)
+{
+	std::size_t n = 0;
+	queue.journal.ForEachSince(since, [&n](const auto &){ ++n; });
+	return n;
+}
+
+static void
+Append(Queue &queue, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		queue.Append(DetachedSong("foo.ogg"), 0);
+}
+
+TEST(QueueJournal, Replay)
+{
+	Queue queue(64);
+
+	std::vector<unsigned> mirror;
+	uint32_t since = queue.version;
+
+	/* consecutive appends are merged into one entry */
+	Append(queue, 16);
+	queue.IncrementVersion();
+	EXPECT_EQ(CountEntries(queue, since), 1u);
+	Apply(mirror, queue, since);
+	EXPECT_EQ(mirror, GetIds(queue));
+	since = queue.version;
+
+	queue.DeletePosition(3);
+	queue.DeletePosition(3);
+	queue.MoveRange(2, 5, 8);
+	queue.MovePostion(0, 10);
+	queue.SwapPositions(1, 7);
+	queue.SetPriority(4, 10, -1);
+	queue.IncrementVersion();
+	Append(queue, 2);
+	queue.IncrementVersion();
+
+	Apply(mirror, queue, since);
+	EXPECT_EQ(mirror, GetIds(queue));
+	since = queue.version;
+
+	/* a shuffle is only one entry */
+	queue.ShuffleRange(2, 12);
+	queue.IncrementVersion();
+	EXPECT_EQ(CountEntries(queue, since), 1u);
+	Apply(mirror, queue, since);
+	EXPECT_EQ(mirror, GetIds(queue));
+	since = queue.version;
+
+	queue.Clear();
+	Append(queue, 3);
+	queue.IncrementVersion();
+	Apply(mirror, queue, since);
+	EXPECT_EQ(mirror, GetIds(queue));
+
+	/* the journal is complete after "clear", even for clients
+	   which have never seen the queue */
+	std::vector<unsigned> fresh;
+	Apply(fresh, queue, 1);
+	EXPECT_EQ(fresh, GetIds(queue));
+}
+
+TEST(QueueJournal, Overflow)
+{
+	Queue queue(4);
+
+	const uint32_t since = queue.version;
+	Append(queue, 4);
+	queue.IncrementVersion();
+	EXPECT_TRUE(queue.journal.IsAvailable(since, queue.version));
+
+	/* the journal is limited to 4*4 entries and ids */
+	for (unsigned i = 0; i < 16; ++i) {
+		queue.SwapPositions(0, 3);
+		queue.IncrementVersion();
+	}
+
+	EXPECT_FALSE(queue.journal.IsAvailable(since, queue.version));
+	EXPECT_TRUE(queue.journal.IsAvailable(queue.version, queue.version));
+}
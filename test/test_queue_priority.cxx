@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 
 #include <iterator>
+#include <string>
+#include <vector>
 
 Tag::Tag(const Tag &) noexcept {}
 void Tag::Clear() noexcept {}
@@ -23,7 +25,7 @@ check_descending_priority(const Queue *queue,
 	uint8_t last_priority = 0xff;
 	for (unsigned order = start_order; order < queue->GetLength(); ++order) {
 		unsigned position = queue->OrderToPosition(order);
-		uint8_t priority = queue->items[position].priority;
+		uint8_t priority = queue->GetPriorityAtPosition(position);
 		assert(priority <= last_priority);
 		(void)last_priority;
 		last_priority = priority;
@@ -129,7 +131,7 @@ TEST(QueuePriority, Priority)
 
 	unsigned a_order = 3;
 	unsigned a_position = queue.OrderToPosition(a_order);
-	EXPECT_EQ(10u, unsigned(queue.items[a_position].priority));
+	EXPECT_EQ(10u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 20, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -146,7 +148,7 @@ TEST(QueuePriority, Priority)
 
 	unsigned b_order = 10;
 	unsigned b_position = queue.OrderToPosition(b_order);
-	EXPECT_EQ(0u, unsigned(queue.items[b_position].priority));
+	EXPECT_EQ(0u, unsigned(queue.GetPriorityAtPosition(b_position)));
 	queue.SetPriority(b_position, 70, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -161,7 +163,7 @@ TEST(QueuePriority, Priority)
 
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(5u, a_order);
-	EXPECT_EQ(20u, unsigned(queue.items[a_position].priority));
+	EXPECT_EQ(20u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 5, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -170,3 +172,40 @@ TEST(QueuePriority, Priority)
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(6u, a_order);
 }
+
+TEST(QueuePriority, ShuffleOrder)
+{
+	Queue queue(1024);
+	queue.random = true;
+
+	for (unsigned i = 0; i < 500; ++i)
+		queue.Append(DetachedSong(std::to_string(i) + ".ogg"),
+			     i % 7 == 0 ? uint8_t(i % 5) : 0);
+
+	queue.ShuffleOrder();
+	check_descending_priority(&queue, 0);
+
+	/* "order" must still be a permutation of all positions */
+	std::vector<bool> seen(queue.GetLength());
+	for (unsigned order = 0; order < queue.GetLength(); ++order) {
+		const unsigned position = queue.OrderToPosition(order);
+		ASSERT_LT(position, queue.GetLength());
+		EXPECT_FALSE(seen[position]);
+		seen[position] = true;
+	}
+
+	/* append songs and shuffle them into the last group */
+	for (unsigned i = 500; i < 600; ++i)
+		queue.Append(DetachedSong(std::to_string(i) + ".ogg"), 0);
+
+	queue.ShuffleOrderLastGroup(10, queue.GetLength(), 100);
+	check_descending_priority(&queue, 0);
+
+	unsigned new_songs_in_front = 0;
+	for (unsigned order = 0; order < 500; ++order)
+		if (queue.OrderToPosition(order) >= 500)
+			++new_songs_in_front;
+
+	/* the new songs have been mixed into the group */
+	EXPECT_GT(new_songs_in_front, 0U);
+}
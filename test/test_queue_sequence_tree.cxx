@@ -0,0 +1,635 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "queue/SequenceTree.hxx"
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/LightSong.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+Tag::Tag(const Tag &) noexcept {}
+void Tag::Clear() noexcept {}
+
+DetachedSong::operator LightSong() const noexcept
+{
+	return {uri.c_str(), tag};
+}
+
+namespace {
+
+/**
+ * A node with a value, a lazy "add" modification and the maximum
+ * value of its subtree as aggregate.
+ */
+struct TestNode {
+	SequenceTreeLink<TestNode> link;
+
+	uint32_t key;
+
+	int value;
+
+	/**
+	 * A lazy modification: add this to all values in this
+	 * subtree.
+	 */
+	int add = 0;
+
+	/**
+	 * The highest value in this subtree (not including this
+	 * node's #add).
+	 */
+	int max_value;
+
+	TestNode(uint32_t _key, int _value) noexcept
+		:key(_key), value(_value) {}
+
+	int GetMax() const noexcept {
+		return max_value + add;
+	}
+};
+
+struct TestTraits {
+	static uint32_t GetKey(const TestNode &node) noexcept {
+		return node.key;
+	}
+
+	static void PushDown(TestNode &node) noexcept {
+		if (node.add == 0)
+			return;
+
+		node.value += node.add;
+		node.max_value += node.add;
+
+		for (TestNode *child : {node.link.left, node.link.right})
+			if (child != nullptr)
+				child->add += node.add;
+
+		node.add = 0;
+	}
+
+	static void Update(TestNode &node) noexcept {
+		node.max_value = node.value;
+
+		for (const TestNode *child : {node.link.left, node.link.right})
+			if (child != nullptr)
+				node.max_value = std::max(node.max_value,
+							  child->GetMax());
+	}
+};
+
+using TestTree = SequenceTree<TestNode, &TestNode::link, TestTraits>;
+
+/**
+ * Owns the nodes and keeps a reference copy of the sequence in a
+ * std::vector.
+ */
+class TestSequence {
+	std::mt19937 rng{42};
+
+	std::vector<std::unique_ptr<TestNode>> nodes;
+
+public:
+	TestTree tree;
+
+	std::vector<TestNode *> expected;
+
+	unsigned Random(unsigned max) noexcept {
+		return std::uniform_int_distribution<unsigned>{0, max}(rng);
+	}
+
+	TestNode &MakeNode(int value) noexcept {
+		nodes.emplace_back(std::make_unique<TestNode>(rng(), value));
+		return *nodes.back();
+	}
+
+	void Fill(unsigned n) noexcept {
+		for (unsigned i = 0; i < n; ++i) {
+			auto &node = MakeNode(i);
+			tree.PushBack(node);
+			expected.push_back(&node);
+		}
+	}
+};
+
+/**
+ * Determine the value of a node, taking lazy modifications into
+ * account.
+ */
+static int
+GetValue(const TestNode &node) noexcept
+{
+	int value = node.value;
+	TestTree::ForEachAncestor(node, [&value](const TestNode &i){
+		value += i.add;
+	});
+	return value;
+}
+
+/**
+ * Verify the structure of a subtree: sizes, parent pointers, heap
+ * order and aggregates.
+ *
+ * @return the number of nodes in the subtree
+ */
+static unsigned
+CheckSubtree(const TestNode *node, const TestNode *parent) noexcept
+{
+	if (node == nullptr)
+		return 0;
+
+	const auto &link = node->link;
+	EXPECT_EQ(link.parent, parent);
+
+	int max_value = node->value;
+	for (const TestNode *child : {link.left, link.right}) {
+		if (child != nullptr) {
+			EXPECT_LE(child->key, node->key);
+			max_value = std::max(max_value, child->GetMax());
+		}
+	}
+
+	EXPECT_EQ(node->max_value, max_value);
+
+	const unsigned size = 1 + CheckSubtree(link.left, node) +
+		CheckSubtree(link.right, node);
+	EXPECT_EQ(link.size, size);
+	return size;
+}
+
+/**
+ * Compare the tree with the expected sequence.
+ */
+static void
+Check(const TestSequence &s) noexcept
+{
+	const auto &tree = s.tree;
+	const auto &expected = s.expected;
+
+	ASSERT_EQ(tree.size(), expected.size());
+	EXPECT_EQ(tree.empty(), expected.empty());
+	EXPECT_EQ(CheckSubtree(tree.GetRoot(), nullptr), expected.size());
+	EXPECT_EQ(tree.ToVector(), expected);
+
+	for (unsigned i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(&tree[i], expected[i]);
+		EXPECT_EQ(TestTree::IndexOf(*expected[i]), i);
+	}
+}
+
+} // anonymous namespace
+
+TEST(SequenceTree, Empty)
+{
+	TestTree tree;
+	EXPECT_TRUE(tree.empty());
+	EXPECT_EQ(tree.size(), 0u);
+	EXPECT_EQ(tree.GetRoot(), nullptr);
+	EXPECT_TRUE(tree.ToVector().empty());
+}
+
+TEST(SequenceTree, InsertErase)
+{
+	TestSequence s;
+
+	for (unsigned i = 0; i < 500; ++i) {
+		const unsigned position = s.Random(s.expected.size());
+		auto &node = s.MakeNode(i);
+		s.tree.Insert(position, node);
+		s.expected.insert(s.expected.begin() + position, &node);
+	}
+
+	Check(s);
+
+	while (!s.expected.empty()) {
+		const unsigned position = s.Random(s.expected.size() - 1);
+		s.tree.Erase(*s.expected[position]);
+		s.expected.erase(s.expected.begin() + position);
+
+		if (s.expected.size() % 50 == 0)
+			Check(s);
+	}
+
+	EXPECT_TRUE(s.tree.empty());
+	EXPECT_EQ(s.tree.GetRoot(), nullptr);
+}
+
+TEST(SequenceTree, Swap)
+{
+	TestSequence s;
+	s.Fill(200);
+
+	/* edge cases: same index, first and last, neighbours */
+	s.tree.Swap(5, 5);
+	s.tree.Swap(0, 199);
+	std::swap(s.expected[0], s.expected[199]);
+	s.tree.Swap(11, 10);
+	std::swap(s.expected[10], s.expected[11]);
+	Check(s);
+
+	for (unsigned i = 0; i < 500; ++i) {
+		const unsigned a = s.Random(199), b = s.Random(199);
+		s.tree.Swap(a, b);
+		std::swap(s.expected[a], s.expected[b]);
+	}
+
+	Check(s);
+}
+
+TEST(SequenceTree, MoveRange)
+{
+	TestSequence s;
+	s.Fill(200);
+
+	for (unsigned i = 0; i < 500; ++i) {
+		const unsigned start = s.Random(200);
+		const unsigned end = start + s.Random(200 - start);
+		const unsigned to = s.Random(200 - (end - start));
+
+		s.tree.MoveRange(start, end, to);
+
+		std::vector<TestNode *> range(s.expected.begin() + start,
+					      s.expected.begin() + end);
+		s.expected.erase(s.expected.begin() + start,
+				 s.expected.begin() + end);
+		s.expected.insert(s.expected.begin() + to,
+				  range.begin(), range.end());
+
+		if (i % 50 == 0)
+			Check(s);
+	}
+
+	Check(s);
+}
+
+TEST(SequenceTree, AssignRearrange)
+{
+	TestSequence s;
+	s.Fill(100);
+
+	std::vector<TestNode *> v = s.expected;
+	std::reverse(v.begin(), v.end());
+	s.tree.Assign(v);
+	s.expected = v;
+	Check(s);
+
+	s.tree.Rearrange(20, 70, [](auto &r){
+		std::rotate(r.begin(), r.begin() + 10, r.end());
+	});
+	std::rotate(s.expected.begin() + 20, s.expected.begin() + 30,
+		    s.expected.begin() + 70);
+	Check(s);
+
+	/* an empty range must not change anything */
+	s.tree.Rearrange(50, 50, [](auto &r){
+		EXPECT_TRUE(r.empty());
+	});
+	Check(s);
+
+	unsigned n = 0;
+	s.tree.ClearAndDispose([&n](TestNode &){ ++n; });
+	EXPECT_EQ(n, 100u);
+	EXPECT_TRUE(s.tree.empty());
+}
+
+TEST(SequenceTree, LazyModification)
+{
+	TestSequence s;
+	s.Fill(300);
+
+	std::vector<int> values(300);
+	for (unsigned i = 0; i < values.size(); ++i)
+		values[i] = i;
+
+	for (unsigned i = 0; i < 300; ++i) {
+		const unsigned start = s.Random(300);
+		const unsigned end = start + s.Random(300 - start);
+		const int delta = int(s.Random(20)) - 10;
+
+		s.tree.ApplyRange(start, end, [delta](TestNode &node){
+			node.add += delta;
+		});
+
+		for (unsigned j = start; j < end; ++j)
+			values[j] += delta;
+
+		/* the lazy modifications must survive restructuring */
+		const unsigned a = s.Random(299), b = s.Random(299);
+		s.tree.Swap(a, b);
+		std::swap(s.expected[a], s.expected[b]);
+		std::swap(values[a], values[b]);
+	}
+
+	Check(s);
+
+	for (unsigned i = 0; i < values.size(); ++i)
+		EXPECT_EQ(GetValue(s.tree[i]), values[i]);
+
+	EXPECT_EQ(s.tree.GetRoot()->GetMax(),
+		  *std::max_element(values.begin(), values.end()));
+
+	/* Rearrange() propagates all lazy modifications into the
+	   range */
+	s.tree.Rearrange(0, 300, [&values](auto &v){
+		for (unsigned i = 0; i < v.size(); ++i) {
+			EXPECT_EQ(v[i]->add, 0);
+			EXPECT_EQ(v[i]->value, values[i]);
+		}
+	});
+}
+
+TEST(SequenceTree, UpdatePath)
+{
+	TestSequence s;
+	s.Fill(100);
+
+	auto &node = s.tree[42];
+	node.value = 1000;
+	TestTree::UpdatePath(node);
+
+	Check(s);
+	EXPECT_EQ(s.tree.GetRoot()->GetMax(), 1000);
+}
+
+TEST(SequenceTree, FindFirst)
+{
+	TestSequence s;
+	s.Fill(200);
+
+	/* mark some nodes with a high value */
+	std::vector<unsigned> marked;
+	for (unsigned i = 0; i < 20; ++i) {
+		const unsigned position = s.Random(199);
+		s.tree[position].value = 1000;
+		TestTree::UpdatePath(s.tree[position]);
+		marked.push_back(position);
+	}
+
+	std::sort(marked.begin(), marked.end());
+
+	const auto subtree_predicate = [](const TestNode &node){
+		return node.GetMax() >= 1000;
+	};
+
+	const auto node_predicate = [](const TestNode &node){
+		return node.value >= 1000;
+	};
+
+	for (unsigned start = 0; start <= 200; ++start) {
+		const auto i = std::lower_bound(marked.begin(), marked.end(),
+						start);
+		const unsigned expected = i != marked.end() ? *i : 200;
+		EXPECT_EQ(s.tree.FindFirst(start, subtree_predicate,
+					   node_predicate),
+			  expected);
+	}
+}
+
+/**
+ * Compare the queue with the expected song ids in "position" and
+ * "order" order.
+ */
+static void
+CheckQueue(const Queue &queue, const std::vector<unsigned> &positions,
+	   const std::vector<unsigned> &orders) noexcept
+{
+	ASSERT_EQ(queue.GetLength(), positions.size());
+	ASSERT_EQ(queue.GetLength(), orders.size());
+
+	for (unsigned position = 0; position < positions.size(); ++position) {
+		const unsigned id = positions[position];
+		EXPECT_EQ(queue.PositionToId(position), int(id));
+		EXPECT_EQ(queue.IdToPosition(id), int(position));
+
+		const unsigned order = queue.PositionToOrder(position);
+		EXPECT_EQ(queue.OrderToPosition(order), position);
+		EXPECT_EQ(orders[order], id);
+	}
+}
+
+TEST(SequenceTree, QueueConversion)
+{
+	Queue queue(1024);
+	queue.random = true;
+
+	std::mt19937 rng{42};
+	const auto random = [&rng](unsigned max){
+		return std::uniform_int_distribution<unsigned>{0, max}(rng);
+	};
+
+	std::vector<unsigned> positions, orders;
+	for (unsigned i = 0; i < 300; ++i) {
+		const unsigned id =
+			queue.Append(DetachedSong(std::to_string(i) + ".ogg"),
+				     0);
+		positions.push_back(id);
+		orders.push_back(id);
+	}
+
+	queue.ShuffleOrder();
+	for (unsigned order = 0; order < orders.size(); ++order)
+		orders[order] = queue.PositionToId(queue.OrderToPosition(order));
+
+	CheckQueue(queue, positions, orders);
+
+	for (unsigned i = 0; i < 200; ++i) {
+		const unsigned length = positions.size();
+
+		switch (random(3)) {
+		case 0:
+			{
+				const unsigned a = random(length - 1);
+				const unsigned b = random(length - 1);
+				const auto oa = std::find(orders.begin(),
+							  orders.end(),
+							  positions[a]);
+				const auto ob = std::find(orders.begin(),
+							  orders.end(),
+							  positions[b]);
+				queue.SwapPositions(a, b);
+				std::swap(positions[a], positions[b]);
+				std::iter_swap(oa, ob);
+			}
+			break;
+
+		case 1:
+			{
+				/* in random mode, moving songs does
+				   not change the order */
+				const unsigned start = random(length);
+				const unsigned end =
+					start + random(length - start);
+				const unsigned to =
+					random(length - (end - start));
+				queue.MoveRange(start, end, to);
+
+				std::vector<unsigned> range(positions.begin() + start,
+							    positions.begin() + end);
+				positions.erase(positions.begin() + start,
+						positions.begin() + end);
+				positions.insert(positions.begin() + to,
+						 range.begin(), range.end());
+			}
+			break;
+
+		case 2:
+			{
+				const unsigned from = random(length - 1);
+				const unsigned to = random(length - 1);
+				queue.MoveOrder(from, to);
+
+				const unsigned id = orders[from];
+				orders.erase(orders.begin() + from);
+				orders.insert(orders.begin() + to, id);
+			}
+			break;
+
+		case 3:
+			{
+				const unsigned position = random(length - 1);
+				const unsigned id = positions[position];
+				queue.DeletePosition(position);
+
+				positions.erase(positions.begin() + position);
+				orders.erase(std::find(orders.begin(),
+						       orders.end(), id));
+				EXPECT_EQ(queue.IdToPosition(id), -1);
+			}
+			break;
+		}
+
+		queue.IncrementVersion();
+	}
+
+	CheckQueue(queue, positions, orders);
+}
+
+/**
+ * Compare IsNewerAtPosition() and ForEachNewer() with the expected
+ * per-position versions.
+ */
+static void
+CheckVersions(const Queue &queue, const std::vector<uint32_t> &versions)
+{
+	ASSERT_EQ(queue.GetLength(), versions.size());
+
+	for (uint32_t since = 0; since <= queue.version + 1; ++since) {
+		std::vector<unsigned> expected;
+		for (unsigned position = 0; position < versions.size(); ++position) {
+			const bool newer = since > queue.version ||
+				versions[position] >= since ||
+				versions[position] == 0;
+			EXPECT_EQ(queue.IsNewerAtPosition(position, since),
+				  newer);
+			if (newer)
+				expected.push_back(position);
+		}
+
+		std::vector<unsigned> found;
+		queue.ForEachNewer(since, 0, queue.GetLength(),
+				   [&found](unsigned position){
+					   found.push_back(position);
+				   });
+		EXPECT_EQ(found, expected);
+	}
+}
+
+TEST(SequenceTree, QueueVersions)
+{
+	Queue queue(1024);
+
+	std::mt19937 rng{42};
+	const auto random = [&rng](unsigned max){
+		return std::uniform_int_distribution<unsigned>{0, max}(rng);
+	};
+
+	std::vector<uint32_t> versions;
+	const auto modify = [&versions, &queue](unsigned start, unsigned end){
+		for (unsigned i = start; i < end; ++i)
+			versions[i] = queue.version;
+	};
+
+	const auto step = [&](){
+		const unsigned length = versions.size();
+
+		switch (random(3)) {
+		case 0:
+			queue.Append(DetachedSong("x.ogg"), 0);
+			versions.push_back(queue.version);
+			break;
+
+		case 1:
+			{
+				const unsigned a = random(length - 1);
+				const unsigned b = random(length - 1);
+				queue.SwapPositions(a, b);
+				modify(a, a + 1);
+				modify(b, b + 1);
+			}
+			break;
+
+		case 2:
+			{
+				/* all songs between the old and the
+				   new location get the new version
+				   lazily */
+				const unsigned start = random(length);
+				const unsigned end =
+					start + random(length - start);
+				const unsigned to =
+					random(length - (end - start));
+				queue.MoveRange(start, end, to);
+				modify(std::min(start, to),
+				       std::max(end, to + end - start));
+			}
+			break;
+
+		case 3:
+			{
+				const unsigned position = random(length - 1);
+				queue.DeletePosition(position);
+				versions.erase(versions.begin() + position);
+				modify(position, versions.size());
+			}
+			break;
+		}
+
+		queue.IncrementVersion();
+	};
+
+	for (unsigned i = 0; i < 100; ++i) {
+		queue.Append(DetachedSong(std::to_string(i) + ".ogg"), 0);
+		versions.push_back(queue.version);
+	}
+
+	queue.IncrementVersion();
+
+	for (unsigned i = 0; i < 100; ++i)
+		step();
+
+	CheckVersions(queue, versions);
+
+	/* the version number wraps around; all items are reset to
+	   version 0, which means "always newer" */
+	queue.version = (uint32_t(1) << 31) - 3;
+	step();
+	EXPECT_EQ(queue.version, (uint32_t(1) << 31) - 2);
+
+	queue.IncrementVersion();
+	EXPECT_EQ(queue.version, 1u);
+	std::fill(versions.begin(), versions.end(), 0);
+	CheckVersions(queue, versions);
+
+	/* new modifications after the wraparound are tracked
+	   again */
+	for (unsigned i = 0; i < 50; ++i)
+		step();
+
+	CheckVersions(queue, versions);
+}
@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Sort.hxx"
+#include "tag/VisitFallback.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <fmt/core.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+class TagIndexTest : public ::testing::Test {
+protected:
+	Directory *root;
+
+	void SetUp() override {
+		IcuInit();
+
+		const ScopeDatabaseLock protect;
+		root = Directory::NewRoot();
+		Generate();
+	}
+
+	void TearDown() override {
+		{
+			const ScopeDatabaseLock protect;
+			delete root;
+		}
+
+		IcuFinish();
+	}
+
+private:
+	void Generate() noexcept {
+		for (unsigned a = 0; a < 4; ++a) {
+			auto *artist = root->MakeChild(fmt::format("Artist {}", a));
+
+			for (unsigned b = 0; b < 3; ++b) {
+				auto *album = artist->MakeChild(fmt::format("Album {}", b));
+
+				for (unsigned i = 0; i < 5; ++i)
+					AddSong(*album, a, b, i);
+			}
+		}
+	}
+
+	static void AddSong(Directory &directory, unsigned a, unsigned b,
+			    unsigned i) noexcept {
+		const auto artist = fmt::format("Artist {}", a);
+		const auto album = fmt::format("Album {}{}", char('A' + b), a);
+		const auto title = fmt::format("Title {}", (i * 7 + a) % 5);
+		const auto date = fmt::format("{}", 1990 + (a + b) % 3);
+
+		auto song = std::make_unique<Song>(fmt::format("{}.flac", i),
+						   directory);
+
+		/* some songs have an AlbumArtist, some have no
+		   Date */
+		song->tag = i % 2 == 0
+			? MakeTag(TAG_ARTIST, artist.c_str(),
+				  TAG_ALBUM_ARTIST, "Various",
+				  TAG_ALBUM, album.c_str(),
+				  TAG_TITLE, title.c_str(),
+				  TAG_DATE, date.c_str())
+			: MakeTag(TAG_ARTIST, artist.c_str(),
+				  TAG_ALBUM, album.c_str(),
+				  TAG_TITLE, title.c_str());
+
+		/* pretend a playlist refers to some songs */
+		song->in_playlist = i == 3;
+
+		directory.AddSong(std::move(song));
+	}
+};
+
+static SongFilter
+ParseFilter(const char *expression)
+{
+	const std::array<const char *, 1> args{expression};
+
+	SongFilter filter;
+	filter.Parse(args);
+	filter.Optimize();
+	return filter;
+}
+
+/**
+ * Collect the URIs of all matching songs with Directory::Walk().
+ */
+static std::vector<std::string>
+WalkTree(const Directory &directory, const SongFilter *filter,
+	 bool hide_playlist_targets)
+{
+	std::vector<std::string> result;
+	directory.Walk(true, filter, hide_playlist_targets, {},
+		       [&result](const LightSong &song){
+			       result.push_back(song.GetURI());
+		       }, {});
+	return result;
+}
+
+static std::vector<std::string>
+WalkIndex(const TagIndex &index, const Directory &directory,
+	  const SongFilter &filter, bool hide_playlist_targets)
+{
+	std::vector<std::string> result;
+	EXPECT_TRUE(index.Walk(directory, filter, hide_playlist_targets,
+			       [&result](const LightSong &song){
+				       result.push_back(song.GetURI());
+			       }));
+	return result;
+}
+
+/**
+ * Like TagIndex::VisitSorted(), but implemented with
+ * Directory::Walk() and std::stable_sort().
+ */
+static std::vector<std::string>
+SortTree(const Directory &root, TagType type, bool descending,
+	 const SongFilter *filter, RangeArg window,
+	 bool hide_playlist_targets)
+{
+	std::vector<std::pair<std::string, std::string>> songs;
+	root.Walk(true, filter, hide_playlist_targets, {},
+		  [type, &songs](const LightSong &song){
+			  songs.emplace_back(song.tag.GetSortValue(type),
+					     song.GetURI());
+		  }, {});
+
+	std::stable_sort(songs.begin(), songs.end(),
+			 [type, descending](const auto &a, const auto &b){
+				 return descending
+					 ? CompareTagValues(type, b.first.c_str(),
+							    a.first.c_str())
+					 : CompareTagValues(type, a.first.c_str(),
+							    b.first.c_str());
+			 });
+
+	std::vector<std::string> result;
+	for (unsigned i = 0; i < songs.size(); ++i)
+		if (window.Contains(i))
+			result.push_back(std::move(songs[i].second));
+	return result;
+}
+
+static std::vector<std::string>
+SortIndex(const TagIndex &index, TagType type, bool descending,
+	  const SongFilter *filter, RangeArg window)
+{
+	std::vector<std::string> result;
+	EXPECT_TRUE(index.VisitSorted(type, descending, filter, window,
+				      [&result](const LightSong &song){
+					      result.push_back(song.GetURI());
+				      }));
+	return result;
+}
+
+TEST_F(TagIndexTest, Walk)
+{
+	const ScopeDatabaseReadLock protect;
+
+	TagIndex index{TagMask{TAG_ARTIST} | TAG_ALBUM_ARTIST | TAG_ALBUM};
+	index.Build(*root, false);
+
+	static constexpr const char *expressions[] = {
+		"(Artist == \"Artist 2\")",
+		"(Artist == \"nonexistent\")",
+		"(Album starts_with \"Album B\")",
+		"(Album starts_with \"Album\")",
+		/* falls back to Artist for songs without
+		   AlbumArtist */
+		"(AlbumArtist == \"Artist 1\")",
+		"(AlbumArtist == \"Various\")",
+		"((Artist == \"Artist 3\") AND (Title == \"Title 1\"))",
+		"((Album starts_with \"Album C\") AND (!(Artist == \"Artist 0\")))",
+	};
+
+	for (const char *expression : expressions) {
+		const auto filter = ParseFilter(expression);
+		ASSERT_TRUE(index.CanWalk(filter)) << expression;
+
+		for (const bool hide : {false, true}) {
+			EXPECT_EQ(WalkIndex(index, *root, filter, hide),
+				  WalkTree(*root, &filter, hide))
+				<< expression;
+		}
+
+		/* walking a subdirectory */
+		const auto *directory = root->LookupDirectory("Artist 1").directory;
+		ASSERT_NE(directory, nullptr);
+		EXPECT_EQ(WalkIndex(index, *directory, filter, false),
+			  WalkTree(*directory, &filter, false))
+			<< expression;
+	}
+}
+
+TEST_F(TagIndexTest, CanWalk)
+{
+	const ScopeDatabaseReadLock protect;
+
+	TagIndex index{TagMask{TAG_ARTIST} | TAG_ALBUM};
+	index.Build(*root, false);
+
+	EXPECT_TRUE(index.CanWalk(ParseFilter("(Artist == \"Artist 1\")")));
+	EXPECT_TRUE(index.CanWalk(ParseFilter("(Album starts_with \"A\")")));
+	EXPECT_TRUE(index.CanWalk(ParseFilter("((Title == \"x\") AND (Artist == \"y\"))")));
+
+	/* not indexed */
+	EXPECT_FALSE(index.CanWalk(ParseFilter("(Title == \"Title 1\")")));
+
+	/* AlbumArtist falls back to Artist, which is indexed, but
+	   AlbumArtist is not */
+	EXPECT_FALSE(index.CanWalk(ParseFilter("(AlbumArtist == \"Various\")")));
+
+	/* these cannot be looked up */
+	EXPECT_FALSE(index.CanWalk(ParseFilter("(Artist != \"Artist 1\")")));
+	EXPECT_FALSE(index.CanWalk(ParseFilter("(Artist contains \"1\")")));
+	EXPECT_FALSE(index.CanWalk(ParseFilter("(Artist == \"\")")));
+
+	TagIndex index2{TagMask{TAG_ARTIST}};
+	index2.Build(*root, false);
+
+	const auto filter = ParseFilter("(Title == \"Title 1\")");
+	bool visited = false;
+	EXPECT_FALSE(index2.Walk(*root, filter, false,
+				 [&visited](const LightSong &){
+					 visited = true;
+				 }));
+	EXPECT_FALSE(visited);
+}
+
+TEST_F(TagIndexTest, VisitSorted)
+{
+	const ScopeDatabaseReadLock protect;
+
+	for (const bool hide : {false, true}) {
+		TagIndex index{TagMask{TAG_ALBUM} | TAG_DATE | TAG_TITLE};
+		index.Build(*root, hide);
+
+		const auto filter = ParseFilter("(Artist != \"Artist 2\")");
+
+		for (const TagType type : {TAG_ALBUM, TAG_DATE, TAG_TITLE}) {
+			for (const bool descending : {false, true}) {
+				for (const RangeArg window : {RangeArg::All(),
+							      RangeArg{0, 1},
+							      RangeArg{5, 17},
+							      RangeArg{40, 1000},
+							      RangeArg{3, 3}}) {
+					EXPECT_EQ(SortIndex(index, type, descending,
+							    nullptr, window),
+						  SortTree(*root, type, descending,
+							   nullptr, window, hide));
+					EXPECT_EQ(SortIndex(index, type, descending,
+							    &filter, window),
+						  SortTree(*root, type, descending,
+							   &filter, window, hide));
+				}
+			}
+		}
+
+		/* not indexed */
+		EXPECT_FALSE(index.VisitSorted(TAG_ARTIST, false, nullptr,
+					       RangeArg::All(),
+					       [](const LightSong &){}));
+	}
+}
+
+TEST_F(TagIndexTest, GetValues)
+{
+	const ScopeDatabaseReadLock protect;
+
+	for (const bool hide : {false, true}) {
+		TagIndex index{TagMask{TAG_ALBUM_ARTIST} | TAG_DATE};
+		index.Build(*root, hide);
+
+		for (const TagType type : {TAG_ALBUM_ARTIST, TAG_DATE}) {
+			std::map<std::string, unsigned> expected;
+			root->Walk(true, nullptr, hide, {},
+				   [type, &expected](const LightSong &song){
+					   VisitTagWithFallbackOrEmpty(song.tag, type,
+								       [&expected](const char *value){
+									       ++expected[value];
+								       });
+				   }, {});
+
+			const auto *values = index.GetValues(type);
+			ASSERT_NE(values, nullptr);
+
+			std::map<std::string, unsigned> actual;
+			for (const auto &[value, stats] : *values)
+				actual.emplace(value, stats.n_songs);
+
+			EXPECT_EQ(actual, expected);
+		}
+
+		EXPECT_EQ(index.GetValues(TAG_ARTIST), nullptr);
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * Unit tests for class PeakBuffer.
+ */
+
+#include "util/PeakBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+static std::vector<std::byte>
+MakeData(std::size_t size, unsigned seed) noexcept
+{
+	std::vector<std::byte> v(size);
+	for (std::size_t i = 0; i < size; ++i)
+		v[i] = std::byte(i * 7 + seed);
+	return v;
+}
+
+static std::vector<std::byte>
+ReadAll(const PeakBuffer &buffer) noexcept
+{
+	std::array<std::span<const std::byte>, 64> pieces;
+	const std::size_t n = buffer.Read(pieces);
+
+	std::vector<std::byte> result;
+	for (std::size_t i = 0; i < n; ++i)
+		result.insert(result.end(), pieces[i].begin(), pieces[i].end());
+	return result;
+}
+
+TEST(PeakBuffer, Normal)
+{
+	PeakBuffer buffer(1024, 0);
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_TRUE(buffer.Read().empty());
+
+	const auto a = MakeData(1000, 1);
+	EXPECT_TRUE(buffer.Append(a));
+	EXPECT_FALSE(buffer.empty());
+	EXPECT_EQ(ReadAll(buffer), a);
+
+	/* no peak buffer configured; nothing is appended */
+	EXPECT_FALSE(buffer.Append(MakeData(100, 2)));
+	EXPECT_EQ(ReadAll(buffer), a);
+
+	buffer.Consume(1000);
+	EXPECT_TRUE(buffer.empty());
+}
+
+TEST(PeakBuffer, Peak)
+{
+	PeakBuffer buffer(1024, 1024 * 1024);
+
+	const auto a = MakeData(1000, 1);
+	const auto b = MakeData(300000, 2);
+	EXPECT_TRUE(buffer.Append(a));
+	EXPECT_TRUE(buffer.Append(b));
+
+	std::vector<std::byte> expected = a;
+	expected.insert(expected.end(), b.begin(), b.end());
+	EXPECT_EQ(ReadAll(buffer), expected);
+
+	/* the first piece is the normal buffer */
+	EXPECT_EQ(buffer.Read().size(), 1024u);
+
+	/* consume across several pieces */
+	buffer.Consume(200000);
+	expected.erase(expected.begin(), expected.begin() + 200000);
+	EXPECT_EQ(ReadAll(buffer), expected);
+
+	/* new data goes after the peak data */
+	const auto c = MakeData(50, 3);
+	EXPECT_TRUE(buffer.Append(c));
+	expected.insert(expected.end(), c.begin(), c.end());
+	EXPECT_EQ(ReadAll(buffer), expected);
+
+	buffer.Consume(expected.size());
+	EXPECT_TRUE(buffer.empty());
+
+	/* the normal buffer is used again after the peak is gone */
+	EXPECT_TRUE(buffer.Append(c));
+	EXPECT_EQ(ReadAll(buffer), c);
+}
+
+TEST(PeakBuffer, Full)
+{
+	PeakBuffer buffer(1024, 4096);
+
+	EXPECT_TRUE(buffer.Append(MakeData(1024 + 4096, 1)));
+	EXPECT_FALSE(buffer.Append(MakeData(1, 2)));
+}
+
+TEST(PeakBuffer, FullNothingAppended)
+{
+	PeakBuffer buffer(1024, 4096);
+
+	/* data which does not fit is rejected as a whole */
+	EXPECT_FALSE(buffer.Append(MakeData(1024 + 4096 + 1, 1)));
+	EXPECT_TRUE(buffer.empty());
+
+	const auto a = MakeData(3000, 2);
+	EXPECT_TRUE(buffer.Append(a));
+	EXPECT_FALSE(buffer.Append(MakeData(3000, 3)));
+	EXPECT_EQ(ReadAll(buffer), a);
+}
+
+TEST(PeakBuffer, AllocatedSize)
+{
+	PeakBuffer buffer(1024, 1024 * 1024);
+	EXPECT_EQ(buffer.GetAllocatedSize(), 0U);
+
+	EXPECT_TRUE(buffer.Append(MakeData(1000, 1)));
+	const std::size_t normal = buffer.GetAllocatedSize();
+	EXPECT_GE(normal, 1000U);
+
+	/* the peak chunks are counted, too */
+	EXPECT_TRUE(buffer.Append(MakeData(200000, 2)));
+	EXPECT_GE(buffer.GetAllocatedSize(), normal + 200000);
+
+	/* consumed peak chunks are handed back */
+	buffer.Consume(1000 + 200000);
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_LE(buffer.GetAllocatedSize(), normal);
+}
+
+TEST(PeakBuffer, TotalPeakSize)
+{
+	const std::size_t before = PeakBuffer::GetTotalPeakSize();
+
+	PeakBuffer buffer(1024, 1024 * 1024);
+	EXPECT_TRUE(buffer.Append(MakeData(1024, 1)));
+	EXPECT_EQ(PeakBuffer::GetTotalPeakSize(), before);
+
+	EXPECT_TRUE(buffer.Append(MakeData(200000, 2)));
+	EXPECT_GE(PeakBuffer::GetTotalPeakSize(), before + 200000);
+
+	buffer.Consume(1024 + 200000);
+	EXPECT_EQ(PeakBuffer::GetTotalPeakSize(), before);
+}
@@ -0,0 +1,90 @@
+/*
+ * Unit tests for class Tokenizer.
+ */
+
+#include "util/Tokenizer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+TEST(Tokenizer, Word)
+{
+	char buffer[] = "  foo_1 bar";
+	Tokenizer t(buffer + 2);
+	EXPECT_STREQ(t.NextWord(), "foo_1");
+	EXPECT_STREQ(t.NextWord(), "bar");
+	EXPECT_EQ(t.NextWord(), nullptr);
+
+	char invalid[] = "foo-bar";
+	Tokenizer t2(invalid);
+	EXPECT_THROW(t2.NextWord(), std::runtime_error);
+}
+
+TEST(Tokenizer, Unquoted)
+{
+	char buffer[] = "a/b.flac   c";
+	Tokenizer t(buffer);
+	EXPECT_STREQ(t.NextUnquoted(), "a/b.flac");
+	EXPECT_STREQ(t.NextUnquoted(), "c");
+	EXPECT_EQ(t.NextUnquoted(), nullptr);
+
+	char invalid[] = "a\"b";
+	Tokenizer t2(invalid);
+	EXPECT_THROW(t2.NextUnquoted(), std::runtime_error);
+}
+
+TEST(Tokenizer, String)
+{
+	char buffer[] = "\"foo bar\" \"\" \"x\"";
+	Tokenizer t(buffer);
+
+	/* without escapes, the string is used in place */
+	char *const s = t.NextString();
+	EXPECT_EQ(s, buffer + 1);
+	EXPECT_STREQ(s, "foo bar");
+
+	EXPECT_STREQ(t.NextString(), "");
+	EXPECT_STREQ(t.NextString(), "x");
+	EXPECT_EQ(t.NextString(), nullptr);
+}
+
+TEST(Tokenizer, Escape)
+{
+	char buffer[] = R"("a\"b\\c" "\x" "end\"")";
+	Tokenizer t(buffer);
+	EXPECT_STREQ(t.NextString(), R"(a"b\c)");
+	EXPECT_STREQ(t.NextString(), "x");
+	EXPECT_STREQ(t.NextString(), "end\"");
+	EXPECT_EQ(t.NextString(), nullptr);
+}
+
+TEST(Tokenizer, StringErrors)
+{
+	char missing_quote[] = "\"foo";
+	EXPECT_THROW(Tokenizer(missing_quote).NextString(),
+		     std::runtime_error);
+
+	char trailing_backslash[] = "\"foo\\";
+	EXPECT_THROW(Tokenizer(trailing_backslash).NextString(),
+		     std::runtime_error);
+
+	char no_space[] = "\"foo\"bar";
+	EXPECT_THROW(Tokenizer(no_space).NextString(),
+		     std::runtime_error);
+
+	char unquoted[] = "foo";
+	EXPECT_THROW(Tokenizer(unquoted).NextString(),
+		     std::runtime_error);
+}
+
+TEST(Tokenizer, Param)
+{
+	char buffer[] = "find \"(artist == \\\"x\\\")\" sort Title";
+	Tokenizer t(buffer);
+	EXPECT_STREQ(t.NextWord(), "find");
+	EXPECT_STREQ(t.NextParam(), "(artist == \"x\")");
+	EXPECT_STREQ(t.NextParam(), "sort");
+	EXPECT_STREQ(t.NextParam(), "Title");
+	EXPECT_EQ(t.NextParam(), nullptr);
+}
@@ -0,0 +1,30 @@
+/*
+ * Unit tests for src/util/
+ */
+
+#include "util/UTF8.hxx"
+
+#include <gtest/gtest.h>
+
+using std::string_view_literals::operator""sv;
+
+TEST(UTF8, Validate)
+{
+	EXPECT_TRUE(ValidateUTF8(""sv));
+	EXPECT_TRUE(ValidateUTF8("foo"sv));
+	EXPECT_TRUE(ValidateUTF8("0123456789abcdef0123456789"sv));
+	EXPECT_TRUE(ValidateUTF8("01234567\xc3\xa4"sv));
+	EXPECT_TRUE(ValidateUTF8("\xe2\x82\xac 0123456789 \xf0\x9f\x8e\xb5"sv));
+
+	/* continuation without a leading byte */
+	EXPECT_FALSE(ValidateUTF8("0123456789\x80"sv));
+
+	/* missing continuation */
+	EXPECT_FALSE(ValidateUTF8("\xc3" "a0123456789"sv));
+
+	/* truncated sequence at the end */
+	EXPECT_FALSE(ValidateUTF8("0123456789\xe2\x82"sv));
+
+	/* the string_view ends before the continuation */
+	EXPECT_FALSE(ValidateUTF8("\xc3\xa4"sv.substr(0, 1)));
+}